@@ -42,6 +42,10 @@ extern "C"
 #include "mlt_frame.h"
 #include "mlt_image.h"
 #include "mlt_deque.h"
+#include "mlt_ring.h"
+#include "mlt_audio_ring.h"
+#include "mlt_peaks.h"
+#include "mlt_trace.h"
 #include "mlt_multitrack.h"
 #include "mlt_producer.h"
 #include "mlt_transition.h"
@@ -59,6 +63,7 @@ extern "C"
 #include "mlt_cache.h"
 #include "mlt_version.h"
 #include "mlt_slices.h"
+#include "mlt_cpu.h"
 #include "mlt_link.h"
 #include "mlt_chain.h"
 
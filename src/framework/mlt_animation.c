@@ -26,6 +26,7 @@
 #include "mlt_factory.h"
 #include "mlt_properties.h"
 
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -52,10 +53,155 @@ struct mlt_animation_s
 	double fps;           /**< framerate to use when converting time clock strings to frame units */
 	locale_t locale;      /**< pointer to a locale to use when converting strings to numeric values */
 	animation_node nodes; /**< a linked list of keyframes (and possibly non-keyframe values) */
+	animation_node *index; /**< the nodes in list order for searching by position or number */
+	int count;            /**< the number of nodes */
+	int capacity;         /**< the allocated size of index */
+	int sorted;           /**< whether the nodes are in order of frame, so index can be bisected */
+	atomic_int last;      /**< the node found by the previous lookup, as a hint for the next one */
 };
 
 static void mlt_animation_clear_string( mlt_animation self );
 
+/** Find the node that governs a position.
+ *
+ * This is the last node at or before the position, or the first node if the
+ * position precedes them all. Playback usually asks for the same segment as
+ * before or the one after it, so those are tried before bisecting the index.
+ * \private \memberof mlt_animation_s
+ * \param self an animation
+ * \param position the frame number
+ * \return the index of the node or -1 if there are no nodes
+ */
+
+static int find_node( mlt_animation self, int position )
+{
+	animation_node *index = self->index;
+	int n = self->count;
+	int i;
+
+	if ( n == 0 )
+		return -1;
+	if ( !self->sorted )
+	{
+		for ( i = 0; i + 1 < n && position >= index[i + 1]->item.frame; i++ );
+		return i;
+	}
+
+	i = atomic_load_explicit( &self->last, memory_order_relaxed );
+	if ( i >= 0 && i < n && ( i == 0 || position >= index[i]->item.frame ) )
+	{
+		if ( i + 1 == n || position < index[i + 1]->item.frame )
+			return i;
+		if ( i + 2 == n || position < index[i + 2]->item.frame )
+			i++;
+		else
+			i = -1;
+	}
+	else
+	{
+		i = -1;
+	}
+
+	if ( i < 0 )
+	{
+		// Bisect for the first node after the position
+		int lo = 0, hi = n;
+		while ( lo < hi )
+		{
+			int mid = lo + ( hi - lo ) / 2;
+			if ( index[mid]->item.frame <= position )
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		i = lo > 0 ? lo - 1 : 0;
+	}
+	atomic_store_explicit( &self->last, i, memory_order_relaxed );
+	return i;
+}
+
+/** Find the first node at or after a position.
+ *
+ * \private \memberof mlt_animation_s
+ * \param self an animation
+ * \param position the frame number
+ * \return the index of the node, which is the number of nodes if there is none
+ */
+
+static int find_next( mlt_animation self, int position )
+{
+	animation_node *index = self->index;
+	int lo = 0, hi = self->count;
+
+	if ( !self->sorted )
+	{
+		while ( lo < hi && position > index[lo]->item.frame )
+			lo++;
+		return lo;
+	}
+	while ( lo < hi )
+	{
+		int mid = lo + ( hi - lo ) / 2;
+		if ( index[mid]->item.frame < position )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/** Determine if the nodes are still in order after moving one.
+ *
+ * Out of order nodes are searched from the start of the list like they always
+ * were, until moving them puts them back in order.
+ * \private \memberof mlt_animation_s
+ * \param self an animation
+ * \param i the index of the node that moved
+ */
+
+static void check_order( mlt_animation self, int i )
+{
+	animation_node *index = self->index;
+
+	if ( self->sorted )
+	{
+		if ( ( i > 0 && index[i - 1]->item.frame > index[i]->item.frame )
+			 || ( i + 1 < self->count && index[i]->item.frame > index[i + 1]->item.frame ) )
+			self->sorted = 0;
+	}
+	else
+	{
+		for ( i = 1; i < self->count && index[i - 1]->item.frame <= index[i]->item.frame; i++ );
+		self->sorted = i >= self->count;
+	}
+}
+
+/** Add a node to the index.
+ *
+ * \private \memberof mlt_animation_s
+ * \param self an animation
+ * \param i the position of the node in the list
+ * \param node the node
+ * \return true if there was an error
+ */
+
+static int index_insert( mlt_animation self, int i, animation_node node )
+{
+	if ( self->count == self->capacity )
+	{
+		int capacity = self->capacity ? self->capacity * 2 : 16;
+		animation_node *index = realloc( self->index, capacity * sizeof( *index ) );
+		if ( !index )
+			return 1;
+		self->index = index;
+		self->capacity = capacity;
+	}
+	memmove( &self->index[i + 1], &self->index[i], ( self->count - i ) * sizeof( *self->index ) );
+	self->index[i] = node;
+	self->count++;
+	return 0;
+}
+
 /** Create a new animation object.
  *
  * \public \memberof mlt_animation_s
@@ -65,6 +211,8 @@ static void mlt_animation_clear_string( mlt_animation self );
 mlt_animation mlt_animation_new( )
 {
 	mlt_animation self = calloc( 1, sizeof( *self ) );
+	if ( self )
+		self->sorted = 1;
 	return self;
 }
 
@@ -125,6 +273,19 @@ void mlt_animation_interpolate( mlt_animation self )
 
 static int mlt_animation_drop( mlt_animation self, animation_node node )
 {
+	int i = self->count - 1;
+
+	// Nodes are mostly dropped from the end or, when cleaning, the start
+	if ( i > 0 && self->index[i] != node )
+	{
+		for ( i = 0; i < self->count && self->index[i] != node; i++ );
+	}
+	if ( i >= 0 && i < self->count )
+	{
+		memmove( &self->index[i], &self->index[i + 1], ( self->count - i - 1 ) * sizeof( *self->index ) );
+		self->count--;
+	}
+
 	if ( node == self->nodes )
 	{
 		self->nodes = node->next;
@@ -164,8 +325,14 @@ static void mlt_animation_clean( mlt_animation self )
 
 	free( self->data );
 	self->data = NULL;
+	self->count = 0;
 	while ( self->nodes )
 		mlt_animation_drop( self, self->nodes );
+	free( self->index );
+	self->index = NULL;
+	self->capacity = 0;
+	self->sorted = 1;
+	atomic_store_explicit( &self->last, 0, memory_order_relaxed );
 }
 
 /** Parse a string representing an animation.
@@ -398,11 +565,8 @@ int mlt_animation_get_item( mlt_animation self, mlt_animation_item item, int pos
 
 	int error = 0;
 	// Need to find the nearest keyframe to the position specified
-	animation_node node = self->nodes;
-
-	// Iterate through the keyframes until we reach last or have
-	while ( node && node->next && position >= node->next->item.frame )
-		node = node->next;
+	int i = find_node( self, position );
+	animation_node node = i >= 0 ? self->index[i] : NULL;
 
 	if ( node )
 	{
@@ -483,14 +647,20 @@ int mlt_animation_insert( mlt_animation self, mlt_animation_item item )
 	// Determine if we need to insert or append to the list, or if it's a new list
 	if ( self->nodes )
 	{
-		// Get the first item
-		animation_node current = self->nodes;
-
 		// Locate an existing nearby item
-		while ( current->next && item->frame > current->item.frame )
-			current = current->next;
+		int i = find_next( self, item->frame );
+		if ( i == self->count )
+			i--;
+		animation_node current = self->index[i];
 
-		if ( item->frame < current->item.frame )
+		if ( item->frame != current->item.frame
+			 && index_insert( self, item->frame < current->item.frame ? i : i + 1, node ) )
+		{
+			mlt_property_close( node->item.property );
+			free( node );
+			error = 1;
+		}
+		else if ( item->frame < current->item.frame )
 		{
 			if ( current == self->nodes )
 				self->nodes = node;
@@ -519,6 +689,12 @@ int mlt_animation_insert( mlt_animation self, mlt_animation_item item )
 			free( node );
 		}
 	}
+	else if ( index_insert( self, 0, node ) )
+	{
+		mlt_property_close( node->item.property );
+		free( node );
+		error = 1;
+	}
 	else
 	{
 		// Set the first item
@@ -542,10 +718,20 @@ int mlt_animation_remove( mlt_animation self, int position )
 	if (!self) return 1;
 
 	int error = 1;
-	animation_node node = self->nodes;
+	animation_node node = NULL;
 
-	while ( node && position != node->item.frame )
-		node = node->next;
+	if ( self->sorted )
+	{
+		int i = find_next( self, position );
+		if ( i < self->count )
+			node = self->index[i];
+	}
+	else
+	{
+		node = self->nodes;
+		while ( node && position != node->item.frame )
+			node = node->next;
+	}
 
 	if ( node && position == node->item.frame )
 		error = mlt_animation_drop( self, node );
@@ -568,10 +754,8 @@ int mlt_animation_next_key( mlt_animation self, mlt_animation_item item, int pos
 {
 	if (!self || !item) return 1;
 
-	animation_node node = self->nodes;
-
-	while ( node && position > node->item.frame )
-		node = node->next;
+	int i = find_next( self, position );
+	animation_node node = i < self->count ? self->index[i] : NULL;
 
 	if ( node )
 	{
@@ -598,10 +782,8 @@ int mlt_animation_prev_key( mlt_animation self, mlt_animation_item item, int pos
 {
 	if (!self || !item) return 1;
 
-	animation_node node = self->nodes;
-
-	while ( node && node->next && position >= node->next->item.frame )
-		node = node->next;
+	int i = find_node( self, position );
+	animation_node node = i >= 0 ? self->index[i] : NULL;
 
 	if ( node )
 	{
@@ -818,14 +1000,7 @@ char *mlt_animation_serialize( mlt_animation self )
 
 int mlt_animation_key_count( mlt_animation self )
 {
-	int count = -1;
-	if ( self )
-	{
-		animation_node node = self->nodes;
-		for ( count = 0; node; ++count )
-			node = node->next;
-	}
-	return count;
+	return self ? self->count : -1;
 }
 
 /** Get an animation item for the N-th keyframe.
@@ -842,12 +1017,7 @@ int mlt_animation_key_get( mlt_animation self, mlt_animation_item item, int inde
 	if (!self || !item) return 1;
 
 	int error = 0;
-	animation_node node = self->nodes;
-
-	// Iterate through the keyframes.
-	int i = index;
-	while ( i-- && node )
-		node = node->next;
+	animation_node node = index >= 0 && index < self->count ? self->index[index] : NULL;
 
 	if ( node )
 	{
@@ -866,6 +1036,22 @@ int mlt_animation_key_get( mlt_animation self, mlt_animation_item item, int inde
 	return error;
 }
 
+/** Get the number of the keyframe that applies at a position.
+ *
+ * This is the keyframe at or preceding the position, or the first one if the
+ * position precedes them all, which makes it the start of the segment that
+ * mlt_animation_get_item() interpolates.
+ * \public \memberof mlt_animation_s
+ * \param self an animation
+ * \param position the frame number
+ * \return the N-th keyframe (0 based) or -1 if there are none
+ */
+
+int mlt_animation_key_index( mlt_animation self, int position )
+{
+	return self ? find_node( self, position ) : -1;
+}
+
 /** Close the animation and deallocate all of its resources.
  *
  * \public \memberof mlt_animation_s
@@ -895,12 +1081,7 @@ int mlt_animation_key_set_type(mlt_animation self, int index, mlt_keyframe_type
 	if (!self) return 1;
 
 	int error = 0;
-	animation_node node = self->nodes;
-
-	// Iterate through the keyframes.
-	int i = index;
-	while ( i-- && node )
-		node = node->next;
+	animation_node node = index >= 0 && index < self->count ? self->index[index] : NULL;
 
 	if ( node ) {
 		node->item.keyframe_type = type;
@@ -927,15 +1108,11 @@ int mlt_animation_key_set_frame(mlt_animation self, int index, int frame)
 	if (!self) return 1;
 
 	int error = 0;
-	animation_node node = self->nodes;
-
-	// Iterate through the keyframes.
-	int i = index;
-	while ( i-- && node )
-		node = node->next;
+	animation_node node = index >= 0 && index < self->count ? self->index[index] : NULL;
 
 	if ( node ) {
 		node->item.frame = frame;
+		check_order( self, index );
 		mlt_animation_interpolate(self);
 		mlt_animation_clear_string( self );
 	} else {
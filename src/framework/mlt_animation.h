@@ -66,6 +66,7 @@ extern char *mlt_animation_serialize_tf( mlt_animation self, mlt_time_format );
 extern char *mlt_animation_serialize( mlt_animation self );
 extern int mlt_animation_key_count( mlt_animation self );
 extern int mlt_animation_key_get( mlt_animation self, mlt_animation_item item, int index );
+extern int mlt_animation_key_index( mlt_animation self, int position );
 extern void mlt_animation_close( mlt_animation self );
 extern int mlt_animation_key_set_type( mlt_animation self, int index, mlt_keyframe_type type );
 extern int mlt_animation_key_set_frame( mlt_animation self, int index, int frame );
@@ -27,6 +27,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define USE_NEON 1
+#endif
+
 /** Allocate a new Audio object.
  *
  * \return a new audio object with default values set
@@ -712,3 +720,342 @@ mlt_channel_layout mlt_audio_channel_layout_default( int channels )
 	}
 	return mlt_channel_independent;
 }
+
+/** Convert signed 16-bit samples to float.
+ *
+ * The layout is kept, so this works for interleaved and planar audio alike.
+ * The results are the same as those of the scalar conversion by 32768.
+ *
+ * \public \memberof mlt_audio_s
+ * \param dst the float samples
+ * \param src the 16-bit samples
+ * \param count the number of samples of all of the channels
+ */
+
+void mlt_audio_s16_to_f32( float *dst, const int16_t *src, int count )
+{
+	int i = 0;
+#if USE_SSE2
+	const __m128 scale = _mm_set1_ps( 1.0f / 32768.0f );
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m128i v = _mm_loadu_si128( (const __m128i*) ( src + i ) );
+		_mm_storeu_ps( dst + i, _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 ) ), scale ) );
+		_mm_storeu_ps( dst + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( v, v ), 16 ) ), scale ) );
+	}
+#elif USE_NEON
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		int16x8_t v = vld1q_s16( src + i );
+		vst1q_f32( dst + i, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_low_s16( v ) ) ), 1.0f / 32768.0f ) );
+		vst1q_f32( dst + i + 4, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_high_s16( v ) ) ), 1.0f / 32768.0f ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+		dst[i] = (float) src[i] / 32768.0f;
+}
+
+// Clip float samples to -1.0 to 1.0, and NaN to 0. NaN is found by its bits
+// since -ffast-math lets the compiler assume that a float equals itself.
+static inline float clip_sample( float f )
+{
+	uint32_t bits;
+	memcpy( &bits, &f, sizeof( bits ) );
+	return ( bits & 0x7fffffff ) > 0x7f800000 ? 0.0f : CLAMP( f, -1.0f, 1.0f );
+}
+#if USE_SSE2
+#define CLIP_SAMPLES( v ) _mm_min_ps( _mm_max_ps( _mm_andnot_ps( _mm_castsi128_ps( _mm_cmpgt_epi32( \
+	_mm_and_si128( _mm_castps_si128( v ), _mm_set1_epi32( 0x7fffffff ) ), _mm_set1_epi32( 0x7f800000 ) ) ), ( v ) ), lo ), hi )
+#elif USE_NEON
+#define CLIP_SAMPLES( v ) vminq_f32( vmaxq_f32( vreinterpretq_f32_u32( vbicq_u32( vreinterpretq_u32_f32( v ), vcgtq_u32( \
+	vandq_u32( vreinterpretq_u32_f32( v ), vdupq_n_u32( 0x7fffffff ) ), vdupq_n_u32( 0x7f800000 ) ) ) ), \
+	vdupq_n_f32( -1.0f ) ), vdupq_n_f32( 1.0f ) )
+#endif
+
+/** Convert float samples to signed 16-bit.
+ *
+ * Samples are clipped to -1.0 to 1.0, scaled by 32767 and truncated. NaN
+ * gives 0.
+ *
+ * \public \memberof mlt_audio_s
+ * \param dst the 16-bit samples
+ * \param src the float samples
+ * \param count the number of samples of all of the channels
+ */
+
+void mlt_audio_f32_to_s16( int16_t *dst, const float *src, int count )
+{
+	int i = 0;
+#if USE_SSE2
+	const __m128 lo = _mm_set1_ps( -1.0f ), hi = _mm_set1_ps( 1.0f ), scale = _mm_set1_ps( 32767.0f );
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m128 a = _mm_loadu_ps( src + i );
+		__m128 b = _mm_loadu_ps( src + i + 4 );
+		a = CLIP_SAMPLES( a );
+		b = CLIP_SAMPLES( b );
+		_mm_storeu_si128( (__m128i*) ( dst + i ), _mm_packs_epi32( _mm_cvttps_epi32( _mm_mul_ps( a, scale ) ),
+			_mm_cvttps_epi32( _mm_mul_ps( b, scale ) ) ) );
+	}
+#elif USE_NEON
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		float32x4_t a = vld1q_f32( src + i );
+		float32x4_t b = vld1q_f32( src + i + 4 );
+		a = CLIP_SAMPLES( a );
+		b = CLIP_SAMPLES( b );
+		vst1q_s16( dst + i, vcombine_s16( vqmovn_s32( vcvtq_s32_f32( vmulq_n_f32( a, 32767.0f ) ) ),
+			vqmovn_s32( vcvtq_s32_f32( vmulq_n_f32( b, 32767.0f ) ) ) ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+	{
+		float f = clip_sample( src[i] );
+		dst[i] = 32767 * f;
+	}
+}
+
+/** Convert signed 32-bit samples to float.
+ *
+ * \public \memberof mlt_audio_s
+ * \param dst the float samples
+ * \param src the 32-bit samples
+ * \param count the number of samples of all of the channels
+ */
+
+void mlt_audio_s32_to_f32( float *dst, const int32_t *src, int count )
+{
+	int i = 0;
+#if USE_SSE2
+	const __m128 scale = _mm_set1_ps( 1.0f / 2147483648.0f );
+	for ( ; i + 4 <= count; i += 4 )
+		_mm_storeu_ps( dst + i, _mm_mul_ps( _mm_cvtepi32_ps( _mm_loadu_si128( (const __m128i*) ( src + i ) ) ), scale ) );
+#elif USE_NEON
+	for ( ; i + 4 <= count; i += 4 )
+		vst1q_f32( dst + i, vmulq_n_f32( vcvtq_f32_s32( vld1q_s32( src + i ) ), 1.0f / 2147483648.0f ) );
+#endif
+	for ( ; i < count; i++ )
+		dst[i] = (float) src[i] / 2147483648.0f;
+}
+
+/** Convert float samples to signed 32-bit.
+ *
+ * Samples are clipped to -1.0 to 1.0 and scaled by 2^31, and 1.0 gives the
+ * largest 32-bit value. NaN gives 0.
+ *
+ * \public \memberof mlt_audio_s
+ * \param dst the 32-bit samples
+ * \param src the float samples
+ * \param count the number of samples of all of the channels
+ */
+
+void mlt_audio_f32_to_s32( int32_t *dst, const float *src, int count )
+{
+	int i = 0;
+#if USE_SSE2
+	const __m128 lo = _mm_set1_ps( -1.0f ), hi = _mm_set1_ps( 1.0f ), scale = _mm_set1_ps( 2147483648.0f );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128 v = _mm_loadu_ps( src + i );
+		v = _mm_mul_ps( CLIP_SAMPLES( v ), scale );
+		// 2^31 converts to 0x80000000, which the mask turns into 0x7fffffff
+		__m128i over = _mm_castps_si128( _mm_cmpge_ps( v, scale ) );
+		_mm_storeu_si128( (__m128i*) ( dst + i ), _mm_xor_si128( _mm_cvttps_epi32( v ), over ) );
+	}
+#elif USE_NEON
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		float32x4_t v = vld1q_f32( src + i );
+		v = CLIP_SAMPLES( v );
+		// The conversion saturates, so 2^31 gives 0x7fffffff
+		vst1q_s32( dst + i, vcvtq_s32_f32( vmulq_n_f32( v, 2147483648.0f ) ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+	{
+		float f = clip_sample( src[i] );
+		int64_t pcm = 2147483648.0f * f;
+		dst[i] = CLAMP( pcm, -2147483648LL, 2147483647LL );
+	}
+}
+
+#define INTERLEAVE_LOOP( type ) \
+	for ( c = 0; c < channels; c++ ) \
+	{ \
+		const type *q = (const type*) planes[c]; \
+		type *p = (type*) dst + c; \
+		for ( s = 0; s < samples; s++, p += channels ) \
+			*p = q[s]; \
+	}
+
+#define DEINTERLEAVE_LOOP( type ) \
+	for ( c = 0; c < channels; c++ ) \
+	{ \
+		const type *q = (const type*) src + c; \
+		type *p = (type*) planes[c]; \
+		for ( s = 0; s < samples; s++, q += channels ) \
+			p[s] = *q; \
+	}
+
+/** Interleave planes of audio.
+ *
+ * \public \memberof mlt_audio_s
+ * \param dst the interleaved samples
+ * \param planes a pointer to the samples of each channel
+ * \param sample_size the bytes of a sample: 1, 2, 4 or 8
+ * \param channels the number of channels
+ * \param samples the number of samples of each channel
+ */
+
+void mlt_audio_interleave( void *dst, const void *const *planes, int sample_size, int channels, int samples )
+{
+	const void *rest[2];
+	int c, s = 0;
+
+	if ( channels == 1 )
+	{
+		memcpy( dst, planes[0], (size_t) samples * sample_size );
+		return;
+	}
+#if USE_SSE2
+	if ( sample_size == 4 && channels == 2 )
+	{
+		const float *l = planes[0], *r = planes[1];
+		float *p = dst;
+		for ( ; s + 4 <= samples; s += 4 )
+		{
+			__m128 a = _mm_loadu_ps( l + s ), b = _mm_loadu_ps( r + s );
+			_mm_storeu_ps( p + s * 2, _mm_unpacklo_ps( a, b ) );
+			_mm_storeu_ps( p + s * 2 + 4, _mm_unpackhi_ps( a, b ) );
+		}
+	}
+	else if ( sample_size == 2 && channels == 2 )
+	{
+		const int16_t *l = planes[0], *r = planes[1];
+		int16_t *p = dst;
+		for ( ; s + 8 <= samples; s += 8 )
+		{
+			__m128i a = _mm_loadu_si128( (const __m128i*) ( l + s ) ), b = _mm_loadu_si128( (const __m128i*) ( r + s ) );
+			_mm_storeu_si128( (__m128i*) ( p + s * 2 ), _mm_unpacklo_epi16( a, b ) );
+			_mm_storeu_si128( (__m128i*) ( p + s * 2 + 8 ), _mm_unpackhi_epi16( a, b ) );
+		}
+	}
+#elif USE_NEON
+	if ( sample_size == 4 && channels == 2 )
+	{
+		for ( ; s + 4 <= samples; s += 4 )
+		{
+			float32x4x2_t v = { { vld1q_f32( (const float*) planes[0] + s ), vld1q_f32( (const float*) planes[1] + s ) } };
+			vst2q_f32( (float*) dst + s * 2, v );
+		}
+	}
+	else if ( sample_size == 2 && channels == 2 )
+	{
+		for ( ; s + 8 <= samples; s += 8 )
+		{
+			int16x8x2_t v = { { vld1q_s16( (const int16_t*) planes[0] + s ), vld1q_s16( (const int16_t*) planes[1] + s ) } };
+			vst2q_s16( (int16_t*) dst + s * 2, v );
+		}
+	}
+#endif
+	if ( s )
+	{
+		// Finish the samples after the vectors
+		rest[0] = (const uint8_t*) planes[0] + s * sample_size;
+		rest[1] = (const uint8_t*) planes[1] + s * sample_size;
+		dst = (uint8_t*) dst + s * 2 * sample_size;
+		planes = rest;
+		samples -= s;
+	}
+	switch ( sample_size )
+	{
+	case 1: INTERLEAVE_LOOP( uint8_t ); break;
+	case 2: INTERLEAVE_LOOP( uint16_t ); break;
+	case 4: INTERLEAVE_LOOP( uint32_t ); break;
+	case 8: INTERLEAVE_LOOP( uint64_t ); break;
+	}
+}
+
+/** Split interleaved audio into planes.
+ *
+ * \public \memberof mlt_audio_s
+ * \param planes a pointer to the samples of each channel
+ * \param src the interleaved samples
+ * \param sample_size the bytes of a sample: 1, 2, 4 or 8
+ * \param channels the number of channels
+ * \param samples the number of samples of each channel
+ */
+
+void mlt_audio_deinterleave( void *const *planes, const void *src, int sample_size, int channels, int samples )
+{
+	void *rest[2];
+	int c, s = 0;
+
+	if ( channels == 1 )
+	{
+		memcpy( planes[0], src, (size_t) samples * sample_size );
+		return;
+	}
+#if USE_SSE2
+	if ( sample_size == 4 && channels == 2 )
+	{
+		const float *q = src;
+		float *l = planes[0], *r = planes[1];
+		for ( ; s + 4 <= samples; s += 4 )
+		{
+			__m128 a = _mm_loadu_ps( q + s * 2 ), b = _mm_loadu_ps( q + s * 2 + 4 );
+			_mm_storeu_ps( l + s, _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+			_mm_storeu_ps( r + s, _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+		}
+	}
+	else if ( sample_size == 2 && channels == 2 )
+	{
+		const int16_t *q = src;
+		int16_t *l = planes[0], *r = planes[1];
+		for ( ; s + 8 <= samples; s += 8 )
+		{
+			__m128i a = _mm_loadu_si128( (const __m128i*) ( q + s * 2 ) ), b = _mm_loadu_si128( (const __m128i*) ( q + s * 2 + 8 ) );
+			// Sign extend the even samples and shift down the odd ones, then pack them
+			__m128i even = _mm_packs_epi32( _mm_srai_epi32( _mm_slli_epi32( a, 16 ), 16 ), _mm_srai_epi32( _mm_slli_epi32( b, 16 ), 16 ) );
+			__m128i odd = _mm_packs_epi32( _mm_srai_epi32( a, 16 ), _mm_srai_epi32( b, 16 ) );
+			_mm_storeu_si128( (__m128i*) ( l + s ), even );
+			_mm_storeu_si128( (__m128i*) ( r + s ), odd );
+		}
+	}
+#elif USE_NEON
+	if ( sample_size == 4 && channels == 2 )
+	{
+		for ( ; s + 4 <= samples; s += 4 )
+		{
+			float32x4x2_t v = vld2q_f32( (const float*) src + s * 2 );
+			vst1q_f32( (float*) planes[0] + s, v.val[0] );
+			vst1q_f32( (float*) planes[1] + s, v.val[1] );
+		}
+	}
+	else if ( sample_size == 2 && channels == 2 )
+	{
+		for ( ; s + 8 <= samples; s += 8 )
+		{
+			int16x8x2_t v = vld2q_s16( (const int16_t*) src + s * 2 );
+			vst1q_s16( (int16_t*) planes[0] + s, v.val[0] );
+			vst1q_s16( (int16_t*) planes[1] + s, v.val[1] );
+		}
+	}
+#endif
+	if ( s )
+	{
+		// Finish the samples after the vectors
+		rest[0] = (uint8_t*) planes[0] + s * sample_size;
+		rest[1] = (uint8_t*) planes[1] + s * sample_size;
+		src = (const uint8_t*) src + s * 2 * sample_size;
+		planes = rest;
+		samples -= s;
+	}
+	switch ( sample_size )
+	{
+	case 1: DEINTERLEAVE_LOOP( uint8_t ); break;
+	case 2: DEINTERLEAVE_LOOP( uint16_t ); break;
+	case 4: DEINTERLEAVE_LOOP( uint32_t ); break;
+	case 8: DEINTERLEAVE_LOOP( uint64_t ); break;
+	}
+}
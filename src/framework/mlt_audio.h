@@ -63,5 +63,11 @@ extern const char * mlt_audio_channel_layout_name( mlt_channel_layout layout );
 extern mlt_channel_layout mlt_audio_channel_layout_id( const char * name );
 extern int mlt_audio_channel_layout_channels( mlt_channel_layout layout );
 extern mlt_channel_layout mlt_audio_channel_layout_default( int channels );
+extern void mlt_audio_s16_to_f32( float *dst, const int16_t *src, int count );
+extern void mlt_audio_f32_to_s16( int16_t *dst, const float *src, int count );
+extern void mlt_audio_s32_to_f32( float *dst, const int32_t *src, int count );
+extern void mlt_audio_f32_to_s32( int32_t *dst, const float *src, int count );
+extern void mlt_audio_interleave( void *dst, const void *const *planes, int sample_size, int channels, int samples );
+extern void mlt_audio_deinterleave( void *const *planes, const void *src, int sample_size, int channels, int samples );
 
 #endif
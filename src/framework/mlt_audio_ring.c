@@ -0,0 +1,350 @@
+/**
+ * \file mlt_audio_ring.c
+ * \brief single producer, single consumer ring of audio samples
+ * \see mlt_audio_ring_s
+ *
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Local header files
+#include "mlt_audio_ring.h"
+
+// System header files
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <stdatomic.h>
+
+/** the number of times to check before a waiting writer sleeps */
+#define SPIN_COUNT 200
+
+/** the longest time in microseconds a waiting writer sleeps before it checks again */
+#define WAIT_SLICE 1000
+
+/** \brief Audio Ring class
+ *
+ * A bounded first-in first-out buffer of samples for handing audio from one
+ * writing thread to one reading thread, normally a device callback. A sample
+ * is a fixed number of bytes, such as one value for every channel of
+ * interleaved audio. The reader never blocks or waits for a lock, so it is
+ * safe to use in a real-time callback however long the writer holds on to
+ * the CPU. The writer can wait for space: it spins briefly and then sleeps
+ * in short slices, and the reader only signals it when the writer is
+ * sleeping and the mutex happens to be free.
+ */
+
+struct mlt_audio_ring_s
+{
+	uint8_t *buffer;
+	size_t size;            /**< the capacity in samples */
+	int sample_size;        /**< the number of bytes per sample */
+	atomic_size_t head;     /**< the number of samples read, only changed by the reader */
+	atomic_size_t tail;     /**< the number of samples written, only changed by the writer */
+	atomic_size_t discard;  /**< one more than the position before which a clear discards samples, or 0 */
+	atomic_int waiting;     /**< non-zero while the writer sleeps on \p cond */
+	atomic_int interrupted; /**< makes a blocked or blocking wait return */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+/** Create an audio ring.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param samples the number of samples the ring holds
+ * \param sample_size the number of bytes in a sample, such as channels times the size of a value
+ * \return a new ring or NULL on error
+ */
+
+mlt_audio_ring mlt_audio_ring_init( int samples, int sample_size )
+{
+	mlt_audio_ring self = NULL;
+
+	if ( samples <= 0 || sample_size <= 0 )
+		return NULL;
+	self = calloc( 1, sizeof( struct mlt_audio_ring_s ) );
+	if ( self )
+	{
+		self->buffer = calloc( samples, sample_size );
+		if ( !self->buffer )
+		{
+			free( self );
+			return NULL;
+		}
+		self->size = samples;
+		self->sample_size = sample_size;
+		pthread_mutex_init( &self->mutex, NULL );
+		pthread_cond_init( &self->cond, NULL );
+	}
+	return self;
+}
+
+/** Get the number of samples the ring can hold.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \return the capacity in samples
+ */
+
+int mlt_audio_ring_capacity( mlt_audio_ring self )
+{
+	return self ? self->size : 0;
+}
+
+/** Get the number of samples that can be read.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \return the number of samples, only a snapshot while the other thread uses the ring
+ */
+
+int mlt_audio_ring_available( mlt_audio_ring self )
+{
+	size_t head, tail;
+
+	if ( !self )
+		return 0;
+	// Load the head first so that the difference can not be negative.
+	head = atomic_load_explicit( &self->head, memory_order_acquire );
+	tail = atomic_load_explicit( &self->tail, memory_order_acquire );
+	return tail - head;
+}
+
+/** Get the number of samples that can be written.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \return the number of samples, only a snapshot while the other thread uses the ring
+ */
+
+int mlt_audio_ring_space( mlt_audio_ring self )
+{
+	return self ? mlt_audio_ring_capacity( self ) - mlt_audio_ring_available( self ) : 0;
+}
+
+/** Copy samples into or out of the buffer, wrapping around its end.
+ *
+ * \private \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \param position the position in the stream of the first sample
+ * \param data the samples to write, or NULL to write silence, or the buffer to read into
+ * \param samples the number of samples
+ * \param write true to copy into the ring
+ */
+
+static void ring_copy( mlt_audio_ring self, size_t position, void *data, int samples, int write )
+{
+	size_t start = position % self->size;
+	size_t first = MIN( ( size_t )samples, self->size - start );
+	size_t bytes = first * self->sample_size;
+	size_t rest = ( samples - first ) * self->sample_size;
+	uint8_t *p = self->buffer + start * self->sample_size;
+
+	if ( !write )
+	{
+		memcpy( data, p, bytes );
+		memcpy( ( uint8_t* )data + bytes, self->buffer, rest );
+	}
+	else if ( data )
+	{
+		memcpy( p, data, bytes );
+		memcpy( self->buffer, ( const uint8_t* )data + bytes, rest );
+	}
+	else
+	{
+		memset( p, 0, bytes );
+		memset( self->buffer, 0, rest );
+	}
+}
+
+/** Add samples to the end of the ring without waiting.
+ *
+ * Only one thread may write to a ring.
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \param data the samples, or NULL to add silence
+ * \param samples the number of samples
+ * \return the number of samples written, which is less than \p samples when the ring fills
+ */
+
+int mlt_audio_ring_write( mlt_audio_ring self, const void *data, int samples )
+{
+	size_t tail = atomic_load_explicit( &self->tail, memory_order_relaxed );
+	size_t head = atomic_load_explicit( &self->head, memory_order_acquire );
+	int space = self->size - ( tail - head );
+
+	if ( samples > space )
+		samples = space;
+	if ( samples > 0 )
+	{
+		ring_copy( self, tail, ( void* )data, samples, 1 );
+		atomic_store_explicit( &self->tail, tail + samples, memory_order_release );
+	}
+	return MAX( samples, 0 );
+}
+
+/** Remove samples from the front of the ring without waiting.
+ *
+ * Only one thread may read from a ring. This never waits for a lock, so it
+ * may be called from a real-time audio callback. When there are not enough
+ * samples, the rest of \p data is filled with silence.
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \param data a buffer for \p samples samples
+ * \param samples the number of samples
+ * \return the number of samples read
+ */
+
+int mlt_audio_ring_read( mlt_audio_ring self, void *data, int samples )
+{
+	size_t head = atomic_load_explicit( &self->head, memory_order_relaxed );
+	size_t tail = atomic_load_explicit( &self->tail, memory_order_acquire );
+	size_t discard = atomic_exchange_explicit( &self->discard, 0, memory_order_acquire );
+	int count;
+
+	if ( discard && discard - 1 - head <= tail - head )
+		head = discard - 1;
+	count = MIN( samples, ( int )( tail - head ) );
+	if ( count > 0 )
+		ring_copy( self, head, data, count, 0 );
+	else
+		count = 0;
+	if ( count < samples )
+		memset( ( uint8_t* )data + count * self->sample_size, 0, ( samples - count ) * self->sample_size );
+	atomic_store_explicit( &self->head, head + count, memory_order_release );
+
+	if ( atomic_load( &self->waiting ) && !pthread_mutex_trylock( &self->mutex ) )
+	{
+		pthread_cond_signal( &self->cond );
+		pthread_mutex_unlock( &self->mutex );
+	}
+	return count;
+}
+
+/** Wait until some number of samples can be written.
+ *
+ * Only the writer may wait.
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \param samples the number of samples, clamped to the capacity
+ * \param timeout the longest time to wait in microseconds, or a negative value to wait without a limit
+ * \return true if the wait was interrupted by mlt_audio_ring_interrupt() or timed out
+ */
+
+int mlt_audio_ring_wait_for_space( mlt_audio_ring self, int samples, int timeout )
+{
+	struct timespec now, deadline, slice;
+	int i;
+
+	samples = CLAMP( samples, 1, mlt_audio_ring_capacity( self ) );
+
+#define RING_READY() ( atomic_load( &self->interrupted ) || mlt_audio_ring_space( self ) >= samples )
+
+	for ( i = 0; i < SPIN_COUNT; i++ )
+	{
+		if ( RING_READY() )
+			return atomic_load( &self->interrupted );
+		sched_yield();
+	}
+
+	clock_gettime( CLOCK_REALTIME, &deadline );
+	deadline.tv_sec += timeout / 1000000;
+	deadline.tv_nsec += ( timeout % 1000000 ) * 1000;
+	if ( deadline.tv_nsec >= 1000000000 )
+	{
+		deadline.tv_sec += 1;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock( &self->mutex );
+	atomic_store( &self->waiting, 1 );
+	while ( !RING_READY() )
+	{
+		clock_gettime( CLOCK_REALTIME, &now );
+		if ( timeout >= 0 && ( now.tv_sec > deadline.tv_sec ||
+			( now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec ) ) )
+			break;
+
+		// The reader does not wait for the mutex to signal, so do not sleep for long.
+		slice = now;
+		slice.tv_nsec += WAIT_SLICE * 1000;
+		if ( slice.tv_nsec >= 1000000000 )
+		{
+			slice.tv_sec += 1;
+			slice.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait( &self->cond, &self->mutex, &slice );
+	}
+	atomic_store( &self->waiting, 0 );
+	pthread_mutex_unlock( &self->mutex );
+
+	i = !RING_READY() || atomic_load( &self->interrupted );
+
+#undef RING_READY
+
+	return i;
+}
+
+/** Discard the samples in the ring.
+ *
+ * This may be called from any thread. The reader drops the samples that
+ * were written before the call when it next reads, so the space they take
+ * is only available to the writer after that.
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ */
+
+void mlt_audio_ring_clear( mlt_audio_ring self )
+{
+	if ( self )
+		atomic_store_explicit( &self->discard,
+			atomic_load_explicit( &self->tail, memory_order_acquire ) + 1, memory_order_release );
+}
+
+/** Make a waiting writer return immediately or wait again.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \param interrupted true to wake the writer and stop waiting
+ */
+
+void mlt_audio_ring_interrupt( mlt_audio_ring self, int interrupted )
+{
+	atomic_store( &self->interrupted, interrupted );
+	pthread_mutex_lock( &self->mutex );
+	pthread_cond_broadcast( &self->cond );
+	pthread_mutex_unlock( &self->mutex );
+}
+
+/** Destroy an audio ring.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ */
+
+void mlt_audio_ring_close( mlt_audio_ring self )
+{
+	if ( self )
+	{
+		pthread_cond_destroy( &self->cond );
+		pthread_mutex_destroy( &self->mutex );
+		free( self->buffer );
+		free( self );
+	}
+}
@@ -0,0 +1,39 @@
+/**
+ * \file mlt_audio_ring.h
+ * \brief single producer, single consumer ring of audio samples
+ * \see mlt_audio_ring_s
+ *
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MLT_AUDIO_RING_H
+#define MLT_AUDIO_RING_H
+
+#include "mlt_types.h"
+
+extern mlt_audio_ring mlt_audio_ring_init( int samples, int sample_size );
+extern int mlt_audio_ring_capacity( mlt_audio_ring self );
+extern int mlt_audio_ring_available( mlt_audio_ring self );
+extern int mlt_audio_ring_space( mlt_audio_ring self );
+extern int mlt_audio_ring_write( mlt_audio_ring self, const void *data, int samples );
+extern int mlt_audio_ring_read( mlt_audio_ring self, void *data, int samples );
+extern int mlt_audio_ring_wait_for_space( mlt_audio_ring self, int samples, int timeout );
+extern void mlt_audio_ring_clear( mlt_audio_ring self );
+extern void mlt_audio_ring_interrupt( mlt_audio_ring self, int interrupted );
+extern void mlt_audio_ring_close( mlt_audio_ring self );
+
+#endif
@@ -27,14 +27,16 @@
 #include "mlt_frame.h"
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <pthread.h>
-
-/** the maximum number of data objects to cache per line */
-#define MAX_CACHE_SIZE (200)
+#include <stdatomic.h>
 
 /** the default number of data objects to cache per line */
 #define DEFAULT_CACHE_SIZE (4)
 
+/** the initial number of buckets in the index of a cache */
+#define INITIAL_BUCKETS (16)
+
 /** \brief Cache item class
  *
  * A cache item is a structure holding information about a data object including
@@ -56,13 +58,28 @@ typedef struct mlt_cache_item_s
 	mlt_destructor destructor; /**< a function to release or destroy the cached data */
 } mlt_cache_item_s;
 
+/** \brief private to mlt_cache_s, an entry in the recently used list
+ */
+
+typedef struct cache_entry_s
+{
+	uintptr_t key;               /**< the owner's address or the frame position */
+	void *object;                /**< the owner or, for a frame cache, the cached frame */
+	int64_t size;                /**< the number of bytes charged to the cache */
+	uint64_t stamp;              /**< when the entry was last used, for eviction across caches */
+	struct cache_entry_s *prev;  /**< the next less recently used entry */
+	struct cache_entry_s *next;  /**< the next more recently used entry */
+	struct cache_entry_s *chain; /**< the next entry in the same bucket */
+} cache_entry;
+
 /** \brief Cache class
  *
  * This is a utility class for implementing a Least Recently Used (LRU) cache
  * of data blobs indexed by the address of some other object (e.g., a service).
- * Instead of sorting and manipulating linked lists, it tries to be simple and
- * elegant by copying pointers between two arrays of fixed size to shuffle the
- * order of elements.
+ * The entries are kept in a doubly linked list from least to most recently
+ * used with a hash table over it, so getting, putting, and evicting an entry
+ * does not depend on the number of entries. The cache can be limited by the
+ * number of entries, by the number of bytes they hold, or both.
  *
  * This class is useful if you have a service that wants to cache something
  * somewhat large, but will not scale if there are many instances of the service.
@@ -81,20 +98,65 @@ typedef struct mlt_cache_item_s
 struct mlt_cache_s
 {
 	int count;             /**< the number of items currently in the cache */
-	int size;              /**< the maximum number of items permitted in the cache <= \p MAX_CACHE_SIZE */
+	int size;              /**< the maximum number of items permitted in the cache */
+	int64_t bytes;         /**< the number of bytes held by the items in the cache */
+	int64_t max_bytes;     /**< the maximum number of bytes permitted in the cache or 0 for no limit */
 	int is_frames;         /**< indicates if this cache is used to cache frames */
-	void* *current;        /**< pointer to the current array of pointers */
-	void* A[ MAX_CACHE_SIZE ];
-	void* B[ MAX_CACHE_SIZE ];
+	cache_entry *lru;      /**< the least recently used entry */
+	cache_entry *mru;      /**< the most recently used entry */
+	cache_entry **buckets; /**< the hash index of the entries */
+	int bucket_count;      /**< the number of buckets, a power of two */
 	pthread_mutex_t mutex; /**< a mutex to prevent multi-threaded race conditions */
 	mlt_properties active; /**< a list of cache items some of which may no longer
-	                            be in \p current but to which there are
+	                            be in the cache but to which there are
 	                            outstanding references */
 	mlt_properties garbage;/**< a list cache items pending release. A cache item
 	                            is copied to this list when it is updated but there
 	                            are outstanding references to the old data object. */
+	mlt_cache prev_cache;  /**< the previous cache known to the governor */
+	mlt_cache next_cache;  /**< the next cache known to the governor */
 };
 
+/** \brief Cache memory governor
+ *
+ * Every cache registers with a process-wide governor that tracks the bytes
+ * held by all caches. When they exceed the global budget, the least recently
+ * used entries across all caches are released.
+ */
+
+static pthread_once_t governor_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t governor_mutex;
+static mlt_cache governor_caches = NULL;
+static int governor_trimming = 0;
+static atomic_llong governor_bytes = 0;
+static atomic_llong governor_budget = 0;
+static atomic_ullong governor_clock = 0;
+
+/** Initialise the governor and read its budget from the environment.
+ *
+ * \private \memberof mlt_cache_s
+ */
+
+static void governor_init( )
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init( &attr );
+	pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+	pthread_mutex_init( &governor_mutex, &attr );
+	pthread_mutexattr_destroy( &attr );
+
+	char *budget = getenv( "MLT_CACHE_BUDGET" );
+	if ( budget )
+	{
+		char *end = NULL;
+		long long bytes = strtoll( budget, &end, 10 );
+		if ( end && ( *end == 'k' || *end == 'K' ) ) bytes <<= 10;
+		else if ( end && ( *end == 'm' || *end == 'M' ) ) bytes <<= 20;
+		else if ( end && ( *end == 'g' || *end == 'G' ) ) bytes <<= 30;
+		atomic_store( &governor_budget, bytes > 0 ? bytes : 0 );
+	}
+}
+
 /** Get the data pointer from the cache item.
  *
  * \public \memberof mlt_cache_s
@@ -187,6 +249,301 @@ void mlt_cache_item_close( mlt_cache_item item )
 	}
 }
 
+
+/** Get the bucket of a key.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param key an owner's address or a frame position
+ * \return the index of the bucket
+ */
+
+static inline int cache_bucket( mlt_cache cache, uintptr_t key )
+{
+	uint64_t hash = ( uint64_t )key * 0x9E3779B97F4A7C15ULL;
+	return ( int )( hash >> 32 ) & ( cache->bucket_count - 1 );
+}
+
+/** Change the number of bytes held by a cache.
+ *
+ * The cache must be locked.
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param bytes the number of bytes added, negative if removed
+ */
+
+static inline void cache_account( mlt_cache cache, int64_t bytes )
+{
+	cache->bytes += bytes;
+	atomic_fetch_add( &governor_bytes, bytes );
+}
+
+/** Find the entry for a key.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param key an owner's address or a frame position
+ * \return the entry or NULL if it is not in the cache
+ */
+
+static cache_entry *cache_find( mlt_cache cache, uintptr_t key )
+{
+	cache_entry *entry = cache->buckets ? cache->buckets[ cache_bucket( cache, key ) ] : NULL;
+	while ( entry && entry->key != key )
+		entry = entry->chain;
+	return entry;
+}
+
+/** Double the number of buckets in the index of a cache.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ */
+
+static void cache_grow( mlt_cache cache )
+{
+	int count = cache->bucket_count ? cache->bucket_count * 2 : INITIAL_BUCKETS;
+	cache_entry **buckets = calloc( count, sizeof( cache_entry* ) );
+	if ( buckets )
+	{
+		cache_entry *entry;
+		free( cache->buckets );
+		cache->buckets = buckets;
+		cache->bucket_count = count;
+		for ( entry = cache->lru; entry; entry = entry->next )
+		{
+			int i = cache_bucket( cache, entry->key );
+			entry->chain = buckets[ i ];
+			buckets[ i ] = entry;
+		}
+	}
+}
+
+/** Move an entry to the most recently used end of the list.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param entry an entry in the cache
+ */
+
+static void cache_touch( mlt_cache cache, cache_entry *entry )
+{
+	entry->stamp = atomic_fetch_add( &governor_clock, 1 );
+	if ( entry == cache->mru )
+		return;
+	if ( entry->prev )
+		entry->prev->next = entry->next;
+	else
+		cache->lru = entry->next;
+	entry->next->prev = entry->prev;
+	entry->prev = cache->mru;
+	entry->next = NULL;
+	cache->mru->next = entry;
+	cache->mru = entry;
+}
+
+/** Add an entry as the most recently used.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param key an owner's address or a frame position
+ * \param object the owner or the cached frame
+ * \param size the number of bytes to charge to the cache
+ * \return the new entry or NULL if out of memory
+ */
+
+static cache_entry *cache_insert( mlt_cache cache, uintptr_t key, void *object, int64_t size )
+{
+	cache_entry *entry = calloc( 1, sizeof( cache_entry ) );
+	if ( entry )
+	{
+		if ( cache->count >= cache->bucket_count )
+			cache_grow( cache );
+		if ( !cache->buckets )
+		{
+			free( entry );
+			return NULL;
+		}
+		entry->key = key;
+		entry->object = object;
+		entry->size = size;
+		entry->stamp = atomic_fetch_add( &governor_clock, 1 );
+		entry->prev = cache->mru;
+		if ( cache->mru )
+			cache->mru->next = entry;
+		else
+			cache->lru = entry;
+		cache->mru = entry;
+		int i = cache_bucket( cache, key );
+		entry->chain = cache->buckets[ i ];
+		cache->buckets[ i ] = entry;
+		cache->count++;
+		cache_account( cache, size );
+	}
+	return entry;
+}
+
+/** Remove an entry without closing its object.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param entry an entry in the cache
+ */
+
+static void cache_remove( mlt_cache cache, cache_entry *entry )
+{
+	cache_entry **link = &cache->buckets[ cache_bucket( cache, entry->key ) ];
+	while ( *link != entry )
+		link = &( *link )->chain;
+	*link = entry->chain;
+	if ( entry->prev )
+		entry->prev->next = entry->next;
+	else
+		cache->lru = entry->next;
+	if ( entry->next )
+		entry->next->prev = entry->prev;
+	else
+		cache->mru = entry->prev;
+	cache->count--;
+	cache_account( cache, -entry->size );
+	free( entry );
+}
+
+/** Release the least recently used entries until the cache is within its limits.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param keep an entry to keep even if it alone exceeds the limits (optional)
+ */
+
+static void cache_evict( mlt_cache cache, cache_entry *keep )
+{
+	while ( cache->lru && cache->lru != keep &&
+		( cache->count > cache->size || ( cache->max_bytes > 0 && cache->bytes > cache->max_bytes ) ) )
+	{
+		cache_entry *entry = cache->lru;
+		mlt_log( NULL, MLT_LOG_DEBUG, "%s: evict %p\n", __FUNCTION__, entry->object );
+		cache_object_close( cache, entry->object, NULL );
+		cache_remove( cache, entry );
+	}
+}
+
+/** Release the least recently used entries of all caches until they are within the global budget.
+ *
+ * Entries used after the trim started are kept. Caches that are busy in other
+ * threads are skipped rather than waited on to avoid a lock order inversion.
+ * \private \memberof mlt_cache_s
+ */
+
+static void governor_trim_to( long long budget )
+{
+	pthread_mutex_lock( &governor_mutex );
+	if ( !governor_trimming )
+	{
+		uint64_t start = atomic_load( &governor_clock );
+		governor_trimming = 1;
+		while ( atomic_load( &governor_bytes ) > budget )
+		{
+			mlt_cache victim = NULL;
+			uint64_t oldest = start;
+			mlt_cache cache;
+
+			// Find the cache with the least recently used entry
+			for ( cache = governor_caches; cache; cache = cache->next_cache )
+			{
+				if ( pthread_mutex_trylock( &cache->mutex ) == 0 )
+				{
+					if ( cache->lru && cache->lru->stamp < oldest )
+					{
+						oldest = cache->lru->stamp;
+						victim = cache;
+					}
+					pthread_mutex_unlock( &cache->mutex );
+				}
+			}
+			if ( !victim || pthread_mutex_trylock( &victim->mutex ) )
+				break;
+			if ( victim->lru && victim->lru->stamp < start )
+			{
+				cache_entry *entry = victim->lru;
+				mlt_log( NULL, MLT_LOG_DEBUG, "%s: evict %p from %p\n", __FUNCTION__, entry->object, victim );
+				cache_object_close( victim, entry->object, NULL );
+				cache_remove( victim, entry );
+			}
+			pthread_mutex_unlock( &victim->mutex );
+		}
+		governor_trimming = 0;
+	}
+	pthread_mutex_unlock( &governor_mutex );
+}
+
+/** Release the least recently used entries of all caches when they exceed the global budget.
+ *
+ * \private \memberof mlt_cache_s
+ */
+
+static void governor_trim( )
+{
+	long long budget = atomic_load( &governor_budget );
+	if ( budget > 0 && atomic_load( &governor_bytes ) > budget )
+		governor_trim_to( budget );
+}
+
+/** Set the maximum number of bytes held by all caches together.
+ *
+ * When exceeded, the least recently used entries across all caches are
+ * released. The initial value comes from the environment variable
+ * MLT_CACHE_BUDGET, which accepts a K, M, or G suffix. Only the sizes given
+ * to mlt_cache_put() and the images and audio of cached frames are counted.
+ * \public \memberof mlt_cache_s
+ * \param bytes the budget in bytes or 0 for unlimited
+ */
+
+void mlt_cache_set_budget( int64_t bytes )
+{
+	pthread_once( &governor_once, governor_init );
+	atomic_store( &governor_budget, bytes > 0 ? bytes : 0 );
+	governor_trim( );
+}
+
+/** Get the maximum number of bytes held by all caches together.
+ *
+ * \public \memberof mlt_cache_s
+ * \return the budget in bytes or 0 for unlimited
+ */
+
+int64_t mlt_cache_get_budget( )
+{
+	pthread_once( &governor_once, governor_init );
+	return atomic_load( &governor_budget );
+}
+
+/** Release the least recently used entries of all caches down to a number of bytes.
+ *
+ * This is a one time trim, for example under memory pressure, that does not
+ * change the budget.
+ * \public \memberof mlt_cache_s
+ * \param bytes the number of bytes to keep at most
+ */
+
+void mlt_cache_trim( int64_t bytes )
+{
+	pthread_once( &governor_once, governor_init );
+	if ( atomic_load( &governor_bytes ) > bytes )
+		governor_trim_to( bytes > 0 ? bytes : 0 );
+}
+
+/** Get the number of bytes held by all caches together.
+ *
+ * \public \memberof mlt_cache_s
+ * \return the number of bytes
+ */
+
+int64_t mlt_cache_get_total_bytes( )
+{
+	return atomic_load( &governor_bytes );
+}
+
 /** Create a new cache.
  *
  * The default size is \p DEFAULT_CACHE_SIZE.
@@ -200,18 +557,25 @@ mlt_cache mlt_cache_init()
 	if ( result )
 	{
 		result->size = DEFAULT_CACHE_SIZE;
-		result->current = result->A;
 		pthread_mutex_init( &result->mutex, NULL );
 		result->active = mlt_properties_new();
 		result->garbage = mlt_properties_new();
+
+		// Register with the governor
+		pthread_once( &governor_once, governor_init );
+		pthread_mutex_lock( &governor_mutex );
+		result->next_cache = governor_caches;
+		if ( governor_caches )
+			governor_caches->prev_cache = result;
+		governor_caches = result;
+		pthread_mutex_unlock( &governor_mutex );
 	}
 	return result;
 }
 
 /** Set the number of items to cache.
  *
- * This must be called before using the cache. The size can not be more
- * than \p MAX_CACHE_SIZE.
+ * If the cache holds more items, the least recently used ones are released.
  * \public \memberof mlt_cache_s
  * \param cache the cache to adjust
  * \param size the new size of the cache
@@ -219,8 +583,13 @@ mlt_cache mlt_cache_init()
 
 void mlt_cache_set_size( mlt_cache cache, int size )
 {
-	if ( size <= MAX_CACHE_SIZE )
+	if ( size >= 0 )
+	{
+		pthread_mutex_lock( &cache->mutex );
 		cache->size = size;
+		cache_evict( cache, NULL );
+		pthread_mutex_unlock( &cache->mutex );
+	}
 }
 
 /** Get the number of possible cache items.
@@ -235,6 +604,37 @@ int mlt_cache_get_size( mlt_cache cache )
     return cache->size;
 }
 
+/** Set the maximum number of bytes to cache.
+ *
+ * The bytes are those given to mlt_cache_put() or, for a frame cache, the
+ * size of the images and audio of the frames. When the limit is exceeded,
+ * the least recently used items are released, but the most recently put
+ * item is always kept. The limit on the number of items still applies.
+ * \public \memberof mlt_cache_s
+ * \param cache the cache to adjust
+ * \param bytes the maximum number of bytes or 0 for no limit
+ */
+
+void mlt_cache_set_max_bytes( mlt_cache cache, int64_t bytes )
+{
+	pthread_mutex_lock( &cache->mutex );
+	cache->max_bytes = bytes > 0 ? bytes : 0;
+	cache_evict( cache, cache->mru );
+	pthread_mutex_unlock( &cache->mutex );
+}
+
+/** Get the maximum number of bytes to cache.
+ *
+ * \public \memberof mlt_cache_s
+ * \param cache the cache to check
+ * \return the maximum number of bytes or 0 for no limit
+ */
+
+int64_t mlt_cache_get_max_bytes( mlt_cache cache )
+{
+	return cache->max_bytes;
+}
+
 /** Destroy a cache.
  *
  * \public \memberof mlt_cache_s
@@ -245,12 +645,24 @@ void mlt_cache_close( mlt_cache cache )
 {
 	if ( cache )
 	{
-		while ( cache->count-- )
+		// Unregister from the governor
+		pthread_mutex_lock( &governor_mutex );
+		if ( cache->prev_cache )
+			cache->prev_cache->next_cache = cache->next_cache;
+		else
+			governor_caches = cache->next_cache;
+		if ( cache->next_cache )
+			cache->next_cache->prev_cache = cache->prev_cache;
+		pthread_mutex_unlock( &governor_mutex );
+
+		while ( cache->mru )
 		{
-			void *object = cache->current[ cache->count ];
-			mlt_log( NULL, MLT_LOG_DEBUG, "%s: %d = %p\n", __FUNCTION__, cache->count, object );
-			cache_object_close( cache, object, NULL );
+			cache_entry *entry = cache->mru;
+			mlt_log( NULL, MLT_LOG_DEBUG, "%s: %d = %p\n", __FUNCTION__, cache->count - 1, entry->object );
+			cache_object_close( cache, entry->object, NULL );
+			cache_remove( cache, entry );
 		}
+		free( cache->buckets );
 		mlt_properties_close( cache->active );
 		mlt_properties_close( cache->garbage );
 		pthread_mutex_destroy( &cache->mutex );
@@ -269,87 +681,22 @@ void mlt_cache_purge( mlt_cache cache, void *object )
 {
 	if (!cache) return;
 	pthread_mutex_lock( &cache->mutex );
-	if ( cache && object )
+	if ( object && !cache->is_frames )
 	{
-		int i, j;
-		void **alt = cache->current == cache->A ? cache->B : cache->A;
-
-		for ( i = 0, j = 0; i < cache->count; i++ )
+		cache_entry *entry = cache_find( cache, ( uintptr_t )object );
+		if ( entry )
 		{
-			void *o = cache->current[ i ];
-
-			if ( o == object )
-			{
-				cache_object_close( cache, o, NULL );
-			}
-			else
-			{
-				alt[ j++ ] = o;
-			}
+			cache_object_close( cache, object, NULL );
+			cache_remove( cache, entry );
 		}
-		cache->count = j;
-		cache->current = alt;
 	}
 	pthread_mutex_unlock( &cache->mutex );
 }
 
-/** Shuffle the cache entries between the two arrays and return the cache entry for an object.
- *
- * \private \memberof mlt_cache_s
- * \param cache a cache object
- * \param object the object that owns the cached data
- * \return a cache entry if there was a hit or NULL for a miss
- */
-
-static void** shuffle_get_hit( mlt_cache cache, void *object )
-{
-	int i = cache->count;
-	int j = cache->count - 1;
-	void **hit = NULL;
-	void **alt = cache->current == cache->A ? cache->B : cache->A;
-
-	if ( cache->count > 0 && cache->count < cache->size )
-	{
-		// first determine if we have a hit
-		while ( i-- && !hit )
-		{
-			void **o = &cache->current[ i ];
-			if ( *o == object )
-				hit = o;
-		}
-		// if there was no hit, we will not be shuffling out an entry
-		// and are still filling the cache
-		if ( !hit )
-			++j;
-		// reset these
-		i = cache->count;
-		hit = NULL;
-	}
-
-	// shuffle the existing entries to the alternate array
-	while ( i-- )
-	{
-		void **o = &cache->current[ i ];
-
-		if ( !hit && *o == object )
-		{
-			hit = o;
-		}
-		else if ( j > 0 )
-		{
-			alt[ --j ] = *o;
-// 			mlt_log( NULL, MLT_LOG_DEBUG, "%s: shuffle %d = %p\n", __FUNCTION__, j, alt[j] );
-		}
-	}
-	return hit;
-}
-
 /** Put a chunk of data in the cache.
  *
- * This function and mlt_cache_get() are not scalable with a large volume
- * of unique \p object parameter values. Therefore, it does not make sense
- * to use it for a frame/image cache using the frame position for \p object.
- * Instead, use mlt_cache_put_frame() for that.
+ * This function and mlt_cache_get() are not meant for a frame/image cache
+ * using the frame position for \p object. Use mlt_cache_put_frame() for that.
  *
  * \public \memberof mlt_cache_s
  * \param cache a cache object
@@ -362,31 +709,24 @@ static void** shuffle_get_hit( mlt_cache cache, void *object )
 void mlt_cache_put( mlt_cache cache, void *object, void* data, int size, mlt_destructor destructor )
 {
 	pthread_mutex_lock( &cache->mutex );
-	void **hit = shuffle_get_hit( cache, object );
-	void **alt = cache->current == cache->A ? cache->B : cache->A;
+	cache_entry *entry = cache_find( cache, ( uintptr_t )object );
 
 	// add the object to the cache
-	if ( hit )
+	if ( entry )
 	{
 		// release the old data
-		cache_object_close( cache, *hit, NULL );
+		cache_object_close( cache, object, NULL );
 		// the MRU end gets the updated data
-		hit = &alt[ cache->count - 1 ];
-	}
-	else if ( cache->count < cache->size )
-	{
-		// more room in cache, add it to MRU end
-		hit = &alt[ cache->count++ ];
+		cache_account( cache, size - entry->size );
+		entry->size = size;
+		cache_touch( cache, entry );
 	}
 	else
 	{
-		// release the entry at the LRU end
-		cache_object_close( cache, cache->current[0], NULL );
-
-		// The MRU end gets the new item
-		hit = &alt[ cache->count - 1 ];
+		entry = cache_insert( cache, ( uintptr_t )object, object, size );
 	}
-	*hit = object;
+	// release entries at the LRU end
+	cache_evict( cache, entry );
 	mlt_log( NULL, MLT_LOG_DEBUG, "%s: put %d = %p, %p\n", __FUNCTION__, cache->count - 1, object, data );
 
 	// Fetch the cache item
@@ -424,10 +764,9 @@ void mlt_cache_put( mlt_cache cache, void *object, void* data, int size, mlt_des
 		item->destructor = destructor;
 		item->refcount = 1;
 	}
-	
-	// swap the current array
-	cache->current = alt;
+
 	pthread_mutex_unlock( &cache->mutex );
+	governor_trim( );
 }
 
 /** Get a chunk of data from the cache.
@@ -442,81 +781,49 @@ mlt_cache_item mlt_cache_get( mlt_cache cache, void *object )
 {
 	mlt_cache_item result = NULL;
 	pthread_mutex_lock( &cache->mutex );
-	void **hit = shuffle_get_hit( cache, object );
-	void **alt = cache->current == cache->A ? cache->B : cache->A;
+	cache_entry *entry = cache_find( cache, ( uintptr_t )object );
 
-	if ( hit )
+	if ( entry )
 	{
-		// copy the hit to the MRU end
-		alt[ cache->count - 1 ] = *hit;
-		hit = &alt[ cache->count - 1 ];
+		// move the hit to the MRU end
+		cache_touch( cache, entry );
 
 		char key[19];
-		sprintf( key, "%p", *hit );
+		sprintf( key, "%p", object );
 		result = mlt_properties_get_data( cache->active, key, NULL );
 		if ( result && result->data )
 		{
 			result->refcount++;
-			mlt_log( NULL, MLT_LOG_DEBUG, "%s: get %d = %p, %p\n", __FUNCTION__, cache->count - 1, *hit, result->data );
+			mlt_log( NULL, MLT_LOG_DEBUG, "%s: get %d = %p, %p\n", __FUNCTION__, cache->count - 1, object, result->data );
 		}
-
-		// swap the current array
-		cache->current = alt;
 	}
 	pthread_mutex_unlock( &cache->mutex );
-	
+
 	return result;
 }
 
-/** Shuffle the cache entries between the two arrays and return the frame for a position.
+/** Get the number of bytes a frame holds in images and audio.
  *
  * \private \memberof mlt_cache_s
- * \param cache a cache object
- * \param position the position of the frame that you want
- * \return a frame if there was a hit or NULL for a miss
+ * \param frame a frame
+ * \return the number of bytes
  */
 
-static mlt_frame* shuffle_get_frame( mlt_cache cache, mlt_position position )
+static int64_t frame_size( mlt_frame frame )
 {
-	int i = cache->count;
-	int j = cache->count - 1;
-	mlt_frame *hit = NULL;
-	mlt_frame *alt = (mlt_frame*) ( cache->current == cache->A ? cache->B : cache->A );
-
-	if ( cache->count > 0 && cache->count < cache->size )
-	{
-		// first determine if we have a hit
-		while ( i-- && !hit )
-		{
-			mlt_frame *o = (mlt_frame*) &cache->current[ i ];
-			if ( mlt_frame_original_position( *o ) == position )
-				hit = o;
-		}
-		// if there was no hit, we will not be shuffling out an entry
-		// and are still filling the cache
-		if ( !hit )
-			++j;
-		// reset these
-		i = cache->count;
-		hit = NULL;
-	}
-
-	// shuffle the existing entries to the alternate array
-	while ( i-- )
-	{
-		mlt_frame *o = (mlt_frame*) &cache->current[ i ];
-
-		if ( !hit && mlt_frame_original_position( *o ) == position )
-		{
-			hit = o;
-		}
-		else if ( j > 0 )
-		{
-			alt[ --j ] = *o;
-// 			mlt_log( NULL, MLT_LOG_DEBUG, "%s: shuffle %d = %p\n", __FUNCTION__, j, alt[j] );
-		}
-	}
-	return hit;
+	mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
+	int64_t total = 0;
+	int size = 0;
+
+	if ( mlt_properties_get_data( properties, "image", &size ) )
+		total += size;
+	size = 0;
+	if ( mlt_properties_get_data( properties, "alpha", &size ) )
+		total += size;
+	size = 0;
+	if ( mlt_properties_get_data( properties, "audio", &size ) )
+		total += size;
+	return total;
 }
 
 /** Put a frame in the cache.
@@ -534,38 +841,37 @@ static mlt_frame* shuffle_get_frame( mlt_cache cache, mlt_position position )
 
 void mlt_cache_put_frame( mlt_cache cache, mlt_frame frame )
 {
+	mlt_frame clone = mlt_frame_clone( frame, 1 );
+	uintptr_t key = ( uintptr_t )( intptr_t )mlt_frame_original_position( frame );
+	int64_t size = frame_size( clone );
+
 	pthread_mutex_lock( &cache->mutex );
-	mlt_frame *hit = shuffle_get_frame( cache, mlt_frame_original_position( frame ) );
-	mlt_frame *alt = (mlt_frame*) ( cache->current == cache->A ? cache->B : cache->A );
+	cache_entry *entry = cache_find( cache, key );
+	cache->is_frames = 1;
 
 	// add the frame to the cache
-	if ( hit )
+	if ( entry )
 	{
 		// release the old data
-		mlt_frame_close( *hit );
+		mlt_frame_close( entry->object );
 		// the MRU end gets the updated data
-		hit = &alt[ cache->count - 1 ];
-	}
-	else if ( cache->count < cache->size )
-	{
-		// more room in cache, add it to MRU end
-		hit = &alt[ cache->count++ ];
+		entry->object = clone;
+		cache_account( cache, size - entry->size );
+		entry->size = size;
+		cache_touch( cache, entry );
 	}
 	else
 	{
-		// release the entry at the LRU end
-		mlt_frame_close( cache->current[0] );
-
-		// The MRU end gets the new item
-		hit = &alt[ cache->count - 1 ];
+		entry = cache_insert( cache, key, clone, size );
+		if ( !entry )
+			mlt_frame_close( clone );
 	}
-	*hit = mlt_frame_clone( frame, 1 );
+	// release entries at the LRU end
+	cache_evict( cache, entry );
 	mlt_log( NULL, MLT_LOG_DEBUG, "%s: put %d = %p\n", __FUNCTION__, cache->count - 1, frame );
 
-	// swap the current array
-	cache->current = (void**) alt;
-	cache->is_frames = 1;
 	pthread_mutex_unlock( &cache->mutex );
+	governor_trim( );
 }
 
 /** Get a frame from the cache.
@@ -583,20 +889,15 @@ mlt_frame mlt_cache_get_frame( mlt_cache cache, mlt_position position )
 {
 	mlt_frame result = NULL;
 	pthread_mutex_lock( &cache->mutex );
-	mlt_frame *hit = shuffle_get_frame( cache, position );
-	mlt_frame *alt = (mlt_frame*) ( cache->current == cache->A ? cache->B : cache->A );
+	cache_entry *entry = cache_find( cache, ( uintptr_t )( intptr_t )position );
 
-	if ( hit )
+	if ( entry )
 	{
-		// copy the hit to the MRU end
-		alt[ cache->count - 1 ] = *hit;
-		hit = &alt[ cache->count - 1 ];
-
-		result = mlt_frame_clone( *hit, 1 );
-		mlt_log( NULL, MLT_LOG_DEBUG, "%s: get %d = %p\n", __FUNCTION__, cache->count - 1, *hit );
+		// move the hit to the MRU end
+		cache_touch( cache, entry );
 
-		// swap the current array
-		cache->current = (void**) alt;
+		result = mlt_frame_clone( entry->object, 1 );
+		mlt_log( NULL, MLT_LOG_DEBUG, "%s: get %d = %p\n", __FUNCTION__, cache->count - 1, entry->object );
 	}
 	pthread_mutex_unlock( &cache->mutex );
 
@@ -26,12 +26,47 @@
 #include "mlt_frame.h"
 #include "mlt_profile.h"
 #include "mlt_log.h"
+#include "mlt_ring.h"
+#include "mlt_slices.h"
+#include "mlt_trace.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <sys/time.h>
 #include <stdatomic.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+// Interned names of properties read on every frame
+static pthread_once_t atoms_once = PTHREAD_ONCE_INIT;
+static mlt_property_atom atom_audio_off = NULL;
+static mlt_property_atom atom_video_off = NULL;
+static mlt_property_atom atom_buffer_auto = NULL;
+static mlt_property_atom atom_buffer = NULL;
+static mlt_property_atom atom_prefill = NULL;
+static mlt_property_atom atom_speed = NULL;
+static mlt_property_atom atom_rendered = NULL;
+static mlt_property_atom atom_drop_max = NULL;
+static mlt_property_atom atom_drop_count = NULL;
+static mlt_property_atom atom_latency = NULL;
+
+static void atoms_init( void )
+{
+	atom_audio_off = mlt_atom( "audio_off" );
+	atom_video_off = mlt_atom( "video_off" );
+	atom_buffer_auto = mlt_atom( "_buffer" );
+	atom_buffer = mlt_atom( "buffer" );
+	atom_prefill = mlt_atom( "prefill" );
+	atom_speed = mlt_atom( "_speed" );
+	atom_rendered = mlt_atom( "rendered" );
+	atom_drop_max = mlt_atom( "drop_max" );
+	atom_drop_count = mlt_atom( "drop_count" );
+	atom_latency = mlt_atom( "latency" );
+}
 
 /** Define this if you want an automatic deinterlace (if necessary) when the
  * consumer's producer is not running at normal speed.
@@ -52,17 +87,17 @@ typedef struct
 	mlt_image_format image_format;
 	mlt_audio_format audio_format;
 	mlt_deque queue;
+	mlt_ring ring;
 	void *ahead_thread;
 	pthread_mutex_t queue_mutex;
 	pthread_cond_t queue_cond;
-	pthread_mutex_t put_mutex;
-	pthread_cond_t put_cond;
-	mlt_frame put;
-	int put_active;
+	mlt_ring put_ring;
+	atomic_int put_limit;
+	atomic_int put_active;
 	mlt_event event_listener;
 	mlt_position position;
 	pthread_mutex_t position_mutex;	
-	int is_purge;
+	atomic_int is_purge;
 	int aud_counter;
 	double fps;
 	int channels;
@@ -77,6 +112,17 @@ typedef struct
 	int process_head;
 	atomic_int started;
 	pthread_t *threads; /**< used to deallocate all threads */
+	pthread_t audio_thread; /**< processes audio in order beside the image workers */
+	int audio_async; /**< whether audio_thread is running */
+	atomic_int audio_head; /**< the number of queued frames whose audio is done */
+	int64_t render_time; /**< moving average of image render time in usec, guarded by done_mutex */
+	int clone_range; /**< the positions in a range the workers take frames from in turn */
+	atomic_int bound_threads; /**< the number of worker threads that have bound themselves */
+	int64_t clock_time; /**< when the last frame was taken from the queue in usec or 0, guarded by done_mutex */
+	mlt_position clock_position; /**< the position of that frame, guarded by done_mutex */
+	int scale_shift; /**< the power of two the images are reduced by under load, guarded by done_mutex */
+	int scale_frames; /**< the number of frames rendered at this scale, guarded by done_mutex */
+	int64_t scale_time; /**< moving average of their render time in usec, guarded by done_mutex */
 }
 consumer_private;
 
@@ -86,6 +132,7 @@ static void on_consumer_frame_show(mlt_properties owner, mlt_consumer self, mlt_
 static void mlt_thread_create( mlt_consumer self, mlt_thread_function_t function );
 static void mlt_thread_join( mlt_consumer self );
 static void consumer_read_ahead_start( mlt_consumer self );
+static void put_queue_reset( mlt_consumer self );
 
 /** Initialize a consumer service.
  *
@@ -104,6 +151,8 @@ int mlt_consumer_init( mlt_consumer self, void *child, mlt_profile profile )
 	self->child = child;
 	consumer_private *priv = self->local = calloc( 1, sizeof( consumer_private ) );
 
+	pthread_once( &atoms_once, atoms_init );
+
 	error = mlt_service_init( &self->parent, self );
 	if ( error == 0 )
 	{
@@ -122,8 +171,9 @@ int mlt_consumer_init( mlt_consumer self, void *child, mlt_profile profile )
 		apply_profile_properties( self, profile, properties );
 		mlt_properties_set( properties, "mlt_type", "consumer" );
 
-		// Default rescaler for all consumers
+		// Default rescaler and resampler quality for all consumers
 		mlt_properties_set( properties, "rescale", "bilinear" );
+		mlt_properties_set( properties, "resample_quality", "best" );
 
 		// Default read ahead buffer size
 		mlt_properties_set_int( properties, "buffer", 25 );
@@ -135,6 +185,7 @@ int mlt_consumer_init( mlt_consumer self, void *child, mlt_profile profile )
 
 		// Default of all consumers is real time
 		mlt_properties_set_int( properties, "real_time", 1 );
+		mlt_properties_set_int( properties, "audio_thread", 1 );
 
 		// Default to environment test card
 		mlt_properties_set( properties, "test_card", mlt_environment( "MLT_TEST_CARD" ) );
@@ -157,9 +208,9 @@ int mlt_consumer_init( mlt_consumer self, void *child, mlt_profile profile )
 		// subsequent properties can override the profile
 		priv->event_listener = mlt_events_listen( properties, self, "property-changed", ( mlt_listener )mlt_consumer_property_changed );
 
-		// Create the push mutex and condition
-		pthread_mutex_init( &priv->put_mutex, NULL );
-		pthread_cond_init( &priv->put_cond, NULL );
+		// Create the push queue
+		priv->put_ring = mlt_ring_init( 1 );
+		priv->put_limit = 1;
 
 		pthread_mutex_init( &priv->position_mutex, NULL );
 	}
@@ -497,10 +548,7 @@ int mlt_consumer_start( mlt_consumer self )
 	char *test_card = mlt_properties_get( properties, "test_card" );
 
 	// Just to make sure nothing is hanging around...
-	pthread_mutex_lock( &priv->put_mutex );
-	priv->put = NULL;
-	priv->put_active = 1;
-	pthread_mutex_unlock( &priv->put_mutex );
+	put_queue_reset( self );
 
 	// Deal with it now.
 	if ( test_card != NULL )
@@ -533,6 +581,21 @@ int mlt_consumer_start( mlt_consumer self )
 	// The profile could have changed between a stop and a restart.
 	apply_profile_properties( self, mlt_service_profile( MLT_CONSUMER_SERVICE(self) ), properties );
 
+	// Simplify the nested playlists and tractors being rendered if asked to
+	if ( mlt_properties_get_int( properties, "optimise" ) )
+	{
+		mlt_service service = mlt_service_producer( MLT_CONSUMER_SERVICE( self ) );
+		mlt_service_type type = mlt_service_identify( service );
+		while ( type == mlt_service_filter_type || type == mlt_service_transition_type )
+		{
+			service = mlt_service_producer( service );
+			type = mlt_service_identify( service );
+		}
+		if ( type == mlt_service_producer_type || type == mlt_service_playlist_type
+			|| type == mlt_service_tractor_type || type == mlt_service_multitrack_type || type == mlt_service_chain_type )
+			mlt_producer_simplify( MLT_PRODUCER( service ) );
+	}
+
 	// Set the frame duration in microseconds for the frame-dropping heuristic
 	int frame_rate_num = mlt_properties_get_int( properties, "frame_rate_num" );
 	int frame_rate_den = mlt_properties_get_int( properties, "frame_rate_den" );
@@ -553,6 +616,7 @@ int mlt_consumer_start( mlt_consumer self )
 
 	// Set the real_time preference
 	priv->real_time = mlt_properties_get_int( properties, "real_time" );
+	priv->clone_range = mlt_properties_get_int( properties, "clone_range" );
 
 	// For worker threads implementation, buffer must be at least # threads
 	if ( abs( priv->real_time ) > 1 && mlt_properties_get_int( properties, "buffer" ) <= abs( priv->real_time ) )
@@ -577,9 +641,56 @@ int mlt_consumer_start( mlt_consumer self )
 	return error;
 }
 
+/** Close the frames left in the push queue and size it from the put_queue property.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ */
+
+static void put_queue_reset( mlt_consumer self )
+{
+	consumer_private *priv = self->local;
+	int limit = MAX( 1, mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( self ), "put_queue" ) );
+	mlt_frame frame;
+
+	atomic_store( &priv->put_active, 0 );
+	while ( ( frame = mlt_ring_pop( priv->put_ring ) ) )
+		mlt_frame_close( frame );
+	if ( limit > mlt_ring_capacity( priv->put_ring ) )
+	{
+		mlt_ring_close( priv->put_ring );
+		priv->put_ring = mlt_ring_init( limit );
+	}
+	atomic_store( &priv->put_limit, limit );
+	mlt_ring_interrupt( priv->put_ring, 0 );
+	atomic_store( &priv->put_active, 1 );
+}
+
+/** Add a frame to the push queue if it is below its limit.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param frame a frame
+ * \return 0 if queued, 1 if the queue is full, or -1 if the consumer does not take frames
+ */
+
+static int put_queue_push( mlt_consumer self, mlt_frame frame )
+{
+	consumer_private *priv = self->local;
+
+	if ( mlt_service_producer( MLT_CONSUMER_SERVICE( self ) ) || !atomic_load( &priv->put_active ) )
+		return -1;
+	// Pushing from several threads may pass the limit by a little, but never the capacity.
+	if ( mlt_ring_count( priv->put_ring ) >= atomic_load( &priv->put_limit ) || mlt_ring_push( priv->put_ring, frame ) )
+		return 1;
+	return 0;
+}
+
 /** An alternative method to feed frames into the consumer.
  *
- * Only valid if the consumer itself is not connected.
+ * Only valid if the consumer itself is not connected. The frames go into a
+ * queue of up to \em put_queue frames, read when the consumer starts, and
+ * this waits while the queue is full.
  *
  * \public \memberof mlt_consumer_s
  * \param self a consumer
@@ -590,41 +701,98 @@ int mlt_consumer_start( mlt_consumer self )
 int mlt_consumer_put_frame( mlt_consumer self, mlt_frame frame )
 {
 	int error = 1;
+	int result;
 
-	// Get the service associated to the consumer
-	mlt_service service = MLT_CONSUMER_SERVICE( self );
-
-	if ( mlt_service_producer( service ) == NULL )
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES(self), "put_pending", 1 );
+	while ( ( result = put_queue_push( self, frame ) ) > 0 )
 	{
-		struct timeval now;
-		struct timespec tm;
-		consumer_private *priv = self->local;
-
-		mlt_properties_set_int( MLT_CONSUMER_PROPERTIES(self), "put_pending", 1 );
-		pthread_mutex_lock( &priv->put_mutex );
-		while ( priv->put_active && priv->put != NULL )
-		{
-			gettimeofday( &now, NULL );
-			tm.tv_sec = now.tv_sec + 1;
-			tm.tv_nsec = now.tv_usec * 1000;
-			pthread_cond_timedwait( &priv->put_cond, &priv->put_mutex, &tm );
-		}
-		mlt_properties_set_int( MLT_CONSUMER_PROPERTIES(self), "put_pending", 0 );
-		if ( priv->put_active && priv->put == NULL )
-			priv->put = frame;
-		else
-			mlt_frame_close( frame );
-		pthread_cond_broadcast( &priv->put_cond );
-		pthread_mutex_unlock( &priv->put_mutex );
+		if ( mlt_consumer_wait_for_put_space( self ) )
+			break;
 	}
-	else
-	{
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES(self), "put_pending", 0 );
+	if ( result )
 		mlt_frame_close( frame );
-	}
 
 	return error;
 }
 
+/** Feed a frame into the consumer without waiting.
+ *
+ * Only valid if the consumer itself is not connected. Use this with
+ * mlt_consumer_wait_for_put_space() and mlt_consumer_put_depth() to adapt
+ * to the rate at which the consumer takes frames instead of blocking.
+ *
+ * \public \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param frame a frame, which the consumer takes on success
+ * \return 0 if queued, 1 if the queue is full, or -1 if the consumer is stopped or connected;
+ * the caller keeps the frame on failure
+ */
+
+int mlt_consumer_try_put_frame( mlt_consumer self, mlt_frame frame )
+{
+	return put_queue_push( self, frame );
+}
+
+/** Wait until the push queue has room for a frame.
+ *
+ * \public \memberof mlt_consumer_s
+ * \param self a consumer
+ * \return true if the consumer is stopped
+ */
+
+int mlt_consumer_wait_for_put_space( mlt_consumer self )
+{
+	consumer_private *priv = self->local;
+
+	if ( !atomic_load( &priv->put_active ) )
+		return 1;
+	return mlt_ring_wait_for_space( priv->put_ring, atomic_load( &priv->put_limit ) ) || !atomic_load( &priv->put_active );
+}
+
+/** Get the number of frames waiting in the push queue.
+ *
+ * \public \memberof mlt_consumer_s
+ * \param self a consumer
+ * \return the number of frames
+ */
+
+int mlt_consumer_put_depth( mlt_consumer self )
+{
+	consumer_private *priv = self->local;
+	return mlt_ring_count( priv->put_ring );
+}
+
+/** Get the number of frames rendered ahead and waiting for the consumer.
+ *
+ * This is how much of the read ahead buffer is filled, so a depth that
+ * stays well below the buffer property means rendering is not keeping up.
+ * It is always 0 when real_time is 0 or the consumer is stopped, and it
+ * must not be called while the consumer is stopping.
+ *
+ * \public \memberof mlt_consumer_s
+ * \param self a consumer
+ * \return the number of frames
+ */
+
+int mlt_consumer_queue_depth( mlt_consumer self )
+{
+	consumer_private *priv = self->local;
+	int depth = 0;
+
+	if ( abs( priv->real_time ) == 1 )
+	{
+		depth = mlt_ring_count( priv->ring );
+	}
+	else if ( abs( priv->real_time ) > 1 && atomic_load( &priv->started ) )
+	{
+		pthread_mutex_lock( &priv->queue_mutex );
+		depth = mlt_deque_count( priv->queue );
+		pthread_mutex_unlock( &priv->queue_mutex );
+	}
+	return depth;
+}
+
 /** Protected method for consumer to get frames from connected service
  *
  * \public \memberof mlt_consumer_s
@@ -643,31 +811,25 @@ mlt_frame mlt_consumer_get_frame( mlt_consumer self )
 	// Get the consumer properties
 	mlt_properties properties = MLT_CONSUMER_PROPERTIES( self );
 
+	// Follow the memory use
+	mlt_factory_check_memory( );
+
 	// Get the frame
 	if ( mlt_service_producer( service ) == NULL && mlt_properties_get_int( properties, "put_mode" ) )
 	{
-		struct timeval now;
-		struct timespec tm;
 		consumer_private *priv = self->local;
 
-		pthread_mutex_lock( &priv->put_mutex );
-		while ( priv->put_active && priv->put == NULL )
-		{
-			gettimeofday( &now, NULL );
-			tm.tv_sec = now.tv_sec + 1;
-			tm.tv_nsec = now.tv_usec * 1000;
-			pthread_cond_timedwait( &priv->put_cond, &priv->put_mutex, &tm );
-		}
-		frame = priv->put;
-		priv->put = NULL;
-		pthread_cond_broadcast( &priv->put_cond );
-		pthread_mutex_unlock( &priv->put_mutex );
+		while ( !( frame = mlt_ring_pop( priv->put_ring ) ) && atomic_load( &priv->put_active ) )
+			mlt_ring_wait_for_items_timeout( priv->put_ring, 1, 1000000 );
 		if ( frame != NULL )
 			mlt_service_apply_filters( service, frame, 0 );
 	}
 	else if ( mlt_service_producer( service ) != NULL )
 	{
+		// Let the services skip what is only needed for the image
+		int previous = mlt_frame_set_thread_video_off( mlt_properties_get_int_atom( properties, atom_video_off ) );
 		mlt_service_get_frame( service, &frame, 0 );
+		mlt_frame_set_thread_video_off( previous );
 	}
 	else
 	{
@@ -694,6 +856,8 @@ mlt_frame mlt_consumer_get_frame( mlt_consumer self )
 		mlt_properties_set_int( frame_properties, "consumer_tff", mlt_properties_get_int( properties, "top_field_first" ) );
 		mlt_properties_set( frame_properties, "consumer_color_trc", mlt_properties_get( properties, "color_trc" ) );
 		mlt_properties_set( frame_properties, "consumer_channel_layout", mlt_properties_get( properties, "channel_layout" ) );
+		mlt_properties_set( frame_properties, "consumer_resample_quality", mlt_properties_get( properties, "resample_quality" ) );
+		mlt_properties_set_int( frame_properties, "consumer_proxy", mlt_properties_get_int( properties, "proxy" ) );
 	}
 
 	// Return the frame
@@ -716,6 +880,145 @@ static inline long time_difference( struct timeval *time1 )
 	return time1->tv_sec * 1000000 + time1->tv_usec - time2.tv_sec * 1000000 - time2.tv_usec;
 }
 
+/** Get the priority class of the rendering of a consumer.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \return the priority class given by \em render_priority
+ */
+
+static mlt_slices_priority consumer_render_priority( mlt_consumer self )
+{
+	const char *priority = mlt_properties_get( MLT_CONSUMER_PROPERTIES( self ), "render_priority" );
+
+	if ( !priority )
+		return mlt_slices_priority_normal;
+	if ( !strcmp( priority, "high" ) )
+		return mlt_slices_priority_high;
+	if ( !strcmp( priority, "low" ) )
+		return mlt_slices_priority_low;
+	return atoi( priority ) > 0 ? mlt_slices_priority_high :
+		atoi( priority ) < 0 ? mlt_slices_priority_low : mlt_slices_priority_normal;
+}
+
+/** Set up a thread of the consumer from the properties.
+ *
+ * This restricts the thread to the CPUs given by \em cpus. With \em numa
+ * each worker is bound to a NUMA node in turn, so the slices it runs use the
+ * pool of its node when MLT_SLICES_NUMA is set. The slices the thread runs
+ * get the priority class of \em render_priority, and a low priority thread
+ * also gets a lower scheduling priority so it yields the CPU.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param spread whether to bind to the next NUMA node
+ */
+
+static void consumer_thread_init( mlt_consumer self, int spread )
+{
+	consumer_private *priv = self->local;
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( self );
+	const char *cpus = mlt_properties_get( properties, "cpus" );
+	int nodes = mlt_properties_get_int( properties, "numa" ) ? mlt_slices_node_count() : 1;
+	int node = -1;
+	mlt_slices_priority priority = consumer_render_priority( self );
+
+	if ( spread && nodes > 1 )
+		node = atomic_fetch_add( &priv->bound_threads, 1 ) % nodes;
+	if ( ( cpus && *cpus ) || node >= 0 )
+		mlt_slices_bind_thread( cpus, node );
+
+	mlt_slices_set_priority( priority );
+#if defined(__linux__) && defined(SYS_gettid)
+	// On Linux the nice value is per thread
+	if ( priority == mlt_slices_priority_low )
+		setpriority( PRIO_PROCESS, syscall( SYS_gettid ), 10 );
+#endif
+}
+
+/** Get the size to render an image at with adaptive_scale.
+ *
+ * The images are reduced to a half or a quarter of the consumer size while
+ * playing under load. A paused frame is always rendered at full size.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param frame the frame to render
+ * \param[in,out] width the width of the image
+ * \param[in,out] height the height of the image
+ */
+
+static void adaptive_scale_size( mlt_consumer self, mlt_frame frame, int *width, int *height )
+{
+	consumer_private *priv = self->local;
+	int shift = 0;
+
+	if ( !mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( self ), "adaptive_scale" ) )
+		return;
+	if ( mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_speed ) != 0 )
+	{
+		pthread_mutex_lock( &priv->done_mutex );
+		shift = priv->scale_shift;
+		pthread_mutex_unlock( &priv->done_mutex );
+	}
+	if ( shift > 0 )
+	{
+		*width = MAX( 2, *width >> shift );
+		*width -= *width % 2;
+		*height = MAX( 2, *height >> shift );
+		*height -= *height % 2;
+	}
+	mlt_properties_set_double( MLT_FRAME_PROPERTIES( frame ), "consumer_scale", 1.0 / ( 1 << shift ) );
+}
+
+/** Change the scale of adaptive_scale from the render time.
+ *
+ * The scale is reduced when the average render time at the current scale
+ * stays near the time the threads have for a frame, and it is restored when
+ * the full size would take less than half of that. A change waits for half
+ * a second of frames at the current scale.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param frame the frame rendered
+ * \param render_time the time it took to render the image in usec
+ * \param threads the number of threads rendering images
+ */
+
+static void adaptive_scale_update( mlt_consumer self, mlt_frame frame, int64_t render_time, int threads )
+{
+	consumer_private *priv = self->local;
+	int64_t budget = priv->fps > 0.0 ? threads * 1000000.0 / priv->fps : 0;
+	int shift = -1;
+
+	if ( !budget || !mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( self ), "adaptive_scale" )
+		|| mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_speed ) == 0 )
+		return;
+
+	pthread_mutex_lock( &priv->done_mutex );
+	priv->scale_time = priv->scale_time ? priv->scale_time + ( render_time - priv->scale_time ) / 8 : render_time;
+	if ( ++priv->scale_frames >= MAX( priv->fps / 2, 8 ) )
+	{
+		if ( priv->scale_time > budget * 9 / 10 && priv->scale_shift < 2 )
+			shift = priv->scale_shift + 1;
+		else if ( priv->scale_shift > 0 && ( priv->scale_time << ( 2 * priv->scale_shift ) ) < budget / 2 )
+			shift = 0;
+		if ( shift >= 0 )
+		{
+			priv->scale_shift = shift;
+			priv->scale_frames = 0;
+			priv->scale_time = 0;
+		}
+	}
+	pthread_mutex_unlock( &priv->done_mutex );
+
+	if ( shift >= 0 )
+	{
+		mlt_log_verbose( MLT_CONSUMER_SERVICE( self ), "adaptive scale 1/%d\n", 1 << shift );
+		mlt_properties_set_double( MLT_CONSUMER_PROPERTIES( self ), "adaptive_scale_factor", 1.0 / ( 1 << shift ) );
+	}
+}
+
 /** The thread procedure for asynchronously pulling frames through the service
  * network connected to a consumer.
  *
@@ -741,6 +1044,8 @@ static void *consumer_read_ahead_thread( void *arg )
 	int preview_off = mlt_properties_get_int( properties, "preview_off" );
 	int preview_format = mlt_properties_get_int( properties, "preview_format" );
 
+	consumer_thread_init( self, 0 );
+
 	// Audio processing variables
 	int samples = 0;
 	void *audio = NULL;
@@ -776,7 +1081,7 @@ static void *consumer_read_ahead_thread( void *arg )
 
 	// Get the first frame
 	frame = mlt_consumer_get_frame( self );
-	priv->speed = mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "_speed" );
+	priv->speed = mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_speed );
 
 	if ( frame )
 	{
@@ -795,7 +1100,7 @@ static void *consumer_read_ahead_thread( void *arg )
 		}
 
 		// Mark as rendered
-		mlt_properties_set_int( MLT_FRAME_PROPERTIES( frame ), "rendered", 1 );
+		mlt_properties_set_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_rendered, 1 );
 		last_pos = start_pos = pos = mlt_frame_get_position( frame );
 	}
 
@@ -805,24 +1110,16 @@ static void *consumer_read_ahead_thread( void *arg )
 	// Continue to read ahead
 	while ( priv->ahead )
 	{
-		// Get the maximum size of the buffer
+		// Get the maximum size of the buffer, which shrinks under memory pressure
 		int buffer = (priv->speed == 0) ? 1 : MAX(mlt_properties_get_int( properties, "buffer" ), 0) + 1;
+		buffer = MAX( 1, buffer >> mlt_factory_get_memory_pressure() );
 	
 		// Put the current frame into the queue
-		pthread_mutex_lock( &priv->queue_mutex );
-		while( priv->ahead && mlt_deque_count( priv->queue ) >= buffer )
-			pthread_cond_wait( &priv->queue_cond, &priv->queue_mutex );
-		if ( priv->is_purge )
-		{
+		int64_t trace_begin = mlt_trace_now();
+		mlt_ring_wait_for_space( priv->ring, buffer );
+		mlt_trace_event( self, "consumer", "wait_for_queue_space", trace_begin );
+		if ( atomic_exchange( &priv->is_purge, 0 ) || mlt_ring_push( priv->ring, frame ) )
 			mlt_frame_close( frame );
-			priv->is_purge = 0;
-		}
-		else
-		{
-			mlt_deque_push_back( priv->queue, frame );
-		}
-		pthread_cond_broadcast( &priv->queue_cond );
-		pthread_mutex_unlock( &priv->queue_mutex );
 
 		mlt_log_timings_begin();
 		// Get the next frame
@@ -833,7 +1130,7 @@ static void *consumer_read_ahead_thread( void *arg )
 		if ( frame == NULL )
 			continue;
 		pos = mlt_frame_get_position( frame );
-		priv->speed = mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "_speed" );
+		priv->speed = mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_speed );
 
 		// WebVfx uses this to setup a consumer-stopping event handler.
 		mlt_properties_set_data( MLT_FRAME_PROPERTIES( frame ), "consumer", self, 0, NULL, NULL );
@@ -866,16 +1163,20 @@ static void *consumer_read_ahead_thread( void *arg )
 				// Reset width/height - could have been changed by previous mlt_frame_get_image
 				width = mlt_properties_get_int( properties, "width" );
 				height = mlt_properties_get_int( properties, "height" );
+				adaptive_scale_size( self, frame, &width, &height );
 
 				// Get the image
+				struct timeval render_begin;
+				gettimeofday( &render_begin, NULL );
 				mlt_events_fire( MLT_CONSUMER_PROPERTIES( self ), "consumer-frame-render", mlt_event_data_from_frame(frame) );
 				mlt_log_timings_begin();
 				mlt_frame_get_image( frame, &image, &priv->image_format, &width, &height, 0 );
 				mlt_log_timings_end( NULL, "mlt_frame_get_image" );
+				adaptive_scale_update( self, frame, time_difference( &render_begin ), 1 );
 			}
 
 			// Indicate the rendered image is available.
-			mlt_properties_set_int( MLT_FRAME_PROPERTIES( frame ), "rendered", 1 );
+			mlt_properties_set_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_rendered, 1 );
 
 			// Reset consecutively-skipped counter
 			skipped = 0;
@@ -929,7 +1230,7 @@ static void *consumer_read_ahead_thread( void *arg )
 		skip_next = 0;
 
 		// Only consider skipping if the buffer level is low (or really small)
-		if ( mlt_deque_count( priv->queue ) <= buffer / 5 + 1 && count > 1 )
+		if ( mlt_ring_count( priv->ring ) <= buffer / 5 + 1 && count > 1 )
 		{
 			// Skip next frame if average cost exceeds frame duration.
 			if ( time_process / count > frame_duration )
@@ -944,14 +1245,8 @@ static void *consumer_read_ahead_thread( void *arg )
 	mlt_frame_close( frame );
 
 	// Wipe the queue
-	pthread_mutex_lock( &priv->queue_mutex );
-	while ( mlt_deque_count( priv->queue ) )
-		mlt_frame_close( mlt_deque_pop_back( priv->queue ) );
-
-	// Close the queue
-	mlt_deque_close( priv->queue );
-	priv->queue = NULL;
-	pthread_mutex_unlock( &priv->queue_mutex );
+	while ( ( frame = mlt_ring_pop( priv->ring ) ) )
+		mlt_frame_close( frame );
 
 	mlt_events_fire( MLT_CONSUMER_PROPERTIES(self), "consumer-thread-stopped", mlt_event_data_none() );
 
@@ -983,6 +1278,93 @@ static inline int first_unprocessed_frame( mlt_consumer self )
 	return index;
 }
 
+/** Find the next frame for a worker thread when the consumer has a clone_range.
+ *
+ * Producers with a clone_pool decode each range of clone_range positions
+ * with one clone, so a worker prefers a frame from a range that no other
+ * worker is rendering. It falls back to the first unprocessed frame when
+ * every range in the queue is busy.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \return an index into the queue
+ */
+
+static int next_unprocessed_frame( mlt_consumer self )
+{
+	consumer_private *priv = self->local;
+	int first = first_unprocessed_frame( self );
+	int count = mlt_deque_count( priv->queue );
+
+	if ( priv->clone_range <= 0 || first >= count )
+		return first;
+
+	// Collect the ranges being rendered
+	mlt_position busy[ 64 ];
+	int n = 0;
+	int i;
+	for ( i = 0; i < count && n < 64; i++ )
+	{
+		mlt_frame frame = mlt_deque_peek( priv->queue, i );
+		if ( frame->is_processing && !mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_rendered ) )
+			busy[ n++ ] = mlt_frame_get_position( frame ) / priv->clone_range;
+	}
+
+	for ( i = first; i < count; i++ )
+	{
+		mlt_frame frame = mlt_deque_peek( priv->queue, i );
+		if ( frame->is_processing )
+			continue;
+		mlt_position range = mlt_frame_get_position( frame ) / priv->clone_range;
+		int j = 0;
+		while ( j < n && busy[ j ] != range )
+			j++;
+		if ( j == n )
+			return i;
+	}
+	return first;
+}
+
+/** Determine whether a frame would not be rendered before it is shown.
+ *
+ * When frames may be dropped, the time a frame is shown is estimated from
+ * when the last one was taken from the queue, and a frame is late when that
+ * is sooner than the average render time.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param frame a queued frame
+ * \param queued the number of frames in the queue, read under queue_mutex
+ * \return true if the frame would be late
+ */
+
+static int frame_is_late( mlt_consumer self, mlt_frame frame, int queued )
+{
+	consumer_private *priv = self->local;
+	double speed = mlt_properties_get_double_atom( MLT_FRAME_PROPERTIES( frame ), atom_speed );
+	int64_t clock_time, render_time;
+	mlt_position clock_position;
+	struct timeval now;
+
+	if ( priv->real_time <= 0 || speed == 0.0 || priv->fps <= 0.0 )
+		return 0;
+
+	pthread_mutex_lock( &priv->done_mutex );
+	clock_time = priv->clock_time;
+	clock_position = priv->clock_position;
+	render_time = priv->render_time;
+	pthread_mutex_unlock( &priv->done_mutex );
+
+	// The number of frames shown before this one, not knowing after a jump
+	double ahead = ( mlt_frame_get_position( frame ) - clock_position ) / speed;
+	if ( !clock_time || !render_time || ahead <= 0.0 || ahead > queued + 1 )
+		return 0;
+
+	gettimeofday( &now, NULL );
+	int64_t deadline = clock_time + (int64_t) ( ahead * 1000000.0 / priv->fps );
+	return deadline < (int64_t) now.tv_sec * 1000000 + now.tv_usec + render_time;
+}
+
 /** The worker thread procedure for parallel processing frames.
  *
  * \private \memberof mlt_consumer_s
@@ -1008,9 +1390,12 @@ static void *consumer_worker_thread( void *arg )
 	int preview_off = mlt_properties_get_int( properties, "preview_off" );
 	int preview_format = mlt_properties_get_int( properties, "preview_format" );
 
+	consumer_thread_init( self, 1 );
+
 	// General frame variable
 	mlt_frame frame = NULL;
 	uint8_t *image = NULL;
+	int queued = 0;
 
 	if ( preview_off && preview_format != 0 )
 		format = preview_format;
@@ -1022,17 +1407,18 @@ static void *consumer_worker_thread( void *arg )
 	{
 		// Get the next unprocessed frame from the work queue
 		pthread_mutex_lock( &priv->queue_mutex );
-		int index = first_unprocessed_frame( self );
+		int index = next_unprocessed_frame( self );
 		while ( priv->ahead && index >= mlt_deque_count( priv->queue ) )
 		{
 			mlt_log_debug( MLT_CONSUMER_SERVICE(self), "waiting in worker index = %d queue count = %d\n",
 				index, mlt_deque_count( priv->queue ) );
 			pthread_cond_wait( &priv->queue_cond, &priv->queue_mutex );
-			index = first_unprocessed_frame( self );
+			index = next_unprocessed_frame( self );
 		}
 
 		// Mark the frame for processing
 		frame = mlt_deque_peek( priv->queue, index );
+		queued = mlt_deque_count( priv->queue );
 		if ( frame )
 		{
 			mlt_log_debug( MLT_CONSUMER_SERVICE(self), "worker processing index = %d frame " MLT_POSITION_FMT " queue count = %d\n",
@@ -1046,28 +1432,100 @@ static void *consumer_worker_thread( void *arg )
 		if ( frame == NULL )
 			continue;
 
+		// Leave a frame that would be dropped anyway unrendered to catch up
+		if ( !video_off && frame_is_late( self, frame, queued ) )
+		{
+			mlt_log_debug( MLT_CONSUMER_SERVICE(self), "worker skipping late frame " MLT_POSITION_FMT "\n",
+				mlt_frame_get_position( frame ) );
+			mlt_frame_close( frame );
+			pthread_mutex_lock( &priv->done_mutex );
+			pthread_cond_broadcast( &priv->done_cond );
+			pthread_mutex_unlock( &priv->done_mutex );
+			continue;
+		}
+
 		// WebVfx uses this to setup a consumer-stopping event handler.
 		mlt_properties_set_data( MLT_FRAME_PROPERTIES( frame ), "consumer", self, 0, NULL, NULL );
 
 #ifdef DEINTERLACE_ON_NOT_NORMAL_SPEED
 		// All non normal playback frames should be shown
-		if ( mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "_speed" ) != 1 )
+		if ( mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_speed ) != 1 )
 			mlt_properties_set_int( MLT_FRAME_PROPERTIES( frame ), "consumer_deinterlace", 1 );
 #endif
 
 		// Get the image
+		struct timeval ante;
+		gettimeofday( &ante, NULL );
 		if ( !video_off )
 		{
 			// Fetch width/height again
 			width = mlt_properties_get_int( properties, "width" );
 			height = mlt_properties_get_int( properties, "height" );
+			adaptive_scale_size( self, frame, &width, &height );
 			mlt_events_fire( MLT_CONSUMER_PROPERTIES( self ), "consumer-frame-render", mlt_event_data_from_frame(frame) );
 			mlt_frame_get_image( frame, &image, &format, &width, &height, 0 );
 		}
-		mlt_properties_set_int( MLT_FRAME_PROPERTIES( frame ), "rendered", 1 );
+		mlt_properties_set_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_rendered, 1 );
+		int64_t time_current = time_difference( &ante );
+		if ( !video_off )
+			adaptive_scale_update( self, frame, time_current, abs( priv->real_time ) );
 		mlt_frame_close( frame );
 
 		// Tell a waiting thread (non-realtime main consumer thread) that we are done.
+		pthread_mutex_lock( &priv->done_mutex );
+		priv->render_time = priv->render_time ? priv->render_time + ( time_current - priv->render_time ) / 8 : time_current;
+		pthread_cond_broadcast( &priv->done_cond );
+		pthread_mutex_unlock( &priv->done_mutex );
+	}
+
+	return NULL;
+}
+
+/** The thread procedure for processing audio beside the parallel workers.
+ *
+ * Audio must be processed in order, so a single thread walks the work queue
+ * from the head while the workers render images. The frames before
+ * audio_head have their audio done and may be released to the consumer.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param arg a consumer
+ */
+
+static void *consumer_audio_thread( void *arg )
+{
+	mlt_consumer self = arg;
+	consumer_private *priv = self->local;
+	mlt_frame frame = NULL;
+	void *audio = NULL;
+	int samples = 0;
+
+	consumer_thread_init( self, 0 );
+	mlt_events_fire( MLT_CONSUMER_PROPERTIES( self ), "consumer-thread-started", mlt_event_data_none() );
+
+	while ( priv->ahead )
+	{
+		// Get the next frame without audio from the work queue
+		pthread_mutex_lock( &priv->queue_mutex );
+		while ( priv->ahead && priv->audio_head >= mlt_deque_count( priv->queue ) )
+			pthread_cond_wait( &priv->queue_cond, &priv->queue_mutex );
+		frame = mlt_deque_peek( priv->queue, priv->audio_head );
+		if ( frame )
+			mlt_properties_inc_ref( MLT_FRAME_PROPERTIES( frame ) );
+		pthread_mutex_unlock( &priv->queue_mutex );
+
+		if ( frame == NULL )
+			continue;
+
+		samples = mlt_audio_calculate_frame_samples( priv->fps, priv->frequency, priv->aud_counter++ );
+		mlt_frame_get_audio( frame, &audio, &priv->audio_format, &priv->frequency, &priv->channels, &samples );
+
+		// Advance unless the queue was purged meanwhile
+		pthread_mutex_lock( &priv->queue_mutex );
+		if ( mlt_deque_peek( priv->queue, priv->audio_head ) == frame )
+			priv->audio_head++;
+		pthread_mutex_unlock( &priv->queue_mutex );
+		mlt_frame_close( frame );
+
 		pthread_mutex_lock( &priv->done_mutex );
 		pthread_cond_broadcast( &priv->done_cond );
 		pthread_mutex_unlock( &priv->done_mutex );
@@ -1092,14 +1550,14 @@ static void consumer_read_ahead_start( mlt_consumer self )
 	// We're running now
 	priv->ahead = 1;
 
-	// Create the frame queue
-	priv->queue = mlt_deque_init( );
-
-	// Create the queue mutex
-	pthread_mutex_init( &priv->queue_mutex, NULL );
-
-	// Create the condition
-	pthread_cond_init( &priv->queue_cond, NULL );
+	// Create the frame queue - it lives until the consumer is closed because
+	// the consuming thread may still be polling it while we are stopped
+	if ( !priv->ring )
+	{
+		int buffer = MAX( mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( self ), "buffer" ), 0 ) + 1;
+		priv->ring = mlt_ring_init( MAX( 64, buffer + 1 ) );
+	}
+	mlt_ring_interrupt( priv->ring, 0 );
 
 	// Create the read ahead
 	mlt_thread_create( self, (mlt_thread_function_t) consumer_read_ahead_thread );
@@ -1135,6 +1593,12 @@ static void consumer_work_start( mlt_consumer self )
 	// If we always start from the head, then we may likely not complete processing
 	// before the frame is played out.
 	priv->process_head = 0;
+	priv->render_time = 0;
+	priv->clock_time = 0;
+	priv->scale_shift = 0;
+	priv->scale_frames = 0;
+	priv->scale_time = 0;
+	atomic_store( &priv->bound_threads, 0 );
 
 	// Create the queues
 	priv->queue = mlt_deque_init();
@@ -1184,6 +1648,12 @@ static void consumer_work_start( mlt_consumer self )
 			thread++;
 		}
 	}
+
+	// Process audio on its own thread unless disabled
+	priv->audio_head = 0;
+	priv->audio_async = !mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( self ), "audio_off" ) &&
+		mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( self ), "audio_thread" ) &&
+		pthread_create( &priv->audio_thread, NULL, consumer_audio_thread, self ) == 0;
 	priv->started = 1;
 }
 
@@ -1205,24 +1675,11 @@ static void consumer_read_ahead_stop( mlt_consumer self )
 		priv->ahead = 0;
 		mlt_events_fire( MLT_CONSUMER_PROPERTIES(self), "consumer-stopping", mlt_event_data_none() );
 
-		// Broadcast to the condition in case it's waiting
-		pthread_mutex_lock( &priv->queue_mutex );
-		pthread_cond_broadcast( &priv->queue_cond );
-		pthread_mutex_unlock( &priv->queue_mutex );
-
-		// Broadcast to the put condition in case it's waiting
-		pthread_mutex_lock( &priv->put_mutex );
-		pthread_cond_broadcast( &priv->put_cond );
-		pthread_mutex_unlock( &priv->put_mutex );
+		// Wake up anything waiting on the frame queue
+		mlt_ring_interrupt( priv->ring, 1 );
 
 		// Join the thread
 		mlt_thread_join( self );
-
-		// Destroy the frame queue mutex
-		pthread_mutex_destroy( &priv->queue_mutex );
-
-		// Destroy the condition
-		pthread_cond_destroy( &priv->queue_cond );
 	}
 }
 
@@ -1249,11 +1706,6 @@ static void consumer_work_stop( mlt_consumer self )
 		pthread_cond_broadcast( &priv->queue_cond );
 		pthread_mutex_unlock( &priv->queue_mutex );
 
-		// Broadcast to the put condition in case it's waiting
-		pthread_mutex_lock( &priv->put_mutex );
-		pthread_cond_broadcast( &priv->put_cond );
-		pthread_mutex_unlock( &priv->put_mutex );
-
 		// Broadcast to the done condition in case it's waiting
 		pthread_mutex_lock( &priv->done_mutex );
 		pthread_cond_broadcast( &priv->done_cond );
@@ -1263,6 +1715,10 @@ static void consumer_work_stop( mlt_consumer self )
 		pthread_t *thread;
 		while ( ( thread = mlt_deque_pop_back( priv->worker_threads ) ) )
 			pthread_join( *thread, NULL );
+		if ( priv->audio_async )
+			pthread_join( priv->audio_thread, NULL );
+		priv->audio_async = 0;
+		priv->audio_head = 0;
 
 		// Deallocate the array of threads
 		free( priv->threads );
@@ -1298,45 +1754,117 @@ void mlt_consumer_purge( mlt_consumer self )
 	if ( self )
 	{
 		consumer_private *priv = self->local;
+		mlt_frame frame;
 
-		pthread_mutex_lock( &priv->put_mutex );
-		if ( priv->put ) {
-			mlt_frame_close( priv->put );
-			priv->put = NULL;
-		}
-		pthread_cond_broadcast( &priv->put_cond );
-		pthread_mutex_unlock( &priv->put_mutex );
+		while ( ( frame = mlt_ring_pop( priv->put_ring ) ) )
+			mlt_frame_close( frame );
 
 		if ( self->purge )
 			self->purge( self );
 
-		if ( priv->started && priv->real_time )
+		if ( priv->started && abs( priv->real_time ) == 1 )
+		{
+			// Flag the frame in flight before draining so it is dropped too
+			priv->is_purge = 1;
+			while ( ( frame = mlt_ring_pop( priv->ring ) ) )
+				mlt_frame_close( frame );
+		}
+		else if ( priv->started && priv->real_time )
 			pthread_mutex_lock( &priv->queue_mutex );
 
-		while ( priv->started && mlt_deque_count( priv->queue ) )
-			mlt_frame_close( mlt_deque_pop_back( priv->queue ) );
+		while ( priv->started && abs( priv->real_time ) != 1 && mlt_deque_count( priv->queue ) )
+		{
+			// Let the workers abandon the frames they are rendering
+			mlt_frame frame = mlt_deque_pop_back( priv->queue );
+			if ( frame->is_processing )
+				mlt_frame_cancel( frame );
+			mlt_frame_close( frame );
+		}
 
-		if ( priv->started && priv->real_time )
+		if ( priv->started && abs( priv->real_time ) > 1 )
 		{
+			priv->audio_head = 0;
 			priv->is_purge = 1;
 			pthread_cond_broadcast( &priv->queue_cond );
 			pthread_mutex_unlock( &priv->queue_mutex );
-			if ( abs( priv->real_time ) > 1 )
-			{
-				pthread_mutex_lock( &priv->done_mutex );
-				pthread_cond_broadcast( &priv->done_cond );
-				pthread_mutex_unlock( &priv->done_mutex );
-			}
+			pthread_mutex_lock( &priv->done_mutex );
+			pthread_cond_broadcast( &priv->done_cond );
+			pthread_mutex_unlock( &priv->done_mutex );
 		}
 
-		pthread_mutex_lock( &priv->put_mutex );
-		if ( priv->put ) {
-			mlt_frame_close( priv->put );
-			priv->put = NULL;
-		}
-		pthread_cond_broadcast( &priv->put_cond );
-		pthread_mutex_unlock( &priv->put_mutex );
+		while ( ( frame = mlt_ring_pop( priv->put_ring ) ) )
+			mlt_frame_close( frame );
+	}
+}
+
+/** Check whether the frame at the head of the work queue may be released.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \return true if its audio is done and, when not dropping frames, its image
+ */
+
+static int first_frame_ready( mlt_consumer self )
+{
+	consumer_private *priv = self->local;
+	int ready = 1;
+
+	pthread_mutex_lock( &priv->queue_mutex );
+	if ( priv->audio_async && priv->audio_head == 0 )
+		ready = 0;
+	else if ( priv->real_time < 0 )
+		ready = mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( MLT_FRAME( mlt_deque_peek_front( priv->queue ) ) ), atom_rendered );
+	pthread_mutex_unlock( &priv->queue_mutex );
+
+	return ready;
+}
+
+/** Size the work queue and worker look-ahead for a target latency.
+ *
+ * The buffer holds as many frames as fit in the target latency. Workers skip
+ * the frames at the head of the queue that would not finish rendering before
+ * they are played out at the measured render time, which drops them.
+ * The estimates are published as read only consumer properties.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param latency the target latency in milliseconds
+ * \param threads the number of worker threads
+ * \return the work queue size
+ */
+
+static int latency_control( mlt_consumer self, int latency, int threads )
+{
+	consumer_private *priv = self->local;
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( self );
+	int frame_duration = MAX( mlt_properties_get_int( properties, "frame_duration" ), 1 );
+	int buffer = MAX( 1, (int64_t) latency * 1000 / frame_duration );
+	int lookahead = 0;
+	int64_t render_time;
+
+	pthread_mutex_lock( &priv->done_mutex );
+	render_time = priv->render_time;
+	pthread_mutex_unlock( &priv->done_mutex );
+
+	if ( priv->real_time > 0 && render_time > 0 )
+	{
+		// A frame at index i is shown about (i + 1) frame durations from now
+		lookahead = render_time / frame_duration;
+		lookahead = MIN( lookahead, MAX( buffer - threads, 0 ) );
+		priv->process_head = lookahead;
+	}
+	else if ( priv->real_time < 0 )
+	{
+		// Without dropping, the workers need one frame each
+		buffer = MAX( buffer, threads );
 	}
+
+	mlt_properties_set_double( properties, "latency_render_time", render_time / 1000.0 );
+	mlt_properties_set_int( properties, "latency_buffer", buffer );
+	mlt_properties_set_int( properties, "latency_lookahead", lookahead );
+	mlt_properties_set_double( properties, "latency_estimate", (double) buffer * frame_duration / 1000.0 );
+
+	return buffer;
 }
 
 /** Use multiple worker threads and a work queue.
@@ -1348,19 +1876,27 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 	mlt_frame frame = NULL;
 	consumer_private *priv = self->local;
 	int threads = abs( priv->real_time );
-	int audio_off = mlt_properties_get_int( properties, "audio_off" );
+	int audio_off = mlt_properties_get_int_atom( properties, atom_audio_off );
 	int samples = 0;
 	void *audio = NULL;
-	int buffer = mlt_properties_get_int( properties, "_buffer" );
-	buffer = buffer > 0 ? buffer : mlt_properties_get_int( properties, "buffer" );
+	int buffer = mlt_properties_get_int_atom( properties, atom_buffer_auto );
+	buffer = buffer > 0 ? buffer : mlt_properties_get_int_atom( properties, atom_buffer );
 	// This is a heuristic to determine a suitable minimum buffer size for the number of threads.
 	int headroom = (priv->real_time < 0) ? threads : (2 + threads * threads);
 	buffer = MAX(buffer, headroom);
+	int latency = mlt_properties_get_int_atom( properties, atom_latency );
+	if ( latency > 0 )
+		buffer = latency_control( self, latency, threads );
+	else if ( priv->clone_range > 0 )
+		// Queue a range for each worker, within four times the buffer to bound the memory
+		buffer = MAX( buffer, MIN( threads * priv->clone_range, 4 * buffer ) );
+	// Queue fewer frames under memory pressure but still one for each worker
+	buffer = MAX( threads, buffer >> mlt_factory_get_memory_pressure() );
 
 	// Start worker threads if not already started.
 	if ( ! priv->ahead )
 	{
-		int prefill = mlt_properties_get_int( properties, "prefill" );
+		int prefill = mlt_properties_get_int_atom( properties, atom_prefill );
 		prefill = prefill > 0 && prefill < buffer ? prefill : buffer;
 
 		set_audio_format( self );
@@ -1374,29 +1910,27 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 			frame = mlt_consumer_get_frame( self );
 			if ( frame )
 			{
-				// Process the audio
-				if ( !audio_off )
+				// Process the audio unless it has its own thread
+				if ( !audio_off && !priv->audio_async )
 				{
 					samples = mlt_audio_calculate_frame_samples( priv->fps, priv->frequency, priv->aud_counter++ );
 					mlt_frame_get_audio( frame, &audio, &priv->audio_format, &priv->frequency, &priv->channels, &samples );
 				}
+				priv->speed = mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_speed );
+				buffer = (priv->speed == 0) ? 1 : buffer;
 				pthread_mutex_lock( &priv->queue_mutex );
 				mlt_deque_push_back( priv->queue, frame );
-				pthread_cond_signal( &priv->queue_cond );
+				pthread_cond_broadcast( &priv->queue_cond );
 				pthread_mutex_unlock( &priv->queue_mutex );
-				priv->speed = mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "_speed" );
-				buffer = (priv->speed == 0) ? 1 : buffer;
 			}
 		}
 
-		// Wait for prefill
-		while ( priv->ahead && first_unprocessed_frame( self ) < prefill )
-		{
-			pthread_mutex_lock( &priv->done_mutex );
+		// Wait for prefill, unless a purge emptied the queue
+		pthread_mutex_lock( &priv->done_mutex );
+		while ( priv->ahead && !priv->is_purge && first_unprocessed_frame( self ) < prefill )
 			pthread_cond_wait( &priv->done_cond, &priv->done_mutex );
-			pthread_mutex_unlock( &priv->done_mutex );
-		}
-		priv->process_head = threads;
+		pthread_mutex_unlock( &priv->done_mutex );
+		priv->process_head = latency > 0 ? 0 : threads;
 	}
 
 //	mlt_log_verbose( MLT_CONSUMER_SERVICE(self), "size %d done count %d work count %d process_head %d\n",
@@ -1408,43 +1942,64 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 		frame = mlt_consumer_get_frame( self );
 		if ( frame )
 		{
-			// Process the audio
-			if ( !audio_off )
+			// Process the audio unless it has its own thread
+			if ( !audio_off && !priv->audio_async )
 			{
 				samples = mlt_audio_calculate_frame_samples( priv->fps, priv->frequency, priv->aud_counter++ );
 				mlt_frame_get_audio( frame, &audio, &priv->audio_format, &priv->frequency, &priv->channels, &samples );
 			}
+			priv->speed = mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_speed );
+			buffer = (priv->speed == 0) ? 1 : buffer;
 			pthread_mutex_lock( &priv->queue_mutex );
 			mlt_deque_push_back( priv->queue, frame );
-			pthread_cond_signal( &priv->queue_cond );
+			pthread_cond_broadcast( &priv->queue_cond );
 			pthread_mutex_unlock( &priv->queue_mutex );
-			priv->speed = mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "_speed" );
-			buffer = (priv->speed == 0) ? 1 : buffer;
 		}
 	}
 
-	// Wait if not realtime.
-	while ( priv->ahead && priv->real_time < 0 && !priv->is_purge &&
-		!( mlt_properties_get_int( MLT_FRAME_PROPERTIES( MLT_FRAME( mlt_deque_peek_front( priv->queue ) ) ), "rendered" ) ) )
-	{
-		pthread_mutex_lock( &priv->done_mutex );
+	// Wait for the audio and, if not realtime, the image.
+	int64_t trace_begin = mlt_trace_now();
+	pthread_mutex_lock( &priv->done_mutex );
+	while ( priv->ahead && !priv->is_purge && !first_frame_ready( self ) )
 		pthread_cond_wait( &priv->done_cond, &priv->done_mutex );
-		pthread_mutex_unlock( &priv->done_mutex );
-	}
+	pthread_mutex_unlock( &priv->done_mutex );
+	mlt_trace_event( self, "consumer", "wait_for_frame_done", trace_begin );
 
 	// Get the frame from the queue.
 	pthread_mutex_lock( &priv->queue_mutex );
 	frame = mlt_deque_pop_front( priv->queue );
+	if ( frame && priv->audio_head > 0 )
+		priv->audio_head--;
 	pthread_mutex_unlock( &priv->queue_mutex );
 	if ( ! frame ) {
 		priv->is_purge = 0;
 		return frame;
 	}
 
-	// Adapt the worker process head to the runtime conditions.
+	// The frame is due now, which gives the time the queued frames are due
 	if ( priv->real_time > 0 )
 	{
-		if ( mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "rendered" ) )
+		struct timeval now;
+		gettimeofday( &now, NULL );
+		pthread_mutex_lock( &priv->done_mutex );
+		priv->clock_time = (int64_t) now.tv_sec * 1000000 + now.tv_usec;
+		priv->clock_position = mlt_frame_get_position( frame );
+		pthread_mutex_unlock( &priv->done_mutex );
+	}
+
+	// Adapt the worker process head to the runtime conditions.
+	if ( priv->real_time > 0 && latency > 0 )
+	{
+		if ( !mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES(frame), atom_rendered) )
+		{
+			int dropped = mlt_properties_get_int_atom( properties, atom_drop_count );
+			mlt_properties_set_int_atom( properties, atom_drop_count, ++dropped );
+			mlt_log_verbose( MLT_CONSUMER_SERVICE(self), "dropped video frame %d\n", dropped );
+		}
+	}
+	else if ( priv->real_time > 0 )
+	{
+		if ( mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_rendered ) )
 		{
 			priv->consecutive_dropped = 0;
 			if ( priv->process_head > threads && priv->consecutive_rendered >= priv->process_head )
@@ -1464,10 +2019,10 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 //			priv->consecutive_dropped, priv->consecutive_rendered, priv->process_head );
 
 		// Check for too many consecutively dropped frames
-		if ( priv->consecutive_dropped > mlt_properties_get_int( properties, "drop_max" ) )
+		if ( priv->consecutive_dropped > mlt_properties_get_int_atom( properties, atom_drop_max ) )
 		{
-			int orig_buffer = mlt_properties_get_int( properties, "buffer" );
-			int prefill = mlt_properties_get_int( properties, "prefill" );
+			int orig_buffer = mlt_properties_get_int_atom( properties, atom_buffer );
+			int prefill = mlt_properties_get_int_atom( properties, atom_prefill );
 			mlt_log_verbose( self, "too many frames dropped - " );
 
 			// If using a default low-latency buffer level (SDL) and below the limit
@@ -1475,21 +2030,21 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 			{
 				// Auto-scale the buffer to compensate
 				mlt_log_verbose( self, "increasing buffer to %d\n", buffer + threads );
-				mlt_properties_set_int( properties, "_buffer", buffer + threads );
+				mlt_properties_set_int_atom( properties, atom_buffer_auto, buffer + threads );
 				priv->consecutive_dropped = priv->fps / 2;
 			}
 			else
 			{
 				// Tell the consumer to render it
 				mlt_log_verbose( self, "forcing next frame\n" );
-				mlt_properties_set_int( MLT_FRAME_PROPERTIES( frame ), "rendered", 1 );
+				mlt_properties_set_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_rendered, 1 );
 				priv->consecutive_dropped = 0;
 			}
 		}
-		if ( !mlt_properties_get_int( MLT_FRAME_PROPERTIES(frame), "rendered") )
+		if ( !mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES(frame), atom_rendered) )
 		{
-			int dropped = mlt_properties_get_int( properties, "drop_count" );
-			mlt_properties_set_int( properties, "drop_count", ++dropped );
+			int dropped = mlt_properties_get_int_atom( properties, atom_drop_count );
+			mlt_properties_set_int_atom( properties, atom_drop_count, ++dropped );
 			mlt_log_verbose( MLT_CONSUMER_SERVICE(self), "dropped video frame %d\n", dropped );
 		}
 	}
@@ -1544,16 +2099,17 @@ mlt_frame mlt_consumer_rt_frame( mlt_consumer self )
 		}
 
 		// Get frame from queue
-		pthread_mutex_lock( &priv->queue_mutex );
+		int64_t trace_begin = mlt_trace_now();
 		mlt_log_timings_begin();
-		while( priv->ahead && mlt_deque_count( priv->queue ) < size )
-			pthread_cond_wait( &priv->queue_cond, &priv->queue_mutex );
-		frame = mlt_deque_pop_front( priv->queue );
+		if ( priv->ring )
+		{
+			mlt_ring_wait_for_items( priv->ring, size );
+			frame = mlt_ring_pop( priv->ring );
+		}
 		mlt_log_timings_end( NULL, "wait_for_frame_queue" );
-		pthread_cond_broadcast( &priv->queue_cond );
-		pthread_mutex_unlock( &priv->queue_mutex );
+		mlt_trace_event( self, "consumer", "wait_for_frame_queue", trace_begin );
 		if ( priv->real_time == 1 && frame &&
-			 !mlt_properties_get_int( MLT_FRAME_PROPERTIES(frame), "rendered" ) )
+			 !mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_rendered ) )
 		{
 			int dropped = mlt_properties_get_int( properties, "drop_count" );
 			mlt_properties_set_int( properties, "drop_count", ++dropped );
@@ -1562,18 +2118,24 @@ mlt_frame mlt_consumer_rt_frame( mlt_consumer self )
 	}
 	else // real_time == 0
 	{
+		// The caller may be an application thread, so only its slices for
+		// this frame take the priority class of the consumer
+		mlt_slices_priority priority = mlt_slices_get_priority();
+
 		if ( !priv->ahead )
 		{
 			priv->ahead = 1;
 			mlt_events_fire( properties, "consumer-thread-started", mlt_event_data_none() );
 		}
 		// Get the frame in non real time
+		mlt_slices_set_priority( consumer_render_priority( self ) );
 		frame = mlt_consumer_get_frame( self );
+		mlt_slices_set_priority( priority );
 
 		// This isn't true, but from the consumers perspective it is
 		if ( frame != NULL )
 		{
-			mlt_properties_set_int( MLT_FRAME_PROPERTIES( frame ), "rendered", 1 );
+			mlt_properties_set_int_atom( MLT_FRAME_PROPERTIES( frame ), atom_rendered, 1 );
 
 			// WebVfx uses this to setup a consumer-stopping event handler.
 			mlt_properties_set_data( MLT_FRAME_PROPERTIES( frame ), "consumer", self, 0, NULL, NULL );
@@ -1615,16 +2177,14 @@ int mlt_consumer_stop( mlt_consumer self )
 
 	// Just in case...
 	mlt_log( MLT_CONSUMER_SERVICE( self ), MLT_LOG_DEBUG, "stopping put waiting\n" );
-	pthread_mutex_lock( &priv->put_mutex );
-	priv->put_active = 0;
-	pthread_cond_broadcast( &priv->put_cond );
-	pthread_mutex_unlock( &priv->put_mutex );
+	atomic_store( &priv->put_active, 0 );
+	mlt_ring_interrupt( priv->put_ring, 1 );
 
 	// Stop the consumer
 	mlt_log( MLT_CONSUMER_SERVICE( self ), MLT_LOG_DEBUG, "stopping consumer\n" );
 	
 	// Cancel the read ahead threads
-	if ( priv->started )
+	if ( priv->started && abs( priv->real_time ) > 1 )
 	{
 		// Unblock the consumer calling mlt_consumer_rt_frame
 		pthread_mutex_lock( &priv->queue_mutex );
@@ -1696,16 +2256,20 @@ void mlt_consumer_close( mlt_consumer self )
 		else
 		{
 			consumer_private *priv = self->local;
+			mlt_frame frame;
 
 			// Make sure it only gets called once
 			self->parent.close = NULL;
 
-			// Destroy the push mutex and condition
-			pthread_mutex_destroy( &priv->put_mutex );
-			pthread_cond_destroy( &priv->put_cond );
+			// Destroy the push queue
+			while ( ( frame = mlt_ring_pop( priv->put_ring ) ) )
+				mlt_frame_close( frame );
+			mlt_ring_close( priv->put_ring );
 
 			pthread_mutex_destroy( &priv->position_mutex );
 
+			mlt_ring_close( priv->ring );
+
 			mlt_service_close( &self->parent );
 			free( priv );
 		}
@@ -37,7 +37,8 @@
  * \properties \em rescale the scaling algorithm to pass on to all scaling
  * filters, defaults to "bilinear"
  * \properties \em buffer the number of frames to use in the asynchronous
- * render thread, defaults to 25
+ * render thread, defaults to 25; it is halved under moderate memory pressure and
+ * quartered under critical memory pressure (see mlt_factory_set_memory_pressure)
  * \properties \em prefill the number of frames to render before commencing
  * output when real_time <> 0, defaults to the size of buffer
  * \properties \em drop_max the maximum number of consecutively dropped frames, defaults to 5
@@ -45,6 +46,10 @@
  * \properties \em channels the number of audio channels to use, defaults to 2
  * \properties \em channel_layout the layout of the audio channels, defaults to auto.
  * other options include: mono, stereo, 5.1, 7.1, etc.
+ * \properties \em resample_quality the audio resampling quality to pass on to all
+ * resampling filters: fast, medium, or best, defaults to "best"
+ * \properties \em put_queue the number of frames that mlt_consumer_put_frame() may queue
+ * before it waits, read when the consumer starts, defaults to 1
  * \properties \em real_time the asynchronous behavior: 1 (default) for asynchronous
  * with frame dropping, -1 for asynchronous without frame dropping, 0 to disable (synchronous)
  * \properties \em test_card the name of a resource to use as the test card, defaults to
@@ -83,8 +88,40 @@
  * \properties \em mlt_image_format the image format to request in rendering threads, defaults to yuv422
  * \properties \em mlt_audio_format the audio format to request in rendering threads, defaults to S16
  * \properties \em audio_off set non-zero to disable audio processing
- * \properties \em video_off set non-zero to disable video processing
+ * \properties \em audio_thread when real_time is more than 1 or less than -1, process audio
+ *   on a separate thread in parallel with the image workers, defaults to 1
+ * \properties \em clone_range when real_time is more than 1 or less than -1, let each worker
+ *   render frames from a different range of this many positions so producers with a \p clone_pool
+ *   decode them with separate clones. Set it to the \p clone_range of those producers. The queue
+ *   grows to hold a range for each worker unless \p latency is set, but to at most four times
+ *   \p buffer, which bounds the frames held in memory, defaults to 0 (off)
+ * \properties \em video_off set non-zero to disable video processing, which also marks the frames so that producers, filters and transitions skip their image work
  * \properties \em drop_count the number of video frames not rendered since starting consumer
+ * \properties \em latency when real_time is more than 1 or less than -1, the target latency in
+ *   milliseconds. When set, the buffer depth and worker look-ahead follow the measured render time
+ *   instead of \p buffer and \p drop_max, defaults to 0 (off)
+ * \properties \em latency_render_time the average image render time in milliseconds (read only)
+ * \properties \em latency_buffer the number of frames queued for the target latency (read only)
+ * \properties \em latency_lookahead the number of frames at the head of the queue the workers
+ *   skip because they would not be ready in time (read only)
+ * \properties \em latency_estimate the latency of the queue in milliseconds (read only)
+ * \properties \em proxy set non-zero to let producers that have a proxy, such as the
+ *   proxy producer, render from it, intended for previews; frames get it as consumer_proxy
+ * \properties \em optimise set non-zero to simplify the nested playlists and tractors of the
+ *   producer with mlt_producer_simplify() when starting, which changes its playlists
+ * \properties \em cpus a list of CPUs such as "0-7,16-23" to restrict the read ahead, audio
+ *   and worker threads to (Linux only)
+ * \properties \em numa set non-zero to bind the worker threads to the NUMA nodes in turn,
+ *   use it with MLT_SLICES_NUMA so each worker runs its slices on its own node (Linux only)
+ * \properties \em render_priority the priority class of the slices run while rendering:
+ *   high (or 1) for an interactive preview, normal (or 0, the default), or low (or -1) for
+ *   background work; the queued slices of a higher class start first, and on Linux the threads
+ *   of a low priority consumer also get a lower scheduling priority
+ * \properties \em adaptive_scale set non-zero to render images at a half or a quarter of the
+ *   consumer size while playing when rendering does not keep up, and to restore the full size
+ *   when it does; frames get the scale as consumer_scale, intended for previews with a consumer
+ *   that accepts images of any size
+ * \properties \em adaptive_scale_factor the current scale of adaptive_scale (read only)
  */
 
 struct mlt_consumer_s
@@ -140,6 +177,10 @@ extern int mlt_consumer_connect( mlt_consumer self, mlt_service producer );
 extern int mlt_consumer_start( mlt_consumer self );
 extern void mlt_consumer_purge( mlt_consumer self );
 extern int mlt_consumer_put_frame( mlt_consumer self, mlt_frame frame );
+extern int mlt_consumer_try_put_frame( mlt_consumer self, mlt_frame frame );
+extern int mlt_consumer_wait_for_put_space( mlt_consumer self );
+extern int mlt_consumer_put_depth( mlt_consumer self );
+extern int mlt_consumer_queue_depth( mlt_consumer self );
 extern mlt_frame mlt_consumer_get_frame( mlt_consumer self );
 extern mlt_frame mlt_consumer_rt_frame( mlt_consumer self );
 extern int mlt_consumer_stop( mlt_consumer self );
@@ -0,0 +1,211 @@
+/**
+ * \file mlt_cpu.c
+ * \brief runtime CPU feature detection and dispatch
+ *
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Local header files
+#include "mlt_cpu.h"
+#include "mlt_log.h"
+
+// System header files
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_IX86) )
+#include <intrin.h>
+#elif defined(__linux__) && defined(__arm__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#endif
+
+static int g_flags = 0;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+static const struct
+{
+	int flag;
+	const char *name;
+}
+flag_names[] =
+{
+	{ mlt_cpu_mmx, "mmx" },
+	{ mlt_cpu_sse, "sse" },
+	{ mlt_cpu_sse2, "sse2" },
+	{ mlt_cpu_sse3, "sse3" },
+	{ mlt_cpu_ssse3, "ssse3" },
+	{ mlt_cpu_sse41, "sse4.1" },
+	{ mlt_cpu_sse42, "sse4.2" },
+	{ mlt_cpu_avx, "avx" },
+	{ mlt_cpu_avx2, "avx2" },
+	{ mlt_cpu_fma, "fma" },
+	{ mlt_cpu_avx512f, "avx512f" },
+	{ mlt_cpu_avx512bw, "avx512bw" },
+	{ mlt_cpu_neon, "neon" },
+	{ mlt_cpu_altivec, "altivec" },
+};
+
+static int detect_flags( void )
+{
+	int flags = 0;
+
+#if ( defined(__GNUC__) || defined(__clang__) ) && ( defined(__x86_64__) || defined(__i386__) )
+	// The compiler runtime also checks that the OS saves the wider registers
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports( "mmx" ) ) flags |= mlt_cpu_mmx;
+	if ( __builtin_cpu_supports( "sse" ) ) flags |= mlt_cpu_sse;
+	if ( __builtin_cpu_supports( "sse2" ) ) flags |= mlt_cpu_sse2;
+	if ( __builtin_cpu_supports( "sse3" ) ) flags |= mlt_cpu_sse3;
+	if ( __builtin_cpu_supports( "ssse3" ) ) flags |= mlt_cpu_ssse3;
+	if ( __builtin_cpu_supports( "sse4.1" ) ) flags |= mlt_cpu_sse41;
+	if ( __builtin_cpu_supports( "sse4.2" ) ) flags |= mlt_cpu_sse42;
+	if ( __builtin_cpu_supports( "avx" ) ) flags |= mlt_cpu_avx;
+	if ( __builtin_cpu_supports( "avx2" ) ) flags |= mlt_cpu_avx2;
+	if ( __builtin_cpu_supports( "fma" ) ) flags |= mlt_cpu_fma;
+	if ( __builtin_cpu_supports( "avx512f" ) ) flags |= mlt_cpu_avx512f;
+	if ( __builtin_cpu_supports( "avx512bw" ) ) flags |= mlt_cpu_avx512bw;
+#elif defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_IX86) )
+	int info[4];
+	unsigned long long xcr0 = 0;
+
+	__cpuid( info, 1 );
+	if ( info[3] & ( 1 << 23 ) ) flags |= mlt_cpu_mmx;
+	if ( info[3] & ( 1 << 25 ) ) flags |= mlt_cpu_sse;
+	if ( info[3] & ( 1 << 26 ) ) flags |= mlt_cpu_sse2;
+	if ( info[2] & ( 1 << 0 ) ) flags |= mlt_cpu_sse3;
+	if ( info[2] & ( 1 << 9 ) ) flags |= mlt_cpu_ssse3;
+	if ( info[2] & ( 1 << 19 ) ) flags |= mlt_cpu_sse41;
+	if ( info[2] & ( 1 << 20 ) ) flags |= mlt_cpu_sse42;
+	if ( info[2] & ( 1 << 27 ) )
+		xcr0 = _xgetbv( 0 );
+	// AVX needs the OS to save the YMM registers and AVX-512 also the ZMM ones
+	if ( ( xcr0 & 0x6 ) == 0x6 )
+	{
+		if ( info[2] & ( 1 << 28 ) ) flags |= mlt_cpu_avx;
+		if ( info[2] & ( 1 << 12 ) ) flags |= mlt_cpu_fma;
+		__cpuidex( info, 7, 0 );
+		if ( info[1] & ( 1 << 5 ) ) flags |= mlt_cpu_avx2;
+		if ( ( xcr0 & 0xe6 ) == 0xe6 )
+		{
+			if ( info[1] & ( 1 << 16 ) ) flags |= mlt_cpu_avx512f;
+			if ( info[1] & ( 1 << 30 ) ) flags |= mlt_cpu_avx512bw;
+		}
+	}
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	flags |= mlt_cpu_neon;
+#elif defined(__linux__) && defined(__arm__)
+	if ( getauxval( AT_HWCAP ) & HWCAP_NEON )
+		flags |= mlt_cpu_neon;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	flags |= mlt_cpu_neon;
+#elif defined(__ALTIVEC__)
+	flags |= mlt_cpu_altivec;
+#endif
+
+	return flags;
+}
+
+static void cpu_init( void )
+{
+	const char *mask = getenv( "MLT_CPU_FLAGS" );
+	char names[256];
+
+	g_flags = detect_flags();
+	if ( mask && strlen( mask ) )
+		g_flags &= (int) strtol( mask, NULL, 0 );
+	mlt_log_verbose( NULL, "[cpu] features: %s\n", mlt_cpu_flags_string( g_flags, names, sizeof( names ) ) );
+}
+
+/** Get the instruction set extensions of the running CPU.
+ *
+ * The result is detected once and combines mlt_cpu_flag values. Set the
+ * environment variable MLT_CPU_FLAGS to a mask to hide features, for example
+ * 0 to run only the portable code or 0x7 to stop at SSE2.
+ *
+ * \return the available features
+ */
+
+int mlt_cpu_flags( void )
+{
+	pthread_once( &g_once, cpu_init );
+	return g_flags;
+}
+
+/** Determine if the running CPU has all of some features.
+ *
+ * \param flags a combination of mlt_cpu_flag values
+ * \return true if every one of the features is available
+ */
+
+int mlt_cpu_has( int flags )
+{
+	return ( mlt_cpu_flags() & flags ) == flags;
+}
+
+/** Choose the best implementation the running CPU supports from a dispatch table.
+ *
+ * The table is searched in order, so list the most demanding implementation first
+ * and end with one whose flags are 0. Call this once and keep the result, for
+ * example in a static function pointer, rather than on every line of an image.
+ *
+ * \param table an array of implementations ending with one that requires no features
+ * \return the function of the first entry whose features are all available
+ */
+
+void *mlt_cpu_select( const mlt_cpu_dispatch *table )
+{
+	if ( !table )
+		return NULL;
+	for ( ; table->flags; table++ )
+		if ( mlt_cpu_has( table->flags ) )
+			return table->function;
+	return table->function;
+}
+
+/** Format features as a list of names separated by spaces.
+ *
+ * \param flags a combination of mlt_cpu_flag values
+ * \param buffer a string buffer to receive the names
+ * \param size the size of the buffer
+ * \return the buffer
+ */
+
+const char *mlt_cpu_flags_string( int flags, char *buffer, int size )
+{
+	int length = 0;
+
+	if ( !buffer || size <= 0 )
+		return buffer;
+	buffer[0] = '\0';
+	for ( size_t i = 0; i < sizeof( flag_names ) / sizeof( flag_names[0] ); i++ )
+	{
+		if ( !( flags & flag_names[i].flag ) )
+			continue;
+		int n = strlen( flag_names[i].name ) + ( length > 0 );
+		if ( length + n >= size )
+			break;
+		if ( length > 0 )
+			buffer[length++] = ' ';
+		strcpy( buffer + length, flag_names[i].name );
+		length += strlen( flag_names[i].name );
+	}
+	return buffer;
+}
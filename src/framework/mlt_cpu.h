@@ -0,0 +1,64 @@
+/**
+ * \file mlt_cpu.h
+ * \brief runtime CPU feature detection and dispatch
+ *
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MLT_CPU_H
+#define MLT_CPU_H
+
+/** The instruction set extensions that mlt_cpu_flags() can report */
+
+typedef enum
+{
+	mlt_cpu_mmx      = 1 << 0,
+	mlt_cpu_sse      = 1 << 1,
+	mlt_cpu_sse2     = 1 << 2,
+	mlt_cpu_sse3     = 1 << 3,
+	mlt_cpu_ssse3    = 1 << 4,
+	mlt_cpu_sse41    = 1 << 5,
+	mlt_cpu_sse42    = 1 << 6,
+	mlt_cpu_avx      = 1 << 7,
+	mlt_cpu_avx2     = 1 << 8,
+	mlt_cpu_fma      = 1 << 9,
+	mlt_cpu_avx512f  = 1 << 10,
+	mlt_cpu_avx512bw = 1 << 11,
+	mlt_cpu_neon     = 1 << 16,
+	mlt_cpu_altivec  = 1 << 24
+}
+mlt_cpu_flag;
+
+/** An entry of a dispatch table: a function and the features it requires.
+ *
+ * A table lists the best implementation first and ends with an entry that
+ * requires nothing, usually the portable C version.
+ */
+
+typedef struct
+{
+	int flags;        /**< a combination of mlt_cpu_flag values */
+	void *function;   /**< the implementation */
+}
+mlt_cpu_dispatch;
+
+extern int mlt_cpu_flags( void );
+extern int mlt_cpu_has( int flags );
+extern void *mlt_cpu_select( const mlt_cpu_dispatch *table );
+extern const char *mlt_cpu_flags_string( int flags, char *buffer, int size );
+
+#endif
@@ -40,19 +40,39 @@ typedef union
 }
 deque_entry;
 
+/** The number of entries stored in the deque itself, enough for most frame stacks */
+
+#define DEQUE_INLINE_SIZE 8
+
 /** \brief Double-Ended Queue (deque) class
  *
  * The double-ended queue is a very versatile data structure. MLT uses it as
  * list, stack, and circular queue.
+ *
+ * The entries are in a circular buffer whose size is a power of two, so
+ * both ends are O(1). The buffer is in the deque until it needs more than
+ * DEQUE_INLINE_SIZE entries.
  */
 
 struct mlt_deque_s
 {
 	deque_entry *list;
 	int size;
+	int head;
 	atomic_int count;
+	deque_entry inline_list[ DEQUE_INLINE_SIZE ];
 };
 
+/** Get an entry by its position from the front.
+ *
+ * \private \memberof mlt_deque_s
+ */
+
+static inline deque_entry *mlt_deque_entry( mlt_deque self, int index )
+{
+	return &self->list[ ( self->head + index ) & ( self->size - 1 ) ];
+}
+
 /** Create a deque.
  *
  * \public \memberof mlt_deque_s
@@ -62,6 +82,11 @@ struct mlt_deque_s
 mlt_deque mlt_deque_init( )
 {
 	mlt_deque self = calloc( 1, sizeof( struct mlt_deque_s ) );
+	if ( self )
+	{
+		self->list = self->inline_list;
+		self->size = DEQUE_INLINE_SIZE;
+	}
 	return self;
 }
 
@@ -91,10 +116,52 @@ static int mlt_deque_allocate( mlt_deque self )
 {
 	if ( self->count == self->size )
 	{
-		self->list = realloc( self->list, sizeof( deque_entry ) * ( self->size + 20 ) );
-		self->size += 20;
+		deque_entry *list = malloc( sizeof( deque_entry ) * self->size * 2 );
+		int first = self->size - self->head;
+
+		if ( list == NULL )
+			return 1;
+		// Unwrap the entries to the start of the new buffer
+		memcpy( list, &self->list[ self->head ], sizeof( deque_entry ) * first );
+		memcpy( &list[ first ], self->list, sizeof( deque_entry ) * self->head );
+		if ( self->list != self->inline_list )
+			free( self->list );
+		self->list = list;
+		self->head = 0;
+		self->size *= 2;
 	}
-	return self->list == NULL;
+	return 0;
+}
+
+/** Make room for an item at the start.
+ *
+ * \private \memberof mlt_deque_s
+ * \param self a deque
+ * \return the new first entry or NULL if there was an error
+ */
+
+static deque_entry *mlt_deque_allocate_front( mlt_deque self )
+{
+	if ( mlt_deque_allocate( self ) )
+		return NULL;
+	self->head = ( self->head - 1 ) & ( self->size - 1 );
+	self->count ++;
+	return mlt_deque_entry( self, 0 );
+}
+
+/** Remove the first entry.
+ *
+ * \private \memberof mlt_deque_s
+ * \param self a deque
+ * \return the entry, which remains valid until the next push
+ */
+
+static deque_entry *mlt_deque_take_front( mlt_deque self )
+{
+	deque_entry *entry = mlt_deque_entry( self, 0 );
+	self->head = ( self->head + 1 ) & ( self->size - 1 );
+	self->count --;
+	return entry;
 }
 
 /** Push an item to the end.
@@ -110,7 +177,10 @@ int mlt_deque_push_back( mlt_deque self, void *item )
 	int error = mlt_deque_allocate( self );
 
 	if ( error == 0 )
-		self->list[ self->count ++ ].addr = item;
+	{
+		mlt_deque_entry( self, self->count )->addr = item;
+		self->count ++;
+	}
 
 	return error;
 }
@@ -124,7 +194,7 @@ int mlt_deque_push_back( mlt_deque self, void *item )
 
 void *mlt_deque_pop_back( mlt_deque self )
 {
-	return self->count > 0 ? self->list[ -- self->count ].addr : NULL;
+	return self->count > 0 ? mlt_deque_entry( self, -- self->count )->addr : NULL;
 }
 
 /** Queue an item at the start.
@@ -137,15 +207,12 @@ void *mlt_deque_pop_back( mlt_deque self )
 
 int mlt_deque_push_front( mlt_deque self, void *item )
 {
-	int error = mlt_deque_allocate( self );
+	deque_entry *entry = mlt_deque_allocate_front( self );
 
-	if ( error == 0 )
-	{
-		memmove( &self->list[ 1 ], self->list, ( self->count ++ ) * sizeof( deque_entry ) );
-		self->list[ 0 ].addr = item;
-	}
+	if ( entry != NULL )
+		entry->addr = item;
 
-	return error;
+	return entry == NULL;
 }
 
 /** Remove an item from the start.
@@ -160,10 +227,7 @@ void *mlt_deque_pop_front( mlt_deque self )
 	void *item = NULL;
 
 	if ( self->count > 0 )
-	{
-		item = self->list[ 0 ].addr;
-		memmove( self->list, &self->list[ 1 ], ( -- self->count ) * sizeof( deque_entry ) );
-	}
+		item = mlt_deque_take_front( self )->addr;
 
 	return item;
 }
@@ -177,7 +241,7 @@ void *mlt_deque_pop_front( mlt_deque self )
 
 void *mlt_deque_peek_back( mlt_deque self )
 {
-	return self->count > 0 ? self->list[ self->count - 1 ].addr : NULL;
+	return self->count > 0 ? mlt_deque_entry( self, self->count - 1 )->addr : NULL;
 }
 
 /** Inquire on item at front of deque but don't remove.
@@ -189,7 +253,7 @@ void *mlt_deque_peek_back( mlt_deque self )
 
 void *mlt_deque_peek_front( mlt_deque self )
 {
-	return self->count > 0 ? self->list[ 0 ].addr : NULL;
+	return self->count > 0 ? mlt_deque_entry( self, 0 )->addr : NULL;
 }
 
 /** Inquire on item in deque but don't remove.
@@ -202,7 +266,7 @@ void *mlt_deque_peek_front( mlt_deque self )
 
 void *mlt_deque_peek( mlt_deque self, int index )
 {
-	return self->count > index ? self->list[ index ].addr : NULL;
+	return index >= 0 && self->count > index ? mlt_deque_entry( self, index )->addr : NULL;
 }
 
 /** Insert an item in a sorted fashion.
@@ -223,11 +287,13 @@ int mlt_deque_insert( mlt_deque self, void *item, mlt_deque_compare cmp )
 	if ( error == 0 )
 	{
 		int n = self->count + 1;
+		int i;
 		while ( --n )
-			if ( cmp( item, self->list[ n - 1 ].addr ) >= 0 )
+			if ( cmp( item, mlt_deque_entry( self, n - 1 )->addr ) >= 0 )
 				break;
-		memmove( &self->list[ n + 1 ], &self->list[ n ], ( self->count - n ) * sizeof( deque_entry ) );
-		self->list[ n ].addr = item;
+		for ( i = self->count; i > n; i -- )
+			*mlt_deque_entry( self, i ) = *mlt_deque_entry( self, i - 1 );
+		mlt_deque_entry( self, n )->addr = item;
 		self->count++;
 	}
 	return error;
@@ -246,7 +312,10 @@ int mlt_deque_push_back_int( mlt_deque self, int item )
 	int error = mlt_deque_allocate( self );
 
 	if ( error == 0 )
-		self->list[ self->count ++ ].value = item;
+	{
+		mlt_deque_entry( self, self->count )->value = item;
+		self->count ++;
+	}
 
 	return error;
 }
@@ -260,7 +329,7 @@ int mlt_deque_push_back_int( mlt_deque self, int item )
 
 int mlt_deque_pop_back_int( mlt_deque self )
 {
-	return self->count > 0 ? self->list[ -- self->count ].value : 0;
+	return self->count > 0 ? mlt_deque_entry( self, -- self->count )->value : 0;
 }
 
 /** Queue an integer at the start.
@@ -273,15 +342,12 @@ int mlt_deque_pop_back_int( mlt_deque self )
 
 int mlt_deque_push_front_int( mlt_deque self, int item )
 {
-	int error = mlt_deque_allocate( self );
+	deque_entry *entry = mlt_deque_allocate_front( self );
 
-	if ( error == 0 )
-	{
-		memmove( &self->list[ 1 ], self->list, ( self->count ++ ) * sizeof( deque_entry ) );
-		self->list[ 0 ].value = item;
-	}
+	if ( entry != NULL )
+		entry->value = item;
 
-	return error;
+	return entry == NULL;
 }
 
 /** Remove an integer from the start.
@@ -296,10 +362,7 @@ int mlt_deque_pop_front_int( mlt_deque self )
 	int item = 0;
 
 	if ( self->count > 0 )
-	{
-		item = self->list[ 0 ].value;
-		memmove( self->list, &self->list[ 1 ], ( -- self->count ) * sizeof( deque_entry ) );
-	}
+		item = mlt_deque_take_front( self )->value;
 
 	return item;
 }
@@ -313,7 +376,7 @@ int mlt_deque_pop_front_int( mlt_deque self )
 
 int mlt_deque_peek_back_int( mlt_deque self )
 {
-	return self->count > 0 ? self->list[ self->count - 1 ].value : 0;
+	return self->count > 0 ? mlt_deque_entry( self, self->count - 1 )->value : 0;
 }
 
 /** Inquire on an integer at front of deque but don't remove.
@@ -325,7 +388,7 @@ int mlt_deque_peek_back_int( mlt_deque self )
 
 int mlt_deque_peek_front_int( mlt_deque self )
 {
-	return self->count > 0 ? self->list[ 0 ].value : 0;
+	return self->count > 0 ? mlt_deque_entry( self, 0 )->value : 0;
 }
 
 /** Push a double float to the end.
@@ -341,7 +404,10 @@ int mlt_deque_push_back_double( mlt_deque self, double item )
 	int error = mlt_deque_allocate( self );
 
 	if ( error == 0 )
-		self->list[ self->count ++ ].floating = item;
+	{
+		mlt_deque_entry( self, self->count )->floating = item;
+		self->count ++;
+	}
 
 	return error;
 }
@@ -355,7 +421,7 @@ int mlt_deque_push_back_double( mlt_deque self, double item )
 
 double mlt_deque_pop_back_double( mlt_deque self )
 {
-	return self->count > 0 ? self->list[ -- self->count ].floating : 0;
+	return self->count > 0 ? mlt_deque_entry( self, -- self->count )->floating : 0;
 }
 
 /** Queue a double float at the start.
@@ -368,15 +434,12 @@ double mlt_deque_pop_back_double( mlt_deque self )
 
 int mlt_deque_push_front_double( mlt_deque self, double item )
 {
-	int error = mlt_deque_allocate( self );
+	deque_entry *entry = mlt_deque_allocate_front( self );
 
-	if ( error == 0 )
-	{
-		memmove( &self->list[ 1 ], self->list, ( self->count ++ ) * sizeof( deque_entry ) );
-		self->list[ 0 ].floating = item;
-	}
+	if ( entry != NULL )
+		entry->floating = item;
 
-	return error;
+	return entry == NULL;
 }
 
 /** Remove a double float from the start.
@@ -391,10 +454,7 @@ double mlt_deque_pop_front_double( mlt_deque self )
 	double item = 0;
 
 	if ( self->count > 0 )
-	{
-		item = self->list[ 0 ].floating;
-		memmove( self->list, &self->list[ 1 ], ( -- self->count ) * sizeof( deque_entry ) );
-	}
+		item = mlt_deque_take_front( self )->floating;
 
 	return item;
 }
@@ -408,7 +468,7 @@ double mlt_deque_pop_front_double( mlt_deque self )
 
 double mlt_deque_peek_back_double( mlt_deque self )
 {
-	return self->count > 0 ? self->list[ self->count - 1 ].floating : 0;
+	return self->count > 0 ? mlt_deque_entry( self, self->count - 1 )->floating : 0;
 }
 
 /** Inquire on a double float at front of deque but don't remove.
@@ -420,7 +480,7 @@ double mlt_deque_peek_back_double( mlt_deque self )
 
 double mlt_deque_peek_front_double( mlt_deque self )
 {
-	return self->count > 0 ? self->list[ 0 ].floating : 0;
+	return self->count > 0 ? mlt_deque_entry( self, 0 )->floating : 0;
 }
 
 /** Destroy the queue.
@@ -431,6 +491,7 @@ double mlt_deque_peek_front_double( mlt_deque self )
 
 void mlt_deque_close( mlt_deque self )
 {
-	free( self->list );
+	if ( self->list != self->inline_list )
+		free( self->list );
 	free( self );
 }
@@ -49,6 +49,8 @@ struct mlt_events_struct
 {
 	mlt_properties owner;
 	mlt_properties listeners;
+	int listener_count;              // the listeners ever added, for a quick mlt_events_fire()
+	mlt_properties property_changed; // the listeners of the most frequent event
 };
 
 typedef struct mlt_events_struct *mlt_events;
@@ -130,6 +132,14 @@ void mlt_event_close( mlt_event self )
 static mlt_events mlt_events_fetch( mlt_properties );
 static void mlt_events_close( mlt_events );
 
+static mlt_property_atom events_atom = NULL;
+static pthread_once_t events_once = PTHREAD_ONCE_INIT;
+
+static void events_atom_init( void )
+{
+	events_atom = mlt_atom( "_events" );
+}
+
 /** Initialise the events structure.
  *
  * \public \memberof mlt_events_struct
@@ -167,7 +177,12 @@ int mlt_events_register(mlt_properties self, const char *id)
 		char temp[ 128 ];
 		sprintf( temp, "list:%s", id );
 		if ( mlt_properties_get_data( list, temp, NULL ) == NULL )
-			mlt_properties_set_data( list, temp, mlt_properties_new( ), 0, ( mlt_destructor )mlt_properties_close, NULL );
+		{
+			mlt_properties listeners = mlt_properties_new( );
+			mlt_properties_set_data( list, temp, listeners, 0, ( mlt_destructor )mlt_properties_close, NULL );
+			if ( !strcmp( id, "property-changed" ) )
+				events->property_changed = listeners;
+		}
 	}
 	return error;
 }
@@ -185,13 +200,19 @@ int mlt_events_fire(mlt_properties self, const char *id, mlt_event_data event_da
 {
 	int result = 0;
 	mlt_events events = mlt_events_fetch( self );
-	if ( events != NULL )
+	if ( events != NULL && events->listener_count > 0 )
 	{
-		mlt_properties list = events->listeners;
 		mlt_properties listeners = NULL;
-		char temp[ 128 ];
-		sprintf( temp, "list:%s", id );
-		listeners = mlt_properties_get_data( list, temp, NULL );
+		if ( events->property_changed && !strcmp( id, "property-changed" ) )
+		{
+			listeners = events->property_changed;
+		}
+		else
+		{
+			char temp[ 128 ];
+			sprintf( temp, "list:%s", id );
+			listeners = mlt_properties_get_data( events->listeners, temp, NULL );
+		}
 
 		if ( listeners != NULL )
 		{
@@ -264,6 +285,7 @@ mlt_event mlt_events_listen( mlt_properties self, void *listener_data, const cha
 					event->listener_data = listener_data;
 					mlt_properties_set_data( listeners, temp, event, 0, ( mlt_destructor )mlt_event_close, NULL );
 					mlt_event_inc_ref( event );
+					events->listener_count ++;
 				}
 			}
 
@@ -453,7 +475,10 @@ static mlt_events mlt_events_fetch( mlt_properties self )
 {
 	mlt_events events = NULL;
 	if ( self != NULL )
-		events = mlt_properties_get_data( self, "_events", NULL );
+	{
+		pthread_once( &events_once, events_atom_init );
+		events = mlt_properties_get_data_atom( self, events_atom, NULL );
+	}
 	return events;
 }
 
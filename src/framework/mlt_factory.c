@@ -27,6 +27,11 @@
 #include <string.h>
 #include <locale.h>
 #include <libgen.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 /** the default subdirectory of the datadir for holding presets */
 #define PRESETS_DIR "/presets"
@@ -68,6 +73,12 @@ static mlt_repository repository = NULL;
 static mlt_properties event_object = NULL;
 /** for tracking the unique_id set on each constructed service */
 static int unique_id = 0;
+/** the current level of memory pressure */
+static atomic_int memory_pressure = mlt_memory_pressure_none;
+/** the time in microseconds of the last check of the memory use */
+static atomic_llong memory_checked = 0;
+/** the memory limit from MLT_MEMORY_LIMIT, 0 for the cgroup limit, -1 for none */
+static atomic_llong memory_limit = 0;
 
 #if defined(_WIN32) || (defined(__APPLE__) && defined(RELOCATABLE))
 // Replacement for buggy dirname() on some systems.
@@ -97,6 +108,11 @@ static char* mlt_dirname( char *path )
 #endif
 
 /** Construct the repository and factories.
+ *
+ * If the environment variable MLT_TRACE names a file, a trace of the
+ * rendering is recorded into it until mlt_factory_close() (see mlt_trace_start()).
+ * If MLT_PERF_COUNTERS is set to a non-zero value, per-service performance
+ * counters are collected (see mlt_service_perf_stats()).
  *
  * \param directory an optional full path to a directory containing the modules that overrides the default and
  * the MLT_REPOSITORY environment variable
@@ -113,6 +129,12 @@ mlt_repository mlt_factory_init( const char *directory )
 #endif
 	setlocale( LC_ALL, locale );
 
+	// Record a trace of the rendering if requested
+	if ( getenv( "MLT_TRACE" ) )
+		mlt_trace_start( getenv( "MLT_TRACE" ) );
+	if ( getenv( "MLT_PERF_COUNTERS" ) && atoi( getenv( "MLT_PERF_COUNTERS" ) ) )
+		mlt_trace_set_counters( 1 );
+
 	if ( ! global_properties )
 		global_properties = mlt_properties_new( );
 
@@ -196,6 +218,19 @@ mlt_repository mlt_factory_init( const char *directory )
 		mlt_events_register( event_object, "transition-create-done" );
 		mlt_events_register( event_object, "consumer-create-request" );
 		mlt_events_register( event_object, "consumer-create-done" );
+		mlt_events_register( event_object, "memory-pressure" );
+
+		// Get the memory limit for the memory pressure
+		char *limit = getenv( "MLT_MEMORY_LIMIT" );
+		if ( limit )
+		{
+			char *end = NULL;
+			long long bytes = strtoll( limit, &end, 10 );
+			if ( end && ( *end == 'k' || *end == 'K' ) ) bytes <<= 10;
+			else if ( end && ( *end == 'm' || *end == 'M' ) ) bytes <<= 20;
+			else if ( end && ( *end == 'g' || *end == 'G' ) ) bytes <<= 30;
+			atomic_store( &memory_limit, bytes > 0 ? bytes : -1 );
+		}
 
 		// Create the repository of services
 		repository = mlt_repository_init( mlt_directory );
@@ -542,6 +577,7 @@ void mlt_factory_close( )
 		}
 		free( mlt_directory );
 		mlt_directory = NULL;
+		mlt_trace_stop( );
 		mlt_pool_close( );
 	}
 }
@@ -550,3 +586,178 @@ mlt_properties mlt_global_properties( )
 {
 	return global_properties;
 }
+
+/** Set the level of memory pressure.
+ *
+ * Under pressure the memory pool is purged and the caches are trimmed, to a
+ * half under moderate pressure and fully under critical pressure, every time
+ * this is called. The consumers buffer fewer frames and producers keep fewer
+ * frames cached while the level remains, so the processing slows down instead
+ * of running out of memory. Applications can call this when the system tells
+ * them memory is low, and the factory fires memory-pressure when the level
+ * changes so other services can release memory too.
+ *
+ * \param level the level of memory pressure
+ */
+
+void mlt_factory_set_memory_pressure( mlt_memory_pressure level )
+{
+	if ( level < mlt_memory_pressure_none )
+		level = mlt_memory_pressure_none;
+	else if ( level > mlt_memory_pressure_critical )
+		level = mlt_memory_pressure_critical;
+
+	int previous = atomic_exchange( &memory_pressure, level );
+	if ( level > mlt_memory_pressure_none )
+	{
+		mlt_pool_purge( );
+		mlt_cache_trim( level == mlt_memory_pressure_critical ? 0 : mlt_cache_get_total_bytes( ) / 2 );
+	}
+	if ( level != previous )
+	{
+		mlt_log_info( NULL, "[factory] memory pressure %d\n", level );
+		if ( event_object )
+			mlt_events_fire( event_object, "memory-pressure", mlt_event_data_from_int( level ) );
+	}
+}
+
+/** Get the level of memory pressure.
+ *
+ * \return the level of memory pressure
+ */
+
+mlt_memory_pressure mlt_factory_get_memory_pressure( )
+{
+	return atomic_load( &memory_pressure );
+}
+
+/** Read a number of bytes from a file.
+ *
+ * \param path the name of a file
+ * \return the number, or -1 if it could not be read or is not a number
+ */
+
+static long long read_bytes( const char *path )
+{
+	long long bytes = -1;
+	FILE *file = fopen( path, "r" );
+	if ( file )
+	{
+		if ( fscanf( file, "%lld", &bytes ) != 1 )
+			bytes = -1;
+		fclose( file );
+	}
+	return bytes;
+}
+
+/** Read a number from a file of names and numbers, such as memory.stat of a cgroup.
+ *
+ * \param path the name of a file
+ * \param name the name of the number
+ * \return the number, or -1 if it could not be read
+ */
+
+static long long read_stat( const char *path, const char *name )
+{
+	long long bytes = -1, value;
+	char key[64];
+	FILE *file = fopen( path, "r" );
+	if ( file )
+	{
+		while ( bytes < 0 && fscanf( file, "%63s %lld", key, &value ) == 2 )
+			if ( !strcmp( key, name ) )
+				bytes = value;
+		fclose( file );
+	}
+	return bytes;
+}
+
+/** Update the level of memory pressure from a reading of the memory use.
+ *
+ * The pressure is moderate from 75% of the limit and critical from 90%.
+ * Critical pressure eases to moderate below 75%, and the pressure ends below
+ * 65%. This calls mlt_factory_set_memory_pressure() only when the level
+ * changes, so the pool and caches are not purged again at every reading.
+ *
+ * \param used the number of bytes in use
+ * \param limit the number of bytes that can be used
+ * \return the level of memory pressure
+ */
+
+mlt_memory_pressure mlt_factory_update_memory_pressure( int64_t used, int64_t limit )
+{
+	int previous = atomic_load( &memory_pressure );
+	int level = previous;
+
+	if ( limit <= 0 )
+		return previous;
+	if ( used * 10 >= limit * 9 )
+		level = mlt_memory_pressure_critical;
+	else if ( used * 4 >= limit * 3 )
+		level = level == mlt_memory_pressure_critical ? level : mlt_memory_pressure_moderate;
+	else if ( used * 20 < limit * 13 )
+		level = mlt_memory_pressure_none;
+	else if ( level == mlt_memory_pressure_critical )
+		level = mlt_memory_pressure_moderate;
+	if ( level != previous )
+		mlt_factory_set_memory_pressure( level );
+	return level;
+}
+
+/** Update the level of memory pressure from the memory use.
+ *
+ * With MLT_MEMORY_LIMIT the resident memory of the process is compared to
+ * the limit, otherwise on Linux the anonymous memory of the cgroup to its
+ * limit. The page cache is left out of the cgroup, because the kernel
+ * reclaims it before running out. See mlt_factory_update_memory_pressure()
+ * for the levels. This is cheap to call often because the memory use is
+ * checked at most four times a second. The consumers call it for each frame.
+ */
+
+void mlt_factory_check_memory( )
+{
+	struct timeval tv;
+	long long now, checked, used = -1, limit = atomic_load( &memory_limit );
+
+	if ( limit < 0 )
+		return;
+	gettimeofday( &tv, NULL );
+	now = (long long) tv.tv_sec * 1000000 + tv.tv_usec;
+	checked = atomic_load( &memory_checked );
+	if ( now - checked < 250000 || !atomic_compare_exchange_strong( &memory_checked, &checked, now ) )
+		return;
+
+	if ( limit > 0 )
+	{
+#ifdef __linux__
+		FILE *file = fopen( "/proc/self/statm", "r" );
+		long long size, resident;
+		if ( file )
+		{
+			if ( fscanf( file, "%lld %lld", &size, &resident ) == 2 )
+				used = resident * sysconf( _SC_PAGESIZE );
+			fclose( file );
+		}
+#endif
+		if ( used < 0 )
+			used = mlt_pool_allocated_bytes( ) + mlt_cache_get_total_bytes( );
+	}
+	else
+	{
+#ifdef __linux__
+		// cgroup v2, then v1, where a huge number means no limit
+		limit = read_bytes( "/sys/fs/cgroup/memory.max" );
+		if ( limit > 0 )
+			used = read_stat( "/sys/fs/cgroup/memory.stat", "anon" );
+		else if ( ( limit = read_bytes( "/sys/fs/cgroup/memory/memory.limit_in_bytes" ) ) > 0 )
+			used = read_stat( "/sys/fs/cgroup/memory/memory.stat", "total_rss" );
+		if ( limit <= 0 || limit >= ( 1LL << 60 ) || used < 0 )
+#endif
+		{
+			// There is no limit to check against
+			atomic_store( &memory_limit, -1 );
+			return;
+		}
+	}
+	mlt_factory_update_memory_pressure( used, limit );
+}
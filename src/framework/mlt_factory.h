@@ -34,7 +34,13 @@
  * \envvar \em MLT_PROFILE selects the default mlt_profile_s, defaults to "dv_pal"
  * \envvar \em MLT_REPOSITORY overrides the default location of the plugin modules, defaults to \p PREFIX_LIB.
  * MLT_REPOSITORY is ignored on Windows and OS X relocatable builds.
+ * \envvar \em MLT_REPOSITORY_INDEX the full path of a file to keep an index of the services of the plugin modules.
+ * While it is current, a module is only loaded when one of its services is first used.
+ * \envvar \em MLT_METADATA_CACHE the full path of a file to cache the parsed metadata of the services,
+ * which is used until the module of a service changes
  * \envvar \em MLT_PRESETS_PATH overrides the default full path to the properties preset files, defaults to \p MLT_DATA/presets
+ * \envvar \em MLT_MEMORY_LIMIT the number of bytes, with an optional K, M, or G suffix, of resident memory
+ * at which the process is under memory pressure; without it the memory limit of the cgroup is used on Linux
  * \event \em producer-create-request fired when mlt_factory_producer is called;
  *   the event data is a pointer to mlt_factory_event_data
  * \event \em producer-create-done fired when a producer registers itself;
@@ -55,6 +61,8 @@
  *   the event data is a pointer to mlt_factory_event_data
  * \event \em link-create-done fired when a link registers itself;
  *   the event data is a pointer to mlt_factory_event_data
+ * \event \em memory-pressure fired when the level of memory pressure changes;
+ *   the event data is an integer of the mlt_memory_pressure level
  */
 
 extern mlt_repository mlt_factory_init( const char *directory );
@@ -71,6 +79,10 @@ extern mlt_consumer mlt_factory_consumer( mlt_profile profile, const char *name,
 extern void mlt_factory_register_for_clean_up( void *ptr, mlt_destructor destructor );
 extern void mlt_factory_close( );
 extern mlt_properties mlt_global_properties( );
+extern void mlt_factory_set_memory_pressure( mlt_memory_pressure level );
+extern mlt_memory_pressure mlt_factory_get_memory_pressure( );
+extern mlt_memory_pressure mlt_factory_update_memory_pressure( int64_t used, int64_t limit );
+extern void mlt_factory_check_memory( );
 
 /** The event data for all factory-related events */
 
@@ -23,6 +23,9 @@
 #include "mlt_filter.h"
 #include "mlt_frame.h"
 #include "mlt_producer.h"
+#include "mlt_factory.h"
+#include "mlt_repository.h"
+#include "mlt_trace.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -282,7 +285,42 @@ double mlt_filter_get_progress( mlt_filter self, mlt_frame frame )
 		return 1.0;
 }
 
+/** Determine if a filter only works on the image, according to the tags in its metadata.
+ *
+ * The answer is kept on the filter as \em _video_only, 1 if so or -1 if not.
+ * \private \memberof mlt_filter_s
+ * \param self a filter
+ * \return true if the filter is tagged Video and not Audio
+ */
+
+static int is_video_only( mlt_filter self )
+{
+	mlt_properties properties = MLT_FILTER_PROPERTIES( self );
+	int result = mlt_properties_get_int( properties, "_video_only" );
+
+	if ( !result )
+	{
+		const char *id = mlt_properties_get( properties, "mlt_service" );
+		mlt_properties metadata = id ? mlt_repository_metadata( mlt_factory_repository(), mlt_service_filter_type, id ) : NULL;
+		mlt_properties tags = metadata ? mlt_properties_get_data( metadata, "tags", NULL ) : NULL;
+		int i, video = 0, audio = 0;
+
+		for ( i = 0; tags && i < mlt_properties_count( tags ); i++ )
+		{
+			const char *tag = mlt_properties_get_value( tags, i );
+			video |= tag && !strcmp( tag, "Video" );
+			audio |= tag && !strcmp( tag, "Audio" );
+		}
+		result = video && !audio ? 1 : -1;
+		mlt_properties_set_int( properties, "_video_only", result );
+	}
+	return result > 0;
+}
+
 /** Process the frame.
+ *
+ * A filter which only works on the image is skipped for a frame which is
+ * made for a consumer without video, see mlt_frame_is_video_off().
  *
  * When fetching the frame position in a subclass process method, the frame's
  * position is relative to the filter's producer - not the filter's in point
@@ -309,7 +347,7 @@ mlt_frame mlt_filter_process( mlt_filter self, mlt_frame frame )
 	// Save the position on the frame
 	mlt_properties_set_position( MLT_FRAME_PROPERTIES( frame ), name, position );
 
-	if ( disable || !self || !self->process )
+	if ( disable || !self || !self->process || ( mlt_frame_is_video_off( frame ) && is_video_only( self ) ) )
 	{
 		return frame;
 	}
@@ -322,7 +360,10 @@ mlt_frame mlt_filter_process( mlt_filter self, mlt_frame frame )
 		mlt_properties_set_data( MLT_FRAME_PROPERTIES(frame), name, self, 0,
 			(mlt_destructor) mlt_filter_close, NULL );
 
-		return self->process( self, frame );
+		void *trace_previous = mlt_trace_enter( self );
+		frame = self->process( self, frame );
+		mlt_trace_leave( trace_previous );
+		return frame;
 	}
 }
 
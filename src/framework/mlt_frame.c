@@ -26,10 +26,100 @@
 #include "mlt_factory.h"
 #include "mlt_profile.h"
 #include "mlt_log.h"
+#include "mlt_trace.h"
+#include "mlt_slices.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Interned names of properties read on every frame
+static pthread_once_t atoms_once = PTHREAD_ONCE_INIT;
+static mlt_property_atom atom_position = NULL;
+static mlt_property_atom atom_original_position = NULL;
+static mlt_property_atom atom_image = NULL;
+static mlt_property_atom atom_alpha = NULL;
+static mlt_property_atom atom_audio = NULL;
+static mlt_property_atom atom_width = NULL;
+static mlt_property_atom atom_height = NULL;
+static mlt_property_atom atom_format = NULL;
+static mlt_property_atom atom_aspect_ratio = NULL;
+static mlt_property_atom atom_test_image = NULL;
+static mlt_property_atom atom_test_audio = NULL;
+static mlt_property_atom atom_audio_frequency = NULL;
+static mlt_property_atom atom_audio_channels = NULL;
+static mlt_property_atom atom_audio_samples = NULL;
+static mlt_property_atom atom_audio_format = NULL;
+static mlt_property_atom atom_producer = NULL;
+static mlt_property_atom atom_cancelled = NULL;
+static mlt_property_atom atom_image_shared = NULL;
+static mlt_property_atom atom_cloned_frame = NULL;
+static mlt_property_atom atom_image_prefetch = NULL;
+static mlt_property_atom atom_audio_prefetch = NULL;
+static mlt_property_atom atom_prefetch = NULL;
+static mlt_property_atom atom_lut = NULL;
+static mlt_property_atom atom_lut_defer = NULL;
+static mlt_property_atom atom_roi = NULL;
+static mlt_property_atom atom_roi_depth = NULL;
+static mlt_property_atom atom_audio_used = NULL;
+static mlt_property_atom atom_audio_used_depth = NULL;
+static mlt_property_atom atom_alpha_bounds = NULL;
+static mlt_property_atom atom_image_nesting = NULL;
+static mlt_property_atom atom_crop = NULL;
+static mlt_property_atom atom_crop_defer = NULL;
+
+// The outermost frame whose image is being rendered on the calling thread
+static pthread_key_t render_key;
+
+// The prefetch being run on the calling thread
+static pthread_key_t prefetch_key;
+
+// Whether the frames made on the calling thread are for a consumer without video
+static pthread_key_t video_off_key;
+static mlt_property_atom atom_video_off = NULL;
+
+static void atoms_init( void )
+{
+	atom_position = mlt_atom( "_position" );
+	atom_original_position = mlt_atom( "original_position" );
+	atom_image = mlt_atom( "image" );
+	atom_alpha = mlt_atom( "alpha" );
+	atom_audio = mlt_atom( "audio" );
+	atom_width = mlt_atom( "width" );
+	atom_height = mlt_atom( "height" );
+	atom_format = mlt_atom( "format" );
+	atom_aspect_ratio = mlt_atom( "aspect_ratio" );
+	atom_test_image = mlt_atom( "test_image" );
+	atom_test_audio = mlt_atom( "test_audio" );
+	atom_audio_frequency = mlt_atom( "audio_frequency" );
+	atom_audio_channels = mlt_atom( "audio_channels" );
+	atom_audio_samples = mlt_atom( "audio_samples" );
+	atom_audio_format = mlt_atom( "audio_format" );
+	atom_producer = mlt_atom( "_producer" );
+	atom_cancelled = mlt_atom( "_cancelled" );
+	atom_image_shared = mlt_atom( "_image_shared" );
+	atom_cloned_frame = mlt_atom( "_cloned_frame" );
+	atom_image_prefetch = mlt_atom( "_image_prefetch" );
+	atom_audio_prefetch = mlt_atom( "_audio_prefetch" );
+	atom_prefetch = mlt_atom( "_prefetch" );
+	atom_lut = mlt_atom( "_lut" );
+	atom_lut_defer = mlt_atom( "_lut_defer" );
+	atom_roi = mlt_atom( "_roi" );
+	atom_roi_depth = mlt_atom( "_roi_depth" );
+	atom_audio_used = mlt_atom( "_audio_used" );
+	atom_audio_used_depth = mlt_atom( "_audio_used_depth" );
+	atom_alpha_bounds = mlt_atom( "_alpha_bounds" );
+	atom_image_nesting = mlt_atom( "_image_nesting" );
+	atom_crop = mlt_atom( "_crop" );
+	atom_crop_defer = mlt_atom( "_crop_defer" );
+	atom_video_off = mlt_atom( "video_off" );
+	pthread_key_create( &render_key, NULL );
+	pthread_key_create( &prefetch_key, NULL );
+	pthread_key_create( &video_off_key, NULL );
+}
 
 /** Construct a frame object.
  *
@@ -47,18 +137,23 @@ mlt_frame mlt_frame_init( mlt_service service )
 	{
 		mlt_profile profile = mlt_service_profile( service );
 
+		pthread_once( &atoms_once, atoms_init );
+
 		// Initialise the properties
 		mlt_properties properties = &self->parent;
 		mlt_properties_init( properties, self );
+		mlt_properties_use_arena( properties );
 
 		// Set default properties on the frame
-		mlt_properties_set_position( properties, "_position", 0.0 );
-		mlt_properties_set_data( properties, "image", NULL, 0, NULL, NULL );
-		mlt_properties_set_int( properties, "width", profile? profile->width : 720 );
-		mlt_properties_set_int( properties, "height", profile? profile->height : 576 );
-		mlt_properties_set_double( properties, "aspect_ratio", mlt_profile_sar( NULL ) );
-		mlt_properties_set_data( properties, "audio", NULL, 0, NULL, NULL );
-		mlt_properties_set_data( properties, "alpha", NULL, 0, NULL, NULL );
+		mlt_properties_set_position_atom( properties, atom_position, 0.0 );
+		mlt_properties_set_data_atom( properties, atom_image, NULL, 0, NULL, NULL );
+		mlt_properties_set_int_atom( properties, atom_width, profile? profile->width : 720 );
+		mlt_properties_set_int_atom( properties, atom_height, profile? profile->height : 576 );
+		mlt_properties_set_double_atom( properties, atom_aspect_ratio, mlt_profile_sar( NULL ) );
+		mlt_properties_set_data_atom( properties, atom_audio, NULL, 0, NULL, NULL );
+		mlt_properties_set_data_atom( properties, atom_alpha, NULL, 0, NULL, NULL );
+		if ( pthread_getspecific( video_off_key ) )
+			mlt_properties_set_int_atom( properties, atom_video_off, 1 );
 
 		// Construct stacks for frames and methods
 		self->stack_image = mlt_deque_init( );
@@ -92,8 +187,8 @@ int mlt_frame_is_test_card( mlt_frame self )
 {
 	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
 	return ( mlt_deque_count( self->stack_image ) == 0
-			 && !mlt_properties_get_data( properties, "image", NULL ) )
-			|| mlt_properties_get_int( properties, "test_image" );
+			 && !mlt_properties_get_data_atom( properties, atom_image, NULL ) )
+			|| mlt_properties_get_int_atom( properties, atom_test_image );
 }
 
 /** Determine if the frame will produce audio from a test card.
@@ -107,8 +202,40 @@ int mlt_frame_is_test_audio( mlt_frame self )
 {
 	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
 	return ( mlt_deque_count( self->stack_audio ) == 0
-			 && !mlt_properties_get_data( properties, "audio", NULL ) )
-			|| mlt_properties_get_int( properties, "test_audio" );
+			 && !mlt_properties_get_data_atom( properties, atom_audio, NULL ) )
+			|| mlt_properties_get_int_atom( properties, atom_test_audio );
+}
+
+/** Determine if the image of the frame will not be used.
+ *
+ * This is set on the frames made while a consumer with video_off gets a
+ * frame, so that services can skip the work they only do for the image, such
+ * as opening a video decoder or processing a video filter or transition.
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \return true (non-zero) if the consumer of the frame does not get its image
+ */
+
+int mlt_frame_is_video_off( mlt_frame self )
+{
+	return mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( self ), atom_video_off );
+}
+
+/** Set whether the frames made on the calling thread are for a consumer without video.
+ *
+ * Consumers call this around getting a frame from their producer, which
+ * makes the frames on the same thread.
+ * \public \memberof mlt_frame_s
+ * \param video_off true (non-zero) to mark the frames with video_off
+ * \return the previous setting, which the caller restores
+ */
+
+int mlt_frame_set_thread_video_off( int video_off )
+{
+	pthread_once( &atoms_once, atoms_init );
+	int previous = pthread_getspecific( video_off_key ) != NULL;
+	pthread_setspecific( video_off_key, video_off ? &video_off_key : NULL );
+	return previous;
 }
 
 /** Get the sample aspect ratio of the frame.
@@ -120,7 +247,7 @@ int mlt_frame_is_test_audio( mlt_frame self )
 
 double mlt_frame_get_aspect_ratio( mlt_frame self )
 {
-	return mlt_properties_get_double( MLT_FRAME_PROPERTIES( self ), "aspect_ratio" );
+	return mlt_properties_get_double_atom( MLT_FRAME_PROPERTIES( self ), atom_aspect_ratio );
 }
 
 /** Set the sample aspect ratio of the frame.
@@ -133,7 +260,7 @@ double mlt_frame_get_aspect_ratio( mlt_frame self )
 
 int mlt_frame_set_aspect_ratio( mlt_frame self, double value )
 {
-	return mlt_properties_set_double( MLT_FRAME_PROPERTIES( self ), "aspect_ratio", value );
+	return mlt_properties_set_double_atom( MLT_FRAME_PROPERTIES( self ), atom_aspect_ratio, value );
 }
 
 /** Get the time position of this frame.
@@ -150,7 +277,7 @@ int mlt_frame_set_aspect_ratio( mlt_frame self, double value )
 
 mlt_position mlt_frame_get_position( mlt_frame self )
 {
-	int pos = mlt_properties_get_position( MLT_FRAME_PROPERTIES( self ), "_position" );
+	int pos = mlt_properties_get_position_atom( MLT_FRAME_PROPERTIES( self ), atom_position );
 	return pos < 0 ? 0 : pos;
 }
 
@@ -165,7 +292,7 @@ mlt_position mlt_frame_get_position( mlt_frame self )
 
 mlt_position mlt_frame_original_position( mlt_frame self )
 {
-	int pos = mlt_properties_get_position( MLT_FRAME_PROPERTIES( self ), "original_position" );
+	int pos = mlt_properties_get_position_atom( MLT_FRAME_PROPERTIES( self ), atom_original_position );
 	return pos < 0 ? 0 : pos;
 }
 
@@ -180,9 +307,9 @@ mlt_position mlt_frame_original_position( mlt_frame self )
 int mlt_frame_set_position( mlt_frame self, mlt_position value )
 {
 	// Only set the original_position the first time.
-	if ( ! mlt_properties_get( MLT_FRAME_PROPERTIES( self ), "original_position" ) )
-		mlt_properties_set_position( MLT_FRAME_PROPERTIES( self ), "original_position", value );
-	return mlt_properties_set_position( MLT_FRAME_PROPERTIES( self ), "_position", value );
+	if ( ! mlt_properties_get_atom( MLT_FRAME_PROPERTIES( self ), atom_original_position ) )
+		mlt_properties_set_position_atom( MLT_FRAME_PROPERTIES( self ), atom_original_position, value );
+	return mlt_properties_set_position_atom( MLT_FRAME_PROPERTIES( self ), atom_position, value );
 }
 
 /** Stack a get_image callback.
@@ -195,6 +322,7 @@ int mlt_frame_set_position( mlt_frame self, mlt_position value )
 
 int mlt_frame_push_get_image( mlt_frame self, mlt_get_image get_image )
 {
+	mlt_trace_push( self, "image", mlt_deque_count( self->stack_image ) );
 	return mlt_deque_push_back( self->stack_image, get_image );
 }
 
@@ -295,6 +423,7 @@ int mlt_frame_pop_service_int( mlt_frame self )
 
 int mlt_frame_push_audio( mlt_frame self, void *that )
 {
+	mlt_trace_push( self, "audio", mlt_deque_count( self->stack_audio ) );
 	return mlt_deque_push_back( self->stack_audio, that );
 }
 
@@ -323,6 +452,10 @@ mlt_deque mlt_frame_service_stack( mlt_frame self )
 }
 
 /** Set a new image on the frame.
+  *
+  * If \p destroy is mlt_image_buffer_release(), the frame takes over a reference
+  * to a shared buffer from mlt_image_buffer_alloc(), and a writable get_image
+  * copies it first if it has other owners.
   *
   * \public \memberof mlt_frame_s
   * \param self a frame
@@ -334,7 +467,114 @@ mlt_deque mlt_frame_service_stack( mlt_frame self )
 
 int mlt_frame_set_image( mlt_frame self, uint8_t *image, int size, mlt_destructor destroy )
 {
-	return mlt_properties_set_data( MLT_FRAME_PROPERTIES( self ), "image", image, size, destroy, NULL );
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	uint8_t *shared = mlt_properties_get_data_atom( properties, atom_image_shared, NULL );
+	int error;
+
+	// A crop that has not been copied yet was for the image being replaced
+	if ( mlt_properties_get_data_atom( properties, atom_crop, NULL ) )
+		mlt_properties_set_data_atom( properties, atom_crop, NULL, 0, NULL, NULL );
+
+	if ( image && destroy == mlt_image_buffer_release )
+	{
+		// The reference is held by _image_shared, which also tells a shared image apart
+		error = mlt_properties_set_data_atom( properties, atom_image, image, size, NULL, NULL );
+		if ( shared == image )
+			mlt_image_buffer_release( image );
+		else
+			mlt_properties_set_data_atom( properties, atom_image_shared, image, size, mlt_image_buffer_release, NULL );
+	}
+	else
+	{
+		error = mlt_properties_set_data_atom( properties, atom_image, image, size, destroy, NULL );
+		if ( shared && shared != image )
+			mlt_properties_set_data_atom( properties, atom_image_shared, NULL, 0, NULL, NULL );
+	}
+	return error;
+}
+
+/** Get a reference to the image of a frame as a shared buffer.
+ *
+ * An image that is not a shared buffer yet is copied into one that replaces it
+ * on the frame, so that only the first call copies. A mlt_image_hwframe
+ * image cannot be shared this way.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param[out] size the size of the image in bytes (optional)
+ * \return a reference to release with mlt_image_buffer_release(), or NULL if there is no image
+ */
+
+uint8_t *mlt_frame_share_image( mlt_frame self, int *size )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	int image_size = 0;
+	uint8_t *image = mlt_properties_get_data_atom( properties, atom_image, &image_size );
+
+	if ( image && mlt_properties_get_int_atom( properties, atom_format ) == mlt_image_hwframe )
+	{
+		image = NULL;
+	}
+	else if ( image && image != mlt_properties_get_data_atom( properties, atom_image_shared, NULL ) )
+	{
+		uint8_t *copy;
+		if ( image_size <= 0 )
+			image_size = mlt_image_format_size( mlt_properties_get_int_atom( properties, atom_format ),
+				mlt_properties_get_int_atom( properties, atom_width ),
+				mlt_properties_get_int_atom( properties, atom_height ), NULL );
+		copy = mlt_image_buffer_alloc( image_size );
+		if ( !copy )
+			return NULL;
+		memcpy( copy, image, image_size );
+		mlt_frame_set_image( self, copy, image_size, mlt_image_buffer_release );
+		image = copy;
+	}
+	if ( size )
+		*size = image ? image_size : 0;
+	return mlt_image_buffer_ref( image );
+}
+
+/** Make sure that the image of a frame is not shared before it is written.
+ *
+ * This copies a shared buffer that has other owners and an image that a
+ * shallow clone borrows from the frame it was cloned from.
+ * \private \memberof mlt_frame_s
+ * \param self a frame
+ * \param buffer the image returned by get_image
+ * \param format the format of the image
+ */
+
+static void make_image_writable( mlt_frame self, uint8_t **buffer, mlt_image_format format )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	int size = 0;
+	uint8_t *shared = mlt_properties_get_data_atom( properties, atom_image_shared, &size );
+	int is_shared = 0;
+
+	if ( shared && shared == *buffer )
+	{
+		is_shared = mlt_image_buffer_is_shared( shared );
+	}
+	else if ( format != mlt_image_hwframe )
+	{
+		mlt_frame cloned = mlt_properties_get_data_atom( properties, atom_cloned_frame, NULL );
+		is_shared = cloned && *buffer == mlt_properties_get_data_atom( MLT_FRAME_PROPERTIES( cloned ), atom_image, &size );
+	}
+
+	if ( is_shared )
+	{
+		uint8_t *copy;
+		if ( size <= 0 )
+			size = mlt_image_format_size( format, mlt_properties_get_int_atom( properties, atom_width ),
+				mlt_properties_get_int_atom( properties, atom_height ), NULL );
+		copy = mlt_image_buffer_alloc( size );
+		if ( copy )
+		{
+			memcpy( copy, *buffer, size );
+			mlt_frame_set_image( self, copy, size, mlt_image_buffer_release );
+			*buffer = copy;
+		}
+	}
 }
 
 /** Set a new alpha channel on the frame.
@@ -349,7 +589,7 @@ int mlt_frame_set_image( mlt_frame self, uint8_t *image, int size, mlt_destructo
 
 int mlt_frame_set_alpha( mlt_frame self, uint8_t *alpha, int size, mlt_destructor destroy )
 {
-	return mlt_properties_set_data( MLT_FRAME_PROPERTIES( self ), "alpha", alpha, size, destroy, NULL );
+	return mlt_properties_set_data_atom( MLT_FRAME_PROPERTIES( self ), atom_alpha, alpha, size, destroy, NULL );
 }
 
 /** Replace image stack with the information provided.
@@ -384,10 +624,11 @@ void mlt_frame_replace_image( mlt_frame self, uint8_t *image, mlt_image_format f
 	while( mlt_deque_pop_back( self->stack_image ) ) ;
 
 	// Update the information
-	mlt_properties_set_data( MLT_FRAME_PROPERTIES( self ), "image", image, 0, NULL, NULL );
-	mlt_properties_set_int( MLT_FRAME_PROPERTIES( self ), "width", width );
-	mlt_properties_set_int( MLT_FRAME_PROPERTIES( self ), "height", height );
-	mlt_properties_set_int( MLT_FRAME_PROPERTIES( self ), "format", format );
+	mlt_properties_set_data_atom( MLT_FRAME_PROPERTIES( self ), atom_crop, NULL, 0, NULL, NULL );
+	mlt_properties_set_data_atom( MLT_FRAME_PROPERTIES( self ), atom_image, image, 0, NULL, NULL );
+	mlt_properties_set_int_atom( MLT_FRAME_PROPERTIES( self ), atom_width, width );
+	mlt_properties_set_int_atom( MLT_FRAME_PROPERTIES( self ), atom_height, height );
+	mlt_properties_set_int_atom( MLT_FRAME_PROPERTIES( self ), atom_format, format );
 }
 
 static int generate_test_image( mlt_properties properties, uint8_t **buffer,  mlt_image_format *format, int *width, int *height, int writable )
@@ -408,12 +649,12 @@ static int generate_test_image( mlt_properties properties, uint8_t **buffer,  ml
 			error = mlt_frame_get_image( test_frame, buffer, format, width, height, writable );
 			if ( !error && buffer && *buffer )
 			{
-				mlt_properties_set_double( properties, "aspect_ratio", mlt_frame_get_aspect_ratio( test_frame ) );
-				mlt_properties_set_int( properties, "width", *width );
-				mlt_properties_set_int( properties, "height", *height );
+				mlt_properties_set_double_atom( properties, atom_aspect_ratio, mlt_frame_get_aspect_ratio( test_frame ) );
+				mlt_properties_set_int_atom( properties, atom_width, *width );
+				mlt_properties_set_int_atom( properties, atom_height, *height );
 				if ( test_frame->convert_image && requested_format != mlt_image_none )
 					test_frame->convert_image( test_frame, buffer, format, requested_format );
-				mlt_properties_set_int( properties, "format", *format );
+				mlt_properties_set_int_atom( properties, atom_format, *format );
 			}
 		}
 		else
@@ -432,10 +673,15 @@ static int generate_test_image( mlt_properties properties, uint8_t **buffer,  ml
 			case mlt_image_yuv422:
 			case mlt_image_yuv422p16:
 			case mlt_image_yuv420p:
+			case mlt_image_yuv420p10:
+			case mlt_image_nv12:
+			case mlt_image_p010:
+			case mlt_image_rgba64:
 				break;
 			case mlt_image_none:
 			case mlt_image_movit:
 			case mlt_image_opengl_texture:
+			case mlt_image_hwframe:
 				*format = mlt_image_yuv422;
 				break;
 		}
@@ -444,20 +690,623 @@ static int generate_test_image( mlt_properties properties, uint8_t **buffer,  ml
 		mlt_image_set_values( &img, NULL, *format, *width, *height );
 		mlt_image_alloc_data( &img );
 		mlt_image_fill_black( &img );
+		mlt_image_pack( &img );
 
 		*buffer = img.data;
-		mlt_properties_set_int( properties, "format", *format );
-		mlt_properties_set_int( properties, "width", *width );
-		mlt_properties_set_int( properties, "height", *height );
-		mlt_properties_set_double( properties, "aspect_ratio", 1.0 );
-		mlt_properties_set_data( properties, "image", *buffer, 0, img.release_data, NULL );
-		mlt_properties_set_int( properties, "test_image", 1 );
+		mlt_properties_set_int_atom( properties, atom_format, *format );
+		mlt_properties_set_int_atom( properties, atom_width, *width );
+		mlt_properties_set_int_atom( properties, atom_height, *height );
+		mlt_properties_set_double_atom( properties, atom_aspect_ratio, 1.0 );
+		mlt_properties_set_data_atom( properties, atom_image, *buffer, 0, img.release_data, NULL );
+		mlt_properties_set_int_atom( properties, atom_test_image, 1 );
 		error = 0;
 	}
 	return error;
 }
 
 
+/** \brief an image or audio being rendered ahead on the slices pool
+ *
+ * It is shared by the frame and the task, and the first of the task or the
+ * renderer of the frame to claim it does the work.
+ */
+
+typedef struct
+{
+	mlt_frame frame;
+	mlt_slices_task task;
+	atomic_int state;
+	atomic_int refs;
+	pthread_mutex_t mutex;
+	pthread_cond_t done;
+	int is_audio;
+	struct
+	{
+		mlt_image_format format;
+		int width;
+		int height;
+		int writable;
+	} requested_image;
+	struct
+	{
+		mlt_audio_format format;
+		int frequency;
+		int channels;
+		int samples;
+	} requested_audio;
+	void *buffer;
+	int format;
+	int width;
+	int height;
+	int frequency;
+	int channels;
+	int samples;
+	int error;
+} frame_prefetch;
+
+enum
+{
+	prefetch_queued,
+	prefetch_running,
+	prefetch_done,
+	prefetch_consumed,
+	prefetch_dropped
+};
+
+static void prefetch_release( frame_prefetch *self )
+{
+	if ( atomic_fetch_sub( &self->refs, 1 ) == 1 )
+	{
+		mlt_slices_task_close( self->task );
+		pthread_mutex_destroy( &self->mutex );
+		pthread_cond_destroy( &self->done );
+		free( self );
+	}
+}
+
+static void prefetch_run( frame_prefetch *self )
+{
+	void *previous = pthread_getspecific( prefetch_key );
+	pthread_setspecific( prefetch_key, self );
+	self->buffer = NULL;
+	if ( self->is_audio )
+	{
+		mlt_audio_format format = self->requested_audio.format;
+		self->frequency = self->requested_audio.frequency;
+		self->channels = self->requested_audio.channels;
+		self->samples = self->requested_audio.samples;
+		self->error = mlt_frame_get_audio( self->frame, &self->buffer, &format, &self->frequency, &self->channels, &self->samples );
+		self->format = format;
+	}
+	else
+	{
+		mlt_image_format format = self->requested_image.format;
+		uint8_t *buffer = NULL;
+		self->width = self->requested_image.width;
+		self->height = self->requested_image.height;
+		self->error = mlt_frame_get_image( self->frame, &buffer, &format, &self->width, &self->height, self->requested_image.writable );
+		self->buffer = buffer;
+		self->format = format;
+	}
+	pthread_setspecific( prefetch_key, previous );
+	pthread_mutex_lock( &self->mutex );
+	atomic_store( &self->state, prefetch_done );
+	pthread_cond_broadcast( &self->done );
+	pthread_mutex_unlock( &self->mutex );
+}
+
+static int prefetch_proc( void *cookie )
+{
+	frame_prefetch *self = cookie;
+	int expected = prefetch_queued;
+	if ( atomic_compare_exchange_strong( &self->state, &expected, prefetch_running ) )
+		prefetch_run( self );
+	prefetch_release( self );
+	return 0;
+}
+
+/** Make sure a prefetch is no longer running.
+ *
+ * \param self a prefetch
+ * \param render whether to render the image here if the pool has not started it, or else drop it
+ */
+
+static void prefetch_finish( frame_prefetch *self, int render )
+{
+	int expected = prefetch_queued;
+	if ( atomic_compare_exchange_strong( &self->state, &expected, render ? prefetch_running : prefetch_dropped ) )
+	{
+		if ( render )
+			prefetch_run( self );
+	}
+	else if ( expected == prefetch_running )
+	{
+		pthread_mutex_lock( &self->mutex );
+		while ( atomic_load( &self->state ) == prefetch_running )
+			pthread_cond_wait( &self->done, &self->mutex );
+		pthread_mutex_unlock( &self->mutex );
+	}
+}
+
+/** Take the result of a prefetch if nobody else did.
+ *
+ * Later requests then find the frame rendered and go the usual way.
+ */
+
+static int prefetch_consume( frame_prefetch *self )
+{
+	int expected = prefetch_done;
+	return atomic_compare_exchange_strong( &self->state, &expected, prefetch_consumed );
+}
+
+static void prefetch_close( frame_prefetch *self )
+{
+	prefetch_finish( self, 0 );
+	prefetch_release( self );
+}
+
+static frame_prefetch *prefetch_init( mlt_frame frame )
+{
+	frame_prefetch *self = calloc( 1, sizeof( *self ) );
+	if ( self )
+	{
+		self->frame = frame;
+		pthread_mutex_init( &self->mutex, NULL );
+		pthread_cond_init( &self->done, NULL );
+		atomic_init( &self->state, prefetch_queued );
+		// One for the frame and one for the task
+		atomic_init( &self->refs, 2 );
+	}
+	return self;
+}
+
+static int prefetch_submit( frame_prefetch *self, mlt_property_atom atom )
+{
+	// The task does not need the frame to hold it yet
+	self->task = mlt_slices_task_submit( prefetch_proc, self );
+	if ( !self->task )
+	{
+		atomic_store( &self->refs, 1 );
+		prefetch_release( self );
+		return 1;
+	}
+	mlt_properties_set_data_atom( MLT_FRAME_PROPERTIES( self->frame ), atom, self, 0, ( mlt_destructor )prefetch_close, NULL );
+	return 0;
+}
+
+// The depth of a region of interest or of used audio channels given to the
+// get_image or get_audio function being run
+#define ROI_RUNNING (-1)
+
+/** Set the region of interest of the next image request.
+ *
+ * A transition or filter that uses only part of the image of a frame, like a
+ * picture-in-picture placed partly off the screen or a crop, calls this before
+ * mlt_frame_get_image(). The services that render the image may then process
+ * only that region and leave the rest of the image undefined; others ignore it.
+ * The region applies to the next call to mlt_frame_get_image() only, and only
+ * reaches the services further up the stack through those that pass it on
+ * with mlt_frame_get_roi(), so a service that moves pixels around without
+ * knowing about it drops it for everything above it.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param rect the region as fractions of the image width and height, which may be empty
+ */
+
+void mlt_frame_set_roi( mlt_frame self, mlt_rect rect )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	double x1 = CLAMP( rect.x + rect.w, 0.0, 1.0 );
+	double y1 = CLAMP( rect.y + rect.h, 0.0, 1.0 );
+	mlt_rect *roi = mlt_properties_get_data_atom( properties, atom_roi, NULL );
+
+	if ( !roi )
+	{
+		roi = malloc( sizeof( *roi ) );
+		if ( !roi )
+			return;
+		mlt_properties_set_data_atom( properties, atom_roi, roi, sizeof( *roi ), free, NULL );
+	}
+	roi->x = CLAMP( rect.x, 0.0, 1.0 );
+	roi->y = CLAMP( rect.y, 0.0, 1.0 );
+	roi->w = MAX( x1 - roi->x, 0.0 );
+	roi->h = MAX( y1 - roi->y, 0.0 );
+	roi->o = 1.0;
+	// The depth is one more than the size of the stack it is meant for, so 0 is none
+	// and ROI_RUNNING is for the get_image function that has been popped
+	mlt_properties_set_int_atom( properties, atom_roi_depth, mlt_deque_count( self->stack_image ) + 1 );
+}
+
+/** Get the region of interest of the image being rendered and pass it on.
+ *
+ * A service that renders the image of a frame calls this in its get_image
+ * function after popping its arguments from the stack and before it calls
+ * mlt_frame_get_image(). It gets the region that its caller needs, and the
+ * services further up the stack then get it too.
+ * Only call it if the image from the rest of the stack maps to the image it
+ * returns without moving any pixel, apart from scaling, or if it sets a new
+ * region with mlt_frame_set_roi() afterwards.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param[out] rect the region as fractions of the image width and height, the whole image if there is none
+ * \return true if there is a region of interest
+ */
+
+int mlt_frame_get_roi( mlt_frame self, mlt_rect *rect )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	int depth = mlt_properties_get_int_atom( properties, atom_roi_depth );
+	int count = mlt_deque_count( self->stack_image );
+	mlt_rect *roi = mlt_properties_get_data_atom( properties, atom_roi, NULL );
+
+	// Given to the get_image call that is running this service, or passed on already
+	if ( roi && ( depth == ROI_RUNNING || depth == count + 1 ) )
+	{
+		mlt_properties_set_int_atom( properties, atom_roi_depth, count + 1 );
+		*rect = *roi;
+		return 1;
+	}
+	rect->x = 0.0;
+	rect->y = 0.0;
+	rect->w = 1.0;
+	rect->h = 1.0;
+	rect->o = 1.0;
+	return 0;
+}
+
+/** Take the region of interest given to a call to mlt_frame_get_image().
+ *
+ * A region that the service which popped the previous get_image function did
+ * not pass on is forgotten here.
+ *
+ * \private \memberof mlt_frame_s
+ * \param self a frame
+ * \param[out] rect the region as fractions of the image width and height
+ * \return true if there is a region of interest for this call
+ */
+
+static int roi_enter( mlt_frame self, mlt_rect *rect )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	int depth = mlt_properties_get_int_atom( properties, atom_roi_depth );
+	mlt_rect *roi = NULL;
+
+	if ( !depth )
+		return 0;
+	if ( depth == mlt_deque_count( self->stack_image ) + 1 )
+		roi = mlt_properties_get_data_atom( properties, atom_roi, NULL );
+	mlt_properties_set_int_atom( properties, atom_roi_depth, roi ? ROI_RUNNING : 0 );
+	if ( roi )
+		*rect = *roi;
+	return roi != NULL;
+}
+
+/** Restrict an image to the pixels of a region of interest.
+ *
+ * The region is widened to whole pixels and to even coordinates, so that the
+ * chroma of subsampled formats stays aligned. Only the formats that
+ * mlt_image_lut_supported() accepts are restricted.
+ *
+ * \private \memberof mlt_frame_s
+ * \param image an image whose planes are set
+ * \param roi the region as fractions of the image width and height
+ */
+
+static void roi_restrict( mlt_image image, const mlt_rect *roi )
+{
+	int x = floor( roi->x * image->width );
+	int y = floor( roi->y * image->height );
+	int x1 = MIN( (int) ceil( ( roi->x + roi->w ) * image->width ), image->width );
+	int y1 = MIN( (int) ceil( ( roi->y + roi->h ) * image->height ), image->height );
+	int bytes = 1;
+
+	x -= x & 1;
+	y -= y & 1;
+	x1 = MIN( x1 + ( x1 & 1 ), image->width );
+	y1 = MIN( y1 + ( y1 & 1 ), image->height );
+	switch ( image->format )
+	{
+	case mlt_image_yuv422:
+		bytes = 2;
+		break;
+	case mlt_image_rgb:
+		bytes = 3;
+		break;
+	case mlt_image_rgba:
+		bytes = 4;
+		break;
+	case mlt_image_yuv420p:
+		image->planes[1] += ( y >> 1 ) * image->strides[1] + ( x >> 1 );
+		image->planes[2] += ( y >> 1 ) * image->strides[2] + ( x >> 1 );
+		break;
+	case mlt_image_nv12:
+		image->planes[1] += ( y >> 1 ) * image->strides[1] + x;
+		break;
+	default:
+		return;
+	}
+	image->planes[0] += y * image->strides[0] + x * bytes;
+	image->width = MAX( x1 - x, 0 );
+	image->height = MAX( y1 - y, 0 );
+}
+
+/** \brief private to mlt_frame, the part of the image that is not fully transparent */
+
+typedef struct
+{
+	mlt_rect rect;
+	int opaque;
+	int level; /**< the nesting of mlt_frame_get_image() calls it holds for, -1 for none */
+}
+frame_alpha_bounds;
+
+/** Publish the part of the image of a frame that is not fully transparent.
+ *
+ * A producer or filter calls this in its get_image function for the image it
+ * returns, so that a compositor can skip the fully transparent pixels around
+ * a title, for example. The bounds are forgotten as the image goes down the
+ * stack unless each service on the way passes them on with
+ * mlt_frame_get_alpha_bounds(), or publishes new ones if it changed them.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param bounds a rectangle in pixels that holds every pixel with some opacity, which may be empty
+ * \param opaque whether every pixel of the image is fully opaque
+ */
+
+void mlt_frame_set_alpha_bounds( mlt_frame self, mlt_rect bounds, int opaque )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	frame_alpha_bounds *alpha_bounds = mlt_properties_get_data_atom( properties, atom_alpha_bounds, NULL );
+
+	if ( !alpha_bounds )
+	{
+		alpha_bounds = malloc( sizeof( *alpha_bounds ) );
+		if ( !alpha_bounds )
+			return;
+		mlt_properties_set_data_atom( properties, atom_alpha_bounds, alpha_bounds, sizeof( *alpha_bounds ), free, NULL );
+	}
+	alpha_bounds->rect = bounds;
+	alpha_bounds->opaque = opaque;
+	alpha_bounds->level = mlt_properties_get_int_atom( properties, atom_image_nesting );
+}
+
+/** Get the part of the image of a frame that is not fully transparent and pass it on.
+ *
+ * Call this right after mlt_frame_get_image(). A service that does not change
+ * the alpha channel calls it in its get_image function to keep the bounds for
+ * its caller, and a compositor calls it to restrict its work.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param[out] bounds a rectangle in pixels that holds every pixel with some opacity
+ * \param[out] opaque whether every pixel of the image is fully opaque
+ * \return true if the bounds are known
+ */
+
+int mlt_frame_get_alpha_bounds( mlt_frame self, mlt_rect *bounds, int *opaque )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	frame_alpha_bounds *alpha_bounds = mlt_properties_get_data_atom( properties, atom_alpha_bounds, NULL );
+	int nesting = mlt_properties_get_int_atom( properties, atom_image_nesting );
+
+	// Published by the call that just returned, or passed on already
+	if ( !alpha_bounds || ( alpha_bounds->level != nesting + 1 && alpha_bounds->level != nesting ) )
+		return 0;
+	alpha_bounds->level = nesting;
+	*bounds = alpha_bounds->rect;
+	*opaque = alpha_bounds->opaque;
+	return 1;
+}
+
+/** Forget the alpha bounds unless the get_image function that just ran published or passed them on.
+ *
+ * \private \memberof mlt_frame_s
+ * \param self a frame
+ * \param nesting the nesting of the mlt_frame_get_image() call that ran it
+ */
+
+static void alpha_bounds_leave( mlt_frame self, int nesting )
+{
+	frame_alpha_bounds *alpha_bounds = mlt_properties_get_data_atom( MLT_FRAME_PROPERTIES( self ), atom_alpha_bounds, NULL );
+	if ( alpha_bounds && alpha_bounds->level != nesting )
+		alpha_bounds->level = -1;
+}
+
+/** \brief private to mlt_frame, the lookup tables that mlt_frame_get_image_lut() has not applied yet */
+
+typedef struct
+{
+	mlt_image_format format;
+	int used[MLT_IMAGE_MAX_PLANES];
+	uint8_t luts[MLT_IMAGE_MAX_PLANES][256];
+}
+frame_lut;
+
+/** Apply the pending lookup tables of a frame to its image and forget them.
+ *
+ * \private \memberof mlt_frame_s
+ * \param self a frame
+ * \param buffer the image returned by the top of the stack
+ * \param format the format of \p buffer
+ * \param width the horizontal size in pixels
+ * \param height the vertical size in pixels
+ * \param roi the region of interest of the image, NULL for all of it
+ */
+
+static void lut_flush( mlt_frame self, uint8_t *buffer, mlt_image_format format, int width, int height, const mlt_rect *roi )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	frame_lut *pending = mlt_properties_get_data_atom( properties, atom_lut, NULL );
+
+	if ( !pending )
+		return;
+	if ( buffer && pending->format == format )
+	{
+		const uint8_t *luts[MLT_IMAGE_MAX_PLANES];
+		struct mlt_image_s image;
+		for ( int i = 0; i < MLT_IMAGE_MAX_PLANES; i++ )
+			luts[i] = pending->used[i] ? pending->luts[i] : NULL;
+		mlt_image_set_values( &image, buffer, format, width, height );
+		if ( roi )
+			roi_restrict( &image, roi );
+		if ( image.width > 0 && image.height > 0 )
+			mlt_image_apply_lut( &image, luts, 0 );
+	}
+	mlt_properties_set_data_atom( properties, atom_lut, NULL, 0, NULL, NULL );
+}
+
+/** \brief private to mlt_frame, the crop that mlt_frame_crop_image() has not copied yet */
+
+typedef struct
+{
+	mlt_image_format format;
+	int width;       ///< the full width of the image
+	int height;      ///< the full height of the image
+	int x;           ///< the left edge of the crop window
+	int y;           ///< the top edge of the crop window
+	int crop_width;  ///< the width of the crop window
+	int crop_height; ///< the height of the crop window
+}
+frame_crop;
+
+/** Whether the crop window of an image in a format can be described by plane pointers and strides.
+ *
+ * \private \memberof mlt_frame_s
+ * \param format an image format
+ * \return true if the format has a single, packed plane
+ */
+
+static int crop_is_strided( mlt_image_format format )
+{
+	return format == mlt_image_rgb || format == mlt_image_rgba
+		|| format == mlt_image_yuv422 || format == mlt_image_rgba64;
+}
+
+/** Copy the pending crop window of a frame to a new image and forget it.
+ *
+ * \private \memberof mlt_frame_s
+ * \param self a frame
+ * \param[in,out] buffer the image returned by the top of the stack, NULL to only forget the crop
+ * \param format the format of \p buffer
+ * \param[in,out] width the horizontal size in pixels
+ * \param[in,out] height the vertical size in pixels
+ */
+
+static void crop_flush( mlt_frame self, uint8_t **buffer, mlt_image_format format, int *width, int *height )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	frame_crop *pending = mlt_properties_get_data_atom( properties, atom_crop, NULL );
+
+	if ( !pending )
+		return;
+	frame_crop crop = *pending;
+	mlt_properties_set_data_atom( properties, atom_crop, NULL, 0, NULL, NULL );
+	if ( !buffer || !*buffer || crop.format != format || crop.width != *width || crop.height != *height )
+		return;
+
+	int bpp;
+	int size = mlt_image_format_size( format, crop.crop_width, crop.crop_height, &bpp );
+	uint8_t *output = mlt_pool_alloc( size );
+	if ( !output )
+		return;
+	const uint8_t *src;
+	if ( format == mlt_image_yuv420p )
+	{
+		// Each plane is cropped on its own, the chroma at half the size
+		uint8_t *in_planes[4], *out_planes[4];
+		int in_strides[4], out_strides[4];
+		mlt_image_format_planes( format, crop.width, crop.height, *buffer, in_planes, in_strides );
+		mlt_image_format_planes( format, crop.crop_width, crop.crop_height, output, out_planes, out_strides );
+		for ( int plane = 0; plane < 3; plane++ )
+		{
+			int shift = plane > 0;
+			src = in_planes[plane] + ( crop.y >> shift ) * in_strides[plane] + ( crop.x >> shift );
+			for ( int line = 0; line < crop.crop_height >> shift; line++ )
+				memcpy( out_planes[plane] + line * out_strides[plane], src + line * in_strides[plane], crop.crop_width >> shift );
+		}
+	}
+	else
+	{
+		src = *buffer + ( crop.y * crop.width + crop.x ) * bpp;
+		for ( int line = 0; line < crop.crop_height; line++ )
+			memcpy( output + line * crop.crop_width * bpp, src + line * crop.width * bpp, crop.crop_width * bpp );
+	}
+
+	// The alpha channel is only cropped when it covers the whole image
+	int alpha_size = 0;
+	uint8_t *alpha = mlt_properties_get_data_atom( properties, atom_alpha, &alpha_size );
+	uint8_t *newalpha = NULL;
+	if ( alpha && alpha_size >= crop.width * crop.height )
+	{
+		newalpha = mlt_pool_alloc( crop.crop_width * crop.crop_height );
+		if ( newalpha )
+		{
+			src = alpha + crop.y * crop.width + crop.x;
+			for ( int line = 0; line < crop.crop_height; line++ )
+				memcpy( newalpha + line * crop.crop_width, src + line * crop.width, crop.crop_width );
+		}
+	}
+
+	mlt_frame_set_image( self, output, size, mlt_pool_release );
+	if ( newalpha )
+		mlt_frame_set_alpha( self, newalpha, crop.crop_width * crop.crop_height, mlt_pool_release );
+	*buffer = output;
+	*width = crop.crop_width;
+	*height = crop.crop_height;
+}
+
+/** Crop the image that a get_image function returns without copying it.
+ *
+ * A get_image function calls this on the image it is about to return, and
+ * returns that image with its full size. The crop is recorded, and the image
+ * is only copied to a smaller one when mlt_frame_get_image() returns it to
+ * a caller, unless that caller used mlt_frame_get_image_strided() and reads the
+ * window in place. The image and alpha channel of the frame must not be
+ * replaced in between.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param format the format of the image
+ * \param width the horizontal size of the image in pixels
+ * \param height the vertical size of the image in pixels
+ * \param left the number of pixels to remove from the left edge
+ * \param right the number of pixels to remove from the right edge
+ * \param top the number of lines to remove from the top edge
+ * \param bottom the number of lines to remove from the bottom edge
+ */
+
+void mlt_frame_crop_image( mlt_frame self, mlt_image_format format, int width, int height, int left, int right, int top, int bottom )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	frame_crop *pending = mlt_properties_get_data_atom( properties, atom_crop, NULL );
+
+	if ( left < 0 || right < 0 || top < 0 || bottom < 0 || width - left - right <= 0 || height - top - bottom <= 0 )
+		return;
+	if ( pending && pending->format == format && pending->crop_width == width && pending->crop_height == height )
+	{
+		// Crop the window again
+		pending->x += left;
+		pending->y += top;
+	}
+	else
+	{
+		pending = calloc( 1, sizeof( *pending ) );
+		if ( !pending )
+			return;
+		pending->format = format;
+		pending->width = width;
+		pending->height = height;
+		pending->x = left;
+		pending->y = top;
+		mlt_properties_set_data_atom( properties, atom_crop, pending, 0, free, NULL );
+	}
+	pending->crop_width = width - left - right;
+	pending->crop_height = height - top - bottom;
+}
+
 /** Get the image associated to the frame.
  *
  * You should express the desired format, width, and height as inputs. As long
@@ -467,6 +1316,10 @@ static int generate_test_image( mlt_properties properties, uint8_t **buffer,  ml
  * on properties and filters. You do not need to supply a pre-allocated
  * buffer, but you should always supply the desired image format.
  *
+ * Requesting mlt_image_hwframe asks for a hardware surface but is not
+ * converted to: you get one only if the producer supplies it, otherwise
+ * the image is returned in whatever format it has.
+ *
  * \public \memberof mlt_frame_s
  * \param self a frame
  * \param[out] buffer an image buffer
@@ -481,38 +1334,106 @@ static int generate_test_image( mlt_properties properties, uint8_t **buffer,  ml
 int mlt_frame_get_image( mlt_frame self, uint8_t **buffer, mlt_image_format *format, int *width, int *height, int writable )
 {
 	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	int lut_defer = mlt_properties_get_int_atom( properties, atom_lut_defer );
+	if ( lut_defer )
+		mlt_properties_set_int_atom( properties, atom_lut_defer, 0 );
+	int crop_defer = mlt_properties_get_int_atom( properties, atom_crop_defer );
+	if ( crop_defer )
+		mlt_properties_set_int_atom( properties, atom_crop_defer, 0 );
+
+	frame_prefetch *prefetch = mlt_properties_get_data_atom( properties, atom_image_prefetch, NULL );
+	if ( prefetch && pthread_getspecific( prefetch_key ) != prefetch )
+	{
+		prefetch_finish( prefetch, 1 );
+		if ( prefetch->requested_image.format == *format
+			&& prefetch->requested_image.width == *width
+			&& prefetch->requested_image.height == *height
+			&& prefetch->requested_image.writable >= writable
+			&& prefetch_consume( prefetch ) )
+		{
+			if ( buffer )
+				*buffer = prefetch->buffer;
+			*format = prefetch->format;
+			*width = prefetch->width;
+			*height = prefetch->height;
+			return prefetch->error;
+		}
+		// Otherwise the stack is done and the image is converted as requested below
+	}
+
+	mlt_rect roi;
+	int has_roi = roi_enter( self, &roi );
 	mlt_get_image get_image = mlt_frame_pop_get_image( self );
 	mlt_image_format requested_format = *format;
 	int error = 0;
 
 	if ( get_image )
 	{
+		mlt_frame root = pthread_getspecific( render_key );
+		int nesting = mlt_properties_get_int_atom( properties, atom_image_nesting ) + 1;
 		mlt_properties_set_int( properties, "image_count", mlt_properties_get_int( properties, "image_count" ) - 1 );
-		error = get_image( self, buffer, format, width, height, writable );
+		if ( !root )
+			pthread_setspecific( render_key, self );
+		mlt_properties_set_int_atom( properties, atom_image_nesting, nesting );
+		if ( mlt_frame_is_cancelled( self ) )
+		{
+			error = 1;
+		}
+		else
+		{
+			void *pusher = mlt_trace_pusher( self, "image", mlt_deque_count( self->stack_image ) );
+			void *previous = mlt_trace_enter( pusher );
+			int64_t trace_begin = mlt_trace_now();
+			error = get_image( self, buffer, format, width, height, writable );
+			mlt_trace_callback( get_image, pusher, "get_image", trace_begin );
+			mlt_trace_leave( previous );
+		}
+		alpha_bounds_leave( self, error ? -1 : nesting );
+		mlt_properties_set_int_atom( properties, atom_image_nesting, nesting - 1 );
+		if ( !root )
+			pthread_setspecific( render_key, NULL );
 		if ( !error && buffer && *buffer )
 		{
-			mlt_properties_set_int( properties, "width", *width );
-			mlt_properties_set_int( properties, "height", *height );
-			if ( self->convert_image && requested_format != mlt_image_none )
+			// A crop is copied now unless the caller reads the window in place
+			if ( !crop_defer || *format != requested_format )
+				crop_flush( self, buffer, *format, width, height );
+			// Tables the stack left pending wait for a caller that wants them too
+			if ( !lut_defer || *format != requested_format )
+				lut_flush( self, *buffer, *format, *width, *height, has_roi ? &roi : NULL );
+			mlt_properties_set_int_atom( properties, atom_width, *width );
+			mlt_properties_set_int_atom( properties, atom_height, *height );
+			if ( self->convert_image && requested_format != mlt_image_none && requested_format != mlt_image_hwframe )
 				self->convert_image( self, buffer, format, requested_format );
-			mlt_properties_set_int( properties, "format", *format );
+			if ( writable )
+				make_image_writable( self, buffer, *format );
+			mlt_properties_set_int_atom( properties, atom_format, *format );
 		}
 		else
 		{
+			crop_flush( self, NULL, mlt_image_none, NULL, NULL );
+			lut_flush( self, NULL, mlt_image_none, 0, 0, NULL );
 			error = generate_test_image( properties, buffer, format, width, height, writable );
 		}
 	}
-	else if ( mlt_properties_get_data( properties, "image", NULL ) && buffer )
+	else if ( mlt_properties_get_data_atom( properties, atom_image, NULL ) && buffer )
 	{
-		*format = mlt_properties_get_int( properties, "format" );
-		*buffer = mlt_properties_get_data( properties, "image", NULL );
-		*width = mlt_properties_get_int( properties, "width" );
-		*height = mlt_properties_get_int( properties, "height" );
-		if ( self->convert_image && *buffer && requested_format != mlt_image_none )
+		*format = mlt_properties_get_int_atom( properties, atom_format );
+		*buffer = mlt_properties_get_data_atom( properties, atom_image, NULL );
+		*width = mlt_properties_get_int_atom( properties, atom_width );
+		*height = mlt_properties_get_int_atom( properties, atom_height );
+		if ( !crop_defer || *format != requested_format )
+		{
+			crop_flush( self, buffer, *format, width, height );
+			mlt_properties_set_int_atom( properties, atom_width, *width );
+			mlt_properties_set_int_atom( properties, atom_height, *height );
+		}
+		if ( self->convert_image && *buffer && requested_format != mlt_image_none && requested_format != mlt_image_hwframe )
 		{
 			self->convert_image( self, buffer, format, requested_format );
-			mlt_properties_set_int( properties, "format", *format );
+			mlt_properties_set_int_atom( properties, atom_format, *format );
 		}
+		if ( writable && *buffer )
+			make_image_writable( self, buffer, *format );
 	}
 	else
 	{
@@ -522,6 +1443,304 @@ int mlt_frame_get_image( mlt_frame self, uint8_t **buffer, mlt_image_format *for
 	return error;
 }
 
+/** Get the image of a frame and replace each component by its entry in a lookup table.
+ *
+ * Filters that change each pixel independently, like gamma or invert, use this
+ * instead of mlt_frame_get_image() followed by a loop over the pixels. The
+ * image is always writable and the tables are only used when it comes back in
+ * the requested \p format and mlt_image_lut_supported() accepts it. They are
+ * not applied right away: the tables of a stack of such filters are combined
+ * with mlt_image_lut_compose() and applied once, in slices, when a service that
+ * is not one of them gets the image. The caller must therefore not touch the
+ * pixels of \p buffer itself, although it may change the alpha channel of
+ * a format that keeps it in a separate plane. See mlt_image_apply_lut() for the
+ * components of each format.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param[out] buffer an image buffer
+ * \param[in,out] format the image format
+ * \param[in,out] width the horizontal size in pixels
+ * \param[in,out] height the vertical size in pixels
+ * \param luts a table of 256 entries per component, NULL to leave it alone
+ * \return true if error
+ */
+
+int mlt_frame_get_image_lut( mlt_frame self, uint8_t **buffer, mlt_image_format *format, int *width, int *height, const uint8_t *luts[MLT_IMAGE_MAX_PLANES] )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	mlt_image_format requested_format = *format;
+	mlt_rect roi;
+
+	// A lookup table does not move pixels
+	mlt_frame_get_roi( self, &roi );
+	mlt_properties_set_int_atom( properties, atom_lut_defer, 1 );
+	int error = mlt_frame_get_image( self, buffer, format, width, height, 1 );
+	mlt_properties_set_int_atom( properties, atom_lut_defer, 0 );
+
+	// The alpha bounds still hold unless the alpha channel has a table
+	if ( !luts[3] )
+	{
+		mlt_rect bounds;
+		int opaque;
+		mlt_frame_get_alpha_bounds( self, &bounds, &opaque );
+	}
+
+	if ( !error && *buffer && *format == requested_format && mlt_image_lut_supported( *format ) )
+	{
+		frame_lut *pending = mlt_properties_get_data_atom( properties, atom_lut, NULL );
+		if ( pending && pending->format != *format )
+		{
+			// A pending table always matches the image, but do not apply it to another format
+			lut_flush( self, NULL, mlt_image_none, 0, 0, NULL );
+			pending = NULL;
+		}
+		if ( !pending )
+		{
+			pending = calloc( 1, sizeof( *pending ) );
+			if ( !pending )
+				return 1;
+			pending->format = *format;
+			mlt_properties_set_data_atom( properties, atom_lut, pending, 0, free, NULL );
+		}
+		for ( int i = 0; i < MLT_IMAGE_MAX_PLANES; i++ )
+		{
+			if ( !luts[i] )
+				continue;
+			if ( pending->used[i] )
+				mlt_image_lut_compose( pending->luts[i], pending->luts[i], luts[i] );
+			else
+				memcpy( pending->luts[i], luts[i], 256 );
+			pending->used[i] = 1;
+		}
+	}
+	return error;
+}
+
+/** Get the image of a frame as plane pointers and strides, without copying a crop.
+ *
+ * This is like mlt_frame_get_image() with writable false, but when the image
+ * comes back cropped by mlt_frame_crop_image() in the requested format, the
+ * crop is not copied: the planes of \p image point at the crop window inside
+ * the full image and the strides are those of the full image. The alpha
+ * channel of the frame, if any, is in planes[3] and strides[3] the same way.
+ * The image is owned by the frame and must not be written to, and
+ * mlt_image_close() does not release it. Callers that need the rows packed
+ * call mlt_frame_pack_image(), which copies the crop. Do not call
+ * mlt_frame_get_image() again for that, since the image stack is spent.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param[in,out] image the requested format, width and height as input, and the image as output
+ * \return true if error
+ */
+
+int mlt_frame_get_image_strided( mlt_frame self, mlt_image image )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	uint8_t *buffer = NULL;
+	mlt_image_format format = image->format;
+	int width = image->width;
+	int height = image->height;
+
+	mlt_properties_set_int_atom( properties, atom_crop_defer, 1 );
+	int error = mlt_frame_get_image( self, &buffer, &format, &width, &height, 0 );
+	mlt_properties_set_int_atom( properties, atom_crop_defer, 0 );
+
+	frame_crop *pending = mlt_properties_get_data_atom( properties, atom_crop, NULL );
+	if ( pending && ( error || !buffer || !crop_is_strided( format ) || pending->format != format
+		|| pending->width != width || pending->height != height ) )
+	{
+		crop_flush( self, error ? NULL : &buffer, format, &width, &height );
+		mlt_properties_set_int_atom( properties, atom_width, width );
+		mlt_properties_set_int_atom( properties, atom_height, height );
+		pending = NULL;
+	}
+
+	mlt_image_set_values( image, buffer, format, width, height );
+	int alpha_size = 0;
+	uint8_t *alpha = mlt_properties_get_data_atom( properties, atom_alpha, &alpha_size );
+	if ( alpha && alpha_size >= width * height )
+	{
+		image->alpha = alpha;
+		image->planes[3] = alpha;
+		image->strides[3] = width;
+	}
+	if ( pending && buffer )
+	{
+		int bpp;
+		mlt_image_format_size( format, 1, 1, &bpp );
+		image->planes[0] += pending->y * image->strides[0] + pending->x * bpp;
+		if ( image->alpha )
+			image->planes[3] += pending->y * image->strides[3] + pending->x;
+		image->width = pending->crop_width;
+		image->height = pending->crop_height;
+	}
+	return error;
+}
+
+/** Pack an image returned by mlt_frame_get_image_strided().
+ *
+ * This copies the crop window that mlt_frame_get_image_strided() left in place,
+ * if any, so that the rows of \p image are tightly packed as in the frame, and
+ * makes it writable if asked. It is for callers that decide after getting the
+ * image that they cannot read it with strides.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param[in,out] image the image from mlt_frame_get_image_strided(), packed as output
+ * \param writable whether or not the image will need to be writable
+ * \return true if error
+ */
+
+int mlt_frame_pack_image( mlt_frame self, mlt_image image, int writable )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	uint8_t *buffer = image->data;
+	mlt_image_format format = image->format;
+	int width = image->width;
+	int height = image->height;
+
+	if ( !buffer )
+		return 1;
+
+	// The planes point into the full image while a crop is pending
+	frame_crop *pending = mlt_properties_get_data_atom( properties, atom_crop, NULL );
+	if ( pending )
+	{
+		width = pending->width;
+		height = pending->height;
+		crop_flush( self, &buffer, format, &width, &height );
+		mlt_properties_set_int_atom( properties, atom_width, width );
+		mlt_properties_set_int_atom( properties, atom_height, height );
+	}
+	if ( writable )
+		make_image_writable( self, &buffer, format );
+
+	mlt_image_set_values( image, buffer, format, width, height );
+	int alpha_size = 0;
+	uint8_t *alpha = mlt_properties_get_data_atom( properties, atom_alpha, &alpha_size );
+	if ( alpha && alpha_size >= width * height )
+	{
+		image->alpha = alpha;
+		image->planes[3] = alpha;
+		image->strides[3] = width;
+	}
+	return 0;
+}
+
+/** Start rendering the image of a frame on the slices pool.
+ *
+ * This lets a transition render the image of its b frame while it renders the
+ * a frame on the calling thread. The first call to mlt_frame_get_image() for
+ * this frame waits for it, or renders it if the pool has not started, and
+ * returns its result when it asks for the same format, size, and whether it is
+ * writable. It only starts for frames whose \em _prefetch property was set by
+ * the service that made them, for example a tractor with \em parallel_tracks,
+ * since every service rendering the frame must then be safe to run alongside
+ * the rest of the graph. Do not call it on a frame that another thread may be
+ * rendering.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param format the image format that will be requested
+ * \param width the horizontal size in pixels that will be requested
+ * \param height the vertical size in pixels that will be requested
+ * \param writable whether or not the image will need to be writable
+ * \return true if the image is not being rendered ahead
+ */
+
+int mlt_frame_prefetch_image( mlt_frame self, mlt_image_format format, int width, int height, int writable )
+{
+	if ( !self )
+		return 1;
+
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	if ( !mlt_properties_get_int_atom( properties, atom_prefetch )
+		|| !mlt_deque_count( self->stack_image )
+		|| mlt_properties_get_data_atom( properties, atom_image_prefetch, NULL ) )
+		return 1;
+
+	frame_prefetch *prefetch = prefetch_init( self );
+	if ( !prefetch )
+		return 1;
+	prefetch->requested_image.format = format;
+	prefetch->requested_image.width = width;
+	prefetch->requested_image.height = height;
+	prefetch->requested_image.writable = writable;
+	return prefetch_submit( prefetch, atom_image_prefetch );
+}
+
+/** Start rendering the audio of a frame on the slices pool.
+ *
+ * This is the counterpart of mlt_frame_prefetch_image() for transitions that
+ * mix audio. The next call to mlt_frame_get_audio() for this frame returns its
+ * result when it asks for the same format, frequency, channels, and samples.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param format the audio format that will be requested
+ * \param frequency the sample rate that will be requested
+ * \param channels the number of channels that will be requested
+ * \param samples the number of samples that will be requested
+ * \return true if the audio is not being rendered ahead
+ */
+
+int mlt_frame_prefetch_audio( mlt_frame self, mlt_audio_format format, int frequency, int channels, int samples )
+{
+	if ( !self )
+		return 1;
+
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	if ( !mlt_properties_get_int_atom( properties, atom_prefetch )
+		|| !mlt_deque_count( self->stack_audio )
+		|| mlt_properties_get_data_atom( properties, atom_audio_prefetch, NULL ) )
+		return 1;
+
+	frame_prefetch *prefetch = prefetch_init( self );
+	if ( !prefetch )
+		return 1;
+	prefetch->is_audio = 1;
+	prefetch->requested_audio.format = format;
+	prefetch->requested_audio.frequency = frequency;
+	prefetch->requested_audio.channels = channels;
+	prefetch->requested_audio.samples = samples;
+	return prefetch_submit( prefetch, atom_audio_prefetch );
+}
+
+/** Ask the services rendering a frame to give up early.
+ *
+ * This is used by the consumer for frames that are purged while rendering.
+ * Producers, filters, and transitions should check mlt_frame_is_cancelled()
+ * in their costly loops and return an error when it is set.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ */
+
+void mlt_frame_cancel( mlt_frame self )
+{
+	if ( self )
+		mlt_properties_set_int_atom( MLT_FRAME_PROPERTIES( self ), atom_cancelled, 1 );
+}
+
+/** Determine if rendering a frame was cancelled.
+ *
+ * The frames nested inside a frame (tracks of a tractor, for example) are
+ * also cancelled while they are rendered for it on the same thread.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \return true if the frame or the frame being rendered for is cancelled
+ */
+
+int mlt_frame_is_cancelled( mlt_frame self )
+{
+	mlt_frame root = pthread_getspecific( render_key );
+	return ( self && mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( self ), atom_cancelled ) ) ||
+		( root && root != self && mlt_properties_get_int_atom( MLT_FRAME_PROPERTIES( root ), atom_cancelled ) );
+}
+
 /** Get the alpha channel associated to the frame (without creating if it has not).
  *
  * \public \memberof mlt_frame_s
@@ -534,11 +1753,81 @@ uint8_t *mlt_frame_get_alpha( mlt_frame self )
 	uint8_t *alpha = NULL;
 	if ( self != NULL )
 	{
-		alpha = mlt_properties_get_data( &self->parent, "alpha", NULL );
+		alpha = mlt_properties_get_data_atom( &self->parent, atom_alpha, NULL );
 	}
 	return alpha;
 }
 
+/** Set the channels that are used of the next audio request.
+ *
+ * A filter or consumer that uses only some of the channels of the audio of a
+ * frame, like one that drops or remaps channels, calls this before
+ * mlt_frame_get_audio(). The services that render the audio may then leave the
+ * other channels silent, and a producer may skip decoding them; others ignore
+ * it. Like the region of interest of an image, it applies to the next call to
+ * mlt_frame_get_audio() only, and only reaches the services further up the
+ * stack through those that pass it on with mlt_frame_get_audio_channels_used().
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param mask a bit for each channel that is used, counting from the least
+ * significant bit; the channels from the 64th on are always used
+ */
+
+void mlt_frame_set_audio_channels_used( mlt_frame self, uint64_t mask )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	mlt_properties_set_int64_atom( properties, atom_audio_used, (int64_t) mask );
+	mlt_properties_set_int_atom( properties, atom_audio_used_depth, mlt_deque_count( self->stack_audio ) + 1 );
+}
+
+/** Get the channels that are used of the audio being rendered and pass them on.
+ *
+ * A service that renders the audio of a frame calls this in its get_audio
+ * function after popping its arguments from the stack and before it calls
+ * mlt_frame_get_audio(). Only call it if each channel of the audio from the
+ * rest of the stack goes to the same channel of the audio it returns, or if it
+ * sets new channels with mlt_frame_set_audio_channels_used() afterwards.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param[out] mask a bit for each channel that is used, all bits if there are no used channels set
+ * \return true if the used channels are set
+ */
+
+int mlt_frame_get_audio_channels_used( mlt_frame self, uint64_t *mask )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	int depth = mlt_properties_get_int_atom( properties, atom_audio_used_depth );
+	int count = mlt_deque_count( self->stack_audio );
+
+	// Given to the get_audio call that is running this service, or passed on already
+	if ( depth == ROI_RUNNING || ( depth && depth == count + 1 ) )
+	{
+		mlt_properties_set_int_atom( properties, atom_audio_used_depth, count + 1 );
+		*mask = (uint64_t) mlt_properties_get_int64_atom( properties, atom_audio_used );
+		return 1;
+	}
+	*mask = UINT64_MAX;
+	return 0;
+}
+
+/** Take the used channels given to a call to mlt_frame_get_audio().
+ *
+ * \private \memberof mlt_frame_s
+ * \param self a frame
+ */
+
+static void audio_used_enter( mlt_frame self )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	int depth = mlt_properties_get_int_atom( properties, atom_audio_used_depth );
+
+	if ( depth )
+		mlt_properties_set_int_atom( properties, atom_audio_used_depth,
+			depth == mlt_deque_count( self->stack_audio ) + 1 ? ROI_RUNNING : 0 );
+}
+
 /** Get the audio associated to the frame.
  *
  * You should express the desired format, frequency, channels, and samples as inputs. As long
@@ -562,28 +1851,54 @@ uint8_t *mlt_frame_get_alpha( mlt_frame self )
 
 int mlt_frame_get_audio( mlt_frame self, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
 {
-	mlt_get_audio get_audio = mlt_frame_pop_audio( self );
 	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
-	int hide = mlt_properties_get_int( properties, "test_audio" );
+	frame_prefetch *prefetch = mlt_properties_get_data_atom( properties, atom_audio_prefetch, NULL );
+	if ( prefetch && pthread_getspecific( prefetch_key ) != prefetch )
+	{
+		prefetch_finish( prefetch, 1 );
+		if ( prefetch->requested_audio.format == *format
+			&& prefetch->requested_audio.frequency == *frequency
+			&& prefetch->requested_audio.channels == *channels
+			&& prefetch->requested_audio.samples == *samples
+			&& prefetch_consume( prefetch ) )
+		{
+			*buffer = prefetch->buffer;
+			*format = prefetch->format;
+			*frequency = prefetch->frequency;
+			*channels = prefetch->channels;
+			*samples = prefetch->samples;
+			return prefetch->error;
+		}
+		// Otherwise the stack is done and the audio is converted as requested below
+	}
+
+	audio_used_enter( self );
+	mlt_get_audio get_audio = mlt_frame_pop_audio( self );
+	int hide = mlt_properties_get_int_atom( properties, atom_test_audio );
 	mlt_audio_format requested_format = *format;
 
 	if ( hide == 0 && get_audio != NULL )
 	{
+		void *pusher = mlt_trace_pusher( self, "audio", mlt_deque_count( self->stack_audio ) );
+		void *previous = mlt_trace_enter( pusher );
+		int64_t trace_begin = mlt_trace_now();
 		get_audio( self, buffer, format, frequency, channels, samples );
-		mlt_properties_set_int( properties, "audio_frequency", *frequency );
-		mlt_properties_set_int( properties, "audio_channels", *channels );
-		mlt_properties_set_int( properties, "audio_samples", *samples );
-		mlt_properties_set_int( properties, "audio_format", *format );
+		mlt_trace_callback( get_audio, pusher, "get_audio", trace_begin );
+		mlt_trace_leave( previous );
+		mlt_properties_set_int_atom( properties, atom_audio_frequency, *frequency );
+		mlt_properties_set_int_atom( properties, atom_audio_channels, *channels );
+		mlt_properties_set_int_atom( properties, atom_audio_samples, *samples );
+		mlt_properties_set_int_atom( properties, atom_audio_format, *format );
 		if ( self->convert_audio && *buffer && requested_format != mlt_audio_none )
 			self->convert_audio( self, buffer, format, requested_format );
 	}
-	else if ( mlt_properties_get_data( properties, "audio", NULL ) )
+	else if ( mlt_properties_get_data_atom( properties, atom_audio, NULL ) )
 	{
-		*buffer = mlt_properties_get_data( properties, "audio", NULL );
-		*format = mlt_properties_get_int( properties, "audio_format" );
-		*frequency = mlt_properties_get_int( properties, "audio_frequency" );
-		*channels = mlt_properties_get_int( properties, "audio_channels" );
-		*samples = mlt_properties_get_int( properties, "audio_samples" );
+		*buffer = mlt_properties_get_data_atom( properties, atom_audio, NULL );
+		*format = mlt_properties_get_int_atom( properties, atom_audio_format );
+		*frequency = mlt_properties_get_int_atom( properties, atom_audio_frequency );
+		*channels = mlt_properties_get_int_atom( properties, atom_audio_channels );
+		*samples = mlt_properties_get_int_atom( properties, atom_audio_samples );
 		if ( self->convert_audio && *buffer && requested_format != mlt_audio_none )
 			self->convert_audio( self, buffer, format, requested_format );
 	}
@@ -593,10 +1908,10 @@ int mlt_frame_get_audio( mlt_frame self, void **buffer, mlt_audio_format *format
 		*samples = *samples <= 0 ? 1920 : *samples;
 		*channels = *channels <= 0 ? 2 : *channels;
 		*frequency = *frequency <= 0 ? 48000 : *frequency;
-		mlt_properties_set_int( properties, "audio_frequency", *frequency );
-		mlt_properties_set_int( properties, "audio_channels", *channels );
-		mlt_properties_set_int( properties, "audio_samples", *samples );
-		mlt_properties_set_int( properties, "audio_format", *format );
+		mlt_properties_set_int_atom( properties, atom_audio_frequency, *frequency );
+		mlt_properties_set_int_atom( properties, atom_audio_channels, *channels );
+		mlt_properties_set_int_atom( properties, atom_audio_samples, *samples );
+		mlt_properties_set_int_atom( properties, atom_audio_format, *format );
 
 		size = mlt_audio_format_size( *format, *samples, *channels );
 		if ( size )
@@ -605,8 +1920,8 @@ int mlt_frame_get_audio( mlt_frame self, void **buffer, mlt_audio_format *format
 			*buffer = NULL;
 		if ( *buffer )
 			memset( *buffer, 0, size );
-		mlt_properties_set_data( properties, "audio", *buffer, size, ( mlt_destructor )mlt_pool_release, NULL );
-		mlt_properties_set_int( properties, "test_audio", 1 );
+		mlt_properties_set_data_atom( properties, atom_audio, *buffer, size, ( mlt_destructor )mlt_pool_release, NULL );
+		mlt_properties_set_int_atom( properties, atom_test_audio, 1 );
 	}
 
 	// TODO: This does not belong here
@@ -648,8 +1963,8 @@ int mlt_frame_get_audio( mlt_frame self, void **buffer, mlt_audio_format *format
 
 int mlt_frame_set_audio( mlt_frame self, void *buffer, mlt_audio_format format, int size, mlt_destructor destructor )
 {
-	mlt_properties_set_int( MLT_FRAME_PROPERTIES( self ), "audio_format", format );
-	return mlt_properties_set_data( MLT_FRAME_PROPERTIES( self ), "audio", buffer, size, destructor, NULL );
+	mlt_properties_set_int_atom( MLT_FRAME_PROPERTIES( self ), atom_audio_format, format );
+	return mlt_properties_set_data_atom( MLT_FRAME_PROPERTIES( self ), atom_audio, buffer, size, destructor, NULL );
 }
 
 /** Get audio on a frame as a waveform image.
@@ -746,7 +2061,7 @@ unsigned char *mlt_frame_get_waveform( mlt_frame self, int w, int h )
 mlt_producer mlt_frame_get_original_producer( mlt_frame self )
 {
 	if ( self != NULL )
-		return mlt_properties_get_data( MLT_FRAME_PROPERTIES( self ), "_producer", NULL );
+		return mlt_properties_get_data_atom( MLT_FRAME_PROPERTIES( self ), atom_producer, NULL );
 	return NULL;
 }
 
@@ -760,6 +2075,13 @@ void mlt_frame_close( mlt_frame self )
 {
 	if ( self != NULL && mlt_properties_dec_ref( MLT_FRAME_PROPERTIES( self ) ) <= 0 )
 	{
+		// Stop an image that is rendering ahead before taking the frame apart
+		frame_prefetch *prefetch = mlt_properties_get_data_atom( MLT_FRAME_PROPERTIES( self ), atom_image_prefetch, NULL );
+		if ( prefetch )
+			prefetch_finish( prefetch, 0 );
+		prefetch = mlt_properties_get_data_atom( MLT_FRAME_PROPERTIES( self ), atom_audio_prefetch, NULL );
+		if ( prefetch )
+			prefetch_finish( prefetch, 0 );
 		mlt_deque_close( self->stack_image );
 		mlt_deque_close( self->stack_audio );
 		while( mlt_deque_peek_back( self->stack_service ) )
@@ -820,6 +2142,7 @@ mlt_properties mlt_frame_unique_properties( mlt_frame self, mlt_service service
 	if ( !instance_props )
 	{
 		instance_props = mlt_properties_new();
+		mlt_properties_use_arena( instance_props );
 		mlt_properties_set_data( frame_props, unique, instance_props, 0, (mlt_destructor) mlt_properties_close, NULL );
 		mlt_properties_set_lcnumeric( instance_props, mlt_properties_get_lcnumeric( service_props ) );
 		mlt_properties_set_data( instance_props, "_profile", mlt_service_profile( service ), 0, NULL, NULL );
@@ -845,11 +2168,39 @@ mlt_properties mlt_frame_get_unique_properties( mlt_frame self, mlt_service serv
 	return mlt_properties_get_data( MLT_FRAME_PROPERTIES(self), unique, NULL );
 }
 
+/** Make a new frame with the properties of a frame.
+ *
+ * \private \memberof mlt_frame_s
+ * \param self the frame to clone
+ * \return a frame without image, audio or processing stacks
+ */
+
+static mlt_frame clone_properties( mlt_frame self )
+{
+	mlt_frame new_frame = mlt_frame_init( NULL );
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	mlt_properties new_props = MLT_FRAME_PROPERTIES( new_frame );
+
+	mlt_properties_inherit( new_props, properties );
+
+	// Carry over some special data properties for the multi consumer.
+	mlt_properties_set_data_atom( new_props, atom_producer,
+		mlt_frame_get_original_producer( self ), 0, NULL, NULL );
+	mlt_properties_set_data( new_props, "movit.convert",
+		mlt_properties_get_data( properties, "movit.convert", NULL), 0, NULL, NULL );
+	return new_frame;
+}
+
 /** Make a copy of a frame.
  *
  * This does not copy the get_image/get_audio processing stacks or any
  * data properties other than the audio and image.
  *
+ * An image in a shared buffer from mlt_image_buffer_alloc() is never copied
+ * here. Both frames hold a reference to it, and the first writable get_image
+ * on either of them copies it. A shallow clone also copies an image that it
+ * borrows from \p self before it is written.
+ *
  * \public \memberof mlt_frame_s
  * \param self the frame to clone
  * \param is_deep a boolean to indicate whether to make a deep copy of the audio
@@ -860,54 +2211,63 @@ mlt_properties mlt_frame_get_unique_properties( mlt_frame self, mlt_service serv
 
 mlt_frame mlt_frame_clone( mlt_frame self, int is_deep )
 {
-	mlt_frame new_frame = mlt_frame_init( NULL );
+	mlt_frame new_frame = clone_properties( self );
 	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
 	mlt_properties new_props = MLT_FRAME_PROPERTIES( new_frame );
 	void *data, *copy;
 	int size;
 
-	mlt_properties_inherit( new_props, properties );
-
-	// Carry over some special data properties for the multi consumer.
-	mlt_properties_set_data( new_props, "_producer",
-		mlt_frame_get_original_producer( self ), 0, NULL, NULL );
-	mlt_properties_set_data( new_props, "movit.convert",
-		mlt_properties_get_data( properties, "movit.convert", NULL), 0, NULL, NULL );
-
 	if ( is_deep )
 	{
-		data = mlt_properties_get_data( properties, "audio", &size );
+		data = mlt_properties_get_data_atom( properties, atom_audio, &size );
 		if ( data )
 		{
 			if ( !size )
-				size = mlt_audio_format_size( mlt_properties_get_int( properties, "audio_format" ),
-					mlt_properties_get_int( properties, "audio_samples" ),
-					mlt_properties_get_int( properties, "audio_channels" ) );
+				size = mlt_audio_format_size( mlt_properties_get_int_atom( properties, atom_audio_format ),
+					mlt_properties_get_int_atom( properties, atom_audio_samples ),
+					mlt_properties_get_int_atom( properties, atom_audio_channels ) );
 			copy = mlt_pool_alloc( size );
 			memcpy( copy, data, size );
-			mlt_properties_set_data( new_props, "audio", copy, size, mlt_pool_release, NULL );
+			mlt_properties_set_data_atom( new_props, atom_audio, copy, size, mlt_pool_release, NULL );
 		}
-		data = mlt_properties_get_data( properties, "image", &size );
+		data = mlt_properties_get_data_atom( properties, atom_image, &size );
 		if ( data )
 		{
-			int width = mlt_properties_get_int( properties, "width" );
-			int height = mlt_properties_get_int( properties, "height" );
+			int width = mlt_properties_get_int_atom( properties, atom_width );
+			int height = mlt_properties_get_int_atom( properties, atom_height );
 
 			if ( ! size )
-				size = mlt_image_format_size( mlt_properties_get_int( properties, "format" ),
+				size = mlt_image_format_size( mlt_properties_get_int_atom( properties, atom_format ),
 					width, height, NULL );
-			copy = mlt_pool_alloc( size );
-			memcpy( copy, data, size );
-			mlt_properties_set_data( new_props, "image", copy, size, mlt_pool_release, NULL );
 
-			data = mlt_properties_get_data( properties, "alpha", &size );
+			// Share a shared image and copy any other into a shared buffer, so
+			// that clones of the clone (as made by mlt_cache) cost nothing
+			if ( mlt_properties_get_int_atom( properties, atom_format ) == mlt_image_hwframe )
+			{
+				// A hardware surface cannot be copied here, so keep the original alive
+				mlt_properties_inc_ref( properties );
+				mlt_properties_set_data_atom( new_props, atom_cloned_frame, self, 0,
+					(mlt_destructor) mlt_frame_close, NULL );
+				mlt_properties_set_data_atom( new_props, atom_image, data, size, NULL, NULL );
+			}
+			else if ( data == mlt_properties_get_data_atom( properties, atom_image_shared, NULL ) )
+			{
+				mlt_frame_set_image( new_frame, mlt_image_buffer_ref( data ), size, mlt_image_buffer_release );
+			}
+			else if ( ( copy = mlt_image_buffer_alloc( size ) ) )
+			{
+				memcpy( copy, data, size );
+				mlt_frame_set_image( new_frame, copy, size, mlt_image_buffer_release );
+			}
+
+			data = mlt_properties_get_data_atom( properties, atom_alpha, &size );
 			if ( data )
 			{
 				if ( ! size )
 					size = width * height;
 				copy = mlt_pool_alloc( size );
 				memcpy( copy, data, size );
-				mlt_properties_set_data( new_props, "alpha", copy, size, mlt_pool_release, NULL );
+				mlt_properties_set_data_atom( new_props, atom_alpha, copy, size, mlt_pool_release, NULL );
 			};
 		}
 	}
@@ -915,17 +2275,66 @@ mlt_frame mlt_frame_clone( mlt_frame self, int is_deep )
 	{
 		// This frame takes a reference on the original frame since the data is a shallow copy.
 		mlt_properties_inc_ref( properties );
-		mlt_properties_set_data( new_props, "_cloned_frame", self, 0,
+		mlt_properties_set_data_atom( new_props, atom_cloned_frame, self, 0,
 			(mlt_destructor) mlt_frame_close, NULL );
 
 		// Copy properties
-		data = mlt_properties_get_data( properties, "audio", &size );
-		mlt_properties_set_data( new_props, "audio", data, size, NULL, NULL );
-		data = mlt_properties_get_data( properties, "image", &size );
-		mlt_properties_set_data( new_props, "image", data, size, NULL, NULL );
-		data = mlt_properties_get_data( properties, "alpha", &size );
-		mlt_properties_set_data( new_props, "alpha", data, size, NULL, NULL );
+		data = mlt_properties_get_data_atom( properties, atom_audio, &size );
+		mlt_properties_set_data_atom( new_props, atom_audio, data, size, NULL, NULL );
+		data = mlt_properties_get_data_atom( properties, atom_image, &size );
+		if ( data && data == mlt_properties_get_data_atom( properties, atom_image_shared, NULL ) )
+			mlt_frame_set_image( new_frame, mlt_image_buffer_ref( data ), size, mlt_image_buffer_release );
+		else
+			mlt_properties_set_data_atom( new_props, atom_image, data, size, NULL, NULL );
+		data = mlt_properties_get_data_atom( properties, atom_alpha, &size );
+		mlt_properties_set_data_atom( new_props, atom_alpha, data, size, NULL, NULL );
+	}
+
+	return new_frame;
+}
+
+/** Make a copy of a frame for its image only.
+ *
+ * This is a cheaper deep mlt_frame_clone() for services that keep a snapshot
+ * of an image while the frame goes on to be processed. The audio is left out
+ * and the image is never copied here: it is moved into a shared buffer on
+ * \p self if it is not in one yet, and both frames hold a reference to it, so
+ * that the first writable get_image on either of them makes the copy. The
+ * alpha channel is copied. A mlt_image_hwframe image is kept alive with the
+ * frame as by mlt_frame_clone().
+ *
+ * \public \memberof mlt_frame_s
+ * \param self the frame to clone
+ * \return a copy of the frame with its image
+ */
+
+mlt_frame mlt_frame_clone_image( mlt_frame self )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( self );
+	mlt_image_format format = mlt_properties_get_int_atom( properties, atom_format );
+	int size = 0;
+	uint8_t *image = NULL;
+
+	if ( format != mlt_image_hwframe )
+		image = mlt_frame_share_image( self, &size );
+	if ( !image )
+	{
+		// Nothing to share, so the audio is not worth leaving out
+		return mlt_frame_clone( self, 1 );
 	}
 
+	mlt_frame new_frame = clone_properties( self );
+	mlt_properties new_props = MLT_FRAME_PROPERTIES( new_frame );
+	mlt_frame_set_image( new_frame, image, size, mlt_image_buffer_release );
+
+	uint8_t *alpha = mlt_properties_get_data_atom( properties, atom_alpha, &size );
+	if ( alpha )
+	{
+		if ( !size )
+			size = mlt_properties_get_int_atom( properties, atom_width ) * mlt_properties_get_int_atom( properties, atom_height );
+		uint8_t *copy = mlt_pool_alloc( size );
+		memcpy( copy, alpha, size );
+		mlt_properties_set_data_atom( new_props, atom_alpha, copy, size, mlt_pool_release, NULL );
+	}
 	return new_frame;
 }
@@ -69,6 +69,8 @@ typedef int ( *mlt_get_audio )( mlt_frame self, void **buffer, mlt_audio_format
  * \properties \em width the horizontal resolution of the image
  * \properties \em height the vertical resolution of the image
  * \properties \em aspect_ratio the sample aspect ratio of the image
+ * \properties \em _prefetch set by the service that made the frame to allow mlt_frame_prefetch_image() and mlt_frame_prefetch_audio()
+ * \properties \em video_off set when the frame was made for a consumer which never gets the image, see mlt_frame_is_video_off()
  */
 
 struct mlt_frame_s
@@ -108,18 +110,35 @@ extern mlt_frame mlt_frame_init( mlt_service service );
 extern mlt_properties mlt_frame_properties( mlt_frame self );
 extern int mlt_frame_is_test_card( mlt_frame self );
 extern int mlt_frame_is_test_audio( mlt_frame self );
+extern int mlt_frame_is_video_off( mlt_frame self );
+extern int mlt_frame_set_thread_video_off( int video_off );
 extern double mlt_frame_get_aspect_ratio( mlt_frame self );
 extern int mlt_frame_set_aspect_ratio( mlt_frame self, double value );
 extern mlt_position mlt_frame_get_position( mlt_frame self );
 extern mlt_position mlt_frame_original_position( mlt_frame self );
 extern int mlt_frame_set_position( mlt_frame self, mlt_position value );
 extern int mlt_frame_set_image( mlt_frame self, uint8_t *image, int size, mlt_destructor destroy );
+extern uint8_t *mlt_frame_share_image( mlt_frame self, int *size );
 extern int mlt_frame_set_alpha( mlt_frame self, uint8_t *alpha, int size, mlt_destructor destroy );
 extern void mlt_frame_replace_image( mlt_frame self, uint8_t *image, mlt_image_format format, int width, int height );
 extern int mlt_frame_get_image( mlt_frame self, uint8_t **buffer, mlt_image_format *format, int *width, int *height, int writable );
+extern int mlt_frame_get_image_lut( mlt_frame self, uint8_t **buffer, mlt_image_format *format, int *width, int *height, const uint8_t *luts[MLT_IMAGE_MAX_PLANES] );
+extern int mlt_frame_get_image_strided( mlt_frame self, mlt_image image );
+extern int mlt_frame_pack_image( mlt_frame self, mlt_image image, int writable );
+extern void mlt_frame_crop_image( mlt_frame self, mlt_image_format format, int width, int height, int left, int right, int top, int bottom );
+extern void mlt_frame_set_roi( mlt_frame self, mlt_rect rect );
+extern int mlt_frame_get_roi( mlt_frame self, mlt_rect *rect );
+extern void mlt_frame_set_alpha_bounds( mlt_frame self, mlt_rect bounds, int opaque );
+extern int mlt_frame_get_alpha_bounds( mlt_frame self, mlt_rect *bounds, int *opaque );
+extern int mlt_frame_prefetch_image( mlt_frame self, mlt_image_format format, int width, int height, int writable );
+extern void mlt_frame_cancel( mlt_frame self );
+extern int mlt_frame_is_cancelled( mlt_frame self );
 extern uint8_t *mlt_frame_get_alpha( mlt_frame self );
 extern int mlt_frame_get_audio( mlt_frame self, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples );
+extern int mlt_frame_prefetch_audio( mlt_frame self, mlt_audio_format format, int frequency, int channels, int samples );
 extern int mlt_frame_set_audio( mlt_frame self, void *buffer, mlt_audio_format, int size, mlt_destructor );
+extern void mlt_frame_set_audio_channels_used( mlt_frame self, uint64_t mask );
+extern int mlt_frame_get_audio_channels_used( mlt_frame self, uint64_t *mask );
 extern unsigned char *mlt_frame_get_waveform( mlt_frame self, int w, int h );
 extern int mlt_frame_push_get_image( mlt_frame self, mlt_get_image get_image );
 extern mlt_get_image mlt_frame_pop_get_image( mlt_frame self );
@@ -137,6 +156,7 @@ extern void mlt_frame_close( mlt_frame self );
 extern mlt_properties mlt_frame_unique_properties( mlt_frame self, mlt_service service );
 extern mlt_properties mlt_frame_get_unique_properties( mlt_frame self, mlt_service service );
 extern mlt_frame mlt_frame_clone( mlt_frame self, int is_deep );
+extern mlt_frame mlt_frame_clone_image( mlt_frame self );
 
 /* convenience functions */
 extern void mlt_frame_write_ppm( mlt_frame frame );
@@ -23,9 +23,52 @@
 #include "mlt_image.h"
 
 #include "mlt_log.h"
+#include "mlt_slices.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define USE_NEON 1
+#endif
+
+/** the bytes in front of a shared buffer, which keep its data aligned like a pool block */
+
+#define SHARED_HEADER_SIZE 64
+
+/** \brief private to mlt_image, the reference count in front of a shared buffer */
+
+typedef struct
+{
+	atomic_int references;
+}
+shared_header;
+
+static inline int align_up( int value, int alignment )
+{
+	return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+static int plane_height( mlt_image_format format, int height, int plane )
+{
+	switch ( format )
+	{
+		case mlt_image_yuv420p:
+		case mlt_image_yuv420p10:
+		case mlt_image_nv12:
+		case mlt_image_p010:
+			return plane > 0 ? height >> 1 : height;
+		default:
+			return height;
+	}
+}
 
 /** Allocate a new Image object.
  *
@@ -84,12 +127,17 @@ void mlt_image_set_values( mlt_image self, void* data, mlt_image_format format,
 	self->height = height;
 	self->colorspace = mlt_colorspace_unspecified;
 	self->release_data = NULL;
+	self->alpha = NULL;
 	self->release_alpha = NULL;
 	self->close = NULL;
 	mlt_image_format_planes( self->format, self->width, self->height, self->data, self->planes, self->strides );
 }
 
 /** Get the most common values for the image.
+ *
+ * This does not change the image. The raw data of a frame is tightly packed,
+ * so call mlt_image_pack() first if the planes may be padded, as they are
+ * after mlt_image_alloc_data(), and the data is going to a frame.
  *
  * \public \memberof mlt_image_s
  * \param self the Image object
@@ -116,6 +164,10 @@ void mlt_image_get_values( mlt_image self, void** data, mlt_image_format* format
  * After this function call, the release_data field will be set and can be used
  * to release the data when necessary.
  *
+ * Each plane starts on a MLT_IMAGE_ALIGNMENT boundary and its rows are padded
+ * to a multiple of it, so always address rows through planes and strides. Use
+ * mlt_image_pack() before handing the data to a frame.
+ *
  * \public \memberof mlt_image_s
  * \param self the Image object
  */
@@ -129,10 +181,10 @@ void mlt_image_alloc_data( mlt_image self )
 		self->release_data( self->data );
 	}
 
-	int size = mlt_image_calculate_size( self );
+	int size = mlt_image_format_planes_aligned( self->format, self->width, self->height, NULL, self->planes, self->strides, MLT_IMAGE_ALIGNMENT );
 	self->data = mlt_pool_alloc( size );
 	self->release_data = mlt_pool_release;
-	mlt_image_format_planes( self->format, self->width, self->height, self->data, self->planes, self->strides );
+	mlt_image_format_planes_aligned( self->format, self->width, self->height, self->data, self->planes, self->strides, MLT_IMAGE_ALIGNMENT );
 }
 
 /** Allocate the alpha field based on the other properties of the Image.
@@ -157,12 +209,117 @@ void mlt_image_alloc_alpha( mlt_image self )
 		self->release_alpha( self->alpha );
 	}
 
-	self->alpha = mlt_pool_alloc( self->width * self->height );
+	self->strides[3] = align_up( self->width, MLT_IMAGE_ALIGNMENT );
+	self->alpha = mlt_pool_alloc( self->strides[3] * self->height );
 	self->release_alpha = mlt_pool_release;
-	self->strides[3] = self->width;
 	self->planes[3] = self->alpha;
 }
 
+/** Pack padded planes of the image in place.
+ *
+ * The frame API passes images around as a single tightly packed buffer. This
+ * moves the rows of each plane, and of the alpha plane owned by the image, to
+ * the layout given by mlt_image_format_planes(), and updates planes and
+ * strides to match. The planes must lie inside the data buffer, at or after
+ * their packed position, as they do after mlt_image_alloc_data(). It does
+ * nothing when the rows are already packed, which is the case whenever the
+ * packed row sizes are a multiple of MLT_IMAGE_ALIGNMENT.
+ *
+ * \public \memberof mlt_image_s
+ * \param self the Image object
+ */
+
+void mlt_image_pack( mlt_image self )
+{
+	if ( !self || !self->data ) return;
+
+	uint8_t* planes[MLT_IMAGE_MAX_PLANES];
+	int strides[MLT_IMAGE_MAX_PLANES];
+	mlt_image_format_planes( self->format, self->width, self->height, self->data, planes, strides );
+	for ( int plane = 0; plane < MLT_IMAGE_MAX_PLANES; plane++ )
+	{
+		if ( !strides[plane] || ( planes[plane] == self->planes[plane] && strides[plane] == self->strides[plane] ) )
+			continue;
+		int rows = plane_height( self->format, self->height, plane );
+		for ( int line = 0; line < rows; line++ )
+			memmove( planes[plane] + line * strides[plane], self->planes[plane] + line * self->strides[plane], strides[plane] );
+		self->planes[plane] = planes[plane];
+		self->strides[plane] = strides[plane];
+	}
+	if ( self->alpha && self->planes[3] == self->alpha && self->strides[3] != self->width )
+	{
+		uint8_t* alpha = self->alpha;
+		for ( int line = 0; line < self->height; line++ )
+			memmove( alpha + line * self->width, alpha + line * self->strides[3], self->width );
+		self->strides[3] = self->width;
+	}
+}
+
+/** Allocate a reference counted buffer for image data.
+ *
+ * A shared buffer can be owned by several frames or caches at once without
+ * copying it. Give it to mlt_frame_set_image() with mlt_image_buffer_release()
+ * as the destructor, and a frame makes a private copy only when a writable
+ * image is requested while someone else also holds a reference.
+ *
+ * \public \memberof mlt_image_s
+ * \param size the number of bytes
+ * \return a buffer with one reference, or NULL on error
+ */
+
+void *mlt_image_buffer_alloc( int size )
+{
+	char *block = mlt_pool_alloc( size + SHARED_HEADER_SIZE );
+	if ( !block )
+		return NULL;
+	atomic_init( &( ( shared_header* ) block )->references, 1 );
+	return block + SHARED_HEADER_SIZE;
+}
+
+/** Add a reference to a shared buffer.
+ *
+ * \public \memberof mlt_image_s
+ * \param buffer a buffer from mlt_image_buffer_alloc() (optional)
+ * \return \p buffer
+ */
+
+void *mlt_image_buffer_ref( void *buffer )
+{
+	if ( buffer )
+		atomic_fetch_add( &( ( shared_header* )( ( char* ) buffer - SHARED_HEADER_SIZE ) )->references, 1 );
+	return buffer;
+}
+
+/** Release a reference to a shared buffer and free it with the last one.
+ *
+ * This can be used as the mlt_destructor of a shared buffer.
+ *
+ * \public \memberof mlt_image_s
+ * \param buffer a buffer from mlt_image_buffer_alloc() (optional)
+ */
+
+void mlt_image_buffer_release( void *buffer )
+{
+	if ( buffer )
+	{
+		char *block = ( char* ) buffer - SHARED_HEADER_SIZE;
+		if ( atomic_fetch_sub( &( ( shared_header* ) block )->references, 1 ) == 1 )
+			mlt_pool_release( block );
+	}
+}
+
+/** Determine if a shared buffer has more than one owner.
+ *
+ * \public \memberof mlt_image_s
+ * \param buffer a buffer from mlt_image_buffer_alloc()
+ * \return true if writing to it would be seen by another owner
+ */
+
+int mlt_image_buffer_is_shared( void *buffer )
+{
+	return buffer && atomic_load( &( ( shared_header* )( ( char* ) buffer - SHARED_HEADER_SIZE ) )->references ) > 1;
+}
+
 /** Calculate the number of bytes needed for the Image data.
  *
  * \public \memberof mlt_image_s
@@ -187,6 +344,14 @@ int mlt_image_calculate_size( mlt_image self )
 			return 4;
 		case mlt_image_yuv422p16:
 			return 4 * self->width * self->height;
+		case mlt_image_yuv420p10:
+		case mlt_image_p010:
+			return self->width * self->height * 3;
+		case mlt_image_nv12:
+			return self->width * self->height * 3 / 2;
+		case mlt_image_rgba64:
+			return self->width * self->height * 8;
+		case mlt_image_hwframe:
 		case mlt_image_none:
 		case mlt_image_invalid:
 			return 0;
@@ -214,6 +379,11 @@ const char * mlt_image_format_name( mlt_image_format format )
 		case mlt_image_movit:          return "glsl";
 		case mlt_image_opengl_texture: return "opengl_texture";
 		case mlt_image_yuv422p16:      return "yuv422p16";
+		case mlt_image_yuv420p10:      return "yuv420p10";
+		case mlt_image_nv12:           return "nv12";
+		case mlt_image_p010:           return "p010";
+		case mlt_image_rgba64:         return "rgba64";
+		case mlt_image_hwframe:        return "hwframe";
 		case mlt_image_invalid:        return "invalid";
 	}
 	return "invalid";
@@ -240,6 +410,16 @@ mlt_image_format mlt_image_format_id( const char * name )
 	return mlt_image_invalid;
 }
 
+static void fill_plane16( uint8_t* plane, int stride, int count, int rows, uint16_t value )
+{
+	for ( int line = 0; line < rows; line++ )
+	{
+		uint16_t* p = (uint16_t*)( plane + line * stride );
+		for ( int i = 0; i < count; i++ )
+			*p++ = value;
+	}
+}
+
 /** Fill an image with black.
   *
   * \public \memberof mlt_image_s
@@ -254,23 +434,28 @@ void mlt_image_fill_black( mlt_image self )
 		case mlt_image_none:
 		case mlt_image_movit:
 		case mlt_image_opengl_texture:
+		case mlt_image_hwframe:
 			return;
 		case mlt_image_rgb:
 		case mlt_image_rgba:
 		{
-			int size = mlt_image_calculate_size( self );
-			memset( self->planes[0], 255, size );
+			int bpp;
+			mlt_image_format_size( self->format, self->width, 1, &bpp );
+			for ( int line = 0; line < self->height; line++ )
+				memset( self->planes[0] + line * self->strides[0], 255, self->width * bpp );
 			break;
 		}
 		case mlt_image_yuv422:
 		{
-			int size = mlt_image_calculate_size( self );
-			register uint8_t *p = self->planes[0];
-			register uint8_t *q = p + size;
-			while ( p != NULL && p != q )
+			for ( int line = 0; line < self->height; line++ )
 			{
-				*p ++ = 235;
-				*p ++ = 128;
+				register uint8_t *p = self->planes[0] + line * self->strides[0];
+				register uint8_t *q = p + self->width * 2;
+				while ( p != q )
+				{
+					*p ++ = 235;
+					*p ++ = 128;
+				}
 			}
 		}
 		break;
@@ -285,26 +470,51 @@ void mlt_image_fill_black( mlt_image self )
 					value = 128 << 8;
 					width = self->width / 2;
 				}
-				uint16_t* pRow = (uint16_t*)self->planes[plane];
 				for ( int i = 0; i < self->height; i++ )
 				{
-					uint16_t* p = pRow;
+					uint16_t* p = (uint16_t*)( self->planes[plane] + i * self->strides[plane] );
 					for ( int j = 0; j < width; j++ )
 					{
 						*p++ = value;
 					}
-					pRow += self->strides[plane];
 				}
 			}
 		}
 		break;
 		case mlt_image_yuv420p:
 		{
-			memset(self->planes[0], 235, self->height * self->strides[0]);
-			memset(self->planes[1], 128, self->height * self->strides[1] / 2);
-			memset(self->planes[2], 128, self->height * self->strides[2] / 2);
+			for ( int plane = 0; plane < 3; plane++ )
+			{
+				int width = plane ? self->width >> 1 : self->width;
+				for ( int line = 0; line < plane_height( self->format, self->height, plane ); line++ )
+					memset( self->planes[plane] + line * self->strides[plane], plane ? 128 : 235, width );
+			}
+		}
+		break;
+		case mlt_image_yuv420p10:
+		{
+			for ( int plane = 0; plane < 3; plane++ )
+				fill_plane16( self->planes[plane], self->strides[plane], plane ? self->width >> 1 : self->width,
+					plane_height( self->format, self->height, plane ), plane ? 128 << 2 : 235 << 2 );
+		}
+		break;
+		case mlt_image_nv12:
+		{
+			for ( int line = 0; line < self->height; line++ )
+				memset( self->planes[0] + line * self->strides[0], 235, self->width );
+			for ( int line = 0; line < plane_height( self->format, self->height, 1 ); line++ )
+				memset( self->planes[1] + line * self->strides[1], 128, self->width );
+		}
+		break;
+		case mlt_image_p010:
+		{
+			fill_plane16( self->planes[0], self->strides[0], self->width, self->height, 235 << 8 );
+			fill_plane16( self->planes[1], self->strides[1], self->width, plane_height( self->format, self->height, 1 ), 128 << 8 );
 		}
 		break;
+		case mlt_image_rgba64:
+			fill_plane16( self->planes[0], self->strides[0], self->width * 4, self->height, 0xffff );
+		break;
 	}
 }
 
@@ -324,16 +534,415 @@ void mlt_image_fill_opaque( mlt_image self )
 			for ( int pixel = 0; pixel < self->width; pixel++ )
 			{
 				*pLine = 0xff;
-				*pLine += 4;
+				pLine += 4;
+			}
+		}
+	}
+	else if ( self->format == mlt_image_rgba64 && self->planes[0] != NULL )
+	{
+		for ( int line = 0; line < self->height; line++ )
+		{
+			uint16_t* pLine = (uint16_t*)( self->planes[0] + ( self->strides[0] * line ) ) + 3;
+			for ( int pixel = 0; pixel < self->width; pixel++ )
+			{
+				*pLine = 0xffff;
+				pLine += 4;
 			}
 		}
 	}
 	else if ( self->planes[3] != NULL )
 	{
-		memset( self->planes[3], 255, self->height * self->strides[3] );
+		for ( int line = 0; line < self->height; line++ )
+			memset( self->planes[3] + line * self->strides[3], 255, self->width );
 	}
 }
 
+/** Find the part of an image that is not fully transparent.
+ *
+ * Producers of mostly transparent images, like titles, use this once per
+ * rendering to publish the result with mlt_frame_set_alpha_bounds(). An image
+ * without an alpha channel is fully opaque.
+ *
+ * \public \memberof mlt_image_s
+ * \param self the Image object
+ * \param[out] bounds the smallest rectangle in pixels that holds every pixel with some opacity, empty if none does
+ * \return true if every pixel is fully opaque
+ */
+
+int mlt_image_alpha_bounds( mlt_image self, mlt_rect *bounds )
+{
+	int x0 = self->width, y0 = self->height, x1 = -1, y1 = -1;
+	int opaque = 1;
+	int step = 1, offset = 0;
+	const uint8_t *plane = self->planes[3];
+	int stride = self->strides[3];
+
+	if ( self->format == mlt_image_rgba )
+	{
+		plane = self->planes[0];
+		stride = self->strides[0];
+		step = 4;
+		offset = 3;
+	}
+	else if ( self->format == mlt_image_rgba64 )
+	{
+		// Both bytes of each 16-bit alpha sample are checked, in either byte order
+		plane = self->planes[0];
+		stride = self->strides[0];
+		step = 8;
+		offset = 7;
+	}
+	if ( !plane )
+	{
+		*bounds = (mlt_rect) { 0, 0, self->width, self->height, 1.0 };
+		return 1;
+	}
+
+	for ( int line = 0; line < self->height; line++ )
+	{
+		const uint8_t *p = plane + line * stride + offset;
+		int first = -1, last = -1;
+		for ( int pixel = 0; pixel < self->width; pixel++, p += step )
+		{
+			if ( *p != 255 || ( step == 8 && p[-1] != 255 ) )
+				opaque = 0;
+			if ( *p || ( step == 8 && p[-1] ) )
+			{
+				if ( first < 0 )
+					first = pixel;
+				last = pixel;
+			}
+		}
+		if ( first >= 0 )
+		{
+			x0 = MIN( x0, first );
+			x1 = MAX( x1, last );
+			y0 = MIN( y0, line );
+			y1 = line;
+		}
+	}
+	if ( x1 < 0 )
+		*bounds = (mlt_rect) { 0, 0, 0, 0, 1.0 };
+	else
+		*bounds = (mlt_rect) { x0, y0, x1 - x0 + 1, y1 - y0 + 1, 1.0 };
+	return opaque;
+}
+
+/** \brief private to mlt_image, what a lookup table does to its component */
+
+typedef enum
+{
+	lut_identity = 0, /**< the component is left alone */
+	lut_constant,     /**< every value becomes the same one */
+	lut_general       /**< each value is looked up */
+}
+lut_kind;
+
+/** \brief private to mlt_image, the job of mlt_image_apply_lut() */
+
+typedef struct
+{
+	mlt_image image;
+	const uint8_t *luts[MLT_IMAGE_MAX_PLANES];
+	lut_kind kinds[MLT_IMAGE_MAX_PLANES];
+	int jobs;
+}
+lut_job;
+
+static uint8_t lut_identity_table[256];
+static pthread_once_t identity_once = PTHREAD_ONCE_INIT;
+
+static void lut_identity_init( )
+{
+	for ( int i = 0; i < 256; i++ )
+		lut_identity_table[i] = i;
+}
+
+static lut_kind lut_classify( const uint8_t *lut )
+{
+	int identity = 1;
+	int constant = 1;
+
+	if ( !lut )
+		return lut_identity;
+	for ( int i = 0; i < 256; i++ )
+	{
+		identity &= lut[i] == i;
+		constant &= lut[i] == lut[0];
+	}
+	return identity ? lut_identity : constant ? lut_constant : lut_general;
+}
+
+/** Look up the components of a row in which they repeat every \p period bytes. */
+
+static void lut_row_packed( uint8_t *p, int size, const uint8_t **luts, int period )
+{
+	uint8_t *end = p + size - size % period;
+
+	if ( period == 4 )
+	{
+		const uint8_t *a = luts[0], *b = luts[1], *c = luts[2], *d = luts[3];
+		for ( ; p < end; p += 4 )
+		{
+			p[0] = a[p[0]];
+			p[1] = b[p[1]];
+			p[2] = c[p[2]];
+			p[3] = d[p[3]];
+		}
+	}
+	else if ( period == 3 )
+	{
+		const uint8_t *a = luts[0], *b = luts[1], *c = luts[2];
+		for ( ; p < end; p += 3 )
+		{
+			p[0] = a[p[0]];
+			p[1] = b[p[1]];
+			p[2] = c[p[2]];
+		}
+	}
+	else
+	{
+		for ( ; p < end; p += period )
+			for ( int i = 0; i < period; i++ )
+				p[i] = luts[i][p[i]];
+	}
+	for ( int i = 0; i < size % period; i++ )
+		p[i] = luts[i][p[i]];
+}
+
+/** Set the chroma of a yuv422 row to constants and leave its luma alone.
+ *
+ * \param u the value of U, or -1 to leave it alone
+ * \param v the value of V, or -1 to leave it alone
+ */
+
+static void lut_row_yuv422_chroma( uint8_t *p, int width, int u, int v )
+{
+	uint8_t value[4] = { 0, u < 0 ? 0 : u, 0, v < 0 ? 0 : v };
+	uint8_t mask[4] = { 0, u < 0 ? 0 : 0xff, 0, v < 0 ? 0 : 0xff };
+	int i = 0;
+
+#if defined(USE_SSE2)
+	uint32_t value32, mask32;
+	memcpy( &value32, value, 4 );
+	memcpy( &mask32, mask, 4 );
+	__m128i vvalue = _mm_set1_epi32( value32 );
+	__m128i vmask = _mm_set1_epi32( mask32 );
+	for ( ; i + 8 <= width; i += 8, p += 16 )
+	{
+		__m128i x = _mm_loadu_si128( (const __m128i*) p );
+		x = _mm_or_si128( _mm_andnot_si128( vmask, x ), vvalue );
+		_mm_storeu_si128( (__m128i*) p, x );
+	}
+#elif defined(USE_NEON)
+	uint32_t value32, mask32;
+	memcpy( &value32, value, 4 );
+	memcpy( &mask32, mask, 4 );
+	uint8x16_t vvalue = vreinterpretq_u8_u32( vdupq_n_u32( value32 ) );
+	uint8x16_t vmask = vreinterpretq_u8_u32( vdupq_n_u32( mask32 ) );
+	for ( ; i + 8 <= width; i += 8, p += 16 )
+		vst1q_u8( p, vbslq_u8( vmask, vvalue, vld1q_u8( p ) ) );
+#endif
+	for ( ; i < width; i++, p += 2 )
+		if ( mask[( i & 1 ) * 2 + 1] )
+			p[1] = value[( i & 1 ) * 2 + 1];
+}
+
+/** Apply the table of a component that has a plane of its own. */
+
+static void lut_plane( uint8_t *p, int size, const uint8_t *lut, lut_kind kind )
+{
+	if ( kind == lut_constant )
+	{
+		memset( p, lut[0], size );
+	}
+	else if ( kind == lut_general )
+	{
+		uint8_t *end = p + size;
+		for ( ; p + 4 <= end; p += 4 )
+		{
+			p[0] = lut[p[0]];
+			p[1] = lut[p[1]];
+			p[2] = lut[p[2]];
+			p[3] = lut[p[3]];
+		}
+		for ( ; p < end; p++ )
+			*p = lut[*p];
+	}
+}
+
+static void lut_rows( lut_job *job, int plane, int index, int *start, int *count )
+{
+	int rows = plane_height( job->image->format, job->image->height, plane );
+	int slice = ( rows + job->jobs - 1 ) / job->jobs;
+	*start = index * slice;
+	*count = MAX( 0, MIN( slice, rows - *start ) );
+}
+
+static int lut_slice( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	lut_job *job = cookie;
+	mlt_image image = job->image;
+	const uint8_t **luts = job->luts;
+	lut_kind *kinds = job->kinds;
+	int start, count;
+
+	lut_rows( job, 0, index, &start, &count );
+	switch ( image->format )
+	{
+	case mlt_image_yuv422:
+	{
+		const uint8_t *pattern[4] = { luts[0], luts[1], luts[0], luts[2] };
+		int chroma_only = kinds[0] == lut_identity && kinds[1] != lut_general && kinds[2] != lut_general;
+		for ( int line = start; line < start + count; line++ )
+		{
+			uint8_t *p = image->planes[0] + line * image->strides[0];
+			if ( chroma_only )
+				lut_row_yuv422_chroma( p, image->width, kinds[1] == lut_constant ? luts[1][0] : -1,
+					kinds[2] == lut_constant ? luts[2][0] : -1 );
+			else
+				lut_row_packed( p, image->width * 2, pattern, 4 );
+		}
+		break;
+	}
+	case mlt_image_rgb:
+	case mlt_image_rgba:
+	{
+		int period = image->format == mlt_image_rgb ? 3 : 4;
+		for ( int line = start; line < start + count; line++ )
+			lut_row_packed( image->planes[0] + line * image->strides[0], image->width * period, luts, period );
+		break;
+	}
+	case mlt_image_yuv420p:
+		for ( int plane = 0; plane < 3; plane++ )
+		{
+			int width = plane ? image->width >> 1 : image->width;
+			if ( kinds[plane] == lut_identity )
+				continue;
+			lut_rows( job, plane, index, &start, &count );
+			for ( int line = start; line < start + count; line++ )
+				lut_plane( image->planes[plane] + line * image->strides[plane], width, luts[plane], kinds[plane] );
+		}
+		break;
+	case mlt_image_nv12:
+		if ( kinds[0] != lut_identity )
+			for ( int line = start; line < start + count; line++ )
+				lut_plane( image->planes[0] + line * image->strides[0], image->width, luts[0], kinds[0] );
+		if ( kinds[1] != lut_identity || kinds[2] != lut_identity )
+		{
+			lut_rows( job, 1, index, &start, &count );
+			for ( int line = start; line < start + count; line++ )
+				lut_row_packed( image->planes[1] + line * image->strides[1], image->width & ~1, luts + 1, 2 );
+		}
+		break;
+	default:
+		break;
+	}
+	return 0;
+}
+
+/** Tell whether mlt_image_apply_lut() handles an image format.
+ *
+ * \public \memberof mlt_image_s
+ * \param format the image format
+ * \return true if images in \p format can be given lookup tables
+ */
+
+int mlt_image_lut_supported( mlt_image_format format )
+{
+	return format == mlt_image_yuv422 || format == mlt_image_rgb || format == mlt_image_rgba
+		|| format == mlt_image_yuv420p || format == mlt_image_nv12;
+}
+
+/** Fill a lookup table with an affine transform of the 8-bit values.
+ *
+ * Each value i becomes i * \p scale + \p offset rounded to the nearest integer
+ * and clamped to [\p min, \p max], so a \p scale of 0 gives a constant table.
+ *
+ * \public \memberof mlt_image_s
+ * \param[out] lut the table of 256 entries
+ * \param scale the factor of each value
+ * \param offset the amount added to each value
+ * \param min the lowest result
+ * \param max the highest result
+ */
+
+void mlt_image_lut_affine( uint8_t *lut, double scale, double offset, int min, int max )
+{
+	for ( int i = 0; i < 256; i++ )
+	{
+		long value = lrint( i * scale + offset );
+		lut[i] = CLAMP( value, min, max );
+	}
+}
+
+/** Combine two lookup tables into one that does the same as both in turn.
+ *
+ * \public \memberof mlt_image_s
+ * \param[out] result the table of 256 entries, which may be \p first
+ * \param first the table applied first
+ * \param second the table applied to the results of \p first
+ */
+
+void mlt_image_lut_compose( uint8_t *result, const uint8_t *first, const uint8_t *second )
+{
+	for ( int i = 0; i < 256; i++ )
+		result[i] = second[first[i]];
+}
+
+/** Replace each 8-bit component of an image by its entry in a lookup table.
+ *
+ * This is the loop of the filters that change each pixel independently, like
+ * gamma or invert: they describe the change with a table per component, which
+ * is applied here in slices on the slices pool. A component whose table maps
+ * every value to itself or a single value is skipped or filled instead. The
+ * components are Y, U and V for the YUV formats and R, G, B and A for rgb and
+ * rgba; the alpha channel of other formats is a separate plane that is not
+ * handled. See mlt_image_lut_supported() for the formats.
+ *
+ * \public \memberof mlt_image_s
+ * \param self the Image object
+ * \param luts a table of 256 entries per component, NULL to leave it alone
+ * \param threads the number of slices, 0 for as many as the slices pool has
+ * \return true if the format is not supported
+ */
+
+int mlt_image_apply_lut( mlt_image self, const uint8_t *luts[MLT_IMAGE_MAX_PLANES], int threads )
+{
+	int components = self->format == mlt_image_rgba ? 4 : 3;
+	lut_job job;
+	int work = 0;
+
+	if ( !mlt_image_lut_supported( self->format ) || !self->planes[0] )
+		return 1;
+
+	pthread_once( &identity_once, lut_identity_init );
+	job.image = self;
+	for ( int i = 0; i < MLT_IMAGE_MAX_PLANES; i++ )
+	{
+		job.kinds[i] = lut_classify( luts[i] );
+		job.luts[i] = job.kinds[i] == lut_identity ? lut_identity_table : luts[i];
+		if ( i < components )
+			work |= job.kinds[i] != lut_identity;
+	}
+	if ( !work )
+		return 0;
+
+	if ( threads <= 0 )
+		threads = mlt_slices_count_normal();
+	// Small images are not worth waking the pool for
+	threads = CLAMP( threads, 1, MAX( 1, self->height / 16 ) );
+	if ( self->width * self->height < 128 * 128 )
+		threads = 1;
+	job.jobs = threads;
+	if ( threads == 1 )
+		lut_slice( 0, 0, 1, &job );
+	else
+		mlt_slices_run_normal( threads, lut_slice, &job );
+	return 0;
+}
+
 /** Get the number of bytes needed for an image.
   *
   * \public \memberof mlt_image_s
@@ -366,6 +975,16 @@ int mlt_image_format_size( mlt_image_format format, int width, int height, int *
 		case mlt_image_yuv422p16:
 			if ( bpp ) *bpp = 0;
 			return 4 * height * width ;
+		case mlt_image_yuv420p10:
+		case mlt_image_p010:
+			if ( bpp ) *bpp = 0;
+			return width * height * 3;
+		case mlt_image_nv12:
+			if ( bpp ) *bpp = 0;
+			return width * height * 3 / 2;
+		case mlt_image_rgba64:
+			if ( bpp ) *bpp = 8;
+			return width * height * 8;
 		default:
 			if ( bpp ) *bpp = 0;
 			return 0;
@@ -400,6 +1019,32 @@ void mlt_image_format_planes( mlt_image_format format, int width, int height, vo
 		planes[2] = planes[1] + height * strides[1];
 		planes[3] = 0;
 	}
+	else if ( mlt_image_yuv420p10 == format )
+	{
+		strides[0] = width * 2;
+		strides[1] = width;
+		strides[2] = width;
+		strides[3] = 0;
+
+		planes[0] = (unsigned char*)data;
+		planes[1] = planes[0] + height * strides[0];
+		planes[2] = planes[1] + ( height >> 1 ) * strides[1];
+		planes[3] = 0;
+	}
+	else if ( mlt_image_nv12 == format || mlt_image_p010 == format )
+	{
+		int bps = mlt_image_p010 == format ? 2 : 1;
+
+		strides[0] = width * bps;
+		strides[1] = width * bps;
+		strides[2] = 0;
+		strides[3] = 0;
+
+		planes[0] = (unsigned char*)data;
+		planes[1] = planes[0] + height * strides[0];
+		planes[2] = 0;
+		planes[3] = 0;
+	}
 	else if ( mlt_image_yuv420p == format )
 	{
 		strides[0] = width;
@@ -429,3 +1074,37 @@ void mlt_image_format_planes( mlt_image_format format, int width, int height, vo
 		strides[3] = 0;
 	};
 }
+
+/** Build plane pointers of an image with aligned, padded planes.
+ *
+ * This is like mlt_image_format_planes(), but each plane starts on a multiple
+ * of \p alignment bytes from \p data and every row is padded to a multiple of
+ * it. Give it a NULL \p data to only compute the size to allocate.
+ *
+ * \public \memberof mlt_image_s
+ * \param format the image format
+ * \param width width of the image in pixels
+ * \param height height of the image in pixels
+ * \param[in] data pointer to allocated image, may be NULL
+ * \param[out] planes pointers to plane's pointers will be set
+ * \param[out] strides pointers to plane's strides will be set
+ * \param alignment the alignment in bytes, a power of two; 1 gives a packed layout
+ * \return the number of bytes needed for the image
+ */
+int mlt_image_format_planes_aligned( mlt_image_format format, int width, int height, void* data, uint8_t* planes[4], int strides[4], int alignment )
+{
+	int size = 0;
+
+	mlt_image_format_planes( format, width, height, data, planes, strides );
+	if ( alignment <= 1 || !strides[0] )
+		return mlt_image_format_size( format, width, height, NULL );
+
+	for ( int plane = 0; plane < MLT_IMAGE_MAX_PLANES; plane++ )
+	{
+		if ( !strides[plane] ) continue;
+		strides[plane] = align_up( strides[plane], alignment );
+		planes[plane] = data ? (uint8_t*) data + size : NULL;
+		size += strides[plane] * plane_height( format, height, plane );
+	}
+	return size;
+}
@@ -31,6 +31,9 @@
  */
 #define MLT_IMAGE_MAX_PLANES 4
 
+/** The alignment in bytes of planes and rows allocated by mlt_image_alloc_data() */
+#define MLT_IMAGE_ALIGNMENT 64
+
 struct mlt_image_s
 {
 	mlt_image_format format;
@@ -52,11 +55,22 @@ extern void mlt_image_set_values( mlt_image self, void* data, mlt_image_format f
 extern void mlt_image_get_values( mlt_image self, void** data, mlt_image_format* format, int* width, int* height );
 extern void mlt_image_alloc_data( mlt_image self );
 extern void mlt_image_alloc_alpha( mlt_image self );
+extern void mlt_image_pack( mlt_image self );
+extern void *mlt_image_buffer_alloc( int size );
+extern void *mlt_image_buffer_ref( void *buffer );
+extern void mlt_image_buffer_release( void *buffer );
+extern int mlt_image_buffer_is_shared( void *buffer );
 extern int mlt_image_calculate_size( mlt_image self );
 extern void mlt_image_fill_black( mlt_image self );
 extern void mlt_image_fill_opaque( mlt_image self );
+extern int mlt_image_alpha_bounds( mlt_image self, mlt_rect *bounds );
 extern const char * mlt_image_format_name( mlt_image_format format );
 extern mlt_image_format mlt_image_format_id( const char * name );
+extern int mlt_image_format_planes_aligned( mlt_image_format format, int width, int height, void* data, uint8_t* planes[4], int strides[4], int alignment );
+extern int mlt_image_lut_supported( mlt_image_format format );
+extern void mlt_image_lut_affine( uint8_t *lut, double scale, double offset, int min, int max );
+extern void mlt_image_lut_compose( uint8_t *result, const uint8_t *first, const uint8_t *second );
+extern int mlt_image_apply_lut( mlt_image self, const uint8_t *luts[MLT_IMAGE_MAX_PLANES], int threads );
 
 // Deprecated functions
 extern int mlt_image_format_size( mlt_image_format format, int width, int height, int *bpp );
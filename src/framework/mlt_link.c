@@ -115,6 +115,73 @@ void mlt_link_close( mlt_link self )
 	}
 }
 
+/** Get a frame from the next producer.
+ *
+ * A link that needs more than one frame of the next producer for each of its
+ * own frames, or the same ones again for the following frames, should get them
+ * with this. Frames inside the window given to mlt_link_retain_frames() are
+ * shared instead of being fetched again.
+ *
+ * \public \memberof mlt_link_s
+ * \param self a link
+ * \param position the position of the next producer
+ * \param index the track index
+ * \param[out] frame a frame by reference, which the caller must close
+ * \return true on error
+ */
+
+int mlt_link_get_next_frame( mlt_link self, mlt_position position, int index, mlt_frame_ptr frame )
+{
+	if ( !self || !self->next || !frame )
+		return 1;
+	return mlt_producer_fetch_frame( MLT_LINK_PRODUCER( self ), self->next, position, index, frame );
+}
+
+/** Keep the frames of the next producer in a window and fetch the missing ones ahead.
+ *
+ * Call this from the link's get_frame with the positions it needs now and for the
+ * frames it expects to be asked for next. Frames outside the window are released.
+ * At most 32 frames are kept, counted from \p first.
+ *
+ * \public \memberof mlt_link_s
+ * \param self a link
+ * \param first the first position of the next producer to keep
+ * \param last the last position of the next producer to keep
+ * \param index the track index
+ */
+
+void mlt_link_retain_frames( mlt_link self, mlt_position first, mlt_position last, int index )
+{
+	if ( !self || !self->next )
+		return;
+
+	mlt_position positions[ 32 ];
+	int count = 0;
+	while ( first <= last && count < 32 )
+		positions[ count++ ] = first++;
+	mlt_producer_retain_frames( MLT_LINK_PRODUCER( self ), self->next, positions, count, index );
+}
+
+/** Render the images of the frames fetched from the next producer from now on.
+ *
+ * A link calls this from its get_image with the request it makes of the next
+ * producer's images, so that the frames fetched ahead by mlt_link_retain_frames()
+ * are rendered on the slices pool by the time they are needed. Only a request
+ * that stays the same gets any benefit. Pass mlt_image_none to stop.
+ *
+ * \public \memberof mlt_link_s
+ * \param self a link
+ * \param format the image format
+ * \param width the horizontal size in pixels
+ * \param height the vertical size in pixels
+ */
+
+void mlt_link_prefetch_images( mlt_link self, mlt_image_format format, int width, int height )
+{
+	if ( self )
+		mlt_producer_prefetch_images( MLT_LINK_PRODUCER( self ), format, width, height );
+}
+
 static int producer_get_frame( mlt_producer parent, mlt_frame_ptr frame, int index )
 {
 	if ( parent && parent->child )
@@ -72,5 +72,8 @@ struct mlt_link_s
 extern mlt_link mlt_link_init( );
 extern int mlt_link_connect_next( mlt_link self, mlt_producer next, mlt_profile chain_profile );
 extern void mlt_link_close( mlt_link self );
+extern int mlt_link_get_next_frame( mlt_link self, mlt_position position, int index, mlt_frame_ptr frame );
+extern void mlt_link_retain_frames( mlt_link self, mlt_position first, mlt_position last, int index );
+extern void mlt_link_prefetch_images( mlt_link self, mlt_image_format format, int width, int height );
 
 #endif
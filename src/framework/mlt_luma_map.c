@@ -20,15 +20,75 @@
  */
 
 #include "mlt_luma_map.h"
+#include "mlt_cache.h"
+#include "mlt_factory.h"
+#include "mlt_log.h"
 #include "mlt_pool.h"
+#include "mlt_properties.h"
 #include "mlt_types.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #define HALF_USHRT_MAX (1 << 15)
 
+/** the number of luma maps kept for all services of the process */
+#define LUMA_CACHE_SIZE (16)
+
+/** the byte order mark of a saved luma map */
+#define LUMA16_BYTE_ORDER (0x01020304)
+
+/** The header of a luma map saved in the byte order of the machine by mlt_luma_map_save().
+ * The map follows right after it, so it is read without any conversion.
+ */
+
+struct luma16_header
+{
+	char magic[8];       ///< MLTLUM16
+	uint32_t byte_order; ///< LUMA16_BYTE_ORDER as written by the machine
+	uint32_t width;
+	uint32_t height;
+	uint32_t reserved;
+};
+
+/** The object under which the cache keeps a luma map.
+ *
+ * mlt_cache finds entries by address, so the slots stay allocated until the
+ * cache is closed. A slot is reused for another key once its map is released.
+ */
+
+struct luma_slot
+{
+	char *key;
+	atomic_int live;     ///< true until the map put under the slot is released
+};
+
+/** The cache of luma maps and its slots.
+*/
+
+struct luma_cache
+{
+	mlt_cache cache;
+	struct luma_slot **slots;
+	int count;
+};
+
+/** A luma map shared through the cache.
+*/
+
+struct shared_luma
+{
+	int width;
+	int height;
+	uint16_t *map;
+	struct luma_slot *slot; ///< the slot the map is cached under or NULL
+};
+
+static pthread_mutex_t luma_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 void mlt_luma_map_init(mlt_luma_map self)
 {
 	memset( self, 0, sizeof(struct mlt_luma_map_s) );
@@ -556,3 +616,314 @@ void mlt_luma_map_from_yuv422(uint8_t *image, uint16_t **map, int width, int hei
 	for ( i = 0; i < size; i += 2 )
 		*p++ = ( image[ i ] - 16 ) * 299; // 299 = 65535 / 219
 }
+
+static void shared_luma_close( struct shared_luma *self )
+{
+	mlt_pool_release( self->map );
+	if ( self->slot )
+		atomic_store( &self->slot->live, 0 );
+	free( self );
+}
+
+static void luma_cache_close( struct luma_cache *self )
+{
+	int i;
+
+	// Release the maps before the slots they refer to
+	mlt_cache_close( self->cache );
+	for ( i = 0; i < self->count; i++ )
+	{
+		free( self->slots[i]->key );
+		free( self->slots[i] );
+	}
+	free( self->slots );
+	free( self );
+}
+
+/** Get the cache of luma maps, which is kept in the global properties.
+ *
+ * The cache mutex must be locked.
+ */
+
+static struct luma_cache *luma_cache( )
+{
+	mlt_properties global = mlt_global_properties();
+	struct luma_cache *self = mlt_properties_get_data( global, "_luma_map.cache", NULL );
+
+	if ( !self && ( self = calloc( 1, sizeof( *self ) ) ) )
+	{
+		self->cache = mlt_cache_init();
+		mlt_cache_set_size( self->cache, LUMA_CACHE_SIZE );
+		mlt_properties_set_data( global, "_luma_map.cache", self, 0, ( mlt_destructor )luma_cache_close, NULL );
+	}
+	return self;
+}
+
+static mlt_cache_item luma_cache_get( const char *key, uint16_t **map, int *width, int *height )
+{
+	struct luma_cache *cache = luma_cache();
+	int i;
+
+	// A map that was evicted but is still in use keeps its slot, so a key
+	// can be in more than one slot but it is cached in one at most
+	for ( i = 0; cache && i < cache->count; i++ )
+	{
+		struct luma_slot *slot = cache->slots[i];
+		mlt_cache_item item = slot->key && !strcmp( slot->key, key ) ? mlt_cache_get( cache->cache, slot ) : NULL;
+		struct shared_luma *luma = item ? mlt_cache_item_data( item, NULL ) : NULL;
+
+		if ( luma )
+		{
+			*map = luma->map;
+			*width = luma->width;
+			*height = luma->height;
+			return item;
+		}
+	}
+	return NULL;
+}
+
+/** Get a slot whose map was released, or a new one.
+ *
+ * There are only as many slots as maps that were in use or cached at the
+ * same time, which the size of the cache bounds unless the services hold on
+ * to more of them.
+ */
+
+static struct luma_slot *luma_cache_slot( struct luma_cache *cache )
+{
+	struct luma_slot *slot = NULL, **slots;
+	int i;
+
+	for ( i = 0; i < cache->count; i++ )
+		if ( !atomic_load( &cache->slots[i]->live ) )
+			return cache->slots[i];
+	slots = realloc( cache->slots, ( cache->count + 1 ) * sizeof( *slots ) );
+	if ( slots )
+	{
+		cache->slots = slots;
+		slot = calloc( 1, sizeof( *slot ) );
+		if ( slot )
+			cache->slots[ cache->count++ ] = slot;
+	}
+	return slot;
+}
+
+static mlt_cache_item luma_cache_put( const char *key, struct shared_luma *luma, uint16_t **map, int *width, int *height )
+{
+	struct luma_cache *cache = luma_cache();
+	struct luma_slot *slot = cache ? luma_cache_slot( cache ) : NULL;
+	char *copy = strdup( key );
+
+	if ( !slot || !copy )
+	{
+		free( copy );
+		shared_luma_close( luma );
+		return NULL;
+	}
+	free( slot->key );
+	slot->key = copy;
+	atomic_store( &slot->live, 1 );
+	luma->slot = slot;
+	mlt_cache_put( cache->cache, slot, luma, sizeof( *luma ) + luma->width * luma->height * 2, ( mlt_destructor )shared_luma_close );
+	return luma_cache_get( key, map, width, height );
+}
+
+/** Get a luma map that is shared by all the services of the process.
+ *
+ * The map must not be changed and stays valid until the item is closed.
+ * \param key a string that identifies the map, including anything it depends upon such as its size
+ * \param[out] map the luma map
+ * \param[out] width the width of the map
+ * \param[out] height the height of the map
+ * \return a cache item to close with mlt_cache_item_close() when done, or NULL if the map is not cached
+ */
+
+mlt_cache_item mlt_luma_map_cache_get( const char *key, uint16_t **map, int *width, int *height )
+{
+	mlt_cache_item item = NULL;
+
+	if ( key && map && width && height )
+	{
+		pthread_mutex_lock( &luma_cache_mutex );
+		item = luma_cache_get( key, map, width, height );
+		pthread_mutex_unlock( &luma_cache_mutex );
+	}
+	return item;
+}
+
+/** Share a luma map with all the services of the process.
+ *
+ * The cache owns the map from now on and releases it with mlt_pool_release()
+ * when it is no longer used. If another map was put under the same key in the
+ * meantime, this one is released at once and the other is returned instead.
+ * \param key a string that identifies the map, including anything it depends upon such as its size
+ * \param[in,out] map a luma map allocated with mlt_pool_alloc(), which is set to the shared map
+ * \param[in,out] width the width of the map
+ * \param[in,out] height the height of the map
+ * \return a cache item for the shared map to close with mlt_cache_item_close() when done, or NULL on error
+ */
+
+mlt_cache_item mlt_luma_map_cache_put( const char *key, uint16_t **map, int *width, int *height )
+{
+	mlt_cache_item item = NULL;
+	struct shared_luma *luma = NULL;
+
+	if ( !map || !*map )
+		return NULL;
+	if ( !key || !width || !height || *width <= 0 || *height <= 0 || !( luma = calloc( 1, sizeof( *luma ) ) ) )
+	{
+		mlt_pool_release( *map );
+		*map = NULL;
+		return NULL;
+	}
+	luma->map = *map;
+	luma->width = *width;
+	luma->height = *height;
+	*map = NULL;
+
+	pthread_mutex_lock( &luma_cache_mutex );
+	item = luma_cache_get( key, map, width, height );
+	if ( item )
+		shared_luma_close( luma );
+	else
+		item = luma_cache_put( key, luma, map, width, height );
+	pthread_mutex_unlock( &luma_cache_mutex );
+
+	return item;
+}
+
+/** Read a luma map saved by mlt_luma_map_save().
+ *
+ * It is read rather than memory mapped, because a mapped file that another
+ * process truncates would fault on the next access.
+ * \return the luma map or NULL if the file is not a luma map for this machine
+ */
+
+static struct shared_luma *luma_map_from_luma16( const char *filename )
+{
+	struct luma16_header header;
+	struct shared_luma *luma = NULL;
+	FILE *f = mlt_fopen( filename, "rb" );
+
+	if ( !f )
+		return NULL;
+	if ( fread( &header, sizeof( header ), 1, f ) == 1 && !memcmp( header.magic, "MLTLUM16", 8 )
+		 && header.byte_order == LUMA16_BYTE_ORDER && header.width > 0 && header.height > 0
+		 && header.width < (1 << 15) && header.height < (1 << 15)
+		 && ( luma = calloc( 1, sizeof( *luma ) ) ) )
+	{
+		size_t size = (size_t) header.width * header.height * sizeof( uint16_t );
+
+		luma->width = header.width;
+		luma->height = header.height;
+		luma->map = mlt_pool_alloc( size );
+		if ( !luma->map || fread( luma->map, size, 1, f ) != 1 )
+		{
+			shared_luma_close( luma );
+			luma = NULL;
+		}
+	}
+	fclose( f );
+	return luma;
+}
+
+/** Get a luma map from a file, which is loaded only once for all the services of the process.
+ *
+ * The file is either a luma map saved by mlt_luma_map_save(), which is read
+ * without any conversion, or a PGM. If it cannot be read but a name is given,
+ * the map is generated as by mlt_luma_map_new() for that name.
+ * \param filename the file
+ * \param name the name of a standard luma map to generate if the file is missing or NULL to not generate one
+ * \param width the width of the map to generate, or 0 for the default
+ * \param height the height of the map to generate, or 0 for the default
+ * \param[out] map the luma map, which must not be changed
+ * \param[out] map_width the width of the luma map
+ * \param[out] map_height the height of the luma map
+ * \return a cache item to close with mlt_cache_item_close() when done, or NULL if there is no map
+ */
+
+mlt_cache_item mlt_luma_map_load( const char *filename, const char *name, int width, int height, uint16_t **map, int *map_width, int *map_height )
+{
+	mlt_cache_item item = NULL;
+	char *key = NULL;
+
+	if ( !filename || !map || !map_width || !map_height )
+		return NULL;
+	key = malloc( strlen( filename ) + ( name ? strlen( name ) : 0 ) + 32 );
+	if ( !key )
+		return NULL;
+	sprintf( key, "%s %s %dx%d", filename, name ? name : "", width, height );
+
+	// Hold the lock while loading, so every map is loaded only once
+	pthread_mutex_lock( &luma_cache_mutex );
+	item = luma_cache_get( key, map, map_width, map_height );
+	if ( !item )
+	{
+		struct shared_luma *luma = luma_map_from_luma16( filename );
+		if ( !luma && ( luma = calloc( 1, sizeof( *luma ) ) ) )
+		{
+			if ( mlt_luma_map_from_pgm( filename, &luma->map, &luma->width, &luma->height ) )
+			{
+				luma->map = NULL;
+				mlt_luma_map generator = name ? mlt_luma_map_new( name ) : NULL;
+				if ( generator )
+				{
+					if ( width > 0 && height > 0 )
+					{
+						generator->w = width;
+						generator->h = height;
+					}
+					luma->map = mlt_luma_map_render( generator );
+					luma->width = generator->w;
+					luma->height = generator->h;
+					free( generator );
+				}
+			}
+			if ( !luma->map || luma->width <= 0 || luma->height <= 0 )
+			{
+				shared_luma_close( luma );
+				luma = NULL;
+			}
+		}
+		if ( luma )
+			item = luma_cache_put( key, luma, map, map_width, map_height );
+		else
+			mlt_log_verbose( NULL, "[luma_map] failed to load %s\n", filename );
+	}
+	pthread_mutex_unlock( &luma_cache_mutex );
+
+	free( key );
+	return item;
+}
+
+/** Save a luma map in the byte order of the machine, so mlt_luma_map_load() can read it without conversion.
+ *
+ * \param filename the file to write
+ * \param map a luma map
+ * \param width the width of the map
+ * \param height the height of the map
+ * \return true if there was an error
+ */
+
+int mlt_luma_map_save( const char *filename, const uint16_t *map, int width, int height )
+{
+	struct luma16_header header;
+	FILE *f = NULL;
+	int error = !filename || !map || width <= 0 || height <= 0;
+
+	if ( !error )
+		f = mlt_fopen( filename, "wb" );
+	if ( !f )
+		return 1;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, "MLTLUM16", 8 );
+	header.byte_order = LUMA16_BYTE_ORDER;
+	header.width = width;
+	header.height = height;
+	error = fwrite( &header, sizeof( header ), 1, f ) != 1
+		 || fwrite( map, (size_t) width * height * sizeof( uint16_t ), 1, f ) != 1;
+	if ( fclose( f ) )
+		error = 1;
+	return error;
+}
@@ -22,6 +22,8 @@
 #ifndef MLT_LUMA_MAP_H
 #define MLT_LUMA_MAP_H
 
+#include "mlt_types.h"
+
 #include <stdint.h>
 #include <stdio.h>
 
@@ -57,6 +59,10 @@ extern mlt_luma_map mlt_luma_map_new( const char *path );
 extern uint16_t *mlt_luma_map_render( mlt_luma_map self );
 extern int mlt_luma_map_from_pgm( const char *filename, uint16_t **map, int *width, int *height );
 extern void mlt_luma_map_from_yuv422( uint8_t *image, uint16_t **map, int width, int height );
+extern mlt_cache_item mlt_luma_map_cache_get( const char *key, uint16_t **map, int *width, int *height );
+extern mlt_cache_item mlt_luma_map_cache_put( const char *key, uint16_t **map, int *width, int *height );
+extern mlt_cache_item mlt_luma_map_load( const char *filename, const char *name, int width, int height, uint16_t **map, int *map_width, int *map_height );
+extern int mlt_luma_map_save( const char *filename, const uint16_t *map, int width, int height );
 
 #ifdef __cplusplus
 }
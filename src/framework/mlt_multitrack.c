@@ -121,6 +121,8 @@ void mlt_multitrack_refresh( mlt_multitrack self )
 {
 	int i = 0;
 
+	self->refresh_pending = 0;
+
 	// Obtain the properties of this multitrack
 	mlt_properties properties = MLT_MULTITRACK_PROPERTIES( self );
 
@@ -139,11 +141,18 @@ void mlt_multitrack_refresh( mlt_multitrack self )
 		{
 			// If we have more than 1 track, we must be in continue mode
 			if ( self->count > 1 )
-				mlt_properties_set( MLT_PRODUCER_PROPERTIES( producer ), "eof", "continue" );
+			{
+				// Avoid firing property-changed on every track for every edit
+				const char *eof = mlt_properties_get( MLT_PRODUCER_PROPERTIES( producer ), "eof" );
+				if ( !eof || strcmp( eof, "continue" ) )
+					mlt_properties_set( MLT_PRODUCER_PROPERTIES( producer ), "eof", "continue" );
+			}
 
 			// Determine the longest length
 			//if ( !mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( producer ), "hide" ) )
-				length = mlt_producer_get_playtime( producer ) > length ? mlt_producer_get_playtime( producer ) : length;
+			mlt_position playtime = mlt_producer_get_playtime( producer );
+			if ( playtime > length )
+				length = playtime;
 		}
 	}
 
@@ -154,6 +163,51 @@ void mlt_multitrack_refresh( mlt_multitrack self )
 	mlt_properties_set_position( properties, "out", length - 1 );
 }
 
+/** Start a batch of changes to the tracks.
+ *
+ * The multitrack is not refreshed for changes to its tracks until the matching
+ * mlt_multitrack_end_update(), so that editing many clips of a large timeline
+ * only recalculates its length once. Batches can be nested.
+ *
+ * \public \memberof mlt_multitrack_s
+ * \param self a multitrack
+ */
+
+void mlt_multitrack_begin_update( mlt_multitrack self )
+{
+	if ( self )
+		self->update_depth ++;
+}
+
+/** Finish a batch of changes to the tracks.
+ *
+ * This refreshes the multitrack if any track changed since the outermost
+ * mlt_multitrack_begin_update().
+ *
+ * \public \memberof mlt_multitrack_s
+ * \param self a multitrack
+ */
+
+void mlt_multitrack_end_update( mlt_multitrack self )
+{
+	if ( self && self->update_depth > 0 && --self->update_depth == 0 && self->refresh_pending )
+		mlt_multitrack_refresh( self );
+}
+
+/** Refresh the multitrack now or at the end of the current batch of changes.
+ *
+ * \private \memberof mlt_multitrack_s
+ * \param self a multitrack
+ */
+
+static void mlt_multitrack_changed( mlt_multitrack self )
+{
+	if ( self->update_depth > 0 )
+		self->refresh_pending = 1;
+	else
+		mlt_multitrack_refresh( self );
+}
+
 /** Listener for producers on the playlist.
  *
  * \private \memberof mlt_multitrack_s
@@ -163,7 +217,7 @@ void mlt_multitrack_refresh( mlt_multitrack self )
 
 static void mlt_multitrack_listener( mlt_producer producer, mlt_multitrack self )
 {
-	mlt_multitrack_refresh( self );
+	mlt_multitrack_changed( self );
 }
 
 static void resize_service_caches( mlt_multitrack self )
@@ -236,7 +290,7 @@ int mlt_multitrack_connect( mlt_multitrack self, mlt_producer producer, int trac
 		}
 
 		// Refresh our stats
-		mlt_multitrack_refresh( self );
+		mlt_multitrack_changed( self );
 	}
 
 	return result;
@@ -290,7 +344,7 @@ int mlt_multitrack_insert( mlt_multitrack self, mlt_producer producer, int track
 			mlt_event_inc_ref( self->list[ track ]->event );
 
 			// Refresh our stats
-			mlt_multitrack_refresh( self );
+			mlt_multitrack_changed( self );
 		}
 		else
 		{
@@ -343,7 +397,7 @@ int mlt_multitrack_disconnect( mlt_multitrack self, int track )
 			self->count --;
 
 			// Recalculate the duration.
-			mlt_multitrack_refresh( self );
+			mlt_multitrack_changed( self );
 		}
 	}
 	return error;
@@ -392,49 +446,28 @@ mlt_producer mlt_multitrack_track( mlt_multitrack self, int track )
 
 static int position_compare( const void *p1, const void *p2 )
 {
-	return *( const mlt_position * )p1 - *( const mlt_position * )p2;
+	mlt_position a = *( const mlt_position * )p1;
+	mlt_position b = *( const mlt_position * )p2;
+	return ( a > b ) - ( a < b );
 }
 
-/** Add a position to a set.
+/** Sort a list of positions and remove the duplicates.
  *
  * \private \memberof mlt_multitrack_s
- * \param array an array of positions (the set)
- * \param size the current number of positions in the array (not the capacity of the array)
- * \param position the position to add
- * \return the new size of the array
+ * \param array an array of positions
+ * \param count the number of positions in the array
+ * \return the number of unique positions now at the start of the array
  */
 
-static int add_unique( mlt_position *array, int size, mlt_position position )
+static int sort_unique( mlt_position *array, int count )
 {
-	int i = 0;
-	for ( i = 0; i < size; i ++ )
-		if ( array[ i ] == position )
-			break;
-	if ( i == size )
-		array[ size ++ ] = position;
-	return size;
-}
+	int i, size = 0;
 
-/** Increase the capacity of a set of mlt_position.
- *
- * \private \memberof mlt_multitrack_s
- * \param array an array of positions (the set)
- * \param count the current number of elements in the array (not the capacity)
- * \param[out] size the current capacity of the array
- * \return the new address of the array
- */
-
-static mlt_position* resize_set( mlt_position *map, int count, int *size )
-{
-	mlt_position* result = map;
-	// Resize only if needed.
-	if ( count + 1 >= *size )
-	{
-		result = realloc( map, (*size + 1000) * sizeof(*map) );
-		memset( map + *size, 0, 1000 * sizeof(*map) );
-		*size += 1000;
-	}
-	return result;
+	qsort( array, count, sizeof( *array ), position_compare );
+	for ( i = 0; i < count; i ++ )
+		if ( size == 0 || array[ i ] != array[ size - 1 ] )
+			array[ size ++ ] = array[ i ];
+	return size;
 }
 
 /** Determine the clip point.
@@ -470,10 +503,11 @@ mlt_position mlt_multitrack_clip( mlt_multitrack self, mlt_whence whence, int in
 	mlt_position position = 0;
 	int i = 0;
 	int j = 0;
-	int size = 1000;
-	mlt_position *map = calloc( size, sizeof(*map) );
+	int size = 0;
+	mlt_position *map = NULL;
 	int count = 0;
 
+	// Collect the clip positions of every track, then sort them and drop the repeats
 	for ( i = 0; i < self->count; i ++ )
 	{
 		// Get the producer for this track
@@ -487,35 +521,47 @@ mlt_position mlt_multitrack_clip( mlt_multitrack self, mlt_whence whence, int in
 
 			// Determine if it's a playlist
 			mlt_playlist playlist = mlt_properties_get_data( properties, "playlist", NULL );
+			int clips = playlist != NULL ? mlt_playlist_count( playlist ) : 1;
+
+			if ( count + clips + 1 > size )
+			{
+				int new_size = ( count + clips + 1 ) * 2;
+				mlt_position *new_map = realloc( map, new_size * sizeof( *map ) );
+				if ( new_map == NULL )
+					break;
+				map = new_map;
+				size = new_size;
+			}
 
-			map = resize_set( map, count, &size );
-			
 			// Special case consideration of playlists
 			if ( playlist != NULL )
 			{
-				for ( j = 0; j < mlt_playlist_count( playlist ); j ++ )
-				{
-					count = add_unique( map, count, mlt_playlist_clip( playlist, mlt_whence_relative_start, j ) );
-					map = resize_set( map, count, &size );
-				}
-				count = add_unique( map, count, mlt_producer_get_out( producer ) + 1 );
+				for ( j = 0; j < clips; j ++ )
+					map[ count ++ ] = mlt_playlist_clip( playlist, mlt_whence_relative_start, j );
 			}
 			else
 			{
-				count = add_unique( map, count, 0 );
-				count = add_unique( map, count, mlt_producer_get_out( producer ) + 1 );
+				map[ count ++ ] = 0;
 			}
+			map[ count ++ ] = mlt_producer_get_out( producer ) + 1;
 		}
 	}
 
 	// Now sort the map
-	qsort( map, count, sizeof( mlt_position ), position_compare );
+	count = sort_unique( map, count );
+	if ( count == 0 )
+	{
+		free( map );
+		return 0;
+	}
 
 	// Now locate the requested index
 	switch( whence )
 	{
 		case mlt_whence_relative_start:
-			if ( index < count )
+			if ( index < 0 )
+				position = map[ 0 ];
+			else if ( index < count )
 				position = map[ index ];
 			else
 				position = map[ count - 1 ];
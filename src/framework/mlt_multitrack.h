@@ -51,6 +51,8 @@ struct mlt_multitrack_s
 	mlt_track *list;
 	int size;
 	int count;
+	int update_depth;
+	int refresh_pending;
 };
 
 #define MLT_MULTITRACK_PRODUCER( multitrack )	( &( multitrack )->parent )
@@ -68,6 +70,8 @@ extern mlt_position mlt_multitrack_clip( mlt_multitrack self, mlt_whence whence,
 extern void mlt_multitrack_close( mlt_multitrack self );
 extern int mlt_multitrack_count( mlt_multitrack self );
 extern void mlt_multitrack_refresh( mlt_multitrack self );
+extern void mlt_multitrack_begin_update( mlt_multitrack self );
+extern void mlt_multitrack_end_update( mlt_multitrack self );
 extern mlt_producer mlt_multitrack_track( mlt_multitrack self, int track );
 
 #endif
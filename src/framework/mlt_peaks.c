@@ -0,0 +1,683 @@
+/**
+ * \file mlt_peaks.c
+ * \brief multi-resolution audio peaks of a producer
+ * \see mlt_peaks_s
+ *
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Local header files
+#include "mlt_peaks.h"
+#include "mlt_audio.h"
+#include "mlt_factory.h"
+#include "mlt_frame.h"
+#include "mlt_log.h"
+#include "mlt_producer.h"
+#include "mlt_properties.h"
+
+// System header files
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/** the sample rate at which the audio is analyzed */
+#define PEAKS_FREQUENCY 48000
+
+/** the number of samples in a bin of the finest level */
+#define PEAKS_BASE 256
+
+/** the number of bins of a level that make a bin of the next level */
+#define PEAKS_FACTOR 4
+
+/** the number of levels, the coarsest having bins of about 87 seconds */
+#define PEAKS_LEVELS 8
+
+/** identifies a file of saved peaks and its layout */
+#define PEAKS_MAGIC "MLTPEAK1"
+
+/** \brief Peaks class
+ *
+ * The minimum, maximum and RMS level of the audio of a producer at several
+ * resolutions, so that a waveform can be drawn at any zoom level without
+ * decoding the audio again. The finest level summarizes every PEAKS_BASE
+ * samples and each level above combines PEAKS_FACTOR bins of the one below.
+ *
+ * The audio is analyzed on a thread from a private copy of the producer, and
+ * the peaks can be read while that runs. When the producer is a file, the
+ * finest level is saved when the analysis completes and loaded again the
+ * next time, as long as the file has the same size and modification time.
+ */
+
+struct mlt_peaks_s
+{
+	mlt_producer producer;            /**< a private copy of the producer to analyze */
+	double fps;
+	int frequency;
+	int channels;                     /**< 0 until the first audio is analyzed */
+	int64_t samples;                  /**< the number of samples of the producer */
+	int64_t committed;                /**< the number of finished bins of the finest level */
+	int64_t bins[ PEAKS_LEVELS ];
+	mlt_peak *levels[ PEAKS_LEVELS ]; /**< the bins of each level for each channel, rms holding the mean square */
+	mlt_peak *partial;                /**< the unfinished finest bin of each channel, rms holding the sum of squares */
+	int partial_count;
+	char *file;                       /**< where to save the peaks, or NULL */
+	int64_t source_size;
+	int64_t source_time;
+	int complete;
+	int started;
+	int running;
+	atomic_int cancel;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+static int64_t bin_size( int level )
+{
+	return (int64_t) PEAKS_BASE << ( 2 * level );
+}
+
+static int64_t bin_samples( mlt_peaks self, int level, int64_t bin )
+{
+	int64_t size = bin_size( level );
+	return MIN( size, self->samples - bin * size );
+}
+
+/** Allocate the levels once the number of channels is known.
+ *
+ * \private \memberof mlt_peaks_s
+ * \param self a peaks object
+ * \param channels the number of channels
+ * \return true on error
+ */
+
+static int allocate_levels( mlt_peaks self, int channels )
+{
+	int level;
+
+	for ( level = 0; level < PEAKS_LEVELS; level++ )
+	{
+		int64_t size = bin_size( level );
+		self->bins[ level ] = ( self->samples + size - 1 ) / size;
+		self->levels[ level ] = calloc( MAX( self->bins[ level ], 1 ) * channels, sizeof( mlt_peak ) );
+		if ( !self->levels[ level ] )
+			return 1;
+	}
+	self->partial = calloc( channels, sizeof( mlt_peak ) );
+	if ( !self->partial )
+		return 1;
+	self->channels = channels;
+	return 0;
+}
+
+/** Combine the finished bins below into a bin of a level.
+ *
+ * \private \memberof mlt_peaks_s
+ * \param self a peaks object
+ * \param level the level of the bin, at least 1
+ * \param bin the bin
+ * \param last the last finished bin of the level below
+ */
+
+static void merge_bin( mlt_peaks self, int level, int64_t bin, int64_t last )
+{
+	int64_t first = bin * PEAKS_FACTOR;
+	int64_t end = MIN( MIN( first + PEAKS_FACTOR, self->bins[ level - 1 ] ), last + 1 );
+	int c;
+
+	for ( c = 0; c < self->channels; c++ )
+	{
+		mlt_peak *peak = &self->levels[ level ][ bin * self->channels + c ];
+		double sum = 0.0;
+		int64_t weight = 0;
+		int64_t k;
+
+		peak->min = FLT_MAX;
+		peak->max = -FLT_MAX;
+		for ( k = first; k < end; k++ )
+		{
+			const mlt_peak *child = &self->levels[ level - 1 ][ k * self->channels + c ];
+			int64_t n = bin_samples( self, level - 1, k );
+			peak->min = MIN( peak->min, child->min );
+			peak->max = MAX( peak->max, child->max );
+			sum += child->rms * n;
+			weight += n;
+		}
+		peak->rms = weight ? sum / weight : 0.0;
+		if ( weight == 0 )
+			peak->min = peak->max = 0.0;
+	}
+}
+
+/** Save the partial bin as the next bin of the finest level and update the levels above.
+ *
+ * \private \memberof mlt_peaks_s
+ * \param self a peaks object
+ */
+
+static void commit_bin( mlt_peaks self )
+{
+	int64_t bin = self->committed;
+	int level, c;
+
+	if ( bin >= self->bins[0] || self->partial_count == 0 )
+		return;
+	for ( c = 0; c < self->channels; c++ )
+	{
+		mlt_peak *peak = &self->levels[0][ bin * self->channels + c ];
+		*peak = self->partial[c];
+		peak->rms /= self->partial_count;
+	}
+	for ( level = 1; level < PEAKS_LEVELS; level++ )
+	{
+		int64_t parent = bin / PEAKS_FACTOR;
+		merge_bin( self, level, parent, bin );
+		bin = parent;
+	}
+	self->committed++;
+	self->partial_count = 0;
+}
+
+/** Add planar float samples to the analysis.
+ *
+ * \private \memberof mlt_peaks_s
+ * \param self a peaks object
+ * \param buffer the samples, or NULL for silence
+ * \param channels the number of channels in \p buffer
+ * \param samples the number of samples in \p buffer
+ */
+
+static void add_samples( mlt_peaks self, const float *buffer, int channels, int samples )
+{
+	int i = 0;
+
+	while ( i < samples && self->committed < self->bins[0] )
+	{
+		int n = MIN( samples - i, PEAKS_BASE - self->partial_count );
+		int c, k;
+
+		for ( c = 0; c < self->channels; c++ )
+		{
+			mlt_peak *peak = &self->partial[c];
+			if ( self->partial_count == 0 )
+			{
+				peak->min = FLT_MAX;
+				peak->max = -FLT_MAX;
+				peak->rms = 0.0;
+			}
+			if ( buffer && c < channels )
+			{
+				const float *p = buffer + c * samples + i;
+				for ( k = 0; k < n; k++ )
+				{
+					peak->min = MIN( peak->min, p[k] );
+					peak->max = MAX( peak->max, p[k] );
+					peak->rms += p[k] * p[k];
+				}
+			}
+			else
+			{
+				peak->min = MIN( peak->min, 0.0 );
+				peak->max = MAX( peak->max, 0.0 );
+			}
+		}
+		self->partial_count += n;
+		i += n;
+		if ( self->partial_count == PEAKS_BASE )
+			commit_bin( self );
+	}
+}
+
+/** Write the finest level to the cache file.
+ *
+ * \private \memberof mlt_peaks_s
+ * \param self a peaks object
+ */
+
+static void save_peaks( mlt_peaks self )
+{
+	size_t length = strlen( self->file ) + 5;
+	char *temp = malloc( length );
+	FILE *f;
+	int32_t header[2] = { self->frequency, self->channels };
+	int64_t source[3] = { self->samples, self->source_size, self->source_time };
+	int error = 1;
+
+	if ( !temp )
+		return;
+	snprintf( temp, length, "%s.tmp", self->file );
+	f = fopen( temp, "wb" );
+	if ( f )
+	{
+		error = fwrite( PEAKS_MAGIC, 8, 1, f ) != 1
+			|| fwrite( header, sizeof( header ), 1, f ) != 1
+			|| fwrite( source, sizeof( source ), 1, f ) != 1
+			|| fwrite( self->levels[0], sizeof( mlt_peak ) * self->channels, self->bins[0], f ) != (size_t) self->bins[0];
+		error |= fclose( f ) != 0;
+		if ( !error )
+			error = rename( temp, self->file ) != 0;
+		if ( error )
+			remove( temp );
+	}
+	if ( error )
+		mlt_log_warning( NULL, "[peaks] failed to save %s\n", self->file );
+	free( temp );
+}
+
+/** Read the cache file if it matches the producer.
+ *
+ * \private \memberof mlt_peaks_s
+ * \param self a peaks object
+ * \return true if the peaks were not loaded
+ */
+
+static int load_peaks( mlt_peaks self )
+{
+	FILE *f = fopen( self->file, "rb" );
+	char magic[8];
+	int32_t header[2];
+	int64_t source[3];
+	int error = 1;
+
+	if ( !f )
+		return 1;
+	if ( fread( magic, 8, 1, f ) == 1 && !memcmp( magic, PEAKS_MAGIC, 8 )
+		 && fread( header, sizeof( header ), 1, f ) == 1
+		 && fread( source, sizeof( source ), 1, f ) == 1
+		 && header[0] == self->frequency && header[1] > 0
+		 && source[0] == self->samples && source[1] == self->source_size && source[2] == self->source_time
+		 && !allocate_levels( self, header[1] )
+		 && fread( self->levels[0], sizeof( mlt_peak ) * self->channels, self->bins[0], f ) == (size_t) self->bins[0] )
+	{
+		int64_t bins = self->bins[0];
+		int level;
+		int64_t bin;
+
+		for ( level = 1; level < PEAKS_LEVELS; level++ )
+		{
+			for ( bin = 0; bin < self->bins[ level ]; bin++ )
+				merge_bin( self, level, bin, bins - 1 );
+			bins = self->bins[ level ];
+		}
+		self->committed = self->bins[0];
+		self->complete = 1;
+		error = 0;
+	}
+	fclose( f );
+	return error;
+}
+
+/** Analyze the audio of the private producer.
+ *
+ * \private \memberof mlt_peaks_s
+ * \param arg a peaks object
+ * \return NULL
+ */
+
+static void *analyze_thread( void *arg )
+{
+	mlt_peaks self = arg;
+	mlt_producer producer = self->producer;
+	int length = mlt_producer_get_length( producer );
+	mlt_position position;
+
+	mlt_producer_seek( producer, 0 );
+	for ( position = 0; position < length && !atomic_load( &self->cancel ); position++ )
+	{
+		mlt_frame frame = NULL;
+		mlt_audio_format format = mlt_audio_float;
+		int frequency = self->frequency;
+		int samples = mlt_audio_calculate_frame_samples( self->fps, frequency, position );
+		int channels;
+		void *buffer = NULL;
+
+		if ( mlt_service_get_frame( MLT_PRODUCER_SERVICE( producer ), &frame, 0 ) || !frame )
+			break;
+		channels = self->channels ? self->channels : mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "audio_channels" );
+		if ( channels <= 0 )
+			channels = 2;
+		if ( mlt_frame_get_audio( frame, &buffer, &format, &frequency, &channels, &samples ) || format != mlt_audio_float )
+			buffer = NULL;
+
+		pthread_mutex_lock( &self->mutex );
+		if ( !self->channels && allocate_levels( self, channels ) )
+		{
+			pthread_mutex_unlock( &self->mutex );
+			mlt_frame_close( frame );
+			break;
+		}
+		add_samples( self, buffer, channels, samples );
+		pthread_mutex_unlock( &self->mutex );
+
+		mlt_frame_close( frame );
+		mlt_producer_prepare_next( producer );
+	}
+
+	pthread_mutex_lock( &self->mutex );
+	if ( self->channels && !atomic_load( &self->cancel ) )
+	{
+		commit_bin( self );
+		self->complete = 1;
+	}
+	self->running = 0;
+	pthread_cond_broadcast( &self->cond );
+	pthread_mutex_unlock( &self->mutex );
+
+	if ( self->complete && self->file )
+		save_peaks( self );
+
+	return NULL;
+}
+
+/** Make a file name for the saved peaks of a resource.
+ *
+ * \private \memberof mlt_peaks_s
+ * \param resource the file of the producer
+ * \param directory a directory in which to keep the peaks or NULL to keep them next to \p resource
+ * \return a new string
+ */
+
+static char *peaks_file_name( const char *resource, const char *directory )
+{
+	size_t length;
+	char *name;
+
+	if ( directory )
+	{
+		// FNV-1a
+		uint64_t hash = 14695981039346656037ULL;
+		const unsigned char *p;
+		for ( p = (const unsigned char*) resource; *p; p++ )
+			hash = ( hash ^ *p ) * 1099511628211ULL;
+		length = strlen( directory ) + 32;
+		name = malloc( length );
+		if ( name )
+			snprintf( name, length, "%s/%016llx.mltpeaks", directory, (unsigned long long) hash );
+	}
+	else
+	{
+		length = strlen( resource ) + 10;
+		name = malloc( length );
+		if ( name )
+			snprintf( name, length, "%s.mltpeaks", resource );
+	}
+	return name;
+}
+
+/** Get the peaks of a producer.
+ *
+ * This loads the saved peaks of the producer, or else starts analyzing its
+ * audio in the background on a private copy of the producer.
+ * \public \memberof mlt_peaks_s
+ * \param producer a producer, whose parent is used if it is a cut
+ * \param directory a directory in which to keep the peaks or NULL to keep them next to the file of the producer
+ * \return a new peaks object or NULL on error
+ */
+
+mlt_peaks mlt_peaks_init( mlt_producer producer, const char *directory )
+{
+	mlt_properties properties;
+	const char *service;
+	const char *resource;
+	mlt_peaks self;
+	struct stat info;
+	char *spec;
+
+	if ( !producer )
+		return NULL;
+	producer = mlt_producer_cut_parent( producer );
+	properties = MLT_PRODUCER_PROPERTIES( producer );
+	service = mlt_properties_get( properties, "mlt_service" );
+	resource = mlt_properties_get( properties, "resource" );
+	if ( !service )
+		return NULL;
+
+	self = calloc( 1, sizeof( struct mlt_peaks_s ) );
+	if ( !self )
+		return NULL;
+	pthread_mutex_init( &self->mutex, NULL );
+	pthread_cond_init( &self->cond, NULL );
+	self->fps = mlt_producer_get_fps( producer );
+	self->frequency = PEAKS_FREQUENCY;
+	self->samples = mlt_audio_calculate_samples_to_position( self->fps, self->frequency, mlt_properties_get_int( properties, "length" ) );
+
+	// Only keep the peaks of a file
+	if ( resource && !stat( resource, &info ) && S_ISREG( info.st_mode ) )
+	{
+		self->source_size = info.st_size;
+		self->source_time = info.st_mtime;
+		self->file = peaks_file_name( resource, directory );
+		if ( self->file && !load_peaks( self ) )
+			return self;
+	}
+
+	// Analyze a private copy of the producer, normalized by the loader
+	spec = malloc( strlen( service ) + ( resource ? strlen( resource ) : 0 ) + 2 );
+	if ( spec )
+	{
+		strcpy( spec, service );
+		if ( resource && strcmp( resource, "" ) )
+		{
+			strcat( spec, ":" );
+			strcat( spec, resource );
+		}
+		self->producer = mlt_factory_producer( mlt_service_profile( MLT_PRODUCER_SERVICE( producer ) ), NULL, spec );
+		free( spec );
+	}
+	if ( self->producer )
+	{
+		mlt_properties copy = MLT_PRODUCER_PROPERTIES( self->producer );
+		if ( mlt_properties_get( properties, "audio_index" ) )
+			mlt_properties_set( copy, "audio_index", mlt_properties_get( properties, "audio_index" ) );
+		mlt_properties_set_int( copy, "video_index", -1 );
+		self->running = 1;
+		self->started = !pthread_create( &self->thread, NULL, analyze_thread, self );
+		self->running = self->started;
+	}
+	if ( !self->started )
+	{
+		mlt_log_warning( MLT_PRODUCER_SERVICE( producer ), "[peaks] failed to analyze %s\n", resource ? resource : service );
+		mlt_peaks_close( self );
+		self = NULL;
+	}
+	return self;
+}
+
+/** Get the number of channels of the peaks.
+ *
+ * \public \memberof mlt_peaks_s
+ * \param self a peaks object
+ * \return the number of channels, 0 until the analysis reaches the first audio
+ */
+
+int mlt_peaks_channels( mlt_peaks self )
+{
+	int channels = 0;
+	if ( self )
+	{
+		pthread_mutex_lock( &self->mutex );
+		channels = self->channels;
+		pthread_mutex_unlock( &self->mutex );
+	}
+	return channels;
+}
+
+/** Get the sample rate at which the audio is analyzed.
+ *
+ * \public \memberof mlt_peaks_s
+ * \param self a peaks object
+ * \return the sample rate
+ */
+
+int mlt_peaks_frequency( mlt_peaks self )
+{
+	return self ? self->frequency : 0;
+}
+
+/** Get how much of the audio has been analyzed.
+ *
+ * \public \memberof mlt_peaks_s
+ * \param self a peaks object
+ * \return a fraction from 0.0 to 1.0, which is 1.0 once the peaks are complete
+ */
+
+double mlt_peaks_progress( mlt_peaks self )
+{
+	double progress = 0.0;
+	if ( self )
+	{
+		pthread_mutex_lock( &self->mutex );
+		if ( self->complete )
+			progress = 1.0;
+		else if ( self->bins[0] > 0 )
+			progress = (double) self->committed / self->bins[0];
+		pthread_mutex_unlock( &self->mutex );
+	}
+	return progress;
+}
+
+/** Wait for the analysis to finish.
+ *
+ * \public \memberof mlt_peaks_s
+ * \param self a peaks object
+ * \return true if the peaks are not complete, such as when the audio could not be read
+ */
+
+int mlt_peaks_wait( mlt_peaks self )
+{
+	int error = 1;
+	if ( self )
+	{
+		pthread_mutex_lock( &self->mutex );
+		while ( self->running && !self->complete )
+			pthread_cond_wait( &self->cond, &self->mutex );
+		error = !self->complete;
+		pthread_mutex_unlock( &self->mutex );
+	}
+	return error;
+}
+
+/** Get the peaks of a range of the producer.
+ *
+ * The range is divided into \p count equal parts and each is summarized
+ * from the coarsest level that has at least one bin per part. Parts that
+ * have not been analyzed yet are zero.
+ * \public \memberof mlt_peaks_s
+ * \param self a peaks object
+ * \param channel a channel, or -1 to combine all of the channels
+ * \param in the first frame of the range, relative to the start of the media even for a cut
+ * \param out the last frame of the range
+ * \param peaks an array of \p count peaks to fill
+ * \param count the number of peaks to get
+ * \return true on error
+ */
+
+int mlt_peaks_get( mlt_peaks self, int channel, mlt_position in, mlt_position out, mlt_peak *peaks, int count )
+{
+	int64_t start, end, size, ready;
+	double span;
+	int level, i;
+	int first_channel, last_channel;
+
+	if ( !self || !peaks || count <= 0 || out < in )
+		return 1;
+	memset( peaks, 0, count * sizeof( mlt_peak ) );
+
+	pthread_mutex_lock( &self->mutex );
+	if ( channel >= self->channels && self->channels > 0 )
+	{
+		pthread_mutex_unlock( &self->mutex );
+		return 1;
+	}
+	first_channel = channel < 0 ? 0 : channel;
+	last_channel = channel < 0 ? self->channels - 1 : channel;
+	start = MAX( mlt_audio_calculate_samples_to_position( self->fps, self->frequency, in ), 0 );
+	end = MIN( mlt_audio_calculate_samples_to_position( self->fps, self->frequency, out + 1 ), self->samples );
+	span = (double) ( end - start ) / count;
+
+	// Use the coarsest level that still has a bin for every peak
+	level = 0;
+	while ( level + 1 < PEAKS_LEVELS && bin_size( level + 1 ) <= span )
+		level++;
+	size = bin_size( level );
+	ready = self->complete ? self->bins[ level ] : ( self->committed * PEAKS_BASE + size - 1 ) / size;
+
+	for ( i = 0; i < count && self->channels > 0 && end > start; i++ )
+	{
+		int64_t a = start + (int64_t) ( i * span );
+		int64_t b = MAX( start + (int64_t) ( ( i + 1 ) * span ), a + 1 );
+		int64_t first = a / size;
+		int64_t last = MIN( ( b - 1 ) / size, ready - 1 );
+		double sum = 0.0;
+		int64_t weight = 0;
+		int64_t k;
+		int c;
+
+		if ( first > last )
+			continue;
+		peaks[i].min = FLT_MAX;
+		peaks[i].max = -FLT_MAX;
+		for ( k = first; k <= last; k++ )
+		{
+			int64_t n = bin_samples( self, level, k );
+			for ( c = first_channel; c <= last_channel; c++ )
+			{
+				const mlt_peak *peak = &self->levels[ level ][ k * self->channels + c ];
+				peaks[i].min = MIN( peaks[i].min, peak->min );
+				peaks[i].max = MAX( peaks[i].max, peak->max );
+				sum += peak->rms * n;
+				weight += n;
+			}
+		}
+		peaks[i].rms = weight ? sqrt( sum / weight ) : 0.0;
+	}
+	pthread_mutex_unlock( &self->mutex );
+	return 0;
+}
+
+/** Stop the analysis and destroy the peaks.
+ *
+ * \public \memberof mlt_peaks_s
+ * \param self a peaks object
+ */
+
+void mlt_peaks_close( mlt_peaks self )
+{
+	int level;
+
+	if ( !self )
+		return;
+	if ( self->started )
+	{
+		atomic_store( &self->cancel, 1 );
+		pthread_join( self->thread, NULL );
+	}
+	mlt_producer_close( self->producer );
+	for ( level = 0; level < PEAKS_LEVELS; level++ )
+		free( self->levels[ level ] );
+	free( self->partial );
+	free( self->file );
+	pthread_mutex_destroy( &self->mutex );
+	pthread_cond_destroy( &self->cond );
+	free( self );
+}
@@ -26,6 +26,7 @@
 #include "mlt_field.h"
 #include "mlt_frame.h"
 #include "mlt_transition.h"
+#include "mlt_slices.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -53,6 +54,63 @@ static int producer_get_frame( mlt_producer producer, mlt_frame_ptr frame, int i
 static int mlt_playlist_unmix( mlt_playlist self, int clip );
 static int mlt_playlist_resize_mix( mlt_playlist self, int clip, int in, int out );
 
+/** Stop using the index of clip positions until the next refresh.
+ *
+ * Call this whenever the entries are rearranged, because the lengths in the
+ * index are only updated by mlt_playlist_virtual_refresh().
+ * \private \memberof mlt_playlist_s
+ * \param self a playlist
+ */
+
+static inline void mlt_playlist_invalidate_index( mlt_playlist self )
+{
+	self->indexed = -1;
+}
+
+/** Find the entry that contains a position.
+ *
+ * Entries without frames are skipped like when adding up their lengths.
+ * \private \memberof mlt_playlist_s
+ * \param self a playlist
+ * \param position a time relative to the start of the playlist
+ * \param[out] start the time at which the entry starts
+ * \return the index of the entry or the number of entries if the position is at or after the end
+ */
+
+static int mlt_playlist_find( mlt_playlist self, mlt_position position, mlt_position *start )
+{
+	int i;
+
+	if ( self->indexed == self->count )
+	{
+		// Bisect for the first entry that ends after the position
+		int lo = 0, hi = self->count;
+		while ( lo < hi )
+		{
+			int mid = lo + ( hi - lo ) / 2;
+			if ( self->ends[ mid ] > position )
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		i = lo;
+		if ( i < self->count )
+			*start = self->ends[ i ] - self->list[ i ]->frame_count;
+		else
+			*start = self->count > 0 ? self->ends[ self->count - 1 ] : 0;
+		return i;
+	}
+
+	*start = 0;
+	for ( i = 0; i < self->count; i ++ )
+	{
+		if ( position - *start < self->list[ i ]->frame_count )
+			break;
+		*start += self->list[ i ]->frame_count;
+	}
+	return i;
+}
+
 /** Construct a playlist.
  *
  * Sets the resource property to "<playlist>".
@@ -217,6 +275,30 @@ static int mlt_playlist_virtual_refresh( mlt_playlist self )
 		frame_count += self->list[ i ]->frame_count;
 	}
 
+	// Index the end of each clip for mlt_playlist_find, which needs them in order
+	self->indexed = -1;
+	if ( self->count > self->ends_size )
+	{
+		int size = self->size > self->count ? self->size : self->count;
+		mlt_position *ends = realloc( self->ends, size * sizeof( *ends ) );
+		if ( ends != NULL )
+		{
+			self->ends = ends;
+			self->ends_size = size;
+		}
+	}
+	if ( self->count <= self->ends_size )
+	{
+		mlt_position end = 0;
+		for ( i = 0; i < self->count && self->list[ i ]->frame_count >= 0; i ++ )
+		{
+			end += self->list[ i ]->frame_count;
+			self->ends[ i ] = end;
+		}
+		if ( i == self->count )
+			self->indexed = self->count;
+	}
+
 	// Refresh all properties
 	mlt_events_block( properties, properties );
 	mlt_properties_set_position( properties, "length", frame_count );
@@ -336,6 +418,7 @@ static int mlt_playlist_virtual_append( mlt_playlist self, mlt_producer source,
 	}
 
 	// Create the entry
+	mlt_playlist_invalidate_index( self );
 	self->list[ self->count ] = calloc( 1, sizeof( playlist_entry ) );
 	if ( self->list[ self->count ] != NULL )
 	{
@@ -369,29 +452,167 @@ static mlt_producer mlt_playlist_locate( mlt_playlist self, mlt_position *positi
 {
 	// Default producer to NULL
 	mlt_producer producer = NULL;
+	mlt_position start = 0;
 
-	// Loop for each producer until found
-	for ( *clip = 0; *clip < self->count; *clip += 1 )
+	// Note that 0 length clips get skipped automatically
+	*clip = mlt_playlist_find( self, *position, &start );
+	*position -= start;
+	*total += start;
+	if ( *clip < self->count )
 	{
-		// Increment the total
 		*total += self->list[ *clip ]->frame_count;
+		producer = self->list[ *clip ]->producer;
+	}
+
+	return producer;
+}
+
+/** Render the first frame of a clip to open the producer and decode ahead.
+ *
+ * The seek and the frame are done under the lock of the parent producer,
+ * like mlt_service_get_frame() does, so they cannot interleave with another
+ * user of the producer.
+ *
+ * \private \memberof mlt_playlist_s
+ * \param cookie a producer
+ * \return 0
+ */
+
+static int mlt_playlist_prefetch_proc( void *cookie )
+{
+	mlt_producer producer = cookie;
+	mlt_producer parent = mlt_producer_cut_parent( producer );
+	mlt_service service = MLT_PRODUCER_SERVICE( parent );
+	mlt_frame frame = NULL;
+	int error = 1;
+
+	mlt_service_lock( service );
+	mlt_producer_seek( parent, mlt_producer_get_in( producer ) );
+	if ( service->get_frame )
+		error = service->get_frame( service, &frame, 0 );
+	mlt_service_unlock( service );
+	if ( !error && frame )
+	{
+		mlt_image_format format = mlt_image_none;
+		uint8_t *image = NULL;
+		int width = 0;
+		int height = 0;
+		mlt_frame_get_image( frame, &image, &format, &width, &height, 0 );
+		mlt_frame_close( frame );
+	}
+	return 0;
+}
 
-		// Check if the position indicates that we have found the clip
-		// Note that 0 length clips get skipped automatically
-		if ( *position < self->list[ *clip ]->frame_count )
+/** Get the speed of the producer that the consumer plays.
+ *
+ * A track of a tractor keeps the speed 1 while the tractor pauses or plays
+ * backwards, so this follows the connections from the playlist to the last
+ * producer before the consumer.
+ *
+ * \private \memberof mlt_playlist_s
+ * \param self a playlist
+ * \return the speed
+ */
+
+static double mlt_playlist_play_speed( mlt_playlist self )
+{
+	mlt_service service = MLT_PLAYLIST_SERVICE( self );
+	double speed = mlt_producer_get_speed( MLT_PLAYLIST_PRODUCER( self ) );
+
+	while ( ( service = mlt_service_consumer( service ) ) && mlt_service_identify( service ) != mlt_service_consumer_type )
+	{
+		switch ( mlt_service_identify( service ) )
 		{
-			// Found it, now break
-			producer = self->list[ *clip ]->producer;
+		case mlt_service_producer_type:
+		case mlt_service_tractor_type:
+		case mlt_service_playlist_type:
+		case mlt_service_multitrack_type:
+		case mlt_service_chain_type:
+			speed = mlt_producer_get_speed( MLT_PRODUCER( service ) );
+			break;
+		default:
 			break;
-		}
-		else
-		{
-			// Decrement position by length of self entry
-			*position -= self->list[ *clip ]->frame_count;
 		}
 	}
+	return speed;
+}
 
-	return producer;
+/** Determine if only this playlist uses a clip, so that it can be prefetched.
+ *
+ * The cut must only be in this playlist, and its parent must only be held
+ * by the cut. Other references could be other cuts in use on another track,
+ * which the reference count cannot tell apart from the one of whoever made
+ * the parent.
+ *
+ * \private \memberof mlt_playlist_s
+ * \param producer a cut
+ * \return true if the clip is not shared
+ */
+
+static int mlt_playlist_unshared( mlt_producer producer )
+{
+	mlt_producer parent = mlt_producer_cut_parent( producer );
+
+	return mlt_properties_ref_count( MLT_PRODUCER_PROPERTIES( producer ) ) == 1
+		&& ( parent == producer || mlt_properties_ref_count( MLT_PRODUCER_PROPERTIES( parent ) ) == 1 );
+}
+
+/** Wait for the prefetch of the next clip and release it.
+ *
+ * \private \memberof mlt_playlist_s
+ * \param self a playlist
+ */
+
+static void mlt_playlist_prefetch_release( mlt_playlist self )
+{
+	if ( self->prefetch )
+	{
+		mlt_slices_task_wait( self->prefetch );
+		mlt_slices_task_close( self->prefetch );
+		self->prefetch = NULL;
+	}
+	mlt_producer_close( self->prefetched );
+	self->prefetched = NULL;
+}
+
+/** Prefetch the clip after the one at the play head when it is near its end.
+ *
+ * This must be called before using the producer at the play head since the
+ * prefetch may be using the same producer.
+ * \private \memberof mlt_playlist_s
+ * \param self a playlist
+ * \param clip the index of the entry at the play head
+ * \param remaining the number of frames until the end of the entry
+ */
+
+static void mlt_playlist_prefetch( mlt_playlist self, int clip, mlt_position remaining )
+{
+	mlt_producer producer = clip < self->count ? self->list[ clip ]->producer : NULL;
+	mlt_producer parent = producer ? mlt_producer_cut_parent( producer ) : NULL;
+	mlt_producer next = NULL;
+	int i;
+
+	// Do not let the prefetch use the producer at the play head
+	if ( self->prefetched && ( !parent || mlt_producer_cut_parent( self->prefetched ) == parent ) )
+		mlt_playlist_prefetch_release( self );
+
+	if ( !parent || remaining > mlt_properties_get_int( MLT_PLAYLIST_PROPERTIES( self ), "prefetch" )
+		|| mlt_playlist_play_speed( self ) <= 0 )
+		return;
+
+	// Find the next entry with frames
+	for ( i = clip + 1; i < self->count && !next; i ++ )
+		if ( self->list[ i ]->frame_count > 0 )
+			next = self->list[ i ]->producer;
+	if ( !next || next == self->prefetched || mlt_producer_is_blank( next )
+		|| mlt_producer_cut_parent( next ) == parent || !mlt_playlist_unshared( next )
+		|| mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( next ), "meta.fx_cut" ) )
+		return;
+
+	mlt_playlist_prefetch_release( self );
+	mlt_properties_inc_ref( MLT_PRODUCER_PROPERTIES( next ) );
+	self->prefetched = next;
+	self->prefetch = mlt_slices_task_submit( mlt_playlist_prefetch_proc, next );
 }
 
 /** Seek in the virtual playlist.
@@ -425,6 +646,10 @@ static mlt_service mlt_playlist_virtual_seek( mlt_playlist self, int *progressiv
 	// Get the properties
 	mlt_properties properties = MLT_PLAYLIST_PROPERTIES( self );
 
+	// Prefetch the next clip near the end of this one
+	if ( self->prefetched || mlt_properties_get_int( properties, "prefetch" ) > 0 )
+		mlt_playlist_prefetch( self, i, total - original );
+
 	// Automatically close previous producers if requested
 	if ( i > 1 // keep immediate previous in case app wants to get info about what just finished
 		&& position < 2 // tolerate off-by-one error on going to next clip
@@ -505,23 +730,13 @@ static mlt_producer mlt_playlist_virtual_set_out( mlt_playlist self )
 	// Map playlist position to real producer in virtual playlist
 	mlt_position position = mlt_producer_frame( &self->parent );
 
-	// Loop through the virtual playlist
-	int i = 0;
+	// Find the entry in the virtual playlist
+	mlt_position start = 0;
+	int i = mlt_playlist_find( self, position, &start );
 
-	for ( i = 0; i < self->count; i ++ )
-	{
-		if ( position < self->list[ i ]->frame_count )
-		{
-			// Found it, now break
-			producer = self->list[ i ]->producer;
-			break;
-		}
-		else
-		{
-			// Decrement position by length of this entry
-			position -= self->list[ i ]->frame_count;
-		}
-	}
+	position -= start;
+	if ( i < self->count )
+		producer = self->list[ i ]->producer;
 
 	// Seek in real producer to relative position
 	if ( i < self->count && self->list[ i ]->frame_out != position )
@@ -549,24 +764,10 @@ int mlt_playlist_current_clip( mlt_playlist self )
 	// Map playlist position to real producer in virtual playlist
 	mlt_position position = mlt_producer_frame( &self->parent );
 
-	// Loop through the virtual playlist
-	int i = 0;
+	// Find the entry in the virtual playlist
+	mlt_position start = 0;
 
-	for ( i = 0; i < self->count; i ++ )
-	{
-		if ( position < self->list[ i ]->frame_count )
-		{
-			// Found it, now break
-			break;
-		}
-		else
-		{
-			// Decrement position by length of this entry
-			position -= self->list[ i ]->frame_count;
-		}
-	}
-
-	return i;
+	return mlt_playlist_find( self, position, &start );
 }
 
 /** Obtain the current clips producer.
@@ -624,8 +825,11 @@ mlt_position mlt_playlist_clip( mlt_playlist self, mlt_whence whence, int index
 		absolute_clip = self->count;
 
 	// Now determine the position
-	for ( i = 0; i < absolute_clip; i ++ )
-		position += self->list[ i ]->frame_count;
+	if ( self->indexed == self->count )
+		position = absolute_clip > 0 ? self->ends[ absolute_clip - 1 ] : 0;
+	else
+		for ( i = 0; i < absolute_clip; i ++ )
+			position += self->list[ i ]->frame_count;
 
 	return position;
 }
@@ -691,6 +895,7 @@ int mlt_playlist_clear( mlt_playlist self )
 		mlt_producer_close( self->list[ i ]->producer );
 	}
 	self->count = 0;
+	mlt_playlist_invalidate_index( self );
 	return mlt_playlist_virtual_refresh( self );
 }
 
@@ -821,6 +1026,7 @@ int mlt_playlist_remove( mlt_playlist self, int where )
 		for ( i = where + 1; i < self->count; i ++ )
 			self->list[ i - 1 ] = self->list[ i ];
 		self->count --;
+		mlt_playlist_invalidate_index( self );
 
 		if ( entry->preservation_hack == 0 )
 		{
@@ -919,6 +1125,7 @@ int mlt_playlist_move( mlt_playlist self, int src, int dest )
 				self->list[ i ] = self->list[ i + 1 ];
 		}
 		self->list[ dest ] = src_entry;
+		mlt_playlist_invalidate_index( self );
 
 		mlt_playlist_get_clip_info( self, &current_info, current );
 		mlt_producer_seek( MLT_PLAYLIST_PRODUCER( self ), current_info.start + position );
@@ -965,6 +1172,7 @@ int mlt_playlist_reorder( mlt_playlist self, const int *indices )
 	// Delete the old list and save the new list
 	free( self->list );
 	self->list = new_list;
+	mlt_playlist_invalidate_index( self );
 	mlt_playlist_virtual_refresh( self );
 
 	return 0;
@@ -2121,6 +2329,7 @@ void mlt_playlist_close( mlt_playlist self )
 	{
 		int i = 0;
 		self->parent.close = NULL;
+		mlt_playlist_prefetch_release( self );
 		for ( i = 0; i < self->count; i ++ )
 		{
 			mlt_event_close( self->list[ i ]->event );
@@ -2130,6 +2339,7 @@ void mlt_playlist_close( mlt_playlist self )
 		mlt_producer_close( &self->blank );
 		mlt_producer_close( &self->parent );
 		free( self->list );
+		free( self->ends );
 		free( self );
 	}
 }
@@ -65,6 +65,11 @@ typedef struct playlist_entry_s playlist_entry;
  * \properties \em hide Set to 1 to hide the video (make it an audio-only track),
  * 2 to hide the audio (make it a video-only track), or 3 to hide audio and video (hidden track).
  * This property only applies when using a multitrack or transition.
+ * \properties \em prefetch the number of frames before the end of a clip at which to seek the
+ * next clip and render its first frame in the background while playing forward, which opens it
+ * if needed and avoids a stall at the cut. Only clips whose producer is held by nothing but their
+ * entry in this playlist are prefetched, and only while the producer that the consumer plays, such
+ * as the tractor of a track, plays forward, defaults to 0 (off)
  * \event \em playlist-next The playlist fires this when it moves to the next item in the list.
  *   The event data is an integer of the index of the entry that just completed.
  */
@@ -77,6 +82,11 @@ struct mlt_playlist_s
 	int size;
 	int count;
 	playlist_entry **list;
+	mlt_position *ends;
+	int ends_size;
+	int indexed;
+	mlt_slices_task prefetch; /**< the task rendering the first frame of the next clip */
+	mlt_producer prefetched;  /**< the producer of the next clip while it is prefetched */
 };
 
 #define MLT_PLAYLIST_PRODUCER( playlist )	( &( playlist )->parent )
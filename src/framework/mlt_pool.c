@@ -23,27 +23,40 @@
 #include "mlt_properties.h"
 #include "mlt_deque.h"
 #include "mlt_log.h"
+#include "mlt_trace.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 // Not nice - memalign is defined here apparently?
 #ifdef linux
 #include <malloc.h>
 #endif
 
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
 // Macros to re-assign system functions.
 #ifdef _WIN32
 #  define mlt_free _aligned_free
-#  define mlt_alloc(X) _aligned_malloc( (X), 16 )
-#  define mlt_realloc(X, Y) _aligned_realloc( (X), (Y), 16 )
+#  define mlt_alloc(X) _aligned_malloc( (X), 64 )
+#  define mlt_realloc(X, Y) _aligned_realloc( (X), (Y), 64 )
 #else
 #  define mlt_free free
 #  ifdef linux
-#    define mlt_alloc(X) memalign( 16, (X) )
+#    define mlt_alloc(X) memalign( 64, (X) )
 #  else
-#    define mlt_alloc(X) malloc( (X) )
+static inline void *mlt_alloc( size_t size )
+{
+	void *ptr = NULL;
+	return posix_memalign( &ptr, 64, size ) ? NULL : ptr;
+}
 #  endif
 #  define mlt_realloc realloc
 #endif
@@ -62,6 +75,11 @@ void mlt_pool_release( void *release ) { return mlt_free( release ); }
 void mlt_pool_purge() {}
 void mlt_pool_close() {}
 void mlt_pool_stat() {}
+void mlt_pool_set_budget( int64_t bytes ) {}
+int64_t mlt_pool_get_budget( ) { return 0; }
+int64_t mlt_pool_high_water( ) { return 0; }
+int64_t mlt_pool_allocated_bytes( ) { return 0; }
+mlt_properties mlt_pool_get_stats( ) { return mlt_properties_new( ); }
 
 #else
 
@@ -69,35 +87,315 @@ void mlt_pool_stat() {}
 
 static mlt_properties pools = NULL;
 
+/** the number of steps a size class grows by between two powers of two */
+
+#define POOL_STEPS 4
+
+/** the number of size classes, from 2^8 to 2^30 bytes */
+
+#define POOL_COUNT ( 22 * POOL_STEPS + 1 )
+
+/** the maximum number of blocks a thread keeps per size class */
+
+#define MAGAZINE_SIZE 8
+
+/** a thread keeps at most this many bytes per size class */
+
+#define MAGAZINE_BYTES ( 4 << 20 )
+
+/** size classes at least this big may use huge pages and per-node stacks */
+
+#define LARGE_BLOCK_SIZE ( 2 << 20 )
+
+/** the maximum number of NUMA nodes tracked */
+
+#define MAX_NODES 16
+
+/** use huge pages for large blocks: 0 = no, 1 = transparent, 2 = explicit */
+
+static int use_hugepages = 0;
+
+/** the number of NUMA nodes to keep separate stacks for, 1 to disable */
+
+static int numa_nodes = 1;
+
 /** \brief Pool (memory) class
  */
 
 typedef struct mlt_pool_s
 {
 	pthread_mutex_t lock; ///< lock to prevent race conditions
-	mlt_deque stack;      ///< a stack of addresses to memory blocks
-	int size;             ///< the size of the memory block as a power of 2
+	mlt_deque stack[ MAX_NODES ]; ///< stacks of addresses to memory blocks, one per NUMA node
+	int nodes;            ///< the number of stacks in use
+	int mapped;           ///< the length of the mmap() of a block, 0 if not mapped
+	int size;             ///< the size of the memory block
 	int count;            ///< the number of blocks in the pool
+	int index;            ///< the index of this pool in the thread caches
+	int capacity;         ///< the number of blocks a thread may cache
+	int peak_count;       ///< the largest number of blocks the pool has had at once
+	uint64_t cache_hits;  ///< requests served from a thread cache
+	uint64_t cache_misses;///< requests served by the shared pool
+	atomic_llong fetches; ///< the number of blocks handed out
+	atomic_llong returns; ///< the number of blocks released
+	atomic_llong wasted;  ///< bytes of live blocks beyond what was requested
 }
 *mlt_pool;
 
+/** \brief private to mlt_pool_s, a per-thread cache of free blocks
+ *
+ * Blocks are moved between a magazine and its shared pool in batches so the
+ * common allocate and release path does not need to take the pool lock.
+ */
+
+typedef struct
+{
+	void *items[ POOL_COUNT ][ MAGAZINE_SIZE ];
+	int count[ POOL_COUNT ];
+	uint64_t hits[ POOL_COUNT ];
+	long long fetches[ POOL_COUNT ];
+	long long returns[ POOL_COUNT ];
+	long long wasted[ POOL_COUNT ];
+	int generation;       ///< the purge generation the thread last drained at
+}
+pool_magazine;
+
+static pthread_key_t magazine_key;
+static pthread_once_t magazine_once = PTHREAD_ONCE_INIT;
+
+/** incremented by mlt_pool_purge() so every thread drains its cache on its next use */
+static atomic_int purge_generation;
+
 /** \brief private to mlt_pool_s, for tracking items to release
  *
- * Aligned to 16 byte in case we toss buffers to external assembly
- * optimized libraries (sse/altivec).
+ * Aligned to 64 byte so that buffers given out start on a cache line and
+ * suit aligned SIMD loads (sse/avx/neon), including image rows and planes.
  */
 
-typedef struct __attribute__ ((aligned (16))) mlt_release_s
+typedef struct __attribute__ ((aligned (64))) mlt_release_s
 {
 	mlt_pool pool;
 	int references;
+	int node;
+	int requested;
 }
 *mlt_release;
 
+/** Get the NUMA node of the CPU the calling thread is running on.
+ *
+ * \private \memberof mlt_pool_s
+ * \return a node number less than numa_nodes
+ */
+
+static inline int current_node( )
+{
+	unsigned node = 0;
+#if defined(__linux__) && defined(SYS_getcpu)
+	if ( numa_nodes > 1 && syscall( SYS_getcpu, NULL, &node, NULL ) )
+		node = 0;
+#endif
+	return node < numa_nodes ? node : 0;
+}
+
+/** Allocate the memory for a block of a pool.
+ *
+ * \private \memberof mlt_pool_s
+ * \param self a pool
+ * \return the memory or NULL on failure
+ */
+
+static void *block_alloc( mlt_pool self )
+{
+#ifdef __linux__
+	if ( self->mapped )
+	{
+		void *block = MAP_FAILED;
+#ifdef MAP_HUGETLB
+		if ( use_hugepages == 2 )
+			block = mmap( NULL, self->mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+#endif
+		// Fall back to transparent huge pages if none are reserved
+		if ( block == MAP_FAILED )
+			block = mmap( NULL, self->mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+		if ( block == MAP_FAILED )
+			return NULL;
+#ifdef MADV_HUGEPAGE
+		if ( use_hugepages )
+			madvise( block, self->mapped, MADV_HUGEPAGE );
+#endif
+		// Pages are placed on the node of the thread that touches them first
+		return block;
+	}
+#endif
+	return mlt_alloc( self->size );
+}
+
+/** Free the memory of a block of a pool.
+ *
+ * \private \memberof mlt_pool_s
+ * \param self a pool
+ * \param ptr an opaque pointer as returned by pool_fetch()
+ */
+
+static void block_free( mlt_pool self, void *ptr )
+{
+	void *block = ( char * )ptr - sizeof( struct mlt_release_s );
+#ifdef __linux__
+	if ( self->mapped )
+	{
+		munmap( block, self->mapped );
+		return;
+	}
+#endif
+	mlt_free( block );
+}
+
+/** the maximum number of bytes held in free blocks, 0 for unlimited */
+
+static atomic_llong pool_budget = 0;
+
+/** the number of bytes held in free blocks on the shared stacks */
+
+static atomic_llong idle_bytes = 0;
+
+/** the number of bytes currently allocated by all pools and its peak */
+
+static atomic_llong allocated_bytes = 0;
+static atomic_llong peak_bytes = 0;
+
+/** Account for a block allocated by a pool.
+ *
+ * \private \memberof mlt_pool_s
+ * \param size the number of bytes allocated, negative when freed
+ */
+
+static inline void account_allocated( long long size )
+{
+	long long total = atomic_fetch_add( &allocated_bytes, size ) + size;
+	long long peak = atomic_load( &peak_bytes );
+	while ( total > peak && !atomic_compare_exchange_weak( &peak_bytes, &peak, total ) );
+}
+
+/** Push a free block onto a pool's stack.
+ *
+ * The pool must be locked.
+ * \private \memberof mlt_pool_s
+ * \param self a pool
+ * \param ptr an opaque pointer
+ */
+
+static inline void pool_push( mlt_pool self, void *ptr )
+{
+	int node = self->nodes > 1 ? ( ( mlt_release )( ( char * )ptr - sizeof( struct mlt_release_s ) ) )->node : 0;
+	mlt_deque_push_back( self->stack[ node ], ptr );
+	atomic_fetch_add( &idle_bytes, self->size );
+}
+
+/** Pop the most recently returned block off a pool's stack.
+ *
+ * The pool must be locked.
+ * \private \memberof mlt_pool_s
+ * \param self a pool
+ * \return an opaque pointer or NULL if the stack is empty
+ */
+
+static inline void *pool_pop( mlt_pool self )
+{
+	void *ptr = NULL;
+	int node = self->nodes > 1 ? current_node( ) : 0;
+	int i;
+
+	// Prefer a block that was first touched on the node of the calling thread
+	for ( i = 0; ptr == NULL && i < self->nodes; i ++ )
+		ptr = mlt_deque_pop_back( self->stack[ ( node + i ) % self->nodes ] );
+	if ( ptr )
+		atomic_fetch_sub( &idle_bytes, self->size );
+	return ptr;
+}
+
+/** Free the least recently returned block of a pool.
+ *
+ * The pool must be locked.
+ * \private \memberof mlt_pool_s
+ * \param self a pool
+ * \return true if a block was freed
+ */
+
+static int pool_free_oldest( mlt_pool self )
+{
+	void *ptr = NULL;
+	int i;
+	for ( i = 0; ptr == NULL && i < self->nodes; i ++ )
+		ptr = mlt_deque_pop_front( self->stack[ i ] );
+	if ( ptr )
+	{
+		block_free( self, ptr );
+		self->count --;
+		atomic_fetch_sub( &idle_bytes, self->size );
+		account_allocated( -self->size );
+	}
+	return ptr != NULL;
+}
+
+static void pool_trim( );
+
+/** Get the number of free blocks held by a pool.
+ *
+ * \private \memberof mlt_pool_s
+ * \param self a pool
+ * \return the number of blocks on its stacks
+ */
+
+static int pool_idle( mlt_pool self )
+{
+	int i, count = 0;
+	for ( i = 0; i < self->nodes; i ++ )
+		count += mlt_deque_count( self->stack[ i ] );
+	return count;
+}
+
+/** Get the block size of a size class.
+ *
+ * Between each two powers of two there are POOL_STEPS evenly spaced classes,
+ * so a request wastes at most a fifth of its block rather than a half.
+ * \private \memberof mlt_pool_s
+ * \param index the index of the size class
+ * \return the size of its blocks in bytes
+ */
+
+static inline int class_size( int index )
+{
+	return ( 1 << ( 8 + index / POOL_STEPS ) ) / POOL_STEPS * ( POOL_STEPS + index % POOL_STEPS );
+}
+
+/** Get the smallest size class that holds a block.
+ *
+ * \private \memberof mlt_pool_s
+ * \param size the number of bytes including the header
+ * \return the index of the size class, which may be too big for any pool
+ */
+
+static inline int class_index( int size )
+{
+	int exponent = 8;
+
+	// Minimum size pooled is 256 bytes
+	if ( size <= ( 1 << exponent ) )
+		return 0;
+	if ( size > class_size( POOL_COUNT - 1 ) )
+		return POOL_COUNT;
+	while ( ( 1 << exponent ) < size )
+		exponent ++;
+
+	// Find the step above the previous power of two
+	int base = 1 << ( exponent - 1 );
+	int step = base / POOL_STEPS;
+	return ( exponent - 9 ) * POOL_STEPS + ( size - base + step - 1 ) / step;
+}
+
 /** Create a pool.
  *
  * \private \memberof mlt_pool_s
- * \param size the size of the memory blocks to hold as some power of two
+ * \param size the size of the memory blocks to hold
  * \return a new pool object
  */
 
@@ -112,11 +410,30 @@ static mlt_pool pool_init( int size )
 		// Initialise the mutex
 		pthread_mutex_init( &self->lock, NULL );
 
-		// Create the stack
-		self->stack = mlt_deque_init( );
+		// Large blocks are kept per NUMA node and mapped directly
+		self->nodes = size >= LARGE_BLOCK_SIZE ? numa_nodes : 1;
+#ifdef __linux__
+		if ( size >= LARGE_BLOCK_SIZE && ( use_hugepages || numa_nodes > 1 ) )
+		{
+			// Explicit huge pages can only be mapped whole
+			self->mapped = size;
+			if ( use_hugepages == 2 )
+				self->mapped = ( size + LARGE_BLOCK_SIZE - 1 ) / LARGE_BLOCK_SIZE * LARGE_BLOCK_SIZE;
+		}
+#endif
+
+		// Create the stacks
+		int i;
+		for ( i = 0; i < self->nodes; i ++ )
+			self->stack[ i ] = mlt_deque_init( );
 
 		// Assign the size
 		self->size = size;
+
+		// Do not let threads hoard large blocks
+		self->capacity = MAGAZINE_BYTES / size;
+		if ( self->capacity > MAGAZINE_SIZE )
+			self->capacity = MAGAZINE_SIZE;
 	}
 
 	// Return it
@@ -141,26 +458,24 @@ static void *pool_fetch( mlt_pool self )
 		// Lock the pool
 		pthread_mutex_lock( &self->lock );
 
-		// Check if the stack is empty
-		if ( mlt_deque_count( self->stack ) != 0 )
+		// Pop the top of the stack if it is not empty
+		ptr = pool_pop( self );
+		if ( ptr != NULL )
 		{
-			// Pop the top of the stack
-			ptr = mlt_deque_pop_back( self->stack );
-
 			// Assign the reference
-			( ( mlt_release )ptr )->references = 1;
+			( ( mlt_release )( ( char * )ptr - sizeof( struct mlt_release_s ) ) )->references = 1;
 		}
 		else
 		{
 			// We need to generate a release item
-			mlt_release release = mlt_alloc( self->size );
+			mlt_release release = block_alloc( self );
 
 			// If out of memory, log it, reclaim memory, and try again.
 			if ( !release && self->size > 0 )
 			{
 				mlt_log_fatal( NULL, "[mlt_pool] out of memory\n" );
 				mlt_pool_purge();
-				release = mlt_alloc( self->size );
+				release = block_alloc( self );
 			}
 
 			// Initialise it
@@ -168,6 +483,9 @@ static void *pool_fetch( mlt_pool self )
 			{
 				// Increment the number of items allocated to this pool
 				self->count ++;
+				if ( self->count > self->peak_count )
+					self->peak_count = self->count;
+				account_allocated( self->size );
 
 				// Assign the pool
 				release->pool = self;
@@ -175,6 +493,9 @@ static void *pool_fetch( mlt_pool self )
 				// Assign the reference
 				release->references = 1;
 
+				// Remember where the memory is likely to be placed
+				release->node = current_node( );
+
 				// Determine the ptr
 				ptr = ( char * )release + sizeof( struct mlt_release_s );
 			}
@@ -211,11 +532,13 @@ static void pool_return( void *ptr )
 			pthread_mutex_lock( &self->lock );
 
 			// Push the that back back on to the stack
-			mlt_deque_push_back( self->stack, ptr );
+			pool_push( self, ptr );
 
 			// Unlock the pool
 			pthread_mutex_unlock( &self->lock );
 
+			pool_trim( );
+
 			return;
 		}
 
@@ -224,6 +547,234 @@ static void pool_return( void *ptr )
 	}
 }
 
+/** Flush a thread's counters into a pool's statistics.
+ *
+ * The pool must be locked.
+ * \private \memberof mlt_pool_s
+ * \param self a pool
+ * \param magazine the calling thread's cache
+ */
+
+static inline void magazine_flush_hits( mlt_pool self, pool_magazine *magazine )
+{
+	int i = self->index;
+	self->cache_hits += magazine->hits[ i ];
+	atomic_fetch_add( &self->fetches, magazine->fetches[ i ] );
+	atomic_fetch_add( &self->returns, magazine->returns[ i ] );
+	atomic_fetch_add( &self->wasted, magazine->wasted[ i ] );
+	magazine->hits[ i ] = 0;
+	magazine->fetches[ i ] = 0;
+	magazine->returns[ i ] = 0;
+	magazine->wasted[ i ] = 0;
+}
+
+/** Return all of the blocks held by a thread cache to the shared pools.
+ *
+ * \private \memberof mlt_pool_s
+ * \param magazine a thread cache
+ */
+
+static void magazine_drain( pool_magazine *magazine )
+{
+	int i;
+	for ( i = 0; pools && i < POOL_COUNT; i ++ )
+	{
+		mlt_pool self = mlt_properties_get_data_at( pools, i, NULL );
+		if ( self != NULL && ( magazine->count[ i ] || magazine->hits[ i ] || magazine->fetches[ i ] || magazine->returns[ i ] ) )
+		{
+			pthread_mutex_lock( &self->lock );
+			while ( magazine->count[ i ] > 0 )
+				pool_push( self, magazine->items[ i ][ -- magazine->count[ i ] ] );
+			magazine_flush_hits( self, magazine );
+			pthread_mutex_unlock( &self->lock );
+		}
+	}
+	pool_trim( );
+}
+
+/** Destroy a thread cache when its thread exits.
+ *
+ * \private \memberof mlt_pool_s
+ * \param magazine a thread cache
+ */
+
+static void magazine_close( void *magazine )
+{
+	magazine_drain( magazine );
+	free( magazine );
+}
+
+static void magazine_key_init( )
+{
+	pthread_key_create( &magazine_key, magazine_close );
+}
+
+/** Get the calling thread's cache, creating it if needed.
+ *
+ * A cache is drained first if the pools were purged since its last use.
+ * \private \memberof mlt_pool_s
+ * \return a thread cache or NULL on allocation failure
+ */
+
+static inline pool_magazine *magazine_get( )
+{
+	pool_magazine *magazine = pthread_getspecific( magazine_key );
+	int generation = atomic_load_explicit( &purge_generation, memory_order_relaxed );
+	if ( magazine == NULL )
+	{
+		magazine = calloc( 1, sizeof( pool_magazine ) );
+		if ( magazine )
+			magazine->generation = generation;
+		pthread_setspecific( magazine_key, magazine );
+	}
+	else if ( magazine->generation != generation )
+	{
+		magazine->generation = generation;
+		magazine_drain( magazine );
+	}
+	return magazine;
+}
+
+/** Update the usage statistics of a pool.
+ *
+ * Counts for size classes that go through a thread cache are kept there and
+ * flushed into the pool whenever the thread exchanges blocks with it.
+ * \private \memberof mlt_pool_s
+ * \param self a pool
+ * \param fetches the number of blocks handed out
+ * \param returns the number of blocks released
+ * \param wasted the change in bytes allocated but not requested
+ */
+
+static inline void pool_account( mlt_pool self, int fetches, int returns, long long wasted )
+{
+	pool_magazine *magazine = self->capacity > 0 ? pthread_getspecific( magazine_key ) : NULL;
+
+	if ( magazine )
+	{
+		magazine->fetches[ self->index ] += fetches;
+		magazine->returns[ self->index ] += returns;
+		magazine->wasted[ self->index ] += wasted;
+	}
+	else
+	{
+		atomic_fetch_add( &self->fetches, fetches );
+		atomic_fetch_add( &self->returns, returns );
+		atomic_fetch_add( &self->wasted, wasted );
+	}
+}
+
+/** Get the number of bytes of a block that were not requested.
+ *
+ * \private \memberof mlt_pool_s
+ * \param that the header of a block
+ * \return the number of bytes
+ */
+
+static inline long long block_waste( mlt_release that )
+{
+	return that->pool->size - ( long long )sizeof( struct mlt_release_s ) - that->requested;
+}
+
+/** Get an item from the calling thread's cache or refill it from the pool.
+ *
+ * \private \memberof mlt_pool_s
+ * \param self a pool
+ * \return an opaque pointer
+ */
+
+static void *pool_fetch_cached( mlt_pool self )
+{
+	pool_magazine *magazine = self && self->capacity > 0 ? magazine_get( ) : NULL;
+
+	if ( magazine == NULL )
+		return pool_fetch( self );
+
+	int i = self->index;
+	if ( magazine->count[ i ] == 0 )
+	{
+		// Refill half of the magazine from the shared stack in one go
+		pthread_mutex_lock( &self->lock );
+		void *item;
+		while ( magazine->count[ i ] < ( self->capacity + 1 ) / 2 && ( item = pool_pop( self ) ) )
+			magazine->items[ i ][ magazine->count[ i ] ++ ] = item;
+		self->cache_misses ++;
+		magazine_flush_hits( self, magazine );
+		pthread_mutex_unlock( &self->lock );
+
+		if ( magazine->count[ i ] == 0 )
+			return pool_fetch( self );
+	}
+	else
+	{
+		magazine->hits[ i ] ++;
+	}
+
+	void *ptr = magazine->items[ i ][ -- magazine->count[ i ] ];
+	( ( mlt_release )( ( char * )ptr - sizeof( struct mlt_release_s ) ) )->references = 1;
+	return ptr;
+}
+
+/** Return an item to the calling thread's cache.
+ *
+ * When the cache is full, half of it is returned to the shared pool.
+ * \private \memberof mlt_pool_s
+ * \param ptr an opaque pointer
+ */
+
+static void pool_return_cached( void *ptr )
+{
+	if ( ptr == NULL )
+		return;
+
+	mlt_release that = ( void * )(( char * )ptr - sizeof( struct mlt_release_s ));
+	mlt_pool self = that->pool;
+	pool_magazine *magazine = self && self->capacity > 0 ? magazine_get( ) : NULL;
+
+	if ( magazine == NULL )
+	{
+		pool_return( ptr );
+		return;
+	}
+
+	int i = self->index;
+	if ( magazine->count[ i ] == self->capacity )
+	{
+		pthread_mutex_lock( &self->lock );
+		while ( magazine->count[ i ] > self->capacity / 2 )
+			pool_push( self, magazine->items[ i ][ -- magazine->count[ i ] ] );
+		magazine_flush_hits( self, magazine );
+		pthread_mutex_unlock( &self->lock );
+		pool_trim( );
+	}
+	magazine->items[ i ][ magazine->count[ i ] ++ ] = ptr;
+}
+
+/** Free idle blocks until the pools are within the budget.
+ *
+ * The least recently returned blocks of the largest size classes go first.
+ * \private \memberof mlt_pool_s
+ */
+
+static void pool_trim( )
+{
+	long long budget = atomic_load( &pool_budget );
+	int i;
+
+	if ( budget <= 0 || atomic_load( &idle_bytes ) <= budget )
+		return;
+
+	for ( i = POOL_COUNT - 1; pools && i >= 0 && atomic_load( &idle_bytes ) > budget; i -- )
+	{
+		mlt_pool self = mlt_properties_get_data_at( pools, i, NULL );
+		if ( self == NULL )
+			continue;
+		pthread_mutex_lock( &self->lock );
+		while ( atomic_load( &idle_bytes ) > budget && pool_free_oldest( self ) );
+		pthread_mutex_unlock( &self->lock );
+	}
+}
+
 /** Destroy a pool.
  *
  * \private \memberof mlt_pool_s
@@ -238,14 +789,17 @@ static void pool_close( mlt_pool self )
 		void *release = NULL;
 
 		// Iterate through the stack until depleted
-		while ( ( release = mlt_deque_pop_back( self->stack ) ) != NULL )
+		while ( ( release = pool_pop( self ) ) != NULL )
 		{
 			// We'll free this item now
-			mlt_free( ( char * )release - sizeof( struct mlt_release_s ) );
+			block_free( self, release );
+			account_allocated( -self->size );
 		}
 
-		// We can now close the stack
-		mlt_deque_close( self->stack );
+		// We can now close the stacks
+		int i;
+		for ( i = 0; i < self->nodes; i ++ )
+			mlt_deque_close( self->stack[ i ] );
 
 		// Destroy the mutex
 		pthread_mutex_destroy( &self->lock );
@@ -265,20 +819,62 @@ void mlt_pool_init( )
 	// Loop variable used to create the pools
 	int i = 0;
 
+	// Create the key for the thread caches
+	pthread_once( &magazine_once, magazine_key_init );
+
+	// Apply the memory budget from the environment
+	char *budget = getenv( "MLT_POOL_BUDGET" );
+	if ( budget )
+	{
+		char *end = NULL;
+		long long bytes = strtoll( budget, &end, 10 );
+		if ( end && ( *end == 'k' || *end == 'K' ) ) bytes <<= 10;
+		else if ( end && ( *end == 'm' || *end == 'M' ) ) bytes <<= 20;
+		else if ( end && ( *end == 'g' || *end == 'G' ) ) bytes <<= 30;
+		mlt_pool_set_budget( bytes );
+	}
+
+	// Back large blocks with huge pages
+	char *hugepages = getenv( "MLT_POOL_HUGEPAGES" );
+	if ( hugepages )
+		use_hugepages = !strcmp( hugepages, "explicit" ) ? 2 : !!atoi( hugepages ) || !strcmp( hugepages, "transparent" );
+
+	// Keep large blocks on the NUMA node where they were first allocated
+	numa_nodes = 1;
+#ifdef __linux__
+	char *numa = getenv( "MLT_POOL_NUMA" );
+	if ( numa && atoi( numa ) )
+	{
+		DIR *dir = opendir( "/sys/devices/system/node" );
+		struct dirent *de;
+		while ( dir && ( de = readdir( dir ) ) )
+		{
+			int node = 0;
+			if ( sscanf( de->d_name, "node%d", &node ) == 1 && node + 1 > numa_nodes )
+				numa_nodes = node + 1;
+		}
+		if ( dir )
+			closedir( dir );
+		if ( numa_nodes > MAX_NODES )
+			numa_nodes = MAX_NODES;
+	}
+#endif
+
 	// Create the pools
 	pools = mlt_properties_new( );
 
 	// Create the pools
-	for ( i = 8; i < 31; i ++ )
+	for ( i = 0; i < POOL_COUNT; i ++ )
 	{
 		// Each properties item needs a name
 		char name[ 32 ];
 
 		// Construct a pool
-		mlt_pool pool = pool_init( 1 << i );
+		mlt_pool pool = pool_init( class_size( i ) );
+		pool->index = i;
 
 		// Generate a name
-		sprintf( name, "%d", i );
+		sprintf( name, "%d", pool->size );
 
 		// Register with properties
 		mlt_properties_set_data( pools, name, pool, 0, ( mlt_destructor )pool_close, NULL );
@@ -297,18 +893,25 @@ void *mlt_pool_alloc( int size )
 	mlt_pool pool = NULL;
 
 	// Determines the index of the pool to use
-	int index = 8;
-
-	// Minimum size pooled is 256 bytes
 	size += sizeof( struct mlt_release_s );
-	while ( ( 1 << index ) < size )
-		index ++;
+	int index = class_index( size );
 
 	// Now get the pool at the index
-	pool = mlt_properties_get_data_at( pools, index - 8, NULL );
+	if ( index < POOL_COUNT )
+		pool = mlt_properties_get_data_at( pools, index, NULL );
 
 	// Now get the real item
-	return pool_fetch( pool );
+	void *ptr = pool_fetch_cached( pool );
+
+	// Keep track of how much of the block is actually used
+	if ( ptr != NULL )
+	{
+		mlt_release that = ( void * )(( char * )ptr - sizeof( struct mlt_release_s ));
+		that->requested = size - sizeof( struct mlt_release_s );
+		pool_account( pool, 1, 0, block_waste( that ) );
+		mlt_trace_alloc( that->requested );
+	}
+	return ptr;
 }
 
 /** Allocate size bytes from the pool.
@@ -343,7 +946,10 @@ void *mlt_pool_realloc( void *ptr, int size )
 		}
 		else
 		{
-			// Nothing to do
+			// Nothing to do but note the new size
+			long long wasted = block_waste( that );
+			that->requested = size;
+			pool_account( that->pool, 0, 0, block_waste( that ) - wasted );
 			result = ptr;
 		}
 	}
@@ -358,7 +964,11 @@ void *mlt_pool_realloc( void *ptr, int size )
 
 /** Purge unused items in the pool.
  *
- * A form of garbage collection.
+ * A form of garbage collection. The blocks cached by the calling thread are
+ * freed at once. Other threads cannot be drained safely from here, so they
+ * return the blocks they cache to the shared pools on their next allocation
+ * or release, or when they exit. From there the budget or the next purge
+ * frees them. Until then a thread that stays idle keeps its cache.
  * \public \memberof mlt_pool_s
  */
 
@@ -366,6 +976,15 @@ void mlt_pool_purge( )
 {
 	int i = 0;
 
+	// Ask every thread to return its cache, and return the calling thread's now
+	int generation = atomic_fetch_add( &purge_generation, 1 ) + 1;
+	pool_magazine *magazine = pthread_getspecific( magazine_key );
+	if ( magazine )
+	{
+		magazine->generation = generation;
+		magazine_drain( magazine );
+	}
+
 	// For each pool
 	for ( i = 0; i < mlt_properties_count( pools ); i ++ )
 	{
@@ -379,10 +998,11 @@ void mlt_pool_purge( )
 		pthread_mutex_lock( &self->lock );
 
 		// We'll free all unused items now
-		while ( ( release = mlt_deque_pop_back( self->stack ) ) != NULL )
+		while ( ( release = pool_pop( self ) ) != NULL )
 		{
-			mlt_free( ( char * )release - sizeof( struct mlt_release_s ) );
+			block_free( self, release );
 			self->count--;
+			account_allocated( -self->size );
 		}
 
 		// Unlock the pool
@@ -390,6 +1010,138 @@ void mlt_pool_purge( )
 	}
 }
 
+/** Set the maximum number of bytes the pool may hold in unused blocks.
+ *
+ * When released blocks would exceed the budget, the least recently released
+ * blocks are freed, starting with the largest sizes. The initial value comes
+ * from the environment variable MLT_POOL_BUDGET, which accepts a K, M, or G
+ * suffix. Each thread may additionally cache a few small blocks of its own.
+ * \public \memberof mlt_pool_s
+ * \param bytes the budget in bytes or 0 for unlimited
+ */
+
+void mlt_pool_set_budget( int64_t bytes )
+{
+	atomic_store( &pool_budget, bytes > 0 ? bytes : 0 );
+	pool_trim( );
+}
+
+/** Get the maximum number of bytes the pool may hold in unused blocks.
+ *
+ * \public \memberof mlt_pool_s
+ * \return the budget in bytes or 0 for unlimited
+ */
+
+int64_t mlt_pool_get_budget( )
+{
+	return atomic_load( &pool_budget );
+}
+
+/** Get the largest number of bytes the pool has had allocated at once.
+ *
+ * \public \memberof mlt_pool_s
+ * \return the high-water mark in bytes
+ */
+
+int64_t mlt_pool_high_water( )
+{
+	return atomic_load( &peak_bytes );
+}
+
+/** Get the number of bytes the pool has allocated, including free blocks.
+ *
+ * \public \memberof mlt_pool_s
+ * \return the number of bytes
+ */
+
+int64_t mlt_pool_allocated_bytes( )
+{
+	return atomic_load( &allocated_bytes );
+}
+
+/** Get the usage statistics of the pool.
+ *
+ * The result holds the totals "allocated_bytes", "used_bytes", "idle_bytes",
+ * "high_water", "budget", "cache_hits", and "cache_misses", and a properties
+ * list "classes" with an entry per size class named by its block size. Each
+ * entry has the properties:
+ *
+ * - size: the size of a block including its header
+ * - blocks: the number of blocks allocated
+ * - peak_blocks: the largest number of blocks allocated at once
+ * - live_blocks: the number of blocks in use
+ * - cached_blocks: the number of free blocks on the shared stacks
+ * - thread_cached_blocks: the number of free blocks held by thread caches
+ * - bytes, live_bytes, and cached_bytes: the above multiplied by the size
+ * - fetches and returns: the number of blocks handed out and released
+ * - wasted_bytes: the bytes of live blocks beyond what was requested
+ * - cache_hits and cache_misses: how often the thread caches were used
+ *
+ * Other threads flush their counts whenever they exchange blocks with the
+ * shared stacks, so the figures are approximate while they are running.
+ * \public \memberof mlt_pool_s
+ * \return a new properties list that the caller must close
+ */
+
+mlt_properties mlt_pool_get_stats( )
+{
+	mlt_properties stats = mlt_properties_new( );
+	mlt_properties classes = mlt_properties_new( );
+	pool_magazine *magazine = pthread_getspecific( magazine_key );
+	int64_t allocated = 0, used = 0;
+	uint64_t hits = 0, misses = 0;
+	int i;
+
+	for ( i = 0; pools && i < mlt_properties_count( pools ); i ++ )
+	{
+		mlt_pool self = mlt_properties_get_data_at( pools, i, NULL );
+		mlt_properties entry = mlt_properties_new( );
+		char name[ 32 ];
+
+		pthread_mutex_lock( &self->lock );
+		if ( magazine )
+			magazine_flush_hits( self, magazine );
+		int64_t size = self->size;
+		int count = self->count;
+		int idle = pool_idle( self );
+		int64_t live = atomic_load( &self->fetches ) - atomic_load( &self->returns );
+		int64_t thread_cached = count - idle - live;
+		mlt_properties_set_int( entry, "size", self->size );
+		mlt_properties_set_int( entry, "blocks", count );
+		mlt_properties_set_int( entry, "peak_blocks", self->peak_count );
+		mlt_properties_set_int64( entry, "live_blocks", live );
+		mlt_properties_set_int( entry, "cached_blocks", idle );
+		mlt_properties_set_int64( entry, "thread_cached_blocks", thread_cached > 0 ? thread_cached : 0 );
+		mlt_properties_set_int64( entry, "bytes", size * count );
+		mlt_properties_set_int64( entry, "live_bytes", size * live );
+		mlt_properties_set_int64( entry, "cached_bytes", size * idle );
+		mlt_properties_set_int64( entry, "fetches", atomic_load( &self->fetches ) );
+		mlt_properties_set_int64( entry, "returns", atomic_load( &self->returns ) );
+		mlt_properties_set_int64( entry, "wasted_bytes", atomic_load( &self->wasted ) );
+		mlt_properties_set_int64( entry, "cache_hits", self->cache_hits );
+		mlt_properties_set_int64( entry, "cache_misses", self->cache_misses );
+		allocated += size * count;
+		used += size * ( count - idle );
+		hits += self->cache_hits;
+		misses += self->cache_misses;
+		pthread_mutex_unlock( &self->lock );
+
+		sprintf( name, "%d", self->size );
+		mlt_properties_set_data( classes, name, entry, 0, ( mlt_destructor )mlt_properties_close, NULL );
+	}
+
+	mlt_properties_set_int64( stats, "allocated_bytes", allocated );
+	mlt_properties_set_int64( stats, "used_bytes", used );
+	mlt_properties_set_int64( stats, "idle_bytes", atomic_load( &idle_bytes ) );
+	mlt_properties_set_int64( stats, "high_water", mlt_pool_high_water( ) );
+	mlt_properties_set_int64( stats, "budget", mlt_pool_get_budget( ) );
+	mlt_properties_set_int64( stats, "cache_hits", hits );
+	mlt_properties_set_int64( stats, "cache_misses", misses );
+	mlt_properties_set_data( stats, "classes", classes, 0, ( mlt_destructor )mlt_properties_close, NULL );
+
+	return stats;
+}
+
 /** Release the allocated memory.
  *
  * \public \memberof mlt_pool_s
@@ -398,8 +1150,15 @@ void mlt_pool_purge( )
 
 void mlt_pool_release( void *release )
 {
+	if ( release != NULL )
+	{
+		mlt_release that = ( void * )(( char * )release - sizeof( struct mlt_release_s ));
+		if ( that->pool != NULL )
+			pool_account( that->pool, 0, 1, -block_waste( that ) );
+	}
+
 	// Return to the pool
-	pool_return( release );
+	pool_return_cached( release );
 }
 
 /** Close the pool.
@@ -413,14 +1172,20 @@ void mlt_pool_close( )
 	mlt_pool_stat( );
 #endif
 
+	// Return the blocks cached by the calling thread so they get freed
+	pool_magazine *magazine = pthread_getspecific( magazine_key );
+	if ( magazine )
+		magazine_drain( magazine );
+
 	// Close the properties
 	mlt_properties_close( pools );
+	pools = NULL;
 }
 
 void mlt_pool_stat( )
 {
 	// Stats dump
-	uint64_t allocated = 0, used = 0, s;
+	uint64_t allocated = 0, used = 0, s, hits = 0, misses = 0;
 	int i = 0, c = mlt_properties_count( pools );
 
 	mlt_log( NULL, MLT_LOG_VERBOSE, "%s: count %d\n", __FUNCTION__, c);
@@ -430,14 +1195,18 @@ void mlt_pool_stat( )
 		mlt_pool pool = mlt_properties_get_data_at( pools, i, NULL );
 		if ( pool->count )
 			mlt_log_verbose( NULL, "%s: size %d allocated %d returned %d %c\n", __FUNCTION__,
-				pool->size, pool->count, mlt_deque_count( pool->stack ),
-				pool->count !=  mlt_deque_count( pool->stack ) ? '*' : ' ' );
+				pool->size, pool->count, pool_idle( pool ),
+				pool->count != pool_idle( pool ) ? '*' : ' ' );
 		s = pool->size; s *= pool->count; allocated += s;
-		s = pool->count - mlt_deque_count( pool->stack ); s *= pool->size; used += s;
+		s = pool->count - pool_idle( pool ); s *= pool->size; used += s;
+		hits += pool->cache_hits;
+		misses += pool->cache_misses;
 	}
 
-	mlt_log_verbose( NULL, "%s: allocated %"PRIu64" bytes, used %"PRIu64" bytes \n",
-		__FUNCTION__, allocated, used );
+	mlt_log_verbose( NULL, "%s: allocated %"PRIu64" bytes, used %"PRIu64" bytes, high-water %"PRId64" bytes, budget %"PRId64" bytes\n",
+		__FUNCTION__, allocated, used, mlt_pool_high_water(), mlt_pool_get_budget() );
+	mlt_log_verbose( NULL, "%s: thread cache hits %"PRIu64" misses %"PRIu64" hit rate %.1f%%\n",
+		__FUNCTION__, hits, misses, hits + misses ? 100.0 * hits / ( hits + misses ) : 0.0 );
 }
 
 #endif // NO_MLT_POOL
@@ -23,6 +23,10 @@
 #ifndef MLT_POOL_H
 #define MLT_POOL_H
 
+#include <stdint.h>
+
+struct mlt_properties_s;
+
 extern void mlt_pool_init( );
 extern void *mlt_pool_alloc( int size );
 extern void *mlt_pool_realloc( void *ptr, int size );
@@ -30,5 +34,10 @@ extern void mlt_pool_release( void *release );
 extern void mlt_pool_purge( );
 extern void mlt_pool_close( );
 extern void mlt_pool_stat( );
+extern void mlt_pool_set_budget( int64_t bytes );
+extern int64_t mlt_pool_get_budget( );
+extern int64_t mlt_pool_high_water( );
+extern int64_t mlt_pool_allocated_bytes( );
+extern struct mlt_properties_s *mlt_pool_get_stats( );
 
 #endif
@@ -24,6 +24,9 @@
 #include "mlt_factory.h"
 #include "mlt_frame.h"
 #include "mlt_parser.h"
+#include "mlt_playlist.h"
+#include "mlt_multitrack.h"
+#include "mlt_tractor.h"
 #include "mlt_profile.h"
 #include "mlt_log.h"
 
@@ -34,12 +37,46 @@
 #include <sys/stat.h>  // for stat()
 #include <time.h>      // for strftime() and gtime()
 #include <unistd.h>    // for stat()
+#include <pthread.h>
+
+// Interned names of properties read on every frame
+static pthread_once_t atoms_once = PTHREAD_ONCE_INIT;
+static mlt_property_atom atom_eof = NULL;
+static mlt_property_atom atom_use_clone = NULL;
+static mlt_property_atom atom_test_image = NULL;
+static mlt_property_atom atom_test_audio = NULL;
+static mlt_property_atom atom_speed = NULL;
+static mlt_property_atom atom_producer = NULL;
+static mlt_property_atom atom_clone = NULL;
+static mlt_property_atom atom_position = NULL;
+static mlt_property_atom atom_clone_pool = NULL;
+static mlt_property_atom atom_clone_range = NULL;
+
+// Protects the frame metadata of all producers
+static pthread_mutex_t frame_meta_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void atoms_init( void )
+{
+	atom_eof = mlt_atom( "eof" );
+	atom_use_clone = mlt_atom( "use_clone" );
+	atom_test_image = mlt_atom( "test_image" );
+	atom_test_audio = mlt_atom( "test_audio" );
+	atom_speed = mlt_atom( "_speed" );
+	atom_producer = mlt_atom( "_producer" );
+	atom_clone = mlt_atom( "_clone" );
+	atom_position = mlt_atom( "_position" );
+	atom_clone_pool = mlt_atom( "clone_pool" );
+	atom_clone_range = mlt_atom( "clone_range" );
+}
+
 
 /* Forward references. */
 
 static int producer_get_frame( mlt_service self, mlt_frame_ptr frame, int index );
 static void mlt_producer_property_changed(mlt_service owner, mlt_producer self, mlt_event_data );
+static void frame_meta_changed( mlt_properties owner, void *unused, mlt_event_data );
 static void mlt_producer_service_changed( mlt_service owner, mlt_producer self );
+static mlt_producer mlt_producer_clone( mlt_producer self );
 
 /* for debugging */
 //#define _MLT_PRODUCER_CHECKS_ 1
@@ -71,6 +108,8 @@ int mlt_producer_init( mlt_producer self, void *child )
 		// Initialise the producer
 		memset( self, 0, sizeof( struct mlt_producer_s ) );
 
+		pthread_once( &atoms_once, atoms_init );
+
 		// Associate with the child
 		self->child = child;
 
@@ -108,6 +147,7 @@ int mlt_producer_init( mlt_producer self, void *child )
 
 			mlt_events_listen( properties, self, "service-changed", ( mlt_listener )mlt_producer_service_changed );
 			mlt_events_listen( properties, self, "property-changed", ( mlt_listener )mlt_producer_property_changed );
+			mlt_events_listen( properties, &frame_meta_mutex, "property-changed", ( mlt_listener )frame_meta_changed );
 			mlt_events_register( properties, "producer-changed" );
 		}
 	}
@@ -133,6 +173,73 @@ static void mlt_producer_property_changed( mlt_service owner, mlt_producer self,
 		mlt_events_fire( MLT_PRODUCER_PROPERTIES( mlt_producer_cut_parent( self ) ), "producer-changed", mlt_event_data_none() );
 }
 
+/** Listener for property changes that drops the frame metadata.
+ *
+ * It is listened to with its own data so that blocking the events of a
+ * producer does not keep stale metadata.
+ *
+ * \private \memberof mlt_producer_s
+ * \param owner the properties of the producer
+ * \param unused the listener data
+ * \param event_data the name of the property that changed
+ */
+
+static void frame_meta_changed( mlt_properties owner, void *unused, mlt_event_data event_data )
+{
+	const char *name = mlt_event_data_to_string( event_data );
+	if ( name && ( !strncmp( name, "meta.", 5 ) || !strncmp( name, "set.", 4 ) ) )
+	{
+		pthread_mutex_lock( &frame_meta_mutex );
+		if ( mlt_properties_get_data( owner, "_frame_meta", NULL ) )
+		{
+			mlt_properties_set_data( owner, "_frame_meta", NULL, 0, NULL, NULL );
+			mlt_properties_set_data( owner, "_frame_set", NULL, 0, NULL, NULL );
+		}
+		pthread_mutex_unlock( &frame_meta_mutex );
+	}
+}
+
+/** Get the properties that a producer gives each of its frames.
+ *
+ * These are the "meta." properties, which frames look up through their
+ * parent, and the "set." properties, which are set on each frame without the
+ * prefix. Both are made once and kept until one of them changes. The caller
+ * must close both.
+ *
+ * \private \memberof mlt_producer_s
+ * \param properties the properties of a producer
+ * \param meta the "meta." properties by reference
+ * \param set the "set." properties by reference
+ */
+
+static void get_frame_meta( mlt_properties properties, mlt_properties *meta, mlt_properties *set )
+{
+	pthread_mutex_lock( &frame_meta_mutex );
+	*meta = mlt_properties_get_data( properties, "_frame_meta", NULL );
+	*set = mlt_properties_get_data( properties, "_frame_set", NULL );
+	if ( *meta == NULL || *set == NULL )
+	{
+		*meta = mlt_properties_new( );
+		*set = mlt_properties_new( );
+		mlt_properties_lock( properties );
+		int i, count = mlt_properties_count( properties );
+		for ( i = 0; i < count; i ++ )
+		{
+			char *name = mlt_properties_get_name( properties, i );
+			if ( !strncmp( name, "meta.", 5 ) )
+				mlt_properties_set( *meta, name, mlt_properties_get_value( properties, i ) );
+			else if ( !strncmp( name, "set.", 4 ) )
+				mlt_properties_set( *set, name + 4, mlt_properties_get_value( properties, i ) );
+		}
+		mlt_properties_unlock( properties );
+		mlt_properties_set_data( properties, "_frame_meta", *meta, 0, ( mlt_destructor )mlt_properties_close, NULL );
+		mlt_properties_set_data( properties, "_frame_set", *set, 0, ( mlt_destructor )mlt_properties_close, NULL );
+	}
+	mlt_properties_inc_ref( *meta );
+	mlt_properties_inc_ref( *set );
+	pthread_mutex_unlock( &frame_meta_mutex );
+}
+
 /** Listener for service changes.
  *
  * Fires the "producer-changed" event.
@@ -430,7 +537,7 @@ int mlt_producer_set_speed( mlt_producer self, double speed )
 
 double mlt_producer_get_speed( mlt_producer self )
 {
-	return mlt_properties_get_double( MLT_PRODUCER_PROPERTIES( self ), "_speed" );
+	return mlt_properties_get_double_atom( MLT_PRODUCER_PROPERTIES( self ), atom_speed );
 }
 
 /** Get the frames per second.
@@ -603,6 +710,60 @@ void mlt_producer_prepare_next( mlt_producer self )
 		mlt_producer_seek( self, mlt_producer_position( self ) + mlt_producer_get_speed( self ) );
 }
 
+/** Choose the clone of a producer that makes the frame at its position.
+ *
+ * When the clone_pool property is more than 1, each run of clone_range
+ * positions goes to one of that many decoders in turn, the first being the
+ * producer itself. This lets the worker threads of a consumer decode
+ * different ranges of one source at the same time, while each decoder
+ * still reads its own range in order. The clones are made when first used.
+ *
+ * \private \memberof mlt_producer_s
+ * \param self a producer that is not a cut
+ * \return the producer to get the frame from, seeked to the position of \p self
+ */
+
+static mlt_producer pool_clone( mlt_producer self )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self );
+	int pool = mlt_properties_get_int_atom( properties, atom_clone_pool );
+	mlt_producer clone = self;
+
+	if ( pool > 1 )
+	{
+		int range = mlt_properties_get_int_atom( properties, atom_clone_range );
+		mlt_position position = mlt_producer_frame( self );
+		int index;
+
+		range = range > 0 ? range : 100;
+		index = ( position < 0 ? 0 : position / range ) % pool;
+		if ( index > 0 )
+		{
+			char key[ 25 ];
+			sprintf( key, "_clone_pool.%d", index - 1 );
+			clone = mlt_properties_get_data( properties, key, NULL );
+			if ( clone == NULL )
+			{
+				// Do not let the clone make a pool of its own
+				clone = mlt_producer_clone( self );
+				if ( clone != NULL )
+				{
+					mlt_properties_clear( MLT_PRODUCER_PROPERTIES( clone ), "clone_pool" );
+					mlt_properties_set_data( properties, key, clone, 0, ( mlt_destructor )mlt_producer_close, NULL );
+				}
+				else
+				{
+					mlt_log_warning( MLT_PRODUCER_SERVICE( self ), "failed to clone for the pool, decoding with one\n" );
+					mlt_properties_set_int_atom( properties, atom_clone_pool, 1 );
+					return self;
+				}
+			}
+			mlt_producer_seek( clone, mlt_producer_position( self ) );
+		}
+	}
+	return clone;
+}
+
 /** Get a frame.
  *
  * This is the implementation of the \p get_frame virtual function.
@@ -630,17 +791,25 @@ static int producer_get_frame( mlt_service service, mlt_frame_ptr frame, int ind
 		mlt_properties properties = MLT_PRODUCER_PROPERTIES( self );
 
 		// Determine eof handling
-		char *eof = mlt_properties_get( MLT_PRODUCER_PROPERTIES( self ), "eof" );
+		char *eof = mlt_properties_get_atom( MLT_PRODUCER_PROPERTIES( self ), atom_eof );
 
 		// Get the speed of the producer
 		double speed = mlt_producer_get_speed( self );
 
 		// We need to use the clone if it's specified
-		mlt_producer clone = mlt_properties_get_data( properties, "use_clone", NULL );
+		mlt_producer clone = mlt_properties_get_data_atom( properties, atom_use_clone, NULL );
 
 		// If no clone is specified, use self
 		clone = clone == NULL ? self : clone;
 
+		// Spread ranges of positions over a pool of clones
+		int pooled = 0;
+		if ( clone == self && self->get_frame != NULL )
+		{
+			clone = pool_clone( self );
+			pooled = clone != self;
+		}
+
 		// A properly instatiated producer will have a get_frame method...
 		if ( self->get_frame == NULL || ( eof && !strcmp( eof, "continue" ) && mlt_producer_position( self ) > mlt_producer_get_out( self ) ) )
 		{
@@ -651,8 +820,8 @@ static int producer_get_frame( mlt_service service, mlt_frame_ptr frame, int ind
 			result = mlt_frame_set_position( *frame, mlt_producer_position( self ) );
 
 			// Mark as a test card
-			mlt_properties_set_int( MLT_FRAME_PROPERTIES( *frame ), "test_image", 1 );
-			mlt_properties_set_int( MLT_FRAME_PROPERTIES( *frame ), "test_audio", 1 );
+			mlt_properties_set_int_atom( MLT_FRAME_PROPERTIES( *frame ), atom_test_image, 1 );
+			mlt_properties_set_int_atom( MLT_FRAME_PROPERTIES( *frame ), atom_test_audio, 1 );
 
 			// Calculate the next position
 			mlt_producer_prepare_next( self );
@@ -661,15 +830,19 @@ static int producer_get_frame( mlt_service service, mlt_frame_ptr frame, int ind
 		{
 			// Get the frame from the implementation
 			result = self->get_frame( clone, frame, index );
+
+			// A clone from the pool only moved its own play head
+			if ( pooled )
+				mlt_producer_prepare_next( self );
 		}
 
 		// Copy the fps and speed of the producer onto the frame
 		properties = MLT_FRAME_PROPERTIES( *frame );
-		mlt_properties_set_double( properties, "_speed", speed );
-		mlt_properties_set_int( properties, "test_audio", mlt_frame_is_test_audio( *frame ) );
-		mlt_properties_set_int( properties, "test_image", mlt_frame_is_test_card( *frame ) );
-		if ( mlt_properties_get_data( properties, "_producer", NULL ) == NULL )
-			mlt_properties_set_data( properties, "_producer", service, 0, NULL, NULL );
+		mlt_properties_set_double_atom( properties, atom_speed, speed );
+		mlt_properties_set_int_atom( properties, atom_test_audio, mlt_frame_is_test_audio( *frame ) );
+		mlt_properties_set_int_atom( properties, atom_test_image, mlt_frame_is_test_card( *frame ) );
+		if ( mlt_properties_get_data_atom( properties, atom_producer, NULL ) == NULL )
+			mlt_properties_set_data_atom( properties, atom_producer, service, 0, NULL, NULL );
 	}
 	else if ( self != NULL )
 	{
@@ -686,7 +859,7 @@ static int producer_get_frame( mlt_service service, mlt_frame_ptr frame, int ind
 		mlt_properties properties = MLT_PRODUCER_PROPERTIES( self );
 
 		// Determine the clone index
-		int clone_index = mlt_properties_get_int( properties, "_clone" );
+		int clone_index = mlt_properties_get_int_atom( properties, atom_clone );
 
 		// Determine the clone to use
 		mlt_producer clone = self;
@@ -705,22 +878,22 @@ static int producer_get_frame( mlt_service service, mlt_frame_ptr frame, int ind
 		}
 
 		// We need to seek to the correct position in the clone
-		mlt_producer_seek( clone, mlt_producer_get_in( self ) + mlt_properties_get_int( properties, "_position" ) );
+		mlt_producer_seek( clone, mlt_producer_get_in( self ) + mlt_properties_get_int_atom( properties, atom_position ) );
 
 		// Assign the clone property to the parent
-		mlt_properties_set_data( parent_properties, "use_clone", clone, 0, NULL, NULL );
+		mlt_properties_set_data_atom( parent_properties, atom_use_clone, clone, 0, NULL, NULL );
 
 		// Now get the frame from the parents service
 		result = mlt_service_get_frame( MLT_PRODUCER_SERVICE( parent ), frame, index );
 
 		// We're done with the clone now
-		mlt_properties_set_data( parent_properties, "use_clone", NULL, 0, NULL, NULL );
+		mlt_properties_set_data_atom( parent_properties, atom_use_clone, NULL, 0, NULL, NULL );
 
 		// This is useful and required by always_active transitions to determine in/out points of the cut
-		if ( mlt_properties_get_data( MLT_FRAME_PROPERTIES( *frame ), "_producer", NULL ) == MLT_PRODUCER_SERVICE( parent ) )
-			mlt_properties_set_data( MLT_FRAME_PROPERTIES( *frame ), "_producer", self, 0, NULL, NULL );
+		if ( mlt_properties_get_data_atom( MLT_FRAME_PROPERTIES( *frame ), atom_producer, NULL ) == MLT_PRODUCER_SERVICE( parent ) )
+			mlt_properties_set_data_atom( MLT_FRAME_PROPERTIES( *frame ), atom_producer, self, 0, NULL, NULL );
 
-		mlt_properties_set_double( MLT_FRAME_PROPERTIES( *frame ), "_speed", speed );
+		mlt_properties_set_double_atom( MLT_FRAME_PROPERTIES( *frame ), atom_speed, speed );
 		mlt_producer_prepare_next( self );
 	}
 	else
@@ -733,19 +906,38 @@ static int producer_get_frame( mlt_service service, mlt_frame_ptr frame, int ind
 	if ( *frame != NULL && self != NULL )
 	{
 		int i = 0;
-		mlt_properties p_props = MLT_PRODUCER_PROPERTIES( self );
 		mlt_properties f_props = MLT_FRAME_PROPERTIES( *frame );
-		mlt_properties_lock( p_props );
-		int count = mlt_properties_count( p_props );
-		for ( i = 0; i < count; i ++ )
+		mlt_properties meta, set;
+		get_frame_meta( MLT_PRODUCER_PROPERTIES( self ), &meta, &set );
+		int count = mlt_properties_count( meta );
+		if ( count > 0 && !mlt_properties_get_parent( f_props ) )
 		{
-			char *name = mlt_properties_get_name( p_props, i );
-			if ( !strncmp( name, "meta.", 5 ) )
-				mlt_properties_set( f_props, name, mlt_properties_get_value( p_props, i ) );
-			else if ( !strncmp( name, "set.", 4 ) )
-				mlt_properties_set( f_props, name + 4, mlt_properties_get_value( p_props, i ) );
+			// The frame looks them up in the producer's, whose values replace its own
+			for ( i = 0; i < mlt_properties_count( f_props ); i ++ )
+			{
+				char *name = mlt_properties_get_name( f_props, i );
+				if ( !strncmp( name, "meta.", 5 ) && mlt_properties_exists( meta, name ) )
+					mlt_properties_set( f_props, name, mlt_properties_get( meta, name ) );
+			}
+			mlt_properties_set_parent( f_props, meta );
 		}
-		mlt_properties_unlock( p_props );
+		else
+		{
+			// A frame that already has a parent, such as that of a cut's producer, gets copies
+			for ( i = 0; i < count; i ++ )
+			{
+				char *name = mlt_properties_get_name( meta, i );
+				char *value = mlt_properties_get_value( meta, i );
+				char *current = mlt_properties_get( f_props, name );
+				if ( !current || !value || strcmp( current, value ) )
+					mlt_properties_set( f_props, name, value );
+			}
+		}
+		count = mlt_properties_count( set );
+		for ( i = 0; i < count; i ++ )
+			mlt_properties_set( f_props, mlt_properties_get_name( set, i ), mlt_properties_get_value( set, i ) );
+		mlt_properties_close( meta );
+		mlt_properties_close( set );
 	}
 
 	return result;
@@ -1073,6 +1265,488 @@ int mlt_producer_optimise( mlt_producer self )
 	return error;
 }
 
+/** The properties that every cut has, which are not worth keeping a cut for */
+
+static const char *cut_properties[] = { "mlt_type", "in", "out", "length", "eof", "resource", "aspect_ratio", NULL };
+
+/** Determine if a property of a cut is one that every cut has or is private.
+ *
+ * \private \memberof mlt_producer_s
+ * \param name the name of a property
+ * \return true if the property can be dropped with the cut
+ */
+
+static int is_cut_property( const char *name )
+{
+	int i;
+	if ( name[0] == '_' )
+		return 1;
+	for ( i = 0; cut_properties[ i ]; i ++ )
+		if ( !strcmp( name, cut_properties[ i ] ) )
+			return 1;
+	return 0;
+}
+
+/** Determine if a cut has no filters and no properties of its own.
+ *
+ * \private \memberof mlt_producer_s
+ * \param cut a cut
+ * \return true if the cut only selects frames of its parent
+ */
+
+static int is_plain_cut( mlt_producer cut )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( cut );
+	int i;
+	if ( mlt_service_filter_count( MLT_PRODUCER_SERVICE( cut ) ) > 0 )
+		return 0;
+	for ( i = 0; i < mlt_properties_count( properties ); i ++ )
+		if ( !is_cut_property( mlt_properties_get_name( properties, i ) ) )
+			return 0;
+	return 1;
+}
+
+/** Determine if the filters of a container can be dropped when it is bypassed.
+ *
+ * A disabled filter does nothing, and a normaliser that the loader attached
+ * repeats one that the producer inside of it has already.
+ *
+ * \private \memberof mlt_producer_s
+ * \param container a playlist or tractor
+ * \param inner the producer that plays instead of it
+ * \return true if none of the filters of \p container change the frames of \p inner
+ */
+
+static int filters_are_redundant( mlt_producer container, mlt_producer inner )
+{
+	mlt_service service = MLT_PRODUCER_SERVICE( container );
+	int i, j;
+	for ( i = 0; i < mlt_service_filter_count( service ); i ++ )
+	{
+		mlt_properties filter = MLT_FILTER_PROPERTIES( mlt_service_filter( service, i ) );
+		const char *id = mlt_properties_get( filter, "mlt_service" );
+		int found = mlt_properties_get_int( filter, "disable" );
+		if ( !found && id && mlt_properties_get_int( filter, "_loader" ) )
+		{
+			for ( j = 0; !found && j < mlt_service_filter_count( MLT_PRODUCER_SERVICE( inner ) ); j ++ )
+			{
+				mlt_properties other = MLT_FILTER_PROPERTIES( mlt_service_filter( MLT_PRODUCER_SERVICE( inner ), j ) );
+				found = mlt_properties_get_int( other, "_loader" ) && !mlt_properties_get_int( other, "disable" )
+					&& !strcmp( id, mlt_properties_get( other, "mlt_service" ) ? mlt_properties_get( other, "mlt_service" ) : "" );
+			}
+		}
+		if ( !found )
+			return 0;
+	}
+	return 1;
+}
+
+/** Replace a range of a container by the same range of the producer it holds.
+ *
+ * Only a playlist with a single entry and a tractor with a single visible
+ * track and nothing planted on it are bypassed.
+ *
+ * \private \memberof mlt_producer_s
+ * \param[in,out] producer the parent of a cut
+ * \param[in,out] in the first frame of the cut
+ * \param[in,out] out the last frame of the cut
+ * \return true if the range was moved to the producer inside of \p producer
+ */
+
+static int flatten_cut( mlt_producer *producer, mlt_position *in, mlt_position *out )
+{
+	mlt_producer container = *producer;
+	mlt_producer inner = NULL;
+	mlt_position offset = 0, limit = -1;
+
+	if ( mlt_producer_get_in( container ) != 0 )
+		return 0;
+	switch ( mlt_service_identify( MLT_PRODUCER_SERVICE( container ) ) )
+	{
+		case mlt_service_playlist_type:
+		{
+			mlt_playlist playlist = ( mlt_playlist )container;
+			mlt_playlist_clip_info info;
+			if ( mlt_playlist_count( playlist ) == 1 && !mlt_playlist_get_clip_info( playlist, &info, 0 )
+				&& info.repeat == 1 && !mlt_producer_is_blank( info.cut ) && is_plain_cut( info.cut ) )
+			{
+				inner = info.producer;
+				offset = info.frame_in;
+				limit = info.frame_out;
+			}
+			break;
+		}
+		case mlt_service_tractor_type:
+		{
+			mlt_tractor tractor = ( mlt_tractor )container;
+			mlt_multitrack multitrack = mlt_tractor_multitrack( tractor );
+			mlt_producer track = mlt_multitrack_count( multitrack ) == 1 ? mlt_multitrack_track( multitrack, 0 ) : NULL;
+			if ( track && mlt_service_producer( MLT_TRACTOR_SERVICE( tractor ) ) == MLT_MULTITRACK_SERVICE( multitrack )
+				&& !mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( track ), "hide" ) )
+			{
+				if ( !mlt_producer_is_cut( track ) )
+				{
+					inner = mlt_producer_get_in( track ) == 0 ? track : NULL;
+					limit = mlt_producer_get_out( track );
+				}
+				else if ( is_plain_cut( track ) )
+				{
+					inner = mlt_producer_cut_parent( track );
+					offset = mlt_producer_get_in( track );
+					limit = mlt_producer_get_out( track );
+				}
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	if ( !inner || *out + offset > limit || !filters_are_redundant( container, inner ) )
+		return 0;
+	*producer = inner;
+	*in += offset;
+	*out += offset;
+	return 1;
+}
+
+/** Determine if an entry of a playlist and the next one play on from each other.
+ *
+ * \private \memberof mlt_producer_s
+ * \param a the clip info of an entry
+ * \param b the clip info of the next entry
+ * \return true if one cut covering both entries plays the same frames
+ */
+
+static int cuts_continue( mlt_playlist_clip_info *a, mlt_playlist_clip_info *b )
+{
+	mlt_properties first = MLT_PRODUCER_PROPERTIES( a->cut );
+	mlt_properties second = MLT_PRODUCER_PROPERTIES( b->cut );
+	int i;
+
+	if ( a->producer != b->producer || a->repeat != 1 || b->repeat != 1 || a->frame_out + 1 != b->frame_in
+		|| mlt_producer_is_blank( a->cut ) || mlt_service_filter_count( MLT_PRODUCER_SERVICE( a->cut ) ) > 0
+		|| mlt_service_filter_count( MLT_PRODUCER_SERVICE( b->cut ) ) > 0 )
+		return 0;
+
+	// Both cuts must have the same properties of their own
+	for ( i = 0; i < mlt_properties_count( first ); i ++ )
+	{
+		const char *name = mlt_properties_get_name( first, i );
+		const char *value = mlt_properties_get_value( first, i );
+		const char *other = mlt_properties_get( second, name );
+		if ( !is_cut_property( name ) && ( !value || !other || strcmp( value, other ) ) )
+			return 0;
+	}
+	for ( i = 0; i < mlt_properties_count( second ); i ++ )
+	{
+		const char *name = mlt_properties_get_name( second, i );
+		if ( !is_cut_property( name ) && !mlt_properties_get( first, name ) )
+			return 0;
+	}
+	return 1;
+}
+
+static int on_end_playlist_simplify( mlt_parser self, mlt_playlist playlist )
+{
+	mlt_properties properties = mlt_parser_properties( self );
+	int i;
+
+	for ( i = mlt_playlist_count( playlist ) - 1; i >= 0; i -- )
+	{
+		mlt_playlist_clip_info info, next;
+		if ( mlt_playlist_get_clip_info( playlist, &info, i ) || info.repeat != 1
+			|| mlt_producer_is_blank( info.cut ) || !is_plain_cut( info.cut ) )
+			continue;
+
+		mlt_producer producer = info.producer;
+		mlt_position in = info.frame_in;
+		mlt_position out = info.frame_out;
+		int depth = 0;
+		while ( flatten_cut( &producer, &in, &out ) )
+			depth ++;
+		if ( depth && !mlt_playlist_insert( playlist, producer, i, in, out ) )
+		{
+			mlt_playlist_remove( playlist, i + 1 );
+			mlt_properties_set_int( properties, "flattened", mlt_properties_get_int( properties, "flattened" ) + depth );
+			mlt_playlist_get_clip_info( playlist, &info, i );
+		}
+
+		// The next entry has been simplified already
+		if ( !mlt_playlist_get_clip_info( playlist, &next, i + 1 ) && cuts_continue( &info, &next )
+			&& !mlt_playlist_resize_clip( playlist, i, info.frame_in, next.frame_out ) )
+		{
+			mlt_playlist_remove( playlist, i + 1 );
+			mlt_properties_set_int( properties, "merged", mlt_properties_get_int( properties, "merged" ) + 1 );
+		}
+	}
+	return 0;
+}
+
+/** Simplify the playlists and tractors under a producer for rendering.
+ *
+ * Editors generate deeply nested documents, and every level costs a get_frame
+ * and often a get_image call for each frame. This bypasses a playlist with a
+ * single entry and a tractor with a single track and nothing planted on it
+ * wherever a playlist entry refers to them, so that the entry plays the same
+ * frames from the producer inside of them instead, and it merges the entries
+ * of a playlist that play on from each other in the same producer into one.
+ * The filters of a bypassed container must be disabled or normalisers that
+ * the loader attached to it and to the producer inside of it alike, which
+ * leaves one set of normalisers on the path of each frame. Entries with filters, repeats or properties of their own are
+ * kept, as are the containers themselves, which stay as they are for other
+ * references to them.
+ *
+ * The playlists change, so this is meant for rendering an edit rather than
+ * for the documents that an application edits. Use it again after edits.
+ * A consumer calls it when it starts if its \p optimise property is set.
+ *
+ * \public \memberof mlt_producer_s
+ * \param self a producer
+ * \return true if there was an error
+ */
+
+int mlt_producer_simplify( mlt_producer self )
+{
+	mlt_parser parser = mlt_parser_new( );
+	if ( parser == NULL )
+		return 1;
+	parser->on_end_playlist = on_end_playlist_simplify;
+	mlt_parser_start( parser, MLT_PRODUCER_SERVICE( self ) );
+	mlt_log_verbose( MLT_PRODUCER_SERVICE( self ), "simplified: %d containers bypassed, %d entries merged\n",
+		mlt_properties_get_int( mlt_parser_properties( parser ), "flattened" ),
+		mlt_properties_get_int( mlt_parser_properties( parser ), "merged" ) );
+	mlt_parser_close( parser );
+	return 0;
+}
+
+/** The most frames of a source producer that a producer keeps */
+
+#define FRAME_CACHE_SIZE 32
+
+/** \brief private to mlt_producer_s, the frames of a source producer kept by mlt_producer_retain_frames() */
+
+typedef struct
+{
+	pthread_mutex_t mutex;      /**< protects all of the fields and the use of the source */
+	mlt_producer source;        /**< the producer the frames came from */
+	int wanted_count;
+	mlt_position wanted[ FRAME_CACHE_SIZE ]; /**< the positions to keep */
+	int count;
+	mlt_position positions[ FRAME_CACHE_SIZE ];
+	mlt_frame frames[ FRAME_CACHE_SIZE ];
+	mlt_image_format format;    /**< the format to prefetch images in or mlt_image_none */
+	int width;
+	int height;
+}
+frame_cache;
+
+static pthread_mutex_t frame_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static frame_cache *get_frame_cache( mlt_producer self )
+{
+	pthread_mutex_lock( &frame_cache_mutex );
+	if ( !self->local )
+	{
+		frame_cache *cache = calloc( 1, sizeof( frame_cache ) );
+		if ( cache )
+		{
+			cache->format = mlt_image_none;
+			pthread_mutex_init( &cache->mutex, NULL );
+		}
+		self->local = cache;
+	}
+	pthread_mutex_unlock( &frame_cache_mutex );
+	return self->local;
+}
+
+static void frame_cache_close( mlt_producer self )
+{
+	frame_cache *cache = self->local;
+	if ( cache )
+	{
+		while ( cache->count > 0 )
+			mlt_frame_close( cache->frames[ --cache->count ] );
+		pthread_mutex_destroy( &cache->mutex );
+		free( cache );
+		self->local = NULL;
+	}
+}
+
+static int frame_cache_find( frame_cache *cache, mlt_position position )
+{
+	int i;
+	for ( i = 0; i < cache->count; i++ )
+		if ( cache->positions[ i ] == position )
+			return i;
+	return -1;
+}
+
+static int frame_cache_wants( frame_cache *cache, mlt_position position )
+{
+	int i;
+	for ( i = 0; i < cache->wanted_count; i++ )
+		if ( cache->wanted[ i ] == position )
+			return 1;
+	return 0;
+}
+
+/** Forget the frames of another source; call with the cache locked. */
+
+static void frame_cache_set_source( frame_cache *cache, mlt_producer source )
+{
+	if ( cache->source != source )
+	{
+		while ( cache->count > 0 )
+			mlt_frame_close( cache->frames[ --cache->count ] );
+		cache->wanted_count = 0;
+		cache->source = source;
+	}
+}
+
+/** Get a frame from the source, keeping it if it is wanted; call with the cache locked if there is one. */
+
+static int frame_cache_fetch( frame_cache *cache, mlt_producer source, mlt_position position, int index, mlt_frame_ptr frame )
+{
+	mlt_producer_seek( source, position );
+	int error = mlt_service_get_frame( MLT_PRODUCER_SERVICE( source ), frame, index );
+	if ( !error && *frame && cache && cache->count < FRAME_CACHE_SIZE && frame_cache_wants( cache, position ) )
+	{
+		mlt_properties_inc_ref( MLT_FRAME_PROPERTIES( *frame ) );
+		cache->positions[ cache->count ] = position;
+		cache->frames[ cache->count++ ] = *frame;
+
+		// Nobody else has the frame yet, so it is safe to start rendering it
+		if ( cache->format != mlt_image_none )
+		{
+			mlt_properties_set_int( MLT_FRAME_PROPERTIES( *frame ), "_prefetch", 1 );
+			mlt_frame_prefetch_image( *frame, cache->format, cache->width, cache->height, 0 );
+		}
+	}
+	return error;
+}
+
+/** Get a frame of a source producer.
+ *
+ * A producer that reads the frames of another one, more than one for each of
+ * its own frames or the same ones again for the following frames, should get
+ * them with this. Frames at the positions given to mlt_producer_retain_frames()
+ * are shared instead of being fetched again, and their images may already be
+ * rendered. It is safe to call from the threads rendering the frames of \p self
+ * while another calls mlt_producer_retain_frames().
+ *
+ * \public \memberof mlt_producer_s
+ * \param self the producer that reads \p source
+ * \param source the producer to get frames from
+ * \param position the position of \p source
+ * \param index the track index
+ * \param[out] frame a frame by reference, which the caller must close
+ * \return true on error
+ */
+
+int mlt_producer_fetch_frame( mlt_producer self, mlt_producer source, mlt_position position, int index, mlt_frame_ptr frame )
+{
+	if ( !self || !source || !frame )
+		return 1;
+
+	frame_cache *cache = self->local;
+	if ( !cache )
+		return frame_cache_fetch( NULL, source, position, index, frame );
+
+	pthread_mutex_lock( &cache->mutex );
+	frame_cache_set_source( cache, source );
+	int error = 0;
+	int i = frame_cache_find( cache, position );
+	if ( i >= 0 )
+	{
+		*frame = cache->frames[ i ];
+		mlt_properties_inc_ref( MLT_FRAME_PROPERTIES( *frame ) );
+	}
+	else
+	{
+		error = frame_cache_fetch( cache, source, position, index, frame );
+	}
+	pthread_mutex_unlock( &cache->mutex );
+	return error;
+}
+
+/** Keep the frames of a source producer at some positions and fetch the missing ones ahead.
+ *
+ * Call this from the producer's get_frame with the positions it needs now and
+ * for the frames it expects to be asked for next. Frames at other positions are
+ * released. At most 32 positions are kept, the first ones given.
+ *
+ * \public \memberof mlt_producer_s
+ * \param self the producer that reads \p source
+ * \param source the producer to get frames from
+ * \param positions the positions of \p source to keep
+ * \param count the number of positions
+ * \param index the track index
+ */
+
+void mlt_producer_retain_frames( mlt_producer self, mlt_producer source, const mlt_position *positions, int count, int index )
+{
+	frame_cache *cache = self && source ? get_frame_cache( self ) : NULL;
+	if ( !cache )
+		return;
+
+	pthread_mutex_lock( &cache->mutex );
+	frame_cache_set_source( cache, source );
+	cache->wanted_count = MIN( MAX( count, 0 ), FRAME_CACHE_SIZE );
+	memcpy( cache->wanted, positions, cache->wanted_count * sizeof( mlt_position ) );
+
+	// Release the frames that are no longer wanted
+	int i, kept = 0;
+	for ( i = 0; i < cache->count; i++ )
+	{
+		if ( frame_cache_wants( cache, cache->positions[ i ] ) )
+		{
+			cache->positions[ kept ] = cache->positions[ i ];
+			cache->frames[ kept++ ] = cache->frames[ i ];
+		}
+		else
+		{
+			mlt_frame_close( cache->frames[ i ] );
+		}
+	}
+	cache->count = kept;
+
+	// Fetch the rest
+	for ( i = 0; i < cache->wanted_count; i++ )
+	{
+		mlt_frame frame = NULL;
+		if ( frame_cache_find( cache, cache->wanted[ i ] ) < 0
+			&& !frame_cache_fetch( cache, source, cache->wanted[ i ], index, &frame ) )
+			mlt_frame_close( frame );
+	}
+	pthread_mutex_unlock( &cache->mutex );
+}
+
+/** Render the images of the frames fetched from a source producer from now on.
+ *
+ * A producer calls this from its get_image with the request it makes of the
+ * source's images, so that the frames fetched ahead by mlt_producer_retain_frames()
+ * are rendered on the slices pool by the time they are needed. Only a request
+ * that stays the same gets any benefit. Pass mlt_image_none to stop.
+ *
+ * \public \memberof mlt_producer_s
+ * \param self the producer that reads the source
+ * \param format the image format
+ * \param width the horizontal size in pixels
+ * \param height the vertical size in pixels
+ */
+
+void mlt_producer_prefetch_images( mlt_producer self, mlt_image_format format, int width, int height )
+{
+	frame_cache *cache = self ? get_frame_cache( self ) : NULL;
+	if ( !cache )
+		return;
+	pthread_mutex_lock( &cache->mutex );
+	cache->format = format;
+	cache->width = width;
+	cache->height = height;
+	pthread_mutex_unlock( &cache->mutex );
+}
+
 /** Close the producer.
  *
  * Destroys the producer and deallocates its resources managed by its
@@ -1108,6 +1782,7 @@ void mlt_producer_close( mlt_producer self )
 			mlt_log( MLT_PRODUCER_SERVICE( self ), MLT_LOG_DEBUG, "Producers created %d, destroyed %d\n", producers_created, ++producers_destroyed );
 #endif
 
+			frame_cache_close( self );
 			mlt_service_close( &self->parent );
 
 			if ( destroy )
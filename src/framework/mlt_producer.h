@@ -53,6 +53,11 @@
  * \properties \em _clone is the index of the clone in the list of clones stored on the clone's producer
  * \properties \em _clones is the number of clones of the producer, as created by mlt_producer_optimise
  * \properties \em _clone.{N} holds a reference to the N'th clone of the producer, as created by mlt_producer_optimise
+ * \properties \em clone_pool the number of decoders to spread ranges of positions over,
+ *   including this producer, so the workers of a consumer can decode them at the same time, defaults to 1 (off)
+ * \properties \em clone_range the number of positions each decoder of the clone pool takes in turn,
+ *   best at least the keyframe interval of the source, defaults to 100
+ * \properties \em _clone_pool.{N} holds a reference to the N'th clone of the clone pool
  * \properties \em meta.* holds metadata - there is a loose taxonomy to be defined
  * \properties \em set.* holds properties to set on a frame produced
  * \envvar \em MLT_DEFAULT_PRODUCER_LENGTH - the default duration of the producer in frames, defaults to 15000.
@@ -102,7 +107,7 @@ struct mlt_producer_s
 	mlt_destructor close;
 	void *close_object; /**< the object supplied to the close virtual function */
 
-	void *local; /**< \private instance object */
+	void *local; /**< \private the frames kept by mlt_producer_retain_frames() */
 	void *child; /**< \private the object of a subclass */
 };
 
@@ -142,6 +147,10 @@ extern int mlt_producer_is_mix( mlt_producer self );
 extern int mlt_producer_is_blank( mlt_producer self );
 extern mlt_producer mlt_producer_cut_parent( mlt_producer self );
 extern int mlt_producer_optimise( mlt_producer self );
+extern int mlt_producer_simplify( mlt_producer self );
+extern int mlt_producer_fetch_frame( mlt_producer self, mlt_producer source, mlt_position position, int index, mlt_frame_ptr frame );
+extern void mlt_producer_retain_frames( mlt_producer self, mlt_producer source, const mlt_position *positions, int count, int index );
+extern void mlt_producer_prefetch_images( mlt_producer self, mlt_image_format format, int width, int height );
 extern void mlt_producer_close( mlt_producer self );
 int64_t mlt_producer_get_creation_time( mlt_producer self );
 void mlt_producer_set_creation_time( mlt_producer self, int64_t creation_time );
@@ -37,6 +37,7 @@
 #include <ctype.h>
 #include <stdarg.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <sys/stat.h>
@@ -46,22 +47,98 @@
 
 #define MAX_LOAD_LINE_SIZE 4096
 
+/** \brief a chunk of memory in a properties arena */
+
+typedef struct arena_chunk_s
+{
+	struct arena_chunk_s *next;
+	size_t used;
+	size_t size;
+}
+arena_chunk;
+
+#define ARENA_CHUNK_SIZE 8192
+#define ARENA_ALIGN 16
+
+/** \brief the changes one thread holds back with mlt_properties_begin_update() */
+
+typedef struct update_batch_s
+{
+	pthread_t thread;
+	int depth;
+	mlt_properties changed;   // the names changed during the update
+	struct update_batch_s *next;
+}
+update_batch;
+
 /** \brief private implementation of the property list */
 
 typedef struct
 {
-	int hash[ 199 ];
+	int *hash;
+	int hash_size;
 	char **name;
+	unsigned int *name_hash;
+	mlt_property_atom *atom;
 	mlt_property *value;
 	int count;
 	int size;
 	mlt_properties mirror;
 	int ref_count;
-	pthread_mutex_t mutex;
+	pthread_mutex_t mutex;    // protects ref_count
+	pthread_rwlock_t rwlock;  // protects the name/value arrays and hash table
 	locale_t locale;
+	arena_chunk *arena;       // optional storage for names and property objects
+	atomic_int updating;      // the number of threads in mlt_properties_begin_update()
+	update_batch *batches;    // the update of each of those threads, protected by mutex
+	_Atomic( mlt_property ) *slots; // direct pointers to well-known properties, only with an arena
+	mlt_properties parent;    // looked up for names that are not in this list, see mlt_properties_set_parent()
+	int *inherited;           // the indices of the properties of parent that this list does not hide
+	int inherited_count;
 }
 property_list;
 
+/** \brief an interned property name
+ *
+ * Atoms are created once per unique name by mlt_atom() and are never freed,
+ * so they compare by pointer and may be cached in static variables.
+ */
+
+struct mlt_property_atom_s
+{
+	char *name;
+	unsigned int hash;
+	int slot;
+	struct mlt_property_atom_s *next;
+};
+
+/** The well-known frame properties that get a fixed slot.
+ *
+ * These are read and written many times per frame by the framework, filters,
+ * and consumers. Properties lists that use an arena keep a direct pointer to
+ * each of them so that an atom lookup does not need to probe the hash table.
+ */
+
+static const char *slot_names[] =
+{
+	"width", "height", "format", "aspect_ratio", "progressive", "test_image", "test_audio",
+	"rendered", "_speed", "audio_frequency", "audio_channels", "audio_samples"
+};
+
+#define SLOT_COUNT ( int )( sizeof( slot_names ) / sizeof( slot_names[ 0 ] ) )
+
+#define ATOM_TABLE_SIZE 1024
+
+static mlt_property_atom atom_table[ ATOM_TABLE_SIZE ];
+static pthread_mutex_t atom_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t atoms_once = PTHREAD_ONCE_INIT;
+static mlt_property_atom atom_profile = NULL;
+
+static void atoms_init( void )
+{
+	atom_profile = mlt_atom( "_profile" );
+}
+
 /* Memory leak checks */
 
 //#define _MLT_PROPERTY_CHECKS_ 2
@@ -100,6 +177,9 @@ int mlt_properties_init( mlt_properties self, void *child )
 		// Increment the ref count
 		( ( property_list * )self->local )->ref_count = 1;
 		pthread_mutex_init( &( ( property_list * )self->local )->mutex, NULL );;
+		pthread_rwlock_init( &( ( property_list * )self->local )->rwlock, NULL );
+
+		pthread_once( &atoms_once, atoms_init );
 	}
 
 	// Check that initialisation was successful
@@ -211,6 +291,8 @@ static int load_properties( mlt_properties self, const char *filename )
 		char temp[ MAX_LOAD_LINE_SIZE ];
 		char last[ MAX_LOAD_LINE_SIZE ] = "";
 
+		mlt_properties_begin_update( self );
+
 		// Read each string from the file
 		while( fgets( temp, MAX_LOAD_LINE_SIZE, file ) )
 		{
@@ -237,6 +319,7 @@ static int load_properties( mlt_properties self, const char *filename )
 			if ( strcmp( temp, "" ) && temp[ 0 ] != '#' )
 				mlt_properties_parse( self, temp );
 		}
+		mlt_properties_end_update( self );
 
 		// Close the file
 		fclose( file );
@@ -329,15 +412,203 @@ int mlt_properties_preset( mlt_properties self, const char *name )
  *
  * \private \memberof mlt_properties_s
  * \param name a string
- * \return an integer
+ * \return the full (unreduced) hash value
  */
 
-static inline int generate_hash( const char *name )
+static inline unsigned int generate_hash( const char *name )
 {
 	unsigned int hash = 5381;
 	while ( *name )
 		hash = hash * 33 + (unsigned int) ( *name ++ );
-	return hash % 199;
+	return hash;
+}
+
+/** Allocate memory from the arena of a property list.
+ *
+ * The memory is only released when the properties list is closed.
+ * \private \memberof mlt_properties_s
+ * \param list the private property list
+ * \param size the number of bytes
+ * \return a pointer aligned to ARENA_ALIGN bytes
+ */
+
+static void *arena_alloc( property_list *list, size_t size )
+{
+	size_t header = ( sizeof( arena_chunk ) + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 );
+	arena_chunk *chunk = list->arena;
+
+	size = ( size + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 );
+	if ( chunk->used + size > chunk->size )
+	{
+		size_t chunk_size = header + size > ARENA_CHUNK_SIZE ? header + size : ARENA_CHUNK_SIZE;
+		chunk = malloc( chunk_size );
+		if ( !chunk )
+			return NULL;
+		chunk->next = list->arena;
+		chunk->used = header;
+		chunk->size = chunk_size;
+		list->arena = chunk;
+	}
+	void *result = ( char* ) chunk + chunk->used;
+	chunk->used += size;
+	return result;
+}
+
+/** Copy a string into the arena of a property list.
+ *
+ * \private \memberof mlt_properties_s
+ * \param list the private property list
+ * \param string the string to copy
+ * \return the copy
+ */
+
+static char *arena_strdup( property_list *list, const char *string )
+{
+	size_t length = strlen( string ) + 1;
+	char *result = arena_alloc( list, length );
+	if ( result )
+		memcpy( result, string, length );
+	return result;
+}
+
+/** Make a properties list allocate from a private arena.
+ *
+ * With an arena, property names and property objects come from a few large
+ * blocks that are released all at once by mlt_properties_close() instead of
+ * being allocated and freed one by one. This is intended for short-lived
+ * objects with many properties such as frames. It must be called before any
+ * property is set.
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \return true if error
+ */
+
+int mlt_properties_use_arena( mlt_properties self )
+{
+	if ( !self ) return 1;
+	property_list *list = self->local;
+	if ( list->arena ) return 0;
+	if ( list->count > 0 ) return 1;
+	list->arena = calloc( 1, ARENA_CHUNK_SIZE );
+	if ( !list->arena ) return 1;
+	list->arena->used = ( sizeof( arena_chunk ) + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 );
+	list->arena->size = ARENA_CHUNK_SIZE;
+	list->slots = arena_alloc( list, SLOT_COUNT * sizeof( *list->slots ) );
+	for ( int i = 0; i < SLOT_COUNT; i ++ )
+		atomic_init( &list->slots[ i ], NULL );
+	return 0;
+}
+
+/** Get the slot of a well-known property name.
+ *
+ * \private \memberof mlt_properties_s
+ * \param name a property name
+ * \return the index into slot_names or -1 if name does not have a slot
+ */
+
+static int slot_of_name( const char *name )
+{
+	for ( int i = 0; i < SLOT_COUNT; i ++ )
+		if ( !strcmp( slot_names[ i ], name ) )
+			return i;
+	return -1;
+}
+
+/** Determine if a property name must be freed individually.
+ *
+ * \private \memberof mlt_properties_s
+ * \param list the private property list
+ * \param index the index of the property
+ * \return true if the name was allocated with strdup()
+ */
+
+static inline int name_is_owned( property_list *list, int index )
+{
+	return !list->arena && !( list->atom[ index ] && list->name[ index ] == list->atom[ index ]->name );
+}
+
+/** Intern a property name.
+ *
+ * The returned atom is valid for the lifetime of the process and is the same
+ * pointer for every call with an equal name. Use it with the *_atom variants of
+ * the property accessors to avoid hashing and comparing the name on every call.
+ * \public \memberof mlt_properties_s
+ * \param name a property name
+ * \return the atom for the name or NULL if name is NULL
+ */
+
+mlt_property_atom mlt_atom( const char *name )
+{
+	if ( !name ) return NULL;
+
+	unsigned int hash = generate_hash( name );
+	unsigned int bucket = hash % ATOM_TABLE_SIZE;
+	mlt_property_atom atom;
+
+	pthread_mutex_lock( &atom_mutex );
+	for ( atom = atom_table[ bucket ]; atom != NULL; atom = atom->next )
+		if ( atom->hash == hash && !strcmp( atom->name, name ) )
+			break;
+	if ( atom == NULL )
+	{
+		atom = malloc( sizeof( struct mlt_property_atom_s ) );
+		atom->name = strdup( name );
+		atom->hash = hash;
+		atom->slot = slot_of_name( name );
+		atom->next = atom_table[ bucket ];
+		atom_table[ bucket ] = atom;
+	}
+	pthread_mutex_unlock( &atom_mutex );
+
+	return atom;
+}
+
+/** Get the name of an atom.
+ *
+ * Do not free the returned string.
+ * \public \memberof mlt_properties_s
+ * \param atom an atom created by mlt_atom()
+ * \return the property name or NULL if atom is NULL
+ */
+
+const char *mlt_atom_name( mlt_property_atom atom )
+{
+	return atom ? atom->name : NULL;
+}
+
+/** Insert a property index into the open-addressing hash table.
+ *
+ * The table must have at least one free slot.
+ * \private \memberof mlt_properties_s
+ * \param list the private property list
+ * \param index the index of the property in the name/value arrays
+ */
+
+static inline void hash_insert( property_list *list, int index )
+{
+	unsigned int mask = list->hash_size - 1;
+	unsigned int slot = list->name_hash[ index ] & mask;
+	while ( list->hash[ slot ] != 0 )
+		slot = ( slot + 1 ) & mask;
+	list->hash[ slot ] = index + 1;
+}
+
+/** Rebuild the hash table with the given capacity.
+ *
+ * \private \memberof mlt_properties_s
+ * \param list the private property list
+ * \param size the new number of slots, must be a power of two
+ */
+
+static void hash_rebuild( property_list *list, int size )
+{
+	int i;
+	free( list->hash );
+	list->hash = calloc( size, sizeof( int ) );
+	list->hash_size = size;
+	for ( i = 0; i < list->count; i ++ )
+		if ( list->name[ i ] )
+			hash_insert( list, i );
 }
 
 /** Copy a serializable property to a properties list that is mirroring this one.
@@ -435,8 +706,49 @@ void mlt_properties_mirror( mlt_properties self, mlt_properties that )
 	list->mirror = that;
 }
 
+static void inherited_rebuild( mlt_properties self );
+
+/** Let a properties list look up the names it does not have in another.
+ *
+ * This shares values that many lists have in common, such as the metadata
+ * that a producer gives each of its frames, without copying them. Only the
+ * getters look in the parent: setting a value always sets it in \p self,
+ * where it hides the parent's value of the same name. The parent's properties
+ * that are not hidden are counted by mlt_properties_count() and follow those
+ * of \p self by index. The parent must not be changed while it is in use, so
+ * make a new one rather than modify it.
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param parent the properties to fall back to or NULL for none; a reference is held
+ */
+
+void mlt_properties_set_parent( mlt_properties self, mlt_properties parent )
+{
+	if ( !self || parent == self ) return;
+	property_list *list = self->local;
+	mlt_properties_inc_ref( parent );
+	mlt_properties_close( list->parent );
+	list->parent = parent;
+	inherited_rebuild( self );
+}
+
+/** Get the properties list that a properties list falls back to.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \return the parent or NULL if there is none
+ * \see mlt_properties_set_parent
+ */
+
+mlt_properties mlt_properties_get_parent( mlt_properties self )
+{
+	return self ? ( ( property_list* )self->local )->parent : NULL;
+}
+
 /** Copy all serializable properties to another properties list.
  *
+ * If \p that has a parent and \p self has none, \p self shares it instead of
+ * copying the values found through it.
  * \public \memberof mlt_properties_s
  * \param self The properties to copy to
  * \param that The properties to copy from
@@ -452,9 +764,18 @@ int mlt_properties_inherit( mlt_properties self, mlt_properties that )
 	if (value)
 		mlt_properties_set_string(self, "properties", value);
 
+	mlt_properties_begin_update( self );
+
+	// Share the parent rather than copy the values found through it
+	mlt_properties parent = mlt_properties_get_parent( that );
+	if ( parent && !mlt_properties_get_parent( self ) )
+		mlt_properties_set_parent( self, parent );
+
 	mlt_properties_lock( that );
 
 	int count = mlt_properties_count( that );
+	if ( parent && mlt_properties_get_parent( self ) == parent )
+		count = ( ( property_list* )that->local )->count;
 	int i = 0;
 	for ( i = 0; i < count; i ++ )
 	{
@@ -467,6 +788,7 @@ int mlt_properties_inherit( mlt_properties self, mlt_properties that )
 		}
 	}
 
+	mlt_properties_end_update( self );
 	mlt_properties_unlock( that );
 
 	return 0;
@@ -490,6 +812,7 @@ int mlt_properties_pass( mlt_properties self, mlt_properties that, const char *p
 	int count = mlt_properties_count( that );
 	int length = strlen( prefix );
 	int i = 0;
+	mlt_properties_begin_update( self );
 	for ( i = 0; i < count; i ++ )
 	{
 		char *name = mlt_properties_get_name( that, i );
@@ -500,56 +823,206 @@ int mlt_properties_pass( mlt_properties self, mlt_properties that, const char *p
 				mlt_properties_set_string( self, name + length, value );
 		}
 	}
+	mlt_properties_end_update( self );
 	return 0;
 }
 
-/** Locate a property by name.
+/** Locate a property by name and precomputed hash.
  *
+ * When an atom is supplied, entries that were added or previously found
+ * through an atom are matched by pointer only, and entries added by plain name
+ * are matched by string once and then remember the atom, which is stored under
+ * the write lock.
  * \private \memberof mlt_properties_s
  * \param self a properties list
  * \param name the property to lookup by name
+ * \param key the hash of the name
+ * \param atom the atom for name or NULL
  * \return the property or NULL for failure
  */
 
-static inline mlt_property mlt_properties_find( mlt_properties self, const char *name )
+static inline mlt_property mlt_properties_lookup( mlt_properties self, const char *name, unsigned int key, mlt_property_atom atom )
 {
-	if ( !self || !name ) return NULL;
 	property_list *list = self->local;
 	mlt_property value = NULL;
-	int key = generate_hash( name );
+	int remember = -1;
 
-	mlt_properties_lock( self );
+	pthread_rwlock_rdlock( &list->rwlock );
 
-	int i = list->hash[ key ] - 1;
-	if ( i >= 0 )
+	if ( list->hash_size > 0 )
 	{
-		// Check if we're hashed
-		if ( list->count > 0 && list->name[ i ] &&
-		 	!strcmp( list->name[ i ], name ) )
-			value = list->value[ i ];
+		unsigned int mask = list->hash_size - 1;
+		unsigned int slot = key & mask;
+		int i;
 
-		// Locate the item
-		for ( i = list->count - 1; value == NULL && i >= 0; i -- )
-			if ( list->name[ i ] && !strcmp( list->name[ i ], name ) )
-				value = list->value[ i ];
+		// Probe until we hit an empty slot
+		while ( ( i = list->hash[ slot ] - 1 ) >= 0 )
+		{
+			if ( list->name_hash[ i ] == key && list->name[ i ] )
+			{
+				if ( atom && list->atom[ i ] )
+				{
+					if ( list->atom[ i ] == atom )
+					{
+						value = list->value[ i ];
+						break;
+					}
+				}
+				else if ( !strcmp( list->name[ i ], name ) )
+				{
+					if ( atom )
+						remember = i;
+					value = list->value[ i ];
+					break;
+				}
+			}
+			slot = ( slot + 1 ) & mask;
+		}
 	}
-	mlt_properties_unlock( self );
+	pthread_rwlock_unlock( &list->rwlock );
+
+	// The entry may have been renamed since the read lock was released
+	if ( remember >= 0 && !pthread_rwlock_wrlock( &list->rwlock ) )
+	{
+		if ( remember < list->count && list->value[ remember ] == value && !list->atom[ remember ]
+			&& list->name[ remember ] && !strcmp( list->name[ remember ], name ) )
+			list->atom[ remember ] = atom;
+		pthread_rwlock_unlock( &list->rwlock );
+	}
+
+	return value;
+}
+
+/** Locate a property by name without looking in the parents.
+ *
+ * \private \memberof mlt_properties_s
+ * \param self a properties list
+ * \param name the property to lookup by name
+ * \return the property or NULL for failure
+ */
+
+static inline mlt_property mlt_properties_find_local( mlt_properties self, const char *name )
+{
+	if ( !self || !name ) return NULL;
+	return mlt_properties_lookup( self, name, generate_hash( name ), NULL );
+}
+
+/** Locate a property by name in a list or else in its parents.
+ *
+ * \private \memberof mlt_properties_s
+ * \param self a properties list
+ * \param name the property to lookup by name
+ * \return the property or NULL for failure
+ */
 
+static inline mlt_property mlt_properties_find( mlt_properties self, const char *name )
+{
+	if ( !self || !name ) return NULL;
+	unsigned int key = generate_hash( name );
+	mlt_property value = mlt_properties_lookup( self, name, key, NULL );
+	for ( self = ( ( property_list* )self->local )->parent; !value && self; self = ( ( property_list* )self->local )->parent )
+		value = mlt_properties_lookup( self, name, key, NULL );
 	return value;
 }
 
+/** Locate a property by atom without looking in the parents.
+ *
+ * \private \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned name of the property
+ * \return the property or NULL for failure
+ */
+
+static inline mlt_property mlt_properties_find_atom_local( mlt_properties self, mlt_property_atom atom )
+{
+	if ( !self || !atom ) return NULL;
+
+	// Properties are never removed, so a slot can be read without the lock
+	property_list *list = self->local;
+	if ( list->slots && atom->slot >= 0 )
+		return atomic_load_explicit( &list->slots[ atom->slot ], memory_order_acquire );
+
+	return mlt_properties_lookup( self, atom->name, atom->hash, atom );
+}
+
+/** Locate a property by atom in a list or else in its parents.
+ *
+ * \private \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned name of the property
+ * \return the property or NULL for failure
+ */
+
+static inline mlt_property mlt_properties_find_atom( mlt_properties self, mlt_property_atom atom )
+{
+	mlt_property value = mlt_properties_find_atom_local( self, atom );
+	while ( !value && self && ( self = ( ( property_list* )self->local )->parent ) )
+		value = mlt_properties_find_atom_local( self, atom );
+	return value;
+}
+
+/** Find the properties of the parent that a list does not hide.
+ *
+ * \private \memberof mlt_properties_s
+ * \param self a properties list
+ */
+
+static void inherited_rebuild( mlt_properties self )
+{
+	property_list *list = self->local;
+	int count = mlt_properties_count( list->parent );
+	int *inherited = count > 0 ? malloc( count * sizeof( int ) ) : NULL;
+	int i, n = 0;
+
+	for ( i = 0; inherited && i < count; i ++ )
+		if ( !mlt_properties_find_local( self, mlt_properties_get_name( list->parent, i ) ) )
+			inherited[ n ++ ] = i;
+
+	mlt_properties_lock( self );
+	free( list->inherited );
+	list->inherited = inherited;
+	list->inherited_count = n;
+	mlt_properties_unlock( self );
+}
+
+/** Stop enumerating the property of the parent that a new property hides.
+ *
+ * The caller must hold the write lock.
+ * \private \memberof mlt_properties_s
+ * \param list the private data of a properties list
+ * \param name the name of the new property
+ */
+
+static void inherited_hide( property_list *list, const char *name )
+{
+	if ( list->inherited_count && mlt_properties_find( list->parent, name ) )
+	{
+		int i;
+		for ( i = 0; i < list->inherited_count; i ++ )
+		{
+			if ( !strcmp( mlt_properties_get_name( list->parent, list->inherited[ i ] ), name ) )
+			{
+				list->inherited_count --;
+				memmove( &list->inherited[ i ], &list->inherited[ i + 1 ], ( list->inherited_count - i ) * sizeof( int ) );
+				break;
+			}
+		}
+	}
+}
+
 /** Add a new property.
  *
  * \private \memberof mlt_properties_s
  * \param self a properties list
  * \param name the name of the new property
+ * \param key the hash of the name
+ * \param atom the atom for name or NULL
  * \return the new property
  */
 
-static mlt_property mlt_properties_add( mlt_properties self, const char *name )
+static mlt_property mlt_properties_add( mlt_properties self, const char *name, unsigned int key, mlt_property_atom atom )
 {
 	property_list *list = self->local;
-	int key = generate_hash( name );
 	mlt_property result;
 
 	mlt_properties_lock( self );
@@ -559,20 +1032,42 @@ static mlt_property mlt_properties_add( mlt_properties self, const char *name )
 	{
 		list->size += 50;
 		list->name = realloc( list->name, list->size * sizeof( const char * ) );
+		list->name_hash = realloc( list->name_hash, list->size * sizeof( unsigned int ) );
+		list->atom = realloc( list->atom, list->size * sizeof( mlt_property_atom ) );
 		list->value = realloc( list->value, list->size * sizeof( mlt_property ) );
 	}
 
 	// Assign name/value pair
-	list->name[ list->count ] = strdup( name );
-	list->value[ list->count ] = mlt_property_init( );
+	list->name_hash[ list->count ] = key;
+	list->atom[ list->count ] = atom;
+	if ( list->arena )
+	{
+		list->name[ list->count ] = atom ? atom->name : arena_strdup( list, name );
+		list->value[ list->count ] = mlt_property_init_in( arena_alloc( list, mlt_property_struct_size() ) );
+	}
+	else
+	{
+		list->name[ list->count ] = atom ? atom->name : strdup( name );
+		list->value[ list->count ] = mlt_property_init( );
+	}
 
-	// Assign to hash table
-	if ( list->hash[ key ] == 0 )
-		list->hash[ key ] = list->count + 1;
+	// Keep the hash table at most half full so probe sequences stay short
+	if ( ( list->count + 1 ) * 2 > list->hash_size )
+		hash_rebuild( list, list->hash_size ? list->hash_size * 2 : 16 );
+	hash_insert( list, list->count );
 
 	// Return and increment count accordingly
 	result = list->value[ list->count ++ ];
 
+	// Publish well-known properties in their slot
+	if ( list->slots )
+	{
+		int slot = atom ? atom->slot : slot_of_name( name );
+		if ( slot >= 0 )
+			atomic_store_explicit( &list->slots[ slot ], result, memory_order_release );
+	}
+
+	inherited_hide( list, name );
 	mlt_properties_unlock( self );
 
 	return result;
@@ -588,22 +1083,142 @@ static mlt_property mlt_properties_add( mlt_properties self, const char *name )
 
 static mlt_property mlt_properties_fetch( mlt_properties self, const char *name )
 {
-	// Try to find an existing property first
-	mlt_property property = mlt_properties_find( self, name );
+	// Try to find an existing property first, a parent's is never changed
+	mlt_property property = mlt_properties_find_local( self, name );
 
 	// If it wasn't found, create one
 	if ( property == NULL )
-		property = mlt_properties_add( self, name );
+		property = mlt_properties_add( self, name, generate_hash( name ), NULL );
 
 	// Return the property
 	return property;
 }
 
+/** Fetch a property by atom and add one if not found.
+ *
+ * \private \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned name of the property to lookup or add
+ * \return the property
+ */
+
+static mlt_property mlt_properties_fetch_atom( mlt_properties self, mlt_property_atom atom )
+{
+	mlt_property property = mlt_properties_find_atom_local( self, atom );
+	if ( property == NULL )
+		property = mlt_properties_add( self, atom->name, atom->hash, atom );
+	return property;
+}
+
+static update_batch *find_batch( property_list *list )
+{
+	update_batch *batch = list->batches;
+	while ( batch != NULL && !pthread_equal( batch->thread, pthread_self( ) ) )
+		batch = batch->next;
+	return batch;
+}
+
 static void fire_property_changed(mlt_properties self, const char *name)
 {
+	property_list *list = self->local;
+
+	if ( atomic_load_explicit( &list->updating, memory_order_acquire ) > 0 )
+	{
+		int held = 0;
+		pthread_mutex_lock( &list->mutex );
+		update_batch *batch = find_batch( list );
+		if ( batch != NULL )
+		{
+			// Only the last value matters, so remember each name once
+			if ( batch->changed == NULL )
+				batch->changed = mlt_properties_new( );
+			mlt_properties_set_int( batch->changed, name, 1 );
+			held = 1;
+		}
+		pthread_mutex_unlock( &list->mutex );
+		if ( held )
+			return;
+	}
 	mlt_events_fire(self, "property-changed", mlt_event_data_from_string(name));
 }
 
+/** Start a batch of changes to a properties list.
+ *
+ * Until the matching mlt_properties_end_update() the "property-changed"
+ * event is held back for changes made by the calling thread, and then it is
+ * fired once for each property that changed, in the order they first changed.
+ * The calls may be nested, and each thread has its own batch, so changes made
+ * by other threads in the meantime fire as usual.
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ */
+
+void mlt_properties_begin_update( mlt_properties self )
+{
+	if ( self != NULL )
+	{
+		property_list *list = self->local;
+
+		pthread_mutex_lock( &list->mutex );
+		update_batch *batch = find_batch( list );
+		if ( batch == NULL )
+		{
+			batch = calloc( 1, sizeof( *batch ) );
+			if ( batch != NULL )
+			{
+				batch->thread = pthread_self( );
+				batch->next = list->batches;
+				list->batches = batch;
+				atomic_fetch_add( &list->updating, 1 );
+			}
+		}
+		if ( batch != NULL )
+			batch->depth ++;
+		pthread_mutex_unlock( &list->mutex );
+	}
+}
+
+/** Finish a batch of changes to a properties list.
+ *
+ * It must be called on the thread that called mlt_properties_begin_update().
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \see mlt_properties_begin_update
+ */
+
+void mlt_properties_end_update( mlt_properties self )
+{
+	if ( self != NULL )
+	{
+		property_list *list = self->local;
+		mlt_properties changed = NULL;
+		update_batch **link;
+		int i;
+
+		pthread_mutex_lock( &list->mutex );
+		for ( link = &list->batches; *link != NULL; link = &( *link )->next )
+		{
+			update_batch *batch = *link;
+			if ( pthread_equal( batch->thread, pthread_self( ) ) )
+			{
+				if ( -- batch->depth == 0 )
+				{
+					changed = batch->changed;
+					*link = batch->next;
+					free( batch );
+					atomic_fetch_sub( &list->updating, 1 );
+				}
+				break;
+			}
+		}
+		pthread_mutex_unlock( &list->mutex );
+
+		for ( i = 0; i < mlt_properties_count( changed ); i ++ )
+			mlt_events_fire( self, "property-changed", mlt_event_data_from_string( mlt_properties_get_name( changed, i ) ) );
+		mlt_properties_close( changed );
+	}
+}
+
 /** Copy a property to another properties list.
  *
  * \public \memberof mlt_properties_s
@@ -644,6 +1259,7 @@ int mlt_properties_pass_list( mlt_properties self, mlt_properties that, const ch
 	const char *delim = " ,\t\n";	// Any combination of spaces, commas, tabs, and newlines
 	int count, done = 0;
 
+	mlt_properties_begin_update( self );
 	while( !done )
 	{
 		count = strcspn( ptr, delim );
@@ -659,6 +1275,7 @@ int mlt_properties_pass_list( mlt_properties self, mlt_properties that, const ch
 		if ( !done )
 			ptr += strspn( ptr, delim );
 	}
+	mlt_properties_end_update( self );
 
 	free( props );
 
@@ -897,6 +1514,8 @@ char *mlt_properties_get_name( mlt_properties self, int index )
 	property_list *list = self->local;
 	if ( index >= 0 && index < list->count )
 		return list->name[ index ];
+	if ( index >= list->count && index - list->count < list->inherited_count )
+		return mlt_properties_get_name( list->parent, list->inherited[ index - list->count ] );
 	return NULL;
 }
 
@@ -916,6 +1535,8 @@ char *mlt_properties_get_value_tf( mlt_properties self, int index, mlt_time_form
 	property_list *list = self->local;
 	if ( index >= 0 && index < list->count )
 		return mlt_property_get_string_l_tf( list->value[ index ], list->locale, time_format );
+	if ( index >= list->count && index - list->count < list->inherited_count )
+		return mlt_properties_get_value_tf( list->parent, list->inherited[ index - list->count ], time_format );
 	return NULL;
 }
 
@@ -949,11 +1570,14 @@ void *mlt_properties_get_data_at( mlt_properties self, int index, int *size )
 	property_list *list = self->local;
 	if ( index >= 0 && index < list->count )
 		return mlt_property_get_data( list->value[ index ], size );
+	if ( index >= list->count && index - list->count < list->inherited_count )
+		return mlt_properties_get_data_at( list->parent, list->inherited[ index - list->count ], size );
 	return NULL;
 }
 
 /** Return the number of items in the list.
  *
+ * This includes the properties of the parent that the list does not hide.
  * \public \memberof mlt_properties_s
  * \param self a properties list
  * \return the number of property objects or -1 if error
@@ -963,7 +1587,7 @@ int mlt_properties_count( mlt_properties self )
 {
 	if ( !self ) return -1;
 	property_list *list = self->local;
-	return list->count;
+	return list->count + list->inherited_count;
 }
 
 /** Set a value by parsing a name=value string.
@@ -1025,7 +1649,7 @@ int mlt_properties_get_int( mlt_properties self, const char *name )
 	mlt_property value = mlt_properties_find( self, name );
 	if ( value )
 	{
-		mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+		mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 		double fps = mlt_profile_fps( profile );
 		property_list *list = self->local;
 		result = mlt_property_get_int( value, fps, list->locale );
@@ -1121,7 +1745,7 @@ double mlt_properties_get_double( mlt_properties self, const char *name )
 	mlt_property value = mlt_properties_find( self, name );
 	if ( value )
 	{
-		mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+		mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 		double fps = mlt_profile_fps( profile );
 		property_list *list = self->local;
 		result = mlt_property_get_double( value, fps, list->locale );
@@ -1173,7 +1797,7 @@ mlt_position mlt_properties_get_position( mlt_properties self, const char *name
 	mlt_property value = mlt_properties_find( self, name );
 	if ( value )
 	{
-		mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+		mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 		double fps = mlt_profile_fps( profile );
 		property_list *list = self->local;
 		result = mlt_property_get_position( value, fps, list->locale );
@@ -1248,13 +1872,117 @@ int mlt_properties_set_data( mlt_properties self, const char *name, void *value,
 	// Fetch the property to work with
 	mlt_property property = mlt_properties_fetch( self, name );
 
-	// Set it if not NULL
-	if ( property != NULL )
-		error = mlt_property_set_data( property, value, length, destroy, serialise );
+	// Set it if not NULL
+	if ( property != NULL )
+		error = mlt_property_set_data( property, value, length, destroy, serialise );
+
+	fire_property_changed(self, name);
+
+	return error;
+}
+
+/** Get a property object to read a parameter repeatedly.
+ *
+ * The property is added empty if it does not exist yet, so that it is the
+ * object that is set later. Properties are never removed from a list, so it
+ * remains valid until the list is closed, and it follows its name through
+ * mlt_properties_rename(). Read it with the *_property getters to skip the
+ * name lookup, for example when a service reads its parameters on every frame.
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param name the property name
+ * \return the property or NULL if error
+ */
+
+mlt_property mlt_properties_get_property( mlt_properties self, const char *name )
+{
+	if ( !self || !name ) return NULL;
+	return mlt_properties_fetch( self, name );
+}
+
+/** Get the string value of a property object.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self the properties list that holds \p property
+ * \param property a property from mlt_properties_get_property()
+ * \return the string value or NULL if it is not set
+ */
+
+char *mlt_properties_get_string_property( mlt_properties self, mlt_property property )
+{
+	if ( !self || !property ) return NULL;
+	property_list *list = self->local;
+	return mlt_property_get_string_l( property, list->locale );
+}
+
+/** Get the integer value of a property object.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self the properties list that holds \p property
+ * \param property a property from mlt_properties_get_property()
+ * \return the integer value, 0 if it is not set
+ */
+
+int mlt_properties_get_int_property( mlt_properties self, mlt_property property )
+{
+	if ( !self || !property ) return 0;
+	mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
+	property_list *list = self->local;
+	return mlt_property_get_int( property, mlt_profile_fps( profile ), list->locale );
+}
+
+/** Get the floating point value of a property object.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self the properties list that holds \p property
+ * \param property a property from mlt_properties_get_property()
+ * \return the floating point value, 0 if it is not set
+ */
+
+double mlt_properties_get_double_property( mlt_properties self, mlt_property property )
+{
+	if ( !self || !property ) return 0.0;
+	mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
+	property_list *list = self->local;
+	return mlt_property_get_double( property, mlt_profile_fps( profile ), list->locale );
+}
+
+/** Get the integer value of a property object at a frame position.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self the properties list that holds \p property
+ * \param property a property from mlt_properties_get_property()
+ * \param position the frame number
+ * \param length the maximum number of frames when interpreting negative keyframe times,
+ *  <=0 if you don't care or need that
+ * \return the integer value, 0 if it is not set
+ */
+
+int mlt_properties_anim_get_int_property( mlt_properties self, mlt_property property, int position, int length )
+{
+	if ( !self || !property ) return 0;
+	mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
+	property_list *list = self->local;
+	return mlt_property_anim_get_int( property, mlt_profile_fps( profile ), list->locale, position, length );
+}
 
-	fire_property_changed(self, name);
+/** Get the floating point value of a property object at a frame position.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self the properties list that holds \p property
+ * \param property a property from mlt_properties_get_property()
+ * \param position the frame number
+ * \param length the maximum number of frames when interpreting negative keyframe times,
+ *  <=0 if you don't care or need that
+ * \return the floating point value, 0 if it is not set
+ */
 
-	return error;
+double mlt_properties_anim_get_double_property( mlt_properties self, mlt_property property, int position, int length )
+{
+	if ( !self || !property ) return 0.0;
+	mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
+	property_list *list = self->local;
+	return mlt_property_anim_get_double( property, mlt_profile_fps( profile ), list->locale, position, length );
 }
 
 /** Rename a property.
@@ -1268,7 +1996,7 @@ int mlt_properties_set_data( mlt_properties self, const char *name, void *value,
 
 int mlt_properties_rename( mlt_properties self, const char *source, const char *dest )
 {
-	mlt_property value = mlt_properties_find( self, dest );
+	mlt_property value = mlt_properties_find_local( self, dest );
 
 	if ( value == NULL )
 	{
@@ -1281,13 +2009,29 @@ int mlt_properties_rename( mlt_properties self, const char *source, const char *
 		{
 			if ( list->name[ i ] && !strcmp( list->name[ i ], source ) )
 			{
-				free( list->name[ i ] );
-				list->name[ i ] = strdup( dest );
-				list->hash[ generate_hash( dest ) ] = i + 1;
+				if ( name_is_owned( list, i ) )
+					free( list->name[ i ] );
+				list->name[ i ] = list->arena ? arena_strdup( list, dest ) : strdup( dest );
+				list->name_hash[ i ] = generate_hash( dest );
+				list->atom[ i ] = NULL;
+				hash_rebuild( list, list->hash_size );
+				if ( list->slots )
+				{
+					int slot = slot_of_name( source );
+					if ( slot >= 0 )
+						atomic_store_explicit( &list->slots[ slot ], NULL, memory_order_release );
+					slot = slot_of_name( dest );
+					if ( slot >= 0 )
+						atomic_store_explicit( &list->slots[ slot ], list->value[ i ], memory_order_release );
+				}
 				break;
 			}
 		}
 		mlt_properties_unlock( self );
+
+		// The new name may hide a property of the parent and the old one show one
+		if ( list->parent )
+			inherited_rebuild( self );
 	}
 
 	return value != NULL;
@@ -1303,11 +2047,13 @@ int mlt_properties_rename( mlt_properties self, const char *source, const char *
 void mlt_properties_dump( mlt_properties self, FILE *output )
 {
 	if ( !self || !output ) return;
-	property_list *list = self->local;
 	int i = 0;
-	for ( i = 0; i < list->count; i ++ )
-		if ( mlt_properties_get( self, list->name[ i ] ) != NULL )
-			fprintf( output, "%s=%s\n", list->name[ i ], mlt_properties_get( self, list->name[ i ] ) );
+	for ( i = 0; i < mlt_properties_count( self ); i ++ )
+	{
+		char *name = mlt_properties_get_name( self, i );
+		if ( mlt_properties_get( self, name ) != NULL )
+			fprintf( output, "%s=%s\n", name, mlt_properties_get( self, name ) );
+	}
 }
 
 /** Output the properties to a file handle.
@@ -1328,11 +2074,14 @@ void mlt_properties_debug( mlt_properties self, const char *title, FILE *output
 		property_list *list = self->local;
 		int i = 0;
 		fprintf( output, "[ ref=%d", list->ref_count );
-		for ( i = 0; i < list->count; i ++ )
-			if ( mlt_properties_get( self, list->name[ i ] ) != NULL )
-				fprintf( output, ", %s=%s", list->name[ i ], mlt_properties_get( self, list->name[ i ] ) );
+		for ( i = 0; i < mlt_properties_count( self ); i ++ )
+		{
+			char *name = mlt_properties_get_name( self, i );
+			if ( mlt_properties_get( self, name ) != NULL )
+				fprintf( output, ", %s=%s", name, mlt_properties_get( self, name ) );
 			else
-				fprintf( output, ", %s=%p", list->name[ i ], mlt_properties_get_data( self, list->name[ i ], NULL ) );
+				fprintf( output, ", %s=%p", name, mlt_properties_get_data( self, name, NULL ) );
+		}
 		fprintf( output, " ]" );
 	}
 	fprintf( output, "\n" );
@@ -1460,7 +2209,7 @@ int mlt_properties_dir_list( mlt_properties self, const char *dirname, const cha
 	{
 		property_list *list = self->local;
 		mlt_properties_lock( self );
-		qsort( list->value, mlt_properties_count( self ), sizeof( mlt_property ), mlt_compare );
+		qsort( list->value, list->count, sizeof( mlt_property ), mlt_compare );
 		mlt_properties_unlock( self );
 	}
 
@@ -1503,8 +2252,24 @@ void mlt_properties_close( mlt_properties self )
 			// Clean up names and values
 			for ( index = list->count - 1; index >= 0; index -- )
 			{
-				mlt_property_close( list->value[ index ] );
-				free( list->name[ index ] );
+				if ( list->arena )
+				{
+					mlt_property_close_in( list->value[ index ] );
+				}
+				else
+				{
+					mlt_property_close( list->value[ index ] );
+					if ( name_is_owned( list, index ) )
+						free( list->name[ index ] );
+				}
+			}
+
+			// Release the arena
+			while ( list->arena )
+			{
+				arena_chunk *next = list->arena->next;
+				free( list->arena );
+				list->arena = next;
 			}
 
 #if defined(__GLIBC__) || defined(__APPLE__)
@@ -1517,8 +2282,21 @@ void mlt_properties_close( mlt_properties self )
 #endif
 
 			// Clear up the list
+			while ( list->batches != NULL )
+			{
+				update_batch *batch = list->batches;
+				list->batches = batch->next;
+				mlt_properties_close( batch->changed );
+				free( batch );
+			}
+			mlt_properties_close( list->parent );
+			free( list->inherited );
 			pthread_mutex_destroy( &list->mutex );
+			pthread_rwlock_destroy( &list->rwlock );
+			free( list->hash );
 			free( list->name );
+			free( list->name_hash );
+			free( list->atom );
 			free( list->value );
 			free( list );
 
@@ -2209,6 +2987,8 @@ char *mlt_properties_serialise_yaml( mlt_properties self )
 
 /** Protect a properties list against concurrent access.
  *
+ * This takes the list's exclusive (writer) lock. Property lookups only take
+ * the shared (reader) lock so that concurrent readers never block each other.
  * \public \memberof mlt_properties_s
  * \param self a properties list
  */
@@ -2216,7 +2996,7 @@ char *mlt_properties_serialise_yaml( mlt_properties self )
 void mlt_properties_lock( mlt_properties self )
 {
 	if ( self )
-		pthread_mutex_lock( &( ( property_list* )( self->local ) )->mutex );
+		pthread_rwlock_wrlock( &( ( property_list* )( self->local ) )->rwlock );
 }
 
 /** End protecting a properties list against concurrent access.
@@ -2228,7 +3008,7 @@ void mlt_properties_lock( mlt_properties self )
 void mlt_properties_unlock( mlt_properties self )
 {
 	if ( self )
-		pthread_mutex_unlock( &( ( property_list* )( self->local ) )->mutex );
+		pthread_rwlock_unlock( &( ( property_list* )( self->local ) )->rwlock );
 }
 
 /** Remove the value for a property.
@@ -2273,6 +3053,267 @@ int mlt_properties_exists( mlt_properties self, const char *name )
 	return !mlt_property_is_clear( mlt_properties_find( self, name ) );
 }
 
+/** Get a string value associated to an atom.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned property name
+ * \return the property's string value or NULL if it does not exist
+ * \see mlt_atom
+ */
+
+char *mlt_properties_get_atom( mlt_properties self, mlt_property_atom atom )
+{
+	char *result = NULL;
+	mlt_property value = mlt_properties_find_atom( self, atom );
+	if ( value )
+	{
+		property_list *list = self->local;
+		result = mlt_property_get_string_l( value, list->locale );
+	}
+	return result;
+}
+
+/** Get an integer value associated to an atom.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned property name
+ * \return the value or 0 if not found
+ * \see mlt_atom
+ */
+
+int mlt_properties_get_int_atom( mlt_properties self, mlt_property_atom atom )
+{
+	int result = 0;
+	mlt_property value = mlt_properties_find_atom( self, atom );
+	if ( value )
+	{
+		mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
+		double fps = mlt_profile_fps( profile );
+		property_list *list = self->local;
+		result = mlt_property_get_int( value, fps, list->locale );
+	}
+	return result;
+}
+
+/** Set an integer value associated to an atom.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned property name
+ * \param value the value
+ * \return true if error
+ * \see mlt_atom
+ */
+
+int mlt_properties_set_int_atom( mlt_properties self, mlt_property_atom atom, int value )
+{
+	int error = 1;
+
+	if ( !self || !atom ) return error;
+
+	mlt_property property = mlt_properties_fetch_atom( self, atom );
+	if ( property != NULL )
+	{
+		error = mlt_property_set_int( property, value );
+		mlt_properties_do_mirror( self, atom->name );
+	}
+
+	fire_property_changed( self, atom->name );
+
+	return error;
+}
+
+/** Get a 64-bit integer value associated to an atom.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned property name
+ * \return the value or 0 if not found
+ * \see mlt_atom
+ */
+
+int64_t mlt_properties_get_int64_atom( mlt_properties self, mlt_property_atom atom )
+{
+	mlt_property value = mlt_properties_find_atom( self, atom );
+	return value == NULL ? 0 : mlt_property_get_int64( value );
+}
+
+/** Set a 64-bit integer value associated to an atom.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned property name
+ * \param value the value
+ * \return true if error
+ * \see mlt_atom
+ */
+
+int mlt_properties_set_int64_atom( mlt_properties self, mlt_property_atom atom, int64_t value )
+{
+	int error = 1;
+
+	if ( !self || !atom ) return error;
+
+	mlt_property property = mlt_properties_fetch_atom( self, atom );
+	if ( property != NULL )
+	{
+		error = mlt_property_set_int64( property, value );
+		mlt_properties_do_mirror( self, atom->name );
+	}
+
+	fire_property_changed( self, atom->name );
+
+	return error;
+}
+
+/** Get a floating point value associated to an atom.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned property name
+ * \return the value or 0 if not found
+ * \see mlt_atom
+ */
+
+double mlt_properties_get_double_atom( mlt_properties self, mlt_property_atom atom )
+{
+	double result = 0;
+	mlt_property value = mlt_properties_find_atom( self, atom );
+	if ( value )
+	{
+		mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
+		double fps = mlt_profile_fps( profile );
+		property_list *list = self->local;
+		result = mlt_property_get_double( value, fps, list->locale );
+	}
+	return result;
+}
+
+/** Set a floating point value associated to an atom.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned property name
+ * \param value the value
+ * \return true if error
+ * \see mlt_atom
+ */
+
+int mlt_properties_set_double_atom( mlt_properties self, mlt_property_atom atom, double value )
+{
+	int error = 1;
+
+	if ( !self || !atom ) return error;
+
+	mlt_property property = mlt_properties_fetch_atom( self, atom );
+	if ( property != NULL )
+	{
+		error = mlt_property_set_double( property, value );
+		mlt_properties_do_mirror( self, atom->name );
+	}
+
+	fire_property_changed( self, atom->name );
+
+	return error;
+}
+
+/** Get a position value associated to an atom.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned property name
+ * \return the value or 0 if not found
+ * \see mlt_atom
+ */
+
+mlt_position mlt_properties_get_position_atom( mlt_properties self, mlt_property_atom atom )
+{
+	mlt_position result = 0;
+	mlt_property value = mlt_properties_find_atom( self, atom );
+	if ( value )
+	{
+		mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
+		double fps = mlt_profile_fps( profile );
+		property_list *list = self->local;
+		result = mlt_property_get_position( value, fps, list->locale );
+	}
+	return result;
+}
+
+/** Set a position value associated to an atom.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned property name
+ * \param value the value
+ * \return true if error
+ * \see mlt_atom
+ */
+
+int mlt_properties_set_position_atom( mlt_properties self, mlt_property_atom atom, mlt_position value )
+{
+	int error = 1;
+
+	if ( !self || !atom ) return error;
+
+	mlt_property property = mlt_properties_fetch_atom( self, atom );
+	if ( property != NULL )
+	{
+		error = mlt_property_set_position( property, value );
+		mlt_properties_do_mirror( self, atom->name );
+	}
+
+	fire_property_changed( self, atom->name );
+
+	return error;
+}
+
+/** Get a binary data value associated to an atom.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned property name
+ * \param[out] length the size of the binary data in bytes, if available (optional)
+ * \return a pointer to the opaque binary data or NULL if not found
+ * \see mlt_atom
+ */
+
+void *mlt_properties_get_data_atom( mlt_properties self, mlt_property_atom atom, int *length )
+{
+	mlt_property value = mlt_properties_find_atom( self, atom );
+	return value == NULL ? NULL : mlt_property_get_data( value, length );
+}
+
+/** Store binary data associated to an atom.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param atom the interned property name
+ * \param value an opaque pointer to binary data
+ * \param length the size of the binary data in bytes (optional)
+ * \param destroy a function to deallocate the binary data when the property is closed (optional)
+ * \param serialise a function that can serialize the binary data as text (optional)
+ * \return true if error
+ * \see mlt_atom
+ */
+
+int mlt_properties_set_data_atom( mlt_properties self, mlt_property_atom atom, void *value, int length, mlt_destructor destroy, mlt_serialiser serialise )
+{
+	int error = 1;
+
+	if ( !self || !atom ) return error;
+
+	mlt_property property = mlt_properties_fetch_atom( self, atom );
+	if ( property != NULL )
+		error = mlt_property_set_data( property, value, length, destroy, serialise );
+
+	fire_property_changed( self, atom->name );
+
+	return error;
+}
+
 /** Get a time string associated to the name.
  *
  * Do not free the returned string. It's lifetime is controlled by the property.
@@ -2285,7 +3326,7 @@ int mlt_properties_exists( mlt_properties self, const char *name )
 
 char *mlt_properties_get_time( mlt_properties self, const char* name, mlt_time_format format )
 {
-	mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+	mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 	if ( profile )
 	{
 		double fps = mlt_profile_fps( profile );
@@ -2341,7 +3382,7 @@ mlt_position mlt_properties_time_to_frames( mlt_properties self, const char *tim
 
 mlt_color mlt_properties_get_color( mlt_properties self, const char* name )
 {
-	mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+	mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 	double fps = mlt_profile_fps( profile );
 	property_list *list = self->local;
 	mlt_property value = mlt_properties_find( self, name );
@@ -2432,7 +3473,7 @@ int mlt_properties_set_color( mlt_properties self, const char *name, mlt_color c
 
 char* mlt_properties_anim_get( mlt_properties self, const char *name, int position, int length )
 {
-	mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+	mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 	double fps = mlt_profile_fps( profile );
 	mlt_property value = mlt_properties_find( self, name );
 	property_list *list = self->local;
@@ -2466,7 +3507,7 @@ int mlt_properties_anim_set( mlt_properties self, const char *name, const char *
 	// Set it if not NULL
 	if ( property )
 	{
-		mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+		mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 		double fps = mlt_profile_fps( profile );
 		property_list *list = self->local;
 		error = mlt_property_anim_set_string( property, value,
@@ -2492,7 +3533,7 @@ int mlt_properties_anim_set( mlt_properties self, const char *name, const char *
 
 int mlt_properties_anim_get_int( mlt_properties self, const char *name, int position, int length )
 {
-	mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+	mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 	double fps = mlt_profile_fps( profile );
 	property_list *list = self->local;
 	mlt_property value = mlt_properties_find( self, name );
@@ -2525,7 +3566,7 @@ int mlt_properties_anim_set_int( mlt_properties self, const char *name, int valu
 	// Set it if not NULL
 	if ( property != NULL )
 	{
-		mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+		mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 		double fps = mlt_profile_fps( profile );
 		property_list *list = self->local;
 		error = mlt_property_anim_set_int( property, value, fps, list->locale, position, length, keyframe_type );
@@ -2550,13 +3591,44 @@ int mlt_properties_anim_set_int( mlt_properties self, const char *name, int valu
 
 double mlt_properties_anim_get_double( mlt_properties self, const char *name, int position, int length )
 {
-	mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+	mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 	double fps = mlt_profile_fps( profile );
 	property_list *list = self->local;
 	mlt_property value = mlt_properties_find( self, name );
 	return value == NULL ? 0.0 : mlt_property_anim_get_double( value, fps, list->locale, position, length );
 }
 
+/** Get the real numbers of a property for a range of frame positions.
+ *
+ * This gives the same results as calling mlt_properties_anim_get_double() for
+ * each position, which is much slower for a long range.
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param name the property to get
+ * \param values an array to receive \p count real numbers, which are 0 for a missing property
+ * \param position the frame number of the first value
+ * \param count the number of consecutive frames
+ * \param length the maximum number of frames when interpreting negative keyframe times,
+ *  <=0 if you don't care or need that
+ * \return true if there was an error
+ */
+
+int mlt_properties_anim_get_double_range( mlt_properties self, const char *name, double *values,
+	int position, int count, int length )
+{
+	if ( !self || !name || !values || count < 0 ) return 1;
+
+	mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
+	double fps = mlt_profile_fps( profile );
+	property_list *list = self->local;
+	mlt_property value = mlt_properties_find( self, name );
+	if ( value )
+		return mlt_property_anim_get_double_range( value, values, fps, list->locale, position, count, length );
+	for ( int i = 0; i < count; i++ )
+		values[i] = 0.0;
+	return 0;
+}
+
 /** Set a property to a real number at a frame position.
  *
  * \public \memberof mlt_properties_s
@@ -2583,7 +3655,7 @@ int mlt_properties_anim_set_double( mlt_properties self, const char *name, doubl
 	// Set it if not NULL
 	if ( property != NULL )
 	{
-		mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+		mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 		double fps = mlt_profile_fps( profile );
 		property_list *list = self->local;
 		error = mlt_property_anim_set_double( property, value, fps, list->locale, position, length, keyframe_type );
@@ -2681,7 +3753,7 @@ extern int mlt_properties_anim_set_rect( mlt_properties self, const char *name,
 	// Set it if not NULL
 	if ( property != NULL )
 	{
-		mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+		mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 		double fps = mlt_profile_fps( profile );
 		property_list *list = self->local;
 		error = mlt_property_anim_set_rect( property, value, fps, list->locale, position, length, keyframe_type );
@@ -2706,7 +3778,7 @@ extern int mlt_properties_anim_set_rect( mlt_properties self, const char *name,
 
 extern mlt_rect mlt_properties_anim_get_rect( mlt_properties self, const char *name, int position, int length )
 {
-	mlt_profile profile = mlt_properties_get_data( self, "_profile", NULL );
+	mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
 	double fps = mlt_profile_fps( profile );
 	property_list *list = self->local;
 	mlt_property value = mlt_properties_find( self, name );
@@ -2714,6 +3786,38 @@ extern mlt_rect mlt_properties_anim_get_rect( mlt_properties self, const char *n
 	return value == NULL ? rect : mlt_property_anim_get_rect( value, fps, list->locale, position, length );
 }
 
+/** Get the rectangles of a property for a range of frame positions.
+ *
+ * This gives the same results as calling mlt_properties_anim_get_rect() for
+ * each position, which is much slower for a long range.
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param name the property to get
+ * \param values an array to receive \p count rectangles, which have DBL_MIN fields for a missing property
+ * \param position the frame number of the first value
+ * \param count the number of consecutive frames
+ * \param length the maximum number of frames when interpreting negative keyframe times,
+ *  <=0 if you don't care or need that
+ * \return true if there was an error
+ */
+
+int mlt_properties_anim_get_rect_range( mlt_properties self, const char *name, mlt_rect *values,
+	int position, int count, int length )
+{
+	if ( !self || !name || !values || count < 0 ) return 1;
+
+	mlt_profile profile = mlt_properties_get_data_atom( self, atom_profile, NULL );
+	double fps = mlt_profile_fps( profile );
+	property_list *list = self->local;
+	mlt_property value = mlt_properties_find( self, name );
+	mlt_rect rect = { DBL_MIN, DBL_MIN, DBL_MIN, DBL_MIN, DBL_MIN };
+	if ( value )
+		return mlt_property_anim_get_rect_range( value, values, fps, list->locale, position, count, length );
+	for ( int i = 0; i < count; i++ )
+		values[i] = rect;
+	return 0;
+}
+
 #ifndef _WIN32
 
 // See win32/win32.c for win32 implementation.
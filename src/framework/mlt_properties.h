@@ -48,6 +48,7 @@ struct mlt_properties_s
 
 extern int mlt_properties_init( mlt_properties, void *child );
 extern mlt_properties mlt_properties_new( );
+extern int mlt_properties_use_arena( mlt_properties self );
 extern int mlt_properties_set_lcnumeric( mlt_properties, const char *locale );
 extern const char* mlt_properties_get_lcnumeric( mlt_properties self );
 extern mlt_properties mlt_properties_load( const char *file );
@@ -56,7 +57,11 @@ extern int mlt_properties_inc_ref( mlt_properties self );
 extern int mlt_properties_dec_ref( mlt_properties self );
 extern int mlt_properties_ref_count( mlt_properties self );
 extern void mlt_properties_mirror( mlt_properties self, mlt_properties that );
+extern void mlt_properties_set_parent( mlt_properties self, mlt_properties parent );
+extern mlt_properties mlt_properties_get_parent( mlt_properties self );
 extern int mlt_properties_inherit( mlt_properties self, mlt_properties that );
+extern void mlt_properties_begin_update( mlt_properties self );
+extern void mlt_properties_end_update( mlt_properties self );
 extern int mlt_properties_pass( mlt_properties self, mlt_properties that, const char *prefix );
 extern void mlt_properties_pass_property( mlt_properties self, mlt_properties that, const char *name );
 extern int mlt_properties_pass_list( mlt_properties self, mlt_properties that, const char *list );
@@ -94,6 +99,26 @@ extern void mlt_properties_unlock( mlt_properties self );
 extern void mlt_properties_clear( mlt_properties self, const char *name );
 extern int mlt_properties_exists( mlt_properties self, const char *name );
 
+extern mlt_property_atom mlt_atom( const char *name );
+extern const char *mlt_atom_name( mlt_property_atom atom );
+extern char *mlt_properties_get_atom( mlt_properties self, mlt_property_atom atom );
+extern int mlt_properties_get_int_atom( mlt_properties self, mlt_property_atom atom );
+extern int mlt_properties_set_int_atom( mlt_properties self, mlt_property_atom atom, int value );
+extern int64_t mlt_properties_get_int64_atom( mlt_properties self, mlt_property_atom atom );
+extern int mlt_properties_set_int64_atom( mlt_properties self, mlt_property_atom atom, int64_t value );
+extern double mlt_properties_get_double_atom( mlt_properties self, mlt_property_atom atom );
+extern int mlt_properties_set_double_atom( mlt_properties self, mlt_property_atom atom, double value );
+extern mlt_position mlt_properties_get_position_atom( mlt_properties self, mlt_property_atom atom );
+extern int mlt_properties_set_position_atom( mlt_properties self, mlt_property_atom atom, mlt_position value );
+extern void *mlt_properties_get_data_atom( mlt_properties self, mlt_property_atom atom, int *length );
+extern int mlt_properties_set_data_atom( mlt_properties self, mlt_property_atom atom, void *value, int length, mlt_destructor, mlt_serialiser );
+extern mlt_property mlt_properties_get_property( mlt_properties self, const char *name );
+extern char *mlt_properties_get_string_property( mlt_properties self, mlt_property property );
+extern int mlt_properties_get_int_property( mlt_properties self, mlt_property property );
+extern double mlt_properties_get_double_property( mlt_properties self, mlt_property property );
+extern int mlt_properties_anim_get_int_property( mlt_properties self, mlt_property property, int position, int length );
+extern double mlt_properties_anim_get_double_property( mlt_properties self, mlt_property property, int position, int length );
+
 extern char *mlt_properties_get_time( mlt_properties, const char* name, mlt_time_format );
 extern char *mlt_properties_frames_to_time( mlt_properties, mlt_position, mlt_time_format );
 extern mlt_position mlt_properties_time_to_frames( mlt_properties, const char* time );
@@ -106,6 +131,7 @@ extern int mlt_properties_anim_set( mlt_properties self, const char *name, const
 extern int mlt_properties_anim_get_int( mlt_properties self, const char *name, int position, int length );
 extern int mlt_properties_anim_set_int( mlt_properties self, const char *name, int value, int position, int length, mlt_keyframe_type keyframe_type );
 extern double mlt_properties_anim_get_double( mlt_properties self, const char *name, int position, int length );
+extern int mlt_properties_anim_get_double_range( mlt_properties self, const char *name, double *values, int position, int count, int length );
 extern int mlt_properties_anim_set_double( mlt_properties self, const char *name, double value, int position, int length, mlt_keyframe_type keyframe_type );
 extern mlt_animation mlt_properties_get_animation( mlt_properties self, const char *name );
 
@@ -113,6 +139,7 @@ extern int mlt_properties_set_rect( mlt_properties self, const char *name, mlt_r
 extern mlt_rect mlt_properties_get_rect( mlt_properties self, const char *name );
 extern int mlt_properties_anim_set_rect( mlt_properties self, const char *name, mlt_rect value, int position, int length, mlt_keyframe_type keyframe_type );
 extern mlt_rect mlt_properties_anim_get_rect( mlt_properties self, const char *name, int position, int length );
+extern int mlt_properties_anim_get_rect_range( mlt_properties self, const char *name, mlt_rect *values, int position, int count, int length );
 
 extern int mlt_properties_from_utf8( mlt_properties properties, const char *name_from, const char *name_to );
 extern int mlt_properties_to_utf8( mlt_properties properties, const char *name_from, const char *name_to );
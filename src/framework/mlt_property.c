@@ -35,6 +35,9 @@
 #include <pthread.h>
 #include <float.h>
 #include <math.h>
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <langinfo.h>
+#endif
 
 
 /** Bit pattern used internally to indicated representations available.
@@ -81,6 +84,13 @@ struct mlt_property_s
 
 	pthread_mutex_t mutex;
 	mlt_animation animation;
+
+	/// The numbers parsed from prop_string, valid for parsed_fps and parsed_locale
+	mlt_property_type parsed_types;
+	int parsed_int;
+	double parsed_double;
+	double parsed_fps;
+	locale_t parsed_locale;
 };
 
 /** Construct a property and initialize it
@@ -89,9 +99,35 @@ struct mlt_property_s
 
 mlt_property mlt_property_init( )
 {
-	mlt_property self = calloc( 1, sizeof( *self ) );
+	return mlt_property_init_in( calloc( 1, sizeof( struct mlt_property_s ) ) );
+}
+
+/** Get the number of bytes needed to hold a property object.
+ *
+ * \public \memberof mlt_property_s
+ * \return the size of a property in bytes
+ * \see mlt_property_init_in
+ */
+
+size_t mlt_property_struct_size( )
+{
+	return sizeof( struct mlt_property_s );
+}
+
+/** Construct a property in memory owned by the caller.
+ *
+ * Release it with mlt_property_close_in(), which does not free the memory.
+ * \public \memberof mlt_property_s
+ * \param memory a block of at least mlt_property_struct_size() bytes
+ * \return the property or NULL if memory is NULL
+ */
+
+mlt_property mlt_property_init_in( void *memory )
+{
+	mlt_property self = memory;
 	if ( self ) {
 		pthread_mutexattr_t attr;
+		memset( self, 0, sizeof( *self ) );
 		pthread_mutexattr_init(&attr);
 		pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
 		pthread_mutex_init( &self->mutex, &attr );
@@ -130,6 +166,7 @@ static void clear_property( mlt_property self )
 	self->destructor = NULL;
 	self->serialiser = NULL;
 	self->animation = NULL;
+	self->parsed_types = mlt_prop_none;
 }
 
 /** Clear (0/null) a property.
@@ -296,6 +333,135 @@ int mlt_property_set_data( mlt_property self, void *value, int length, mlt_destr
 	return 0;
 }
 
+/** Get the decimal point of a locale.
+ *
+ * \private \memberof mlt_property_s
+ * \param locale the locale, or NULL for the locale of the thread
+ * \return the character, or 0 if it is unknown or not a single character
+ */
+
+static char decimal_point( locale_t locale )
+{
+#if defined(__GLIBC__) || defined(__APPLE__)
+	const char *point = locale ? nl_langinfo_l( RADIXCHAR, locale ) : nl_langinfo( RADIXCHAR );
+	return point && point[0] && !point[1] ? point[0] : 0;
+#else
+	return 0;
+#endif
+}
+
+/** Parse a plain decimal number without strtod.
+ *
+ * Nearly every number in a property is a few digits with an optional sign
+ * and fraction. The digits and the power of ten of such a number are exact
+ * doubles, so dividing them once rounds exactly like strtod does, without the
+ * cost of its locale handling. Only a number that ends the string or is
+ * followed by a percent sign is taken. Anything else, such as an exponent, too
+ * many digits, a hexadecimal number or a decimal point that is not known to be
+ * that of the locale, is left to strtod.
+ * \private \memberof mlt_property_s
+ * \param s the string to parse
+ * \param locale the locale which gives the decimal point
+ * \param[out] result the number
+ * \param[out] end the character after the number
+ * \return true if the number was parsed
+ */
+
+static int parse_decimal( const char *s, locale_t locale, double *result, const char **end )
+{
+	static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	uint64_t mantissa = 0;
+	int digits = 0, fraction = 0, negative = 0;
+
+	if ( *s == '-' || *s == '+' )
+		negative = *s++ == '-';
+	for ( ; *s >= '0' && *s <= '9' && digits <= 19; s++, digits++ )
+		mantissa = mantissa * 10 + ( *s - '0' );
+	if ( ( *s == '.' || *s == ',' ) && *s == decimal_point( locale ) )
+	{
+		for ( s++; *s >= '0' && *s <= '9' && digits <= 19; s++, digits++, fraction++ )
+			mantissa = mantissa * 10 + ( *s - '0' );
+	}
+	// 19 digits always fit in 64 bits, but only 53 bits in a double
+	if ( digits == 0 || digits > 19 || mantissa > ( UINT64_C(1) << 53 ) )
+		return 0;
+	// strtod might read on, into a fraction, an exponent or a hexadecimal number
+	if ( *s && *s != '%' )
+		return 0;
+	*result = (double) mantissa / powers[ fraction ];
+	if ( negative )
+		*result = -*result;
+	*end = s;
+	return 1;
+}
+
+/** Parse a SMIL clock value of plain decimals as HH:MM:SS.S, MM:SS.S or SS.S.
+ *
+ * \private \memberof mlt_property_s
+ * \return true if the value was parsed, otherwise time_clock_to_frames must do it
+ */
+
+static int parse_clock( const char *s, locale_t locale, int *hours, int *minutes, double *seconds )
+{
+	int fields[2], count = 0;
+	const char *end;
+
+	while ( count < 2 )
+	{
+		const char *p = s;
+		int value = 0;
+
+		for ( ; *p >= '0' && *p <= '9' && p - s < 9; p++ )
+			value = value * 10 + ( *p - '0' );
+		if ( p == s || *p != ':' )
+			break;
+		fields[ count++ ] = value;
+		s = p + 1;
+	}
+	if ( !parse_decimal( s, locale, seconds, &end ) || *end )
+		return 0;
+	*hours = count == 2 ? fields[0] : 0;
+	*minutes = count == 2 ? fields[1] : count == 1 ? fields[0] : 0;
+	return 1;
+}
+
+/** Parse a SMPTE timecode of plain digits as HH:MM:SS:FF, MM:SS:FF or SS:FF.
+ *
+ * The separator before the frames may be a semicolon.
+ * \private \memberof mlt_property_s
+ * \param[out] fields the hours, minutes, seconds and frames
+ * \return true if the timecode was parsed, otherwise time_code_to_frames must do it
+ */
+
+static int parse_timecode( const char *s, int fields[4] )
+{
+	int values[4], count = 0, i;
+
+	while ( count < 4 )
+	{
+		const char *p = s;
+		int value = 0;
+
+		for ( ; *p >= '0' && *p <= '9' && p - s < 9; p++ )
+			value = value * 10 + ( *p - '0' );
+		if ( p == s )
+			return 0;
+		values[ count++ ] = value;
+		if ( *p == 0 )
+			break;
+		// Only the frames may follow a semicolon
+		if ( *p == ';' && strpbrk( p + 1, ":;" ) )
+			return 0;
+		if ( ( *p != ':' && *p != ';' ) || count == 4 )
+			return 0;
+		s = p + 1;
+	}
+	for ( i = 0; i < 4; i++ )
+		fields[i] = i < 4 - count ? 0 : values[ i - 4 + count ];
+	return 1;
+}
+
 /** Parse a SMIL clock value.
  *
  * \private \memberof mlt_property_s
@@ -308,10 +474,13 @@ int mlt_property_set_data( mlt_property self, void *value, int length, mlt_destr
 
 static int time_clock_to_frames( mlt_property self, const char *s, double fps, locale_t locale )
 {
-	char *pos, *copy = strdup( s );
 	int hours = 0, minutes = 0;
 	double seconds;
 
+	if ( parse_clock( s, locale, &hours, &minutes, &seconds ) )
+		return floor( fps * hours * 3600 ) + floor( fps * minutes * 60 ) + lrint( fps * seconds );
+
+	char *pos, *copy = strdup( s );
 	s = copy;
 	pos = strrchr( s, ':' );
 
@@ -382,6 +551,11 @@ static int time_clock_to_frames( mlt_property self, const char *s, double fps, l
 
 static int time_code_to_frames( mlt_property self, const char *s, double fps )
 {
+	int fields[4];
+
+	if ( parse_timecode( s, fields ) )
+		return floor( fps * fields[0] * 3600 ) + floor( fps * fields[1] * 60 ) + ceil( fps * fields[2] ) + fields[3];
+
 	char *pos, *copy = strdup( s );
 	int hours = 0, minutes = 0, seconds = 0, frames;
 
@@ -418,6 +592,32 @@ static int time_code_to_frames( mlt_property self, const char *s, double fps )
 	return floor( fps * hours * 3600 ) + floor( fps * minutes * 60 ) + ceil( fps * seconds ) + frames;
 }
 
+/** Check for a number already parsed from the string of a property.
+ *
+ * Parsing a string is much slower than using the number, and services read
+ * their parameters on every frame. The parsed numbers are kept until the
+ * string changes or a different fps or locale is used. If the number is not
+ * cached, this marks it as cached and the caller must store it.
+ * \private \memberof mlt_property_s
+ * \param self a property
+ * \param type mlt_prop_int or mlt_prop_double
+ * \param fps frames per second, used when converting from time value
+ * \param locale the locale to use when converting from time clock value
+ * \return true if the cached number can be used
+ */
+
+static inline int use_parsed( mlt_property self, mlt_property_type type, double fps, locale_t locale )
+{
+	if ( self->parsed_types && ( self->parsed_fps != fps || self->parsed_locale != locale ) )
+		self->parsed_types = mlt_prop_none;
+	if ( self->parsed_types & type )
+		return 1;
+	self->parsed_types |= type;
+	self->parsed_fps = fps;
+	self->parsed_locale = locale;
+	return 0;
+}
+
 /** Convert a string to an integer.
  *
  * The string must begin with '0x' to be interpreted as hexadecimal.
@@ -499,7 +699,11 @@ int mlt_property_get_int( mlt_property self, double fps, locale_t locale )
 		if ( self->animation && !mlt_animation_get_string(self->animation) )
 			mlt_property_get_string( self );
 		if ( ( self->types & mlt_prop_string ) && self->prop_string )
-			result = mlt_property_atoi( self, fps, locale );
+		{
+			if ( !use_parsed( self, mlt_prop_int, fps, locale ) )
+				self->parsed_int = mlt_property_atoi( self, fps, locale );
+			result = self->parsed_int;
+		}
 	}
 	pthread_mutex_unlock( &self->mutex );
 	return result;
@@ -532,8 +736,12 @@ static double mlt_property_atof( mlt_property self, double fps, locale_t locale
 	else
 	{
 		char *end = NULL;
+		const char *stop;
 		double result;
 
+		if ( parse_decimal( value, locale, &result, &stop ) )
+			return stop[0] == '%' ? result / 100.0 : result;
+
 #if defined(__GLIBC__) || defined(__APPLE__) || defined(HAVE_STRTOD_L)
 		if ( locale )
 			result = strtod_l( value, &end, locale );
@@ -597,7 +805,11 @@ double mlt_property_get_double( mlt_property self, double fps, locale_t locale )
 		if ( self->animation && !mlt_animation_get_string(self->animation) )
 			mlt_property_get_string( self );
 		if ( ( self->types & mlt_prop_string ) && self->prop_string )
-			result = mlt_property_atof( self, fps, locale );
+		{
+			if ( !use_parsed( self, mlt_prop_double, fps, locale ) )
+				self->parsed_double = mlt_property_atof( self, fps, locale );
+			result = self->parsed_double;
+		}
 	}
 	pthread_mutex_unlock( &self->mutex );
 	return result;
@@ -632,7 +844,12 @@ mlt_position mlt_property_get_position( mlt_property self, double fps, locale_t
 		if ( self->animation && !mlt_animation_get_string(self->animation) )
 			mlt_property_get_string( self );
 		if ( ( self->types & mlt_prop_string ) && self->prop_string )
-			result = ( mlt_position )mlt_property_atoi( self, fps, locale );
+		{
+			// The position is parsed like an integer, so share its cache
+			if ( !use_parsed( self, mlt_prop_int, fps, locale ) )
+				self->parsed_int = mlt_property_atoi( self, fps, locale );
+			result = ( mlt_position )self->parsed_int;
+		}
 	}
 	pthread_mutex_unlock( &self->mutex );
 	return result;
@@ -708,6 +925,7 @@ char *mlt_property_get_string_tf( mlt_property self, mlt_time_format time_format
 	{
 		if ( self->prop_string )
 			free( self->prop_string );
+		self->parsed_types = mlt_prop_none;
 		self->prop_string = self->serialiser( self->animation, time_format );
 	}
 	else if ( ! ( self->types & mlt_prop_string ) )
@@ -795,6 +1013,7 @@ char *mlt_property_get_string_l_tf( mlt_property self, locale_t locale, mlt_time
 	{
 		if ( self->prop_string )
 			free( self->prop_string );
+		self->parsed_types = mlt_prop_none;
 		self->prop_string = self->serialiser( self->animation, time_format );
 	}
 	else if ( ! ( self->types & mlt_prop_string ) )
@@ -908,10 +1127,22 @@ void *mlt_property_get_data( mlt_property self, int *length )
  */
 
 void mlt_property_close( mlt_property self )
+{
+	mlt_property_close_in( self );
+	free( self );
+}
+
+/** Destroy a property that was constructed with mlt_property_init_in().
+ *
+ * This releases everything the property holds but not the property memory itself.
+ * \public \memberof mlt_property_s
+ * \param self a property
+ */
+
+void mlt_property_close_in( mlt_property self )
 {
 	clear_property( self );
 	pthread_mutex_destroy( &self->mutex );
-	free( self );
 }
 
 /** Copy a property.
@@ -1350,6 +1581,7 @@ static void refresh_animation( mlt_property self, double fps, locale_t locale, i
 		self->types &= ~mlt_prop_string;
 		if ( self->prop_string )
 			free( self->prop_string );
+		self->parsed_types = mlt_prop_none;
 		self->prop_string = NULL;
 	}
 	else if ( ( self->types & mlt_prop_string ) && self->prop_string )
@@ -1381,14 +1613,15 @@ double mlt_property_anim_get_double( mlt_property self, double fps, locale_t loc
 	if ( self->animation || ( self->prop_string && strchr( self->prop_string, '=' ) ) )
 	{
 		struct mlt_animation_item_s item;
-		item.property = mlt_property_init();
+		struct mlt_property_s scratch;
+		item.property = mlt_property_init_in( &scratch );
 
 		refresh_animation( self, fps, locale, length );
 		mlt_animation_get_item( self->animation, &item, position );
 		pthread_mutex_unlock( &self->mutex );
 		result = mlt_property_get_double( item.property, fps, locale );
 
-		mlt_property_close( item.property );
+		mlt_property_close_in( item.property );
 	}
 	else
 	{
@@ -1417,14 +1650,15 @@ int mlt_property_anim_get_int( mlt_property self, double fps, locale_t locale, i
 	if ( self->animation || ( self->prop_string && strchr( self->prop_string, '=' ) ) )
 	{
 		struct mlt_animation_item_s item;
-		item.property = mlt_property_init();
+		struct mlt_property_s scratch;
+		item.property = mlt_property_init_in( &scratch );
 
 		refresh_animation( self, fps, locale, length );
 		mlt_animation_get_item( self->animation, &item, position );
 		pthread_mutex_unlock( &self->mutex );
 		result = mlt_property_get_int( item.property, fps, locale );
 
-		mlt_property_close( item.property );
+		mlt_property_close_in( item.property );
 	}
 	else
 	{
@@ -1453,13 +1687,15 @@ char* mlt_property_anim_get_string( mlt_property self, double fps, locale_t loca
 	if ( self->animation || ( self->prop_string && strchr( self->prop_string, '=' ) ) )
 	{
 		struct mlt_animation_item_s item;
-		item.property = mlt_property_init();
+		struct mlt_property_s scratch;
+		item.property = mlt_property_init_in( &scratch );
 
 		if ( !self->animation )
 			refresh_animation( self, fps, locale, length );
 		mlt_animation_get_item( self->animation, &item, position );
 
 		free( self->prop_string );
+		self->parsed_types = mlt_prop_none;
 
 		pthread_mutex_unlock( &self->mutex );
 		self->prop_string = mlt_property_get_string_l( item.property, locale );
@@ -1470,7 +1706,7 @@ char* mlt_property_anim_get_string( mlt_property self, double fps, locale_t loca
 		self->types |= mlt_prop_string;
 
 		result = self->prop_string;
-		mlt_property_close( item.property );
+		mlt_property_close_in( item.property );
 		pthread_mutex_unlock( &self->mutex );
 	}
 	else
@@ -1801,7 +2037,8 @@ mlt_rect mlt_property_anim_get_rect( mlt_property self, double fps, locale_t loc
 	if ( self->animation || ( self->prop_string && strchr( self->prop_string, '=' ) ) )
 	{
 		struct mlt_animation_item_s item;
-		item.property = mlt_property_init();
+		struct mlt_property_s scratch;
+		item.property = mlt_property_init_in( &scratch );
 		item.property->types = mlt_prop_rect;
 
 		refresh_animation( self, fps, locale, length );
@@ -1809,7 +2046,7 @@ mlt_rect mlt_property_anim_get_rect( mlt_property self, double fps, locale_t loc
 		pthread_mutex_unlock( &self->mutex );
 		result = mlt_property_get_rect( item.property, locale );
 
-		mlt_property_close( item.property );
+		mlt_property_close_in( item.property );
 	}
 	else
 	{
@@ -1818,3 +2055,279 @@ mlt_rect mlt_property_anim_get_rect( mlt_property self, double fps, locale_t loc
 	}
 	return result;
 }
+
+/** \brief a keyframe loaded for evaluating an animation over a range of frames */
+
+typedef struct
+{
+	int frame;
+	mlt_keyframe_type type;
+	int numeric;
+	double value;
+	mlt_rect rect;
+} range_key;
+
+/** Load the N-th keyframe for evaluating a range.
+ *
+ * \private \memberof mlt_property_s
+ * \param animation an animation
+ * \param index the N-th keyframe (0 based)
+ * \param scratch a property to receive the keyframe value
+ * \param fps the frame rate, which may be needed for converting a time string to frame units
+ * \param locale the locale, which may be needed for converting a string to a real number
+ * \param is_rect whether to convert the value to a rectangle instead of a real number
+ * \param[out] key the keyframe
+ */
+
+static void load_range_key( mlt_animation animation, int index, mlt_property scratch, double fps,
+	locale_t locale, int is_rect, range_key *key )
+{
+	struct mlt_animation_item_s item;
+
+	item.property = scratch;
+	mlt_animation_key_get( animation, &item, index );
+	key->frame = item.frame;
+	key->type = item.keyframe_type;
+	key->numeric = is_property_numeric( scratch, locale );
+	if ( is_rect )
+		key->rect = mlt_property_get_rect( scratch, locale );
+	else
+		key->value = mlt_property_get_double( scratch, fps, locale );
+}
+
+/** Evaluate an animated property over consecutive frames.
+ *
+ * The results are the same as calling mlt_property_anim_get_double() or
+ * mlt_property_anim_get_rect() for each frame, but the keyframes of a segment
+ * are only converted once and the property is only locked once.
+ * \private \memberof mlt_property_s
+ * \param self a property
+ * \param values an array of \p count real numbers to fill in, or NULL for rectangles
+ * \param rects an array of \p count rectangles to fill in, or NULL for real numbers
+ * \param fps the frame rate, which may be needed for converting a time string to frame units
+ * \param locale the locale, which may be needed for converting a string to a real number
+ * \param position the frame number of the first value
+ * \param count the number of values
+ * \param length the maximum number of frames when interpreting negative keyframe times,
+ *  <=0 if you don't care or need that
+ */
+
+static void anim_get_range( mlt_property self, double *values, mlt_rect *rects, double fps, locale_t locale,
+	int position, int count, int length )
+{
+	int is_rect = rects != NULL;
+	int n, i;
+
+	pthread_mutex_lock( &self->mutex );
+	if ( self->animation || ( self->prop_string && strchr( self->prop_string, '=' ) ) )
+	{
+		refresh_animation( self, fps, locale, length );
+		n = mlt_animation_key_count( self->animation );
+	}
+	else
+	{
+		pthread_mutex_unlock( &self->mutex );
+		if ( is_rect )
+		{
+			mlt_rect rect = mlt_property_get_rect( self, locale );
+			for ( i = 0; i < count; i++ )
+				rects[i] = rect;
+		}
+		else
+		{
+			double value = mlt_property_get_double( self, fps, locale );
+			for ( i = 0; i < count; i++ )
+				values[i] = value;
+		}
+		return;
+	}
+
+	if ( n <= 0 )
+	{
+		pthread_mutex_unlock( &self->mutex );
+		mlt_rect rect = { DBL_MIN, DBL_MIN, DBL_MIN, DBL_MIN, DBL_MIN };
+		for ( i = 0; i < count; i++ )
+		{
+			if ( is_rect )
+				rects[i] = rect;
+			else
+				values[i] = 0.0;
+		}
+		return;
+	}
+
+	// keys[1] starts the segment, keys[0] precedes it, and keys[2] and keys[3] follow it
+	range_key keys[4];
+	mlt_property scratch = mlt_property_init();
+	int current = -1;
+
+	for ( i = 0; i < count; )
+	{
+		int frame = position + i;
+		int index = mlt_animation_key_index( self->animation, frame );
+		int last = index + 1 == n;
+
+		if ( index != current )
+		{
+			if ( index == current + 1 && current >= 0 )
+			{
+				keys[0] = keys[1];
+				keys[1] = keys[2];
+				keys[2] = keys[3];
+			}
+			else
+			{
+				load_range_key( self->animation, index, scratch, fps, locale, is_rect, &keys[1] );
+				if ( index > 0 )
+					load_range_key( self->animation, index - 1, scratch, fps, locale, is_rect, &keys[0] );
+				else
+					keys[0] = keys[1];
+				if ( !last )
+					load_range_key( self->animation, index + 1, scratch, fps, locale, is_rect, &keys[2] );
+				else
+					keys[2] = keys[1];
+			}
+			if ( index + 2 < n )
+				load_range_key( self->animation, index + 2, scratch, fps, locale, is_rect, &keys[3] );
+			else
+				keys[3] = keys[2];
+			current = index;
+		}
+
+		// The number of frames in this segment
+		int run = count - i;
+		if ( !last && keys[2].frame - frame < run )
+			run = keys[2].frame - frame;
+
+		// The frames up to and including the keyframe and after the last one take its value
+		int hold = keys[1].frame - frame + 1;
+		if ( last || keys[1].type == mlt_keyframe_discrete || !keys[1].numeric || !keys[2].numeric )
+			hold = run;
+		if ( hold > 0 )
+		{
+			if ( hold > run )
+				hold = run;
+			for ( int j = 0; j < hold; j++ )
+			{
+				if ( is_rect )
+					rects[i + j] = keys[1].rect;
+				else
+					values[i + j] = keys[1].value;
+			}
+			i += hold;
+			frame += hold;
+			run -= hold;
+		}
+
+		// Interpolate the rest
+		int start = keys[1].frame;
+		double span = keys[2].frame - keys[1].frame;
+		if ( is_rect )
+		{
+			mlt_rect *out = &rects[i];
+			mlt_rect p0 = keys[0].rect, p1 = keys[1].rect, p2 = keys[2].rect, p3 = keys[3].rect;
+			if ( keys[1].type == mlt_keyframe_smooth )
+			{
+				for ( int j = 0; j < run; j++ )
+				{
+					double t = frame + j - start;
+					t /= span;
+					out[j].x = catmull_rom_interpolate( p0.x, p1.x, p2.x, p3.x, t );
+					out[j].y = catmull_rom_interpolate( p0.y, p1.y, p2.y, p3.y, t );
+					out[j].w = catmull_rom_interpolate( p0.w, p1.w, p2.w, p3.w, t );
+					out[j].h = catmull_rom_interpolate( p0.h, p1.h, p2.h, p3.h, t );
+					out[j].o = catmull_rom_interpolate( p0.o, p1.o, p2.o, p3.o, t );
+				}
+			}
+			else
+			{
+				for ( int j = 0; j < run; j++ )
+				{
+					double t = frame + j - start;
+					t /= span;
+					out[j].x = linear_interpolate( p1.x, p2.x, t );
+					out[j].y = linear_interpolate( p1.y, p2.y, t );
+					out[j].w = linear_interpolate( p1.w, p2.w, t );
+					out[j].h = linear_interpolate( p1.h, p2.h, t );
+					out[j].o = linear_interpolate( p1.o, p2.o, t );
+				}
+			}
+		}
+		else
+		{
+			double *out = &values[i];
+			double y0 = keys[0].value, y1 = keys[1].value, y2 = keys[2].value, y3 = keys[3].value;
+			if ( keys[1].type == mlt_keyframe_smooth )
+			{
+				for ( int j = 0; j < run; j++ )
+				{
+					double t = frame + j - start;
+					t /= span;
+					out[j] = catmull_rom_interpolate( y0, y1, y2, y3, t );
+				}
+			}
+			else
+			{
+				for ( int j = 0; j < run; j++ )
+				{
+					double t = frame + j - start;
+					t /= span;
+					out[j] = linear_interpolate( y1, y2, t );
+				}
+			}
+		}
+		i += run;
+	}
+	pthread_mutex_unlock( &self->mutex );
+	mlt_property_close( scratch );
+}
+
+/** Get the real numbers for a range of frame positions.
+ *
+ * This gives the same results as calling mlt_property_anim_get_double() for
+ * each position, which is much slower for a long range.
+ * \public \memberof mlt_property_s
+ * \param self a property
+ * \param values an array to receive \p count real numbers
+ * \param fps the frame rate, which may be needed for converting a time string to frame units
+ * \param locale the locale, which may be needed for converting a string to a real number
+ * \param position the frame number of the first value
+ * \param count the number of consecutive frames
+ * \param length the maximum number of frames when interpreting negative keyframe times,
+ *  <=0 if you don't care or need that
+ * \return true if there was an error
+ */
+
+int mlt_property_anim_get_double_range( mlt_property self, double *values, double fps, locale_t locale,
+	int position, int count, int length )
+{
+	if ( !self || !values || count < 0 )
+		return 1;
+	anim_get_range( self, values, NULL, fps, locale, position, count, length );
+	return 0;
+}
+
+/** Get the rectangles for a range of frame positions.
+ *
+ * This gives the same results as calling mlt_property_anim_get_rect() for
+ * each position, which is much slower for a long range.
+ * \public \memberof mlt_property_s
+ * \param self a property
+ * \param values an array to receive \p count rectangles
+ * \param fps the frame rate, which may be needed for converting a time string to frame units
+ * \param locale the locale, which may be needed for converting a string to a real number
+ * \param position the frame number of the first value
+ * \param count the number of consecutive frames
+ * \param length the maximum number of frames when interpreting negative keyframe times,
+ *  <=0 if you don't care or need that
+ * \return true if there was an error
+ */
+
+int mlt_property_anim_get_rect_range( mlt_property self, mlt_rect *values, double fps, locale_t locale,
+	int position, int count, int length )
+{
+	if ( !self || !values || count < 0 )
+		return 1;
+	anim_get_range( self, NULL, values, fps, locale, position, count, length );
+	return 0;
+}
@@ -42,6 +42,8 @@ typedef char* locale_t;
 #endif
 
 extern mlt_property mlt_property_init( );
+extern size_t mlt_property_struct_size( );
+extern mlt_property mlt_property_init_in( void *memory );
 extern void mlt_property_clear( mlt_property self );
 extern int mlt_property_is_clear( mlt_property self );
 extern int mlt_property_set_int( mlt_property self, int value );
@@ -60,11 +62,13 @@ extern char *mlt_property_get_string_l_tf( mlt_property self, locale_t, mlt_time
 extern char *mlt_property_get_string_l( mlt_property self, locale_t );
 extern void *mlt_property_get_data( mlt_property self, int *length );
 extern void mlt_property_close( mlt_property self );
+extern void mlt_property_close_in( mlt_property self );
 extern void mlt_property_pass( mlt_property self, mlt_property that );
 extern char *mlt_property_get_time( mlt_property self, mlt_time_format, double fps, locale_t );
 
 extern int mlt_property_interpolate( mlt_property self, mlt_property points[], double progress, double fps, locale_t locale, mlt_keyframe_type interp );
 extern double mlt_property_anim_get_double( mlt_property self, double fps, locale_t locale, int position, int length );
+extern int mlt_property_anim_get_double_range( mlt_property self, double *values, double fps, locale_t locale, int position, int count, int length );
 extern int mlt_property_anim_get_int( mlt_property self, double fps, locale_t locale, int position, int length );
 extern char* mlt_property_anim_get_string( mlt_property self, double fps, locale_t locale, int position, int length );
 extern int mlt_property_anim_set_double( mlt_property self, double value, double fps, locale_t locale, int position, int length, mlt_keyframe_type keyframe_type );
@@ -76,5 +80,6 @@ extern int mlt_property_set_rect( mlt_property self, mlt_rect value );
 extern mlt_rect mlt_property_get_rect( mlt_property self, locale_t locale );
 extern int mlt_property_anim_set_rect( mlt_property self, mlt_rect value, double fps, locale_t locale, int position, int length, mlt_keyframe_type keyframe_type );
 extern mlt_rect mlt_property_anim_get_rect( mlt_property self, double fps, locale_t locale, int position, int length );
+extern int mlt_property_anim_get_rect_range( mlt_property self, mlt_rect *values, double fps, locale_t locale, int position, int count, int length );
 
 #endif
@@ -32,12 +32,20 @@
 #include <string.h>
 #include <limits.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <sys/stat.h>
 
 /** \brief Repository class
  *
  * The Repository is a collection of plugin modules and their services and service metadata.
  *
+ * When the environment variable MLT_REPOSITORY_INDEX names a file, the repository
+ * keeps an index there of the services each module registers. While the index
+ * matches the modules on disk, the repository lists the services from it and only
+ * loads a module when one of its services is first created or its metadata is
+ * requested. Otherwise it loads every module and writes a new index.
+ *
  * \extends mlt_properties_s
  * \properties \p language a cached list of user locales
  */
@@ -50,8 +58,242 @@ struct mlt_repository_s
 	mlt_properties links;           /// a list of entry points for links
 	mlt_properties producers;       /// a list of entry points for producers
 	mlt_properties transitions;     /// a list of entry points for transitions
+	const char *loading;            /// the object file whose services are being registered
+	pthread_mutex_t load_mutex;     /// serialises loading the modules listed by the index
+	pthread_mutex_t cache_mutex;    /// guards the metadata cache
+	int cache_loaded;               /// whether the metadata cache file has been read
+	char *cache;                    /// the contents of the metadata cache file
+	size_t cache_size;              /// the size of the metadata cache file
+	mlt_properties cache_index;     /// the offsets of the entries in the cache file
+	mlt_properties cache_new;       /// the entries to add to the cache file
+	mlt_properties cache_stamps;    /// the modification times and sizes of the modules
 };
 
+/** The names of the service classes in the index. */
+
+static const struct
+{
+	mlt_service_type type;
+	const char *name;
+}
+index_types[] =
+{
+	{ mlt_service_consumer_type, "consumer" },
+	{ mlt_service_filter_type, "filter" },
+	{ mlt_service_link_type, "link" },
+	{ mlt_service_producer_type, "producer" },
+	{ mlt_service_transition_type, "transition" },
+};
+
+#define INDEX_TYPES ( sizeof( index_types ) / sizeof( index_types[0] ) )
+
+static mlt_properties get_service_list( mlt_repository self, mlt_service_type type );
+static void write_metadata_cache( mlt_repository self );
+
+/** Close the shared object of a module, as a destructor of the repository properties.
+ *
+ * \private \memberof mlt_repository_s
+ * \param object the handle returned by dlopen
+ */
+
+static void close_module( void *object )
+{
+	dlclose( object );
+}
+
+/** Load a module and register its services.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ * \param object_name the full path of the shared object
+ * \return true if it is not a module
+ */
+
+static int load_module( mlt_repository self, const char *object_name )
+{
+	int error = 1;
+
+	// Open the shared object
+	void *object = dlopen( object_name, RTLD_NOW );
+	if ( object != NULL )
+	{
+		// Get the registration function
+		mlt_repository_callback symbol_ptr = dlsym( object, "mlt_register" );
+
+		// Call the registration function
+		if ( symbol_ptr != NULL )
+		{
+			self->loading = object_name;
+			symbol_ptr( self );
+			self->loading = NULL;
+
+			// Register the object file for closure
+			mlt_properties_set_data( &self->parent, object_name, object, 0, close_module, NULL );
+			error = 0;
+		}
+		else
+		{
+			dlclose( object );
+		}
+	}
+	else if ( strstr( object_name, "libmlt" ) )
+	{
+		mlt_log_warning( NULL, "%s: failed to dlopen %s\n  (%s)\n", __FUNCTION__, object_name, dlerror() );
+	}
+	return error;
+}
+
+/** Check that a file has not changed since it was written to the index.
+ *
+ * \private \memberof mlt_repository_s
+ * \param filename the full path of a file
+ * \param mtime the modification time from the index
+ * \param size the size from the index
+ * \return true if the file is missing or changed
+ */
+
+static int index_stale( const char *filename, long long mtime, long long size )
+{
+	struct stat info;
+	return stat( filename, &info ) || (long long) info.st_mtime != mtime || (long long) info.st_size != size;
+}
+
+/** List the services of the modules from an index without loading them.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ * \param directory the directory of the modules
+ * \param filename the index file
+ * \return true if the index is missing or does not match the modules
+ */
+
+static int read_index( mlt_repository self, const char *directory, const char *filename )
+{
+	FILE *file = fopen( filename, "r" );
+	if ( !file )
+		return 1;
+
+	char line[ PATH_MAX + 64 ];
+	char module[ PATH_MAX ] = "";
+	int error = 1;
+	int services = 0;
+	long long mtime, size;
+	int offset;
+
+	while ( fgets( line, sizeof( line ), file ) )
+	{
+		line[ strcspn( line, "\r\n" ) ] = '\0';
+		if ( line[0] == '#' || line[0] == '\0' )
+			continue;
+		if ( sscanf( line, "directory %lld %lld %n", &mtime, &size, &offset ) == 2 )
+		{
+			// Any module added to or removed from the directory changes it
+			error = strcmp( line + offset, directory ) || index_stale( directory, mtime, size );
+		}
+		else if ( sscanf( line, "module %lld %lld %n", &mtime, &size, &offset ) == 2 )
+		{
+			strncpy( module, line + offset, sizeof( module ) - 1 );
+			error = index_stale( module, mtime, size );
+		}
+		else
+		{
+			// A service line is the class followed by the name
+			size_t i;
+			error = 1;
+			for ( i = 0; i < INDEX_TYPES && module[0]; i++ )
+			{
+				size_t n = strlen( index_types[i].name );
+				if ( !strncmp( line, index_types[i].name, n ) && line[n] == ' ' )
+				{
+					mlt_properties properties = mlt_properties_new();
+					mlt_properties_set( properties, "module", module );
+					mlt_properties_set_data( get_service_list( self, index_types[i].type ), line + n + 1, properties, 0, ( mlt_destructor )mlt_properties_close, NULL );
+					services++;
+					error = 0;
+					break;
+				}
+			}
+		}
+		if ( error )
+			break;
+	}
+	fclose( file );
+
+	if ( error || !services )
+	{
+		// Start again from the modules
+		mlt_properties_close( self->consumers );
+		mlt_properties_close( self->filters );
+		mlt_properties_close( self->links );
+		mlt_properties_close( self->producers );
+		mlt_properties_close( self->transitions );
+		self->consumers = mlt_properties_new();
+		self->filters = mlt_properties_new();
+		self->links = mlt_properties_new();
+		self->producers = mlt_properties_new();
+		self->transitions = mlt_properties_new();
+		mlt_log_verbose( NULL, "%s: rebuilding the stale index %s\n", __FUNCTION__, filename );
+		return 1;
+	}
+	return 0;
+}
+
+/** Write the services of the loaded modules to an index.
+ *
+ * The index is written to a temporary file and renamed so that other
+ * processes never read a partial one.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ * \param directory the directory of the modules
+ * \param filename the index file
+ */
+
+static void write_index( mlt_repository self, const char *directory, const char *filename )
+{
+	char temp[ PATH_MAX ];
+	struct stat info;
+	int i, j;
+	size_t t;
+
+	if ( stat( directory, &info ) )
+		return;
+	snprintf( temp, sizeof( temp ), "%s.%d", filename, (int) getpid() );
+	FILE *file = fopen( temp, "w" );
+	if ( !file )
+	{
+		mlt_log_warning( NULL, "%s: failed to write %s\n", __FUNCTION__, filename );
+		return;
+	}
+	fprintf( file, "# MLT service index, rebuilt when a module changes\n" );
+	fprintf( file, "directory %lld %lld %s\n", (long long) info.st_mtime, (long long) info.st_size, directory );
+
+	// The modules are the object files registered for closure
+	for ( i = 0; i < mlt_properties_count( &self->parent ); i++ )
+	{
+		const char *module = mlt_properties_get_name( &self->parent, i );
+		if ( !module || strncmp( module, directory, strlen( directory ) ) || stat( module, &info ) )
+			continue;
+		fprintf( file, "module %lld %lld %s\n", (long long) info.st_mtime, (long long) info.st_size, module );
+		for ( t = 0; t < INDEX_TYPES; t++ )
+		{
+			mlt_properties list = get_service_list( self, index_types[t].type );
+			for ( j = 0; j < mlt_properties_count( list ); j++ )
+			{
+				mlt_properties properties = mlt_properties_get_data_at( list, j, NULL );
+				const char *owner = properties ? mlt_properties_get( properties, "module" ) : NULL;
+				if ( owner && !strcmp( owner, module ) )
+					fprintf( file, "%s %s\n", index_types[t].name, mlt_properties_get_name( list, j ) );
+			}
+		}
+	}
+	if ( fclose( file ) || rename( temp, filename ) )
+	{
+		mlt_log_warning( NULL, "%s: failed to write %s\n", __FUNCTION__, filename );
+		remove( temp );
+	}
+}
+
 /** Construct a new repository.
  *
  * \public \memberof mlt_repository_s
@@ -73,6 +315,8 @@ mlt_repository mlt_repository_init( const char *directory )
 	self->links = mlt_properties_new();
 	self->producers = mlt_properties_new();
 	self->transitions = mlt_properties_new();
+	pthread_mutex_init( &self->load_mutex, NULL );
+	pthread_mutex_init( &self->cache_mutex, NULL );
 
 	// Get the directory list
 	mlt_properties dir = mlt_properties_new();
@@ -98,39 +342,24 @@ mlt_repository mlt_repository_init( const char *directory )
 	free(newpath);
 #endif
 
+	// List the services from the index if it is current
+	const char *index = getenv( "MLT_REPOSITORY_INDEX" );
+	if ( index && index[0] && !read_index( self, directory, index ) )
+	{
+		mlt_properties_close( dir );
+		return self;
+	}
+
 	// Iterate over files
 	for ( i = 0; i < count; i++ )
 	{
-		int flags = RTLD_NOW;
-		const char *object_name = mlt_properties_get_value( dir, i);
-
-		// Open the shared object
-		void *object = dlopen( object_name, flags );
-		if ( object != NULL )
-		{
-			// Get the registration function
-			mlt_repository_callback symbol_ptr = dlsym( object, "mlt_register" );
-
-			// Call the registration function
-			if ( symbol_ptr != NULL )
-			{
-				symbol_ptr( self );
-
-				// Register the object file for closure
-				mlt_properties_set_data( &self->parent, object_name, object, 0, ( mlt_destructor )dlclose, NULL );
-				++plugin_count;
-			}
-			else
-			{
-				dlclose( object );
-			}
-		}
-		else if ( strstr( object_name, "libmlt" ) )
-		{
-			mlt_log_warning( NULL, "%s: failed to dlopen %s\n  (%s)\n", __FUNCTION__, object_name, dlerror() );
-		}
+		if ( !load_module( self, mlt_properties_get_value( dir, i ) ) )
+			++plugin_count;
 	}
 
+	if ( index && index[0] && plugin_count )
+		write_index( self, directory, index );
+
 	if ( !plugin_count )
 		mlt_log_error( NULL, "%s: no plugins found in \"%s\"\n", __FUNCTION__, directory );
 
@@ -167,26 +396,53 @@ static mlt_properties new_service( void *symbol )
 void mlt_repository_register( mlt_repository self, mlt_service_type service_type, const char *service, mlt_register_callback symbol )
 {
 	// Add the entry point to the corresponding service list
-	switch ( service_type )
+	mlt_properties list = get_service_list( self, service_type );
+	if ( list )
+	{
+		mlt_properties properties = mlt_properties_get_data( list, service, NULL );
+		if ( properties && !mlt_properties_get_data( properties, "symbol", NULL ) )
+		{
+			// Complete the service listed by the index in place, since it may be in use
+			mlt_properties_set_data( properties, "symbol", symbol, 0, NULL, NULL );
+		}
+		else
+		{
+			properties = new_service( symbol );
+			mlt_properties_set_data( list, service, properties, 0, ( mlt_destructor )mlt_properties_close, NULL );
+		}
+		if ( self->loading )
+			mlt_properties_set( properties, "module", self->loading );
+	}
+	else
+	{
+		mlt_log_error( NULL, "%s: Unable to register \"%s\"\n", __FUNCTION__, service );
+	}
+}
+
+/** Get the list of services of a service class.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ * \param type a service class
+ * \return a properties list or NULL if error
+ */
+
+static mlt_properties get_service_list( mlt_repository self, mlt_service_type type )
+{
+	switch ( type )
 	{
 		case mlt_service_consumer_type:
-			mlt_properties_set_data( self->consumers, service, new_service( symbol ), 0, ( mlt_destructor )mlt_properties_close, NULL );
-			break;
+			return self->consumers;
 		case mlt_service_filter_type:
-			mlt_properties_set_data( self->filters, service, new_service( symbol ), 0, ( mlt_destructor )mlt_properties_close, NULL );
-			break;
+			return self->filters;
 		case mlt_service_link_type:
-			mlt_properties_set_data( self->links, service, new_service( symbol ), 0, ( mlt_destructor )mlt_properties_close, NULL );
-			break;
+			return self->links;
 		case mlt_service_producer_type:
-			mlt_properties_set_data( self->producers, service, new_service( symbol ), 0, ( mlt_destructor )mlt_properties_close, NULL );
-			break;
+			return self->producers;
 		case mlt_service_transition_type:
-			mlt_properties_set_data( self->transitions, service, new_service( symbol ), 0, ( mlt_destructor )mlt_properties_close, NULL );
-			break;
+			return self->transitions;
 		default:
-			mlt_log_error( NULL, "%s: Unable to register \"%s\"\n", __FUNCTION__, service );
-			break;
+			return NULL;
 	}
 }
 
@@ -201,30 +457,452 @@ void mlt_repository_register( mlt_repository self, mlt_service_type service_type
 
 static mlt_properties get_service_properties( mlt_repository self, mlt_service_type type, const char *service )
 {
-	mlt_properties service_properties = NULL;
+	mlt_properties list = get_service_list( self, type );
+	return list ? mlt_properties_get_data( list, service, NULL ) : NULL;
+}
 
-	// Get the entry point from the corresponding service list
-	switch ( type )
+/** Get the repository properties for a service, loading its module if the index listed it.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ * \param type a service class
+ * \param service the name of a service
+ * \return a properties list or NULL if error
+ */
+
+static mlt_properties load_service_properties( mlt_repository self, mlt_service_type type, const char *service )
+{
+	mlt_properties properties = get_service_properties( self, type, service );
+	if ( properties && !mlt_properties_get_data( properties, "symbol", NULL ) && mlt_properties_get( properties, "module" ) )
 	{
-		case mlt_service_consumer_type:
-			service_properties = mlt_properties_get_data( self->consumers, service, NULL );
-			break;
-		case mlt_service_filter_type:
-			service_properties = mlt_properties_get_data( self->filters, service, NULL );
-			break;
-		case mlt_service_link_type:
-			service_properties = mlt_properties_get_data( self->links, service, NULL );
-			break;
-		case mlt_service_producer_type:
-			service_properties = mlt_properties_get_data( self->producers, service, NULL );
-			break;
-		case mlt_service_transition_type:
-			service_properties = mlt_properties_get_data( self->transitions, service, NULL );
-			break;
-		default:
-			break;
+		pthread_mutex_lock( &self->load_mutex );
+		if ( !mlt_properties_get_data( properties, "symbol", NULL ) )
+		{
+			// Registering the services replaces the module string
+			char *module = strdup( mlt_properties_get( properties, "module" ) );
+			if ( !mlt_properties_get_data( &self->parent, module, NULL ) )
+				load_module( self, module );
+			free( module );
+		}
+		pthread_mutex_unlock( &self->load_mutex );
+	}
+	return properties;
+}
+
+/** The version of the metadata cache file format. */
+
+#define METADATA_CACHE_MAGIC "MLTMETA"
+#define METADATA_CACHE_VERSION 1
+
+/** \brief a growable buffer for writing the metadata cache */
+
+typedef struct
+{
+	char *data;
+	size_t size;
+	size_t alloc;
+} cache_buffer;
+
+static void cache_put( cache_buffer *buffer, const void *data, size_t size )
+{
+	if ( buffer->size + size > buffer->alloc )
+	{
+		size_t alloc = buffer->alloc ? buffer->alloc * 2 : 4096;
+		while ( alloc < buffer->size + size )
+			alloc *= 2;
+		char *grown = realloc( buffer->data, alloc );
+		if ( !grown )
+			return;
+		buffer->data = grown;
+		buffer->alloc = alloc;
 	}
-	return service_properties;
+	memcpy( buffer->data + buffer->size, data, size );
+	buffer->size += size;
+}
+
+static void cache_put_uint32( cache_buffer *buffer, uint32_t value )
+{
+	cache_put( buffer, &value, sizeof( value ) );
+}
+
+static void cache_put_string( cache_buffer *buffer, const char *value )
+{
+	uint32_t length = value ? strlen( value ) : 0;
+	cache_put_uint32( buffer, length );
+	cache_put( buffer, value, length );
+}
+
+/** Write a metadata tree to the cache.
+ *
+ * Like mlt_properties_serialise_yaml(), this assumes that every data item is a
+ * nested properties list.
+ */
+
+static void cache_put_properties( cache_buffer *buffer, mlt_properties properties )
+{
+	int count = mlt_properties_count( properties );
+	int i;
+
+	cache_put_uint32( buffer, count );
+	for ( i = 0; i < count; i++ )
+	{
+		const char *name = mlt_properties_get_name( properties, i );
+		const char *value = mlt_properties_get_value( properties, i );
+		mlt_properties child = mlt_properties_get_data_at( properties, i, NULL );
+
+		cache_put_string( buffer, name );
+		if ( value || !child )
+		{
+			cache_put( buffer, "s", 1 );
+			cache_put_string( buffer, value );
+		}
+		else
+		{
+			cache_put( buffer, "p", 1 );
+			cache_put_properties( buffer, child );
+		}
+	}
+}
+
+/** \brief a reader of the metadata cache */
+
+typedef struct
+{
+	const char *data;
+	size_t size;
+	size_t offset;
+	int error;
+} cache_reader;
+
+static const char *cache_get( cache_reader *reader, size_t size )
+{
+	if ( reader->error || reader->size - reader->offset < size )
+	{
+		reader->error = 1;
+		return NULL;
+	}
+	reader->offset += size;
+	return reader->data + reader->offset - size;
+}
+
+static uint32_t cache_get_uint32( cache_reader *reader )
+{
+	uint32_t value = 0;
+	const char *data = cache_get( reader, sizeof( value ) );
+	if ( data )
+		memcpy( &value, data, sizeof( value ) );
+	return value;
+}
+
+static char *cache_get_string( cache_reader *reader )
+{
+	uint32_t length = cache_get_uint32( reader );
+	const char *data = cache_get( reader, length );
+	char *value = data ? malloc( length + 1 ) : NULL;
+	if ( value )
+	{
+		memcpy( value, data, length );
+		value[ length ] = '\0';
+	}
+	return value;
+}
+
+static mlt_properties cache_get_properties( cache_reader *reader, int depth )
+{
+	mlt_properties properties = mlt_properties_new();
+	uint32_t count = cache_get_uint32( reader );
+	uint32_t i;
+
+	mlt_properties_set_lcnumeric( properties, "C" );
+	for ( i = 0; i < count && !reader->error && depth < 64; i++ )
+	{
+		char *name = cache_get_string( reader );
+		const char *kind = cache_get( reader, 1 );
+		if ( name && kind && *kind == 's' )
+		{
+			char *value = cache_get_string( reader );
+			mlt_properties_set_string( properties, name, value );
+			free( value );
+		}
+		else if ( name && kind && *kind == 'p' )
+		{
+			mlt_properties child = cache_get_properties( reader, depth + 1 );
+			mlt_properties_set_data( properties, name, child, 0, ( mlt_destructor )mlt_properties_close, NULL );
+		}
+		else
+		{
+			reader->error = 1;
+		}
+		free( name );
+	}
+	if ( reader->error || depth >= 64 )
+	{
+		reader->error = 1;
+		mlt_properties_close( properties );
+		properties = NULL;
+	}
+	return properties;
+}
+
+/** Get the key of the metadata of a service in the cache.
+ */
+
+static void cache_key( char *key, size_t size, mlt_service_type type, const char *service )
+{
+	snprintf( key, size, "%d:%s", (int) type, service );
+}
+
+/** Get the modification time and size of a module, remembering it for later.
+ *
+ * \private \memberof mlt_repository_s
+ * \return the modification time and size as a string, or NULL if the module is missing
+ */
+
+static const char *cache_stamp( mlt_repository self, const char *module )
+{
+	const char *stamp = mlt_properties_get( self->cache_stamps, module );
+	if ( !stamp )
+	{
+		struct stat info;
+		char value[ 64 ];
+		if ( stat( module, &info ) )
+			return NULL;
+		snprintf( value, sizeof( value ), "%lld %lld", (long long) info.st_mtime, (long long) info.st_size );
+		mlt_properties_set( self->cache_stamps, module, value );
+		stamp = mlt_properties_get( self->cache_stamps, module );
+	}
+	return stamp;
+}
+
+/** Get the languages list as one string, since metadata can depend on the locale.
+ */
+
+static char *cache_languages( mlt_repository self )
+{
+	mlt_properties languages = mlt_repository_languages( self );
+	cache_buffer buffer = { NULL, 0, 0 };
+	int i;
+
+	for ( i = 0; i < mlt_properties_count( languages ); i++ )
+	{
+		const char *language = mlt_properties_get_value( languages, i );
+		if ( i )
+			cache_put( &buffer, ":", 1 );
+		cache_put( &buffer, language, strlen( language ) );
+	}
+	cache_put( &buffer, "", 1 );
+	return buffer.data;
+}
+
+/** Read the metadata cache file named by MLT_METADATA_CACHE.
+ *
+ * The file is read once and indexed by class and service. It is ignored if
+ * its version or languages differ.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ * \return true if there is no metadata cache
+ */
+
+static int read_metadata_cache( mlt_repository self )
+{
+	const char *filename = getenv( "MLT_METADATA_CACHE" );
+
+	if ( self->cache_loaded )
+		return self->cache_index == NULL;
+	self->cache_loaded = 1;
+	if ( !filename || !filename[0] )
+		return 1;
+
+	self->cache_index = mlt_properties_new();
+	self->cache_new = mlt_properties_new();
+	self->cache_stamps = mlt_properties_new();
+
+	FILE *file = fopen( filename, "rb" );
+	if ( !file )
+		return 0;
+	if ( !fseek( file, 0, SEEK_END ) )
+	{
+		long size = ftell( file );
+		rewind( file );
+		if ( size > 0 && ( self->cache = malloc( size ) ) )
+		{
+			if ( fread( self->cache, 1, size, file ) == (size_t) size )
+				self->cache_size = size;
+		}
+	}
+	fclose( file );
+
+	cache_reader reader = { self->cache, self->cache_size, 0, 0 };
+	const char *magic = cache_get( &reader, sizeof( METADATA_CACHE_MAGIC ) );
+	uint32_t version = cache_get_uint32( &reader );
+	char *languages = cache_get_string( &reader );
+	char *current = cache_languages( self );
+	uint32_t count = cache_get_uint32( &reader );
+
+	if ( magic && !memcmp( magic, METADATA_CACHE_MAGIC, sizeof( METADATA_CACHE_MAGIC ) )
+		&& version == METADATA_CACHE_VERSION && languages && current && !strcmp( languages, current ) )
+	{
+		// Each entry is the class, service, module, module stamp and metadata
+		uint32_t i;
+		for ( i = 0; i < count && !reader.error; i++ )
+		{
+			size_t offset = reader.offset;
+			uint32_t type = cache_get_uint32( &reader );
+			char *service = cache_get_string( &reader );
+			cache_get( &reader, cache_get_uint32( &reader ) );
+			cache_get( &reader, cache_get_uint32( &reader ) );
+			cache_get( &reader, cache_get_uint32( &reader ) );
+			if ( service && !reader.error )
+			{
+				char key[ 256 ];
+				cache_key( key, sizeof( key ), type, service );
+				mlt_properties_set_int64( self->cache_index, key, offset );
+			}
+			free( service );
+		}
+	}
+	free( languages );
+	free( current );
+	return 0;
+}
+/** Get the metadata of a service from the cache.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ * \param type a service class
+ * \param service the name of a service
+ * \param module the module that registers the service
+ * \return the metadata or NULL if it is not cached or its module changed
+ */
+
+static mlt_properties lookup_metadata_cache( mlt_repository self, mlt_service_type type, const char *service, const char *module )
+{
+	mlt_properties metadata = NULL;
+	char key[ 256 ];
+
+	pthread_mutex_lock( &self->cache_mutex );
+	cache_key( key, sizeof( key ), type, service );
+	if ( !read_metadata_cache( self ) && mlt_properties_get( self->cache_index, key ) )
+	{
+		cache_reader reader = { self->cache, self->cache_size, mlt_properties_get_int64( self->cache_index, key ), 0 };
+		const char *stamp = cache_stamp( self, module );
+		char *cached_module, *cached_stamp;
+
+		cache_get_uint32( &reader );
+		free( cache_get_string( &reader ) );
+		cached_module = cache_get_string( &reader );
+		cached_stamp = cache_get_string( &reader );
+		cache_get_uint32( &reader );
+		if ( !reader.error && stamp && !strcmp( cached_module, module ) && !strcmp( cached_stamp, stamp ) )
+			metadata = cache_get_properties( &reader, 0 );
+		free( cached_module );
+		free( cached_stamp );
+	}
+	pthread_mutex_unlock( &self->cache_mutex );
+	return metadata;
+}
+
+/** Add the metadata of a service to the cache.
+ *
+ * The entry is kept in memory and written to the file when the repository closes.
+ *
+ * \private \memberof mlt_repository_s
+ */
+
+static void store_metadata_cache( mlt_repository self, mlt_service_type type, const char *service, const char *module, mlt_properties metadata )
+{
+	pthread_mutex_lock( &self->cache_mutex );
+	const char *stamp = read_metadata_cache( self ) ? NULL : cache_stamp( self, module );
+	if ( stamp )
+	{
+		cache_buffer entry = { NULL, 0, 0 };
+		cache_buffer blob = { NULL, 0, 0 };
+		char key[ 256 ];
+
+		cache_put_properties( &blob, metadata );
+		cache_put_uint32( &entry, type );
+		cache_put_string( &entry, service );
+		cache_put_string( &entry, module );
+		cache_put_string( &entry, stamp );
+		cache_put_uint32( &entry, blob.size );
+		cache_put( &entry, blob.data, blob.size );
+		free( blob.data );
+		if ( entry.data )
+		{
+			cache_key( key, sizeof( key ), type, service );
+			mlt_properties_set_data( self->cache_new, key, entry.data, entry.size, free, NULL );
+		}
+	}
+	pthread_mutex_unlock( &self->cache_mutex );
+}
+
+/** Write the metadata cache file if this process added entries.
+ *
+ * The entries already in the file whose modules have not changed are kept.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ */
+
+static void write_metadata_cache( mlt_repository self )
+{
+	const char *filename = getenv( "MLT_METADATA_CACHE" );
+	if ( !self->cache_new || !mlt_properties_count( self->cache_new ) || !filename || !filename[0] )
+		return;
+
+	cache_buffer buffer = { NULL, 0, 0 };
+	char *languages = cache_languages( self );
+	uint32_t count = 0;
+	int i;
+
+	cache_put( &buffer, METADATA_CACHE_MAGIC, sizeof( METADATA_CACHE_MAGIC ) );
+	cache_put_uint32( &buffer, METADATA_CACHE_VERSION );
+	cache_put_string( &buffer, languages );
+	size_t count_offset = buffer.size;
+	cache_put_uint32( &buffer, 0 );
+	free( languages );
+
+	for ( i = 0; i < mlt_properties_count( self->cache_index ); i++ )
+	{
+		const char *key = mlt_properties_get_name( self->cache_index, i );
+		if ( mlt_properties_get_data( self->cache_new, key, NULL ) )
+			continue;
+		cache_reader reader = { self->cache, self->cache_size, mlt_properties_get_int64( self->cache_index, key ), 0 };
+		size_t offset = reader.offset;
+		cache_get_uint32( &reader );
+		free( cache_get_string( &reader ) );
+		char *module = cache_get_string( &reader );
+		char *stamp = cache_get_string( &reader );
+		cache_get( &reader, cache_get_uint32( &reader ) );
+		const char *current = module ? cache_stamp( self, module ) : NULL;
+		if ( !reader.error && stamp && current && !strcmp( stamp, current ) )
+		{
+			cache_put( &buffer, self->cache + offset, reader.offset - offset );
+			count++;
+		}
+		free( module );
+		free( stamp );
+	}
+	for ( i = 0; i < mlt_properties_count( self->cache_new ); i++ )
+	{
+		int size = 0;
+		void *entry = mlt_properties_get_data_at( self->cache_new, i, &size );
+		cache_put( &buffer, entry, size );
+		count++;
+	}
+	if ( buffer.data )
+		memcpy( buffer.data + count_offset, &count, sizeof( count ) );
+
+	char temp[ PATH_MAX ];
+	snprintf( temp, sizeof( temp ), "%s.%d", filename, (int) getpid() );
+	FILE *file = fopen( temp, "wb" );
+	if ( !file || fwrite( buffer.data, 1, buffer.size, file ) != buffer.size || fclose( file ) || rename( temp, filename ) )
+	{
+		mlt_log_warning( NULL, "%s: failed to write %s\n", __FUNCTION__, filename );
+		remove( temp );
+	}
+	free( buffer.data );
 }
 
 /** Construct a new instance of a service.
@@ -239,7 +917,7 @@ static mlt_properties get_service_properties( mlt_repository self, mlt_service_t
 
 void *mlt_repository_create( mlt_repository self, mlt_profile profile, mlt_service_type type, const char *service, const void *input )
 {
-	mlt_properties properties = get_service_properties( self, type, service );
+	mlt_properties properties = load_service_properties( self, type, service );
 	if ( properties != NULL )
 	{
 		mlt_register_callback symbol_ptr = mlt_properties_get_data( properties, "symbol", NULL );
@@ -262,7 +940,14 @@ void mlt_repository_close( mlt_repository self )
 	mlt_properties_close( self->filters );
 	mlt_properties_close( self->producers );
 	mlt_properties_close( self->transitions );
+	write_metadata_cache( self );
+	mlt_properties_close( self->cache_index );
+	mlt_properties_close( self->cache_new );
+	mlt_properties_close( self->cache_stamps );
+	free( self->cache );
 	mlt_properties_close( &self->parent );
+	pthread_mutex_destroy( &self->load_mutex );
+	pthread_mutex_destroy( &self->cache_mutex );
 	free( self );
 }
 
@@ -346,6 +1031,19 @@ void mlt_repository_register_metadata( mlt_repository self, mlt_service_type typ
 	mlt_properties_set_data( service_properties, "metadata_cb_data", callback_data, 0, NULL, NULL );
 }
 
+/** Serialise the metadata of a service as YAML, as the serialiser of its properties.
+ *
+ * \private \memberof mlt_repository_s
+ * \param metadata the metadata properties
+ * \param length unused
+ * \return the YAML, which the caller frees
+ */
+
+static char *serialise_metadata( void *metadata, int length )
+{
+	return mlt_properties_serialise_yaml( metadata );
+}
+
 /** Get the metadata about a service.
  *
  * Returns NULL if service or its metadata are unavailable.
@@ -367,8 +1065,19 @@ mlt_properties mlt_repository_metadata( mlt_repository self, mlt_service_type ty
 	{
 		// Lookup cached metadata
 		metadata = mlt_properties_get_data( properties, "metadata", NULL );
+		char *module = mlt_properties_get( properties, "module" ) ? strdup( mlt_properties_get( properties, "module" ) ) : NULL;
+
+		// Then the cache file, which does not need the module to be loaded
+		if ( ! metadata && module )
+		{
+			metadata = lookup_metadata_cache( self, type, service, module );
+			if ( metadata )
+				mlt_properties_set_data( properties, "metadata", metadata, 0, ( mlt_destructor )mlt_properties_close, serialise_metadata );
+		}
 		if ( ! metadata )
 		{
+			load_service_properties( self, type, service );
+
 			// Not cached, so get the registered metadata callback function
 			mlt_metadata_callback callback = mlt_properties_get_data( properties, "metadata_cb", NULL );
 
@@ -383,10 +1092,15 @@ mlt_properties mlt_repository_metadata( mlt_repository self, mlt_service_type ty
 
 				// Cache the metadata
 				if ( metadata )
+				{
+					if ( module )
+						store_metadata_cache( self, type, service, module, metadata );
 					// Include dellocation and serialisation
-					mlt_properties_set_data( properties, "metadata", metadata, 0, ( mlt_destructor )mlt_properties_close, ( mlt_serialiser )mlt_properties_serialise_yaml );
+					mlt_properties_set_data( properties, "metadata", metadata, 0, ( mlt_destructor )mlt_properties_close, serialise_metadata );
+				}
 			}
 		}
+		free( module );
 	}
 	return metadata;
 }
@@ -0,0 +1,356 @@
+/**
+ * \file mlt_ring.c
+ * \brief bounded lock-free queue
+ * \see mlt_ring_s
+ *
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Local header files
+#include "mlt_ring.h"
+
+// System header files
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <time.h>
+#include <stdatomic.h>
+
+/** the number of times to check before a waiting thread sleeps */
+#define SPIN_COUNT 200
+
+/** \brief private to mlt_ring_s, a slot of the ring
+ *
+ * The sequence number tells whose turn it is: a producer may fill the slot
+ * when it equals the position, and a consumer may empty it when it equals
+ * the position plus one.
+ */
+
+typedef struct
+{
+	atomic_size_t sequence;
+	void *item;
+}
+ring_slot;
+
+/** \brief Ring class
+ *
+ * A bounded first-in first-out queue of pointers that any number of threads
+ * can push to and pop from without taking a lock. The blocking functions
+ * spin briefly and then sleep on a condition variable, which is only
+ * signalled when a thread is actually sleeping, so in the steady state
+ * handing an item over makes no system calls.
+ */
+
+struct mlt_ring_s
+{
+	ring_slot *slots;
+	size_t mask;
+	atomic_size_t head;     /**< the position of the next item to pop */
+	atomic_size_t tail;     /**< the position of the next item to push */
+	atomic_int count;       /**< the number of items completely pushed and not yet popped */
+	atomic_int waiting;     /**< the number of threads sleeping on \p cond */
+	atomic_int interrupted; /**< makes blocked and blocking calls return */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+/** Create a ring.
+ *
+ * \public \memberof mlt_ring_s
+ * \param capacity the minimum number of items the ring must hold, rounded up to a power of two
+ * \return a new ring or NULL on error
+ */
+
+mlt_ring mlt_ring_init( int capacity )
+{
+	mlt_ring self = calloc( 1, sizeof( struct mlt_ring_s ) );
+	size_t size = 2, i;
+
+	while ( size < ( size_t )capacity )
+		size <<= 1;
+	if ( self )
+	{
+		self->slots = calloc( size, sizeof( ring_slot ) );
+		if ( !self->slots )
+		{
+			free( self );
+			return NULL;
+		}
+		for ( i = 0; i < size; i++ )
+			atomic_init( &self->slots[i].sequence, i );
+		self->mask = size - 1;
+		pthread_mutex_init( &self->mutex, NULL );
+		pthread_cond_init( &self->cond, NULL );
+	}
+	return self;
+}
+
+/** Get the number of items the ring can hold.
+ *
+ * \public \memberof mlt_ring_s
+ * \param self a ring
+ * \return the capacity
+ */
+
+int mlt_ring_capacity( mlt_ring self )
+{
+	return self ? self->mask + 1 : 0;
+}
+
+/** Get the number of items in the ring.
+ *
+ * While other threads use the ring, this is only a snapshot. An item counts
+ * once it can be popped and until it has been popped.
+ * \public \memberof mlt_ring_s
+ * \param self a ring
+ * \return the number of items
+ */
+
+int mlt_ring_count( mlt_ring self )
+{
+	return self ? atomic_load( &self->count ) : 0;
+}
+
+/** Wake the threads waiting on the ring if there are any.
+ *
+ * \private \memberof mlt_ring_s
+ * \param self a ring
+ */
+
+static void ring_wake( mlt_ring self )
+{
+	if ( atomic_load( &self->waiting ) > 0 )
+	{
+		pthread_mutex_lock( &self->mutex );
+		pthread_cond_broadcast( &self->cond );
+		pthread_mutex_unlock( &self->mutex );
+	}
+}
+
+/** Add an item to the end of the ring without waiting.
+ *
+ * \public \memberof mlt_ring_s
+ * \param self a ring
+ * \param item an opaque pointer
+ * \return true if the ring is full
+ */
+
+int mlt_ring_push( mlt_ring self, void *item )
+{
+	size_t pos = atomic_load_explicit( &self->tail, memory_order_relaxed );
+	ring_slot *slot;
+
+	while ( 1 )
+	{
+		slot = &self->slots[ pos & self->mask ];
+		size_t sequence = atomic_load_explicit( &slot->sequence, memory_order_acquire );
+		if ( sequence == pos )
+		{
+			if ( atomic_compare_exchange_weak_explicit( &self->tail, &pos, pos + 1,
+				memory_order_relaxed, memory_order_relaxed ) )
+				break;
+		}
+		else if ( sequence < pos )
+		{
+			return 1;
+		}
+		else
+		{
+			pos = atomic_load_explicit( &self->tail, memory_order_relaxed );
+		}
+	}
+	slot->item = item;
+	atomic_store_explicit( &slot->sequence, pos + 1, memory_order_release );
+	atomic_fetch_add( &self->count, 1 );
+	ring_wake( self );
+	return 0;
+}
+
+/** Remove the item at the front of the ring without waiting.
+ *
+ * \public \memberof mlt_ring_s
+ * \param self a ring
+ * \return an opaque pointer or NULL if the ring is empty
+ */
+
+void *mlt_ring_pop( mlt_ring self )
+{
+	size_t pos = atomic_load_explicit( &self->head, memory_order_relaxed );
+	ring_slot *slot;
+	void *item;
+
+	while ( 1 )
+	{
+		slot = &self->slots[ pos & self->mask ];
+		size_t sequence = atomic_load_explicit( &slot->sequence, memory_order_acquire );
+		if ( sequence == pos + 1 )
+		{
+			if ( atomic_compare_exchange_weak_explicit( &self->head, &pos, pos + 1,
+				memory_order_relaxed, memory_order_relaxed ) )
+				break;
+		}
+		else if ( sequence < pos + 1 )
+		{
+			return NULL;
+		}
+		else
+		{
+			pos = atomic_load_explicit( &self->head, memory_order_relaxed );
+		}
+	}
+	item = slot->item;
+	atomic_store_explicit( &slot->sequence, pos + self->mask + 1, memory_order_release );
+	atomic_fetch_sub( &self->count, 1 );
+	ring_wake( self );
+	return item;
+}
+
+/** Wait until a condition on the number of items holds or the ring is interrupted.
+ *
+ * \private \memberof mlt_ring_s
+ * \param self a ring
+ * \param limit wait while the count is at least this
+ * \param minimum wait while the count is less than this
+ * \param deadline the clock time to stop waiting at or NULL to wait without a limit
+ * \return true if interrupted or the deadline passed
+ */
+
+static int ring_wait( mlt_ring self, int limit, int minimum, const struct timespec *deadline )
+{
+	int i, timed_out = 0;
+
+#define RING_READY() ( atomic_load( &self->interrupted ) || \
+	( mlt_ring_count( self ) < limit && mlt_ring_count( self ) >= minimum ) )
+
+	for ( i = 0; i < SPIN_COUNT; i++ )
+	{
+		if ( RING_READY() )
+			return atomic_load( &self->interrupted );
+		sched_yield();
+	}
+
+	pthread_mutex_lock( &self->mutex );
+	atomic_fetch_add( &self->waiting, 1 );
+	while ( !RING_READY() )
+	{
+		if ( !deadline )
+			pthread_cond_wait( &self->cond, &self->mutex );
+		else if ( pthread_cond_timedwait( &self->cond, &self->mutex, deadline ) == ETIMEDOUT )
+		{
+			timed_out = !RING_READY();
+			break;
+		}
+	}
+	atomic_fetch_sub( &self->waiting, 1 );
+	pthread_mutex_unlock( &self->mutex );
+
+#undef RING_READY
+
+	return atomic_load( &self->interrupted ) || timed_out;
+}
+
+/** Wait until the ring holds fewer than some number of items.
+ *
+ * \public \memberof mlt_ring_s
+ * \param self a ring
+ * \param limit the number of items, clamped to the capacity
+ * \return true if the wait was interrupted by mlt_ring_interrupt()
+ */
+
+int mlt_ring_wait_for_space( mlt_ring self, int limit )
+{
+	if ( limit <= 0 || limit > mlt_ring_capacity( self ) )
+		limit = mlt_ring_capacity( self );
+	return ring_wait( self, limit, 0, NULL );
+}
+
+/** Wait until the ring holds at least some number of items.
+ *
+ * \public \memberof mlt_ring_s
+ * \param self a ring
+ * \param minimum the number of items, clamped to the capacity
+ * \return true if the wait was interrupted by mlt_ring_interrupt()
+ */
+
+int mlt_ring_wait_for_items( mlt_ring self, int minimum )
+{
+	if ( minimum < 1 )
+		minimum = 1;
+	if ( minimum > mlt_ring_capacity( self ) )
+		minimum = mlt_ring_capacity( self );
+	return ring_wait( self, mlt_ring_capacity( self ) + 1, minimum, NULL );
+}
+
+/** Wait for a limited time until the ring holds at least some number of items.
+ *
+ * \public \memberof mlt_ring_s
+ * \param self a ring
+ * \param minimum the number of items, clamped to the capacity
+ * \param timeout the longest time to wait in microseconds
+ * \return true if the wait was interrupted by mlt_ring_interrupt() or timed out
+ */
+
+int mlt_ring_wait_for_items_timeout( mlt_ring self, int minimum, int timeout )
+{
+	struct timespec deadline;
+	int64_t nsec;
+
+	if ( minimum < 1 )
+		minimum = 1;
+	if ( minimum > mlt_ring_capacity( self ) )
+		minimum = mlt_ring_capacity( self );
+	clock_gettime( CLOCK_REALTIME, &deadline );
+	nsec = deadline.tv_nsec + ( int64_t ) MAX( timeout, 0 ) * 1000;
+	deadline.tv_sec += nsec / 1000000000;
+	deadline.tv_nsec = nsec % 1000000000;
+	return ring_wait( self, mlt_ring_capacity( self ) + 1, minimum, &deadline );
+}
+
+/** Make waiting calls return immediately or wait again.
+ *
+ * \public \memberof mlt_ring_s
+ * \param self a ring
+ * \param interrupted true to wake all waiting threads and stop waiting
+ */
+
+void mlt_ring_interrupt( mlt_ring self, int interrupted )
+{
+	atomic_store( &self->interrupted, interrupted );
+	pthread_mutex_lock( &self->mutex );
+	pthread_cond_broadcast( &self->cond );
+	pthread_mutex_unlock( &self->mutex );
+}
+
+/** Destroy a ring.
+ *
+ * The items that are still in it are not released.
+ * \public \memberof mlt_ring_s
+ * \param self a ring
+ */
+
+void mlt_ring_close( mlt_ring self )
+{
+	if ( self )
+	{
+		pthread_cond_destroy( &self->cond );
+		pthread_mutex_destroy( &self->mutex );
+		free( self->slots );
+		free( self );
+	}
+}
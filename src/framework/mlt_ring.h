@@ -0,0 +1,39 @@
+/**
+ * \file mlt_ring.h
+ * \brief bounded lock-free queue
+ * \see mlt_ring_s
+ *
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MLT_RING_H
+#define MLT_RING_H
+
+#include "mlt_types.h"
+
+extern mlt_ring mlt_ring_init( int capacity );
+extern int mlt_ring_capacity( mlt_ring self );
+extern int mlt_ring_count( mlt_ring self );
+extern int mlt_ring_push( mlt_ring self, void *item );
+extern void *mlt_ring_pop( mlt_ring self );
+extern int mlt_ring_wait_for_space( mlt_ring self, int limit );
+extern int mlt_ring_wait_for_items( mlt_ring self, int minimum );
+extern int mlt_ring_wait_for_items_timeout( mlt_ring self, int minimum, int timeout );
+extern void mlt_ring_interrupt( mlt_ring self, int interrupted );
+extern void mlt_ring_close( mlt_ring self );
+
+#endif
@@ -27,6 +27,7 @@
 #include "mlt_factory.h"
 #include "mlt_log.h"
 #include "mlt_producer.h"
+#include "mlt_trace.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -563,6 +564,8 @@ void mlt_service_apply_filters( mlt_service self, mlt_frame frame, int index )
 int mlt_service_get_frame( mlt_service self, mlt_frame_ptr frame, int index )
 {
 	int result = 0;
+	int64_t trace_begin = mlt_trace_now();
+	void *trace_previous = mlt_trace_enter( self );
 
 	// Lock the service
 	mlt_service_lock( self );
@@ -630,6 +633,9 @@ int mlt_service_get_frame( mlt_service self, mlt_frame_ptr frame, int index )
 	// Unlock the service
 	mlt_service_unlock( self );
 
+	mlt_trace_leave( trace_previous );
+	mlt_trace_event( self, "get_frame", NULL, trace_begin );
+
 	return result;
 }
 
@@ -904,6 +910,29 @@ void mlt_service_cache_purge( mlt_service self )
 	}
 }
 
+/** Get the performance counters of a service.
+ *
+ * The counters are only collected while mlt_trace_set_counters() is on, for
+ * example by setting the environment variable MLT_PERF_COUNTERS=1. Time spent
+ * in a get_image or get_audio callback is charged to the service whose get_frame
+ * or process pushed it, and includes the time of the services below it.
+ *
+ * The properties are get_frame_count, get_image_count and get_audio_count;
+ * get_frame_time, get_image_time and get_audio_time, the total in microseconds;
+ * get_frame_avg, get_image_avg and get_audio_avg; get_frame_p99, get_image_p99
+ * and get_audio_p99, an upper bound of the 99th percentile in microseconds;
+ * bytes_allocated from mlt_pool; and, for a consumer, frames_dropped.
+ *
+ * \public \memberof mlt_service_s
+ * \param self a service
+ * \return a new properties list that the caller must close
+ */
+
+mlt_properties mlt_service_perf_stats( mlt_service self )
+{
+	return mlt_trace_service_stats( self );
+}
+
 /** Lookup the cache object for a service.
  *
  * \private \memberof mlt_service_s
@@ -105,6 +105,7 @@ extern mlt_cache_item mlt_service_cache_get( mlt_service self, const char *name
 extern void mlt_service_cache_set_size( mlt_service self, const char *name, int size );
 extern int mlt_service_cache_get_size( mlt_service self, const char *name );
 extern void mlt_service_cache_purge( mlt_service self );
+extern mlt_properties mlt_service_perf_stats( mlt_service self );
 
 #endif
 
@@ -20,6 +20,10 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "mlt_slices.h"
 #include "mlt_properties.h"
 #include "mlt_log.h"
@@ -29,11 +33,20 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <sched.h>
+#include <stdatomic.h>
 #ifdef _WIN32
 #include <windows.h>
 #endif
+#ifdef __linux__
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#endif
 #define MAX_SLICES 32
+#define MAX_NODES 64
 #define ENV_SLICES "MLT_SLICES_COUNT"
+#define ENV_SLICES_CPUS "MLT_SLICES_CPUS"
+#define ENV_SLICES_NUMA "MLT_SLICES_NUMA"
 
 typedef enum {
 	mlt_policy_normal,
@@ -46,29 +59,410 @@ mlt_schedule_policy;
 static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
 static mlt_slices globals[mlt_policy_nb] = {NULL, NULL, NULL};
 
+/** the normal policy contexts of each NUMA node when MLT_SLICES_NUMA is set */
+static mlt_slices node_globals[MAX_NODES];
+
+/** the NUMA topology, read once */
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+static int node_count = 1;
+static int numa_enabled = 0;
+#ifdef __linux__
+static cpu_set_t node_cpus[MAX_NODES];
+#endif
+
+/** the key to find out which worker of which context the calling thread is */
+static pthread_key_t worker_key;
+
+/** the key to find out the priority class of the calling thread */
+static pthread_key_t priority_key;
+static pthread_once_t worker_once = PTHREAD_ONCE_INIT;
 
 struct mlt_slices_runtime_s
 {
-	int jobs, done, curr;
+	int jobs, curr;
+	int is_task;
+	mlt_slices_priority priority;
+	atomic_int done;
 	mlt_slices_proc proc;
 	void* cookie;
-	struct mlt_slices_runtime_s* next;
+	struct mlt_slices_runtime_s *prev, *next;
 };
 
+/** \brief private to mlt_slices_s, a list of runtimes with jobs left to start
+ */
+
+struct mlt_slices_queue_s
+{
+	pthread_mutex_t lock;
+	struct mlt_slices_runtime_s *head, *tail;
+};
+
+/** \brief private to mlt_slices_s, the identity of a worker thread
+ */
+
+struct mlt_slices_worker_s
+{
+	mlt_slices ctx;
+	int id;
+};
+
+/** \brief Sliced threading context
+ *
+ * Each worker has its own queue of runtimes and there are three more queues
+ * for runtimes submitted by other threads, one for each priority class. A
+ * worker first starts jobs from its own queue, most recent first, then from
+ * the shared queues, high priority first, and then steals from the queues of
+ * the other workers. So queued background jobs wait while there are jobs of
+ * a higher priority, but jobs already running are not interrupted. A runtime submitted from inside a
+ * job goes onto the queue of the worker running it, and that worker starts
+ * its jobs itself while idle workers steal the rest, so nested parallelism
+ * neither blocks a worker nor adds threads.
+ */
+
 struct mlt_slices_s
 {
 	int f_exit;
 	int count;
+	int node;             /**< the NUMA node the workers are bound to or -1 */
 	int readys;
 	int ref;
+	atomic_int pending;   /**< the number of runtimes with jobs left to start */
+	atomic_int sleeping;  /**< the number of workers waiting for runtimes */
 	pthread_mutex_t cond_mutex;
 	pthread_cond_t cond_var_job;
 	pthread_cond_t cond_var_ready;
 	pthread_t threads[MAX_SLICES];
-	struct mlt_slices_runtime_s *head, *tail;
+	struct mlt_slices_worker_s workers[MAX_SLICES];
+	struct mlt_slices_queue_s queues[MAX_SLICES + 3]; /**< one per worker and the shared ones last */
 	const char* name;
 };
 
+static void worker_key_init( )
+{
+	pthread_key_create( &worker_key, NULL );
+	pthread_key_create( &priority_key, NULL );
+}
+
+/** Get the index of the shared queue of a priority class.
+ *
+ * \private \memberof mlt_slices_s
+ * \param ctx context pointer
+ * \param priority a priority class
+ * \return the index of the queue
+ */
+
+static inline int shared_queue( mlt_slices ctx, mlt_slices_priority priority )
+{
+	return ctx->count + 1 - ( priority < 0 ? -1 : priority > 0 ? 1 : 0 );
+}
+
+#ifdef __linux__
+
+/** Parse a CPU list such as "0-3,8,10-11".
+ *
+ * \private \memberof mlt_slices_s
+ * \param list a CPU list
+ * \param set the set to fill
+ * \return the number of CPUs in the set
+ */
+
+static int parse_cpu_list( const char *list, cpu_set_t *set )
+{
+	CPU_ZERO( set );
+	while ( list && *list )
+	{
+		char *end;
+		long first = strtol( list, &end, 10 ), last = first;
+		if ( end == list )
+			break;
+		if ( *end == '-' )
+			last = strtol( end + 1, &end, 10 );
+		for ( ; first <= last && first < CPU_SETSIZE; first++ )
+			if ( first >= 0 )
+				CPU_SET( first, set );
+		list = *end ? end + 1 : end;
+	}
+	return CPU_COUNT( set );
+}
+
+#endif
+
+/** Read the NUMA topology from sysfs.
+ *
+ * \private \memberof mlt_slices_s
+ */
+
+static void topology_init( )
+{
+#ifdef __linux__
+	char path[64], list[1024];
+	int n;
+
+	for ( n = 0; n < MAX_NODES; n++ )
+	{
+		FILE *f;
+		snprintf( path, sizeof( path ), "/sys/devices/system/node/node%d/cpulist", n );
+		if ( !( f = fopen( path, "r" ) ) )
+			break;
+		if ( !fgets( list, sizeof( list ), f ) )
+			list[0] = '\0';
+		fclose( f );
+		parse_cpu_list( list, &node_cpus[n] );
+	}
+	node_count = n > 0 ? n : 1;
+	numa_enabled = node_count > 1 && getenv( ENV_SLICES_NUMA ) && atoi( getenv( ENV_SLICES_NUMA ) );
+#endif
+}
+
+/** Get the NUMA node of the CPU running the calling thread.
+ *
+ * \private \memberof mlt_slices_s
+ * \return the node index
+ */
+
+static int current_node( )
+{
+	unsigned node = 0;
+#if defined(__linux__) && defined(SYS_getcpu)
+	if ( node_count > 1 && syscall( SYS_getcpu, NULL, &node, NULL ) )
+		node = 0;
+#endif
+	return node < (unsigned) node_count ? (int) node : 0;
+}
+
+#ifdef __linux__
+
+/** Compute the CPUs a thread may run on.
+ *
+ * \private \memberof mlt_slices_s
+ * \param cpus a CPU list or NULL for all
+ * \param node a NUMA node or -1 for any
+ * \param set the set to fill
+ * \return the number of CPUs in the set, 0 if there is no restriction
+ */
+
+static int thread_cpus( const char *cpus, int node, cpu_set_t *set )
+{
+	int restricted = 0;
+
+	pthread_once( &topology_once, topology_init );
+	if ( cpus && *cpus )
+	{
+		parse_cpu_list( cpus, set );
+		restricted = 1;
+	}
+	if ( node >= 0 && node < node_count && node_count > 1 )
+	{
+		if ( restricted )
+			CPU_AND( set, set, &node_cpus[node] );
+		else
+			CPU_OR( set, &node_cpus[node], &node_cpus[node] );
+		restricted = 1;
+	}
+	return restricted ? CPU_COUNT( set ) : 0;
+}
+
+#endif
+
+/** Set the priority class of the work the calling thread submits.
+ *
+ * Jobs and tasks are started in order of their priority class. A job gets
+ * the priority class of the thread that submitted it, and the work it submits
+ * in turn gets the same one.
+ * \public \memberof mlt_slices_s
+ * \param priority a priority class
+ */
+
+void mlt_slices_set_priority( mlt_slices_priority priority )
+{
+	pthread_once( &worker_once, worker_key_init );
+	pthread_setspecific( priority_key, (void*) (intptr_t) ( priority + 2 ) );
+}
+
+/** Get the priority class of the work the calling thread submits.
+ *
+ * \public \memberof mlt_slices_s
+ * \return a priority class, normal unless it was set
+ */
+
+mlt_slices_priority mlt_slices_get_priority( )
+{
+	intptr_t priority;
+	pthread_once( &worker_once, worker_key_init );
+	priority = (intptr_t) pthread_getspecific( priority_key );
+	return priority ? (mlt_slices_priority) ( priority - 2 ) : mlt_slices_priority_normal;
+}
+
+/** Get the number of NUMA nodes.
+ *
+ * \public \memberof mlt_slices_s
+ * \return the number of nodes, 1 when NUMA is not available
+ */
+
+int mlt_slices_node_count( )
+{
+	pthread_once( &topology_once, topology_init );
+	return node_count;
+}
+
+/** Restrict the calling thread to a set of CPUs.
+ *
+ * This is available on Linux only.
+ * \public \memberof mlt_slices_s
+ * \param cpus a CPU list such as "0-7,16-23", NULL for all
+ * \param node a NUMA node to restrict to, or -1 for any
+ * \return true on error or if there is nothing to restrict to
+ */
+
+int mlt_slices_bind_thread( const char *cpus, int node )
+{
+#ifdef __linux__
+	cpu_set_t set;
+	if ( thread_cpus( cpus, node, &set ) > 0 )
+		return pthread_setaffinity_np( pthread_self(), sizeof( set ), &set ) != 0;
+#endif
+	return 1;
+}
+
+/** Add a runtime to the end of a queue.
+ *
+ * \private \memberof mlt_slices_s
+ * \param ctx context pointer
+ * \param q the index of the queue
+ * \param r a runtime
+ */
+
+static void queue_push( mlt_slices ctx, int q, struct mlt_slices_runtime_s* r )
+{
+	struct mlt_slices_queue_s *queue = &ctx->queues[q];
+
+	pthread_mutex_lock( &queue->lock );
+	r->prev = queue->tail;
+	r->next = NULL;
+	if ( queue->tail )
+		queue->tail->next = r;
+	else
+		queue->head = r;
+	queue->tail = r;
+	pthread_mutex_unlock( &queue->lock );
+
+	atomic_fetch_add( &ctx->pending, 1 );
+
+	/* wake the workers if any are waiting, including those waiting on a task */
+	if ( atomic_load( &ctx->sleeping ) > 0 )
+	{
+		pthread_mutex_lock( &ctx->cond_mutex );
+		pthread_cond_broadcast( &ctx->cond_var_job );
+		pthread_cond_broadcast( &ctx->cond_var_ready );
+		pthread_mutex_unlock( &ctx->cond_mutex );
+	}
+}
+
+/** Start a job from a queue.
+ *
+ * A runtime is removed from its queue when its last job is started, so a
+ * runtime in a queue is always still waited on by its submitter.
+ * \private \memberof mlt_slices_s
+ * \param ctx context pointer
+ * \param q the index of the queue
+ * \param own whether to take the most recent runtime rather than the oldest
+ * \param r_idx the index of the job started
+ * \return the runtime of the job or NULL if the queue is empty
+ */
+
+static struct mlt_slices_runtime_s* queue_claim( mlt_slices ctx, int q, int own, int *r_idx )
+{
+	struct mlt_slices_queue_s *queue = &ctx->queues[q];
+	struct mlt_slices_runtime_s* r;
+
+	pthread_mutex_lock( &queue->lock );
+	r = own ? queue->tail : queue->head;
+	if ( r )
+	{
+		*r_idx = r->curr++;
+		if ( r->curr == r->jobs )
+		{
+			if ( r->prev )
+				r->prev->next = r->next;
+			else
+				queue->head = r->next;
+			if ( r->next )
+				r->next->prev = r->prev;
+			else
+				queue->tail = r->prev;
+			atomic_fetch_sub( &ctx->pending, 1 );
+		}
+	}
+	pthread_mutex_unlock( &queue->lock );
+
+	return r;
+}
+
+/** Find a job to run for a worker.
+ *
+ * \private \memberof mlt_slices_s
+ * \param ctx context pointer
+ * \param id the worker's id
+ * \param r_idx the index of the job started
+ * \return the runtime of the job or NULL if there is none
+ */
+
+static struct mlt_slices_runtime_s* worker_claim( mlt_slices ctx, int id, int *r_idx )
+{
+	struct mlt_slices_runtime_s* r;
+	int i;
+
+	if ( ( r = queue_claim( ctx, id, 1, r_idx ) ) )
+		return r;
+	for ( i = 0; i < 3; i++ )
+		if ( ( r = queue_claim( ctx, ctx->count + i, 0, r_idx ) ) )
+			return r;
+	for ( i = 1; i < ctx->count; i++ )
+		if ( ( r = queue_claim( ctx, ( id + i ) % ctx->count, 0, r_idx ) ) )
+			return r;
+	return NULL;
+}
+
+/** Run a job and notify the submitter if it was the last one.
+ *
+ * \private \memberof mlt_slices_s
+ * \param ctx context pointer
+ * \param id the id of the thread running the job
+ * \param r the runtime of the job
+ * \param idx the index of the job
+ */
+
+static void run_job( mlt_slices ctx, int id, struct mlt_slices_runtime_s* r, int idx )
+{
+	int jobs = r->jobs;
+	void *priority = pthread_getspecific( priority_key );
+
+	mlt_log_debug( NULL, "%s:%d: running job: id=%d, idx=%d/%d, pool=[%s]\n", __FUNCTION__, __LINE__,
+		id, idx, jobs, ctx->name );
+
+	/* work submitted from the job gets its priority */
+	mlt_slices_set_priority( r->priority );
+
+	/* a task completes itself and may be gone when its proc returns */
+	if ( r->is_task )
+	{
+		r->proc( id, idx, jobs, r->cookie );
+		pthread_setspecific( priority_key, priority );
+		return;
+	}
+	r->proc( id, idx, jobs, r->cookie );
+	pthread_setspecific( priority_key, priority );
+
+	/* notify we finished the last job, r may be gone after the increment */
+	if ( atomic_fetch_add( &r->done, 1 ) + 1 == jobs )
+	{
+		mlt_log_debug( NULL, "%s:%d: pthread_cond_broadcast( &ctx->cond_var_ready )\n", __FUNCTION__, __LINE__ );
+		pthread_mutex_lock( &ctx->cond_mutex );
+		pthread_cond_broadcast( &ctx->cond_var_ready );
+		pthread_mutex_unlock( &ctx->cond_mutex );
+	}
+}
+
 static void* mlt_slices_worker( void* p )
 {
 	int id, idx;
@@ -78,58 +472,42 @@ static void* mlt_slices_worker( void* p )
 	mlt_log_debug( NULL, "%s:%d: ctx=[%p][%s] entering\n", __FUNCTION__, __LINE__ , ctx, ctx->name );
 
 	pthread_mutex_lock( &ctx->cond_mutex );
-
 	id = ctx->readys;
 	ctx->readys++;
+	pthread_mutex_unlock( &ctx->cond_mutex );
 
-	while ( 1 )
-	{
-		mlt_log_debug( NULL, "%s:%d: ctx=[%p][%s] waiting\n", __FUNCTION__, __LINE__ , ctx, ctx->name );
+	ctx->workers[id].ctx = ctx;
+	ctx->workers[id].id = id;
+	pthread_setspecific( worker_key, &ctx->workers[id] );
 
-		/* wait for new jobs */
-		while( !ctx->f_exit && !( r = ctx->head ) )
-			pthread_cond_wait( &ctx->cond_var_job, &ctx->cond_mutex );
+	if ( ctx->node >= 0 || getenv( ENV_SLICES_CPUS ) )
+		mlt_slices_bind_thread( getenv( ENV_SLICES_CPUS ), ctx->node );
 
-		if ( ctx->f_exit )
-			break;
-
-		if ( !r )
-			continue;
+	while ( 1 )
+	{
+		int f_exit;
 
-		/* check if no new job */
-		if ( r->curr == r->jobs )
+		if ( ( r = worker_claim( ctx, id, &idx ) ) )
 		{
-			ctx->head = ctx->head->next;
-			if ( !ctx->head )
-				ctx->tail = NULL;
-			mlt_log_debug( NULL, "%s:%d: new ctx->head=%p\n", __FUNCTION__, __LINE__, ctx->head );
+			run_job( ctx, id, r, idx );
 			continue;
-		};
+		}
 
-		/* new job id */
-		idx = r->curr;
-		r->curr++;
+		mlt_log_debug( NULL, "%s:%d: ctx=[%p][%s] waiting\n", __FUNCTION__, __LINE__ , ctx, ctx->name );
 
-		/* run job */
-		pthread_mutex_unlock( &ctx->cond_mutex );
-		mlt_log_debug( NULL, "%s:%d: running job: id=%d, idx=%d/%d, pool=[%s]\n", __FUNCTION__, __LINE__,
-			id, idx, r->jobs, ctx->name );
-		r->proc( id, idx, r->jobs, r->cookie );
+		/* wait for new jobs */
 		pthread_mutex_lock( &ctx->cond_mutex );
+		atomic_fetch_add( &ctx->sleeping, 1 );
+		while ( !ctx->f_exit && !atomic_load( &ctx->pending ) )
+			pthread_cond_wait( &ctx->cond_var_job, &ctx->cond_mutex );
+		atomic_fetch_sub( &ctx->sleeping, 1 );
+		f_exit = ctx->f_exit;
+		pthread_mutex_unlock( &ctx->cond_mutex );
 
-		/* increase done jobs counter */
-		r->done++;
-
-		/* notify we fininished last job */
-		if ( r->done == r->jobs )
-		{
-			mlt_log_debug( NULL, "%s:%d: pthread_cond_signal( &ctx->cond_var_ready )\n", __FUNCTION__, __LINE__ );
-			pthread_cond_broadcast( &ctx->cond_var_ready );
-		}
+		if ( f_exit )
+			break;
 	}
 
-	pthread_mutex_unlock( &ctx->cond_mutex );
-
 	return NULL;
 }
 
@@ -139,10 +517,11 @@ static void* mlt_slices_worker( void* p )
  * \param threads number of threads to use for job list, 0 for #cpus
  * \param policy scheduling policy of processing threads, -1 for normal
  * \param priority priority value that can be used with the scheduling algorithm, -1 for maximum
+ * \param node the NUMA node to bind the threads to, -1 for any
  * \return the context pointer
  */
 
-static mlt_slices mlt_slices_init( int threads, int policy, int priority )
+static mlt_slices mlt_slices_init( int threads, int policy, int priority, int node )
 {
 	pthread_attr_t tattr;
 	struct sched_param param;
@@ -161,6 +540,15 @@ static mlt_slices mlt_slices_init( int threads, int policy, int priority )
 #endif
 	int i, env_val = env ? atoi(env) : 0;
 
+#ifdef __linux__
+	/* size a bound pool by the CPUs it may run on */
+	cpu_set_t set;
+	int bound = thread_cpus( getenv( ENV_SLICES_CPUS ), node, &set );
+	if ( bound > 0 )
+		cpus = bound;
+#endif
+	ctx->node = node;
+
 	/* check given threads count */
 	if ( !env || !env_val )
 	{
@@ -191,6 +579,9 @@ static mlt_slices mlt_slices_init( int threads, int policy, int priority )
 	ctx->count = threads;
 
 	/* init attributes */
+	pthread_once( &worker_once, worker_key_init );
+	for ( i = 0; i < ctx->count + 3; i++ )
+		pthread_mutex_init( &ctx->queues[i].lock, NULL );
 	pthread_mutex_init ( &ctx->cond_mutex, NULL );
 	pthread_cond_init ( &ctx->cond_var_job, NULL );
 	pthread_cond_init ( &ctx->cond_var_ready, NULL );
@@ -241,8 +632,8 @@ static void mlt_slices_close( mlt_slices ctx )
 	pthread_mutex_unlock( &g_lock );
 
 	/* notify to exit */
-	ctx->f_exit = 1;
 	pthread_mutex_lock( &ctx->cond_mutex );
+	ctx->f_exit = 1;
 	pthread_cond_broadcast( &ctx->cond_var_job);
 	pthread_cond_broadcast( &ctx->cond_var_ready);
 	pthread_mutex_unlock( &ctx->cond_mutex );
@@ -252,6 +643,8 @@ static void mlt_slices_close( mlt_slices ctx )
 		pthread_join ( ctx->threads[j], NULL );
 
 	/* destroy vars */
+	for ( j = 0; j < ctx->count + 3; j++ )
+		pthread_mutex_destroy( &ctx->queues[j].lock );
 	pthread_cond_destroy ( &ctx->cond_var_ready );
 	pthread_cond_destroy ( &ctx->cond_var_job );
 	pthread_mutex_destroy ( &ctx->cond_mutex );
@@ -271,9 +664,8 @@ static void mlt_slices_close( mlt_slices ctx )
 static void mlt_slices_run( mlt_slices ctx, int jobs, mlt_slices_proc proc, void* cookie )
 {
 	struct mlt_slices_runtime_s runtime, *r = &runtime;
-
-	/* lock */
-	pthread_mutex_lock( &ctx->cond_mutex);
+	struct mlt_slices_worker_s *worker = pthread_getspecific( worker_key );
+	int idx;
 
 	/* check jobs count */
 	if ( jobs < 0 )
@@ -283,34 +675,40 @@ static void mlt_slices_run( mlt_slices ctx, int jobs, mlt_slices_proc proc, void
 
 	/* setup runtime args */
 	r->jobs = jobs;
-	r->done = 0;
+	r->is_task = 0;
+	r->priority = mlt_slices_get_priority();
+	atomic_init( &r->done, 0 );
 	r->curr = 0;
 	r->proc = proc;
 	r->cookie = cookie;
-	r->next = NULL;
 
-	/* attach job */
-	if ( ctx->tail )
+	if ( worker && worker->ctx == ctx )
 	{
-		ctx->tail->next = r;
-		ctx->tail = r;
+		/* nested call from a job: start the jobs here and let idle workers steal */
+		struct mlt_slices_runtime_s* got;
+		queue_push( ctx, worker->id, r );
+		while ( ( got = queue_claim( ctx, worker->id, 1, &idx ) ) )
+		{
+			run_job( ctx, worker->id, got, idx );
+			/* all of ours are started once an older runtime comes up */
+			if ( got != r )
+				break;
+		}
 	}
 	else
 	{
-		ctx->head = ctx->tail = r;
+		/* attach job to the shared queue of its priority */
+		queue_push( ctx, shared_queue( ctx, r->priority ), r );
 	}
 
-	/* notify workers */
-	pthread_cond_broadcast( &ctx->cond_var_job );
-
 	/* wait for end of task */
-	while( !ctx->f_exit && ( r->done < r->jobs ) )
+	pthread_mutex_lock( &ctx->cond_mutex );
+	while( !ctx->f_exit && ( atomic_load( &r->done ) < r->jobs ) )
 	{
 		pthread_cond_wait( &ctx->cond_var_ready, &ctx->cond_mutex );
 		mlt_log_debug( NULL, "%s:%d: ctx=[%p][%s] signalled\n", __FUNCTION__, __LINE__ , ctx, ctx->name );
 	}
-
-	pthread_mutex_unlock( &ctx->cond_mutex);
+	pthread_mutex_unlock( &ctx->cond_mutex );
 }
 
 /** Get a global shared sliced threading context.
@@ -338,7 +736,7 @@ static mlt_slices mlt_slices_get_global( mlt_schedule_policy policy )
 		default:
 			posix_policy = SCHED_OTHER;
 		}
-		globals[policy] = mlt_slices_init( 0, posix_policy, -1 );
+		globals[policy] = mlt_slices_init( 0, posix_policy, -1, -1 );
 		mlt_factory_register_for_clean_up( globals[policy], (mlt_destructor) mlt_slices_close );
 	}
 	pthread_mutex_unlock( &g_lock );
@@ -346,6 +744,43 @@ static mlt_slices mlt_slices_get_global( mlt_schedule_policy policy )
 	return globals[policy];
 }
 
+/** Get the sliced threading context for the normal scheduling policy.
+ *
+ * When MLT_SLICES_NUMA is set there is one per NUMA node, and the one of the
+ * node running the calling thread is returned. A worker of a context always
+ * gets its own context.
+ *
+ * \private \memberof mlt_slices_s
+ * \return the context pointer
+ */
+
+static mlt_slices mlt_slices_get_normal( )
+{
+	struct mlt_slices_worker_s *worker;
+	int node;
+
+	pthread_once( &topology_once, topology_init );
+	if ( !numa_enabled )
+		return mlt_slices_get_global( mlt_policy_normal );
+
+	// No context may exist yet to have created the key
+	pthread_once( &worker_once, worker_key_init );
+	worker = pthread_getspecific( worker_key );
+	if ( worker && worker->ctx->node >= 0 )
+		return worker->ctx;
+
+	node = current_node();
+	pthread_mutex_lock( &g_lock );
+	if ( !node_globals[node] )
+	{
+		node_globals[node] = mlt_slices_init( 0, SCHED_OTHER, -1, node );
+		mlt_factory_register_for_clean_up( node_globals[node], (mlt_destructor) mlt_slices_close );
+	}
+	pthread_mutex_unlock( &g_lock );
+
+	return node_globals[node];
+}
+
 /** Get the number of slices for the normal scheduling policy.
  *
  * \public \memberof mlt_slices_s
@@ -354,7 +789,7 @@ static mlt_slices mlt_slices_get_global( mlt_schedule_policy policy )
 
 int mlt_slices_count_normal()
 {
-	mlt_slices slices = mlt_slices_get_global( mlt_policy_normal );
+	mlt_slices slices = mlt_slices_get_normal();
 	if (slices)
 		return slices->count;
 	else
@@ -393,7 +828,7 @@ int mlt_slices_count_fifo()
 
 void mlt_slices_run_normal(int jobs, mlt_slices_proc proc, void *cookie)
 {
-	return mlt_slices_run( mlt_slices_get_global( mlt_policy_normal ),
+	return mlt_slices_run( mlt_slices_get_normal(),
 	   jobs, proc, cookie );
 }
 
@@ -408,3 +843,296 @@ void mlt_slices_run_fifo(int jobs, mlt_slices_proc proc, void *cookie)
 	return mlt_slices_run( mlt_slices_get_global( mlt_policy_fifo ),
 	   jobs, proc, cookie );
 }
+
+/** \brief private to mlt_slices_s, an asynchronous task
+ */
+
+struct mlt_slices_task_s
+{
+	struct mlt_slices_runtime_s runtime;
+	mlt_slices ctx;
+	mlt_slices_task_proc proc;
+	void* cookie;
+	atomic_int refs;
+	int done;                         /**< guarded by the context's cond_mutex */
+	int result;
+	mlt_slices_task continuations;    /**< tasks to submit when this one is done */
+	mlt_slices_task next;             /**< the next continuation of the same task */
+	mlt_slices_group group;
+};
+
+/** \brief private to mlt_slices_s, a set of tasks that can be waited on together
+ */
+
+struct mlt_slices_group_s
+{
+	mlt_slices ctx;
+	int pending;                      /**< guarded by the context's cond_mutex */
+};
+
+/** Wait on a condition, running other jobs of the pool meanwhile if called from a worker.
+ *
+ * \private \memberof mlt_slices_s
+ * \param ctx context pointer
+ * \param is_done a function that checks the condition with cond_mutex locked
+ * \param arg the argument to \p is_done
+ */
+
+static void slices_wait( mlt_slices ctx, int (*is_done)( void* ), void* arg )
+{
+	struct mlt_slices_worker_s *worker = pthread_getspecific( worker_key );
+	int in_pool = worker && worker->ctx == ctx;
+	struct mlt_slices_runtime_s* r;
+	int idx, done = 0;
+
+	while ( !done )
+	{
+		if ( in_pool && ( r = worker_claim( ctx, worker->id, &idx ) ) )
+		{
+			run_job( ctx, worker->id, r, idx );
+			pthread_mutex_lock( &ctx->cond_mutex );
+			done = is_done( arg );
+			pthread_mutex_unlock( &ctx->cond_mutex );
+			continue;
+		}
+
+		pthread_mutex_lock( &ctx->cond_mutex );
+		if ( in_pool )
+			atomic_fetch_add( &ctx->sleeping, 1 );
+		while ( !ctx->f_exit && !( done = is_done( arg ) ) && !( in_pool && atomic_load( &ctx->pending ) ) )
+			pthread_cond_wait( &ctx->cond_var_ready, &ctx->cond_mutex );
+		if ( in_pool )
+			atomic_fetch_sub( &ctx->sleeping, 1 );
+		done |= ctx->f_exit;
+		pthread_mutex_unlock( &ctx->cond_mutex );
+	}
+}
+
+static int task_is_done( void* task )
+{
+	return ( ( mlt_slices_task ) task )->done;
+}
+
+static int group_is_done( void* group )
+{
+	return ( ( mlt_slices_group ) group )->pending == 0;
+}
+
+/** Run a task, then complete it and submit its continuations.
+ *
+ * \private \memberof mlt_slices_s
+ */
+
+static int task_proc( int id, int idx, int jobs, void* cookie )
+{
+	mlt_slices_task task = cookie;
+	mlt_slices ctx = task->ctx;
+	mlt_slices_task continuations;
+
+	task->result = task->proc( task->cookie );
+
+	pthread_mutex_lock( &ctx->cond_mutex );
+	task->done = 1;
+	continuations = task->continuations;
+	task->continuations = NULL;
+	if ( task->group )
+		task->group->pending--;
+	pthread_cond_broadcast( &ctx->cond_var_ready );
+	pthread_mutex_unlock( &ctx->cond_mutex );
+
+	while ( continuations )
+	{
+		mlt_slices_task next = continuations->next;
+		queue_push( ctx, shared_queue( ctx, continuations->runtime.priority ), &continuations->runtime );
+		continuations = next;
+	}
+
+	/* release the reference held while it was queued */
+	mlt_slices_task_close( task );
+	return 0;
+}
+
+/** Create a task that is not yet queued.
+ *
+ * \private \memberof mlt_slices_s
+ */
+
+static mlt_slices_task task_init( mlt_slices ctx, mlt_slices_task_proc proc, void* cookie )
+{
+	mlt_slices_task task = calloc( 1, sizeof( struct mlt_slices_task_s ) );
+	if ( task )
+	{
+		task->runtime.jobs = 1;
+		task->runtime.is_task = 1;
+		task->runtime.priority = mlt_slices_get_priority();
+		task->runtime.proc = task_proc;
+		task->runtime.cookie = task;
+		task->ctx = ctx;
+		task->proc = proc;
+		task->cookie = cookie;
+		/* one for the caller and one while it is queued */
+		atomic_init( &task->refs, 2 );
+	}
+	return task;
+}
+
+/** Run a function asynchronously on the normal policy thread pool.
+ *
+ * Unlike mlt_slices_run_normal(), this does not wait. Tasks may be submitted
+ * and waited on from inside jobs and other tasks.
+ * \public \memberof mlt_slices_s
+ * \param proc the function to run
+ * \param cookie the argument to \p proc
+ * \return a task that the caller must release with mlt_slices_task_close(), or NULL on error
+ */
+
+mlt_slices_task mlt_slices_task_submit( mlt_slices_task_proc proc, void* cookie )
+{
+	mlt_slices ctx = mlt_slices_get_normal();
+	mlt_slices_task task = ctx ? task_init( ctx, proc, cookie ) : NULL;
+	if ( task )
+		queue_push( ctx, shared_queue( ctx, task->runtime.priority ), &task->runtime );
+	return task;
+}
+
+/** Run a function asynchronously after a task is done.
+ *
+ * \public \memberof mlt_slices_s
+ * \param task the task to follow
+ * \param proc the function to run
+ * \param cookie the argument to \p proc
+ * \return a task that the caller must release with mlt_slices_task_close(), or NULL on error
+ */
+
+mlt_slices_task mlt_slices_task_then( mlt_slices_task task, mlt_slices_task_proc proc, void* cookie )
+{
+	mlt_slices ctx = task ? task->ctx : NULL;
+	mlt_slices_task next = ctx ? task_init( ctx, proc, cookie ) : NULL;
+	if ( next )
+	{
+		pthread_mutex_lock( &ctx->cond_mutex );
+		int done = task->done;
+		if ( !done )
+		{
+			next->next = task->continuations;
+			task->continuations = next;
+		}
+		pthread_mutex_unlock( &ctx->cond_mutex );
+		if ( done )
+			queue_push( ctx, shared_queue( ctx, next->runtime.priority ), &next->runtime );
+	}
+	return next;
+}
+
+/** Check whether a task is done without waiting.
+ *
+ * \public \memberof mlt_slices_s
+ * \param task a task
+ * \return true if the task has finished running
+ */
+
+int mlt_slices_task_is_done( mlt_slices_task task )
+{
+	int done = 1;
+	if ( task )
+	{
+		pthread_mutex_lock( &task->ctx->cond_mutex );
+		done = task->done;
+		pthread_mutex_unlock( &task->ctx->cond_mutex );
+	}
+	return done;
+}
+
+/** Wait for a task to finish.
+ *
+ * When called from a thread of the pool, other jobs and tasks are run while waiting.
+ * \public \memberof mlt_slices_s
+ * \param task a task
+ * \return the value returned by the task's function
+ */
+
+int mlt_slices_task_wait( mlt_slices_task task )
+{
+	if ( !task )
+		return 0;
+	slices_wait( task->ctx, task_is_done, task );
+	return task->result;
+}
+
+/** Release a task.
+ *
+ * This does not cancel the task. It still runs if it has not yet.
+ * \public \memberof mlt_slices_s
+ * \param task a task
+ */
+
+void mlt_slices_task_close( mlt_slices_task task )
+{
+	if ( task && atomic_fetch_sub( &task->refs, 1 ) == 1 )
+		free( task );
+}
+
+/** Create a group of tasks.
+ *
+ * \public \memberof mlt_slices_s
+ * \return a new group or NULL on error
+ */
+
+mlt_slices_group mlt_slices_group_init( )
+{
+	mlt_slices ctx = mlt_slices_get_normal();
+	mlt_slices_group group = ctx ? calloc( 1, sizeof( struct mlt_slices_group_s ) ) : NULL;
+	if ( group )
+		group->ctx = ctx;
+	return group;
+}
+
+/** Run a function asynchronously as part of a group.
+ *
+ * \public \memberof mlt_slices_s
+ * \param group a group
+ * \param proc the function to run
+ * \param cookie the argument to \p proc
+ */
+
+void mlt_slices_group_submit( mlt_slices_group group, mlt_slices_task_proc proc, void* cookie )
+{
+	mlt_slices_task task = group ? task_init( group->ctx, proc, cookie ) : NULL;
+	if ( task )
+	{
+		task->group = group;
+		pthread_mutex_lock( &group->ctx->cond_mutex );
+		group->pending++;
+		pthread_mutex_unlock( &group->ctx->cond_mutex );
+		queue_push( group->ctx, shared_queue( group->ctx, task->runtime.priority ), &task->runtime );
+		mlt_slices_task_close( task );
+	}
+}
+
+/** Wait for all of the tasks of a group to finish.
+ *
+ * When called from a thread of the pool, other jobs and tasks are run while waiting.
+ * \public \memberof mlt_slices_s
+ * \param group a group
+ */
+
+void mlt_slices_group_wait( mlt_slices_group group )
+{
+	if ( group )
+		slices_wait( group->ctx, group_is_done, group );
+}
+
+/** Wait for the tasks of a group and destroy it.
+ *
+ * \public \memberof mlt_slices_s
+ * \param group a group
+ */
+
+void mlt_slices_group_close( mlt_slices_group group )
+{
+	if ( group )
+	{
+		mlt_slices_group_wait( group );
+		free( group );
+	}
+}
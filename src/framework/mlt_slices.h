@@ -28,12 +28,19 @@
 /**
  * \envvar \em MLT_SLICES_COUNT Set the number of slices to use, which
  * defaults to number of CPUs found.
+ * \envvar \em MLT_SLICES_CPUS Restrict the slice threads to a list of CPUs,
+ * for example "0-15,32-47", which also sets the number of CPUs found (Linux only).
+ * \envvar \em MLT_SLICES_NUMA Set to 1 to use a separate pool of slice
+ * threads for each NUMA node, bound to the CPUs of its node and sized by them.
+ * Slices are run on the pool of the node the caller is running on (Linux only).
  */
 
 struct mlt_slices_s;
 
 typedef int (*mlt_slices_proc)( int id, int idx, int jobs, void* cookie );
 
+typedef int (*mlt_slices_task_proc)( void* cookie );
+
 extern int mlt_slices_count_normal();
 
 extern int mlt_slices_count_rr();
@@ -46,4 +53,30 @@ extern void mlt_slices_run_rr( int jobs, mlt_slices_proc proc, void* cookie );
 
 extern void mlt_slices_run_fifo( int jobs, mlt_slices_proc proc, void* cookie );
 
+extern mlt_slices_task mlt_slices_task_submit( mlt_slices_task_proc proc, void* cookie );
+
+extern mlt_slices_task mlt_slices_task_then( mlt_slices_task task, mlt_slices_task_proc proc, void* cookie );
+
+extern int mlt_slices_task_is_done( mlt_slices_task task );
+
+extern int mlt_slices_task_wait( mlt_slices_task task );
+
+extern void mlt_slices_task_close( mlt_slices_task task );
+
+extern mlt_slices_group mlt_slices_group_init( );
+
+extern void mlt_slices_group_submit( mlt_slices_group group, mlt_slices_task_proc proc, void* cookie );
+
+extern void mlt_slices_group_wait( mlt_slices_group group );
+
+extern void mlt_slices_group_close( mlt_slices_group group );
+
+extern void mlt_slices_set_priority( mlt_slices_priority priority );
+
+extern mlt_slices_priority mlt_slices_get_priority( );
+
+extern int mlt_slices_node_count( );
+
+extern int mlt_slices_bind_thread( const char *cpus, int node );
+
 #endif
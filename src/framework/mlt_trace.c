@@ -0,0 +1,643 @@
+/**
+ * \file mlt_trace.c
+ * \brief hot path tracing in the Chrome trace event format
+ *
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+// Local header files
+#include "mlt_trace.h"
+#include "mlt_service.h"
+#include "mlt_frame.h"
+
+// System header files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <libgen.h>
+
+/** the number of events a thread buffers before writing them out */
+#define TRACE_EVENTS 1024
+
+/** the size of an event or callback name */
+#define TRACE_NAME_SIZE 48
+
+/** \brief private to mlt_trace, a completed span of time */
+
+typedef struct
+{
+	int64_t begin;
+	int64_t duration;
+	const char *category;
+	const void *service;
+	char name[TRACE_NAME_SIZE];
+}
+trace_event;
+
+/** \brief private to mlt_trace, the state of a thread
+ *
+ * Events are appended under the thread's own mutex, which is only contended
+ * while the trace is written out. Lock trace_mutex before it, never after.
+ */
+
+typedef struct trace_thread_s
+{
+	pthread_mutex_t mutex;
+	int id;
+	int count;
+	void *current;           /**< the service whose get_frame or process is running */
+	struct trace_thread_s *next;
+	struct trace_thread_s *prev;
+	trace_event events[TRACE_EVENTS];
+}
+trace_thread;
+
+/** the number of histogram buckets, four per power of two microseconds */
+#define PERF_BUCKETS 160
+
+/** \brief private to mlt_trace, the counters of one kind of call */
+
+typedef struct
+{
+	atomic_llong count;
+	atomic_llong time;
+	atomic_llong histogram[PERF_BUCKETS];
+}
+perf_op;
+
+/** the kinds of calls that are counted */
+enum { PERF_GET_FRAME, PERF_GET_IMAGE, PERF_GET_AUDIO, PERF_OPS };
+static const char *perf_op_names[PERF_OPS] = { "get_frame", "get_image", "get_audio" };
+
+/** \brief private to mlt_trace, the counters of a service */
+
+typedef struct
+{
+	perf_op ops[PERF_OPS];
+	atomic_llong bytes;
+}
+perf_counters;
+
+static atomic_int trace_enabled = 0;
+static atomic_int perf_enabled = 0;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t perf_mutex = PTHREAD_MUTEX_INITIALIZER;
+static FILE *trace_file = NULL;
+static trace_thread *trace_threads = NULL;
+static int trace_next_id = 0;
+
+/** Write the events of a thread to the trace file.
+ *
+ * The caller holds trace_mutex and the thread's mutex.
+ */
+
+static void trace_write( trace_thread *thread )
+{
+	int i;
+	if ( trace_file )
+	{
+		for ( i = 0; i < thread->count; i++ )
+		{
+			trace_event *event = &thread->events[i];
+			fprintf( trace_file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,"
+				"\"pid\":%d,\"tid\":%d,\"args\":{\"service\":\"%p\"}},\n",
+				event->name, event->category, (long long) event->begin, (long long) event->duration,
+				(int) getpid(), thread->id, event->service );
+		}
+	}
+	thread->count = 0;
+}
+
+/** Write out and release the state of an exiting thread. */
+
+static void trace_thread_close( void *arg )
+{
+	trace_thread *thread = arg;
+
+	pthread_mutex_lock( &trace_mutex );
+	pthread_mutex_lock( &thread->mutex );
+	trace_write( thread );
+	if ( thread->prev )
+		thread->prev->next = thread->next;
+	else
+		trace_threads = thread->next;
+	if ( thread->next )
+		thread->next->prev = thread->prev;
+	pthread_mutex_unlock( &thread->mutex );
+	pthread_mutex_unlock( &trace_mutex );
+
+	pthread_mutex_destroy( &thread->mutex );
+	free( thread );
+}
+
+static void trace_init( void )
+{
+	pthread_key_create( &trace_key, trace_thread_close );
+}
+
+/** Get the state of the calling thread, creating it if needed. */
+
+static trace_thread *trace_thread_get( void )
+{
+	trace_thread *thread;
+
+	pthread_once( &trace_once, trace_init );
+	thread = pthread_getspecific( trace_key );
+	if ( !thread )
+	{
+		thread = calloc( 1, sizeof( trace_thread ) );
+		if ( !thread )
+			return NULL;
+		pthread_mutex_init( &thread->mutex, NULL );
+		pthread_mutex_lock( &trace_mutex );
+		thread->id = ++trace_next_id;
+		thread->next = trace_threads;
+		if ( trace_threads )
+			trace_threads->prev = thread;
+		trace_threads = thread;
+		pthread_mutex_unlock( &trace_mutex );
+		pthread_setspecific( trace_key, thread );
+	}
+	return thread;
+}
+
+/** Copy a name, replacing characters that would need escaping in JSON. */
+
+static void trace_copy_name( char *dest, const char *name )
+{
+	int i;
+	for ( i = 0; name[i] && i < TRACE_NAME_SIZE - 1; i++ )
+		dest[i] = ( name[i] == '"' || name[i] == '\\' || (unsigned char) name[i] < ' ' ) ? '_' : name[i];
+	dest[i] = '\0';
+}
+
+/** Describe a service by its type and name, for example "filter brightness". */
+
+static void trace_service_name( void *service, char *dest )
+{
+	char name[TRACE_NAME_SIZE];
+	const char *type = NULL;
+	const char *id = NULL;
+
+	if ( service )
+	{
+		mlt_properties properties = MLT_SERVICE_PROPERTIES( (mlt_service) service );
+		type = mlt_properties_get( properties, "mlt_type" );
+		id = mlt_properties_get( properties, "mlt_service" );
+	}
+	if ( id )
+		snprintf( name, sizeof( name ), "%s %s", type ? type : "service", id );
+	else
+		snprintf( name, sizeof( name ), "%s %p", type ? type : "service", service );
+	trace_copy_name( dest, name );
+}
+
+/** Get the counters of a service, creating them if needed. */
+
+static perf_counters *perf_get( void *service )
+{
+	mlt_properties properties = MLT_SERVICE_PROPERTIES( (mlt_service) service );
+	perf_counters *counters = mlt_properties_get_data( properties, "_perf", NULL );
+
+	if ( !counters )
+	{
+		pthread_mutex_lock( &perf_mutex );
+		counters = mlt_properties_get_data( properties, "_perf", NULL );
+		if ( !counters && ( counters = calloc( 1, sizeof( perf_counters ) ) ) )
+			mlt_properties_set_data( properties, "_perf", counters, 0, free, NULL );
+		pthread_mutex_unlock( &perf_mutex );
+	}
+	return counters;
+}
+
+/** Get the histogram bucket of a duration. */
+
+static int perf_bucket( int64_t duration )
+{
+	int exponent, bucket;
+
+	if ( duration < 1 )
+		return 0;
+	exponent = 63 - __builtin_clzll( duration );
+	bucket = 4 * exponent + 1 + ( exponent >= 2 ? ( duration >> ( exponent - 2 ) ) & 3 : ( duration << ( 2 - exponent ) ) & 3 );
+	return bucket < PERF_BUCKETS ? bucket : PERF_BUCKETS - 1;
+}
+
+/** Get the smallest duration that is beyond a histogram bucket. */
+
+static int64_t perf_bucket_limit( int bucket )
+{
+	int exponent = ( bucket - 1 ) / 4;
+	int64_t step = ( bucket - 1 ) % 4 + 5;
+
+	if ( bucket < 1 )
+		return 1;
+	return ( ( step << exponent ) + 3 ) >> 2;
+}
+
+/** Count a call that took \p duration microseconds. */
+
+static void perf_count( void *service, int op, int64_t duration )
+{
+	perf_counters *counters = perf_get( service );
+
+	if ( counters )
+	{
+		atomic_fetch_add( &counters->ops[op].count, 1 );
+		atomic_fetch_add( &counters->ops[op].time, duration );
+		atomic_fetch_add( &counters->ops[op].histogram[perf_bucket( duration )], 1 );
+	}
+}
+
+/** Get the current time in microseconds. */
+
+static int64_t trace_clock( void )
+{
+	struct timespec now;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000 + 1;
+}
+
+/** Record an event of a thread into the trace. */
+
+static void trace_record( void *service, const char *category, const char *name, int64_t begin, int64_t end )
+{
+	trace_thread *thread = trace_thread_get();
+	trace_event *event;
+
+	if ( !thread )
+		return;
+
+	pthread_mutex_lock( &thread->mutex );
+	if ( thread->count == TRACE_EVENTS )
+	{
+		pthread_mutex_unlock( &thread->mutex );
+		pthread_mutex_lock( &trace_mutex );
+		pthread_mutex_lock( &thread->mutex );
+		trace_write( thread );
+		pthread_mutex_unlock( &trace_mutex );
+	}
+	event = &thread->events[thread->count++];
+	event->begin = begin;
+	event->duration = end - begin;
+	event->category = category;
+	event->service = service;
+	if ( name )
+		trace_copy_name( event->name, name );
+	else
+		trace_service_name( service, event->name );
+	pthread_mutex_unlock( &thread->mutex );
+}
+
+/** Start recording a trace.
+ *
+ * The trace is written in the Chrome trace event format, which chrome://tracing
+ * and Perfetto can open. It is started by mlt_factory_init() when the
+ * environment variable MLT_TRACE names a file.
+ *
+ * \public \memberof mlt_trace
+ * \param filename the file to write
+ * \return true if tracing was already started or the file could not be opened
+ */
+
+int mlt_trace_start( const char *filename )
+{
+	int error = 1;
+
+	pthread_once( &trace_once, trace_init );
+	pthread_mutex_lock( &trace_mutex );
+	if ( !trace_file && filename && ( trace_file = fopen( filename, "w" ) ) )
+	{
+		fputs( "{\"traceEvents\":[\n", trace_file );
+		trace_enabled = 1;
+		error = 0;
+	}
+	pthread_mutex_unlock( &trace_mutex );
+
+	return error;
+}
+
+/** Stop recording and finish writing the trace file.
+ *
+ * \public \memberof mlt_trace
+ */
+
+void mlt_trace_stop( void )
+{
+	trace_thread *thread;
+
+	trace_enabled = 0;
+	pthread_mutex_lock( &trace_mutex );
+	for ( thread = trace_threads; thread; thread = thread->next )
+	{
+		pthread_mutex_lock( &thread->mutex );
+		trace_write( thread );
+		pthread_mutex_unlock( &thread->mutex );
+	}
+	if ( trace_file )
+	{
+		fprintf( trace_file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"mlt\"}}\n]}\n", (int) getpid() );
+		fclose( trace_file );
+		trace_file = NULL;
+	}
+	pthread_mutex_unlock( &trace_mutex );
+}
+
+/** Determine if a trace is being recorded.
+ *
+ * \public \memberof mlt_trace
+ * \return true if tracing
+ */
+
+int mlt_trace_is_enabled( void )
+{
+	return trace_enabled;
+}
+
+/** Turn the per-service performance counters on or off.
+ *
+ * They are turned on by mlt_factory_init() when the environment variable
+ * MLT_PERF_COUNTERS is set to a non-zero value. Counters that were already
+ * collected are kept. See mlt_service_perf_stats().
+ *
+ * \public \memberof mlt_trace
+ * \param enabled true to count
+ */
+
+void mlt_trace_set_counters( int enabled )
+{
+	pthread_once( &trace_once, trace_init );
+	perf_enabled = !!enabled;
+}
+
+/** Determine if the per-service performance counters are on.
+ *
+ * \public \memberof mlt_trace
+ * \return true if counting
+ */
+
+int mlt_trace_get_counters( void )
+{
+	return perf_enabled;
+}
+
+/** Get the time that begins an event.
+ *
+ * \public \memberof mlt_trace
+ * \return a monotonic time in microseconds, or 0 if neither tracing nor counting
+ */
+
+int64_t mlt_trace_now( void )
+{
+	if ( !trace_enabled && !perf_enabled )
+		return 0;
+	return trace_clock();
+}
+
+/** Record an event that began at \p begin and ends now.
+ *
+ * \public \memberof mlt_trace
+ * \param service the service the time is spent in (optional)
+ * \param category the kind of event, a string that must outlive the trace;
+ * "get_frame" events are also counted for the service
+ * \param name the name of the event, or NULL to use the service's type and name
+ * \param begin the value of mlt_trace_now() when the event began; if 0 nothing is recorded
+ */
+
+void mlt_trace_event( void *service, const char *category, const char *name, int64_t begin )
+{
+	int64_t end;
+
+	if ( !begin )
+		return;
+	end = trace_clock();
+	if ( perf_enabled && service && !strcmp( category, perf_op_names[PERF_GET_FRAME] ) )
+		perf_count( service, PERF_GET_FRAME, end - begin );
+	if ( trace_enabled )
+		trace_record( service, category, name, begin, end );
+}
+
+/** Make a service the one that the work of the calling thread belongs to.
+ *
+ * \public \memberof mlt_trace
+ * \param service a service about to get a frame, process one, or run a callback
+ * \return the previous service to give to mlt_trace_leave()
+ */
+
+void *mlt_trace_enter( void *service )
+{
+	trace_thread *thread;
+	void *previous = NULL;
+
+	if ( ( trace_enabled || perf_enabled ) && ( thread = trace_thread_get() ) )
+	{
+		previous = thread->current;
+		thread->current = service;
+	}
+	return previous;
+}
+
+/** Restore the service that the work of the calling thread belongs to.
+ *
+ * \public \memberof mlt_trace
+ * \param previous the value returned by mlt_trace_enter()
+ */
+
+void mlt_trace_leave( void *previous )
+{
+	trace_thread *thread;
+
+	if ( ( trace_enabled || perf_enabled ) && ( thread = trace_thread_get() ) )
+		thread->current = previous;
+}
+
+/** Remember which service pushed an item onto a frame's stack.
+ *
+ * The frame holds a reference to the service, so it can still be named when
+ * the item runs after the service was closed.
+ * \public \memberof mlt_trace
+ * \param frame a frame
+ * \param stack the name of the stack, "image" or "audio"
+ * \param depth the number of items on the stack before the push
+ */
+
+void mlt_trace_push( mlt_frame frame, const char *stack, int depth )
+{
+	trace_thread *thread;
+	char name[32];
+
+	if ( ( trace_enabled || perf_enabled ) && ( thread = trace_thread_get() ) )
+	{
+		snprintf( name, sizeof( name ), "_trace.%s.%d", stack, depth );
+		if ( thread->current )
+			mlt_properties_inc_ref( MLT_SERVICE_PROPERTIES( (mlt_service) thread->current ) );
+		mlt_properties_set_data( MLT_FRAME_PROPERTIES( frame ), name, thread->current, 0,
+			thread->current ? (mlt_destructor) mlt_service_close : NULL, NULL );
+	}
+}
+
+/** Get the service that pushed an item onto a frame's stack.
+ *
+ * \public \memberof mlt_trace
+ * \param frame a frame
+ * \param stack the name of the stack, "image" or "audio"
+ * \param depth the number of items on the stack below the item
+ * \return the service or NULL if unknown
+ */
+
+void *mlt_trace_pusher( mlt_frame frame, const char *stack, int depth )
+{
+	char name[32];
+
+	if ( !trace_enabled && !perf_enabled )
+		return NULL;
+	snprintf( name, sizeof( name ), "_trace.%s.%d", stack, depth );
+	return mlt_properties_get_data( MLT_FRAME_PROPERTIES( frame ), name, NULL );
+}
+
+/** Record the time spent in a get_image or get_audio callback.
+ *
+ * \public \memberof mlt_trace
+ * \param callback the callback
+ * \param service the service that pushed the callback or NULL if unknown
+ * \param category "get_image" or "get_audio"
+ * \param begin the value of mlt_trace_now() when the callback was called
+ */
+
+void mlt_trace_callback( void *callback, void *service, const char *category, int64_t begin )
+{
+	char name[TRACE_NAME_SIZE];
+	int64_t end;
+
+	if ( !begin )
+		return;
+	end = trace_clock();
+
+	if ( perf_enabled && service )
+		perf_count( service, strcmp( category, perf_op_names[PERF_GET_AUDIO] ) ? PERF_GET_IMAGE : PERF_GET_AUDIO, end - begin );
+	if ( !trace_enabled )
+		return;
+
+	if ( service )
+	{
+		trace_service_name( service, name );
+	}
+	else
+	{
+		// Fall back to the symbol or the module and offset of a callback
+		// pushed outside of any service's get_frame or process
+		Dl_info info;
+		int found = dladdr( callback, &info ) != 0;
+		if ( found && info.dli_sname )
+			snprintf( name, sizeof( name ), "%s", info.dli_sname );
+		else if ( found && info.dli_fname )
+		{
+			char *module = strdup( info.dli_fname );
+			snprintf( name, sizeof( name ), "%s+%#lx", module ? basename( module ) : "?",
+				(unsigned long) ( (char*) callback - (char*) info.dli_fbase ) );
+			free( module );
+		}
+		else
+			snprintf( name, sizeof( name ), "%s %p", category, callback );
+	}
+	trace_record( service ? service : callback, category, name, begin, end );
+}
+
+/** Count bytes allocated on behalf of the current service.
+ *
+ * \public \memberof mlt_trace
+ * \param size the number of bytes
+ */
+
+void mlt_trace_alloc( int size )
+{
+	trace_thread *thread;
+
+	// Only threads that already entered a service can have one to charge
+	if ( perf_enabled && ( thread = pthread_getspecific( trace_key ) ) && thread->current )
+	{
+		perf_counters *counters = perf_get( thread->current );
+		if ( counters )
+			atomic_fetch_add( &counters->bytes, size );
+	}
+}
+
+/** Get the performance counters of a service.
+ *
+ * \public \memberof mlt_trace
+ * \param service a service
+ * \return a new properties list that the caller must close
+ * \see mlt_service_perf_stats
+ */
+
+mlt_properties mlt_trace_service_stats( void *service )
+{
+	mlt_properties stats = mlt_properties_new();
+	perf_counters *counters;
+	char name[32];
+	int op, bucket;
+
+	if ( !stats || !service )
+		return stats;
+
+	counters = mlt_properties_get_data( MLT_SERVICE_PROPERTIES( (mlt_service) service ), "_perf", NULL );
+	for ( op = 0; op < PERF_OPS; op++ )
+	{
+		int64_t count = counters ? counters->ops[op].count : 0;
+		int64_t time = counters ? counters->ops[op].time : 0;
+		int64_t p99 = 0;
+
+		// Find the bucket that holds the 99th percentile
+		if ( count > 0 )
+		{
+			int64_t target = count - count / 100, seen = 0;
+			for ( bucket = 0; bucket < PERF_BUCKETS; bucket++ )
+			{
+				seen += counters->ops[op].histogram[bucket];
+				if ( seen >= target )
+					break;
+			}
+			p99 = perf_bucket_limit( bucket );
+		}
+		snprintf( name, sizeof( name ), "%s_count", perf_op_names[op] );
+		mlt_properties_set_int64( stats, name, count );
+		snprintf( name, sizeof( name ), "%s_time", perf_op_names[op] );
+		mlt_properties_set_int64( stats, name, time );
+		snprintf( name, sizeof( name ), "%s_avg", perf_op_names[op] );
+		mlt_properties_set_double( stats, name, count ? (double) time / count : 0.0 );
+		snprintf( name, sizeof( name ), "%s_p99", perf_op_names[op] );
+		mlt_properties_set_int64( stats, name, p99 );
+	}
+	mlt_properties_set_int64( stats, "bytes_allocated", counters ? counters->bytes : 0 );
+	if ( mlt_service_identify( service ) == mlt_service_consumer_type )
+		mlt_properties_set_int( stats, "frames_dropped",
+			mlt_properties_get_int( MLT_SERVICE_PROPERTIES( (mlt_service) service ), "drop_count" ) );
+
+	return stats;
+}
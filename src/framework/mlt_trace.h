@@ -0,0 +1,44 @@
+/**
+ * \file mlt_trace.h
+ * \brief hot path tracing in the Chrome trace event format
+ *
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MLT_TRACE_H
+#define MLT_TRACE_H
+
+#include "mlt_types.h"
+
+#include <stdint.h>
+
+extern int mlt_trace_start( const char *filename );
+extern void mlt_trace_stop( void );
+extern int mlt_trace_is_enabled( void );
+extern int64_t mlt_trace_now( void );
+extern void mlt_trace_event( void *service, const char *category, const char *name, int64_t begin );
+extern void *mlt_trace_enter( void *service );
+extern void mlt_trace_leave( void *previous );
+extern void mlt_trace_set_counters( int enabled );
+extern int mlt_trace_get_counters( void );
+extern void mlt_trace_push( mlt_frame frame, const char *stack, int depth );
+extern void *mlt_trace_pusher( mlt_frame frame, const char *stack, int depth );
+extern void mlt_trace_callback( void *callback, void *service, const char *category, int64_t begin );
+extern void mlt_trace_alloc( int size );
+extern mlt_properties mlt_trace_service_stats( void *service );
+
+#endif
@@ -37,6 +37,7 @@
 
 static int producer_get_frame( mlt_producer parent, mlt_frame_ptr frame, int track );
 static void mlt_tractor_listener( mlt_multitrack tracks, mlt_tractor self );
+static void mlt_tractor_sync( mlt_tractor self );
 
 /** Construct a tractor without a field or multitrack.
  *
@@ -197,18 +198,68 @@ void mlt_tractor_refresh( mlt_tractor self )
 	mlt_properties multitrack_props = MLT_MULTITRACK_PROPERTIES( multitrack );
 	mlt_properties properties = MLT_TRACTOR_PROPERTIES( self );
 	mlt_events_block( multitrack_props, properties );
-	mlt_events_block( properties, properties );
 	mlt_multitrack_refresh( multitrack );
+	mlt_events_unblock( multitrack_props, properties );
+	mlt_tractor_sync( self );
+}
+
+/** Copy the length of the multitrack to the tractor.
+ *
+ * \private \memberof mlt_tractor_s
+ * \param self a tractor
+ */
+
+static void mlt_tractor_sync( mlt_tractor self )
+{
+	mlt_properties multitrack_props = MLT_MULTITRACK_PROPERTIES( mlt_tractor_multitrack( self ) );
+	mlt_properties properties = MLT_TRACTOR_PROPERTIES( self );
+	mlt_events_block( properties, properties );
 	mlt_properties_set_position( properties, "in", 0 );
 	mlt_properties_set_position( properties, "out", mlt_properties_get_position( multitrack_props, "out" ) );
 	mlt_events_unblock( properties, properties );
-	mlt_events_unblock( multitrack_props, properties );
 	mlt_properties_set_position( properties, "length", mlt_properties_get_position( multitrack_props, "length" ) );
 }
 
+/** Listener for changes to the multitrack.
+ *
+ * The multitrack has already refreshed itself by the time it announces a change,
+ * so this only passes on its length.
+ * \private \memberof mlt_tractor_s
+ * \param tracks the multitrack
+ * \param self a tractor
+ */
+
 static void mlt_tractor_listener( mlt_multitrack tracks, mlt_tractor self )
 {
-	mlt_tractor_refresh( self );
+	mlt_tractor_sync( self );
+}
+
+/** Start a batch of changes to the tracks.
+ *
+ * The tractor and its multitrack are not refreshed for changes to the tracks
+ * until the matching mlt_tractor_end_update(). Batches can be nested.
+ * \public \memberof mlt_tractor_s
+ * \param self a tractor
+ * \see mlt_multitrack_begin_update
+ */
+
+void mlt_tractor_begin_update( mlt_tractor self )
+{
+	if ( self )
+		mlt_multitrack_begin_update( mlt_tractor_multitrack( self ) );
+}
+
+/** Finish a batch of changes to the tracks.
+ *
+ * \public \memberof mlt_tractor_s
+ * \param self a tractor
+ * \see mlt_multitrack_end_update
+ */
+
+void mlt_tractor_end_update( mlt_tractor self )
+{
+	if ( self )
+		mlt_multitrack_end_update( mlt_tractor_multitrack( self ) );
 }
 
 /** Connect the tractor.
@@ -365,6 +416,7 @@ static int producer_get_image( mlt_frame self, uint8_t **buffer, mlt_image_forma
 	mlt_properties_set( frame_properties, "deinterlace_method", mlt_properties_get( properties, "deinterlace_method" ) );
 	mlt_properties_set_int( frame_properties, "consumer_tff", mlt_properties_get_int( properties, "consumer_tff" ) );
 	mlt_properties_set( frame_properties, "consumer_color_trc", mlt_properties_get( properties, "consumer_color_trc" ) );
+	mlt_properties_set_int( frame_properties, "consumer_proxy", mlt_properties_get_int( properties, "consumer_proxy" ) );
 	// WebVfx uses this to setup a consumer-stopping event handler.
 	mlt_properties_set_data( frame_properties, "consumer", mlt_properties_get_data( properties, "consumer", NULL ), 0, NULL, NULL );
 
@@ -480,6 +532,9 @@ static int producer_get_frame( mlt_producer parent, mlt_frame_ptr frame, int tra
 			// Temporary properties
 			mlt_properties temp_properties = NULL;
 
+			// Allow transitions to render the tracks concurrently
+			int parallel = mlt_properties_get_int( properties, "parallel_tracks" );
+
 			// Get the multitrack's producer
 			mlt_producer target = MLT_MULTITRACK_PRODUCER( multitrack );
 			mlt_producer_seek( target, mlt_producer_frame( parent ) );
@@ -521,6 +576,9 @@ static int producer_get_frame( mlt_producer parent, mlt_frame_ptr frame, int tra
 				// Check for last track
 				done = mlt_properties_get_int( temp_properties, "last_track" );
 
+				if ( parallel )
+					mlt_properties_set_int( temp_properties, "_prefetch", 1 );
+
 				// Handle fx only tracks
 				if ( mlt_properties_get_int( temp_properties, "fx_cut" ) )
 				{
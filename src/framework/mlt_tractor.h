@@ -34,6 +34,7 @@
  * \properties \em multitrack holds a reference to the mulitrack object that a tractor manages
  * \properties \em field holds a reference to the field object that a tractor manages
  * \properties \em producer holds a reference to an encapsulated producer
+ * \properties \em parallel_tracks set non-zero to let transitions render the images and audio of tracks concurrently
  */
 
 struct mlt_tractor_s
@@ -55,6 +56,8 @@ extern mlt_field mlt_tractor_field( mlt_tractor self );
 extern mlt_multitrack mlt_tractor_multitrack( mlt_tractor self );
 extern int mlt_tractor_connect( mlt_tractor self, mlt_service service );
 extern void mlt_tractor_refresh( mlt_tractor self );
+extern void mlt_tractor_begin_update( mlt_tractor self );
+extern void mlt_tractor_end_update( mlt_tractor self );
 extern int mlt_tractor_set_track( mlt_tractor self, mlt_producer producer, int index );
 extern int mlt_tractor_insert_track( mlt_tractor self, mlt_producer producer, int index );
 extern int mlt_tractor_remove_track( mlt_tractor self, int index );
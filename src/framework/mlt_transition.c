@@ -24,6 +24,7 @@
 #include "mlt_frame.h"
 #include "mlt_log.h"
 #include "mlt_producer.h"
+#include "mlt_trace.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -320,8 +321,11 @@ mlt_frame mlt_transition_process( mlt_transition self, mlt_frame a_frame, mlt_fr
 {
 	if ( self->process == NULL )
 		return a_frame;
-	else
-		return self->process( self, a_frame, b_frame );
+
+	void *trace_previous = mlt_trace_enter( self );
+	a_frame = self->process( self, a_frame, b_frame );
+	mlt_trace_leave( trace_previous );
+	return a_frame;
 }
 
 static int get_image_a( mlt_frame a_frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
@@ -338,7 +342,19 @@ static int get_image_a( mlt_frame a_frame, uint8_t **image, mlt_image_format *fo
 	if ( mlt_frame_get_aspect_ratio( a_frame ) == 0.0 )
 		mlt_frame_set_aspect_ratio( a_frame, mlt_profile_sar( mlt_service_profile( MLT_TRANSITION_SERVICE(self) ) ) );
 
-	return mlt_frame_get_image( a_frame, image, format, width, height, writable );
+	// Give the region of interest that the transition set to the services below
+	mlt_rect roi;
+	if ( mlt_frame_get_roi( a_frame, &roi ) )
+		mlt_frame_set_roi( a_frame, roi );
+	int error = mlt_frame_get_image( a_frame, image, format, width, height, writable );
+
+	// Keep the alpha bounds of the image for the transition
+	mlt_rect bounds;
+	int opaque;
+	if ( !error && mlt_frame_get_alpha_bounds( a_frame, &bounds, &opaque ) )
+		mlt_frame_set_alpha_bounds( a_frame, bounds, opaque );
+
+	return error;
 }
 
 static int get_image_b( mlt_frame b_frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
@@ -362,9 +378,21 @@ static int get_image_b( mlt_frame b_frame, uint8_t **image, mlt_image_format *fo
 		mlt_frame_set_aspect_ratio( b_frame, mlt_profile_sar( mlt_service_profile( MLT_TRANSITION_SERVICE(self) ) ) );
 
 	mlt_properties_pass_list( b_props, a_props,
-		"consumer_deinterlace, deinterlace_method, consumer_tff, consumer_color_trc, consumer_channel_layout" );
+		"consumer_deinterlace, deinterlace_method, consumer_tff, consumer_color_trc, consumer_channel_layout, consumer_proxy" );
 
-	return mlt_frame_get_image( b_frame, image, format, width, height, writable );
+	// Give the region of interest that the transition set to the services below
+	mlt_rect roi;
+	if ( mlt_frame_get_roi( b_frame, &roi ) )
+		mlt_frame_set_roi( b_frame, roi );
+	int error = mlt_frame_get_image( b_frame, image, format, width, height, writable );
+
+	// Keep the alpha bounds of the image for the transition
+	mlt_rect bounds;
+	int opaque;
+	if ( !error && mlt_frame_get_alpha_bounds( b_frame, &bounds, &opaque ) )
+		mlt_frame_set_alpha_bounds( b_frame, bounds, opaque );
+
+	return error;
 }
 
 /** Get a frame from a transition.
@@ -479,6 +507,10 @@ static int transition_get_frame( mlt_service service, mlt_frame_ptr frame, int i
 				break;
 		}
 
+		// A transition of the images has nothing to do without video
+		if ( active && type == 1 && mlt_frame_is_video_off( self->frames[ b_frame ] ) )
+			active = 0;
+
 		// Now handle the non-always active case
 		if ( active && !always_active && a_frame <= b_track )
 		{
@@ -52,6 +52,11 @@ typedef enum
 	mlt_image_movit,          /**< for movit module internal use only */
 	mlt_image_opengl_texture, /**< an OpenGL texture name */
 	mlt_image_yuv422p16,      /**< planar YUV 4:2:2, 32bpp, (1 Cr & Cb sample per 2x1 Y samples), little-endian */
+	mlt_image_yuv420p10,      /**< planar YUV 4:2:0, 24bpp, 10 bits in the low bits of 16, little-endian */
+	mlt_image_nv12,           /**< 8-bit YUV 4:2:0, a Y plane followed by an interleaved Cb and Cr plane */
+	mlt_image_p010,           /**< YUV 4:2:0 like nv12, 10 bits in the high bits of 16, little-endian */
+	mlt_image_rgba64,         /**< 16-bit RGB with alpha channel, little-endian */
+	mlt_image_hwframe,        /**< a hardware surface, the image is an opaque handle (AVFrame for avformat) */
 	mlt_image_invalid
 }
 mlt_image_format;
@@ -170,6 +175,26 @@ typedef enum
 }
 mlt_service_type;
 
+/** The priority classes of sliced processing work */
+
+typedef enum
+{
+	mlt_slices_priority_low = -1,   /**< background work that yields to the rest */
+	mlt_slices_priority_normal = 0, /**< the default */
+	mlt_slices_priority_high = 1    /**< interactive work such as a preview */
+}
+mlt_slices_priority;
+
+/** The levels of memory pressure */
+
+typedef enum
+{
+	mlt_memory_pressure_none = 0,     /**< memory is plentiful */
+	mlt_memory_pressure_moderate = 1, /**< release what is cheap to recreate */
+	mlt_memory_pressure_critical = 2  /**< release everything possible and buffer the minimum */
+}
+mlt_memory_pressure;
+
 /* I don't want to break anyone's applications without warning. -Zach */
 #ifdef DOUBLE_MLT_POSITION
 #define MLT_POSITION_FMT "%f"
@@ -207,6 +232,7 @@ typedef struct mlt_image_s *mlt_image;                  /**< pointer to Image ob
 typedef struct mlt_frame_s *mlt_frame, **mlt_frame_ptr; /**< pointer to Frame object */
 typedef struct mlt_property_s *mlt_property;            /**< pointer to Property object */
 typedef struct mlt_properties_s *mlt_properties;        /**< pointer to Properties object */
+typedef struct mlt_property_atom_s *mlt_property_atom;  /**< pointer to an interned property name */
 typedef struct mlt_event_struct *mlt_event;             /**< pointer to Event object */
 typedef struct mlt_service_s *mlt_service;              /**< pointer to Service object */
 typedef struct mlt_producer_s *mlt_producer;            /**< pointer to Producer object */
@@ -219,6 +245,9 @@ typedef struct mlt_field_s *mlt_field;                  /**< pointer to Field ob
 typedef struct mlt_consumer_s *mlt_consumer;            /**< pointer to Consumer object */
 typedef struct mlt_parser_s *mlt_parser;                /**< pointer to Properties object */
 typedef struct mlt_deque_s *mlt_deque;                  /**< pointer to Deque object */
+typedef struct mlt_ring_s *mlt_ring;                    /**< pointer to Ring object */
+typedef struct mlt_audio_ring_s *mlt_audio_ring;        /**< pointer to Audio Ring object */
+typedef struct mlt_peaks_s *mlt_peaks;                  /**< pointer to Peaks object */
 typedef struct mlt_geometry_s *mlt_geometry;            /**< pointer to Geometry object */
 typedef struct mlt_geometry_item_s *mlt_geometry_item;  /**< pointer to Geometry Item object */
 typedef struct mlt_profile_s *mlt_profile;              /**< pointer to Profile object */
@@ -227,6 +256,8 @@ typedef struct mlt_cache_s *mlt_cache;                  /**< pointer to Cache ob
 typedef struct mlt_cache_item_s *mlt_cache_item;        /**< pointer to CacheItem object */
 typedef struct mlt_animation_s *mlt_animation;          /**< pointer to Property Animation object */
 typedef struct mlt_slices_s *mlt_slices;                /**< pointer to Sliced processing context object */
+typedef struct mlt_slices_task_s *mlt_slices_task;      /**< pointer to Sliced processing task object */
+typedef struct mlt_slices_group_s *mlt_slices_group;    /**< pointer to Sliced processing task group object */
 typedef struct mlt_link_s *mlt_link;                    /**< pointer to Link object */
 typedef struct mlt_chain_s *mlt_chain;                  /**< pointer to Chain object */
 
@@ -0,0 +1,797 @@
+/*
+ * farm.c -- melt render farm
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <limits.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "farm.h"
+
+/* The coordinator splits the timeline into chunks like the segments of the
+ * avformat consumer and sends each chunk to a worker on a TCP connection of
+ * its own:
+ *
+ *     MELT-FARM 2
+ *     secret <the value of MELT_FARM_SECRET>
+ *     in <frame>
+ *     out <frame>
+ *     set <name>=<value>      once for each property of the consumer
+ *     xml <bytes>
+ *     <the project as MLT XML>
+ *
+ * The worker answers with "progress <frames>" every second while it renders,
+ * then "file <bytes>" followed by the Matroska file of the chunk or
+ * "error <message>". The coordinator stores the chunks next to the target and
+ * lets the avformat consumer concatenate them without encoding again.
+ *
+ * Anyone who can connect to a worker and knows the secret can make it read
+ * any file that its user can read, so a worker listens on the loopback
+ * interface unless it is given an address. Neither the secret nor the chunks
+ * are encrypted. The worker always writes Matroska to a temporary file of its
+ * own and refuses the properties that name other files.
+ */
+
+#define FARM_MAGIC "MELT-FARM 2"
+#define FARM_SECRET "MELT_FARM_SECRET"
+
+// A host is dropped after this many jobs in a row failed on it
+#define FARM_HOST_FAILURES 3
+
+static volatile sig_atomic_t farm_stopped = 0;
+
+static void farm_stop_handler( int signum )
+{
+	farm_stopped = 1;
+}
+
+static void farm_signals( )
+{
+	struct sigaction action;
+
+	// Without SA_RESTART, so that a blocking accept returns
+	memset( &action, 0, sizeof( action ) );
+	action.sa_handler = farm_stop_handler;
+	sigaction( SIGINT, &action, NULL );
+	sigaction( SIGTERM, &action, NULL );
+	signal( SIGPIPE, SIG_IGN );
+}
+
+/** Split [host:]port, returning the host, which the caller frees, or NULL.
+*/
+
+static char *split_address( const char *address, const char **port )
+{
+	const char *colon = strrchr( address, ':' );
+
+	if ( !colon )
+	{
+		*port = address;
+		return NULL;
+	}
+	*port = colon + 1;
+	// A numeric IPv6 address is in brackets
+	if ( address[0] == '[' && colon > address + 1 && colon[-1] == ']' )
+		return strndup( address + 1, colon - address - 2 );
+	return strndup( address, colon - address );
+}
+
+/** Get the secret that the coordinator and the workers share, or NULL.
+*/
+
+static const char *farm_secret( )
+{
+	const char *secret = getenv( FARM_SECRET );
+
+	if ( !secret || !secret[0] || strchr( secret, '\n' ) )
+	{
+		fprintf( stderr, "The farm needs a secret in the " FARM_SECRET " environment variable\n" );
+		return NULL;
+	}
+	return secret;
+}
+
+/** Compare a secret in a time that does not depend on where it differs.
+*/
+
+static int secret_matches( const char *secret, const char *given )
+{
+	size_t length = strlen( secret );
+	size_t given_length = strlen( given );
+	unsigned char difference = length != given_length;
+	size_t i;
+
+	for ( i = 0; i < length; i++ )
+		difference |= secret[i] ^ given[ i < given_length ? i : 0 ];
+	return !difference;
+}
+
+static int farm_socket( const char *address, int server )
+{
+	const char *port = NULL;
+	char *host = split_address( address, &port );
+	struct addrinfo hints, *result = NULL, *ai;
+	int fd = -1;
+
+	memset( &hints, 0, sizeof( hints ) );
+	// Without AI_PASSIVE, a server without a host only listens on 127.0.0.1,
+	// which a coordinator reaches as localhost whichever address it tries first
+	hints.ai_family = server && !host ? AF_INET : AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if ( !getaddrinfo( host, port, &hints, &result ) )
+	{
+		for ( ai = result; ai && fd < 0; ai = ai->ai_next )
+		{
+			int error;
+
+			fd = socket( ai->ai_family, ai->ai_socktype, ai->ai_protocol );
+			if ( fd < 0 )
+				continue;
+			if ( server )
+			{
+				int on = 1;
+				setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on ) );
+				error = bind( fd, ai->ai_addr, ai->ai_addrlen ) || listen( fd, 8 );
+			}
+			else
+			{
+				error = connect( fd, ai->ai_addr, ai->ai_addrlen );
+			}
+			if ( error )
+			{
+				close( fd );
+				fd = -1;
+			}
+		}
+		freeaddrinfo( result );
+	}
+	free( host );
+	return fd;
+}
+
+/** Read a line without its newline, returning NULL at the end of the stream.
+*/
+
+static char *read_line( char **line, size_t *size, FILE *stream )
+{
+	ssize_t length = getline( line, size, stream );
+
+	if ( length <= 0 )
+		return NULL;
+	if ( ( *line )[ length - 1 ] == '\n' )
+		( *line )[ length - 1 ] = '\0';
+	return *line;
+}
+
+static int copy_bytes( FILE *from, FILE *to, long long size )
+{
+	char buffer[ 65536 ];
+
+	while ( size > 0 )
+	{
+		size_t n = fread( buffer, 1, size < (long long) sizeof( buffer ) ? (size_t) size : sizeof( buffer ), from );
+		if ( n == 0 || fwrite( buffer, 1, n, to ) != n )
+			return 1;
+		size -= n;
+	}
+	return 0;
+}
+
+/** The state of a chunk of the timeline */
+
+typedef struct
+{
+	int in, out;         // the range of the timeline to render
+	const char *disable; // "an" for video or "vn" for audio
+	char *target;        // the file which receives the chunk
+	int attempts;
+	int state;
+	int progress;        // the frames rendered so far
+}
+farm_job;
+
+enum
+{
+	job_pending,
+	job_running,
+	job_done,
+	job_failed
+};
+
+typedef struct
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	farm_job *jobs;
+	int count;
+	int retries;
+	int active;          // the hosts which are still taking jobs
+	int failed;
+	char *settings;      // the set lines which every job sends
+	char *xml;
+	const char *secret;
+}
+farm_state;
+
+typedef struct
+{
+	farm_state *farm;
+	const char *address;
+	pthread_t thread;
+}
+farm_host;
+
+/** Render a chunk on a host, returning NULL or an error message, which the caller frees.
+*/
+
+static char *host_job( farm_host *host, farm_job *job )
+{
+	farm_state *farm = host->farm;
+	int fd = farm_socket( host->address, 0 );
+	FILE *in = fd < 0 ? NULL : fdopen( fd, "r" );
+	FILE *out = fd < 0 ? NULL : fdopen( dup( fd ), "w" );
+	char *line = NULL;
+	size_t size = 0;
+	char *message = NULL;
+
+	if ( !in || !out )
+		message = strdup( "could not connect" );
+	else if ( fprintf( out, FARM_MAGIC "\nsecret %s\nin %d\nout %d\nset %s=1\nset %s=1\n%sxml %zu\n%s",
+			farm->secret, job->in, job->out, job->disable, strcmp( job->disable, "an" ) ? "video_off" : "audio_off",
+			farm->settings, strlen( farm->xml ), farm->xml ) < 0 || fflush( out ) )
+		message = strdup( "could not send the job" );
+	while ( !message )
+	{
+		if ( !read_line( &line, &size, in ) )
+		{
+			message = strdup( "lost the connection" );
+		}
+		else if ( farm_stopped )
+		{
+			message = strdup( "stopped" );
+		}
+		else if ( !strncmp( line, "progress ", 9 ) )
+		{
+			pthread_mutex_lock( &farm->mutex );
+			job->progress = atoi( line + 9 );
+			pthread_mutex_unlock( &farm->mutex );
+		}
+		else if ( !strncmp( line, "file ", 5 ) )
+		{
+			FILE *file = fopen( job->target, "wb" );
+			if ( !file || copy_bytes( in, file, atoll( line + 5 ) ) )
+				message = strdup( "could not receive the chunk" );
+			if ( file && fclose( file ) && !message )
+				message = strdup( "could not write the chunk" );
+			break;
+		}
+		else if ( !strncmp( line, "error ", 6 ) )
+		{
+			message = strdup( line + 6 );
+		}
+		else
+		{
+			message = strdup( "not a melt farm worker" );
+		}
+	}
+	free( line );
+	if ( in )
+		fclose( in );
+	else if ( fd >= 0 )
+		close( fd );
+	if ( out )
+		fclose( out );
+	return message;
+}
+
+/** Take the jobs one after another for a host until none are left.
+*/
+
+static void *host_thread( void *arg )
+{
+	farm_host *host = arg;
+	farm_state *farm = host->farm;
+	int failures = 0;
+
+	pthread_mutex_lock( &farm->mutex );
+	while ( !farm->failed && !farm_stopped && failures < FARM_HOST_FAILURES )
+	{
+		farm_job *job = NULL;
+		int i, running = 0;
+
+		for ( i = 0; i < farm->count; i++ )
+		{
+			if ( !job && farm->jobs[i].state == job_pending )
+				job = &farm->jobs[i];
+			running += farm->jobs[i].state == job_running;
+		}
+		if ( !job )
+		{
+			// Another host may yet give a job back
+			if ( !running )
+				break;
+			pthread_cond_wait( &farm->cond, &farm->mutex );
+			continue;
+		}
+		job->state = job_running;
+		job->progress = 0;
+		pthread_mutex_unlock( &farm->mutex );
+
+		char *message = host_job( host, job );
+
+		pthread_mutex_lock( &farm->mutex );
+		job->progress = 0;
+		if ( !message )
+		{
+			job->state = job_done;
+			failures = 0;
+		}
+		else
+		{
+			if ( !farm_stopped )
+				fprintf( stderr, "Frames %d-%d failed on %s: %s\n", job->in, job->out, host->address, message );
+			free( message );
+			failures++;
+			if ( ++job->attempts > farm->retries )
+			{
+				job->state = job_failed;
+				farm->failed = 1;
+			}
+			else
+			{
+				job->state = job_pending;
+			}
+		}
+		pthread_cond_broadcast( &farm->cond );
+		if ( message && !farm_stopped )
+		{
+			// Give the host some time before it takes the next job
+			pthread_mutex_unlock( &farm->mutex );
+			sleep( failures );
+			pthread_mutex_lock( &farm->mutex );
+		}
+	}
+	if ( failures >= FARM_HOST_FAILURES )
+		fprintf( stderr, "Dropped %s from the farm\n", host->address );
+	farm->active--;
+	pthread_cond_broadcast( &farm->cond );
+	pthread_mutex_unlock( &farm->mutex );
+
+	return NULL;
+}
+
+/** Make the set lines of the consumer properties which the workers apply.
+*/
+
+static char *farm_settings( mlt_properties properties )
+{
+	static const char *skip[] = { "target", "f", "segments", "smart_render", "join_segments", "segment_size",
+		"farm_retries", "running", "mlt_type", "mlt_service", "progress", "silent", "melt_getc", "done",
+		"in", "out", "an", "vn", "audio_off", "video_off", "properties", NULL };
+	char *settings = NULL;
+	size_t size = 0;
+	FILE *stream = open_memstream( &settings, &size );
+	int i, j, count = mlt_properties_count( properties );
+
+	if ( !stream )
+		return NULL;
+	for ( i = 0; i < count; i++ )
+	{
+		const char *name = mlt_properties_get_name( properties, i );
+		const char *value = mlt_properties_get_value( properties, i );
+
+		if ( !name || !value || name[0] == '_' || strchr( name, '\n' ) || strchr( value, '\n' ) )
+			continue;
+		for ( j = 0; skip[j] && strcmp( skip[j], name ); j++ );
+		if ( !skip[j] )
+			fprintf( stream, "set %s=%s\n", name, value );
+	}
+	fprintf( stream, "set terminate_on_pause=1\n" );
+	fclose( stream );
+	return settings;
+}
+
+static char *farm_xml( mlt_producer producer )
+{
+	mlt_consumer consumer = mlt_factory_consumer( mlt_service_profile( MLT_PRODUCER_SERVICE( producer ) ), "xml", "string" );
+	char *xml = NULL;
+
+	if ( consumer )
+	{
+		mlt_consumer_connect( consumer, MLT_PRODUCER_SERVICE( producer ) );
+		mlt_consumer_start( consumer );
+		if ( mlt_properties_get( MLT_CONSUMER_PROPERTIES( consumer ), "string" ) )
+			xml = strdup( mlt_properties_get( MLT_CONSUMER_PROPERTIES( consumer ), "string" ) );
+		mlt_consumer_close( consumer );
+	}
+	return xml;
+}
+
+/** Render the producer on the workers and concatenate the chunks with the consumer.
+ *
+ * The consumer must be avformat writing a file. It is rendered in chunks of
+ * whole GOPs, as many as its segments property or four for each host, and
+ * the audio of the whole timeline is one more chunk. A failed chunk is sent
+ * again up to farm_retries times (2 by default), to another host if one is
+ * free. The hosts are a comma separated list of host:port, where a host may
+ * appear more than once to render several chunks on it at the same time.
+ * The sources of the project must be found at the same paths on the workers,
+ * and the secret in MELT_FARM_SECRET must be the one they were started with.
+ */
+
+int farm_render( mlt_consumer consumer, mlt_producer producer, const char *hosts, int silent )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+	const char *service = mlt_properties_get( properties, "mlt_service" );
+	const char *target = mlt_properties_get( properties, "target" );
+	const char *acodec = mlt_properties_get( properties, "acodec" );
+	const char *vcodec = mlt_properties_get( properties, "vcodec" );
+	int gop = mlt_properties_get_int( properties, "g" ) > 0 ? mlt_properties_get_int( properties, "g" ) : 12;
+	int audio = !mlt_properties_get_int( properties, "an" ) && !( acodec && !strcmp( acodec, "none" ) );
+	int in = mlt_producer_get_in( producer );
+	int length = mlt_producer_get_playtime( producer );
+	farm_state farm;
+	farm_host *host_list = NULL;
+	char *address_list = strdup( hosts );
+	char *address, *save = NULL;
+	int i, count, size, host_count = 0, error = 1;
+
+	memset( &farm, 0, sizeof( farm ) );
+	farm.secret = farm_secret( );
+	if ( !farm.secret )
+		goto exit;
+	if ( !service || strcmp( service, "avformat" ) || !target || !strcmp( target, "" ) || strstr( target, "://" )
+		|| !strncmp( target, "pipe:", 5 ) || mlt_properties_get_int( properties, "redirect" )
+		|| mlt_properties_get( properties, "target.1" ) )
+	{
+		fprintf( stderr, "The farm needs -consumer avformat:file\n" );
+		goto exit;
+	}
+	if ( mlt_properties_get_int( properties, "vn" ) || ( vcodec && !strcmp( vcodec, "none" ) )
+		|| mlt_properties_get_int( properties, "pass" ) )
+	{
+		fprintf( stderr, "The farm needs video and a single pass\n" );
+		goto exit;
+	}
+
+	for ( address = strtok_r( address_list, ",", &save ); address; address = strtok_r( NULL, ",", &save ) )
+	{
+		host_list = realloc( host_list, ( host_count + 1 ) * sizeof( *host_list ) );
+		host_list[ host_count ].farm = &farm;
+		host_list[ host_count ].address = address;
+		host_count++;
+	}
+	farm.xml = farm_xml( producer );
+	farm.settings = farm_settings( properties );
+	if ( !host_count || !farm.xml || !farm.settings || length <= 0 )
+	{
+		fprintf( stderr, "Failed to prepare the project for the farm\n" );
+		goto exit;
+	}
+
+	// Round the chunks up to whole GOPs
+	count = mlt_properties_get_int( properties, "segments" ) > 0 ? mlt_properties_get_int( properties, "segments" ) : 4 * host_count;
+	size = ( length + count - 1 ) / count;
+	size = ( size + gop - 1 ) / gop * gop;
+	count = ( length + size - 1 ) / size;
+	farm.count = count + audio;
+	farm.jobs = calloc( farm.count, sizeof( *farm.jobs ) );
+	farm.retries = mlt_properties_get( properties, "farm_retries" ) ? mlt_properties_get_int( properties, "farm_retries" ) : 2;
+	for ( i = 0; i < farm.count; i++ )
+	{
+		farm_job *job = &farm.jobs[i];
+		int video = i < count;
+
+		job->target = malloc( strlen( target ) + 20 );
+		sprintf( job->target, "%s.%d.mkv", target, i );
+		job->in = video ? in + i * size : in;
+		job->out = video ? in + ( ( i + 1 ) * size < length ? ( i + 1 ) * size : length ) - 1 : in + length - 1;
+		job->disable = video ? "an" : "vn";
+	}
+	if ( !silent )
+		fprintf( stderr, "Rendering %d chunks of %d frames on %d hosts\n", count, size, host_count );
+
+	farm_signals( );
+	pthread_mutex_init( &farm.mutex, NULL );
+	pthread_cond_init( &farm.cond, NULL );
+	farm.active = host_count;
+	for ( i = 0; i < host_count; i++ )
+		pthread_create( &host_list[i].thread, NULL, host_thread, &host_list[i] );
+
+	// Report the progress of all of the chunks
+	pthread_mutex_lock( &farm.mutex );
+	while ( farm.active > 0 )
+	{
+		struct timespec deadline;
+		clock_gettime( CLOCK_REALTIME, &deadline );
+		deadline.tv_sec += 1;
+		pthread_cond_timedwait( &farm.cond, &farm.mutex, &deadline );
+		if ( !silent )
+		{
+			int done = 0, frames = 0, total = 0;
+			for ( i = 0; i < farm.count; i++ )
+			{
+				int frames_in_job = farm.jobs[i].out - farm.jobs[i].in + 1;
+				done += farm.jobs[i].state == job_done;
+				frames += farm.jobs[i].state == job_done ? frames_in_job : farm.jobs[i].progress;
+				total += frames_in_job;
+			}
+			fprintf( stderr, "Chunks: %5d of %5d, percentage: %10d%c", done, farm.count, 100 * frames / total, '\r' );
+		}
+	}
+	pthread_mutex_unlock( &farm.mutex );
+	for ( i = 0; i < host_count; i++ )
+		pthread_join( host_list[i].thread, NULL );
+	if ( !silent )
+		fprintf( stderr, "\n" );
+	pthread_cond_destroy( &farm.cond );
+	pthread_mutex_destroy( &farm.mutex );
+
+	for ( error = farm_stopped, i = 0; i < farm.count; i++ )
+		error |= farm.jobs[i].state != job_done;
+	if ( !error )
+	{
+		// Concatenate the chunks into the target, which also removes them
+		mlt_properties_set_int( properties, "segments", count );
+		mlt_properties_set_int( properties, "segment_size", size );
+		mlt_properties_set_int( properties, "join_segments", 1 );
+		mlt_properties_set_int( properties, "smart_render", 0 );
+		error = mlt_consumer_start( consumer );
+		while ( !error && !mlt_consumer_is_stopped( consumer ) )
+			usleep( 100000 );
+		mlt_consumer_stop( consumer );
+	}
+	else
+	{
+		fprintf( stderr, "The farm failed to render the project\n" );
+		for ( i = 0; i < farm.count; i++ )
+			remove( farm.jobs[i].target );
+	}
+
+exit:
+	for ( i = 0; farm.jobs && i < farm.count; i++ )
+		free( farm.jobs[i].target );
+	free( farm.jobs );
+	free( farm.settings );
+	free( farm.xml );
+	free( host_list );
+	free( address_list );
+	return error;
+}
+
+static void on_worker_error( mlt_properties owner, mlt_consumer consumer )
+{
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( consumer ), "farm_error", 1 );
+}
+
+/** Tell whether a worker refuses a property, which is one that names a file or a muxer.
+*/
+
+static int worker_refuses( const char *name )
+{
+	static const char *names[] = { "f", "properties", "pass", "passlogfile", "vpre", "apre", "fpre",
+		"redirect", "mlt_type", "mlt_service", NULL };
+	// Codec options such as x264-params or stats may hold paths too
+	static const char *parts[] = { "target", "file", "path", "dir", "stats", "params", "opts", NULL };
+	int i;
+
+	if ( name[0] == '_' )
+		return 1;
+	for ( i = 0; names[i]; i++ )
+		if ( !strcmp( names[i], name ) )
+			return 1;
+	for ( i = 0; parts[i]; i++ )
+		if ( strstr( name, parts[i] ) )
+			return 1;
+	return 0;
+}
+
+/** Render a chunk for the coordinator on the other end of the connection.
+*/
+
+static void worker_job( FILE *in, FILE *out, const char *secret )
+{
+	mlt_properties settings = mlt_properties_new( );
+	mlt_profile profile = NULL;
+	mlt_producer producer = NULL;
+	mlt_consumer consumer = NULL;
+	char *line = NULL;
+	size_t size = 0;
+	char *xml = NULL;
+	const char *message = NULL;
+	int in_point = 0, out_point = -1;
+	char path[ PATH_MAX ] = "";
+	const char *tmpdir = getenv( "TMPDIR" );
+	int fd;
+
+	if ( !read_line( &line, &size, in ) || strcmp( line, FARM_MAGIC ) )
+		goto exit;
+	if ( !read_line( &line, &size, in ) || strncmp( line, "secret ", 7 ) || !secret_matches( secret, line + 7 ) )
+	{
+		fprintf( stderr, "Refused a coordinator without the secret\n" );
+		fprintf( out, "error wrong secret\n" );
+		fflush( out );
+		goto exit;
+	}
+	while ( !xml && read_line( &line, &size, in ) )
+	{
+		if ( !strncmp( line, "in ", 3 ) )
+		{
+			in_point = atoi( line + 3 );
+		}
+		else if ( !strncmp( line, "out ", 4 ) )
+		{
+			out_point = atoi( line + 4 );
+		}
+		else if ( !strncmp( line, "set ", 4 ) && strchr( line, '=' ) )
+		{
+			char *value = strchr( line, '=' );
+			*value++ = '\0';
+			if ( worker_refuses( line + 4 ) )
+			{
+				fprintf( stderr, "Refused the property %s\n", line + 4 );
+				fprintf( out, "error refused the property %s\n", line + 4 );
+				fflush( out );
+				goto exit;
+			}
+			mlt_properties_set( settings, line + 4, value );
+		}
+		else if ( !strncmp( line, "xml ", 4 ) )
+		{
+			size_t length = strtoul( line + 4, NULL, 10 );
+			xml = calloc( 1, length + 1 );
+			if ( !xml || fread( xml, 1, length, in ) != length )
+				goto exit;
+		}
+	}
+	if ( !xml )
+		goto exit;
+
+	fprintf( stderr, "Rendering frames %d-%d\n", in_point, out_point );
+	snprintf( path, sizeof( path ), "%s/melt-farm-XXXXXX", tmpdir ? tmpdir : "/tmp" );
+	fd = mkstemp( path );
+	if ( fd < 0 )
+	{
+		message = "could not create a temporary file";
+		goto answer;
+	}
+	close( fd );
+
+	// The profile comes with the XML
+	profile = mlt_profile_init( NULL );
+	producer = mlt_factory_producer( profile, "xml-string", xml );
+	consumer = producer ? mlt_factory_consumer( profile, "avformat", path ) : NULL;
+	if ( !producer || !consumer )
+	{
+		message = producer ? "failed to load the avformat consumer" : "failed to load the project";
+		goto answer;
+	}
+	mlt_properties_inherit( MLT_CONSUMER_PROPERTIES( consumer ), settings );
+	// Matroska can hold any codec and keeps the encoder's global headers
+	mlt_properties_set( MLT_CONSUMER_PROPERTIES( consumer ), "f", "matroska" );
+	mlt_producer_set_in_and_out( producer, in_point, out_point );
+	mlt_events_listen( MLT_CONSUMER_PROPERTIES( consumer ), consumer, "consumer-fatal-error", ( mlt_listener )on_worker_error );
+	mlt_consumer_connect( consumer, MLT_PRODUCER_SERVICE( producer ) );
+	if ( mlt_consumer_start( consumer ) )
+		message = "failed to start the consumer";
+	while ( !message && !mlt_consumer_is_stopped( consumer ) )
+	{
+		sleep( 1 );
+		if ( farm_stopped )
+			message = "the worker was stopped";
+		else if ( fprintf( out, "progress %d\n", (int) mlt_producer_position( producer ) ) < 0 || fflush( out ) )
+			goto exit;
+	}
+	mlt_consumer_stop( consumer );
+	if ( !message && mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( consumer ), "farm_error" ) )
+		message = "failed to encode";
+
+answer:
+	if ( !message )
+	{
+		FILE *file = fopen( path, "rb" );
+		struct stat info;
+
+		if ( file && !fstat( fileno( file ), &info ) )
+		{
+			fprintf( out, "file %lld\n", (long long) info.st_size );
+			copy_bytes( file, out, info.st_size );
+		}
+		else
+		{
+			fprintf( out, "error could not read the chunk\n" );
+		}
+		if ( file )
+			fclose( file );
+	}
+	else
+	{
+		fprintf( stderr, "Failed: %s\n", message );
+		fprintf( out, "error %s\n", message );
+	}
+	fflush( out );
+
+exit:
+	if ( consumer )
+	{
+		mlt_consumer_stop( consumer );
+		mlt_consumer_close( consumer );
+	}
+	mlt_producer_close( producer );
+	mlt_profile_close( profile );
+	if ( path[0] )
+		remove( path );
+	mlt_properties_close( settings );
+	free( xml );
+	free( line );
+}
+
+/** Take the jobs of coordinators one at a time until the process is stopped.
+*/
+
+int farm_worker( const char *address )
+{
+	const char *secret = farm_secret( );
+	int server = address && secret ? farm_socket( address, 1 ) : -1;
+
+	if ( !secret )
+		return 1;
+	if ( server < 0 )
+	{
+		fprintf( stderr, "Failed to listen on %s\n", address ? address : "(none)" );
+		return 1;
+	}
+	farm_signals( );
+	fprintf( stderr, "Waiting for jobs on %s\n", address );
+	while ( !farm_stopped )
+	{
+		int fd = accept( server, NULL, NULL );
+		FILE *in, *out;
+
+		if ( fd < 0 )
+		{
+			if ( errno == EINTR )
+				continue;
+			break;
+		}
+		in = fdopen( fd, "r" );
+		out = fdopen( dup( fd ), "w" );
+		if ( in && out )
+			worker_job( in, out, secret );
+		if ( in )
+			fclose( in );
+		else
+			close( fd );
+		if ( out )
+			fclose( out );
+	}
+	close( server );
+	return 0;
+}
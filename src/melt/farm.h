@@ -0,0 +1,37 @@
+/*
+ * farm.h -- melt render farm
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _MELT_FARM_H_
+#define _MELT_FARM_H_
+
+#include <framework/mlt.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+extern int farm_render( mlt_consumer consumer, mlt_producer producer, const char *hosts, int silent );
+extern int farm_worker( const char *address );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -28,6 +28,10 @@
 #include <limits.h>
 #include <unistd.h>
 #include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
 
 #include <framework/mlt.h>
 
@@ -36,6 +40,9 @@
 #endif
 
 #include "io.h"
+#ifndef _WIN32
+#include "farm.h"
+#endif
 
 static mlt_producer melt = NULL;
 
@@ -501,10 +508,15 @@ static void show_usage( char *program_name )
 "  -attach-track filter[:arg] [name=value]* Attach a filter to a track\n"
 "  -attach-clip filter[:arg] [name=value]*  Attach a filter to a producer\n"
 "  -audio-track | -hide-video               Add an audio-only track\n"
+"  -benchmark                               Render as fast as possible and report timings\n"
 "  -blank frames                            Add blank silence to a track\n"
 "  -chain id[:arg] [name=value]*            Add a producer as a chain\n"
 "  -consumer id[:arg] [name=value]*         Set the consumer (sink)\n"
 "  -debug                                   Set the logging level to debug\n"
+#ifndef _WIN32
+"  -farm host:port[,host:port]*             Render on melt -farm-worker hosts\n"
+"  -farm-worker [address:]port              Render chunks for melt -farm\n"
+#endif
 "  -filter filter[:arg] [name=value]*       Add a filter to the current track\n"
 "  -getc                                    Get keyboard input using getc\n"
 "  -group [name=value]*                     Apply properties repeatedly\n"
@@ -512,6 +524,8 @@ static void show_usage( char *program_name )
 "  -jack                                    Enable JACK transport synchronization\n"
 "  -join clips                              Join multiple clips into one cut\n"
 "  -link id[:arg] [name=value]*             Add a link to a chain\n"
+"  -metrics filename                        Write Prometheus metrics to a file\n"
+"  -metrics-interval seconds                Set how often the metrics are written\n"
 "  -mix length                              Add a mix between the last two cuts\n"
 "  -mixer transition                        Add a transition to the mix\n"
 "  -null-track | -hide-track                Add a hidden track\n"
@@ -737,6 +751,390 @@ static void on_fatal_error( mlt_properties owner, mlt_consumer consumer )
 	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES(consumer), "melt_error", 1 );
 }
 
+/** \brief the frame times collected by -benchmark */
+
+typedef struct
+{
+	int64_t start;
+	int64_t *times;
+	int count;
+	int size;
+}
+benchmark_data;
+
+static int64_t benchmark_clock( )
+{
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void on_benchmark_frame( mlt_properties owner, benchmark_data *data, mlt_event_data event_data )
+{
+	if ( data->count == data->size )
+	{
+		int64_t *times = realloc( data->times, sizeof( int64_t ) * ( data->size + 1024 ) );
+		if ( !times )
+			return;
+		data->times = times;
+		data->size += 1024;
+	}
+	data->times[ data->count ++ ] = benchmark_clock( );
+}
+
+static int compare_int64( const void *a, const void *b )
+{
+	int64_t x = *(const int64_t*) a, y = *(const int64_t*) b;
+	return x < y ? -1 : x > y;
+}
+
+static const char *service_type_name( mlt_service service )
+{
+	switch ( mlt_service_identify( service ) )
+	{
+		case mlt_service_tractor_type: return "tractor";
+		case mlt_service_playlist_type: return "playlist";
+		case mlt_service_multitrack_type: return "multitrack";
+		case mlt_service_filter_type: return "filter";
+		case mlt_service_transition_type: return "transition";
+		case mlt_service_consumer_type: return "consumer";
+		case mlt_service_field_type: return "field";
+		case mlt_service_link_type: return "link";
+		case mlt_service_chain_type: return "chain";
+		default: return "producer";
+	}
+}
+
+static void benchmark_service( mlt_service service, void *data )
+{
+	mlt_properties stats = mlt_service_perf_stats( service );
+	char name[ 64 ];
+
+	if ( mlt_properties_get_int64( stats, "get_frame_count" ) ||
+	     mlt_properties_get_int64( stats, "get_image_count" ) ||
+	     mlt_properties_get_int64( stats, "get_audio_count" ) )
+	{
+		const char *id = mlt_properties_get( MLT_SERVICE_PROPERTIES( service ), "mlt_service" );
+		if ( id )
+			snprintf( name, sizeof( name ), "%s %s", service_type_name( service ), id );
+		else
+			snprintf( name, sizeof( name ), "%s %p", service_type_name( service ), service );
+		fprintf( stdout, "%-32s %8d %9.3f %8d %9.3f %9.3f %8d %9.3f %10.1f\n", name,
+			mlt_properties_get_int( stats, "get_frame_count" ),
+			mlt_properties_get_double( stats, "get_frame_avg" ) / 1000.0,
+			mlt_properties_get_int( stats, "get_image_count" ),
+			mlt_properties_get_double( stats, "get_image_avg" ) / 1000.0,
+			mlt_properties_get_int64( stats, "get_image_p99" ) / 1000.0,
+			mlt_properties_get_int( stats, "get_audio_count" ),
+			mlt_properties_get_double( stats, "get_audio_avg" ) / 1000.0,
+			mlt_properties_get_int64( stats, "bytes_allocated" ) / 1048576.0 );
+	}
+	mlt_properties_close( stats );
+}
+
+/** \brief a function that walk_services calls on each service */
+
+typedef void ( *service_visitor )( mlt_service service, void *data );
+
+static void walk_services( mlt_service service, mlt_properties seen, service_visitor visit, void *data )
+{
+	char key[ 32 ];
+	int i;
+
+	if ( service == NULL )
+		return;
+	snprintf( key, sizeof( key ), "%p", service );
+	if ( mlt_properties_get_int( seen, key ) )
+		return;
+	mlt_properties_set_int( seen, key, 1 );
+
+	visit( service, data );
+	for ( i = 0; i < mlt_service_filter_count( service ); i ++ )
+		walk_services( MLT_FILTER_SERVICE( mlt_service_filter( service, i ) ), seen, visit, data );
+
+	switch ( mlt_service_identify( service ) )
+	{
+		case mlt_service_playlist_type:
+		{
+			mlt_playlist playlist = (mlt_playlist) MLT_PRODUCER( service );
+			mlt_playlist_clip_info info;
+			for ( i = 0; i < mlt_playlist_count( playlist ); i ++ )
+			{
+				if ( !mlt_playlist_get_clip_info( playlist, &info, i ) )
+				{
+					walk_services( MLT_PRODUCER_SERVICE( info.cut ), seen, visit, data );
+					walk_services( MLT_PRODUCER_SERVICE( info.producer ), seen, visit, data );
+				}
+			}
+			break;
+		}
+		case mlt_service_multitrack_type:
+		{
+			mlt_multitrack multitrack = (mlt_multitrack) MLT_PRODUCER( service );
+			for ( i = 0; i < mlt_multitrack_count( multitrack ); i ++ )
+				walk_services( MLT_PRODUCER_SERVICE( mlt_multitrack_track( multitrack, i ) ), seen, visit, data );
+			break;
+		}
+		case mlt_service_tractor_type:
+			walk_services( MLT_MULTITRACK_SERVICE( mlt_tractor_multitrack( (mlt_tractor) MLT_PRODUCER( service ) ) ), seen, visit, data );
+			walk_services( mlt_service_producer( service ), seen, visit, data );
+			break;
+		case mlt_service_chain_type:
+		{
+			mlt_chain chain = (mlt_chain) MLT_PRODUCER( service );
+			walk_services( MLT_PRODUCER_SERVICE( mlt_chain_get_source( chain ) ), seen, visit, data );
+			for ( i = 0; i < mlt_chain_link_count( chain ); i ++ )
+				walk_services( MLT_LINK_SERVICE( mlt_chain_link( chain, i ) ), seen, visit, data );
+			break;
+		}
+		default:
+			if ( mlt_service_identify( service ) == mlt_service_producer_type && mlt_producer_is_cut( MLT_PRODUCER( service ) ) )
+				walk_services( MLT_PRODUCER_SERVICE( mlt_producer_cut_parent( MLT_PRODUCER( service ) ) ), seen, visit, data );
+			walk_services( mlt_service_producer( service ), seen, visit, data );
+			break;
+	}
+}
+
+static void benchmark_report( benchmark_data *data, mlt_producer producer, mlt_consumer consumer )
+{
+	mlt_properties stats = mlt_service_perf_stats( MLT_CONSUMER_SERVICE( consumer ) );
+	mlt_properties seen = mlt_properties_new( );
+	int64_t *intervals = calloc( data->count + 1, sizeof( int64_t ) );
+	double seconds = 0.0;
+	int n = 0;
+	int i;
+
+	if ( data->count > 0 )
+		seconds = ( data->times[ data->count - 1 ] - data->start ) / 1000000.0;
+	for ( i = 0; intervals && i < data->count; i ++ )
+		intervals[ n ++ ] = data->times[ i ] - ( i ? data->times[ i - 1 ] : data->start );
+	if ( n )
+		qsort( intervals, n, sizeof( int64_t ), compare_int64 );
+
+	fprintf( stdout, "frames: %d\n", data->count );
+	fprintf( stdout, "seconds: %.3f\n", seconds );
+	fprintf( stdout, "fps: %.2f\n", seconds > 0.0 ? data->count / seconds : 0.0 );
+	if ( n )
+		fprintf( stdout, "frame_ms: p50 %.3f p90 %.3f p99 %.3f max %.3f\n",
+			intervals[ n / 2 ] / 1000.0, intervals[ n * 9 / 10 ] / 1000.0,
+			intervals[ n * 99 / 100 ] / 1000.0, intervals[ n - 1 ] / 1000.0 );
+	fprintf( stdout, "frames_dropped: %d\n", mlt_properties_get_int( stats, "frames_dropped" ) );
+	fprintf( stdout, "pool_peak_mib: %.1f\n", mlt_pool_high_water( ) / 1048576.0 );
+	fprintf( stdout, "%-32s %8s %9s %8s %9s %9s %8s %9s %10s\n", "service",
+		"frames", "frame_ms", "images", "image_ms", "image_p99", "audios", "audio_ms", "alloc_mib" );
+	walk_services( MLT_CONSUMER_SERVICE( consumer ), seen, benchmark_service, NULL );
+	walk_services( MLT_PRODUCER_SERVICE( producer ), seen, benchmark_service, NULL );
+	fflush( stdout );
+
+	free( intervals );
+	mlt_properties_close( seen );
+	mlt_properties_close( stats );
+}
+
+/** \brief the state of the -metrics writer */
+
+typedef struct
+{
+	const char *filename;
+	int interval;
+	mlt_producer producer;
+	mlt_consumer consumer;
+	int frames;
+	int running;
+	int64_t last_time;
+	int last_frames;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+}
+metrics_data;
+
+/** \brief a metric of the services written by metrics_service */
+
+typedef struct
+{
+	FILE *file;
+	const char *name;
+	const char *op;
+	const char *key;
+	double scale;
+}
+metrics_family;
+
+static void on_metrics_frame( mlt_properties owner, metrics_data *data, mlt_event_data event_data )
+{
+	pthread_mutex_lock( &data->mutex );
+	data->frames ++;
+	pthread_mutex_unlock( &data->mutex );
+}
+
+static void metrics_label( FILE *file, const char *value )
+{
+	for ( ; value && *value; value ++ )
+	{
+		if ( *value == '\\' || *value == '"' )
+			fputc( '\\', file );
+		fputc( *value == '\n' ? ' ' : *value, file );
+	}
+}
+
+static void metrics_service( mlt_service service, void *data )
+{
+	metrics_family *family = data;
+	mlt_properties stats = mlt_service_perf_stats( service );
+	char key[ 32 ];
+
+	snprintf( key, sizeof( key ), "%s_count", family->op );
+	if ( mlt_properties_get_int64( stats, key ) )
+	{
+		fprintf( family->file, "%s{type=\"%s\",service=\"", family->name, service_type_name( service ) );
+		metrics_label( family->file, mlt_properties_get( MLT_SERVICE_PROPERTIES( service ), "mlt_service" ) );
+		fprintf( family->file, "\",instance=\"%p\",op=\"%s\"} ", service, family->op );
+		snprintf( key, sizeof( key ), "%s_%s", family->op, family->key );
+		if ( family->scale == 1.0 )
+			fprintf( family->file, "%" PRId64 "\n", mlt_properties_get_int64( stats, key ) );
+		else
+			fprintf( family->file, "%.6f\n", mlt_properties_get_int64( stats, key ) * family->scale );
+	}
+	mlt_properties_close( stats );
+}
+
+static void metrics_header( FILE *file, const char *name, const char *type, const char *help )
+{
+	fprintf( file, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type );
+}
+
+static void metrics_write( metrics_data *data, int frames )
+{
+	static const char *ops[] = { "get_frame", "get_image", "get_audio" };
+	static const struct { const char *name, *type, *key, *help; double scale; } families[] = {
+		{ "mlt_service_calls_total", "counter", "count", "The number of calls to a service.", 1.0 },
+		{ "mlt_service_seconds_total", "counter", "time", "The time spent in the calls to a service.", 1e-6 },
+		{ "mlt_service_p99_seconds", "gauge", "p99", "The 99th percentile of the time of a call to a service since the start.", 1e-6 },
+	};
+	mlt_properties consumer_properties = MLT_CONSUMER_PROPERTIES( data->consumer );
+	mlt_properties pool = mlt_pool_get_stats( );
+	size_t length = strlen( data->filename );
+	char *temp = malloc( length + 5 );
+	int64_t now = benchmark_clock( );
+	double seconds = ( now - data->last_time ) / 1000000.0;
+	FILE *file;
+	int i, j;
+
+	if ( !temp )
+		return;
+	snprintf( temp, length + 5, "%s.tmp", data->filename );
+	file = mlt_fopen( temp, "w" );
+	if ( file )
+	{
+		metrics_header( file, "mlt_consumer_frames_total", "counter", "The number of frames shown by the consumer." );
+		fprintf( file, "mlt_consumer_frames_total %d\n", frames );
+		metrics_header( file, "mlt_consumer_fps", "gauge", "The frames shown per second since the last update." );
+		fprintf( file, "mlt_consumer_fps %.3f\n", seconds > 0.0 ? ( frames - data->last_frames ) / seconds : 0.0 );
+		metrics_header( file, "mlt_consumer_dropped_frames_total", "counter", "The number of frames the consumer dropped." );
+		fprintf( file, "mlt_consumer_dropped_frames_total %d\n", mlt_properties_get_int( consumer_properties, "drop_count" ) );
+		metrics_header( file, "mlt_consumer_position", "gauge", "The position of the last frame shown." );
+		fprintf( file, "mlt_consumer_position %d\n", mlt_consumer_position( data->consumer ) );
+		metrics_header( file, "mlt_consumer_queue_depth", "gauge", "The number of frames rendered ahead of the consumer." );
+		fprintf( file, "mlt_consumer_queue_depth %d\n", mlt_consumer_queue_depth( data->consumer ) );
+		metrics_header( file, "mlt_consumer_queue_size", "gauge", "The size of the read ahead buffer in frames." );
+		fprintf( file, "mlt_consumer_queue_size %d\n", mlt_properties_get_int( consumer_properties, "buffer" ) );
+		metrics_header( file, "mlt_pool_allocated_bytes", "gauge", "The bytes allocated by the memory pool." );
+		fprintf( file, "mlt_pool_allocated_bytes %" PRId64 "\n", mlt_properties_get_int64( pool, "allocated_bytes" ) );
+		metrics_header( file, "mlt_pool_used_bytes", "gauge", "The bytes of the memory pool in use." );
+		fprintf( file, "mlt_pool_used_bytes %" PRId64 "\n", mlt_properties_get_int64( pool, "used_bytes" ) );
+		metrics_header( file, "mlt_pool_high_water_bytes", "gauge", "The most bytes the memory pool allocated at once." );
+		fprintf( file, "mlt_pool_high_water_bytes %" PRId64 "\n", mlt_properties_get_int64( pool, "high_water" ) );
+		metrics_header( file, "mlt_pool_budget_bytes", "gauge", "The budget of the memory pool or 0 for unlimited." );
+		fprintf( file, "mlt_pool_budget_bytes %" PRId64 "\n", mlt_properties_get_int64( pool, "budget" ) );
+		metrics_header( file, "mlt_cache_bytes", "gauge", "The bytes held by all caches." );
+		fprintf( file, "mlt_cache_bytes %" PRId64 "\n", mlt_cache_get_total_bytes( ) );
+		metrics_header( file, "mlt_cache_budget_bytes", "gauge", "The budget of all caches or 0 for unlimited." );
+		fprintf( file, "mlt_cache_budget_bytes %" PRId64 "\n", mlt_cache_get_budget( ) );
+
+		// Each metric is written for all of the services at once
+		for ( i = 0; i < sizeof( families ) / sizeof( families[ 0 ] ); i ++ )
+		{
+			metrics_header( file, families[ i ].name, families[ i ].type, families[ i ].help );
+			for ( j = 0; j < sizeof( ops ) / sizeof( ops[ 0 ] ); j ++ )
+			{
+				metrics_family family = { file, families[ i ].name, ops[ j ], families[ i ].key, families[ i ].scale };
+				mlt_properties seen = mlt_properties_new( );
+				walk_services( MLT_CONSUMER_SERVICE( data->consumer ), seen, metrics_service, &family );
+				walk_services( MLT_PRODUCER_SERVICE( data->producer ), seen, metrics_service, &family );
+				mlt_properties_close( seen );
+			}
+		}
+
+		metrics_header( file, "mlt_metrics_timestamp_seconds", "gauge", "When these metrics were written." );
+		fprintf( file, "mlt_metrics_timestamp_seconds %" PRId64 "\n", (int64_t) time( NULL ) );
+
+		// Replace the file at once so that readers never see a partial file
+		if ( fclose( file ) == 0 && rename( temp, data->filename ) == 0 )
+		{
+			data->last_time = now;
+			data->last_frames = frames;
+		}
+		else
+		{
+			fprintf( stderr, "Failed to write the metrics to %s\n", data->filename );
+		}
+	}
+	mlt_properties_close( pool );
+	free( temp );
+}
+
+static void *metrics_thread( void *arg )
+{
+	metrics_data *data = arg;
+
+	pthread_mutex_lock( &data->mutex );
+	while ( data->running )
+	{
+		struct timespec deadline;
+		clock_gettime( CLOCK_REALTIME, &deadline );
+		deadline.tv_sec += data->interval;
+		while ( data->running && pthread_cond_timedwait( &data->cond, &data->mutex, &deadline ) != ETIMEDOUT );
+		int frames = data->frames;
+		pthread_mutex_unlock( &data->mutex );
+		metrics_write( data, frames );
+		pthread_mutex_lock( &data->mutex );
+	}
+	pthread_mutex_unlock( &data->mutex );
+	return NULL;
+}
+
+static void metrics_start( metrics_data *data, mlt_producer producer, mlt_consumer consumer )
+{
+	data->producer = producer;
+	data->consumer = consumer;
+	data->last_time = benchmark_clock( );
+	data->running = 1;
+	pthread_mutex_init( &data->mutex, NULL );
+	pthread_cond_init( &data->cond, NULL );
+	mlt_trace_set_counters( 1 );
+	mlt_events_listen( MLT_CONSUMER_PROPERTIES( consumer ), data, "consumer-frame-show", ( mlt_listener )on_metrics_frame );
+	if ( pthread_create( &data->thread, NULL, metrics_thread, data ) )
+		data->running = 0;
+}
+
+/** Stop the -metrics writer, which writes the metrics once more first.
+*/
+
+static void metrics_stop( metrics_data *data )
+{
+	if ( data->running )
+	{
+		pthread_mutex_lock( &data->mutex );
+		data->running = 0;
+		pthread_cond_signal( &data->cond );
+		pthread_mutex_unlock( &data->mutex );
+		pthread_join( data->thread, NULL );
+	}
+	if ( data->consumer )
+		mlt_events_disconnect( MLT_CONSUMER_PROPERTIES( data->consumer ), data );
+}
+
 static void set_preview_scale(mlt_profile *profile, mlt_profile *backup_profile, double scale)
 {
 	*backup_profile = mlt_profile_clone(*profile);
@@ -762,11 +1160,14 @@ int main( int argc, char **argv )
 	int is_silent = 0;
 	int is_abort = 0;
 	int is_getc = 0;
+	int is_benchmark = 0;
 	int error = 0;
 	mlt_profile backup_profile;
 	mlt_repository repo = NULL;
 	const char* repo_path = NULL;
 	int is_consumer_explicit = 0;
+	const char *farm_hosts = NULL;
+	metrics_data metrics = { NULL, 10 };
 
 	// Handle abnormal exit situations.
 	signal( SIGSEGV, abnormal_exit_handler );
@@ -903,6 +1304,11 @@ query_all:
 		{
 			is_getc = 1;
 		}
+		else if ( !strcmp( argv[ i ], "-benchmark" ) )
+		{
+			is_benchmark = 1;
+			is_silent = 1;
+		}
 		else if ( !repo && !strcmp( argv[ i ], "-repository" ) )
 		{
 			if ( i+1 < argc && argv[i+1][0] != '-' )
@@ -912,6 +1318,27 @@ query_all:
 		{
 			is_consumer_explicit = 1;
 		}
+		else if ( !strcmp( argv[ i ], "-metrics" ) && i + 1 < argc )
+		{
+			metrics.filename = argv[ ++ i ];
+		}
+		else if ( !strcmp( argv[ i ], "-metrics-interval" ) && i + 1 < argc )
+		{
+			metrics.interval = MAX( atoi( argv[ ++ i ] ), 1 );
+		}
+#ifndef _WIN32
+		else if ( !strcmp( argv[ i ], "-farm" ) && i + 1 < argc )
+		{
+			farm_hosts = argv[ ++ i ];
+		}
+		else if ( !strcmp( argv[ i ], "-farm-worker" ) )
+		{
+			if ( !repo )
+				repo = mlt_factory_init( repo_path );
+			error = farm_worker( argv[ ++ i ] );
+			goto exit_factory;
+		}
+#endif
 	}
 	if ( !is_silent && !isatty( STDIN_FILENO ) && !is_progress )
 		is_progress = 1;
@@ -919,6 +1346,8 @@ query_all:
 	// Construct the factory
 	if ( !repo )
 		repo = mlt_factory_init( repo_path );
+	if ( is_benchmark )
+		mlt_trace_set_counters( 1 );
 
 	// Create profile if not set explicitly
 	if ( getenv( "MLT_PROFILE" ) )
@@ -981,9 +1410,13 @@ query_all:
 			}
 		}
 
-		// If we have no consumer, default to sdl
+		// If we have no consumer, default to sdl, or to null when benchmarking
 		if ( store == NULL && consumer == NULL )
-			consumer = create_consumer( profile, NULL );
+		{
+			consumer = create_consumer( profile, is_benchmark ? "null" : NULL );
+			if ( consumer && is_benchmark )
+				mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( consumer ), "real_time", -1 );
+		}
 	}
 	
 	// Set transport properties on consumer and produder
@@ -997,6 +1430,8 @@ query_all:
 			mlt_properties_set_int(  MLT_CONSUMER_PROPERTIES( consumer ), "silent", is_silent );
 		if ( is_getc )
 			mlt_properties_set_int(  MLT_CONSUMER_PROPERTIES( consumer ), "melt_getc", is_getc );
+		if ( is_benchmark )
+			mlt_properties_set_int(  MLT_CONSUMER_PROPERTIES( consumer ), "terminate_on_pause", 1 );
 	}
 
 	if ( argc > 1 && melt != NULL && mlt_producer_get_length( melt ) > 0 )
@@ -1056,7 +1491,18 @@ query_all:
 			mlt_consumer_connect( consumer, MLT_PRODUCER_SERVICE( melt ) );
 
 			// Start the consumer
+			benchmark_data benchmark = { benchmark_clock( ), NULL, 0, 0 };
 			mlt_events_listen( properties, consumer, "consumer-fatal-error", ( mlt_listener )on_fatal_error );
+			if ( is_benchmark )
+				mlt_events_listen( properties, &benchmark, "consumer-frame-show", ( mlt_listener )on_benchmark_frame );
+#ifndef _WIN32
+			if ( farm_hosts )
+			{
+				if ( farm_render( consumer, melt, farm_hosts, is_silent ) )
+					mlt_properties_set_int( properties, "melt_error", 1 );
+			}
+			else
+#endif
 			if ( mlt_consumer_start( consumer ) == 0 )
 			{
 				// Try to exit gracefully upon these signals
@@ -1067,12 +1513,23 @@ query_all:
 				signal( SIGPIPE, stop_handler );
 #endif
 
+				if ( metrics.filename )
+					metrics_start( &metrics, melt, consumer );
+
 				// Transport functionality
 				transport( melt, consumer );
-				
+
+				// Write the last metrics while the consumer still runs
+				if ( metrics.filename )
+					metrics_stop( &metrics );
+
 				// Stop the consumer
 				mlt_consumer_stop( consumer );
-			}	
+
+				if ( is_benchmark )
+					benchmark_report( &benchmark, melt, consumer );
+			}
+			free( benchmark.times );
 		}
 		else if ( store != NULL && store != stdout && name != NULL )
 		{
@@ -36,6 +36,7 @@
 #include "MltMultitrack.h"
 #include "MltParser.h"
 #include "MltPlaylist.h"
+#include "MltPool.h"
 #include "MltProducer.h"
 #include "MltProfile.h"
 #include "MltProperties.h"
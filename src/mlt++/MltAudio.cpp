@@ -31,11 +31,28 @@ Audio::Audio( mlt_audio audio )
 {
 }
 
+Audio::Audio( Audio &&audio ) noexcept
+ : instance( audio.instance )
+{
+	audio.instance = NULL;
+}
+
 Audio::~Audio( )
 {
 	mlt_audio_close( instance );
 }
 
+Audio &Audio::operator=( Audio &&audio ) noexcept
+{
+	if ( this != &audio )
+	{
+		mlt_audio_close( instance );
+		instance = audio.instance;
+		audio.instance = NULL;
+	}
+	return *this;
+}
+
 void* Audio::data()
 {
 	return instance->data;
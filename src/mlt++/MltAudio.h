@@ -33,7 +33,11 @@ namespace Mlt
 		public:
 			Audio();
 			Audio( mlt_audio audio );
+			Audio( Audio &&audio ) noexcept;
+			Audio( const Audio &audio ) = delete;
 			virtual ~Audio( );
+			Audio& operator=( Audio &&audio ) noexcept;
+			Audio& operator=( const Audio &audio ) = delete;
 			void* data();
 			void set_data( void* data );
 			int frequency();
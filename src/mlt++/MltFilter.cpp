@@ -86,6 +86,16 @@ Filter::Filter( mlt_filter filter ) :
 	inc_ref( );
 }
 
+Filter::Filter( Filter &&filter ) noexcept :
+	Mlt::Service( ),
+	instance( filter.get_filter( ) )
+{
+	if ( instance == filter.instance )
+		filter.instance = NULL;
+	else
+		inc_ref( );
+}
+
 Filter::~Filter( )
 {
 	mlt_filter_close( instance );
@@ -102,6 +112,20 @@ Filter &Filter::operator=(const Filter &filter)
 	return *this;
 }
 
+Filter &Filter::operator=( Filter &&filter ) noexcept
+{
+	if ( this != &filter )
+	{
+		mlt_filter_close( instance );
+		instance = filter.get_filter( );
+		if ( instance == filter.instance )
+			filter.instance = NULL;
+		else
+			inc_ref( );
+	}
+	return *this;
+}
+
 mlt_filter Filter::get_filter( )
 {
 	return instance;
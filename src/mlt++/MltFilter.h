@@ -43,9 +43,11 @@ namespace Mlt
 			Filter( Service &filter );
 			Filter( Filter &filter );
 			Filter( const Filter &filter );
+			Filter( Filter &&filter ) noexcept;
 			Filter( mlt_filter filter );
 			virtual ~Filter( );
 			Filter& operator=( const Filter &filter );
+			Filter& operator=( Filter &&filter ) noexcept;
 			virtual mlt_filter get_filter( );
 			mlt_service get_service( );
 			int connect( Service &service, int index = 0 );
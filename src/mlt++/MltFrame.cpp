@@ -20,6 +20,7 @@
 
 #include "MltFrame.h"
 #include "MltProducer.h"
+#include <cstring>
 using namespace Mlt;
 
 Frame::Frame() :
@@ -49,6 +50,16 @@ Frame::Frame( const Frame &frame ) :
 	inc_ref( );
 }
 
+Frame::Frame( Frame &&frame ) noexcept :
+	Mlt::Properties( (mlt_properties)NULL ),
+	instance( frame.get_frame( ) )
+{
+	if ( instance == frame.instance )
+		frame.instance = NULL;
+	else
+		inc_ref( );
+}
+
 Frame::~Frame( )
 {
 	mlt_frame_close( instance );
@@ -65,6 +76,20 @@ Frame& Frame::operator=( const Frame &frame )
 	return *this;
 }
 
+Frame &Frame::operator=( Frame &&frame ) noexcept
+{
+	if ( this != &frame )
+	{
+		mlt_frame_close( instance );
+		instance = frame.get_frame( );
+		if ( instance == frame.instance )
+			frame.instance = NULL;
+		else
+			inc_ref( );
+	}
+	return *this;
+}
+
 mlt_frame Frame::get_frame( )
 {
 	return instance;
@@ -104,6 +129,24 @@ void *Frame::get_audio( mlt_audio_format &format, int &frequency, int &channels,
 	return audio;
 }
 
+ImageView Frame::get_image_view( mlt_image_format format, int width, int height, int writable )
+{
+	uint8_t *image = NULL;
+	if ( get_double( "consumer_aspect_ratio" ) == 0.0 )
+		set( "consumer_aspect_ratio", 1.0 );
+	mlt_frame_get_image( get_frame( ), &image, &format, &width, &height, writable );
+	set( "format", format );
+	set( "writable", writable );
+	return ImageView( get_frame( ), image, format, width, height );
+}
+
+AudioView Frame::get_audio_view( mlt_audio_format format, int frequency, int channels, int samples )
+{
+	void *audio = NULL;
+	mlt_frame_get_audio( get_frame( ), &audio, &format, &frequency, &channels, &samples );
+	return AudioView( get_frame( ), audio, format, frequency, channels, samples );
+}
+
 unsigned char *Frame::get_waveform( int w, int h )
 {
 	return mlt_frame_get_waveform( get_frame( ), w, h );
@@ -133,3 +176,118 @@ int Frame::set_alpha( uint8_t *alpha, int size, mlt_destructor destroy )
 {
 	return mlt_frame_set_alpha( get_frame(), alpha, size, destroy );
 }
+
+ImageView::ImageView( mlt_frame frame, uint8_t *data, mlt_image_format format, int width, int height ) :
+	frame_( frame ),
+	data_( data ),
+	format_( format ),
+	width_( width ),
+	height_( height ),
+	planes_{ NULL, NULL, NULL, NULL },
+	strides_{ 0, 0, 0, 0 }
+{
+	mlt_properties_inc_ref( MLT_FRAME_PROPERTIES( frame_ ) );
+	if ( data_ )
+		mlt_image_format_planes( format_, width_, height_, data_, planes_, strides_ );
+}
+
+ImageView::ImageView( ImageView &&view ) noexcept :
+	frame_( view.frame_ ),
+	data_( view.data_ ),
+	format_( view.format_ ),
+	width_( view.width_ ),
+	height_( view.height_ )
+{
+	for ( int i = 0; i < 4; i++ )
+	{
+		planes_[i] = view.planes_[i];
+		strides_[i] = view.strides_[i];
+	}
+	view.frame_ = NULL;
+	view.data_ = NULL;
+}
+
+ImageView::~ImageView( )
+{
+	mlt_frame_close( frame_ );
+}
+
+ImageView &ImageView::operator=( ImageView &&view ) noexcept
+{
+	if ( this != &view )
+	{
+		mlt_frame_close( frame_ );
+		frame_ = view.frame_;
+		data_ = view.data_;
+		format_ = view.format_;
+		width_ = view.width_;
+		height_ = view.height_;
+		for ( int i = 0; i < 4; i++ )
+		{
+			planes_[i] = view.planes_[i];
+			strides_[i] = view.strides_[i];
+		}
+		view.frame_ = NULL;
+		view.data_ = NULL;
+	}
+	return *this;
+}
+
+uint8_t *ImageView::plane( int plane ) const
+{
+	return plane >= 0 && plane < 4 ? planes_[plane] : NULL;
+}
+
+int ImageView::stride( int plane ) const
+{
+	return plane >= 0 && plane < 4 ? strides_[plane] : 0;
+}
+
+AudioView::AudioView( mlt_frame frame, void *data, mlt_audio_format format, int frequency, int channels, int samples ) :
+	frame_( frame )
+{
+	mlt_properties_inc_ref( MLT_FRAME_PROPERTIES( frame_ ) );
+	memset( &audio_, 0, sizeof( audio_ ) );
+	mlt_audio_set_values( &audio_, data, frequency, format, samples, channels );
+}
+
+AudioView::AudioView( AudioView &&view ) noexcept :
+	frame_( view.frame_ ),
+	audio_( view.audio_ )
+{
+	view.frame_ = NULL;
+	view.audio_.data = NULL;
+}
+
+AudioView::~AudioView( )
+{
+	mlt_frame_close( frame_ );
+}
+
+AudioView &AudioView::operator=( AudioView &&view ) noexcept
+{
+	if ( this != &view )
+	{
+		mlt_frame_close( frame_ );
+		frame_ = view.frame_;
+		audio_ = view.audio_;
+		view.frame_ = NULL;
+		view.audio_.data = NULL;
+	}
+	return *this;
+}
+
+int AudioView::size( ) const
+{
+	return mlt_audio_format_size( audio_.format, audio_.samples, audio_.channels );
+}
+
+void *AudioView::plane( int channel )
+{
+	if ( !audio_.data || channel < 0 || channel >= audio_.channels )
+		return NULL;
+	// Interleaved formats have a single plane, which is only a channel if mono
+	if ( mlt_audio_plane_count( &audio_ ) != audio_.channels )
+		return NULL;
+	return (uint8_t*) audio_.data + channel * mlt_audio_plane_size( &audio_ );
+}
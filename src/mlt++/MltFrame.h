@@ -31,6 +31,68 @@ namespace Mlt
 	class Properties;
 	class Producer;
 	class Service;
+	class Frame;
+
+	/** A view of the image of a frame without a copy.
+	 *
+	 * The view holds a reference to the frame, so the image stays valid for
+	 * as long as the view exists, even if the Frame it came from is closed.
+	 */
+
+	class MLTPP_DECLSPEC ImageView
+	{
+		friend class Frame;
+		private:
+			mlt_frame frame_;
+			uint8_t *data_;
+			mlt_image_format format_;
+			int width_;
+			int height_;
+			uint8_t *planes_[4];
+			int strides_[4];
+			ImageView( mlt_frame frame, uint8_t *data, mlt_image_format format, int width, int height );
+		public:
+			ImageView( ImageView &&view ) noexcept;
+			ImageView( const ImageView &view ) = delete;
+			~ImageView( );
+			ImageView& operator=( ImageView &&view ) noexcept;
+			ImageView& operator=( const ImageView &view ) = delete;
+			bool is_valid( ) const { return data_ != NULL; }
+			mlt_image_format format( ) const { return format_; }
+			int width( ) const { return width_; }
+			int height( ) const { return height_; }
+			uint8_t *data( ) const { return data_; }
+			uint8_t *plane( int plane ) const;
+			int stride( int plane ) const;
+	};
+
+	/** A view of the audio of a frame without a copy.
+	 *
+	 * Like ImageView, the view holds a reference to the frame.
+	 */
+
+	class MLTPP_DECLSPEC AudioView
+	{
+		friend class Frame;
+		private:
+			mlt_frame frame_;
+			struct mlt_audio_s audio_;
+			AudioView( mlt_frame frame, void *data, mlt_audio_format format, int frequency, int channels, int samples );
+		public:
+			AudioView( AudioView &&view ) noexcept;
+			AudioView( const AudioView &view ) = delete;
+			~AudioView( );
+			AudioView& operator=( AudioView &&view ) noexcept;
+			AudioView& operator=( const AudioView &view ) = delete;
+			bool is_valid( ) const { return audio_.data != NULL; }
+			void *data( ) const { return audio_.data; }
+			mlt_audio_format format( ) const { return audio_.format; }
+			int frequency( ) const { return audio_.frequency; }
+			int channels( ) const { return audio_.channels; }
+			int samples( ) const { return audio_.samples; }
+			int size( ) const;
+			void *plane( int channel );
+	};
 
 	class MLTPP_DECLSPEC Frame : public Properties
 	{
@@ -41,14 +103,18 @@ namespace Mlt
 			Frame( mlt_frame frame );
 			Frame( Frame &frame );
 			Frame( const Frame &frame );
+			Frame( Frame &&frame ) noexcept;
 			virtual ~Frame( );
 			Frame& operator=( const Frame &frame );
+			Frame& operator=( Frame &&frame ) noexcept;
 			virtual mlt_frame get_frame( );
 			mlt_properties get_properties( );
 			uint8_t *get_image( mlt_image_format &format, int &w, int &h, int writable = 0 );
 			unsigned char *fetch_image( mlt_image_format format, int w, int h, int writable = 0 );
 			void *get_audio( mlt_audio_format &format, int &frequency, int &channels, int &samples );
 			unsigned char *get_waveform( int w, int h );
+			ImageView get_image_view( mlt_image_format format, int width = 0, int height = 0, int writable = 0 );
+			AudioView get_audio_view( mlt_audio_format format, int frequency, int channels, int samples );
 			Producer *get_original_producer( );
 			int get_position( );
 			mlt_properties get_unique_properties( Service &service );
@@ -37,11 +37,28 @@ Image::Image( int width, int height, mlt_image_format format )
 	alloc( width, height, format );
 }
 
+Image::Image( Image &&image ) noexcept
+ : instance( image.instance )
+{
+	image.instance = NULL;
+}
+
 Image::~Image( )
 {
 	mlt_image_close( instance );
 }
 
+Image &Image::operator=( Image &&image ) noexcept
+{
+	if ( this != &image )
+	{
+		mlt_image_close( instance );
+		instance = image.instance;
+		image.instance = NULL;
+	}
+	return *this;
+}
+
 mlt_image_format Image::format()
 {
 	return instance->format;
@@ -33,8 +33,12 @@ namespace Mlt
 		public:
 			Image();
 			Image( mlt_image image );
+			Image( Image &&image ) noexcept;
+			Image( const Image &image ) = delete;
 			Image( int width, int height, mlt_image_format format );
 			virtual ~Image( );
+			Image& operator=( Image &&image ) noexcept;
+			Image& operator=( const Image &image ) = delete;
 			mlt_image_format format();
 			int width();
 			int height();
@@ -0,0 +1,50 @@
+/**
+ * MltPool.cpp - MLT Wrapper
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "MltPool.h"
+#include "MltProperties.h"
+using namespace Mlt;
+
+Properties *Pool::stats( )
+{
+	mlt_properties stats = mlt_pool_get_stats( );
+	Properties *result = new Properties( stats );
+	mlt_properties_close( stats );
+	return result;
+}
+
+void Pool::purge( )
+{
+	mlt_pool_purge( );
+}
+
+void Pool::set_budget( int64_t bytes )
+{
+	mlt_pool_set_budget( bytes );
+}
+
+int64_t Pool::budget( )
+{
+	return mlt_pool_get_budget( );
+}
+
+int64_t Pool::high_water( )
+{
+	return mlt_pool_high_water( );
+}
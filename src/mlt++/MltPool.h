@@ -0,0 +1,46 @@
+/**
+ * MltPool.h - MLT Wrapper
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MLTPP_POOL_H
+#define MLTPP_POOL_H
+
+#include "MltConfig.h"
+
+#ifdef SWIG
+#define MLTPP_DECLSPEC
+#endif
+
+#include <framework/mlt.h>
+
+namespace Mlt
+{
+	class Properties;
+
+	class MLTPP_DECLSPEC Pool
+	{
+		public:
+			static Properties *stats( );
+			static void purge( );
+			static void set_budget( int64_t bytes );
+			static int64_t budget( );
+			static int64_t high_water( );
+	};
+}
+
+#endif
@@ -87,6 +87,23 @@ Producer::Producer( Producer *producer ) :
 		inc_ref( );
 }
 
+Producer::Producer( Producer &&producer ) noexcept :
+	Mlt::Service( ),
+	instance( producer.get_producer( ) ),
+	parent_( NULL )
+{
+	if ( instance == producer.instance )
+	{
+		producer.instance = NULL;
+		parent_ = producer.parent_;
+		producer.parent_ = NULL;
+	}
+	else
+	{
+		inc_ref( );
+	}
+}
+
 Producer::~Producer( )
 {
 	delete parent_;
@@ -107,6 +124,28 @@ Producer &Producer::operator=(const Producer &producer)
 	return *this;
 }
 
+Producer &Producer::operator=( Producer &&producer ) noexcept
+{
+	if ( this != &producer )
+	{
+		delete parent_;
+		parent_ = nullptr;
+		mlt_producer_close( instance );
+		instance = producer.get_producer( );
+		if ( instance == producer.instance )
+		{
+			producer.instance = NULL;
+			parent_ = producer.parent_;
+			producer.parent_ = nullptr;
+		}
+		else
+		{
+			inc_ref( );
+		}
+	}
+	return *this;
+}
+
 mlt_producer Producer::get_producer( )
 {
 	return instance;
@@ -46,9 +46,11 @@ namespace Mlt
 			Producer( mlt_producer producer );
 			Producer( Producer &producer );
 			Producer( const Producer &producer );
+			Producer( Producer &&producer ) noexcept;
 			Producer( Producer *producer );
 			virtual ~Producer( );
 			Producer& operator=( const Producer &producer );
+			Producer& operator=( Producer &&producer ) noexcept;
 			virtual mlt_producer get_producer( );
 			Producer &parent( );
 			mlt_producer get_parent( );
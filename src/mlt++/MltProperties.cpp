@@ -44,6 +44,17 @@ Properties::Properties( const Properties &properties )
 {
 }
 
+// Take over the reference of the other object, unless it is a subclass whose
+// properties are kept elsewhere, which needs a new reference like a copy.
+Properties::Properties( Properties &&properties ) noexcept :
+	instance( properties.get_properties( ) )
+{
+	if ( instance == properties.instance )
+		properties.instance = NULL;
+	else
+		inc_ref( );
+}
+
 Properties::Properties( mlt_properties properties ) :
 	instance( properties )
 {
@@ -78,6 +89,20 @@ Properties &Properties::operator=(const Properties &properties)
 	return *this;
 }
 
+Properties &Properties::operator=( Properties &&properties ) noexcept
+{
+	if ( this != &properties )
+	{
+		mlt_properties_close( instance );
+		instance = properties.get_properties( );
+		if ( instance == properties.instance )
+			properties.instance = NULL;
+		else
+			inc_ref( );
+	}
+	return *this;
+}
+
 mlt_properties Properties::get_properties( )
 {
 	return instance;
@@ -243,6 +268,16 @@ int Properties::inherit( Properties &that )
 	return mlt_properties_inherit( get_properties( ), that.get_properties( ) );
 }
 
+void Properties::begin_update( )
+{
+	mlt_properties_begin_update( get_properties( ) );
+}
+
+void Properties::end_update( )
+{
+	mlt_properties_end_update( get_properties( ) );
+}
+
 int Properties::rename( const char *source, const char *dest )
 {
 	return mlt_properties_rename( get_properties( ), source, dest );
@@ -391,6 +426,11 @@ double Properties::anim_get_double(const char *name, int position, int length)
 	return mlt_properties_anim_get_double( get_properties(), name, position, length );
 }
 
+int Properties::anim_get_double_range( const char *name, double *values, int position, int count, int length )
+{
+	return mlt_properties_anim_get_double_range( get_properties(), name, values, position, count, length );
+}
+
 int Properties::anim_set( const char *name, double value, int position, int length, mlt_keyframe_type keyframe_type )
 {
 	return mlt_properties_anim_set_double( get_properties(), name, value, position, length, keyframe_type );
@@ -422,6 +462,11 @@ mlt_rect Properties::anim_get_rect(const char *name, int position, int length)
 	return mlt_properties_anim_get_rect( get_properties(), name, position, length );
 }
 
+int Properties::anim_get_rect_range( const char *name, mlt_rect *values, int position, int count, int length )
+{
+	return mlt_properties_anim_get_rect_range( get_properties(), name, values, position, count, length );
+}
+
 mlt_animation Properties::get_animation( const char *name )
 {
 	return mlt_properties_get_animation( get_properties(), name );
@@ -42,11 +42,13 @@ namespace Mlt
 			Properties( bool dummy );
 			Properties( Properties &properties );
 			Properties( const Properties &properties );
+			Properties( Properties &&properties ) noexcept;
 			Properties( mlt_properties properties );
 			Properties( void *properties );
 			Properties( const char *file );
 			virtual ~Properties( );
 			Properties& operator=( const Properties &properties );
+			Properties& operator=( Properties &&properties ) noexcept;
 			virtual mlt_properties get_properties( );
 			int inc_ref( );
 			int dec_ref( );
@@ -80,6 +82,8 @@ namespace Mlt
 			void *get_data( int index, int &size );
 			void mirror( Properties &that );
 			int inherit( Properties &that );
+			void begin_update( );
+			void end_update( );
 			int rename( const char *source, const char *dest );
 			void dump( FILE *output = stderr );
 			void debug( const char *title = "Object", FILE *output = stderr );
@@ -112,6 +116,7 @@ namespace Mlt
 			int anim_set( const char *name, int value, int position, int length = 0,
 				mlt_keyframe_type keyframe_type = mlt_keyframe_linear );
 			double anim_get_double( const char *name, int position, int length = 0 );
+			int anim_get_double_range( const char *name, double *values, int position, int count, int length = 0 );
 			int anim_set( const char *name, double value, int position, int length = 0,
 				mlt_keyframe_type keyframe_type = mlt_keyframe_linear );
 
@@ -121,6 +126,7 @@ namespace Mlt
 			int anim_set( const char *name, mlt_rect value, int position, int length = 0,
 				mlt_keyframe_type keyframe_type = mlt_keyframe_linear );
 			mlt_rect anim_get_rect( const char *name, int position, int length = 0 );
+			int anim_get_rect_range( const char *name, mlt_rect *values, int position, int count, int length = 0 );
 			mlt_animation get_animation( const char *name );
 			Animation* get_anim( const char *name );
 	};
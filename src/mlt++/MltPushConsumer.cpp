@@ -90,37 +90,41 @@ int PushConsumer::connect( Service &/*service*/ )
 	return -1;
 }
 
-int PushConsumer::push( Frame *frame )
+// Process the frame at the render resolution, if set, before it is queued
+static void render( PushConsumer &consumer, Frame *frame )
 {
-	frame->inc_ref( );
-
 	// Here we have the option to process the frame at a render resolution (this will 
 	// typically be PAL or NTSC) prior to scaling according to the consumers profile
 	// This is done to optimise quality, esp. with regard to compositing positions 
-	if ( get_int( "render_width" ) )
+	if ( consumer.get_int( "render_width" ) )
 	{
 		// Process the projects render resolution first
 		mlt_image_format format = mlt_image_yuv422;
-		int w = get_int( "render_width" );
-		int h = get_int( "render_height" );
-		frame->set( "consumer_aspect_ratio", get_double( "render_aspect_ratio" ) );
-		frame->set( "consumer_deinterlace", get_int( "deinterlace" ) );
-		frame->set( "deinterlace_method", get_int( "deinterlace_method" ) );
-		frame->set( "rescale.interp", get( "rescale" ) );
+		int w = consumer.get_int( "render_width" );
+		int h = consumer.get_int( "render_height" );
+		frame->set( "consumer_aspect_ratio", consumer.get_double( "render_aspect_ratio" ) );
+		frame->set( "consumer_deinterlace", consumer.get_int( "deinterlace" ) );
+		frame->set( "deinterlace_method", consumer.get_int( "deinterlace_method" ) );
+		frame->set( "rescale.interp", consumer.get( "rescale" ) );
 
 		// Render the frame
 		frame->get_image( format, w, h );
 
 		// Now set up the post image scaling
-		Filter *convert = ( Filter * )get_data( "filter_convert" );
+		Filter *convert = ( Filter * )consumer.get_data( "filter_convert" );
 		mlt_filter_process( convert->get_filter( ), frame->get_frame( ) );
-		Filter *rescale = ( Filter * )get_data( "filter_rescale" );
+		Filter *rescale = ( Filter * )consumer.get_data( "filter_rescale" );
 		mlt_filter_process( rescale->get_filter( ), frame->get_frame( ) );
-		Filter *resize = ( Filter * )get_data( "filter_resize" );
+		Filter *resize = ( Filter * )consumer.get_data( "filter_resize" );
 		mlt_filter_process( resize->get_filter( ), frame->get_frame( ) );
 	}
+}
 
-	return mlt_consumer_put_frame( ( mlt_consumer )get_service( ), frame->get_frame( ) );
+int PushConsumer::push( Frame *frame )
+{
+	frame->inc_ref( );
+	render( *this, frame );
+	return mlt_consumer_put_frame( get_consumer( ), frame->get_frame( ) );
 }
 
 int PushConsumer::push( Frame &frame )
@@ -128,6 +132,39 @@ int PushConsumer::push( Frame &frame )
 	return push( &frame );
 }
 
+// Returns 0 if the frame was queued, 1 if the queue is full, or -1 if the
+// consumer is stopped. Unlike push, it does not wait, so the caller can
+// produce frames at the rate the consumer takes them.
+int PushConsumer::try_push( Frame *frame )
+{
+	// Avoid rendering a frame that the queue has no room for
+	int limit = get_int( "put_queue" );
+	if ( queue_depth( ) >= ( limit > 1 ? limit : 1 ) )
+		return is_stopped( ) ? -1 : 1;
+	render( *this, frame );
+	frame->inc_ref( );
+	int error = mlt_consumer_try_put_frame( get_consumer( ), frame->get_frame( ) );
+	if ( error )
+		mlt_frame_close( frame->get_frame( ) );
+	return error;
+}
+
+int PushConsumer::try_push( Frame &frame )
+{
+	return try_push( &frame );
+}
+
+// Returns true if the consumer is stopped
+int PushConsumer::wait_for_space( )
+{
+	return mlt_consumer_wait_for_put_space( get_consumer( ) );
+}
+
+int PushConsumer::queue_depth( )
+{
+	return mlt_consumer_put_depth( get_consumer( ) );
+}
+
 int PushConsumer::drain( )
 {
 	return 0;
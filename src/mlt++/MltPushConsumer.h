@@ -43,6 +43,10 @@ namespace Mlt
 			virtual int connect( Service &service );
 			int push( Frame *frame );
 			int push( Frame &frame );
+			int try_push( Frame *frame );
+			int try_push( Frame &frame );
+			int wait_for_space( );
+			int queue_depth( );
 			int drain( );
 			Frame *construct( int );
 	};
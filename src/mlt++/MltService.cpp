@@ -48,6 +48,16 @@ Service::Service( mlt_service service ) :
 	inc_ref( );
 }
 
+Service::Service( Service &&service ) noexcept :
+	Properties( false ),
+	instance( service.get_service( ) )
+{
+	if ( instance == service.instance )
+		service.instance = NULL;
+	else
+		inc_ref( );
+}
+
 Service::~Service( )
 {
 	mlt_service_close( instance );
@@ -64,6 +74,20 @@ Service &Service::operator=(const Service &service)
 	return *this;
 }
 
+Service &Service::operator=( Service &&service ) noexcept
+{
+	if ( this != &service )
+	{
+		mlt_service_close( instance );
+		instance = service.get_service( );
+		if ( instance == service.instance )
+			service.instance = NULL;
+		else
+			inc_ref( );
+	}
+	return *this;
+}
+
 mlt_service Service::get_service( )
 {
 	return instance;
@@ -173,3 +197,11 @@ void Service::set_profile( Profile &profile )
 {
 	set_profile( profile.get_profile( ) );
 }
+
+Properties *Service::perf_stats( )
+{
+	mlt_properties stats = mlt_service_perf_stats( get_service( ) );
+	Properties *result = new Properties( stats );
+	mlt_properties_close( stats );
+	return result;
+}
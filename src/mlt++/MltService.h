@@ -42,9 +42,11 @@ namespace Mlt
 			Service( );
 			Service( Service &service );
 			Service( const Service &service );
+			Service( Service &&service ) noexcept;
 			Service( mlt_service service );
 			virtual ~Service( );
 			Service& operator=( const Service &service );
+			Service& operator=( Service &&service ) noexcept;
 			virtual mlt_service get_service( );
 			void lock( );
 			void unlock( );
@@ -66,6 +68,7 @@ namespace Mlt
 			Filter *filter( int index );
 			void set_profile( mlt_profile profile );
 			void set_profile( Profile &profile );
+			Properties *perf_stats( );
 	};
 }
 
@@ -87,6 +87,16 @@ Transition::Transition( mlt_transition transition ) :
 	inc_ref( );
 }
 
+Transition::Transition( Transition &&transition ) noexcept :
+	Mlt::Service( ),
+	instance( transition.get_transition( ) )
+{
+	if ( instance == transition.instance )
+		transition.instance = NULL;
+	else
+		inc_ref( );
+}
+
 Transition::~Transition( )
 {
 	mlt_transition_close( instance );
@@ -103,6 +113,20 @@ Transition &Transition::operator=(const Transition &transition)
 	return *this;
 }
 
+Transition &Transition::operator=( Transition &&transition ) noexcept
+{
+	if ( this != &transition )
+	{
+		mlt_transition_close( instance );
+		instance = transition.get_transition( );
+		if ( instance == transition.instance )
+			transition.instance = NULL;
+		else
+			inc_ref( );
+	}
+	return *this;
+}
+
 mlt_transition Transition::get_transition( )
 {
 	return instance;
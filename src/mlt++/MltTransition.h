@@ -44,9 +44,11 @@ namespace Mlt
 			Transition( Service &transition );
 			Transition( Transition &transition );
 			Transition( const Transition &transition );
+			Transition( Transition &&transition ) noexcept;
 			Transition( mlt_transition transition );
 			virtual ~Transition( );
 			Transition& operator=( const Transition &transition );
+			Transition& operator=( Transition &&transition ) noexcept;
 			virtual mlt_transition get_transition( );
 			mlt_service get_service( );
 			void set_in_and_out( int in, int out );
@@ -20,9 +20,39 @@
 #include "common.h"
 
 #include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
 #include <libavutil/pixdesc.h>
 #include <libavutil/samplefmt.h>
 
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Conversions with the same size are run in columns of this width on the slice threads
+#define SWS_SLICE_WIDTH (512)
+#define SWS_POOL_SIZE (32)
+#define SWS_HAS_THREADS (LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 1, 100))
+
+typedef struct
+{
+	int src_width, src_height, src_format;
+	int dst_width, dst_height, dst_format;
+	int flags, threads;
+	int src_colorspace, dst_colorspace, src_full_range, dst_full_range;
+} sws_key;
+
+static struct
+{
+	sws_key key;
+	struct SwsContext *context;
+	int transfer, busy;
+	int64_t used;
+} sws_pool[SWS_POOL_SIZE];
+static pthread_mutex_t sws_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int64_t sws_pool_clock = 0;
+
 int mlt_get_sws_flags(int srcwidth, int srcheight, int srcformat, int dstwidth, int dstheight, int dstformat)
 {
 	// Use default flags unless there is a reason to use something different.
@@ -236,3 +266,233 @@ int mlt_set_luma_transfer( struct SwsContext *context, int src_colorspace,
 	return sws_setColorspaceDetails( context, src_coefficients, src_range, dst_coefficients, dst_range,
 		brightness, contrast, saturation );
 }
+
+static struct SwsContext *sws_pool_get( const sws_key *key, int *transfer )
+{
+	struct SwsContext *context = NULL;
+	int i, slot = -1;
+
+	pthread_mutex_lock( &sws_pool_mutex );
+	for ( i = 0; i < SWS_POOL_SIZE && !context; i++ )
+	{
+		if ( sws_pool[i].context && !sws_pool[i].busy && !memcmp( &sws_pool[i].key, key, sizeof( *key ) ) )
+		{
+			sws_pool[i].busy = 1;
+			sws_pool[i].used = ++sws_pool_clock;
+			context = sws_pool[i].context;
+			*transfer = sws_pool[i].transfer;
+		}
+	}
+	pthread_mutex_unlock( &sws_pool_mutex );
+	if ( context )
+		return context;
+
+	context = sws_alloc_context();
+	if ( !context )
+		return NULL;
+	av_opt_set_int( context, "srcw", key->src_width, 0 );
+	av_opt_set_int( context, "srch", key->src_height, 0 );
+	av_opt_set_int( context, "src_format", key->src_format, 0 );
+	av_opt_set_int( context, "dstw", key->dst_width, 0 );
+	av_opt_set_int( context, "dsth", key->dst_height, 0 );
+	av_opt_set_int( context, "dst_format", key->dst_format, 0 );
+	av_opt_set_int( context, "sws_flags", key->flags, 0 );
+#if SWS_HAS_THREADS
+	av_opt_set_int( context, "threads", key->threads, 0 );
+#endif
+	if ( sws_init_context( context, NULL, NULL ) < 0 )
+	{
+		sws_freeContext( context );
+		return NULL;
+	}
+	*transfer = 0;
+	if ( key->src_colorspace || key->dst_colorspace )
+		*transfer = mlt_set_luma_transfer( context, key->src_colorspace, key->dst_colorspace,
+			key->src_full_range, key->dst_full_range );
+
+	// Keep it in a free slot or the one of the least recently used idle context
+	pthread_mutex_lock( &sws_pool_mutex );
+	for ( i = 0; i < SWS_POOL_SIZE; i++ )
+	{
+		if ( !sws_pool[i].context )
+		{
+			slot = i;
+			break;
+		}
+		if ( !sws_pool[i].busy && ( slot < 0 || sws_pool[i].used < sws_pool[slot].used ) )
+			slot = i;
+	}
+	if ( slot >= 0 )
+	{
+		if ( sws_pool[slot].context )
+			sws_freeContext( sws_pool[slot].context );
+		sws_pool[slot].key = *key;
+		sws_pool[slot].context = context;
+		sws_pool[slot].transfer = *transfer;
+		sws_pool[slot].busy = 1;
+		sws_pool[slot].used = ++sws_pool_clock;
+	}
+	pthread_mutex_unlock( &sws_pool_mutex );
+
+	return context;
+}
+
+static void sws_pool_put( struct SwsContext *context )
+{
+	int i;
+
+	pthread_mutex_lock( &sws_pool_mutex );
+	for ( i = 0; i < SWS_POOL_SIZE; i++ )
+	{
+		if ( sws_pool[i].context == context )
+		{
+			sws_pool[i].busy = 0;
+			break;
+		}
+	}
+	pthread_mutex_unlock( &sws_pool_mutex );
+
+	// Every slot was busy when it was made
+	if ( i == SWS_POOL_SIZE )
+		sws_freeContext( context );
+}
+
+struct sws_slices
+{
+	sws_key key;
+	int width, slice_width;
+	uint8_t **in_data, **out_data;
+	int *in_stride, *out_stride;
+	pthread_mutex_t mutex;
+	int transfer, error;
+};
+
+static int sws_slice_proc( int id, int index, int jobs, void *cookie )
+{
+	struct sws_slices *slices = cookie;
+	sws_key key = slices->key;
+	const uint8_t *in[4];
+	uint8_t *out[4];
+	int x = slices->slice_width * index;
+	int transfer = 0;
+	int i;
+
+	if ( x >= slices->width )
+		return 0;
+	key.src_width = key.dst_width = FFMIN( slices->slice_width, slices->width - x );
+	for ( i = 0; i < 4; i++ )
+	{
+		in[i] = slices->in_data[i] ? slices->in_data[i] + FFMAX( av_image_get_linesize( key.src_format, x, i ), 0 ) : NULL;
+		out[i] = slices->out_data[i] ? slices->out_data[i] + FFMAX( av_image_get_linesize( key.dst_format, x, i ), 0 ) : NULL;
+	}
+
+	// Every slice has the same colorspaces, so the first one reports the transfer
+	struct SwsContext *context = sws_pool_get( &key, &transfer );
+	if ( context )
+	{
+		sws_scale( context, in, slices->in_stride, 0, key.src_height, out, slices->out_stride );
+		sws_pool_put( context );
+	}
+	pthread_mutex_lock( &slices->mutex );
+	if ( !context )
+		slices->error = 1;
+	else if ( index == 0 )
+		slices->transfer = transfer;
+	pthread_mutex_unlock( &slices->mutex );
+	return 0;
+}
+
+#if SWS_HAS_THREADS
+static void sws_buffer_free( void *opaque, uint8_t *data )
+{
+}
+
+static int sws_wrap_frame( AVFrame *frame, uint8_t *data[4], int stride[4], int width, int height, int format )
+{
+	frame->width = width;
+	frame->height = height;
+	frame->format = format;
+	memcpy( frame->data, data, 4 * sizeof( *data ) );
+	memcpy( frame->linesize, stride, 4 * sizeof( *stride ) );
+	// Reference the caller's image so that libswscale does not copy or allocate one
+	frame->buf[0] = av_buffer_create( data[0], 1, sws_buffer_free, NULL, 0 );
+	return frame->buf[0] ? 0 : AVERROR(ENOMEM);
+}
+#endif
+
+/** Convert or scale an image with pooled contexts on the slice threads.
+ *
+ * Contexts are kept for reuse and keyed by all of the parameters, so the luma
+ * transfer is only set up when one is made. Conversions that keep the size are
+ * split into columns and run with mlt_slices; scaling uses the slice threads of
+ * libswscale when it has them. Set the environment variable
+ * MLT_AVFORMAT_SLICED_PIXFMT_DISABLE to run everything on the calling thread.
+ * Colorspaces of 0 keep the defaults of libswscale.
+ *
+ * \return the result of mlt_set_luma_transfer or -1 if there is no context
+ */
+
+int mlt_sws_scale_sliced( uint8_t *in_data[4], int in_stride[4], int src_width, int src_height, int src_format,
+	uint8_t *out_data[4], int out_stride[4], int dst_width, int dst_height, int dst_format, int flags,
+	int src_colorspace, int dst_colorspace, int src_full_range, int dst_full_range )
+{
+	int sliced = !getenv( "MLT_AVFORMAT_SLICED_PIXFMT_DISABLE" );
+	struct sws_slices slices = {
+		.key = {
+			.src_width = src_width, .src_height = src_height, .src_format = src_format,
+			.dst_width = dst_width, .dst_height = dst_height, .dst_format = dst_format,
+			.flags = flags, .threads = 1,
+			.src_colorspace = src_colorspace, .dst_colorspace = dst_colorspace,
+			.src_full_range = src_full_range, .dst_full_range = dst_full_range,
+		},
+		.width = src_width,
+		.slice_width = src_width,
+		.in_data = in_data, .out_data = out_data,
+		.in_stride = in_stride, .out_stride = out_stride,
+		.mutex = PTHREAD_MUTEX_INITIALIZER,
+	};
+
+	if ( src_width == dst_width && src_height == dst_height )
+	{
+		int jobs = ( src_width + SWS_SLICE_WIDTH - 1 ) / SWS_SLICE_WIDTH;
+		int last = src_width - SWS_SLICE_WIDTH * ( jobs - 1 );
+
+		// Keep the chroma of every column whole
+		if ( sliced && jobs > 1 && last % 16 == 0 )
+		{
+			slices.slice_width = SWS_SLICE_WIDTH;
+			mlt_slices_run_normal( jobs, sws_slice_proc, &slices );
+		}
+		else
+		{
+			sws_slice_proc( 0, 0, 1, &slices );
+		}
+		return slices.error ? -1 : slices.transfer;
+	}
+
+#if SWS_HAS_THREADS
+	if ( sliced )
+		slices.key.threads = mlt_slices_count_normal();
+#endif
+	struct SwsContext *context = sws_pool_get( &slices.key, &slices.transfer );
+	if ( !context )
+		return -1;
+#if SWS_HAS_THREADS
+	if ( slices.key.threads > 1 )
+	{
+		AVFrame *src = av_frame_alloc();
+		AVFrame *dst = av_frame_alloc();
+		int error = !src || !dst
+			|| sws_wrap_frame( src, in_data, in_stride, src_width, src_height, src_format )
+			|| sws_wrap_frame( dst, out_data, out_stride, dst_width, dst_height, dst_format )
+			|| sws_scale_frame( context, dst, src ) < 0;
+		av_frame_free( &src );
+		av_frame_free( &dst );
+		sws_pool_put( context );
+		return error ? -1 : slices.transfer;
+	}
+#endif
+	sws_scale( context, (const uint8_t* const*) in_data, in_stride, 0, src_height, out_data, out_stride );
+	sws_pool_put( context );
+	return slices.transfer;
+}
@@ -30,5 +30,8 @@ mlt_channel_layout mlt_get_channel_layout_or_default( const char* name, int chan
 int mlt_set_luma_transfer( struct SwsContext *context, int src_colorspace,
 	int dst_colorspace, int src_full_range, int dst_full_range );
 int mlt_get_sws_flags(int srcwidth, int srcheight, int srcformat, int dstwidth, int dstheight, int dstformat);
+int mlt_sws_scale_sliced( uint8_t *in_data[4], int in_stride[4], int src_width, int src_height, int src_format,
+	uint8_t *out_data[4], int out_stride[4], int dst_width, int dst_height, int dst_format, int flags,
+	int src_colorspace, int dst_colorspace, int src_full_range, int dst_full_range );
 
 #endif // COMMON_H
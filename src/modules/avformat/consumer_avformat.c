@@ -17,6 +17,11 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+// For O_DIRECT
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "common.h"
 
 // mlt Header files
@@ -34,6 +39,8 @@
 #include <pthread.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
 
 // avformat header files
 #include <libavformat/avformat.h>
@@ -44,6 +51,7 @@
 #include <libavutil/samplefmt.h>
 #include <libavutil/opt.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/hwcontext.h>
 #include <libavutil/version.h>
 #ifdef AVFILTER
 #include <libavfilter/avfilter.h>
@@ -65,6 +73,10 @@
 #define AUDIO_BUFFER_SIZE (1024 * 42)
 #define VIDEO_BUFFER_SIZE (8192 * 8192)
 #define IMAGE_ALIGN (4)
+#define WRAP_ALIGN (32)
+#define MUX_QUEUE_SIZE (128)
+#define MAX_OUTPUTS (8)
+#define AUDIO_QUEUE_SECONDS (2)
 
 //
 // This structure should be extended and made globally available in mlt
@@ -218,6 +230,10 @@ static int consumer_start( mlt_consumer consumer );
 static int consumer_stop( mlt_consumer consumer );
 static int consumer_is_stopped( mlt_consumer consumer );
 static void *consumer_thread( void *arg );
+static void *segments_thread( void *arg );
+static void *smart_render_thread( void *arg );
+static int use_segments( mlt_properties properties );
+static int use_smart_render( mlt_properties properties );
 static void consumer_close( mlt_consumer consumer );
 
 /** Initialise the consumer.
@@ -510,7 +526,8 @@ static int consumer_start( mlt_consumer consumer )
 		mlt_properties_set_data( properties, "thread", thread, sizeof( pthread_t ), free, NULL );
 
 		// Create the thread
-		pthread_create( thread, NULL, consumer_thread, consumer );
+		pthread_create( thread, NULL, use_smart_render( properties ) ? smart_render_thread
+			: use_segments( properties ) ? segments_thread : consumer_thread, consumer );
 
 		// Set the running state
 		mlt_properties_set_int( properties, "running", 1 );
@@ -590,6 +607,14 @@ static enum AVPixelFormat pick_pix_fmt( mlt_image_format img_fmt )
 		return AV_PIX_FMT_YUV420P;
 	case mlt_image_yuv422p16:
 		return AV_PIX_FMT_YUV422P16LE;
+	case mlt_image_yuv420p10:
+		return AV_PIX_FMT_YUV420P10LE;
+	case mlt_image_nv12:
+		return AV_PIX_FMT_NV12;
+	case mlt_image_p010:
+		return AV_PIX_FMT_P010LE;
+	case mlt_image_rgba64:
+		return AV_PIX_FMT_RGBA64LE;
 	default:
 		return AV_PIX_FMT_YUYV422;
 	}
@@ -672,22 +697,42 @@ static int pick_sample_fmt( mlt_properties properties, AVCodec *codec )
 static uint8_t* interleaved_to_planar( int samples, int channels, uint8_t* audio, int bytes_per_sample )
 {
 	uint8_t *buffer = mlt_pool_alloc( AUDIO_ENCODE_BUFFER_SIZE );
-	uint8_t *p = buffer;
+	void *stack[ AV_NUM_DATA_POINTERS ];
+	void **planes = channels <= AV_NUM_DATA_POINTERS ? stack : malloc( channels * sizeof( void* ) );
 	int c;
 
 	memset( buffer, 0, AUDIO_ENCODE_BUFFER_SIZE );
 	for ( c = 0; c < channels; c++ )
+		planes[c] = buffer + c * samples * bytes_per_sample;
+	mlt_audio_deinterleave( planes, audio, bytes_per_sample, channels, samples );
+	if ( planes != stack )
+		free( planes );
+	return buffer;
+}
+
+/** Determine if the encoders must put their headers in the codec parameters.
+ *
+ * They must if the main or any of the extra outputs (target.1 to target.8 with
+ * the formats in f.1 to f.8) has a format that needs them.
+ */
+
+static int needs_global_header( AVFormatContext *oc, mlt_properties properties )
+{
+	char key[20];
+	int i;
+
+	if ( oc->oformat->flags & AVFMT_GLOBALHEADER )
+		return 1;
+	for ( i = 1; i <= MAX_OUTPUTS; i++ )
 	{
-		uint8_t *q = audio + c * bytes_per_sample;
-		int i = samples + 1;
-		while ( --i )
-		{
-			memcpy( p, q, bytes_per_sample );
-			p += bytes_per_sample;
-			q += channels * bytes_per_sample;
-		}
+		snprintf( key, sizeof(key), "target.%d", i );
+		const char *target = mlt_properties_get( properties, key );
+		snprintf( key, sizeof(key), "f.%d", i );
+		AVOutputFormat *fmt = target ? av_guess_format( mlt_properties_get( properties, key ), target, NULL ) : NULL;
+		if ( fmt && ( fmt->flags & AVFMT_GLOBALHEADER ) )
+			return 1;
 	}
-	return buffer;
+	return 0;
 }
 
 /** Add an audio output stream
@@ -723,7 +768,7 @@ static AVStream *add_audio_stream( mlt_consumer consumer, AVFormatContext *oc, A
 			c->thread_count = thread_count;
 #endif
 
-		if (oc->oformat->flags & AVFMT_GLOBALHEADER) 
+		if ( needs_global_header( oc, properties ) )
 			c->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 		
 		// Allow the user to override the audio fourcc
@@ -980,7 +1025,7 @@ static AVStream *add_video_stream( mlt_consumer consumer, AVFormatContext *oc, A
 		}
 
 		// Some formats want stream headers to be separate
-		if ( oc->oformat->flags & AVFMT_GLOBALHEADER ) 
+		if ( needs_global_header( oc, properties ) )
 			c->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
 		// Translate these standard mlt consumer properties to ffmpeg
@@ -1094,6 +1139,46 @@ static AVStream *add_video_stream( mlt_consumer consumer, AVFormatContext *oc, A
 	return st;
 }
 
+static void release_wrapped_image( void *opaque, uint8_t *data )
+{
+	mlt_frame_close( opaque );
+}
+
+/** Give an image of the encoder's pixel format to the encoder without copying it.
+ *
+ * The AVFrame refers to the planes of the MLT image and holds a reference to the
+ * MLT frame until the encoder is done with it. This is only done when swscale
+ * would not change the pixels and the planes suit the SIMD code of the encoders.
+ *
+ * \return true if the image was wrapped
+ */
+
+static int wrap_picture( AVFrame *picture, mlt_frame frame, uint8_t *image, mlt_image_format format,
+	int width, int height )
+{
+	uint8_t *data[4];
+	int linesize[4];
+	int i;
+
+	mlt_image_format_planes( format, width, height, image, data, linesize );
+	for ( i = 0; i < 4 && data[i]; i++ )
+		if ( ( (uintptr_t) data[i] % WRAP_ALIGN ) || ( linesize[i] % WRAP_ALIGN ) )
+			return 0;
+
+	av_frame_unref( picture );
+	picture->buf[0] = av_buffer_create( image, mlt_image_format_size( format, width, height, NULL ),
+		release_wrapped_image, frame, AV_BUFFER_FLAG_READONLY );
+	if ( !picture->buf[0] )
+		return 0;
+	mlt_properties_inc_ref( MLT_FRAME_PROPERTIES( frame ) );
+	memcpy( picture->data, data, sizeof( data ) );
+	memcpy( picture->linesize, linesize, sizeof( linesize ) );
+	picture->format = pick_pix_fmt( format );
+	picture->width = width;
+	picture->height = height;
+	return 1;
+}
+
 static AVFrame *alloc_picture( int pix_fmt, int width, int height )
 {
 	// Allocate a frame
@@ -1203,6 +1288,287 @@ static int mlt_write(void *h, uint8_t *buf, int size)
 	return 0;
 }
 
+#define WRITE_BEHIND_ALIGN 4096
+#define WRITE_BEHIND_BLOCK ( 1024 * 1024 )
+
+/** A block of output waiting to be written */
+
+typedef struct write_chunk_s
+{
+	int64_t offset;
+	int size;
+	struct write_chunk_s *next;
+	uint8_t *data;
+} *write_chunk;
+
+/** Write-behind output.
+ *
+ * The muxer writes into memory through a custom AVIOContext and a thread writes
+ * the blocks out in order, so a stall of the storage only stalls the encoder
+ * once the backlog reaches its capacity. The output is either a file, written
+ * at the offsets the muxer seeked to, or the avformat-write event when redirecting.
+ */
+
+typedef struct write_behind_s
+{
+	mlt_properties properties;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	write_chunk head, tail;
+	size_t backlog, capacity;
+	int64_t position, size;
+	int fd, direct_fd;
+	int error, closing;
+	uint8_t *avio_buffer;
+	AVIOContext *io;
+} *write_behind;
+
+// O_DIRECT needs the memory to be aligned like the file offsets
+static uint8_t *write_chunk_alloc( int size )
+{
+#ifndef _WIN32
+	void *data = NULL;
+	return posix_memalign( &data, WRITE_BEHIND_ALIGN, size ) ? NULL : data;
+#else
+	return malloc( size );
+#endif
+}
+
+static void write_chunk_out( write_behind self, write_chunk chunk )
+{
+	if ( self->fd < 0 )
+	{
+		buffer_t buffer = { chunk->data, chunk->size };
+		mlt_events_fire( self->properties, "avformat-write", mlt_event_data_from_object(&buffer) );
+		return;
+	}
+#ifndef _WIN32
+	// Whole aligned blocks bypass the page cache when that was asked for
+	int fd = self->direct_fd >= 0 && !( chunk->offset % WRITE_BEHIND_ALIGN ) && !( chunk->size % WRITE_BEHIND_ALIGN ) ?
+		self->direct_fd : self->fd;
+	int done = 0;
+	while ( done < chunk->size )
+	{
+		ssize_t n = pwrite( fd, chunk->data + done, chunk->size - done, chunk->offset + done );
+		if ( n < 0 && errno == EINTR )
+			continue;
+		if ( n < 0 && fd == self->direct_fd )
+		{
+			// Some file systems refuse O_DIRECT, so carry on without it
+			fd = self->fd;
+			continue;
+		}
+		if ( n <= 0 )
+		{
+			mlt_log_error( NULL, "[consumer avformat] write failed: %s\n", strerror( errno ) );
+			pthread_mutex_lock( &self->mutex );
+			self->error = 1;
+			pthread_mutex_unlock( &self->mutex );
+			return;
+		}
+		done += n;
+	}
+#endif
+}
+
+static void *write_behind_thread( void *arg )
+{
+	write_behind self = arg;
+
+	pthread_mutex_lock( &self->mutex );
+	while ( 1 )
+	{
+		while ( !self->head && !self->closing )
+			pthread_cond_wait( &self->cond, &self->mutex );
+		write_chunk chunk = self->head;
+		if ( !chunk )
+			break;
+		pthread_mutex_unlock( &self->mutex );
+
+		if ( !self->error )
+			write_chunk_out( self, chunk );
+
+		pthread_mutex_lock( &self->mutex );
+		self->head = chunk->next;
+		if ( !self->head )
+			self->tail = NULL;
+		self->backlog -= chunk->size;
+		mlt_properties_set_int64( self->properties, "write_backlog", self->backlog );
+		pthread_cond_broadcast( &self->cond );
+		free( chunk->data );
+		free( chunk );
+	}
+	pthread_mutex_unlock( &self->mutex );
+	return NULL;
+}
+
+static int write_behind_write( void *opaque, uint8_t *buf, int size )
+{
+	write_behind self = opaque;
+	write_chunk chunk = calloc( 1, sizeof( *chunk ) );
+	int error;
+
+	if ( !chunk || !( chunk->data = write_chunk_alloc( size ) ) )
+	{
+		free( chunk );
+		return AVERROR( ENOMEM );
+	}
+	memcpy( chunk->data, buf, size );
+	chunk->size = size;
+
+	pthread_mutex_lock( &self->mutex );
+	// Block only when the backlog is full, there is always room for one chunk
+	while ( self->head && self->backlog + size > self->capacity && !self->error )
+		pthread_cond_wait( &self->cond, &self->mutex );
+	chunk->offset = self->position;
+	self->position += size;
+	if ( self->position > self->size )
+		self->size = self->position;
+	error = self->error;
+	if ( !error )
+	{
+		if ( self->tail )
+			self->tail->next = chunk;
+		else
+			self->head = chunk;
+		self->tail = chunk;
+		self->backlog += size;
+		if ( self->backlog > mlt_properties_get_int64( self->properties, "write_backlog_peak" ) )
+			mlt_properties_set_int64( self->properties, "write_backlog_peak", self->backlog );
+		pthread_cond_broadcast( &self->cond );
+	}
+	pthread_mutex_unlock( &self->mutex );
+
+	if ( error )
+	{
+		free( chunk->data );
+		free( chunk );
+		return AVERROR( EIO );
+	}
+	return size;
+}
+
+// Seeking only moves where the next chunk goes, the writes happen in order
+static int64_t write_behind_seek( void *opaque, int64_t offset, int whence )
+{
+	write_behind self = opaque;
+	int64_t position;
+
+	pthread_mutex_lock( &self->mutex );
+	switch ( whence & ~AVSEEK_FORCE )
+	{
+	case AVSEEK_SIZE:
+		position = self->size;
+		pthread_mutex_unlock( &self->mutex );
+		return position;
+	case SEEK_SET:
+		position = offset;
+		break;
+	case SEEK_CUR:
+		position = self->position + offset;
+		break;
+	case SEEK_END:
+		position = self->size + offset;
+		break;
+	default:
+		position = -1;
+		break;
+	}
+	if ( position >= 0 )
+		self->position = position;
+	pthread_mutex_unlock( &self->mutex );
+	return position >= 0 ? position : AVERROR( EINVAL );
+}
+
+/** Open the write-behind output.
+ *
+ * \param properties the consumer properties
+ * \param filename the file to write or NULL to fire avformat-write
+ * \return the output, or NULL if it could not be opened
+ */
+
+static write_behind write_behind_open( mlt_properties properties, const char *filename )
+{
+	write_behind self = calloc( 1, sizeof( *self ) );
+
+	self->properties = properties;
+	self->fd = self->direct_fd = -1;
+	self->capacity = (size_t) mlt_properties_get_int( properties, "write_behind" ) * 1024 * 1024;
+	pthread_mutex_init( &self->mutex, NULL );
+	pthread_cond_init( &self->cond, NULL );
+#ifndef _WIN32
+	if ( filename )
+	{
+		self->fd = open( filename, O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+#ifdef O_DIRECT
+		if ( self->fd >= 0 && mlt_properties_get_int( properties, "write_direct" ) )
+			self->direct_fd = open( filename, O_WRONLY | O_DIRECT );
+#endif
+	}
+#endif
+	self->avio_buffer = av_malloc( WRITE_BEHIND_BLOCK );
+	if ( self->avio_buffer )
+		self->io = avio_alloc_context( self->avio_buffer, WRITE_BEHIND_BLOCK, 1, self, NULL, write_behind_write,
+			filename ? write_behind_seek : NULL );
+	if ( ( filename && self->fd < 0 ) || !self->io || pthread_create( &self->thread, NULL, write_behind_thread, self ) )
+	{
+#ifndef _WIN32
+		if ( self->fd >= 0 )
+			close( self->fd );
+#endif
+		av_free( self->io );
+		av_free( self->avio_buffer );
+		pthread_mutex_destroy( &self->mutex );
+		pthread_cond_destroy( &self->cond );
+		free( self );
+		return NULL;
+	}
+	mlt_properties_set_int64( properties, "write_backlog", 0 );
+	mlt_properties_set_int64( properties, "write_backlog_peak", 0 );
+	return self;
+}
+
+/** Write out the backlog and close the output.
+ *
+ * \return true if anything could not be written
+ */
+
+static int write_behind_close( write_behind self )
+{
+	int error;
+
+	avio_flush( self->io );
+	pthread_mutex_lock( &self->mutex );
+	self->closing = 1;
+	pthread_cond_broadcast( &self->cond );
+	pthread_mutex_unlock( &self->mutex );
+	pthread_join( self->thread, NULL );
+	error = self->error;
+#ifndef _WIN32
+	if ( self->direct_fd >= 0 )
+		close( self->direct_fd );
+	if ( self->fd >= 0 && close( self->fd ) )
+		error = 1;
+#endif
+	av_free( self->io->buffer );
+	av_free( self->io );
+	pthread_mutex_destroy( &self->mutex );
+	pthread_cond_destroy( &self->cond );
+	free( self );
+	return error;
+}
+
+// The write-behind output only writes plain files, other protocols keep their own I/O
+static const char *write_behind_file( const char *filename )
+{
+	const char *protocol = avio_find_protocol_name( filename );
+
+	if ( !protocol || strcmp( protocol, "file" ) )
+		return NULL;
+	return strncmp( filename, "file:", 5 ) ? filename : filename + 5;
+}
+
 typedef struct encode_ctx_desc
 {
 	mlt_consumer consumer;
@@ -1238,8 +1604,201 @@ typedef struct encode_ctx_desc
 	mlt_properties frame_meta_properties;
 
 	AVFrame *audio_avframe;
+
+	// Encoding and muxing threads
+	int pipeline;
+	int real_time_output;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t mux_thread;
+	pthread_t audio_thread;
+	int mux_running;
+	int audio_running;
+	mlt_deque packets;
+	int packets_max;
+	int mux_error;
+	int mux_done;
+	int audio_error;
+	int audio_done;
+	int audio_abort;
+
+	// Extra muxers that receive copies of the packets
+	AVFormatContext *outputs[ MAX_OUTPUTS ];
+	int output_count;
+
+	// Asynchronous writing of the main output
+	write_behind write_behind;
 } encode_ctx_t;
 
+/** Open the extra outputs after the header of the main one is written.
+ *
+ * Each gets the streams of the main output, so the encoders are shared. An
+ * output that fails is left out without stopping the others.
+ */
+
+static void outputs_open( encode_ctx_t *ctx )
+{
+	char key[20];
+	int i, j;
+
+	for ( i = 1; i <= MAX_OUTPUTS; i++ )
+	{
+		snprintf( key, sizeof(key), "target.%d", i );
+		const char *target = mlt_properties_get( ctx->properties, key );
+		snprintf( key, sizeof(key), "f.%d", i );
+		const char *format = mlt_properties_get( ctx->properties, key );
+		AVFormatContext *oc = NULL;
+		int error = 0;
+
+		if ( !target || avformat_alloc_output_context2( &oc, NULL, format, target ) < 0 )
+			continue;
+		for ( j = 0; j < ctx->oc->nb_streams && !error; j++ )
+		{
+			AVStream *in = ctx->oc->streams[j];
+			AVStream *out = avformat_new_stream( oc, NULL );
+
+			error = !out || avcodec_parameters_from_context( out->codecpar, in->codec ) < 0;
+			if ( !error )
+			{
+				out->codecpar->codec_tag = 0;
+				out->time_base = in->time_base;
+				out->sample_aspect_ratio = in->sample_aspect_ratio;
+				av_dict_copy( &out->metadata, in->metadata, 0 );
+			}
+		}
+		av_dict_copy( &oc->metadata, ctx->oc->metadata, 0 );
+		if ( oc->oformat->priv_class && oc->priv_data )
+			apply_properties( oc->priv_data, ctx->properties, AV_OPT_FLAG_ENCODING_PARAM );
+		if ( !error && !( oc->oformat->flags & AVFMT_NOFILE ) )
+			error = avio_open( &oc->pb, target, AVIO_FLAG_WRITE ) < 0;
+		if ( !error )
+			error = avformat_write_header( oc, NULL ) < 0;
+		if ( error )
+		{
+			mlt_log_error( MLT_CONSUMER_SERVICE( ctx->consumer ), "Could not open the extra output '%s'\n", target );
+			if ( oc->pb && !( oc->oformat->flags & AVFMT_NOFILE ) )
+				avio_closep( &oc->pb );
+			avformat_free_context( oc );
+			continue;
+		}
+		ctx->outputs[ ctx->output_count++ ] = oc;
+	}
+}
+
+static void outputs_close_one( AVFormatContext *oc, int trailer )
+{
+	if ( trailer )
+		av_write_trailer( oc );
+	if ( oc->pb && !( oc->oformat->flags & AVFMT_NOFILE ) )
+		avio_closep( &oc->pb );
+	avformat_free_context( oc );
+}
+
+static void outputs_close( encode_ctx_t *ctx )
+{
+	int i;
+
+	for ( i = 0; i < ctx->output_count; i++ )
+		outputs_close_one( ctx->outputs[i], 1 );
+	ctx->output_count = 0;
+}
+
+/** Write a packet to the main output and a copy of it to each of the extra ones.
+ */
+
+static int outputs_write( encode_ctx_t *ctx, AVPacket *pkt )
+{
+	int i;
+
+	for ( i = 0; i < ctx->output_count; )
+	{
+		AVFormatContext *oc = ctx->outputs[i];
+		AVPacket *copy = pkt->size ? av_packet_clone( pkt ) : NULL;
+		int ret = 0;
+
+		if ( copy )
+		{
+			av_packet_rescale_ts( copy, ctx->oc->streams[ pkt->stream_index ]->time_base,
+				oc->streams[ pkt->stream_index ]->time_base );
+			ret = av_interleaved_write_frame( oc, copy );
+			av_packet_free( &copy );
+		}
+		if ( ret < 0 )
+		{
+			// A stream that went away does not stop the others
+			mlt_log_error( MLT_CONSUMER_SERVICE( ctx->consumer ), "error writing to extra output %d, dropping it\n", i + 1 );
+			outputs_close_one( oc, 0 );
+			ctx->outputs[i] = ctx->outputs[ --ctx->output_count ];
+		}
+		else
+		{
+			i++;
+		}
+	}
+	return av_interleaved_write_frame( ctx->oc, pkt );
+}
+
+/** Write a packet, through the muxing thread when the pipeline is running.
+ *
+ * The packet is copied into the bounded queue of the thread, so the caller
+ * can reuse its buffer, and this only waits when the queue is full.
+ */
+
+static int mux_write( encode_ctx_t *ctx, AVPacket *pkt )
+{
+	if ( !ctx->mux_running )
+		return outputs_write( ctx, pkt );
+
+	AVPacket *copy = av_packet_alloc();
+	if ( !copy || av_packet_ref( copy, pkt ) < 0 )
+	{
+		av_packet_free( &copy );
+		return AVERROR(ENOMEM);
+	}
+	pthread_mutex_lock( &ctx->mutex );
+	while ( mlt_deque_count( ctx->packets ) >= ctx->packets_max && !ctx->mux_error )
+		pthread_cond_wait( &ctx->cond, &ctx->mutex );
+	int error = ctx->mux_error;
+	if ( !error )
+		mlt_deque_push_back( ctx->packets, copy );
+	pthread_cond_broadcast( &ctx->cond );
+	pthread_mutex_unlock( &ctx->mutex );
+	if ( error )
+		av_packet_free( &copy );
+	return error;
+}
+
+static void *mux_thread( void *arg )
+{
+	encode_ctx_t *ctx = arg;
+
+	pthread_mutex_lock( &ctx->mutex );
+	while ( 1 )
+	{
+		while ( !mlt_deque_count( ctx->packets ) && !ctx->mux_done )
+			pthread_cond_wait( &ctx->cond, &ctx->mutex );
+		AVPacket *pkt = mlt_deque_pop_front( ctx->packets );
+		if ( !pkt )
+			break;
+		pthread_cond_broadcast( &ctx->cond );
+		pthread_mutex_unlock( &ctx->mutex );
+
+		// A slow disk or network only holds up this thread until the queue is full
+		int ret = ctx->mux_error ? 0 : outputs_write( ctx, pkt );
+		av_packet_free( &pkt );
+
+		pthread_mutex_lock( &ctx->mutex );
+		if ( ret < 0 && !ctx->mux_error )
+		{
+			ctx->mux_error = ret;
+			pthread_cond_broadcast( &ctx->cond );
+		}
+	}
+	pthread_mutex_unlock( &ctx->mutex );
+
+	return NULL;
+}
+
 static int encode_audio(encode_ctx_t* ctx)
 {
 	char key[27];
@@ -1247,6 +1806,9 @@ static int encode_audio(encode_ctx_t* ctx)
 
 	int frame_length = ctx->audio_input_frame_size * ctx->channels * ctx->sample_bytes;
 
+	if ( ctx->audio_running )
+		pthread_mutex_lock( &ctx->mutex );
+
 	// Get samples count to fetch from fifo
 	if ( sample_fifo_used( ctx->fifo ) < frame_length )
 	{
@@ -1260,17 +1822,22 @@ static int encode_audio(encode_ctx_t* ctx)
 
 	// Get the audio samples
 	if ( samples > 0 )
-	{
 		sample_fifo_fetch( ctx->fifo, ctx->audio_buf_1, samples * ctx->sample_bytes * ctx->channels );
+	if ( ctx->audio_running )
+	{
+		// Let the frame thread append more
+		pthread_cond_broadcast( &ctx->cond );
+		pthread_mutex_unlock( &ctx->mutex );
 	}
-	else if ( ctx->audio_codec_id == AV_CODEC_ID_VORBIS && ctx->terminated )
+
+	if ( samples <= 0 && ctx->audio_codec_id == AV_CODEC_ID_VORBIS && ctx->terminated )
 	{
 		// This prevents an infinite loop when some versions of vorbis do not
 		// increment pts when encoding silence.
 		ctx->audio_pts = ctx->video_pts;
 		return 1;
 	}
-	else
+	else if ( samples <= 0 )
 	{
 		memset( ctx->audio_buf_1, 0, AUDIO_ENCODE_BUFFER_SIZE );
 	}
@@ -1424,7 +1991,7 @@ receive_audio_packet:
 			if ( pkt.duration > 0 )
 				pkt.duration = av_rescale_q( pkt.duration, codec->time_base, stream->time_base );
 			pkt.stream_index = stream->index;
-			if ( av_interleaved_write_frame( ctx->oc, &pkt ) )
+			if ( mux_write( ctx, &pkt ) )
 			{
 				mlt_log_fatal( MLT_CONSUMER_SERVICE( ctx->consumer ), "error writing audio frame\n" );
 				mlt_events_fire( ctx->properties, "consumer-fatal-error", mlt_event_data_none() );
@@ -1447,7 +2014,7 @@ receive_audio_packet:
 		else if (!samples) // flushing
 		{
 			pkt.stream_index = stream->index;
-			av_interleaved_write_frame(ctx->oc, &pkt);
+			mux_write( ctx, &pkt );
 		}
 
 		if ( i == 0 )
@@ -1459,6 +2026,137 @@ receive_audio_packet:
 	return 0;
 }
 
+/** The audio encoding thread of the pipeline.
+ *
+ * It encodes whole frames of samples as the frame thread appends them to the
+ * fifo. When it is told that the input is done it pads the audio to the length
+ * of the video and drains the encoder like the single threaded loop does.
+ */
+
+static void *audio_thread( void *arg )
+{
+	encode_ctx_t *ctx = arg;
+	int r = 0;
+
+	pthread_mutex_lock( &ctx->mutex );
+	while ( !ctx->audio_abort )
+	{
+		int frame_length = ctx->audio_input_frame_size * ctx->channels * ctx->sample_bytes;
+
+		if ( ctx->fifo && sample_fifo_used( ctx->fifo ) >= frame_length )
+		{
+			pthread_mutex_unlock( &ctx->mutex );
+			r = encode_audio( ctx );
+			pthread_mutex_lock( &ctx->mutex );
+			if ( r < 0 )
+				break;
+		}
+		else if ( ctx->audio_done )
+		{
+			break;
+		}
+		else
+		{
+			pthread_cond_wait( &ctx->cond, &ctx->mutex );
+		}
+	}
+	pthread_mutex_unlock( &ctx->mutex );
+
+	if ( r >= 0 && !ctx->audio_abort )
+	{
+		r = 0;
+		while ( !r && ctx->audio_pts < ctx->video_pts )
+			r = encode_audio( ctx );
+		if ( r >= 0 && ctx->fifo && ctx->real_time_output <= 0 ) for (;;)
+		{
+			pthread_mutex_lock( &ctx->mutex );
+			int sz = sample_fifo_used( ctx->fifo );
+			pthread_mutex_unlock( &ctx->mutex );
+			r = encode_audio( ctx );
+
+			mlt_log_debug( MLT_CONSUMER_SERVICE( ctx->consumer ), "flushing audio: sz=%d, ret=%d\n", sz, r );
+
+			if ( !sz || r < 0 )
+				break;
+		}
+	}
+	if ( r < 0 )
+	{
+		pthread_mutex_lock( &ctx->mutex );
+		ctx->audio_error = 1;
+		pthread_cond_broadcast( &ctx->cond );
+		pthread_mutex_unlock( &ctx->mutex );
+	}
+
+	return NULL;
+}
+
+/** Start the muxing thread and, with video, the audio encoding thread.
+ *
+ * The audio thread needs the muxing thread to serialize its packets with the
+ * video, so without it the encoding stays on the consumer thread.
+ */
+
+static void pipeline_start( encode_ctx_t *ctx )
+{
+	ctx->packets = mlt_deque_init();
+	if ( !ctx->packets || pthread_create( &ctx->mux_thread, NULL, mux_thread, ctx ) )
+	{
+		mlt_log_warning( MLT_CONSUMER_SERVICE( ctx->consumer ), "failed to start the muxing thread, encoding without it\n" );
+		if ( ctx->packets )
+			mlt_deque_close( ctx->packets );
+		ctx->packets = NULL;
+		ctx->pipeline = 0;
+		return;
+	}
+	ctx->mux_running = 1;
+	if ( ctx->video_st && ctx->audio_st[0] )
+	{
+		ctx->audio_running = 1;
+		if ( pthread_create( &ctx->audio_thread, NULL, audio_thread, ctx ) )
+			ctx->audio_running = 0;
+	}
+}
+
+/** Tell the audio thread that there are no more samples and wait for it.
+ *
+ * \param abort non-zero to stop without padding or draining the encoder
+ */
+
+static void pipeline_finish_audio( encode_ctx_t *ctx, int abort )
+{
+	if ( ctx->audio_running )
+	{
+		pthread_mutex_lock( &ctx->mutex );
+		ctx->audio_done = 1;
+		ctx->audio_abort = abort;
+		pthread_cond_broadcast( &ctx->cond );
+		pthread_mutex_unlock( &ctx->mutex );
+		pthread_join( ctx->audio_thread, NULL );
+		ctx->audio_running = 0;
+	}
+}
+
+/** Stop the pipeline after writing all of the queued packets.
+ */
+
+static void pipeline_stop( encode_ctx_t *ctx )
+{
+	pipeline_finish_audio( ctx, 1 );
+	if ( ctx->mux_running )
+	{
+		pthread_mutex_lock( &ctx->mutex );
+		ctx->mux_done = 1;
+		pthread_cond_broadcast( &ctx->cond );
+		pthread_mutex_unlock( &ctx->mutex );
+		pthread_join( ctx->mux_thread, NULL );
+		ctx->mux_running = 0;
+	}
+	if ( ctx->packets )
+		mlt_deque_close( ctx->packets );
+	ctx->packets = NULL;
+}
+
 /** The main thread - the argument is simply the consumer.
 */
 
@@ -1476,11 +2174,18 @@ static void *consumer_thread( void *arg )
 	// Get the properties
 	mlt_properties properties = enc_ctx->properties = MLT_CONSUMER_PROPERTIES( consumer );
 
+	// Encode audio and write packets on their own threads unless disabled
+	pthread_mutex_init( &enc_ctx->mutex, NULL );
+	pthread_cond_init( &enc_ctx->cond, NULL );
+	enc_ctx->pipeline = !mlt_properties_get( properties, "pipeline" ) || mlt_properties_get_int( properties, "pipeline" );
+	enc_ctx->packets_max = mlt_properties_get_int( properties, "mux_queue_size" ) > 0 ?
+		mlt_properties_get_int( properties, "mux_queue_size" ) : MUX_QUEUE_SIZE;
+
 	// Get the terminate on pause property
 	enc_ctx->terminate_on_pause = mlt_properties_get_int( enc_ctx->properties, "terminate_on_pause" );
 
 	// Determine if feed is slow (for realtime stuff)
-	int real_time_output = mlt_properties_get_int( properties, "real_time" );
+	int real_time_output = enc_ctx->real_time_output = mlt_properties_get_int( properties, "real_time" );
 
 	// Time structures
 	struct timeval ante;
@@ -1521,6 +2226,7 @@ static void *consumer_thread( void *arg )
 
 	// Need two av pictures for converting
 	AVFrame *converted_avframe = NULL;
+	AVFrame *wrapped_avframe = NULL;
 	AVFrame *avframe = NULL;
 
 	// For receiving audio samples back from the fifo
@@ -1676,10 +2382,34 @@ static void *consumer_thread( void *arg )
 					 !strcmp( pix_fmt_name, "bgra" ) ) {
 					mlt_properties_set( properties, "mlt_image_format", "rgba" );
 					img_fmt = mlt_image_rgba;
+				} else if ( !strcmp( pix_fmt_name, "rgba64le" ) ) {
+					mlt_properties_set( properties, "mlt_image_format", "rgba64" );
+					img_fmt = mlt_image_rgba64;
 				} else if ( strstr( pix_fmt_name, "rgb" ) ||
 							strstr( pix_fmt_name, "bgr" ) ) {
 					mlt_properties_set( properties, "mlt_image_format", "rgb" );
 					img_fmt = mlt_image_rgb;
+				} else if ( !strcmp( pix_fmt_name, "yuv420p10le" ) ) {
+					// Keep the native layout of high bit depth and hardware encoders.
+					mlt_properties_set( properties, "mlt_image_format", "yuv420p10" );
+					img_fmt = mlt_image_yuv420p10;
+				} else if ( !strcmp( pix_fmt_name, "yuv420p" ) ) {
+					// Let the graph produce the planes the encoder takes.
+					mlt_properties_set( properties, "mlt_image_format", "yuv420p" );
+					img_fmt = mlt_image_yuv420p;
+				} else if ( !strcmp( pix_fmt_name, "yuv422p16le" ) ) {
+					mlt_properties_set( properties, "mlt_image_format", "yuv422p16" );
+					img_fmt = mlt_image_yuv422p16;
+				} else if ( !strcmp( pix_fmt_name, "p010le" ) ) {
+					mlt_properties_set( properties, "mlt_image_format", "p010" );
+					img_fmt = mlt_image_p010;
+				} else if ( !strcmp( pix_fmt_name, "nv12" )
+#if defined(AVFILTER) && LIBAVUTIL_VERSION_MAJOR >= 56
+							|| !strcmp( pix_fmt_name, "vaapi" )
+#endif
+							) {
+					mlt_properties_set( properties, "mlt_image_format", "nv12" );
+					img_fmt = mlt_image_nv12;
 				}
 			}
 		}
@@ -1717,6 +2447,10 @@ static void *consumer_thread( void *arg )
 	}
 	mlt_properties_set_int( properties, "channels", enc_ctx->total_channels );
 
+	// Without a video stream the producers need not make images
+	if ( !enc_ctx->video_st && enc_ctx->audio_st[0] )
+		mlt_properties_set_int( properties, "video_off", 1 );
+
 	// Audio format is determined when adding the audio stream
 	mlt_audio_format aud_fmt = mlt_audio_none;
 	if ( enc_ctx->audio_st[0] )
@@ -1765,7 +2499,21 @@ static void *consumer_thread( void *arg )
 		}
 
 		// Setup custom I/O if redirecting
-		if ( mlt_properties_get_int( properties, "redirect" ) )
+		if ( mlt_properties_get_int( properties, "redirect" ) && mlt_properties_get_int( properties, "write_behind" ) > 0 )
+		{
+			enc_ctx->write_behind = write_behind_open( properties, NULL );
+			if ( enc_ctx->write_behind )
+			{
+				enc_ctx->oc->pb = enc_ctx->write_behind->io;
+				enc_ctx->oc->flags |= AVFMT_FLAG_CUSTOM_IO;
+				mlt_events_register( properties, "avformat-write" );
+			}
+			else
+			{
+				mlt_log_error( MLT_CONSUMER_SERVICE(consumer), "failed to setup output redirection\n" );
+			}
+		}
+		else if ( mlt_properties_get_int( properties, "redirect" ) )
 		{
 			int buffer_size = 32768;
 			unsigned char *buffer = av_malloc( buffer_size );
@@ -1787,10 +2535,23 @@ static void *consumer_thread( void *arg )
 		// Open the output file, if needed
 		else if ( !( fmt->flags & AVFMT_NOFILE ) )
 		{
-			if ( avio_open( &enc_ctx->oc->pb, filename, AVIO_FLAG_WRITE ) < 0 )
+			const char *file = write_behind_file( filename );
+			const char *movflags = mlt_properties_get( properties, "movflags" );
+
+			// faststart reads the file back before the backlog is written
+			if ( file && mlt_properties_get_int( properties, "write_behind" ) > 0 && !( movflags && strstr( movflags, "faststart" ) ) )
 			{
-				mlt_log_error( MLT_CONSUMER_SERVICE( consumer ), "Could not open '%s'\n", filename );
-				mlt_events_fire( properties, "consumer-fatal-error", mlt_event_data_none() );
+				enc_ctx->write_behind = write_behind_open( properties, file );
+				if ( enc_ctx->write_behind )
+				{
+					enc_ctx->oc->pb = enc_ctx->write_behind->io;
+					enc_ctx->oc->flags |= AVFMT_FLAG_CUSTOM_IO;
+				}
+			}
+			if ( !enc_ctx->write_behind && avio_open( &enc_ctx->oc->pb, filename, AVIO_FLAG_WRITE ) < 0 )
+			{
+				mlt_log_error( MLT_CONSUMER_SERVICE( consumer ), "Could not open '%s'\n", filename );
+				mlt_events_fire( properties, "consumer-fatal-error", mlt_event_data_none() );
 				goto on_fatal_error;
 			}
 		}
@@ -1881,6 +2642,14 @@ static void *consumer_thread( void *arg )
 				}
 
 				header_written = 1;
+				outputs_open( enc_ctx );
+
+#ifdef AVFMT_RAWPICTURE
+				if ( enc_ctx->oc->oformat->flags & AVFMT_RAWPICTURE )
+					enc_ctx->pipeline = 0;
+#endif
+				if ( enc_ctx->pipeline )
+					pipeline_start( enc_ctx );
 			}
 
 			// Increment frames dispatched
@@ -1892,13 +2661,26 @@ static void *consumer_thread( void *arg )
 			// Get audio and append to the fifo
 			if ( !enc_ctx->terminated && enc_ctx->audio_st[0] )
 			{
-				samples = mlt_audio_calculate_frame_samples( fps, enc_ctx->frequency, count ++ );
-				enc_ctx->channels = enc_ctx->total_channels;
-				mlt_frame_get_audio( frame, &pcm, &aud_fmt, &enc_ctx->frequency, &enc_ctx->channels, &samples );
+				int channels = enc_ctx->total_channels;
+				int frequency = enc_ctx->frequency;
+				samples = mlt_audio_calculate_frame_samples( fps, frequency, count ++ );
+				mlt_frame_get_audio( frame, &pcm, &aud_fmt, &frequency, &channels, &samples );
 
 				// Save the audio channel remap properties for later
 				mlt_properties_pass( enc_ctx->frame_meta_properties, frame_properties, "meta.map.audio." );
 
+				if ( enc_ctx->audio_running )
+				{
+					pthread_mutex_lock( &enc_ctx->mutex );
+
+					// Wait while the audio encoder is far behind
+					while ( enc_ctx->fifo && !enc_ctx->audio_error && sample_fifo_used( enc_ctx->fifo ) >
+						AUDIO_QUEUE_SECONDS * enc_ctx->frequency * enc_ctx->channels * enc_ctx->sample_bytes )
+						pthread_cond_wait( &enc_ctx->cond, &enc_ctx->mutex );
+				}
+				enc_ctx->channels = channels;
+				enc_ctx->frequency = frequency;
+
 				// Create the fifo if we don't have one
 				if ( enc_ctx->fifo == NULL )
 				{
@@ -1915,6 +2697,13 @@ static void *consumer_thread( void *arg )
 					sample_fifo_append( enc_ctx->fifo, pcm, samples * enc_ctx->channels * enc_ctx->sample_bytes );
 					total_time += ( samples * 1000000 ) / enc_ctx->frequency;
 				}
+				if ( enc_ctx->audio_running )
+				{
+					pthread_cond_broadcast( &enc_ctx->cond );
+					pthread_mutex_unlock( &enc_ctx->mutex );
+					if ( enc_ctx->audio_error )
+						goto on_fatal_error;
+				}
 				if ( !enc_ctx->video_st ) {
 					mlt_events_fire( properties, "consumer-frame-show", mlt_event_data_from_frame(frame) );
 				}
@@ -1932,7 +2721,8 @@ static void *consumer_thread( void *arg )
 		while ( 1 )
 		{
 			// Write interleaved audio and video frames
-			if ( !enc_ctx->video_st || ( enc_ctx->video_st && enc_ctx->audio_st[0] && enc_ctx->audio_pts < enc_ctx->video_pts ) )
+			if ( !enc_ctx->audio_running &&
+				( !enc_ctx->video_st || ( enc_ctx->video_st && enc_ctx->audio_st[0] && enc_ctx->audio_pts < enc_ctx->video_pts ) ) )
 			{
 				// Write audio
 				int fifo_frames = sample_fifo_used( enc_ctx->fifo ) /
@@ -1965,12 +2755,75 @@ static void *consumer_thread( void *arg )
 					if ( mlt_properties_get_int( frame_properties, "rendered" ) )
 					{
 						AVFrame video_avframe;
-						mlt_frame_get_image( frame, &image, &img_fmt, &img_width, &img_height, 0 );
+						AVFrame *sw_frame = NULL;
+						int srcfmt;
 
-						mlt_image_format_planes( img_fmt, width, height, image, video_avframe.data, video_avframe.linesize );
+						// Request the configured format for every frame, even if one came back as another.
+						mlt_image_format frame_img_fmt = img_fmt;
+						mlt_frame_get_image( frame, &image, &frame_img_fmt, &img_width, &img_height, 0 );
+
+						if ( frame_img_fmt == mlt_image_hwframe )
+						{
+#if defined(AVFILTER) && LIBAVUTIL_VERSION_MAJOR >= 56
+							// Encode the decoded surface directly without leaving the device.
+							if ( AV_PIX_FMT_VAAPI == c->pix_fmt && ( (AVFrame*) image )->format == AV_PIX_FMT_VAAPI )
+							{
+								if ( !avframe )
+									avframe = av_frame_alloc();
+								av_frame_unref( avframe );
+								ret = av_frame_ref( avframe, (AVFrame*) image );
+								if ( ret < 0 ) {
+									mlt_log_warning( MLT_CONSUMER_SERVICE( consumer ), "error referencing hardware frame: %d (frame %d)\n", ret, enc_ctx->frame_count );
+									goto on_fatal_error;
+								}
+								mlt_events_fire( properties, "consumer-frame-show", mlt_event_data_from_frame(frame) );
+								goto video_frame_ready;
+							}
+#endif
+							// Otherwise download it and convert from its software format.
+							sw_frame = av_frame_alloc();
+							ret = av_hwframe_transfer_data( sw_frame, (AVFrame*) image, 0 );
+							if ( ret < 0 ) {
+								mlt_log_error( MLT_CONSUMER_SERVICE( consumer ), "av_hwframe_transfer_data() failed %d\n", ret );
+								av_frame_free( &sw_frame );
+								goto on_fatal_error;
+							}
+							memcpy( video_avframe.data, sw_frame->data, sizeof( video_avframe.data ) );
+							memcpy( video_avframe.linesize, sw_frame->linesize, sizeof( video_avframe.linesize ) );
+							srcfmt = sw_frame->format;
+							ret = 0;
+						}
+						else
+						{
+							int src_colorspace = mlt_properties_get_int( frame_properties, "colorspace" );
+							int src_full_range = mlt_properties_get_int( frame_properties, "full_luma" );
+							const char *img_fmt_name = mlt_properties_get( properties, "mlt_image_format" );
+							int is_rgb = frame_img_fmt == mlt_image_rgb || frame_img_fmt == mlt_image_rgba
+								|| frame_img_fmt == mlt_image_rgba64;
+
+							// Skip the conversion if the image already is what the encoder takes
+							if ( pick_pix_fmt( frame_img_fmt ) == pix_fmt && img_width == width && img_height == height
+								 && ( is_rgb || ( src_colorspace == dst_colorspace && src_full_range == dst_full_range ) )
+								 && ( pix_fmt != AV_PIX_FMT_RGBA || ( img_fmt_name && !strcmp( img_fmt_name, "rgba" ) ) )
+#if defined(AVFILTER) && LIBAVUTIL_VERSION_MAJOR >= 56
+								 && AV_PIX_FMT_VAAPI != c->pix_fmt
+#endif
+								 )
+							{
+								if ( !wrapped_avframe )
+									wrapped_avframe = av_frame_alloc();
+								if ( wrapped_avframe && wrap_picture( wrapped_avframe, frame, image, frame_img_fmt, width, height ) )
+								{
+									avframe = wrapped_avframe;
+									mlt_events_fire( properties, "consumer-frame-show", mlt_event_data_from_frame(frame) );
+									goto video_frame_wrapped;
+								}
+							}
+							mlt_image_format_planes( frame_img_fmt, width, height, image, video_avframe.data, video_avframe.linesize );
+							srcfmt = pick_pix_fmt( frame_img_fmt );
+						}
 
 						// Do the colour space conversion
-						int srcfmt = pick_pix_fmt( img_fmt );
 						int flags = mlt_get_sws_flags( width, height, srcfmt, width, height, pix_fmt);
 						struct SwsContext *context = sws_getContext( width, height, srcfmt,
 							width, height, pix_fmt, flags, NULL, NULL, NULL);
@@ -1980,6 +2833,7 @@ static void *consumer_thread( void *arg )
 						sws_scale( context, (const uint8_t* const*) video_avframe.data, video_avframe.linesize, 0, height,
 							converted_avframe->data, converted_avframe->linesize);
 						sws_freeContext( context );
+						av_frame_free( &sw_frame );
 
 						mlt_events_fire( properties, "consumer-frame-show", mlt_event_data_from_frame(frame) );
 
@@ -2053,6 +2907,11 @@ static void *consumer_thread( void *arg )
 #else
 						avframe = converted_avframe;
 #endif
+#if defined(AVFILTER) && LIBAVUTIL_VERSION_MAJOR >= 56
+video_frame_ready:
+#endif
+video_frame_wrapped:
+						;
 					}
 
 #ifdef AVFMT_RAWPICTURE
@@ -2133,7 +2992,7 @@ receive_video_packet:
 							pkt.stream_index = enc_ctx->video_st->index;
 
 							// write the compressed frame in the media file
-							ret = av_interleaved_write_frame(enc_ctx->oc, &pkt);
+							ret = mux_write( enc_ctx, &pkt );
 							mlt_log_debug( MLT_CONSUMER_SERVICE( consumer ), " frame_size %d\n", c->frame_size );
 							
 							// Dual pass logging
@@ -2187,7 +3046,11 @@ receive_video_packet:
 			long passed = time_difference( &ante );
 			if ( enc_ctx->fifo != NULL )
 			{
+				if ( enc_ctx->audio_running )
+					pthread_mutex_lock( &enc_ctx->mutex );
 				long pending = ( ( ( long )sample_fifo_used( enc_ctx->fifo ) / enc_ctx->sample_bytes * 1000 ) / enc_ctx->frequency ) * 1000;
+				if ( enc_ctx->audio_running )
+					pthread_mutex_unlock( &enc_ctx->mutex );
 				passed -= pending;
 			}
 			if ( passed < total_time )
@@ -2199,12 +3062,18 @@ receive_video_packet:
 		}
 	}
 
+	// The audio thread pads and flushes its encoder itself
+	int audio_threaded = enc_ctx->audio_running;
+	pipeline_finish_audio( enc_ctx, 0 );
+	if ( enc_ctx->audio_error )
+		goto on_fatal_error;
+
 	// Flush the encoder buffers
 	if ( real_time_output <= 0 )
 	{
 		// Flush audio fifo
 		// TODO: flush all audio streams
-		if ( enc_ctx->fifo && enc_ctx->audio_st[0] ) for (;;)
+		if ( enc_ctx->fifo && enc_ctx->audio_st[0] && !audio_threaded ) for (;;)
 		{
 			int sz = sample_fifo_used( enc_ctx->fifo );
 			int ret = encode_audio( enc_ctx );
@@ -2267,7 +3136,7 @@ receive_video_packet:
 			pkt.stream_index = enc_ctx->video_st->index;
 
 			// write the compressed frame in the media file
-			if ( av_interleaved_write_frame( enc_ctx->oc, &pkt ) != 0 )
+			if ( mux_write( enc_ctx, &pkt ) != 0 )
 			{
 				mlt_log_fatal( MLT_CONSUMER_SERVICE(consumer), "error writing flushed video frame\n" );
 				mlt_events_fire( properties, "consumer-fatal-error", mlt_event_data_none() );
@@ -2281,14 +3150,19 @@ on_fatal_error:
 	if ( frame )
 		mlt_frame_close( frame );
 
+	// Write out everything that is still queued
+	pipeline_stop( enc_ctx );
+
 	// Write the trailer, if any
 	if ( frames )
 		av_write_trailer( enc_ctx->oc );
+	outputs_close( enc_ctx );
 
 	// Clean up input and output frames
 	if ( converted_avframe )
 		av_free( converted_avframe->data[0] );
 	av_free( converted_avframe );
+	av_frame_free( &wrapped_avframe );
 #if defined(AVFILTER) && LIBAVUTIL_VERSION_MAJOR >= 56
 	if (enc_ctx->video_st && enc_ctx->video_st->codec && AV_PIX_FMT_VAAPI == enc_ctx->video_st->codec->pix_fmt)
 		av_frame_free(&avframe);
@@ -2307,7 +3181,17 @@ on_fatal_error:
 		av_freep( &enc_ctx->oc->streams[i] );
 
 	// Close the output file
-	if ( !( fmt->flags & AVFMT_NOFILE ) &&
+	if ( enc_ctx->write_behind )
+	{
+		if ( write_behind_close( enc_ctx->write_behind ) )
+		{
+			mlt_log_error( MLT_CONSUMER_SERVICE( consumer ), "failed to write '%s'\n", filename );
+			mlt_events_fire( properties, "consumer-fatal-error", mlt_event_data_none() );
+		}
+		enc_ctx->write_behind = NULL;
+		enc_ctx->oc->pb = NULL;
+	}
+	else if ( !( fmt->flags & AVFMT_NOFILE ) &&
 		!mlt_properties_get_int( properties, "redirect" ) )
 	{
 		if ( enc_ctx->oc->pb  ) avio_close( enc_ctx->oc->pb );
@@ -2363,11 +3247,1083 @@ on_fatal_error:
 	while ( ( frame = mlt_deque_pop_back( queue ) ) )
 		mlt_frame_close( frame );
 
+	pthread_mutex_destroy( &enc_ctx->mutex );
+	pthread_cond_destroy( &enc_ctx->cond );
 	mlt_pool_release( enc_ctx );
 
 	return NULL;
 }
 
+/** Determine if the export can be made of separately written segments.
+*/
+
+static int segments_supported( mlt_properties properties )
+{
+	const char *target = mlt_properties_get( properties, "target" );
+	const char *vcodec = mlt_properties_get( properties, "vcodec" );
+
+	// The segments are files which are concatenated afterwards
+	if ( !target || !strcmp( target, "" ) || strstr( target, "://" ) || !strncmp( target, "pipe:", 5 )
+		|| mlt_properties_get_int( properties, "redirect" ) )
+		return 0;
+	if ( mlt_properties_get_int( properties, "vn" ) || ( vcodec && !strcmp( vcodec, "none" ) ) )
+		return 0;
+	// Every segment would need the whole log of the first pass
+	if ( mlt_properties_get_int( properties, "pass" ) )
+		return 0;
+	// The extra outputs are fed by the encoders of one consumer
+	if ( mlt_properties_get( properties, "target.1" ) )
+		return 0;
+	return 1;
+}
+
+/** Determine if the export should be split into segments which are encoded in parallel.
+*/
+
+static int use_segments( mlt_properties properties )
+{
+	return ( mlt_properties_get_int( properties, "segments" ) > 1 || mlt_properties_get_int( properties, "join_segments" )
+		|| mlt_properties_get_int( properties, "checkpoint" ) ) && segments_supported( properties );
+}
+
+/** Determine if unchanged parts of the sources should be copied instead of encoded.
+*/
+
+static int use_smart_render( mlt_properties properties )
+{
+	return mlt_properties_get_int( properties, "smart_render" ) && segments_supported( properties );
+}
+
+typedef struct
+{
+	mlt_consumer consumer;
+	mlt_producer producer;
+	char *target;
+	int position;         // the first frame of the segment in the output
+	int in, out;          // the range of the timeline to encode
+	const char *disable;  // "an" for video or "vn" for audio
+	char *source;         // or the file to copy the video packets from
+	int video_index;
+	int copy_in, copy_out; // the keyframes of the source which begin and end the copy
+	int started;
+	int done;             // 1 when the file is complete, -1 when it is not
+} segment_job;
+
+/** The properties of the parent consumer which are not given to the consumers of the segments */
+
+static const char *segment_skip[] = { "target", "f", "segments", "smart_render", "join_segments", "segment_size",
+	"checkpoint", "running", "mlt_type", "mlt_service", NULL };
+
+static int segment_skipped( const char *name )
+{
+	int i;
+
+	for ( i = 0; segment_skip[i] && strcmp( segment_skip[i], name ); i++ );
+	return name[0] == '_' || segment_skip[i] != NULL;
+}
+
+/** Make the consumer of a segment with the settings of the parent consumer.
+*/
+
+static mlt_consumer segment_consumer( mlt_consumer parent, const char *target )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( parent );
+	mlt_consumer consumer = mlt_factory_consumer( mlt_service_profile( MLT_CONSUMER_SERVICE( parent ) ), "avformat", target );
+
+	if ( consumer )
+	{
+		mlt_properties child = MLT_CONSUMER_PROPERTIES( consumer );
+		int i, count = mlt_properties_count( properties );
+
+		for ( i = 0; i < count; i++ )
+		{
+			const char *name = mlt_properties_get_name( properties, i );
+			const char *value = mlt_properties_get_value( properties, i );
+
+			if ( name && value && !segment_skipped( name ) )
+				mlt_properties_set( child, name, value );
+		}
+		// Matroska can hold any codec and keeps the encoder's global headers
+		mlt_properties_set( child, "f", "matroska" );
+		mlt_properties_set_int( child, "terminate_on_pause", 1 );
+	}
+	return consumer;
+}
+
+/** Start rendering a range of the timeline on its own copy of the producer graph.
+*/
+
+static int segment_start( mlt_consumer parent, segment_job *job, const char *xml )
+{
+	mlt_profile profile = mlt_service_profile( MLT_CONSUMER_SERVICE( parent ) );
+
+	job->started = 1;
+	job->producer = mlt_factory_producer( profile, "xml-string", xml );
+	job->consumer = segment_consumer( parent, job->target );
+	if ( !job->producer || !job->consumer )
+		return 1;
+	mlt_producer_set_in_and_out( job->producer, job->in, job->out );
+	// Nor render what the segment does not encode
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( job->consumer ), job->disable, 1 );
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( job->consumer ), strcmp( job->disable, "an" ) ? "video_off" : "audio_off", 1 );
+	mlt_consumer_connect( job->consumer, MLT_PRODUCER_SERVICE( job->producer ) );
+	return mlt_consumer_start( job->consumer );
+}
+
+/** Close the job of a segment and remove its file unless asked to keep it.
+*/
+
+static void segment_close( segment_job *job, int keep )
+{
+	if ( job->consumer )
+	{
+		mlt_consumer_stop( job->consumer );
+		mlt_consumer_close( job->consumer );
+	}
+	mlt_producer_close( job->producer );
+	if ( job->target )
+	{
+		if ( !keep )
+			remove( job->target );
+		free( job->target );
+	}
+	free( job->source );
+	memset( job, 0, sizeof( *job ) );
+}
+
+/** Read the next packet of the video segments as one stream in the time base of the output.
+*/
+
+static int segment_read_video( segment_job *jobs, int count, int *index, AVFormatContext **ic,
+	AVRational frame_duration, AVStream *out, AVPacket *pkt )
+{
+	while ( *index < count )
+	{
+		if ( !*ic )
+		{
+			if ( avformat_open_input( ic, jobs[*index].target, NULL, NULL ) < 0
+				|| avformat_find_stream_info( *ic, NULL ) < 0 || (*ic)->nb_streams < 1 )
+				return AVERROR_INVALIDDATA;
+		}
+		AVStream *in = (*ic)->streams[0];
+		if ( av_read_frame( *ic, pkt ) >= 0 )
+		{
+			// Place the first picture of the segment at its position in the timeline
+			int64_t start = in->start_time == AV_NOPTS_VALUE ? 0 : in->start_time;
+			int64_t offset = av_rescale_q( jobs[*index].position, frame_duration, out->time_base )
+				- av_rescale_q( start, in->time_base, out->time_base );
+			av_packet_rescale_ts( pkt, in->time_base, out->time_base );
+			if ( pkt->pts != AV_NOPTS_VALUE )
+				pkt->pts += offset;
+			if ( pkt->dts != AV_NOPTS_VALUE )
+				pkt->dts += offset;
+			pkt->stream_index = out->index;
+			return 0;
+		}
+		avformat_close_input( ic );
+		(*index)++;
+	}
+	return AVERROR_EOF;
+}
+
+/** Check that every video segment has the codec parameters of the first one.
+ *
+ * The joined file has the extradata of the first segment, such as the
+ * sequence and picture parameter sets, so a segment encoded with other
+ * parameters would not decode. Such a segment is not kept for a checkpoint,
+ * so the next run encodes it again.
+ *
+ * \return true if the segments can be joined
+*/
+
+static int segments_match( mlt_consumer consumer, segment_job *jobs, int count, const AVCodecParameters *first )
+{
+	int i;
+
+	for ( i = 1; i < count; i++ )
+	{
+		AVFormatContext *ic = NULL;
+		int match = avformat_open_input( &ic, jobs[i].target, NULL, NULL ) >= 0
+			&& avformat_find_stream_info( ic, NULL ) >= 0 && ic->nb_streams > 0;
+
+		if ( match )
+		{
+			const AVCodecParameters *par = ic->streams[0]->codecpar;
+			match = par->codec_id == first->codec_id && par->format == first->format
+				&& par->width == first->width && par->height == first->height
+				&& par->profile == first->profile && par->level == first->level
+				&& par->extradata_size == first->extradata_size
+				&& ( !par->extradata_size || !memcmp( par->extradata, first->extradata, par->extradata_size ) );
+		}
+		avformat_close_input( &ic );
+		if ( !match )
+		{
+			mlt_log_error( MLT_CONSUMER_SERVICE( consumer ), "segment %s was encoded with other parameters than the first and cannot be joined\n",
+				jobs[i].target );
+			jobs[i].done = -1;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/** Concatenate the video segments and the audio into the target without encoding again.
+*/
+
+static int segments_mux( mlt_consumer consumer, segment_job *jobs, int count, segment_job *audio )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+	mlt_profile profile = mlt_service_profile( MLT_CONSUMER_SERVICE( consumer ) );
+	const char *filename = mlt_properties_get( properties, "target" );
+	const char *format = mlt_properties_get( properties, "f" );
+	AVRational frame_duration = { profile->frame_rate_den, profile->frame_rate_num };
+	AVFormatContext *oc = NULL, *vic = NULL, *aic = NULL;
+	AVStream *video_st = NULL;
+	AVStream *audio_st[ MAX_AUDIO_STREAMS ] = { NULL };
+	AVPacket *vpkt = av_packet_alloc();
+	AVPacket *apkt = av_packet_alloc();
+	int64_t last_dts = AV_NOPTS_VALUE;
+	int i, index = 0, have_video, have_audio = 0, error = 0;
+
+	if ( avformat_alloc_output_context2( &oc, NULL, format, filename ) < 0 || !vpkt || !apkt )
+	{
+		error = 1;
+		goto done;
+	}
+
+	// Copy the streams from the first video segment and the audio file
+	if ( avformat_open_input( &vic, jobs[0].target, NULL, NULL ) < 0 || avformat_find_stream_info( vic, NULL ) < 0
+		|| !segments_match( consumer, jobs, count, vic->streams[0]->codecpar ) )
+	{
+		error = 1;
+		goto done;
+	}
+	video_st = avformat_new_stream( oc, NULL );
+	avcodec_parameters_copy( video_st->codecpar, vic->streams[0]->codecpar );
+	video_st->codecpar->codec_tag = 0;
+	video_st->time_base = frame_duration;
+	video_st->avg_frame_rate = av_inv_q( frame_duration );
+	video_st->sample_aspect_ratio = vic->streams[0]->sample_aspect_ratio;
+	if ( audio )
+	{
+		if ( avformat_open_input( &aic, audio->target, NULL, NULL ) < 0 || avformat_find_stream_info( aic, NULL ) < 0 )
+		{
+			error = 1;
+			goto done;
+		}
+		for ( i = 0; i < aic->nb_streams && i < MAX_AUDIO_STREAMS; i++ )
+		{
+			audio_st[i] = avformat_new_stream( oc, NULL );
+			avcodec_parameters_copy( audio_st[i]->codecpar, aic->streams[i]->codecpar );
+			audio_st[i]->codecpar->codec_tag = 0;
+			audio_st[i]->time_base = aic->streams[i]->time_base;
+		}
+	}
+
+	apply_properties( oc, properties, AV_OPT_FLAG_ENCODING_PARAM );
+	if ( oc->oformat->priv_class && oc->priv_data )
+		apply_properties( oc->priv_data, properties, AV_OPT_FLAG_ENCODING_PARAM );
+	if ( !( oc->oformat->flags & AVFMT_NOFILE ) && avio_open( &oc->pb, filename, AVIO_FLAG_WRITE ) < 0 )
+	{
+		mlt_log_error( MLT_CONSUMER_SERVICE( consumer ), "Could not open '%s'\n", filename );
+		error = 1;
+		goto done;
+	}
+	if ( avformat_write_header( oc, NULL ) < 0 )
+	{
+		error = 1;
+		goto done;
+	}
+
+	// Interleave the packets in the order of their decoding times
+	have_video = !segment_read_video( jobs, count, &index, &vic, frame_duration, video_st, vpkt );
+	while ( aic && !have_audio )
+	{
+		if ( av_read_frame( aic, apkt ) < 0 )
+			break;
+		if ( apkt->stream_index < MAX_AUDIO_STREAMS && audio_st[ apkt->stream_index ] )
+			have_audio = 1;
+		else
+			av_packet_unref( apkt );
+	}
+	while ( !error && ( have_video || have_audio ) && mlt_properties_get_int( properties, "running" ) )
+	{
+		int video_first = have_video;
+
+		if ( have_video && have_audio )
+		{
+			AVStream *in = aic->streams[ apkt->stream_index ];
+			video_first = av_compare_ts( vpkt->dts, video_st->time_base, apkt->dts, in->time_base ) <= 0;
+		}
+		if ( video_first )
+		{
+			// The decoding delay of the next segment may reach back before the end of the previous one
+			if ( vpkt->dts != AV_NOPTS_VALUE && last_dts != AV_NOPTS_VALUE && vpkt->dts <= last_dts )
+				vpkt->dts = last_dts + 1;
+			if ( vpkt->pts != AV_NOPTS_VALUE && vpkt->dts != AV_NOPTS_VALUE && vpkt->pts < vpkt->dts )
+				vpkt->pts = vpkt->dts;
+			last_dts = vpkt->dts;
+			error = av_interleaved_write_frame( oc, vpkt ) < 0;
+			have_video = !segment_read_video( jobs, count, &index, &vic, frame_duration, video_st, vpkt );
+		}
+		else
+		{
+			AVStream *in = aic->streams[ apkt->stream_index ];
+			AVStream *out = audio_st[ apkt->stream_index ];
+			av_packet_rescale_ts( apkt, in->time_base, out->time_base );
+			apkt->stream_index = out->index;
+			error = av_interleaved_write_frame( oc, apkt ) < 0;
+			have_audio = 0;
+			while ( !have_audio && av_read_frame( aic, apkt ) >= 0 )
+			{
+				if ( apkt->stream_index < MAX_AUDIO_STREAMS && audio_st[ apkt->stream_index ] )
+					have_audio = 1;
+				else
+					av_packet_unref( apkt );
+			}
+		}
+	}
+	if ( !error )
+		error = av_write_trailer( oc ) < 0;
+
+done:
+	av_packet_free( &vpkt );
+	av_packet_free( &apkt );
+	avformat_close_input( &vic );
+	avformat_close_input( &aic );
+	if ( oc )
+	{
+		if ( oc->pb && !( oc->oformat->flags & AVFMT_NOFILE ) )
+			avio_closep( &oc->pb );
+		avformat_free_context( oc );
+	}
+	return error;
+}
+
+/** Copy the producer graph of the consumer as XML.
+ *
+ * \param in receives the in point of the producer
+ * \param length receives the number of frames to export
+ * \return the XML, which the caller frees, or NULL
+ */
+
+static char *segments_copy_graph( mlt_consumer consumer, int *in, int *length )
+{
+	mlt_service service = mlt_service_producer( MLT_CONSUMER_SERVICE( consumer ) );
+	mlt_consumer xml_consumer = mlt_factory_consumer( mlt_service_profile( MLT_CONSUMER_SERVICE( consumer ) ), "xml", "string" );
+	char *xml = NULL;
+
+	*in = *length = 0;
+	if ( xml_consumer && service )
+	{
+		mlt_consumer_connect( xml_consumer, service );
+		mlt_consumer_start( xml_consumer );
+		if ( mlt_properties_get( MLT_CONSUMER_PROPERTIES( xml_consumer ), "string" ) )
+			xml = strdup( mlt_properties_get( MLT_CONSUMER_PROPERTIES( xml_consumer ), "string" ) );
+	}
+	mlt_consumer_close( xml_consumer );
+	if ( service && mlt_service_identify( service ) != mlt_service_consumer_type )
+	{
+		*in = mlt_producer_get_in( MLT_PRODUCER( service ) );
+		*length = mlt_producer_get_playtime( MLT_PRODUCER( service ) );
+	}
+	if ( xml && *length <= 0 )
+	{
+		free( xml );
+		xml = NULL;
+	}
+	if ( !xml )
+		mlt_log_error( MLT_CONSUMER_SERVICE( consumer ), "failed to copy the producer for the segments\n" );
+	return xml;
+}
+
+/** Copy the video packets of a source between two keyframes into the file of a segment.
+*/
+
+static int segment_copy( mlt_consumer consumer, segment_job *job )
+{
+	mlt_profile profile = mlt_service_profile( MLT_CONSUMER_SERVICE( consumer ) );
+	AVRational frame_duration = { profile->frame_rate_den, profile->frame_rate_num };
+	AVFormatContext *ic = NULL, *oc = NULL;
+	AVPacket *pkt = av_packet_alloc();
+	int error = 1;
+
+	job->started = 1;
+	if ( !pkt || avformat_open_input( &ic, job->source, NULL, NULL ) < 0 || avformat_find_stream_info( ic, NULL ) < 0
+		|| avformat_alloc_output_context2( &oc, NULL, "matroska", job->target ) < 0 )
+		goto done;
+
+	AVStream *in = ic->streams[ job->video_index ];
+	AVStream *out = avformat_new_stream( oc, NULL );
+	int64_t start = in->start_time == AV_NOPTS_VALUE ? 0 : in->start_time;
+	int copying = 0;
+
+	avcodec_parameters_copy( out->codecpar, in->codecpar );
+	out->codecpar->codec_tag = 0;
+	out->time_base = in->time_base;
+	if ( avio_open( &oc->pb, job->target, AVIO_FLAG_WRITE ) < 0 || avformat_write_header( oc, NULL ) < 0 )
+		goto done;
+	av_seek_frame( ic, job->video_index, start + av_rescale_q( job->copy_in, frame_duration, in->time_base ), AVSEEK_FLAG_BACKWARD );
+
+	// Packets are in decoding order, so a closed GOP ends where the next keyframe begins
+	error = 0;
+	while ( !error && av_read_frame( ic, pkt ) >= 0 )
+	{
+		if ( pkt->stream_index == job->video_index )
+		{
+			if ( ( pkt->flags & AV_PKT_FLAG_KEY ) && pkt->pts != AV_NOPTS_VALUE )
+			{
+				int frame = av_rescale_q( pkt->pts - start, in->time_base, frame_duration );
+				if ( frame >= job->copy_out )
+				{
+					av_packet_unref( pkt );
+					break;
+				}
+				copying |= frame >= job->copy_in;
+			}
+			if ( copying )
+			{
+				pkt->stream_index = out->index;
+				av_packet_rescale_ts( pkt, in->time_base, out->time_base );
+				error = av_interleaved_write_frame( oc, pkt ) < 0;
+			}
+		}
+		av_packet_unref( pkt );
+	}
+	if ( !error )
+		error = av_write_trailer( oc ) < 0;
+
+done:
+	av_packet_free( &pkt );
+	avformat_close_input( &ic );
+	if ( oc )
+	{
+		avio_closep( &oc->pb );
+		avformat_free_context( oc );
+	}
+	if ( error )
+		mlt_log_error( MLT_CONSUMER_SERVICE( consumer ), "failed to copy the packets of %s\n", job->source );
+	return error;
+}
+
+/** Determine if the file of a segment was completely written.
+ *
+ * Matroska only has the duration once the trailer is written, so a segment
+ * which was interrupted has none. As a file cut short after its last cluster
+ * can still carry the duration, the end of its last packet must also reach it.
+ * Half a frame is allowed for the millisecond timestamps of Matroska.
+ */
+
+static int segment_complete( mlt_consumer consumer, segment_job *job )
+{
+	mlt_profile profile = mlt_service_profile( MLT_CONSUMER_SERVICE( consumer ) );
+	AVRational frame_duration = { profile->frame_rate_den, profile->frame_rate_num };
+	AVRational half_frame = { profile->frame_rate_den, 2 * profile->frame_rate_num };
+	int64_t expected = av_rescale_q( job->out - job->in + 1, frame_duration, AV_TIME_BASE_Q )
+		- av_rescale_q( 1, half_frame, AV_TIME_BASE_Q );
+	AVFormatContext *ic = NULL;
+	AVPacket *pkt;
+	int64_t start, end = AV_NOPTS_VALUE;
+
+	if ( !job->target || avformat_open_input( &ic, job->target, NULL, NULL ) < 0 )
+		return 0;
+	if ( ic->duration == AV_NOPTS_VALUE || ic->duration < expected )
+	{
+		avformat_close_input( &ic );
+		return 0;
+	}
+
+	// Read the packets from a keyframe a little before the end
+	start = ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0;
+	av_seek_frame( ic, -1, start + FFMAX( expected - AV_TIME_BASE, 0 ), AVSEEK_FLAG_BACKWARD );
+	pkt = av_packet_alloc();
+	while ( av_read_frame( ic, pkt ) >= 0 )
+	{
+		int64_t pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+
+		if ( pts != AV_NOPTS_VALUE )
+		{
+			pts = av_rescale_q( pts + pkt->duration, ic->streams[ pkt->stream_index ]->time_base, AV_TIME_BASE_Q ) - start;
+			if ( end == AV_NOPTS_VALUE || pts > end )
+				end = pts;
+		}
+		av_packet_unref( pkt );
+	}
+	av_packet_free( &pkt );
+	avformat_close_input( &ic );
+	return end != AV_NOPTS_VALUE && end >= expected;
+}
+
+/** Compute the key of a checkpoint from the producer graph, the settings and the segment length.
+ *
+ * A checkpoint is only resumed by a run which has the same key, so that
+ * segments of another project or encoding are never joined. The media files
+ * the graph refers to are not part of the key, so they must not change.
+ */
+
+static uint64_t checkpoint_key( mlt_consumer consumer, const char *xml, int size )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+	uint64_t hash = 14695981039346656037ULL;
+	char buffer[32];
+	const char *s;
+	int i, count = mlt_properties_count( properties );
+
+	// FNV-1a
+	for ( s = xml; *s; s++ )
+		hash = ( hash ^ (uint8_t) *s ) * 1099511628211ULL;
+	snprintf( buffer, sizeof( buffer ), "%d", size );
+	for ( s = buffer; *s; s++ )
+		hash = ( hash ^ (uint8_t) *s ) * 1099511628211ULL;
+	for ( i = 0; i < count; i++ )
+	{
+		const char *name = mlt_properties_get_name( properties, i );
+		const char *value = mlt_properties_get_value( properties, i );
+
+		if ( !name || !value || segment_skipped( name ) )
+			continue;
+		for ( s = name; *s; s++ )
+			hash = ( hash ^ (uint8_t) *s ) * 1099511628211ULL;
+		hash = ( hash ^ '=' ) * 1099511628211ULL;
+		for ( s = value; *s; s++ )
+			hash = ( hash ^ (uint8_t) *s ) * 1099511628211ULL;
+		hash = ( hash ^ '\n' ) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+/** Mark the segments which a previous run with the same key completed as done.
+ *
+ * \return the number of segments which need not be encoded again
+ */
+
+static int checkpoint_load( mlt_consumer consumer, const char *path, uint64_t key, segment_job *jobs, int count )
+{
+	FILE *file = fopen( path, "r" );
+	unsigned long long saved = 0;
+	int i, index, done = 0;
+
+	if ( !file )
+		return 0;
+	if ( fscanf( file, "key %llx\n", &saved ) == 1 && saved == key )
+	{
+		while ( fscanf( file, "done %d\n", &index ) == 1 )
+			if ( index >= 0 && index < count )
+				jobs[ index ].done = 1;
+	}
+	else
+	{
+		mlt_log_warning( MLT_CONSUMER_SERVICE( consumer ), "ignoring the checkpoint of another export in %s\n", path );
+	}
+	fclose( file );
+
+	// Trust the files rather than the list
+	for ( i = 0; i < count; i++ )
+	{
+		if ( jobs[i].done && segment_complete( consumer, &jobs[i] ) )
+		{
+			jobs[i].started = 1;
+			done++;
+		}
+		else
+		{
+			jobs[i].done = 0;
+		}
+	}
+	return done;
+}
+
+/** Write the list of completed segments, replacing the previous one in one step.
+ *
+ * It is not synced to the disk, because each segment it lists is checked
+ * again when it is loaded, so a list lost in a crash only costs encoding
+ * the segments again.
+ */
+
+static void checkpoint_save( mlt_consumer consumer, const char *path, uint64_t key, segment_job *jobs, int count )
+{
+	char *temp = malloc( strlen( path ) + 5 );
+	FILE *file;
+	int i, error;
+
+	sprintf( temp, "%s.tmp", path );
+	file = fopen( temp, "w" );
+	error = !file;
+	if ( file )
+	{
+		fprintf( file, "key %016llx\n", (unsigned long long) key );
+		for ( i = 0; i < count; i++ )
+			if ( jobs[i].done == 1 )
+				fprintf( file, "done %d\n", i );
+		error = fclose( file );
+	}
+	if ( error || rename( temp, path ) )
+	{
+		mlt_log_warning( MLT_CONSUMER_SERVICE( consumer ), "failed to write the checkpoint %s\n", path );
+		remove( temp );
+	}
+	free( temp );
+}
+
+/** Run the jobs of the segments, encoding up to a number of them at the same time.
+ *
+ * With a checkpoint file each segment which completes is added to it.
+ */
+
+static int segments_run( mlt_consumer consumer, const char *xml, segment_job *jobs, int count, int parallel,
+	const char *checkpoint, uint64_t key )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+	int i, error = 0;
+
+	while ( !error && mlt_properties_get_int( properties, "running" ) )
+	{
+		int busy = 0, waiting = 0;
+
+		for ( i = 0; i < count; i++ )
+		{
+			if ( jobs[i].consumer && !mlt_consumer_is_stopped( jobs[i].consumer ) )
+			{
+				busy++;
+			}
+			else if ( checkpoint && jobs[i].consumer && !jobs[i].done && !error )
+			{
+				jobs[i].done = segment_complete( consumer, &jobs[i] ) ? 1 : -1;
+				if ( jobs[i].done == 1 )
+					checkpoint_save( consumer, checkpoint, key, jobs, count );
+				else
+					mlt_log_error( MLT_CONSUMER_SERVICE( consumer ), "segment %s is incomplete\n", jobs[i].target );
+				error = jobs[i].done != 1;
+			}
+		}
+		for ( i = 0; i < count && !error; i++ )
+		{
+			if ( jobs[i].started )
+				continue;
+			if ( jobs[i].source )
+			{
+				// Copying is only bound by the disk, so do it while the encoders run
+				error = segment_copy( consumer, &jobs[i] );
+			}
+			else if ( busy < parallel )
+			{
+				error = segment_start( consumer, &jobs[i], xml );
+				busy++;
+			}
+			else
+			{
+				waiting++;
+			}
+		}
+		if ( !busy && !waiting )
+			break;
+		usleep( 100000 );
+	}
+	for ( i = 0; i < count; i++ )
+		if ( jobs[i].consumer )
+			mlt_consumer_stop( jobs[i].consumer );
+
+	return error || !mlt_properties_get_int( properties, "running" );
+}
+
+/** Concatenate the finished segments, clean up and report the result.
+ *
+ * When the export with a checkpoint file fails or is stopped, the completed
+ * segments and the checkpoint file are kept for the next run.
+ */
+
+static void segments_finish( mlt_consumer consumer, segment_job *jobs, int count, segment_job *audio, int error,
+	const char *checkpoint )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+	int i;
+
+	if ( !error && mlt_properties_get_int( properties, "running" ) )
+		error = segments_mux( consumer, jobs, count, audio );
+	if ( error && mlt_properties_get_int( properties, "running" ) )
+		mlt_events_fire( properties, "consumer-fatal-error", mlt_event_data_none() );
+	error = error || !mlt_properties_get_int( properties, "running" );
+	for ( i = 0; jobs && i < count; i++ )
+		segment_close( &jobs[i], checkpoint && error && jobs[i].done == 1 );
+	if ( audio )
+		segment_close( audio, checkpoint && error && audio->done == 1 );
+	if ( checkpoint && error )
+		mlt_log_info( MLT_CONSUMER_SERVICE( consumer ), "keeping the completed segments for %s\n", checkpoint );
+	else if ( checkpoint )
+		remove( checkpoint );
+	mlt_consumer_stopped( consumer );
+}
+
+/** Make the name of the file of a segment, or of the checkpoint with a negative index.
+*/
+
+static char *segment_target( const char *target, int index )
+{
+	char *path = malloc( strlen( target ) + 20 );
+	if ( index < 0 )
+		sprintf( path, "%s.checkpoint", target );
+	else
+		sprintf( path, "%s.%d.mkv", target, index );
+	return path;
+}
+
+/** The segmented export thread.
+ *
+ * The producer graph is copied through XML once for each segment of the
+ * timeline, which is a whole number of GOPs long so that every segment starts
+ * on a keyframe. The segments are encoded without audio by their own avformat
+ * consumers at the same time, and the audio of the whole timeline is encoded
+ * once alongside them so that its priming and frame boundaries are the same as
+ * in a normal export. The results are concatenated into the target at the end.
+ *
+ * With join_segments the segments were encoded elsewhere, such as by the
+ * workers of melt -farm, and are only concatenated.
+ *
+ * With checkpoint the segments are short and a file next to the target lists
+ * those which are complete, so that a run of the same export after a failure
+ * only encodes the rest.
+ */
+
+static void *segments_thread( void *arg )
+{
+	mlt_consumer consumer = arg;
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+	const char *target = mlt_properties_get( properties, "target" );
+	const char *acodec = mlt_properties_get( properties, "acodec" );
+	int count = mlt_properties_get_int( properties, "segments" );
+	int gop = mlt_properties_get_int( properties, "g" ) > 0 ? mlt_properties_get_int( properties, "g" ) : 12;
+	int audio = !mlt_properties_get_int( properties, "an" ) && !( acodec && !strcmp( acodec, "none" ) );
+	int join = mlt_properties_get_int( properties, "join_segments" );
+	int parallel = count > 1 ? count : 1;
+	char *checkpoint = !join && mlt_properties_get_int( properties, "checkpoint" ) ? segment_target( target, -1 ) : NULL;
+	uint64_t key = 0;
+	segment_job *jobs = NULL;
+	int i, in, length, size, error = 1;
+	char *xml = join ? NULL : segments_copy_graph( consumer, &in, &length );
+
+	if ( join )
+	{
+		size = mlt_properties_get_int( properties, "segment_size" );
+		if ( count > 0 && size > 0 )
+		{
+			jobs = calloc( count + 1, sizeof( *jobs ) );
+			for ( i = 0; i < count; i++ )
+			{
+				jobs[i].target = segment_target( target, i );
+				jobs[i].position = i * size;
+			}
+			// The audio is optional, as the segments may have been encoded without it
+			jobs[count].target = segment_target( target, count );
+			audio = !access( jobs[count].target, R_OK );
+			if ( !audio )
+			{
+				free( jobs[count].target );
+				jobs[count].target = NULL;
+			}
+			error = 0;
+		}
+		else
+		{
+			mlt_log_error( MLT_CONSUMER_SERVICE( consumer ), "join_segments needs segments and segment_size\n" );
+		}
+	}
+	else if ( xml )
+	{
+		if ( checkpoint )
+		{
+			// Short segments lose little work, one minute unless told otherwise
+			mlt_profile profile = mlt_service_profile( MLT_CONSUMER_SERVICE( consumer ) );
+			size = mlt_properties_get_int( properties, "segment_size" );
+			if ( size <= 0 )
+				size = mlt_profile_fps( profile ) * 60 + 0.5;
+		}
+		else
+		{
+			size = ( length + count - 1 ) / count;
+		}
+		// Round the segments up to whole GOPs
+		size = ( size + gop - 1 ) / gop * gop;
+		count = ( length + size - 1 ) / size;
+		parallel = FFMIN( parallel, count );
+		jobs = calloc( count + 1, sizeof( *jobs ) );
+		mlt_log_info( MLT_CONSUMER_SERVICE( consumer ), "encoding %d segments of %d frames\n", count, size );
+
+		for ( i = 0; i < count + audio; i++ )
+		{
+			segment_job *job = &jobs[i];
+			int video = i < count;
+
+			job->target = segment_target( target, i );
+			job->position = video ? i * size : 0;
+			job->in = in + job->position;
+			job->out = video ? in + FFMIN( job->position + size, length ) - 1 : in + length - 1;
+			job->disable = video ? "an" : "vn";
+		}
+		if ( checkpoint )
+		{
+			key = checkpoint_key( consumer, xml, size );
+			i = checkpoint_load( consumer, checkpoint, key, jobs, count + audio );
+			if ( i > 0 )
+				mlt_log_info( MLT_CONSUMER_SERVICE( consumer ), "resuming from %s with %d segments done\n", checkpoint, i );
+		}
+		error = segments_run( consumer, xml, jobs, count + audio, parallel + audio, checkpoint, key );
+	}
+	segments_finish( consumer, jobs, count, audio && jobs ? &jobs[count] : NULL, error, checkpoint );
+	free( checkpoint );
+	free( jobs );
+	free( xml );
+
+	return NULL;
+}
+
+/** Determine if a service has filters other than those the loader attached.
+*/
+
+static int smart_render_filtered( mlt_service service )
+{
+	mlt_filter filter;
+	int i;
+
+	for ( i = 0; ( filter = mlt_service_filter( service, i ) ); i++ )
+		if ( !mlt_properties_get_int( MLT_FILTER_PROPERTIES( filter ), "_loader" ) )
+			return 1;
+	return 0;
+}
+
+/** Find the playlist of a cuts-only edit.
+ *
+ * That is the service itself or the only track of a tractor without
+ * transitions or filters.
+ */
+
+static mlt_playlist smart_render_playlist( mlt_service service )
+{
+	if ( !service || smart_render_filtered( service ) )
+		return NULL;
+	if ( mlt_service_identify( service ) == mlt_service_playlist_type )
+		return MLT_PLAYLIST( service );
+	if ( mlt_service_identify( service ) == mlt_service_tractor_type )
+	{
+		mlt_multitrack multitrack = mlt_tractor_multitrack( MLT_TRACTOR( service ) );
+
+		// Transitions and filters of the tractor are planted between it and the multitrack
+		if ( multitrack && mlt_multitrack_count( multitrack ) == 1
+			&& mlt_service_producer( service ) == MLT_MULTITRACK_SERVICE( multitrack ) )
+			return smart_render_playlist( MLT_PRODUCER_SERVICE( mlt_multitrack_track( multitrack, 0 ) ) );
+	}
+	return NULL;
+}
+
+/** Determine if the encoder of the consumer makes packets like those of a video stream.
+ */
+
+static int smart_render_compatible( mlt_consumer consumer, AVFormatContext *ic, AVStream *st )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+	mlt_profile profile = mlt_service_profile( MLT_CONSUMER_SERVICE( consumer ) );
+	const char *vcodec = mlt_properties_get( properties, "vcodec" );
+	const char *pix_fmt = mlt_properties_get( properties, "pix_fmt" );
+	AVRational frame_rate = av_guess_frame_rate( ic, st, NULL );
+	AVCodec *codec = NULL;
+
+	if ( vcodec )
+	{
+		codec = avcodec_find_encoder_by_name( vcodec );
+	}
+	else
+	{
+		AVOutputFormat *fmt = av_guess_format( mlt_properties_get( properties, "f" ), mlt_properties_get( properties, "target" ), NULL );
+		if ( fmt )
+			codec = avcodec_find_encoder( fmt->video_codec );
+	}
+	if ( !codec || codec->id != st->codecpar->codec_id )
+		return 0;
+	if ( st->codecpar->width != mlt_properties_get_int( properties, "width" )
+		|| st->codecpar->height != mlt_properties_get_int( properties, "height" ) )
+		return 0;
+	if ( frame_rate.num * profile->frame_rate_den != frame_rate.den * profile->frame_rate_num )
+		return 0;
+	if ( pix_fmt ? av_get_pix_fmt( pix_fmt ) != st->codecpar->format
+		: codec->pix_fmts && codec->pix_fmts[0] != st->codecpar->format )
+		return 0;
+	// The normalizers would deinterlace it
+	if ( mlt_properties_get_int( properties, "progressive" ) && st->codecpar->field_order > AV_FIELD_PROGRESSIVE )
+		return 0;
+	return 1;
+}
+
+/** Find the keyframes of a clip that can be copied.
+ *
+ * \param copy_in receives the first keyframe at or after in
+ * \param copy_out receives the last keyframe at or before out + 1, or the end
+ * \return the index of the video stream or -1 if nothing can be copied
+ */
+
+static int smart_render_keyframes( mlt_consumer consumer, const char *path, int video_index,
+	int in, int out, int *copy_in, int *copy_out )
+{
+	mlt_profile profile = mlt_service_profile( MLT_CONSUMER_SERVICE( consumer ) );
+	AVRational frame_duration = { profile->frame_rate_den, profile->frame_rate_num };
+	AVFormatContext *ic = NULL;
+	AVPacket *pkt = av_packet_alloc();
+	int index = -1, last = -1;
+
+	*copy_in = *copy_out = -1;
+	if ( !pkt || avformat_open_input( &ic, path, NULL, NULL ) < 0 || avformat_find_stream_info( ic, NULL ) < 0 )
+		goto done;
+	if ( video_index < 0 || video_index >= ic->nb_streams
+		|| ic->streams[ video_index ]->codecpar->codec_type != AVMEDIA_TYPE_VIDEO )
+		video_index = av_find_best_stream( ic, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0 );
+	if ( video_index < 0 || !smart_render_compatible( consumer, ic, ic->streams[ video_index ] ) )
+		goto done;
+
+	AVStream *st = ic->streams[ video_index ];
+	int64_t start = st->start_time == AV_NOPTS_VALUE ? 0 : st->start_time;
+	int eof = 1;
+
+	av_seek_frame( ic, video_index, start + av_rescale_q( in, frame_duration, st->time_base ), AVSEEK_FLAG_BACKWARD );
+	while ( av_read_frame( ic, pkt ) >= 0 )
+	{
+		if ( pkt->stream_index == video_index && pkt->pts != AV_NOPTS_VALUE )
+		{
+			int frame = av_rescale_q( pkt->pts - start, st->time_base, frame_duration );
+			last = FFMAX( last, frame );
+			if ( pkt->flags & AV_PKT_FLAG_KEY )
+			{
+				if ( frame >= in && *copy_in < 0 )
+					*copy_in = frame;
+				if ( frame <= out + 1 && frame >= in )
+					*copy_out = frame;
+				if ( frame > out + 1 )
+				{
+					eof = 0;
+					av_packet_unref( pkt );
+					break;
+				}
+			}
+		}
+		av_packet_unref( pkt );
+	}
+	// The end of the file ends the last GOP too
+	if ( eof && last <= out )
+		*copy_out = last + 1;
+	if ( *copy_in >= 0 && *copy_out > *copy_in )
+		index = video_index;
+
+done:
+	av_packet_free( &pkt );
+	avformat_close_input( &ic );
+	return index;
+}
+
+static segment_job *smart_render_add( segment_job **jobs, int *count, const char *target )
+{
+	*jobs = realloc( *jobs, ( *count + 1 ) * sizeof( **jobs ) );
+	segment_job *job = &( *jobs )[ *count ];
+	memset( job, 0, sizeof( *job ) );
+	job->target = segment_target( target, *count );
+	job->disable = "an";
+	( *count )++;
+	return job;
+}
+
+/** The smart rendering export thread.
+ *
+ * For a cuts-only edit, the clips which are avformat producers without
+ * filters and whose video has the codec, size, frame rate and pixel format of
+ * the output are copied a GOP at a time without decoding. Only the frames
+ * before the first keyframe and after the last one of each clip and the parts
+ * of the timeline that are not such clips are encoded, as segments on their
+ * own copies of the producer graph. The audio is encoded for the whole
+ * timeline as in the segmented export, and everything is concatenated at the
+ * end. Everything is encoded when the timeline is not a cuts-only edit.
+ */
+
+static void *smart_render_thread( void *arg )
+{
+	mlt_consumer consumer = arg;
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+	mlt_service service = mlt_service_producer( MLT_CONSUMER_SERVICE( consumer ) );
+	const char *target = mlt_properties_get( properties, "target" );
+	const char *acodec = mlt_properties_get( properties, "acodec" );
+	int audio = !mlt_properties_get_int( properties, "an" ) && !( acodec && !strcmp( acodec, "none" ) );
+	int parallel = mlt_properties_get_int( properties, "segments" ) > 0 ? mlt_properties_get_int( properties, "segments" ) : 2;
+	mlt_playlist playlist = smart_render_playlist( service );
+	segment_job *jobs = NULL;
+	int i, in, length, count = 0, copied = 0, error = 1;
+	int encode_from = 0;
+	char *xml = segments_copy_graph( consumer, &in, &length );
+
+	if ( !xml )
+		goto done;
+
+	for ( i = 0; playlist && i < mlt_playlist_count( playlist ); i++ )
+	{
+		mlt_playlist_clip_info info;
+		int copy_in, copy_out, index;
+
+		if ( mlt_playlist_is_blank( playlist, i ) || mlt_playlist_get_clip_info( playlist, &info, i ) || info.repeat > 1 )
+			continue;
+		mlt_properties clip = MLT_PRODUCER_PROPERTIES( info.producer );
+		const char *name = mlt_properties_get( clip, "mlt_service" );
+		const char *resource = mlt_properties_get( clip, "resource" );
+
+		// The clip must be all within the export
+		if ( info.start < in || info.start + info.frame_count > in + length
+			|| !name || strncmp( name, "avformat", 8 ) || !resource
+			|| smart_render_filtered( MLT_PRODUCER_SERVICE( info.producer ) )
+			|| smart_render_filtered( MLT_PRODUCER_SERVICE( info.cut ) ) )
+			continue;
+		index = smart_render_keyframes( consumer, resource, mlt_properties_get_int( clip, "video_index" ),
+			info.frame_in, info.frame_out, &copy_in, &copy_out );
+		if ( index < 0 )
+			continue;
+
+		// Encode what comes before the copy
+		int position = info.start - in + copy_in - info.frame_in;
+		if ( position > encode_from )
+		{
+			segment_job *job = smart_render_add( &jobs, &count, target );
+			job->position = encode_from;
+			job->in = in + encode_from;
+			job->out = in + position - 1;
+		}
+		segment_job *job = smart_render_add( &jobs, &count, target );
+		job->position = position;
+		job->source = strdup( resource );
+		job->video_index = index;
+		job->copy_in = copy_in;
+		job->copy_out = copy_out;
+		encode_from = position + copy_out - copy_in;
+		copied += copy_out - copy_in;
+	}
+	if ( encode_from < length )
+	{
+		segment_job *job = smart_render_add( &jobs, &count, target );
+		job->position = encode_from;
+		job->in = in + encode_from;
+		job->out = in + length - 1;
+	}
+	mlt_log_info( MLT_CONSUMER_SERVICE( consumer ), "copying %d of %d frames in %d segments\n", copied, length, count );
+	if ( audio )
+	{
+		// This one is after the video segments and not counted with them
+		segment_job *job = smart_render_add( &jobs, &count, target );
+		job->in = in;
+		job->out = in + length - 1;
+		job->disable = "vn";
+		count--;
+	}
+	error = segments_run( consumer, xml, jobs, count + audio, parallel + audio, NULL, 0 );
+
+done:
+	segments_finish( consumer, jobs, count, audio && jobs ? &jobs[count] : NULL, error, NULL );
+	free( jobs );
+	free( xml );
+
+	return NULL;
+}
+
 /** Close the consumer.
 */
 
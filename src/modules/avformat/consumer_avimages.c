@@ -0,0 +1,523 @@
+/*
+ * consumer_avimages.c -- a parallel image sequence writer based on avcodec
+ * Copyright (C) 2024 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "common.h"
+
+// mlt Header files
+#include <framework/mlt_consumer.h>
+#include <framework/mlt_frame.h>
+#include <framework/mlt_deque.h>
+#include <framework/mlt_image.h>
+#include <framework/mlt_log.h>
+#include <framework/mlt_events.h>
+
+// System header files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// avformat header files
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/opt.h>
+#include <libavutil/imgutils.h>
+
+#define MAX_THREADS (64)
+#define IMAGE_ALIGN (4)
+
+/** This classes definition.
+*/
+
+typedef struct consumer_avimages_s *consumer_avimages;
+
+struct consumer_avimages_s
+{
+	struct mlt_consumer_s parent;
+	pthread_t thread;
+	int joined;
+	int running;
+	pthread_t workers[ MAX_THREADS ];
+	int worker_count;
+	AVCodec *codec;
+	enum AVPixelFormat src_fmt;
+	enum AVPixelFormat pix_fmt;
+
+	// The frames to encode, guarded by mutex
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	mlt_deque queue;
+	int in_flight;
+	int done;
+	int error;
+};
+
+/** Forward references to static functions.
+*/
+
+static int consumer_start( mlt_consumer parent );
+static int consumer_stop( mlt_consumer parent );
+static int consumer_is_stopped( mlt_consumer parent );
+static void consumer_close( mlt_consumer parent );
+static void *consumer_thread( void *arg );
+
+/** Initialise the consumer.
+*/
+
+mlt_consumer consumer_avimages_init( mlt_profile profile, char *arg )
+{
+	// Create the consumer object
+	consumer_avimages self = calloc( 1, sizeof( struct consumer_avimages_s ) );
+
+	// If no malloc'd and consumer init ok
+	if ( self != NULL && mlt_consumer_init( &self->parent, self, profile ) == 0 )
+	{
+		mlt_consumer parent = &self->parent;
+		mlt_properties properties = MLT_CONSUMER_PROPERTIES( parent );
+
+		// We have stuff to clean up, so override the close method
+		parent->close = consumer_close;
+
+		// Interpret the argument
+		if ( arg != NULL )
+			mlt_properties_set( properties, "target", arg );
+
+		self->queue = mlt_deque_init( );
+		pthread_mutex_init( &self->mutex, NULL );
+		pthread_cond_init( &self->cond, NULL );
+
+		// Image sequences are usually wanted with alpha
+		mlt_properties_set( properties, "mlt_image_format", "rgba" );
+		mlt_properties_set_int( properties, "start_number", 1 );
+
+		// Ensure termination at end of the stream
+		mlt_properties_set_int( properties, "terminate_on_pause", 1 );
+
+		// Default to separate processing threads for producer and consumer with no frame dropping!
+		mlt_properties_set_int( properties, "real_time", -1 );
+		mlt_properties_set_int( properties, "prefill", 1 );
+
+		// Ensure we don't join on a non-running object
+		self->joined = 1;
+
+		// Allow thread to be started/stopped
+		parent->start = consumer_start;
+		parent->stop = consumer_stop;
+		parent->is_stopped = consumer_is_stopped;
+
+		mlt_events_register( properties, "consumer-fatal-error" );
+
+		// Return the consumer produced
+		return parent;
+	}
+
+	// malloc or consumer init failed
+	free( self );
+
+	// Indicate failure
+	return NULL;
+}
+
+/** Process properties as AVOptions and apply to AV context obj
+*/
+
+static void apply_properties( void *obj, mlt_properties properties, int flags )
+{
+	int i;
+	int count = mlt_properties_count( properties );
+
+	for ( i = 0; i < count; i++ )
+	{
+		const char *opt_name = mlt_properties_get_name( properties, i );
+		int search_flags = AV_OPT_SEARCH_CHILDREN;
+		const AVOption *opt = av_opt_find( obj, opt_name, NULL, flags, search_flags );
+
+		// If option not found, see if it was prefixed with v (-vb)
+		if ( !opt && opt_name[0] == 'v' )
+			opt = av_opt_find( obj, ++opt_name, NULL, flags, search_flags );
+		// Apply option if found
+		if ( opt )
+			av_opt_set( obj, opt_name, mlt_properties_get_value( properties, i), search_flags );
+	}
+}
+
+/** Choose the encoder and pixel formats.
+*/
+
+static int setup_codec( consumer_avimages self )
+{
+	mlt_consumer parent = &self->parent;
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( parent );
+	const char *target = mlt_properties_get( properties, "target" );
+	const char *vcodec = mlt_properties_get( properties, "vcodec" );
+	const char *pix_fmt = mlt_properties_get( properties, "pix_fmt" );
+	char filename[ PATH_MAX ];
+
+	if ( !target || av_get_frame_filename( filename, sizeof( filename ), target, 1 ) < 0 )
+	{
+		mlt_log_error( MLT_CONSUMER_SERVICE( parent ), "the target needs a frame number pattern such as %%05d\n" );
+		return 1;
+	}
+
+	// Get the encoder by name or from the file name extension
+	if ( vcodec )
+	{
+		self->codec = avcodec_find_encoder_by_name( vcodec );
+	}
+	else
+	{
+		AVOutputFormat *fmt = av_guess_format( "image2", target, NULL );
+		enum AVCodecID id = fmt ? av_guess_codec( fmt, NULL, target, NULL, AVMEDIA_TYPE_VIDEO ) : AV_CODEC_ID_NONE;
+		self->codec = id != AV_CODEC_ID_NONE ? avcodec_find_encoder( id ) : NULL;
+	}
+	if ( !self->codec )
+	{
+		mlt_log_error( MLT_CONSUMER_SERVICE( parent ), "no image encoder found for '%s'\n", vcodec ? vcodec : target );
+		return 1;
+	}
+
+	// The source is the image format rendered by the consumer
+	switch ( mlt_image_format_id( mlt_properties_get( properties, "mlt_image_format" ) ) )
+	{
+	case mlt_image_rgb:
+		self->src_fmt = AV_PIX_FMT_RGB24;
+		break;
+	case mlt_image_rgba64:
+		self->src_fmt = AV_PIX_FMT_RGBA64LE;
+		break;
+	default:
+		mlt_properties_set( properties, "mlt_image_format", "rgba" );
+		self->src_fmt = AV_PIX_FMT_RGBA;
+		break;
+	}
+
+	self->pix_fmt = pix_fmt ? av_get_pix_fmt( pix_fmt ) : AV_PIX_FMT_NONE;
+	if ( self->pix_fmt == AV_PIX_FMT_NONE )
+		self->pix_fmt = self->codec->pix_fmts ?
+			avcodec_find_best_pix_fmt_of_list( self->codec->pix_fmts, self->src_fmt, 1, NULL ) : self->src_fmt;
+
+	return 0;
+}
+
+/** Open an encoder for one worker thread.
+*/
+
+static AVCodecContext *open_encoder( consumer_avimages self )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( &self->parent );
+	AVCodecContext *c = avcodec_alloc_context3( self->codec );
+
+	if ( c )
+	{
+		c->width = mlt_properties_get_int( properties, "width" );
+		c->height = mlt_properties_get_int( properties, "height" );
+		c->time_base.num = mlt_properties_get_int( properties, "frame_rate_den" );
+		c->time_base.den = mlt_properties_get_int( properties, "frame_rate_num" );
+		c->sample_aspect_ratio = av_d2q( mlt_properties_get_double( properties, "aspect_ratio" ), 255 );
+		apply_properties( c, properties, AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_ENCODING_PARAM );
+		c->pix_fmt = self->pix_fmt;
+
+		// The frames are encoded in parallel instead
+		c->thread_count = 1;
+
+		if ( avcodec_open2( c, self->codec, NULL ) < 0 )
+		{
+			mlt_log_error( MLT_CONSUMER_SERVICE( &self->parent ), "could not open the %s encoder\n", self->codec->name );
+			avcodec_free_context( &c );
+		}
+	}
+	return c;
+}
+
+/** Convert, encode and write the image of a frame.
+*/
+
+static int encode_frame( consumer_avimages self, AVCodecContext *c, struct SwsContext **context, AVFrame *avframe, mlt_frame frame )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( &self->parent );
+	mlt_properties frame_properties = MLT_FRAME_PROPERTIES( frame );
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get( c->pix_fmt );
+	int colorspace = mlt_properties_get_int( properties, "colorspace" );
+	int full_range = c->color_range == AVCOL_RANGE_JPEG ||
+		( desc && ( ( desc->flags & AV_PIX_FMT_FLAG_RGB ) || !strncmp( desc->name, "yuvj", 4 ) ) );
+	mlt_image_format format = mlt_image_format_id( mlt_properties_get( properties, "mlt_image_format" ) );
+	int width = c->width;
+	int height = c->height;
+	uint8_t *image = NULL;
+	uint8_t *data[4];
+	int linesize[4];
+	char filename[ PATH_MAX ];
+	AVPacket pkt;
+	int error = 0;
+
+	if ( mlt_frame_get_image( frame, &image, &format, &width, &height, 0 ) || !image )
+	{
+		mlt_log_error( MLT_CONSUMER_SERVICE( &self->parent ), "failed to get the image of frame %d\n", mlt_frame_get_position( frame ) );
+		return 1;
+	}
+
+	// Convert to the pixel format of the encoder
+	mlt_image_format_planes( format, width, height, image, data, linesize );
+	*context = sws_getCachedContext( *context, width, height, self->src_fmt, c->width, c->height, c->pix_fmt,
+		mlt_get_sws_flags( width, height, self->src_fmt, c->width, c->height, c->pix_fmt ), NULL, NULL, NULL );
+	if ( !*context || av_frame_make_writable( avframe ) < 0 )
+		return 1;
+	mlt_set_luma_transfer( *context, colorspace, colorspace, 1, full_range );
+	sws_scale( *context, (const uint8_t* const*) data, linesize, 0, height, avframe->data, avframe->linesize );
+	avframe->pts = mlt_frame_get_position( frame );
+
+	// Encode the image
+	av_init_packet( &pkt );
+	pkt.data = NULL;
+	pkt.size = 0;
+#if LIBAVCODEC_VERSION_INT >= ((57<<16)+(37<<8)+0)
+	error = avcodec_send_frame( c, avframe );
+	if ( !error )
+		error = avcodec_receive_packet( c, &pkt );
+#else
+	int got_packet = 0;
+	error = avcodec_encode_video2( c, &pkt, avframe, &got_packet );
+	if ( !error && !got_packet )
+		error = AVERROR(EAGAIN);
+#endif
+	if ( error )
+	{
+		mlt_log_error( MLT_CONSUMER_SERVICE( &self->parent ), "error with video encode: %d (frame %d)\n", error, mlt_frame_get_position( frame ) );
+		return 1;
+	}
+
+	// Write it to its own file
+	av_get_frame_filename( filename, sizeof( filename ), mlt_properties_get( properties, "target" ),
+		mlt_properties_get_int( frame_properties, "_avimages_number" ) );
+	FILE *file = mlt_fopen( filename, "wb" );
+	if ( !file || fwrite( pkt.data, 1, pkt.size, file ) != (size_t) pkt.size )
+		error = 1;
+	if ( file && fclose( file ) )
+		error = 1;
+	if ( error )
+		mlt_log_error( MLT_CONSUMER_SERVICE( &self->parent ), "failed to write '%s'\n", filename );
+	av_packet_unref( &pkt );
+
+	return error;
+}
+
+/** Encode frames from the queue in any order.
+*/
+
+static void *worker_thread( void *arg )
+{
+	consumer_avimages self = arg;
+	AVCodecContext *c = open_encoder( self );
+	AVFrame *avframe = av_frame_alloc();
+	struct SwsContext *context = NULL;
+	int error = !c || !avframe;
+
+	if ( !error )
+	{
+		avframe->format = c->pix_fmt;
+		avframe->width = c->width;
+		avframe->height = c->height;
+		error = av_frame_get_buffer( avframe, IMAGE_ALIGN ) < 0;
+	}
+
+	pthread_mutex_lock( &self->mutex );
+	if ( error )
+		self->error = 1;
+	while ( !self->error )
+	{
+		mlt_frame frame = mlt_deque_pop_front( self->queue );
+		if ( frame )
+		{
+			pthread_mutex_unlock( &self->mutex );
+			error = encode_frame( self, c, &context, avframe, frame );
+			mlt_frame_close( frame );
+			pthread_mutex_lock( &self->mutex );
+			self->in_flight --;
+			if ( error )
+				self->error = 1;
+			pthread_cond_broadcast( &self->cond );
+		}
+		else if ( self->done )
+		{
+			break;
+		}
+		else
+		{
+			pthread_cond_wait( &self->cond, &self->mutex );
+		}
+	}
+	pthread_cond_broadcast( &self->cond );
+	pthread_mutex_unlock( &self->mutex );
+
+	sws_freeContext( context );
+	av_frame_free( &avframe );
+	avcodec_free_context( &c );
+
+	return NULL;
+}
+
+static int consumer_start( mlt_consumer parent )
+{
+	consumer_avimages self = parent->child;
+
+	if ( !self->running )
+	{
+		consumer_stop( parent );
+
+		if ( setup_codec( self ) )
+		{
+			mlt_events_fire( MLT_CONSUMER_PROPERTIES( parent ), "consumer-fatal-error", mlt_event_data_none() );
+			return 1;
+		}
+		self->running = 1;
+		self->joined = 0;
+		pthread_create( &self->thread, NULL, consumer_thread, self );
+	}
+
+	return 0;
+}
+
+static int consumer_stop( mlt_consumer parent )
+{
+	consumer_avimages self = parent->child;
+
+	if ( !self->joined )
+	{
+		// Kill the thread and clean up
+		self->joined = 1;
+		self->running = 0;
+		pthread_join( self->thread, NULL );
+	}
+
+	return 0;
+}
+
+static int consumer_is_stopped( mlt_consumer parent )
+{
+	consumer_avimages self = parent->child;
+	return !self->running;
+}
+
+/** Render frames in order and queue them for the worker threads.
+*/
+
+static void *consumer_thread( void *arg )
+{
+	consumer_avimages self = arg;
+	mlt_consumer consumer = &self->parent;
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+	int terminate_on_pause = mlt_properties_get_int( properties, "terminate_on_pause" );
+	int number = mlt_properties_get_int( properties, "start_number" );
+	int threads = mlt_properties_get_int( properties, "threads" );
+	int limit = mlt_properties_get_int( properties, "in_flight" );
+	int i;
+
+	if ( threads <= 0 )
+		threads = sysconf( _SC_NPROCESSORS_ONLN );
+	threads = CLAMP( threads, 1, MAX_THREADS );
+	if ( limit <= 0 )
+		limit = 2 * threads;
+
+	self->in_flight = 0;
+	self->done = 0;
+	self->error = 0;
+	for ( self->worker_count = 0; self->worker_count < threads; self->worker_count++ )
+		if ( pthread_create( &self->workers[ self->worker_count ], NULL, worker_thread, self ) )
+			break;
+	if ( !self->worker_count )
+		self->error = 1;
+
+	while ( self->running )
+	{
+		mlt_frame frame = mlt_consumer_rt_frame( consumer );
+
+		if ( !frame )
+			continue;
+
+		// Check for the terminated condition
+		if ( terminate_on_pause && mlt_properties_get_double( MLT_FRAME_PROPERTIES( frame ), "_speed" ) == 0.0 )
+		{
+			mlt_frame_close( frame );
+			break;
+		}
+
+		mlt_events_fire( properties, "consumer-frame-show", mlt_event_data_from_frame( frame ) );
+
+		// Wait for room among the frames in flight
+		pthread_mutex_lock( &self->mutex );
+		while ( self->in_flight >= limit && !self->error )
+			pthread_cond_wait( &self->cond, &self->mutex );
+		if ( self->error )
+		{
+			pthread_mutex_unlock( &self->mutex );
+			mlt_frame_close( frame );
+			break;
+		}
+		mlt_properties_set_int( MLT_FRAME_PROPERTIES( frame ), "_avimages_number", number ++ );
+		mlt_deque_push_back( self->queue, frame );
+		self->in_flight ++;
+		pthread_cond_broadcast( &self->cond );
+		pthread_mutex_unlock( &self->mutex );
+	}
+
+	// Let the workers finish the queue
+	pthread_mutex_lock( &self->mutex );
+	self->done = 1;
+	pthread_cond_broadcast( &self->cond );
+	pthread_mutex_unlock( &self->mutex );
+	for ( i = 0; i < self->worker_count; i++ )
+		pthread_join( self->workers[ i ], NULL );
+	while ( mlt_deque_count( self->queue ) )
+		mlt_frame_close( mlt_deque_pop_front( self->queue ) );
+
+	if ( self->error )
+		mlt_events_fire( properties, "consumer-fatal-error", mlt_event_data_none() );
+
+	self->running = 0;
+
+	// Just in case we terminated on pause
+	mlt_consumer_stopped( consumer );
+
+	return NULL;
+}
+
+/** Close the consumer.
+*/
+
+static void consumer_close( mlt_consumer parent )
+{
+	// Get the actual object
+	consumer_avimages self = parent->child;
+
+	// Stop the consumer
+	mlt_consumer_stop( parent );
+
+	// Now clean up the rest
+	mlt_consumer_close( parent );
+
+	mlt_deque_close( self->queue );
+	pthread_mutex_destroy( &self->mutex );
+	pthread_cond_destroy( &self->cond );
+
+	// Finally clean up this
+	free( self );
+}
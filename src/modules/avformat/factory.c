@@ -25,6 +25,7 @@
 #include <framework/mlt.h>
 
 extern mlt_consumer consumer_avformat_init( mlt_profile profile, char *file );
+extern mlt_consumer consumer_avimages_init( mlt_profile profile, char *file );
 extern mlt_filter filter_avcolour_space_init( void *arg );
 extern mlt_filter filter_avdeinterlace_init( void *arg );
 extern mlt_filter filter_swresample_init( mlt_profile profile, char *arg );
@@ -117,6 +118,8 @@ static void *create_service( mlt_profile profile, mlt_service_type type, const c
 		else if ( type == mlt_service_consumer_type )
 			return consumer_avformat_init( profile, arg );
 	}
+	if ( !strcmp( id, "avimages" ) && type == mlt_service_consumer_type )
+		return consumer_avimages_init( profile, arg );
 #endif
 #ifdef FILTERS
 	if ( !strcmp( id, "avcolor_space" ) )
@@ -391,7 +394,7 @@ static mlt_properties avfilter_metadata( mlt_service_type type, const char *id,
 			snprintf( key, 20, "%d", mlt_properties_count( params ) );
 			mlt_properties_set_data( params, key, p, 0, (mlt_destructor) mlt_properties_close, NULL );
 			mlt_properties_set( p, "identifier", "av.threads" );
-			mlt_properties_set( p, "description", "Maximum number of threads" );
+			mlt_properties_set( p, "description", "Maximum number of threads for each filter graph, 0 for one per CPU core" );
 			mlt_properties_set( p, "type", "integer" );
 			mlt_properties_set_int( p, "minimum", 0 );
 			mlt_properties_set_int( p, "default", 0 );
@@ -430,6 +433,8 @@ MLT_REPOSITORY
 	MLT_REGISTER( mlt_service_producer_type, "avformat", create_service );
 	MLT_REGISTER( mlt_service_producer_type, "avformat-novalidate", create_service );
 	MLT_REGISTER_METADATA( mlt_service_consumer_type, "avformat", avformat_metadata, NULL );
+	MLT_REGISTER( mlt_service_consumer_type, "avimages", create_service );
+	MLT_REGISTER_METADATA( mlt_service_consumer_type, "avimages", avformat_metadata, NULL );
 	MLT_REGISTER_METADATA( mlt_service_producer_type, "avformat", avformat_metadata, NULL );
 #endif
 #ifdef FILTERS
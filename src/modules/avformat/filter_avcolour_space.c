@@ -29,9 +29,11 @@
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/hwcontext.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if 0 // This test might come in handy elsewhere someday.
 static int is_big_endian( )
@@ -66,6 +68,18 @@ static int convert_mlt_to_av_cs( mlt_image_format format )
 		case mlt_image_yuv422p16:
 			value = AV_PIX_FMT_YUV422P16LE;
 			break;
+		case mlt_image_yuv420p10:
+			value = AV_PIX_FMT_YUV420P10LE;
+			break;
+		case mlt_image_nv12:
+			value = AV_PIX_FMT_NV12;
+			break;
+		case mlt_image_p010:
+			value = AV_PIX_FMT_P010LE;
+			break;
+		case mlt_image_rgba64:
+			value = AV_PIX_FMT_RGBA64LE;
+			break;
 		default:
 			mlt_log_error( NULL, "[filter avcolor_space] Invalid format %s\n",
 				mlt_image_format_name( format ) );
@@ -75,39 +89,30 @@ static int convert_mlt_to_av_cs( mlt_image_format format )
 	return value;
 }
 
+static void fill_image_arrays( uint8_t *data[4], int stride[4], uint8_t *image, int fmt, int width, int height )
+{
+	if ( fmt == AV_PIX_FMT_YUV422P16LE )
+		mlt_image_format_planes( mlt_image_yuv422p16, width, height, image, data, stride );
+	else
+		av_image_fill_arrays( data, stride, image, fmt, width, height, IMAGE_ALIGN );
+}
+
 // returns set_lumage_transfer result
-static int av_convert_image( uint8_t *out, uint8_t *in, int out_fmt, int in_fmt,
+static int av_convert_image( uint8_t *out, uint8_t *in_data[4], int in_stride[4], int out_fmt, int in_fmt,
 	int out_width, int out_height, int in_width, int in_height,
 	int src_colorspace, int dst_colorspace, int use_full_range )
 {
-	uint8_t *in_data[4];
-	int in_stride[4];
 	uint8_t *out_data[4];
 	int out_stride[4];
 	int flags = mlt_get_sws_flags( in_width, in_height, in_fmt, out_width, out_height, out_fmt);
-	int error = -1;
 
-	if ( in_fmt == AV_PIX_FMT_YUV422P16LE )
-		mlt_image_format_planes(mlt_image_yuv422p16, in_width, in_height, in, in_data, in_stride);
-	else
-		av_image_fill_arrays(in_data, in_stride, in, in_fmt, in_width, in_height, IMAGE_ALIGN);
-	if ( out_fmt == AV_PIX_FMT_YUV422P16LE )
-		mlt_image_format_planes(mlt_image_yuv422p16, out_width, out_height, out, out_data, out_stride);
-	else
-		av_image_fill_arrays(out_data, out_stride, out, out_fmt, out_width, out_height, IMAGE_ALIGN);
-	struct SwsContext *context = sws_getContext( in_width, in_height, in_fmt,
-		out_width, out_height, out_fmt, flags, NULL, NULL, NULL);
-	if ( context )
-	{
-		// libswscale wants the RGB colorspace to be SWS_CS_DEFAULT, which is = SWS_CS_ITU601.
-		if ( out_fmt == AV_PIX_FMT_RGB24 || out_fmt == AV_PIX_FMT_RGBA )
-			dst_colorspace = 601;
-		error = mlt_set_luma_transfer( context, src_colorspace, dst_colorspace, use_full_range, use_full_range );
-		sws_scale(context, (const uint8_t* const*) in_data, in_stride, 0, in_height,
-			out_data, out_stride);
-		sws_freeContext( context );
-	}
-	return error;
+	fill_image_arrays( out_data, out_stride, out, out_fmt, out_width, out_height );
+	// libswscale wants the RGB colorspace to be SWS_CS_DEFAULT, which is = SWS_CS_ITU601.
+	if ( out_fmt == AV_PIX_FMT_RGB24 || out_fmt == AV_PIX_FMT_RGBA || out_fmt == AV_PIX_FMT_RGBA64LE )
+		dst_colorspace = 601;
+	return mlt_sws_scale_sliced( in_data, in_stride, in_width, in_height, in_fmt,
+		out_data, out_stride, out_width, out_height, out_fmt, flags,
+		src_colorspace, dst_colorspace, use_full_range, use_full_range );
 }
 
 /** Do it :-).
@@ -142,7 +147,34 @@ static int convert_image( mlt_frame frame, uint8_t **image, mlt_image_format *fo
 			mlt_image_format_name( *format ), width, height, mlt_image_format_name( output_format ),
 			out_width, out_height, colorspace, profile_colorspace );
 
-		int in_fmt = convert_mlt_to_av_cs( *format );
+		uint8_t *in_data[4];
+		int in_stride[4];
+		int in_width = width;
+		int in_height = height;
+		int in_fmt;
+		AVFrame *sw_frame = NULL;
+
+		if ( *format == mlt_image_hwframe )
+		{
+			// Download the hardware surface and convert from its software format
+			sw_frame = av_frame_alloc();
+			if ( av_hwframe_transfer_data( sw_frame, (AVFrame*) *image, 0 ) < 0 )
+			{
+				mlt_log_error( NULL, "[filter avcolor_space] failed to download the hardware frame\n" );
+				av_frame_free( &sw_frame );
+				return 1;
+			}
+			memcpy( in_data, sw_frame->data, sizeof( in_data ) );
+			memcpy( in_stride, sw_frame->linesize, sizeof( in_stride ) );
+			in_fmt = sw_frame->format;
+			in_width = sw_frame->width;
+			in_height = sw_frame->height;
+		}
+		else
+		{
+			in_fmt = convert_mlt_to_av_cs( *format );
+			fill_image_arrays( in_data, in_stride, *image, in_fmt, width, height );
+		}
 		int out_fmt = convert_mlt_to_av_cs( output_format );
 		int size = FFMAX( av_image_get_buffer_size(out_fmt, out_width, out_height, IMAGE_ALIGN),
 			mlt_image_format_size( output_format, out_width, out_height, NULL ) );
@@ -183,16 +215,20 @@ static int convert_image( mlt_frame frame, uint8_t **image, mlt_image_format *fo
 		}
 
 		// Update the output
-		if ( !av_convert_image( output, *image, out_fmt, in_fmt,
-		                        out_width, out_height, width, height,
+		if ( !av_convert_image( output, in_data, in_stride, out_fmt, in_fmt,
+		                        out_width, out_height, in_width, in_height,
 		                        colorspace, profile_colorspace, force_full_luma ) )
 		{
 			// The new colorspace is only valid if destination is YUV.
 			if ( output_format == mlt_image_yuv422 ||
 				output_format == mlt_image_yuv420p ||
-				output_format == mlt_image_yuv422p16 )
+				output_format == mlt_image_yuv422p16 ||
+				output_format == mlt_image_yuv420p10 ||
+				output_format == mlt_image_nv12 ||
+				output_format == mlt_image_p010 )
 				mlt_properties_set_int( properties, "colorspace", profile_colorspace );
 		}
+		av_frame_free( &sw_frame );
 		*image = output;
 		*format = output_format;
 		mlt_frame_set_image( frame, output, size, mlt_pool_release );
@@ -36,21 +36,37 @@
 #define PARAM_PREFIX_LEN (sizeof(PARAM_PREFIX) - 1)
 #define MLT_SWS_FLAGS "bicubic+accurate_rnd+full_chroma_int+full_chroma_inp"
 
+/** The number of filter graphs kept by each filter, enough for one per worker thread */
+
+#define MAX_GRAPHS 8
+
 typedef struct
 {
-	AVFilter* avfilter;
+	AVFilterGraph* avfilter_graph;
 	AVFilterContext* avbuffsink_ctx;
 	AVFilterContext* avbuffsrc_ctx;
 	AVFilterContext* avfilter_ctx;
 	AVFilterContext* scale_ctx;
 	AVFilterContext* pad_ctx;
-	AVFilterGraph* avfilter_graph;
 	AVFrame* avinframe;
 	AVFrame* avoutframe;
 	int format;
 	int width;
 	int height;
-	int reset;
+	int frequency;
+	int channels;
+	int generation;
+	int in_use;
+	int temporary;
+	int64_t last_used;
+} filter_graph;
+
+typedef struct
+{
+	AVFilter* avfilter;
+	filter_graph graphs[MAX_GRAPHS];
+	int generation;
+	int64_t uses;
 } private_data;
 
 static void property_changed( mlt_service owner, mlt_filter filter, mlt_event_data event_data )
@@ -65,10 +81,12 @@ static void property_changed( mlt_service owner, mlt_filter filter, mlt_event_da
 			{
 				if( !strcmp( opt->name, name + PARAM_PREFIX_LEN ) )
 				{
-					pdata->reset = 1;
+					pdata->generation++;
 					break;
 				}
 			}
+			if( !strcmp( "threads", name + PARAM_PREFIX_LEN ) )
+				pdata->generation++;
 		}
 	}
 }
@@ -98,10 +116,14 @@ static mlt_image_format get_supported_image_format( mlt_image_format format )
 	switch( format )
 	{
 	case mlt_image_rgba:
+	case mlt_image_rgba64:
 		return mlt_image_rgba;
 	case mlt_image_rgb:
 		return mlt_image_rgb;
 	case mlt_image_yuv420p:
+	case mlt_image_yuv420p10:
+	case mlt_image_nv12:
+	case mlt_image_p010:
 		return mlt_image_yuv420p;
 	default:
 		mlt_log_error(NULL, "[filter_avfilter] Unknown image format requested: %d\n", format );
@@ -113,9 +135,8 @@ static mlt_image_format get_supported_image_format( mlt_image_format format )
 	}
 }
 
-static void set_avfilter_options( mlt_filter filter, double scale)
+static void set_avfilter_options( mlt_filter filter, filter_graph* g, double scale)
 {
-	private_data* pdata = (private_data*)filter->child;
 	mlt_properties filter_properties = MLT_FILTER_PROPERTIES(filter);
 	int i;
 	int count = mlt_properties_count( filter_properties );
@@ -126,7 +147,7 @@ static void set_avfilter_options( mlt_filter filter, double scale)
 		const char *param_name = mlt_properties_get_name( filter_properties, i );
 		if( param_name && strncmp( PARAM_PREFIX, param_name, PARAM_PREFIX_LEN ) == 0 )
 		{
-			const AVOption *opt = av_opt_find( pdata->avfilter_ctx->priv, param_name + PARAM_PREFIX_LEN, 0, 0, 0 );
+			const AVOption *opt = av_opt_find( g->avfilter_ctx->priv, param_name + PARAM_PREFIX_LEN, 0, 0, 0 );
 			const char* value = mlt_properties_get_value( filter_properties, i );
 			if( opt && value )
 			{
@@ -139,13 +160,13 @@ static void set_avfilter_options( mlt_filter filter, double scale)
 						value = mlt_properties_get(filter_properties, "_avfilter_temp");
 					}
 				}
-				av_opt_set( pdata->avfilter_ctx->priv, opt->name, value, 0 );
+				av_opt_set( g->avfilter_ctx->priv, opt->name, value, 0 );
 			}
 		}
 	}
 }
 
-static void init_audio_filtergraph( mlt_filter filter, mlt_audio_format format, int frequency, int channels )
+static void init_audio_filtergraph( mlt_filter filter, filter_graph* g, mlt_audio_format format, int frequency, int channels )
 {
 	private_data* pdata = (private_data*)filter->child;
 	AVFilter *abuffersrc  = avfilter_get_by_name("abuffer");
@@ -157,7 +178,9 @@ static void init_audio_filtergraph( mlt_filter filter, mlt_audio_format format,
 	char channel_layout_str[64];
 	int ret;
 
-	pdata->format = format;
+	g->format = format;
+	g->frequency = frequency;
+	g->channels = channels;
 
 	// Set up formats
 	sample_fmts[0] = mlt_to_av_sample_format( format );
@@ -167,112 +190,112 @@ static void init_audio_filtergraph( mlt_filter filter, mlt_audio_format format,
 	av_get_channel_layout_string( channel_layout_str, sizeof(channel_layout_str), 0, channel_layouts[0]);
 
 	// Destroy the current filter graph
-	avfilter_graph_free( &pdata->avfilter_graph );
+	avfilter_graph_free( &g->avfilter_graph );
 
 	// Create the new filter graph
-	pdata->avfilter_graph = avfilter_graph_alloc();
-	if( !pdata->avfilter_graph ) {
+	g->avfilter_graph = avfilter_graph_alloc();
+	if( !g->avfilter_graph ) {
 		mlt_log_error( filter, "Cannot create filter graph\n" );
 		goto fail;
 	}
 
 	// Set thread count if supported.
 	if ( pdata->avfilter->flags & AVFILTER_FLAG_SLICE_THREADS ) {
-		av_opt_set_int( pdata->avfilter_graph, "threads",
+		av_opt_set_int( g->avfilter_graph, "threads",
 			FFMAX( 0, mlt_properties_get_int( MLT_FILTER_PROPERTIES(filter), "av.threads" ) ), 0 );
 	}
 
 	// Initialize the buffer source filter context
-	pdata->avbuffsrc_ctx = avfilter_graph_alloc_filter( pdata->avfilter_graph, abuffersrc, "in");
-	if( !pdata->avbuffsrc_ctx ) {
+	g->avbuffsrc_ctx = avfilter_graph_alloc_filter( g->avfilter_graph, abuffersrc, "in");
+	if( !g->avbuffsrc_ctx ) {
 		mlt_log_error( filter, "Cannot create audio buffer source\n" );
 		goto fail;
 	}
-	ret = av_opt_set_int( pdata->avbuffsrc_ctx, "sample_rate", sample_rates[0], AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_int( g->avbuffsrc_ctx, "sample_rate", sample_rates[0], AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set src sample rate %d\n", sample_rates[0] );
 		goto fail;
 	}
-	ret = av_opt_set_int( pdata->avbuffsrc_ctx, "sample_fmt", sample_fmts[0], AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_int( g->avbuffsrc_ctx, "sample_fmt", sample_fmts[0], AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set src sample format %d\n", sample_fmts[0] );
 		goto fail;
 	}
-	ret = av_opt_set_int( pdata->avbuffsrc_ctx, "channels", channel_counts[0], AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_int( g->avbuffsrc_ctx, "channels", channel_counts[0], AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set src channels %d\n", channel_counts[0] );
 		goto fail;
 	}
-	ret = av_opt_set( pdata->avbuffsrc_ctx, "channel_layout", channel_layout_str, AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set( g->avbuffsrc_ctx, "channel_layout", channel_layout_str, AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set src channel layout %s\n", channel_layout_str );
 		goto fail;
 	}
-	ret = avfilter_init_str( pdata->avbuffsrc_ctx, NULL );
+	ret = avfilter_init_str( g->avbuffsrc_ctx, NULL );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot init buffer source\n" );
 		goto fail;
 	}
 
 	// Initialize the buffer sink filter context
-	pdata->avbuffsink_ctx = avfilter_graph_alloc_filter( pdata->avfilter_graph, abuffersink, "out");
-	if( !pdata->avbuffsink_ctx ) {
+	g->avbuffsink_ctx = avfilter_graph_alloc_filter( g->avfilter_graph, abuffersink, "out");
+	if( !g->avbuffsink_ctx ) {
 		mlt_log_error( filter, "Cannot create audio buffer sink\n" );
 		goto fail;
 	}
-	ret = av_opt_set_int_list( pdata->avbuffsink_ctx, "sample_fmts", sample_fmts, -1, AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_int_list( g->avbuffsink_ctx, "sample_fmts", sample_fmts, -1, AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set sink sample formats\n" );
 		goto fail;
 	}
-	ret = av_opt_set_int_list( pdata->avbuffsink_ctx, "sample_rates", sample_rates, -1, AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_int_list( g->avbuffsink_ctx, "sample_rates", sample_rates, -1, AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set sink sample rates\n" );
 		goto fail;
 	}
-	ret = av_opt_set_int_list( pdata->avbuffsink_ctx, "channel_counts", channel_counts, -1, AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_int_list( g->avbuffsink_ctx, "channel_counts", channel_counts, -1, AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set sink channel counts\n" );
 		goto fail;
 	}
-	ret = av_opt_set_int_list( pdata->avbuffsink_ctx, "channel_layouts", channel_layouts, -1, AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_int_list( g->avbuffsink_ctx, "channel_layouts", channel_layouts, -1, AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set sink channel_layouts\n" );
 		goto fail;
 	}
-	ret = avfilter_init_str(  pdata->avbuffsink_ctx, NULL );
+	ret = avfilter_init_str(  g->avbuffsink_ctx, NULL );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot init buffer sink\n" );
 		goto fail;
 	}
 
 	// Initialize the filter context
-	pdata->avfilter_ctx = avfilter_graph_alloc_filter( pdata->avfilter_graph, pdata->avfilter, pdata->avfilter->name );
-	if( !pdata->avfilter_ctx ) {
+	g->avfilter_ctx = avfilter_graph_alloc_filter( g->avfilter_graph, pdata->avfilter, pdata->avfilter->name );
+	if( !g->avfilter_ctx ) {
 		mlt_log_error( filter, "Cannot create audio filter\n" );
 		goto fail;
 	}
-	set_avfilter_options( filter, 1.0 );
-	ret = avfilter_init_str(  pdata->avfilter_ctx, NULL );
+	set_avfilter_options( filter, g, 1.0 );
+	ret = avfilter_init_str(  g->avfilter_ctx, NULL );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot init filter\n" );
 		goto fail;
 	}
 
 	// Connect the filters
-	ret = avfilter_link( pdata->avbuffsrc_ctx, 0, pdata->avfilter_ctx, 0 );
+	ret = avfilter_link( g->avbuffsrc_ctx, 0, g->avfilter_ctx, 0 );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot link src to filter\n" );
 		goto fail;
 	}
-	ret = avfilter_link( pdata->avfilter_ctx, 0, pdata->avbuffsink_ctx, 0 );
+	ret = avfilter_link( g->avfilter_ctx, 0, g->avbuffsink_ctx, 0 );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot link filter to sink\n" );
 		goto fail;
 	}
 
 	// Configure the graph.
-	ret = avfilter_graph_config( pdata->avfilter_graph, NULL );
+	ret = avfilter_graph_config( g->avfilter_graph, NULL );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot configure the filter graph\n" );
 		goto fail;
@@ -281,11 +304,11 @@ static void init_audio_filtergraph( mlt_filter filter, mlt_audio_format format,
 	return;
 
 fail:
-	avfilter_graph_free( &pdata->avfilter_graph );
+	avfilter_graph_free( &g->avfilter_graph );
 }
 
 
-static void init_image_filtergraph( mlt_filter filter, mlt_image_format format, int width, int height, double resolution_scale )
+static void init_image_filtergraph( mlt_filter filter, filter_graph* g, mlt_image_format format, int width, int height, double resolution_scale )
 {
 	private_data* pdata = (private_data*)filter->child;
 	mlt_profile profile = mlt_service_profile(MLT_FILTER_SERVICE(filter));
@@ -300,96 +323,96 @@ static void init_image_filtergraph( mlt_filter filter, mlt_image_format format,
 	AVRational framerate = (AVRational){ profile->frame_rate_num, profile->frame_rate_den };
 	int ret;
 
-	pdata->format = format;
-	pdata->width = width;
-	pdata->height = height;
+	g->format = format;
+	g->width = width;
+	g->height = height;
 
 	// Set up formats
 	pixel_fmts[0] = mlt_to_av_image_format( format );
 
 	// Destroy the current filter graph
-	avfilter_graph_free( &pdata->avfilter_graph );
+	avfilter_graph_free( &g->avfilter_graph );
 
 	// Create the new filter graph
-	pdata->avfilter_graph = avfilter_graph_alloc();
-	if( !pdata->avfilter_graph ) {
+	g->avfilter_graph = avfilter_graph_alloc();
+	if( !g->avfilter_graph ) {
 		mlt_log_error( filter, "Cannot create filter graph\n" );
 		goto fail;
 	}
-	pdata->avfilter_graph->scale_sws_opts = av_strdup("flags=" MLT_SWS_FLAGS);
+	g->avfilter_graph->scale_sws_opts = av_strdup("flags=" MLT_SWS_FLAGS);
 
 	// Set thread count if supported.
 	if ( pdata->avfilter->flags & AVFILTER_FLAG_SLICE_THREADS ) {
-		av_opt_set_int( pdata->avfilter_graph, "threads",
+		av_opt_set_int( g->avfilter_graph, "threads",
 			FFMAX( 0, mlt_properties_get_int( MLT_FILTER_PROPERTIES(filter), "av.threads" ) ), 0 );
 	}
 
 	// Initialize the buffer source filter context
-	pdata->avbuffsrc_ctx = avfilter_graph_alloc_filter( pdata->avfilter_graph, buffersrc, "in");
-	if( !pdata->avbuffsrc_ctx ) {
+	g->avbuffsrc_ctx = avfilter_graph_alloc_filter( g->avfilter_graph, buffersrc, "in");
+	if( !g->avbuffsrc_ctx ) {
 		mlt_log_error( filter, "Cannot create image buffer source\n" );
 		goto fail;
 	}
-	ret = av_opt_set_int( pdata->avbuffsrc_ctx, "width", width, AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_int( g->avbuffsrc_ctx, "width", width, AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set src width %d\n", width );
 		goto fail;
 	}
-	ret = av_opt_set_int( pdata->avbuffsrc_ctx, "height", height, AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_int( g->avbuffsrc_ctx, "height", height, AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set src height %d\n", height );
 		goto fail;
 	}
-	ret = av_opt_set_pixel_fmt( pdata->avbuffsrc_ctx, "pix_fmt", pixel_fmts[0], AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_pixel_fmt( g->avbuffsrc_ctx, "pix_fmt", pixel_fmts[0], AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set src pixel format %d\n", pixel_fmts[0] );
 		goto fail;
 	}
-	ret = av_opt_set_q( pdata->avbuffsrc_ctx, "sar", sar, AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_q( g->avbuffsrc_ctx, "sar", sar, AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set src sar %d/%d\n", sar.num, sar.den );
 		goto fail;
 	}
-	ret = av_opt_set_q( pdata->avbuffsrc_ctx, "time_base", timebase, AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_q( g->avbuffsrc_ctx, "time_base", timebase, AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set src time_base %d/%d\n", timebase.num, timebase.den );
 		goto fail;
 	}
-	ret = av_opt_set_q( pdata->avbuffsrc_ctx, "frame_rate", framerate, AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_q( g->avbuffsrc_ctx, "frame_rate", framerate, AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set src frame_rate %d/%d\n", framerate.num, framerate.den );
 		goto fail;
 	}
-	ret = avfilter_init_str( pdata->avbuffsrc_ctx, NULL );
+	ret = avfilter_init_str( g->avbuffsrc_ctx, NULL );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot init buffer source\n" );
 		goto fail;
 	}
 
 	// Initialize the buffer sink filter context
-	pdata->avbuffsink_ctx = avfilter_graph_alloc_filter( pdata->avfilter_graph, buffersink, "out");
-	if( !pdata->avbuffsink_ctx ) {
+	g->avbuffsink_ctx = avfilter_graph_alloc_filter( g->avfilter_graph, buffersink, "out");
+	if( !g->avbuffsink_ctx ) {
 		mlt_log_error( filter, "Cannot create image buffer sink\n" );
 		goto fail;
 	}
-	ret = av_opt_set_int_list( pdata->avbuffsink_ctx, "pix_fmts", pixel_fmts, -1, AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_int_list( g->avbuffsink_ctx, "pix_fmts", pixel_fmts, -1, AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set sink pixel formats\n" );
 		goto fail;
 	}
-	ret = avfilter_init_str(  pdata->avbuffsink_ctx, NULL );
+	ret = avfilter_init_str(  g->avbuffsink_ctx, NULL );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot init buffer sink\n" );
 		goto fail;
 	}
 
 	// Initialize the filter context
-	pdata->avfilter_ctx = avfilter_graph_alloc_filter( pdata->avfilter_graph, pdata->avfilter, pdata->avfilter->name );
-	if( !pdata->avfilter_ctx ) {
+	g->avfilter_ctx = avfilter_graph_alloc_filter( g->avfilter_graph, pdata->avfilter, pdata->avfilter->name );
+	if( !g->avfilter_ctx ) {
 		mlt_log_error( filter, "Cannot create video filter\n" );
 		goto fail;
 	}
-	set_avfilter_options( filter, resolution_scale );
+	set_avfilter_options( filter, g, resolution_scale );
 
 	if ( !strcmp( "lut3d", pdata->avfilter->name ) ) {
 #if defined(__GLIBC__) || defined(__APPLE__) || (__FreeBSD__)
@@ -398,7 +421,7 @@ static void init_image_filtergraph( mlt_filter filter, mlt_image_format format,
 		// Get the current locale and switch to POSIX local.
 		locale_t orig_locale  = uselocale( posix_locale );
 		// Initialize the filter.
-		ret = avfilter_init_str(  pdata->avfilter_ctx, NULL );
+		ret = avfilter_init_str(  g->avfilter_ctx, NULL );
 		// Restore the original locale.
 		uselocale( orig_locale );
 		freelocale( posix_locale );
@@ -407,13 +430,13 @@ static void init_image_filtergraph( mlt_filter filter, mlt_image_format format,
 		char *orig_localename = strdup( setlocale( LC_NUMERIC, NULL ) );
 		setlocale( LC_NUMERIC, "C" );
 		// Initialize the filter.
-		ret = avfilter_init_str(  pdata->avfilter_ctx, NULL );
+		ret = avfilter_init_str(  g->avfilter_ctx, NULL );
 		// Restore the original locale.
 		setlocale( LC_NUMERIC, orig_localename );
 		free( orig_localename );
 #endif
 	} else {
-		ret = avfilter_init_str(  pdata->avfilter_ctx, NULL );
+		ret = avfilter_init_str(  g->avfilter_ctx, NULL );
 	}
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot init scale filter: %s\n", av_err2str(ret) );
@@ -423,116 +446,116 @@ static void init_image_filtergraph( mlt_filter filter, mlt_image_format format,
 	// scale=w=1280:h=720:force_original_aspect_ratio=decrease, pad=w=1280:h=720:x=(ow-iw)/2:y=(oh-ih)/2
 
 	// Initialize the scale filter context
-	pdata->scale_ctx = avfilter_graph_alloc_filter( pdata->avfilter_graph, scale, "scale");
-	if( !pdata->scale_ctx ) {
+	g->scale_ctx = avfilter_graph_alloc_filter( g->avfilter_graph, scale, "scale");
+	if( !g->scale_ctx ) {
 		mlt_log_error( filter, "Cannot create scale filer\n" );
 		goto fail;
 	}
 	mlt_properties_set_int( p, "w", width );
 	mlt_properties_set_int( p, "h", height );
-	const AVOption *opt = av_opt_find( pdata->scale_ctx->priv, "w", 0, 0, 0 );
+	const AVOption *opt = av_opt_find( g->scale_ctx->priv, "w", 0, 0, 0 );
 	if ( opt ) {
-		ret = av_opt_set( pdata->scale_ctx->priv, opt->name, mlt_properties_get(p, "w"), 0 );
+		ret = av_opt_set( g->scale_ctx->priv, opt->name, mlt_properties_get(p, "w"), 0 );
 		if ( ret < 0 ) {
 			mlt_log_error( filter, "Cannot set scale width\n" );
 			goto fail;
 		}
 	}
-	opt = av_opt_find( pdata->scale_ctx->priv, "h", 0, 0, 0 );
+	opt = av_opt_find( g->scale_ctx->priv, "h", 0, 0, 0 );
 	if ( opt ) {
-		ret = av_opt_set( pdata->scale_ctx->priv, opt->name, mlt_properties_get(p, "h"), 0 );
+		ret = av_opt_set( g->scale_ctx->priv, opt->name, mlt_properties_get(p, "h"), 0 );
 		if ( ret < 0 ) {
 			mlt_log_error( filter, "Cannot set scale height\n" );
 			goto fail;
 		}
 	}
-	ret = av_opt_set_int( pdata->scale_ctx, "force_original_aspect_ratio", 1, AV_OPT_SEARCH_CHILDREN );
+	ret = av_opt_set_int( g->scale_ctx, "force_original_aspect_ratio", 1, AV_OPT_SEARCH_CHILDREN );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot set scale force_original_aspect_ratio\n" );
 		goto fail;
 	}
-	opt = av_opt_find( pdata->scale_ctx->priv, "flags", 0, 0, 0 );
+	opt = av_opt_find( g->scale_ctx->priv, "flags", 0, 0, 0 );
 	if ( opt ) {
-		ret = av_opt_set( pdata->scale_ctx->priv, opt->name, MLT_SWS_FLAGS, 0 );
+		ret = av_opt_set( g->scale_ctx->priv, opt->name, MLT_SWS_FLAGS, 0 );
 		if ( ret < 0 ) {
 			mlt_log_error( filter, "Cannot set scale flags\n" );
 			goto fail;
 		}
 	}
-	ret = avfilter_init_str(  pdata->scale_ctx, NULL );
+	ret = avfilter_init_str(  g->scale_ctx, NULL );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot init scale filter\n" );
 		goto fail;
 	}
 
 	// Initialize the padding filter context
-	pdata->pad_ctx = avfilter_graph_alloc_filter( pdata->avfilter_graph, pad, "pad");
-	if( !pdata->pad_ctx ) {
+	g->pad_ctx = avfilter_graph_alloc_filter( g->avfilter_graph, pad, "pad");
+	if( !g->pad_ctx ) {
 		mlt_log_error( filter, "Cannot create pad filter\n" );
 		goto fail;
 	}
-	opt = av_opt_find( pdata->pad_ctx->priv, "w", 0, 0, 0 );
+	opt = av_opt_find( g->pad_ctx->priv, "w", 0, 0, 0 );
 	if ( opt ) {
-		ret = av_opt_set( pdata->pad_ctx->priv, opt->name, mlt_properties_get(p, "w"), 0 );
+		ret = av_opt_set( g->pad_ctx->priv, opt->name, mlt_properties_get(p, "w"), 0 );
 		if ( ret < 0 ) {
 			mlt_log_error( filter, "Cannot set pad width\n" );
 			goto fail;
 		}
 	}
-	opt = av_opt_find( pdata->pad_ctx->priv, "h", 0, 0, 0 );
+	opt = av_opt_find( g->pad_ctx->priv, "h", 0, 0, 0 );
 	if ( opt ) {
-		ret = av_opt_set( pdata->pad_ctx->priv, opt->name, mlt_properties_get(p, "h"), 0 );
+		ret = av_opt_set( g->pad_ctx->priv, opt->name, mlt_properties_get(p, "h"), 0 );
 		if ( ret < 0 ) {
 			mlt_log_error( filter, "Cannot pad scale height\n" );
 			goto fail;
 		}
 	}
-	opt = av_opt_find( pdata->pad_ctx->priv, "x", 0, 0, 0 );
+	opt = av_opt_find( g->pad_ctx->priv, "x", 0, 0, 0 );
 	if ( opt ) {
-		ret = av_opt_set( pdata->pad_ctx->priv, opt->name, "(ow-iw)/2", 0 );
+		ret = av_opt_set( g->pad_ctx->priv, opt->name, "(ow-iw)/2", 0 );
 		if ( ret < 0 ) {
 			mlt_log_error( filter, "Cannot set pad x\n" );
 			goto fail;
 		}
 	}
-	opt = av_opt_find( pdata->pad_ctx->priv, "y", 0, 0, 0 );
+	opt = av_opt_find( g->pad_ctx->priv, "y", 0, 0, 0 );
 	if ( opt ) {
-		ret = av_opt_set( pdata->pad_ctx->priv, opt->name, "(oh-ih)/2", 0 );
+		ret = av_opt_set( g->pad_ctx->priv, opt->name, "(oh-ih)/2", 0 );
 		if ( ret < 0 ) {
 			mlt_log_error( filter, "Cannot set pad y\n" );
 			goto fail;
 		}
 	}
-	ret = avfilter_init_str(  pdata->pad_ctx, NULL );
+	ret = avfilter_init_str(  g->pad_ctx, NULL );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot init pad filter\n" );
 		goto fail;
 	}
 
 	// Connect the filters
-	ret = avfilter_link( pdata->avbuffsrc_ctx, 0, pdata->avfilter_ctx, 0 );
+	ret = avfilter_link( g->avbuffsrc_ctx, 0, g->avfilter_ctx, 0 );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot link src to filter\n" );
 		goto fail;
 	}
-	ret = avfilter_link( pdata->avfilter_ctx, 0, pdata->scale_ctx, 0 );
+	ret = avfilter_link( g->avfilter_ctx, 0, g->scale_ctx, 0 );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot link filter to scale\n" );
 		goto fail;
 	}
-	ret = avfilter_link( pdata->scale_ctx, 0, pdata->pad_ctx, 0 );
+	ret = avfilter_link( g->scale_ctx, 0, g->pad_ctx, 0 );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot link scale to pad\n" );
 		goto fail;
 	}
-	ret = avfilter_link( pdata->pad_ctx, 0, pdata->avbuffsink_ctx, 0 );
+	ret = avfilter_link( g->pad_ctx, 0, g->avbuffsink_ctx, 0 );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot link pad to sink\n" );
 		goto fail;
 	}
 
 	// Configure the graph.
-	ret = avfilter_graph_config( pdata->avfilter_graph, NULL );
+	ret = avfilter_graph_config( g->avfilter_graph, NULL );
 	if( ret < 0 ) {
 		mlt_log_error( filter, "Cannot configure the filter graph\n" );
 		goto fail;
@@ -542,7 +565,96 @@ static void init_image_filtergraph( mlt_filter filter, mlt_image_format format,
 
 fail:
 	mlt_properties_close( p );
-	avfilter_graph_free( &pdata->avfilter_graph );
+	avfilter_graph_free( &g->avfilter_graph );
+}
+
+static void free_graph( filter_graph* g )
+{
+	avfilter_graph_free( &g->avfilter_graph );
+	av_frame_free( &g->avinframe );
+	av_frame_free( &g->avoutframe );
+}
+
+/** Find a filter graph that is not in use and matches the request, or make one.
+ *
+ * The filter must be locked. Frames of different sizes, like those of a preview
+ * and a full resolution render, each keep their graph instead of rebuilding a
+ * shared one, and frames rendered at the same time by several threads each get
+ * their own graph. A graph stays in use until it is given to release_graph().
+ * Pass 0 for the sizes of audio and for the frequency and channels of images.
+ */
+
+static filter_graph* get_graph( mlt_filter filter, int format, int width, int height, int frequency, int channels )
+{
+	private_data* pdata = (private_data*)filter->child;
+	filter_graph* g = NULL;
+	int i;
+
+	for( i = 0; i < MAX_GRAPHS; i++ )
+	{
+		filter_graph* candidate = &pdata->graphs[i];
+		if( !candidate->in_use && candidate->generation == pdata->generation &&
+			candidate->format == format && candidate->width == width && candidate->height == height &&
+			candidate->frequency == frequency && candidate->channels == channels )
+		{
+			g = candidate;
+			break;
+		}
+	}
+
+	if( !g )
+	{
+		// Replace the graph that was used longest ago
+		for( i = 0; i < MAX_GRAPHS; i++ )
+		{
+			filter_graph* candidate = &pdata->graphs[i];
+			if( !candidate->in_use && ( !g || candidate->last_used < g->last_used ) )
+				g = candidate;
+		}
+		if( !g )
+		{
+			// More threads than graphs, so this one is dropped after use
+			g = calloc( 1, sizeof( *g ) );
+			if( !g )
+				return NULL;
+			g->temporary = 1;
+		}
+		if( !g->avinframe )
+			g->avinframe = av_frame_alloc();
+		if( !g->avoutframe )
+			g->avoutframe = av_frame_alloc();
+		if( width > 0 )
+		{
+			mlt_profile profile = mlt_service_profile( MLT_FILTER_SERVICE(filter) );
+			init_image_filtergraph( filter, g, format, width, height, mlt_profile_scale_width( profile, width ) );
+		}
+		else
+		{
+			init_audio_filtergraph( filter, g, format, frequency, channels );
+		}
+		g->generation = pdata->generation;
+	}
+
+	g->in_use = 1;
+	g->last_used = ++pdata->uses;
+	return g;
+}
+
+/** Give back a filter graph from get_graph().
+ *
+ * The filter must be locked.
+ */
+
+static void release_graph( filter_graph* g )
+{
+	av_frame_unref( g->avinframe );
+	av_frame_unref( g->avoutframe );
+	g->in_use = 0;
+	if( g->temporary )
+	{
+		free_graph( g );
+		free( g );
+	}
 }
 
 mlt_position get_position(mlt_filter filter, mlt_frame frame)
@@ -570,7 +682,6 @@ mlt_position get_position(mlt_filter filter, mlt_frame frame)
 static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
 {
 	mlt_filter filter = mlt_frame_pop_audio( frame );
-	private_data* pdata = (private_data*)filter->child;
 	double fps = mlt_profile_fps( mlt_service_profile(MLT_FILTER_SERVICE(filter)) );
 	int64_t samplepos = mlt_audio_calculate_samples_to_position( fps, *frequency, get_position(filter, frame) );
 	int bufsize = 0;
@@ -581,96 +692,94 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 	bufsize = mlt_audio_format_size( *format, *samples, *channels );
 
 	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
+	filter_graph* g = get_graph( filter, *format, 0, 0, *frequency, *channels );
+	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
 
-	if( pdata->reset || pdata->format != *format )
-	{
-		init_audio_filtergraph( filter, *format, *frequency, *channels );
-		pdata->reset = 0;
-	}
-
-	if( pdata->avfilter_graph )
+	if( g && g->avfilter_graph )
 	{
 		// Set up the input frame
 		mlt_channel_layout layout = mlt_get_channel_layout_or_default( mlt_properties_get( MLT_FRAME_PROPERTIES(frame), "channel_layout" ) , *channels );
-		pdata->avinframe->sample_rate = *frequency;
-		pdata->avinframe->format = mlt_to_av_sample_format( *format );
-		pdata->avinframe->channel_layout = mlt_to_av_channel_layout( layout );
-		pdata->avinframe->channels = *channels;
-		pdata->avinframe->nb_samples = *samples;
-		pdata->avinframe->pts = samplepos;
-		ret = av_frame_get_buffer( pdata->avinframe, 1 );
+		g->avinframe->sample_rate = *frequency;
+		g->avinframe->format = mlt_to_av_sample_format( *format );
+		g->avinframe->channel_layout = mlt_to_av_channel_layout( layout );
+		g->avinframe->channels = *channels;
+		g->avinframe->nb_samples = *samples;
+		g->avinframe->pts = samplepos;
+		ret = av_frame_get_buffer( g->avinframe, 1 );
 		if( ret < 0 ) {
 			mlt_log_error( filter, "Cannot get in frame buffer\n" );
 		}
 
-		if( av_sample_fmt_is_planar( pdata->avinframe->format ) )
+		if( av_sample_fmt_is_planar( g->avinframe->format ) )
 		{
 			int i = 0;
 			int stride = bufsize / *channels;
 			for( i = 0; i < * channels; i++ )
 			{
-				memcpy( pdata->avinframe->extended_data[i],
+				memcpy( g->avinframe->extended_data[i],
 						(uint8_t*)*buffer + stride * i,
 						stride );
 			}
 		}
 		else
 		{
-			memcpy( pdata->avinframe->extended_data[0],
+			memcpy( g->avinframe->extended_data[0],
 					(uint8_t*)*buffer,
 					bufsize );
 		}
 
 		// Run the frame through the filter graph
-		ret = av_buffersrc_add_frame( pdata->avbuffsrc_ctx, pdata->avinframe );
+		ret = av_buffersrc_add_frame( g->avbuffsrc_ctx, g->avinframe );
 		if( ret < 0 ) {
 			mlt_log_error( filter, "Cannot add frame to buffer source\n" );
 		}
-		ret = av_buffersink_get_frame( pdata->avbuffsink_ctx, pdata->avoutframe );
+		ret = av_buffersink_get_frame( g->avbuffsink_ctx, g->avoutframe );
 		if( ret < 0 ) {
 			mlt_log_error( filter, "Cannot get frame from buffer sink\n" );
 		}
 
 		// Sanity check the output frame
-		if( *channels != pdata->avoutframe->channels ||
-			*samples != pdata->avoutframe->nb_samples ||
-			*frequency != pdata->avoutframe->sample_rate )
+		if( *channels != g->avoutframe->channels ||
+			*samples != g->avoutframe->nb_samples ||
+			*frequency != g->avoutframe->sample_rate )
 		{
 			mlt_log_error( filter, "Unexpected return format\n" );
 			goto exit;
 		}
 
 		// Copy the filter output into the original buffer
-		if( av_sample_fmt_is_planar( pdata->avoutframe->format ) )
+		if( av_sample_fmt_is_planar( g->avoutframe->format ) )
 		{
 			int stride = bufsize / *channels;
 			int i = 0;
 			for( i = 0; i < * channels; i++ )
 			{
 				memcpy( (uint8_t*)*buffer + stride * i,
-						pdata->avoutframe->extended_data[i],
+						g->avoutframe->extended_data[i],
 						stride );
 			}
 		}
 		else
 		{
 			memcpy( (uint8_t*)*buffer,
-					pdata->avoutframe->extended_data[0],
+					g->avoutframe->extended_data[0],
 					bufsize );
 		}
 	}
 
 exit:
-	av_frame_unref( pdata->avinframe );
-	av_frame_unref( pdata->avoutframe );
-	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+	if( g )
+	{
+		mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
+		release_graph( g );
+		mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+	}
 	return 0;
 }
 
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
 	mlt_filter filter = mlt_frame_pop_service( frame );
-	private_data* pdata = (private_data*)filter->child;
 	int64_t pos = get_position( filter, frame );
 	mlt_profile profile = mlt_service_profile(MLT_FILTER_SERVICE(filter));
 	mlt_properties frame_properties = MLT_FRAME_PROPERTIES(frame);
@@ -683,52 +792,48 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		*format = get_supported_image_format(*format);
 	}
 
-	mlt_frame_get_image( frame, image, format, width, height, 0 );
+	// The output of the graph is copied back into the image
+	mlt_frame_get_image( frame, image, format, width, height, 1 );
 
 	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
+	filter_graph* g = get_graph( filter, *format, *width, *height, 0, 0 );
+	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
 
-	if( pdata->reset || pdata->format != *format || pdata->width != *width || pdata->height != *height )
-	{
-		double scale = mlt_profile_scale_width(profile, *width);
-		init_image_filtergraph( filter, *format, *width, *height, scale );
-		pdata->reset = 0;
-	}
-
-	if( pdata->avfilter_graph )
+	if( g && g->avfilter_graph )
 	{
-		pdata->avinframe->width = *width;
-		pdata->avinframe->height = *height;
-		pdata->avinframe->format = mlt_to_av_image_format( *format );
-		pdata->avinframe->sample_aspect_ratio = (AVRational) {
+		g->avinframe->width = *width;
+		g->avinframe->height = *height;
+		g->avinframe->format = mlt_to_av_image_format( *format );
+		g->avinframe->sample_aspect_ratio = (AVRational) {
 			profile->sample_aspect_num, profile->frame_rate_den };
-		pdata->avinframe->pts = pos;
-		pdata->avinframe->interlaced_frame = !mlt_properties_get_int( frame_properties, "progressive" );
-		pdata->avinframe->top_field_first = mlt_properties_get_int( frame_properties, "top_field_first" );
-		pdata->avinframe->color_primaries = mlt_properties_get_int( frame_properties, "color_primaries" );
-		pdata->avinframe->color_trc = mlt_properties_get_int( frame_properties, "color_trc" );
-		av_frame_set_color_range( pdata->avinframe,
+		g->avinframe->pts = pos;
+		g->avinframe->interlaced_frame = !mlt_properties_get_int( frame_properties, "progressive" );
+		g->avinframe->top_field_first = mlt_properties_get_int( frame_properties, "top_field_first" );
+		g->avinframe->color_primaries = mlt_properties_get_int( frame_properties, "color_primaries" );
+		g->avinframe->color_trc = mlt_properties_get_int( frame_properties, "color_trc" );
+		av_frame_set_color_range( g->avinframe,
 			mlt_properties_get_int( frame_properties, "full_luma" )? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG );
 
 		switch (mlt_properties_get_int( frame_properties, "colorspace" ))
 		{
 		case 240:
-			av_frame_set_colorspace( pdata->avinframe, AVCOL_SPC_SMPTE240M );
+			av_frame_set_colorspace( g->avinframe, AVCOL_SPC_SMPTE240M );
 			break;
 		case 601:
-			av_frame_set_colorspace( pdata->avinframe, AVCOL_SPC_BT470BG );
+			av_frame_set_colorspace( g->avinframe, AVCOL_SPC_BT470BG );
 			break;
 		case 709:
-			av_frame_set_colorspace( pdata->avinframe, AVCOL_SPC_BT709 );
+			av_frame_set_colorspace( g->avinframe, AVCOL_SPC_BT709 );
 			break;
 		case 2020:
-			av_frame_set_colorspace( pdata->avinframe, AVCOL_SPC_BT2020_NCL );
+			av_frame_set_colorspace( g->avinframe, AVCOL_SPC_BT2020_NCL );
 			break;
 		case 2021:
-			av_frame_set_colorspace( pdata->avinframe, AVCOL_SPC_BT2020_CL );
+			av_frame_set_colorspace( g->avinframe, AVCOL_SPC_BT2020_CL );
 			break;
 		}
 
-		ret = av_frame_get_buffer( pdata->avinframe, 1 );
+		ret = av_frame_get_buffer( g->avinframe, 1 );
 		if( ret < 0 ) {
 			mlt_log_error( filter, "Cannot get in frame buffer\n" );
 		}
@@ -743,12 +848,12 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 			uint8_t* src = *image;
 			for( p = 0; p < 3; p ++ )
 			{
-				uint8_t* dst = pdata->avinframe->data[p];
+				uint8_t* dst = g->avinframe->data[p];
 				for( i = 0; i < heights[p]; i ++ )
 				{
 					memcpy( dst, src, widths[p] );
 					src += widths[p];
-					dst += pdata->avinframe->linesize[p];
+					dst += g->avinframe->linesize[p];
 				}
 			}
 		}
@@ -756,29 +861,29 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		{
 			int i;
 			uint8_t* src = *image;
-			uint8_t* dst = pdata->avinframe->data[0];
+			uint8_t* dst = g->avinframe->data[0];
 			int stride = mlt_image_format_size( *format, *width, 1, NULL );
 			for( i = 0; i < *height; i ++ )
 			{
 				memcpy( dst, src, stride );
 				src += stride;
-				dst += pdata->avinframe->linesize[0];
+				dst += g->avinframe->linesize[0];
 			}
 		}
 
 		// Run the frame through the filter graph
-		ret = av_buffersrc_add_frame( pdata->avbuffsrc_ctx, pdata->avinframe );
+		ret = av_buffersrc_add_frame( g->avbuffsrc_ctx, g->avinframe );
 		if( ret < 0 ) {
 			mlt_log_error( filter, "Cannot add frame to buffer source\n" );
 		}
-		ret = av_buffersink_get_frame( pdata->avbuffsink_ctx, pdata->avoutframe );
+		ret = av_buffersink_get_frame( g->avbuffsink_ctx, g->avoutframe );
 		if( ret < 0 ) {
 			mlt_log_error( filter, "Cannot get frame from buffer sink\n" );
 		}
 
 		// Sanity check the output frame
-		if( *width != pdata->avoutframe->width ||
-			*height != pdata->avoutframe->height )
+		if( *width != g->avoutframe->width ||
+			*height != g->avoutframe->height )
 		{
 			mlt_log_error( filter, "Unexpected return format\n" );
 			goto exit;
@@ -794,12 +899,12 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 			uint8_t* dst = *image;
 			for ( p = 0; p < 3; p ++ )
 			{
-				uint8_t* src = pdata->avoutframe->data[p];
+				uint8_t* src = g->avoutframe->data[p];
 				for ( i = 0; i < heights[p]; i ++ )
 				{
 					memcpy( dst, src, widths[p] );
 					dst += widths[p];
-					src += pdata->avoutframe->linesize[p];
+					src += g->avoutframe->linesize[p];
 				}
 			}
 		}
@@ -807,21 +912,24 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		{
 			int i;
 			uint8_t* dst = *image;
-			uint8_t* src = pdata->avoutframe->data[0];
+			uint8_t* src = g->avoutframe->data[0];
 			int stride = mlt_image_format_size( *format, *width, 1, NULL );
 			for( i = 0; i < *height; i ++ )
 			{
 				memcpy( dst, src, stride );
 				dst += stride;
-				src += pdata->avoutframe->linesize[0];
+				src += g->avoutframe->linesize[0];
 			}
 		}
 	}
 
 exit:
-	av_frame_unref( pdata->avinframe );
-	av_frame_unref( pdata->avoutframe );
-	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+	if( g )
+	{
+		mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
+		release_graph( g );
+		mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+	}
 	return 0;
 }
 
@@ -855,9 +963,9 @@ static void filter_close( mlt_filter filter )
 
 	if( pdata )
 	{
-		avfilter_graph_free( &pdata->avfilter_graph );
-		av_frame_free( &pdata->avinframe );
-		av_frame_free( &pdata->avoutframe );
+		int i;
+		for( i = 0; i < MAX_GRAPHS; i++ )
+			free_graph( &pdata->graphs[i] );
 		free( pdata );
 	}
 	filter->child = NULL;
@@ -884,16 +992,9 @@ mlt_filter filter_avfilter_init( mlt_profile profile, mlt_service_type type, con
 
 	if( filter && pdata && pdata->avfilter )
 	{
-		pdata->avbuffsink_ctx = NULL;
-		pdata->avbuffsrc_ctx = NULL;
-		pdata->avfilter_ctx = NULL;
-		pdata->avfilter_graph = NULL;
-		pdata->avinframe = av_frame_alloc();
-		pdata->avoutframe = av_frame_alloc();
-		pdata->format = -1;
-		pdata->width = -1;
-		pdata->height = -1;
-		pdata->reset = 1;
+		int i;
+		for( i = 0; i < MAX_GRAPHS; i++ )
+			pdata->graphs[i].format = -1;
 
 		filter->close = filter_close;
 		filter->process = filter_process;
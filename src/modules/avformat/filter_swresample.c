@@ -39,8 +39,21 @@ typedef struct
 	int out_channels;
 	mlt_channel_layout in_layout;
 	mlt_channel_layout out_layout;
+	int filter_size;
 } private_data;
 
+/** Get the length of the resampling filter for a quality name.
+*/
+
+static int get_filter_size( const char* quality )
+{
+	if ( quality && !strcmp( quality, "fast" ) )
+		return 8;
+	else if ( quality && !strcmp( quality, "medium" ) )
+		return 16;
+	return 32;
+}
+
 static int configure_swr_context( mlt_filter filter )
 {
 	private_data* pdata = (private_data*)filter->child;
@@ -64,6 +77,7 @@ static int configure_swr_context( mlt_filter filter )
 	av_opt_set_int( pdata->ctx, "isf", mlt_to_av_sample_format( pdata->in_format ), 0 );
 	av_opt_set_int( pdata->ctx, "isr", pdata->in_frequency,  0 );
 	av_opt_set_int( pdata->ctx, "ich", pdata->in_channels, 0 );
+	av_opt_set_int( pdata->ctx, "filter_size", pdata->filter_size, 0 );
 
 	if( pdata->in_layout != mlt_channel_independent && pdata->out_layout != mlt_channel_independent )
 	{
@@ -170,6 +184,24 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 		return error;
 	}
 
+	if( in.frequency == out.frequency &&
+		in.channels == out.channels &&
+		in.layout == out.layout &&
+		frame->convert_audio &&
+		!frame->convert_audio( frame, &in.data, &in.format, out.format ) )
+	{
+		// Only the sample format changes, which does not need a resampler
+		mlt_audio_get_values( &in, buffer, frequency, format, samples, channels );
+		mlt_properties_set( frame_properties, "channel_layout", mlt_audio_channel_layout_name( in.layout ) );
+		return error;
+	}
+
+	// The filter quality overrides the one the consumer asks for
+	const char* quality = mlt_properties_get( MLT_FILTER_PROPERTIES(filter), "quality" );
+	if ( !quality )
+		quality = mlt_properties_get( frame_properties, "consumer_resample_quality" );
+	int filter_size = get_filter_size( quality );
+
 	mlt_service_lock( MLT_FILTER_SERVICE(filter) );
 
 	// Detect configuration change
@@ -181,7 +213,8 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 		pdata->in_channels != in.channels ||
 		pdata->out_channels != out.channels ||
 		pdata->in_layout != in.layout ||
-		pdata->out_layout != out.layout )
+		pdata->out_layout != out.layout ||
+		pdata->filter_size != filter_size )
 	{
 		// Save the configuration
 		pdata->in_format = in.format;
@@ -192,6 +225,7 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 		pdata->out_channels = out.channels;
 		pdata->in_layout = in.layout;
 		pdata->out_layout = out.layout;
+		pdata->filter_size = filter_size;
 		// Reconfigure the context
 		error = configure_swr_context( filter );
 	}
@@ -240,8 +274,11 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 
 static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
 {
-	mlt_frame_push_audio( frame, filter );
-	mlt_frame_push_audio( frame, filter_get_audio );
+	if ( mlt_frame_is_test_audio( frame ) == 0 )
+	{
+		mlt_frame_push_audio( frame, filter );
+		mlt_frame_push_audio( frame, filter_get_audio );
+	}
 	return frame;
 }
 
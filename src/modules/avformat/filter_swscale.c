@@ -17,6 +17,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include "common.h"
+
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_factory.h>
@@ -51,6 +53,9 @@ static inline int convert_mlt_to_av_cs( mlt_image_format format )
 		case mlt_image_yuv420p:
 			value = AV_PIX_FMT_YUV420P;
 			break;
+		case mlt_image_yuv422p16:
+			value = AV_PIX_FMT_YUV422P16LE;
+			break;
 		default:
 			fprintf( stderr, "Invalid format...\n" );
 			break;
@@ -59,11 +64,8 @@ static inline int convert_mlt_to_av_cs( mlt_image_format format )
 	return value;
 }
 
-static int filter_scale( mlt_frame frame, uint8_t **image, mlt_image_format *format, int iwidth, int iheight, int owidth, int oheight )
+static int get_interpolation( mlt_properties properties )
 {
-	// Get the properties
-	mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
-
 	// Get the requested interpolation method
 	char *interps = mlt_properties_get( properties, "rescale.interp" );
 
@@ -91,6 +93,15 @@ static int filter_scale( mlt_frame frame, uint8_t **image, mlt_image_format *for
 	// Set swscale flags to get good quality
 	interp |= SWS_FULL_CHR_H_INP | SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND;
 
+	return interp;
+}
+
+static int filter_scale( mlt_frame frame, uint8_t **image, mlt_image_format *format, int iwidth, int iheight, int owidth, int oheight )
+{
+	// Get the properties
+	mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
+	int interp = get_interpolation( properties );
+
 	// Determine the output image size.
 	int out_size = mlt_image_format_size( *format, owidth, oheight, NULL );
 
@@ -99,9 +110,11 @@ static int filter_scale( mlt_frame frame, uint8_t **image, mlt_image_format *for
 		case mlt_image_yuv422:
 		case mlt_image_rgb:
 		case mlt_image_rgba:
+		case mlt_image_yuv420p:
+		case mlt_image_yuv422p16:
 			break;
 		default:
-			// XXX: we only know how to rescale packed formats
+			// XXX: we only know how to rescale packed formats, 4:2:0 and yuv422p16
 			return 1;
 	}
 
@@ -118,14 +131,10 @@ static int filter_scale( mlt_frame frame, uint8_t **image, mlt_image_format *for
 	av_image_fill_arrays(in_data, in_stride, *image, avformat, iwidth, iheight, IMAGE_ALIGN);
 	av_image_fill_arrays(out_data, out_stride, outbuf, avformat, owidth, oheight, IMAGE_ALIGN);
 
-	// Create the context and output image
-	struct SwsContext *context = sws_getContext( iwidth, iheight, avformat, owidth, oheight, avformat, interp, NULL, NULL, NULL);
-	if ( context )
+	// Perform the scaling with a pooled context
+	if ( !mlt_sws_scale_sliced( in_data, in_stride, iwidth, iheight, avformat,
+		out_data, out_stride, owidth, oheight, avformat, interp, 0, 0, 0, 0 ) )
 	{
-		// Perform the scaling
-		sws_scale( context, (const uint8_t **) in_data, in_stride, 0, iheight, out_data, out_stride);
-		sws_freeContext( context );
-	
 		// Now update the frame
 		mlt_frame_set_image( frame, outbuf, out_size, mlt_pool_release );
 	
@@ -142,14 +151,13 @@ static int filter_scale( mlt_frame frame, uint8_t **image, mlt_image_format *for
 			if ( alpha )
 			{
 				avformat = AV_PIX_FMT_GRAY8;
-				struct SwsContext *context = sws_getContext( iwidth, iheight, avformat, owidth, oheight, avformat, interp, NULL, NULL, NULL);
 				outbuf = mlt_pool_alloc( owidth * oheight );
 				av_image_fill_arrays(in_data, in_stride, alpha, avformat, iwidth, iheight, IMAGE_ALIGN);
 				av_image_fill_arrays(out_data, out_stride, outbuf, avformat, owidth, oheight, IMAGE_ALIGN);
 	
 				// Perform the scaling
-				sws_scale( context, (const uint8_t **) in_data, in_stride, 0, iheight, out_data, out_stride);
-				sws_freeContext( context );
+				mlt_sws_scale_sliced( in_data, in_stride, iwidth, iheight, avformat,
+					out_data, out_stride, owidth, oheight, avformat, interp, 0, 0, 0, 0 );
 	
 				// Set it back on the frame
 				mlt_frame_set_alpha( frame, outbuf, owidth * oheight, mlt_pool_release );
@@ -160,8 +168,62 @@ static int filter_scale( mlt_frame frame, uint8_t **image, mlt_image_format *for
 	}
 	else
 	{
+		mlt_pool_release( outbuf );
+		return 1;
+	}
+}
+
+/** Scale an image read through its plane pointers and strides, such as a crop window.
+*/
+
+static int filter_scale_strided( mlt_frame frame, mlt_image input, uint8_t **image, mlt_image_format *format, int owidth, int oheight )
+{
+	int interp = get_interpolation( MLT_FRAME_PROPERTIES( frame ) );
+	int out_size = mlt_image_format_size( *format, owidth, oheight, NULL );
+
+	switch ( *format )
+	{
+		case mlt_image_yuv422:
+		case mlt_image_rgb:
+		case mlt_image_rgba:
+			break;
+		default:
+			return 1;
+	}
+
+	int avformat = convert_mlt_to_av_cs( *format );
+	uint8_t *in_data[4] = { input->planes[0], NULL, NULL, NULL };
+	int in_stride[4] = { input->strides[0], 0, 0, 0 };
+	uint8_t *out_data[4];
+	int out_stride[4];
+	uint8_t *outbuf = mlt_pool_alloc( out_size );
+
+	av_image_fill_arrays(out_data, out_stride, outbuf, avformat, owidth, oheight, IMAGE_ALIGN);
+	if ( mlt_sws_scale_sliced( in_data, in_stride, input->width, input->height, avformat,
+		out_data, out_stride, owidth, oheight, avformat, interp, 0, 0, 0, 0 ) )
+	{
+		mlt_pool_release( outbuf );
 		return 1;
 	}
+
+	// Scale the alpha window before the new image replaces the one it is in
+	uint8_t *alpha = NULL;
+	if ( input->planes[3] )
+	{
+		alpha = mlt_pool_alloc( owidth * oheight );
+		in_data[0] = input->planes[3];
+		in_stride[0] = input->strides[3];
+		av_image_fill_arrays(out_data, out_stride, alpha, AV_PIX_FMT_GRAY8, owidth, oheight, IMAGE_ALIGN);
+		mlt_sws_scale_sliced( in_data, in_stride, input->width, input->height, AV_PIX_FMT_GRAY8,
+			out_data, out_stride, owidth, oheight, AV_PIX_FMT_GRAY8, interp, 0, 0, 0, 0 );
+	}
+
+	mlt_frame_set_image( frame, outbuf, out_size, mlt_pool_release );
+	if ( alpha )
+		mlt_frame_set_alpha( frame, alpha, owidth * oheight, mlt_pool_release );
+	*image = outbuf;
+
+	return 0;
 }
 
 /** Constructor for the filter.
@@ -196,6 +258,11 @@ mlt_filter filter_swscale_init( mlt_profile profile, void *arg )
 
 		// Set the method
 		mlt_properties_set_data( properties, "method", filter_scale, 0, NULL, NULL );
+		mlt_properties_set_data( properties, "strided_method", filter_scale_strided, 0, NULL, NULL );
+
+		// The method keeps 4:2:0 and 16-bit 4:2:2 as they are
+		mlt_properties_set_int( properties, "_yuv420p", 1 );
+		mlt_properties_set_int( properties, "_yuv422p16", 1 );
 	}
 
 	return filter;
@@ -68,6 +68,10 @@
 #include <math.h>
 #include <wchar.h>
 #include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #define POSITION_INITIAL (-2)
 #define POSITION_INVALID (-1)
@@ -76,6 +80,55 @@
 #define MAX_AUDIO_FRAME_SIZE (192000) // 1 second of 48khz 32bit audio
 #define IMAGE_ALIGN (1)
 #define VFR_THRESHOLD (3) // The minimum number of video frames with differing durations to be considered VFR.
+#define REVERSE_CACHE_FRAMES (600) // The most frames of a GOP kept to play backwards, also limited by reverse_cache_bytes.
+#define AUDIO_CACHE_FRAMES (1500) // The most frames of decoded audio kept for scrubbing, also limited by audio_cache_bytes.
+#define AUDIO_CACHE_BYTES (32 * 1024 * 1024)
+#define SEEK_INDEX_MAGIC "MLTSIDX1"
+
+/** A keyframe of the video stream, as it was read from the file */
+
+typedef struct
+{
+	int64_t pts;
+	int64_t pos; /// the byte offset of the packet, or -1 if unknown
+} seek_index_entry;
+
+#define DEMUX_VIDEO (0)
+#define DEMUX_AUDIO (1)
+
+/** A thread that reads the packets of a context ahead into a queue per stream class */
+
+typedef struct
+{
+	struct producer_avformat_s *owner;
+	AVFormatContext *context;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	mlt_deque queue[2];     /// packets for DEMUX_VIDEO and DEMUX_AUDIO
+	int64_t bytes[2];       /// the size of the packets in each queue
+	double duration[2];     /// the duration of the packets in each queue in seconds
+	int wants[2];           /// whether the context supplies each queue
+	int waiting[2];         /// the number of readers waiting on each empty queue
+	int64_t max_bytes;
+	double max_duration;
+	int error;              /// the result of av_read_frame() that stopped reading, or 0
+	int reading;            /// whether the thread is inside av_read_frame()
+	int seeking;            /// whether a seek is waiting for the thread
+	int blocked;            /// whether a queue at twice its limit stops the thread
+	int stop;
+} demuxer;
+
+/** The keyframes of the video stream in presentation order */
+
+typedef struct
+{
+	int stream;
+	int64_t first_pts;
+	int variable_frame_rate;
+	int count;
+	seek_index_entry *entries;
+} seek_index;
 
 struct producer_avformat_s
 {
@@ -96,6 +149,8 @@ struct producer_avformat_s
 	atomic_int_fast64_t last_position;
 	int video_seekable;
 	int seekable; /// This one is used for both audio and file level seekability.
+	int audio_only; /// Never decode video and discard its packets at the demuxer.
+	int live; /// Ingest a live stream with little probing and buffering.
 	atomic_int_fast64_t current_position;
 	mlt_position nonseek_position;
 	atomic_int top_field_first;
@@ -103,6 +158,7 @@ struct producer_avformat_s
 	int audio_buffer_size[ MAX_AUDIO_STREAMS ];
 	uint8_t *decode_buffer[ MAX_AUDIO_STREAMS ];
 	int audio_used[ MAX_AUDIO_STREAMS ];
+	uint32_t audio_skipped;       // the streams not decoded for the last frame with audio_index=all
 	int audio_streams;
 	int audio_max_stream;
 	int total_channels;
@@ -111,6 +167,20 @@ struct producer_avformat_s
 	unsigned int invalid_pts_counter;
 	unsigned int invalid_dts_counter;
 	mlt_cache image_cache;
+	int image_cache_size;         // the size of the image cache without memory pressure
+	int memory_pressure;          // the memory pressure the image cache is sized for
+	mlt_cache reverse_cache;      // the decoded frames of the GOP while playing backwards
+	mlt_cache audio_cache;        // the decoded audio of recent frames for scrubbing or NULL
+	double audio_cache_fps;       // the frame rate the cached audio was cut for
+	int audio_cache_index;        // the audio_index the cached audio was decoded from
+	char *probe_key;              // the entry of the file in the probe cache or NULL
+	pthread_rwlock_t idle_lock;   // read while using the contexts, written to close them when idle
+	double idle_timeout;          // the seconds without frames before closing the contexts or 0
+	atomic_int_fast64_t idle_used; // the time of the last frame in microseconds
+	int idle_listed;
+	struct producer_avformat_s *idle_next;
+	int seek_keyframes;           // seek_mode=keyframe shows the keyframe before each frame
+	int64_t seek_keyframe_pts;    // the keyframe of the last keyframe seek or AV_NOPTS_VALUE
 	int yuv_colorspace, color_primaries, color_trc;
 	int full_luma;
 	pthread_mutex_t video_mutex;
@@ -131,6 +201,15 @@ struct producer_avformat_s
 	int autorotate;
 	int is_audio_synchronizing;
 	int video_send_result;
+	seek_index *seek_index;       // set once it is complete and not changed afterwards
+	atomic_int seek_index_ready;
+	atomic_int seek_index_cancel;
+	pthread_t seek_index_thread;
+	int seek_index_started;
+	char *seek_index_file;        // the media file to index
+	char *seek_index_cache;       // where to persist the index, or NULL
+	demuxer *video_demuxer;       // reads video_format ahead, when demux_thread is set
+	demuxer *audio_demuxer;       // reads audio_format ahead, the same as video_demuxer if they share it
 #if USE_HWACCEL
 	struct {
 		int pix_fmt;
@@ -155,6 +234,13 @@ static int video_codec_init( producer_avformat self, int index, mlt_properties p
 static void get_audio_streams_info( producer_avformat self );
 static mlt_audio_format pick_audio_format( int sample_fmt );
 static int pick_av_pixel_format( int *pix_fmt );
+static void seek_index_open( producer_avformat self, const char *filename );
+static void demuxer_stop( producer_avformat self );
+static int probe_cache_restore( producer_avformat self, mlt_profile profile, const char *filename );
+static void idle_register( producer_avformat self );
+static void idle_unregister( producer_avformat self );
+static void idle_forget( mlt_producer parent );
+static void probe_cache_store( producer_avformat self );
 
 /** Constructor for libavformat.
 */
@@ -177,6 +263,7 @@ mlt_producer producer_avformat_init( mlt_profile profile, const char *service, c
 		if ( mlt_producer_init( producer, self ) == 0 )
 		{
 			self->parent = producer;
+			pthread_rwlock_init( &self->idle_lock, NULL );
 
 			// Get the properties
 			mlt_properties properties = MLT_PRODUCER_PROPERTIES( producer );
@@ -196,23 +283,29 @@ mlt_producer producer_avformat_init( mlt_profile profile, const char *service, c
 
 			if ( strcmp( service, "avformat-novalidate" ) )
 			{
-				// Open the file
-				if ( producer_open( self, profile, mlt_properties_get( properties, "resource" ), 1, 1 ) != 0 )
+				// Use what an earlier producer of the same file found
+				if ( !probe_cache_restore( self, profile, mlt_properties_get( properties, "resource" ) ) )
 				{
-					// Clean up
-					mlt_producer_close( producer );
-					producer = NULL;
-					producer_avformat_close( self );
-				}
-				else if ( self->seekable )
-				{
-					// Close the file to release resources for large playlists - reopen later as needed
-					if ( self->audio_format )
-						avformat_close_input( &self->audio_format );
-					if ( self->video_format )
-						avformat_close_input( &self->video_format );
-					self->audio_format = NULL;
-					self->video_format = NULL;
+					// Open the file
+					if ( producer_open( self, profile, mlt_properties_get( properties, "resource" ), 1, 1 ) != 0 )
+					{
+						// Clean up
+						mlt_producer_close( producer );
+						producer = NULL;
+						producer_avformat_close( self );
+					}
+					else if ( self->seekable )
+					{
+						probe_cache_store( self );
+
+						// Close the file to release resources for large playlists - reopen later as needed
+						if ( self->audio_format )
+							avformat_close_input( &self->audio_format );
+						if ( self->video_format )
+							avformat_close_input( &self->video_format );
+						self->audio_format = NULL;
+						self->video_format = NULL;
+					}
 				}
 			}
 			if ( producer )
@@ -821,6 +914,18 @@ static int producer_open(producer_avformat self, mlt_profile profile, const char
 	AVDictionary *params = NULL;
 	char *filename = parse_url( profile, URL, &format, &params );
 
+	// A live stream starts with what the first packets tell
+	self->live = mlt_properties_get_int( properties, "live" );
+	if ( self->live )
+	{
+		if ( !av_dict_get( params, "probesize", NULL, 0 ) )
+			av_dict_set( &params, "probesize", "32768", 0 );
+		if ( !av_dict_get( params, "analyzeduration", NULL, 0 ) )
+			av_dict_set( &params, "analyzeduration", "500000", 0 );
+		if ( !av_dict_get( params, "fflags", NULL, 0 ) )
+			av_dict_set( &params, "fflags", "nobuffer", 0 );
+	}
+
 	// Now attempt to open the file or device with filename
 	error = avformat_open_input( &self->video_format, filename, format, &params ) < 0;
 	if ( error )
@@ -847,10 +952,21 @@ static int producer_open(producer_avformat self, mlt_profile profile, const char
 			// Find default audio and video streams
 			find_default_streams( self );
 			error = get_basic_info( self, profile, filename );
+			if ( self->live )
+			{
+				// Never seek, and share one context between audio and video
+				self->seekable = self->video_seekable = 0;
+				mlt_properties_set_int( properties, "seekable", 0 );
+			}
 
 			// Initialize position info
 			self->first_pts = AV_NOPTS_VALUE;
 			self->last_position = POSITION_INITIAL;
+			self->seek_keyframe_pts = AV_NOPTS_VALUE;
+			self->audio_only = self->audio_index != -1 && mlt_properties_get_int( properties, "audio_only" );
+
+			if ( !test_open && !error && !self->audio_only )
+				seek_index_open( self, filename );
 
 #if USE_HWACCEL
 			AVDictionaryEntry *hwaccel = av_dict_get( params, "hwaccel", NULL, 0 );
@@ -907,7 +1023,7 @@ static int producer_open(producer_avformat self, mlt_profile profile, const char
 				// We're going to cheat here - for seekable A/V files, we will have separate contexts
 				// to support independent seeking of audio from video.
 				// TODO: Is this really necessary?
-				if ( self->audio_index != -1 && self->video_index != -1 )
+				if ( self->audio_index != -1 && self->video_index != -1 && !self->audio_only )
 				{
 					if ( self->seekable )
 					{
@@ -939,7 +1055,7 @@ static int producer_open(producer_avformat self, mlt_profile profile, const char
 
 #ifdef AVFILTER
 				// Setup autorotate filters.
-				if (self->video_index != -1) {
+				if (self->video_format && self->video_index != -1) {
 					self->autorotate = !mlt_properties_get(properties, "autorotate") || mlt_properties_get_int(properties, "autorotate");
 					if (!test_open && self->autorotate && !self->vfilter_graph) {
 						double theta  = get_rotation(self->video_format->streams[self->video_index]);
@@ -994,15 +1110,23 @@ static int producer_open(producer_avformat self, mlt_profile profile, const char
 	}
 	mlt_events_unblock( properties, self->parent );
 
+	if ( !error && !test_open && self->seekable )
+		idle_register( self );
+
 	return error;
 }
 
-static void prepare_reopen( producer_avformat self )
+/** Close the contexts and codecs so that the next frame opens the file again.
+ *
+ * The caller must stop the video and audio from being decoded.
+ */
+
+static void release_contexts( producer_avformat self )
 {
-	mlt_service_lock( MLT_PRODUCER_SERVICE( self->parent ) );
-	pthread_mutex_lock( &self->audio_mutex );
 	pthread_mutex_lock( &self->open_mutex );
 
+	demuxer_stop( self );
+
 	int i;
 	for ( i = 0; i < MAX_AUDIO_STREAMS; i++ )
 	{
@@ -1045,29 +1169,995 @@ static void prepare_reopen( producer_avformat self )
 		mlt_deque_close( self->apackets );
 		self->apackets = NULL;
 	}
-	if ( self->vpackets )
+	if ( self->vpackets )
+	{
+		while ( ( pkt = mlt_deque_pop_back( self->vpackets ) ) )
+		{
+			av_packet_unref( pkt );
+			free( pkt );
+		}
+		mlt_deque_close( self->vpackets );
+		self->vpackets = NULL;
+	}
+}
+
+static void prepare_reopen( producer_avformat self )
+{
+	mlt_service_lock( MLT_PRODUCER_SERVICE( self->parent ) );
+	pthread_mutex_lock( &self->audio_mutex );
+	release_contexts( self );
+	pthread_mutex_unlock( &self->audio_mutex );
+	mlt_service_unlock( MLT_PRODUCER_SERVICE( self->parent ) );
+}
+
+/** The producers that close their file after being idle for idle_close seconds.
+ *
+ * A reaper thread checks them every second. It only takes the idle lock of a
+ * producer if nobody is using its contexts, so it never waits on a producer,
+ * and the next frame reopens the file and seeks back to the position. The
+ * factory stops and joins it when it closes.
+ */
+
+static producer_avformat idle_list = NULL;
+static pthread_mutex_t idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t idle_reaper;
+static int idle_running = 0;
+static int idle_stopping = 0;
+
+static int64_t idle_now( void )
+{
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void *idle_thread( void *arg )
+{
+	(void) arg;
+	pthread_mutex_lock( &idle_mutex );
+	while ( !idle_stopping )
+	{
+		struct timespec until;
+		clock_gettime( CLOCK_REALTIME, &until );
+		until.tv_sec += 1;
+		pthread_cond_timedwait( &idle_cond, &idle_mutex, &until );
+		if ( idle_stopping )
+			break;
+		int64_t now = idle_now();
+		producer_avformat *link = &idle_list;
+		while ( *link )
+		{
+			producer_avformat self = *link;
+			if ( now - self->idle_used < self->idle_timeout * 1000000 || pthread_rwlock_trywrlock( &self->idle_lock ) )
+			{
+				link = &self->idle_next;
+				continue;
+			}
+			mlt_log_verbose( MLT_PRODUCER_SERVICE( self->parent ), "closing %s after %g seconds idle\n",
+				mlt_properties_get( MLT_PRODUCER_PROPERTIES( self->parent ), "resource" ), self->idle_timeout );
+			release_contexts( self );
+			*link = self->idle_next;
+			self->idle_next = NULL;
+			self->idle_listed = 0;
+			pthread_rwlock_unlock( &self->idle_lock );
+		}
+	}
+	pthread_mutex_unlock( &idle_mutex );
+	return NULL;
+}
+
+/** Stop the reaper and wait for it, when the factory closes.
+ */
+
+static void idle_stop( void *arg )
+{
+	(void) arg;
+	pthread_mutex_lock( &idle_mutex );
+	idle_stopping = 1;
+	pthread_cond_signal( &idle_cond );
+	pthread_mutex_unlock( &idle_mutex );
+	pthread_join( idle_reaper, NULL );
+	pthread_mutex_lock( &idle_mutex );
+	idle_running = 0;
+	idle_stopping = 0;
+	pthread_mutex_unlock( &idle_mutex );
+}
+
+/** Let the reaper close the contexts of a producer once they are idle.
+ */
+
+static void idle_register( producer_avformat self )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self->parent );
+	const char *timeout = mlt_properties_get( properties, "idle_close" );
+
+	if ( !timeout )
+		timeout = getenv( "MLT_AVFORMAT_IDLE_CLOSE" );
+	self->idle_timeout = timeout ? strtod( timeout, NULL ) : 0.0;
+	self->idle_used = idle_now();
+	if ( self->idle_timeout <= 0.0 )
+		return;
+
+	pthread_mutex_lock( &idle_mutex );
+	if ( !idle_running && !pthread_create( &idle_reaper, NULL, idle_thread, NULL ) )
+	{
+		idle_running = 1;
+		mlt_factory_register_for_clean_up( &idle_reaper, idle_stop );
+	}
+	if ( !self->idle_listed )
+	{
+		self->idle_next = idle_list;
+		idle_list = self;
+		self->idle_listed = 1;
+	}
+	pthread_mutex_unlock( &idle_mutex );
+}
+
+static void idle_unregister( producer_avformat self )
+{
+	pthread_mutex_lock( &idle_mutex );
+	producer_avformat *link = &idle_list;
+	while ( *link && *link != self )
+		link = &( *link )->idle_next;
+	if ( *link )
+		*link = self->idle_next;
+	self->idle_next = NULL;
+	self->idle_listed = 0;
+	pthread_mutex_unlock( &idle_mutex );
+}
+
+/** Forget every producer of a closing parent, even one whose cache entry is still in use.
+ */
+
+static void idle_forget( mlt_producer parent )
+{
+	pthread_mutex_lock( &idle_mutex );
+	producer_avformat *link = &idle_list;
+	while ( *link )
+	{
+		producer_avformat self = *link;
+		if ( self->parent == parent )
+		{
+			*link = self->idle_next;
+			self->idle_next = NULL;
+			self->idle_listed = 0;
+		}
+		else
+		{
+			link = &self->idle_next;
+		}
+	}
+	pthread_mutex_unlock( &idle_mutex );
+}
+
+static int64_t best_pts( producer_avformat self, int64_t pts, int64_t dts )
+{
+	self->invalid_pts_counter += pts == AV_NOPTS_VALUE;
+	self->invalid_dts_counter += dts == AV_NOPTS_VALUE;
+	if ( ( self->invalid_pts_counter <= self->invalid_dts_counter
+		   || dts == AV_NOPTS_VALUE ) && pts != AV_NOPTS_VALUE )
+		return pts;
+	else
+		return dts;
+}
+
+static void seek_index_close( seek_index *index )
+{
+	if ( index )
+	{
+		free( index->entries );
+		free( index );
+	}
+}
+
+/** Get the fingerprint of a media file that keys its persistent index.
+ *
+ * \return true if the file is not a regular file
+ */
+
+static int seek_index_fingerprint( const char *filename, char *fingerprint, size_t size )
+{
+	struct stat info;
+	if ( stat( filename, &info ) || !S_ISREG( info.st_mode ) )
+		return 1;
+	snprintf( fingerprint, size, "%lld %lld %s", (long long) info.st_size, (long long) info.st_mtime, filename );
+	return 0;
+}
+
+static int seek_index_compare( const void *a, const void *b )
+{
+	int64_t pts_a = ( (const seek_index_entry*) a )->pts;
+	int64_t pts_b = ( (const seek_index_entry*) b )->pts;
+	return ( pts_a > pts_b ) - ( pts_a < pts_b );
+}
+
+/** Read a persisted index if it is for the same file and stream.
+ */
+
+static seek_index *seek_index_load( const char *cache, const char *fingerprint, int stream )
+{
+	FILE *file = fopen( cache, "rb" );
+	seek_index *index = NULL;
+	char magic[ sizeof( SEEK_INDEX_MAGIC ) ];
+	uint32_t length = 0;
+	int ok = 0;
+
+	if ( !file )
+		return NULL;
+	if ( fread( magic, 1, sizeof( magic ), file ) == sizeof( magic ) && !memcmp( magic, SEEK_INDEX_MAGIC, sizeof( magic ) )
+		&& fread( &length, sizeof( length ), 1, file ) == 1 && length == strlen( fingerprint ) )
+	{
+		char *stored = malloc( length );
+		if ( stored && fread( stored, 1, length, file ) == length && !memcmp( stored, fingerprint, length ) )
+		{
+			index = calloc( 1, sizeof( *index ) );
+			int32_t header[ 3 ];
+			if ( index && fread( header, sizeof( header ), 1, file ) == 1 && fread( &index->first_pts, sizeof( index->first_pts ), 1, file ) == 1
+				&& header[0] == stream && header[2] > 0 )
+			{
+				index->stream = header[0];
+				index->variable_frame_rate = header[1];
+				index->count = header[2];
+				index->entries = malloc( index->count * sizeof( seek_index_entry ) );
+				ok = index->entries && fread( index->entries, sizeof( seek_index_entry ), index->count, file ) == (size_t) index->count;
+			}
+		}
+		free( stored );
+	}
+	fclose( file );
+	if ( !ok )
+	{
+		seek_index_close( index );
+		index = NULL;
+	}
+	return index;
+}
+
+static void seek_index_save( seek_index *index, const char *cache, const char *fingerprint )
+{
+	char temp[ PATH_MAX ];
+	uint32_t length = strlen( fingerprint );
+	int32_t header[ 3 ] = { index->stream, index->variable_frame_rate, index->count };
+
+	snprintf( temp, sizeof( temp ), "%s.%d", cache, (int) getpid() );
+	FILE *file = fopen( temp, "wb" );
+	if ( !file )
+		return;
+	int error = fwrite( SEEK_INDEX_MAGIC, 1, sizeof( SEEK_INDEX_MAGIC ), file ) != sizeof( SEEK_INDEX_MAGIC )
+		|| fwrite( &length, sizeof( length ), 1, file ) != 1
+		|| fwrite( fingerprint, 1, length, file ) != length
+		|| fwrite( header, sizeof( header ), 1, file ) != 1
+		|| fwrite( &index->first_pts, sizeof( index->first_pts ), 1, file ) != 1
+		|| fwrite( index->entries, sizeof( seek_index_entry ), index->count, file ) != (size_t) index->count;
+	if ( fclose( file ) || error || rename( temp, cache ) )
+		remove( temp );
+}
+
+/** Read the packets of a file to find the keyframes of its video stream.
+ *
+ * This runs on its own thread with its own context, so it does not disturb
+ * the decoding, and gives up when the producer closes.
+ */
+
+static seek_index *seek_index_build( producer_avformat self, const char *filename, int stream )
+{
+	AVFormatContext *context = NULL;
+	seek_index *index = NULL;
+	int alloc = 0;
+	int vfr_countdown = 20;
+	int vfr_counter = 0;
+	int64_t prev_pkt_duration = AV_NOPTS_VALUE;
+	AVPacket pkt;
+
+	if ( avformat_open_input( &context, filename, NULL, NULL ) < 0 )
+		return NULL;
+	if ( avformat_find_stream_info( context, NULL ) >= 0 && stream < context->nb_streams )
+		index = calloc( 1, sizeof( *index ) );
+	if ( index )
+	{
+		index->stream = stream;
+		index->first_pts = AV_NOPTS_VALUE;
+		av_init_packet( &pkt );
+		while ( !self->seek_index_cancel && av_read_frame( context, &pkt ) >= 0 )
+		{
+			if ( pkt.stream_index == stream )
+			{
+				// The same checks as find_first_pts()
+				if ( vfr_countdown-- > 0 && pkt.duration != AV_NOPTS_VALUE && pkt.duration != prev_pkt_duration )
+				{
+					if ( prev_pkt_duration != AV_NOPTS_VALUE )
+						++vfr_counter;
+					prev_pkt_duration = pkt.duration;
+				}
+				int64_t pts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts;
+				if ( ( pkt.flags & AV_PKT_FLAG_KEY ) && pts != AV_NOPTS_VALUE )
+				{
+					if ( index->first_pts == AV_NOPTS_VALUE )
+						index->first_pts = ( pkt.dts != AV_NOPTS_VALUE && pkt.dts < 0 ) ? 0 : pts;
+					if ( index->count == alloc )
+					{
+						alloc = alloc ? alloc * 2 : 1024;
+						seek_index_entry *entries = realloc( index->entries, alloc * sizeof( seek_index_entry ) );
+						if ( !entries )
+						{
+							av_packet_unref( &pkt );
+							break;
+						}
+						index->entries = entries;
+					}
+					index->entries[ index->count ].pts = pts;
+					index->entries[ index->count ].pos = pkt.pos;
+					index->count++;
+				}
+			}
+			av_packet_unref( &pkt );
+		}
+		index->variable_frame_rate = vfr_counter >= VFR_THRESHOLD;
+	}
+	avformat_close_input( &context );
+
+	if ( index && ( self->seek_index_cancel || !index->count || index->entries == NULL ) )
+	{
+		seek_index_close( index );
+		index = NULL;
+	}
+	if ( index )
+		qsort( index->entries, index->count, sizeof( seek_index_entry ), seek_index_compare );
+	return index;
+}
+
+static void *seek_index_thread( void *arg )
+{
+	producer_avformat self = arg;
+	char fingerprint[ PATH_MAX + 64 ];
+
+	if ( !seek_index_fingerprint( self->seek_index_file, fingerprint, sizeof( fingerprint ) ) )
+	{
+		seek_index *index = seek_index_build( self, self->seek_index_file, self->video_index );
+		if ( index )
+		{
+			if ( self->seek_index_cache )
+				seek_index_save( index, self->seek_index_cache, fingerprint );
+			self->seek_index = index;
+			self->seek_index_ready = 1;
+			mlt_log_verbose( MLT_PRODUCER_SERVICE( self->parent ), "indexed %d keyframes\n", index->count );
+		}
+	}
+	return NULL;
+}
+
+/** Load the keyframe index of the file or start building it in the background.
+ *
+ * The index is enabled with the seek_index property, which defaults to on when
+ * the environment variable MLT_AVFORMAT_SEEK_INDEX names a directory to keep
+ * the indexes in. They are keyed by the path, size and modification time of
+ * the file.
+ */
+
+static void seek_index_open( producer_avformat self, const char *filename )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self->parent );
+	const char *directory = getenv( "MLT_AVFORMAT_SEEK_INDEX" );
+	char fingerprint[ PATH_MAX + 64 ];
+	int enabled = mlt_properties_get( properties, "seek_index" ) ? mlt_properties_get_int( properties, "seek_index" )
+		: directory && directory[0];
+
+	if ( !enabled || self->seek_index_started || self->seek_index_ready || self->video_index < 0 || !self->seekable
+		|| seek_index_fingerprint( filename, fingerprint, sizeof( fingerprint ) ) )
+		return;
+
+	self->seek_index_file = strdup( filename );
+	if ( directory && directory[0] )
+	{
+		// Name the index after a hash of the fingerprint
+		uint64_t hash = 1469598103934665603ULL;
+		const char *c;
+		for ( c = fingerprint; *c; c++ )
+			hash = ( hash ^ (unsigned char) *c ) * 1099511628211ULL;
+		self->seek_index_cache = calloc( 1, strlen( directory ) + 22 );
+		sprintf( self->seek_index_cache, "%s/%016" PRIx64 ".idx", directory, hash );
+
+		seek_index *index = seek_index_load( self->seek_index_cache, fingerprint, self->video_index );
+		if ( index )
+		{
+			self->seek_index = index;
+			self->seek_index_ready = 1;
+			return;
+		}
+	}
+	self->seek_index_started = !pthread_create( &self->seek_index_thread, NULL, seek_index_thread, self );
+}
+
+/** Find the last keyframe at or before a timestamp of the video stream.
+ *
+ * \return the keyframe or NULL if there is no complete index
+ */
+
+static seek_index_entry *seek_index_find( producer_avformat self, int64_t timestamp )
+{
+	seek_index *index = self->seek_index_ready ? self->seek_index : NULL;
+	if ( !index || index->stream != self->video_index || timestamp < index->entries[0].pts )
+		return NULL;
+
+	int low = 0, high = index->count - 1;
+	while ( low < high )
+	{
+		int middle = ( low + high + 1 ) / 2;
+		if ( index->entries[ middle ].pts <= timestamp )
+			low = middle;
+		else
+			high = middle - 1;
+	}
+	return &index->entries[ low ];
+}
+
+static void seek_index_stop( producer_avformat self )
+{
+	if ( self->seek_index_started )
+	{
+		self->seek_index_cancel = 1;
+		pthread_join( self->seek_index_thread, NULL );
+		self->seek_index_started = 0;
+	}
+	seek_index_close( self->seek_index );
+	self->seek_index = NULL;
+	self->seek_index_ready = 0;
+	free( self->seek_index_file );
+	free( self->seek_index_cache );
+	self->seek_index_file = NULL;
+	self->seek_index_cache = NULL;
+}
+
+/** The results of probing files, shared by the producers of the same file.
+ *
+ * Each entry holds the properties that opening the file set and is keyed by
+ * the size, modification time and path of the file and the frame rate of the
+ * profile. When the environment variable MLT_AVFORMAT_PROBE_CACHE names a
+ * directory, the entries are also kept there for other processes.
+ */
+
+#define PROBE_CACHE_MAGIC "MLTPROBE1"
+
+static mlt_properties probe_cache = NULL;
+static pthread_mutex_t probe_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char *probe_cache_path( const char *key )
+{
+	const char *directory = getenv( "MLT_AVFORMAT_PROBE_CACHE" );
+	uint64_t hash = 1469598103934665603ULL;
+	const char *c;
+
+	if ( !directory || !directory[0] )
+		return NULL;
+	for ( c = key; *c; c++ )
+		hash = ( hash ^ (unsigned char) *c ) * 1099511628211ULL;
+	char *path = calloc( 1, strlen( directory ) + 24 );
+	if ( path )
+		sprintf( path, "%s/%016" PRIx64 ".probe", directory, hash );
+	return path;
+}
+
+static mlt_properties probe_cache_load( const char *key )
+{
+	char *path = probe_cache_path( key );
+	FILE *file = path ? fopen( path, "rb" ) : NULL;
+	mlt_properties entry = NULL;
+	char line[ PATH_MAX + 64 ];
+	int count = 0;
+
+	free( path );
+	if ( !file )
+		return NULL;
+	if ( fgets( line, sizeof( line ), file ) && !strcmp( line, PROBE_CACHE_MAGIC "\n" )
+		 && fgets( line, sizeof( line ), file ) && !strncmp( line, key, strlen( key ) ) && line[ strlen( key ) ] == '\n'
+		 && fgets( line, sizeof( line ), file ) && sscanf( line, "%d", &count ) == 1 && count > 0 )
+	{
+		entry = mlt_properties_new();
+		while ( entry && count-- > 0 )
+		{
+			char size[ 32 ];
+			size_t length = 0;
+			char *value = NULL;
+			if ( !fgets( line, sizeof( line ), file ) || !strchr( line, '\n' ) || !fgets( size, sizeof( size ), file )
+				 || sscanf( size, "%zu", &length ) != 1 || length > 1024 * 1024 || !( value = malloc( length + 1 ) )
+				 || fread( value, 1, length, file ) != length || fgetc( file ) != '\n' )
+			{
+				free( value );
+				mlt_properties_close( entry );
+				entry = NULL;
+				break;
+			}
+			value[ length ] = '\0';
+			*strchr( line, '\n' ) = '\0';
+			mlt_properties_set( entry, line, value );
+			free( value );
+		}
+	}
+	fclose( file );
+	return entry;
+}
+
+static void probe_cache_save( const char *key, mlt_properties entry )
+{
+	char *path = probe_cache_path( key );
+	if ( !path )
+		return;
+
+	char *temp = calloc( 1, strlen( path ) + 16 );
+	sprintf( temp, "%s.%d", path, (int) getpid() );
+	FILE *file = fopen( temp, "wb" );
+	if ( file )
+	{
+		int i, count = mlt_properties_count( entry );
+		int error = fprintf( file, "%s\n%s\n%d\n", PROBE_CACHE_MAGIC, key, count ) < 0;
+		for ( i = 0; i < count && !error; i++ )
+		{
+			const char *value = mlt_properties_get_value( entry, i );
+			error = fprintf( file, "%s\n%zu\n%s\n", mlt_properties_get_name( entry, i ), strlen( value ), value ) < 0;
+		}
+		error |= fclose( file ) != 0;
+		if ( error || rename( temp, path ) )
+			remove( temp );
+	}
+	free( temp );
+	free( path );
+}
+
+/** Get the cached entry of the producer's file, loading it from disk if needed.
+ *
+ * \return the entry, only to be used while probe_cache_mutex is locked
+ */
+
+static mlt_properties probe_cache_entry( producer_avformat self )
+{
+	mlt_properties entry = self->probe_key && probe_cache ?
+		mlt_properties_get_data( probe_cache, self->probe_key, NULL ) : NULL;
+	if ( !entry && self->probe_key && ( entry = probe_cache_load( self->probe_key ) ) )
+	{
+		if ( !probe_cache )
+		{
+			probe_cache = mlt_properties_new();
+			mlt_factory_register_for_clean_up( probe_cache, (mlt_destructor) mlt_properties_close );
+		}
+		mlt_properties_set_data( probe_cache, self->probe_key, entry, 0, (mlt_destructor) mlt_properties_close, NULL );
+	}
+	return entry;
+}
+
+/** Set up the producer from what probing the same file found before.
+ *
+ * \return true if the file needs no probing
+ */
+
+static int probe_cache_restore( producer_avformat self, mlt_profile profile, const char *filename )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self->parent );
+	char fingerprint[ PATH_MAX + 64 ];
+	int restored = 0;
+
+	if ( !filename || seek_index_fingerprint( filename, fingerprint, sizeof( fingerprint ) ) )
+		return 0;
+	self->probe_key = malloc( strlen( fingerprint ) + 32 );
+	if ( !self->probe_key )
+		return 0;
+	sprintf( self->probe_key, "%d/%d %s", profile->frame_rate_num, profile->frame_rate_den, fingerprint );
+
+	pthread_mutex_lock( &probe_cache_mutex );
+	mlt_properties entry = probe_cache_entry( self );
+	if ( entry )
+	{
+		int i, count = mlt_properties_count( entry );
+		mlt_events_block( properties, self->parent );
+		for ( i = 0; i < count; i++ )
+		{
+			const char *name = mlt_properties_get_name( entry, i );
+			if ( name[0] != '_' )
+				mlt_properties_set( properties, name, mlt_properties_get_value( entry, i ) );
+		}
+		mlt_events_unblock( properties, self->parent );
+		self->audio_index = mlt_properties_get_int( entry, "_audio_index" );
+		self->video_index = mlt_properties_get_int( entry, "_video_index" );
+		self->seekable = self->video_seekable = 1;
+		restored = 1;
+	}
+	pthread_mutex_unlock( &probe_cache_mutex );
+	return restored;
+}
+
+/** Remember what probing a seekable file found for the next producers of it.
+ */
+
+static void probe_cache_store( producer_avformat self )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self->parent );
+	int i, count = mlt_properties_count( properties );
+
+	if ( !self->probe_key )
+		return;
+	mlt_properties entry = mlt_properties_new();
+	if ( !entry )
+		return;
+	for ( i = 0; i < count; i++ )
+	{
+		const char *name = mlt_properties_get_name( properties, i );
+		const char *value = mlt_properties_get_value( properties, i );
+		if ( name && value && name[0] != '_' && strcmp( name, "resource" ) )
+			mlt_properties_set( entry, name, value );
+	}
+	mlt_properties_set_int( entry, "_audio_index", self->audio_index );
+	mlt_properties_set_int( entry, "_video_index", self->video_index );
+
+	pthread_mutex_lock( &probe_cache_mutex );
+	if ( !probe_cache )
+	{
+		probe_cache = mlt_properties_new();
+		mlt_factory_register_for_clean_up( probe_cache, (mlt_destructor) mlt_properties_close );
+	}
+	mlt_properties_set_data( probe_cache, self->probe_key, entry, 0, (mlt_destructor) mlt_properties_close, NULL );
+	probe_cache_save( self->probe_key, entry );
+	pthread_mutex_unlock( &probe_cache_mutex );
+}
+
+/** Get the first PTS of a video stream that an earlier producer of the file found.
+ *
+ * \return true if it is known
+ */
+
+static int probe_cache_first_pts( producer_avformat self, int video_index )
+{
+	char name[ 64 ];
+	int found = 0;
+
+	pthread_mutex_lock( &probe_cache_mutex );
+	mlt_properties entry = probe_cache_entry( self );
+	snprintf( name, sizeof( name ), "_first_pts.%d", video_index );
+	if ( entry && mlt_properties_get( entry, name ) )
+	{
+		self->first_pts = mlt_properties_get_int64( entry, name );
+		snprintf( name, sizeof( name ), "_vfr.%d", video_index );
+		if ( mlt_properties_get_int( entry, name ) )
+			mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( self->parent ), "meta.media.variable_frame_rate", 1 );
+		found = 1;
+	}
+	pthread_mutex_unlock( &probe_cache_mutex );
+	return found;
+}
+
+static void probe_cache_set_first_pts( producer_avformat self, int video_index, int vfr )
+{
+	char name[ 64 ];
+
+	pthread_mutex_lock( &probe_cache_mutex );
+	mlt_properties entry = probe_cache_entry( self );
+	if ( entry )
+	{
+		snprintf( name, sizeof( name ), "_first_pts.%d", video_index );
+		mlt_properties_set_int64( entry, name, self->first_pts );
+		snprintf( name, sizeof( name ), "_vfr.%d", video_index );
+		mlt_properties_set_int( entry, name, vfr );
+		probe_cache_save( self->probe_key, entry );
+	}
+	pthread_mutex_unlock( &probe_cache_mutex );
+}
+
+/** Queue a packet that a reader wants, dropping the rest.
+ *
+ * \return true if the packet was not queued
+ */
+
+static int demuxer_queue( producer_avformat self, demuxer *demux, AVPacket *pkt )
+{
+	int index = pkt->stream_index;
+	int queue = -1;
+
+	if ( index == self->video_index )
+		queue = DEMUX_VIDEO;
+	else if ( index == self->audio_index || ( self->audio_index == INT_MAX && index < demux->context->nb_streams
+		&& demux->context->streams[ index ]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO ) )
+		queue = DEMUX_AUDIO;
+	if ( queue < 0 || !demux->wants[ queue ] )
+		return 1;
+
+	AVPacket *queued = av_packet_alloc();
+	if ( !queued )
+		return 1;
+	av_packet_move_ref( queued, pkt );
+	demux->bytes[ queue ] += queued->size;
+	if ( queued->duration > 0 && index < demux->context->nb_streams )
+		demux->duration[ queue ] += queued->duration * av_q2d( demux->context->streams[ index ]->time_base );
+	mlt_deque_push_back( demux->queue[ queue ], queued );
+	return 0;
+}
+
+static void demuxer_flush( demuxer *demux )
+{
+	int queue;
+	for ( queue = 0; queue < 2; queue++ )
+	{
+		AVPacket *pkt;
+		while ( ( pkt = mlt_deque_pop_front( demux->queue[ queue ] ) ) )
+			av_packet_free( &pkt );
+		demux->bytes[ queue ] = 0;
+		demux->duration[ queue ] = 0;
+	}
+}
+
+/** Determine if the thread should wait before reading another packet.
+ *
+ * A full queue stops the reading unless a reader waits on the other,
+ * empty queue, so that streams that are not closely interleaved can be
+ * read. A queue at twice its limit always stops it, and sets blocked so
+ * that a reader of the other queue does not wait for a packet that the
+ * thread cannot read.
+ */
+
+static int demuxer_full( demuxer *demux )
+{
+	int queue, full = 0;
+
+	demux->blocked = 0;
+	for ( queue = 0; queue < 2; queue++ )
+		if ( demux->bytes[ queue ] >= 2 * demux->max_bytes || demux->duration[ queue ] >= 2 * demux->max_duration )
+			demux->blocked = 1;
+	if ( demux->blocked )
+		return 1;
+	for ( queue = 0; queue < 2; queue++ )
+	{
+		if ( demux->waiting[ queue ] && !mlt_deque_count( demux->queue[ queue ] ) )
+			return 0;
+		if ( demux->bytes[ queue ] >= demux->max_bytes || demux->duration[ queue ] >= demux->max_duration )
+			full = 1;
+	}
+	return full;
+}
+
+static void *demuxer_thread( void *arg )
+{
+	demuxer *demux = arg;
+	producer_avformat self = demux->owner;
+	AVPacket pkt;
+
+	av_init_packet( &pkt );
+	pthread_mutex_lock( &demux->mutex );
+	while ( !demux->stop )
+	{
+		if ( demux->seeking || demux->error || demuxer_full( demux ) )
+		{
+			// Wake the readers that wait in vain
+			if ( demux->blocked )
+				pthread_cond_broadcast( &demux->cond );
+			pthread_cond_wait( &demux->cond, &demux->mutex );
+			continue;
+		}
+		demux->reading = 1;
+		pthread_mutex_unlock( &demux->mutex );
+		int ret = av_read_frame( demux->context, &pkt );
+		pthread_mutex_lock( &demux->mutex );
+		demux->reading = 0;
+		if ( ret < 0 )
+			demux->error = ret;
+		else
+			demuxer_queue( self, demux, &pkt );
+		av_packet_unref( &pkt );
+		pthread_cond_broadcast( &demux->cond );
+	}
+	pthread_mutex_unlock( &demux->mutex );
+	return NULL;
+}
+
+/** Get the demuxer of a context, starting it if the demux_thread property is set.
+ *
+ * \return the demuxer or NULL to read the context inline
+ */
+
+static demuxer *demuxer_get( producer_avformat self, AVFormatContext *context )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self->parent );
+	demuxer **demux = context == self->video_format ? &self->video_demuxer : &self->audio_demuxer;
+
+	if ( *demux || !context || !( self->live || mlt_properties_get_int( properties, "demux_thread" ) ) )
+		return *demux;
+
+	// A shared context feeds both queues from one thread
+	if ( self->video_format == self->audio_format && ( self->video_demuxer || self->audio_demuxer ) )
+	{
+		*demux = self->video_demuxer ? self->video_demuxer : self->audio_demuxer;
+		return *demux;
+	}
+
+	demuxer *created = calloc( 1, sizeof( demuxer ) );
+	if ( !created )
+		return NULL;
+	created->owner = self;
+	created->context = context;
+	created->queue[ DEMUX_VIDEO ] = mlt_deque_init();
+	created->queue[ DEMUX_AUDIO ] = mlt_deque_init();
+	created->wants[ DEMUX_VIDEO ] = context == self->video_format;
+	created->wants[ DEMUX_AUDIO ] = context == self->audio_format;
+	created->max_bytes = mlt_properties_get( properties, "demux_queue_size" ) ?
+		mlt_properties_get_int64( properties, "demux_queue_size" ) : 16 * 1024 * 1024;
+	created->max_duration = mlt_properties_get( properties, "demux_queue_duration" ) ?
+		mlt_properties_get_double( properties, "demux_queue_duration" ) : self->live ? 1.0 : 5.0;
+	pthread_mutex_init( &created->mutex, NULL );
+	pthread_cond_init( &created->cond, NULL );
+
+	if ( pthread_create( &created->thread, NULL, demuxer_thread, created ) )
+	{
+		mlt_deque_close( created->queue[ DEMUX_VIDEO ] );
+		mlt_deque_close( created->queue[ DEMUX_AUDIO ] );
+		pthread_mutex_destroy( &created->mutex );
+		pthread_cond_destroy( &created->cond );
+		free( created );
+		return NULL;
+	}
+	*demux = created;
+	if ( self->video_format == self->audio_format )
+		self->video_demuxer = self->audio_demuxer = created;
+	return created;
+}
+
+/** Take the next packet of a queue like av_read_frame().
+ *
+ * \param timeout the most microseconds to wait for a packet or -1 to wait until there is one
+ * \return 0, AVERROR(EAGAIN) if the wait timed out or the error that stopped
+ * the reading once the queue is empty
+ */
+
+static int demuxer_read( demuxer *demux, int queue, AVPacket *pkt, int64_t timeout )
+{
+	int ret = 0;
+	struct timespec deadline;
+
+	if ( timeout >= 0 )
+	{
+		clock_gettime( CLOCK_REALTIME, &deadline );
+		deadline.tv_sec += ( deadline.tv_nsec + timeout * 1000 ) / 1000000000;
+		deadline.tv_nsec = ( deadline.tv_nsec + timeout * 1000 ) % 1000000000;
+	}
+	pthread_mutex_lock( &demux->mutex );
+	demux->waiting[ queue ]++;
+	pthread_cond_broadcast( &demux->cond );
+	while ( !mlt_deque_count( demux->queue[ queue ] ) && !demux->error && !demux->stop && !demux->blocked && ret != ETIMEDOUT )
+	{
+		if ( timeout >= 0 )
+			ret = pthread_cond_timedwait( &demux->cond, &demux->mutex, &deadline );
+		else
+			pthread_cond_wait( &demux->cond, &demux->mutex );
+	}
+	demux->waiting[ queue ]--;
+	if ( ret == ETIMEDOUT || ( demux->blocked && !mlt_deque_count( demux->queue[ queue ] ) && !demux->error && !demux->stop ) )
+	{
+		if ( ret != ETIMEDOUT )
+			mlt_log_verbose( MLT_PRODUCER_SERVICE( demux->owner->parent ), "the %s demux queue is full, the streams are not interleaved\n",
+				queue == DEMUX_VIDEO ? "audio" : "video" );
+		pthread_mutex_unlock( &demux->mutex );
+		return AVERROR( EAGAIN );
+	}
+	ret = 0;
+
+	AVPacket *queued = mlt_deque_pop_front( demux->queue[ queue ] );
+	if ( queued )
+	{
+		demux->bytes[ queue ] -= queued->size;
+		if ( queued->duration > 0 && queued->stream_index < demux->context->nb_streams )
+			demux->duration[ queue ] -= queued->duration * av_q2d( demux->context->streams[ queued->stream_index ]->time_base );
+		if ( !mlt_deque_count( demux->queue[ queue ] ) )
+			demux->bytes[ queue ] = demux->duration[ queue ] = 0;
+		av_packet_move_ref( pkt, queued );
+		av_packet_free( &queued );
+		pthread_cond_broadcast( &demux->cond );
+	}
+	else
+	{
+		ret = demux->error ? demux->error : AVERROR_EOF;
+	}
+	pthread_mutex_unlock( &demux->mutex );
+	return ret;
+}
+
+/** Get the number of video packets that live input has read ahead.
+ */
+
+static int live_buffer_depth( producer_avformat self )
+{
+	demuxer *demux = self->video_demuxer;
+	int depth = 0;
+
+	if ( demux )
 	{
-		while ( ( pkt = mlt_deque_pop_back( self->vpackets ) ) )
-		{
-			av_packet_unref( pkt );
-			free( pkt );
-		}
-		mlt_deque_close( self->vpackets );
-		self->vpackets = NULL;
+		pthread_mutex_lock( &demux->mutex );
+		depth = mlt_deque_count( demux->queue[ DEMUX_VIDEO ] );
+		pthread_mutex_unlock( &demux->mutex );
 	}
-	pthread_mutex_unlock( &self->audio_mutex );
-	mlt_service_unlock( MLT_PRODUCER_SERVICE( self->parent ) );
+	mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( self->parent ), "live_buffer_depth", depth );
+	return depth;
 }
 
-static int64_t best_pts( producer_avformat self, int64_t pts, int64_t dts )
+static int live_buffer_target( producer_avformat self )
 {
-	self->invalid_pts_counter += pts == AV_NOPTS_VALUE;
-	self->invalid_dts_counter += dts == AV_NOPTS_VALUE;
-	if ( ( self->invalid_pts_counter <= self->invalid_dts_counter
-		   || dts == AV_NOPTS_VALUE ) && pts != AV_NOPTS_VALUE )
-		return pts;
-	else
-		return dts;
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self->parent );
+	return mlt_properties_get( properties, "live_buffer" ) ? mlt_properties_get_int( properties, "live_buffer" ) : 2;
+}
+
+/** Get the duration of a source frame in the time base of the video stream.
+ */
+
+static int64_t live_frame_pts( producer_avformat self, double source_fps )
+{
+	double time_base = av_q2d( self->video_time_base );
+	return time_base > 0.0 && source_fps > 0.0 ? llrint( 1.0 / ( time_base * source_fps ) ) : 0;
+}
+
+/** Hold the demuxer of a context outside av_read_frame() to use the context directly.
+ *
+ * \return the locked demuxer to give to demuxer_resume() or NULL if there is none
+ */
+
+static demuxer *demuxer_pause( producer_avformat self, AVFormatContext *context )
+{
+	demuxer *demux = context == self->video_format ? self->video_demuxer : self->audio_demuxer;
+
+	if ( !demux || demux->context != context )
+		return NULL;
+	pthread_mutex_lock( &demux->mutex );
+	demux->seeking = 1;
+	while ( demux->reading )
+		pthread_cond_wait( &demux->cond, &demux->mutex );
+	return demux;
+}
+
+/** Drop the packets read ahead of a paused demuxer and let it read on from the new position.
+ */
+
+static void demuxer_resume( demuxer *demux )
+{
+	if ( !demux )
+		return;
+	demuxer_flush( demux );
+	demux->error = 0;
+	demux->seeking = 0;
+	pthread_cond_broadcast( &demux->cond );
+	pthread_mutex_unlock( &demux->mutex );
+}
+
+/** Seek a context, through its demuxer if it has one.
+ */
+
+static int demuxer_seek( producer_avformat self, AVFormatContext *context, int stream_index, int64_t timestamp, int flags )
+{
+	demuxer *demux = demuxer_pause( self, context );
+	int ret = av_seek_frame( context, stream_index, timestamp, flags );
+	demuxer_resume( demux );
+	return ret;
+}
+
+static void demuxer_close( demuxer *demux )
+{
+	pthread_mutex_lock( &demux->mutex );
+	demux->stop = 1;
+	pthread_cond_broadcast( &demux->cond );
+	pthread_mutex_unlock( &demux->mutex );
+	pthread_join( demux->thread, NULL );
+	demuxer_flush( demux );
+	mlt_deque_close( demux->queue[ DEMUX_VIDEO ] );
+	mlt_deque_close( demux->queue[ DEMUX_AUDIO ] );
+	pthread_mutex_destroy( &demux->mutex );
+	pthread_cond_destroy( &demux->cond );
+	free( demux );
+}
+
+/** Stop the demuxers before their contexts close or are read directly.
+ */
+
+static void demuxer_stop( producer_avformat self )
+{
+	if ( self->video_demuxer )
+		demuxer_close( self->video_demuxer );
+	if ( self->audio_demuxer && self->audio_demuxer != self->video_demuxer )
+		demuxer_close( self->audio_demuxer );
+	self->video_demuxer = NULL;
+	self->audio_demuxer = NULL;
 }
 
 static void find_first_pts( producer_avformat self, int video_index )
@@ -1081,6 +2171,19 @@ static void find_first_pts( producer_avformat self, int video_index )
 	AVPacket pkt;
 	int64_t prev_pkt_duration = AV_NOPTS_VALUE;
 
+	// The keyframe index already knows
+	seek_index *index = self->seek_index_ready ? self->seek_index : NULL;
+	if ( index && index->stream == video_index && index->first_pts != AV_NOPTS_VALUE )
+	{
+		self->first_pts = index->first_pts;
+		if ( index->variable_frame_rate )
+			mlt_properties_set_int( MLT_PRODUCER_PROPERTIES(self->parent), "meta.media.variable_frame_rate", 1 );
+		return;
+	}
+	if ( probe_cache_first_pts( self, video_index ) )
+		return;
+
+	demuxer *demux = demuxer_pause( self, context );
 	av_init_packet( &pkt );
 	while ( ret >= 0 && pkt_countdown-- > 0 &&
 	      ( self->first_pts == AV_NOPTS_VALUE || ( vfr_counter < VFR_THRESHOLD && vfr_countdown > 0 ) ) )
@@ -1121,6 +2224,9 @@ static void find_first_pts( producer_avformat self, int video_index )
 	if ( vfr_counter >= VFR_THRESHOLD )
 		mlt_properties_set_int( MLT_PRODUCER_PROPERTIES(self->parent), "meta.media.variable_frame_rate", 1 );
 	av_seek_frame( context, -1, 0, AVSEEK_FLAG_BACKWARD );
+	demuxer_resume( demux );
+	if ( self->first_pts != AV_NOPTS_VALUE )
+		probe_cache_set_first_pts( self, video_index, vfr_counter >= VFR_THRESHOLD );
 }
 
 static int seek_video( producer_avformat self, mlt_position position,
@@ -1158,7 +2264,7 @@ static int seek_video( producer_avformat self, mlt_position position,
 			// We're paused - use last image
 			paused = 1;
 		}
-		else if ( position < self->video_expected || position - self->video_expected >= seek_threshold || self->last_position < 0 )
+		else if ( self->seek_keyframes || position < self->video_expected || position - self->video_expected >= seek_threshold || self->last_position < 0 )
 		{
 			// Calculate the timestamp for the requested frame
 			int64_t timestamp = req_position / ( av_q2d( self->video_time_base ) * source_fps );
@@ -1168,7 +2274,17 @@ static int seek_video( producer_avformat self, mlt_position position,
 				timestamp += self->first_pts;
 			else if ( context->start_time != AV_NOPTS_VALUE )
 				timestamp += context->start_time;
-			if ( preseek && av_q2d( self->video_time_base ) != 0 )
+			// With an index, go straight to the keyframe that starts the GOP
+			seek_index_entry *keyframe = seek_index_find( self, timestamp );
+			if ( self->seek_keyframes && keyframe && keyframe->pts == self->seek_keyframe_pts
+				 && self->current_position != POSITION_INVALID )
+			{
+				// Still in the GOP of the last picture
+				pthread_mutex_unlock( &self->packets_mutex );
+				return 1;
+			}
+			self->seek_keyframe_pts = self->seek_keyframes && keyframe ? keyframe->pts : AV_NOPTS_VALUE;
+			if ( !keyframe && preseek && av_q2d( self->video_time_base ) != 0 )
 				timestamp -= 2 / av_q2d( self->video_time_base );
 			if ( timestamp < 0 )
 				timestamp = 0;
@@ -1177,7 +2293,17 @@ static int seek_video( producer_avformat self, mlt_position position,
 
 			// Seek to the timestamp
 			codec_context->skip_loop_filter = AVDISCARD_NONREF;
-			av_seek_frame( context, self->video_index, timestamp, AVSEEK_FLAG_BACKWARD );
+			int seeked = 0;
+			if ( keyframe )
+			{
+				// Byte offsets avoid the timestamp search of formats like MPEG-TS
+				if ( keyframe->pos >= 0 && !( context->iformat->flags & AVFMT_NO_BYTE_SEEK ) )
+					seeked = demuxer_seek( self, context, self->video_index, keyframe->pos, AVSEEK_FLAG_BYTE ) >= 0;
+				if ( !seeked )
+					seeked = demuxer_seek( self, context, self->video_index, keyframe->pts, AVSEEK_FLAG_BACKWARD ) >= 0;
+			}
+			if ( !seeked )
+				demuxer_seek( self, context, self->video_index, timestamp, AVSEEK_FLAG_BACKWARD );
 
 			// flush any pictures still in decode buffer
 			avcodec_flush_buffers( codec_context );
@@ -1251,6 +2377,14 @@ static mlt_image_format pick_image_format( enum AVPixelFormat pix_fmt )
 	case AV_PIX_FMT_YUVJ420P:
 	case AV_PIX_FMT_YUVA420P:
 		return mlt_image_yuv420p;
+	case AV_PIX_FMT_YUV420P10LE:
+		return mlt_image_yuv420p10;
+	case AV_PIX_FMT_NV12:
+		return mlt_image_nv12;
+	case AV_PIX_FMT_P010LE:
+		return mlt_image_p010;
+	case AV_PIX_FMT_RGBA64LE:
+		return mlt_image_rgba64;
 	case AV_PIX_FMT_RGB24:
 	case AV_PIX_FMT_BGR24:
 	case AV_PIX_FMT_GRAY8:
@@ -1520,6 +2654,38 @@ static int convert_image( producer_avformat self, AVFrame *frame, uint8_t *buffe
 			out_data, out_stride);
 		sws_freeContext( context );
 	}
+	else if ( *format == mlt_image_yuv420p10 || *format == mlt_image_nv12 || *format == mlt_image_p010 ||
+		*format == mlt_image_rgba64 || *format == mlt_image_yuv422p16 )
+	{
+		// High bit depth and hardware layouts keep their range like yuv420p,
+		// and a decoder already producing the layout is only copied.
+		int dst_pix_fmt = *format == mlt_image_yuv420p10 ? AV_PIX_FMT_YUV420P10LE
+			: *format == mlt_image_nv12 ? AV_PIX_FMT_NV12
+			: *format == mlt_image_p010 ? AV_PIX_FMT_P010LE
+			: *format == mlt_image_rgba64 ? AV_PIX_FMT_RGBA64LE
+			: AV_PIX_FMT_YUV422P16LE;
+		uint8_t *out_data[4];
+		int out_stride[4];
+		mlt_image_format_planes( *format, width, height, buffer, out_data, out_stride );
+		if ( pix_fmt == dst_pix_fmt && frame->width == width && frame->height == height )
+		{
+			av_image_copy( out_data, out_stride, (const uint8_t **) frame->data, frame->linesize,
+				dst_pix_fmt, width, height );
+		}
+		else
+		{
+			int flags = mlt_get_sws_flags(width, height, src_pix_fmt, width, height, dst_pix_fmt);
+			struct SwsContext *context = sws_getContext( width, height, src_pix_fmt,
+				width, height, dst_pix_fmt, flags, NULL, NULL, NULL);
+			if ( *format == mlt_image_rgba64 )
+				mlt_set_luma_transfer( context, self->yuv_colorspace, 601, self->full_luma, 0 );
+			else if ( !mlt_set_luma_transfer( context, self->yuv_colorspace, profile->colorspace, self->full_luma, self->full_luma ) )
+				result = profile->colorspace;
+			sws_scale( context, (const uint8_t* const*) frame->data, frame->linesize, 0, height,
+				out_data, out_stride);
+			sws_freeContext( context );
+		}
+	}
 	else
 #if defined(FFUDIV) && (LIBSWSCALE_VERSION_INT >= ((3<<16)+(1<<8)+101))
 	{
@@ -1624,15 +2790,59 @@ static int allocate_buffer( mlt_frame frame, AVCodecParameters *codec_params, ui
 		return size;
 
 	size = mlt_image_format_size( format, width, height, NULL );
-	*buffer = mlt_pool_alloc( size );
+	*buffer = mlt_image_buffer_alloc( size );
 	if ( *buffer )
-		mlt_frame_set_image( frame, *buffer, size, mlt_pool_release );
+		mlt_frame_set_image( frame, *buffer, size, mlt_image_buffer_release );
 	else
 		size = 0;
 
 	return size;
 }
 
+#if USE_HWACCEL
+/** Download a hardware surface into system memory, replacing it in place.
+*/
+
+static int download_hwframe( producer_avformat self, AVFrame *frame )
+{
+	AVFrame *sw_video_frame = av_frame_alloc();
+	int result = av_hwframe_transfer_data( sw_video_frame, frame, 0 );
+	if ( result < 0 )
+	{
+		mlt_log_error( MLT_PRODUCER_SERVICE(self->parent), "av_hwframe_transfer_data() failed %d\n", result );
+		av_frame_free( &sw_video_frame );
+		return result;
+	}
+	av_frame_copy_props( sw_video_frame, frame );
+	sw_video_frame->width = frame->width;
+	sw_video_frame->height = frame->height;
+
+	av_frame_unref( frame );
+	av_frame_move_ref( frame, sw_video_frame );
+	av_frame_free( &sw_video_frame );
+	return 0;
+}
+
+static void release_hwframe( void *data )
+{
+	AVFrame *frame = data;
+	av_frame_free( &frame );
+}
+
+/** Set a reference to a hardware surface as the image of a frame.
+*/
+
+static int set_hwframe_image( mlt_frame frame, AVFrame *hw_frame, uint8_t **buffer )
+{
+	AVFrame *clone = av_frame_clone( hw_frame );
+	if ( !clone )
+		return 0;
+	*buffer = (uint8_t*) clone;
+	mlt_frame_set_image( frame, *buffer, sizeof( AVFrame ), release_hwframe );
+	return sizeof( AVFrame );
+}
+#endif
+
 static int ignore_send_packet_result(int result)
 {
 	return result >= 0 || result == AVERROR(EAGAIN) || result == AVERROR_EOF || result == AVERROR_INVALIDDATA || result == AVERROR(EINVAL);
@@ -1641,6 +2851,41 @@ static int ignore_send_packet_result(int result)
 /** Get an image from a frame.
 */
 
+/** Keep a decoded picture before the requested one to play it backwards later.
+ */
+
+static void reverse_cache_put( producer_avformat self, AVCodecParameters *codec_params, mlt_image_format format,
+	int64_t source_position, double source_fps )
+{
+	mlt_producer producer = self->parent;
+	mlt_frame cached = mlt_frame_init( MLT_PRODUCER_SERVICE( producer ) );
+	uint8_t *buffer = NULL;
+	uint8_t *alpha = NULL;
+	int width, height;
+
+	if ( !cached )
+		return;
+	mlt_properties_set_position( MLT_FRAME_PROPERTIES( cached ), "original_position",
+		llrint( source_position / source_fps * mlt_producer_get_fps( producer ) ) );
+	set_image_size( self, &width, &height );
+	if ( allocate_buffer( cached, codec_params, &buffer, format, width, height ) )
+	{
+#if USE_HWACCEL
+		int yuv_colorspace = convert_image( self, self->video_frame, buffer, self->video_frame->format,
+			&format, width, height, &alpha );
+#else
+		int yuv_colorspace = convert_image( self, self->video_frame, buffer, codec_params->format,
+			&format, width, height, &alpha );
+#endif
+		if ( alpha )
+			mlt_frame_set_alpha( cached, alpha, width * height, mlt_pool_release );
+		mlt_properties_set_int( MLT_FRAME_PROPERTIES( cached ), "format", format );
+		mlt_properties_set_int( MLT_FRAME_PROPERTIES( cached ), "colorspace", yuv_colorspace );
+		mlt_cache_put_frame( self->reverse_cache, cached );
+	}
+	mlt_frame_close( cached );
+}
+
 static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_format *format, int *width, int *height, int writable )
 {
 	// Get the producer
@@ -1661,6 +2906,8 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 	int got_picture = 0;
 	int image_size = 0;
 
+	pthread_rwlock_rdlock( &self->idle_lock );
+	self->idle_used = idle_now();
 	pthread_mutex_lock( &self->video_mutex );
 	mlt_service_lock( MLT_PRODUCER_SERVICE( producer ) );
 	mlt_log_timings_begin();
@@ -1707,10 +2954,48 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 		// set cache size if supplied
 		if ( self->image_cache && cache_supplied )
 			mlt_cache_set_size( self->image_cache, cache_size );
+		// limit the memory used by the cache if requested
+		if ( self->image_cache && mlt_properties_get( properties, "cache_bytes" ) )
+			mlt_cache_set_max_bytes( self->image_cache, mlt_properties_get_int64( properties, "cache_bytes" ) );
+		if ( self->image_cache )
+			self->image_cache_size = mlt_cache_get_size( self->image_cache );
+		self->memory_pressure = mlt_memory_pressure_none;
+	}
+
+	// Keep fewer images under memory pressure
+	int memory_pressure = mlt_factory_get_memory_pressure();
+	if ( self->image_cache && memory_pressure != self->memory_pressure )
+	{
+		int size = self->image_cache_size;
+		if ( memory_pressure == mlt_memory_pressure_critical )
+			size = 1;
+		else if ( memory_pressure == mlt_memory_pressure_moderate )
+			size = MAX( 1, size / 2 );
+		mlt_cache_set_size( self->image_cache, size );
+		self->memory_pressure = memory_pressure;
+	}
+
+	// Playing backwards decodes each GOP once and serves it from the end
+	double speed = mlt_producer_get_speed(producer);
+	int64_t reverse_bytes = mlt_properties_get( properties, "reverse_cache_bytes" ) ?
+		mlt_properties_get_int64( properties, "reverse_cache_bytes" ) : 256 * 1024 * 1024;
+	if ( speed < 0.0 && reverse_bytes > 0 && !is_album_art && !self->reverse_cache )
+	{
+		self->reverse_cache = mlt_cache_init();
+		mlt_cache_set_size( self->reverse_cache, REVERSE_CACHE_FRAMES );
+		mlt_cache_set_max_bytes( self->reverse_cache, reverse_bytes );
+	}
+	else if ( speed >= 0.0 && self->reverse_cache )
+	{
+		mlt_cache_close( self->reverse_cache );
+		self->reverse_cache = NULL;
 	}
-	if ( self->image_cache )
+
+	if ( self->image_cache || self->reverse_cache )
 	{
-		mlt_frame original = mlt_cache_get_frame( self->image_cache, position );
+		mlt_frame original = self->image_cache ? mlt_cache_get_frame( self->image_cache, position ) : NULL;
+		if ( !original && self->reverse_cache )
+			original = mlt_cache_get_frame( self->reverse_cache, position );
 		if ( original )
 		{
 			mlt_properties orig_props = MLT_FRAME_PROPERTIES( original );
@@ -1719,8 +3004,8 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 			*buffer = mlt_properties_get_data( orig_props, "alpha", &size );
 			if (*buffer)
 				mlt_frame_set_alpha( frame, *buffer, size, NULL );
-			*buffer = mlt_properties_get_data( orig_props, "image", &size );
-			mlt_frame_set_image( frame, *buffer, size, NULL );
+			*buffer = mlt_frame_share_image( original, &size );
+			mlt_frame_set_image( frame, *buffer, size, mlt_image_buffer_release );
 			mlt_properties_set_data( frame_properties, "avformat.image_cache", original, 0, (mlt_destructor) mlt_frame_close, NULL );
 			*format = mlt_properties_get_int( orig_props, "format" );
 			set_image_size( self, width, height );
@@ -1744,8 +3029,11 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 
 	double delay = mlt_properties_get_double( properties, "video_delay" );
 
+	// Only decode the keyframe before the requested frame for thumbnails and scrubbing
+	const char *seek_mode = mlt_properties_get( properties, "seek_mode" );
+	self->seek_keyframes = must_decode && !is_album_art && seek_mode && !strcmp( seek_mode, "keyframe" );
+
 	// Seek if necessary
-	double speed = mlt_producer_get_speed(producer);
 	int preseek = must_decode && codec_context->has_b_frames && speed >= 0.0 && speed <= 1.0;
 	int paused = seek_video( self, position, req_position, preseek );
 
@@ -1754,6 +3042,7 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 	stream = context->streams[ self->video_index ];
 	codec_context = stream->codec;
 	codec_params = stream->codecpar;
+	codec_context->skip_frame = self->seek_keyframes ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
 	if ( *format == mlt_image_none || *format == mlt_image_movit ||
 			codec_params->format == AV_PIX_FMT_ARGB ||
 			codec_params->format == AV_PIX_FMT_RGBA ||
@@ -1776,13 +3065,45 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 			)
 		*format = mlt_image_rgba;
 
+	// A hardware surface is only passed on when decoding on the device without filters.
+	int hwframe = 0;
+	if ( *format == mlt_image_hwframe )
+	{
+#if USE_HWACCEL
+		hwframe = self->hwaccel.device_ctx && !( self->autorotate && self->vfilter_graph );
+#endif
+		if ( !hwframe )
+			*format = pick_image_format( codec_params->format );
+	}
+
 	// Duplicate the last image if necessary
-	if ( self->video_frame && self->video_frame->linesize[0]
+	if ( self->video_frame && ( self->video_frame->linesize[0] || self->video_frame->hw_frames_ctx )
 		 && (self->pkt.stream_index == self->video_index )
 		 && ( paused || self->current_position >= req_position ) )
 	{
 		// Duplicate it
 		set_image_size( self, width, height );
+#if USE_HWACCEL
+		if ( self->video_frame->hw_frames_ctx )
+		{
+			if ( hwframe )
+			{
+				if ( ( image_size = set_hwframe_image( frame, self->video_frame, buffer ) ) )
+				{
+					mlt_properties_set_int( frame_properties, "colorspace", self->yuv_colorspace );
+					got_picture = 1;
+				}
+				goto exit_duplicate;
+			}
+			if ( download_hwframe( self, self->video_frame ) < 0 )
+				goto exit_get_image;
+		}
+		else if ( hwframe )
+		{
+			hwframe = 0;
+			*format = pick_image_format( self->video_frame->format );
+		}
+#endif
 		if ( ( image_size = allocate_buffer( frame, codec_params, buffer, *format, *width, *height ) ) )
 		{
 			int yuv_colorspace;
@@ -1796,6 +3117,10 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 			mlt_properties_set_int( frame_properties, "colorspace", yuv_colorspace );
 			got_picture = 1;
 		}
+#if USE_HWACCEL
+exit_duplicate:
+		;
+#endif
 	}
 	else
 	{
@@ -1808,7 +3133,7 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 		else
 			av_frame_unref( self->video_frame );
 
-		while (!got_picture && ignore_send_packet_result(self->video_send_result))
+		while (!got_picture && !mlt_frame_is_cancelled( frame ) && ignore_send_packet_result(self->video_send_result))
 		{
 			if ( self->video_send_result != AVERROR( EAGAIN ) )
 			{
@@ -1817,7 +3142,8 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 					av_packet_unref( &self->pkt );
 				av_init_packet( &self->pkt );
 				pthread_mutex_lock( &self->packets_mutex );
-				if ( mlt_deque_count( self->vpackets ) )
+				demuxer *demux = demuxer_get( self, context );
+				if ( !demux && mlt_deque_count( self->vpackets ) )
 				{
 					AVPacket *tmp = (AVPacket*) mlt_deque_pop_front( self->vpackets );
 					av_packet_ref( &self->pkt, tmp );
@@ -1825,8 +3151,31 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 				}
 				else
 				{
-					int ret = av_read_frame( context, &self->pkt );
-					if ( ret >= 0 && !self->video_seekable && self->pkt.stream_index == self->audio_index )
+					int ret;
+					if ( demux )
+					{
+						// The demuxer sorts the packets, so only wait for video.
+						// Live input waits a frame at most once there is a picture to repeat.
+						int64_t timeout = self->live && self->last_good_frame ?
+							llrint( 1000000.0 / mlt_producer_get_fps( producer ) ) : -1;
+						pthread_mutex_unlock( &self->packets_mutex );
+						ret = demuxer_read( demux, DEMUX_VIDEO, &self->pkt, timeout );
+						pthread_mutex_lock( &self->packets_mutex );
+						if ( ret == AVERROR( EAGAIN ) )
+						{
+							// Underrun: repeat the last picture and let a live source be a frame later
+							if ( timeout >= 0 && self->first_pts != AV_NOPTS_VALUE )
+								self->first_pts -= live_frame_pts( self, source_fps );
+							self->pkt.stream_index = -1;
+							pthread_mutex_unlock( &self->packets_mutex );
+							break;
+						}
+					}
+					else
+					{
+						ret = av_read_frame( context, &self->pkt );
+					}
+					if ( ret >= 0 && !demux && !self->video_seekable && self->pkt.stream_index == self->audio_index )
 					{
 						mlt_deque_push_back( self->apackets, av_packet_clone( &self->pkt ) );
 					}
@@ -1900,6 +3249,11 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 					codec_context->reordered_opaque = int_position;
 					if ( int_position >= req_position )
 						codec_context->skip_loop_filter = AVDISCARD_NONE;
+					// Catching up to a later frame, as when the consumer skips late frames,
+					// needs only the frames before it that are referenced
+					if ( !self->seek_keyframes && !self->reverse_cache )
+						codec_context->skip_frame = pts != AV_NOPTS_VALUE && int_position + 1 < req_position ?
+							AVDISCARD_NONREF : AVDISCARD_DEFAULT;
 					self->video_send_result = avcodec_send_packet( codec_context, &self->pkt );
 					mlt_log_debug( MLT_PRODUCER_SERVICE( producer ), "decoded video packet with size %d => %d\n", self->pkt.size, self->video_send_result );
 					// Note: decode may fail at the beginning of MPEGfile (B-frames referencing before first I-frame), so allow a few errors.
@@ -1921,23 +3275,11 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 						else
 						{
 #if USE_HWACCEL
-							if (self->hwaccel.device_ctx && self->video_frame->format == self->hwaccel.pix_fmt)
+							// Keep the surface on the device when the caller accepts it
+							if ( !hwframe && self->hwaccel.device_ctx && self->video_frame->format == self->hwaccel.pix_fmt )
 							{
-								AVFrame *sw_video_frame = av_frame_alloc();
-								int transfer_data_result = av_hwframe_transfer_data(sw_video_frame, self->video_frame, 0);
-								if(transfer_data_result < 0) 
-								{
-									mlt_log_error( MLT_PRODUCER_SERVICE(producer), "av_hwframe_transfer_data() failed %d\n", transfer_data_result);
-									av_frame_free(&sw_video_frame);
+								if ( download_hwframe( self, self->video_frame ) < 0 )
 									goto exit_get_image;
-								}
-								av_frame_copy_props(sw_video_frame, self->video_frame);
-								sw_video_frame->width = self->video_frame->width;
-								sw_video_frame->height = self->video_frame->height;
-
-								av_frame_unref(self->video_frame);
-								av_frame_move_ref(self->video_frame, sw_video_frame);
-								av_frame_free(&sw_video_frame);
 							}
 #endif
 							got_picture = 1;
@@ -1966,8 +3308,25 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 						int_position = ( int64_t )( ( av_q2d( self->video_time_base ) * pts + delay ) * source_fps + 0.5 );
 					}
 
-					if ( int_position < req_position )
+					if ( got_picture && int_position >= req_position && self->live
+						 && live_buffer_depth( self ) > live_buffer_target( self ) )
+					{
+						// Overrun: drop this picture and let the source be a frame earlier
+						if ( self->first_pts != AV_NOPTS_VALUE )
+							self->first_pts += live_frame_pts( self, source_fps );
+						mlt_log_debug( MLT_PRODUCER_SERVICE( producer ), "live buffer overrun, dropping a frame\n" );
+						got_picture = 0;
+					}
+					else if ( int_position < req_position && !self->seek_keyframes )
+					{
+						int filtered = 0;
+#ifdef AVFILTER
+						filtered = self->autorotate && self->vfilter_graph;
+#endif
+						if ( self->reverse_cache && must_decode && !hwframe && !filtered )
+							reverse_cache_put( self, codec_params, *format, int_position, source_fps );
 						got_picture = 0;
+					}
 					else if ( int_position >= req_position )
 						codec_context->skip_loop_filter = AVDISCARD_NONE;
 				}
@@ -1999,6 +3358,28 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 				}
 #endif
 				set_image_size( self, width, height );
+#if USE_HWACCEL
+				if ( hwframe && !self->video_frame->hw_frames_ctx )
+				{
+					// The decoder fell back to software
+					hwframe = 0;
+					*format = pick_image_format( self->video_frame->format );
+				}
+				if ( hwframe )
+				{
+					if ( ( image_size = set_hwframe_image( frame, self->video_frame, buffer ) ) )
+					{
+						mlt_properties_set_int( frame_properties, "colorspace", self->yuv_colorspace );
+						self->top_field_first |= self->video_frame->top_field_first;
+						self->current_position = int_position;
+					}
+					else
+					{
+						got_picture = 0;
+					}
+				}
+				else
+#endif
 				if ( ( image_size = allocate_buffer( frame, codec_params, buffer, *format, *width, *height ) ) )
 				{
 					int yuv_colorspace;
@@ -2033,11 +3414,16 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 	if ( alpha )
 		mlt_frame_set_alpha( frame, alpha, (*width) * (*height), mlt_pool_release );
 
-	if ( image_size > 0 )
+	if ( image_size > 0 && *format == mlt_image_hwframe )
 	{
+		// A device surface is neither cached nor kept for error concealment
 		mlt_properties_set_int( frame_properties, "format", *format );
-		// Cache the image for rapid repeated access.
-		if ( self->image_cache ) {
+	}
+	else if ( image_size > 0 )
+	{
+		mlt_properties_set_int( frame_properties, "format", *format );
+		// Cache the image for rapid repeated access, unless it only approximates the position.
+		if ( self->image_cache && !self->seek_keyframes ) {
 			if (is_album_art) {
 				mlt_position original_pos = mlt_frame_original_position( frame );
 				mlt_properties_set_position(frame_properties, "original_position", 0);
@@ -2055,7 +3441,7 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 			self->last_good_frame = mlt_frame_clone( frame, 1 );
 		}
 	}
-	else if ( self->last_good_frame )
+	else if ( self->last_good_frame && !mlt_frame_is_cancelled( frame ) )
 	{
 		// Use last known good frame if there was a decoding failure.
 		mlt_frame original = mlt_frame_clone( self->last_good_frame, 1 );
@@ -2065,8 +3451,8 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 		*buffer = mlt_properties_get_data( orig_props, "alpha", &size );
 		if (*buffer)
 			mlt_frame_set_alpha( frame, *buffer, size, NULL );
-		*buffer = mlt_properties_get_data( orig_props, "image", &size );
-		mlt_frame_set_image( frame, *buffer, size, NULL );
+		*buffer = mlt_frame_share_image( original, &size );
+		mlt_frame_set_image( frame, *buffer, size, mlt_image_buffer_release );
 		mlt_properties_set_data( frame_properties, "avformat.conceal_error", original, 0, (mlt_destructor) mlt_frame_close, NULL );
 		*format = mlt_properties_get_int( orig_props, "format" );
 		set_image_size( self, width, height );
@@ -2099,6 +3485,7 @@ exit_get_image:
 	mlt_properties_set_int( properties, "meta.media.top_field_first", self->top_field_first );
 	mlt_properties_set_int( properties, "meta.media.progressive", mlt_properties_get_int( frame_properties, "progressive" ) );
 	mlt_service_unlock( MLT_PRODUCER_SERVICE( producer ) );
+	pthread_rwlock_unlock( &self->idle_lock );
 
 	mlt_log_timings_end( NULL, __FUNCTION__ );
 
@@ -2203,6 +3590,26 @@ static int video_codec_init( producer_avformat self, int index, mlt_properties p
 
 		skip_hwaccel:
 #endif
+		if ( self->live )
+			codec_context->flags |= AV_CODEC_FLAG_LOW_DELAY;
+
+		// Let the decoder reduce the picture when the profile is much smaller
+		if ( codec && codec->max_lowres > 0 && mlt_properties_get_int( properties, "reduced_decode" ) )
+		{
+			mlt_profile profile = mlt_service_profile( MLT_PRODUCER_SERVICE( self->parent ) );
+			double theta = self->autorotate ? get_rotation( stream ) : 0.0;
+			int rotated = fabs( theta - 90.0 ) < 1.0 || fabs( theta - 270.0 ) < 1.0;
+			int width = rotated ? profile->height : profile->width;
+			int height = rotated ? profile->width : profile->height;
+			int lowres = 0;
+			while ( lowres < codec->max_lowres && ( codec_params->width >> ( lowres + 1 ) ) >= width
+					&& ( codec_params->height >> ( lowres + 1 ) ) >= height )
+				lowres++;
+			codec_context->lowres = lowres;
+			if ( lowres )
+				mlt_log_verbose( MLT_PRODUCER_SERVICE( self->parent ), "decoding at 1/%d size\n", 1 << lowres );
+		}
+
 		// If we don't have a codec and we can't initialise it, we can't do much more...
 		pthread_mutex_lock( &self->open_mutex );
 		if ( codec && avcodec_open2( codec_context, codec, NULL ) >= 0 )
@@ -2372,6 +3779,13 @@ static void producer_set_up_video( producer_avformat self, mlt_frame frame )
 
 	int unlock_needed = 0;
 
+	// There is only an audio context, or the consumer does not want the image
+	if ( self->audio_only || mlt_frame_is_video_off( frame ) )
+	{
+		mlt_properties_set_int( MLT_FRAME_PROPERTIES( frame ), "test_image", 1 );
+		return;
+	}
+
 	// Reopen the file if necessary
 	if ( !context && index > -1 )
 	{
@@ -2451,6 +3865,14 @@ static void producer_set_up_video( producer_avformat self, mlt_frame frame )
 			}
 			mlt_properties_set_double( frame_properties, "aspect_ratio", aspect_ratio );
 		}
+		if ( self->video_codec->lowres > 0 )
+		{
+			// The media keeps its real size when the decoder reduces it
+			AVCodecParameters *codec_params = self->video_format->streams[ index ]->codecpar;
+			int rotated = fabs( theta - 90.0 ) < 1.0 || fabs( theta - 270.0 ) < 1.0;
+			mlt_properties_set_int( properties, "meta.media.width", rotated ? codec_params->height : codec_params->width );
+			mlt_properties_set_int( properties, "meta.media.height", rotated ? codec_params->width : codec_params->height );
+		}
 		mlt_properties_set_int( frame_properties, "colorspace", self->yuv_colorspace );
 		mlt_properties_set_int( frame_properties, "color_trc", self->color_trc );
 		mlt_properties_set_int( frame_properties, "color_primaries", self->color_primaries );
@@ -2470,6 +3892,26 @@ static void producer_set_up_video( producer_avformat self, mlt_frame frame )
 		pthread_mutex_unlock( &self->video_mutex );
 }
 
+/** Stop the demuxer returning the packets of streams other than the selected audio.
+ *
+ * The first PTS comes from the video packets, so this follows find_first_pts().
+ */
+
+static void discard_unused_streams( producer_avformat self )
+{
+	AVFormatContext *context = self->audio_format;
+	unsigned int i;
+
+	if ( !context )
+		return;
+	for ( i = 0; i < context->nb_streams; i++ )
+	{
+		int wanted = self->audio_index == INT_MAX ?
+			context->streams[ i ]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO : (int) i == self->audio_index;
+		context->streams[ i ]->discard = wanted ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+	}
+}
+
 static int seek_audio( producer_avformat self, mlt_position position, double timecode )
 {
 	int paused = 0;
@@ -2504,7 +3946,7 @@ static int seek_audio( producer_avformat self, mlt_position position, double tim
 				timestamp = 0;
 
 			// Set to the real timecode
-			if ( av_seek_frame( context, -1, timestamp, AVSEEK_FLAG_BACKWARD ) != 0 )
+			if ( demuxer_seek( self, context, -1, timestamp, AVSEEK_FLAG_BACKWARD ) != 0 )
 				paused = 1;
 
 			// Clear the usage in the audio buffer
@@ -2513,6 +3955,8 @@ static int seek_audio( producer_avformat self, mlt_position position, double tim
 				self->audio_used[i - 1] = 0;
 		}
 	}
+	if ( self->audio_only )
+		discard_unused_streams( self );
 	pthread_mutex_unlock( &self->packets_mutex );
 	return paused;
 }
@@ -2524,16 +3968,8 @@ static int sample_bytes( AVCodecContext *context )
 
 static void planar_to_interleaved( uint8_t *dest, AVFrame *src, int samples, int channels, int bytes_per_sample )
 {
-	int s, c;
-	for ( s = 0; s < samples; s++ )
-	{
-		for ( c = 0; c < channels; c++ )
-		{
-			if ( c < AV_NUM_DATA_POINTERS )
-				memcpy( dest, &src->data[c][s * bytes_per_sample], bytes_per_sample );
-			dest += bytes_per_sample;
-		}
-	}
+	// extended_data has the planes beyond AV_NUM_DATA_POINTERS too
+	mlt_audio_interleave( dest, (const void *const *) src->extended_data, bytes_per_sample, channels, samples );
 }
 
 static int decode_audio( producer_avformat self, int *ignore, const AVPacket *pkt, int samples, double timecode, double fps )
@@ -2657,6 +4093,124 @@ static int decode_audio( producer_avformat self, int *ignore, const AVPacket *pk
 	return ret;
 }
 
+/** Find the audio streams that none of the used channels come from with audio_index=all.
+ *
+ * The audio left in the buffers of the streams to skip is dropped.
+ *
+ * \return true if a stream that was skipped for the last frame is needed again
+ */
+static int skip_unused_streams( producer_avformat self, int index_max, uint64_t used, int skip[] )
+{
+	uint32_t skipped = 0;
+	int channel = 0;
+	int index;
+
+	for ( index = 0; index < index_max; index++ )
+	{
+		AVCodecContext *codec_context = self->audio_codec[ index ];
+		if ( !codec_context )
+			continue;
+		int channels = codec_context->channels;
+		uint64_t bits = channels < 64 ? ( UINT64_C(1) << channels ) - 1 : UINT64_MAX;
+
+		// The channels from the 64th on are always used
+		skip[ index ] = channel + channels <= 64 && !( used & ( bits << channel ) );
+		if ( skip[ index ] )
+		{
+			skipped |= 1u << index;
+			self->audio_used[ index ] = 0;
+		}
+		channel += channels;
+	}
+	int resumed = ( self->audio_skipped & ~skipped ) != 0;
+	self->audio_skipped = skipped;
+	return resumed;
+}
+
+/** Set up the cache of decoded audio for the frame rate and the streams in use.
+ *
+ * Recently decoded audio is kept by frame position, so that scrubbing and
+ * shuttling over a few frames do not seek and decode it again. The cache
+ * counts against the budget of all caches and audio_cache_bytes=0 disables it.
+ */
+
+static void audio_cache_setup( producer_avformat self, double fps )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self->parent );
+	int64_t bytes = mlt_properties_get( properties, "audio_cache_bytes" ) ?
+		mlt_properties_get_int64( properties, "audio_cache_bytes" ) : AUDIO_CACHE_BYTES;
+
+	// The audio of a frame changes with the frame rate and the streams
+	if ( self->audio_cache && ( bytes <= 0 || !self->seekable || self->audio_cache_fps != fps
+		|| self->audio_cache_index != self->audio_index ) )
+	{
+		mlt_cache_close( self->audio_cache );
+		self->audio_cache = NULL;
+	}
+	if ( !self->audio_cache && bytes > 0 && self->seekable )
+	{
+		self->audio_cache = mlt_cache_init();
+		mlt_cache_set_size( self->audio_cache, AUDIO_CACHE_FRAMES );
+		self->audio_cache_fps = fps;
+		self->audio_cache_index = self->audio_index;
+	}
+	if ( self->audio_cache )
+		mlt_cache_set_max_bytes( self->audio_cache, bytes );
+}
+
+/** Get the audio of a frame from the cache of decoded audio.
+ *
+ * \return true if the audio was found
+ */
+
+static int audio_cache_get( producer_avformat self, mlt_frame frame, mlt_position position, void **buffer,
+	mlt_audio_format *format, int *frequency, int *channels, int *samples )
+{
+	mlt_frame cached = mlt_cache_get_frame( self->audio_cache, position );
+	if ( !cached )
+		return 0;
+
+	mlt_properties cached_props = MLT_FRAME_PROPERTIES( cached );
+	mlt_properties frame_props = MLT_FRAME_PROPERTIES( frame );
+	int size = 0;
+	*buffer = mlt_properties_get_data( cached_props, "audio", &size );
+	if ( !*buffer || size <= 0 )
+	{
+		mlt_frame_close( cached );
+		return 0;
+	}
+	*format = mlt_properties_get_int( cached_props, "audio_format" );
+	*frequency = mlt_properties_get_int( cached_props, "audio_frequency" );
+	*channels = mlt_properties_get_int( cached_props, "audio_channels" );
+	*samples = mlt_properties_get_int( cached_props, "audio_samples" );
+
+	// The copy from the cache lives as long as the frame uses its audio
+	mlt_frame_set_audio( frame, *buffer, *format, size, NULL );
+	mlt_properties_set_data( frame_props, "avformat.audio_cache", cached, 0, (mlt_destructor) mlt_frame_close, NULL );
+	mlt_properties_pass_property( frame_props, cached_props, "channel_layout" );
+	return 1;
+}
+
+/** Put the audio of a frame in the cache of decoded audio.
+ */
+
+static void audio_cache_put( producer_avformat self, mlt_frame frame, mlt_position position, void *buffer,
+	mlt_audio_format format, int frequency, int channels, int samples )
+{
+	mlt_frame cached = mlt_frame_init( NULL );
+	mlt_properties cached_props = MLT_FRAME_PROPERTIES( cached );
+
+	// Putting the frame in the cache copies the audio
+	mlt_frame_set_position( cached, position );
+	mlt_frame_set_audio( cached, buffer, format, mlt_audio_format_size( format, samples, channels ), NULL );
+	mlt_properties_set_int( cached_props, "audio_frequency", frequency );
+	mlt_properties_set_int( cached_props, "audio_channels", channels );
+	mlt_properties_set_int( cached_props, "audio_samples", samples );
+	mlt_properties_pass_property( cached_props, MLT_FRAME_PROPERTIES( frame ), "channel_layout" );
+	mlt_cache_put_frame( self->audio_cache, cached );
+	mlt_frame_close( cached );
+}
+
 /** Get the audio from a frame.
 */
 static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
@@ -2664,6 +4218,8 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 	// Get the producer
 	producer_avformat self = mlt_frame_pop_audio( frame );
 
+	pthread_rwlock_rdlock( &self->idle_lock );
+	self->idle_used = idle_now();
 	pthread_mutex_lock( &self->audio_mutex );
 	
 	// Obtain the frame number of this frame
@@ -2677,9 +4233,24 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 	if ( mlt_properties_get( MLT_FRAME_PROPERTIES(frame), "producer_consumer_fps" ) )
 		fps = mlt_properties_get_double( MLT_FRAME_PROPERTIES(frame), "producer_consumer_fps" );
 
+	// Jumping back or ahead to recently decoded audio does not need to seek
+	audio_cache_setup( self, fps );
+	if ( self->audio_cache && position != self->audio_expected && !( position + 1 == self->audio_expected &&
+		 mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( self->parent ), "mute_on_pause" ) ) &&
+		 audio_cache_get( self, frame, position, buffer, format, frequency, channels, samples ) )
+	{
+		// The decoder stays where it was for the frame it expects next
+		pthread_mutex_unlock( &self->audio_mutex );
+		pthread_rwlock_unlock( &self->idle_lock );
+		return 0;
+	}
+
 	// Number of frames to ignore (for ffwd)
 	int ignore[ MAX_AUDIO_STREAMS ] = { 0 };
 
+	// The streams that are not decoded with audio_index=all
+	int skip[ MAX_AUDIO_STREAMS ] = { 0 };
+
 	// Flag for paused (silence)
 	double timecode = self->audio_expected > 0 ? real_timecode : FFMAX(real_timecode - 0.25, 0.0);
 	int paused = seek_audio( self, position, timecode );
@@ -2706,6 +4277,15 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 		*channels = self->total_channels;
 		*samples = mlt_audio_calculate_frame_samples( fps, self->max_frequency, position );
 		*frequency = self->max_frequency;
+
+		// Only decode the streams of the channels that are used. Skipping packets
+		// needs seeking to get back in sync, so a stream that is needed again
+		// makes all of them start over from here.
+		uint64_t used;
+		if ( !mlt_frame_get_audio_channels_used( frame, &used ) || !self->seekable )
+			used = UINT64_MAX;
+		if ( skip_unused_streams( self, index_max, used, skip ) && !paused )
+			seek_audio( self, -1, timecode );
 	}
 
 	// Initialize the buffers
@@ -2758,7 +4338,7 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 				// Check if there is enough audio for all streams
 				got_audio = 1;
 				for ( index = 0; got_audio && index < index_max; index++ )
-					if ( ( self->audio_codec[ index ] && self->audio_used[ index ] < *samples ) || ignore[ index ] )
+					if ( !skip[ index ] && ( ( self->audio_codec[ index ] && self->audio_used[ index ] < *samples ) || ignore[ index ] ) )
 						got_audio = 0;
 				if ( got_audio )
 					break;
@@ -2766,7 +4346,8 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 
 			// Read a packet
 			pthread_mutex_lock( &self->packets_mutex );
-			if ( mlt_deque_count( self->apackets ) )
+			demuxer *demux = demuxer_get( self, context );
+			if ( !demux && mlt_deque_count( self->apackets ) )
 			{
 				AVPacket *tmp = (AVPacket*) mlt_deque_pop_front( self->apackets );
 				av_packet_ref( &pkt, tmp );
@@ -2774,12 +4355,22 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 			}
 			else
 			{
-				ret = av_read_frame( context, &pkt );
-				if ( ret >= 0 && !self->seekable && pkt.stream_index == self->video_index )
+				if ( demux )
+				{
+					pthread_mutex_unlock( &self->packets_mutex );
+					ret = demuxer_read( demux, DEMUX_AUDIO, &pkt, -1 );
+					pthread_mutex_lock( &self->packets_mutex );
+				}
+				else
+				{
+					ret = av_read_frame( context, &pkt );
+				}
+				if ( ret >= 0 && !demux && !self->seekable && !self->audio_only && pkt.stream_index == self->video_index )
 				{
 					mlt_deque_push_back( self->vpackets, av_packet_clone(&pkt) );
 				}
-				else if ( ret < 0 )
+				// EAGAIN means the video queue is full, so the frame gets the audio decoded so far
+				else if ( ret < 0 && ret != AVERROR( EAGAIN ) )
 				{
 					mlt_producer producer = self->parent;
 					mlt_properties properties = MLT_PRODUCER_PROPERTIES( producer );
@@ -2805,12 +4396,12 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 			// We only deal with audio from the selected audio index
 			index = pkt.stream_index;
 			if ( index < MAX_AUDIO_STREAMS && ret >= 0 && pkt.data && pkt.size > 0 && ( index == self->audio_index ||
-				 ( self->audio_index == INT_MAX && context->streams[ index ]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO ) ) )
+				 ( self->audio_index == INT_MAX && context->streams[ index ]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO && !skip[ index ] ) ) )
 			{
 				ret = decode_audio( self, &ignore[index], &pkt, *samples, real_timecode, fps );
 			}
 
-			if ( self->seekable || index != self->video_index )
+			if ( demux || self->seekable || index != self->video_index )
 				av_packet_unref( &pkt );
 		}
 		self->is_audio_synchronizing = 0;
@@ -2852,6 +4443,7 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 		if ( self->audio_index == INT_MAX )
 		{
 			uint8_t *dest = *buffer;
+			uint8_t silence = *format == mlt_audio_u8 ? 0x80 : 0;
 			int i;
 			for ( i = 0; i < *samples; i++ )
 			{
@@ -2860,7 +4452,10 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 				{
 					int current_channels = self->audio_codec[ index ]->channels;
 					uint8_t *src = self->audio_buffer[ index ] + i * current_channels * sizeof_sample;
-					memcpy( dest, src, current_channels * sizeof_sample );
+					if ( skip[ index ] )
+						memset( dest, silence, current_channels * sizeof_sample );
+					else
+						memcpy( dest, src, current_channels * sizeof_sample );
 					dest += current_channels * sizeof_sample;
 				}
 			}
@@ -2899,6 +4494,10 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 				memset( *buffer, silence, *samples * *channels * sizeof_sample );
 			}
 		}
+
+		// Audio with streams left out for the channels of this frame is not kept
+		if ( self->audio_cache && ( self->audio_index != INT_MAX || !self->audio_skipped ) )
+			audio_cache_put( self, frame, position, *buffer, *format, *frequency, *channels, *samples );
 	}
 	else
 	{
@@ -2912,6 +4511,7 @@ exit_get_audio:
 		self->audio_expected = position + 1;
 
 	pthread_mutex_unlock( &self->audio_mutex );
+	pthread_rwlock_unlock( &self->idle_lock );
 
 	return 0;
 }
@@ -3072,6 +4672,7 @@ static int producer_get_frame( mlt_producer producer, mlt_frame_ptr frame, int i
 		self = calloc( 1, sizeof( struct producer_avformat_s ) );
 		producer->child = self;
 		self->parent = producer;
+		pthread_rwlock_init( &self->idle_lock, NULL );
 		mlt_service_cache_put( service, "producer_avformat", self, 0, (mlt_destructor) producer_avformat_close );
 		cache_item = mlt_service_cache_get( service, "producer_avformat" );
 	}
@@ -3092,11 +4693,12 @@ static int producer_get_frame( mlt_producer producer, mlt_frame_ptr frame, int i
 	// Update timecode on the frame we're creating
 	mlt_frame_set_position( *frame, mlt_producer_position( producer ) );
 
-	// Set up the video
+	// Set up the video and audio, reopening the file if it was closed while idle
+	pthread_rwlock_rdlock( &self->idle_lock );
+	self->idle_used = idle_now();
 	producer_set_up_video( self, *frame );
-
-	// Set up the audio
 	producer_set_up_audio( self, *frame );
+	pthread_rwlock_unlock( &self->idle_lock );
 
 	// Set the position of this producer
 	mlt_position position = mlt_producer_frame( producer );
@@ -3112,6 +4714,14 @@ static void producer_avformat_close( producer_avformat self )
 {
 	mlt_log_debug( NULL, "producer_avformat_close\n" );
 
+	// Stop indexing before the contexts go away
+	seek_index_stop( self );
+
+	// Stop reading ahead before the contexts close
+	idle_unregister( self );
+	demuxer_stop( self );
+	free( self->probe_key );
+
 	// Cleanup av contexts
 	av_packet_unref( &self->pkt );
 	av_frame_free( &self->video_frame );
@@ -3150,6 +4760,11 @@ static void producer_avformat_close( producer_avformat self )
 
 	// Cleanup caches.
 	mlt_cache_close( self->image_cache );
+	self->image_cache = NULL;
+	mlt_cache_close( self->reverse_cache );
+	self->reverse_cache = NULL;
+	mlt_cache_close( self->audio_cache );
+	self->audio_cache = NULL;
 	if ( self->last_good_frame )
 		mlt_frame_close( self->last_good_frame );
 
@@ -3161,6 +4776,7 @@ static void producer_avformat_close( producer_avformat self )
 		pthread_mutex_destroy( &self->packets_mutex );
 		pthread_mutex_destroy( &self->open_mutex );
 	}
+	pthread_rwlock_destroy( &self->idle_lock );
 
 	// Cleanup the packet queues
 	AVPacket *pkt;
@@ -3188,7 +4804,8 @@ static void producer_avformat_close( producer_avformat self )
 
 static void producer_close( mlt_producer parent )
 {
-	// Remove this instance from the cache
+	// Stop closing it when idle and remove this instance from the cache
+	idle_forget( parent );
 	mlt_service_cache_purge( MLT_PRODUCER_SERVICE(parent) );
 
 	// Close the parent
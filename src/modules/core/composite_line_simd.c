@@ -0,0 +1,481 @@
+/*
+ * composite_line_simd.c -- vectorised lines for transition_composite
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "composite_line_simd.h"
+
+#include <framework/mlt_cpu.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The blend kernels keep the 32-bit integer math of calculate_mix, smoothstep and
+// sample_mix, and results are truncated to 8 bits like the scalar stores. The division
+// in smoothstep becomes a multiplication by the reciprocal of the softness in double
+// precision plus a bias smaller than the gap between any quotient and the next integer,
+// which is exact while the softness is at most MAX_SOFTNESS.
+// The 16-bit kernel takes the mix of each sample already calculated and computes
+// dest + ( ( src - dest ) * ( mix >> 1 ) >> 15 ), which cannot overflow 32 bits.
+
+#define MAX_SOFTNESS ( 1 << 16 )
+#define QUOTIENT_BIAS ( 1.0 / ( 1 << 20 ) )
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) ) && defined(__SSE2__)
+#define USE_X86_SIMD 1
+#include <immintrin.h>
+
+__attribute__((target("sse4.1")))
+static inline __m128i load4_u8_sse41( const uint8_t *p )
+{
+	int32_t v;
+	memcpy( &v, p, 4 );
+	return _mm_cvtepu8_epi32( _mm_cvtsi32_si128( v ) );
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i smoothstep_sse41( __m128i edge1, __m128i softness, __m128i step, __m128d scale )
+{
+	const __m128d bias = _mm_set1_pd( QUOTIENT_BIAS );
+	__m128i edge2 = _mm_add_epi32( edge1, softness );
+	__m128i below = _mm_xor_si128( _mm_cmpeq_epi32( _mm_max_epu32( step, edge1 ), step ), _mm_set1_epi32( -1 ) );
+	__m128i above = _mm_cmpeq_epi32( _mm_max_epu32( step, edge2 ), step );
+	// Only lanes with edge1 <= step < edge2 are kept, so this difference is below the softness
+	__m128i x = _mm_sub_epi32( step, edge1 );
+	__m128d lo = _mm_add_pd( _mm_mul_pd( _mm_cvtepi32_pd( x ), scale ), bias );
+	__m128d hi = _mm_add_pd( _mm_mul_pd( _mm_cvtepi32_pd( _mm_unpackhi_epi64( x, x ) ), scale ), bias );
+	__m128i a = _mm_unpacklo_epi64( _mm_cvttpd_epi32( lo ), _mm_cvttpd_epi32( hi ) );
+	__m128i r = _mm_srli_epi32( _mm_mullo_epi32( _mm_srli_epi32( _mm_mullo_epi32( a, a ), 16 ),
+		_mm_sub_epi32( _mm_set1_epi32( 3 << 16 ), _mm_add_epi32( a, a ) ) ), 16 );
+	r = _mm_blendv_epi8( r, _mm_set1_epi32( 0x10000 ), above );
+	return _mm_andnot_si128( below, r );
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i sample_mix_sse41( __m128i dest, __m128i src, __m128i mix )
+{
+	__m128i r = _mm_srai_epi32( _mm_mullo_epi32( _mm_sub_epi32( src, dest ), mix ), 16 );
+	return _mm_and_si128( _mm_add_epi32( dest, r ), _mm_set1_epi32( 0xff ) );
+}
+
+__attribute__((target("sse4.1")))
+static int blend_sse41( uint8_t *dest, const uint8_t *src, int width, const uint8_t *alpha_b, uint8_t *alpha_a,
+	int weight, const uint16_t *luma, int softness, uint32_t step, composite_line_op op )
+{
+	const __m128i opaque = _mm_set1_epi32( 255 );
+	const __m128d scale = _mm_set1_pd( 65536.0 / ( softness > 0 ? softness : 1 ) );
+	int n = 0;
+
+	if ( luma && (unsigned) softness > MAX_SOFTNESS )
+		return 0;
+
+	for ( ; n + 4 <= width; n += 4 )
+	{
+		__m128i a = alpha_b ? load4_u8_sse41( alpha_b + n ) : opaque;
+		__m128i b = alpha_a ? load4_u8_sse41( alpha_a + n ) : opaque;
+		__m128i factor = _mm_set1_epi32( weight );
+		__m128i mix;
+
+		if ( op == composite_line_or )
+			a = _mm_or_si128( a, b );
+		else if ( op == composite_line_and )
+			a = _mm_and_si128( a, b );
+		else if ( op == composite_line_xor )
+			a = _mm_xor_si128( a, b );
+		if ( luma )
+			factor = smoothstep_sse41( _mm_cvtepu16_epi32( _mm_loadl_epi64( (const __m128i*) ( luma + n ) ) ),
+				_mm_set1_epi32( softness ), _mm_set1_epi32( step ), scale );
+		mix = _mm_srai_epi32( _mm_mullo_epi32( factor, _mm_add_epi32( a, _mm_set1_epi32( 1 ) ) ), 8 );
+
+		__m128i s = _mm_loadl_epi64( (const __m128i*) ( src + n * 2 ) );
+		__m128i d = _mm_loadl_epi64( (const __m128i*) ( dest + n * 2 ) );
+		__m128i lo = sample_mix_sse41( _mm_cvtepu8_epi32( d ), _mm_cvtepu8_epi32( s ),
+			_mm_shuffle_epi32( mix, _MM_SHUFFLE( 1, 1, 0, 0 ) ) );
+		__m128i hi = sample_mix_sse41( _mm_cvtepu8_epi32( _mm_srli_si128( d, 4 ) ), _mm_cvtepu8_epi32( _mm_srli_si128( s, 4 ) ),
+			_mm_shuffle_epi32( mix, _MM_SHUFFLE( 3, 3, 2, 2 ) ) );
+		__m128i r = _mm_packus_epi32( lo, hi );
+		_mm_storel_epi64( (__m128i*) ( dest + n * 2 ), _mm_packus_epi16( r, r ) );
+
+		if ( alpha_a )
+		{
+			__m128i out = _mm_srai_epi32( mix, 8 );
+			if ( op == composite_line_over )
+				out = _mm_or_si128( out, b );
+			out = _mm_packus_epi32( _mm_and_si128( out, opaque ), opaque );
+			int32_t v = _mm_cvtsi128_si32( _mm_packus_epi16( out, out ) );
+			memcpy( alpha_a + n, &v, 4 );
+		}
+	}
+	return n;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i smoothstep_avx2( __m256i edge1, __m256i softness, __m256i step, __m256d scale )
+{
+	const __m256d bias = _mm256_set1_pd( QUOTIENT_BIAS );
+	__m256i edge2 = _mm256_add_epi32( edge1, softness );
+	__m256i below = _mm256_xor_si256( _mm256_cmpeq_epi32( _mm256_max_epu32( step, edge1 ), step ), _mm256_set1_epi32( -1 ) );
+	__m256i above = _mm256_cmpeq_epi32( _mm256_max_epu32( step, edge2 ), step );
+	__m256i x = _mm256_sub_epi32( step, edge1 );
+	__m256d lo = _mm256_add_pd( _mm256_mul_pd( _mm256_cvtepi32_pd( _mm256_castsi256_si128( x ) ), scale ), bias );
+	__m256d hi = _mm256_add_pd( _mm256_mul_pd( _mm256_cvtepi32_pd( _mm256_extracti128_si256( x, 1 ) ), scale ), bias );
+	__m256i a = _mm256_inserti128_si256( _mm256_castsi128_si256( _mm256_cvttpd_epi32( lo ) ),
+		_mm256_cvttpd_epi32( hi ), 1 );
+	__m256i r = _mm256_srli_epi32( _mm256_mullo_epi32( _mm256_srli_epi32( _mm256_mullo_epi32( a, a ), 16 ),
+		_mm256_sub_epi32( _mm256_set1_epi32( 3 << 16 ), _mm256_add_epi32( a, a ) ) ), 16 );
+	r = _mm256_blendv_epi8( r, _mm256_set1_epi32( 0x10000 ), above );
+	return _mm256_andnot_si256( below, r );
+}
+
+__attribute__((target("avx2")))
+static inline __m256i sample_mix_avx2( __m256i dest, __m256i src, __m256i mix )
+{
+	__m256i r = _mm256_srai_epi32( _mm256_mullo_epi32( _mm256_sub_epi32( src, dest ), mix ), 16 );
+	return _mm256_and_si256( _mm256_add_epi32( dest, r ), _mm256_set1_epi32( 0xff ) );
+}
+
+__attribute__((target("avx2")))
+static int blend_avx2( uint8_t *dest, const uint8_t *src, int width, const uint8_t *alpha_b, uint8_t *alpha_a,
+	int weight, const uint16_t *luma, int softness, uint32_t step, composite_line_op op )
+{
+	const __m256i opaque = _mm256_set1_epi32( 255 );
+	const __m256d scale = _mm256_set1_pd( 65536.0 / ( softness > 0 ? softness : 1 ) );
+	const __m256i first = _mm256_setr_epi32( 0, 0, 1, 1, 2, 2, 3, 3 );
+	const __m256i second = _mm256_setr_epi32( 4, 4, 5, 5, 6, 6, 7, 7 );
+	int n = 0;
+
+	if ( luma && (unsigned) softness > MAX_SOFTNESS )
+		return 0;
+
+	for ( ; n + 8 <= width; n += 8 )
+	{
+		__m256i a = alpha_b ? _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*) ( alpha_b + n ) ) ) : opaque;
+		__m256i b = alpha_a ? _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*) ( alpha_a + n ) ) ) : opaque;
+		__m256i factor = _mm256_set1_epi32( weight );
+		__m256i mix;
+
+		if ( op == composite_line_or )
+			a = _mm256_or_si256( a, b );
+		else if ( op == composite_line_and )
+			a = _mm256_and_si256( a, b );
+		else if ( op == composite_line_xor )
+			a = _mm256_xor_si256( a, b );
+		if ( luma )
+			factor = smoothstep_avx2( _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*) ( luma + n ) ) ),
+				_mm256_set1_epi32( softness ), _mm256_set1_epi32( step ), scale );
+		mix = _mm256_srai_epi32( _mm256_mullo_epi32( factor, _mm256_add_epi32( a, _mm256_set1_epi32( 1 ) ) ), 8 );
+
+		__m128i s = _mm_loadu_si128( (const __m128i*) ( src + n * 2 ) );
+		__m128i d = _mm_loadu_si128( (const __m128i*) ( dest + n * 2 ) );
+		__m256i lo = sample_mix_avx2( _mm256_cvtepu8_epi32( d ), _mm256_cvtepu8_epi32( s ),
+			_mm256_permutevar8x32_epi32( mix, first ) );
+		__m256i hi = sample_mix_avx2( _mm256_cvtepu8_epi32( _mm_srli_si128( d, 8 ) ), _mm256_cvtepu8_epi32( _mm_srli_si128( s, 8 ) ),
+			_mm256_permutevar8x32_epi32( mix, second ) );
+		__m256i r = _mm256_permute4x64_epi64( _mm256_packus_epi32( lo, hi ), _MM_SHUFFLE( 3, 1, 2, 0 ) );
+		_mm_storeu_si128( (__m128i*) ( dest + n * 2 ),
+			_mm_packus_epi16( _mm256_castsi256_si128( r ), _mm256_extracti128_si256( r, 1 ) ) );
+
+		if ( alpha_a )
+		{
+			__m256i out = _mm256_srai_epi32( mix, 8 );
+			if ( op == composite_line_over )
+				out = _mm256_or_si256( out, b );
+			out = _mm256_and_si256( out, opaque );
+			__m128i words = _mm_packus_epi32( _mm256_castsi256_si128( out ), _mm256_extracti128_si256( out, 1 ) );
+			_mm_storel_epi64( (__m128i*) ( alpha_a + n ), _mm_packus_epi16( words, words ) );
+		}
+	}
+	return n + blend_sse41( dest + n * 2, src + n * 2, width - n, alpha_b ? alpha_b + n : NULL,
+		alpha_a ? alpha_a + n : NULL, weight, luma ? luma + n : NULL, softness, step, op );
+}
+
+__attribute__((target("sse4.1")))
+static int blend16_sse41( uint16_t *dest, const uint16_t *src, const int32_t *mix, int count )
+{
+	int n = 0;
+
+	for ( ; n + 8 <= count; n += 8 )
+	{
+		__m128i s = _mm_loadu_si128( (const __m128i*) ( src + n ) );
+		__m128i d = _mm_loadu_si128( (const __m128i*) ( dest + n ) );
+		__m128i d_lo = _mm_cvtepu16_epi32( d );
+		__m128i d_hi = _mm_cvtepu16_epi32( _mm_srli_si128( d, 8 ) );
+		__m128i m_lo = _mm_srai_epi32( _mm_loadu_si128( (const __m128i*) ( mix + n ) ), 1 );
+		__m128i m_hi = _mm_srai_epi32( _mm_loadu_si128( (const __m128i*) ( mix + n + 4 ) ), 1 );
+		__m128i lo = _mm_mullo_epi32( _mm_sub_epi32( _mm_cvtepu16_epi32( s ), d_lo ), m_lo );
+		__m128i hi = _mm_mullo_epi32( _mm_sub_epi32( _mm_cvtepu16_epi32( _mm_srli_si128( s, 8 ) ), d_hi ), m_hi );
+		lo = _mm_add_epi32( d_lo, _mm_srai_epi32( lo, 15 ) );
+		hi = _mm_add_epi32( d_hi, _mm_srai_epi32( hi, 15 ) );
+		_mm_storeu_si128( (__m128i*) ( dest + n ), _mm_packus_epi32( lo, hi ) );
+	}
+	return n;
+}
+
+__attribute__((target("avx2")))
+static int blend16_avx2( uint16_t *dest, const uint16_t *src, const int32_t *mix, int count )
+{
+	int n = 0;
+
+	for ( ; n + 16 <= count; n += 16 )
+	{
+		__m128i s0 = _mm_loadu_si128( (const __m128i*) ( src + n ) );
+		__m128i s1 = _mm_loadu_si128( (const __m128i*) ( src + n + 8 ) );
+		__m256i d_lo = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*) ( dest + n ) ) );
+		__m256i d_hi = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*) ( dest + n + 8 ) ) );
+		__m256i m_lo = _mm256_srai_epi32( _mm256_loadu_si256( (const __m256i*) ( mix + n ) ), 1 );
+		__m256i m_hi = _mm256_srai_epi32( _mm256_loadu_si256( (const __m256i*) ( mix + n + 8 ) ), 1 );
+		__m256i lo = _mm256_mullo_epi32( _mm256_sub_epi32( _mm256_cvtepu16_epi32( s0 ), d_lo ), m_lo );
+		__m256i hi = _mm256_mullo_epi32( _mm256_sub_epi32( _mm256_cvtepu16_epi32( s1 ), d_hi ), m_hi );
+		lo = _mm256_add_epi32( d_lo, _mm256_srai_epi32( lo, 15 ) );
+		hi = _mm256_add_epi32( d_hi, _mm256_srai_epi32( hi, 15 ) );
+		_mm256_storeu_si256( (__m256i*) ( dest + n ),
+			_mm256_permute4x64_epi64( _mm256_packus_epi32( lo, hi ), _MM_SHUFFLE( 3, 1, 2, 0 ) ) );
+	}
+	return n + blend16_sse41( dest + n, src + n, mix + n, count - n );
+}
+
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+#define USE_SIMPLE 1
+
+extern void composite_line_yuv_sse2_simple( uint8_t *dest, uint8_t *src, int width, uint8_t *alpha_b, uint8_t *alpha_a, int weight );
+
+static int blend_simple_sse2( uint8_t *dest, const uint8_t *src, int width, const uint8_t *alpha_b, uint8_t *alpha_a, int weight )
+{
+	if ( width < 8 )
+		return 0;
+	composite_line_yuv_sse2_simple( dest, (uint8_t*) src, width, (uint8_t*) alpha_b, alpha_a, weight );
+	return width - width % 8;
+}
+
+/** Composite 16 pixels the way composite_line_yuv_sse2_simple does. */
+
+__attribute__((target("avx2")))
+static inline void blend_simple_16_avx2( uint8_t *dest, const uint8_t *src, const uint8_t *alpha_b, uint8_t *alpha_a, int weight )
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i c255 = _mm256_set1_epi16( 0xff );
+	const __m256i c128 = _mm256_set1_epi16( 0x80 );
+	__m256i a;
+
+	if ( alpha_b )
+	{
+		a = _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*) alpha_b ) );
+		if ( weight != 256 )
+			a = _mm256_srli_epi16( _mm256_mullo_epi16( a, _mm256_set1_epi16( weight ) ), 8 );
+	}
+	else
+	{
+		a = _mm256_set1_epi16( weight );
+	}
+
+	if ( alpha_a )
+	{
+		__m256i d = _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*) alpha_a ) );
+		__m256i t = _mm256_mullo_epi16( _mm256_sub_epi16( c255, d ), a );
+		t = _mm256_srli_epi16( _mm256_add_epi16( _mm256_add_epi16( _mm256_srli_epi16( t, 8 ), t ), c128 ), 8 );
+		d = _mm256_packus_epi16( _mm256_add_epi16( d, t ), zero );
+		_mm_storeu_si128( (__m128i*) alpha_a, _mm256_castsi256_si128( _mm256_permute4x64_epi64( d, _MM_SHUFFLE( 3, 1, 2, 0 ) ) ) );
+	}
+
+	__m256i s = _mm256_loadu_si256( (const __m256i*) src );
+	__m256i d = _mm256_loadu_si256( (const __m256i*) dest );
+	__m256i s_lo = _mm256_unpacklo_epi8( s, zero );
+	__m256i d_lo = _mm256_unpacklo_epi8( d, zero );
+	__m256i s_hi = _mm256_unpackhi_epi8( s, zero );
+	__m256i d_hi = _mm256_unpackhi_epi8( d, zero );
+	__m256i lo = _mm256_add_epi16( _mm256_mullo_epi16( _mm256_sub_epi16( s_lo, d_lo ), _mm256_unpacklo_epi16( a, a ) ),
+		_mm256_mullo_epi16( d_lo, c255 ) );
+	__m256i hi = _mm256_add_epi16( _mm256_mullo_epi16( _mm256_sub_epi16( s_hi, d_hi ), _mm256_unpackhi_epi16( a, a ) ),
+		_mm256_mullo_epi16( d_hi, c255 ) );
+	lo = _mm256_srli_epi16( _mm256_add_epi16( _mm256_add_epi16( _mm256_srli_epi16( lo, 8 ), lo ), c128 ), 8 );
+	hi = _mm256_srli_epi16( _mm256_add_epi16( _mm256_add_epi16( _mm256_srli_epi16( hi, 8 ), hi ), c128 ), 8 );
+	_mm256_storeu_si256( (__m256i*) dest, _mm256_packus_epi16( lo, hi ) );
+}
+
+__attribute__((target("avx2")))
+static int blend_simple_avx2( uint8_t *dest, const uint8_t *src, int width, const uint8_t *alpha_b, uint8_t *alpha_a, int weight )
+{
+	int n = 0;
+
+	if ( width < 8 )
+		return 0;
+	weight >>= 8;
+	if ( !alpha_b && weight == 256 )
+	{
+		memcpy( dest, src, 2 * width );
+		if ( alpha_a )
+			memset( alpha_a, 0xff, width );
+		return width;
+	}
+	for ( ; n + 16 <= width; n += 16 )
+		blend_simple_16_avx2( dest + n * 2, src + n * 2, alpha_b ? alpha_b + n : NULL, alpha_a ? alpha_a + n : NULL, weight );
+	return n + blend_simple_sse2( dest + n * 2, src + n * 2, width - n, alpha_b ? alpha_b + n : NULL,
+		alpha_a ? alpha_a + n : NULL, weight << 8 );
+}
+
+#endif // USE_SSE && ARCH_X86_64
+
+#elif defined(__aarch64__)
+#define USE_NEON 1
+#include <arm_neon.h>
+
+static inline uint32x4_t load4_u8_neon( const uint8_t *p )
+{
+	uint32_t v;
+	memcpy( &v, p, 4 );
+	return vmovl_u16( vget_low_u16( vmovl_u8( vreinterpret_u8_u32( vdup_n_u32( v ) ) ) ) );
+}
+
+static inline uint32x4_t smoothstep_neon( uint32x4_t edge1, uint32x4_t softness, uint32x4_t step, float64x2_t scale )
+{
+	const float64x2_t bias = vdupq_n_f64( QUOTIENT_BIAS );
+	uint32x4_t below = vcltq_u32( step, edge1 );
+	uint32x4_t above = vcgeq_u32( step, vaddq_u32( edge1, softness ) );
+	uint32x4_t x = vsubq_u32( step, edge1 );
+	float64x2_t lo = vfmaq_f64( bias, vcvtq_f64_u64( vmovl_u32( vget_low_u32( x ) ) ), scale );
+	float64x2_t hi = vfmaq_f64( bias, vcvtq_f64_u64( vmovl_high_u32( x ) ), scale );
+	uint32x4_t a = vcombine_u32( vmovn_u64( vcvtq_u64_f64( lo ) ), vmovn_u64( vcvtq_u64_f64( hi ) ) );
+	uint32x4_t r = vshrq_n_u32( vmulq_u32( vshrq_n_u32( vmulq_u32( a, a ), 16 ),
+		vsubq_u32( vdupq_n_u32( 3 << 16 ), vaddq_u32( a, a ) ) ), 16 );
+	r = vbslq_u32( above, vdupq_n_u32( 0x10000 ), r );
+	return vbslq_u32( below, vdupq_n_u32( 0 ), r );
+}
+
+static inline uint16x4_t sample_mix_neon( uint32x4_t dest, uint32x4_t src, uint32x4_t mix )
+{
+	int32x4_t r = vmulq_s32( vreinterpretq_s32_u32( vsubq_u32( src, dest ) ), vreinterpretq_s32_u32( mix ) );
+	return vmovn_u32( vaddq_u32( dest, vreinterpretq_u32_s32( vshrq_n_s32( r, 16 ) ) ) );
+}
+
+static int blend_neon( uint8_t *dest, const uint8_t *src, int width, const uint8_t *alpha_b, uint8_t *alpha_a,
+	int weight, const uint16_t *luma, int softness, uint32_t step, composite_line_op op )
+{
+	const uint32x4_t opaque = vdupq_n_u32( 255 );
+	const float64x2_t scale = vdupq_n_f64( 65536.0 / ( softness > 0 ? softness : 1 ) );
+	int n = 0;
+
+	if ( luma && (unsigned) softness > MAX_SOFTNESS )
+		return 0;
+
+	for ( ; n + 4 <= width; n += 4 )
+	{
+		uint32x4_t a = alpha_b ? load4_u8_neon( alpha_b + n ) : opaque;
+		uint32x4_t b = alpha_a ? load4_u8_neon( alpha_a + n ) : opaque;
+		uint32x4_t factor = vdupq_n_u32( weight );
+		uint32x4_t mix;
+
+		if ( op == composite_line_or )
+			a = vorrq_u32( a, b );
+		else if ( op == composite_line_and )
+			a = vandq_u32( a, b );
+		else if ( op == composite_line_xor )
+			a = veorq_u32( a, b );
+		if ( luma )
+			factor = smoothstep_neon( vmovl_u16( vld1_u16( luma + n ) ), vdupq_n_u32( softness ), vdupq_n_u32( step ), scale );
+		mix = vreinterpretq_u32_s32( vshrq_n_s32( vreinterpretq_s32_u32( vmulq_u32( factor, vaddq_u32( a, vdupq_n_u32( 1 ) ) ) ), 8 ) );
+
+		uint16x8_t s = vmovl_u8( vld1_u8( src + n * 2 ) );
+		uint16x8_t d = vmovl_u8( vld1_u8( dest + n * 2 ) );
+		uint16x4_t lo = sample_mix_neon( vmovl_u16( vget_low_u16( d ) ), vmovl_u16( vget_low_u16( s ) ), vzip1q_u32( mix, mix ) );
+		uint16x4_t hi = sample_mix_neon( vmovl_high_u16( d ), vmovl_high_u16( s ), vzip2q_u32( mix, mix ) );
+		vst1_u8( dest + n * 2, vmovn_u16( vcombine_u16( lo, hi ) ) );
+
+		if ( alpha_a )
+		{
+			uint32x4_t out = vreinterpretq_u32_s32( vshrq_n_s32( vreinterpretq_s32_u32( mix ), 8 ) );
+			if ( op == composite_line_over )
+				out = vorrq_u32( out, b );
+			uint16x4_t words = vmovn_u32( out );
+			uint32_t v = vget_lane_u32( vreinterpret_u32_u8( vmovn_u16( vcombine_u16( words, words ) ) ), 0 );
+			memcpy( alpha_a + n, &v, 4 );
+		}
+	}
+	return n;
+}
+
+static int blend16_neon( uint16_t *dest, const uint16_t *src, const int32_t *mix, int count )
+{
+	int n = 0;
+
+	for ( ; n + 8 <= count; n += 8 )
+	{
+		uint16x8_t s = vld1q_u16( src + n );
+		uint16x8_t d = vld1q_u16( dest + n );
+		int32x4_t d_lo = vreinterpretq_s32_u32( vmovl_u16( vget_low_u16( d ) ) );
+		int32x4_t d_hi = vreinterpretq_s32_u32( vmovl_high_u16( d ) );
+		int32x4_t lo = vmulq_s32( vsubq_s32( vreinterpretq_s32_u32( vmovl_u16( vget_low_u16( s ) ) ), d_lo ),
+			vshrq_n_s32( vld1q_s32( mix + n ), 1 ) );
+		int32x4_t hi = vmulq_s32( vsubq_s32( vreinterpretq_s32_u32( vmovl_high_u16( s ) ), d_hi ),
+			vshrq_n_s32( vld1q_s32( mix + n + 4 ), 1 ) );
+		lo = vaddq_s32( d_lo, vshrq_n_s32( lo, 15 ) );
+		hi = vaddq_s32( d_hi, vshrq_n_s32( hi, 15 ) );
+		vst1q_u16( dest + n, vcombine_u16( vqmovun_s32( lo ), vqmovun_s32( hi ) ) );
+	}
+	return n;
+}
+
+#endif
+
+static composite_line_simd g_simd;
+static pthread_once_t g_simd_once = PTHREAD_ONCE_INIT;
+
+static void simd_init( void )
+{
+#if USE_X86_SIMD
+	static const mlt_cpu_dispatch blend[] = {
+		{ mlt_cpu_avx2 | mlt_cpu_sse41, blend_avx2 },
+		{ mlt_cpu_sse41, blend_sse41 },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch blend16[] = {
+		{ mlt_cpu_avx2 | mlt_cpu_sse41, blend16_avx2 },
+		{ mlt_cpu_sse41, blend16_sse41 },
+		{ 0, NULL }
+	};
+#elif USE_NEON
+	static const mlt_cpu_dispatch blend[] = {
+		{ mlt_cpu_neon, blend_neon },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch blend16[] = {
+		{ mlt_cpu_neon, blend16_neon },
+		{ 0, NULL }
+	};
+#else
+	static const mlt_cpu_dispatch blend[] = { { 0, NULL } };
+	static const mlt_cpu_dispatch blend16[] = { { 0, NULL } };
+#endif
+#if USE_SIMPLE
+	static const mlt_cpu_dispatch blend_simple[] = {
+		{ mlt_cpu_avx2, blend_simple_avx2 },
+		{ mlt_cpu_sse2, blend_simple_sse2 },
+		{ 0, NULL }
+	};
+#else
+	static const mlt_cpu_dispatch blend_simple[] = { { 0, NULL } };
+#endif
+	g_simd.blend = mlt_cpu_select( blend );
+	g_simd.blend_simple = mlt_cpu_select( blend_simple );
+	g_simd.blend16 = mlt_cpu_select( blend16 );
+}
+
+const composite_line_simd *composite_line_simd_get( void )
+{
+	pthread_once( &g_simd_once, simd_init );
+	return &g_simd;
+}
@@ -0,0 +1,64 @@
+/*
+ * composite_line_simd.h -- vectorised lines for transition_composite
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef COMPOSITE_LINE_SIMD_H
+#define COMPOSITE_LINE_SIMD_H
+
+#include <stdint.h>
+
+/** How the alpha of the destination combines with that of the source */
+
+typedef enum
+{
+	composite_line_over = 0, /**< use the source alpha and add it to the destination */
+	composite_line_or,       /**< use source | destination and replace the destination */
+	composite_line_and,      /**< use source & destination and replace the destination */
+	composite_line_xor       /**< use source ^ destination and replace the destination */
+}
+composite_line_op;
+
+/** Line compositors for yuv422 images.
+ *
+ * blend gives the same results as the scalar code in transition_composite for
+ * every operator, with or without a luma map. blend_simple has the results of
+ * composite_line_yuv_sse2_simple and only handles the over operator without a
+ * luma map. Each one composites the largest number of pixels it can handle from
+ * the start of the line and returns it, leaving the rest of the line to the caller.
+ *
+ * blend16 mixes count samples of one plane of a 16-bit image with a mix from 0 to
+ * 1 << 16 for each sample, as calculated by the caller. It also returns the number
+ * of samples done.
+ */
+
+typedef struct
+{
+	int ( *blend )( uint8_t *dest, const uint8_t *src, int width, const uint8_t *alpha_b, uint8_t *alpha_a,
+		int weight, const uint16_t *luma, int softness, uint32_t step, composite_line_op op );
+	int ( *blend_simple )( uint8_t *dest, const uint8_t *src, int width, const uint8_t *alpha_b, uint8_t *alpha_a,
+		int weight );
+	int ( *blend16 )( uint16_t *dest, const uint16_t *src, const int32_t *mix, int count );
+} composite_line_simd;
+
+/** Get the best line compositors for the running CPU, or NULL ones if none apply.
+ * They are chosen with mlt_cpu_select(), so MLT_CPU_FLAGS can restrict them.
+ */
+
+extern const composite_line_simd *composite_line_simd_get( void );
+
+#endif
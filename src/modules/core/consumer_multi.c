@@ -48,6 +48,7 @@ mlt_consumer consumer_multi_init( mlt_profile profile, mlt_service_type type, co
 		mlt_properties_set( properties, "resource", arg );
 		mlt_properties_set_int( properties, "real_time", -1 );
 		mlt_properties_set_int( properties, "terminate_on_pause", 1 );
+		mlt_properties_set_int( properties, "queue_depth", 4 );
 
 		// Init state
 		mlt_properties_set_int( properties, "joined", 1 );
@@ -162,9 +163,87 @@ static void on_frame_show( void *dummy, mlt_properties properties, mlt_event_dat
 	mlt_events_fire( properties, "consumer-frame-show", event_data );
 }
 
-static mlt_consumer generate_consumer( mlt_consumer consumer, mlt_properties props, int index )
+// The properties that may differ between outputs that share an encoder
+static int is_output_property( const char *name )
 {
+	return !strcmp( name, "target" ) || !strcmp( name, "f" ) || !strcmp( name, "mlt_service" )
+		|| !strcmp( name, "consumer" );
+}
+
+static int contains_settings( mlt_properties a, mlt_properties b )
+{
+	int i;
+	for ( i = 0; i < mlt_properties_count( a ); i++ )
+	{
+		const char *name = mlt_properties_get_name( a, i );
+		const char *value = mlt_properties_get_value( a, i );
+		const char *other = mlt_properties_get( b, name );
+		if ( is_output_property( name ) )
+			continue;
+		if ( ( value == NULL ) != ( other == NULL ) || ( value && strcmp( value, other ) ) )
+			return 0;
+	}
+	return 1;
+}
+
+/** Add the target to an earlier avformat output with the same encoding settings.
+ *
+ * That consumer then muxes the packets of its encoders into this target too, as
+ * one of its target.N outputs, so the audio and video are only encoded once.
+ */
+
+static int share_encoder( mlt_consumer consumer, mlt_properties props, int count )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES(consumer);
+	const char *service = mlt_properties_get( props, "mlt_service" );
+	char key[30];
+	int index, n;
+
+	if ( !mlt_properties_get_int( properties, "share_encoders" ) || !service
+		 || strcmp( service, "avformat" ) || !mlt_properties_get( props, "target" ) )
+		return 0;
+	for ( index = 0; index < count; index++ )
+	{
+		snprintf( key, sizeof(key), "%d.settings", index );
+		mlt_properties settings = mlt_properties_get_data( properties, key, NULL );
+		snprintf( key, sizeof(key), "%d.consumer", index );
+		mlt_consumer nested = mlt_properties_get_data( properties, key, NULL );
+		if ( !settings || !nested || !contains_settings( settings, props ) || !contains_settings( props, settings ) )
+			continue;
+		mlt_properties nested_props = MLT_CONSUMER_PROPERTIES(nested);
+		for ( n = 1; n <= 8; n++ )
+		{
+			snprintf( key, sizeof(key), "target.%d", n );
+			if ( mlt_properties_get( nested_props, key ) )
+				continue;
+			mlt_properties_set( nested_props, key, mlt_properties_get( props, "target" ) );
+			snprintf( key, sizeof(key), "f.%d", n );
+			mlt_properties_set( nested_props, key, mlt_properties_get( props, "f" ) );
+			mlt_log_verbose( MLT_CONSUMER_SERVICE(consumer), "output %s shares the encoder of output %d\n",
+				mlt_properties_get( props, "target" ), index );
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static mlt_consumer generate_consumer( mlt_consumer consumer, mlt_properties props )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES(consumer);
 	mlt_profile profile = NULL;
+	char key[30];
+	int index = 0;
+
+	// Find the next free output
+	for ( ;; index++ )
+	{
+		snprintf( key, sizeof(key), "%d.consumer", index );
+		if ( !mlt_properties_get_data( properties, key, NULL ) )
+			break;
+	}
+	if ( share_encoder( consumer, props, index ) )
+		return NULL;
+
 	if ( mlt_properties_get( props, "mlt_profile" ) )
 		profile = mlt_profile_init( mlt_properties_get( props, "mlt_profile" ) );
 	if ( !profile )
@@ -174,10 +253,15 @@ static mlt_consumer generate_consumer( mlt_consumer consumer, mlt_properties pro
 
 	if ( nested )
 	{
-		mlt_properties properties = MLT_CONSUMER_PROPERTIES(consumer);
 		mlt_properties nested_props = MLT_CONSUMER_PROPERTIES(nested);
-		char key[30];
 
+		if ( mlt_properties_get_int( properties, "share_encoders" ) )
+		{
+			mlt_properties settings = mlt_properties_new();
+			mlt_properties_inherit( settings, props );
+			snprintf( key, sizeof(key), "%d.settings", index );
+			mlt_properties_set_data( properties, key, settings, 0, (mlt_destructor) mlt_properties_close, NULL );
+		}
 		snprintf( key, sizeof(key), "%d.consumer", index );
 		mlt_properties_set_data( properties, key, nested, 0, (mlt_destructor) mlt_consumer_close, NULL );
 		snprintf( key, sizeof(key), "%d.profile", index );
@@ -223,9 +307,9 @@ static void foreach_consumer_init( mlt_consumer consumer )
 			mlt_properties_close( properties );
 		properties = MLT_CONSUMER_PROPERTIES(consumer);
 		do {
-			snprintf( key, sizeof(key), "%d", index );
+			snprintf( key, sizeof(key), "%d", index++ );
 			if ( ( p = mlt_properties_get_data( properties, key, NULL ) ) )
-				generate_consumer( consumer, p, index++ );
+				generate_consumer( consumer, p );
 		} while ( p );
 	}
 	else if ( properties && mlt_properties_get_data( properties, "0", NULL ) )
@@ -234,9 +318,9 @@ static void foreach_consumer_init( mlt_consumer consumer )
 		mlt_properties p;
 
 		do {
-			snprintf( key, sizeof(key), "%d", index );
+			snprintf( key, sizeof(key), "%d", index++ );
 			if ( ( p = mlt_properties_get_data( properties, key, NULL ) ) )
-				generate_consumer( consumer, p, index++ );
+				generate_consumer( consumer, p );
 		} while ( p );
 		mlt_properties_close( properties );
 	}
@@ -271,7 +355,7 @@ static void foreach_consumer_init( mlt_consumer consumer )
 				mlt_properties_set( p, "mlt_service", service );
 				free( service );
 
-				snprintf( key, sizeof(key), "%d.", index );
+				snprintf( key, sizeof(key), "%d.", index++ );
 
 				int i, count;
 				count = mlt_properties_count( properties );
@@ -282,7 +366,7 @@ static void foreach_consumer_init( mlt_consumer consumer )
 						mlt_properties_set( p, name + strlen(key),
 							mlt_properties_get_value( properties, i ) );
 				}
-				generate_consumer( consumer, p, index++ );
+				generate_consumer( consumer, p );
 				mlt_properties_close( p );
 			}
 		} while ( s );
@@ -291,12 +375,216 @@ static void foreach_consumer_init( mlt_consumer consumer )
 	}
 }
 
+// The audio of a frame, fetched once for all of the nested consumers
+typedef struct
+{
+	uint8_t *buffer;
+	mlt_audio_format format;
+	int frequency;
+	int channels;
+	int samples;
+} multi_audio;
+
+static void put_nested( mlt_consumer consumer, mlt_consumer nested, mlt_frame frame, int deeply, multi_audio *audio )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+	mlt_properties nested_props = MLT_CONSUMER_PROPERTIES(nested);
+	double self_fps = mlt_properties_get_double( properties, "fps" );
+	double nested_fps = mlt_properties_get_double( nested_props, "fps" );
+	mlt_position nested_pos = mlt_properties_get_position( nested_props, "_multi_position" );
+	mlt_position self_pos = mlt_frame_get_position( frame );
+	double self_time = self_pos / self_fps;
+	double nested_time = nested_pos / nested_fps;
+
+	// the audio for the current frame
+	uint8_t *buffer = audio->buffer;
+	mlt_audio_format format = audio->format;
+	int channels = audio->channels;
+	int frequency = audio->frequency;
+	int current_samples = audio->samples;
+	int current_size = mlt_audio_format_size( format, current_samples, channels );
+
+	// get any leftover audio
+	int prev_size = 0;
+	uint8_t *prev_buffer = mlt_properties_get_data( nested_props, "_multi_audio", &prev_size );
+	uint8_t *new_buffer = NULL;
+	if ( prev_size > 0 )
+	{
+		new_buffer = mlt_pool_alloc( prev_size + current_size );
+		memcpy( new_buffer, prev_buffer, prev_size );
+		memcpy( new_buffer + prev_size, buffer, current_size );
+		buffer = new_buffer;
+	}
+	current_size += prev_size;
+	current_samples += mlt_properties_get_int( nested_props, "_multi_samples" );
+
+	while ( nested_time <= self_time )
+	{
+		// put ideal number of samples into cloned frame
+		mlt_frame clone_frame = mlt_frame_clone( frame, deeply );
+		mlt_properties clone_props = MLT_FRAME_PROPERTIES( clone_frame );
+		int nested_samples = mlt_audio_calculate_frame_samples( nested_fps, frequency, nested_pos );
+		// -10 is an optimization to avoid tiny amounts of leftover samples
+		nested_samples = nested_samples > current_samples - 10 ? current_samples : nested_samples;
+		int nested_size = mlt_audio_format_size( format, nested_samples, channels );
+		if ( nested_size > 0 )
+		{
+			prev_buffer = mlt_pool_alloc( nested_size );
+			memcpy( prev_buffer, buffer, nested_size );
+		}
+		else
+		{
+			prev_buffer = NULL;
+			nested_size = 0;
+		}
+		mlt_frame_set_audio( clone_frame, prev_buffer, format, nested_size, mlt_pool_release );
+		mlt_properties_set_int( clone_props, "audio_samples", nested_samples );
+		mlt_properties_set_int( clone_props, "audio_frequency", frequency );
+		mlt_properties_set_int( clone_props, "audio_channels", channels );
+
+		// chomp the audio
+		current_samples -= nested_samples;
+		current_size -= nested_size;
+		buffer += nested_size;
+
+		// Fix some things
+		mlt_properties_set_int( clone_props, "meta.media.width",
+			mlt_properties_get_int( MLT_FRAME_PROPERTIES(frame), "width" ) );
+		mlt_properties_set_int( clone_props, "meta.media.height",
+			mlt_properties_get_int( MLT_FRAME_PROPERTIES(frame), "height" ) );
+
+		// send frame to nested consumer
+		mlt_consumer_put_frame( nested, clone_frame );
+		mlt_properties_set_position( nested_props, "_multi_position", ++nested_pos );
+		nested_time = nested_pos / nested_fps;
+	}
+
+	// save any remaining audio
+	if ( current_size > 0 )
+	{
+		prev_buffer = mlt_pool_alloc( current_size );
+		memcpy( prev_buffer, buffer, current_size );
+	}
+	else
+	{
+		prev_buffer = NULL;
+		current_size = 0;
+	}
+	mlt_pool_release( new_buffer );
+	mlt_properties_set_data( nested_props, "_multi_audio", prev_buffer, current_size, mlt_pool_release, NULL );
+	mlt_properties_set_int( nested_props, "_multi_samples", current_samples );
+}
+
+/** The queue and thread that feed one nested consumer.
+ *
+ * The frames are queued by reference, so that a slow output only holds up
+ * the others once its queue is full.
+ */
+
+typedef struct
+{
+	mlt_consumer consumer;
+	mlt_consumer nested;
+	int deeply;
+	int depth;
+	int running;
+	mlt_deque queue;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} multi_feeder;
+
+static void *feeder_thread( void *arg )
+{
+	multi_feeder *feeder = arg;
+
+	while ( 1 )
+	{
+		pthread_mutex_lock( &feeder->mutex );
+		while ( feeder->running && !mlt_deque_count( feeder->queue ) )
+			pthread_cond_wait( &feeder->cond, &feeder->mutex );
+		mlt_frame frame = mlt_deque_pop_front( feeder->queue );
+		pthread_cond_broadcast( &feeder->cond );
+		pthread_mutex_unlock( &feeder->mutex );
+
+		// Stop once the queue is drained
+		if ( !frame )
+			break;
+		put_nested( feeder->consumer, feeder->nested, frame, feeder->deeply,
+			mlt_properties_get_data( MLT_FRAME_PROPERTIES(frame), "_multi_audio", NULL ) );
+		mlt_frame_close( frame );
+	}
+	return NULL;
+}
+
+static void feeder_put( multi_feeder *feeder, mlt_frame frame )
+{
+	pthread_mutex_lock( &feeder->mutex );
+	while ( feeder->running && mlt_deque_count( feeder->queue ) >= feeder->depth )
+		pthread_cond_wait( &feeder->cond, &feeder->mutex );
+	mlt_properties_inc_ref( MLT_FRAME_PROPERTIES(frame) );
+	mlt_deque_push_back( feeder->queue, frame );
+	pthread_cond_broadcast( &feeder->cond );
+	pthread_mutex_unlock( &feeder->mutex );
+}
+
+static void feeder_purge( multi_feeder *feeder )
+{
+	mlt_frame frame;
+
+	pthread_mutex_lock( &feeder->mutex );
+	while ( ( frame = mlt_deque_pop_front( feeder->queue ) ) )
+		mlt_frame_close( frame );
+	pthread_cond_broadcast( &feeder->cond );
+	pthread_mutex_unlock( &feeder->mutex );
+}
+
+static void feeder_close( multi_feeder *feeder )
+{
+	pthread_mutex_lock( &feeder->mutex );
+	feeder->running = 0;
+	pthread_cond_broadcast( &feeder->cond );
+	pthread_mutex_unlock( &feeder->mutex );
+	pthread_join( feeder->thread, NULL );
+	mlt_deque_close( feeder->queue );
+	pthread_mutex_destroy( &feeder->mutex );
+	pthread_cond_destroy( &feeder->cond );
+	free( feeder );
+}
+
+static multi_feeder *feeder_open( mlt_consumer consumer, mlt_consumer nested, int deeply, int depth )
+{
+	multi_feeder *feeder = calloc( 1, sizeof( *feeder ) );
+
+	if ( feeder )
+	{
+		feeder->consumer = consumer;
+		feeder->nested = nested;
+		feeder->deeply = deeply;
+		feeder->depth = depth;
+		feeder->running = 1;
+		feeder->queue = mlt_deque_init();
+		pthread_mutex_init( &feeder->mutex, NULL );
+		pthread_cond_init( &feeder->cond, NULL );
+		if ( pthread_create( &feeder->thread, NULL, feeder_thread, feeder ) )
+		{
+			mlt_deque_close( feeder->queue );
+			pthread_mutex_destroy( &feeder->mutex );
+			pthread_cond_destroy( &feeder->cond );
+			free( feeder );
+			feeder = NULL;
+		}
+	}
+	return feeder;
+}
+
 static void foreach_consumer_start( mlt_consumer consumer )
 {
 	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
 	mlt_consumer nested = NULL;
 	char key[30];
 	int index = 0;
+	int depth = mlt_properties_get_int( properties, "queue_depth" );
 
 	do {
 		snprintf( key, sizeof(key), "%d.consumer", index++ );
@@ -308,10 +596,34 @@ static void foreach_consumer_start( mlt_consumer consumer )
 			mlt_properties_set_data( nested_props, "_multi_audio", NULL, 0, NULL, NULL );
 			mlt_properties_set_int( nested_props, "_multi_samples", 0 );
 			mlt_consumer_start( nested );
+
+			// Feed each output from its own thread
+			if ( depth > 0 )
+			{
+				multi_feeder *feeder = feeder_open( consumer, nested, index > 1, depth );
+				snprintf( key, sizeof(key), "%d.feeder", index - 1 );
+				mlt_properties_set_data( properties, key, feeder, 0, (mlt_destructor) feeder_close, NULL );
+			}
 		}
 	} while ( nested );
 }
 
+static void foreach_consumer_drain( mlt_consumer consumer )
+{
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+	char key[30];
+	int index = 0;
+
+	do {
+		snprintf( key, sizeof(key), "%d.consumer", index );
+		if ( !mlt_properties_get_data( properties, key, NULL ) )
+			break;
+		// Closing the feeder delivers the queued frames before it stops
+		snprintf( key, sizeof(key), "%d.feeder", index++ );
+		mlt_properties_set_data( properties, key, NULL, 0, NULL, NULL );
+	} while ( 1 );
+}
+
 static void foreach_consumer_refresh( mlt_consumer consumer )
 {
 	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
@@ -349,98 +661,27 @@ static void foreach_consumer_put( mlt_consumer consumer, mlt_frame frame )
 	char key[30];
 	int index = 0;
 
+	// get the audio for the current frame
+	multi_audio *audio = calloc( 1, sizeof( *audio ) );
+	double self_fps = mlt_properties_get_double( properties, "fps" );
+	audio->format = mlt_audio_s16;
+	audio->channels = mlt_properties_get_int( properties, "channels" );
+	audio->frequency = mlt_properties_get_int( properties, "frequency" );
+	audio->samples = mlt_audio_calculate_frame_samples( self_fps, audio->frequency, mlt_frame_get_position( frame ) );
+	mlt_frame_get_audio( frame, (void**) &audio->buffer, &audio->format, &audio->frequency, &audio->channels, &audio->samples );
+	mlt_properties_set_data( MLT_FRAME_PROPERTIES(frame), "_multi_audio", audio, 0, free, NULL );
+
 	do {
 		snprintf( key, sizeof(key), "%d.consumer", index++ );
 		nested = mlt_properties_get_data( properties, key, NULL );
 		if ( nested )
 		{
-			mlt_properties nested_props = MLT_CONSUMER_PROPERTIES(nested);
-			double self_fps = mlt_properties_get_double( properties, "fps" );
-			double nested_fps = mlt_properties_get_double( nested_props, "fps" );
-			mlt_position nested_pos = mlt_properties_get_position( nested_props, "_multi_position" );
-			mlt_position self_pos = mlt_frame_get_position( frame );
-			double self_time = self_pos / self_fps;
-			double nested_time = nested_pos / nested_fps;
-
-			// get the audio for the current frame
-			uint8_t *buffer = NULL;
-			mlt_audio_format format = mlt_audio_s16;
-			int channels = mlt_properties_get_int( properties, "channels" );
-			int frequency = mlt_properties_get_int( properties, "frequency" );
-			int current_samples = mlt_audio_calculate_frame_samples( self_fps, frequency, self_pos );
-			mlt_frame_get_audio( frame, (void**) &buffer, &format, &frequency, &channels, &current_samples );
-			int current_size = mlt_audio_format_size( format, current_samples, channels );
-
-			// get any leftover audio
-			int prev_size = 0;
-			uint8_t *prev_buffer = mlt_properties_get_data( nested_props, "_multi_audio", &prev_size );
-			uint8_t *new_buffer = NULL;
-			if ( prev_size > 0 )
-			{
-				new_buffer = mlt_pool_alloc( prev_size + current_size );
-				memcpy( new_buffer, prev_buffer, prev_size );
-				memcpy( new_buffer + prev_size, buffer, current_size );
-				buffer = new_buffer;
-			}
-			current_size += prev_size;
-			current_samples += mlt_properties_get_int( nested_props, "_multi_samples" );
-
-			while ( nested_time <= self_time )
-			{
-				// put ideal number of samples into cloned frame
-				int deeply = index > 1 ? 1 : 0;
-				mlt_frame clone_frame = mlt_frame_clone( frame, deeply );
-				mlt_properties clone_props = MLT_FRAME_PROPERTIES( clone_frame );
-				int nested_samples = mlt_audio_calculate_frame_samples( nested_fps, frequency, nested_pos );
-				// -10 is an optimization to avoid tiny amounts of leftover samples
-				nested_samples = nested_samples > current_samples - 10 ? current_samples : nested_samples;
-				int nested_size = mlt_audio_format_size( format, nested_samples, channels );
-				if ( nested_size > 0 )
-				{
-					prev_buffer = mlt_pool_alloc( nested_size );
-					memcpy( prev_buffer, buffer, nested_size );
-				}
-				else
-				{
-					prev_buffer = NULL;
-					nested_size = 0;
-				}
-				mlt_frame_set_audio( clone_frame, prev_buffer, format, nested_size, mlt_pool_release );
-				mlt_properties_set_int( clone_props, "audio_samples", nested_samples );
-				mlt_properties_set_int( clone_props, "audio_frequency", frequency );
-				mlt_properties_set_int( clone_props, "audio_channels", channels );
-
-				// chomp the audio
-				current_samples -= nested_samples;
-				current_size -= nested_size;
-				buffer += nested_size;
-
-				// Fix some things
-				mlt_properties_set_int( clone_props, "meta.media.width",
-					mlt_properties_get_int( MLT_FRAME_PROPERTIES(frame), "width" ) );
-				mlt_properties_set_int( clone_props, "meta.media.height",
-					mlt_properties_get_int( MLT_FRAME_PROPERTIES(frame), "height" ) );
-
-				// send frame to nested consumer
-				mlt_consumer_put_frame( nested, clone_frame );
-				mlt_properties_set_position( nested_props, "_multi_position", ++nested_pos );
-				nested_time = nested_pos / nested_fps;
-			}
-
-			// save any remaining audio
-			if ( current_size > 0 )
-			{
-				prev_buffer = mlt_pool_alloc( current_size );
-				memcpy( prev_buffer, buffer, current_size );
-			}
+			snprintf( key, sizeof(key), "%d.feeder", index - 1 );
+			multi_feeder *feeder = mlt_properties_get_data( properties, key, NULL );
+			if ( feeder )
+				feeder_put( feeder, frame );
 			else
-			{
-				prev_buffer = NULL;
-				current_size = 0;
-			}
-			mlt_pool_release( new_buffer );
-			mlt_properties_set_data( nested_props, "_multi_audio", prev_buffer, current_size, mlt_pool_release, NULL );
-			mlt_properties_set_int( nested_props, "_multi_samples", current_samples );
+				put_nested( consumer, nested, frame, index > 1, audio );
 		}
 	} while ( nested );
 }
@@ -527,6 +768,7 @@ static int stop( mlt_consumer consumer )
 		mlt_properties_set_int( properties, "joined", 1 );
 
 		// Stop nested consumers
+		foreach_consumer_drain( consumer );
 		foreach_consumer_stop( consumer );
 	}
 
@@ -554,6 +796,10 @@ static void purge( mlt_consumer consumer )
 		int index = 0;
 
 		do {
+			snprintf( key, sizeof(key), "%d.feeder", index );
+			multi_feeder *feeder = mlt_properties_get_data( properties, key, NULL );
+			if ( feeder )
+				feeder_purge( feeder );
 			snprintf( key, sizeof(key), "%d.consumer", index++ );
 			nested = mlt_properties_get_data( properties, key, NULL );
 			mlt_consumer_purge( nested );
@@ -39,9 +39,11 @@ extern mlt_filter filter_luma_init( mlt_profile profile, mlt_service_type type,
 extern mlt_filter filter_mask_apply_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_mask_start_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_mirror_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
+extern mlt_filter filter_mixbus_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_mono_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_obscure_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_panner_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
+extern mlt_filter filter_rendercache_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_rescale_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_resize_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_transition_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
@@ -54,6 +56,7 @@ extern mlt_producer producer_loader_init( mlt_profile profile, mlt_service_type
 extern mlt_producer producer_melt_file_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_producer producer_melt_init( mlt_profile profile, mlt_service_type type, const char *id, char **argv );
 extern mlt_producer producer_noise_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
+extern mlt_producer producer_proxy_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_producer producer_timewarp_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_producer producer_tone_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 #include "transition_composite.h"
@@ -77,6 +80,7 @@ MLT_REPOSITORY
 	MLT_REGISTER( mlt_service_filter_type, "audiomap", filter_audiomap_init );
 	MLT_REGISTER( mlt_service_filter_type, "audiowave", filter_audiowave_init );
 	MLT_REGISTER( mlt_service_filter_type, "brightness", filter_brightness_init );
+	MLT_REGISTER( mlt_service_filter_type, "cache", filter_rendercache_init );
 	MLT_REGISTER( mlt_service_filter_type, "channelcopy", filter_channelcopy_init );
 	MLT_REGISTER( mlt_service_filter_type, "channelswap", filter_channelcopy_init );
 	MLT_REGISTER( mlt_service_filter_type, "choppy", filter_choppy_init );
@@ -90,9 +94,11 @@ MLT_REPOSITORY
 	MLT_REGISTER( mlt_service_filter_type, "mask_apply", filter_mask_apply_init );
 	MLT_REGISTER( mlt_service_filter_type, "mask_start", filter_mask_start_init );
 	MLT_REGISTER( mlt_service_filter_type, "mirror", filter_mirror_init );
+	MLT_REGISTER( mlt_service_filter_type, "mixbus", filter_mixbus_init );
 	MLT_REGISTER( mlt_service_filter_type, "mono", filter_mono_init );
 	MLT_REGISTER( mlt_service_filter_type, "obscure", filter_obscure_init );
 	MLT_REGISTER( mlt_service_filter_type, "panner", filter_panner_init );
+	MLT_REGISTER( mlt_service_filter_type, "rendercache", filter_rendercache_init );
 	MLT_REGISTER( mlt_service_filter_type, "rescale", filter_rescale_init );
 	MLT_REGISTER( mlt_service_filter_type, "resize", filter_resize_init );
 	MLT_REGISTER( mlt_service_filter_type, "transition", filter_transition_init );
@@ -107,6 +113,7 @@ MLT_REPOSITORY
 	MLT_REGISTER( mlt_service_producer_type, "melt", producer_melt_init );
 	MLT_REGISTER( mlt_service_producer_type, "melt_file", producer_melt_file_init );
 	MLT_REGISTER( mlt_service_producer_type, "noise", producer_noise_init );
+	MLT_REGISTER( mlt_service_producer_type, "proxy", producer_proxy_init );
 	MLT_REGISTER( mlt_service_producer_type, "timewarp", producer_timewarp_init );
 	MLT_REGISTER( mlt_service_producer_type, "tone", producer_tone_init );
 	MLT_REGISTER( mlt_service_transition_type, "composite", transition_composite_init );
@@ -118,6 +125,7 @@ MLT_REPOSITORY
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "audiomap", metadata, "filter_audiomap.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "audiowave", metadata, "filter_audiowave.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "brightness", metadata, "filter_brightness.yml" );
+	MLT_REGISTER_METADATA( mlt_service_filter_type, "cache", metadata, "filter_cache.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "channelcopy", metadata, "filter_channelcopy.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "channelswap", metadata, "filter_channelcopy.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "choppy", metadata, "filter_choppy.yml" );
@@ -130,9 +138,11 @@ MLT_REPOSITORY
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "mask_apply", metadata, "filter_mask_apply.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "mask_start", metadata, "filter_mask_start.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "mirror", metadata, "filter_mirror.yml" );
+	MLT_REGISTER_METADATA( mlt_service_filter_type, "mixbus", metadata, "filter_mixbus.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "mono", metadata, "filter_mono.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "obscure", metadata, "filter_obscure.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "panner", metadata, "filter_panner.yml" );
+	MLT_REGISTER_METADATA( mlt_service_filter_type, "rendercache", metadata, "filter_rendercache.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "rescale", metadata, "filter_rescale.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "resize", metadata, "filter_resize.yml" );
 	MLT_REGISTER_METADATA( mlt_service_filter_type, "transition", metadata, "filter_transition.yml" );
@@ -146,6 +156,7 @@ MLT_REPOSITORY
 	MLT_REGISTER_METADATA( mlt_service_producer_type, "melt", metadata, "producer_melt.yml" );
 	MLT_REGISTER_METADATA( mlt_service_producer_type, "melt_file", metadata, "producer_melt_file.yml" );
 	MLT_REGISTER_METADATA( mlt_service_producer_type, "noise", metadata, "producer_noise.yml" );
+	MLT_REGISTER_METADATA( mlt_service_producer_type, "proxy", metadata, "producer_proxy.yml" );
 	MLT_REGISTER_METADATA( mlt_service_producer_type, "timewarp", metadata, "producer_timewarp.yml" );
 	MLT_REGISTER_METADATA( mlt_service_producer_type, "tone", metadata, "producer_tone.yml" );
 	MLT_REGISTER_METADATA( mlt_service_transition_type, "composite", metadata, "transition_composite.yml" );
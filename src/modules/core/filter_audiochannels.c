@@ -28,6 +28,13 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 	// Used to return number of channels in the source
 	int channels_avail = *channels;
 
+	// Only the channels that are kept or mixed down are used from the source
+	int source_channels = mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "audio_channels" );
+	if ( source_channels == 6 && *channels == 2 )
+		mlt_frame_set_audio_channels_used( frame, 0x37 );
+	else if ( source_channels > *channels && *channels > 0 && *channels < 64 )
+		mlt_frame_set_audio_channels_used( frame, ( UINT64_C(1) << *channels ) - 1 );
+
 	// Get the producer's audio
 	int error = mlt_frame_get_audio( frame, buffer, format, frequency, &channels_avail, samples );
 	if ( error ) return error;
@@ -241,7 +248,9 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 
 static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
 {
-	mlt_frame_push_audio( frame, filter_get_audio );
+	// A frame without audio gets silence with the channels it asks for
+	if ( !mlt_frame_is_test_audio( frame ) )
+		mlt_frame_push_audio( frame, filter_get_audio );
 	return frame;
 }
 
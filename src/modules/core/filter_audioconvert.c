@@ -17,6 +17,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <framework/mlt_audio.h>
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_log.h>
@@ -24,6 +25,36 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+// Split interleaved samples into the planes of a planar buffer, returning true on error
+static int to_planar( void *dst, const void *src, int sample_size, int channels, int samples )
+{
+	void **planes = malloc( channels * sizeof( *planes ) );
+	int c;
+
+	if ( !planes )
+		return 1;
+	for ( c = 0; c < channels; c++ )
+		planes[c] = (uint8_t*) dst + c * samples * sample_size;
+	mlt_audio_deinterleave( planes, src, sample_size, channels, samples );
+	free( planes );
+	return 0;
+}
+
+// Interleave the planes of a planar buffer, returning true on error
+static int to_interleaved( void *dst, const void *src, int sample_size, int channels, int samples )
+{
+	const void **planes = malloc( channels * sizeof( *planes ) );
+	int c;
+
+	if ( !planes )
+		return 1;
+	for ( c = 0; c < channels; c++ )
+		planes[c] = (const uint8_t*) src + c * samples * sample_size;
+	mlt_audio_interleave( dst, planes, sample_size, channels, samples );
+	free( planes );
+	return 0;
+}
+
 static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *format, mlt_audio_format requested_format )
 {
 	int error = 1;
@@ -64,18 +95,15 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_float:
 			{
 				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
+				int16_t *planar = mlt_pool_alloc( samples * channels * sizeof( int16_t ) );
+				if ( to_planar( planar, *audio, sizeof( int16_t ), channels, samples ) )
 				{
-					int16_t *q = (int16_t*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						*p++ = (float)( *q ) / 32768.0;
-						q += channels;
-					}
+					mlt_pool_release( planar );
+					mlt_pool_release( buffer );
+					break;
 				}
+				mlt_audio_s16_to_f32( buffer, planar, samples * channels );
+				mlt_pool_release( planar );
 				*audio = buffer;
 				error = 0;
 				break;
@@ -95,14 +123,7 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_f32le:
 			{
 				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int16_t *q = (int16_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-				{
-					float f = (float)( *q++ ) / 32768.0;
-					*p++ = CLAMP( f, -1.0f, 1.0f );
-				}
+				mlt_audio_s16_to_f32( buffer, *audio, samples * channels );
 				*audio = buffer;
 				error = 0;
 				break;
@@ -142,11 +163,7 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_float:
 			{
 				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int32_t *q = (int32_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-					*p++ = (float)( *q++ ) / 2147483648.0;
+				mlt_audio_s32_to_f32( buffer, *audio, samples * channels );
 				*audio = buffer;
 				error = 0;
 				break;
@@ -154,12 +171,11 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_s32le:
 			{
 				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				int32_t *q = (int32_t*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-						*p++ = *( q + c * samples + s );
+				if ( to_interleaved( buffer, *audio, sizeof( int32_t ), channels, samples ) )
+				{
+					mlt_pool_release( buffer );
+					break;
+				}
 				*audio = buffer;
 				error = 0;
 				break;
@@ -167,15 +183,12 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_f32le:
 			{
 				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int32_t *q = (int32_t*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-					{
-						float f = (float)( *( q + c * samples + s ) ) / 2147483648.0;
-						*p++ = CLAMP( f, -1.0f, 1.0f );
-					}
+				if ( to_interleaved( buffer, *audio, sizeof( int32_t ), channels, samples ) )
+				{
+					mlt_pool_release( buffer );
+					break;
+				}
+				mlt_audio_s32_to_f32( buffer, (int32_t*) buffer, samples * channels );
 				*audio = buffer;
 				error = 0;
 				break;
@@ -203,16 +216,15 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_s16:
 			{
 				int16_t *buffer = mlt_pool_alloc( size );
-				int16_t *p = buffer;
-				float *q = (float*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-					{
-						float f = *( q + c * samples + s );
-						f = CLAMP( f, -1.0f, 1.0f );
-						*p++ = 32767 * f;
-					}
+				int16_t *planar = mlt_pool_alloc( samples * channels * sizeof( int16_t ) );
+				mlt_audio_f32_to_s16( planar, *audio, samples * channels );
+				if ( to_interleaved( buffer, planar, sizeof( int16_t ), channels, samples ) )
+				{
+					mlt_pool_release( planar );
+					mlt_pool_release( buffer );
+					break;
+				}
+				mlt_pool_release( planar );
 				*audio = buffer;
 				error = 0;
 				break;
@@ -220,16 +232,7 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_s32:
 			{
 				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				float *q = (float*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-				{
-					float f = *q++;
-					f = CLAMP( f, -1.0f, 1.0f );
-					int64_t pcm = ( f > 0.0f ? 2147483647LL : 2147483648LL ) * f;
-					*p++ = CLAMP( pcm, -2147483648LL, 2147483647LL );
-				}
+				mlt_audio_f32_to_s32( buffer, *audio, samples * channels );
 				*audio = buffer;
 				error = 0;
 				break;
@@ -237,17 +240,12 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_s32le:
 			{
 				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				float *q = (float*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-					{
-						float f = *( q + c * samples + s );
-						f = CLAMP( f, -1.0f, 1.0f );
-						int64_t pcm = ( f > 0.0f ? 2147483647LL : 2147483648LL ) * f;
-						*p++ = CLAMP( pcm, -2147483648LL, 2147483647LL );
-					}
+				if ( to_interleaved( buffer, *audio, sizeof( float ), channels, samples ) )
+				{
+					mlt_pool_release( buffer );
+					break;
+				}
+				mlt_audio_f32_to_s32( buffer, (float*) buffer, samples * channels );
 				*audio = buffer;
 				error = 0;
 				break;
@@ -255,12 +253,11 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_f32le:
 			{
 				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				float *q = (float*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-						*p++ = *( q + c * samples + s );
+				if ( to_interleaved( buffer, *audio, sizeof( float ), channels, samples ) )
+				{
+					mlt_pool_release( buffer );
+					break;
+				}
 				*audio = buffer;
 				error = 0;
 				break;
@@ -304,17 +301,10 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_s32:
 			{
 				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
+				if ( to_planar( buffer, *audio, sizeof( int32_t ), channels, samples ) )
 				{
-					int32_t *q = (int32_t*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						*p++ = *q;
-						q += channels;
-					}
+					mlt_pool_release( buffer );
+					break;
 				}
 				*audio = buffer;
 				error = 0;
@@ -323,18 +313,12 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_float:
 			{
 				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
+				if ( to_planar( buffer, *audio, sizeof( int32_t ), channels, samples ) )
 				{
-					int32_t *q = (int32_t*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						*p++ = (float)( *q ) / 2147483648.0;
-						q += channels;
-					}
+					mlt_pool_release( buffer );
+					break;
 				}
+				mlt_audio_s32_to_f32( buffer, (int32_t*) buffer, samples * channels );
 				*audio = buffer;
 				error = 0;
 				break;
@@ -342,11 +326,7 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_f32le:
 			{
 				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int32_t *q = (int32_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-					*p++ = (float)( *q++ ) / 2147483648.0;
+				mlt_audio_s32_to_f32( buffer, *audio, samples * channels );
 				*audio = buffer;
 				error = 0;
 				break;
@@ -373,15 +353,7 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_s16:
 			{
 				int16_t *buffer = mlt_pool_alloc( size );
-				int16_t *p = buffer;
-				float *q = (float*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-				{
-					float f = *q++;
-					f = CLAMP( f, -1.0f , 1.0f );
-					*p++ = 32767 * f;
-				}
+				mlt_audio_f32_to_s16( buffer, *audio, samples * channels );
 				*audio = buffer;
 				error = 0;
 				break;
@@ -389,17 +361,10 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_float:
 			{
 				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
+				if ( to_planar( buffer, *audio, sizeof( float ), channels, samples ) )
 				{
-					float *q = (float*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						*p++ = *q;
-						q += channels;
-					}
+					mlt_pool_release( buffer );
+					break;
 				}
 				*audio = buffer;
 				error = 0;
@@ -408,21 +373,12 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_s32:
 			{
 				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
+				if ( to_planar( buffer, *audio, sizeof( float ), channels, samples ) )
 				{
-					float *q = (float*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						float f = *q;
-						f = CLAMP( f, -1.0f , 1.0f );
-						int64_t pcm = ( f > 0.0f ? 2147483647LL : 2147483648LL ) * f;
-						*p++ = CLAMP( pcm, -2147483648LL, 2147483647LL );
-						q += channels;
-					}
+					mlt_pool_release( buffer );
+					break;
 				}
+				mlt_audio_f32_to_s32( buffer, (float*) buffer, samples * channels );
 				*audio = buffer;
 				error = 0;
 				break;
@@ -430,16 +386,7 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 			case mlt_audio_s32le:
 			{
 				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				float *q = (float*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-				{
-					float f = *q++;
-					f = CLAMP( f, -1.0f , 1.0f );
-					int64_t pcm = ( f > 0.0f ? 2147483647LL : 2147483648LL ) * f;
-					*p++ = CLAMP( pcm, -2147483648LL, 2147483647LL );
-				}
+				mlt_audio_f32_to_s32( buffer, *audio, samples * channels );
 				*audio = buffer;
 				error = 0;
 				break;
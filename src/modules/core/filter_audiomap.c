@@ -32,19 +32,8 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 	int i, j, l, m[MAX_CHANNELS];
 
 	mlt_filter filter = mlt_frame_pop_audio(frame);
-
-	// Get the producer's audio
-	int error = mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
-	if ( error ) return error;
-
 	mlt_properties properties = MLT_FILTER_PROPERTIES(filter);
 
-	/* find samples length */
-	int len = mlt_audio_format_size( *format, 1, 1 );
-
-	/* pcm samples buffer */
-	uint8_t *pcm = *buffer;
-
 	/* build matrix */
 	for ( i = 0; i < MAX_CHANNELS; i++ )
 	{
@@ -59,6 +48,25 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 		}
 	}
 
+	/* only the sources of the used channels are used */
+	uint64_t used, sources;
+	mlt_frame_get_audio_channels_used( frame, &used );
+	sources = used & ~( ( UINT64_C(1) << MAX_CHANNELS ) - 1 );
+	for ( i = 0; i < MAX_CHANNELS; i++ )
+		if ( used & ( UINT64_C(1) << i ) )
+			sources |= UINT64_C(1) << m[i];
+	mlt_frame_set_audio_channels_used( frame, sources );
+
+	// Get the producer's audio
+	int error = mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
+	if ( error ) return error;
+
+	/* find samples length */
+	int len = mlt_audio_format_size( *format, 1, 1 );
+
+	/* pcm samples buffer */
+	uint8_t *pcm = *buffer;
+
 	/* process samples */
 	for ( i = 0; i < *samples; i++ )
 	{
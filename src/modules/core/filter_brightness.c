@@ -27,36 +27,26 @@
 #include <math.h>
 
 
+typedef struct
+{
+	mlt_property level;
+	mlt_property alpha;
+} private_data;
+
 struct sliced_desc
 {
 	mlt_image image;
-	double level;
 	double alpha_level;
+	int x, y, width, height; // the region of interest
 };
 
 static int sliced_proc(int id, int index, int jobs, void* cookie)
 {
 	(void) id; // unused
 	struct sliced_desc* ctx = ((struct sliced_desc*) cookie);
-	int slice_height = (ctx->image->height + jobs - 1) / jobs;
-	int slice_line_start = index * slice_height;
-	slice_height = MIN(slice_height, ctx->image->height - slice_line_start);
-
-	// Only process if level is something other than 1
-	if (ctx->level != 1.0 && ctx->image->format == mlt_image_yuv422) {
-		int32_t m = ctx->level * (1 << 16);
-		int32_t n = 128 * ((1 << 16 ) - m);
-		for ( int line = 0; line < slice_height; line++ )
-		{
-			uint8_t* p = ctx->image->planes[0] + ( (slice_line_start + line) * ctx->image->strides[0]);
-			for ( int pixel = 0; pixel < ctx->image->width; pixel++ )
-			{
-				*p++ = CLAMP((*p * m) >> 16, 16, 235);
-				*p++ = CLAMP((*p * m + n) >> 16, 16, 240);
-			}
-		}
-
-	}
+	int slice_height = (ctx->height + jobs - 1) / jobs;
+	int slice_line_start = ctx->y + index * slice_height;
+	slice_height = MIN(slice_height, ctx->y + ctx->height - slice_line_start);
 
 	// Process the alpha channel if requested.
 	if (ctx->alpha_level != 1.0) {
@@ -64,8 +54,8 @@ static int sliced_proc(int id, int index, int jobs, void* cookie)
 		if (ctx->image->format == mlt_image_rgba) {
 			for ( int line = 0; line < slice_height; line++ )
 			{
-				uint8_t* p = ctx->image->planes[0] + ( (slice_line_start + line) * ctx->image->strides[0]) + 3;
-				for ( int pixel = 0; pixel < ctx->image->width; pixel++ )
+				uint8_t* p = ctx->image->planes[0] + ( (slice_line_start + line) * ctx->image->strides[0]) + ctx->x * 4 + 3;
+				for ( int pixel = 0; pixel < ctx->width; pixel++ )
 				{
 					*p = (*p * m) >> 16;
 					p += 4;
@@ -74,8 +64,8 @@ static int sliced_proc(int id, int index, int jobs, void* cookie)
 		} else {
 			for ( int line = 0; line < slice_height; line++ )
 			{
-				uint8_t* p = ctx->image->planes[3] + ( (slice_line_start + line) * ctx->image->strides[3]);
-				for ( int pixel = 0; pixel < ctx->image->width; pixel++ )
+				uint8_t* p = ctx->image->planes[3] + ( (slice_line_start + line) * ctx->image->strides[3]) + ctx->x;
+				for ( int pixel = 0; pixel < ctx->width; pixel++ )
 				{
 					*p++ = (*p * m) >> 16;
 				}
@@ -91,6 +81,7 @@ static int sliced_proc(int id, int index, int jobs, void* cookie)
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
 	mlt_filter filter =  (mlt_filter) mlt_frame_pop_service( frame );
+	private_data *pdata = (private_data*) filter->child;
 	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
 	mlt_position position = mlt_filter_get_position( filter, frame );
 	mlt_position length = mlt_filter_get_length2( filter, frame );
@@ -98,10 +89,9 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	double alpha_level = 1.0;
 
 	// Use animated "level" property only if it has been set since init
-	char* level_property = mlt_properties_get( properties, "level" );
-	if ( level_property != NULL )
+	if ( mlt_properties_get_string_property( properties, pdata->level ) != NULL )
 	{
-		level = mlt_properties_anim_get_double( properties, "level", position, length );
+		level = mlt_properties_anim_get_double_property( properties, pdata->level, position, length );
 	}
 	else
 	{
@@ -118,21 +108,48 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		}
 	}
 
-	// Do not cause an image conversion unless there is real work to do.
-	if ( level != 1.0 )
-		*format = mlt_image_yuv422;
+	// Changing each pixel on its own keeps the region of interest
+	mlt_rect roi;
+	mlt_frame_get_roi( frame, &roi );
 
 	// Get the image
-	int error = mlt_frame_get_image( frame, image, format, width, height, 1 );
+	int error;
+	if ( level != 1.0 )
+	{
+		// Scale the luma and the chroma around neutral with lookup tables
+		uint8_t luma[256], chroma[256];
+		const uint8_t *luts[MLT_IMAGE_MAX_PLANES] = { luma, chroma, chroma, NULL };
+		int32_t m = level * (1 << 16);
+		int32_t n = 128 * ((1 << 16 ) - m);
+		for ( int i = 0; i < 256; i++ )
+		{
+			luma[i] = CLAMP((i * m) >> 16, 16, 235);
+			chroma[i] = CLAMP((i * m + n) >> 16, 16, 240);
+		}
+		// The same tables work on the planes of 4:2:0, so keep it if asked for
+		if ( *format != mlt_image_yuv420p )
+			*format = mlt_image_yuv422;
+		error = mlt_frame_get_image_lut( frame, image, format, width, height, luts );
+	}
+	else
+	{
+		// Do not cause an image conversion unless there is real work to do.
+		error = mlt_frame_get_image( frame, image, format, width, height, 1 );
+	}
+
+	// Scaling the alpha keeps transparent pixels transparent
+	mlt_rect bounds;
+	int opaque;
+	int has_bounds = mlt_frame_get_alpha_bounds( frame, &bounds, &opaque );
 
-	level = (*format == mlt_image_yuv422) ? level : 1.0;
-	alpha_level = mlt_properties_get(properties, "alpha")? MIN(mlt_properties_anim_get_double(properties, "alpha", position, length), 1.0) : 1.0;
+	level = (*format == mlt_image_yuv422 || *format == mlt_image_yuv420p) ? level : 1.0;
+	alpha_level = mlt_properties_get_string_property(properties, pdata->alpha)? MIN(mlt_properties_anim_get_double_property(properties, pdata->alpha, position, length), 1.0) : 1.0;
 	if (alpha_level < 0.0) {
 		alpha_level = level;
 	}
 
-	// Only process if we have no error.
-	if (!error && (level != 1.0 || alpha_level != 1.0)) {
+	// Only process the alpha channel if we have no error.
+	if (!error && alpha_level != 1.0) {
 		int threads = mlt_properties_get_int(properties, "threads");
 		struct sliced_desc desc;
 		struct mlt_image_s proc_image;
@@ -144,12 +161,16 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 				// Alpha will be needed but it does not exist yet. Create opaque alpha.
 				mlt_image_alloc_alpha( &proc_image );
 				mlt_image_fill_opaque( &proc_image );
+				mlt_image_pack( &proc_image );
 				mlt_frame_set_alpha( frame, proc_image.planes[3], 0, proc_image.release_alpha );
 			}
 		}
-		desc.level = level;
 		desc.alpha_level = alpha_level;
 		desc.image = &proc_image;
+		desc.x = floor( roi.x * *width );
+		desc.y = floor( roi.y * *height );
+		desc.width = MAX( MIN( (int) ceil( ( roi.x + roi.w ) * *width ), *width ) - desc.x, 0 );
+		desc.height = MAX( MIN( (int) ceil( ( roi.y + roi.h ) * *height ), *height ) - desc.y, 0 );
 
 		threads = CLAMP(threads, 0, mlt_slices_count_normal());
 		if (threads == 1) {
@@ -157,6 +178,8 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		} else {
 			mlt_slices_run_normal(threads, sliced_proc, &desc);
 		}
+		if (has_bounds)
+			mlt_frame_set_alpha_bounds(frame, bounds, opaque && alpha_level >= 1.0);
 	}
 
 	return error;
@@ -173,17 +196,40 @@ static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
 	return frame;
 }
 
+static void filter_close( mlt_filter filter )
+{
+	free( filter->child );
+	filter->child = NULL;
+	filter->close = NULL;
+	filter->parent.close = NULL;
+	mlt_service_close( &filter->parent );
+}
+
 /** Constructor for the filter.
 */
 
 mlt_filter filter_brightness_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg )
 {
 	mlt_filter filter = mlt_filter_new( );
-	if ( filter != NULL )
+	private_data *pdata = (private_data*) calloc( 1, sizeof( private_data ) );
+	if ( filter != NULL && pdata != NULL )
 	{
+		mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
 		filter->process = filter_process;
-		mlt_properties_set( MLT_FILTER_PROPERTIES( filter ), "start", arg == NULL ? "1" : arg );
-		mlt_properties_set( MLT_FILTER_PROPERTIES( filter ), "level", NULL );
+		filter->close = filter_close;
+		filter->child = pdata;
+		mlt_properties_set( properties, "start", arg == NULL ? "1" : arg );
+		mlt_properties_set( properties, "level", NULL );
+
+		// Look up the animated parameters once instead of on every frame
+		pdata->level = mlt_properties_get_property( properties, "level" );
+		pdata->alpha = mlt_properties_get_property( properties, "alpha" );
+	}
+	else
+	{
+		mlt_filter_close( filter );
+		filter = NULL;
+		free( pdata );
 	}
 	return filter;
 }
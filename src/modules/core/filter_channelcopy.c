@@ -38,6 +38,20 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 	int to = mlt_properties_get_int( properties, "to" );
 	int swap = mlt_properties_get_int( properties, "swap" );
 
+	// Copying over a channel leaves its own samples unused
+	uint64_t used;
+	mlt_frame_get_audio_channels_used( frame, &used );
+	if ( from != to && from >= 0 && from < 64 && to >= 0 && to < 64 )
+	{
+		uint64_t from_bit = UINT64_C(1) << from, to_bit = UINT64_C(1) << to;
+		uint64_t sources = used & ~( from_bit | to_bit );
+		if ( used & to_bit )
+			sources |= from_bit;
+		if ( used & from_bit )
+			sources |= swap ? to_bit : from_bit;
+		mlt_frame_set_audio_channels_used( frame, sources );
+	}
+
 	// Get the producer's audio
 	mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
 
@@ -45,24 +45,23 @@ static int get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format
 			mlt_properties_set_data(properties, "cloned_frame", cloned_frame, 0, (mlt_destructor) mlt_frame_close, NULL);
 			mlt_service_unlock(MLT_FILTER_SERVICE(filter));
 		} else {
+			// Share the held image, so that a repeated frame is copied only if it is written
+			int size = 0;
+			uint8_t *shared = mlt_frame_share_image(cloned_frame, &size);
+			mlt_properties_inc_ref(MLT_FRAME_PROPERTIES(cloned_frame));
 			mlt_service_unlock(MLT_FILTER_SERVICE(filter));
 			error = mlt_frame_get_image(frame, image, format, width, height, writable);
 			if (!error) {
 				mlt_properties cloned_props = MLT_FRAME_PROPERTIES(cloned_frame);
-				int size = 0;
-				void *data = mlt_properties_get_data(cloned_props, "image", &size);
-				if (data) {
+				if (shared) {
 					*width = mlt_properties_get_int(cloned_props, "width");
 					*height = mlt_properties_get_int(cloned_props, "height");
 					*format = mlt_properties_get_int(cloned_props, "format");
-					if (!size) {
-						size = mlt_image_format_size(*format, *width, *height, NULL);
-					}
-					*image = mlt_pool_alloc(size);
-					memcpy(*image, data, size);
-					mlt_frame_set_image(frame, *image, size, mlt_pool_release);
+					*image = shared;
+					mlt_frame_set_image(frame, *image, size, mlt_image_buffer_release);
+					shared = NULL;
 
-					data = mlt_properties_get_data(cloned_props, "alpha", &size);
+					void *data = mlt_properties_get_data(cloned_props, "alpha", &size);
 					if (data) {
 						if (!size) {
 							size = (*width) * (*height);
@@ -73,6 +72,8 @@ static int get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format
 					}
 				}
 			}
+			mlt_image_buffer_release(shared);
+			mlt_frame_close(cloned_frame);
 		}
 	} else {
 		error = mlt_frame_get_image(frame, image, format, width, height, writable);
@@ -27,21 +27,6 @@
 #include <stdlib.h>
 #include <math.h>
 
-static void crop( uint8_t *src, uint8_t *dest, int bpp, int width, int height, int left, int right, int top, int bottom )
-{
-	int src_stride = ( width  ) * bpp;
-	int dest_stride = ( width - left - right ) * bpp;
-	int y      = height - top - bottom + 1;
-	src += top * src_stride + left * bpp;
-
-	while ( --y )
-	{
-		memcpy( dest, src, dest_stride );
-		dest += dest_stride;
-		src += src_stride;
-	}
-}
-
 /** Do it :-).
 */
 
@@ -65,16 +50,43 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	int top     = mlt_properties_get_int( properties, "crop.top" );
 	int bottom  = mlt_properties_get_int( properties, "crop.bottom" );
 
+	// The part of the image that the caller needs
+	mlt_rect roi;
+
 	// Request the image at its original resolution
 	if ( left || right || top || bottom )
 	{
-		mlt_properties_set_int( properties, "rescale_width", mlt_properties_get_int( properties, "crop.original_width" ) );
-		mlt_properties_set_int( properties, "rescale_height", mlt_properties_get_int( properties, "crop.original_height" ) );
+		int original_width = mlt_properties_get_int( properties, "crop.original_width" );
+		int original_height = mlt_properties_get_int( properties, "crop.original_height" );
+		mlt_properties_set_int( properties, "rescale_width", original_width );
+		mlt_properties_set_int( properties, "rescale_height", original_height );
+
+		// Nothing outside of the crop window is needed from the original
+		if ( original_width > left + right && original_height > top + bottom )
+		{
+			double crop_width = original_width - left - right;
+			double crop_height = original_height - top - bottom;
+			mlt_frame_get_roi( frame, &roi );
+			roi.x = ( left + roi.x * crop_width ) / original_width;
+			roi.y = ( top + roi.y * crop_height ) / original_height;
+			roi.w = roi.w * crop_width / original_width;
+			roi.h = roi.h * crop_height / original_height;
+			mlt_frame_set_roi( frame, roi );
+		}
+	}
+	else
+	{
+		mlt_frame_get_roi( frame, &roi );
 	}
 
 	// Now get the image
 	error = mlt_frame_get_image( frame, image, format, width, height, writable );
 
+	// Keep the alpha bounds, which are moved with the crop below
+	mlt_rect bounds;
+	int opaque;
+	int has_bounds = mlt_frame_get_alpha_bounds( frame, &bounds, &opaque );
+
 	int owidth  = *width - left - right;
 	int oheight = *height - top - bottom;
 	owidth = owidth < 0 ? 0 : owidth;
@@ -83,7 +95,9 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	if ( ( owidth != *width || oheight != *height ) &&
 		error == 0 && *image != NULL && owidth > 0 && oheight > 0 )
 	{
-		int bpp;
+		// 4:2:0 is kept as long as the crop keeps whole chroma samples
+		if ( *format == mlt_image_yuv420p && frame->convert_image && ( ( left | right | top | bottom ) & 1 ) )
+			frame->convert_image( frame, image, format, mlt_image_yuv422 );
 
 		// Subsampled YUV is messy and less precise.
 		if (*format == mlt_image_yuv422 && frame->convert_image && (left & 1 || right & 1))
@@ -98,34 +112,19 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		if ( top % 2 )
 			mlt_properties_set_int( properties, "top_field_first", !mlt_properties_get_int( properties, "top_field_first" ) );
 		
-		// Create the output image
-		int size = mlt_image_format_size( *format, owidth, oheight, &bpp );
-		uint8_t *output = mlt_pool_alloc( size );
-		if ( output )
-		{
-			// Call the generic resize
-			crop( *image, output, bpp, *width, *height, left, right, top, bottom );
+		// The image and its alpha are only copied if the caller needs them packed
+		mlt_frame_crop_image( frame, *format, *width, *height, left, right, top, bottom );
 
-			// Now update the frame
-			mlt_frame_set_image( frame, output, size, mlt_pool_release );
-			*image = output;
-		}
-
-		// We should resize the alpha too
-		uint8_t *alpha = mlt_frame_get_alpha( frame );
-		int alpha_size = 0;
-		mlt_properties_get_data( properties, "alpha", &alpha_size );
-		if ( alpha && alpha_size >= ( *width * *height ) )
+		if ( has_bounds && bounds.w > 0 && bounds.h > 0 )
 		{
-			uint8_t *newalpha = mlt_pool_alloc( owidth * oheight );
-			if ( newalpha )
-			{
-				crop( alpha, newalpha, 1, *width, *height, left, right, top, bottom );
-				mlt_frame_set_alpha( frame, newalpha, owidth * oheight, mlt_pool_release );
-			}
+			int x0 = MAX( bounds.x - left, 0 );
+			int y0 = MAX( bounds.y - top, 0 );
+			int x1 = MIN( bounds.x + bounds.w - left, owidth );
+			int y1 = MIN( bounds.y + bounds.h - top, oheight );
+			bounds = (mlt_rect) { x0, y0, MAX( x1 - x0, 0 ), MAX( y1 - y0, 0 ), 1.0 };
 		}
-		*width = owidth;
-		*height = oheight;
+		if ( has_bounds )
+			mlt_frame_set_alpha_bounds( frame, bounds, opaque );
 	}
 
 	return error;
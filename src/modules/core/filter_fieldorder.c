@@ -24,8 +24,50 @@
 #include <stdlib.h>
 #include <math.h>
 
+struct sliced_desc
+{
+	uint8_t *src[4];
+	uint8_t *dst[4];
+	int strides[4];
+	int height;
+	int swap;   // swap the lines of each field pair instead of moving down one line
+};
+
+static int sliced_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	int start = ctx->height * index / jobs;
+	int end = ctx->height * ( index + 1 ) / jobs;
+	int p, line;
+
+	for ( p = 0; p < 4; p++ )
+	{
+		if ( !ctx->dst[p] )
+			continue;
+		for ( line = start; line < end; line++ )
+		{
+			int from = ctx->swap ? MIN( line ^ 1, ctx->height - 1 ) : MAX( line - 1, 0 );
+			memcpy( ctx->dst[p] + line * ctx->strides[p], ctx->src[p] + from * ctx->strides[p], ctx->strides[p] );
+		}
+	}
+	return 0;
+}
+
+static void copy_lines( struct sliced_desc *desc, int threads )
+{
+	threads = CLAMP( threads, 0, mlt_slices_count_normal() );
+	if ( threads == 1 )
+		sliced_proc( 0, 0, 1, desc );
+	else
+		mlt_slices_run_normal( threads, sliced_proc, desc );
+}
+
 static int get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
+	mlt_filter filter = mlt_frame_pop_service( frame );
+	int threads = mlt_properties_get_int( MLT_FILTER_PROPERTIES( filter ), "threads" );
+
 	// Get the properties from the frame
 	mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
 
@@ -53,20 +95,13 @@ static int get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format
 			int bpp;
 			int size = mlt_image_format_size( *format, *width, *height, &bpp );
 			uint8_t *new_image = mlt_pool_alloc( size );
-			int stride = *width * bpp;
-			int i = *height + 1;
-			uint8_t *src = *image;
+			struct sliced_desc desc = { { *image }, { new_image }, { *width * bpp }, *height, 1 };
+
+			copy_lines( &desc, threads );
 
 			// Set the new image
 			mlt_frame_set_image( frame, new_image, size, mlt_pool_release );
 			*image = new_image;
-
-			while ( --i )
-			{
-				memcpy( new_image, src + stride * !(i % 2), stride );
-				new_image += stride;
-				src += stride * (i % 2) * 2;
-			}
 		}
 
 		// Correct field order if needed
@@ -85,21 +120,13 @@ static int get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format
 			}
 
 			// Shift the entire image down by one line
-			int p, strides[4], size;
-			uint8_t *new_planes[4], *old_planes[4], *new_image;
-
-			size = mlt_image_format_size( *format, *width, *height, NULL );
-			new_image = mlt_pool_alloc( size );
-			mlt_image_format_planes( *format, *width, *height, new_image, new_planes, strides );
-			mlt_image_format_planes( *format, *width, *height, *image, old_planes, strides );
+			struct sliced_desc desc = { .height = *height, .swap = 0 };
+			int size = mlt_image_format_size( *format, *width, *height, NULL );
+			uint8_t *new_image = mlt_pool_alloc( size );
+			mlt_image_format_planes( *format, *width, *height, new_image, desc.dst, desc.strides );
+			mlt_image_format_planes( *format, *width, *height, *image, desc.src, desc.strides );
 
-			for( p = 0; p < 4; p++ )
-			{
-				if( !new_planes[p] )
-					continue;
-				memcpy( new_planes[p], old_planes[p], strides[p] );
-				memcpy( new_planes[p] + strides[p], old_planes[p], strides[p] * ( *height - 1 ) );
-			}
+			copy_lines( &desc, threads );
 
 			// Set the new image
 			mlt_frame_set_image( frame, new_image, size, mlt_pool_release );
@@ -118,6 +145,7 @@ static int get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format
 
 static mlt_frame process( mlt_filter filter, mlt_frame frame )
 {
+	mlt_frame_push_service( frame, filter );
 	mlt_frame_push_get_image( frame, get_image );
 	return frame;
 }
@@ -34,33 +34,26 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	mlt_position position = mlt_filter_get_position( filter, frame );
 	mlt_position length = mlt_filter_get_length2( filter, frame );
 
-	*format = mlt_image_yuv422;
-	int error = mlt_frame_get_image( frame, image, format, width, height, 1 );
+	// Get the gamma value
+	double gamma = mlt_properties_anim_get_double( properties, "gamma", position, length );
 
-	if ( error == 0 )
+	*format = mlt_image_yuv422;
+	if ( gamma != 1.0 )
 	{
-		// Get the gamma value
-		double gamma = mlt_properties_anim_get_double( properties, "gamma", position, length );
-
-		if ( gamma != 1.0 )
-		{
-			uint8_t *p = *image;
-			uint8_t *q = *image + *width * *height * 2;
+		// Calculate the look up table of the luma
+		double exp = 1 / gamma;
+		uint8_t lookup[ 256 ];
+		const uint8_t *luts[ MLT_IMAGE_MAX_PLANES ] = { lookup, NULL, NULL, NULL };
+		int i;
 
-			// Calculate the look up table
-			double exp = 1 / gamma;
-			uint8_t lookup[ 256 ];
-			int i;
+		for( i = 0; i < 256; i ++ )
+			lookup[ i ] = ( uint8_t )( pow( ( double )i / 255.0, exp ) * 255 );
 
-			for( i = 0; i < 256; i ++ )
-				lookup[ i ] = ( uint8_t )( pow( ( double )i / 255.0, exp ) * 255 );
-
-			while ( p != q )
-			{
-				*p = lookup[ *p ];
-				p += 2;
-			}
-		}
+		mlt_frame_get_image_lut( frame, image, format, width, height, luts );
+	}
+	else
+	{
+		mlt_frame_get_image( frame, image, format, width, height, 1 );
 	}
 
 	return 0;
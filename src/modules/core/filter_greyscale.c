@@ -22,22 +22,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /** Do it :-).
 */
 
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
+	// Set the chroma to neutral
+	uint8_t chroma[ 256 ];
+	const uint8_t *luts[ MLT_IMAGE_MAX_PLANES ] = { NULL, chroma, chroma, NULL };
+	memset( chroma, 128, sizeof( chroma ) );
+
 	*format = mlt_image_yuv422;
-	int error = mlt_frame_get_image( frame, image, format, width, height, 1 );
-	if ( error == 0 )
-	{
-		uint8_t *p = *image;
-		uint8_t *q = *image + *width * *height * 2;
-		while ( p ++ != q )
-			*p ++ = 128;
-	}
-	return error;
+	return mlt_frame_get_image_lut( frame, image, format, width, height, luts );
 }
 
 /** Filter processing.
@@ -22,8 +22,11 @@
 #include <framework/mlt_image.h>
 #include <framework/mlt_log.h>
 #include <framework/mlt_pool.h>
+#include <framework/mlt_slices.h>
+#include "imageconvert_simd.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 /** This macro converts a YUV value to the RGB color space. */
 #define RGB2YUV_601_UNSCALED(r, g, b, y, u, v)\
@@ -46,6 +49,9 @@
   g = g < 0 ? 0 : g > 255 ? 255 : g; \
   b = b < 0 ? 0 : b > 255 ? 255 : b;
 
+/** Images shorter than twice this many lines are converted on the calling thread. */
+#define MIN_SLICE_HEIGHT (64)
+
 #define SCALED 1
 #if SCALED
 #define RGB2YUV_601 RGB2YUV_601_SCALED
@@ -55,21 +61,72 @@
 #define YUV2RGB_601 YUV2RGB_601_UNSCALED
 #endif
 
-static void convert_yuv422_to_rgba( mlt_image src, mlt_image dst )
+/** A function converting the lines [start, end) of an image that was already allocated.
+*/
+
+typedef void ( *lines_function )( mlt_image src, mlt_image dst, int start, int end );
+
+struct sliced_desc
+{
+	mlt_image src;
+	mlt_image dst;
+	lines_function lines;
+};
+
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* ctx = ( (struct sliced_desc*) cookie );
+	// Keep slices on even lines so that no two share a line of 4:2:0 chroma.
+	int slice_height = ( ( ctx->src->height + jobs - 1 ) / jobs + 1 ) & ~1;
+	int slice_line_start = index * slice_height;
+	int slice_line_end = MIN( slice_line_start + slice_height, ctx->src->height );
+
+	if ( slice_line_start < slice_line_end )
+		ctx->lines( ctx->src, ctx->dst, slice_line_start, slice_line_end );
+	return 0;
+}
+
+/** Run a line converter over the whole image, sliced across threads when it is large enough.
+*/
+
+static void convert_lines( mlt_image src, mlt_image dst, lines_function lines )
+{
+	int jobs = MIN( mlt_slices_count_normal(), src->height / MIN_SLICE_HEIGHT );
+
+	if ( jobs > 1 )
+	{
+		struct sliced_desc desc = { src, dst, lines };
+		mlt_slices_run_normal( jobs, sliced_proc, &desc );
+	}
+	else
+	{
+		lines( src, dst, 0, src->height );
+	}
+}
+
+static void yuv422_to_rgba_lines( mlt_image src, mlt_image dst, int start, int end )
 {
+	const imageconvert_simd *simd = imageconvert_simd_get();
 	int yy, uu, vv;
 	int r,g,b;
 
-	mlt_image_set_values( dst, NULL, mlt_image_rgba, src->width, src->height );
-	mlt_image_alloc_data( dst );
-
-	for ( int line = 0; line < src->height; line++ )
+	for ( int line = start; line < end; line++ )
 	{
 		uint8_t* pSrc = src->planes[0] + src->strides[0] * line;
-		uint8_t* pAlpha = src->planes[3] + src->strides[3] * line;
+		uint8_t* pAlpha = src->planes[3] ? src->planes[3] + src->strides[3] * line : NULL;
 		uint8_t* pDst = dst->planes[0] + dst->strides[0] * line;
 		int total = src->width / 2 + 1;
 
+		if ( simd->yuv422_to_rgba )
+		{
+			int done = simd->yuv422_to_rgba( pSrc, pAlpha, pDst, src->width );
+			pSrc += done * 2;
+			pDst += done * 4;
+			if ( pAlpha )
+				pAlpha += done;
+			total -= done / 2;
+		}
 		if ( pAlpha )
 			while ( --total )
 			{
@@ -113,15 +170,19 @@ static void convert_yuv422_to_rgba( mlt_image src, mlt_image dst )
 	}
 }
 
-static void convert_yuv422_to_rgb( mlt_image src, mlt_image dst )
+static void convert_yuv422_to_rgba( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_rgba, src->width, src->height );
+	mlt_image_alloc_data( dst );
+	convert_lines( src, dst, yuv422_to_rgba_lines );
+}
+
+static void yuv422_to_rgb_lines( mlt_image src, mlt_image dst, int start, int end )
 {
 	int yy, uu, vv;
 	int r,g,b;
 
-	mlt_image_set_values( dst, NULL, mlt_image_rgb, src->width, src->height );
-	mlt_image_alloc_data( dst );
-
-	for ( int line = 0; line < src->height; line++ )
+	for ( int line = start; line < end; line++ )
 	{
 		uint8_t* pSrc = src->planes[0] + src->strides[0] * line;
 		uint8_t* pDst = dst->planes[0] + dst->strides[0] * line;
@@ -146,21 +207,34 @@ static void convert_yuv422_to_rgb( mlt_image src, mlt_image dst )
 	}
 }
 
-static void convert_rgba_to_yuv422( mlt_image src, mlt_image dst )
+static void convert_yuv422_to_rgb( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_rgb, src->width, src->height );
+	mlt_image_alloc_data( dst );
+	convert_lines( src, dst, yuv422_to_rgb_lines );
+}
+
+static void rgba_to_yuv422_lines( mlt_image src, mlt_image dst, int start, int end )
 {
+	const imageconvert_simd *simd = imageconvert_simd_get();
 	int y0, y1, u0, u1, v0, v1;
 	int r, g, b;
 
-	mlt_image_set_values( dst, NULL, mlt_image_yuv422, src->width, src->height );
-	mlt_image_alloc_data( dst );
-	mlt_image_alloc_alpha( dst );
-
-	for ( int line = 0; line < src->height; line++ )
+	for ( int line = start; line < end; line++ )
 	{
 		uint8_t* pSrc = src->planes[0] + src->strides[0] * line;
 		uint8_t* pDst = dst->planes[0] + dst->strides[0] * line;
 		uint8_t* pAlpha = dst->planes[3] + dst->strides[3] * line;
 		int j = src->width / 2 + 1;
+
+		if ( simd->rgba_to_yuv422 )
+		{
+			int done = simd->rgba_to_yuv422( pSrc, pDst, pAlpha, src->width );
+			pSrc += done * 4;
+			pDst += done * 2;
+			pAlpha += done;
+			j -= done / 2;
+		}
 		while ( --j )
 		{
 			r = *pSrc++;
@@ -191,15 +265,20 @@ static void convert_rgba_to_yuv422( mlt_image src, mlt_image dst )
 	}
 }
 
-static void convert_rgb_to_yuv422( mlt_image src, mlt_image dst )
+static void convert_rgba_to_yuv422( mlt_image src, mlt_image dst )
 {
-	int y0, y1, u0, u1, v0, v1;
-	int r, g, b;
-
 	mlt_image_set_values( dst, NULL, mlt_image_yuv422, src->width, src->height );
 	mlt_image_alloc_data( dst );
+	mlt_image_alloc_alpha( dst );
+	convert_lines( src, dst, rgba_to_yuv422_lines );
+}
 
-	for ( int line = 0; line < src->height; line++ )
+static void rgb_to_yuv422_lines( mlt_image src, mlt_image dst, int start, int end )
+{
+	int y0, y1, u0, u1, v0, v1;
+	int r, g, b;
+
+	for ( int line = start; line < end; line++ )
 	{
 		uint8_t* pSrc = src->planes[0] + src->strides[0] * line;
 		uint8_t* pDst = dst->planes[0] + dst->strides[0] * line;
@@ -231,18 +310,34 @@ static void convert_rgb_to_yuv422( mlt_image src, mlt_image dst )
 	}
 }
 
-static void convert_yuv420p_to_yuv422( mlt_image src, mlt_image dst )
+static void convert_rgb_to_yuv422( mlt_image src, mlt_image dst )
 {
 	mlt_image_set_values( dst, NULL, mlt_image_yuv422, src->width, src->height );
 	mlt_image_alloc_data( dst );
+	convert_lines( src, dst, rgb_to_yuv422_lines );
+}
 
-	for ( int line = 0; line < src->height; line++ )
+static void yuv420p_to_yuv422_lines( mlt_image src, mlt_image dst, int start, int end )
+{
+	const imageconvert_simd *simd = imageconvert_simd_get();
+
+	for ( int line = start; line < end; line++ )
 	{
 		uint8_t* pSrcY = src->planes[0] + src->strides[0] * line;
-		uint8_t* pSrcU = src->planes[1] + src->strides[1] * line / 2;
-		uint8_t* pSrcV = src->planes[2] + src->strides[2] * line / 2;
+		uint8_t* pSrcU = src->planes[1] + src->strides[1] * ( line / 2 );
+		uint8_t* pSrcV = src->planes[2] + src->strides[2] * ( line / 2 );
 		uint8_t* pDst = dst->planes[0] + dst->strides[0] * line;
 		int j = src->width / 2 + 1;
+
+		if ( simd->yuv420p_to_yuv422 )
+		{
+			int done = simd->yuv420p_to_yuv422( pSrcY, pSrcU, pSrcV, pDst, src->width );
+			pSrcY += done;
+			pSrcU += done / 2;
+			pSrcV += done / 2;
+			pDst += done * 2;
+			j -= done / 2;
+		}
 		while ( --j )
 		{
 			*pDst++ = *pSrcY++;
@@ -253,19 +348,23 @@ static void convert_yuv420p_to_yuv422( mlt_image src, mlt_image dst )
 	}
 }
 
-static void convert_yuv420p_to_rgb( mlt_image src, mlt_image dst )
+static void convert_yuv420p_to_yuv422( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_yuv422, src->width, src->height );
+	mlt_image_alloc_data( dst );
+	convert_lines( src, dst, yuv420p_to_yuv422_lines );
+}
+
+static void yuv420p_to_rgb_lines( mlt_image src, mlt_image dst, int start, int end )
 {
 	int yy, uu, vv;
 	int r,g,b;
 
-	mlt_image_set_values( dst, NULL, mlt_image_rgb, src->width, src->height );
-	mlt_image_alloc_data( dst );
-
-	for ( int line = 0; line < src->height; line++ )
+	for ( int line = start; line < end; line++ )
 	{
 		uint8_t* pSrcY = src->planes[0] + src->strides[0] * line;
-		uint8_t* pSrcU = src->planes[1] + src->strides[1] * line / 2;
-		uint8_t* pSrcV = src->planes[2] + src->strides[2] * line / 2;
+		uint8_t* pSrcU = src->planes[1] + src->strides[1] * ( line / 2 );
+		uint8_t* pSrcV = src->planes[2] + src->strides[2] * ( line / 2 );
 		uint8_t* pDst = dst->planes[0] + dst->strides[0] * line;
 		int total = src->width / 2 + 1;
 		while ( --total )
@@ -287,22 +386,39 @@ static void convert_yuv420p_to_rgb( mlt_image src, mlt_image dst )
 	}
 }
 
-static void convert_yuv420p_to_rgba( mlt_image src, mlt_image dst )
+static void convert_yuv420p_to_rgb( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_rgb, src->width, src->height );
+	mlt_image_alloc_data( dst );
+	convert_lines( src, dst, yuv420p_to_rgb_lines );
+}
+
+static void yuv420p_to_rgba_lines( mlt_image src, mlt_image dst, int start, int end )
 {
+	const imageconvert_simd *simd = imageconvert_simd_get();
 	int yy, uu, vv;
 	int r,g,b;
 
-	mlt_image_set_values( dst, NULL, mlt_image_rgba, src->width, src->height );
-	mlt_image_alloc_data( dst );
-
-	for ( int line = 0; line < src->height; line++ )
+	for ( int line = start; line < end; line++ )
 	{
 		uint8_t* pSrcY = src->planes[0] + src->strides[0] * line;
-		uint8_t* pSrcU = src->planes[1] + src->strides[1] * line / 2;
-		uint8_t* pSrcV = src->planes[2] + src->strides[2] * line / 2;
-		uint8_t* pSrcA = src->planes[3] + src->strides[3] * line;
+		uint8_t* pSrcU = src->planes[1] + src->strides[1] * ( line / 2 );
+		uint8_t* pSrcV = src->planes[2] + src->strides[2] * ( line / 2 );
+		uint8_t* pSrcA = src->planes[3] ? src->planes[3] + src->strides[3] * line : NULL;
 		uint8_t* pDst = dst->planes[0] + dst->strides[0] * line;
 		int total = src->width / 2 + 1;
+
+		if ( simd->yuv420p_to_rgba )
+		{
+			int done = simd->yuv420p_to_rgba( pSrcY, pSrcU, pSrcV, pSrcA, pDst, src->width );
+			pSrcY += done;
+			pSrcU += done / 2;
+			pSrcV += done / 2;
+			if ( pSrcA )
+				pSrcA += done;
+			pDst += done * 4;
+			total -= done / 2;
+		}
 		if ( pSrcA )
 			while ( --total )
 			{
@@ -344,17 +460,20 @@ static void convert_yuv420p_to_rgba( mlt_image src, mlt_image dst )
 	}
 }
 
-static void convert_yuv422_to_yuv420p( mlt_image src, mlt_image dst )
+static void convert_yuv420p_to_rgba( mlt_image src, mlt_image dst )
 {
-	int lines = src->height;
-	int pixels = src->width;
-
-	mlt_image_set_values( dst, NULL, mlt_image_yuv420p, src->width, src->height );
+	mlt_image_set_values( dst, NULL, mlt_image_rgba, src->width, src->height );
 	mlt_image_alloc_data( dst );
+	convert_lines( src, dst, yuv420p_to_rgba_lines );
+}
+
+static void yuv422_to_yuv420p_lines( mlt_image src, mlt_image dst, int start, int end )
+{
+	int pixels = src->width;
 
-	// Y
-	for ( int line = 0; line < lines; line++ )
+	for ( int line = start; line < end; line++ )
 	{
+		// Y
 		uint8_t* pSrc = src->planes[0] + src->strides[0] * line;
 		uint8_t* pDst = dst->planes[0] + dst->strides[0] * line;
 		for ( int pixel = 0; pixel < pixels; pixel++ )
@@ -362,42 +481,34 @@ static void convert_yuv422_to_yuv420p( mlt_image src, mlt_image dst )
 			*pDst++ = *pSrc;
 			pSrc += 2;
 		}
-	}
-
-	lines = src->height / 2;
-	pixels = src->width / 2;
-
-	// U
-	for ( int line = 0; line < lines; line++ )
-	{
-		uint8_t* pSrc = src->planes[0] + src->strides[0] * line * 2 + 1;
-		uint8_t* pDst = dst->planes[1] + dst->strides[1] * line;
-		for ( int pixel = 0; pixel < pixels; pixel++ )
-		{
-			*pDst++ = *pSrc;
-			pSrc += 4;
-		}
-	}
 
-	// V
-	for ( int line = 0; line < lines; line++ )
-	{
-		uint8_t* pSrc = src->planes[0] + src->strides[0] * line * 2 + 3;
-		uint8_t* pDst = dst->planes[2] + dst->strides[2] * line;
-		for ( int pixel = 0; pixel < pixels; pixel++ )
+		// U and V are taken from the even lines
+		if ( line % 2 || line / 2 >= src->height / 2 )
+			continue;
+		uint8_t* pSrcU = src->planes[0] + src->strides[0] * line + 1;
+		uint8_t* pSrcV = src->planes[0] + src->strides[0] * line + 3;
+		uint8_t* pDstU = dst->planes[1] + dst->strides[1] * ( line / 2 );
+		uint8_t* pDstV = dst->planes[2] + dst->strides[2] * ( line / 2 );
+		for ( int pixel = 0; pixel < pixels / 2; pixel++ )
 		{
-			*pDst++ = *pSrc;
-			pSrc += 4;
+			*pDstU++ = *pSrcU;
+			*pDstV++ = *pSrcV;
+			pSrcU += 4;
+			pSrcV += 4;
 		}
 	}
 }
 
-static void convert_rgb_to_rgba( mlt_image src, mlt_image dst )
+static void convert_yuv422_to_yuv420p( mlt_image src, mlt_image dst )
 {
-	mlt_image_set_values( dst, NULL, mlt_image_rgba, src->width, src->height );
+	mlt_image_set_values( dst, NULL, mlt_image_yuv420p, src->width, src->height );
 	mlt_image_alloc_data( dst );
+	convert_lines( src, dst, yuv422_to_yuv420p_lines );
+}
 
-	for ( int line = 0; line < src->height; line++ )
+static void rgb_to_rgba_lines( mlt_image src, mlt_image dst, int start, int end )
+{
+	for ( int line = start; line < end; line++ )
 	{
 		uint8_t* pSrc = src->planes[0] + src->strides[0] * line;
 		uint8_t* pAlpha = src->planes[3] + src->strides[3] * line;
@@ -424,13 +535,16 @@ static void convert_rgb_to_rgba( mlt_image src, mlt_image dst )
 	}
 }
 
-static void convert_rgba_to_rgb( mlt_image src, mlt_image dst )
+static void convert_rgb_to_rgba( mlt_image src, mlt_image dst )
 {
-	mlt_image_set_values( dst, NULL, mlt_image_rgb, src->width, src->height );
+	mlt_image_set_values( dst, NULL, mlt_image_rgba, src->width, src->height );
 	mlt_image_alloc_data( dst );
-	mlt_image_alloc_alpha( dst );
+	convert_lines( src, dst, rgb_to_rgba_lines );
+}
 
-	for ( int line = 0; line < src->height; line++ )
+static void rgba_to_rgb_lines( mlt_image src, mlt_image dst, int start, int end )
+{
+	for ( int line = start; line < end; line++ )
 	{
 		uint8_t* pSrc = src->planes[0] + src->strides[0] * line;
 		uint8_t* pDst = dst->planes[0] + dst->strides[0] * line;
@@ -447,18 +561,301 @@ static void convert_rgba_to_rgb( mlt_image src, mlt_image dst )
 	}
 }
 
+static void convert_rgba_to_rgb( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_rgb, src->width, src->height );
+	mlt_image_alloc_data( dst );
+	mlt_image_alloc_alpha( dst );
+	convert_lines( src, dst, rgba_to_rgb_lines );
+}
+
+static void plane_16_to_8( mlt_image src, mlt_image dst, int plane, int count, int shift )
+{
+	int rows = plane ? dst->height / 2 : dst->height;
+	int round = 1 << ( shift - 1 );
+
+	for ( int line = 0; line < rows; line++ )
+	{
+		uint16_t* pSrc = (uint16_t*)( src->planes[plane] + src->strides[plane] * line );
+		uint8_t* pDst = dst->planes[plane] + dst->strides[plane] * line;
+		for ( int i = 0; i < count; i++ )
+		{
+			int value = ( *pSrc++ + round ) >> shift;
+			*pDst++ = value > 255 ? 255 : value;
+		}
+	}
+}
+
+static void plane_8_to_16( mlt_image src, mlt_image dst, int plane, int count, int shift )
+{
+	int rows = plane ? src->height / 2 : src->height;
+
+	for ( int line = 0; line < rows; line++ )
+	{
+		uint8_t* pSrc = src->planes[plane] + src->strides[plane] * line;
+		uint16_t* pDst = (uint16_t*)( dst->planes[plane] + dst->strides[plane] * line );
+		for ( int i = 0; i < count; i++ )
+			*pDst++ = *pSrc++ << shift;
+	}
+}
+
+static void convert_yuv420p10_to_yuv420p( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_yuv420p, src->width, src->height );
+	mlt_image_alloc_data( dst );
+
+	plane_16_to_8( src, dst, 0, src->width, 2 );
+	plane_16_to_8( src, dst, 1, src->width / 2, 2 );
+	plane_16_to_8( src, dst, 2, src->width / 2, 2 );
+}
+
+static void convert_yuv420p_to_yuv420p10( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_yuv420p10, src->width, src->height );
+	mlt_image_alloc_data( dst );
+
+	plane_8_to_16( src, dst, 0, src->width, 2 );
+	plane_8_to_16( src, dst, 1, src->width / 2, 2 );
+	plane_8_to_16( src, dst, 2, src->width / 2, 2 );
+}
+
+static void convert_nv12_to_yuv420p( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_yuv420p, src->width, src->height );
+	mlt_image_alloc_data( dst );
+
+	for ( int line = 0; line < src->height; line++ )
+		memcpy( dst->planes[0] + dst->strides[0] * line, src->planes[0] + src->strides[0] * line, src->width );
+	for ( int line = 0; line < src->height / 2; line++ )
+	{
+		uint8_t* pSrc = src->planes[1] + src->strides[1] * line;
+		uint8_t* pDstU = dst->planes[1] + dst->strides[1] * line;
+		uint8_t* pDstV = dst->planes[2] + dst->strides[2] * line;
+		for ( int pixel = 0; pixel < src->width / 2; pixel++ )
+		{
+			*pDstU++ = *pSrc++;
+			*pDstV++ = *pSrc++;
+		}
+	}
+}
+
+static void convert_yuv420p_to_nv12( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_nv12, src->width, src->height );
+	mlt_image_alloc_data( dst );
+
+	for ( int line = 0; line < src->height; line++ )
+		memcpy( dst->planes[0] + dst->strides[0] * line, src->planes[0] + src->strides[0] * line, src->width );
+	for ( int line = 0; line < src->height / 2; line++ )
+	{
+		uint8_t* pSrcU = src->planes[1] + src->strides[1] * line;
+		uint8_t* pSrcV = src->planes[2] + src->strides[2] * line;
+		uint8_t* pDst = dst->planes[1] + dst->strides[1] * line;
+		for ( int pixel = 0; pixel < src->width / 2; pixel++ )
+		{
+			*pDst++ = *pSrcU++;
+			*pDst++ = *pSrcV++;
+		}
+	}
+}
+
+static void convert_p010_to_yuv420p( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_yuv420p, src->width, src->height );
+	mlt_image_alloc_data( dst );
+
+	plane_16_to_8( src, dst, 0, src->width, 8 );
+	for ( int line = 0; line < src->height / 2; line++ )
+	{
+		uint16_t* pSrc = (uint16_t*)( src->planes[1] + src->strides[1] * line );
+		uint8_t* pDstU = dst->planes[1] + dst->strides[1] * line;
+		uint8_t* pDstV = dst->planes[2] + dst->strides[2] * line;
+		for ( int pixel = 0; pixel < src->width / 2; pixel++ )
+		{
+			*pDstU++ = *pSrc++ >> 8;
+			*pDstV++ = *pSrc++ >> 8;
+		}
+	}
+}
+
+static void convert_yuv420p_to_p010( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_p010, src->width, src->height );
+	mlt_image_alloc_data( dst );
+
+	plane_8_to_16( src, dst, 0, src->width, 8 );
+	for ( int line = 0; line < src->height / 2; line++ )
+	{
+		uint8_t* pSrcU = src->planes[1] + src->strides[1] * line;
+		uint8_t* pSrcV = src->planes[2] + src->strides[2] * line;
+		uint16_t* pDst = (uint16_t*)( dst->planes[1] + dst->strides[1] * line );
+		for ( int pixel = 0; pixel < src->width / 2; pixel++ )
+		{
+			*pDst++ = *pSrcU++ << 8;
+			*pDst++ = *pSrcV++ << 8;
+		}
+	}
+}
+
+static void convert_rgba64_to_rgba( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_rgba, src->width, src->height );
+	mlt_image_alloc_data( dst );
+
+	for ( int line = 0; line < src->height; line++ )
+	{
+		uint16_t* pSrc = (uint16_t*)( src->planes[0] + src->strides[0] * line );
+		uint8_t* pDst = dst->planes[0] + dst->strides[0] * line;
+		for ( int i = 0; i < src->width * 4; i++ )
+			*pDst++ = *pSrc++ >> 8;
+	}
+}
+
+static void convert_rgba_to_rgba64( mlt_image src, mlt_image dst )
+{
+	mlt_image_set_values( dst, NULL, mlt_image_rgba64, src->width, src->height );
+	mlt_image_alloc_data( dst );
+
+	for ( int line = 0; line < src->height; line++ )
+	{
+		uint8_t* pSrc = src->planes[0] + src->strides[0] * line;
+		uint16_t* pDst = (uint16_t*)( dst->planes[0] + dst->strides[0] * line );
+		for ( int i = 0; i < src->width * 4; i++ )
+			*pDst++ = *pSrc++ * 257;
+	}
+}
+
 typedef void ( *conversion_function )( mlt_image src, mlt_image dst );
 
+/** Convert through another format, for the pairs without a direct conversion.
+ *
+ * The alpha that the first conversion takes out of rgba is kept for the result.
+*/
+
+static void convert_through( mlt_image src, mlt_image dst, conversion_function first, conversion_function second )
+{
+	struct mlt_image_s temp;
+
+	first( src, &temp );
+	second( &temp, dst );
+	if ( temp.alpha && !dst->alpha )
+	{
+		dst->alpha = temp.alpha;
+		dst->release_alpha = temp.release_alpha;
+		dst->planes[3] = temp.planes[3];
+		dst->strides[3] = temp.strides[3];
+		temp.alpha = NULL;
+		temp.release_alpha = NULL;
+	}
+	if ( temp.release_data )
+		temp.release_data( temp.data );
+	if ( temp.release_alpha )
+		temp.release_alpha( temp.alpha );
+}
+
+static void convert_rgb_to_yuv420p( mlt_image src, mlt_image dst )
+{
+	convert_through( src, dst, convert_rgb_to_yuv422, convert_yuv422_to_yuv420p );
+}
+
+static void convert_rgba_to_yuv420p( mlt_image src, mlt_image dst )
+{
+	convert_through( src, dst, convert_rgba_to_yuv422, convert_yuv422_to_yuv420p );
+}
+
+static void convert_rgb_to_yuv420p10( mlt_image src, mlt_image dst )
+{
+	convert_through( src, dst, convert_rgb_to_yuv420p, convert_yuv420p_to_yuv420p10 );
+}
+
+static void convert_rgba_to_yuv420p10( mlt_image src, mlt_image dst )
+{
+	convert_through( src, dst, convert_rgba_to_yuv420p, convert_yuv420p_to_yuv420p10 );
+}
+
+static void convert_rgb_to_nv12( mlt_image src, mlt_image dst )
+{
+	convert_through( src, dst, convert_rgb_to_yuv420p, convert_yuv420p_to_nv12 );
+}
+
+static void convert_rgba_to_nv12( mlt_image src, mlt_image dst )
+{
+	convert_through( src, dst, convert_rgba_to_yuv420p, convert_yuv420p_to_nv12 );
+}
+
+static void convert_rgb_to_p010( mlt_image src, mlt_image dst )
+{
+	convert_through( src, dst, convert_rgb_to_yuv420p, convert_yuv420p_to_p010 );
+}
+
+static void convert_rgba_to_p010( mlt_image src, mlt_image dst )
+{
+	convert_through( src, dst, convert_rgba_to_yuv420p, convert_yuv420p_to_p010 );
+}
+
 static conversion_function conversion_matrix[ mlt_image_invalid - 1 ][ mlt_image_invalid - 1 ] = {
-	{ NULL, convert_rgb_to_rgba, convert_rgb_to_yuv422, NULL, NULL, NULL, NULL },
-	{ convert_rgba_to_rgb, NULL, convert_rgba_to_yuv422, NULL, NULL, NULL, NULL },
-	{ convert_yuv422_to_rgb, convert_yuv422_to_rgba, NULL, convert_yuv422_to_yuv420p, NULL, NULL, NULL },
-	{ convert_yuv420p_to_rgb, convert_yuv420p_to_rgba, convert_yuv420p_to_yuv422, NULL, NULL, NULL, NULL },
-	{ NULL, NULL, NULL, NULL, NULL, NULL, NULL },
-	{ NULL, NULL, NULL, NULL, NULL, NULL, NULL },
-	{ NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+	{ NULL, convert_rgb_to_rgba, convert_rgb_to_yuv422, convert_rgb_to_yuv420p, NULL, NULL, NULL, convert_rgb_to_yuv420p10, convert_rgb_to_nv12, convert_rgb_to_p010, NULL },
+	{ convert_rgba_to_rgb, NULL, convert_rgba_to_yuv422, convert_rgba_to_yuv420p, NULL, NULL, NULL, convert_rgba_to_yuv420p10, convert_rgba_to_nv12, convert_rgba_to_p010, convert_rgba_to_rgba64 },
+	{ convert_yuv422_to_rgb, convert_yuv422_to_rgba, NULL, convert_yuv422_to_yuv420p, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+	{ convert_yuv420p_to_rgb, convert_yuv420p_to_rgba, convert_yuv420p_to_yuv422, NULL, NULL, NULL, NULL, convert_yuv420p_to_yuv420p10, convert_yuv420p_to_nv12, convert_yuv420p_to_p010, NULL },
+	{ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+	{ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+	{ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+	{ NULL, NULL, NULL, convert_yuv420p10_to_yuv420p, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+	{ NULL, NULL, NULL, convert_nv12_to_yuv420p, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+	{ NULL, NULL, NULL, convert_p010_to_yuv420p, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+	{ NULL, convert_rgba64_to_rgba, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
 };
 
+/** Get the 8-bit format through which a format without a direct conversion goes.
+*/
+
+static mlt_image_format base_format( mlt_image_format format )
+{
+	switch ( format )
+	{
+	case mlt_image_yuv420p10:
+	case mlt_image_nv12:
+	case mlt_image_p010:
+		return mlt_image_yuv420p;
+	case mlt_image_rgba64:
+		return mlt_image_rgba;
+	default:
+		return format;
+	}
+}
+
+static conversion_function get_converter( mlt_image_format from, mlt_image_format to )
+{
+	return from == to ? NULL : conversion_matrix[ from - 1 ][ to - 1 ];
+}
+
+/** Find a chain of at most three conversions, returning the number of steps.
+*/
+
+static int find_conversion_path( mlt_image_format from, mlt_image_format to, mlt_image_format path[4] )
+{
+	mlt_image_format hops[4] = { from, base_format( from ), base_format( to ), to };
+	int steps = 0;
+
+	if ( get_converter( from, to ) )
+	{
+		path[0] = from;
+		path[1] = to;
+		return 1;
+	}
+	path[0] = from;
+	for ( int i = 1; i < 4; i++ )
+	{
+		if ( hops[i] == path[steps] )
+			continue;
+		if ( !get_converter( path[steps], hops[i] ) )
+			return 0;
+		path[++steps] = hops[i];
+	}
+	return steps;
+}
+
 static int convert_image( mlt_frame frame, uint8_t **buffer, mlt_image_format *format, mlt_image_format requested_format )
 {
 	int error = 0;
@@ -468,25 +865,39 @@ static int convert_image( mlt_frame frame, uint8_t **buffer, mlt_image_format *f
 
 	if ( *format != requested_format )
 	{
-		conversion_function converter = conversion_matrix[ *format - 1 ][ requested_format - 1 ];
+		mlt_image_format path[4];
+		int steps = find_conversion_path( *format, requested_format, path );
 
 		mlt_log_debug( NULL, "[filter imageconvert] %s -> %s @ %dx%d\n",
 			mlt_image_format_name( *format ), mlt_image_format_name( requested_format ),
 			width, height );
-		if ( converter )
+		if ( steps )
 		{
 			struct mlt_image_s src;
 			struct mlt_image_s dst;
 			mlt_image_set_values( &src, *buffer, *format, width, height );
-			if ( requested_format == mlt_image_rgba && mlt_frame_get_alpha( frame ) )
+			for ( int i = 0; i < steps; i++ )
 			{
-				// imageconvert leaves the alpha buffer alone except in the case of rgba.
-				// For rgba input, an alpha buffer will be created and added to the frame.
-				// For rgba output, the alpha buffer will be copied to the rgba and the buffer is removed from the frame.
-				src.planes[3] = mlt_frame_get_alpha( frame );
-				src.strides[3] = src.width;
+				if ( i == steps - 1 && requested_format == mlt_image_rgba && mlt_frame_get_alpha( frame ) )
+				{
+					// imageconvert leaves the alpha buffer alone except in the case of rgba.
+					// For rgba input, an alpha buffer will be created and added to the frame.
+					// For rgba output, the alpha buffer will be copied to the rgba and the buffer is removed from the frame.
+					src.planes[3] = mlt_frame_get_alpha( frame );
+					src.strides[3] = src.width;
+				}
+				get_converter( path[i], path[i + 1] )( &src, &dst );
+				if ( i > 0 )
+				{
+					// Release the intermediate image
+					if ( src.release_data )
+						src.release_data( src.data );
+					if ( src.release_alpha )
+						src.release_alpha( src.alpha );
+				}
+				src = dst;
 			}
-			converter( &src, &dst );
+			mlt_image_pack( &dst );
 			mlt_frame_set_image( frame, dst.data, 0, dst.release_data );
 			if ( requested_format == mlt_image_rgba )
 			{
@@ -20,6 +20,7 @@
 #include <framework/mlt_filter.h>
 #include <framework/mlt_factory.h>
 #include <framework/mlt_frame.h>
+#include <framework/mlt_image.h>
 #include <framework/mlt_transition.h>
 #include <framework/mlt_log.h>
 
@@ -28,10 +29,14 @@
 static int dummy_get_image(mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable)
 {
 	mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+	mlt_rect *bounds = mlt_frame_pop_service(frame);
+	int opaque = mlt_frame_pop_service_int(frame);
 	*image = mlt_properties_get_data(properties, "image", NULL);
 	*format = mlt_properties_get_int(properties, "format");
 	*width = mlt_properties_get_int(properties, "width");
 	*height = mlt_properties_get_int(properties, "height");
+	// Let the transition blend only where the mask is not transparent
+	mlt_frame_set_alpha_bounds(frame, *bounds, opaque);
 	return 0;
 }
 
@@ -44,10 +49,27 @@ static int get_image(mlt_frame frame, uint8_t **image, mlt_image_format *format,
 		mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
 		mlt_frame clone = mlt_properties_get_data(properties, "mask frame", NULL);
 		if (clone) {
-			mlt_frame_push_get_image(frame, dummy_get_image);
-			mlt_service_lock(MLT_TRANSITION_SERVICE(transition));
-			mlt_transition_process(transition, clone, frame);
-			mlt_service_unlock(MLT_TRANSITION_SERVICE(transition));
+			// Find the part of the frame that the mask lets through
+			mlt_rect bounds;
+			int opaque;
+			if (!mlt_frame_get_alpha_bounds(frame, &bounds, &opaque)) {
+				struct mlt_image_s mask;
+				mlt_image_set_values(&mask, *image, *format, *width, *height);
+				if (*format != mlt_image_rgba && *format != mlt_image_rgba64) {
+					mask.planes[3] = mlt_frame_get_alpha(frame);
+					mask.strides[3] = *width;
+				}
+				opaque = mlt_image_alpha_bounds(&mask, &bounds);
+			}
+			// Nothing is composited over the snapshot through an empty mask
+			if (bounds.w > 0 && bounds.h > 0) {
+				mlt_frame_push_service_int(frame, opaque);
+				mlt_frame_push_service(frame, &bounds);
+				mlt_frame_push_get_image(frame, dummy_get_image);
+				mlt_service_lock(MLT_TRANSITION_SERVICE(transition));
+				mlt_transition_process(transition, clone, frame);
+				mlt_service_unlock(MLT_TRANSITION_SERVICE(transition));
+			}
 			error = mlt_frame_get_image(clone, image, format, width, height, writable);
 			if (!error) {
 				int size = mlt_image_format_size(*format, *width, *height, NULL);
@@ -83,6 +105,11 @@ static mlt_frame process(mlt_filter filter, mlt_frame frame)
 		int hide = mlt_properties_get_int(MLT_FRAME_PROPERTIES(frame), "hide");
 
 		mlt_properties_pass_list(transition_props, properties, "in out");
+
+		// Let the transition use the same slices unless it is told otherwise
+		int threads = mlt_properties_get_int(properties, "threads");
+		mlt_properties_set_int(transition_props, "threads", threads);
+		mlt_properties_set_int(transition_props, "sliced_composite", threads != 1);
 		mlt_properties_pass(transition_props, properties, "transition." );
 
 		// Only if video transition on visible track.
@@ -29,7 +29,8 @@ static int get_image(mlt_frame frame, uint8_t **image, mlt_image_format *format,
 	mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
 	int error = mlt_frame_get_image(frame, image, format, width, height, writable);
 	if (!error) {
-		mlt_frame clone = mlt_frame_clone(frame, 1);
+		// The snapshot shares the image until one of them is written
+		mlt_frame clone = mlt_frame_clone_image(frame);
 		clone->convert_audio = frame->convert_audio;
 		clone->convert_image = frame->convert_image;
 		mlt_properties_set_data(properties,
@@ -20,306 +20,360 @@
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_image.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-/** Do it :-).
-*/
-
-static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
+enum mirror_mode
 {
-	struct mlt_image_s img;
-	int i;
+	mirror_horizontal,
+	mirror_vertical,
+	mirror_diagonal,
+	mirror_xdiagonal,
+	mirror_flip,
+	mirror_flop
+};
 
-	// Pop the mirror filter from the stack
-	mlt_filter filter = mlt_frame_pop_service( frame );
-
-	// Get the mirror type
-	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
-
-	// Get the properties
-	char *mirror = mlt_properties_get( properties, "mirror" );
+struct sliced_desc
+{
+	mlt_image image;
+	enum mirror_mode mode;
+	int reverse;
+};
 
-	// Determine if reverse is required
-	int reverse = mlt_properties_get_int( properties, "reverse" );
+/** Mirror the rows of a slice.
+ *
+ * The vertical modes swap each row in the top half with its row in the bottom
+ * half, so they divide the top half among the slices.
+ */
 
-	// Get the image
-	*format = mlt_image_yuv422;
-	int error = mlt_frame_get_image( frame, image, format, width, height, 1 );
+static int sliced_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	struct mlt_image_s img = *ctx->image;
+	int reverse = ctx->reverse;
+	int rows = ( ctx->mode == mirror_vertical || ctx->mode == mirror_flop ) ? img.height / 2 : img.height;
+	int start = rows * index / jobs;
+	int end = rows * ( index + 1 ) / jobs;
+	int i;
 
-	// If we have an image of the right colour space
-	if ( error == 0 && *format == mlt_image_yuv422 )
+	if ( ctx->mode == mirror_horizontal )
 	{
-		mlt_image_set_values( &img, *image, *format, *width, *height );
-		if ( mlt_frame_get_alpha( frame ) )
+		int uneven_w = ( img.width % 2 ) * 2;
+		for ( i = start; i < end; i ++ )
 		{
-			img.planes[3] = mlt_frame_get_alpha( frame );
-			img.strides[3] = img.width;
-		}
-
-		if ( !strcmp( mirror, "horizontal" ) )
-		{
-			int uneven_w = ( img.width % 2 ) * 2;
-			for ( i = 0; i < img.height; i ++ )
+			uint8_t* p = img.planes[0] + img.strides[0] * i;
+			uint8_t* q = p + img.width * 2;
+			if ( !reverse )
 			{
-				uint8_t* p = img.planes[0] + img.strides[0] * i;
-				uint8_t* q = p + img.width * 2;
-				if ( !reverse )
-				{
-					while ( p < q )
-					{
-						*p ++ = *( q - 2 );
-						*p ++ = *( q - 3 - uneven_w );
-						*p ++ = *( q - 4 );
-						*p ++ = *( q - 1 - uneven_w );
-						q -= 4;
-					}
-				}
-				else
+				while ( p < q )
 				{
-					while ( p < q )
-					{
-						*( q - 2 ) = *p ++;
-						*( q - 3 - uneven_w ) = *p ++;
-						*( q - 4 ) = *p ++;
-						*( q - 1 - uneven_w ) = *p ++;
-						q -= 4;
-					}
+					*p ++ = *( q - 2 );
+					*p ++ = *( q - 3 - uneven_w );
+					*p ++ = *( q - 4 );
+					*p ++ = *( q - 1 - uneven_w );
+					q -= 4;
 				}
 			}
-			if ( img.planes[3] )
+			else
 			{
-				for ( i = 0; i < img.height; i ++ )
+				while ( p < q )
 				{
-					uint8_t* a = img.planes[3] + img.strides[3] * i;
-					uint8_t* b = a + img.width - 1;
-					if ( !reverse )
-					{
-						while ( a < b )
-						{
-							*a ++ = *b --;
-							*a ++ = *b --;
-						}
-					}
-					else
-					{
-						while ( a < b )
-						{
-							*b -- = *a ++;
-							*b -- = *a ++;
-						}
-					}
+					*( q - 2 ) = *p ++;
+					*( q - 3 - uneven_w ) = *p ++;
+					*( q - 4 ) = *p ++;
+					*( q - 1 - uneven_w ) = *p ++;
+					q -= 4;
 				}
 			}
-
 		}
-		else if ( !strcmp( mirror, "vertical" ) )
+		if ( img.planes[3] )
 		{
-			int hh = img.height / 2;
-			for ( i = 0; i < hh; i ++ )
+			for ( i = start; i < end; i ++ )
 			{
-				uint16_t* p = (uint16_t*)(img.planes[0] + (img.strides[0] * i));
-				uint16_t* q = (uint16_t*)(img.planes[0] + (img.strides[0] * (img.height - i - 1)));
-				int j = img.width;
+				uint8_t* a = img.planes[3] + img.strides[3] * i;
+				uint8_t* b = a + img.width - 1;
 				if ( !reverse )
 				{
-					while ( j -- )
+					while ( a < b )
 					{
-						*p ++ = *q ++;
+						*a ++ = *b --;
+						*a ++ = *b --;
 					}
 				}
 				else
 				{
-					while ( j -- )
+					while ( a < b )
 					{
-						*q ++ = *p ++;
+						*b -- = *a ++;
+						*b -- = *a ++;
 					}
 				}
 			}
+		}
+
+	}
+	else if ( ctx->mode == mirror_vertical )
+	{
+		for ( i = start; i < end; i ++ )
+		{
+			uint16_t* p = (uint16_t*)(img.planes[0] + (img.strides[0] * i));
+			uint16_t* q = (uint16_t*)(img.planes[0] + (img.strides[0] * (img.height - i - 1)));
+			int j = img.width;
+			if ( !reverse )
+			{
+				while ( j -- )
+				{
+					*p ++ = *q ++;
+				}
+			}
+			else
+			{
+				while ( j -- )
+				{
+					*q ++ = *p ++;
+				}
+			}
 			if ( img.planes[3] )
 			{
-				int j = img.width;
 				uint8_t* a = img.planes[3] + (img.strides[3] * i);
 				uint8_t* b = img.planes[3] + (img.strides[3] * (img.height - i - 1));
 				if ( !reverse )
-					while ( j -- )
-						*a ++ = *b ++;
+					memcpy( a, b, img.width );
 				else
-					while ( j -- )
-						*b ++ = *a ++;
+					memcpy( b, a, img.width );
 			}
 		}
-		else if ( !strcmp( mirror, "diagonal" ) )
+	}
+	else if ( ctx->mode == mirror_diagonal )
+	{
+		int uneven_w = ( img.width % 2 ) * 2;
+		for ( i = start; i < end; i ++ )
 		{
-			int uneven_w = ( img.width % 2 ) * 2;
-			for ( i = 0; i < img.height; i ++ )
+			uint8_t* p = img.planes[0] + (img.strides[0] * i);
+			uint8_t* q = img.planes[0] + (img.strides[0] * (img.height - i - 1));
+			int j = ( ( img.width * ( img.height - i ) ) / img.height ) / 2;
+			if ( !reverse )
 			{
-				uint8_t* p = img.planes[0] + (img.strides[0] * i);
-				uint8_t* q = img.planes[0] + (img.strides[0] * (img.height - i - 1));
-				int j = ( ( img.width * ( img.height - i ) ) / img.height ) / 2;
-				if ( !reverse )
-				{
-					while ( j -- )
-					{
-						*p ++ = *( q - 2 );
-						*p ++ = *( q - 3 - uneven_w );
-						*p ++ = *( q - 4 );
-						*p ++ = *( q - 1 - uneven_w );
-						q -= 4;
-					}
-				}
-				else
+				while ( j -- )
 				{
-					while ( j -- )
-					{
-						*( q - 2 ) = *p ++;
-						*( q - 3 - uneven_w ) = *p ++;
-						*( q - 4 ) = *p ++;
-						*( q - 1 - uneven_w ) = *p ++;
-						q -= 4;
-					}
+					*p ++ = *( q - 2 );
+					*p ++ = *( q - 3 - uneven_w );
+					*p ++ = *( q - 4 );
+					*p ++ = *( q - 1 - uneven_w );
+					q -= 4;
 				}
 			}
-			if ( img.planes[3] )
+			else
 			{
-				int i;
-				for ( i = 0; i < img.height; i ++ )
+				while ( j -- )
 				{
-					int j = ( img.width * ( img.height - i ) ) / img.height;
-					uint8_t* a = img.planes[3] + (img.strides[3] * i);
-					uint8_t* b = img.planes[3] + (img.strides[3] * (img.height - i - 1));
-					if ( !reverse )
-						while ( j -- )
-							*a ++ = *b --;
-					else
-						while ( j -- )
-							*b -- = *a ++;
+					*( q - 2 ) = *p ++;
+					*( q - 3 - uneven_w ) = *p ++;
+					*( q - 4 ) = *p ++;
+					*( q - 1 - uneven_w ) = *p ++;
+					q -= 4;
 				}
 			}
 		}
-		else if ( !strcmp( mirror, "xdiagonal" ) )
+		if ( img.planes[3] )
 		{
-			int uneven_w = ( img.width % 2 ) * 2;
-			for ( i = 0; i < img.height; i ++ )
+			for ( i = start; i < end; i ++ )
 			{
-				uint8_t* p = img.planes[0] + (img.strides[0] * (i + 1));
-				uint8_t* q = img.planes[0] + (img.strides[0] * (img.height - i));
-				int j = ( ( img.width * ( img.height - i ) ) / img.height ) / 2;
+				int j = ( img.width * ( img.height - i ) ) / img.height;
+				uint8_t* a = img.planes[3] + (img.strides[3] * i);
+				uint8_t* b = img.planes[3] + (img.strides[3] * (img.height - i - 1));
 				if ( !reverse )
-				{
 					while ( j -- )
-					{
-						*q ++ = *( p - 2 );
-						*q ++ = *( p - 3 - uneven_w );
-						*q ++ = *( p - 4 );
-						*q ++ = *( p - 1 - uneven_w );
-						p -= 4;
-					}
-				}
+						*a ++ = *b --;
 				else
-				{
 					while ( j -- )
-					{
-						*( p - 2 ) = *q ++;
-						*( p - 3 - uneven_w ) = *q ++;
-						*( p - 4 ) = *q ++;
-						*( p - 1 - uneven_w ) = *q ++;
-						p -= 4;
-					}
+						*b -- = *a ++;
+			}
+		}
+	}
+	else if ( ctx->mode == mirror_xdiagonal )
+	{
+		int uneven_w = ( img.width % 2 ) * 2;
+		for ( i = start; i < end; i ++ )
+		{
+			uint8_t* p = img.planes[0] + (img.strides[0] * (i + 1));
+			uint8_t* q = img.planes[0] + (img.strides[0] * (img.height - i));
+			int j = ( ( img.width * ( img.height - i ) ) / img.height ) / 2;
+			if ( !reverse )
+			{
+				while ( j -- )
+				{
+					*q ++ = *( p - 2 );
+					*q ++ = *( p - 3 - uneven_w );
+					*q ++ = *( p - 4 );
+					*q ++ = *( p - 1 - uneven_w );
+					p -= 4;
 				}
 			}
-			if ( img.planes[3] )
+			else
 			{
-				int i;
-				for ( i = 0; i < img.height; i ++ )
+				while ( j -- )
 				{
-					int j = ( ( img.width * ( img.height - i ) ) / img.height );
-					uint8_t* a = img.planes[3] + (img.strides[3] * i) + img.width - 1;
-					uint8_t* b = img.planes[3] + (img.strides[3] * (img.height - i - 1));
-					if ( !reverse )
-						while ( j -- )
-							*b ++ = *a --;
-					else
-						while ( j -- )
-							*a -- = *b ++;
+					*( p - 2 ) = *q ++;
+					*( p - 3 - uneven_w ) = *q ++;
+					*( p - 4 ) = *q ++;
+					*( p - 1 - uneven_w ) = *q ++;
+					p -= 4;
 				}
 			}
 		}
-		else if ( !strcmp( mirror, "flip" ) )
+		if ( img.planes[3] )
 		{
-			uint8_t t[ 4 ];
-			int uneven_w = ( img.width % 2 ) * 2;
-			for ( i = 0; i < img.height; i ++ )
+			for ( i = start; i < end; i ++ )
 			{
-				uint8_t* p = img.planes[0] + (img.strides[0] * i);
-				uint8_t* q = p + *width * 2;
-				while ( p < q )
-				{
-					t[ 0 ] = p[ 0 ];
-					t[ 1 ] = p[ 1 + uneven_w ];
-					t[ 2 ] = p[ 2 ];
-					t[ 3 ] = p[ 3 + uneven_w ];
-					*p ++ = *( q - 2 );
-					*p ++ = *( q - 3 - uneven_w );
-					*p ++ = *( q - 4 );
-					*p ++ = *( q - 1 - uneven_w );
-					*( -- q ) = t[ 3 ];
-					*( -- q ) = t[ 0 ];
-					*( -- q ) = t[ 1 ];
-					*( -- q ) = t[ 2 ];
-				}
+				int j = ( ( img.width * ( img.height - i ) ) / img.height );
+				uint8_t* a = img.planes[3] + (img.strides[3] * i) + img.width - 1;
+				uint8_t* b = img.planes[3] + (img.strides[3] * (img.height - i - 1));
+				if ( !reverse )
+					while ( j -- )
+						*b ++ = *a --;
+				else
+					while ( j -- )
+						*a -- = *b ++;
 			}
-			if ( img.planes[3] )
+		}
+	}
+	else if ( ctx->mode == mirror_flip )
+	{
+		uint8_t t[ 4 ];
+		int uneven_w = ( img.width % 2 ) * 2;
+		for ( i = start; i < end; i ++ )
+		{
+			uint8_t* p = img.planes[0] + (img.strides[0] * i);
+			uint8_t* q = p + img.width * 2;
+			while ( p < q )
 			{
-				uint8_t c;
-				for ( i = 0; i < img.height; i ++ )
-				{
-					uint8_t* a = img.planes[3] + (img.strides[3] * i);
-					uint8_t* b = a + img.width - 1;
-					while ( a < b )
-					{
-						c = *a;
-						*a ++ = *b;
-						*b -- = c;
-					}
-				}
+				t[ 0 ] = p[ 0 ];
+				t[ 1 ] = p[ 1 + uneven_w ];
+				t[ 2 ] = p[ 2 ];
+				t[ 3 ] = p[ 3 + uneven_w ];
+				*p ++ = *( q - 2 );
+				*p ++ = *( q - 3 - uneven_w );
+				*p ++ = *( q - 4 );
+				*p ++ = *( q - 1 - uneven_w );
+				*( -- q ) = t[ 3 ];
+				*( -- q ) = t[ 0 ];
+				*( -- q ) = t[ 1 ];
+				*( -- q ) = t[ 2 ];
 			}
 		}
-		else if ( !strcmp( mirror, "flop" ) )
+		if ( img.planes[3] )
 		{
-			uint16_t t;
-			int hh = *height / 2;
-			for ( i = 0; i < hh; i ++ )
+			uint8_t c;
+			for ( i = start; i < end; i ++ )
 			{
-				uint16_t* p = (uint16_t*)(img.planes[0] + (img.strides[0] * i));
-				uint16_t* q = (uint16_t*)(img.planes[0] + (img.strides[0] * (img.height - i - 1)));
-				int j = img.width;
-				while ( j -- )
+				uint8_t* a = img.planes[3] + (img.strides[3] * i);
+				uint8_t* b = a + img.width - 1;
+				while ( a < b )
 				{
-					t = *p;
-					*p ++ = *q;
-					*q ++ = t;
+					c = *a;
+					*a ++ = *b;
+					*b -- = c;
 				}
 			}
+		}
+	}
+	else if ( ctx->mode == mirror_flop )
+	{
+		uint16_t t;
+		for ( i = start; i < end; i ++ )
+		{
+			uint16_t* p = (uint16_t*)(img.planes[0] + (img.strides[0] * i));
+			uint16_t* q = (uint16_t*)(img.planes[0] + (img.strides[0] * (img.height - i - 1)));
+			int j = img.width;
+			while ( j -- )
+			{
+				t = *p;
+				*p ++ = *q;
+				*q ++ = t;
+			}
 			if ( img.planes[3] )
 			{
 				uint8_t c;
-				for ( i = 0; i < img.height; i ++ )
+				uint8_t* a = img.planes[3] + (img.strides[3] * i);
+				uint8_t* b = img.planes[3] + (img.strides[3] * (img.height - i - 1));
+				j = img.width;
+				while ( j -- )
 				{
-					uint8_t* a = img.planes[3] + (img.strides[3] * i);
-					uint8_t* b = img.planes[3] + (img.strides[3] * (img.height - i - 1));
-					while ( a < b )
-					{
-						c = *a;
-						*a ++ = *b;
-						*b -- = c;
-					}
+					c = *a;
+					*a ++ = *b;
+					*b ++ = c;
 				}
 			}
 		}
 	}
+	return 0;
+}
+
+/** Do it :-).
+*/
+
+static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
+{
+	struct mlt_image_s img;
+
+	// Pop the mirror filter from the stack
+	mlt_filter filter = mlt_frame_pop_service( frame );
+
+	// Get the mirror type
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+
+	// Get the properties
+	char *mirror = mlt_properties_get( properties, "mirror" );
+
+	// Determine if reverse is required
+	int reverse = mlt_properties_get_int( properties, "reverse" );
+
+	// Get the image
+	*format = mlt_image_yuv422;
+	int error = mlt_frame_get_image( frame, image, format, width, height, 1 );
+
+	// If we have an image of the right colour space
+	if ( error == 0 && *format == mlt_image_yuv422 )
+	{
+		struct sliced_desc desc = { &img, mirror_horizontal, reverse };
+		int threads = CLAMP( mlt_properties_get_int( properties, "threads" ), 0, mlt_slices_count_normal() );
+
+		mlt_image_set_values( &img, *image, *format, *width, *height );
+		if ( mlt_frame_get_alpha( frame ) )
+		{
+			img.planes[3] = mlt_frame_get_alpha( frame );
+			img.strides[3] = img.width;
+		}
+
+		if ( !strcmp( mirror, "horizontal" ) )
+			desc.mode = mirror_horizontal;
+		else if ( !strcmp( mirror, "vertical" ) )
+			desc.mode = mirror_vertical;
+		else if ( !strcmp( mirror, "diagonal" ) )
+			desc.mode = mirror_diagonal;
+		else if ( !strcmp( mirror, "xdiagonal" ) )
+			desc.mode = mirror_xdiagonal;
+		else if ( !strcmp( mirror, "flip" ) )
+			desc.mode = mirror_flip;
+		else if ( !strcmp( mirror, "flop" ) )
+			desc.mode = mirror_flop;
+		else
+			return error;
+
+		// A diagonal row reads a little of a row that an earlier row writes
+		if ( desc.mode == mirror_diagonal || desc.mode == mirror_xdiagonal )
+			threads = 1;
+
+		if ( threads == 1 )
+			sliced_proc( 0, 0, 1, &desc );
+		else
+			mlt_slices_run_normal( threads, sliced_proc, &desc );
+	}
 
 	// Return the error
 	return error;
@@ -0,0 +1,211 @@
+/*
+ * filter_mixbus.c -- mix all of the audio tracks of a tractor in one pass
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mix_audio_simd.h"
+
+#include <framework/mlt_filter.h>
+#include <framework/mlt_frame.h>
+#include <framework/mlt_log.h>
+#include <framework/mlt_profile.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TRACKS (256)
+
+// The tractor keeps the frames of its tracks on its frame under these names
+#define TRACK_PREFIX "mlt_tractor "
+
+/** Find the frames of the tracks whose audio the tractor would use.
+ *
+ * \return the number of the highest track plus one, or 0 if this is not a tractor frame
+ */
+
+static int find_tracks( mlt_frame frame, mlt_frame *tracks )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
+	int count = mlt_properties_count( properties );
+	int result = 0;
+	int i;
+
+	for ( i = 0; i < count; i++ )
+	{
+		const char *name = mlt_properties_get_name( properties, i );
+		const char *index = name ? strrchr( name, '_' ) : NULL;
+		int track = index ? atoi( index + 1 ) : -1;
+
+		if ( !strncmp( name, TRACK_PREFIX, strlen( TRACK_PREFIX ) ) && track >= 0 && track < MAX_TRACKS )
+		{
+			mlt_frame temp = mlt_properties_get_data_at( properties, i, NULL );
+			mlt_properties temp_properties = MLT_FRAME_PROPERTIES( temp );
+
+			// The same tracks as the tractor, without the marker after the last one and effect tracks
+			if ( !mlt_properties_get_int( temp_properties, "last_track" ) && !mlt_frame_is_test_audio( temp )
+			     && !( mlt_properties_get_int( temp_properties, "hide" ) & 2 )
+			     && !mlt_properties_get_int( temp_properties, "fx_cut" ) )
+			{
+				tracks[ track ] = temp;
+				result = MAX( result, track + 1 );
+			}
+		}
+	}
+	return result;
+}
+
+// Add the tracks whose only setting is a gain ramp, all of them in one pass
+static void sum_tracks( float *out, float **inputs, const double *start, const double *step, int count,
+	int channels, int samples )
+{
+	const mix_audio_simd *simd = mix_audio_simd_get();
+	int i = 0, j, k;
+	double v;
+
+	if ( simd->sum )
+		i = simd->sum( out, (const float *const *) inputs, start, step, count, channels, samples );
+	for ( ; i < samples; i++ )
+	{
+		for ( j = 0; j < channels; j++ )
+		{
+			v = (double) out[ i * channels + j ];
+			for ( k = 0; k < count; k++ )
+				v = v + ( start[k] + i * step[k] ) * (double) inputs[k][ i * channels + j ];
+			out[ i * channels + j ] = v;
+		}
+	}
+}
+
+/** Get the audio.
+*/
+
+static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
+{
+	mlt_filter filter = mlt_frame_pop_audio( frame );
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	mlt_position position = mlt_filter_get_position( filter, frame );
+	mlt_position length = mlt_filter_get_length2( filter, frame );
+	mlt_frame tracks[MAX_TRACKS] = { NULL };
+	float *inputs[MAX_TRACKS];
+	double start[MAX_TRACKS], step[MAX_TRACKS];
+	int count = 0;
+	int track_count, track, i, j;
+
+	mlt_properties_lock( MLT_FRAME_PROPERTIES( frame ) );
+	track_count = find_tracks( frame, tracks );
+	mlt_properties_unlock( MLT_FRAME_PROPERTIES( frame ) );
+
+	// Without tracks this is not on a tractor, so leave the audio alone
+	if ( !track_count )
+		return mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
+
+	// We can only mix interleaved 32-bit float.
+	*format = mlt_audio_f32le;
+	if ( *channels <= 0 )
+		*channels = 2;
+	if ( *frequency <= 0 )
+		*frequency = 48000;
+	if ( *samples <= 0 )
+		*samples = mlt_audio_calculate_frame_samples( mlt_profile_fps( mlt_service_profile( MLT_FILTER_SERVICE( filter ) ) ),
+			*frequency, mlt_frame_get_position( frame ) );
+
+	int size = mlt_audio_format_size( *format, *samples, *channels );
+	float *out = mlt_pool_alloc( size );
+	memset( out, 0, size );
+
+	for ( track = 0; track < track_count; track++ )
+	{
+		mlt_audio_format track_format = mlt_audio_f32le;
+		int track_frequency = *frequency, track_channels = *channels, track_samples = *samples;
+		float *track_buffer = NULL;
+		double gain_start = 1.0, gain_end = 1.0, pan = 0.0;
+		char key[32];
+
+		if ( !tracks[ track ] )
+			continue;
+
+		snprintf( key, sizeof( key ), "gain.%d", track );
+		if ( mlt_properties_get( properties, key ) )
+		{
+			gain_start = mlt_properties_anim_get_double( properties, key, position, length );
+			gain_end = mlt_properties_anim_get_double( properties, key, position + 1, length );
+		}
+		snprintf( key, sizeof( key ), "pan.%d", track );
+		if ( mlt_properties_get( properties, key ) )
+			pan = CLAMP( mlt_properties_anim_get_double( properties, key, position, length ), -1.0, 1.0 );
+		if ( gain_start == 0.0 && gain_end == 0.0 )
+			continue;
+
+		if ( mlt_frame_get_audio( tracks[ track ], (void**) &track_buffer, &track_format, &track_frequency,
+				&track_channels, &track_samples ) || !track_buffer || track_format != mlt_audio_f32le )
+			continue;
+		if ( mlt_properties_get_int( MLT_FRAME_PROPERTIES( tracks[ track ] ), "silent_audio" ) )
+			continue;
+
+		if ( track_channels == *channels && track_samples >= *samples && pan == 0.0 )
+		{
+			// Collect these to add them all at once
+			inputs[ count ] = track_buffer;
+			start[ count ] = gain_start;
+			step[ count++ ] = ( gain_end - gain_start ) / *samples;
+		}
+		else
+		{
+			// Pan the pairs of channels by attenuating the opposite side
+			int n = MIN( track_samples, *samples );
+			int c = MIN( track_channels, *channels );
+			double gain_step = ( gain_end - gain_start ) / *samples;
+			double side[2] = { pan > 0.0 && *channels > 1 ? 1.0 - pan : 1.0, pan < 0.0 && *channels > 1 ? 1.0 + pan : 1.0 };
+
+			for ( i = 0; i < n; i++ )
+			{
+				double gain = gain_start + i * gain_step;
+				for ( j = 0; j < c; j++ )
+					out[ i * *channels + j ] += gain * side[ j & 1 ] * track_buffer[ i * track_channels + j ];
+			}
+		}
+	}
+	if ( count )
+		sum_tracks( out, inputs, start, step, count, *channels, *samples );
+
+	*buffer = out;
+	mlt_frame_set_audio( frame, out, *format, size, mlt_pool_release );
+
+	return 0;
+}
+
+/** Filter processing.
+*/
+
+static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
+{
+	mlt_frame_push_audio( frame, filter );
+	mlt_frame_push_audio( frame, filter_get_audio );
+	return frame;
+}
+
+/** Constructor for the filter.
+*/
+
+mlt_filter filter_mixbus_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg )
+{
+	mlt_filter filter = mlt_filter_new( );
+	if ( filter )
+		filter->process = filter_process;
+	return filter;
+}
@@ -20,6 +20,7 @@
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_profile.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -123,6 +124,8 @@ static float lerp( float value, float lower, float upper )
 static void geometry_calculate( struct geometry_s *output, struct geometry_s *in, struct geometry_s *out, float position, int ow, int oh )
 {
 	// Calculate this frames geometry
+	output->nw = ow;
+	output->nh = oh;
 	output->x = lerp( ( in->x + ( out->x - in->x ) * position ) / ( float )out->nw * ow, 0, ow );
 	output->y = lerp( ( in->y + ( out->y - in->y ) * position ) / ( float )out->nh * oh, 0, oh );
 	output->w = lerp( ( in->w + ( out->w - in->w ) * position ) / ( float )out->nw * ow, 0, ow - output->x );
@@ -180,8 +183,19 @@ static inline void obscure_average( uint8_t *start, int width, int height, int s
 /** The obscurer rendering function...
 */
 
-static void obscure_render( uint8_t *image, int width, int height, struct geometry_s result )
+struct sliced_desc
 {
+	uint8_t *image;
+	int width;
+	struct geometry_s result;
+};
+
+static int sliced_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	struct geometry_s result = ctx->result;
+	int width = ctx->width;
 	int area_x = result.x;
 	int area_y = result.y;
 	int area_w = result.w;
@@ -194,11 +208,16 @@ static void obscure_render( uint8_t *image, int width, int height, struct geomet
 	int aw;
 	int ah;
 
-	uint8_t *p = image + area_y * width * 2 + area_x * 2;
+	// Each slice averages whole rows of blocks
+	int rows = ( area_h + mh - 1 ) / mh;
+	int start = rows * index / jobs * mh;
+	int end = rows * ( index + 1 ) / jobs * mh;
+
+	uint8_t *p = ctx->image + area_y * width * 2 + area_x * 2;
 
-	for ( w = 0; w < area_w; w += mw )
+	for ( h = start; h < end && h < area_h; h += mh )
 	{
-		for ( h = 0; h < area_h; h += mh )
+		for ( w = 0; w < area_w; w += mw )
 		{
 			aw = w + mw > area_w ? mw - ( w + mw - area_w ) : mw;
 			ah = h + mh > area_h ? mh - ( h + mh - area_h ) : mh;
@@ -206,6 +225,17 @@ static void obscure_render( uint8_t *image, int width, int height, struct geomet
 				obscure_average( p + h * ( width << 1 ) + ( w << 1 ), aw, ah, width << 1 );
 		}
 	}
+	return 0;
+}
+
+static void obscure_render( uint8_t *image, int width, int height, struct geometry_s result, int threads )
+{
+	struct sliced_desc desc = { image, width, result };
+	threads = CLAMP( threads, 0, mlt_slices_count_normal() );
+	if ( threads == 1 )
+		sliced_proc( 0, 0, 1, &desc );
+	else
+		mlt_slices_run_normal( threads, sliced_proc, &desc );
 }
 
 /** Do it :-).
@@ -245,7 +275,7 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 			geometry_calculate( &result, &start, &end, position, *width, *height );
 
 			// Now actually render it
-			obscure_render( *image, *width, *height, result );
+			obscure_render( *image, *width, *height, result, mlt_properties_get_int( properties, "threads" ) );
 		}
 	}
 
@@ -0,0 +1,769 @@
+/*
+ * filter_rendercache.c -- cache the rendered frames of a service in memory or on disk
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <framework/mlt_cache.h>
+#include <framework/mlt_consumer.h>
+#include <framework/mlt_factory.h>
+#include <framework/mlt_filter.h>
+#include <framework/mlt_frame.h>
+#include <framework/mlt_log.h>
+#include <framework/mlt_pool.h>
+#include <framework/mlt_slices.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir( path, mode ) _mkdir( path )
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#define CACHE_MAGIC "MLTRC002"
+
+// The most bytes of frames waiting to be written before more are dropped
+#define MAX_PENDING ( (int64_t) 256 << 20 )
+
+/** The header of a cache file, followed by the image and alpha or the audio */
+
+typedef struct
+{
+	char magic[8];
+	int32_t format;
+	int32_t width;
+	int32_t height;
+	int32_t frequency;
+	int32_t channels;
+	int32_t samples;
+	int32_t progressive;
+	int32_t top_field_first;
+	int32_t colorspace;
+	int32_t full_luma;
+	double aspect_ratio;
+	int64_t size;
+	int64_t alpha_size;
+	int64_t stored_size;   // the bytes after the header, which are compressed if fewer than size + alpha_size
+} cache_header;
+
+typedef struct
+{
+	mlt_cache memory;         // the in memory store of the cache filter, NULL for files
+	mlt_slices_group writes;  // the files being written, NULL to write them in the caller
+	pthread_mutex_t mutex;    // protects the members below
+	int64_t pending;          // the bytes of the writes not done yet
+	int64_t used;             // the bytes of the files in the directory, -1 if not known
+	int evicting;
+	int warned;
+} private_data;
+
+/** An entry of the in memory store, followed by the data */
+
+typedef struct
+{
+	uint64_t graph;
+	char name[80];
+	cache_header header;
+} memory_entry;
+
+/** A file to write in the background, followed by the data */
+
+typedef struct
+{
+	mlt_filter filter;
+	char *path;
+	int64_t max_bytes;
+	int compress;
+	cache_header header;
+} write_job;
+
+/** A file of the directory for eviction */
+
+typedef struct
+{
+	char *path;
+	int64_t size;
+	time_t time;
+} cache_file;
+
+static uint64_t hash_string( const char *s )
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	while ( *s )
+	{
+		hash ^= (unsigned char) *s++;
+		hash *= 1099511628211ULL;
+	}
+	return hash ? hash : 1;
+}
+
+/** Get the hash of the XML of the service with its filters and everything under it.
+ *
+ * It is computed for every frame, because the services under the service can
+ * change without telling it, and any such change must give a new key.
+ */
+
+static uint64_t graph_hash( mlt_filter filter )
+{
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	mlt_service service = mlt_properties_get_data( properties, "service", NULL );
+	mlt_consumer xml;
+	uint64_t graph = 0;
+
+	if ( !service )
+		return 0;
+	xml = mlt_factory_consumer( mlt_service_profile( service ), "xml", "string" );
+	if ( xml )
+	{
+		mlt_properties xml_properties = MLT_CONSUMER_PROPERTIES( xml );
+		mlt_properties_set_int( xml_properties, "no_meta", 1 );
+		mlt_properties_set( xml_properties, "root", "" );
+		mlt_consumer_connect( xml, service );
+		mlt_consumer_start( xml );
+		if ( mlt_properties_get( xml_properties, "string" ) )
+			graph = hash_string( mlt_properties_get( xml_properties, "string" ) );
+		mlt_consumer_close( xml );
+	}
+	return graph;
+}
+
+/** Check that a directory is only writable by this user, creating it if needed.
+ *
+ * \param path the directory
+ * \param mask the permission bits that others must not have
+ * \return true if it can be used
+ */
+
+static int private_directory( const char *path, int mask )
+{
+#ifndef _WIN32
+	struct stat st;
+
+	if ( mkdir( path, 0700 ) && errno != EEXIST )
+		return 0;
+	return !lstat( path, &st ) && S_ISDIR( st.st_mode ) && st.st_uid == getuid() && !( st.st_mode & mask );
+#else
+	return !mkdir( path, 0700 ) || errno == EEXIST;
+#endif
+}
+
+/** Get the path of a cache file.
+ *
+ * \return the path to free, or NULL if the directory cannot be used
+ */
+
+static char *cache_path( mlt_filter filter, uint64_t graph, const char *name, int make )
+{
+	private_data *pdata = filter->child;
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	const char *directory = mlt_properties_get( properties, "directory" );
+	const char *standard = mlt_properties_get( properties, "_standard" );
+	char *path;
+
+	// A directory that others can write could give us their frames
+	if ( !directory || !private_directory( directory, standard && !strcmp( directory, standard ) ? 077 : 022 ) )
+	{
+		if ( !pdata->warned )
+			mlt_log_warning( MLT_FILTER_SERVICE( filter ), "cannot use the directory %s, caching is off\n", directory );
+		pdata->warned = 1;
+		return NULL;
+	}
+	path = malloc( strlen( directory ) + strlen( name ) + 20 );
+	sprintf( path, "%s/%016llx", directory, (unsigned long long) graph );
+	if ( make )
+		mkdir( path, 0700 );
+	sprintf( path + strlen( path ), "/%s", name );
+	return path;
+}
+
+static int compare_files( const void *a, const void *b )
+{
+	const cache_file *x = a, *y = b;
+	return x->time < y->time ? -1 : x->time > y->time;
+}
+
+/** Add up the files in the directory and remove the least recently used ones
+ * until they take at most three quarters of max_bytes.
+ *
+ * \return the bytes left in the directory
+ */
+
+static int64_t cache_evict( const char *directory, int64_t max_bytes )
+{
+	cache_file *files = NULL;
+	int count = 0, allocated = 0, i;
+	int64_t used = 0;
+	DIR *top = opendir( directory );
+	struct dirent *graph;
+
+	while ( top && ( graph = readdir( top ) ) )
+	{
+		char *sub = malloc( strlen( directory ) + strlen( graph->d_name ) + 2 );
+		DIR *dir;
+		struct dirent *entry;
+
+		sprintf( sub, "%s/%s", directory, graph->d_name );
+		dir = graph->d_name[0] != '.' ? opendir( sub ) : NULL;
+		while ( dir && ( entry = readdir( dir ) ) )
+		{
+			char *path = malloc( strlen( sub ) + strlen( entry->d_name ) + 2 );
+			struct stat st;
+
+			sprintf( path, "%s/%s", sub, entry->d_name );
+			if ( entry->d_name[0] != '.' && !stat( path, &st ) && S_ISREG( st.st_mode ) )
+			{
+				if ( count == allocated )
+				{
+					allocated = allocated ? allocated * 2 : 256;
+					files = realloc( files, allocated * sizeof( *files ) );
+				}
+				files[ count ].path = path;
+				files[ count ].size = st.st_size;
+				files[ count ].time = st.st_mtime;
+				used += st.st_size;
+				count++;
+			}
+			else
+			{
+				free( path );
+			}
+		}
+		if ( dir )
+			closedir( dir );
+		free( sub );
+	}
+	if ( top )
+		closedir( top );
+
+	if ( used > max_bytes )
+	{
+		// Reading a file touches it, so the oldest is the least recently used
+		qsort( files, count, sizeof( *files ), compare_files );
+		for ( i = 0; i < count && used > max_bytes / 4 * 3; i++ )
+		{
+			if ( !remove( files[ i ].path ) )
+			{
+				char *slash = strrchr( files[ i ].path, '/' );
+				used -= files[ i ].size;
+				*slash = 0;
+				rmdir( files[ i ].path );
+			}
+		}
+	}
+	for ( i = 0; i < count; i++ )
+		free( files[ i ].path );
+	free( files );
+	return used;
+}
+
+/** Read a cache file.
+ *
+ * \return a buffer from mlt_pool holding the data after the header, or NULL
+ */
+
+static uint8_t *cache_read( const char *path, cache_header *header )
+{
+	uint8_t *data = NULL;
+	uint8_t *stored = NULL;
+	struct stat st;
+	int fd = open( path, O_RDONLY | O_BINARY );
+
+	if ( fd < 0 )
+		return NULL;
+	// The file is read rather than mapped, as a mapping faults if the file is cut short
+	if ( !fstat( fd, &st ) && read( fd, header, sizeof( *header ) ) == sizeof( *header )
+		 && !memcmp( header->magic, CACHE_MAGIC, 8 ) && header->size >= 0 && header->alpha_size >= 0
+		 && header->stored_size > 0 && header->stored_size <= header->size + header->alpha_size
+		 && sizeof( *header ) + header->stored_size == st.st_size
+		 && ( data = mlt_pool_alloc( header->size + header->alpha_size ) ) )
+	{
+		int64_t size = header->size + header->alpha_size;
+
+		if ( header->stored_size == size )
+		{
+			if ( read( fd, data, size ) != size )
+			{
+				mlt_pool_release( data );
+				data = NULL;
+			}
+		}
+#ifdef USE_ZLIB
+		else if ( ( stored = malloc( header->stored_size ) ) && read( fd, stored, header->stored_size ) == header->stored_size )
+		{
+			uLongf length = size;
+			if ( uncompress( data, &length, stored, header->stored_size ) != Z_OK || length != size )
+			{
+				mlt_pool_release( data );
+				data = NULL;
+			}
+		}
+#endif
+		else
+		{
+			mlt_pool_release( data );
+			data = NULL;
+		}
+	}
+#ifndef _WIN32
+	// Mark it as recently used for the eviction
+	if ( data )
+		futimens( fd, NULL );
+#endif
+	free( stored );
+	close( fd );
+	return data;
+}
+
+/** Write a cache file under a temporary name and rename it, so that readers only see whole files.
+ *
+ * \param data the image followed by the alpha, or the audio
+ * \return the bytes written, 0 on error
+ */
+
+static int64_t cache_write( mlt_filter filter, const char *path, cache_header *header, const uint8_t *data, int compress )
+{
+	static int counter = 0;
+	int64_t size = header->size + header->alpha_size;
+	const uint8_t *stored = data;
+	uint8_t *compressed = NULL;
+	char *temp = malloc( strlen( path ) + 40 );
+	int fd;
+
+	header->stored_size = size;
+#ifdef USE_ZLIB
+	if ( compress && size > 0 )
+	{
+		uLongf length = compressBound( size );
+		compressed = malloc( length );
+		if ( compressed && compress2( compressed, &length, data, size, Z_BEST_SPEED ) == Z_OK && length < size )
+		{
+			stored = compressed;
+			header->stored_size = length;
+		}
+	}
+#endif
+	memcpy( header->magic, CACHE_MAGIC, 8 );
+	sprintf( temp, "%s.%d.%d.tmp", path, (int) getpid(), __sync_fetch_and_add( &counter, 1 ) );
+	fd = open( temp, O_WRONLY | O_CREAT | O_EXCL | O_BINARY, 0600 );
+	if ( fd >= 0 )
+	{
+		int error = write( fd, header, sizeof( *header ) ) != sizeof( *header )
+			|| write( fd, stored, header->stored_size ) != header->stored_size;
+		error = close( fd ) || error;
+		if ( error || rename( temp, path ) )
+		{
+			mlt_log_warning( MLT_FILTER_SERVICE( filter ), "failed to write %s: %s\n", path, strerror( errno ) );
+			remove( temp );
+			size = 0;
+		}
+		else
+		{
+			size = sizeof( *header ) + header->stored_size;
+		}
+	}
+	else
+	{
+		size = 0;
+	}
+	free( compressed );
+	free( temp );
+	return size;
+}
+
+/** Write a file and keep the directory within its budget.
+ */
+
+static int write_proc( void *cookie )
+{
+	write_job *job = cookie;
+	mlt_filter filter = job->filter;
+	private_data *pdata = filter->child;
+	int64_t size = job->header.size + job->header.alpha_size;
+	int64_t written = cache_write( filter, job->path, &job->header, (uint8_t*) ( job + 1 ), job->compress );
+	int evict = 0;
+
+	pthread_mutex_lock( &pdata->mutex );
+	pdata->pending -= size;
+	if ( pdata->used >= 0 )
+		pdata->used += written;
+	if ( !pdata->evicting && ( pdata->used < 0 || pdata->used > job->max_bytes ) )
+		evict = pdata->evicting = 1;
+	pthread_mutex_unlock( &pdata->mutex );
+
+	if ( evict )
+	{
+		// The path is directory/graph/name
+		char *directory = strdup( job->path );
+		int64_t used;
+
+		*strrchr( directory, '/' ) = 0;
+		*strrchr( directory, '/' ) = 0;
+		used = cache_evict( directory, job->max_bytes );
+		free( directory );
+		pthread_mutex_lock( &pdata->mutex );
+		pdata->used = used;
+		pdata->evicting = 0;
+		pthread_mutex_unlock( &pdata->mutex );
+	}
+	free( job->path );
+	free( job );
+	return 0;
+}
+
+static void *memory_key( uint64_t graph, const char *name )
+{
+	return (void*) (uintptr_t) ( graph ^ hash_string( name ) );
+}
+
+/** Look up a cached image or audio block.
+ *
+ * \return a buffer from mlt_pool holding the data after the header, or NULL
+ */
+
+static uint8_t *cache_lookup( mlt_filter filter, uint64_t graph, const char *name, cache_header *header )
+{
+	private_data *pdata = filter->child;
+	uint8_t *data = NULL;
+
+	if ( pdata->memory )
+	{
+		mlt_cache_item item = mlt_cache_get( pdata->memory, memory_key( graph, name ) );
+		memory_entry *entry = mlt_cache_item_data( item, NULL );
+
+		// The key is only a hash, so check what it is for
+		if ( entry && entry->graph == graph && !strcmp( entry->name, name )
+			 && ( data = mlt_pool_alloc( entry->header.size + entry->header.alpha_size ) ) )
+		{
+			*header = entry->header;
+			memcpy( data, entry + 1, header->size + header->alpha_size );
+		}
+		mlt_cache_item_close( item );
+	}
+	else
+	{
+		char *path = cache_path( filter, graph, name, 0 );
+		if ( path )
+			data = cache_read( path, header );
+		free( path );
+	}
+	return data;
+}
+
+static void cache_store( mlt_filter filter, uint64_t graph, const char *name, cache_header *header,
+	const void *data, const void *alpha )
+{
+	private_data *pdata = filter->child;
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+
+	if ( pdata->memory )
+	{
+		int size = sizeof( memory_entry ) + header->size + header->alpha_size;
+		memory_entry *entry = malloc( size );
+
+		if ( entry )
+		{
+			entry->graph = graph;
+			snprintf( entry->name, sizeof( entry->name ), "%s", name );
+			entry->header = *header;
+			memcpy( entry + 1, data, header->size );
+			if ( header->alpha_size )
+				memcpy( (uint8_t*) ( entry + 1 ) + header->size, alpha, header->alpha_size );
+			mlt_cache_set_max_bytes( pdata->memory, mlt_properties_get_int64( properties, "max_bytes" ) );
+			mlt_cache_put( pdata->memory, memory_key( graph, name ), entry, size, free );
+		}
+	}
+	else
+	{
+		int64_t size = header->size + header->alpha_size;
+		write_job *job = NULL;
+		int accept;
+
+		// Drop the frame rather than queue without bound when the disk is slower than rendering
+		pthread_mutex_lock( &pdata->mutex );
+		accept = pdata->pending + size <= MAX_PENDING;
+		if ( accept )
+			pdata->pending += size;
+		pthread_mutex_unlock( &pdata->mutex );
+		if ( accept && ( job = malloc( sizeof( *job ) + size ) ) )
+		{
+			job->filter = filter;
+			job->path = cache_path( filter, graph, name, 1 );
+			job->max_bytes = mlt_properties_get_int64( properties, "max_bytes" );
+			job->compress = mlt_properties_get_int( properties, "compress" );
+			job->header = *header;
+			memcpy( job + 1, data, header->size );
+			if ( header->alpha_size )
+				memcpy( (uint8_t*) ( job + 1 ) + header->size, alpha, header->alpha_size );
+		}
+		if ( job && job->path )
+		{
+			if ( pdata->writes )
+				mlt_slices_group_submit( pdata->writes, write_proc, job );
+			else
+				write_proc( job );
+		}
+		else if ( accept )
+		{
+			if ( job )
+				free( job );
+			pthread_mutex_lock( &pdata->mutex );
+			pdata->pending -= size;
+			pthread_mutex_unlock( &pdata->mutex );
+		}
+	}
+}
+
+static int cacheable_image( mlt_image_format format )
+{
+	return format != mlt_image_none && format != mlt_image_movit && format != mlt_image_opengl_texture
+		&& format != mlt_image_hwframe && format != mlt_image_invalid;
+}
+
+static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
+{
+	mlt_filter filter = mlt_frame_pop_service( frame );
+	mlt_properties frame_properties = MLT_FRAME_PROPERTIES( frame );
+	uint64_t graph;
+	char name[80];
+	cache_header header;
+	uint8_t *data;
+	int error;
+
+	graph = mlt_properties_get_int64( mlt_frame_unique_properties( frame, MLT_FILTER_SERVICE( filter ) ), "graph" );
+	if ( !graph || !cacheable_image( *format ) )
+		return mlt_frame_get_image( frame, image, format, width, height, writable );
+
+	snprintf( name, sizeof( name ), "%d.%dx%d.%d.image", mlt_frame_get_position( frame ), *width, *height, *format );
+	data = cache_lookup( filter, graph, name, &header );
+	if ( data && header.size == mlt_image_format_size( header.format, header.width, header.height, NULL )
+		 && ( !header.alpha_size || header.alpha_size == header.width * header.height ) )
+	{
+		// Use the cached image without rendering the services under this filter
+		*format = header.format;
+		*width = header.width;
+		*height = header.height;
+		*image = data;
+		mlt_frame_set_image( frame, data, header.size, mlt_pool_release );
+		if ( header.alpha_size )
+		{
+			uint8_t *alpha = mlt_pool_alloc( header.alpha_size );
+			memcpy( alpha, data + header.size, header.alpha_size );
+			mlt_frame_set_alpha( frame, alpha, header.alpha_size, mlt_pool_release );
+		}
+		mlt_properties_set_int( frame_properties, "format", header.format );
+		mlt_properties_set_int( frame_properties, "width", header.width );
+		mlt_properties_set_int( frame_properties, "height", header.height );
+		mlt_properties_set_int( frame_properties, "progressive", header.progressive );
+		mlt_properties_set_int( frame_properties, "top_field_first", header.top_field_first );
+		mlt_properties_set_int( frame_properties, "colorspace", header.colorspace );
+		mlt_properties_set_int( frame_properties, "full_luma", header.full_luma );
+		mlt_properties_set_double( frame_properties, "aspect_ratio", header.aspect_ratio );
+		return 0;
+	}
+	mlt_pool_release( data );
+
+	error = mlt_frame_get_image( frame, image, format, width, height, writable );
+	if ( !error && *image && cacheable_image( *format ) )
+	{
+		uint8_t *alpha = mlt_frame_get_alpha( frame );
+
+		memset( &header, 0, sizeof( header ) );
+		header.format = *format;
+		header.width = *width;
+		header.height = *height;
+		header.progressive = mlt_properties_get_int( frame_properties, "progressive" );
+		header.top_field_first = mlt_properties_get_int( frame_properties, "top_field_first" );
+		header.colorspace = mlt_properties_get_int( frame_properties, "colorspace" );
+		header.full_luma = mlt_properties_get_int( frame_properties, "full_luma" );
+		header.aspect_ratio = mlt_properties_get_double( frame_properties, "aspect_ratio" );
+		header.size = mlt_image_format_size( *format, *width, *height, NULL );
+		header.alpha_size = alpha ? *width * *height : 0;
+		cache_store( filter, graph, name, &header, *image, alpha );
+	}
+	return error;
+}
+
+static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
+{
+	mlt_filter filter = mlt_frame_pop_audio( frame );
+	uint64_t graph;
+	char name[80];
+	cache_header header;
+	uint8_t *data;
+	int error;
+
+	graph = mlt_properties_get_int64( mlt_frame_unique_properties( frame, MLT_FILTER_SERVICE( filter ) ), "graph" );
+	if ( !graph )
+		return mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
+
+	snprintf( name, sizeof( name ), "%d.%d.%d.%d.%d.audio", mlt_frame_get_position( frame ), *format, *frequency, *channels, *samples );
+	data = cache_lookup( filter, graph, name, &header );
+	if ( data && header.size == mlt_audio_format_size( header.format, header.samples, header.channels ) )
+	{
+		*format = header.format;
+		*frequency = header.frequency;
+		*channels = header.channels;
+		*samples = header.samples;
+		*buffer = data;
+		mlt_frame_set_audio( frame, data, header.format, header.size, mlt_pool_release );
+		return 0;
+	}
+	mlt_pool_release( data );
+
+	error = mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
+	if ( !error && *buffer )
+	{
+		memset( &header, 0, sizeof( header ) );
+		header.format = *format;
+		header.frequency = *frequency;
+		header.channels = *channels;
+		header.samples = *samples;
+		header.size = mlt_audio_format_size( *format, *samples, *channels );
+		cache_store( filter, graph, name, &header, *buffer, NULL );
+	}
+	return error;
+}
+
+/** Filter processing.
+*/
+
+static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
+{
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	uint64_t graph;
+
+	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
+	graph = graph_hash( filter );
+	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+	mlt_properties_set_int64( mlt_frame_unique_properties( frame, MLT_FILTER_SERVICE( filter ) ), "graph", (int64_t) graph );
+	if ( mlt_properties_get_int( properties, "video" ) )
+	{
+		mlt_frame_push_service( frame, filter );
+		mlt_frame_push_get_image( frame, filter_get_image );
+	}
+	if ( mlt_properties_get_int( properties, "audio" ) )
+	{
+		mlt_frame_push_audio( frame, filter );
+		mlt_frame_push_audio( frame, filter_get_audio );
+	}
+	return frame;
+}
+
+static void filter_close( mlt_filter filter )
+{
+	private_data *pdata = filter->child;
+
+	// The writes use the filter until they finish
+	if ( pdata->writes )
+		mlt_slices_group_close( pdata->writes );
+	if ( pdata->memory )
+		mlt_cache_close( pdata->memory );
+	pthread_mutex_destroy( &pdata->mutex );
+	free( pdata );
+	filter->child = NULL;
+	filter->close = NULL;
+	filter->parent.close = NULL;
+	mlt_service_close( &filter->parent );
+}
+
+/** Constructor for the filter.
+*/
+
+mlt_filter filter_rendercache_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg )
+{
+	mlt_filter filter = mlt_filter_new();
+	private_data *pdata = calloc( 1, sizeof( *pdata ) );
+
+	if ( filter && pdata )
+	{
+		mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+
+		if ( !strcmp( id, "cache" ) )
+		{
+			// Keep the frames in memory within a byte budget
+			pdata->memory = mlt_cache_init();
+			mlt_cache_set_size( pdata->memory, 0x7fffffff );
+			mlt_properties_set_int64( properties, "max_bytes", arg ? strtoll( arg, NULL, 10 ) << 20 : 0 );
+			if ( mlt_properties_get_int64( properties, "max_bytes" ) <= 0 )
+				mlt_properties_set_int64( properties, "max_bytes", (int64_t) 512 << 20 );
+		}
+		else
+		{
+			if ( arg && strcmp( arg, "" ) )
+			{
+				mlt_properties_set( properties, "directory", arg );
+			}
+			else
+			{
+				// A directory of this user, which is checked to be private before use
+				const char *base = getenv( "XDG_CACHE_HOME" );
+				const char *home = getenv( "HOME" );
+				char *directory;
+
+				if ( !base || base[0] != '/' )
+					base = NULL;
+				directory = malloc( ( base ? strlen( base ) : home ? strlen( home ) : 1 ) + 40 );
+				if ( base )
+					strcpy( directory, base );
+				else
+					sprintf( directory, "%s/.cache", home ? home : "." );
+				mkdir( directory, 0700 );
+				strcat( directory, "/mlt" );
+				mkdir( directory, 0700 );
+				strcat( directory, "/rendercache" );
+				mlt_properties_set( properties, "directory", directory );
+				mlt_properties_set( properties, "_standard", directory );
+				free( directory );
+			}
+			mlt_properties_set_int64( properties, "max_bytes", (int64_t) 4096 << 20 );
+#ifdef USE_ZLIB
+			mlt_properties_set_int( properties, "compress", 1 );
+#endif
+			pdata->writes = mlt_slices_group_init();
+		}
+		mlt_properties_set_int( properties, "video", 1 );
+		mlt_properties_set_int( properties, "audio", 1 );
+		pthread_mutex_init( &pdata->mutex, NULL );
+		pdata->used = -1;
+		filter->child = pdata;
+		filter->process = filter_process;
+		filter->close = filter_close;
+	}
+	else
+	{
+		mlt_filter_close( filter );
+		free( pdata );
+		filter = NULL;
+	}
+	return filter;
+}
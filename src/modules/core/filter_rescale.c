@@ -35,22 +35,40 @@
  * rgba -> rgba
  * rgb -> yuv422
  * rgba -> yuv422
+ *
+ * An implementation that also scales yuv420p -> yuv420p says so with the
+ * "_yuv420p" property of the filter; otherwise 4:2:0 is converted to yuv422
+ * before it is scaled. Likewise, "_yuv422p16" says that yuv422p16 is scaled
+ * without losing its depth.
  */
 
 typedef int ( *image_scaler )( mlt_frame frame, uint8_t **image, mlt_image_format *format, int iwidth, int iheight, int owidth, int oheight );
 
-static int filter_scale( mlt_frame frame, uint8_t **image, mlt_image_format *format, int iwidth, int iheight, int owidth, int oheight )
-{
-	// Create the output image
-	uint8_t *output = mlt_pool_alloc( owidth * ( oheight + 1 ) * 2 );
+/** virtual function declaration for an image scaler that reads its input through plane pointers and strides
+ *
+ * The input comes from mlt_frame_get_image_strided() in one of the formats
+ * above and may be a window inside a larger image. The scaler also scales the
+ * alpha channel in planes[3] if there is one. The local scaler has one; other
+ * implementations set it as the "strided_method" property next to "method".
+ */
 
-	// Calculate strides
-	int istride = iwidth * 2;
-	int ostride = owidth * 2;
+typedef int ( *image_scaler_strided )( mlt_frame frame, mlt_image input, uint8_t **image, mlt_image_format *format, int owidth, int oheight );
+
+/** Scale a yuv422 image with the nearest neighbour.
+ *
+ * The rows of the output are ostride bytes apart, so the image can be scaled
+ * straight into the middle of a padded one, and the rows of the input are
+ * istride bytes apart, so it can be read from a crop window in place. The
+ * source offsets of the samples are the same on every row, so they are worked
+ * out once up front.
+ */
+
+static void scale_yuv422( uint8_t *output, int ostride, uint8_t *input, int istride, int iwidth, int iheight, int owidth, int oheight )
+{
 	iwidth = iwidth - ( iwidth % 4 );
 
 	// Derived coordinates
-	int dy, dx;
+	int dy, dx, i;
 
 	// Calculate ranges
 	int out_x_range = owidth / 2;
@@ -58,50 +76,62 @@ static int filter_scale( mlt_frame frame, uint8_t **image, mlt_image_format *for
 	int in_x_range = iwidth / 2;
 	int in_y_range = iheight / 2;
 
-	// Output pointers
-	register uint8_t *out_line = output;
-	register uint8_t *out_ptr;
-
 	// Calculate a middle pointer
-	uint8_t *in_middle = *image + istride * in_y_range + in_x_range * 2;
+	uint8_t *in_middle = input + istride * in_y_range + in_x_range * 2;
 	uint8_t *in_line;
 
 	// Generate the affine transform scaling values
-	register int scale_width = ( iwidth << 16 ) / owidth;
-	register int scale_height = ( iheight << 16 ) / oheight;
-	register int base = 0;
+	int scale_width = ( iwidth << 16 ) / owidth;
+	int scale_height = ( iheight << 16 ) / oheight;
+	int base = 0;
 
 	int outer = out_x_range * scale_width;
 	int bottom = out_y_range * scale_height;
 
+	// Offsets from the middle of an input line for the bytes of an output line
+	int count = out_x_range * 4;
+	int *offsets = mlt_pool_alloc( count * sizeof( int ) );
+	if ( !offsets )
+		return;
+	for ( i = 0, dx = - outer; dx < outer && i < count; dx += scale_width )
+	{
+		base = dx >> 15;
+		base &= 0xfffffffe;
+		offsets[ i++ ] = base;
+		base &= 0xfffffffc;
+		offsets[ i++ ] = base + 1;
+		dx += scale_width;
+		base = dx >> 15;
+		base &= 0xfffffffe;
+		offsets[ i++ ] = base;
+		base &= 0xfffffffc;
+		offsets[ i++ ] = base + 3;
+	}
+	count = i;
+
 	// Loop for the entirety of our output height.
 	for ( dy = - bottom; dy < bottom; dy += scale_height )
 	{
-		// Start at the beginning of the line
-		out_ptr = out_line;
-
 		// Pointer to the middle of the input line
 		in_line = in_middle + ( dy >> 16 ) * istride;
 
 		// Loop for the entirety of our output row.
-		for ( dx = - outer; dx < outer; dx += scale_width )
-		{
-			base = dx >> 15;
-			base &= 0xfffffffe;
-			*out_ptr ++ = *( in_line + base );
-			base &= 0xfffffffc;
-			*out_ptr ++ = *( in_line + base + 1 );
-			dx += scale_width;
-			base = dx >> 15;
-			base &= 0xfffffffe;
-			*out_ptr ++ = *( in_line + base );
-			base &= 0xfffffffc;
-			*out_ptr ++ = *( in_line + base + 3 );
-		}
+		for ( i = 0; i < count; i++ )
+			output[ i ] = in_line[ offsets[ i ] ];
+
 		// Move to next output line
-		out_line += ostride;
+		output += ostride;
 	}
- 
+	mlt_pool_release( offsets );
+}
+
+static int filter_scale( mlt_frame frame, uint8_t **image, mlt_image_format *format, int iwidth, int iheight, int owidth, int oheight )
+{
+	// Create the output image
+	uint8_t *output = mlt_pool_alloc( owidth * ( oheight + 1 ) * 2 );
+
+	scale_yuv422( output, owidth * 2, *image, iwidth * 2, iwidth, iheight, owidth, oheight );
+
 	// Now update the frame
 	mlt_frame_set_image( frame, output, owidth * ( oheight + 1 ) * 2, mlt_pool_release );
 	*image = output;
@@ -109,33 +139,148 @@ static int filter_scale( mlt_frame frame, uint8_t **image, mlt_image_format *for
 	return 0;
 }
 
+/** Scale an alpha channel with the nearest neighbour from rows istride bytes apart into rows ostride bytes apart.
+*/
+
+static void scale_alpha_plane( uint8_t *output, int ostride, uint8_t *input, int istride, int iwidth, int iheight, int owidth, int oheight )
+{
+	uint8_t *out_line, *in_line;
+	register int i, j, x, y;
+	register int ox = ( iwidth << 16 ) / owidth;
+	register int oy = ( iheight << 16 ) / oheight;
+
+	// Loop for the entirety of our output height.
+	for ( i = 0, y = (oy >> 1); i < oheight; i++, y += oy )
+	{
+		out_line = output + i * ostride;
+		in_line = &input[ (y >> 16) * istride ];
+		for ( j = 0, x = (ox >> 1); j < owidth; j++, x += ox )
+			*out_line ++ = in_line[ x >> 16 ];
+	}
+}
+
 static void scale_alpha( mlt_frame frame, int iwidth, int iheight, int owidth, int oheight )
 {
 	// Scale the alpha
-	uint8_t *output = NULL;
 	uint8_t *input = mlt_frame_get_alpha( frame );
 
 	if ( input != NULL )
 	{
-		uint8_t *out_line, *in_line;
-		register int i, j, x, y;
-		register int ox = ( iwidth << 16 ) / owidth;
-		register int oy = ( iheight << 16 ) / oheight;
+		uint8_t *output = mlt_pool_alloc( owidth * oheight );
+		scale_alpha_plane( output, owidth, input, iwidth, iwidth, iheight, owidth, oheight );
+
+		// Set it back on the frame
+		mlt_frame_set_alpha( frame, output, owidth * oheight, mlt_pool_release );
+	}
+}
+
+static int filter_scale_strided( mlt_frame frame, mlt_image input, uint8_t **image, mlt_image_format *format, int owidth, int oheight )
+{
+	// Create the output image
+	uint8_t *output = mlt_pool_alloc( owidth * ( oheight + 1 ) * 2 );
+	uint8_t *alpha = NULL;
+
+	scale_yuv422( output, owidth * 2, input->planes[0], input->strides[0], input->width, input->height, owidth, oheight );
+	if ( input->planes[3] )
+	{
+		alpha = mlt_pool_alloc( owidth * oheight );
+		scale_alpha_plane( alpha, owidth, input->planes[3], input->strides[3], input->width, input->height, owidth, oheight );
+	}
+
+	// Now update the frame
+	mlt_frame_set_image( frame, output, owidth * ( oheight + 1 ) * 2, mlt_pool_release );
+	if ( alpha )
+		mlt_frame_set_alpha( frame, alpha, owidth * oheight, mlt_pool_release );
+	*image = output;
+
+	return 0;
+}
+
+static void fill_black( uint8_t *p, int count )
+{
+	while ( count-- > 0 )
+	{
+		*p++ = 16;
+		*p++ = 128;
+	}
+}
 
-		output = mlt_pool_alloc( owidth * oheight );
-		out_line = output;
+/** Scale a yuv422 image and its alpha straight into the padded size that filter_resize asked for.
+ *
+ * The image is centred with the same padding and alignment as filter_resize
+ * would give it, so that filter has nothing left to do. The input and its
+ * alpha in planes[3] are read through their strides.
+ * \return true if the image was scaled and padded
+ */
 
-   		// Loop for the entirety of our output height.
-		for ( i = 0, y = (oy >> 1); i < oheight; i++, y += oy )
+static int scale_and_pad( mlt_frame frame, uint8_t **image, mlt_image input, int alpha_size, int owidth, int oheight, int pwidth, int pheight )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
+	uint8_t *alpha = input->planes[3];
+	uint8_t alpha_value = mlt_properties_get_int( properties, "resize_alpha" );
+	int offset_x = ( ( pwidth - owidth ) / 2 ) & ~1;
+	int offset_y = ( pheight - oheight ) / 2;
+	int size = pwidth * ( pheight + 1 ) * 2;
+	// scale_yuv422() covers whole pairs of pixels and rows
+	int scaled_width = owidth & ~1;
+	int scaled_height = oheight & ~1;
+	uint8_t *output, *p;
+	int i;
+
+	// Leave anything filter_resize would not pad or an alpha it would not scale to the separate passes
+	if ( owidth > pwidth || oheight > pheight || ( owidth == pwidth && oheight == pheight )
+		 || owidth <= 6 || oheight <= 6 || pwidth <= 6 || pheight <= 6 )
+		return 0;
+	if ( alpha_size > 0 && ( !alpha || alpha_size == owidth * oheight || alpha_size == owidth * ( oheight + 1 ) ) )
+		return 0;
+
+	output = mlt_pool_alloc( size );
+	if ( !output )
+		return 0;
+
+	// Scale into the middle and fill only the borders with black
+	scale_yuv422( output + ( offset_y * pwidth + offset_x ) * 2, pwidth * 2, input->planes[0], input->strides[0],
+		input->width, input->height, owidth, oheight );
+	for ( i = 0; i < pheight; i++ )
+	{
+		p = output + i * pwidth * 2;
+		if ( i < offset_y || i >= offset_y + scaled_height )
+		{
+			fill_black( p, pwidth );
+		}
+		else
 		{
-			in_line = &input[ (y >> 16) * iwidth ];
-			for ( j = 0, x = (ox >> 1); j < owidth; j++, x += ox )
-				*out_line ++ = in_line[ x >> 16 ];
+			fill_black( p, offset_x );
+			fill_black( p + ( offset_x + scaled_width ) * 2, pwidth - offset_x - scaled_width );
 		}
+	}
+	mlt_frame_set_image( frame, output, size, mlt_pool_release );
+	*image = output;
 
-		// Set it back on the frame
-		mlt_frame_set_alpha( frame, output, owidth * oheight, mlt_pool_release );
+	if ( alpha )
+	{
+		uint8_t *alpha_output = mlt_pool_alloc( pwidth * pheight );
+		if ( alpha_output )
+		{
+			scale_alpha_plane( alpha_output + offset_y * pwidth + offset_x, pwidth, alpha, input->strides[3],
+				input->width, input->height, owidth, oheight );
+			for ( i = 0; i < pheight; i++ )
+			{
+				p = alpha_output + i * pwidth;
+				if ( i < offset_y || i >= offset_y + oheight )
+				{
+					memset( p, alpha_value, pwidth );
+				}
+				else
+				{
+					memset( p, alpha_value, offset_x );
+					memset( p + offset_x + owidth, alpha_value, pwidth - offset_x - owidth );
+				}
+			}
+		}
+		mlt_frame_set_alpha( frame, alpha_output, pwidth * pheight, mlt_pool_release );
 	}
+	return 1;
 }
 
 /** Do it :-).
@@ -156,6 +301,8 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 
 	// Get the image scaler method
 	image_scaler scaler_method = mlt_properties_get_data( filter_properties, "method", NULL );
+	image_scaler_strided strided_method = scaler_method == filter_scale ? filter_scale_strided
+		: mlt_properties_get_data( filter_properties, "strided_method", NULL );
 
 	// Correct Width/height if necessary
 	if ( *width == 0 || *height == 0 )
@@ -213,12 +360,73 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		if ( iheight != oheight && ( strcmp( interps, "nearest" ) || ( iheight % oheight != 0 ) ) )
 			mlt_properties_set_int( properties, "consumer_deinterlace", 1 );
 
-		// Convert the image to yuv422 when using the local scaler
-		if ( scaler_method == filter_scale )
+		// Convert the image to yuv422 when using the local scaler, unless 4:2:0 was
+		// asked for and the image is not going to be scaled
+		if ( scaler_method == filter_scale && ( *format != mlt_image_yuv420p
+			 || ( strcmp( interps, "none" ) && ( iwidth != owidth || iheight != oheight ) ) ) )
+			*format = mlt_image_yuv422;
+
+		// A hardware surface must be downloaded to be scaled
+		if ( *format == mlt_image_hwframe && strcmp( interps, "none" ) && ( iwidth != owidth || iheight != oheight ) )
 			*format = mlt_image_yuv422;
 
-		// Get the image as requested
-		mlt_frame_get_image( frame, image, format, &iwidth, &iheight, writable );
+		// The size filter_resize will pad the image to, which is only for this scaler
+		int pad_width = mlt_properties_get_int( properties, "_resize.pad_width" );
+		int pad_height = mlt_properties_get_int( properties, "_resize.pad_height" );
+		mlt_properties_clear( properties, "_resize.pad_width" );
+		mlt_properties_clear( properties, "_resize.pad_height" );
+
+		// Scaling keeps the region of interest, widened by the reach of the interpolation
+		mlt_rect roi;
+		if ( pad_width <= 0 && mlt_frame_get_roi( frame, &roi ) )
+		{
+			double margin_x = 4.0 / MAX( MIN( iwidth, owidth ), 1 );
+			double margin_y = 4.0 / MAX( MIN( iheight, oheight ), 1 );
+			roi.x -= margin_x;
+			roi.y -= margin_y;
+			roi.w += 2 * margin_x;
+			roi.h += 2 * margin_y;
+			mlt_frame_set_roi( frame, roi );
+		}
+
+		// Get the image as requested, reading a crop window in place when it is scaled
+		struct mlt_image_s input;
+		int strided = 0;
+		if ( strided_method )
+		{
+			mlt_image_set_values( &input, NULL, *format, iwidth, iheight );
+			mlt_frame_get_image_strided( frame, &input );
+			interps = mlt_properties_get( properties, "rescale.interp" );
+			strided = input.data && strcmp( interps, "none" ) && ( input.width != owidth || input.height != oheight )
+				&& ( input.format == mlt_image_yuv422 || input.format == mlt_image_rgb || input.format == mlt_image_rgba );
+
+			// Any crop is copied here when the window is not read in place
+			if ( !strided )
+				mlt_frame_pack_image( frame, &input, writable );
+			*image = input.data;
+			*format = input.format;
+			iwidth = input.width;
+			iheight = input.height;
+		}
+		else
+		{
+			// Any crop is copied here
+			mlt_frame_get_image( frame, image, format, &iwidth, &iheight, writable );
+			int alpha_size = 0;
+			uint8_t *alpha = mlt_properties_get_data( properties, "alpha", &alpha_size );
+			mlt_image_set_values( &input, *image, *format, iwidth, iheight );
+			if ( alpha && alpha_size >= iwidth * iheight )
+			{
+				input.planes[3] = alpha;
+				input.strides[3] = iwidth;
+			}
+		}
+
+		// The size of the alpha channel as the scalers see it
+		int alpha_size = 0;
+		mlt_properties_get_data( properties, "alpha", &alpha_size );
+		if ( strided && input.planes[3] )
+			alpha_size = iwidth * iheight;
 
 		// Get rescale interpretation again, in case the producer wishes to override scaling
 		interps = mlt_properties_get( properties, "rescale.interp" );
@@ -228,30 +436,95 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 			mlt_log_debug( MLT_FILTER_SERVICE( filter ), "%dx%d -> %dx%d (%s) %s\n",
 				iwidth, iheight, owidth, oheight, mlt_image_format_name( *format ), interps );
 
-			// If valid colorspace
-			if ( *format == mlt_image_yuv422 || *format == mlt_image_rgb ||
-			     *format == mlt_image_rgba )
+			int scales_yuv420p = mlt_properties_get_int( filter_properties, "_yuv420p" )
+				&& !( ( iwidth | iheight | owidth | oheight ) & 1 );
+			int scales_yuv422p16 = mlt_properties_get_int( filter_properties, "_yuv422p16" )
+				&& !( ( iwidth | owidth ) & 1 );
+			if ( ( ( *format == mlt_image_yuv420p && !scales_yuv420p ) || ( *format == mlt_image_yuv422p16 && !scales_yuv422p16 ) )
+				 && frame->convert_image )
+			{
+				uint8_t *alpha = input.planes[3];
+				frame->convert_image( frame, image, format, mlt_image_yuv422 );
+				mlt_image_set_values( &input, *image, *format, iwidth, iheight );
+				input.planes[3] = alpha;
+				input.strides[3] = iwidth;
+			}
+
+			// Scale and pad in one pass when the local scaler can
+			if ( scaler_method == filter_scale && *format == mlt_image_yuv422 && pad_width > 0 && pad_height > 0
+				 && scale_and_pad( frame, image, &input, alpha_size, owidth, oheight, pad_width, pad_height ) )
 			{
-				// Call the virtual function
-				scaler_method( frame, image, format, iwidth, iheight, owidth, oheight );
-				*width = owidth;
-				*height = oheight;
+				*width = pad_width;
+				*height = pad_height;
 			}
 			else
 			{
-				*width = iwidth;
-				*height = iheight;
+				// If valid colorspace
+				if ( *format == mlt_image_yuv422 || *format == mlt_image_rgb ||
+				     *format == mlt_image_rgba || ( *format == mlt_image_yuv420p && scales_yuv420p ) ||
+				     ( *format == mlt_image_yuv422p16 && scales_yuv422p16 ) )
+				{
+					mlt_rect bounds;
+					int opaque;
+					int has_bounds = mlt_frame_get_alpha_bounds( frame, &bounds, &opaque );
+
+					// Call the virtual function, or copy the crop if the strided one fails
+					if ( strided && strided_method( frame, &input, image, format, owidth, oheight ) )
+					{
+						strided = 0;
+						mlt_frame_pack_image( frame, &input, writable );
+						*image = input.data;
+						*format = input.format;
+						iwidth = input.width;
+						iheight = input.height;
+					}
+					if ( !strided )
+						scaler_method( frame, image, format, iwidth, iheight, owidth, oheight );
+					*width = owidth;
+					*height = oheight;
+
+					// Scale the alpha bounds, widened by the reach of the interpolation
+					if ( has_bounds && bounds.w > 0 && bounds.h > 0 )
+					{
+						double scale_x = (double) owidth / iwidth;
+						double scale_y = (double) oheight / iheight;
+						int margin_x = ceil( 3 * MAX( scale_x, 1.0 ) ) + 1;
+						int margin_y = ceil( 3 * MAX( scale_y, 1.0 ) ) + 1;
+						int x0 = MAX( floor( bounds.x * scale_x ) - margin_x, 0 );
+						int y0 = MAX( floor( bounds.y * scale_y ) - margin_y, 0 );
+						int x1 = MIN( ceil( ( bounds.x + bounds.w ) * scale_x ) + margin_x, owidth );
+						int y1 = MIN( ceil( ( bounds.y + bounds.h ) * scale_y ) + margin_y, oheight );
+						bounds = (mlt_rect) { x0, y0, MAX( x1 - x0, 0 ), MAX( y1 - y0, 0 ), 1.0 };
+					}
+					if ( has_bounds )
+						mlt_frame_set_alpha_bounds( frame, bounds, opaque );
+				}
+				else
+				{
+					*width = iwidth;
+					*height = iheight;
+					mlt_rect bounds;
+					int opaque;
+					mlt_frame_get_alpha_bounds( frame, &bounds, &opaque );
+				}
+				// Scale the alpha channel only if exists and not correct size
+				if ( strided && input.planes[3] )
+					alpha_size = 0;
+				else
+					mlt_properties_get_data( properties, "alpha", &alpha_size );
+				if ( alpha_size > 0 && alpha_size != ( owidth * oheight ) && alpha_size != ( owidth * ( oheight + 1 ) ) )
+					scale_alpha( frame, iwidth, iheight, owidth, oheight );
 			}
-			// Scale the alpha channel only if exists and not correct size
-			int alpha_size = 0;
-			mlt_properties_get_data( properties, "alpha", &alpha_size );
-			if ( alpha_size > 0 && alpha_size != ( owidth * oheight ) && alpha_size != ( owidth * ( oheight + 1 ) ) )
-				scale_alpha( frame, iwidth, iheight, owidth, oheight );
 		}
 		else
 		{
 			*width = iwidth;
 			*height = iheight;
+
+			// Nothing was scaled, so the alpha bounds still hold
+			mlt_rect bounds;
+			int opaque;
+			mlt_frame_get_alpha_bounds( frame, &bounds, &opaque );
 		}
 	}
 	else
@@ -26,7 +26,7 @@
 #include <stdlib.h>
 #include <math.h>
 
-static uint8_t *resize_alpha( uint8_t *input, int owidth, int oheight, int iwidth, int iheight, uint8_t alpha_value )
+static uint8_t *resize_alpha( uint8_t *input, int owidth, int oheight, int iwidth, int iheight, uint8_t alpha_value, mlt_image_format format )
 {
 	uint8_t *output = NULL;
 
@@ -37,6 +37,10 @@ static uint8_t *resize_alpha( uint8_t *input, int owidth, int oheight, int iwidt
 		int offset_y = ( oheight - iheight ) / 2;
 		int iused = iwidth;
 
+		// Follow the whole chroma rows of the image
+		if ( format == mlt_image_yuv420p )
+			offset_y &= ~1;
+
 		output = mlt_pool_alloc( owidth * oheight );
 		memset( output, alpha_value, owidth * oheight );
 
@@ -126,6 +130,67 @@ static void resize_image( uint8_t *output, int owidth, int oheight, uint8_t *inp
 	}
 }
 
+/** Fill samples of 8 or 16 bits with a value.
+*/
+
+static void fill_samples( uint8_t *p, int value, int count, int depth )
+{
+	if ( depth == 1 )
+	{
+		memset( p, value, count );
+	}
+	else
+	{
+		uint16_t *q = (uint16_t*) p;
+		while ( count-- )
+			*q++ = value;
+	}
+}
+
+/** Centre a yuv420p or yuv422p16 image in a bigger one with black borders, plane by plane.
+*/
+
+static void resize_image_planar( uint8_t *output, int owidth, int oheight, uint8_t *input, int iwidth, int iheight, mlt_image_format format )
+{
+	uint8_t *in_planes[4], *out_planes[4];
+	int in_strides[4], out_strides[4];
+	int depth = format == mlt_image_yuv422p16 ? 2 : 1;
+	int shift_y = format == mlt_image_yuv420p;
+	int offset_x = ( ( owidth - iwidth ) / 2 ) & ~1;
+	int offset_y = ( ( oheight - iheight ) / 2 ) & ~shift_y;
+	int plane, line;
+
+	if ( output == NULL || input == NULL || ( owidth <= 6 || oheight <= 6 || iwidth <= 6 || iheight <= 6 ) )
+		return;
+
+	mlt_image_format_planes( format, iwidth, iheight, input, in_planes, in_strides );
+	mlt_image_format_planes( format, owidth, oheight, output, out_planes, out_strides );
+	for ( plane = 0; plane < 3; plane++ )
+	{
+		int shift = plane > 0;
+		int value = ( plane > 0 ? 128 : 16 ) << ( 8 * ( depth - 1 ) );
+		int x = offset_x >> shift;
+		int y = offset_y >> ( shift & shift_y );
+		int width = iwidth >> shift;
+		int height = iheight >> ( shift & shift_y );
+		int samples = out_strides[plane] / depth;
+		for ( line = 0; line < oheight >> ( shift & shift_y ); line++ )
+		{
+			uint8_t *p = out_planes[plane] + line * out_strides[plane];
+			if ( line < y || line >= y + height )
+			{
+				fill_samples( p, value, samples, depth );
+			}
+			else
+			{
+				fill_samples( p, value, x, depth );
+				memcpy( p + x * depth, in_planes[plane] + ( line - y ) * in_strides[plane], width * depth );
+				fill_samples( p + ( x + width ) * depth, value, samples - x - width, depth );
+			}
+		}
+	}
+}
+
 /** A padding function for frames - this does not rescale, but simply
 	resizes.
 */
@@ -150,19 +215,32 @@ static uint8_t *frame_resize_image( mlt_frame frame, int owidth, int oheight, ml
 	if ( iwidth < owidth || iheight < oheight )
 	{
 		uint8_t alpha_value = mlt_properties_get_int( properties, "resize_alpha" );
-		// Create the output image
-		uint8_t *output = mlt_pool_alloc( owidth * ( oheight + 1 ) * bpp );
+		uint8_t *output;
+		int size;
 
-		// Call the generic resize
-		resize_image( output, owidth, oheight, input, iwidth, iheight, bpp, format, alpha_value );
+		if ( format == mlt_image_yuv420p || format == mlt_image_yuv422p16 )
+		{
+			size = mlt_image_format_size( format, owidth, oheight, NULL );
+			output = mlt_pool_alloc( size );
+			resize_image_planar( output, owidth, oheight, input, iwidth, iheight, format );
+		}
+		else
+		{
+			// Create the output image
+			size = owidth * ( oheight + 1 ) * bpp;
+			output = mlt_pool_alloc( size );
+
+			// Call the generic resize
+			resize_image( output, owidth, oheight, input, iwidth, iheight, bpp, format, alpha_value );
+		}
 
 		// Now update the frame
-		mlt_frame_set_image( frame, output, owidth * ( oheight + 1 ) * bpp, mlt_pool_release );
+		mlt_frame_set_image( frame, output, size, mlt_pool_release );
 
 		// We should resize the alpha too
 		if ( format != mlt_image_rgba && alpha && alpha_size >= iwidth * iheight )
 		{
-			alpha = resize_alpha( alpha, owidth, oheight, iwidth, iheight, alpha_value );
+			alpha = resize_alpha( alpha, owidth, oheight, iwidth, iheight, alpha_value, format );
 			if ( alpha )
 				mlt_frame_set_alpha( frame, alpha, owidth * oheight, mlt_pool_release );
 		}
@@ -264,8 +342,8 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	mlt_properties_set_int( properties, "resize_width", *width );
 	mlt_properties_set_int( properties, "resize_height", *height );
 
-	// If there will be padding, then we need packed image format.
-	if ( *format == mlt_image_yuv420p )
+	// If there will be padding, then a hardware surface must be downloaded
+	if ( *format == mlt_image_hwframe )
 	{
 		int iwidth = mlt_properties_get_int( properties, "width" );
 		int iheight = mlt_properties_get_int( properties, "height" );
@@ -274,13 +352,24 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	}
 
 	// Now get the image
-	if ( *format == mlt_image_yuv422 ) {
+	if ( *format == mlt_image_yuv422 || *format == mlt_image_yuv422p16 ) {
+		owidth -= owidth % 2;
+		*width -= *width % 2;
+	}
+	else if ( *format == mlt_image_yuv420p ) {
 		owidth -= owidth % 2;
+		oheight -= oheight % 2;
 		*width -= *width % 2;
+		*height -= *height % 2;
 	}
+	// Let the local scaler of filter_rescale pad the image while it scales it
+	mlt_properties_set_int( properties, "_resize.pad_width", *width );
+	mlt_properties_set_int( properties, "_resize.pad_height", *height );
 	error = mlt_frame_get_image( frame, image, format, &owidth, &oheight, writable );
+	mlt_properties_clear( properties, "_resize.pad_width" );
+	mlt_properties_clear( properties, "_resize.pad_height" );
 
-	if ( error == 0 && *image && *format != mlt_image_yuv420p )
+	if ( error == 0 && *image )
 	{
 		*image = frame_resize_image( frame, *width, *height, *format );
 	}
@@ -22,11 +22,138 @@
 #include <framework/mlt_frame.h>
 #include <framework/mlt_producer.h>
 #include <framework/mlt_transition.h>
+#include <framework/mlt_pool.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/** The number of sizes of the overlay that are kept when caching */
+
+#define MAX_WATERMARK_IMAGES 4
+
+/** Get the overlay image from the cache, or render it once and keep it.
+ *
+ * This sits on top of the image stack of the b frame, so it sees the size that
+ * composite has chosen for the current geometry.
+*/
+
+static int cached_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
+{
+	mlt_filter filter = mlt_frame_pop_service( frame );
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	mlt_properties frame_properties = MLT_FRAME_PROPERTIES( frame );
+	const char *interp = mlt_properties_get( frame_properties, "rescale.interp" );
+	char key[ 128 ];
+	int error = 0;
+
+	snprintf( key, sizeof( key ), "%d.%dx%d.%d.%d.%d.%s", *format, *width, *height,
+		mlt_properties_get_int( frame_properties, "distort" ),
+		mlt_properties_get_int( frame_properties, "resize_alpha" ),
+		mlt_properties_get_int( frame_properties, "consumer_deinterlace" ),
+		interp ? interp : "" );
+
+	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
+
+	mlt_properties cache = mlt_properties_get_data( properties, "_cache", NULL );
+	if ( !cache || ( !mlt_properties_get_data( cache, key, NULL ) && mlt_properties_count( cache ) >= MAX_WATERMARK_IMAGES ) )
+	{
+		cache = mlt_properties_new( );
+		mlt_properties_set_data( properties, "_cache", cache, 0, ( mlt_destructor )mlt_properties_close, NULL );
+	}
+
+	mlt_frame cached = mlt_properties_get_data( cache, key, NULL );
+	int size = 0;
+	uint8_t *shared = NULL;
+
+	if ( cached )
+	{
+		mlt_properties cached_properties = MLT_FRAME_PROPERTIES( cached );
+		*format = mlt_properties_get_int( cached_properties, "format" );
+		*width = mlt_properties_get_int( cached_properties, "width" );
+		*height = mlt_properties_get_int( cached_properties, "height" );
+		shared = mlt_frame_share_image( cached, &size );
+		error = shared == NULL;
+	}
+	else
+	{
+		error = mlt_frame_get_image( frame, image, format, width, height, 0 );
+		if ( !error && *image && ( shared = mlt_frame_share_image( frame, &size ) ) )
+		{
+			// Keep the image in a frame of its own so that nothing else of the b frame is held
+			uint8_t *alpha = mlt_frame_get_alpha( frame );
+			cached = mlt_frame_init( NULL );
+			mlt_frame_set_image( cached, shared, size, mlt_image_buffer_release );
+			if ( alpha )
+			{
+				uint8_t *alpha_copy = mlt_pool_alloc( *width * *height );
+				if ( alpha_copy )
+				{
+					memcpy( alpha_copy, alpha, *width * *height );
+					mlt_frame_set_alpha( cached, alpha_copy, *width * *height, mlt_pool_release );
+				}
+			}
+			mlt_properties_set_int( MLT_FRAME_PROPERTIES( cached ), "format", *format );
+			mlt_properties_set_int( MLT_FRAME_PROPERTIES( cached ), "width", *width );
+			mlt_properties_set_int( MLT_FRAME_PROPERTIES( cached ), "height", *height );
+			mlt_properties_set_data( cache, key, cached, 0, ( mlt_destructor )mlt_frame_close, NULL );
+
+			// Sharing replaced the image of the b frame, so return that one
+			*image = mlt_properties_get_data( frame_properties, "image", NULL );
+		}
+		mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+		return error;
+	}
+
+	// Share the cached image, which is copied only if it must be written
+	uint8_t *alpha = error ? NULL : mlt_frame_get_alpha( cached );
+	uint8_t *alpha_copy = NULL;
+	if ( alpha && ( alpha_copy = mlt_pool_alloc( *width * *height ) ) )
+		memcpy( alpha_copy, alpha, *width * *height );
+	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+
+	if ( !error )
+	{
+		mlt_frame_set_image( frame, shared, size, mlt_image_buffer_release );
+		*image = shared;
+	}
+	if ( alpha_copy )
+		mlt_frame_set_alpha( frame, alpha_copy, *width * *height, mlt_pool_release );
+	return error;
+}
+
+/** Check that the cached overlay images were made with the current producer.* properties.
+*/
+
+static int cache_is_current( mlt_properties properties )
+{
+	mlt_properties current = mlt_properties_new( );
+	mlt_properties cached = mlt_properties_get_data( properties, "_cache_producer", NULL );
+	int result = cached != NULL;
+	int i;
+
+	mlt_properties_pass( current, properties, "producer." );
+	if ( result && mlt_properties_count( current ) == mlt_properties_count( cached ) )
+	{
+		for ( i = 0; result && i < mlt_properties_count( current ); i ++ )
+		{
+			const char *value = mlt_properties_get_value( current, i );
+			const char *old = mlt_properties_get( cached, mlt_properties_get_name( current, i ) );
+			result = value && old ? !strcmp( value, old ) : value == old;
+		}
+	}
+	else
+	{
+		result = 0;
+	}
+
+	if ( result )
+		mlt_properties_close( current );
+	else
+		mlt_properties_set_data( properties, "_cache_producer", current, 0, ( mlt_destructor )mlt_properties_close, NULL );
+	return result;
+}
+
 /** Do it :-).
 */
 
@@ -104,6 +231,9 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 
 			// Set the old resource
 			mlt_properties_set( properties, "_old_resource", resource );
+
+			// Images of the previous producer are of no use
+			mlt_properties_set_data( properties, "_cache", NULL, 0, NULL, NULL );
 		}
 	}
 
@@ -114,6 +244,9 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 
 		// Now pass all producer. properties on the filter down
 		mlt_properties_pass( producer_properties, properties, "producer." );
+
+		if ( mlt_properties_get_int( properties, "cache" ) && !cache_is_current( properties ) )
+			mlt_properties_set_data( properties, "_cache", NULL, 0, NULL, NULL );
 	}
 
 	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
@@ -174,6 +307,13 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 				// Apply all filters that are attached to this filter to the b frame
 				mlt_service_apply_filters( MLT_FILTER_SERVICE( filter ), b_frame, 0 );
 
+				// Render a still overlay only once for each size that composite asks for
+				if ( mlt_properties_get_int( properties, "cache" ) )
+				{
+					mlt_frame_push_service( b_frame, filter );
+					mlt_frame_push_get_image( b_frame, cached_get_image );
+				}
+
 				// Process the frame
 				mlt_transition_process( composite, a_frame, b_frame );
 
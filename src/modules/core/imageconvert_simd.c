@@ -0,0 +1,485 @@
+/*
+ * imageconvert_simd.c -- vectorised lines for filter_imageconvert
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "imageconvert_simd.h"
+
+#include <framework/mlt_cpu.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// All of these use the integer coefficients of YUV2RGB_601_SCALED and RGB2YUV_601_SCALED
+// in 32-bit intermediates, so the results match the scalar code exactly.
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define USE_AVX2 1
+#include <immintrin.h>
+#endif
+
+/** A madd operand holding the 16-bit pair (a, b) in every 32-bit lane. */
+#define PAIR( a, b ) ( (int32_t) ( ( (uint32_t) (uint16_t) (b) << 16 ) | (uint16_t) (a) ) )
+
+static inline void yuv_to_rgba_8_sse2( __m128i y, __m128i u, __m128i v, __m128i a, uint8_t *dst )
+{
+	const __m128i zero = _mm_setzero_si128();
+	y = _mm_sub_epi16( y, _mm_set1_epi16( 16 ) );
+	u = _mm_sub_epi16( u, _mm_set1_epi16( 128 ) );
+	v = _mm_sub_epi16( v, _mm_set1_epi16( 128 ) );
+
+	__m128i yv_lo = _mm_unpacklo_epi16( y, v );
+	__m128i yv_hi = _mm_unpackhi_epi16( y, v );
+	__m128i yu_lo = _mm_unpacklo_epi16( y, u );
+	__m128i yu_hi = _mm_unpackhi_epi16( y, u );
+	__m128i u_lo = _mm_unpacklo_epi16( u, zero );
+	__m128i u_hi = _mm_unpackhi_epi16( u, zero );
+
+	__m128i r_lo = _mm_madd_epi16( yv_lo, _mm_set1_epi32( PAIR( 1192, 1634 ) ) );
+	__m128i r_hi = _mm_madd_epi16( yv_hi, _mm_set1_epi32( PAIR( 1192, 1634 ) ) );
+	__m128i g_lo = _mm_add_epi32( _mm_madd_epi16( yv_lo, _mm_set1_epi32( PAIR( 1192, -832 ) ) ),
+		_mm_madd_epi16( u_lo, _mm_set1_epi32( PAIR( -401, 0 ) ) ) );
+	__m128i g_hi = _mm_add_epi32( _mm_madd_epi16( yv_hi, _mm_set1_epi32( PAIR( 1192, -832 ) ) ),
+		_mm_madd_epi16( u_hi, _mm_set1_epi32( PAIR( -401, 0 ) ) ) );
+	__m128i b_lo = _mm_madd_epi16( yu_lo, _mm_set1_epi32( PAIR( 1192, 2066 ) ) );
+	__m128i b_hi = _mm_madd_epi16( yu_hi, _mm_set1_epi32( PAIR( 1192, 2066 ) ) );
+
+	__m128i r = _mm_packs_epi32( _mm_srai_epi32( r_lo, 10 ), _mm_srai_epi32( r_hi, 10 ) );
+	__m128i g = _mm_packs_epi32( _mm_srai_epi32( g_lo, 10 ), _mm_srai_epi32( g_hi, 10 ) );
+	__m128i b = _mm_packs_epi32( _mm_srai_epi32( b_lo, 10 ), _mm_srai_epi32( b_hi, 10 ) );
+	r = _mm_packus_epi16( r, r );
+	g = _mm_packus_epi16( g, g );
+	b = _mm_packus_epi16( b, b );
+
+	__m128i rg = _mm_unpacklo_epi8( r, g );
+	__m128i ba = _mm_unpacklo_epi8( b, a );
+	_mm_storeu_si128( (__m128i*) dst, _mm_unpacklo_epi16( rg, ba ) );
+	_mm_storeu_si128( (__m128i*) ( dst + 16 ), _mm_unpackhi_epi16( rg, ba ) );
+}
+
+static int yuv422_to_rgba_sse2( const uint8_t *src, const uint8_t *alpha, uint8_t *dst, int width )
+{
+	const __m128i mask = _mm_set1_epi16( 0xff );
+	int n = 0;
+
+	for ( ; n + 8 <= width; n += 8 )
+	{
+		__m128i p = _mm_loadu_si128( (const __m128i*) ( src + n * 2 ) );
+		__m128i y = _mm_and_si128( p, mask );
+		__m128i uv = _mm_srli_epi16( p, 8 );
+		__m128i u = _mm_shufflehi_epi16( _mm_shufflelo_epi16( uv, _MM_SHUFFLE( 2, 2, 0, 0 ) ), _MM_SHUFFLE( 2, 2, 0, 0 ) );
+		__m128i v = _mm_shufflehi_epi16( _mm_shufflelo_epi16( uv, _MM_SHUFFLE( 3, 3, 1, 1 ) ), _MM_SHUFFLE( 3, 3, 1, 1 ) );
+		__m128i a = alpha ? _mm_loadl_epi64( (const __m128i*) ( alpha + n ) ) : _mm_set1_epi8( (char) 0xff );
+		yuv_to_rgba_8_sse2( y, u, v, a, dst + n * 4 );
+	}
+	return n;
+}
+
+static int yuv420p_to_rgba_sse2( const uint8_t *y, const uint8_t *u, const uint8_t *v, const uint8_t *alpha, uint8_t *dst, int width )
+{
+	const __m128i zero = _mm_setzero_si128();
+	int n = 0;
+
+	for ( ; n + 8 <= width; n += 8 )
+	{
+		int32_t u4, v4;
+		memcpy( &u4, u + n / 2, 4 );
+		memcpy( &v4, v + n / 2, 4 );
+		__m128i yy = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*) ( y + n ) ), zero );
+		__m128i uu = _mm_unpacklo_epi8( _mm_cvtsi32_si128( u4 ), zero );
+		__m128i vv = _mm_unpacklo_epi8( _mm_cvtsi32_si128( v4 ), zero );
+		__m128i a = alpha ? _mm_loadl_epi64( (const __m128i*) ( alpha + n ) ) : _mm_set1_epi8( (char) 0xff );
+		yuv_to_rgba_8_sse2( yy, _mm_unpacklo_epi16( uu, uu ), _mm_unpacklo_epi16( vv, vv ), a, dst + n * 4 );
+	}
+	return n;
+}
+
+static int rgba_to_yuv422_sse2( const uint8_t *src, uint8_t *dst, uint8_t *alpha, int width )
+{
+	const __m128i mask = _mm_set1_epi16( 0xff );
+	const __m128i mask32 = _mm_set1_epi32( 0xffff );
+	int n = 0;
+
+	for ( ; n + 8 <= width; n += 8 )
+	{
+		__m128i p0 = _mm_loadu_si128( (const __m128i*) ( src + n * 4 ) );
+		__m128i p1 = _mm_loadu_si128( (const __m128i*) ( src + n * 4 + 16 ) );
+		// Each 32-bit lane holds (r, b) and (g, a) of one pixel
+		__m128i rb0 = _mm_and_si128( p0, mask );
+		__m128i rb1 = _mm_and_si128( p1, mask );
+		__m128i ga0 = _mm_srli_epi16( p0, 8 );
+		__m128i ga1 = _mm_srli_epi16( p1, 8 );
+
+		__m128i y0 = _mm_add_epi32( _mm_madd_epi16( rb0, _mm_set1_epi32( PAIR( 263, 100 ) ) ),
+			_mm_madd_epi16( ga0, _mm_set1_epi32( PAIR( 516, 0 ) ) ) );
+		__m128i y1 = _mm_add_epi32( _mm_madd_epi16( rb1, _mm_set1_epi32( PAIR( 263, 100 ) ) ),
+			_mm_madd_epi16( ga1, _mm_set1_epi32( PAIR( 516, 0 ) ) ) );
+		__m128i u0 = _mm_add_epi32( _mm_madd_epi16( rb0, _mm_set1_epi32( PAIR( -152, 450 ) ) ),
+			_mm_madd_epi16( ga0, _mm_set1_epi32( PAIR( -300, 0 ) ) ) );
+		__m128i u1 = _mm_add_epi32( _mm_madd_epi16( rb1, _mm_set1_epi32( PAIR( -152, 450 ) ) ),
+			_mm_madd_epi16( ga1, _mm_set1_epi32( PAIR( -300, 0 ) ) ) );
+		__m128i v0 = _mm_add_epi32( _mm_madd_epi16( rb0, _mm_set1_epi32( PAIR( 450, -73 ) ) ),
+			_mm_madd_epi16( ga0, _mm_set1_epi32( PAIR( -377, 0 ) ) ) );
+		__m128i v1 = _mm_add_epi32( _mm_madd_epi16( rb1, _mm_set1_epi32( PAIR( 450, -73 ) ) ),
+			_mm_madd_epi16( ga1, _mm_set1_epi32( PAIR( -377, 0 ) ) ) );
+
+		__m128i y = _mm_add_epi16( _mm_packs_epi32( _mm_srai_epi32( y0, 10 ), _mm_srai_epi32( y1, 10 ) ), _mm_set1_epi16( 16 ) );
+		__m128i u = _mm_add_epi16( _mm_packs_epi32( _mm_srai_epi32( u0, 10 ), _mm_srai_epi32( u1, 10 ) ), _mm_set1_epi16( 128 ) );
+		__m128i v = _mm_add_epi16( _mm_packs_epi32( _mm_srai_epi32( v0, 10 ), _mm_srai_epi32( v1, 10 ) ), _mm_set1_epi16( 128 ) );
+
+		// Average the chroma of each pair of pixels
+		u = _mm_srli_epi32( _mm_add_epi32( _mm_and_si128( u, mask32 ), _mm_srli_epi32( u, 16 ) ), 1 );
+		v = _mm_srli_epi32( _mm_add_epi32( _mm_and_si128( v, mask32 ), _mm_srli_epi32( v, 16 ) ), 1 );
+		__m128i c = _mm_or_si128( u, _mm_slli_epi32( v, 16 ) );
+		_mm_storeu_si128( (__m128i*) ( dst + n * 2 ), _mm_or_si128( y, _mm_slli_epi16( c, 8 ) ) );
+
+		__m128i a = _mm_packs_epi32( _mm_srli_epi32( ga0, 16 ), _mm_srli_epi32( ga1, 16 ) );
+		_mm_storel_epi64( (__m128i*) ( alpha + n ), _mm_packus_epi16( a, a ) );
+	}
+	return n;
+}
+
+static int yuv420p_to_yuv422_sse2( const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width )
+{
+	int n = 0;
+
+	for ( ; n + 16 <= width; n += 16 )
+	{
+		__m128i yy = _mm_loadu_si128( (const __m128i*) ( y + n ) );
+		__m128i uv = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*) ( u + n / 2 ) ),
+			_mm_loadl_epi64( (const __m128i*) ( v + n / 2 ) ) );
+		_mm_storeu_si128( (__m128i*) ( dst + n * 2 ), _mm_unpacklo_epi8( yy, uv ) );
+		_mm_storeu_si128( (__m128i*) ( dst + n * 2 + 16 ), _mm_unpackhi_epi8( yy, uv ) );
+	}
+	return n;
+}
+
+#if USE_AVX2
+
+// The 256-bit unpack and pack instructions work within 128-bit lanes, so these
+// process pixels in a lane order and fix it up with a permute before storing.
+
+__attribute__((target("avx2")))
+static int yuv422_to_rgba_avx2( const uint8_t *src, const uint8_t *alpha, uint8_t *dst, int width )
+{
+	const __m256i mask = _mm256_set1_epi16( 0xff );
+	const __m256i zero = _mm256_setzero_si256();
+	int n = 0;
+
+	for ( ; n + 16 <= width; n += 16 )
+	{
+		__m256i p = _mm256_loadu_si256( (const __m256i*) ( src + n * 2 ) );
+		__m256i y = _mm256_sub_epi16( _mm256_and_si256( p, mask ), _mm256_set1_epi16( 16 ) );
+		__m256i uv = _mm256_sub_epi16( _mm256_srli_epi16( p, 8 ), _mm256_set1_epi16( 128 ) );
+		__m256i u = _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( uv, _MM_SHUFFLE( 2, 2, 0, 0 ) ), _MM_SHUFFLE( 2, 2, 0, 0 ) );
+		__m256i v = _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( uv, _MM_SHUFFLE( 3, 3, 1, 1 ) ), _MM_SHUFFLE( 3, 3, 1, 1 ) );
+
+		__m256i yv_lo = _mm256_unpacklo_epi16( y, v );
+		__m256i yv_hi = _mm256_unpackhi_epi16( y, v );
+		__m256i yu_lo = _mm256_unpacklo_epi16( y, u );
+		__m256i yu_hi = _mm256_unpackhi_epi16( y, u );
+		__m256i u_lo = _mm256_unpacklo_epi16( u, zero );
+		__m256i u_hi = _mm256_unpackhi_epi16( u, zero );
+
+		__m256i r_lo = _mm256_madd_epi16( yv_lo, _mm256_set1_epi32( PAIR( 1192, 1634 ) ) );
+		__m256i r_hi = _mm256_madd_epi16( yv_hi, _mm256_set1_epi32( PAIR( 1192, 1634 ) ) );
+		__m256i g_lo = _mm256_add_epi32( _mm256_madd_epi16( yv_lo, _mm256_set1_epi32( PAIR( 1192, -832 ) ) ),
+			_mm256_madd_epi16( u_lo, _mm256_set1_epi32( PAIR( -401, 0 ) ) ) );
+		__m256i g_hi = _mm256_add_epi32( _mm256_madd_epi16( yv_hi, _mm256_set1_epi32( PAIR( 1192, -832 ) ) ),
+			_mm256_madd_epi16( u_hi, _mm256_set1_epi32( PAIR( -401, 0 ) ) ) );
+		__m256i b_lo = _mm256_madd_epi16( yu_lo, _mm256_set1_epi32( PAIR( 1192, 2066 ) ) );
+		__m256i b_hi = _mm256_madd_epi16( yu_hi, _mm256_set1_epi32( PAIR( 1192, 2066 ) ) );
+
+		__m256i r = _mm256_packs_epi32( _mm256_srai_epi32( r_lo, 10 ), _mm256_srai_epi32( r_hi, 10 ) );
+		__m256i g = _mm256_packs_epi32( _mm256_srai_epi32( g_lo, 10 ), _mm256_srai_epi32( g_hi, 10 ) );
+		__m256i b = _mm256_packs_epi32( _mm256_srai_epi32( b_lo, 10 ), _mm256_srai_epi32( b_hi, 10 ) );
+		r = _mm256_packus_epi16( r, r );
+		g = _mm256_packus_epi16( g, g );
+		b = _mm256_packus_epi16( b, b );
+		__m256i a;
+		if ( alpha )
+		{
+			a = _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*) ( alpha + n ) ) );
+			a = _mm256_packus_epi16( a, a );
+		}
+		else
+		{
+			a = _mm256_set1_epi8( (char) 0xff );
+		}
+
+		__m256i rg = _mm256_unpacklo_epi8( r, g );
+		__m256i ba = _mm256_unpacklo_epi8( b, a );
+		__m256i lo = _mm256_unpacklo_epi16( rg, ba );
+		__m256i hi = _mm256_unpackhi_epi16( rg, ba );
+		_mm256_storeu_si256( (__m256i*) ( dst + n * 4 ), _mm256_permute2x128_si256( lo, hi, 0x20 ) );
+		_mm256_storeu_si256( (__m256i*) ( dst + n * 4 + 32 ), _mm256_permute2x128_si256( lo, hi, 0x31 ) );
+	}
+	return n + yuv422_to_rgba_sse2( src + n * 2, alpha ? alpha + n : NULL, dst + n * 4, width - n );
+}
+
+__attribute__((target("avx2")))
+static int rgba_to_yuv422_avx2( const uint8_t *src, uint8_t *dst, uint8_t *alpha, int width )
+{
+	const __m256i mask = _mm256_set1_epi16( 0xff );
+	const __m256i mask32 = _mm256_set1_epi32( 0xffff );
+	int n = 0;
+
+	for ( ; n + 16 <= width; n += 16 )
+	{
+		__m256i p0 = _mm256_loadu_si256( (const __m256i*) ( src + n * 4 ) );
+		__m256i p1 = _mm256_loadu_si256( (const __m256i*) ( src + n * 4 + 32 ) );
+		__m256i rb0 = _mm256_and_si256( p0, mask );
+		__m256i rb1 = _mm256_and_si256( p1, mask );
+		__m256i ga0 = _mm256_srli_epi16( p0, 8 );
+		__m256i ga1 = _mm256_srli_epi16( p1, 8 );
+
+		__m256i y0 = _mm256_add_epi32( _mm256_madd_epi16( rb0, _mm256_set1_epi32( PAIR( 263, 100 ) ) ),
+			_mm256_madd_epi16( ga0, _mm256_set1_epi32( PAIR( 516, 0 ) ) ) );
+		__m256i y1 = _mm256_add_epi32( _mm256_madd_epi16( rb1, _mm256_set1_epi32( PAIR( 263, 100 ) ) ),
+			_mm256_madd_epi16( ga1, _mm256_set1_epi32( PAIR( 516, 0 ) ) ) );
+		__m256i u0 = _mm256_add_epi32( _mm256_madd_epi16( rb0, _mm256_set1_epi32( PAIR( -152, 450 ) ) ),
+			_mm256_madd_epi16( ga0, _mm256_set1_epi32( PAIR( -300, 0 ) ) ) );
+		__m256i u1 = _mm256_add_epi32( _mm256_madd_epi16( rb1, _mm256_set1_epi32( PAIR( -152, 450 ) ) ),
+			_mm256_madd_epi16( ga1, _mm256_set1_epi32( PAIR( -300, 0 ) ) ) );
+		__m256i v0 = _mm256_add_epi32( _mm256_madd_epi16( rb0, _mm256_set1_epi32( PAIR( 450, -73 ) ) ),
+			_mm256_madd_epi16( ga0, _mm256_set1_epi32( PAIR( -377, 0 ) ) ) );
+		__m256i v1 = _mm256_add_epi32( _mm256_madd_epi16( rb1, _mm256_set1_epi32( PAIR( 450, -73 ) ) ),
+			_mm256_madd_epi16( ga1, _mm256_set1_epi32( PAIR( -377, 0 ) ) ) );
+
+		// Pixels are now in the 64-bit chunk order 0-3, 8-11, 4-7, 12-15
+		__m256i y = _mm256_add_epi16( _mm256_packs_epi32( _mm256_srai_epi32( y0, 10 ), _mm256_srai_epi32( y1, 10 ) ), _mm256_set1_epi16( 16 ) );
+		__m256i u = _mm256_add_epi16( _mm256_packs_epi32( _mm256_srai_epi32( u0, 10 ), _mm256_srai_epi32( u1, 10 ) ), _mm256_set1_epi16( 128 ) );
+		__m256i v = _mm256_add_epi16( _mm256_packs_epi32( _mm256_srai_epi32( v0, 10 ), _mm256_srai_epi32( v1, 10 ) ), _mm256_set1_epi16( 128 ) );
+
+		u = _mm256_srli_epi32( _mm256_add_epi32( _mm256_and_si256( u, mask32 ), _mm256_srli_epi32( u, 16 ) ), 1 );
+		v = _mm256_srli_epi32( _mm256_add_epi32( _mm256_and_si256( v, mask32 ), _mm256_srli_epi32( v, 16 ) ), 1 );
+		__m256i c = _mm256_or_si256( u, _mm256_slli_epi32( v, 16 ) );
+		__m256i out = _mm256_or_si256( y, _mm256_slli_epi16( c, 8 ) );
+		_mm256_storeu_si256( (__m256i*) ( dst + n * 2 ), _mm256_permute4x64_epi64( out, _MM_SHUFFLE( 3, 1, 2, 0 ) ) );
+
+		__m256i a = _mm256_packs_epi32( _mm256_srli_epi32( ga0, 16 ), _mm256_srli_epi32( ga1, 16 ) );
+		a = _mm256_permute4x64_epi64( a, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+		a = _mm256_packus_epi16( a, a );
+		a = _mm256_permute4x64_epi64( a, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+		_mm_storeu_si128( (__m128i*) ( alpha + n ), _mm256_castsi256_si128( a ) );
+	}
+	return n + rgba_to_yuv422_sse2( src + n * 4, dst + n * 2, alpha + n, width - n );
+}
+
+#endif // USE_AVX2
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+static inline uint8x8_t narrow_neon( int32x4_t lo, int32x4_t hi )
+{
+	return vqmovun_s16( vcombine_s16( vqmovn_s32( vshrq_n_s32( lo, 10 ) ), vqmovn_s32( vshrq_n_s32( hi, 10 ) ) ) );
+}
+
+static inline void yuv_to_rgb_8_neon( uint8x8_t y8, int16x8_t u, int16x8_t v, uint8x8_t *r, uint8x8_t *g, uint8x8_t *b )
+{
+	int16x8_t y = vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( y8 ) ), vdupq_n_s16( 16 ) );
+	int32x4_t y_lo = vmull_n_s16( vget_low_s16( y ), 1192 );
+	int32x4_t y_hi = vmull_n_s16( vget_high_s16( y ), 1192 );
+
+	*r = narrow_neon( vmlal_n_s16( y_lo, vget_low_s16( v ), 1634 ), vmlal_n_s16( y_hi, vget_high_s16( v ), 1634 ) );
+	*g = narrow_neon( vmlal_n_s16( vmlal_n_s16( y_lo, vget_low_s16( v ), -832 ), vget_low_s16( u ), -401 ),
+		vmlal_n_s16( vmlal_n_s16( y_hi, vget_high_s16( v ), -832 ), vget_high_s16( u ), -401 ) );
+	*b = narrow_neon( vmlal_n_s16( y_lo, vget_low_s16( u ), 2066 ), vmlal_n_s16( y_hi, vget_high_s16( u ), 2066 ) );
+}
+
+/** Convert 16 pixels given as even and odd luma with one chroma sample per pair. */
+
+static inline void yuv_pairs_to_rgba_16_neon( uint8x8_t y_even, uint8x8_t y_odd, uint8x8_t u8, uint8x8_t v8,
+	const uint8_t *alpha, uint8_t *dst )
+{
+	int16x8_t u = vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( u8 ) ), vdupq_n_s16( 128 ) );
+	int16x8_t v = vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( v8 ) ), vdupq_n_s16( 128 ) );
+	uint8x8_t r0, g0, b0, r1, g1, b1;
+	uint8x16x4_t out;
+
+	yuv_to_rgb_8_neon( y_even, u, v, &r0, &g0, &b0 );
+	yuv_to_rgb_8_neon( y_odd, u, v, &r1, &g1, &b1 );
+	uint8x8x2_t r = vzip_u8( r0, r1 );
+	uint8x8x2_t g = vzip_u8( g0, g1 );
+	uint8x8x2_t b = vzip_u8( b0, b1 );
+	out.val[0] = vcombine_u8( r.val[0], r.val[1] );
+	out.val[1] = vcombine_u8( g.val[0], g.val[1] );
+	out.val[2] = vcombine_u8( b.val[0], b.val[1] );
+	out.val[3] = alpha ? vld1q_u8( alpha ) : vdupq_n_u8( 0xff );
+	vst4q_u8( dst, out );
+}
+
+static int yuv422_to_rgba_neon( const uint8_t *src, const uint8_t *alpha, uint8_t *dst, int width )
+{
+	int n = 0;
+
+	for ( ; n + 16 <= width; n += 16 )
+	{
+		uint8x8x4_t p = vld4_u8( src + n * 2 );
+		yuv_pairs_to_rgba_16_neon( p.val[0], p.val[2], p.val[1], p.val[3], alpha ? alpha + n : NULL, dst + n * 4 );
+	}
+	return n;
+}
+
+static int yuv420p_to_rgba_neon( const uint8_t *y, const uint8_t *u, const uint8_t *v, const uint8_t *alpha, uint8_t *dst, int width )
+{
+	int n = 0;
+
+	for ( ; n + 16 <= width; n += 16 )
+	{
+		uint8x8x2_t yy = vuzp_u8( vld1_u8( y + n ), vld1_u8( y + n + 8 ) );
+		yuv_pairs_to_rgba_16_neon( yy.val[0], yy.val[1], vld1_u8( u + n / 2 ), vld1_u8( v + n / 2 ),
+			alpha ? alpha + n : NULL, dst + n * 4 );
+	}
+	return n;
+}
+
+static inline int32x4_t dot_neon( int16x4_t r, int16x4_t g, int16x4_t b, int16_t cr, int16_t cg, int16_t cb )
+{
+	return vmlal_n_s16( vmlal_n_s16( vmull_n_s16( r, cr ), g, cg ), b, cb );
+}
+
+/** Convert 8 pixels to luma and to the chroma averaged over each pair. */
+
+static inline void rgb_to_yuv_8_neon( uint8x8_t r8, uint8x8_t g8, uint8x8_t b8, int16x8_t *y, int16x4_t *u, int16x4_t *v )
+{
+	int16x8_t r = vreinterpretq_s16_u16( vmovl_u8( r8 ) );
+	int16x8_t g = vreinterpretq_s16_u16( vmovl_u8( g8 ) );
+	int16x8_t b = vreinterpretq_s16_u16( vmovl_u8( b8 ) );
+	int16x4_t rl = vget_low_s16( r ), gl = vget_low_s16( g ), bl = vget_low_s16( b );
+	int16x4_t rh = vget_high_s16( r ), gh = vget_high_s16( g ), bh = vget_high_s16( b );
+
+	*y = vaddq_s16( vcombine_s16( vmovn_s32( vshrq_n_s32( dot_neon( rl, gl, bl, 263, 516, 100 ), 10 ) ),
+		vmovn_s32( vshrq_n_s32( dot_neon( rh, gh, bh, 263, 516, 100 ), 10 ) ) ), vdupq_n_s16( 16 ) );
+	int16x8_t uu = vaddq_s16( vcombine_s16( vmovn_s32( vshrq_n_s32( dot_neon( rl, gl, bl, -152, -300, 450 ), 10 ) ),
+		vmovn_s32( vshrq_n_s32( dot_neon( rh, gh, bh, -152, -300, 450 ), 10 ) ) ), vdupq_n_s16( 128 ) );
+	int16x8_t vv = vaddq_s16( vcombine_s16( vmovn_s32( vshrq_n_s32( dot_neon( rl, gl, bl, 450, -377, -73 ), 10 ) ),
+		vmovn_s32( vshrq_n_s32( dot_neon( rh, gh, bh, 450, -377, -73 ), 10 ) ) ), vdupq_n_s16( 128 ) );
+	*u = vmovn_s32( vshrq_n_s32( vpaddlq_s16( uu ), 1 ) );
+	*v = vmovn_s32( vshrq_n_s32( vpaddlq_s16( vv ), 1 ) );
+}
+
+static int rgba_to_yuv422_neon( const uint8_t *src, uint8_t *dst, uint8_t *alpha, int width )
+{
+	int n = 0;
+
+	for ( ; n + 16 <= width; n += 16 )
+	{
+		uint8x16x4_t p = vld4q_u8( src + n * 4 );
+		int16x8_t y0, y1;
+		int16x4_t u0, u1, v0, v1;
+		uint8x8x4_t out;
+
+		rgb_to_yuv_8_neon( vget_low_u8( p.val[0] ), vget_low_u8( p.val[1] ), vget_low_u8( p.val[2] ), &y0, &u0, &v0 );
+		rgb_to_yuv_8_neon( vget_high_u8( p.val[0] ), vget_high_u8( p.val[1] ), vget_high_u8( p.val[2] ), &y1, &u1, &v1 );
+		uint8x8x2_t y = vuzp_u8( vmovn_u16( vreinterpretq_u16_s16( y0 ) ), vmovn_u16( vreinterpretq_u16_s16( y1 ) ) );
+		out.val[0] = y.val[0];
+		out.val[1] = vmovn_u16( vreinterpretq_u16_s16( vcombine_s16( u0, u1 ) ) );
+		out.val[2] = y.val[1];
+		out.val[3] = vmovn_u16( vreinterpretq_u16_s16( vcombine_s16( v0, v1 ) ) );
+		vst4_u8( dst + n * 2, out );
+		vst1q_u8( alpha + n, p.val[3] );
+	}
+	return n;
+}
+
+static int yuv420p_to_yuv422_neon( const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width )
+{
+	int n = 0;
+
+	for ( ; n + 16 <= width; n += 16 )
+	{
+		uint8x8x2_t yy = vuzp_u8( vld1_u8( y + n ), vld1_u8( y + n + 8 ) );
+		uint8x8x4_t out;
+		out.val[0] = yy.val[0];
+		out.val[1] = vld1_u8( u + n / 2 );
+		out.val[2] = yy.val[1];
+		out.val[3] = vld1_u8( v + n / 2 );
+		vst4_u8( dst + n * 2, out );
+	}
+	return n;
+}
+
+#endif
+
+static imageconvert_simd g_simd;
+static pthread_once_t g_simd_once = PTHREAD_ONCE_INIT;
+
+static void simd_init( void )
+{
+#if defined(__SSE2__)
+	static const mlt_cpu_dispatch yuv422_to_rgba[] = {
+#if USE_AVX2
+		{ mlt_cpu_avx2, yuv422_to_rgba_avx2 },
+#endif
+		{ mlt_cpu_sse2, yuv422_to_rgba_sse2 },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch rgba_to_yuv422[] = {
+#if USE_AVX2
+		{ mlt_cpu_avx2, rgba_to_yuv422_avx2 },
+#endif
+		{ mlt_cpu_sse2, rgba_to_yuv422_sse2 },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch yuv420p_to_rgba[] = {
+		{ mlt_cpu_sse2, yuv420p_to_rgba_sse2 },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch yuv420p_to_yuv422[] = {
+		{ mlt_cpu_sse2, yuv420p_to_yuv422_sse2 },
+		{ 0, NULL }
+	};
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	static const mlt_cpu_dispatch yuv422_to_rgba[] = {
+		{ mlt_cpu_neon, yuv422_to_rgba_neon },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch rgba_to_yuv422[] = {
+		{ mlt_cpu_neon, rgba_to_yuv422_neon },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch yuv420p_to_rgba[] = {
+		{ mlt_cpu_neon, yuv420p_to_rgba_neon },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch yuv420p_to_yuv422[] = {
+		{ mlt_cpu_neon, yuv420p_to_yuv422_neon },
+		{ 0, NULL }
+	};
+#else
+	static const mlt_cpu_dispatch yuv422_to_rgba[] = { { 0, NULL } };
+	static const mlt_cpu_dispatch rgba_to_yuv422[] = { { 0, NULL } };
+	static const mlt_cpu_dispatch yuv420p_to_rgba[] = { { 0, NULL } };
+	static const mlt_cpu_dispatch yuv420p_to_yuv422[] = { { 0, NULL } };
+#endif
+	g_simd.yuv422_to_rgba = mlt_cpu_select( yuv422_to_rgba );
+	g_simd.rgba_to_yuv422 = mlt_cpu_select( rgba_to_yuv422 );
+	g_simd.yuv420p_to_rgba = mlt_cpu_select( yuv420p_to_rgba );
+	g_simd.yuv420p_to_yuv422 = mlt_cpu_select( yuv420p_to_yuv422 );
+}
+
+const imageconvert_simd *imageconvert_simd_get( void )
+{
+	pthread_once( &g_simd_once, simd_init );
+	return &g_simd;
+}
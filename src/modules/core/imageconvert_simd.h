@@ -0,0 +1,46 @@
+/*
+ * imageconvert_simd.h -- vectorised lines for filter_imageconvert
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef IMAGECONVERT_SIMD_H
+#define IMAGECONVERT_SIMD_H
+
+#include <stdint.h>
+
+/** Line converters with the same results as the scalar code in filter_imageconvert.
+ *
+ * Each one converts the largest even number of pixels it can handle from the start
+ * of the line and returns it, leaving the rest of the line to the caller. A NULL
+ * source alpha means opaque.
+ */
+
+typedef struct
+{
+	int ( *yuv422_to_rgba )( const uint8_t *src, const uint8_t *alpha, uint8_t *dst, int width );
+	int ( *yuv420p_to_rgba )( const uint8_t *y, const uint8_t *u, const uint8_t *v, const uint8_t *alpha, uint8_t *dst, int width );
+	int ( *rgba_to_yuv422 )( const uint8_t *src, uint8_t *dst, uint8_t *alpha, int width );
+	int ( *yuv420p_to_yuv422 )( const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width );
+} imageconvert_simd;
+
+/** Get the best line converters for the running CPU, or zeroed ones if none apply.
+ * They are chosen with mlt_cpu_select(), so MLT_CPU_FLAGS can restrict them.
+ */
+
+extern const imageconvert_simd *imageconvert_simd_get( void );
+
+#endif
@@ -21,16 +21,24 @@
 #include <framework/mlt_log.h>
 #include <framework/mlt_factory.h>
 #include <framework/mlt_frame.h>
+#include <framework/mlt_slices.h>
 
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define USE_NEON 1
+#endif
+
 // Private Types
 typedef struct
 {
-	mlt_frame prev_frame;
 	mlt_filter resample_filter;
 	mlt_filter pitch_filter;
 } private_data;
@@ -240,6 +248,80 @@ static int link_get_audio( mlt_frame frame, void** audio, mlt_audio_format* form
 	return error;
 }
 
+typedef struct
+{
+	uint8_t* dest;
+	uint8_t** images;
+	int count;
+	int size;
+} blend_desc;
+
+// Average the bytes of the images from offset for length bytes.
+// The sums of up to 10 images fit 16 bits and multiplying them by the rounded up
+// reciprocal of the count, then dropping the low 16 bits, is the same as dividing.
+static void blend_bytes( uint8_t* dest, uint8_t** images, int count, int offset, int length )
+{
+	unsigned int scale = ( 65536 + count - 1 ) / count;
+	int s = 0;
+	int i;
+#if defined(USE_SSE2)
+	__m128i zero = _mm_setzero_si128();
+	__m128i factor = _mm_set1_epi16( (short)scale );
+	for ( ; s + 16 <= length; s += 16 )
+	{
+		__m128i lo = zero, hi = zero;
+		for ( i = 0; i < count; i++ )
+		{
+			__m128i v = _mm_loadu_si128( (const __m128i*)( images[i] + offset + s ) );
+			lo = _mm_add_epi16( lo, _mm_unpacklo_epi8( v, zero ) );
+			hi = _mm_add_epi16( hi, _mm_unpackhi_epi8( v, zero ) );
+		}
+		lo = _mm_mulhi_epu16( lo, factor );
+		hi = _mm_mulhi_epu16( hi, factor );
+		_mm_storeu_si128( (__m128i*)( dest + s ), _mm_packus_epi16( lo, hi ) );
+	}
+#elif defined(USE_NEON)
+	uint16x4_t factor = vdup_n_u16( scale );
+	for ( ; s + 16 <= length; s += 16 )
+	{
+		uint16x8_t lo = vdupq_n_u16( 0 ), hi = vdupq_n_u16( 0 );
+		for ( i = 0; i < count; i++ )
+		{
+			uint8x16_t v = vld1q_u8( images[i] + offset + s );
+			lo = vaddw_u8( lo, vget_low_u8( v ) );
+			hi = vaddw_u8( hi, vget_high_u8( v ) );
+		}
+		uint16x8_t out_lo = vcombine_u16( vshrn_n_u32( vmull_u16( vget_low_u16( lo ), factor ), 16 ),
+			vshrn_n_u32( vmull_u16( vget_high_u16( lo ), factor ), 16 ) );
+		uint16x8_t out_hi = vcombine_u16( vshrn_n_u32( vmull_u16( vget_low_u16( hi ), factor ), 16 ),
+			vshrn_n_u32( vmull_u16( vget_high_u16( hi ), factor ), 16 ) );
+		vst1q_u8( dest + s, vcombine_u8( vmovn_u16( out_lo ), vmovn_u16( out_hi ) ) );
+	}
+#endif
+	for ( ; s < length; s++ )
+	{
+		unsigned int sum = 0;
+		for ( i = 0; i < count; i++ )
+		{
+			sum += images[i][offset + s];
+		}
+		dest[s] = ( sum * scale ) >> 16;
+	}
+}
+
+static int blend_slice( int id, int index, int jobs, void* data )
+{
+	(void) id; // unused
+	blend_desc* desc = (blend_desc*) data;
+	// Keep the slices a multiple of the vector size
+	int slice_size = ( ( desc->size + jobs - 1 ) / jobs + 15 ) & ~15;
+	int start = index * slice_size;
+	int length = MIN( slice_size, desc->size - start );
+	if ( length > 0 )
+		blend_bytes( desc->dest + start, desc->images, desc->count, start, length );
+	return 0;
+}
+
 static int link_get_image_blend( mlt_frame frame, uint8_t** image, mlt_image_format* format, int* width, int* height, int writable )
 {
 	static const int MAX_BLEND_IMAGES = 10;
@@ -249,8 +331,15 @@ static int link_get_image_blend( mlt_frame frame, uint8_t** image, mlt_image_for
 	{
 		return 1;
 	}
+	if ( mlt_properties_get_int( MLT_LINK_PROPERTIES(self), "prefetch" ) > 0 )
+	{
+		// Let the frames that are looked ahead render an image like this one
+		mlt_link_prefetch_images( self, *format, *width, *height );
+	}
 	int requested_width = *width;
 	int requested_height = *height;
+	int image_width = 0;
+	int image_height = 0;
 	double source_time = mlt_properties_get_double( unique_properties, "source_time");
 	double source_fps = mlt_properties_get_double( unique_properties, "source_fps");
 
@@ -268,14 +357,21 @@ static int link_get_image_blend( mlt_frame frame, uint8_t** image, mlt_image_for
 		{
 			break;
 		}
-		if ( mlt_frame_get_image( src_frame, &images[image_count], format, &requested_width, &requested_height, 0 ) != 0 )
+		int image_width_in = requested_width;
+		int image_height_in = requested_height;
+		if ( mlt_frame_get_image( src_frame, &images[image_count], format, &image_width_in, &image_height_in, 0 ) != 0 )
 		{
 			mlt_log_error( MLT_LINK_SERVICE(self), "Failed to get image %s\n", key );
 			break;
 		}
-		if ( *width != requested_width || *height != requested_height )
+		if ( image_count == 0 )
+		{
+			image_width = image_width_in;
+			image_height = image_height_in;
+		}
+		else if ( image_width != image_width_in || image_height != image_height_in )
 		{
-			mlt_log_error( MLT_LINK_SERVICE(self), "Dimension Mismatch (%s): %dx%d != %dx%d\n", key, requested_width, requested_height, *width, *height );
+			mlt_log_error( MLT_LINK_SERVICE(self), "Dimension Mismatch (%s): %dx%d != %dx%d\n", key, image_width_in, image_height_in, image_width, image_height );
 			break;
 		}
 		colorspace = mlt_properties_get_int( MLT_FRAME_PROPERTIES(src_frame), "colorspace" );
@@ -289,23 +385,18 @@ static int link_get_image_blend( mlt_frame frame, uint8_t** image, mlt_image_for
 		return 1;
 	}
 
-	// Sum all the images into one image with 16 bit components
+	// Average all the images into one image, in slices for large images
+	*width = image_width;
+	*height = image_height;
 	int size = mlt_image_format_size( *format, *width, *height, NULL );
 	*image = mlt_pool_alloc( size );
-	int s = 0;
-	uint8_t* p = *image;
-	for( s = 0; s < size; s++ )
-	{
-		int16_t sum = 0;
-		int i = 0;
-		for( i = 0; i < image_count; i++ )
-		{
-			sum += *(images[i]);
-			images[i]++;
-		}
-		*p = sum / image_count;
-		p++;
-	}
+	blend_desc desc = { *image, images, image_count, size };
+	if ( image_count == 1 )
+		memcpy( *image, images[0], size );
+	else if ( size < 256 * 1024 )
+		blend_slice( 0, 0, 1, &desc );
+	else
+		mlt_slices_run_normal( mlt_slices_count_normal(), blend_slice, &desc );
 	mlt_frame_set_image( frame, *image, size, mlt_pool_release );
 	mlt_properties_set_int( MLT_FRAME_PROPERTIES(frame), "format", *format );
 	mlt_properties_set_int( MLT_FRAME_PROPERTIES(frame), "width", *width );
@@ -328,6 +419,10 @@ static int link_get_image_nearest( mlt_frame frame, uint8_t** image, mlt_image_f
 	mlt_position in_frame_pos = floor( source_time * source_fps );
 	char key[19];
 	sprintf( key, "%d", in_frame_pos );
+	if ( mlt_properties_get_int( MLT_LINK_PROPERTIES(self), "prefetch" ) > 0 )
+	{
+		mlt_link_prefetch_images( self, *format, *width, *height );
+	}
 
 	mlt_frame src_frame = (mlt_frame)mlt_properties_get_data( unique_properties, key, NULL );
 	if ( src_frame )
@@ -359,12 +454,52 @@ static int link_get_image_nearest( mlt_frame frame, uint8_t** image, mlt_image_f
 	return 1;
 }
 
+static void get_source_time( mlt_link self, mlt_position position, double* source_time, double* source_duration )
+{
+	mlt_properties properties = MLT_LINK_PROPERTIES( self );
+	double link_fps = mlt_producer_get_fps( MLT_LINK_PRODUCER( self ) );
+
+	if ( !mlt_properties_exists( properties, "map" ) )
+	{
+		*source_time = (double)position / link_fps;
+		*source_duration = 1.0 / link_fps;
+	}
+	else
+	{
+		// Assume that the user wants normal speed before the in point.
+		mlt_position length = mlt_producer_get_length( MLT_LINK_PRODUCER( self ) );
+		mlt_position in = mlt_producer_get_in( MLT_LINK_PRODUCER(self) );
+		double in_time = (double)in / link_fps;
+		*source_time = mlt_properties_anim_get_double( properties, "map", position - in, length ) + in_time;
+		double next_source_time = mlt_properties_anim_get_double( properties, "map", position - in + 1, length ) + in_time;
+		*source_duration = next_source_time - *source_time;
+	}
+}
+
+// Get the positions of the source frames that make up one output frame
+static void get_source_range( double source_time, double source_duration, double source_fps, mlt_position* first, mlt_position* last )
+{
+	mlt_position in_frame_pos = floor( source_time * source_fps );
+	double frame_time = (double)in_frame_pos / source_fps;
+	double source_end_time = source_time + fabs(source_duration);
+	if ( frame_time == source_end_time )
+	{
+		// Force one frame to be sent.
+		source_end_time += 0.0000000001;
+	}
+	*first = in_frame_pos;
+	while ( frame_time < source_end_time )
+	{
+		in_frame_pos++;
+		frame_time = (double)in_frame_pos / source_fps;
+	}
+	*last = in_frame_pos - 1;
+}
+
 static int link_get_frame( mlt_link self, mlt_frame_ptr frame, int index )
 {
 	mlt_properties properties = MLT_LINK_PROPERTIES( self );
-	private_data* pdata = (private_data*)self->child;
 	mlt_position position = mlt_producer_position( MLT_LINK_PRODUCER( self ) );
-	mlt_position length = mlt_producer_get_length( MLT_LINK_PRODUCER( self ) );
 	double source_time = 0.0;
 	double source_duration = 0.0;
 	double source_fps = mlt_producer_get_fps( self->next );
@@ -378,20 +513,7 @@ static int link_get_frame( mlt_link self, mlt_frame_ptr frame, int index )
 	mlt_properties unique_properties = mlt_frame_unique_properties( *frame, MLT_LINK_SERVICE(self) );
 
 	// Calculate the frames from the next link to be used
-	if ( !mlt_properties_exists( properties, "map" ) )
-	{
-		source_time = (double)position / link_fps;
-		source_duration = 1.0 / link_fps;
-	}
-	else
-	{
-		// Assume that the user wants normal speed before the in point.
-		mlt_position in = mlt_producer_get_in( MLT_LINK_PRODUCER(self) );
-		double in_time = (double)in / link_fps;
-		source_time = mlt_properties_anim_get_double( properties, "map", position - in, length ) + in_time;
-		double next_source_time = mlt_properties_anim_get_double( properties, "map", position - in + 1, length ) + in_time;
-		source_duration = next_source_time - source_time;
-	}
+	get_source_time( self, position, &source_time, &source_duration );
 
 	double frame_duration = 1.0 / link_fps;
 	double source_speed = 0.0;
@@ -407,43 +529,38 @@ static int link_get_frame( mlt_link self, mlt_frame_ptr frame, int index )
 
 	mlt_log_debug( MLT_LINK_SERVICE(self), "Get Frame: %f -> %f\t%d\t%d\n", source_fps, link_fps, position, mlt_producer_get_in( MLT_LINK_PRODUCER(self) ) );
 
+	// Keep the source frames of this frame and of the next ones that are prefetched
+	mlt_position first_pos, last_pos;
+	get_source_range( source_time, source_duration, source_fps, &first_pos, &last_pos );
+	mlt_position window_first = first_pos, window_last = last_pos;
+	int prefetch = mlt_properties_get_int( properties, "prefetch" );
+	int i;
+	for ( i = 1; i <= prefetch; i++ )
+	{
+		double time, duration;
+		mlt_position first, last;
+		get_source_time( self, position + i, &time, &duration );
+		get_source_range( time, duration, source_fps, &first, &last );
+		window_first = MIN( window_first, first );
+		window_last = MAX( window_last, last );
+	}
+	mlt_link_retain_frames( self, window_first, window_last, index );
+
 	// Get frames from the next link and pass them along with the new frame
 	int in_frame_count = 0;
 	mlt_frame src_frame = NULL;
-	mlt_position prev_frame_position = pdata->prev_frame ? mlt_frame_get_position( pdata->prev_frame ) : -1;
-	mlt_position in_frame_pos = floor( source_time * source_fps );
-	double frame_time = (double)in_frame_pos / source_fps;
-	double source_end_time = source_time + fabs(source_duration);
-	if ( frame_time == source_end_time )
+	mlt_position in_frame_pos;
+	for ( in_frame_pos = first_pos; in_frame_pos <= last_pos; in_frame_pos++ )
 	{
-		// Force one frame to be sent.
-		source_end_time += 0.0000000001;
-	}
-	while ( frame_time < source_end_time )
-	{
-		if( in_frame_pos == prev_frame_position )
+		result = mlt_link_get_next_frame( self, in_frame_pos, index, &src_frame );
+		if ( result )
 		{
-			// Reuse the previous frame to avoid seeking.
-			src_frame = pdata->prev_frame;
-			mlt_properties_inc_ref( MLT_FRAME_PROPERTIES(src_frame) );
-		}
-		else
-		{
-			mlt_producer_seek( self->next, in_frame_pos );
-			result = mlt_service_get_frame( MLT_PRODUCER_SERVICE( self->next ), &src_frame, index );
-			if ( result )
-			{
-				break;
-			}
+			break;
 		}
 		// Save the source frame on the output frame
 		char key[19];
 		sprintf( key, "%d", in_frame_pos );
 		mlt_properties_set_data( unique_properties, key, src_frame, 0, (mlt_destructor)mlt_frame_close, NULL );
-
-		// Calculate the next frame
-		in_frame_pos++;
-		frame_time = (double)in_frame_pos / source_fps;
 		in_frame_count++;
 	}
 
@@ -460,14 +577,6 @@ static int link_get_frame( mlt_link self, mlt_frame_ptr frame, int index )
 	mlt_properties_pass_list( MLT_FRAME_PROPERTIES(*frame), MLT_FRAME_PROPERTIES(src_frame), "audio_frequency" );
 	mlt_properties_set_data( MLT_FRAME_PROPERTIES(*frame), "_producer", mlt_frame_get_original_producer(src_frame), 0, NULL, NULL );
 
-	if ( src_frame != pdata->prev_frame )
-	{
-		// Save the last source frame because it might be requested for the next frame.
-		mlt_frame_close( pdata->prev_frame );
-		mlt_properties_inc_ref( MLT_FRAME_PROPERTIES(src_frame) );
-		pdata->prev_frame = src_frame;
-	}
-
 	// Setup callbacks
 	char* mode = mlt_properties_get( properties, "image_mode" );
 	mlt_frame_push_get_image( *frame, (void*)self );
@@ -496,10 +605,6 @@ static void link_close( mlt_link self )
 		private_data* pdata = (private_data*)self->child;
 		if ( pdata )
 		{
-			if ( pdata->prev_frame )
-			{
-				mlt_frame_close( pdata->prev_frame );
-			}
 			if ( pdata->resample_filter )
 			{
 				mlt_filter_close( pdata->resample_filter );
@@ -0,0 +1,195 @@
+/*
+ * mix_audio_simd.c -- vectorised audio mixing for transition_mix
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mix_audio_simd.h"
+
+#include <framework/mlt_cpu.h>
+
+#include <pthread.h>
+#include <stddef.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) ) && defined(__SSE2__)
+#define USE_X86_SIMD 1
+#include <immintrin.h>
+
+// The buffers are processed in blocks of 4 samples, which is a whole number of
+// vectors for any channel count. offsets[e] is the sample of element e in a
+// block, so the level of a lane is start + ( i + offsets[e] ) * step, where the
+// sum is an exact integer, giving the same level as the scalar ramp.
+
+static void block_offsets( double *offsets, int channels )
+{
+	int e;
+	for ( e = 0; e < 4 * channels; e++ )
+		offsets[e] = e / channels;
+}
+
+// No FMA, so every product is rounded like in the scalar code
+__attribute__((target("avx")))
+static int mix_avx( float *a, const float *b, int channels, int samples, double start, double step )
+{
+	double offsets[ 4 * MIX_AUDIO_SIMD_CHANNELS ];
+	const __m256d one = _mm256_set1_pd( 1.0 );
+	const __m256d start_v = _mm256_set1_pd( start );
+	const __m256d step_v = _mm256_set1_pd( step );
+	int i, g;
+
+	if ( channels < 1 || channels > MIX_AUDIO_SIMD_CHANNELS )
+		return 0;
+	block_offsets( offsets, channels );
+	for ( i = 0; i + 4 <= samples; i += 4 )
+	{
+		const __m256d base = _mm256_set1_pd( i );
+		for ( g = 0; g < channels; g++ )
+		{
+			float *pa = a + i * channels + g * 4;
+			__m256d mix = _mm256_add_pd( start_v, _mm256_mul_pd( _mm256_add_pd( base, _mm256_loadu_pd( offsets + g * 4 ) ), step_v ) );
+			__m256d va = _mm256_cvtps_pd( _mm_loadu_ps( pa ) );
+			__m256d vb = _mm256_cvtps_pd( _mm_loadu_ps( b + i * channels + g * 4 ) );
+			__m256d v = _mm256_add_pd( _mm256_mul_pd( mix, vb ), _mm256_mul_pd( _mm256_sub_pd( one, mix ), va ) );
+			_mm_storeu_ps( pa, _mm256_cvtpd_ps( v ) );
+		}
+	}
+	return i;
+}
+
+__attribute__((target("avx")))
+static int sum_avx( float *a, const float *const *b, const double *start, const double *step, int count,
+	int channels, int samples )
+{
+	double offsets[ 4 * MIX_AUDIO_SIMD_CHANNELS ];
+	int i, g, k;
+
+	if ( channels < 1 || channels > MIX_AUDIO_SIMD_CHANNELS )
+		return 0;
+	block_offsets( offsets, channels );
+	for ( i = 0; i + 4 <= samples; i += 4 )
+	{
+		const __m256d base = _mm256_set1_pd( i );
+		for ( g = 0; g < channels; g++ )
+		{
+			int e = i * channels + g * 4;
+			__m256d position = _mm256_add_pd( base, _mm256_loadu_pd( offsets + g * 4 ) );
+			__m256d v = _mm256_cvtps_pd( _mm_loadu_ps( a + e ) );
+			for ( k = 0; k < count; k++ )
+			{
+				__m256d mix = _mm256_add_pd( _mm256_set1_pd( start[k] ), _mm256_mul_pd( position, _mm256_set1_pd( step[k] ) ) );
+				v = _mm256_add_pd( v, _mm256_mul_pd( mix, _mm256_cvtps_pd( _mm_loadu_ps( b[k] + e ) ) ) );
+			}
+			_mm_storeu_ps( a + e, _mm256_cvtpd_ps( v ) );
+		}
+	}
+	return i;
+}
+
+static inline __m128d load2_sse2( const float *p )
+{
+	return _mm_cvtps_pd( _mm_castpd_ps( _mm_load_sd( (const double*) p ) ) );
+}
+
+static inline void store2_sse2( float *p, __m128d v )
+{
+	_mm_store_sd( (double*) p, _mm_castps_pd( _mm_cvtpd_ps( v ) ) );
+}
+
+static int mix_sse2( float *a, const float *b, int channels, int samples, double start, double step )
+{
+	double offsets[ 4 * MIX_AUDIO_SIMD_CHANNELS ];
+	const __m128d one = _mm_set1_pd( 1.0 );
+	const __m128d start_v = _mm_set1_pd( start );
+	const __m128d step_v = _mm_set1_pd( step );
+	int i, g;
+
+	if ( channels < 1 || channels > MIX_AUDIO_SIMD_CHANNELS )
+		return 0;
+	block_offsets( offsets, channels );
+	for ( i = 0; i + 4 <= samples; i += 4 )
+	{
+		const __m128d base = _mm_set1_pd( i );
+		for ( g = 0; g < 2 * channels; g++ )
+		{
+			float *pa = a + i * channels + g * 2;
+			__m128d mix = _mm_add_pd( start_v, _mm_mul_pd( _mm_add_pd( base, _mm_loadu_pd( offsets + g * 2 ) ), step_v ) );
+			__m128d va = load2_sse2( pa );
+			__m128d vb = load2_sse2( b + i * channels + g * 2 );
+			store2_sse2( pa, _mm_add_pd( _mm_mul_pd( mix, vb ), _mm_mul_pd( _mm_sub_pd( one, mix ), va ) ) );
+		}
+	}
+	return i;
+}
+
+static int sum_sse2( float *a, const float *const *b, const double *start, const double *step, int count,
+	int channels, int samples )
+{
+	double offsets[ 4 * MIX_AUDIO_SIMD_CHANNELS ];
+	int i, g, k;
+
+	if ( channels < 1 || channels > MIX_AUDIO_SIMD_CHANNELS )
+		return 0;
+	block_offsets( offsets, channels );
+	for ( i = 0; i + 4 <= samples; i += 4 )
+	{
+		const __m128d base = _mm_set1_pd( i );
+		for ( g = 0; g < 2 * channels; g++ )
+		{
+			int e = i * channels + g * 2;
+			__m128d position = _mm_add_pd( base, _mm_loadu_pd( offsets + g * 2 ) );
+			__m128d v = load2_sse2( a + e );
+			for ( k = 0; k < count; k++ )
+			{
+				__m128d mix = _mm_add_pd( _mm_set1_pd( start[k] ), _mm_mul_pd( position, _mm_set1_pd( step[k] ) ) );
+				v = _mm_add_pd( v, _mm_mul_pd( mix, load2_sse2( b[k] + e ) ) );
+			}
+			store2_sse2( a + e, v );
+		}
+	}
+	return i;
+}
+
+#endif
+
+static mix_audio_simd g_simd;
+static pthread_once_t g_simd_once = PTHREAD_ONCE_INIT;
+
+static void simd_init( void )
+{
+#if USE_X86_SIMD
+	static const mlt_cpu_dispatch mix[] = {
+		{ mlt_cpu_avx, mix_avx },
+		{ mlt_cpu_sse2, mix_sse2 },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch sum[] = {
+		{ mlt_cpu_avx, sum_avx },
+		{ mlt_cpu_sse2, sum_sse2 },
+		{ 0, NULL }
+	};
+#else
+	static const mlt_cpu_dispatch mix[] = { { 0, NULL } };
+	static const mlt_cpu_dispatch sum[] = { { 0, NULL } };
+#endif
+	g_simd.mix = mlt_cpu_select( mix );
+	g_simd.sum = mlt_cpu_select( sum );
+}
+
+const mix_audio_simd *mix_audio_simd_get( void )
+{
+	pthread_once( &g_simd_once, simd_init );
+	return &g_simd;
+}
@@ -0,0 +1,49 @@
+/*
+ * mix_audio_simd.h -- vectorised audio mixing for transition_mix
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MIX_AUDIO_SIMD_H
+#define MIX_AUDIO_SIMD_H
+
+/** Mixers for interleaved float audio where every buffer has the same channels.
+ *
+ * The level of sample i is start + i * step. mix crossfades b into a, and sum
+ * adds count buffers to a, each with its own ramp. They compute in double
+ * precision in the same order as the scalar code in transition_mix, so the
+ * results are the same. Each one mixes the largest number of samples it can
+ * handle from the start of the buffers and returns it, leaving the rest to the caller.
+ */
+
+typedef struct
+{
+	int ( *mix )( float *a, const float *b, int channels, int samples, double start, double step );
+	int ( *sum )( float *a, const float *const *b, const double *start, const double *step, int count,
+		int channels, int samples );
+} mix_audio_simd;
+
+/** The highest channel count the mixers handle */
+
+#define MIX_AUDIO_SIMD_CHANNELS (8)
+
+/** Get the best mixers for the running CPU, or NULL ones if none apply.
+ * They are chosen with mlt_cpu_select(), so MLT_CPU_FLAGS can restrict them.
+ */
+
+extern const mix_audio_simd *mix_audio_simd_get( void );
+
+#endif
@@ -21,10 +21,12 @@
 #include <framework/mlt_frame.h>
 #include <framework/mlt_pool.h>
 #include <framework/mlt_log.h>
+#include <framework/mlt_factory.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 
 static int producer_get_frame( mlt_producer parent, mlt_frame_ptr frame, int index );
@@ -44,7 +46,6 @@ mlt_producer producer_colour_init( mlt_profile profile, mlt_service_type type, c
 
 		// Set the default properties
 		mlt_properties_set( properties, "resource", ( !colour || !strcmp( colour, "" ) ) ? "0x000000ff" : colour );
-		mlt_properties_set( properties, "_resource", "" );
 		mlt_properties_set_double( properties, "aspect_ratio", mlt_profile_sar( profile ) );
 		
 		return producer;
@@ -53,6 +54,172 @@ mlt_producer producer_colour_init( mlt_profile profile, mlt_service_type type, c
 	return NULL;
 }
 
+/** The number of colour images that all colour producers share */
+
+#define IMAGE_CACHE_SIZE 8
+
+/** \brief an image of a solid colour in the cache */
+
+typedef struct
+{
+	mlt_color color;
+	mlt_image_format format;
+	int width;
+	int height;
+	uint8_t *image;     /**< a shared buffer from mlt_image_buffer_alloc(), or NULL */
+	int size;
+	uint64_t used;      /**< the value of cache_clock when it was last handed out */
+} cached_image;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static cached_image image_cache[IMAGE_CACHE_SIZE];
+static uint64_t cache_clock = 0;
+static int cache_registered = 0;
+
+static void image_cache_close( void *unused )
+{
+	pthread_mutex_lock( &cache_mutex );
+	for ( int i = 0; i < IMAGE_CACHE_SIZE; i++ )
+	{
+		mlt_image_buffer_release( image_cache[i].image );
+		image_cache[i].image = NULL;
+	}
+	cache_registered = 0;
+	pthread_mutex_unlock( &cache_mutex );
+}
+
+static int color_equal( mlt_color a, mlt_color b )
+{
+	return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+/** Fill the rows of an image by repeating a pattern that covers the first row. */
+
+static void fill_rows( uint8_t *p, const uint8_t *pattern, int pattern_size, int row_size, int rows )
+{
+	int filled = MIN( pattern_size, row_size );
+
+	memcpy( p, pattern, filled );
+	while ( filled < row_size )
+	{
+		int n = MIN( filled, row_size - filled );
+		memcpy( p + filled, p, n );
+		filled += n;
+	}
+	for ( int line = 1; line < rows; line++ )
+		memcpy( p + line * row_size, p, row_size );
+}
+
+static uint8_t *render_image( mlt_producer producer, mlt_color color, mlt_image_format format, int width, int height, int *size )
+{
+	int bpp;
+	uint8_t *p;
+
+	*size = mlt_image_format_size( format, width, height, &bpp );
+	p = mlt_image_buffer_alloc( *size );
+	if ( !p )
+		return NULL;
+
+	switch ( format )
+	{
+	case mlt_image_yuv420p:
+	{
+		int plane_size =  width * height;
+		uint8_t y, u, v;
+
+		RGB2YUV_601_SCALED( color.r, color.g, color.b, y, u, v );
+		memset(p + 0, y, plane_size);
+		memset(p + plane_size, u, plane_size/4);
+		memset(p + plane_size + plane_size/4, v, plane_size/4);
+		break;
+	}
+	case mlt_image_yuv422:
+	{
+		uint8_t y, u, v;
+
+		RGB2YUV_601_SCALED( color.r, color.g, color.b, y, u, v );
+		uint8_t pattern[4] = { y, u, y, v };
+		// An uneven row ends with y and u, which the pattern already gives
+		fill_rows( p, pattern, 4, width * 2, height );
+		break;
+	}
+	case mlt_image_rgb:
+	{
+		uint8_t pattern[3] = { color.r, color.g, color.b };
+		fill_rows( p, pattern, 3, width * 3, height );
+		break;
+	}
+	case mlt_image_movit:
+	case mlt_image_opengl_texture:
+		memset(p, 0, *size);
+		break;
+	case mlt_image_rgba:
+	{
+		uint8_t pattern[4] = { color.r, color.g, color.b, color.a };
+		fill_rows( p, pattern, 4, width * 4, height );
+		break;
+	}
+	default:
+		mlt_log_error( MLT_PRODUCER_SERVICE( producer ),
+			"invalid image format %s\n", mlt_image_format_name( format ) );
+	}
+	return p;
+}
+
+/** Get a reference to an image of a solid colour, rendering it only if no colour producer has it.
+ *
+ * \return a shared buffer to release with mlt_image_buffer_release(), or NULL
+ */
+
+static uint8_t *get_image( mlt_producer producer, mlt_color color, mlt_image_format format, int width, int height, int *size )
+{
+	uint8_t *image = NULL;
+	cached_image *entry = NULL;
+
+	pthread_mutex_lock( &cache_mutex );
+	for ( int i = 0; i < IMAGE_CACHE_SIZE && !image; i++ )
+	{
+		entry = &image_cache[i];
+		if ( entry->image && entry->format == format && entry->width == width && entry->height == height
+			&& color_equal( entry->color, color ) )
+		{
+			entry->used = ++cache_clock;
+			*size = entry->size;
+			image = mlt_image_buffer_ref( entry->image );
+		}
+	}
+	pthread_mutex_unlock( &cache_mutex );
+	if ( image )
+		return image;
+
+	// Render it without the lock; if another thread raced us, both images are valid
+	image = render_image( producer, color, format, width, height, size );
+	if ( !image )
+		return NULL;
+
+	pthread_mutex_lock( &cache_mutex );
+	if ( !cache_registered )
+	{
+		mlt_factory_register_for_clean_up( image_cache, image_cache_close );
+		cache_registered = 1;
+	}
+	entry = &image_cache[0];
+	for ( int i = 1; i < IMAGE_CACHE_SIZE; i++ )
+		if ( image_cache[i].used < entry->used )
+			entry = &image_cache[i];
+	mlt_image_buffer_release( entry->image );
+	entry->color = color;
+	entry->format = format;
+	entry->width = width;
+	entry->height = height;
+	entry->size = *size;
+	entry->used = ++cache_clock;
+	entry->image = mlt_image_buffer_ref( image );
+	pthread_mutex_unlock( &cache_mutex );
+
+	return image;
+}
+
 static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_format *format, int *width, int *height, int writable )
 {
 	// Obtain properties of frame
@@ -66,16 +233,8 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 	// Obtain properties of producer
 	mlt_properties producer_props = MLT_PRODUCER_PROPERTIES( producer );
 
-	// Get the current and previous colour strings
+	// Get the current colour string
 	char *now = mlt_properties_get( producer_props, "resource" );
-	char *then = mlt_properties_get( producer_props, "_resource" );
-
-	// Get the current image and dimensions cached in the producer
-	int size = 0;
-	uint8_t *image = mlt_properties_get_data( producer_props, "image", &size );
-	int current_width = mlt_properties_get_int( producer_props, "_width" );
-	int current_height = mlt_properties_get_int( producer_props, "_height" );
-	mlt_image_format current_format = mlt_properties_get_int( producer_props, "_format" );
 
 	// Parse the colour
 	if ( now && strchr( now, '/' ) )
@@ -83,13 +242,14 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 		now = strdup( strrchr( now, '/' ) + 1 );
 		mlt_properties_set( producer_props, "resource", now );
 		free( now );
-		now = mlt_properties_get( producer_props, "resource" );
 	}
 	mlt_color color = mlt_properties_get_color( producer_props, "resource" );
 
 	if ( mlt_properties_get( producer_props, "mlt_image_format") )
 		*format = mlt_image_format_id( mlt_properties_get( producer_props, "mlt_image_format") );
 
+	mlt_service_unlock( MLT_PRODUCER_SERVICE( producer ) );
+
 	// Choose suitable out values if nothing specific requested
 	if ( *format == mlt_image_none || *format == mlt_image_movit )
 		*format = mlt_image_rgba;
@@ -102,97 +262,11 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 	if (*format!=mlt_image_yuv420p  && *format!=mlt_image_yuv422  && *format!=mlt_image_rgb && *format!= mlt_image_movit && *format!= mlt_image_opengl_texture)
 		*format = mlt_image_rgba;
 
-	// See if we need to regenerate
-	if ( !now || ( then && strcmp( now, then ) ) || *width != current_width || *height != current_height || *format != current_format )
-	{
-		// Color the image
-		int i = *width * *height + 1;
-		int bpp;
-
-		// Allocate the image
-		size = mlt_image_format_size( *format, *width, *height, &bpp );
-		uint8_t *p = image = mlt_pool_alloc( size );
-
-		// Update the producer
-		mlt_properties_set_data( producer_props, "image", image, size, mlt_pool_release, NULL );
-		mlt_properties_set_int( producer_props, "_width", *width );
-		mlt_properties_set_int( producer_props, "_height", *height );
-		mlt_properties_set_int( producer_props, "_format", *format );
-		mlt_properties_set( producer_props, "_resource", now );
-
-		mlt_service_unlock( MLT_PRODUCER_SERVICE( producer ) );
-
-		switch ( *format )
-		{
-		case mlt_image_yuv420p:
-		{
-			int plane_size =  *width * *height;
-			uint8_t y, u, v;
-
-			RGB2YUV_601_SCALED( color.r, color.g, color.b, y, u, v );
-			memset(p + 0, y, plane_size);
-			memset(p + plane_size, u, plane_size/4);
-			memset(p + plane_size + plane_size/4, v, plane_size/4);
-			mlt_properties_set_int( properties, "colorspace", 601 );
-			break;
-		}
-		case mlt_image_yuv422:
-		{
-			int uneven = *width % 2;
-			int count = ( *width - uneven ) / 2 + 1;
-			uint8_t y, u, v;
-
-			RGB2YUV_601_SCALED( color.r, color.g, color.b, y, u, v );
-			i = *height + 1;
-			while ( --i )
-			{
-				int j = count;
-				while ( --j )
-				{
-					*p ++ = y;
-					*p ++ = u;
-					*p ++ = y;
-					*p ++ = v;
-				}
-				if ( uneven )
-				{
-					*p ++ = y;
-					*p ++ = u;
-				}
-			}
-			mlt_properties_set_int( properties, "colorspace", 601 );
-			break;
-		}
-		case mlt_image_rgb:
-			while ( --i )
-			{
-				*p ++ = color.r;
-				*p ++ = color.g;
-				*p ++ = color.b;
-			}
-			break;
-		case mlt_image_movit:
-		case mlt_image_opengl_texture:
-			memset(p, 0, size);
-			break;
-		case mlt_image_rgba:
-			while ( --i )
-			{
-				*p ++ = color.r;
-				*p ++ = color.g;
-				*p ++ = color.b;
-				*p ++ = color.a;
-			}
-			break;
-		default:
-			mlt_log_error( MLT_PRODUCER_SERVICE( producer ),
-				"invalid image format %s\n", mlt_image_format_name( *format ) );
-		}
-	}
-	else
-	{
-		mlt_service_unlock( MLT_PRODUCER_SERVICE( producer ) );
-	}
+	// Get the image of this colour, format and size, shared by all colour producers
+	int size = 0;
+	uint8_t *image = get_image( producer, color, *format, *width, *height, &size );
+	if ( *format == mlt_image_yuv420p || *format == mlt_image_yuv422 )
+		mlt_properties_set_int( properties, "colorspace", 601 );
 
 	// Create the alpha channel
 	int alpha_size = 0;
@@ -208,15 +282,23 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 			alpha_size = 0;
 	}
 
-	// Clone our image
+	// Share our image, the frame copies it only if it is asked to be writable
 	if (buffer && image && size > 0) {
-		*buffer = mlt_pool_alloc( size );
-		memcpy( *buffer, image, size );
+		*buffer = image;
+		mlt_frame_set_image( frame, *buffer, size, mlt_image_buffer_release );
+	} else {
+		mlt_image_buffer_release( image );
 	}
-
-	// Now update properties so we free the copy after
-	mlt_frame_set_image( frame, *buffer, size, mlt_pool_release );
 	mlt_frame_set_alpha( frame, alpha, alpha_size, mlt_pool_release );
+
+	// Tell compositors that a transparent colour covers nothing and an opaque one everything
+	if ( *format != mlt_image_movit && *format != mlt_image_opengl_texture )
+	{
+		mlt_rect bounds = { 0, 0, *width, *height, 1.0 };
+		if ( color.a == 0 )
+			bounds.w = bounds.h = 0;
+		mlt_frame_set_alpha_bounds( frame, bounds, color.a == 255 );
+	}
 	mlt_properties_set_double( properties, "aspect_ratio", mlt_properties_get_double( producer_props, "aspect_ratio" ) );
 	mlt_properties_set_int( properties, "meta.media.width", *width );
 	mlt_properties_set_int( properties, "meta.media.height", *height );
@@ -21,6 +21,7 @@
 
 #define CONSUMER_PROPERTIES_PREFIX "consumer."
 #define PRODUCER_PROPERTIES_PREFIX "producer."
+#define MAX_STALE_FRAMES (3)
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -34,6 +35,8 @@ struct context_s {
 	mlt_profile profile;
 	int64_t audio_counter;
 	mlt_position audio_position;
+	int is_threaded;
+	mlt_position next_position;
 };
 typedef struct context_s *context; 
 
@@ -47,15 +50,25 @@ static int get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format
 	*height = cx->profile->height;
 
 	int result = mlt_frame_get_image( nested_frame, image, format, width, height, writable );
-
-	// Allocate the image
 	int size = mlt_image_format_size( *format, *width, *height, NULL );
-	uint8_t *new_image = mlt_pool_alloc( size );
+	uint8_t *new_image = NULL;
+
+	// Share the image unless it is about to be written anyway
+	if ( !writable )
+		new_image = mlt_frame_share_image( nested_frame, NULL );
 
 	// Update the frame
 	mlt_properties properties = mlt_frame_properties( frame );
-	mlt_frame_set_image( frame, new_image, size, mlt_pool_release );
-	memcpy( new_image, *image, size );
+	if ( new_image )
+	{
+		mlt_frame_set_image( frame, new_image, size, mlt_image_buffer_release );
+	}
+	else
+	{
+		new_image = mlt_pool_alloc( size );
+		mlt_frame_set_image( frame, new_image, size, mlt_pool_release );
+		memcpy( new_image, *image, size );
+	}
 	mlt_properties_set( properties, "progressive", mlt_properties_get( MLT_FRAME_PROPERTIES(nested_frame), "progressive" ) );
 	*image = new_image;
 	
@@ -122,6 +135,40 @@ static void property_changed( mlt_properties owner, mlt_consumer self, mlt_event
 			mlt_properties_get( properties, name ));
 }
 
+/** Get a frame from the read ahead of the nested consumer.
+ *
+ * The nested producer plays on from the requested position while the outer
+ * playhead moves one frame at a time, so the threads of the nested consumer
+ * render the next frames ahead. Any other move restarts the read ahead.
+ */
+
+static mlt_frame get_nested_frame( context cx, mlt_position position, double speed )
+{
+	// Play along only when the nested frames match the outer ones one for one
+	double nested_speed = ( speed == 1.0 && mlt_profile_fps( cx->profile ) == mlt_producer_get_fps( cx->self ) ) ? 1.0 : 0.0;
+	int tries = 0;
+
+	if ( position != cx->next_position || nested_speed != mlt_producer_get_speed( cx->producer ) )
+	{
+		mlt_producer_set_speed( cx->producer, nested_speed );
+		mlt_producer_seek( cx->producer, position );
+		mlt_consumer_purge( cx->consumer );
+	}
+
+	// Drop a frame that was in flight for the previous position
+	mlt_frame nested_frame = mlt_consumer_rt_frame( cx->consumer );
+	while ( nested_frame && mlt_frame_get_position( nested_frame ) != position && tries++ < MAX_STALE_FRAMES )
+	{
+		mlt_frame_close( nested_frame );
+		mlt_producer_seek( cx->producer, position );
+		mlt_consumer_purge( cx->consumer );
+		nested_frame = mlt_consumer_rt_frame( cx->consumer );
+	}
+	cx->next_position = nested_speed != 0.0 ? position + 1 : position;
+
+	return nested_frame;
+}
+
 static int get_frame( mlt_producer self, mlt_frame_ptr frame, int index )
 {
 	mlt_properties properties = MLT_PRODUCER_PROPERTIES(self);
@@ -164,6 +211,8 @@ static int get_frame( mlt_producer self, mlt_frame_ptr frame, int index )
 		// Since we control the seeking, prevent it from seeking on its own
 		mlt_producer_set_speed( cx->producer, 0 );
 		cx->audio_position = -1;
+		cx->is_threaded = mlt_properties_get_int( properties, "real_time" ) != 0;
+		cx->next_position = -1;
 
 		// We will encapsulate a consumer
 		cx->consumer = mlt_consumer_new( cx->profile );
@@ -193,11 +242,19 @@ static int get_frame( mlt_producer self, mlt_frame_ptr frame, int index )
 		if ( mlt_producer_get_speed( self ) != 0 )
 			actual_position *= mlt_producer_get_speed( self );
 		mlt_position need_first = floor( actual_position );
-		mlt_producer_seek( cx->producer,
-			lrint( need_first * mlt_profile_fps( cx->profile ) / mlt_producer_get_fps( self ) ) );
+		mlt_position nested_position = lrint( need_first * mlt_profile_fps( cx->profile ) / mlt_producer_get_fps( self ) );
 
 		// Get the nested frame
-		mlt_frame nested_frame = mlt_consumer_rt_frame( cx->consumer );
+		mlt_frame nested_frame = NULL;
+		if ( cx->is_threaded )
+		{
+			nested_frame = get_nested_frame( cx, nested_position, mlt_producer_get_speed( self ) );
+		}
+		else
+		{
+			mlt_producer_seek( cx->producer, nested_position );
+			nested_frame = mlt_consumer_rt_frame( cx->consumer );
+		}
 
 		// Stack the producer and our methods on the nested frame
 		mlt_frame_push_service( *frame, nested_frame );
@@ -76,53 +76,116 @@ mlt_producer producer_hold_init( mlt_profile profile, mlt_service_type type, con
 	return self;
 }
 
+/** The number of other formats and sizes of the held image that are kept */
+
+#define MAX_HELD_IMAGES 4
+
+/** Render the image of a frame of the held producer, as the first get_image asks. */
+
+static int render_held( mlt_frame held, mlt_properties properties, mlt_image_format *format, int *width, int *height )
+{
+	uint8_t *buffer = NULL;
+
+	mlt_properties_pass( MLT_FRAME_PROPERTIES( held ), properties, "" );
+
+	// We'll deinterlace on the downstream deinterlacer
+	mlt_properties_set_int( MLT_FRAME_PROPERTIES( held ), "consumer_deinterlace", 1 );
+
+	// We want distorted to ensure we don't hit the resize filter twice
+	mlt_properties_set_int( MLT_FRAME_PROPERTIES( held ), "distort", 1 );
+
+	// Get the image
+	return mlt_frame_get_image( held, &buffer, format, width, height, 0 ) || !buffer;
+}
+
+/** Find the frame that holds the image for a format and size, rendering it if none does.
+ *
+ * The real frame renders the first request. Other formats and sizes get a
+ * frame of their own from the producer, kept with the real frame, so that
+ * each one is only decoded and scaled once.
+ */
+
+static mlt_frame get_held( mlt_producer self, mlt_frame real_frame, mlt_properties properties, mlt_image_format *format, int *width, int *height )
+{
+	mlt_properties real_properties = MLT_FRAME_PROPERTIES( real_frame );
+	char key[64];
+
+	snprintf( key, sizeof( key ), "_held.%d.%dx%d", *format, *width, *height );
+
+	// If this is the first time, get it from the real frame
+	if ( !mlt_properties_get( real_properties, "_held" ) )
+	{
+		mlt_properties_set( real_properties, "_held", key );
+		render_held( real_frame, properties, format, width, height );
+		return real_frame;
+	}
+	if ( !strcmp( mlt_properties_get( real_properties, "_held" ), key ) )
+		return real_frame;
+
+	mlt_frame held = mlt_properties_get_data( real_properties, key, NULL );
+	if ( !held )
+	{
+		mlt_properties self_properties = MLT_PRODUCER_PROPERTIES( self );
+		mlt_producer producer = mlt_properties_get_data( self_properties, "producer", NULL );
+		int count = mlt_properties_get_int( real_properties, "_held_count" );
+
+		// Forget the other images rather than keep one for every size asked
+		if ( count >= MAX_HELD_IMAGES )
+		{
+			for ( int i = 0; i < mlt_properties_count( real_properties ); i++ )
+				if ( !strncmp( mlt_properties_get_name( real_properties, i ), "_held.", 6 ) )
+					mlt_properties_set_data( real_properties, mlt_properties_get_name( real_properties, i ), NULL, 0, NULL, NULL );
+			count = 0;
+		}
+
+		mlt_producer_seek( producer, mlt_properties_get_position( self_properties, "_held_frame" ) );
+		if ( mlt_service_get_frame( MLT_PRODUCER_SERVICE( producer ), &held, 0 ) || !held )
+			return real_frame;
+		mlt_properties_set( MLT_FRAME_PROPERTIES( held ), "deinterlace_method",
+			mlt_properties_get( real_properties, "deinterlace_method" ) );
+		if ( render_held( held, properties, format, width, height ) )
+		{
+			mlt_frame_close( held );
+			return real_frame;
+		}
+		mlt_properties_set_data( real_properties, key, held, 0, ( mlt_destructor )mlt_frame_close, NULL );
+		mlt_properties_set_int( real_properties, "_held_count", count + 1 );
+	}
+	return held;
+}
+
 static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_format *format, int *width, int *height, int writable )
 {
 	// Get the properties of the frame
 	mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
 
-	// Obtain the real frame
+	// Obtain the real frame and this producer
 	mlt_frame real_frame = mlt_frame_pop_service( frame );
+	mlt_producer self = mlt_frame_pop_service( frame );
 
-	// Get the image from the real frame
-	int size = 0;
-	*buffer = mlt_properties_get_data( MLT_FRAME_PROPERTIES( real_frame ), "image", &size );
-	*width = mlt_properties_get_int( MLT_FRAME_PROPERTIES( real_frame ), "width" );
-	*height = mlt_properties_get_int( MLT_FRAME_PROPERTIES( real_frame ), "height" );
+	// The held image is shared between frames, so keep it in system memory
+	if ( *format == mlt_image_hwframe )
+		*format = mlt_image_yuv422;
 
-	// If this is the first time, get it from the producer
-	if ( *buffer == NULL )
-	{
-		mlt_properties_pass( MLT_FRAME_PROPERTIES( real_frame ), properties, "" );
+	mlt_service_lock( MLT_PRODUCER_SERVICE( self ) );
 
-		// We'll deinterlace on the downstream deinterlacer
-		mlt_properties_set_int( MLT_FRAME_PROPERTIES( real_frame ), "consumer_deinterlace", 1 );
+	// Get the frame with the image rendered for this request
+	mlt_frame held = get_held( self, real_frame, properties, format, width, height );
+	mlt_properties held_properties = MLT_FRAME_PROPERTIES( held );
 
-		// We want distorted to ensure we don't hit the resize filter twice
-		mlt_properties_set_int( MLT_FRAME_PROPERTIES( real_frame ), "distort", 1 );
+	mlt_properties_pass( properties, held_properties, "" );
 
-		// Get the image
-		mlt_frame_get_image( real_frame, buffer, format, width, height, writable );
-	
-		// Make sure we get the size
-		*buffer = mlt_properties_get_data( MLT_FRAME_PROPERTIES( real_frame ), "image", &size );
-	}
+	// Share the held image instead of copying it for every frame
+	int size = 0;
+	*buffer = mlt_frame_share_image( held, &size );
+	*format = mlt_properties_get_int( held_properties, "format" );
+	*width = mlt_properties_get_int( held_properties, "width" );
+	*height = mlt_properties_get_int( held_properties, "height" );
 
-	mlt_properties_pass( properties, MLT_FRAME_PROPERTIES( real_frame ), "" );
+	mlt_service_unlock( MLT_PRODUCER_SERVICE( self ) );
 
-	// Set the values obtained on the frame
 	if ( *buffer != NULL )
-	{
-		uint8_t *image = mlt_pool_alloc( size );
-		memcpy( image, *buffer, size );
-		*buffer = image;
-		mlt_frame_set_image( frame, *buffer, size, mlt_pool_release );
-	}
-	else
-	{
-		// Pass the current image as is
-		mlt_frame_set_image( frame, *buffer, size, NULL );
-	}
+		mlt_frame_set_image( frame, *buffer, size, mlt_image_buffer_release );
 
 	// Make sure that no further scaling is done
 	mlt_properties_set( properties, "rescale.interps", "none" );
@@ -146,15 +209,22 @@ static int producer_get_frame( mlt_producer producer, mlt_frame_ptr frame, int i
 		// Define the real frame
 		mlt_frame real_frame = mlt_properties_get_data( properties, "real_frame", NULL );
 
+		// Get the frame position requested
+		mlt_position position = mlt_properties_get_position( properties, "frame" );
+
+		// The held images are only valid for the frame they were rendered from
+		if ( real_frame && position != mlt_properties_get_position( properties, "_held_frame" ) )
+		{
+			mlt_properties_set_data( properties, "real_frame", NULL, 0, NULL, NULL );
+			real_frame = NULL;
+		}
+
 		// Obtain real frame if we don't have it
 		if ( real_frame == NULL )
 		{
 			// Get the producer
 			mlt_producer producer = mlt_properties_get_data( properties, "producer", NULL );
 
-			// Get the frame position requested
-			mlt_position position = mlt_properties_get_position( properties, "frame" );
-
 			// Seek the producer to the correct place
 			mlt_producer_seek( producer, position );
 
@@ -163,6 +233,7 @@ static int producer_get_frame( mlt_producer producer, mlt_frame_ptr frame, int i
 
 			// Ensure that the real frame gets wiped eventually
 			mlt_properties_set_data( properties, "real_frame", real_frame, 0, ( mlt_destructor )mlt_frame_close, NULL );
+			mlt_properties_set_position( properties, "_held_frame", position );
 		}
 		else
 		{
@@ -172,7 +243,12 @@ static int producer_get_frame( mlt_producer producer, mlt_frame_ptr frame, int i
 			mlt_properties_set_int( MLT_FRAME_PROPERTIES( *frame ), "test_image", 0 );
 		}
 
-		// Stack the real frame and method
+		// Keep the real frame alive for this frame even if the held frame changes
+		mlt_properties_inc_ref( MLT_FRAME_PROPERTIES( real_frame ) );
+		mlt_properties_set_data( MLT_FRAME_PROPERTIES( *frame ), "_hold_real_frame", real_frame, 0, ( mlt_destructor )mlt_frame_close, NULL );
+
+		// Stack this producer, the real frame and method
+		mlt_frame_push_service( *frame, producer );
 		mlt_frame_push_service( *frame, real_frame );
 		mlt_frame_push_service( *frame, producer_get_image );
 
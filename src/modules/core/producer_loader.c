@@ -206,6 +206,91 @@ static void create_filter( mlt_profile profile, mlt_producer producer, char *eff
 	free( id );
 }
 
+/** The kinds of media that a producer can have, or that a normaliser works on */
+
+enum
+{
+	media_image = 1,
+	media_audio = 2,
+	media_any = media_image | media_audio
+};
+
+/** The normalisers of loader.ini that only work on one kind of media.
+ *
+ * Those not listed here are always attached.
+ */
+
+static const struct
+{
+	const char *name;
+	int media;
+}
+normaliser_media[] =
+{
+	{ "deinterlace", media_image },
+	{ "fieldorder", media_image },
+	{ "crop", media_image },
+	{ "rescaler", media_image },
+	{ "resizer", media_image },
+	{ "channels", media_audio },
+	{ "resampler", media_audio },
+	{ NULL, media_any }
+};
+
+static int get_normaliser_media( const char *name )
+{
+	int i;
+	for ( i = 0; normaliser_media[ i ].name; i ++ )
+		if ( !strcmp( normaliser_media[ i ].name, name ) )
+			break;
+	return normaliser_media[ i ].media;
+}
+
+/** Find out which kinds of media a producer can ever have.
+ *
+ * This uses the streams that the producer reports in its meta.media properties
+ * and otherwise the tags of its service metadata. When neither tells, it is
+ * assumed to have both.
+ */
+
+static int get_producer_media( mlt_producer producer )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( producer );
+	int streams = mlt_properties_get_int( properties, "meta.media.nb_streams" );
+	int result = 0;
+	int i;
+
+	if ( streams > 0 )
+	{
+		for ( i = 0; i < streams; i ++ )
+		{
+			char key[ 64 ];
+			snprintf( key, sizeof( key ), "meta.media.%d.stream.type", i );
+			const char *type = mlt_properties_get( properties, key );
+			if ( type && !strcmp( type, "video" ) )
+				result |= media_image;
+			else if ( type && !strcmp( type, "audio" ) )
+				result |= media_audio;
+		}
+	}
+	else if ( mlt_properties_get( properties, "mlt_service" ) )
+	{
+		mlt_properties metadata = mlt_repository_metadata( mlt_factory_repository( ),
+			mlt_service_producer_type, mlt_properties_get( properties, "mlt_service" ) );
+		mlt_properties tags = metadata ? mlt_properties_get_data( metadata, "tags", NULL ) : NULL;
+		for ( i = 0; tags && i < mlt_properties_count( tags ); i ++ )
+		{
+			const char *tag = mlt_properties_get_value( tags, i );
+			if ( tag && !strcmp( tag, "Video" ) )
+				result |= media_image;
+			else if ( tag && !strcmp( tag, "Audio" ) )
+				result |= media_audio;
+		}
+	}
+
+	return result ? result : media_any;
+}
+
 static void attach_normalisers( mlt_profile profile, mlt_producer producer )
 {
 	// Loop variable
@@ -223,12 +308,17 @@ static void attach_normalisers( mlt_profile profile, mlt_producer producer )
 		mlt_factory_register_for_clean_up( normalisers, ( mlt_destructor )mlt_properties_close );
 	}
 
+	// Normalisers for a kind of media that the producer never has could not do anything
+	int media = get_producer_media( producer );
+
 	// Apply normalisers
 	for ( i = 0; i < mlt_properties_count( normalisers ); i ++ )
 	{
 		int j = 0;
 		int created = 0;
 		char *value = mlt_properties_get_value( normalisers, i );
+		if ( !( get_normaliser_media( mlt_properties_get_name( normalisers, i ) ) & media ) )
+			continue;
 		mlt_tokeniser_parse_new( tokeniser, value, "," );
 		for ( j = 0; !created && j < mlt_tokeniser_count( tokeniser ); j ++ )
 			create_filter( profile, producer, mlt_tokeniser_get_string( tokeniser, j ), &created );
@@ -507,6 +507,9 @@ mlt_producer producer_melt_init( mlt_profile profile, mlt_service_type type, con
 			int backtrack = 0;
 			if ( !strcmp( argv[ i ], "-serialise" ) ||
 			     !strcmp( argv[ i ], "-consumer" ) ||
+			     !strcmp( argv[ i ], "-farm" ) ||
+			     !strcmp( argv[ i ], "-metrics" ) ||
+			     !strcmp( argv[ i ], "-metrics-interval" ) ||
 			     !strcmp( argv[ i ], "-profile" ) )
 			{
 				i += 2;
@@ -0,0 +1,471 @@
+/*
+ * producer_proxy.c -- play a producer from a low resolution proxy
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <framework/mlt.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+typedef enum
+{
+	proxy_queued = 0,
+	proxy_running,
+	proxy_done,
+	proxy_failed,
+	proxy_canceled
+} proxy_status;
+
+static const char *status_names[] = { "queued", "running", "done", "failed", "canceled" };
+
+/** A transcoding job, shared by the producer and the worker that runs it */
+
+typedef struct proxy_job_s
+{
+	pthread_mutex_t mutex;
+	int refs;
+	mlt_producer producer;  // NULL once the producer is closed
+	char *resource;
+	char *target;
+	int width;
+	int cancel;
+	proxy_status status;
+	struct proxy_job_s *next;
+} *proxy_job;
+
+/** The workers that transcode the proxies, shared by all of the proxy producers */
+
+static struct
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t *threads;
+	int count;
+	int closing;
+	proxy_job head;
+	proxy_job tail;
+} pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static void job_release( proxy_job job )
+{
+	pthread_mutex_lock( &job->mutex );
+	int refs = --job->refs;
+	pthread_mutex_unlock( &job->mutex );
+	if ( !refs )
+	{
+		pthread_mutex_destroy( &job->mutex );
+		free( job->resource );
+		free( job->target );
+		free( job );
+	}
+}
+
+// Mirror the state of a job on its producer, if it is still open
+static void job_report( proxy_job job, proxy_status status, int progress )
+{
+	pthread_mutex_lock( &job->mutex );
+	job->status = status;
+	if ( job->producer )
+	{
+		mlt_properties properties = MLT_PRODUCER_PROPERTIES( job->producer );
+		mlt_properties_set( properties, "proxy.status", status_names[ status ] );
+		if ( progress >= 0 )
+			mlt_properties_set_int( properties, "proxy.progress", progress );
+	}
+	pthread_mutex_unlock( &job->mutex );
+}
+
+// A job stops when its producer is closed or when MLT is closed
+static int job_canceled( proxy_job job )
+{
+	pthread_mutex_lock( &job->mutex );
+	int cancel = job->cancel;
+	pthread_mutex_unlock( &job->mutex );
+	pthread_mutex_lock( &pool.mutex );
+	cancel = cancel || pool.closing;
+	pthread_mutex_unlock( &pool.mutex );
+	return cancel;
+}
+
+static void on_fatal_error( mlt_properties owner, int *error )
+{
+	*error = 1;
+}
+
+/** Transcode the resource of a job to an intra only proxy next to the target.
+ *
+ * The proxy is written under a temporary name and renamed when it is complete,
+ * so a proxy file is never seen half written.
+ */
+
+static void job_run( proxy_job job )
+{
+	mlt_profile profile = mlt_profile_init( NULL );
+	mlt_producer producer = mlt_factory_producer( profile, NULL, job->resource );
+	mlt_consumer consumer = NULL;
+	char *temp = malloc( strlen( job->target ) + 10 );
+	struct timespec tm = { 0, 100 * 1000 * 1000 };
+	int error = 1;
+	int fatal = 0;
+
+	sprintf( temp, "%s.tmp.mkv", job->target );
+	job_report( job, proxy_running, 0 );
+	if ( producer )
+	{
+		// Keep the frame rate and display aspect ratio of the source at the proxy width
+		mlt_profile_from_producer( profile, producer );
+		if ( profile->width > job->width && profile->display_aspect_num > 0 )
+		{
+			profile->width = job->width & ~1;
+			profile->height = ( profile->width * profile->display_aspect_den / profile->display_aspect_num ) & ~1;
+			profile->sample_aspect_num = profile->display_aspect_num * profile->height;
+			profile->sample_aspect_den = profile->display_aspect_den * profile->width;
+		}
+		consumer = mlt_factory_consumer( profile, "avformat", temp );
+	}
+	if ( consumer )
+	{
+		mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+		int length = mlt_producer_get_playtime( producer );
+
+		mlt_properties_set( properties, "f", "matroska" );
+		mlt_properties_set( properties, "vcodec", "mjpeg" );
+		mlt_properties_set( properties, "pix_fmt", "yuvj422p" );
+		mlt_properties_set_int( properties, "qscale", 3 );
+		mlt_properties_set_int( properties, "an", 1 );
+		mlt_properties_set_int( properties, "real_time", -1 );
+		mlt_properties_set_int( properties, "terminate_on_pause", 1 );
+		mlt_events_listen( properties, &fatal, "consumer-fatal-error", (mlt_listener) on_fatal_error );
+		mlt_consumer_connect( consumer, MLT_PRODUCER_SERVICE( producer ) );
+		error = mlt_consumer_start( consumer );
+		while ( !error && !mlt_consumer_is_stopped( consumer ) )
+		{
+			if ( job_canceled( job ) )
+			{
+				mlt_consumer_stop( consumer );
+				break;
+			}
+			nanosleep( &tm, NULL );
+			if ( length > 0 )
+				job_report( job, proxy_running, 100 * mlt_producer_position( producer ) / length );
+		}
+		mlt_consumer_stop( consumer );
+		error = error || fatal || job_canceled( job );
+		mlt_consumer_close( consumer );
+	}
+	mlt_producer_close( producer );
+	mlt_profile_close( profile );
+
+	if ( !error && !rename( temp, job->target ) )
+	{
+		job_report( job, proxy_done, 100 );
+	}
+	else
+	{
+		remove( temp );
+		job_report( job, job_canceled( job ) ? proxy_canceled : proxy_failed, -1 );
+		mlt_log_warning( NULL, "[proxy] failed to make %s\n", job->target );
+	}
+	free( temp );
+}
+
+static void *pool_thread( void *arg )
+{
+#ifdef __linux__
+	// Threads have their own nice value on Linux, and the encoder threads inherit it
+	setpriority( PRIO_PROCESS, syscall( SYS_gettid ), 10 );
+#endif
+	while ( 1 )
+	{
+		pthread_mutex_lock( &pool.mutex );
+		while ( !pool.closing && !pool.head )
+			pthread_cond_wait( &pool.cond, &pool.mutex );
+		proxy_job job = pool.closing ? NULL : pool.head;
+		if ( job )
+		{
+			pool.head = job->next;
+			if ( !pool.head )
+				pool.tail = NULL;
+		}
+		pthread_mutex_unlock( &pool.mutex );
+		if ( !job )
+			break;
+		if ( !job_canceled( job ) )
+			job_run( job );
+		else
+			job_report( job, proxy_canceled, -1 );
+		job_release( job );
+	}
+	return NULL;
+}
+
+static void pool_close( void *arg )
+{
+	int i;
+
+	pthread_mutex_lock( &pool.mutex );
+	pool.closing = 1;
+	pthread_cond_broadcast( &pool.cond );
+	pthread_mutex_unlock( &pool.mutex );
+	for ( i = 0; i < pool.count; i++ )
+		pthread_join( pool.threads[i], NULL );
+	while ( pool.head )
+	{
+		proxy_job job = pool.head;
+		pool.head = job->next;
+		job_release( job );
+	}
+	pool.tail = NULL;
+	free( pool.threads );
+	pool.threads = NULL;
+	pool.count = 0;
+}
+
+/** Queue a job, starting the workers the first time.
+ *
+ * MLT_PROXY_THREADS sets the number of workers, 1 by default.
+ */
+
+static void pool_add( proxy_job job )
+{
+	pthread_mutex_lock( &pool.mutex );
+	if ( !pool.threads && !pool.closing )
+	{
+		const char *threads = getenv( "MLT_PROXY_THREADS" );
+		int count = threads ? atoi( threads ) : 1;
+		pool.threads = calloc( count > 0 ? count : 1, sizeof( pthread_t ) );
+		for ( pool.count = 0; pool.count < ( count > 0 ? count : 1 ); pool.count++ )
+			if ( pthread_create( &pool.threads[ pool.count ], NULL, pool_thread, NULL ) )
+				break;
+		mlt_factory_register_for_clean_up( &pool, pool_close );
+	}
+	job->refs++;
+	job->next = NULL;
+	if ( pool.tail )
+		pool.tail->next = job;
+	else
+		pool.head = job;
+	pool.tail = job;
+	pthread_cond_signal( &pool.cond );
+	pthread_mutex_unlock( &pool.mutex );
+}
+
+static int proxy_is_current( const char *resource, const char *target )
+{
+	struct stat source, proxy;
+
+	if ( stat( target, &proxy ) || !proxy.st_size )
+		return 0;
+	return stat( resource, &source ) || proxy.st_mtime >= source.st_mtime;
+}
+
+/** Start making the proxy, or use one that is already there.
+ */
+
+static void proxy_start( mlt_producer self )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self );
+	const char *resource = mlt_properties_get( properties, "resource" );
+	const char *target = mlt_properties_get( properties, "proxy.resource" );
+	proxy_job job = calloc( 1, sizeof( *job ) );
+
+	pthread_mutex_init( &job->mutex, NULL );
+	job->refs = 1;
+	job->producer = self;
+	job->resource = strdup( resource );
+	job->target = strdup( target );
+	job->width = mlt_properties_get_int( properties, "proxy.width" );
+	mlt_properties_set_data( properties, "_job", job, 0, NULL, NULL );
+
+	if ( proxy_is_current( resource, target ) )
+		job_report( job, proxy_done, 100 );
+	else
+		pool_add( job );
+}
+
+// Open the proxy when its job is done
+static mlt_producer get_proxy( mlt_producer self )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self );
+	mlt_producer proxy = mlt_properties_get_data( properties, "_proxy", NULL );
+	proxy_job job = mlt_properties_get_data( properties, "_job", NULL );
+
+	if ( !proxy && job && !mlt_properties_get_int( properties, "_proxy_failed" ) )
+	{
+		pthread_mutex_lock( &job->mutex );
+		int done = job->status == proxy_done;
+		pthread_mutex_unlock( &job->mutex );
+		if ( done )
+		{
+			proxy = mlt_factory_producer( mlt_service_profile( MLT_PRODUCER_SERVICE( self ) ), NULL, job->target );
+			if ( proxy )
+				mlt_properties_set_data( properties, "_proxy", proxy, 0, (mlt_destructor) mlt_producer_close, NULL );
+			else
+				mlt_properties_set_int( properties, "_proxy_failed", 1 );
+		}
+	}
+	return proxy;
+}
+
+static int producer_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
+	mlt_frame original = mlt_frame_pop_service( frame );
+	mlt_frame proxy = mlt_frame_pop_service( frame );
+	mlt_frame source = original;
+	int size = 0;
+
+	// Previews can ask for the proxy, while everything else gets the original
+	if ( proxy && mlt_properties_get_int( properties, "consumer_proxy" ) )
+		source = proxy;
+	mlt_properties_pass_list( MLT_FRAME_PROPERTIES( source ), properties,
+		"consumer_deinterlace, deinterlace_method, rescale.interp, consumer_tff, consumer_color_trc, distort" );
+	int error = mlt_frame_get_image( source, image, format, width, height, writable );
+	if ( !error )
+	{
+		mlt_properties source_properties = MLT_FRAME_PROPERTIES( source );
+		mlt_properties_get_data( source_properties, "image", &size );
+		mlt_frame_set_image( frame, *image, size, NULL );
+		mlt_frame_set_alpha( frame, mlt_frame_get_alpha( source ), 0, NULL );
+		mlt_properties_pass_list( properties, source_properties,
+			"width, height, format, aspect_ratio, progressive, top_field_first, colorspace, full_luma" );
+	}
+	return error;
+}
+
+static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
+{
+	mlt_frame original = mlt_frame_pop_audio( frame );
+	int error = mlt_frame_get_audio( original, buffer, format, frequency, channels, samples );
+	if ( !error )
+		mlt_frame_set_audio( frame, *buffer, *format, 0, NULL );
+	return error;
+}
+
+static int producer_get_frame( mlt_producer self, mlt_frame_ptr frame, int index )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self );
+	mlt_producer original = mlt_properties_get_data( properties, "_original", NULL );
+	mlt_position position = mlt_producer_frame( self );
+	mlt_frame original_frame = NULL;
+	mlt_frame proxy_frame = NULL;
+	mlt_producer proxy;
+
+	// mlt_service_get_frame() holds the service lock here
+	if ( !mlt_properties_get_data( properties, "_job", NULL ) )
+		proxy_start( self );
+	proxy = get_proxy( self );
+
+	mlt_producer_seek( original, position );
+	mlt_service_get_frame( MLT_PRODUCER_SERVICE( original ), &original_frame, index );
+	if ( proxy )
+	{
+		mlt_producer_seek( proxy, position );
+		mlt_service_get_frame( MLT_PRODUCER_SERVICE( proxy ), &proxy_frame, index );
+	}
+
+	*frame = mlt_frame_init( MLT_PRODUCER_SERVICE( self ) );
+	if ( *frame && original_frame )
+	{
+		mlt_properties frame_properties = MLT_FRAME_PROPERTIES( *frame );
+
+		// The decoding is deferred, so getting both frames costs little
+		mlt_properties_pass( frame_properties, MLT_FRAME_PROPERTIES( original_frame ), "" );
+		mlt_properties_set_data( frame_properties, "_original_frame", original_frame, 0, (mlt_destructor) mlt_frame_close, NULL );
+		mlt_properties_set_data( frame_properties, "_proxy_frame", proxy_frame, 0, (mlt_destructor) mlt_frame_close, NULL );
+		mlt_frame_push_service( *frame, proxy_frame );
+		mlt_frame_push_service( *frame, original_frame );
+		mlt_frame_push_get_image( *frame, producer_get_image );
+		mlt_frame_push_audio( *frame, original_frame );
+		mlt_frame_push_audio( *frame, producer_get_audio );
+		mlt_frame_set_position( *frame, mlt_producer_position( self ) );
+	}
+	else
+	{
+		mlt_frame_close( original_frame );
+		mlt_frame_close( proxy_frame );
+	}
+	mlt_producer_prepare_next( self );
+
+	return 0;
+}
+
+static void producer_close( mlt_producer self )
+{
+	proxy_job job = mlt_properties_get_data( MLT_PRODUCER_PROPERTIES( self ), "_job", NULL );
+
+	if ( job )
+	{
+		pthread_mutex_lock( &job->mutex );
+		job->producer = NULL;
+		job->cancel = job->status != proxy_done;
+		pthread_mutex_unlock( &job->mutex );
+		job_release( job );
+	}
+	self->close = NULL;
+	mlt_producer_close( self );
+	free( self );
+}
+
+/** Constructor for the proxy producer.
+ *
+ * This plays the producer of the resource, and transcodes it in the background
+ * to a small intra only proxy that consumers with the proxy property use instead.
+ */
+
+mlt_producer producer_proxy_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg )
+{
+	mlt_producer self = mlt_producer_new( profile );
+	mlt_producer original = arg ? mlt_factory_producer( profile, NULL, arg ) : NULL;
+
+	if ( self && original )
+	{
+		mlt_properties properties = MLT_PRODUCER_PROPERTIES( self );
+		char *target = malloc( strlen( arg ) + 20 );
+
+		sprintf( target, "%s.proxy.mkv", arg );
+		mlt_properties_set_data( properties, "_original", original, 0, (mlt_destructor) mlt_producer_close, NULL );
+		mlt_properties_set( properties, "resource", arg );
+		mlt_properties_set( properties, "proxy.resource", target );
+		mlt_properties_set_int( properties, "proxy.width", 640 );
+		mlt_properties_set( properties, "proxy.status", status_names[ proxy_queued ] );
+		mlt_properties_set_int( properties, "proxy.progress", 0 );
+		mlt_properties_pass_list( properties, MLT_PRODUCER_PROPERTIES( original ), "length, in, out, seekable, aspect_ratio" );
+		mlt_properties_pass( properties, MLT_PRODUCER_PROPERTIES( original ), "meta." );
+		free( target );
+		self->get_frame = producer_get_frame;
+		self->close = (mlt_destructor) producer_close;
+	}
+	else
+	{
+		if ( self )
+			mlt_producer_close( self );
+		mlt_producer_close( original );
+		self = NULL;
+	}
+	return self;
+}
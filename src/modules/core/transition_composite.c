@@ -18,6 +18,7 @@
  */
 
 #include "transition_composite.h"
+#include "composite_line_simd.h"
 #include <framework/mlt.h>
 #include <framework/mlt_luma_map.h>
 
@@ -122,30 +123,37 @@ static inline uint8_t sample_mix( uint8_t dest, uint8_t src, int mix )
 	return ( src * mix + dest * ( ( 1 << 16 ) - mix ) ) >> 16;
 }
 
+/** Composite the start of a line with the vectorised code, if any.
+ * \return the number of pixels done, by which the pointers have been advanced
+ */
+
+static inline int composite_line_simd_start( uint8_t **dest, uint8_t **src, int width, uint8_t **alpha_b, uint8_t **alpha_a, int weight, uint16_t *luma, int soft, uint32_t step, composite_line_op op )
+{
+	const composite_line_simd *simd = composite_line_simd_get();
+	int j = 0;
+
+	if ( op == composite_line_over && !luma && simd->blend_simple )
+		j = simd->blend_simple( *dest, *src, width, *alpha_b, *alpha_a, weight );
+	else if ( simd->blend )
+		j = simd->blend( *dest, *src, width, *alpha_b, *alpha_a, weight, luma, soft, step, op );
+	*dest += j * 2;
+	*src += j * 2;
+	if ( *alpha_a )
+		*alpha_a += j;
+	if ( *alpha_b )
+		*alpha_b += j;
+	return j;
+}
+
 /** Composite a source line over a destination line
 */
-#if defined(USE_SSE) && defined(ARCH_X86_64)
-void composite_line_yuv_sse2_simple(uint8_t *dest, uint8_t *src, int width, uint8_t *alpha_b, uint8_t *alpha_a, int weight);
-#endif
 
 void composite_line_yuv( uint8_t *dest, uint8_t *src, int width, uint8_t *alpha_b, uint8_t *alpha_a, int weight, uint16_t *luma, int soft, uint32_t step )
 {
-	register int j = 0;
+	register int j;
 	register int mix;
 
-#if defined(USE_SSE) && defined(ARCH_X86_64)
-	if ( !luma && width > 7 )
-	{
-		composite_line_yuv_sse2_simple(dest, src, width, alpha_b, alpha_a, weight);
-		j = width - width % 8;
-		dest += j * 2;
-		src += j * 2;
-		if ( alpha_a )
-			alpha_a += j;
-		if ( alpha_b )
-			alpha_b += j;
-	}
-#endif
+	j = composite_line_simd_start( &dest, &src, width, &alpha_b, &alpha_a, weight, luma, soft, step, composite_line_over );
 
 	for ( ; j < width; j ++ )
 	{
@@ -168,7 +176,9 @@ static void composite_line_yuv_or( uint8_t *dest, uint8_t *src, int width, uint8
 	register int j;
 	register int mix;
 
-	for ( j = 0; j < width; j ++ )
+	j = composite_line_simd_start( &dest, &src, width, &alpha_b, &alpha_a, weight, luma, soft, step, composite_line_or );
+
+	for ( ; j < width; j ++ )
 	{
 		mix = calculate_mix( luma, j, soft, weight, (alpha_b? *alpha_b : 255) | (alpha_a? *alpha_a : 255), step );
 		*dest = sample_mix( *dest, *src++, mix );
@@ -185,7 +195,9 @@ static void composite_line_yuv_and( uint8_t *dest, uint8_t *src, int width, uint
 	register int j;
 	register int mix;
 
-	for ( j = 0; j < width; j ++ )
+	j = composite_line_simd_start( &dest, &src, width, &alpha_b, &alpha_a, weight, luma, soft, step, composite_line_and );
+
+	for ( ; j < width; j ++ )
 	{
 		mix = calculate_mix( luma, j, soft, weight, (alpha_b? *alpha_b : 255) & (alpha_a? *alpha_a : 255), step );
 		*dest = sample_mix( *dest, *src++, mix );
@@ -202,7 +214,9 @@ static void composite_line_yuv_xor( uint8_t *dest, uint8_t *src, int width, uint
 	register int j;
 	register int mix;
 
-	for ( j = 0; j < width; j ++ )
+	j = composite_line_simd_start( &dest, &src, width, &alpha_b, &alpha_a, weight, luma, soft, step, composite_line_xor );
+
+	for ( ; j < width; j ++ )
 	{
 		mix = calculate_mix( luma, j, soft, weight, (alpha_b? *alpha_b : 255) ^ (alpha_a? *alpha_a : 255), step );
 		*dest = sample_mix( *dest, *src++, mix );
@@ -214,6 +228,79 @@ static void composite_line_yuv_xor( uint8_t *dest, uint8_t *src, int width, uint
 	}
 }
 
+/** Mix count samples of one plane of a 16-bit image.
+*/
+
+static void blend16( uint16_t *dest, const uint16_t *src, const int32_t *mix, int count )
+{
+	const composite_line_simd *simd = composite_line_simd_get();
+	int j = simd->blend16 ? simd->blend16( dest, src, mix, count ) : 0;
+
+	for ( ; j < count; j ++ )
+		dest[ j ] += ( ( src[ j ] - dest[ j ] ) * ( mix[ j ] >> 1 ) ) >> 15;
+}
+
+/** Mix the planes of a line of yuv422p16 images with a mix for each pixel.
+ * The line starts at an even pixel. U takes the mix of the first pixel of each
+ * pair and V that of the second one, like the bytes of composite_line_yuv, so
+ * the V of a last pixel without its pair is left as it is.
+ */
+
+void composite_line_mix_yuv16( uint16_t *dest[ 3 ], uint16_t *src[ 3 ], const int32_t *mix, int width )
+{
+	int32_t mix_u[ COMPOSITE_LINE16_PIXELS / 2 ], mix_v[ COMPOSITE_LINE16_PIXELS / 2 ];
+	int start, j;
+
+	blend16( dest[ 0 ], src[ 0 ], mix, width );
+	for ( start = 0; start < width; start += COMPOSITE_LINE16_PIXELS )
+	{
+		int count = MIN( width - start, COMPOSITE_LINE16_PIXELS );
+		int chroma = ( count + 1 ) / 2;
+
+		for ( j = 0; j < chroma; j ++ )
+		{
+			mix_u[ j ] = mix[ start + 2 * j ];
+			mix_v[ j ] = 2 * j + 1 < count ? mix[ start + 2 * j + 1 ] : 0;
+		}
+		blend16( dest[ 1 ] + start / 2, src[ 1 ] + start / 2, mix_u, chroma );
+		blend16( dest[ 2 ] + start / 2, src[ 2 ] + start / 2, mix_v, chroma );
+	}
+}
+
+/** Composite a source line over a destination line of yuv422p16 images
+ * with the same mix and alpha as the yuv422 line functions for the operator.
+ */
+
+void composite_line_yuv16( uint16_t *dest[ 3 ], uint16_t *src[ 3 ], int width, uint8_t *alpha_b, uint8_t *alpha_a, int weight, uint16_t *luma, int soft, uint32_t step, composite_line_op op )
+{
+	int32_t mix[ COMPOSITE_LINE16_PIXELS ];
+	int start, j;
+
+	for ( start = 0; start < width; start += COMPOSITE_LINE16_PIXELS )
+	{
+		int count = MIN( width - start, COMPOSITE_LINE16_PIXELS );
+		uint16_t *d[ 3 ] = { dest[ 0 ] + start, dest[ 1 ] + start / 2, dest[ 2 ] + start / 2 };
+		uint16_t *s[ 3 ] = { src[ 0 ] + start, src[ 1 ] + start / 2, src[ 2 ] + start / 2 };
+
+		for ( j = 0; j < count; j ++ )
+		{
+			int b = alpha_b ? alpha_b[ start + j ] : 255;
+			int a = alpha_a ? alpha_a[ start + j ] : 255;
+
+			if ( op == composite_line_or )
+				b |= a;
+			else if ( op == composite_line_and )
+				b &= a;
+			else if ( op == composite_line_xor )
+				b ^= a;
+			mix[ j ] = calculate_mix( luma, start + j, soft, weight, b, step );
+			if ( alpha_a )
+				alpha_a[ start + j ] = op == composite_line_over ? ( mix[ j ] >> 8 ) | a : mix[ j ] >> 8;
+		}
+		composite_line_mix_yuv16( d, s, mix, count );
+	}
+}
+
 struct sliced_composite_desc
 {
 	int height_src;
@@ -259,22 +346,25 @@ static int sliced_composite_proc( int id, int idx, int jobs, void* cookie )
 	return 0;
 }
 
-/** Composite function.
+/** The part of the source and destination that a composite covers.
 */
 
-static int composite_yuv( uint8_t *p_dest, int width_dest, int height_dest, uint8_t *p_src, int width_src, int height_src, uint8_t *alpha_b, uint8_t *alpha_a, const struct geometry_s *geometry, int field, uint16_t *p_luma, double softness, composite_line_fn line_fn, int sliced )
+struct composite_area
+{
+	int x, y;
+	int x_src, y_src;
+	int width_src, height_src;
+	int uneven_x, uneven_x_src; // the parity of x and x_src before cropping
+};
+
+/** Crop the source to the part that lands on the destination.
+ * \return false if there is nothing to composite
+ */
+
+static int composite_clip( const struct geometry_s *geometry, int width_dest, int height_dest, int width_src, int height_src, struct composite_area *area )
 {
-	int ret = 0;
-	int i;
 	int x_src = -geometry->x_src, y_src = -geometry->y_src;
 	int uneven_x_src = ( x_src % 2 );
-	int step = ( field > -1 ) ? 2 : 1;
-	int bpp = 2;
-	int stride_src = geometry->sw * bpp;
-	int stride_dest = width_dest * bpp;
-	int i_softness = ( 1 << 16 ) * softness;
-	int weight = ( ( 1 << 16 ) * geometry->item.o + 50 ) / 100;
-	uint32_t luma_step = ( ( ( 1 << 16 ) - 1 ) * geometry->item.o + 50 ) / 100 * ( 1.0 + softness );
 
 	// Adjust to consumer scale
 	int x = rint( geometry->item.x * width_dest / geometry->nw );
@@ -283,10 +373,10 @@ static int composite_yuv( uint8_t *p_dest, int width_dest, int height_dest, uint
 
 	// optimization points - no work to do
 	if ( width_src <= 0 || height_src <= 0 || y_src >= height_src || x_src >= width_src )
-		return ret;
+		return 0;
 
 	if ( ( x < 0 && -x >= width_src ) || ( y < 0 && -y >= height_src ) )
-		return ret;
+		return 0;
 
 	// cropping affects the source width
 	if ( x_src > 0 )
@@ -330,6 +420,34 @@ static int composite_yuv( uint8_t *p_dest, int width_dest, int height_dest, uint
 	if ( y + height_src > height_dest )
 		height_src = height_dest - y;
 
+	*area = (struct composite_area) { x, y, x_src, y_src, width_src, height_src, uneven_x, uneven_x_src };
+	return 1;
+}
+
+/** Composite function.
+*/
+
+static int composite_yuv( uint8_t *p_dest, int width_dest, int height_dest, uint8_t *p_src, int width_src, int height_src, uint8_t *alpha_b, uint8_t *alpha_a, const struct geometry_s *geometry, int field, uint16_t *p_luma, double softness, composite_line_fn line_fn, int sliced, const mlt_rect *bounds )
+{
+	int ret = 0;
+	int i;
+	int step = ( field > -1 ) ? 2 : 1;
+	int bpp = 2;
+	int stride_src = geometry->sw * bpp;
+	int stride_dest = width_dest * bpp;
+	int i_softness = ( 1 << 16 ) * softness;
+	int weight = ( ( 1 << 16 ) * geometry->item.o + 50 ) / 100;
+	uint32_t luma_step = ( ( ( 1 << 16 ) - 1 ) * geometry->item.o + 50 ) / 100 * ( 1.0 + softness );
+	struct composite_area area;
+
+	if ( !composite_clip( geometry, width_dest, height_dest, width_src, height_src, &area ) )
+		return ret;
+
+	int x = area.x, y = area.y;
+	int x_src = area.x_src, y_src = area.y_src;
+	width_src = area.width_src;
+	height_src = area.height_src;
+
 	// offset pointer into overlay buffer based on cropping
 	p_src += x_src * bpp + y_src * stride_src;
 
@@ -374,12 +492,46 @@ static int composite_yuv( uint8_t *p_dest, int width_dest, int height_dest, uint
 	int alpha_b_stride = stride_src / bpp;
 	int alpha_a_stride = stride_dest / bpp;
 
-	// Align chroma of source and destination
-	if ( uneven_x != uneven_x_src )
+	// Align chroma of source and destination, staying within the source
+	if ( area.uneven_x != area.uneven_x_src )
 	{
 		p_src += 2;
 		if ( alpha_b )
 			alpha_b += 1;
+		width_src = MIN( width_src, geometry->sw - x_src - 1 );
+		x_src ++;
+	}
+
+	// Skip the columns and rows where the overlay is transparent. The vectorised
+	// blend leaves a pixel alone where b is transparent, but the scalar one for the
+	// last width % 8 pixels of each line does not, so those are always blended.
+	if ( bounds )
+	{
+		int empty = bounds->w <= 0 || bounds->h <= 0;
+		int tail = width_src % 8;
+		int left = empty ? width_src : MAX( (int) bounds->x - 2 - x_src, 0 );
+		int right = 0;
+		int top = 0;
+
+		// Keep the groups of 8 pixels of the vectorised blend
+		left = MIN( left, width_src - tail ) & ~7;
+		if ( tail == 0 )
+		{
+			int first_row = y_src + ( field == 1 );
+			right = MAX( x_src + width_src - (int) ceil( bounds->x + bounds->w ) - 2, 0 ) & ~7;
+			top = MAX( (int) bounds->y - 2 - first_row, 0 ) / step * step;
+			height_src = empty ? 0 : MIN( height_src, (int) ceil( bounds->y + bounds->h ) + 2 - first_row );
+		}
+		if ( left + right >= width_src || top >= height_src )
+			return ret;
+		p_src += left * bpp + top / step * stride_src;
+		p_dest += left * bpp + top / step * stride_dest;
+		if ( alpha_b )
+			alpha_b += left + top / step * alpha_b_stride;
+		if ( alpha_a )
+			alpha_a += left + top / step * alpha_a_stride;
+		width_src -= left + right;
+		height_src -= top;
 	}
 
 	// now do the compositing only to cropped extents
@@ -427,6 +579,158 @@ static int composite_yuv( uint8_t *p_dest, int width_dest, int height_dest, uint
 	return ret;
 }
 
+struct sliced_composite16_desc
+{
+	mlt_image dest;
+	mlt_image src;
+	int x, y;
+	int x_src, y_src;
+	int shift;              // the source pixels and alpha are one to the right of x_src
+	int width, height;
+	int step;
+	uint8_t *alpha_b;
+	uint8_t *alpha_a;
+	uint16_t *luma;
+	int weight;
+	int softness;
+	uint32_t luma_step;
+	composite_line_op op;
+};
+
+/** Composite the first pixel of a line at an odd x, which shares its chroma with
+ * the pixel before it, so it only mixes the luma and the V like composite_line_yuv.
+ */
+
+static void composite_first_yuv16( uint16_t *dest[ 3 ], uint16_t *src[ 3 ], uint8_t *alpha_b, uint8_t *alpha_a, int weight, uint16_t *luma, int soft, uint32_t step, composite_line_op op )
+{
+	int b = alpha_b ? *alpha_b : 255;
+	int a = alpha_a ? *alpha_a : 255;
+	int32_t mix;
+
+	if ( op == composite_line_or )
+		b |= a;
+	else if ( op == composite_line_and )
+		b &= a;
+	else if ( op == composite_line_xor )
+		b ^= a;
+	mix = calculate_mix( luma, 0, soft, weight, b, step );
+	if ( alpha_a )
+		*alpha_a = op == composite_line_over ? ( mix >> 8 ) | a : mix >> 8;
+	blend16( dest[ 0 ], src[ 0 ], &mix, 1 );
+	blend16( dest[ 2 ], src[ 2 ], &mix, 1 );
+}
+
+static int sliced_composite16_proc( int id, int idx, int jobs, void* cookie )
+{
+	struct sliced_composite16_desc *ctx = (struct sliced_composite16_desc*) cookie;
+	int rows = ( ctx->height + ctx->step - 1 ) / ctx->step;
+	int slice = ( rows + jobs - 1 ) / jobs;
+	int end = MIN( slice * ( idx + 1 ), rows );
+	int x_src = ctx->x_src + ctx->shift;
+	int first = ctx->x & 1;
+	int n, p;
+
+	for ( n = slice * idx; n < end; n ++ )
+	{
+		int row = ctx->y + n * ctx->step;
+		int row_src = ctx->y_src + n * ctx->step;
+		uint8_t *alpha_b = ctx->alpha_b ? ctx->alpha_b + row_src * ctx->src->width + x_src : NULL;
+		uint8_t *alpha_a = ctx->alpha_a ? ctx->alpha_a + row * ctx->dest->width + ctx->x : NULL;
+		uint16_t *luma = ctx->luma ? ctx->luma + row_src * ctx->src->width + ctx->x_src : NULL;
+		uint16_t *dest[ 3 ], *src[ 3 ];
+
+		for ( p = 0; p < 3; p ++ )
+		{
+			dest[ p ] = (uint16_t*) ( ctx->dest->planes[ p ] + row * ctx->dest->strides[ p ] ) + ( p ? ctx->x / 2 : ctx->x );
+			src[ p ] = (uint16_t*) ( ctx->src->planes[ p ] + row_src * ctx->src->strides[ p ] ) + ( p ? x_src / 2 : x_src );
+		}
+		if ( first )
+		{
+			composite_first_yuv16( dest, src, alpha_b, alpha_a, ctx->weight, luma, ctx->softness, ctx->luma_step, ctx->op );
+			if ( ctx->width == 1 )
+				continue;
+			// The rest of the line starts on a pair
+			dest[ 0 ] ++;
+			dest[ 1 ] ++;
+			dest[ 2 ] ++;
+			src[ 0 ] ++;
+			src[ 1 ] = (uint16_t*) ( ctx->src->planes[ 1 ] + row_src * ctx->src->strides[ 1 ] ) + ( x_src + 1 ) / 2;
+			src[ 2 ] = (uint16_t*) ( ctx->src->planes[ 2 ] + row_src * ctx->src->strides[ 2 ] ) + ( x_src + 1 ) / 2;
+			if ( alpha_b )
+				alpha_b ++;
+			if ( alpha_a )
+				alpha_a ++;
+			if ( luma )
+				luma ++;
+		}
+		composite_line_yuv16( dest, src, ctx->width - first, alpha_b, alpha_a, ctx->weight, luma, ctx->softness, ctx->luma_step, ctx->op );
+	}
+	return 0;
+}
+
+/** Composite function for yuv422p16 images.
+ * The source is placed as in composite_yuv, with its pixels and alpha one to the
+ * right when the parities of the positions differ, and a first pixel at an odd x
+ * only mixes its luma and the V it shares with the pixel before it.
+ */
+
+static int composite_yuv16( mlt_image dest, mlt_image src, int width_src, int height_src, uint8_t *alpha_b, uint8_t *alpha_a, const struct geometry_s *geometry, int field, uint16_t *p_luma, double softness, composite_line_op op, int sliced )
+{
+	struct composite_area area;
+
+	if ( !composite_clip( geometry, dest->width, dest->height, width_src, height_src, &area ) )
+		return 0;
+
+	// Align chroma of source and destination, staying within the source
+	int shift = area.uneven_x != area.uneven_x_src;
+	area.width_src = MIN( area.width_src, src->width - area.x_src - shift );
+
+	// Put the lines of each field on that field, as in composite_yuv
+	if ( ( field > -1 ) && ( area.y % 2 == field ) )
+	{
+		if ( ( field == 1 && area.y < dest->height - 1 ) || ( field == 0 && area.y == 0 ) )
+			area.y ++;
+		else
+			area.y --;
+	}
+	if ( field == 1 )
+	{
+		area.y_src ++;
+		area.height_src --;
+	}
+	area.height_src = MIN( area.height_src, dest->height - area.y );
+	if ( area.width_src <= 0 || area.height_src <= 0 )
+		return 0;
+
+	struct sliced_composite16_desc desc =
+	{
+		.dest = dest,
+		.src = src,
+		.x = area.x,
+		.y = area.y,
+		.x_src = area.x_src,
+		.y_src = area.y_src,
+		.shift = shift,
+		.width = area.width_src,
+		.height = area.height_src,
+		.step = ( field > -1 ) ? 2 : 1,
+		.alpha_b = alpha_b,
+		.alpha_a = alpha_a,
+		.luma = p_luma,
+		.weight = ( ( 1 << 16 ) * geometry->item.o + 50 ) / 100,
+		.softness = ( 1 << 16 ) * softness,
+		.luma_step = ( ( ( 1 << 16 ) - 1 ) * geometry->item.o + 50 ) / 100 * ( 1.0 + softness ),
+		.op = op,
+	};
+
+	if ( sliced )
+		mlt_slices_run_normal( 0, sliced_composite16_proc, &desc );
+	else
+		sliced_composite16_proc( 0, 0, 1, &desc );
+
+	return 0;
+}
+
 
 /** Scale 16bit greyscale luma map using nearest neighbor.
 */
@@ -496,6 +800,8 @@ static uint16_t* get_luma( mlt_transition self, mlt_properties properties, int w
 		if ( invert != old_invert || ( old_luma && old_luma[0] && strcmp( resource, old_luma ) ) )
 		{
 			mlt_properties_set_data( properties, "_luma.orig_bitmap", NULL, 0, NULL, NULL );
+			mlt_properties_clear( properties, "_luma.orig_item" );
+			mlt_properties_clear( properties, "_luma.key" );
 			luma_bitmap = NULL;
 		}
 	}
@@ -505,6 +811,9 @@ static uint16_t* get_luma( mlt_transition self, mlt_properties properties, int w
 		{
 			mlt_properties_set_data( properties, "_luma.orig_bitmap", NULL, 0, NULL, NULL );
 			mlt_properties_set_data( properties, "_luma.bitmap", NULL, 0, NULL, NULL );
+			mlt_properties_clear( properties, "_luma.orig_item" );
+			mlt_properties_clear( properties, "_luma.item" );
+			mlt_properties_clear( properties, "_luma.key" );
 			luma_bitmap = NULL;
 			mlt_properties_set( properties, "_luma", NULL);
 		}
@@ -521,26 +830,22 @@ static uint16_t* get_luma( mlt_transition self, mlt_properties properties, int w
 		{
 			char *extension = strrchr( resource, '.' );
 			
-			// See if it is a PGM
+			// See if it is a PGM or a saved luma map, which are loaded once for all transitions
 			int lumaLoaded = 0;
-			if ( extension != NULL && strcmp( extension, ".pgm" ) == 0 )
+			if ( extension != NULL && ( strcmp( extension, ".pgm" ) == 0 || strcmp( extension, ".luma16" ) == 0 ) )
 			{
-				// Load from PGM
-				if (mlt_luma_map_from_pgm( resource, &orig_bitmap, &luma_width, &luma_height )) {
-					// Failed to read file; generate it.
-					mlt_luma_map luma = mlt_luma_map_new(orig_resource);
-					if (profile) {
-						luma->w = profile->width;
-						luma->h = profile->height;
-					}
-					luma_bitmap = mlt_luma_map_render(luma);
-					luma_width = luma->w;
-					luma_height = luma->h;
-					free(luma);
-				}
-				if ( luma_width > 0 && luma_height > 0 ) {
+				mlt_cache_item item = mlt_luma_map_load( resource, orig_resource,
+					profile ? profile->width : 0, profile ? profile->height : 0, &orig_bitmap, &luma_width, &luma_height );
+				if ( item )
+				{
+					char key[ 1024 ];
+					snprintf( key, sizeof( key ), "%s %s %dx%d", resource, orig_resource,
+						profile ? profile->width : 0, profile ? profile->height : 0 );
+
 					// Remember the original size for subsequent scaling
-					mlt_properties_set_data( properties, "_luma.orig_bitmap", orig_bitmap, luma_width * luma_height * 2, mlt_pool_release, NULL );
+					mlt_properties_set_data( properties, "_luma.orig_bitmap", orig_bitmap, 0, NULL, NULL );
+					mlt_properties_set_data( properties, "_luma.orig_item", item, 0, ( mlt_destructor )mlt_cache_item_close, NULL );
+					mlt_properties_set( properties, "_luma.key", key );
 					mlt_properties_set_int( properties, "_luma.orig_width", luma_width );
 					mlt_properties_set_int( properties, "_luma.orig_height", luma_height );
 					lumaLoaded = 1;
@@ -585,6 +890,8 @@ static uint16_t* get_luma( mlt_transition self, mlt_properties properties, int w
 	
 						// Remember the original size for subsequent scaling
 						mlt_properties_set_data( properties, "_luma.orig_bitmap", orig_bitmap, luma_width * luma_height * 2, mlt_pool_release, NULL );
+						mlt_properties_clear( properties, "_luma.orig_item" );
+						mlt_properties_clear( properties, "_luma.key" );
 						mlt_properties_set_int( properties, "_luma.orig_width", luma_width );
 						mlt_properties_set_int( properties, "_luma.orig_height", luma_height );
 						
@@ -604,14 +911,42 @@ static uint16_t* get_luma( mlt_transition self, mlt_properties properties, int w
 		}
 		if ( orig_bitmap && luma_width > 0 && luma_height > 0 )
 		{
-			// Scale luma map
-			luma_bitmap = mlt_pool_alloc( width * height * sizeof( uint16_t ) );
-			scale_luma( luma_bitmap, width, height, orig_bitmap, luma_width, luma_height, invert * ( ( 1 << 16 ) - 1 ) );
+			const char *key = mlt_properties_get( properties, "_luma.key" );
+			mlt_cache_item item = NULL;
+
+			if ( key )
+			{
+				// Share the scaled map with the transitions that use the same file
+				char name[ 1100 ];
+				int scaled_width, scaled_height;
+
+				snprintf( name, sizeof( name ), "%s %dx%d %d", key, width, height, invert );
+				item = mlt_luma_map_cache_get( name, &luma_bitmap, &scaled_width, &scaled_height );
+				if ( !item && ( luma_bitmap = mlt_pool_alloc( width * height * sizeof( uint16_t ) ) ) )
+				{
+					scale_luma( luma_bitmap, width, height, orig_bitmap, luma_width, luma_height, invert * ( ( 1 << 16 ) - 1 ) );
+					scaled_width = width;
+					scaled_height = height;
+					item = mlt_luma_map_cache_put( name, &luma_bitmap, &scaled_width, &scaled_height );
+				}
+			}
+			if ( item )
+			{
+				mlt_properties_set_data( properties, "_luma.bitmap", luma_bitmap, 0, NULL, NULL );
+				mlt_properties_set_data( properties, "_luma.item", item, 0, ( mlt_destructor )mlt_cache_item_close, NULL );
+			}
+			else
+			{
+				// Scale luma map
+				luma_bitmap = mlt_pool_alloc( width * height * sizeof( uint16_t ) );
+				scale_luma( luma_bitmap, width, height, orig_bitmap, luma_width, luma_height, invert * ( ( 1 << 16 ) - 1 ) );
+				mlt_properties_set_data( properties, "_luma.bitmap", luma_bitmap, width * height * 2, mlt_pool_release, NULL );
+				mlt_properties_clear( properties, "_luma.item" );
+			}
 
 			// Remember the scaled luma size to prevent unnecessary scaling
 			mlt_properties_set_int( properties, "_luma.width", width );
 			mlt_properties_set_int( properties, "_luma.height", height );
-			mlt_properties_set_data( properties, "_luma.bitmap", luma_bitmap, width * height * 2, mlt_pool_release, NULL );
 			mlt_properties_set( properties, "_luma", resource );
 			mlt_properties_set_int( properties, "_luma_invert", invert );
 		}
@@ -622,10 +957,9 @@ static uint16_t* get_luma( mlt_transition self, mlt_properties properties, int w
 /** Get the properly sized image from b_frame.
 */
 
-static int get_b_frame_image( mlt_transition self, mlt_frame b_frame, uint8_t **image, int *width, int *height, struct geometry_s *geometry )
+static int get_b_frame_image( mlt_transition self, mlt_frame b_frame, uint8_t **image, mlt_image_format *format, int *width, int *height, struct geometry_s *geometry, const mlt_rect *roi )
 {
 	int error = 0;
-	mlt_image_format format = mlt_image_yuv422;
 
 	// Get the properties objects
 	mlt_properties b_props = MLT_FRAME_PROPERTIES( b_frame );
@@ -738,6 +1072,21 @@ static int get_b_frame_image( mlt_transition self, mlt_frame b_frame, uint8_t **
 		 mlt_properties_get( properties, "crop" ) == NULL )
 		alignment_calculate( geometry );
 
+	// Only the part of the b image inside the region of interest of the a image is needed
+	if ( roi && geometry->sw > 0 && geometry->sh > 0 && !mlt_properties_get_int( properties, "titles" ) &&
+		 !mlt_properties_get( properties, "crop" ) && !mlt_properties_get_int( properties, "crop_to_fill" ) )
+	{
+		double x0 = MAX( geometry->item.x, roi->x * geometry->nw );
+		double y0 = MAX( geometry->item.y, roi->y * geometry->nh );
+		double x1 = MIN( geometry->item.x + geometry->sw, ( roi->x + roi->w ) * geometry->nw );
+		double y1 = MIN( geometry->item.y + geometry->sh, ( roi->y + roi->h ) * geometry->nh );
+
+		// Allow a pixel on each side for rounding
+		mlt_rect b_roi = { ( x0 - geometry->item.x - 1 ) / geometry->sw, ( y0 - geometry->item.y - 1 ) / geometry->sh,
+			( x1 - x0 + 2 ) / geometry->sw, ( y1 - y0 + 2 ) / geometry->sh, 1.0 };
+		mlt_frame_set_roi( b_frame, b_roi );
+	}
+
 	// Adjust to consumer scale
 	*width = rint( geometry->sw * *width / geometry->nw );
 	*width -= *width % 2; // coerce to even width for yuv422
@@ -745,7 +1094,12 @@ static int get_b_frame_image( mlt_transition self, mlt_frame b_frame, uint8_t **
 // fprintf(stderr, "%s: scaled %dx%d norm %dx%d resize %dx%d\n", __FILE__,
 // geometry->sw, geometry->sh, geometry->nw, geometry->nh, *width, *height);
 
-	error = mlt_frame_get_image( b_frame, image, &format, width, height, 1 );
+	// The b image is only read, so a shared one need not be copied
+	error = mlt_frame_get_image( b_frame, image, format, width, height, 0 );
+
+	// The compositing is done in the format of the a image
+	if ( !error && *format == mlt_image_yuv422p16 && b_frame->convert_image )
+		error = b_frame->convert_image( b_frame, image, format, mlt_image_yuv422p16 );
 
 	// composite_yuv uses geometry->sw to determine source stride, which
 	// should equal the image width if not using crop property.
@@ -893,8 +1247,9 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		b_frame = c;
 	}
 
-	// This compositer is yuv422 only
-	*format = mlt_image_yuv422;
+	// This compositer is yuv422, or yuv422p16 for more than 8 bits
+	if ( *format != mlt_image_yuv422p16 )
+		*format = mlt_image_yuv422;
 
 	if ( b_frame != NULL )
 	{
@@ -913,6 +1268,7 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 
 		// Get the image from the b frame
 		uint8_t *image_b = NULL;
+		mlt_image_format format_b = *format;
 		mlt_profile profile = mlt_service_profile( MLT_TRANSITION_SERVICE( self ) );
 		int width_b = *width > 0 ? *width : profile->width;
 		int height_b = *height > 0 ? *height : profile->height;
@@ -921,6 +1277,14 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		uint8_t *alpha_a = NULL;
 		uint8_t *alpha_b = NULL;
 
+		// The region of the a image that is needed, of which b covers some when placed progressively
+		mlt_rect roi = { 0.0, 0.0, 1.0, 1.0, 1.0 };
+		if ( a_frame != b_frame && !mlt_properties_get_int( properties, "invert" ) )
+			mlt_frame_get_roi( a_frame, &roi );
+		const mlt_rect *b_roi = NULL;
+		if ( mlt_properties_get_int( a_props, "consumer_deinterlace" ) || mlt_properties_get_int( properties, "progressive" ) )
+			b_roi = &roi;
+
 		// Do the calculation
 		// NB: Locks needed here since the properties are being modified
 		mlt_service_lock( MLT_TRANSITION_SERVICE( self ) );
@@ -938,6 +1302,7 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		if ( mlt_properties_get_int( properties, "no_alpha" ) && 
 			 result.item.x == 0 && result.item.y == 0 && result.item.w == *width && result.item.h == *height && result.item.o == 100 )
 		{
+			mlt_frame_set_roi( b_frame, roi );
 			mlt_frame_get_image( b_frame, image, format, width, height, 1 );
 			if ( !mlt_frame_is_test_card( a_frame ) )
 				mlt_frame_replace_image( a_frame, *image, *format, *width, *height );
@@ -947,15 +1312,22 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		if ( a_frame == b_frame )
 		{
 			double aspect_ratio = mlt_frame_get_aspect_ratio( b_frame );
-			get_b_frame_image( self, b_frame, &image_b, &width_b, &height_b, &result );
+			get_b_frame_image( self, b_frame, &image_b, &format_b, &width_b, &height_b, &result, NULL );
 			alpha_b = mlt_frame_get_alpha( b_frame );
 			mlt_properties_set_double( a_props, "aspect_ratio", aspect_ratio );
 		}
 
 		// Get the image from the a frame
 		mlt_frame_get_image( a_frame, image, format, width, height, 1 );
+		if ( *format != mlt_image_yuv422 && *format != mlt_image_yuv422p16 && a_frame->convert_image )
+			a_frame->convert_image( a_frame, image, format, mlt_image_yuv422 );
+		format_b = a_frame == b_frame ? *format : format_b;
 		alpha_a = mlt_frame_get_alpha( a_frame );
 
+		// Give up if the consumer no longer wants this frame
+		if ( mlt_frame_is_cancelled( a_frame ) )
+			return 1;
+
 		// Optimisation - no compositing required
 		if ( result.item.o == 0 || ( result.item.w == 0 && result.item.h == 0 ) )
 			return 0;
@@ -984,8 +1356,16 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		}
 
 		if ( *image != image_b && ( image_b ||
-			get_b_frame_image( self, b_frame, &image_b, &width_b, &height_b, &result ) ) )
+			get_b_frame_image( self, b_frame, &image_b, &format_b, &width_b, &height_b, &result, b_roi ) ) )
 		{
+			// Without a 16-bit b image, both are composited in 8 bits
+			if ( format_b != *format && a_frame->convert_image )
+			{
+				a_frame->convert_image( a_frame, image, format, mlt_image_yuv422 );
+				if ( format_b != mlt_image_yuv422 && b_frame->convert_image )
+					b_frame->convert_image( b_frame, &image_b, &format_b, mlt_image_yuv422 );
+			}
+
 			int progressive = 
 					mlt_properties_get_int( a_props, "consumer_deinterlace" ) ||
 					mlt_properties_get_int( properties, "progressive" );
@@ -1001,17 +1381,37 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 
 			alpha_b = alpha_b == NULL ? mlt_frame_get_alpha( b_frame ) : alpha_b;
 
+			// Where the b image is transparent or opaque, as long as its alpha is its own
+			mlt_rect bounds_b;
+			int opaque_b = 0;
+			int stride_b = width_b;
+			int image_height_b = height_b;
+			int has_bounds_b = a_frame != b_frame && !mlt_properties_get( properties, "alpha_b" )
+				&& mlt_frame_get_alpha_bounds( b_frame, &bounds_b, &opaque_b );
+			if ( has_bounds_b && opaque_b )
+				alpha_b = NULL;
+
 			composite_line_fn line_fn = composite_line_yuv;
+			composite_line_op op = composite_line_over;
 
 			// Replacement and override
 			if ( operator != NULL )
 			{
 				if ( !strcmp( operator, "or" ) )
+				{
 					line_fn = composite_line_yuv_or;
+					op = composite_line_or;
+				}
 				if ( !strcmp( operator, "and" ) )
+				{
 					line_fn = composite_line_yuv_and;
+					op = composite_line_and;
+				}
 				if ( !strcmp( operator, "xor" ) )
+				{
 					line_fn = composite_line_yuv_xor;
+					op = composite_line_xor;
+				}
 			}
 
 			// Allow the user to completely obliterate the alpha channels from both frames
@@ -1071,7 +1471,20 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 
 				// Composite the b_frame on the a_frame
 				mlt_log_timings_begin()
-				composite_yuv( *image, *width, *height, image_b, width_b, height_b, alpha_b, alpha_a, &result, field_id, luma_bitmap, luma_softness, line_fn, sliced );
+				// Only the vectorised blend over leaves the a image alone where b is transparent
+				const mlt_rect *bounds = has_bounds_b && alpha_b && op == composite_line_over && !luma_bitmap
+					&& composite_line_simd_get()->blend_simple && result.sw == stride_b ? &bounds_b : NULL;
+				if ( *format == mlt_image_yuv422p16 && format_b == *format )
+				{
+					struct mlt_image_s dest, src;
+					mlt_image_set_values( &dest, *image, *format, *width, *height );
+					mlt_image_set_values( &src, image_b, format_b, stride_b, image_height_b );
+					composite_yuv16( &dest, &src, width_b, height_b, alpha_b, alpha_a, &result, field_id, luma_bitmap, luma_softness, op, sliced );
+				}
+				else
+				{
+					composite_yuv( *image, *width, *height, image_b, width_b, height_b, alpha_b, alpha_a, &result, field_id, luma_bitmap, luma_softness, line_fn, sliced, bounds );
+				}
 				mlt_log_timings_end( NULL, "composite_yuv" )
 			}
 		}
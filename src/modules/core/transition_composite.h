@@ -21,10 +21,19 @@
 #define _TRANSITION_COMPOSITE_H_
 
 #include <framework/mlt_transition.h>
+#include "composite_line_simd.h"
+
+/** How many pixels of a line the 16-bit line functions mix at a time */
+#define COMPOSITE_LINE16_PIXELS 256
 
 extern mlt_transition transition_composite_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 
 extern void composite_line_yuv( uint8_t *dest, uint8_t *src, int width, uint8_t *alpha_b,
                                 uint8_t *alpha_a, int weight, uint16_t *luma, int soft, uint32_t step );
 
+extern void composite_line_yuv16( uint16_t *dest[ 3 ], uint16_t *src[ 3 ], int width, uint8_t *alpha_b, uint8_t *alpha_a,
+                                  int weight, uint16_t *luma, int soft, uint32_t step, composite_line_op op );
+
+extern void composite_line_mix_yuv16( uint16_t *dest[ 3 ], uint16_t *src[ 3 ], const int32_t *mix, int width );
+
 #endif
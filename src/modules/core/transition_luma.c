@@ -28,7 +28,23 @@
 #include <ctype.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 #include "transition_composite.h"
+#include "composite_line_simd.h"
+
+static pthread_mutex_t luma_name_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Get a name that no other luma map has, for maps that are not shared.
+*/
+
+static void luma_unique_name( char *name, size_t size )
+{
+	static int count = 0;
+
+	pthread_mutex_lock( &luma_name_mutex );
+	snprintf( name, size, "luma #%d", ++count );
+	pthread_mutex_unlock( &luma_name_mutex );
+}
 
 static inline int is_opaque( uint8_t *alpha_channel, int width, int height )
 {
@@ -48,20 +64,29 @@ static inline uint8_t sample_mix( uint8_t dest, uint8_t src, float mix )
 	return src * mix + dest * ( 1.f - mix );
 }
 
+/** Get the mix of the source of a dissolve over a translucent destination and update its alpha.
+*/
+
+static inline float dissolve_mix( uint8_t *alpha_b, uint8_t *alpha_a, float weight )
+{
+	float mix_a = calculate_mix( 1.0f - weight, alpha_a? *alpha_a : 255 );
+	float mix_b = calculate_mix( weight, alpha_b? *alpha_b : 255 );
+	if (alpha_a) {
+		float mix2 = mix_b + mix_a - mix_b * mix_a;
+		*alpha_a = 255 * mix2;
+		if (mix2 != 0.f) mix_b /= mix2;
+	}
+	return mix_b;
+}
+
 static void composite_line_yuv_float( uint8_t *dest, uint8_t *src, int width, uint8_t *alpha_b, uint8_t *alpha_a, float weight )
 {
 	register int j = 0;
-	float mix_a, mix_b;
+	float mix_b;
 
 	for ( ; j < width; j ++ )
 	{
-		mix_a = calculate_mix( 1.0f - weight, alpha_a? *alpha_a : 255 );
-		mix_b = calculate_mix( weight, alpha_b? *alpha_b : 255 );
-		if (alpha_a) {
-			float mix2 = mix_b + mix_a - mix_b * mix_a;
-			*alpha_a = 255 * mix2;
-			if (mix2 != 0.f) mix_b /= mix2;
-		}
+		mix_b = dissolve_mix( alpha_b, alpha_a, weight );
 		*dest = sample_mix( *dest, *src++, mix_b );
 		dest++;
 		*dest = sample_mix( *dest, *src++, mix_b );
@@ -104,7 +129,122 @@ static int dissolve_slice( int id, int index, int count, void *context )
 	return 0;
 }
 
-static inline int dissolve_yuv( mlt_frame frame, mlt_frame that, float weight, int width, int height, int threads, int alpha_over )
+/** Point at the planes of a row of a yuv422p16 image, from an even pixel.
+*/
+
+static inline void planes16_row( mlt_image image, int row, int x, uint16_t *planes[ 3 ] )
+{
+	planes[ 0 ] = (uint16_t*) ( image->planes[ 0 ] + row * image->strides[ 0 ] ) + x;
+	planes[ 1 ] = (uint16_t*) ( image->planes[ 1 ] + row * image->strides[ 1 ] ) + x / 2;
+	planes[ 2 ] = (uint16_t*) ( image->planes[ 2 ] + row * image->strides[ 2 ] ) + x / 2;
+}
+
+/** Set up a yuv422p16 image with its alpha channel, if any, as the fourth plane.
+*/
+
+static void image16_set( mlt_image image, uint8_t *data, int width, int height, uint8_t *alpha )
+{
+	mlt_image_set_values( image, data, mlt_image_yuv422p16, width, height );
+	image->planes[ 3 ] = alpha;
+	image->strides[ 3 ] = alpha ? width : 0;
+}
+
+struct dissolve16_slice_context {
+	struct mlt_image_s dest;
+	struct mlt_image_s src;
+	int width;
+	int height;
+	float weight;
+	int alpha_over;
+};
+
+static int dissolve16_slice( int id, int index, int count, void *context )
+{
+	struct dissolve16_slice_context *ctx = (struct dissolve16_slice_context*) context;
+	int slice_height = ( ctx->height + count - 1 ) / count;
+	int end = MIN( ( index + 1 ) * slice_height, ctx->height );
+	int mix = ctx->weight * ( 1 << 16 );
+	int32_t mixes[ COMPOSITE_LINE16_PIXELS ];
+	int i, j, start;
+
+	for ( i = index * slice_height; i < end; i++ )
+	{
+		uint8_t *alpha_src = ctx->src.planes[ 3 ] ? ctx->src.planes[ 3 ] + i * ctx->src.strides[ 3 ] : NULL;
+		uint8_t *alpha_dest = ctx->dest.planes[ 3 ] ? ctx->dest.planes[ 3 ] + i * ctx->dest.strides[ 3 ] : NULL;
+		uint16_t *p[ 3 ], *q[ 3 ];
+
+		if ( !ctx->alpha_over )
+		{
+			planes16_row( &ctx->src, i, 0, p );
+			planes16_row( &ctx->dest, i, 0, q );
+			composite_line_yuv16( q, p, ctx->width, alpha_src, alpha_dest, mix, NULL, 0, 0, composite_line_over );
+			continue;
+		}
+		for ( start = 0; start < ctx->width; start += COMPOSITE_LINE16_PIXELS )
+		{
+			int n = MIN( ctx->width - start, COMPOSITE_LINE16_PIXELS );
+
+			for ( j = 0; j < n; j++ )
+				mixes[ j ] = ( 1 << 16 ) * dissolve_mix( alpha_src ? alpha_src + start + j : NULL,
+					alpha_dest ? alpha_dest + start + j : NULL, ctx->weight );
+			planes16_row( &ctx->src, i, start, p );
+			planes16_row( &ctx->dest, i, start, q );
+			composite_line_mix_yuv16( q, p, mixes, n );
+		}
+	}
+	return 0;
+}
+
+/** Get the images of both frames to blend, in yuv422p16 if asked for and both have it.
+ * \return the format of both images, which is yuv422 if they cannot both be 16-bit
+ */
+
+static mlt_image_format get_blend_images( mlt_frame frame, mlt_frame that, mlt_image_format format,
+	uint8_t **p_dest, int *width, int *height, uint8_t **p_src, int *width_src, int *height_src )
+{
+	mlt_image_format format_src = format;
+
+	mlt_frame_prefetch_image( that, format_src, *width_src, *height_src, 0 );
+	mlt_frame_get_image( frame, p_dest, &format, width, height, 1 );
+	mlt_frame_get_image( that, p_src, &format_src, width_src, height_src, 0 );
+	if ( format != format_src )
+	{
+		if ( format != mlt_image_yuv422 && frame->convert_image )
+			frame->convert_image( frame, p_dest, &format, mlt_image_yuv422 );
+		if ( format_src != mlt_image_yuv422 && that->convert_image )
+			that->convert_image( that, p_src, &format_src, mlt_image_yuv422 );
+	}
+	return format;
+}
+
+/** Dissolve two opaque 4:2:0 images of the same size.
+ *
+ * Every byte of every plane gets the same mix, so the planes, which follow
+ * each other, are blended as one long line.
+ * \return true if the images were dissolved, false to leave it to yuv422
+ */
+
+static int dissolve_yuv420p( mlt_frame frame, mlt_frame that, int mix, int width, int height )
+{
+	mlt_image_format format = mlt_image_yuv420p;
+	mlt_image_format format_src = mlt_image_yuv420p;
+	int width_src = width, height_src = height;
+	uint8_t *p_src, *p_dest;
+
+	mlt_frame_prefetch_image( that, format, width_src, height_src, 0 );
+	if ( mlt_frame_get_image( frame, &p_dest, &format, &width, &height, 1 )
+		 || mlt_frame_get_image( that, &p_src, &format_src, &width_src, &height_src, 0 ) )
+		return 0;
+	if ( format != mlt_image_yuv420p || format_src != mlt_image_yuv420p
+		 || width != width_src || height != height_src || ( width | height ) & 1
+		 || mlt_frame_get_alpha( frame ) || mlt_frame_get_alpha( that ) )
+		return 0;
+
+	composite_line_yuv( p_dest, p_src, mlt_image_format_size( format, width, height, NULL ) / 2, NULL, NULL, mix, NULL, 0, 0 );
+	return 1;
+}
+
+static inline int dissolve_yuv( mlt_frame frame, mlt_frame that, float weight, int width, int height, int threads, int alpha_over, mlt_image_format *dissolve_format )
 {
 	int ret = 0;
 	int i = height + 1;
@@ -117,13 +257,31 @@ static inline int dissolve_yuv( mlt_frame frame, mlt_frame that, float weight, i
 
 	if ( mlt_properties_get( &frame->parent, "distort" ) )
 		mlt_properties_set( &that->parent, "distort", mlt_properties_get( &frame->parent, "distort" ) );
-	mlt_frame_get_image( frame, &p_dest, &format, &width, &height, 1 );
+	if ( *dissolve_format == mlt_image_yuv420p && dissolve_yuv420p( frame, that, mix, width, height ) )
+		return ret;
+	if ( *dissolve_format == mlt_image_yuv422p16 )
+		format = mlt_image_yuv422p16;
+	format = get_blend_images( frame, that, format, &p_dest, &width, &height, &p_src, &width_src, &height_src );
+	*dissolve_format = format;
 	alpha_dst = mlt_frame_get_alpha( frame );
-	mlt_frame_get_image( that, &p_src, &format, &width_src, &height_src, 0 );
 	alpha_src = mlt_frame_get_alpha( that );
 	int is_translucent = ( alpha_dst && !is_opaque(alpha_dst, width, height) )
 	                  || ( alpha_src && !is_opaque(alpha_src, width_src, height_src) );
 
+	if ( format == mlt_image_yuv422p16 )
+	{
+		struct dissolve16_slice_context context = {
+			.width = MIN( width_src, width ),
+			.height = MIN( height_src, height ),
+			.weight = weight,
+			.alpha_over = is_translucent && alpha_over
+		};
+		image16_set( &context.dest, p_dest, width, height, alpha_dst );
+		image16_set( &context.src, p_src, width_src, height_src, alpha_src );
+		mlt_slices_run_normal( threads, dissolve16_slice, &context );
+		return ret;
+	}
+
 	// Pick the lesser of two evils ;-)
 	width_src = width_src > width ? width : width_src;
 	height_src = height_src > height ? height : height_src;
@@ -185,28 +343,227 @@ static float smoothstep_float( float edge1, float edge2, float a )
 	return ( a * a )  * ( 3 - ( 2 * a ) );
 }
 
+/** Scale a luma map to the size of the image with one value per pixel.
+
+    \param field_count 2 for interlaced images, where each field uses alternate rows of the map
+*/
+static uint16_t *luma_map_scale( const uint16_t *map, int map_width, int map_height, int width, int height, int field_count )
+{
+	uint16_t *result = mlt_pool_alloc( width * height * sizeof( uint16_t ) );
+	int32_t x_diff = ( map_width << 16 ) / width;
+	int32_t y_diff = ( map_height << 16 ) / height;
+	int i, j;
+
+	if ( !result )
+		return NULL;
+	for ( i = 0; i < height; i++ )
+	{
+		int field = i % field_count;
+		int row = ( ( ( field << 16 ) + ( i / field_count ) * y_diff ) >> 16 ) * field_count;
+		const uint16_t *l = map + MIN( row, map_height - 1 ) * map_width;
+		uint16_t *out = result + i * width;
+		int32_t x_offset = 0;
+
+		for ( j = 0; j < width; j++ )
+		{
+			out[ j ] = l[ x_offset >> 16 ];
+			x_offset += x_diff;
+		}
+	}
+	return result;
+}
+
+/** Get the luma map of a transition scaled to the size of the image.
+
+    Maps with a name in _luma_key are scaled once per size and shared.
+    \param[out] item the cache item to close when done, or NULL if the caller must release the result
+*/
+static uint16_t *luma_scaled_get( mlt_properties properties, uint16_t *luma_bitmap, int luma_width, int luma_height,
+								  int width, int height, int field_count, mlt_cache_item *item )
+{
+	const char *key = mlt_properties_get( properties, "_luma_key" );
+
+	*item = NULL;
+	if ( key )
+	{
+		char name[ 1100 ];
+		uint16_t *scaled = NULL;
+		int scaled_width, scaled_height;
+
+		snprintf( name, sizeof( name ), "%s %dx%d %d", key, width, height, field_count );
+		*item = mlt_luma_map_cache_get( name, &scaled, &scaled_width, &scaled_height );
+		if ( !*item )
+		{
+			scaled = luma_map_scale( luma_bitmap, luma_width, luma_height, width, height, field_count );
+			scaled_width = width;
+			scaled_height = height;
+			*item = mlt_luma_map_cache_put( name, &scaled, &scaled_width, &scaled_height );
+		}
+		if ( *item )
+			return scaled;
+	}
+	return luma_map_scale( luma_bitmap, luma_width, luma_height, width, height, field_count );
+}
+
+struct luma_slice_context
+{
+	uint8_t *p_src;
+	uint8_t *p_dest;
+	uint8_t *alpha_src;
+	uint8_t *alpha_dest;
+	uint16_t *luma;
+	int luma_width;
+	int width;
+	int alpha_stride;
+	int stride_src;
+	int stride_dest;
+	int field_count;
+	int field_rows[ 2 ];
+	float field_pos[ 2 ];
+	float softness;
+	int is_translucent;
+	int invert;
+	mlt_image image_src;  // yuv422p16 images with their alpha, or NULL for yuv422
+	mlt_image image_dest;
+};
+
+/** Get the mix of the source at a pixel of a luma wipe over translucent images and update the alpha.
+*/
+
+static inline float luma_mix( struct luma_slice_context *ctx, uint16_t luma, int field, uint8_t *alpha_src, uint8_t *alpha_dest )
+{
+	float weight = luma / 65535.f;
+	float value = smoothstep_float( weight, ctx->softness + weight, ctx->field_pos[ field ] );
+	float mix_a = calculate_mix( 1.0f - value, alpha_dest? *alpha_dest : 255 );
+	float mix_b = calculate_mix( value, alpha_src? *alpha_src : 255 );
+	if (ctx->invert && alpha_src) {
+		float mix2 = mix_b + mix_a - mix_b * mix_a;
+		*alpha_src = 255 * mix2;
+		if (mix2 != 0.f) mix_b /= mix2;
+	} else if (!ctx->invert && alpha_dest) {
+		float mix2 = mix_b + mix_a - mix_b * mix_a;
+		*alpha_dest = 255 * mix2;
+		if (mix2 != 0.f) mix_b /= mix2;
+	}
+	return mix_b;
+}
+
+/** Wipe row i of yuv422p16 images with the luma map, as luma_slice does for yuv422.
+*/
+
+static void luma_row16( struct luma_slice_context *ctx, int i, int field, const uint16_t *l )
+{
+	uint32_t i_softness = ctx->softness * ( 1 << 16 );
+	uint32_t step = ( 1 << 16 ) * ctx->field_pos[ field ];
+	uint8_t *alpha_src = ctx->image_src->planes[ 3 ] ? ctx->image_src->planes[ 3 ] + i * ctx->image_src->strides[ 3 ] : NULL;
+	uint8_t *alpha_dest = ctx->image_dest->planes[ 3 ] ? ctx->image_dest->planes[ 3 ] + i * ctx->image_dest->strides[ 3 ] : NULL;
+	int32_t mix[ COMPOSITE_LINE16_PIXELS ];
+	uint16_t *p[ 3 ], *q[ 3 ];
+	int start, j;
+
+	for ( start = 0; start < ctx->width; start += COMPOSITE_LINE16_PIXELS )
+	{
+		int n = MIN( ctx->width - start, COMPOSITE_LINE16_PIXELS );
+
+		for ( j = start; j < start + n; j++ )
+		{
+			if ( ctx->is_translucent )
+				mix[ j - start ] = ( 1 << 16 ) * luma_mix( ctx, l[ j ], field,
+					alpha_src ? alpha_src + j : NULL, alpha_dest ? alpha_dest + j : NULL );
+			else
+				mix[ j - start ] = smoothstep( l[ j ], i_softness + l[ j ], step );
+		}
+		planes16_row( ctx->image_src, i, start, p );
+		planes16_row( ctx->image_dest, i, start, q );
+		composite_line_mix_yuv16( q, p, mix, n );
+	}
+}
+
+static int luma_slice( int id, int index, int count, void *context )
+{
+	struct luma_slice_context *ctx = (struct luma_slice_context*) context;
+	const composite_line_simd *simd = composite_line_simd_get();
+	int rows = ctx->field_rows[ 0 ] + ctx->field_rows[ 1 ];
+	int slice_height = ( rows + count - 1 ) / count;
+	int start = index * slice_height;
+	int end = MIN( start + slice_height, rows );
+	uint32_t i_softness = ctx->softness * ( 1 << 16 );
+	float mix_b;
+	int n, j;
+
+	// Rows are numbered through the first field and then the second
+	for ( n = start; n < end; n++ )
+	{
+		int field = n >= ctx->field_rows[ 0 ];
+		int i = field + ( n - field * ctx->field_rows[ 0 ] ) * ctx->field_count;
+		uint8_t *p = ctx->p_src + i * ctx->stride_src;
+		uint8_t *q = ctx->p_dest + i * ctx->stride_dest;
+		uint16_t *l = ctx->luma + i * ctx->luma_width;
+
+		if ( ctx->image_dest )
+		{
+			luma_row16( ctx, i, field, l );
+		}
+		else if ( ctx->is_translucent )
+		{
+			// The alpha channels are read in the order the rows are numbered
+			uint8_t *alpha_src = ctx->alpha_src ? ctx->alpha_src + n * ctx->alpha_stride : NULL;
+			uint8_t *alpha_dest = ctx->alpha_dest ? ctx->alpha_dest + n * ctx->alpha_stride : NULL;
+
+			for ( j = 0; j < ctx->width; j++ )
+			{
+				mix_b = luma_mix( ctx, l[ j ], field, alpha_src, alpha_dest );
+				*q = sample_mix( *q, *p++, mix_b );
+				q++;
+				*q = sample_mix( *q, *p++, mix_b );
+				q++;
+				if ( alpha_dest ) alpha_dest ++;
+				if ( alpha_src ) alpha_src ++;
+			}
+		}
+		else
+		{
+			uint32_t step = (1 << 16) * ctx->field_pos[ field ];
+
+			j = 0;
+			if ( simd->blend )
+			{
+				j = simd->blend( q, p, ctx->width, NULL, NULL, 0, l, i_softness, step, composite_line_over );
+				p += j * 2;
+				q += j * 2;
+			}
+			for ( ; j < ctx->width; j++ )
+			{
+				uint16_t weight = l[ j ];
+				uint32_t value = smoothstep( weight, i_softness + weight, step );
+				*q = ( *p++ * value + *q * ((1 << 16) - value) ) >> 16;
+				q++;
+				*q = ( *p++ * value + *q * ((1 << 16) - value) ) >> 16;
+				q++;
+			}
+		}
+	}
+	return 0;
+}
+
 /** powerful stuff
 
+    \param luma_bitmap the luma map scaled to *width x *height
     \param field_order -1 = progressive, 0 = lower field first, 1 = top field first
 */
-static void luma_composite( mlt_frame a_frame, mlt_frame b_frame, int luma_width, int luma_height,
-							uint16_t *luma_bitmap, float pos, float frame_delta, float softness, int field_order,
-							int *width, int *height, int invert )
+static void luma_composite( mlt_frame a_frame, mlt_frame b_frame, uint16_t *luma_bitmap, float pos, float frame_delta,
+							float softness, int field_order, int *width, int *height, int invert, int threads, mlt_image_format *format )
 {
 	int width_src = *width, height_src = *height;
 	int width_dest = *width, height_dest = *height;
-	mlt_image_format format_src = mlt_image_yuv422, format_dest = mlt_image_yuv422;
 	uint8_t *p_src, *p_dest;
 	uint8_t *alpha_src, *alpha_dest;
-	int i, j;
-	int stride_src;
-	int stride_dest;
+	struct mlt_image_s image_src, image_dest;
 
 	if ( mlt_properties_get( &a_frame->parent, "distort" ) )
 		mlt_properties_set( &b_frame->parent, "distort", mlt_properties_get( &a_frame->parent, "distort" ) );
-	mlt_frame_get_image( a_frame, &p_dest, &format_dest, &width_dest, &height_dest, 1 );
+	*format = get_blend_images( a_frame, b_frame, *format, &p_dest, &width_dest, &height_dest, &p_src, &width_src, &height_src );
 	alpha_dest = mlt_frame_get_alpha( a_frame );
-	mlt_frame_get_image( b_frame, &p_src, &format_src, &width_src, &height_src, 0 );
 	alpha_src = mlt_frame_get_alpha( b_frame );
 
 	if ( *width == 0 || *height == 0 )
@@ -215,97 +572,45 @@ static void luma_composite( mlt_frame a_frame, mlt_frame b_frame, int luma_width
 	int is_translucent = ( alpha_dest && !is_opaque(alpha_dest, width_dest, height_dest) )
 	                  || ( alpha_src  && !is_opaque(alpha_src,  width_src,  height_src ) );
 
+	if ( *format == mlt_image_yuv422p16 )
+	{
+		image16_set( &image_dest, p_dest, width_dest, height_dest, alpha_dest );
+		image16_set( &image_src, p_src, width_src, height_src, alpha_src );
+	}
+
 	// Pick the lesser of two evils ;-)
 	width_src = width_src > width_dest ? width_dest : width_src;
 	height_src = height_src > height_dest ? height_dest : height_src;
-	
-	stride_src = width_src * 2;
-	stride_dest = width_dest * 2;
+	// and stay within the luma map
+	height_src = MIN( height_src, *height );
 
-	// Offset the position based on which field we're looking at ...
-	float field_pos[ 2 ];
-	field_pos[ 0 ] = ( pos + ( ( field_order == 0 ? 1 : 0 ) * frame_delta * 0.5f ) ) * ( 1.f + softness );
-	field_pos[ 1 ] = ( pos + ( ( field_order == 0 ? 0 : 1 ) * frame_delta * 0.5f ) ) * ( 1.f + softness );
-
-	register uint8_t *p;
-	register uint8_t *q;
-	uint16_t  *l;
-	int32_t x_diff = ( luma_width << 16 ) / *width;
-	int32_t y_diff = ( luma_height << 16 ) / *height;
-	int32_t x_offset = 0;
-	int32_t y_offset = 0;
-	uint8_t *p_row;
-	uint8_t *q_row;
-	uint32_t i_softness = softness * ( 1 << 16 );
 	int field_count = field_order < 0 ? 1 : 2;
-	int field_stride_src = field_count * stride_src;
-	int field_stride_dest = field_count * stride_dest;
-	int field = 0;
-	float mix_a, mix_b;
-
-	// composite using luma map
-	while ( field < field_count )
-	{
-		p_row = p_src + field * stride_src;
-		q_row = p_dest + field * stride_dest;
-		y_offset = field << 16;
-		i = field;
+	struct luma_slice_context context = {
+		.p_src = p_src,
+		.p_dest = p_dest,
+		.alpha_src = alpha_src,
+		.alpha_dest = alpha_dest,
+		.luma = luma_bitmap,
+		.luma_width = *width,
+		.width = MIN( width_src, *width ),
+		.alpha_stride = width_src,
+		.stride_src = width_src * 2,
+		.stride_dest = width_dest * 2,
+		.field_count = field_count,
+		.field_rows = { ( height_src + field_count - 1 ) / field_count, field_count > 1 ? height_src / 2 : 0 },
+		.softness = softness,
+		.is_translucent = is_translucent,
+		.invert = invert,
+		.image_src = *format == mlt_image_yuv422p16 ? &image_src : NULL,
+		.image_dest = *format == mlt_image_yuv422p16 ? &image_dest : NULL
+	};
 
-		while ( i < height_src )
-		{
-			p = p_row;
-			q = q_row;
-			l = luma_bitmap + ( y_offset >> 16 ) * ( luma_width * field_count );
-			x_offset = 0;
-			j = width_src;
-
-			if (is_translucent)
-			{
-				while( j -- )
-				{
-					float weight = l[ x_offset >> 16 ] / 65535.f;
-					float value = smoothstep_float( weight, softness + weight, field_pos[ field ] );
-					mix_a = calculate_mix( 1.0f - value, alpha_dest? *alpha_dest : 255 );
-					mix_b = calculate_mix( value, alpha_src? *alpha_src : 255 );
-					if (invert && alpha_src) {
-						float mix2 = mix_b + mix_a - mix_b * mix_a;
-						*alpha_src = 255 * mix2;
-						if (mix2 != 0.f) mix_b /= mix2;
-					} else if (!invert && alpha_dest) {
-						float mix2 = mix_b + mix_a - mix_b * mix_a;
-						*alpha_dest = 255 * mix2;
-						if (mix2 != 0.f) mix_b /= mix2;
-					}
-					*q = sample_mix( *q, *p++, mix_b );
-					q++;
-					*q = sample_mix( *q, *p++, mix_b );
-					q++;
-					if ( alpha_dest ) alpha_dest ++;
-					if ( alpha_src ) alpha_src ++;
-					x_offset += x_diff;
-				}
-			}
-			else
-			{
-				while( j -- )
-				{
-					uint16_t weight = l[ x_offset >> 16 ];
-					uint32_t value = smoothstep( weight, i_softness + weight, (1 << 16) * field_pos[ field ] );
-					*q = ( *p++ * value + *q * ((1 << 16) - value) ) >> 16;
-					q++;
-					*q = ( *p++ * value + *q * ((1 << 16) - value) ) >> 16;
-					q++;
-					x_offset += x_diff;
-				}
-			}
-			y_offset += y_diff;
-			i += field_count;
-			p_row += field_stride_src;
-			q_row += field_stride_dest;
-		}
+	// Offset the position based on which field we're looking at ...
+	context.field_pos[ 0 ] = ( pos + ( ( field_order == 0 ? 1 : 0 ) * frame_delta * 0.5f ) ) * ( 1.f + softness );
+	context.field_pos[ 1 ] = ( pos + ( ( field_order == 0 ? 0 : 1 ) * frame_delta * 0.5f ) ) * ( 1.f + softness );
 
-		field ++;
-	}
+	// composite using luma map
+	mlt_slices_run_normal( threads, luma_slice, &context );
 }
 
 void yuv422_to_luma16(uint8_t *image, uint16_t **map, int width, int height, int full_range)
@@ -344,7 +649,9 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 	// Get the properties of the b frame
 	mlt_properties b_props = MLT_FRAME_PROPERTIES( b_frame );
 
-	// This compositer is yuv422 only
+	// This compositer is yuv422, or yuv422p16 for more than 8 bits, except for a dissolve asked for in 4:2:0
+	mlt_image_format luma_format = *format == mlt_image_yuv422p16 ? mlt_image_yuv422p16 : mlt_image_yuv422;
+	mlt_image_format dissolve_format = *format == mlt_image_yuv420p ? mlt_image_yuv420p : luma_format;
 	*format = mlt_image_yuv422;
 
 	mlt_service_lock( MLT_TRANSITION_SERVICE( transition ) );
@@ -388,29 +695,34 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 			extension = strrchr( resource, '.' );
 		}
 
-		// See if it is a PGM
-		if ( extension != NULL && strcmp( extension, ".pgm" ) == 0 )
+		// See if it is a PGM or a saved luma map
+		if ( extension != NULL && ( strcmp( extension, ".pgm" ) == 0 || strcmp( extension, ".luma16" ) == 0 ) )
 		{
-			// Load from PGM
-			luma_bitmap = NULL;
-			if (mlt_luma_map_from_pgm(resource, &luma_bitmap, &luma_width, &luma_height)) {
-				// Failed to read file; generate it.
-				mlt_luma_map luma = mlt_luma_map_new(orig_resource);
-				if (profile) {
-					luma->w = profile->width;
-					luma->h = profile->height;
-				}
-				luma_bitmap = mlt_luma_map_render(luma);
-				luma_width = luma->w;
-				luma_height = luma->h;
-				free(luma);
-			}
+			// Load the map once for all transitions that use it
+			char key[ 1024 ];
+			snprintf( key, sizeof( key ), "%s %s %dx%d", resource, orig_resource,
+				profile ? profile->width : 0, profile ? profile->height : 0 );
+			mlt_cache_item item = mlt_luma_map_load( resource, orig_resource,
+				profile ? profile->width : 0, profile ? profile->height : 0, &luma_bitmap, &luma_width, &luma_height );
 
 			// Set the transition properties
+			if ( item )
+			{
+				mlt_properties_set_data( properties, "bitmap", luma_bitmap, 0, NULL, NULL );
+				mlt_properties_set_data( properties, "_luma_item", item, 0, ( mlt_destructor )mlt_cache_item_close, NULL );
+				mlt_properties_set( properties, "_luma_key", key );
+			}
+			else
+			{
+				luma_bitmap = NULL;
+				luma_width = luma_height = 0;
+				mlt_properties_set_data( properties, "bitmap", NULL, 0, NULL, NULL );
+				mlt_properties_clear( properties, "_luma_item" );
+				mlt_properties_clear( properties, "_luma_key" );
+			}
 			mlt_properties_set_int( properties, "width", luma_width );
 			mlt_properties_set_int( properties, "height", luma_height );
 			mlt_properties_set( properties, "_resource", orig_resource );
-			mlt_properties_set_data( properties, "bitmap", luma_bitmap, luma_width * luma_height * 2, mlt_pool_release, NULL );
 			mlt_properties_clear(properties, "producer");
 		}
 		else if (!*resource) 
@@ -418,6 +730,8 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		    luma_bitmap = NULL;
 		    mlt_properties_set( properties, "_resource", NULL );
 		    mlt_properties_set_data( properties, "bitmap", luma_bitmap, 0, mlt_pool_release, NULL );
+			mlt_properties_clear( properties, "_luma_item" );
+			mlt_properties_clear( properties, "_luma_key" );
 			mlt_properties_clear(properties, "producer");
 		}
 		else
@@ -481,6 +795,16 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 					mlt_properties_set_int( properties, "width", luma_width );
 					mlt_properties_set_int( properties, "height", luma_height );
 					mlt_properties_set_data( properties, "bitmap", luma_bitmap, luma_width * luma_height * 2, mlt_pool_release, NULL );
+					mlt_properties_clear( properties, "_luma_item" );
+
+					// A still image is scaled once per size, the frames of a clip every time
+					if ( is_clip ) {
+						mlt_properties_clear( properties, "_luma_key" );
+					} else {
+						char key[ 32 ];
+						luma_unique_name( key, sizeof( key ) );
+						mlt_properties_set( properties, "_luma_key", key );
+					}
 
 					// Cleanup the luma frame
 					mlt_frame_close( luma_frame );
@@ -511,6 +835,14 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 	int invert = mlt_properties_get_int( properties, "invert" );
 	int threads = CLAMP(mlt_properties_get_int(properties, "threads"), 0, mlt_slices_count_normal());
 	int alpha_over = mlt_properties_get_int(properties, "alpha_over");
+	int field_order = progressive ? -1 : top_field_first;
+	uint16_t *luma_scaled = NULL;
+	mlt_cache_item luma_item = NULL;
+
+	// Get the luma map at the size of the image while its source cannot change
+	if ( luma_width > 0 && luma_height > 0 && luma_bitmap != NULL && *width > 0 && *height > 0 )
+		luma_scaled = luma_scaled_get( properties, luma_bitmap, luma_width, luma_height, *width, *height,
+			field_order < 0 ? 1 : 2, &luma_item );
 
 	// Honour the reverse here
 	if ( mix >= 1.0 )
@@ -526,21 +858,27 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		mlt_service_unlock( MLT_TRANSITION_SERVICE( transition ) );
 	}
 
-	if ( luma_width > 0 && luma_height > 0 && luma_bitmap != NULL )
+	if ( luma_scaled )
 	{
 		reverse = invert ? !reverse : reverse;
 		mix = reverse ? 1 - mix : mix;
 		frame_delta *= reverse ? -1.0 : 1.0;
 		// Composite the frames using a luma map
-		luma_composite( !invert ? a_frame : b_frame, !invert ? b_frame : a_frame, luma_width, luma_height, luma_bitmap, mix, frame_delta,
-			luma_softness, progressive ? -1 : top_field_first, width, height, invert );
+		luma_composite( !invert ? a_frame : b_frame, !invert ? b_frame : a_frame, luma_scaled, mix, frame_delta,
+			luma_softness, field_order, width, height, invert, threads, &luma_format );
+		*format = luma_format;
+		if ( luma_item )
+			mlt_cache_item_close( luma_item );
+		else
+			mlt_pool_release( luma_scaled );
 	}
 	else
 	{
 		mix = ( reverse || invert ) ? 1 - mix : mix;
 		invert = 0;
 		// Dissolve the frames using the time offset for mix value
-		dissolve_yuv( a_frame, b_frame, mix, *width, *height, threads, alpha_over );
+		dissolve_yuv( a_frame, b_frame, mix, *width, *height, threads, alpha_over, &dissolve_format );
+		*format = dissolve_format;
 	}
 	if (producer) {
 		mlt_service_unlock( MLT_TRANSITION_SERVICE( transition ) );
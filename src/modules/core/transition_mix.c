@@ -20,6 +20,7 @@
 #include <framework/mlt_transition.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_log.h>
+#include "mix_audio_simd.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -30,6 +31,7 @@
 #define MAX_SAMPLES  (192000)
 #define SAMPLE_BYTES(samples, channels) ((samples) * (channels) * sizeof(float))
 #define MAX_BYTES    SAMPLE_BYTES( MAX_SAMPLES, MAX_CHANNELS )
+#define MAX_GROUP    (64)
 
 typedef struct transition_mix_s
 {
@@ -42,18 +44,30 @@ typedef struct transition_mix_s
 	mlt_position previous_frame_b;
 } *transition_mix;
 
+/** Summing transitions whose audio is mixed together */
+
+typedef struct mix_group_s
+{
+	int count;
+	mlt_transition transitions[MAX_GROUP];
+	mlt_frame frames[MAX_GROUP];
+} *mix_group;
+
 static void mix_audio( double weight_start, double weight_end, float *buffer_a,
 	float *buffer_b, int channels_a, int channels_b, int channels_out, int samples )
 {
-	int i, j;
-	double a, b, v;
+	const mix_audio_simd *simd = mix_audio_simd_get();
+	int i = 0, j;
+	double a, b, v, mix;
 
 	// Compute a smooth ramp over start to end
-	double mix = weight_start;
 	double mix_step = ( weight_end - weight_start ) / samples;
 
-	for ( i = 0; i < samples; i++ )
+	if ( simd->mix && channels_a == channels_out && channels_b == channels_out )
+		i = simd->mix( buffer_a, buffer_b, channels_out, samples, weight_start, mix_step );
+	for ( ; i < samples; i++ )
 	{
+		mix = weight_start + i * mix_step;
 		for ( j = 0; j < channels_out; j++ )
 		{
 			a = (double) buffer_a[ i * channels_a + j ];
@@ -61,32 +75,46 @@ static void mix_audio( double weight_start, double weight_end, float *buffer_a,
 			v = mix * b + (1.0 - mix) * a;
 			buffer_a[ i * channels_a + j ] = v;
 		}
-		mix += mix_step;
 	}
 }
 
-static void sum_audio( double weight_start, double weight_end, float *buffer_a,
-	float *buffer_b, int channels_a, int channels_b, int channels_out, int samples )
+// Add count buffers to buffer_a in one pass, each with its own ramp
+static void sum_audio_n( int count, const double *weight_start, const double *weight_end, float *buffer_a,
+	float *const *buffer_b, int channels_a, const int *channels_b, int channels_out, int samples )
 {
-	int i, j;
-	double a, b;
+	const mix_audio_simd *simd = mix_audio_simd_get();
+	double mix_step[MAX_GROUP];
+	int same = channels_a == channels_out;
+	int i = 0, j, k;
+	double v;
 
 	// Compute a smooth ramp over start to end
-	double mix = weight_start;
-	double mix_step = ( weight_end - weight_start ) / samples;
+	for ( k = 0; k < count; k++ )
+	{
+		mix_step[k] = ( weight_end[k] - weight_start[k] ) / samples;
+		same = same && channels_b[k] == channels_out;
+	}
 
-	for ( i = 0; i < samples; i++ )
+	if ( simd->sum && same )
+		i = simd->sum( buffer_a, (const float *const *) buffer_b, weight_start, mix_step, count, channels_out, samples );
+	for ( ; i < samples; i++ )
 	{
 		for ( j = 0; j < channels_out; j++ )
 		{
-			a = (double) buffer_a[ i * channels_a + j ];
-			b = (double) buffer_b[ i * channels_b + j ];
-			buffer_a[ i * channels_a + j ] = mix * b + a;
+			v = (double) buffer_a[ i * channels_a + j ];
+			for ( k = 0; k < count; k++ )
+				v = v + ( weight_start[k] + i * mix_step[k] ) * (double) buffer_b[k][ i * channels_b[k] + j ];
+			buffer_a[ i * channels_a + j ] = v;
 		}
-		mix += mix_step;
 	}
 }
 
+static void sum_audio( double weight_start, double weight_end, float *buffer_a,
+	float *buffer_b, int channels_a, int channels_b, int channels_out, int samples )
+{
+	sum_audio_n( 1, &weight_start, &weight_end, buffer_a, &buffer_b, channels_a, &channels_b, channels_out, samples );
+}
+
 // This filter uses an inline low pass filter to allow mixing without volume hacking.
 static void combine_audio( double weight, float *buffer_a, float *buffer_b,
 	int channels_a, int channels_b, int channels_out, int samples )
@@ -113,6 +141,90 @@ static void combine_audio( double weight, float *buffer_a, float *buffer_b,
 	}
 }
 
+// I do not recall what these silent_audio properties are about.
+static void clear_silent( mlt_frame frame, float *buffer, int samples, int channels )
+{
+	int silent = mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "silent_audio" );
+	mlt_properties_set_int( MLT_FRAME_PROPERTIES( frame ), "silent_audio", 0 );
+	if ( silent )
+		memset( buffer, 0, samples * channels * sizeof( float ) );
+}
+
+/** Append the samples of a frame to one of the buffers of a transition.
+ *
+ * \return the buffer
+ */
+
+static float *buffer_append( mlt_transition transition, const char *name, float *store, int *count,
+	mlt_position *previous, mlt_frame frame, float *buffer, int samples, int channels )
+{
+	// Prevent buffer overflow by discarding oldest samples.
+	samples = MIN( samples, MAX_SAMPLES * MAX_CHANNELS / channels );
+	size_t bytes = SAMPLE_BYTES( samples, channels );
+	if ( SAMPLE_BYTES( *count + samples, channels ) > MAX_BYTES ) {
+		mlt_log_verbose( MLT_TRANSITION_SERVICE(transition), "buffer overflow: %s_buffer_count %d\n",
+					  name, *count );
+		*count = MAX_SAMPLES * MAX_CHANNELS / channels - samples;
+		memmove( store, &store[MAX_SAMPLES * MAX_CHANNELS - samples * channels],
+				 SAMPLE_BYTES( samples, channels ) );
+	}
+
+	// Silence buffer if discontinuity
+	if (*count > 0 && mlt_frame_get_position(frame) != *previous + 1)
+		memset(store, 0, SAMPLE_BYTES(*count, channels));
+	*previous = mlt_frame_get_position(frame);
+
+	// Append the new samples from the frame to the buffer
+	memcpy( &store[*count * channels], buffer, bytes );
+	*count += samples;
+	return store;
+}
+
+/** Consume the samples that were mixed from one of the buffers of a transition.
+ */
+
+static void buffer_consume( float *store, int *count, int samples, int channels, int frequency, int paused )
+{
+	int consumed;
+
+	if ( paused )
+	{
+		// Flush the buffer when paused and scrubbing.
+		consumed = *count;
+	}
+	else
+	{
+		// It is also not good for A/V sync to let many samples accumulate in
+		// the buffer. This part provides a time-based buffer limit.
+
+		// Determine the maximum amount of latency permitted in the buffer.
+		int max_latency = CLAMP( frequency / 1000, 0, MAX_SAMPLES ); // samples in 1ms
+		// consumed is the difference between the actual and the target buffer count.
+		consumed = *count - CLAMP( *count - samples, 0, max_latency );
+	}
+
+	*count -= consumed;
+	if ( *count > 0 ) {
+		memmove( store, &store[consumed * channels],
+			SAMPLE_BYTES( *count, channels ));
+	}
+}
+
+// Get the mix levels of a b frame, which default to level
+static void get_mix_levels( mlt_properties b_props, double level, double *mix_start, double *mix_end )
+{
+	*mix_start = *mix_end = level;
+	if ( mlt_properties_get( b_props, "audio.previous_mix" ) )
+		*mix_start = mlt_properties_get_double( b_props, "audio.previous_mix" );
+	if ( mlt_properties_get( b_props, "audio.mix" ) )
+		*mix_end = mlt_properties_get_double( b_props, "audio.mix" );
+	if ( mlt_properties_get_int( b_props, "audio.reverse" ) )
+	{
+		*mix_start = 1.0 - *mix_start;
+		*mix_end = 1.0 - *mix_end;
+	}
+}
+
 /** Get the audio.
 */
 
@@ -137,9 +249,10 @@ static int transition_get_audio( mlt_frame frame_a, void **buffer, mlt_audio_for
 
 	// We can only mix interleaved 32-bit float.
 	*format = mlt_audio_f32le;
-	// Get the audio from our producers
-	mlt_frame_get_audio( frame_b, (void**) &buffer_b, format, &frequency_b, &channels_b, &samples_b );
+	// Get the audio from our producers, the b frame alongside the a frame
+	mlt_frame_prefetch_audio( frame_b, *format, frequency_b, channels_b, samples_b );
 	mlt_frame_get_audio( frame_a, (void**) &buffer_a, format, &frequency_a, &channels_a, &samples_a );
+	mlt_frame_get_audio( frame_b, (void**) &buffer_b, format, &frequency_b, &channels_b, &samples_b );
 
 	// Prevent dividing by zero.
 	if ( !channels_a || !channels_b || !buffer_a || !buffer_b )
@@ -154,15 +267,8 @@ static int transition_get_audio( mlt_frame frame_a, void **buffer, mlt_audio_for
 		return error;
 	}
 
-	// I do not recall what these silent_audio properties are about.
-	int silent = mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame_a ), "silent_audio" );
-	mlt_properties_set_int( MLT_FRAME_PROPERTIES( frame_a ), "silent_audio", 0 );
-	if ( silent )
-		memset( buffer_a, 0, samples_a * channels_a * sizeof( float ) );
-	silent = mlt_properties_get_int( b_props, "silent_audio" );
-	mlt_properties_set_int( b_props, "silent_audio", 0 );
-	if ( silent )
-		memset( buffer_b, 0, samples_b * channels_b * sizeof( float ) );
+	clear_silent( frame_a, buffer_a, samples_a, channels_a );
+	clear_silent( frame_b, buffer_b, samples_b, channels_b );
 
 	// At this point we have two frames of audio with possibly differing sample
 	// counts. How to reconcile this?
@@ -192,61 +298,16 @@ static int transition_get_audio( mlt_frame frame_a, void **buffer, mlt_audio_for
 	*channels = MIN( MIN( channels_b, channels_a ), MAX_CHANNELS );
 	*frequency = frequency_a;
 
-	// Prevent src buffer overflow by discarding oldest samples.
-	samples_b = MIN( samples_b, MAX_SAMPLES * MAX_CHANNELS / channels_b );
-	size_t bytes = SAMPLE_BYTES( samples_b, channels_b );
-	if ( SAMPLE_BYTES( self->src_buffer_count + samples_b, channels_b ) > MAX_BYTES ) {
-		mlt_log_verbose( MLT_TRANSITION_SERVICE(transition), "buffer overflow: src_buffer_count %d\n",
-					  self->src_buffer_count );
-		self->src_buffer_count = MAX_SAMPLES * MAX_CHANNELS / channels_b - samples_b;
-		memmove( self->src_buffer, &self->src_buffer[MAX_SAMPLES * MAX_CHANNELS - samples_b * channels_b],
-				 SAMPLE_BYTES( samples_b, channels_b ) );
-	}
-
-	// Silence src buffer if discontinuity
-	if (self->src_buffer_count > 0 && mlt_frame_get_position(frame_b) != self->previous_frame_b + 1)
-		memset(self->src_buffer, 0, SAMPLE_BYTES(self->src_buffer_count, channels_b));
-	self->previous_frame_b = mlt_frame_get_position(frame_b);
-
-	// Append the new samples from frame B to the src buffer
-	memcpy( &self->src_buffer[self->src_buffer_count * channels_b], buffer_b, bytes );
-	self->src_buffer_count += samples_b;
-	buffer_b = self->src_buffer;
-
-	// Prevent dest buffer overflow by discarding oldest samples.
-	samples_a = MIN( samples_a, MAX_SAMPLES * MAX_CHANNELS / channels_a );
-	bytes = SAMPLE_BYTES( samples_a, channels_a );
-	if ( SAMPLE_BYTES( self->dest_buffer_count + samples_a, channels_a ) > MAX_BYTES ) {
-		mlt_log_verbose( MLT_TRANSITION_SERVICE(transition), "buffer overflow: dest_buffer_count %d\n",
-					  self->dest_buffer_count );
-		self->dest_buffer_count = MAX_SAMPLES * MAX_CHANNELS / channels_a - samples_a;
-		memmove( self->dest_buffer, &self->dest_buffer[MAX_SAMPLES * MAX_CHANNELS - samples_a * channels_a],
-				 SAMPLE_BYTES( samples_a, channels_a ) );
-	}
-
-	// Silence dest buffer if discontinuity
-	if (self->dest_buffer_count > 0 && mlt_frame_get_position(frame_a) != self->previous_frame_a + 1)
-		memset(self->dest_buffer, 0, SAMPLE_BYTES(self->dest_buffer_count, channels_a));
-	self->previous_frame_a = mlt_frame_get_position(frame_a);
-
-	// Append the new samples from frame A to the dest buffer
-	memcpy( &self->dest_buffer[self->dest_buffer_count * channels_a], buffer_a, bytes );
-	self->dest_buffer_count += samples_a;
-	buffer_a = self->dest_buffer;
+	buffer_b = buffer_append( transition, "src", self->src_buffer, &self->src_buffer_count,
+		&self->previous_frame_b, frame_b, buffer_b, samples_b, channels_b );
+	buffer_a = buffer_append( transition, "dest", self->dest_buffer, &self->dest_buffer_count,
+		&self->previous_frame_a, frame_a, buffer_a, samples_a, channels_a );
 
 	// Do the mixing.
 	if ( mlt_properties_get_int( MLT_TRANSITION_PROPERTIES(transition), "sum" ) )
 	{
-		double mix_start = 1.0, mix_end = 1.0;
-		if ( mlt_properties_get( b_props, "audio.previous_mix" ) )
-			mix_start = mlt_properties_get_double( b_props, "audio.previous_mix" );
-		if ( mlt_properties_get( b_props, "audio.mix" ) )
-			mix_end = mlt_properties_get_double( b_props, "audio.mix" );
-		if ( mlt_properties_get_int( b_props, "audio.reverse" ) )
-		{
-			mix_start = 1.0 - mix_start;
-			mix_end = 1.0 - mix_end;
-		}
+		double mix_start, mix_end;
+		get_mix_levels( b_props, 1.0, &mix_start, &mix_end );
 		sum_audio( mix_start, mix_end, buffer_a, buffer_b, channels_a, channels_b, *channels, *samples );
 	}
 	else if ( mlt_properties_get_int( MLT_TRANSITION_PROPERTIES(transition), "combine" ) )
@@ -258,62 +319,111 @@ static int transition_get_audio( mlt_frame frame_a, void **buffer, mlt_audio_for
 	}
 	else
 	{
-		double mix_start = 0.5, mix_end = 0.5;
-		if ( mlt_properties_get( b_props, "audio.previous_mix" ) )
-			mix_start = mlt_properties_get_double( b_props, "audio.previous_mix" );
-		if ( mlt_properties_get( b_props, "audio.mix" ) )
-			mix_end = mlt_properties_get_double( b_props, "audio.mix" );
-		if ( mlt_properties_get_int( b_props, "audio.reverse" ) )
-		{
-			mix_start = 1.0 - mix_start;
-			mix_end = 1.0 - mix_end;
-		}
+		double mix_start, mix_end;
+		get_mix_levels( b_props, 0.5, &mix_start, &mix_end );
 		mix_audio( mix_start, mix_end, buffer_a, buffer_b, channels_a, channels_b, *channels, *samples );
 	}
 
 	// Copy the audio from the dest buffer into the frame.
-	bytes = SAMPLE_BYTES( *samples, *channels );
+	size_t bytes = SAMPLE_BYTES( *samples, *channels );
 	*buffer = mlt_pool_alloc( bytes );
 	memcpy( *buffer, buffer_a, bytes );
 	mlt_frame_set_audio( frame_a, *buffer, *format, bytes, mlt_pool_release );
 
-	if ( mlt_properties_get_int( b_props, "_speed" ) == 0 )
+	// Consume the src and dest buffers.
+	int paused = mlt_properties_get_int( b_props, "_speed" ) == 0;
+	buffer_consume( self->src_buffer, &self->src_buffer_count, *samples, channels_b, *frequency, paused );
+	buffer_consume( self->dest_buffer, &self->dest_buffer_count, *samples, channels_a, *frequency, paused );
+
+	return error;
+}
+
+/** Get the audio of a group of summing transitions onto the same a frame.
+ *
+ * The a frame goes through the dest buffer of the first transition and each b
+ * frame through the src buffer of its own transition, and all of them are added
+ * to the a frame in one pass instead of one transition after the other.
+*/
+
+static int group_get_audio( mlt_frame frame_a, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
+{
+	mix_group group = mlt_frame_pop_audio( frame_a );
+	transition_mix first = group->transitions[0]->child;
+	mlt_transition transitions[MAX_GROUP];
+	mlt_frame frames[MAX_GROUP];
+	float *buffers_b[MAX_GROUP];
+	int channels_b[MAX_GROUP], samples_b[MAX_GROUP];
+	double mix_start[MAX_GROUP], mix_end[MAX_GROUP];
+	float *buffer_a;
+	int frequency_a = *frequency, channels_a = *channels, samples_a = *samples;
+	int out_samples, out_channels = MAX_CHANNELS;
+	int count = 0, k;
+
+	// We can only mix interleaved 32-bit float.
+	*format = mlt_audio_f32le;
+	// Get the audio from our producers, the b frames alongside the a frame
+	for ( k = 0; k < group->count; k++ )
+		mlt_frame_prefetch_audio( group->frames[k], *format, *frequency, *channels, *samples );
+	mlt_frame_get_audio( frame_a, (void**) &buffer_a, format, &frequency_a, &channels_a, &samples_a );
+	if ( !channels_a || !buffer_a )
+		return 1;
+	for ( k = 0; k < group->count; k++ )
 	{
-		// Flush the buffer when paused and scrubbing.
-		samples_b = self->src_buffer_count;
-		samples_a = self->dest_buffer_count;
+		int frequency_b = *frequency;
+		channels_b[k] = *channels;
+		samples_b[k] = *samples;
+		buffers_b[k] = NULL;
+		mlt_frame_get_audio( group->frames[k], (void**) &buffers_b[k], format, &frequency_b, &channels_b[k], &samples_b[k] );
+		if ( !channels_b[k] || !buffers_b[k] )
+			return 1;
 	}
-	else
-	{
-		// It is also not good for A/V sync to let many samples accumulate in
-		// the buffer. This part provides a time-based buffer limit.
 
-		// Determine the maximum amount of latency permitted in the buffer.
-		int max_latency = CLAMP( *frequency / 1000, 0, MAX_SAMPLES ); // samples in 1ms
-		// samples_b becomes the new target src buffer count.
-		samples_b = CLAMP( self->src_buffer_count - *samples, 0, max_latency );
-		// samples_b becomes the number of samples to consume: difference between actual and the target.
-		samples_b = self->src_buffer_count - samples_b;
-		// samples_a becomes the new target dest buffer count.
-		samples_a = CLAMP( self->dest_buffer_count - *samples, 0, max_latency );
-		// samples_a becomes the number of samples to consume: difference between actual and the target.
-		samples_a = self->dest_buffer_count - samples_a;
-	}
+	clear_silent( frame_a, buffer_a, samples_a, channels_a );
+	buffer_a = buffer_append( group->transitions[0], "dest", first->dest_buffer, &first->dest_buffer_count,
+		&first->previous_frame_a, frame_a, buffer_a, samples_a, channels_a );
+	out_samples = first->dest_buffer_count;
 
-	// Consume the src buffer.
-	self->src_buffer_count -= samples_b;
-	if ( self->src_buffer_count ) {
-		memmove( self->src_buffer, &self->src_buffer[samples_b * channels_b],
-			SAMPLE_BYTES( self->src_buffer_count, channels_b ));
+	for ( k = 0; k < group->count; k++ )
+	{
+		transition_mix self = group->transitions[k]->child;
+
+		// The b frame has the audio of the a frame, so there is nothing to add
+		if ( buffers_b[k] == buffer_a )
+			continue;
+		clear_silent( group->frames[k], buffers_b[k], samples_b[k], channels_b[k] );
+		buffers_b[count] = buffer_append( group->transitions[k], "src", self->src_buffer, &self->src_buffer_count,
+			&self->previous_frame_b, group->frames[k], buffers_b[k], samples_b[k], channels_b[k] );
+		channels_b[count] = channels_b[k];
+		get_mix_levels( MLT_FRAME_PROPERTIES( group->frames[k] ), 1.0, &mix_start[count], &mix_end[count] );
+		out_samples = MIN( out_samples, self->src_buffer_count );
+		out_channels = MIN( out_channels, channels_b[k] );
+		transitions[count] = group->transitions[k];
+		frames[count] = group->frames[k];
+		count++;
 	}
-	// Consume the dest buffer.
-	self->dest_buffer_count -= samples_a;
-	if ( self->dest_buffer_count > 0 ) {
-		memmove( self->dest_buffer, &self->dest_buffer[samples_a * channels_a],
-			SAMPLE_BYTES( self->dest_buffer_count, channels_a ));
+
+	*samples = out_samples;
+	*channels = MIN( out_channels, channels_a );
+	*frequency = frequency_a;
+	sum_audio_n( count, mix_start, mix_end, buffer_a, buffers_b, channels_a, channels_b, *channels, *samples );
+
+	// Copy the audio from the dest buffer into the frame.
+	size_t bytes = SAMPLE_BYTES( *samples, *channels );
+	*buffer = mlt_pool_alloc( bytes );
+	memcpy( *buffer, buffer_a, bytes );
+	mlt_frame_set_audio( frame_a, *buffer, *format, bytes, mlt_pool_release );
+
+	// Consume the src and dest buffers.
+	int paused = mlt_properties_get_int( MLT_FRAME_PROPERTIES( group->frames[0] ), "_speed" ) == 0;
+	buffer_consume( first->dest_buffer, &first->dest_buffer_count, *samples, channels_a, *frequency, paused );
+	for ( k = 0; k < count; k++ )
+	{
+		transition_mix self = transitions[k]->child;
+		paused = mlt_properties_get_int( MLT_FRAME_PROPERTIES( frames[k] ), "_speed" ) == 0;
+		buffer_consume( self->src_buffer, &self->src_buffer_count, *samples, channels_b[k], *frequency, paused );
 	}
 
-	return error;
+	return 0;
 }
 
 
@@ -398,10 +508,33 @@ static mlt_frame transition_process( mlt_transition transition, mlt_frame a_fram
 		}
 	}
 
-	// Override the get_audio method
-	mlt_frame_push_audio( a_frame, transition );
-	mlt_frame_push_audio( a_frame, b_frame );
-	mlt_frame_push_audio( a_frame, transition_get_audio );
+	// Summing transitions onto the same a frame can be mixed together in one pass
+	mix_group group = mlt_properties_get_data( MLT_FRAME_PROPERTIES( a_frame ), "_mix_group", NULL );
+	int accumulate = mlt_properties_get_int( properties, "sum" ) && mlt_properties_get_int( properties, "accumulate" );
+	if ( accumulate && group && group->count < MAX_GROUP
+	     && mlt_deque_peek_back( MLT_FRAME_AUDIO_STACK( a_frame ) ) == (void*) group_get_audio )
+	{
+		// Nothing else was stacked since the group started, so join it
+		group->transitions[ group->count ] = transition;
+		group->frames[ group->count++ ] = b_frame;
+	}
+	else if ( accumulate )
+	{
+		group = calloc( 1, sizeof( *group ) );
+		group->transitions[0] = transition;
+		group->frames[0] = b_frame;
+		group->count = 1;
+		mlt_properties_set_data( MLT_FRAME_PROPERTIES( a_frame ), "_mix_group", group, 0, free, NULL );
+		mlt_frame_push_audio( a_frame, group );
+		mlt_frame_push_audio( a_frame, group_get_audio );
+	}
+	else
+	{
+		// Override the get_audio method
+		mlt_frame_push_audio( a_frame, transition );
+		mlt_frame_push_audio( a_frame, b_frame );
+		mlt_frame_push_audio( a_frame, transition_get_audio );
+	}
 
 	// Ensure transition_get_audio is called if test_audio=1.
 	if ( mlt_properties_get_int( properties, "accepts_blanks" ) )
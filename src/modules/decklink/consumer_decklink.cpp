@@ -27,6 +27,7 @@
 #include <limits.h>
 #include <pthread.h>
 #include "common.h"
+#include "v210.h"
 
 #define SWAB_SLICED_ALIGN_POW 5
 static int swab_sliced( int id, int idx, int jobs, void* cookie )
@@ -47,8 +48,88 @@ static int swab_sliced( int id, int idx, int jobs, void* cookie )
 	return 0;
 };
 
+struct v210_pack_desc
+{
+	mlt_image_format format;
+	uint8_t *image, *buffer;
+	int stride, width, height;
+};
+
+static int v210_pack_sliced( int id, int idx, int jobs, void* cookie )
+{
+	struct v210_pack_desc* ctx = (struct v210_pack_desc*) cookie;
+	uint8_t* planes[4];
+	int strides[4];
+	int y = ctx->height * idx / jobs;
+	int end = ctx->height * ( idx + 1 ) / jobs;
+
+	mlt_image_format_planes( ctx->format, ctx->width, ctx->height, ctx->image, planes, strides );
+	for ( ; y < end; y++ )
+	{
+		uint32_t* dst = (uint32_t*) ( ctx->buffer + y * ctx->stride );
+		if ( ctx->format == mlt_image_yuv422p16 )
+			v210_pack_row( (uint16_t*) ( planes[0] + y * strides[0] ), (uint16_t*) ( planes[1] + y * strides[1] ),
+				(uint16_t*) ( planes[2] + y * strides[2] ), dst, ctx->width );
+		else
+			v210_pack_yuv422_row( planes[0] + y * strides[0], dst, ctx->width );
+	}
+
+	return 0;
+}
+
 static const unsigned PREROLL_MINIMUM = 3;
 
+/** Allocates the buffers of the DeckLink video frames from the MLT memory pool.
+ *
+ * The pool keeps released buffers, so restarting playback reuses them instead
+ * of going back to the system allocator.
+ */
+
+class PoolAllocator : public IDeckLinkMemoryAllocator
+{
+private:
+	int m_refs;
+
+public:
+	PoolAllocator()
+		: m_refs( 1 )
+	{}
+
+	virtual ~PoolAllocator()
+	{}
+
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface( REFIID iid, LPVOID *ppv )
+		{ return E_NOINTERFACE; }
+	virtual ULONG STDMETHODCALLTYPE AddRef()
+		{ return __sync_add_and_fetch( &m_refs, 1 ); }
+	virtual ULONG STDMETHODCALLTYPE Release()
+	{
+		int refs = __sync_sub_and_fetch( &m_refs, 1 );
+		if ( !refs )
+			delete this;
+		return refs;
+	}
+
+#ifdef _WIN32
+	virtual HRESULT STDMETHODCALLTYPE AllocateBuffer( unsigned long bufferSize, void **allocatedBuffer )
+#else
+	virtual HRESULT STDMETHODCALLTYPE AllocateBuffer( uint32_t bufferSize, void **allocatedBuffer )
+#endif
+	{
+		*allocatedBuffer = mlt_pool_alloc( bufferSize );
+		return *allocatedBuffer ? S_OK : E_OUTOFMEMORY;
+	}
+	virtual HRESULT STDMETHODCALLTYPE ReleaseBuffer( void *buffer )
+	{
+		mlt_pool_release( buffer );
+		return S_OK;
+	}
+	virtual HRESULT STDMETHODCALLTYPE Commit()
+		{ return S_OK; }
+	virtual HRESULT STDMETHODCALLTYPE Decommit()
+		{ return S_OK; }
+};
+
 enum
 {
 	OP_NONE = 0,
@@ -77,14 +158,16 @@ private:
 	int                         m_inChannels;
 	bool                        m_isAudio;
 	int                         m_isKeyer;
+	int                         m_bitdepth;
+	int                         m_stride;
 	IDeckLinkKeyer*             m_deckLinkKeyer;
 	bool                        m_terminate_on_pause;
 	uint32_t                    m_preroll;
 	uint32_t                    m_reprio;
 
-	mlt_deque                   m_aqueue;
-	pthread_mutex_t             m_aqueue_lock;
-	mlt_deque                   m_frames;
+	mlt_ring                    m_aqueue;
+	mlt_ring                    m_frames;
+	PoolAllocator*              m_allocator;
 
 	pthread_mutex_t             m_op_lock;
 	pthread_mutex_t             m_op_arg_mutex;
@@ -139,8 +222,9 @@ public:
 		m_deckLinkKeyer = NULL;
 		m_deckLinkOutput = NULL;
 		m_deckLink = NULL;
-		m_aqueue = mlt_deque_init();
-		m_frames = mlt_deque_init();
+		m_aqueue = NULL;
+		m_frames = NULL;
+		m_allocator = NULL;
 		m_buffer = NULL;
 
 		// operation locks
@@ -150,7 +234,6 @@ public:
 		pthread_mutexattr_settype( &mta, PTHREAD_MUTEX_RECURSIVE );
 		pthread_mutex_init( &m_op_lock, &mta );
 		pthread_mutex_init( &m_op_arg_mutex, &mta );
-		pthread_mutex_init( &m_aqueue_lock, &mta );
 		pthread_mutexattr_destroy( &mta );
 		pthread_cond_init( &m_op_arg_cond, NULL );
 		pthread_create( &m_op_thread, NULL, op_main, this );
@@ -164,16 +247,16 @@ public:
 		SAFE_RELEASE( m_deckLinkKeyer );
 		SAFE_RELEASE( m_deckLinkOutput );
 		SAFE_RELEASE( m_deckLink );
+		SAFE_RELEASE( m_allocator );
 
-		mlt_deque_close( m_aqueue );
-		mlt_deque_close( m_frames );
+		mlt_ring_close( m_aqueue );
+		mlt_ring_close( m_frames );
 
 		op(OP_EXIT, 0);
 		mlt_log_debug( getConsumer(), "%s: waiting for op thread\n", __FUNCTION__ );
 		pthread_join(m_op_thread, NULL);
 		mlt_log_debug( getConsumer(), "%s: finished op thread\n", __FUNCTION__ );
 
-		pthread_mutex_destroy( &m_aqueue_lock );
 		pthread_mutex_destroy(&m_op_lock);
 		pthread_mutex_destroy(&m_op_arg_mutex);
 		pthread_cond_destroy(&m_op_arg_cond);
@@ -440,22 +523,52 @@ protected:
 			return false;
 		}
 
+		// The keyer needs the alpha channel, which is only in 8-bit ARGB
+		m_bitdepth = ( !m_isKeyer && 10 == mlt_properties_get_int( properties, "bitdepth" ) ) ? 10 : 8;
+		m_stride = m_isKeyer ? m_width * 4 : m_bitdepth == 10 ? v210_row_bytes( m_width ) : m_width * 2;
+
 		m_preroll = preroll;
 		m_reprio = 2;
 
+		// Every video frame is created up front and cycles between the render
+		// thread and the card, an audio frame is queued for each video frame
+		mlt_ring_close( m_frames );
+		mlt_ring_close( m_aqueue );
+		m_frames = mlt_ring_init( m_preroll + 2 );
+		m_aqueue = mlt_ring_init( 2 * ( m_preroll + 2 ) );
+		if ( !m_frames || !m_aqueue )
+		{
+			mlt_log_error( getConsumer(), "%s: failed to allocate the frame queues\n", __FUNCTION__ );
+			stop();
+			return false;
+		}
+
+		// Give the frames buffers from the memory pool
+		if ( mlt_properties_get_int( properties, "frame_pool" ) )
+		{
+			if ( !m_allocator )
+				m_allocator = new PoolAllocator();
+			if ( S_OK != m_deckLinkOutput->SetVideoOutputFrameMemoryAllocator( m_allocator ) )
+				mlt_log_warning( getConsumer(), "%s: failed to set the frame allocator\n", __FUNCTION__ );
+		}
+		else
+		{
+			m_deckLinkOutput->SetVideoOutputFrameMemoryAllocator( NULL );
+		}
+
 		for ( unsigned i = 0; i < ( m_preroll + 2 ) ; i++)
 		{
 			IDeckLinkMutableVideoFrame* frame;
 
 			// Generate a DeckLink video frame
-			if ( S_OK != m_deckLinkOutput->CreateVideoFrame( m_width, m_height,
-				m_width * ( m_isKeyer? 4 : 2 ), m_isKeyer? bmdFormat8BitARGB : bmdFormat8BitYUV, bmdFrameFlagDefault, &frame ) )
+			if ( S_OK != m_deckLinkOutput->CreateVideoFrame( m_width, m_height, m_stride,
+				m_isKeyer? bmdFormat8BitARGB : m_bitdepth == 10 ? bmdFormat10BitYUV : bmdFormat8BitYUV, bmdFrameFlagDefault, &frame ) )
 			{
 				mlt_log_error( getConsumer(), "%s: CreateVideoFrame (%d) failed\n", __FUNCTION__, i );
 				return false;
 			}
 
-			mlt_deque_push_back( m_frames, frame );
+			mlt_ring_push( m_frames, frame );
 		}
 
 		// Set the running state
@@ -478,14 +591,14 @@ protected:
 			m_deckLinkOutput->DisableVideoOutput();
 		}
 
-		pthread_mutex_lock( &m_aqueue_lock );
-		while ( mlt_frame frame = (mlt_frame) mlt_deque_pop_back( m_aqueue ) )
-			mlt_frame_close( frame );
-		pthread_mutex_unlock( &m_aqueue_lock );
+		if ( m_aqueue )
+			while ( mlt_frame frame = (mlt_frame) mlt_ring_pop( m_aqueue ) )
+				mlt_frame_close( frame );
 
 		m_buffer = NULL;
-		while ( IDeckLinkMutableVideoFrame* frame = (IDeckLinkMutableVideoFrame*) mlt_deque_pop_back( m_frames ) )
-			SAFE_RELEASE( frame );
+		if ( m_frames )
+			while ( IDeckLinkMutableVideoFrame* frame = (IDeckLinkMutableVideoFrame*) mlt_ring_pop( m_frames ) )
+				SAFE_RELEASE( frame );
 
 		// set running state is 0
 		mlt_properties_set_int( properties, "running", 0 );
@@ -503,29 +616,44 @@ protected:
 		properties = MLT_FRAME_PROPERTIES( frame );
 		mlt_properties_set_int64( properties, "m_count", m_count);
 		mlt_properties_inc_ref( properties );
-		pthread_mutex_lock( &m_aqueue_lock );
-		mlt_deque_push_back( m_aqueue, frame );
-		mlt_log_debug( getConsumer(), "%s:%d frame=%p, len=%d\n", __FUNCTION__, __LINE__, frame, mlt_deque_count( m_aqueue ));
-		pthread_mutex_unlock( &m_aqueue_lock );
+		if ( !mlt_ring_push( m_aqueue, frame ) )
+		{
+			mlt_log_debug( getConsumer(), "%s:%d frame=%p, len=%d\n", __FUNCTION__, __LINE__, frame, mlt_ring_count( m_aqueue ) );
+		}
+		else
+		{
+			mlt_log_warning( getConsumer(), "%s: audio queue is full, dropping audio\n", __FUNCTION__ );
+			mlt_frame_close( frame );
+		}
 	}
 
 	void renderVideo( mlt_frame frame )
 	{
 		HRESULT hr;
-		mlt_image_format format = m_isKeyer? mlt_image_rgba : mlt_image_yuv422;
+		mlt_image_format format = m_isKeyer? mlt_image_rgba : m_bitdepth == 10 ? mlt_image_yuv422p16 : mlt_image_yuv422;
 		uint8_t* image = 0;
 		int rendered = mlt_properties_get_int( MLT_FRAME_PROPERTIES(frame), "rendered");
 		mlt_properties consumer_properties = MLT_CONSUMER_PROPERTIES( getConsumer() );
-		int stride = m_width * ( m_isKeyer? 4 : 2 );
+		int stride = m_stride;
 		int height = m_height;
+		int error;
 		IDeckLinkMutableVideoFrame* decklinkFrame =
-			static_cast<IDeckLinkMutableVideoFrame*>( mlt_deque_pop_front( m_frames ) );
+			static_cast<IDeckLinkMutableVideoFrame*>( mlt_ring_pop( m_frames ) );
 		
 		mlt_log_debug( getConsumer(), "%s: entering\n", __FUNCTION__ );
 
 		m_sliced_swab = mlt_properties_get_int( consumer_properties, "sliced_swab" );
 
-		if ( rendered && !mlt_frame_get_image( frame, &image, &format, &m_width, &height, 0 ) )
+		error = !rendered || mlt_frame_get_image( frame, &image, &format, &m_width, &height, 0 );
+
+		// Without a converter to 16-bit, pack the 8-bit image into v210
+		if ( !error && m_bitdepth == 10 && format != mlt_image_yuv422p16 && format != mlt_image_yuv422 )
+		{
+			format = mlt_image_yuv422;
+			error = mlt_frame_get_image( frame, &image, &format, &m_width, &height, 0 );
+		}
+
+		if ( !error )
 		{
 			if ( decklinkFrame )
 				decklinkFrame->GetBytes( (void**) &m_buffer );
@@ -541,13 +669,28 @@ protected:
 						memset( m_buffer, 0, stride * 6 );
 						m_buffer += stride * 6;
 					}
+					else if ( m_bitdepth == 10 )
+					{
+						for ( int i = 0; i < 6; i++, m_buffer += stride )
+							v210_black_row( (uint32_t*) m_buffer, m_width );
+					}
 					else for ( int i = 0; i < m_width * 6; i++ )
 					{
 						*m_buffer++ = 128;
 						*m_buffer++ = 16;
 					}
 				}
-				if ( !m_isKeyer )
+				if ( m_bitdepth == 10 )
+				{
+					struct v210_pack_desc desc = { format, image, m_buffer, stride, m_width, height };
+
+					// 10-bit playout - pack the planes into v210
+					if ( !m_sliced_swab )
+						v210_pack_sliced( 0, 0, 1, &desc );
+					else
+						mlt_slices_run_fifo( 0, v210_pack_sliced, &desc );
+				}
+				else if ( !m_isKeyer )
 				{
 					unsigned char *arg[3] = { image, m_buffer };
 					ssize_t size = stride * height;
@@ -590,7 +733,7 @@ protected:
 		{
 			uint8_t* buffer = NULL;
 			decklinkFrame->GetBytes( (void**) &buffer );
-			if ( buffer )
+			if ( buffer && m_buffer )
 				memcpy( buffer, m_buffer, stride * height );
 		}
 		if ( decklinkFrame )
@@ -697,10 +840,8 @@ protected:
 	virtual HRESULT STDMETHODCALLTYPE RenderAudioSamples ( bool preroll )
 #endif
 	{
-		pthread_mutex_lock( &m_aqueue_lock );
-		mlt_log_debug( getConsumer(), "%s: ENTERING preroll=%d, len=%d\n", __FUNCTION__, (int)preroll, mlt_deque_count( m_aqueue ));
-		mlt_frame frame = (mlt_frame) mlt_deque_pop_front( m_aqueue );
-		pthread_mutex_unlock( &m_aqueue_lock );
+		mlt_log_debug( getConsumer(), "%s: ENTERING preroll=%d, len=%d\n", __FUNCTION__, (int)preroll, mlt_ring_count( m_aqueue ) );
+		mlt_frame frame = (mlt_frame) mlt_ring_pop( m_aqueue );
 
 		reprio( 2 );
 
@@ -793,7 +934,7 @@ protected:
 	{
 		mlt_log_debug( getConsumer(), "%s: ENTERING\n", __FUNCTION__ );
 
-		mlt_deque_push_back( m_frames, completedFrame );
+		mlt_ring_push( m_frames, completedFrame );
 
 		//  change priority of video callback thread
 		reprio( 1 );
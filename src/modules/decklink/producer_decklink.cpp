@@ -25,6 +25,7 @@
 #include <limits.h>
 #include <sys/time.h>
 #include "common.h"
+#include "v210.h"
 
 #include <framework/mlt_slices.h>
 
@@ -36,15 +37,9 @@ struct copy_lines_sliced_desc
 	int in_stride, *out_strides, w, h;
 };
 
-#define READ_PIXELS( a, b, c ) \
-val  = *v210++;  \
-*a++ = ( val & 0x3FF ) << 6; \
-*b++ = ( ( val >> 10 ) & 0x3FF ) << 6;  \
-*c++ = ( ( val >> 20 ) & 0x3FF ) << 6;
-
 static int copy_lines_sliced_proc( int id, int idx, int jobs, void* cookie )
 {
-	int c, H, Y, i;
+	int H, Y, i;
 	struct copy_lines_sliced_desc *ctx = (struct copy_lines_sliced_desc*)cookie;
 
 	H = ( ctx->h + jobs ) / jobs;
@@ -54,22 +49,11 @@ static int copy_lines_sliced_proc( int id, int idx, int jobs, void* cookie )
 	if ( ctx->in_fmt == bmdFormat10BitYUV ) // bmdFormat10BitYUV -> mlt_image_yuv422p16
 	{
 		for( i = 0; i < H; i++)
-		{
-			uint32_t val,
-				*v210 = (uint32_t*)( ctx->in_buffer + ( Y + i ) * ctx->in_stride );
-			uint16_t
-				*y = (uint16_t*)( ctx->out_buffers[0] + ( Y + i ) * ctx->out_strides[0] ),
-				*u = (uint16_t*)( ctx->out_buffers[1] + ( Y + i ) * ctx->out_strides[1] ),
-				*v = (uint16_t*)( ctx->out_buffers[2] + ( Y + i ) * ctx->out_strides[2] );
-
-			for( c = 0; c < ctx->w / 6; c++ )
-			{
-				READ_PIXELS( u, y, v );
-				READ_PIXELS( y, u, y );
-				READ_PIXELS( v, y, u );
-				READ_PIXELS( y, v, y );
-			}
-		}
+			v210_unpack_row( (uint32_t*)( ctx->in_buffer + ( Y + i ) * ctx->in_stride ),
+				(uint16_t*)( ctx->out_buffers[0] + ( Y + i ) * ctx->out_strides[0] ),
+				(uint16_t*)( ctx->out_buffers[1] + ( Y + i ) * ctx->out_strides[1] ),
+				(uint16_t*)( ctx->out_buffers[2] + ( Y + i ) * ctx->out_strides[2] ),
+				ctx->w );
 	}
 	else // bmdFormat8BitYUV -> mlt_image_yuv422
 	{
@@ -111,11 +95,10 @@ private:
 	mlt_producer     m_producer;
 	IDeckLink*       m_decklink;
 	IDeckLinkInput*  m_decklinkInput;
-	mlt_deque        m_queue;
-	pthread_mutex_t  m_mutex;
-	pthread_cond_t   m_condition;
+	mlt_ring         m_queue;
 	bool             m_started;
 	int              m_dropped;
+	int              m_late;
 	bool             m_isBuffering;
 	int              m_topFieldFirst;
 	BMDPixelFormat   m_pixel_format;
@@ -172,6 +155,7 @@ public:
 		m_decklink = NULL;
 		m_decklinkInput = NULL;
 		m_new_input = NULL;
+		m_queue = NULL;
 	}
 
 	virtual ~DeckLinkProducer()
@@ -179,9 +163,7 @@ public:
 		if ( m_queue )
 		{
 			stop();
-			mlt_deque_close( m_queue );
-			pthread_mutex_destroy( &m_mutex );
-			pthread_cond_destroy( &m_condition );
+			mlt_ring_close( m_queue );
 			mlt_cache_close( m_cache );
 		}
 		SAFE_RELEASE( m_decklinkInput );
@@ -225,11 +207,10 @@ public:
 			m_decklinkInput->SetCallback( this );
 
 			// Initialize other members
-			pthread_mutex_init( &m_mutex, NULL );
-			pthread_cond_init( &m_condition, NULL );
-			m_queue = mlt_deque_init();
+			m_queue = mlt_ring_init( queueSize() );
 			m_started = false;
 			m_dropped = 0;
+			m_late = 0;
 			m_isBuffering = true;
 			m_cache = mlt_cache_init();
 
@@ -298,9 +279,21 @@ public:
 			if ( S_OK != m_decklinkInput->EnableAudioInput( sampleRate, sampleType, channels ) )
 				throw "Failed to enable audio capture.";
 
+			// Make room for the requested buffer, nothing else uses the queue before capture starts
+			if ( mlt_ring_capacity( m_queue ) < queueSize() )
+			{
+				mlt_ring_close( m_queue );
+				m_queue = mlt_ring_init( queueSize() );
+				if ( !m_queue )
+					throw "Failed to allocate the frame queue.";
+			}
+			mlt_ring_interrupt( m_queue, 0 );
+
 			// Start capture
 			m_dropped = 0;
+			m_late = 0;
 			mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( getProducer() ), "dropped", m_dropped );
+			mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( getProducer() ), "late", m_late );
 			m_started = m_decklinkInput->StartStreams() == S_OK;
 			if ( !m_started )
 				throw "Failed to start capture.";
@@ -321,25 +314,24 @@ public:
 		m_started = false;
 
 		// Release the wait in getFrame
-		pthread_mutex_lock( &m_mutex );
-		pthread_cond_broadcast( &m_condition );
-		pthread_mutex_unlock( &m_mutex );
+		mlt_ring_interrupt( m_queue, 1 );
 
 		m_decklinkInput->StopStreams();
 		m_decklinkInput->DisableVideoInput();
 		m_decklinkInput->DisableAudioInput();
 
 		// Cleanup queue
-		pthread_mutex_lock( &m_mutex );
-		while ( mlt_frame frame = (mlt_frame) mlt_deque_pop_back( m_queue ) )
+		while ( mlt_frame frame = (mlt_frame) mlt_ring_pop( m_queue ) )
 			mlt_frame_close( frame );
-		pthread_mutex_unlock( &m_mutex );
+	}
+
+	int queueSize()
+	{
+		return MAX( mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( getProducer() ), "buffer" ), 1 );
 	}
 
 	mlt_frame getFrame()
 	{
-		struct timeval now;
-		struct timespec tm;
 		double fps = mlt_producer_get_fps( getProducer() );
 		mlt_position position = mlt_producer_position( getProducer() );
 		mlt_frame frame = mlt_cache_get_frame( m_cache, position );
@@ -352,39 +344,18 @@ public:
 
 			m_isBuffering = false;
 			prefill = prefill > buffer ? buffer : prefill;
-			pthread_mutex_lock( &m_mutex );
-			while ( mlt_deque_count( m_queue ) < prefill )
-			{
-				// Wait up to buffer/fps seconds
-				gettimeofday( &now, NULL );
-				long usec = now.tv_sec * 1000000 + now.tv_usec;
-				usec += 1000000 * buffer / fps;
-				tm.tv_sec = usec / 1000000;
-				tm.tv_nsec = (usec % 1000000) * 1000;
-				if ( pthread_cond_timedwait( &m_condition, &m_mutex, &tm ) )
-					break;
-			}
-			pthread_mutex_unlock( &m_mutex );
+
+			// Wait up to buffer/fps seconds
+			if ( prefill > 0 )
+				mlt_ring_wait_for_items_timeout( m_queue, prefill, 1000000 * buffer / fps );
 		}
 
 		if ( !frame )
 		{
-			// Wait if queue is empty
-			pthread_mutex_lock( &m_mutex );
-			while ( mlt_deque_count( m_queue ) < 1 )
-			{
-				// Wait up to twice frame duration
-				gettimeofday( &now, NULL );
-				long usec = now.tv_sec * 1000000 + now.tv_usec;
-				usec += 2000000 / fps;
-				tm.tv_sec = usec / 1000000;
-				tm.tv_nsec = (usec % 1000000) * 1000;
-				if ( pthread_cond_timedwait( &m_condition, &m_mutex, &tm ) )
-					// Stop waiting if error (timed out)
-					break;
-			}
-			frame = ( mlt_frame ) mlt_deque_pop_front( m_queue );
-			pthread_mutex_unlock( &m_mutex );
+			// Wait up to twice frame duration if queue is empty
+			frame = ( mlt_frame ) mlt_ring_pop( m_queue );
+			if ( !frame && !mlt_ring_wait_for_items_timeout( m_queue, 1, 2000000 / fps ) )
+				frame = ( mlt_frame ) mlt_ring_pop( m_queue );
 
 			// add to cache
 			if ( frame )
@@ -419,7 +390,10 @@ public:
 				mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( getProducer() ), "channels" ) );
 		}
 		else
+		{
+			mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( getProducer() ), "late", ++m_late );
 			mlt_log_warning( getProducer(), "buffer underrun\n" );
+		}
 
 		return frame;
 	}
@@ -483,9 +457,8 @@ public:
 		};
 
 		if ( mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( getProducer() ), "preview" ) &&
-			mlt_producer_get_speed( getProducer() ) == 0.0 && !mlt_deque_count( m_queue ))
+			mlt_producer_get_speed( getProducer() ) == 0.0 && !mlt_ring_count( m_queue ))
 		{
-			pthread_cond_broadcast( &m_condition );
 			return S_OK;
 		}
 
@@ -508,10 +481,7 @@ public:
 						"VideoInputFrameArrived: vitc=%.8X vitc_in=%.8X\n", vitc, vitc_in);
 
 					if ( vitc < vitc_in )
-					{
-						pthread_cond_broadcast( &m_condition );
 						return S_OK;
-					}
 
 					mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( getProducer() ), "vitc_in", 0 );
 				}
@@ -642,20 +612,26 @@ public:
 		{
 			mlt_properties_set_int64( MLT_FRAME_PROPERTIES( frame ), "arrived",
 				arrived.tv_sec * 1000000LL + arrived.tv_usec );
-			int queueMax = mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( getProducer() ), "buffer" );
-			pthread_mutex_lock( &m_mutex );
-			if ( mlt_deque_count( m_queue ) < queueMax )
+			int queueMax = MIN( mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( getProducer() ), "buffer" ),
+				mlt_ring_capacity( m_queue ) );
+
+			// Make room by dropping the oldest frame for the lowest latency
+			if ( mlt_ring_count( m_queue ) >= queueMax &&
+				mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( getProducer() ), "drop_oldest" ) )
 			{
-				mlt_deque_push_back( m_queue, frame );
-				pthread_cond_broadcast( &m_condition );
+				if ( mlt_frame oldest = (mlt_frame) mlt_ring_pop( m_queue ) )
+				{
+					mlt_frame_close( oldest );
+					mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( getProducer() ), "dropped", ++m_dropped );
+					mlt_log_warning( getProducer(), "buffer overrun, oldest frame dropped %d\n", m_dropped );
+				}
 			}
-			else
+			if ( mlt_ring_count( m_queue ) >= queueMax || mlt_ring_push( m_queue, frame ) )
 			{
 				mlt_frame_close( frame );
 				mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( getProducer() ), "dropped", ++m_dropped );
 				mlt_log_warning( getProducer(), "buffer overrun, frame dropped %d\n", m_dropped );
 			}
-			pthread_mutex_unlock( &m_mutex );
 		}
 
 		return S_OK;
@@ -0,0 +1,229 @@
+/*
+ * v210.cpp -- 10-bit 4:2:2 packing for the DeckLink module
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "v210.h"
+
+#include <framework/mlt.h>
+
+#include <pthread.h>
+#include <stddef.h>
+
+// A v210 group is 4 words holding these samples, from the low bits:
+//   Cb0 Y0 Cr0 | Y1 Cb1 Y2 | Cr1 Y3 Cb2 | Y4 Cr2 Y5
+
+#define V210_WORD( a, b, c ) ( (uint32_t) ( a ) | ( (uint32_t) ( b ) << 10 ) | ( (uint32_t) ( c ) << 20 ) )
+#define V210_SAMPLE( w, i ) ( ( ( w ) >> ( 10 * ( i ) ) ) & 0x3FF )
+
+static inline uint32_t to_10bit( uint16_t s )
+{
+	return s >= 0xFFE0 ? 0x3FF : ( s + 32 ) >> 6;
+}
+
+typedef int ( *unpack_run )( const uint32_t* src, uint16_t* y, uint16_t* u, uint16_t* v, int width );
+typedef int ( *pack_run )( const uint16_t* y, const uint16_t* u, const uint16_t* v, uint32_t* dst, int width );
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define USE_X86_SIMD 1
+#include <immintrin.h>
+
+// Each step does a whole group, but loads or stores 8 luma and 4 of each chroma,
+// so it stops 2 pixels before the end of the row and leaves the rest to the caller.
+
+__attribute__((target("ssse3")))
+static int unpack_ssse3( const uint32_t* src, uint16_t* y, uint16_t* u, uint16_t* v, int width )
+{
+	const __m128i mask = _mm_set1_epi32( 0x3FF );
+	const __m128i y_ab = _mm_setr_epi8( 8, 9, 2, 3, -1, -1, 12, 13, 6, 7, -1, -1, -1, -1, -1, -1 );
+	const __m128i y_c  = _mm_setr_epi8( -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, 6, 7, -1, -1, -1, -1 );
+	const __m128i u_ab = _mm_setr_epi8( 0, 1, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 );
+	const __m128i u_c  = _mm_setr_epi8( -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 );
+	const __m128i v_ab = _mm_setr_epi8( -1, -1, 4, 5, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 );
+	const __m128i v_c  = _mm_setr_epi8( 0, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 );
+	int x;
+
+	for ( x = 0; x + 8 <= width; x += 6, src += 4 )
+	{
+		__m128i w = _mm_loadu_si128( (const __m128i*) src );
+		// The first, second and third sample of each word
+		__m128i a = _mm_and_si128( w, mask );
+		__m128i b = _mm_and_si128( _mm_srli_epi32( w, 10 ), mask );
+		__m128i c = _mm_and_si128( _mm_srli_epi32( w, 20 ), mask );
+		__m128i ab = _mm_packs_epi32( a, b );
+		__m128i cc = _mm_packs_epi32( c, c );
+		__m128i vy = _mm_or_si128( _mm_shuffle_epi8( ab, y_ab ), _mm_shuffle_epi8( cc, y_c ) );
+		__m128i vu = _mm_or_si128( _mm_shuffle_epi8( ab, u_ab ), _mm_shuffle_epi8( cc, u_c ) );
+		__m128i vv = _mm_or_si128( _mm_shuffle_epi8( ab, v_ab ), _mm_shuffle_epi8( cc, v_c ) );
+		_mm_storeu_si128( (__m128i*) ( y + x ), _mm_slli_epi16( vy, 6 ) );
+		_mm_storel_epi64( (__m128i*) ( u + x / 2 ), _mm_slli_epi16( vu, 6 ) );
+		_mm_storel_epi64( (__m128i*) ( v + x / 2 ), _mm_slli_epi16( vv, 6 ) );
+	}
+	return x;
+}
+
+__attribute__((target("ssse3")))
+static int pack_ssse3( const uint16_t* y, const uint16_t* u, const uint16_t* v, uint32_t* dst, int width )
+{
+	const __m128i round = _mm_set1_epi16( 32 );
+	const __m128i a_uv = _mm_setr_epi8( 0, 1, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1 );
+	const __m128i a_y  = _mm_setr_epi8( -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, -1, -1, 8, 9, -1, -1 );
+	const __m128i b_uv = _mm_setr_epi8( -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, -1, -1, 12, 13, -1, -1 );
+	const __m128i b_y  = _mm_setr_epi8( 0, 1, -1, -1, -1, -1, -1, -1, 6, 7, -1, -1, -1, -1, -1, -1 );
+	const __m128i c_uv = _mm_setr_epi8( 8, 9, -1, -1, -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1 );
+	const __m128i c_y  = _mm_setr_epi8( -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1 );
+	int x;
+
+	for ( x = 0; x + 8 <= width; x += 6, dst += 4 )
+	{
+		__m128i vy = _mm_loadu_si128( (const __m128i*) ( y + x ) );
+		__m128i uv = _mm_unpacklo_epi64( _mm_loadl_epi64( (const __m128i*) ( u + x / 2 ) ),
+			_mm_loadl_epi64( (const __m128i*) ( v + x / 2 ) ) );
+		// Saturating the rounding gives 1023 for the top values like to_10bit
+		vy = _mm_srli_epi16( _mm_adds_epu16( vy, round ), 6 );
+		uv = _mm_srli_epi16( _mm_adds_epu16( uv, round ), 6 );
+		__m128i a = _mm_or_si128( _mm_shuffle_epi8( uv, a_uv ), _mm_shuffle_epi8( vy, a_y ) );
+		__m128i b = _mm_or_si128( _mm_shuffle_epi8( uv, b_uv ), _mm_shuffle_epi8( vy, b_y ) );
+		__m128i c = _mm_or_si128( _mm_shuffle_epi8( uv, c_uv ), _mm_shuffle_epi8( vy, c_y ) );
+		__m128i w = _mm_or_si128( a, _mm_or_si128( _mm_slli_epi32( b, 10 ), _mm_slli_epi32( c, 20 ) ) );
+		_mm_storeu_si128( (__m128i*) dst, w );
+	}
+	return x;
+}
+
+#endif
+
+static struct
+{
+	unpack_run unpack;
+	pack_run pack;
+} g_simd;
+static pthread_once_t g_simd_once = PTHREAD_ONCE_INIT;
+
+static void simd_init( void )
+{
+#if USE_X86_SIMD
+	static const mlt_cpu_dispatch unpack[] = {
+		{ mlt_cpu_ssse3, (void*) unpack_ssse3 },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch pack[] = {
+		{ mlt_cpu_ssse3, (void*) pack_ssse3 },
+		{ 0, NULL }
+	};
+#else
+	static const mlt_cpu_dispatch unpack[] = { { 0, NULL } };
+	static const mlt_cpu_dispatch pack[] = { { 0, NULL } };
+#endif
+	g_simd.unpack = (unpack_run) mlt_cpu_select( unpack );
+	g_simd.pack = (pack_run) mlt_cpu_select( pack );
+}
+
+void v210_unpack_row( const uint32_t* src, uint16_t* y, uint16_t* u, uint16_t* v, int width )
+{
+	int x = 0;
+
+	pthread_once( &g_simd_once, simd_init );
+	if ( g_simd.unpack )
+		x = g_simd.unpack( src, y, u, v, width );
+	for ( src += x / 6 * 4; x < width; x += 6, src += 4 )
+	{
+		uint16_t ys[6], us[3], vs[3];
+		int i;
+
+		us[0] = V210_SAMPLE( src[0], 0 ) << 6;
+		ys[0] = V210_SAMPLE( src[0], 1 ) << 6;
+		vs[0] = V210_SAMPLE( src[0], 2 ) << 6;
+		ys[1] = V210_SAMPLE( src[1], 0 ) << 6;
+		us[1] = V210_SAMPLE( src[1], 1 ) << 6;
+		ys[2] = V210_SAMPLE( src[1], 2 ) << 6;
+		vs[1] = V210_SAMPLE( src[2], 0 ) << 6;
+		ys[3] = V210_SAMPLE( src[2], 1 ) << 6;
+		us[2] = V210_SAMPLE( src[2], 2 ) << 6;
+		ys[4] = V210_SAMPLE( src[3], 0 ) << 6;
+		vs[2] = V210_SAMPLE( src[3], 1 ) << 6;
+		ys[5] = V210_SAMPLE( src[3], 2 ) << 6;
+		for ( i = 0; i < 6 && x + i < width; i++ )
+			y[ x + i ] = ys[i];
+		for ( i = 0; i < 3 && x + 2 * i + 1 < width; i++ )
+		{
+			u[ x / 2 + i ] = us[i];
+			v[ x / 2 + i ] = vs[i];
+		}
+	}
+}
+
+void v210_pack_row( const uint16_t* y, const uint16_t* u, const uint16_t* v, uint32_t* dst, int width )
+{
+	int x = 0;
+
+	pthread_once( &g_simd_once, simd_init );
+	if ( g_simd.pack )
+		x = g_simd.pack( y, u, v, dst, width );
+	for ( dst += x / 6 * 4; x < width; x += 6, dst += 4 )
+	{
+		// The pixels past the end of the row are black
+		uint32_t ys[6] = { 64, 64, 64, 64, 64, 64 }, us[3] = { 512, 512, 512 }, vs[3] = { 512, 512, 512 };
+		int i;
+
+		for ( i = 0; i < 6 && x + i < width; i++ )
+			ys[i] = to_10bit( y[ x + i ] );
+		for ( i = 0; i < 3 && x + 2 * i + 1 < width; i++ )
+		{
+			us[i] = to_10bit( u[ x / 2 + i ] );
+			vs[i] = to_10bit( v[ x / 2 + i ] );
+		}
+		dst[0] = V210_WORD( us[0], ys[0], vs[0] );
+		dst[1] = V210_WORD( ys[1], us[1], ys[2] );
+		dst[2] = V210_WORD( vs[1], ys[3], us[2] );
+		dst[3] = V210_WORD( ys[4], vs[2], ys[5] );
+	}
+}
+
+void v210_pack_yuv422_row( const uint8_t* yuv, uint32_t* dst, int width )
+{
+	int x;
+
+	for ( x = 0; x < width; x += 6, dst += 4 )
+	{
+		uint32_t ys[6] = { 64, 64, 64, 64, 64, 64 }, us[3] = { 512, 512, 512 }, vs[3] = { 512, 512, 512 };
+		int i;
+
+		for ( i = 0; i < 6 && x + i < width; i++ )
+			ys[i] = yuv[ 2 * ( x + i ) ] << 2;
+		for ( i = 0; i < 3 && x + 2 * i + 1 < width; i++ )
+		{
+			us[i] = yuv[ 2 * ( x + 2 * i ) + 1 ] << 2;
+			vs[i] = yuv[ 2 * ( x + 2 * i ) + 3 ] << 2;
+		}
+		dst[0] = V210_WORD( us[0], ys[0], vs[0] );
+		dst[1] = V210_WORD( ys[1], us[1], ys[2] );
+		dst[2] = V210_WORD( vs[1], ys[3], us[2] );
+		dst[3] = V210_WORD( ys[4], vs[2], ys[5] );
+	}
+}
+
+void v210_black_row( uint32_t* dst, int width )
+{
+	int x;
+
+	for ( x = 0; x < width; x += 6, dst += 4 )
+	{
+		dst[0] = dst[2] = V210_WORD( 512, 64, 512 );
+		dst[1] = dst[3] = V210_WORD( 64, 512, 64 );
+	}
+}
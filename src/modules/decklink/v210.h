@@ -0,0 +1,54 @@
+/*
+ * v210.h -- 10-bit 4:2:2 packing for the DeckLink module
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef DECKLINK_V210_H
+#define DECKLINK_V210_H
+
+#include <stdint.h>
+
+/** Get the bytes in a v210 row of \p width pixels.
+ *
+ * v210 packs 6 pixels into 4 little-endian words of three 10-bit samples,
+ * and rows are padded to a multiple of 48 pixels.
+ */
+
+static inline int v210_row_bytes( int width )
+	{ return ( width + 47 ) / 48 * 128; }
+
+/** Unpack a v210 row into the planes of mlt_image_yuv422p16.
+ * The 10-bit samples go to the high bits of 16.
+ */
+
+void v210_unpack_row( const uint32_t* src, uint16_t* y, uint16_t* u, uint16_t* v, int width );
+
+/** Pack a row of the planes of mlt_image_yuv422p16 into v210.
+ * The samples are rounded to 10 bits.
+ */
+
+void v210_pack_row( const uint16_t* y, const uint16_t* u, const uint16_t* v, uint32_t* dst, int width );
+
+/** Pack a row of mlt_image_yuv422 into v210. */
+
+void v210_pack_yuv422_row( const uint8_t* yuv, uint32_t* dst, int width );
+
+/** Fill a v210 row of \p width pixels with black. */
+
+void v210_black_row( uint32_t* dst, int width );
+
+#endif // DECKLINK_V210_H
@@ -91,6 +91,22 @@ static void check_thread_safe(mlt_properties properties, const char *name)
 		}
 	}
 	mlt_properties_close(not_thread_safe);
+
+	if (mlt_properties_get_int(properties, "_not_thread_safe"))
+	{
+		// Some of them only need an instance for each thread.
+		snprintf(dirname, PATH_MAX, "%s/frei0r/instance_per_thread.txt", mlt_environment("MLT_DATA"));
+		mlt_properties instance_per_thread = mlt_properties_load(dirname);
+		for (i = 0; i < mlt_properties_count(instance_per_thread); i++)
+		{
+			if (!strcmp(name, mlt_properties_get_name(instance_per_thread, i)))
+			{
+				mlt_properties_set_int(properties, "_instance_per_thread", 1);
+				break;
+			}
+		}
+		mlt_properties_close(instance_per_thread);
+	}
 }
 
 static mlt_properties fill_param_info(mlt_service_type type, const char *service_name, char *name)
@@ -27,6 +27,127 @@
 
 const char *CAIROBLEND_MODE_PROPERTY = "frei0r.cairoblend.mode";
 
+// The most sizes kept with instances for, such as when the preview scale changes
+#define MAX_INSTANCE_SIZES 4
+
+// The value last given to a parameter of an instance
+struct param_cache {
+	int is_set;
+	double value;
+	f0r_param_color_t color;
+	char *string;
+};
+
+// An instance and what it needs to be reused, kept in the "ctor-" properties
+struct instance_item {
+	f0r_instance_t instance;
+	int width;
+	int height;
+	int in_use;
+	int64_t last_used;
+	int param_count;
+	struct param_cache *params;
+};
+
+static void instance_item_close( struct instance_item *item, void (*f0r_destruct) (f0r_instance_t instance) )
+{
+	int i;
+
+	if (f0r_destruct)
+		f0r_destruct(item->instance);
+	for (i = 0; i < item->param_count; i++)
+		free(item->params[i].string);
+	free(item->params);
+	free(item);
+}
+
+static struct instance_item *instance_item_at( mlt_properties prop, int i )
+{
+	const char *name = mlt_properties_get_name(prop, i);
+	if (!name || strncmp(name, "ctor-", 5))
+		return NULL;
+	return mlt_properties_get_data_at(prop, i, NULL);
+}
+
+// Destroy the idle instances of the least recently used sizes beyond MAX_INSTANCE_SIZES,
+// counting the size of an instance that is about to be made.
+static void evict_instances( mlt_properties prop, int width, int height )
+{
+	void (*f0r_destruct) (f0r_instance_t instance) = mlt_properties_get_data(prop, "f0r_destruct", NULL);
+	int count = mlt_properties_count(prop);
+	struct { int width, height; int64_t last_used; } *sizes = calloc(count + 1, sizeof(*sizes));
+	int n = 1, i, j;
+
+	if (!sizes)
+		return;
+	sizes[0].width = width;
+	sizes[0].height = height;
+	sizes[0].last_used = INT64_MAX;
+	for (i = 0; i < count; i++) {
+		struct instance_item *item = instance_item_at(prop, i);
+		if (!item)
+			continue;
+		for (j = 0; j < n && (sizes[j].width != item->width || sizes[j].height != item->height); j++);
+		if (j == n) {
+			sizes[n].width = item->width;
+			sizes[n].height = item->height;
+			sizes[n++].last_used = item->last_used;
+		} else {
+			sizes[j].last_used = MAX(sizes[j].last_used, item->last_used);
+		}
+	}
+	while (n > MAX_INSTANCE_SIZES) {
+		int oldest = 0;
+		for (j = 1; j < n; j++)
+			if (sizes[j].last_used < sizes[oldest].last_used)
+				oldest = j;
+		for (i = 0; i < count; i++) {
+			struct instance_item *item = instance_item_at(prop, i);
+			if (item && !item->in_use && item->width == sizes[oldest].width && item->height == sizes[oldest].height) {
+				mlt_properties_set_data(prop, mlt_properties_get_name(prop, i), NULL, 0, NULL, NULL);
+				instance_item_close(item, f0r_destruct);
+			}
+		}
+		sizes[oldest] = sizes[--n];
+	}
+	free(sizes);
+}
+
+// Only give the instance a parameter value that differs from the last one
+static void set_param_double( void (*f0r_set_param_value) (f0r_instance_t, f0r_param_t, int),
+	struct instance_item *item, double value, int i )
+{
+	struct param_cache *cache = &item->params[i];
+	if (!cache->is_set || cache->value != value) {
+		f0r_set_param_value(item->instance, &value, i);
+		cache->value = value;
+		cache->is_set = 1;
+	}
+}
+
+static void set_param_color( void (*f0r_set_param_value) (f0r_instance_t, f0r_param_t, int),
+	struct instance_item *item, f0r_param_color_t *color, int i )
+{
+	struct param_cache *cache = &item->params[i];
+	if (!cache->is_set || cache->color.r != color->r || cache->color.g != color->g || cache->color.b != color->b) {
+		f0r_set_param_value(item->instance, color, i);
+		cache->color = *color;
+		cache->is_set = 1;
+	}
+}
+
+static void set_param_string( void (*f0r_set_param_value) (f0r_instance_t, f0r_param_t, int),
+	struct instance_item *item, char *value, int i )
+{
+	struct param_cache *cache = &item->params[i];
+	if (!cache->is_set || !cache->string != !value || (value && strcmp(cache->string, value))) {
+		f0r_set_param_value(item->instance, &value, i);
+		free(cache->string);
+		cache->string = value ? strdup(value) : NULL;
+		cache->is_set = 1;
+	}
+}
+
 static void rgba_bgra( uint8_t *src, uint8_t* dst, int width, int height )
 {
 	int n = width * height + 1;
@@ -102,7 +223,12 @@ int process_frei0r_item( mlt_service service, mlt_position position, double time
 	                     const uint32_t* inframe2, const uint32_t* inframe3, uint32_t* outframe)
 			= mlt_properties_get_data(prop, "f0r_update2", NULL);
 	mlt_service_type type = mlt_service_identify(service);
-	int not_thread_safe = mlt_properties_get_int(prop, "_not_thread_safe");
+	// A plugin that is only unsafe to share gets an instance for each thread, which
+	// lets frames render in parallel. The rest, such as those that carry state from
+	// one frame to the next, keep one instance and take turns with it.
+	int instance_per_thread = mlt_properties_get_int(prop, "_not_thread_safe") &&
+		mlt_properties_get_int(prop, "_instance_per_thread");
+	int not_thread_safe = mlt_properties_get_int(prop, "_not_thread_safe") && !instance_per_thread;
 	int slice_count = mlt_properties_get(prop, "threads") ? mlt_properties_get_int(prop, "threads") : -1;
 	const char *service_name = mlt_properties_get(prop, "mlt_service");
 	int is_cairoblend = service_name && !strcmp("frei0r.cairoblend", service_name);
@@ -115,6 +241,9 @@ int process_frei0r_item( mlt_service service, mlt_position position, double time
 	} else {
 		slice_count = CLAMP(slice_count, 1, mlt_slices_count_normal());
 	}
+	// An instance that is not thread safe cannot be shared among slices
+	if (instance_per_thread)
+		slice_count = 1;
 	// Reduce the slice count until the height is a multiple of slices
 	while (slice_count > 1 && (*height % slice_count)) {
 		--slice_count;
@@ -132,21 +261,37 @@ int process_frei0r_item( mlt_service service, mlt_position position, double time
 		sprintf(ctorname, "ctor-%dx%d-%p", *width, slice_height, (void*) pthread_self());
 #endif
 
+	f0r_plugin_info_t info;
+	memset(&info, 0, sizeof(info));
+	if (f0r_get_plugin_info)
+		f0r_get_plugin_info(&info);
+
 	mlt_service_lock(service);
 
-	f0r_instance_t inst = mlt_properties_get_data(prop, ctorname, NULL);
-	if (!inst) {
-		inst = f0r_construct(*width, slice_height);
-		mlt_properties_set_data(prop, ctorname, inst, 0, NULL, NULL);
+	struct instance_item *item = mlt_properties_get_data(prop, ctorname, NULL);
+	if (!item) {
+		evict_instances(prop, *width, slice_height);
+		item = calloc(1, sizeof(*item));
+		item->instance = f0r_construct(*width, slice_height);
+		item->width = *width;
+		item->height = slice_height;
+		mlt_properties_set_data(prop, ctorname, item, 0, NULL, NULL);
+	}
+	if (item->param_count < info.num_params) {
+		item->params = realloc(item->params, info.num_params * sizeof(struct param_cache));
+		memset(item->params + item->param_count, 0, (info.num_params - item->param_count) * sizeof(struct param_cache));
+		item->param_count = info.num_params;
 	}
+	// The clock orders the uses for evict_instances()
+	static int64_t clock = 0;
+	item->last_used = __sync_add_and_fetch(&clock, 1);
+	item->in_use = 1;
+	f0r_instance_t inst = item->instance;
 
 	if (!not_thread_safe && slice_count == 1)
 		mlt_service_unlock(service);
 
-	f0r_plugin_info_t info;
-	memset(&info, 0, sizeof(info));
 	if (f0r_get_plugin_info) {
-		f0r_get_plugin_info(&info);
 		for (i = 0; i < info.num_params; i++) {
 			prop = MLT_SERVICE_PROPERTIES(service);
 			f0r_param_info_t pinfo;
@@ -169,6 +314,7 @@ int process_frei0r_item( mlt_service service, mlt_position position, double time
 					f0r_get_param_value(inst, &plugin_val, i);
 					if (plugin_val && strcmp(default_val, plugin_val)) {
 						f0r_set_param_value(inst, &default_val, i);
+						item->params[i].is_set = 0;
 						continue;
 					}
 				}
@@ -201,7 +347,7 @@ int process_frei0r_item( mlt_service service, mlt_position position, double time
 							if (scale2 != 0.0)
 								t *= scale * scale2;
 						}
-						f0r_set_param_value(inst,&t,i);
+						set_param_double(f0r_set_param_value, item, t, i);
 						break;
 					}
 					case F0R_PARAM_COLOR:
@@ -212,13 +358,13 @@ int process_frei0r_item( mlt_service service, mlt_position position, double time
 						f_color.r = (float) m_color.r / 255.0f;
 						f_color.g = (float) m_color.g / 255.0f;
 						f_color.b = (float) m_color.b / 255.0f;
-						f0r_set_param_value(inst, &f_color, i);
+						set_param_color(f0r_set_param_value, item, &f_color, i);
 						break;
 					}
 					case F0R_PARAM_STRING:
 					{
 						val = mlt_properties_anim_get(prop, name, position, length);
-						f0r_set_param_value(inst, &val, i);
+						set_param_string(f0r_set_param_value, item, val, i);
 						break;
 					}
 				}
@@ -292,8 +438,10 @@ int process_frei0r_item( mlt_service service, mlt_position position, double time
 			f0r_update2(inst, time, source[0], source[1], NULL, dest);
 		}
 	}
-	if (not_thread_safe || slice_count != 1)
-		mlt_service_unlock(service);
+	if (!not_thread_safe && slice_count == 1)
+		mlt_service_lock(service);
+	item->in_use = 0;
+	mlt_service_unlock(service);
 	if (info.color_model == F0R_COLOR_MODEL_BGRA8888) {
 		rgba_bgra((uint8_t*) dest, (uint8_t*) result, *width, *height);
 	}
@@ -315,11 +463,9 @@ void destruct (mlt_properties prop ) {
 		f0r_deinit();
 
 	for (i=0; i < mlt_properties_count(prop); i++) {
-		if (strstr(mlt_properties_get_name(prop, i), "ctor-")) {
-			void * inst = mlt_properties_get_data(prop, mlt_properties_get_name(prop, i), NULL);
-			if (inst) {
-				f0r_destruct((f0r_instance_t) inst);
-			}
+		struct instance_item *item = instance_item_at(prop, i);
+		if (item) {
+			instance_item_close(item, f0r_destruct);
 		}
 	}
 	void (*dlclose) (void*) = mlt_properties_get_data(prop, "_dlclose", NULL);
@@ -28,11 +28,14 @@
 #include <stdio.h>
 
 #include "pixops.h"
+#include <framework/mlt_cpu.h>
+#include <framework/mlt_slices.h>
 
 #define SUBSAMPLE_BITS 4
 #define SUBSAMPLE (1 << SUBSAMPLE_BITS)
 #define SUBSAMPLE_MASK ((1 << SUBSAMPLE_BITS)-1)
 #define SCALE_SHIFT 16
+#define MIN_SLICE_HEIGHT 16
 
 typedef struct _PixopsFilter PixopsFilter;
 typedef struct _PixopsFilterDimension PixopsFilterDimension;
@@ -62,7 +65,6 @@ typedef void ( *PixopsPixelFunc ) ( guchar *dest, guint y1, guint cr, guint y2,
 /* mmx function declarations */
 #if defined(USE_MMX) && !defined(ARCH_X86_64)
 guchar *pixops_scale_line_22_yuv_mmx ( guint32 weights[ 16 ][ 8 ], guchar *p, guchar *q1, guchar *q2, int x_step, guchar *p_stop, int x_init, int destx );
-int _pixops_have_mmx ( void );
 #endif
 
 static inline int
@@ -342,65 +344,60 @@ make_filter_table ( PixopsFilter *filter )
 }
 
 
-static inline void
-pixops_process ( guchar *dest_buf,
-                 int render_x0,
-                 int render_y0,
-                 int render_x1,
-                 int render_y1,
-                 int dest_rowstride,
-                 int dest_channels,
-                 gboolean dest_has_alpha,
-                 const guchar *src_buf,
-                 int src_width,
-                 int src_height,
-                 int src_rowstride,
-                 int src_channels,
-                 gboolean src_has_alpha,
-                 double scale_x,
-                 double scale_y,
-                 int check_x,
-                 int check_y,
-                 int check_size,
-                 guint32 color1,
-                 guint32 color2,
-                 PixopsFilter *filter,
-                 PixopsLineFunc line_func )
+typedef struct
 {
+	guchar *dest_buf;
+	int render_x0;
+	int render_x1;
+	int dest_rowstride;
+	int dest_channels;
+	const guchar *src_buf;
+	int src_width;
+	int src_height;
+	int src_rowstride;
+	int src_channels;
+	int check_x;
+	PixopsFilter *filter;
+	PixopsLineFunc line_func;
+	int *filter_weights;
+	int x_step;
+	int y_step;
+	int y_init;
+	int scaled_x_offset;
+	int run_end_index;
+	int rows;
+} PixopsJob;
+
+static void
+pixops_process_rows ( PixopsJob *job, int row0, int row1 )
+{
+	PixopsFilter *filter = job->filter;
+	guchar *dest_buf = job->dest_buf;
+	const guchar *src_buf = job->src_buf;
+	int dest_rowstride = job->dest_rowstride;
+	int dest_channels = job->dest_channels;
+	int src_channels = job->src_channels;
+	int src_width = job->src_width;
+	int src_height = job->src_height;
+	int src_rowstride = job->src_rowstride;
+	int render_x0 = job->render_x0;
+	int render_x1 = job->render_x1;
+	int check_x = job->check_x;
+	int x_step = job->x_step;
+	int scaled_x_offset = job->scaled_x_offset;
+	int run_end_index = job->run_end_index;
 	int i, j;
 	int x, y;			/* X and Y position in source (fixed_point) */
 
 	guchar **line_bufs = g_new ( guchar *, filter->y.n );
-	int *filter_weights = make_filter_table ( filter );
 
-	int x_step = ( 1 << SCALE_SHIFT ) / scale_x; /* X step in source (fixed point) */
-	int y_step = ( 1 << SCALE_SHIFT ) / scale_y; /* Y step in source (fixed point) */
-
-	int scaled_x_offset = floor ( filter->x.offset * ( 1 << SCALE_SHIFT ) );
-
-	/* Compute the index where we run off the end of the source buffer. The furthest
-	 * source pixel we access at index i is:
-	 *
-	 *  ((render_x0 + i) * x_step + scaled_x_offset) >> SCALE_SHIFT + filter->x.n - 1
-	 *
-	 * So, run_end_index is the smallest i for which this pixel is src_width, i.e, for which:
-	 *
-	 *  (i + render_x0) * x_step >= ((src_width - filter->x.n + 1) << SCALE_SHIFT) - scaled_x_offset
-	 *
-	 */
-#define MYDIV(a,b) ((a) > 0 ? (a) / (b) : ((a) - (b) + 1) / (b))    /* Division so that -1/5 = -1 */
-
-	int run_end_x = ( ( ( src_width - filter->x.n + 1 ) << SCALE_SHIFT ) - scaled_x_offset );
-	int run_end_index = MYDIV ( run_end_x + x_step - 1, x_step ) - render_x0;
-	run_end_index = MIN ( run_end_index, render_x1 - render_x0 );
-
-	y = render_y0 * y_step + floor ( filter->y.offset * ( 1 << SCALE_SHIFT ) );
-	for ( i = 0; i < ( render_y1 - render_y0 ); i++ )
+	y = job->y_init + row0 * job->y_step;
+	for ( i = row0; i < row1; i++ )
 	{
 		int dest_x;
 		int y_start = y >> SCALE_SHIFT;
 		int x_start;
-		int *run_weights = filter_weights +
+		int *run_weights = job->filter_weights +
 		                   ( ( y >> ( SCALE_SHIFT - SUBSAMPLE_BITS ) ) & SUBSAMPLE_MASK ) *
 		                   filter->x.n * filter->y.n * SUBSAMPLE;
 		guchar *new_outbuf;
@@ -438,11 +435,11 @@ pixops_process ( guchar *dest_buf,
 			outbuf += dest_channels;
 		}
 
-		new_outbuf = ( *line_func ) ( run_weights, filter->x.n, filter->y.n,
-		                              outbuf, dest_x,
-		                              dest_buf + dest_rowstride * i + run_end_index * dest_channels,
-		                              line_bufs,
-		                              x, x_step, src_width );
+		new_outbuf = ( *job->line_func ) ( run_weights, filter->x.n, filter->y.n,
+		                                   outbuf, dest_x,
+		                                   dest_buf + dest_rowstride * i + run_end_index * dest_channels,
+		                                   line_bufs,
+		                                   x, x_step, src_width );
 
 		dest_x += ( new_outbuf - outbuf ) / dest_channels;
 
@@ -462,10 +459,83 @@ pixops_process ( guchar *dest_buf,
 			outbuf += dest_channels;
 		}
 
-		y += y_step;
+		y += job->y_step;
 	}
 
 	g_free ( line_bufs );
+}
+
+static int
+pixops_slice_proc ( int id, int index, int jobs, void *cookie )
+{
+	( void ) id; // unused
+	PixopsJob *job = cookie;
+
+	pixops_process_rows ( job, job->rows * index / jobs, job->rows * ( index + 1 ) / jobs );
+	return 0;
+}
+
+static inline void
+pixops_process ( guchar *dest_buf,
+                 int render_x0,
+                 int render_y0,
+                 int render_x1,
+                 int render_y1,
+                 int dest_rowstride,
+                 int dest_channels,
+                 gboolean dest_has_alpha,
+                 const guchar *src_buf,
+                 int src_width,
+                 int src_height,
+                 int src_rowstride,
+                 int src_channels,
+                 gboolean src_has_alpha,
+                 double scale_x,
+                 double scale_y,
+                 int check_x,
+                 int check_y,
+                 int check_size,
+                 guint32 color1,
+                 guint32 color2,
+                 PixopsFilter *filter,
+                 PixopsLineFunc line_func )
+{
+	int *filter_weights = make_filter_table ( filter );
+
+	int x_step = ( 1 << SCALE_SHIFT ) / scale_x; /* X step in source (fixed point) */
+	int y_step = ( 1 << SCALE_SHIFT ) / scale_y; /* Y step in source (fixed point) */
+
+	int scaled_x_offset = floor ( filter->x.offset * ( 1 << SCALE_SHIFT ) );
+
+	/* Compute the index where we run off the end of the source buffer. The furthest
+	 * source pixel we access at index i is:
+	 *
+	 *  ((render_x0 + i) * x_step + scaled_x_offset) >> SCALE_SHIFT + filter->x.n - 1
+	 *
+	 * So, run_end_index is the smallest i for which this pixel is src_width, i.e, for which:
+	 *
+	 *  (i + render_x0) * x_step >= ((src_width - filter->x.n + 1) << SCALE_SHIFT) - scaled_x_offset
+	 *
+	 */
+#define MYDIV(a,b) ((a) > 0 ? (a) / (b) : ((a) - (b) + 1) / (b))    /* Division so that -1/5 = -1 */
+
+	int run_end_x = ( ( ( src_width - filter->x.n + 1 ) << SCALE_SHIFT ) - scaled_x_offset );
+	int run_end_index = MYDIV ( run_end_x + x_step - 1, x_step ) - render_x0;
+	run_end_index = MIN ( run_end_index, render_x1 - render_x0 );
+
+	PixopsJob job = { dest_buf, render_x0, render_x1, dest_rowstride, dest_channels,
+	                  src_buf, src_width, src_height, src_rowstride, src_channels,
+	                  check_x, filter, line_func, filter_weights,
+	                  x_step, y_step, 0, scaled_x_offset, run_end_index, render_y1 - render_y0 };
+	job.y_init = render_y0 * y_step + floor ( filter->y.offset * ( 1 << SCALE_SHIFT ) );
+
+	/* The rows are independent, so they are shared among the slice threads. */
+	int jobs = CLAMP ( mlt_slices_count_normal(), 1, MAX ( job.rows / MIN_SLICE_HEIGHT, 1 ) );
+	if ( jobs == 1 )
+		pixops_process_rows ( &job, 0, job.rows );
+	else
+		mlt_slices_run_normal ( jobs, pixops_slice_proc, &job );
+
 	g_free ( filter_weights );
 }
 
@@ -704,7 +774,7 @@ yuv422_scale ( guchar *dest_buf,
 	PixopsLineFunc line_func;
 
 #if defined(USE_MMX) && !defined(ARCH_X86_64)
-	gboolean found_mmx = _pixops_have_mmx();
+	gboolean found_mmx = mlt_cpu_has( mlt_cpu_mmx );
 #endif
 
 	//g_return_if_fail ( !( dest_channels == 3 && dest_has_alpha ) );
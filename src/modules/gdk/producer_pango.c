@@ -48,6 +48,8 @@ struct pango_cached_image_s
 	uint8_t *image, *alpha;
 	mlt_image_format format;
 	int width, height;
+	mlt_rect alpha_bounds;  /**< where the text is, for compositors to skip the rest */
+	int opaque;
 };
 
 static void pango_cached_image_destroy( void* p )
@@ -90,6 +92,7 @@ struct producer_pango_s
 	int   wrap_width;
 	int   line_spacing;
 	double aspect_ratio;
+	char *cache_key;
 };
 
 static void clean_cached( producer_pango self )
@@ -103,6 +106,77 @@ typedef struct
 	uint8_t r, g, b, a;
 } rgba_color;
 
+/** A process-wide cache of rendered and scaled titles.
+ *
+ * Entries are keyed by everything that goes into rendering a title, so any
+ * producers with the same text and style share them. Scaled copies are kept
+ * with the size and interpolation they were scaled to, and a width of 0 marks
+ * the rendered original. The least recently used entry is dropped when full.
+ * It is protected by pango_mutex.
+ */
+
+#define PANGO_CACHE_SIZE (128)
+
+typedef struct
+{
+	char *key;
+	int width, height, interp;
+	GdkPixbuf *pixbuf;
+} pango_cache_entry;
+
+static pango_cache_entry pango_cache[ PANGO_CACHE_SIZE ];
+static int pango_cache_count = 0;
+
+/** Get a new reference to a cached title or NULL.
+*/
+
+static GdkPixbuf *pango_cache_get( const char *key, int width, int height, int interp )
+{
+	int i;
+	for ( i = 0; key && i < pango_cache_count; i++ )
+	{
+		pango_cache_entry *entry = &pango_cache[ i ];
+		if ( entry->width == width && entry->height == height && entry->interp == interp && !strcmp( entry->key, key ) )
+		{
+			// Move it to the front
+			pango_cache_entry found = *entry;
+			memmove( &pango_cache[ 1 ], &pango_cache[ 0 ], i * sizeof( pango_cache_entry ) );
+			pango_cache[ 0 ] = found;
+			return g_object_ref( found.pixbuf );
+		}
+	}
+	return NULL;
+}
+
+static void pango_cache_put( const char *key, int width, int height, int interp, GdkPixbuf *pixbuf )
+{
+	if ( !key || !pixbuf )
+		return;
+	if ( pango_cache_count == PANGO_CACHE_SIZE )
+	{
+		pango_cache_entry *last = &pango_cache[ --pango_cache_count ];
+		free( last->key );
+		g_object_unref( last->pixbuf );
+	}
+	memmove( &pango_cache[ 1 ], &pango_cache[ 0 ], pango_cache_count * sizeof( pango_cache_entry ) );
+	pango_cache[ 0 ].key = strdup( key );
+	pango_cache[ 0 ].width = width;
+	pango_cache[ 0 ].height = height;
+	pango_cache[ 0 ].interp = interp;
+	pango_cache[ 0 ].pixbuf = g_object_ref( pixbuf );
+	pango_cache_count++;
+}
+
+static void pango_cache_clear( )
+{
+	while ( pango_cache_count > 0 )
+	{
+		pango_cache_entry *last = &pango_cache[ --pango_cache_count ];
+		free( last->key );
+		g_object_unref( last->pixbuf );
+	}
+}
+
 // Forward declarations
 static int producer_get_frame( mlt_producer parent, mlt_frame_ptr frame, int index );
 static void producer_close( mlt_producer parent );
@@ -386,6 +460,39 @@ static int iconv_utf8( mlt_properties properties, const char *prop_name, const c
 	return result;
 }
 
+/** Append a string to a cache key with its length, so keys can not run into each other.
+*/
+
+static void append_key_string( char **key, const char *value )
+{
+	char *old = *key;
+	size_t size = strlen( old ) + ( value ? strlen( value ) : 0 ) + 24;
+	*key = malloc( size );
+	if ( value )
+		snprintf( *key, size, "%s%zu:%s", old, strlen( value ), value );
+	else
+		snprintf( *key, size, "%s-", old );
+	free( old );
+}
+
+static char *pango_cache_key( const char *markup, const char *text, const char *font,
+		rgba_color fg, rgba_color bg, rgba_color ol, int pad, int align, const char* family,
+		int style, int weight, int stretch, int size, int outline, int rotate,
+		int width_crop, int width_fit, int wrap_type, int wrap_width,
+		int line_spacing, double aspect_ratio )
+{
+	char *key = malloc( 256 );
+	snprintf( key, 256, "%02x%02x%02x%02x %02x%02x%02x%02x %02x%02x%02x%02x %d %d %d %d %d %d %d %d %d %d %d %d %d %d %.17g ",
+		fg.r, fg.g, fg.b, fg.a, bg.r, bg.g, bg.b, bg.a, ol.r, ol.g, ol.b, ol.a,
+		pad, align, style, weight, stretch, size, outline, rotate,
+		width_crop, width_fit, wrap_type, wrap_width, line_spacing, aspect_ratio );
+	append_key_string( &key, markup );
+	append_key_string( &key, text );
+	append_key_string( &key, font );
+	append_key_string( &key, family );
+	return key;
+}
+
 static void refresh_image( producer_pango self, mlt_frame frame, int width, int height )
 {
 	// Pixbuf
@@ -513,11 +620,21 @@ static void refresh_image( producer_pango self, mlt_frame frame, int width, int
 			}
 		}
 		
-		// Render the title
-		pixbuf = pango_get_pixbuf( markup, text, font, fgcolor, bgcolor, olcolor, pad, align, family,
+		// Render the title, unless another producer already did
+		free( self->cache_key );
+		self->cache_key = pango_cache_key( markup, text, font, fgcolor, bgcolor, olcolor, pad, align, family,
 			style, weight, stretch, size, outline, rotate,
 			width_crop, width_fit, wrap_type, wrap_width,
 			line_spacing, aspect_ratio );
+		pixbuf = pango_cache_get( self->cache_key, 0, 0, 0 );
+		if ( pixbuf == NULL )
+		{
+			pixbuf = pango_get_pixbuf( markup, text, font, fgcolor, bgcolor, olcolor, pad, align, family,
+				style, weight, stretch, size, outline, rotate,
+				width_crop, width_fit, wrap_type, wrap_width,
+				line_spacing, aspect_ratio );
+			pango_cache_put( self->cache_key, 0, 0, 0, pixbuf );
+		}
 
 		if ( pixbuf != NULL )
 		{
@@ -559,7 +676,12 @@ static void refresh_image( producer_pango self, mlt_frame frame, int width, int
 // fprintf(stderr,"%s: scaling from %dx%d to %dx%d\n", __FILE__, self->width, self->height, width, height);
 
 		// Note - the original pixbuf is already safe and ready for destruction
-		self->pixbuf = gdk_pixbuf_scale_simple( pixbuf, width, height, interp );
+		self->pixbuf = pango_cache_get( self->cache_key, width, height, interp );
+		if ( self->pixbuf == NULL )
+		{
+			self->pixbuf = gdk_pixbuf_scale_simple( pixbuf, width, height, interp );
+			pango_cache_put( self->cache_key, width, height, interp, self->pixbuf );
+		}
 		clean_cached( self );
 
 		// Store width and height
@@ -664,6 +786,13 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 				cached->alpha = mlt_pool_alloc( size );
 				memcpy( cached->alpha, buf, size );
 			}
+
+			// Find the text once for all the frames that share the image
+			struct mlt_image_s image;
+			mlt_image_set_values( &image, cached->image, cached->format, cached->width, cached->height );
+			image.planes[3] = cached->alpha;
+			image.strides[3] = cached->width;
+			cached->opaque = mlt_image_alpha_bounds( &image, &cached->alpha_bounds );
 		}
 
 		if ( cached )
@@ -685,6 +814,7 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 				memcpy( buf, cached->alpha, size );
 				mlt_frame_set_alpha( frame, buf, size, mlt_pool_release );
 			}
+			mlt_frame_set_alpha_bounds( frame, cached->alpha_bounds, cached->opaque );
 		}
 
 		if ( cached_item )
@@ -759,6 +889,7 @@ static void producer_close( mlt_producer parent )
 	free( self->text );
 	free( self->font );
 	free( self->family );
+	free( self->cache_key );
 	parent->close = NULL;
 	mlt_producer_close( parent );
 	free( self );
@@ -1132,6 +1263,7 @@ static void on_fontmap_reload()
 	pthread_mutex_lock( &pango_mutex );
 	old_fontmap = fontmap;
 	fontmap = new_fontmap;
+	pango_cache_clear();
 	pthread_mutex_unlock( &pango_mutex );
 
 	if ( old_fontmap )
@@ -38,12 +38,34 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <ctype.h>
+#include <fcntl.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 // this protects concurrent access to gdk_pixbuf
 static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 typedef struct producer_pixbuf_s *producer_pixbuf;
 
+enum
+{
+	PREFETCH_EMPTY = 0,
+	PREFETCH_QUEUED,
+	PREFETCH_DECODING,
+	PREFETCH_DONE
+};
+
+// A picture of the sequence decoded ahead of its use
+typedef struct
+{
+	int state;
+	int idx;
+	int disable_exif;
+	GdkPixbuf *pixbuf;
+	int exif_orientation;
+} prefetch_slot;
+
 struct producer_pixbuf_s
 {
 	struct mlt_producer_s parent;
@@ -63,12 +85,22 @@ struct producer_pixbuf_s
 	mlt_cache_item pixbuf_cache;
 	GdkPixbuf *pixbuf;
 	mlt_image_format format;
+
+	// Prefetching of the pictures that follow in the sequence
+	GThreadPool *prefetch_pool;
+	pthread_mutex_t prefetch_mutex;
+	pthread_cond_t prefetch_cond;
+	prefetch_slot *prefetch_slots;
+	int prefetch_count;
+	int prefetch_idx;
+	int prefetch_direction;
 };
 
 static void load_filenames( producer_pixbuf self, mlt_properties producer_properties );
 static int refresh_pixbuf( producer_pixbuf self, mlt_frame frame );
 static int producer_get_frame( mlt_producer parent, mlt_frame_ptr frame, int index );
 static void producer_close( mlt_producer parent );
+static void prefetch_close( producer_pixbuf self );
 
 static void refresh_length( mlt_properties properties, producer_pixbuf self )
 {
@@ -120,6 +152,10 @@ mlt_producer producer_pixbuf_init( char *filename )
 		// Callback registration
 		producer->get_frame = producer_get_frame;
 		producer->close = ( mlt_destructor )producer_close;
+		pthread_mutex_init( &self->prefetch_mutex, NULL );
+		pthread_cond_init( &self->prefetch_cond, NULL );
+		self->prefetch_idx = -1;
+		self->prefetch_direction = 1;
 
 		// Set the default properties
 		mlt_properties_set( properties, "resource", filename );
@@ -396,11 +432,10 @@ static void load_filenames( producer_pixbuf self, mlt_properties properties )
 	refresh_length( properties, self );
 }
 
-static GdkPixbuf* reorient_with_exif( producer_pixbuf self, int image_idx, GdkPixbuf *pixbuf )
+static GdkPixbuf* reorient_with_exif( const char *filename, GdkPixbuf *pixbuf, int *orientation )
 {
 #ifdef USE_EXIF
-	mlt_properties producer_props = MLT_PRODUCER_PROPERTIES( &self->parent );
-	ExifData *d = exif_data_new_from_file( mlt_properties_get_value( self->filenames, image_idx ) );
+	ExifData *d = exif_data_new_from_file( filename );
 	ExifEntry *entry;
 	int exif_orientation = 0;
 
@@ -414,8 +449,7 @@ static GdkPixbuf* reorient_with_exif( producer_pixbuf self, int image_idx, GdkPi
 		exif_data_unref(d);
 	}
 
-	// Remember EXIF value, might be useful for someone
-	mlt_properties_set_int( producer_props, "_exif_orientation" , exif_orientation );
+	*orientation = exif_orientation;
 
 	if ( exif_orientation > 1 )
 	{
@@ -461,6 +495,307 @@ static GdkPixbuf* reorient_with_exif( producer_pixbuf self, int image_idx, GdkPi
 	return pixbuf;
 }
 
+#ifndef _WIN32
+typedef struct
+{
+	void *address;
+	size_t size;
+} mapped_file;
+
+static void unmap_file( guchar *pixels, gpointer data )
+{
+	mapped_file *mapping = data;
+	munmap( mapping->address, mapping->size );
+	free( mapping );
+}
+
+static int read_ppm_number( const uint8_t *data, size_t size, size_t *offset )
+{
+	size_t i = *offset;
+	int value = 0;
+
+	// Skip white space and comments
+	while ( i < size && ( isspace( data[ i ] ) || data[ i ] == '#' ) )
+	{
+		if ( data[ i ] == '#' )
+			while ( i < size && data[ i ] != '\n' )
+				i++;
+		else
+			i++;
+	}
+	if ( i >= size || !isdigit( data[ i ] ) )
+		return -1;
+	while ( i < size && isdigit( data[ i ] ) )
+	{
+		value = value * 10 + data[ i++ ] - '0';
+		if ( value > 1000000 )
+			return -1;
+	}
+	*offset = i;
+	return value;
+}
+
+// Map a binary PPM file with 8-bit samples into memory, which is an image that needs no decoding.
+static GdkPixbuf *load_ppm_mapped( const char *filename )
+{
+	GdkPixbuf *pixbuf = NULL;
+	struct stat st;
+	int fd = open( filename, O_RDONLY );
+
+	if ( fd < 0 )
+		return NULL;
+	if ( fstat( fd, &st ) == 0 && st.st_size > 2 )
+	{
+		size_t size = st.st_size;
+		// Private and writable, so a change to the pixels never reaches the file
+		uint8_t *data = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+		if ( data != MAP_FAILED )
+		{
+			size_t offset = 2;
+			int width = -1, height = -1, maxval = -1;
+
+			if ( data[0] == 'P' && data[1] == '6' )
+				width = read_ppm_number( data, size, &offset );
+			if ( width > 0 )
+				height = read_ppm_number( data, size, &offset );
+			if ( height > 0 )
+				maxval = read_ppm_number( data, size, &offset );
+
+			// A single white space character separates the header from the pixels
+			if ( maxval == 255 && offset < size && isspace( data[ offset ] ) &&
+			     ( size - offset - 1 ) / 3 / width >= height )
+			{
+				mapped_file *mapping = malloc( sizeof( mapped_file ) );
+				mapping->address = data;
+				mapping->size = size;
+				pixbuf = gdk_pixbuf_new_from_data( data + offset + 1, GDK_COLORSPACE_RGB, FALSE, 8,
+					width, height, width * 3, unmap_file, mapping );
+				if ( !pixbuf )
+					free( mapping );
+			}
+			if ( !pixbuf )
+				munmap( data, size );
+		}
+	}
+	close( fd );
+	return pixbuf;
+}
+#endif
+
+static GdkPixbuf *load_pixbuf( const char *filename, int disable_exif, int *exif_orientation )
+{
+	GdkPixbuf *pixbuf = NULL;
+
+#ifndef _WIN32
+	const char *extension = strrchr( filename, '.' );
+	if ( extension && ( !strcasecmp( extension, ".ppm" ) || !strcasecmp( extension, ".pnm" ) ) )
+		pixbuf = load_ppm_mapped( filename );
+#endif
+	if ( !pixbuf )
+	{
+		GError *error = NULL;
+		pixbuf = gdk_pixbuf_new_from_file( filename, &error );
+		if ( error )
+			g_error_free( error );
+	}
+	// Read the exif value for this file
+	if ( pixbuf && !disable_exif )
+		pixbuf = reorient_with_exif( filename, pixbuf, exif_orientation );
+	return pixbuf;
+}
+
+static void prefetch_run( gpointer data, gpointer user_data )
+{
+	producer_pixbuf self = user_data;
+	prefetch_slot *slot = &self->prefetch_slots[ GPOINTER_TO_INT( data ) - 1 ];
+
+	pthread_mutex_lock( &self->prefetch_mutex );
+	if ( slot->state != PREFETCH_QUEUED )
+	{
+		// The picture was dropped, or loaded by the producer itself
+		pthread_mutex_unlock( &self->prefetch_mutex );
+		return;
+	}
+	slot->state = PREFETCH_DECODING;
+	char *filename = strdup( mlt_properties_get_value( self->filenames, slot->idx ) );
+	int disable_exif = slot->disable_exif;
+	pthread_mutex_unlock( &self->prefetch_mutex );
+
+	// gdk-pixbuf serialises the loaders that are not thread safe itself
+	int exif_orientation = 0;
+	GdkPixbuf *pixbuf = load_pixbuf( filename, disable_exif, &exif_orientation );
+	free( filename );
+
+	pthread_mutex_lock( &self->prefetch_mutex );
+	slot->pixbuf = pixbuf;
+	slot->exif_orientation = exif_orientation;
+	slot->state = PREFETCH_DONE;
+	pthread_cond_broadcast( &self->prefetch_cond );
+	pthread_mutex_unlock( &self->prefetch_mutex );
+}
+
+static void prefetch_drop( prefetch_slot *slot )
+{
+	if ( slot->pixbuf )
+		g_object_unref( slot->pixbuf );
+	slot->pixbuf = NULL;
+	slot->state = PREFETCH_EMPTY;
+}
+
+// Drop the pictures that are queued or decoded, such as when they must be reloaded.
+static void prefetch_flush( producer_pixbuf self )
+{
+	int i;
+
+	pthread_mutex_lock( &self->prefetch_mutex );
+	for ( i = 0; i < self->prefetch_count; i++ )
+		if ( self->prefetch_slots[ i ].state == PREFETCH_QUEUED || self->prefetch_slots[ i ].state == PREFETCH_DONE )
+			prefetch_drop( &self->prefetch_slots[ i ] );
+	self->prefetch_idx = -1;
+	pthread_mutex_unlock( &self->prefetch_mutex );
+}
+
+// Take picture idx if it was prefetched, waiting for it if it is being decoded.
+static GdkPixbuf *prefetch_take( producer_pixbuf self, int idx, int disable_exif, int *exif_orientation )
+{
+	GdkPixbuf *pixbuf = NULL;
+	int i;
+
+	pthread_mutex_lock( &self->prefetch_mutex );
+	for ( i = 0; i < self->prefetch_count; i++ )
+	{
+		prefetch_slot *slot = &self->prefetch_slots[ i ];
+
+		if ( slot->state == PREFETCH_EMPTY || slot->idx != idx || slot->disable_exif != disable_exif )
+			continue;
+		if ( slot->state == PREFETCH_QUEUED )
+		{
+			// It is not started, so it is quicker to load it now
+			slot->state = PREFETCH_EMPTY;
+			break;
+		}
+		while ( slot->state == PREFETCH_DECODING )
+			pthread_cond_wait( &self->prefetch_cond, &self->prefetch_mutex );
+		if ( slot->state == PREFETCH_DONE && slot->idx == idx && slot->disable_exif == disable_exif )
+		{
+			pixbuf = slot->pixbuf;
+			*exif_orientation = slot->exif_orientation;
+			slot->pixbuf = NULL;
+			prefetch_drop( slot );
+		}
+		break;
+	}
+	pthread_mutex_unlock( &self->prefetch_mutex );
+	return pixbuf;
+}
+
+// Get how far ahead picture i is from picture idx in the direction of play, or 0 if it is behind.
+static int prefetch_distance( producer_pixbuf self, int i, int idx, int loop )
+{
+	int distance = self->prefetch_direction * ( i - idx );
+	if ( loop )
+		distance = ( distance % self->count + self->count ) % self->count;
+	return MAX( distance, 0 );
+}
+
+// Queue the decoding of the pictures that follow idx in the direction of play.
+static void prefetch_schedule( producer_pixbuf self, int idx, int loop, int disable_exif )
+{
+	int ahead = MIN( mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( &self->parent ), "prefetch" ), self->count - 1 );
+	int i, j, k;
+
+	if ( ahead <= 0 )
+		return;
+
+	pthread_mutex_lock( &self->prefetch_mutex );
+	if ( idx == self->prefetch_idx )
+	{
+		pthread_mutex_unlock( &self->prefetch_mutex );
+		return;
+	}
+	if ( !self->prefetch_pool )
+	{
+		// Leave room for the pictures that are still being decoded when the play moves on
+		self->prefetch_count = 2 * ahead;
+		self->prefetch_slots = calloc( self->prefetch_count, sizeof( prefetch_slot ) );
+		self->prefetch_pool = g_thread_pool_new( prefetch_run, self,
+			MIN( ahead, MAX( 1, g_get_num_processors() / 2 ) ), FALSE, NULL );
+	}
+	ahead = MIN( ahead, self->prefetch_count / 2 );
+
+	// Follow the direction of play, taking a loop back to the start as going forward
+	if ( self->prefetch_idx >= 0 )
+	{
+		int delta = idx - self->prefetch_idx;
+		if ( loop && abs( delta ) * 2 > self->count )
+			delta = -delta;
+		self->prefetch_direction = delta < 0 ? -1 : 1;
+	}
+	self->prefetch_idx = idx;
+
+	// Drop the pictures that are no longer ahead
+	for ( i = 0; i < self->prefetch_count; i++ )
+	{
+		prefetch_slot *slot = &self->prefetch_slots[ i ];
+		if ( ( slot->state == PREFETCH_QUEUED || slot->state == PREFETCH_DONE ) &&
+		     ( slot->disable_exif != disable_exif || prefetch_distance( self, slot->idx, idx, loop ) < 1 ||
+		       prefetch_distance( self, slot->idx, idx, loop ) > ahead ) )
+			prefetch_drop( slot );
+	}
+
+	// Queue the missing ones, nearest first
+	for ( k = 1; k <= ahead; k++ )
+	{
+		int next = idx + self->prefetch_direction * k;
+		int empty = -1;
+
+		if ( loop )
+			next = ( next % self->count + self->count ) % self->count;
+		else if ( next < 0 || next >= self->count )
+			break;
+		for ( j = 0; j < self->prefetch_count; j++ )
+		{
+			prefetch_slot *slot = &self->prefetch_slots[ j ];
+			if ( slot->state == PREFETCH_EMPTY )
+			{
+				if ( empty < 0 )
+					empty = j;
+			}
+			else if ( slot->idx == next && slot->disable_exif == disable_exif )
+			{
+				break;
+			}
+		}
+		if ( j == self->prefetch_count )
+		{
+			if ( empty < 0 )
+				break;
+			self->prefetch_slots[ empty ].state = PREFETCH_QUEUED;
+			self->prefetch_slots[ empty ].idx = next;
+			self->prefetch_slots[ empty ].disable_exif = disable_exif;
+			g_thread_pool_push( self->prefetch_pool, GINT_TO_POINTER( empty + 1 ), NULL );
+		}
+	}
+	pthread_mutex_unlock( &self->prefetch_mutex );
+}
+
+static void prefetch_close( producer_pixbuf self )
+{
+	int i;
+
+	// Let the decoding in progress finish and skip the rest
+	if ( self->prefetch_pool )
+		g_thread_pool_free( self->prefetch_pool, TRUE, TRUE );
+	self->prefetch_pool = NULL;
+	for ( i = 0; i < self->prefetch_count; i++ )
+		prefetch_drop( &self->prefetch_slots[ i ] );
+	free( self->prefetch_slots );
+	self->prefetch_slots = NULL;
+	self->prefetch_count = 0;
+	pthread_mutex_destroy( &self->prefetch_mutex );
+	pthread_cond_destroy( &self->prefetch_cond );
+}
+
 static int refresh_pixbuf( producer_pixbuf self, mlt_frame frame )
 {
 	// Obtain properties of frame and producer
@@ -474,6 +809,7 @@ static int refresh_pixbuf( producer_pixbuf self, mlt_frame frame )
 		self->pixbuf = NULL;
 		self->image = NULL;
 		mlt_properties_set_int( producer_props, "force_reload", 0 );
+		prefetch_flush( self );
 	}
 
 	// Get the original position of this frame
@@ -523,17 +859,16 @@ static int refresh_pixbuf( producer_pixbuf self, mlt_frame frame )
 		self->pixbuf = NULL;
 	if ( !self->pixbuf || mlt_properties_get_int( producer_props, "_disable_exif" ) != disable_exif )
 	{
-		GError *error = NULL;
+		int exif_orientation = 0;
+		GdkPixbuf *pixbuf = prefetch_take( self, current_idx, disable_exif, &exif_orientation );
 
+		if ( !pixbuf )
+			pixbuf = load_pixbuf( mlt_properties_get_value( self->filenames, current_idx ), disable_exif, &exif_orientation );
 		self->image = NULL;
 		pthread_mutex_lock( &g_mutex );
-		self->pixbuf = gdk_pixbuf_new_from_file( mlt_properties_get_value( self->filenames, current_idx ), &error );
+		self->pixbuf = pixbuf;
 		if ( self->pixbuf )
 		{
-			// Read the exif value for this file
-			if ( !disable_exif )
-				self->pixbuf = reorient_with_exif( self, current_idx, self->pixbuf );
-
 			// Register this pixbuf for destruction and reuse
 			mlt_cache_item_close( self->pixbuf_cache );
 			mlt_service_cache_put( MLT_PRODUCER_SERVICE( producer ), "pixbuf.pixbuf", self->pixbuf, 0, ( mlt_destructor )g_object_unref );
@@ -548,12 +883,20 @@ static int refresh_pixbuf( producer_pixbuf self, mlt_frame frame )
 			mlt_properties_set_int( producer_props, "meta.media.width", self->width );
 			mlt_properties_set_int( producer_props, "meta.media.height", self->height );
 			mlt_properties_set_int( producer_props, "_disable_exif", disable_exif );
+#ifdef USE_EXIF
+			// Remember EXIF value, might be useful for someone
+			if ( !disable_exif )
+				mlt_properties_set_int( producer_props, "_exif_orientation", exif_orientation );
+#endif
 			mlt_events_unblock( producer_props, NULL );
 
 		}
 		pthread_mutex_unlock( &g_mutex );
 	}
 
+	// Decode the pictures that come next on other threads
+	prefetch_schedule( self, current_idx, loop, disable_exif );
+
 	// Set width/height of frame
 	mlt_properties_set_int( properties, "width", self->width );
 	mlt_properties_set_int( properties, "height", self->height );
@@ -596,7 +939,8 @@ static void refresh_image( producer_pixbuf self, mlt_frame frame, mlt_image_form
 
 		// Note - the original pixbuf is already safe and ready for destruction
 		pthread_mutex_lock( &g_mutex );
-		GdkPixbuf* pixbuf = gdk_pixbuf_scale_simple( self->pixbuf, width, height, interp );
+		GdkPixbuf* pixbuf = width == gdk_pixbuf_get_width( self->pixbuf ) && height == gdk_pixbuf_get_height( self->pixbuf ) ?
+			g_object_ref( self->pixbuf ) : gdk_pixbuf_scale_simple( self->pixbuf, width, height, interp );
 
 		// Store width and height
 		self->width = width;
@@ -800,6 +1144,7 @@ static int producer_get_frame( mlt_producer producer, mlt_frame_ptr frame, int i
 static void producer_close( mlt_producer parent )
 {
 	producer_pixbuf self = parent->child;
+	prefetch_close( self );
 	parent->close = NULL;
 	mlt_service_cache_purge( MLT_PRODUCER_SERVICE(parent) );
 	mlt_producer_close( parent );
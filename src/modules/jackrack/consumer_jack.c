@@ -25,8 +25,8 @@
 #include <sys/time.h>
 #include <unistd.h>
 #include <jack/jack.h>
-#include <jack/ringbuffer.h>
 
+/** the number of samples buffered ahead of JACK for each channel */
 #define BUFFER_LEN (204800 * 6)
 
 pthread_mutex_t g_activate_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -52,7 +52,8 @@ struct consumer_jack_s
 	pthread_mutex_t refresh_mutex;
 	int refresh_count;
 	int counter;
-	jack_ringbuffer_t **ringbuffers;
+	int channels;
+	mlt_audio_ring *ringbuffers;
 	jack_port_t **ports;
 };
 
@@ -105,6 +106,7 @@ mlt_consumer consumer_jack_init( mlt_profile profile, mlt_service_type type, con
 			// Default scaler (for now we'll use nearest)
 			mlt_properties_set( properties, "rescale", "nearest" );
 			mlt_properties_set( properties, "deinterlace_method", "onefield" );
+			mlt_properties_set( properties, "resample_quality", "fast" );
 
 			// Default buffer for low latency
 			mlt_properties_set_int( properties, "buffer", 1 );
@@ -200,15 +202,16 @@ static int consumer_stop( mlt_consumer parent )
 			jack_deactivate( self->jack );
 		if ( self->ringbuffers )
 		{
-			int n = mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( parent ), "channels" );
+			int n = self->channels;
 			while ( n-- )
 			{
-				jack_ringbuffer_free( self->ringbuffers[n] );
+				mlt_audio_ring_close( self->ringbuffers[n] );
 				jack_port_unregister( self->jack, self->ports[n] );
 			}
 			mlt_pool_release( self->ringbuffers );
 		}
 		self->ringbuffers = NULL;
+		self->channels = 0;
 		if ( self->ports )
 			mlt_pool_release( self->ports );
 		self->ports = NULL;
@@ -227,23 +230,15 @@ static int jack_process( jack_nframes_t frames, void * data )
 {
 	int error = 0;
 	consumer_jack self = (consumer_jack) data;
-	mlt_properties properties = MLT_CONSUMER_PROPERTIES( &self->parent );
-	int channels = mlt_properties_get_int( properties, "channels" );
 	int i;
 
+	// This runs on the JACK thread, so take no locks and read no properties
 	if ( !self->ringbuffers )
 		return 1;
 
-	for ( i = 0; i < channels; i++ )
-	{
-		size_t jack_size = ( frames * sizeof(float) );
-		size_t ring_size = jack_ringbuffer_read_space( self->ringbuffers[i] );
-		char *dest = jack_port_get_buffer( self->ports[i], frames );
-
-		jack_ringbuffer_read( self->ringbuffers[i], dest, ring_size < jack_size ? ring_size : jack_size );
-		if ( ring_size < jack_size )
-			memset( dest + ring_size, 0, jack_size - ring_size );
-	}
+	// The rings pad the ports with silence when they run short
+	for ( i = 0; i < self->channels; i++ )
+		mlt_audio_ring_read( self->ringbuffers[i], jack_port_get_buffer( self->ports[i], frames ), frames );
 
 	return error;
 }
@@ -259,8 +254,10 @@ static void initialise_jack_ports( consumer_jack self )
 	int channels = mlt_properties_get_int( properties, "channels" );
 
 	// Allocate buffers and ports
-	self->ringbuffers = mlt_pool_alloc( sizeof( jack_ringbuffer_t *) * channels );
+	self->ringbuffers = mlt_pool_alloc( sizeof( mlt_audio_ring ) * channels );
 	self->ports = mlt_pool_alloc( sizeof(jack_port_t *) * channels );
+	for ( i = 0; i < channels; i++ )
+		self->ringbuffers[i] = mlt_audio_ring_init( BUFFER_LEN, sizeof(float) );
 
 	// Start Jack processing - required before registering ports
 	pthread_mutex_lock( &g_activate_mutex );
@@ -271,12 +268,14 @@ static void initialise_jack_ports( consumer_jack self )
 	// Register Jack ports
 	for ( i = 0; i < channels; i++ )
 	{
-		self->ringbuffers[i] = jack_ringbuffer_create( BUFFER_LEN * sizeof(float) );
 		snprintf( mlt_name, sizeof( mlt_name ), "out_%d", i + 1 );
 		self->ports[i] = jack_port_register( self->jack, mlt_name, JACK_DEFAULT_AUDIO_TYPE,
 				JackPortIsOutput | JackPortIsTerminal, 0 );
 	}
 
+	// The processing callback only uses the channels that are ready
+	self->channels = channels;
+
 	// Establish connections
 	for ( i = 0; i < channels; i++ )
 	{
@@ -332,8 +331,7 @@ static int consumer_play_audio( consumer_jack self, mlt_frame frame, int init_au
 
 	if ( init_audio == 0 && ( speed == 1.0 || speed == 0.0 ) )
 	{
-		int i;
-		size_t mlt_size = samples * sizeof(float);
+		int i, n = MIN( channels, self->channels );
 		float volume = mlt_properties_get_double( properties, "volume" );
 
 		if ( !scrub && speed == 0.0 )
@@ -347,13 +345,13 @@ static int consumer_play_audio( consumer_jack self, mlt_frame frame, int init_au
 				*p++ *= volume;
 		}
 
-		// Write into output ringbuffer
-		for ( i = 0; i < channels; i++ )
-		{
-			size_t ring_size = jack_ringbuffer_write_space( self->ringbuffers[i] );
-			if ( ring_size >= mlt_size )
-				jack_ringbuffer_write( self->ringbuffers[i], (char*)( buffer + i * samples ), mlt_size );
-		}
+		// Write into output ringbuffer, dropping the frame on every channel when any is full
+		for ( i = 0; i < n; i++ )
+			if ( mlt_audio_ring_space( self->ringbuffers[i] ) < samples )
+				break;
+		if ( i == n )
+			for ( i = 0; i < n; i++ )
+				mlt_audio_ring_write( self->ringbuffers[i], buffer + i * samples, samples );
 	}
 
 	return init_audio;
@@ -32,7 +32,6 @@
 #include "jack_rack.h"
 
 #define BUFFER_LEN       (10000)
-#define MAX_SAMPLE_COUNT (4096)
 
 static jack_rack_t* initialise_jack_rack( mlt_properties properties, int channels )
 {
@@ -179,26 +178,13 @@ static int ladspa_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 				plugin->wet_dry_values[c] = value;
 		}
 
-		// Configure the buffers
-		LADSPA_Data **input_buffers  = mlt_pool_alloc( sizeof( LADSPA_Data* ) * jackrack->channels );
-		LADSPA_Data **output_buffers = mlt_pool_alloc( sizeof( LADSPA_Data* ) * jackrack->channels );
-		
-		// Some plugins crash with too many frames (samples).
-		// So, feed the plugin with N samples per loop iteration.
-		int samples_offset = 0;
-		int sample_count = MIN(*samples, MAX_SAMPLE_COUNT);
-		for (i = 0; samples_offset < *samples; i++) {
-			int j = 0;
-			for (; j < jackrack->channels; j++)
-				output_buffers[j] = input_buffers[j] = (LADSPA_Data*) *buffer + j * (*samples) + samples_offset;
-			sample_count = MIN(*samples - samples_offset, MAX_SAMPLE_COUNT);
-			// Do LADSPA processing
-			error = process_ladspa( jackrack->procinfo, sample_count, input_buffers, output_buffers );
-			samples_offset += MAX_SAMPLE_COUNT;
-		}
+		// Process the planar audio in place, the chain splits it into blocks the plugins can take
+		LADSPA_Data *buffers[ jackrack->channels ];
+		for ( i = 0; i < jackrack->channels; i++ )
+			buffers[i] = (LADSPA_Data*) *buffer + i * *samples;
 
-		mlt_pool_release( input_buffers );
-		mlt_pool_release( output_buffers );
+		// Do LADSPA processing
+		error = process_ladspa( jackrack->procinfo, *samples, buffers, buffers );
 
 		// read the status port values
 		for ( i = 0; i < plugin->desc->status_port_count; i++ )
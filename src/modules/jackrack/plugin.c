@@ -86,12 +86,20 @@ plugin_connect_input_ports (plugin_t * plugin, LADSPA_Data ** inputs)
 /** connect up a plugin's output ports to its own audio_output_memory output memory */
 void
 plugin_connect_output_ports (plugin_t * plugin)
+{
+  if (plugin)
+    plugin_connect_output_buffers (plugin, plugin->audio_output_memory);
+}
+
+/** connect up a plugin's output ports to other buffers, one for each rack channel */
+void
+plugin_connect_output_buffers (plugin_t * plugin, LADSPA_Data ** outputs)
 {
   gint copy;
   unsigned long channel;
   unsigned long rack_channel = 0;
 
-  if (!plugin)
+  if (!plugin || !outputs)
     return;
 
 
@@ -102,7 +110,7 @@ plugin_connect_output_ports (plugin_t * plugin)
           plugin->descriptor->
             connect_port (plugin->holders[copy].instance,
                           plugin->desc->audio_output_port_indicies[channel],
-                          plugin->audio_output_memory[rack_channel]);
+                          outputs[rack_channel]);
           rack_channel++;
         }
     }
@@ -89,5 +89,6 @@ void       plugin_destroy (plugin_t * plugin);
 
 void plugin_connect_input_ports (plugin_t * plugin, LADSPA_Data ** inputs);
 void plugin_connect_output_ports (plugin_t * plugin);
+void plugin_connect_output_buffers (plugin_t * plugin, LADSPA_Data ** outputs);
 
 #endif /* __JR_PLUGIN_H__ */
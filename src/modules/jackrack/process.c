@@ -155,12 +155,32 @@ get_last_enabled_plugin (process_info_t * procinfo)
   return NULL;
 }
 
+/** check whether any of the rack's output buffers is also one of \p inputs */
+static gboolean
+outputs_alias (process_info_t * procinfo, LADSPA_Data ** inputs)
+{
+  unsigned long in, out;
+
+  if (!inputs)
+    return FALSE;
+
+  for (in = 0; in < procinfo->channels; in++)
+    for (out = 0; out < procinfo->channels; out++)
+      if (inputs[in] == procinfo->jack_output_buffers[out])
+        return TRUE;
+
+  return FALSE;
+}
+
 void
 connect_chain (process_info_t * procinfo, jack_nframes_t frames)
 {
   plugin_t * first_enabled, * last_enabled, * plugin;
+  LADSPA_Data ** last_inputs;
   gint copy;
   unsigned long channel;
+
+  procinfo->direct_output = FALSE;
   if (!procinfo->chain) return;
   
   first_enabled = get_first_enabled_plugin (procinfo);
@@ -217,8 +237,22 @@ connect_chain (process_info_t * procinfo, jack_nframes_t frames)
     }
 
   /* input buffers for first plugin */
-  if( plugin->desc->has_input )
+  if( first_enabled->desc->has_input )
     plugin_connect_input_ports (first_enabled, procinfo->jack_input_buffers);
+
+  /* let the last plugin write its output in place, unless it needs its
+     input afterwards for wet/dry or can not share a buffer for both */
+  if (first_enabled == last_enabled)
+    last_inputs = first_enabled->desc->has_input ? procinfo->jack_input_buffers : NULL;
+  else
+    last_inputs = last_enabled->prev->audio_output_memory;
+  if (!last_enabled->wet_dry_enabled &&
+      (!LADSPA_IS_INPLACE_BROKEN (last_enabled->descriptor->Properties) ||
+       !outputs_alias (procinfo, last_inputs)))
+    {
+      plugin_connect_output_buffers (last_enabled, procinfo->jack_output_buffers);
+      procinfo->direct_output = TRUE;
+    }
 }
 
 void
@@ -260,9 +294,10 @@ process_chain (process_info_t * procinfo, jack_nframes_t frames)
       unsigned long channel;
       for (channel = 0; channel < procinfo->channels; channel++)
         {
-          memcpy (procinfo->jack_output_buffers[channel],
-                  procinfo->jack_input_buffers[channel],
-                  sizeof(LADSPA_Data) * frames);
+          if (procinfo->jack_output_buffers[channel] != procinfo->jack_input_buffers[channel])
+            memcpy (procinfo->jack_output_buffers[channel],
+                    procinfo->jack_input_buffers[channel],
+                    sizeof(LADSPA_Data) * frames);
         }
       return;
     }
@@ -303,16 +338,23 @@ process_chain (process_info_t * procinfo, jack_nframes_t frames)
     }
   
   /* copy the last enabled data to the jack ports */
-  for (i = 0; i < procinfo->channels; i++)
-    memcpy (procinfo->jack_output_buffers[i],
-            last_enabled->audio_output_memory[i],
-            sizeof(LADSPA_Data) * frames);
+  if (!procinfo->direct_output)
+    for (i = 0; i < procinfo->channels; i++)
+      memcpy (procinfo->jack_output_buffers[i],
+              last_enabled->audio_output_memory[i],
+              sizeof(LADSPA_Data) * frames);
   
 }
 
+/** run the chain over planar buffers of any length.
+    inputs may be the same as outputs, or NULL when the first plugin has no inputs.
+    returns 0 on success, non-zero on error */
 int process_ladspa (process_info_t * procinfo, jack_nframes_t frames,
                     LADSPA_Data ** inputs, LADSPA_Data ** outputs) {
   unsigned long channel;
+  jack_nframes_t offset, block;
+  plugin_t * first_enabled;
+  gboolean need_inputs;
   
   if (!procinfo)
     {
@@ -324,29 +366,40 @@ int process_ladspa (process_info_t * procinfo, jack_nframes_t frames,
     return 1;
   
   process_control_port_messages (procinfo);
+
+  first_enabled = get_first_enabled_plugin (procinfo);
+  need_inputs = !first_enabled || first_enabled->desc->has_input;
   
   for (channel = 0; channel < procinfo->channels; channel++)
     {
-      if(get_first_enabled_plugin (procinfo)->desc->has_input)
+      if (need_inputs && (!inputs || !inputs[channel]))
         {
-          procinfo->jack_input_buffers[channel] = inputs[channel];
-          if (!procinfo->jack_input_buffers[channel])
-            {
-              mlt_log_verbose( NULL, "%s: no jack buffer for input port %ld\n", __FUNCTION__, channel);
-              return 1;
-            }
+          mlt_log_verbose( NULL, "%s: no jack buffer for input port %ld\n", __FUNCTION__, channel);
+          return 1;
         }
-      procinfo->jack_output_buffers[channel] = outputs[channel];
-      if (!procinfo->jack_output_buffers[channel])
+      if (!outputs[channel])
         {
           mlt_log_verbose( NULL, "%s: no jack buffer for output port %ld\n", __FUNCTION__, channel);
           return 1;
         }
     }
+
+  /* the plugins' audio memory holds buffer_size frames, and some plugins
+     crash with more, so run the chain over blocks of at most that */
+  for (offset = 0; offset < frames; offset += block)
+    {
+      block = MIN (frames - offset, buffer_size);
+
+      for (channel = 0; channel < procinfo->channels; channel++)
+        {
+          procinfo->jack_input_buffers[channel] = need_inputs ? inputs[channel] + offset : NULL;
+          procinfo->jack_output_buffers[channel] = outputs[channel] + offset;
+        }
   
-  connect_chain (procinfo, frames);
+      connect_chain (procinfo, block);
   
-  process_chain (procinfo, frames);
+      process_chain (procinfo, block);
+    }
   
   return 0;
 }
@@ -556,6 +609,7 @@ process_info_new (const char * client_name, unsigned long rack_channels,
   procinfo->jack_output_ports = NULL;
 #endif
   procinfo->channels = rack_channels;
+  procinfo->direct_output = FALSE;
   procinfo->quit = FALSE;
 	
   if ( client_name == NULL )
@@ -54,6 +54,8 @@ struct _process_info {
   LADSPA_Data ** jack_input_buffers;
   LADSPA_Data ** jack_output_buffers;
   LADSPA_Data *  silent_buffer;
+  /** the last enabled plugin writes to jack_output_buffers itself */
+  gboolean direct_output;
   
   char * jack_client_name;
   int quit;
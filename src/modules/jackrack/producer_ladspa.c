@@ -74,7 +74,6 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 	mlt_producer producer = mlt_properties_get_data( MLT_FRAME_PROPERTIES( frame ), "_producer_ladspa", NULL );
 	mlt_properties producer_properties = MLT_PRODUCER_PROPERTIES( producer );
 	int size = 0;
-	LADSPA_Data** output_buffers = NULL;
 	int i = 0;
 
 	// Initialize LADSPA if needed
@@ -121,7 +120,7 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 		*buffer = mlt_pool_alloc( size );
 
 		// Initialize the LADSPA output buffer.
-		output_buffers = mlt_pool_alloc( sizeof( LADSPA_Data* ) * *channels );
+		LADSPA_Data *output_buffers[ *channels ];
 		for ( i = 0; i < *channels; i++ )
 		{
 			output_buffers[i] = (LADSPA_Data*) *buffer + i * *samples;
@@ -129,7 +128,6 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 
 		// Do LADSPA processing
 		process_ladspa( jackrack->procinfo, *samples, NULL, output_buffers );
-		mlt_pool_release( output_buffers );
 
 		// Set the buffer for destruction
 		mlt_frame_set_audio( frame, *buffer, *format, size, mlt_pool_release );
@@ -21,71 +21,160 @@
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_profile.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2 1
+#endif
 
-static void PreCompute(uint8_t *image, int32_t *rgba, int width, int height)
+#define MIN_SLICE_HEIGHT (16)
+
+/** One or more interleaved channels of an image to blur.
+ *
+ * Sample x of channel c of row y is at
+ * data[y * stride + x * step + c * channel_step].
+ */
+typedef struct
 {
-	register int x, y, z;
-	int32_t pts[4];
-	
-	for (y = 0; y < height; y++)
+	uint8_t *data;
+	int width, height, stride;
+	int channels, step, channel_step;
+	int boxw, boxh;
+} blur_plane;
+
+/** The box of a pixel is (x - boxw, x + boxw] x (y - boxh, y + boxh], clamped to
+ * the image and always divided by its full area. Both passes use running sums
+ * of the samples of a row or column, so the cost does not depend on its size.
+ */
+typedef struct
+{
+	blur_plane *plane;
+	uint32_t *sums;    /**< width * channels horizontal box sums per row */
+} blur_desc;
+
+/** Sum the boxes of each row. */
+static int blur_rows_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	blur_desc *desc = (blur_desc*) cookie;
+	blur_plane *plane = desc->plane;
+	int width = plane->width, channels = plane->channels;
+	int start = plane->height * index / jobs;
+	int end = plane->height * ( index + 1 ) / jobs;
+	uint32_t *prefix = malloc( width * sizeof( uint32_t ) );
+	int x, y, c;
+
+	for ( y = start; y < end; y++ )
 	{
-		for (x = 0; x < width; x++)
+		uint32_t *sums = desc->sums + y * width * channels;
+		for ( c = 0; c < channels; c++ )
 		{
-			pts[0] = image[0];
-			pts[1] = image[1];
-			pts[2] = image[2];
-			pts[3] = image[3];
-			for (z = 0; z < 4; z++)
-			{
-				if (x > 0) pts[z] += rgba[-4];
-				if (y > 0) pts[z] += rgba[width * -4];
-				if (x>0 && y>0) pts[z] -= rgba[(width + 1) * -4];
-				*rgba++ = pts[z];
-			}
-			image += 4;
+			const uint8_t *s = plane->data + y * plane->stride + c * plane->channel_step;
+			uint32_t total = 0;
+			for ( x = 0; x < width; x++, s += plane->step )
+				prefix[x] = total += *s;
+			for ( x = 0; x < width; x++ )
+				sums[x * channels + c] = prefix[CLAMP( x + plane->boxw, 0, width - 1 )]
+				                       - prefix[CLAMP( x - plane->boxw, 0, width - 1 )];
 		}
 	}
+	free( prefix );
+	return 0;
 }
 
-static inline int32_t GetRGBA(int32_t *rgba, unsigned int w, unsigned int h, unsigned int x, int offsetx, unsigned int y, int offsety, unsigned int z)
+#if defined(USE_SSE2)
+/** Scale \param count box sums into \param dest and return the number handled. */
+static int scale_sums_sse2( uint8_t *dest, const uint32_t *a, const uint32_t *b, int count, float mul )
 {
-	int xtheo = x + offsetx;
-	int ytheo = y + offsety;
-	return rgba[4 * (CLAMP(xtheo, 0, w-1) + CLAMP(ytheo, 0, h-1) * w) + z];
+	__m128 vmul = _mm_set1_ps( mul );
+	int i;
+	for ( i = 0; i + 16 <= count; i += 16 )
+	{
+		__m128i v[4];
+		int j;
+		for ( j = 0; j < 4; j++ )
+		{
+			__m128i sum = _mm_sub_epi32( _mm_loadu_si128( (const __m128i*) ( a + i + 4 * j ) ),
+			                             _mm_loadu_si128( (const __m128i*) ( b + i + 4 * j ) ) );
+			v[j] = _mm_cvttps_epi32( _mm_mul_ps( _mm_cvtepi32_ps( sum ), vmul ) );
+		}
+		__m128i lo = _mm_packs_epi32( v[0], v[1] );
+		__m128i hi = _mm_packs_epi32( v[2], v[3] );
+		_mm_storeu_si128( (__m128i*) ( dest + i ), _mm_packus_epi16( lo, hi ) );
+	}
+	return i;
 }
+#endif
 
-static void DoBoxBlur(uint8_t *image, int32_t *rgba, unsigned int width, unsigned int height, unsigned int boxw, unsigned int boxh)
+/** Turn the row sums of a range of columns into column sums and write the averages. */
+static int blur_columns_proc( int id, int index, int jobs, void *cookie )
 {
-	register int x, y;
-	float mul = 1.f / ((boxw*2) * (boxh*2));
+	(void) id; // unused
+	blur_desc *desc = (blur_desc*) cookie;
+	blur_plane *plane = desc->plane;
+	int height = plane->height, channels = plane->channels;
+	int n = plane->width * channels;
+	int start = plane->width * index / jobs * channels;
+	int end = plane->width * ( index + 1 ) / jobs * channels;
+	float mul = 1.f / ( ( plane->boxw * 2 ) * ( plane->boxh * 2 ) );
+	int contiguous = plane->step == channels && plane->channel_step == 1;
+	int i, y;
+
+	// Column prefix sums in place; they may wrap, but the differences below do not.
+	for ( y = 1; y < height; y++ )
+	{
+		uint32_t *row = desc->sums + y * n;
+		const uint32_t *above = row - n;
+		for ( i = start; i < end; i++ )
+			row[i] += above[i];
+	}
 
-	for (y = 0; y < height; y++)
+	for ( y = 0; y < height; y++ )
 	{
-		for (x = 0; x < width; x++)
+		const uint32_t *a = desc->sums + CLAMP( y + plane->boxh, 0, height - 1 ) * n;
+		const uint32_t *b = desc->sums + CLAMP( y - plane->boxh, 0, height - 1 ) * n;
+		uint8_t *dest = plane->data + y * plane->stride;
+		i = start;
+		if ( contiguous )
 		{
-			*image++ = (GetRGBA(rgba, width, height, x, +boxw, y, +boxh, 0)
-			          + GetRGBA(rgba, width, height, x, -boxw, y, -boxh, 0)
-			          - GetRGBA(rgba, width, height, x, -boxw, y, +boxh, 0)
-			          - GetRGBA(rgba, width, height, x, +boxw, y, -boxh, 0)) * mul;
-			*image++ = (GetRGBA(rgba, width, height, x, +boxw, y, +boxh, 1)
-			          + GetRGBA(rgba, width, height, x, -boxw, y, -boxh, 1)
-			          - GetRGBA(rgba, width, height, x, -boxw, y, +boxh, 1)
-			          - GetRGBA(rgba, width, height, x, +boxw, y, -boxh, 1)) * mul;
-			*image++ = (GetRGBA(rgba, width, height, x, +boxw, y, +boxh, 2)
-			          + GetRGBA(rgba, width, height, x, -boxw, y, -boxh, 2)
-			          - GetRGBA(rgba, width, height, x, -boxw, y, +boxh, 2)
-			          - GetRGBA(rgba, width, height, x, +boxw, y, -boxh, 2)) * mul;
-			*image++ = (GetRGBA(rgba, width, height, x, +boxw, y, +boxh, 3)
-			          + GetRGBA(rgba, width, height, x, -boxw, y, -boxh, 3)
-			          - GetRGBA(rgba, width, height, x, -boxw, y, +boxh, 3)
-			          - GetRGBA(rgba, width, height, x, +boxw, y, -boxh, 3)) * mul;
+#if defined(USE_SSE2)
+			i += scale_sums_sse2( dest + i, a + i, b + i, end - i, mul );
+#endif
+			for ( ; i < end; i++ )
+				dest[i] = (int32_t) ( a[i] - b[i] ) * mul;
+		}
+		else
+		{
+			for ( ; i < end; i++ )
+				dest[i / channels * plane->step + i % channels * plane->channel_step] = (int32_t) ( a[i] - b[i] ) * mul;
 		}
 	}
+	return 0;
+}
+
+static void DoBoxBlur( blur_plane *plane, int threads )
+{
+	blur_desc desc;
+	desc.plane = plane;
+	desc.sums = mlt_pool_alloc( plane->width * plane->height * plane->channels * sizeof( uint32_t ) );
+
+	int rows = CLAMP( threads, 1, MAX( plane->height / MIN_SLICE_HEIGHT, 1 ) );
+	int columns = CLAMP( threads, 1, MAX( plane->width / MIN_SLICE_HEIGHT, 1 ) );
+	if ( rows == 1 )
+		blur_rows_proc( 0, 0, 1, &desc );
+	else
+		mlt_slices_run_normal( rows, blur_rows_proc, &desc );
+	if ( columns == 1 )
+		blur_columns_proc( 0, 0, 1, &desc );
+	else
+		mlt_slices_run_normal( columns, blur_columns_proc, &desc );
+
+	mlt_pool_release( desc.sums );
 }
 
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
@@ -126,7 +215,8 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	else
 	{
 		// Get the image
-		*format = mlt_image_rgba;
+		if ( *format != mlt_image_yuv422 )
+			*format = mlt_image_rgba;
 		int error = mlt_frame_get_image( frame, image, format, width, height, 1 );
 		
 		// Only process if we have no error and a valid colour space
@@ -136,11 +226,30 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 			boxw *= mlt_profile_scale_width(profile, *width);
 			boxh *= mlt_profile_scale_height(profile, *height);
 			if (boxw || boxh) {
-				int size = mlt_image_format_size( *format, *width, *height, NULL );
-				int32_t *rgba = mlt_pool_alloc( 4 * size );
-				PreCompute( *image, rgba, *width, *height );
-				DoBoxBlur( *image, rgba, *width, *height, MAX(1, boxw), MAX(1, boxh) );
-				mlt_pool_release( rgba );
+				int threads = CLAMP( mlt_properties_get_int( properties, "threads" ), 0, mlt_slices_count_normal() );
+				if ( threads == 0 )
+					threads = mlt_slices_count_normal();
+				boxw = MAX(1, boxw);
+				boxh = MAX(1, boxh);
+				if ( *format == mlt_image_rgba )
+				{
+					blur_plane rgba = { *image, *width, *height, *width * 4, 4, 4, 1, boxw, boxh };
+					DoBoxBlur( &rgba, threads );
+				}
+				else
+				{
+					blur_plane luma = { *image, *width, *height, *width * 2, 1, 2, 1, boxw, boxh };
+					blur_plane chroma = { *image + 1, *width / 2, *height, *width * 2, 2, 4, 2, MAX(1, boxw / 2), boxh };
+					DoBoxBlur( &luma, threads );
+					if ( chroma.width > 0 )
+						DoBoxBlur( &chroma, threads );
+					uint8_t *alpha = mlt_frame_get_alpha( frame );
+					if ( alpha )
+					{
+						blur_plane a = { alpha, *width, *height, *width, 1, 1, 1, boxw, boxh };
+						DoBoxBlur( &a, threads );
+					}
+				}
 			}
 		}
 	}
@@ -27,6 +27,10 @@
 #include <stdio.h>
 #include <string.h>
 
+/** The number of formats and sizes of the frozen image that are kept */
+
+#define MAX_FROZEN_IMAGES 4
+
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
 	// Get the image
@@ -51,8 +55,23 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 
 	if (do_freeze == 1) {
 		mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
-		freeze_frame = mlt_properties_get_data( properties, "freeze_frame", NULL );
-		if ( !freeze_frame || mlt_properties_get_position( properties, "_frame" ) != pos )
+
+		// The frozen images are rendered once per format and size, and only for this position
+		mlt_properties cache = mlt_properties_get_data( properties, "_freeze_frames", NULL );
+		if ( !cache || mlt_properties_get_position( properties, "_frame" ) != pos
+			|| mlt_properties_count( cache ) >= MAX_FROZEN_IMAGES )
+		{
+			cache = mlt_properties_new();
+			mlt_properties_set_data( properties, "_freeze_frames", cache, 0, ( mlt_destructor )mlt_properties_close, NULL );
+			mlt_properties_set_position( properties, "_frame", pos );
+		}
+
+		char key[64];
+		snprintf( key, sizeof( key ), "%d.%dx%d", *format, *width, *height );
+		freeze_frame = mlt_properties_get_data( cache, key, NULL );
+
+		int error = 0;
+		if ( !freeze_frame )
 		{
 			// freeze_frame has not been fetched yet or is not useful, so fetch it and cache it.
 			// get parent producer
@@ -60,37 +79,48 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 			mlt_producer_seek( producer, pos );
 
 			// Get the frame
-			mlt_service_get_frame( mlt_producer_service(producer), &freeze_frame, 0 );
+			if ( mlt_service_get_frame( mlt_producer_service(producer), &freeze_frame, 0 ) || !freeze_frame )
+			{
+				mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+				return 1;
+			}
 
 			mlt_properties freeze_properties = MLT_FRAME_PROPERTIES( freeze_frame );
 			mlt_properties_set( freeze_properties, "rescale.interp", mlt_properties_get( props, "rescale.interp" ) );
 			mlt_properties_set_double( freeze_properties, "aspect_ratio", mlt_frame_get_aspect_ratio( frame ) );
 			mlt_properties_set_int( freeze_properties, "progressive", mlt_properties_get_int( props, "progressive" ) );
 			mlt_properties_set_int( freeze_properties, "consumer_deinterlace", mlt_properties_get_int( props, "consumer_deinterlace" ) || mlt_properties_get_int( properties, "deinterlace" ) );
-			mlt_properties_set_data( properties, "freeze_frame", freeze_frame, 0, ( mlt_destructor )mlt_frame_close, NULL );
-			mlt_properties_set_position( properties, "_frame", pos );
+
+			// Get frozen image
+			uint8_t *buffer = NULL;
+			error = mlt_frame_get_image( freeze_frame, &buffer, format, width, height, 0 );
+			if ( !error )
+				mlt_properties_set_data( cache, key, freeze_frame, 0, ( mlt_destructor )mlt_frame_close, NULL );
+		}
+		else
+		{
+			mlt_properties freeze_properties = MLT_FRAME_PROPERTIES( freeze_frame );
+			*format = mlt_properties_get_int( freeze_properties, "format" );
+			*width = mlt_properties_get_int( freeze_properties, "width" );
+			*height = mlt_properties_get_int( freeze_properties, "height" );
 		}
 
-		// Get frozen image
-		uint8_t *buffer = NULL;
-		int error = mlt_frame_get_image( freeze_frame, &buffer, format, width, height, 1 );
+		// Share it with the current frame, which copies it only if it must be written
+		int size = 0;
+		*image = error ? NULL : mlt_frame_share_image( freeze_frame, &size );
+		uint8_t *alpha_buffer = error ? NULL : mlt_frame_get_alpha( freeze_frame );
+		uint8_t *alpha_copy = NULL;
+		int alphasize = *width * *height;
+		if ( alpha_buffer && ( alpha_copy = mlt_pool_alloc( alphasize ) ) )
+			memcpy( alpha_copy, alpha_buffer, alphasize );
+		if ( error )
+			mlt_frame_close( freeze_frame );
 		mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
 
-		// Copy it to current frame
-		int size = mlt_image_format_size( *format, *width, *height, NULL );
-		uint8_t *image_copy = mlt_pool_alloc( size );
-		memcpy( image_copy, buffer, size );
-		*image = image_copy;
-		mlt_frame_set_image( frame, *image, size, mlt_pool_release );
-
-		uint8_t *alpha_buffer = mlt_frame_get_alpha( freeze_frame );
-		if ( alpha_buffer )
-		{
-			int alphasize = *width * *height;
-			uint8_t *alpha_copy = mlt_pool_alloc( alphasize );
-			memcpy( alpha_copy, alpha_buffer, alphasize );
+		if ( *image )
+			mlt_frame_set_image( frame, *image, size, mlt_image_buffer_release );
+		if ( alpha_copy )
 			mlt_frame_set_alpha( frame, alpha_copy, alphasize, mlt_pool_release );
-		}
 		return error;
 	}
 
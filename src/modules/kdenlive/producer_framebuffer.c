@@ -28,26 +28,13 @@
 #include <sys/time.h>
 #include <assert.h>
 
-// Forward references.
-static int producer_get_frame( mlt_producer producer, mlt_frame_ptr frame, int index );
-
-/** Image stack(able) method
+/** Get the position of the real producer that shows a position of this one.
 */
 
-static int framebuffer_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
+static mlt_position source_position( mlt_producer producer, mlt_position position )
 {
-
-	// Get the filter object and properties
-	mlt_producer producer = mlt_frame_pop_service( frame );
-	int index = mlt_frame_pop_service_int( frame );
 	mlt_properties properties = MLT_PRODUCER_PROPERTIES( producer );
 
-	mlt_service_lock( MLT_PRODUCER_SERVICE( producer ) );
-
-	// Frame properties objects
-	mlt_properties frame_properties = MLT_FRAME_PROPERTIES( frame );
-	mlt_frame first_frame = mlt_properties_get_data( properties, "first_frame", NULL );
-
 	// Get producer parameters
 	int strobe = mlt_properties_get_int( properties, "strobe" );
 	int freeze = mlt_properties_get_int( properties, "freeze" );
@@ -56,13 +43,12 @@ static int framebuffer_get_image( mlt_frame frame, uint8_t **image, mlt_image_fo
 	int in = mlt_properties_get_position( properties, "in" );
 
 	// Determine the position
-	mlt_position first_position = (first_frame != NULL) ? mlt_frame_get_position( first_frame ) : -1;
 	mlt_position need_first = freeze;
 
 	if ( !freeze || freeze_after || freeze_before )
 	{
 		double prod_speed = mlt_properties_get_double( properties, "_speed" );
-		double actual_position = prod_speed * ( in + mlt_producer_position( producer ) );
+		double actual_position = prod_speed * ( in + position );
 
 		if ( mlt_properties_get_int( properties, "reverse" ) )
 			actual_position = mlt_producer_get_playtime( producer ) - actual_position;
@@ -83,7 +69,25 @@ static int framebuffer_get_image( mlt_frame frame, uint8_t **image, mlt_image_fo
 			else if ( freeze_before && need_first < freeze ) need_first = freeze;
 		}
 	}
-	
+	return need_first;
+}
+
+/** Image stack(able) method
+*/
+
+static int framebuffer_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
+{
+
+	// Get the filter object and properties
+	mlt_producer producer = mlt_frame_pop_service( frame );
+	mlt_position need_first = mlt_frame_pop_service_int( frame );
+	int index = mlt_frame_pop_service_int( frame );
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( producer );
+	mlt_producer real_producer = mlt_properties_get_data( properties, "producer", NULL );
+
+	// Frame properties objects
+	mlt_properties frame_properties = MLT_FRAME_PROPERTIES( frame );
+
 	if ( *format == mlt_image_none )
 	{
 		// set format to the original's producer format
@@ -92,113 +96,50 @@ static int framebuffer_get_image( mlt_frame frame, uint8_t **image, mlt_image_fo
 	// Determine output buffer size
 	*width = mlt_properties_get_int( frame_properties, "width" );
 	*height = mlt_properties_get_int( frame_properties, "height" );
-	int size = mlt_image_format_size( *format, *width, *height, NULL );
 
-	// Get output buffer
-	int buffersize = 0;
-	int alphasize = *width * *height;
-	uint8_t *output = mlt_properties_get_data( properties, "output_buffer", &buffersize );
-	uint8_t *output_alpha = mlt_properties_get_data( properties, "output_alpha", NULL );
-	if( buffersize == 0 || buffersize != size )
+	// Get the frame of the real producer, shared with the frames showing the same position
+	mlt_frame first_frame = NULL;
+	int error = mlt_producer_fetch_frame( producer, real_producer, need_first, index, &first_frame );
+	if ( error || !first_frame )
 	{
-		// invalidate cached frame
-		first_position = -1;
-	}
-
-	if ( need_first != first_position )
-	{
-		// invalidate cached frame
-		first_position = -1;
-		
-		// Bust the cached frame
-		mlt_properties_set_data( properties, "first_frame", NULL, 0, NULL, NULL );
-		first_frame = NULL;
+		mlt_log_warning( MLT_PRODUCER_SERVICE( producer ), "failed to get frame " MLT_POSITION_FMT "\n", need_first );
+		return error ? error : 1;
 	}
 
-	if ( output && first_position != -1 ) {
-		// Using the cached frame
-		uint8_t *image_copy = mlt_pool_alloc( size );
-		memcpy( image_copy, output, size );
-		uint8_t *alpha_copy = mlt_pool_alloc( alphasize );
-		memcpy( alpha_copy, output_alpha, alphasize );
-
-		// Set the output image
-		*image = image_copy;
-		mlt_frame_set_image( frame, image_copy, size, mlt_pool_release );
-		mlt_frame_set_alpha( frame, alpha_copy, alphasize, mlt_pool_release );
-
-		*width = mlt_properties_get_int( properties, "_output_width" );
-		*height = mlt_properties_get_int( properties, "_output_height" );
-		*format = mlt_properties_get_int( properties, "_output_format" );
-
-		mlt_service_unlock( MLT_PRODUCER_SERVICE( producer ) );
-		return 0;
-	}
+	// Have the frames fetched ahead rendered the same way
+	mlt_producer_prefetch_images( producer, *format, *width, *height );
 
-	// Get the cached frame
-	if ( first_frame == NULL )
-	{
-		// Get the frame to cache from the real producer
-		mlt_producer real_producer = mlt_properties_get_data( properties, "producer", NULL );
-
-		// Seek the producer to the correct place
-		mlt_producer_seek( real_producer, need_first );
-
-		// Get the frame
-		mlt_service_get_frame( MLT_PRODUCER_SERVICE( real_producer ), &first_frame, index );
+	// The same frame may be rendered on behalf of several of ours
+	mlt_service_lock( MLT_PRODUCER_SERVICE( producer ) );
 
-		// Cache the frame
-		mlt_properties_set_data( properties, "first_frame", first_frame, 0, ( mlt_destructor )mlt_frame_close, NULL );
-	}
 	mlt_properties first_frame_properties = MLT_FRAME_PROPERTIES( first_frame );
+	mlt_properties_set( first_frame_properties, "rescale.interp", mlt_properties_get( frame_properties, "rescale.interp" ) );
 
+	uint8_t *first_image = NULL;
+	error = mlt_frame_get_image( first_frame, &first_image, format, width, height, 0 );
 
-	// Which frames are buffered?
-	uint8_t *first_image = mlt_properties_get_data( first_frame_properties, "image", NULL );
-	uint8_t *first_alpha = mlt_properties_get_data( first_frame_properties, "alpha", NULL );
-	if ( !first_image )
-	{
-		mlt_properties_set( first_frame_properties, "rescale.interp", mlt_properties_get( frame_properties, "rescale.interp" ) );
-
-		int error = mlt_frame_get_image( first_frame, &first_image, format, width, height, writable );
-
-		if ( error != 0 ) {
-			mlt_log_warning( MLT_PRODUCER_SERVICE( producer ), "first_image == NULL get image died\n" );
-			mlt_properties_set_data( properties, "first_frame", NULL, 0, NULL, NULL );
-			mlt_service_unlock( MLT_PRODUCER_SERVICE( producer ) );
-			return error;
-		}
-		output = mlt_pool_alloc( size );
-		memcpy( output, first_image, size );
-		// Let someone else clean up
-		mlt_properties_set_data( properties, "output_buffer", output, size, mlt_pool_release, NULL ); 
-		mlt_properties_set_int( properties, "_output_width", *width );
-		mlt_properties_set_int( properties, "_output_height", *height );
-		mlt_properties_set_int( properties, "_output_format", *format );
-	}
-
-	if ( !first_alpha )
+	if ( error != 0 || !first_image )
 	{
-		alphasize = *width * *height;
-		first_alpha = mlt_frame_get_alpha( first_frame );
-		if ( !first_alpha )
-		{
-			first_alpha = mlt_pool_alloc( alphasize );
-			memset( first_alpha, 255, alphasize );
-			mlt_frame_set_alpha( first_frame, first_alpha, alphasize, mlt_pool_release );
-		}
-		output_alpha = mlt_pool_alloc( alphasize );
-		memcpy( output_alpha, first_alpha, alphasize );
-		mlt_properties_set_data( properties, "output_alpha", output_alpha, alphasize, mlt_pool_release, NULL );
+		mlt_log_warning( MLT_PRODUCER_SERVICE( producer ), "first_image == NULL get image died\n" );
+		mlt_service_unlock( MLT_PRODUCER_SERVICE( producer ) );
+		mlt_frame_close( first_frame );
+		return error ? error : 1;
 	}
 
-	mlt_service_unlock( MLT_PRODUCER_SERVICE( producer ) );
-
 	// Create a copy
+	int size = mlt_image_format_size( *format, *width, *height, NULL );
+	int alphasize = *width * *height;
 	uint8_t *image_copy = mlt_pool_alloc( size );
 	memcpy( image_copy, first_image, size );
 	uint8_t *alpha_copy = mlt_pool_alloc( alphasize );
-	memcpy( alpha_copy, first_alpha, alphasize );
+	uint8_t *first_alpha = mlt_frame_get_alpha( first_frame );
+	if ( first_alpha )
+		memcpy( alpha_copy, first_alpha, alphasize );
+	else
+		memset( alpha_copy, 255, alphasize );
+
+	mlt_service_unlock( MLT_PRODUCER_SERVICE( producer ) );
+	mlt_frame_close( first_frame );
 
 	// Set the output image
 	*image = image_copy;
@@ -212,51 +153,58 @@ static int producer_get_frame( mlt_producer producer, mlt_frame_ptr frame, int i
 {
 	if ( frame )
 	{
+		mlt_properties properties = MLT_PRODUCER_PROPERTIES( producer );
+		mlt_producer real_producer = mlt_properties_get_data( properties, "producer", NULL );
+		mlt_position position = mlt_producer_position( producer );
+
+		// Keep the frames of the real producer for this frame and the next ones
+		mlt_position positions[ 32 ];
+		int prefetch = CLAMP( mlt_properties_get_int( properties, "prefetch" ), 0, 31 );
+		int count = 0, i;
+		positions[ count++ ] = source_position( producer, position );
+		for ( i = 1; i <= prefetch; i++ )
+		{
+			mlt_position next = source_position( producer, position + i );
+			if ( next != positions[ count - 1 ] )
+				positions[ count++ ] = next;
+		}
+		mlt_producer_retain_frames( producer, real_producer, positions, count, index );
+
 		// Construct a new frame
 		*frame = mlt_frame_init( MLT_PRODUCER_SERVICE( producer ) );
 
 		// Stack the producer and producer's get image
 		mlt_frame_push_service_int( *frame, index );
+		mlt_frame_push_service_int( *frame, positions[0] );
 		mlt_frame_push_service( *frame, producer );
 		mlt_frame_push_service( *frame, framebuffer_get_image );
 
-		mlt_properties properties = MLT_PRODUCER_PROPERTIES( producer );
 		mlt_properties frame_properties = MLT_FRAME_PROPERTIES(*frame);
 
 		// Get frame from the real producer
-		mlt_frame first_frame = mlt_properties_get_data( properties, "first_frame", NULL );
+		mlt_frame first_frame = NULL;
+		mlt_producer_fetch_frame( producer, real_producer, positions[0], index, &first_frame );
 
-		if ( first_frame == NULL )
+		if ( first_frame )
 		{
-			// Get the frame to cache from the real producer
-			mlt_producer real_producer = mlt_properties_get_data( properties, "producer", NULL );
-
-			// Get the producer speed
-			double prod_speed = mlt_properties_get_double( properties, "_speed" );
-
-			// Seek the producer to the correct place
-			mlt_producer_seek( real_producer, mlt_producer_position( producer ) * prod_speed );
-
-			// Get the frame
-			mlt_service_get_frame( MLT_PRODUCER_SERVICE( real_producer ), &first_frame, index );
-
-			// Cache the frame
-			mlt_properties_set_data( properties, "first_frame", first_frame, 0, ( mlt_destructor )mlt_frame_close, NULL );
-
-			// Find the original producer's format
-			int width = 0;
-			int height = 0;
-			mlt_image_format format = mlt_image_none;
-			uint8_t *image = NULL;
-			int error = mlt_frame_get_image( first_frame, &image, &format, &width, &height, 0 );
-			if ( !error )
+			if ( !mlt_properties_get( properties, "_original_format" ) )
 			{
-			// cache the original producer's pixel format
-			mlt_properties_set_int( properties, "_original_format", (int) format );
+				// Find the original producer's format
+				int width = 0;
+				int height = 0;
+				mlt_image_format format = mlt_image_none;
+				uint8_t *image = NULL;
+				int error = mlt_frame_get_image( first_frame, &image, &format, &width, &height, 0 );
+				if ( !error )
+				{
+				// cache the original producer's pixel format
+				mlt_properties_set_int( properties, "_original_format", (int) format );
+				}
 			}
-		}
 
-		mlt_properties_inherit( frame_properties, MLT_FRAME_PROPERTIES(first_frame) );
+			mlt_properties_inherit( frame_properties, MLT_FRAME_PROPERTIES(first_frame) );
+			mlt_frame_close( first_frame );
+		}
 
 		double force_aspect_ratio = mlt_properties_get_double( properties, "force_aspect_ratio" );
 		if ( force_aspect_ratio <= 0.0 ) force_aspect_ratio = mlt_properties_get_double( properties, "aspect_ratio" );
@@ -305,6 +253,10 @@ mlt_producer producer_framebuffer_init( mlt_profile profile, mlt_service_type ty
 	* You can freeze the clip at a determined position by adding freeze=frame_pos
 	  add freeze_after=1 to freeze only paste position or freeze_before to freeze before it
 
+	* You can have the frames for the next positions fetched and decoded in the background
+	  by adding prefetch=n, where n is the number of positions to look ahead
+
+
 	**/
 
 	double speed = 0.0;
@@ -20,6 +20,7 @@
 
 #include <stdlib.h>
 #include <string>
+#include <list>
 #include "filter_glsl_manager.h"
 #include <init.h>
 #include <util.h>
@@ -59,16 +60,22 @@ void dec_ref_and_delete(GlslManager *p)
 GlslManager::GlslManager()
 	: Mlt::Filter( mlt_filter_new() )
 	, resource_pool(new ResourcePool())
-	, pbo(0)
+	, upload_supported(-1)
 	, initEvent(0)
 	, closeEvent(0)
 	, prev_sync(NULL)
 {
+	for (int i = 0; i < MAXPBOCOUNT; ++i)
+		pbos[i] = 0;
 	mlt_filter filter = get_filter();
 	if ( filter ) {
 		// Set the mlt_filter child in case we choose to override virtual functions.
 		filter->child = this;
 		add_ref(mlt_global_properties());
+		// The number of PBOs render_frame_rgba() reads a frame back with
+		set( "readback_pbos", 1 );
+		// The number of finalized chains kept for each service
+		set( "chain_cache", 4 );
 
 		mlt_events_register( get_properties(), "init glsl" );
 		mlt_events_register( get_properties(), "close glsl" );
@@ -188,9 +195,10 @@ void GlslManager::delete_sync(GLsync sync)
 	g->unlock();
 }
 
-glsl_pbo GlslManager::get_pbo(int size)
+glsl_pbo GlslManager::get_pbo(int index, int size)
 {
 	lock();
+	glsl_pbo &pbo = pbos[index];
 	if (!pbo) {
 		GLuint pb = 0;
 		glGenBuffers(1, &pb);
@@ -218,6 +226,104 @@ glsl_pbo GlslManager::get_pbo(int size)
 	return pbo;
 }
 
+glsl_upload GlslManager::get_upload(int size)
+{
+	if (size < 1) {
+		return NULL;
+	}
+	// Persistent mapping needs OpenGL 4.4 or ARB_buffer_storage.
+	// Checked here, where there is a current context.
+	if (upload_supported < 0) {
+		upload_supported = epoxy_gl_version() >= 44 || epoxy_has_gl_extension("GL_ARB_buffer_storage");
+	}
+	if (!upload_supported) {
+		return NULL;
+	}
+
+	lock();
+	glsl_upload unused = NULL;
+	for (int i = 0; i < upload_list.count(); ++i) {
+		glsl_upload upload = (glsl_upload) upload_list.peek(i);
+		if (upload->used) {
+			continue;
+		}
+		if (upload->fence) {
+			// Leave it alone while the GPU may still read from it.
+			if (glClientWaitSync(upload->fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+				continue;
+			}
+			glDeleteSync(upload->fence);
+			upload->fence = 0;
+		}
+		if (upload->size == size) {
+			upload->used = 1;
+			unlock();
+			return upload;
+		}
+		unused = upload;
+	}
+
+	// Make room by replacing one of another size.
+	glsl_upload upload = NULL;
+	if (upload_list.count() >= MAXUPLOADCOUNT) {
+		if (!unused) {
+			unlock();
+			return NULL;
+		}
+		upload = unused;
+		glDeleteBuffers(1, &upload->pbo);
+		upload->pbo = 0;
+		upload->used = 1;
+	}
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLuint pb = 0;
+	uint8_t* data = NULL;
+	glGenBuffers(1, &pb);
+	if (pb) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pb);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+		data = (uint8_t*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (!data) {
+			glDeleteBuffers(1, &pb);
+			pb = 0;
+		}
+	}
+	if (!upload) {
+		if (!pb) {
+			unlock();
+			return NULL;
+		}
+		upload = new glsl_upload_s;
+		upload->used = 1;
+		upload->fence = 0;
+		upload_list.push_back(upload);
+	} else if (!pb) {
+		// Keep the emptied one in the list for a later try.
+		upload->size = 0;
+		upload->used = 0;
+		unlock();
+		return NULL;
+	}
+	upload->size = size;
+	upload->pbo = pb;
+	upload->data = data;
+	unlock();
+	return upload;
+}
+
+void GlslManager::release_upload(glsl_upload upload)
+{
+	// This is called right after rendering, in the thread with the context.
+	// The fence tells when the GPU has finished reading the upload.
+	GlslManager* g = GlslManager::get_instance();
+	g->lock();
+	upload->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	upload->used = 0;
+	g->unlock();
+}
+
 void GlslManager::cleanupContext()
 {
 	lock();
@@ -227,10 +333,21 @@ void GlslManager::cleanupContext()
 		delete texture;
 		texture_list.pop_back();
 	}
-	if (pbo) {
-		glDeleteBuffers(1, &pbo->pbo);
-		delete pbo;
-		pbo = 0;
+	while (upload_list.peek_back()) {
+		glsl_upload upload = (glsl_upload) upload_list.pop_back();
+		if (upload->fence) {
+			glDeleteSync(upload->fence);
+		}
+		glDeleteBuffers(1, &upload->pbo);
+		delete upload;
+	}
+	upload_supported = -1;
+	for (int i = 0; i < MAXPBOCOUNT; ++i) {
+		if (pbos[i]) {
+			glDeleteBuffers(1, &pbos[i]->pbo);
+			delete pbos[i];
+			pbos[i] = 0;
+		}
 	}
 	unlock();
 }
@@ -294,6 +411,16 @@ static void deleteChain( GlslChain* chain )
 	delete chain->effect_chain;
 	delete chain;
 }
+
+// The chains of a service, the most recently used first
+typedef std::list<GlslChain*> GlslChainList;
+
+static void deleteChainList( GlslChainList* chains )
+{
+	for (GlslChainList::iterator it = chains->begin(); it != chains->end(); ++it)
+		deleteChain( *it );
+	delete chains;
+}
 	
 void* GlslManager::get_frame_specific_data( mlt_service service, mlt_frame frame, const char *key, int *length )
 {
@@ -313,12 +440,42 @@ int GlslManager::set_frame_specific_data( mlt_service service, mlt_frame frame,
 
 void GlslManager::set_chain( mlt_service service, GlslChain* chain )
 {
-	mlt_properties_set_data( MLT_SERVICE_PROPERTIES(service), "_movit chain", chain, 0, (mlt_destructor) deleteChain, NULL );
+	// Keep the previous chains, so that going back to one of them, such as
+	// when seeking back across an edit, does not compile its shaders again.
+	GlslChainList* chains = (GlslChainList*) mlt_properties_get_data( MLT_SERVICE_PROPERTIES(service), "_movit chain", NULL );
+	if (!chains) {
+		chains = new GlslChainList;
+		mlt_properties_set_data( MLT_SERVICE_PROPERTIES(service), "_movit chain", chains, 0, (mlt_destructor) deleteChainList, NULL );
+	}
+	chains->push_front( chain );
+
+	GlslManager* g = GlslManager::get_instance();
+	size_t limit = g ? MAX( g->get_int( "chain_cache" ), 1 ) : 1;
+	while (chains->size() > limit) {
+		deleteChain( chains->back() );
+		chains->pop_back();
+	}
 }
 
 GlslChain* GlslManager::get_chain( mlt_service service )
 {
-	return (GlslChain*) mlt_properties_get_data( MLT_SERVICE_PROPERTIES(service), "_movit chain", NULL );
+	GlslChainList* chains = (GlslChainList*) mlt_properties_get_data( MLT_SERVICE_PROPERTIES(service), "_movit chain", NULL );
+	return chains && !chains->empty() ? chains->front() : NULL;
+}
+
+GlslChain* GlslManager::find_chain( mlt_service service, const std::string& fingerprint )
+{
+	GlslChainList* chains = (GlslChainList*) mlt_properties_get_data( MLT_SERVICE_PROPERTIES(service), "_movit chain", NULL );
+	if (!chains)
+		return NULL;
+	for (GlslChainList::iterator it = chains->begin(); it != chains->end(); ++it) {
+		if ((*it)->fingerprint == fingerprint) {
+			// Make it the current chain
+			chains->splice( chains->begin(), *chains, it );
+			return chains->front();
+		}
+	}
+	return NULL;
 }
 	
 Effect* GlslManager::get_effect( mlt_service service, mlt_frame frame )
@@ -354,6 +511,16 @@ uint8_t* GlslManager::set_input_pixel_pointer( mlt_producer producer, mlt_frame
 	return image;
 }
 
+glsl_upload GlslManager::get_input_upload( mlt_producer producer, mlt_frame frame )
+{
+	return (glsl_upload) get_frame_specific_data( MLT_PRODUCER_SERVICE(producer), frame, "_movit input upload", NULL );
+}
+
+void GlslManager::set_input_upload( mlt_producer producer, mlt_frame frame, glsl_upload upload )
+{
+	set_frame_specific_data( MLT_PRODUCER_SERVICE(producer), frame, "_movit input upload", upload, 0, NULL, NULL );
+}
+
 mlt_service GlslManager::get_effect_input( mlt_service service, mlt_frame frame )
 {
 	return (mlt_service) get_frame_specific_data( service, frame, "_movit effect input", NULL );
@@ -462,13 +629,20 @@ int GlslManager::render_frame_rgba(EffectChain *chain, mlt_frame frame, int widt
 		return 1;
 	}
 
-	// Use a PBO to hold the data we read back with glReadPixels().
+	// Use PBOs to hold the data we read back with glReadPixels().
 	// (Intel/DRI goes into a slow path if we don't read to PBO.)
+	// With more than one, each gets a band of rows, and a band is copied
+	// while the following ones are still being transferred.
 	int img_size = width * height * 4;
-	glsl_pbo pbo = get_pbo( img_size );
-	if (!pbo) {
-		release_texture(texture);
-		return 1;
+	int pbo_count = CLAMP( get_int( "readback_pbos" ), 1, MIN( MAXPBOCOUNT, height ) );
+	glsl_pbo pbo[MAXPBOCOUNT];
+	for (int i = 0; i < pbo_count; ++i) {
+		int band_height = height * (i + 1) / pbo_count - height * i / pbo_count;
+		pbo[i] = get_pbo( i, width * band_height * 4 );
+		if (!pbo[i]) {
+			release_texture(texture);
+			return 1;
+		}
 	}
 
 	// Set the FBO
@@ -484,35 +658,57 @@ int GlslManager::render_frame_rgba(EffectChain *chain, mlt_frame frame, int widt
 
 	chain->render_to_fbo( fbo, width, height );
 
-	// Read FBO into PBO
+	// Read FBO into PBOs
+	GLsync fence[MAXPBOCOUNT];
 	glBindFramebuffer( GL_FRAMEBUFFER, fbo );
 	check_error();
-	glBindBuffer( GL_PIXEL_PACK_BUFFER_ARB, pbo->pbo );
-	check_error();
-	glBufferData( GL_PIXEL_PACK_BUFFER_ARB, img_size, NULL, GL_STREAM_READ );
-	check_error();
-	glReadPixels( 0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, BUFFER_OFFSET(0) );
-	check_error();
+	for (int i = 0; i < pbo_count; ++i) {
+		int y = height * i / pbo_count;
+		int band_height = height * (i + 1) / pbo_count - y;
+		glBindBuffer( GL_PIXEL_PACK_BUFFER_ARB, pbo[i]->pbo );
+		check_error();
+		glBufferData( GL_PIXEL_PACK_BUFFER_ARB, width * band_height * 4, NULL, GL_STREAM_READ );
+		check_error();
+		glReadPixels( 0, y, width, band_height, GL_BGRA, GL_UNSIGNED_BYTE, BUFFER_OFFSET(0) );
+		check_error();
+		fence[i] = pbo_count > 1 ? glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 ) : NULL;
+	}
+	if (pbo_count > 1)
+		glFlush();
 
-	// Copy from PBO
-	uint8_t* buf = (uint8_t*) glMapBuffer( GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY );
-	check_error();
 	*image = (uint8_t*) mlt_pool_alloc( img_size );
 	mlt_frame_set_image( frame, *image, img_size, mlt_pool_release );
-	memcpy( *image, buf, img_size );
+	for (int i = 0; i < pbo_count; ++i) {
+		int y = height * i / pbo_count;
+		int band_size = width * ( height * (i + 1) / pbo_count - y ) * 4;
+		uint8_t *band = *image + width * y * 4;
+
+		if (fence[i]) {
+			glClientWaitSync( fence[i], 0, GL_TIMEOUT_IGNORED );
+			glDeleteSync( fence[i] );
+		}
+
+		// Copy from PBO
+		glBindBuffer( GL_PIXEL_PACK_BUFFER_ARB, pbo[i]->pbo );
+		check_error();
+		uint8_t* buf = (uint8_t*) glMapBuffer( GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY );
+		check_error();
+		memcpy( band, buf, band_size );
+
+		// Convert BGRA to RGBA
+		register uint8_t *p = band;
+		register int n = band_size / 4 + 1;
+		while ( --n ) {
+			uint8_t b = p[0];
+			*p = p[2]; p += 2;
+			*p = b; p += 2;
+		}
 
-	// Convert BGRA to RGBA
-	register uint8_t *p = *image;
-	register int n = width * height + 1;
-	while ( --n ) {
-		uint8_t b = p[0];
-		*p = p[2]; p += 2;
-		*p = b; p += 2;
+		glUnmapBuffer( GL_PIXEL_PACK_BUFFER_ARB );
+		check_error();
 	}
 
 	// Release PBO and FBO
-	glUnmapBuffer( GL_PIXEL_PACK_BUFFER_ARB );
-	check_error();
 	glBindBuffer( GL_PIXEL_PACK_BUFFER_ARB, 0 );
 	check_error();
 	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
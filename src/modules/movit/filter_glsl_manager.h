@@ -60,6 +60,23 @@ struct glsl_pbo_s
 };
 typedef struct glsl_pbo_s *glsl_pbo;
 
+// The most PBOs render_frame_rgba() reads a frame back with
+#define MAXPBOCOUNT 8
+
+// A PBO that is mapped for as long as it lives, to upload input images through
+struct glsl_upload_s
+{
+	int used;
+	int size;
+	GLuint pbo;
+	uint8_t *data;
+	GLsync fence;
+};
+typedef struct glsl_upload_s *glsl_upload;
+
+// The most upload PBOs kept at once
+#define MAXUPLOADCOUNT 8
+
 namespace movit {
 
 class Effect;
@@ -98,13 +115,16 @@ public:
 	glsl_texture get_texture(int width, int height, GLint internal_format);
 	static void release_texture(glsl_texture);
 	static void delete_sync(GLsync sync);
-	glsl_pbo get_pbo(int size);
+	glsl_pbo get_pbo(int index, int size);
+	glsl_upload get_upload(int size);
+	static void release_upload(glsl_upload);
 	void cleanupContext();
 
 	movit::ResourcePool* get_resource_pool() { return resource_pool; }
 
 	static void set_chain(mlt_service, GlslChain*);
 	static GlslChain* get_chain(mlt_service);
+	static GlslChain* find_chain(mlt_service, const std::string& fingerprint);
 
 	static movit::Effect* get_effect(mlt_service, mlt_frame);
 	static movit::Effect* set_effect(mlt_service, mlt_frame, movit::Effect*);
@@ -112,6 +132,8 @@ public:
 	static MltInput* set_input(mlt_producer, mlt_frame, MltInput*);
 	static uint8_t* get_input_pixel_pointer(mlt_producer, mlt_frame);
 	static uint8_t* set_input_pixel_pointer(mlt_producer, mlt_frame, uint8_t*);
+	static glsl_upload get_input_upload(mlt_producer, mlt_frame);
+	static void set_input_upload(mlt_producer, mlt_frame, glsl_upload);
 
 	static mlt_service get_effect_input(mlt_service, mlt_frame);
 	static void set_effect_input(mlt_service, mlt_frame, mlt_service);
@@ -136,7 +158,9 @@ private:
 	movit::ResourcePool* resource_pool;
 	Mlt::Deque texture_list;
 	Mlt::Deque syncs_to_delete;
-	glsl_pbo  pbo;
+	Mlt::Deque upload_list;
+	int upload_supported;
+	glsl_pbo  pbos[MAXPBOCOUNT];
 	Mlt::Event* initEvent;
 	Mlt::Event* closeEvent;
 	GLsync prev_sync;
@@ -306,14 +306,13 @@ static void dispose_movit_effects( mlt_service service, mlt_frame frame )
 
 static void finalize_movit_chain( mlt_service leaf_service, mlt_frame frame )
 {
-	GlslChain* chain = GlslManager::get_chain( leaf_service );
-
 	std::string new_fingerprint;
 	build_fingerprint( leaf_service, frame, &new_fingerprint );
 
 	// Build the chain if needed.
-	if ( !chain || new_fingerprint != chain->fingerprint ) {
-		mlt_log_debug( leaf_service, "=== CREATING NEW CHAIN (old chain=%p, leaf=%p, fingerprint=%s) ===\n", chain, leaf_service, new_fingerprint.c_str() );
+	GlslChain* chain = GlslManager::find_chain( leaf_service, new_fingerprint );
+	if ( !chain ) {
+		mlt_log_debug( leaf_service, "=== CREATING NEW CHAIN (old chain=%p, leaf=%p, fingerprint=%s) ===\n", GlslManager::get_chain( leaf_service ), leaf_service, new_fingerprint.c_str() );
 		mlt_profile profile = mlt_service_profile( leaf_service );
 		chain = new GlslChain;
 		chain->effect_chain = new EffectChain(
@@ -346,7 +345,10 @@ static void set_movit_parameters( GlslChain *chain, mlt_service service, mlt_fra
 	if ( service == (mlt_service) -1 ) {
 		mlt_producer producer = mlt_producer_cut_parent( mlt_frame_get_original_producer( frame ) );
 		MltInput* input = chain->inputs[ producer ];
-		if (input)
+		glsl_upload upload = GlslManager::get_input_upload( producer, frame );
+		if (input && upload)
+			input->set_pixel_data( NULL, upload->pbo );
+		else if (input)
 			input->set_pixel_data( GlslManager::get_input_pixel_pointer( producer, frame ) );
 		return;
 	}
@@ -426,7 +428,13 @@ static void dispose_pixel_pointers( GlslChain *chain, mlt_service service, mlt_f
 		MltInput* input = chain->inputs[ producer ];
 		if (input)
 			input->invalidate_pixel_data();
-		mlt_pool_release( GlslManager::get_input_pixel_pointer( producer, frame ) );
+		glsl_upload upload = GlslManager::get_input_upload( producer, frame );
+		if ( upload ) {
+			GlslManager::release_upload( upload );
+			GlslManager::set_input_upload( producer, frame, NULL );
+		} else {
+			mlt_pool_release( GlslManager::get_input_pixel_pointer( producer, frame ) );
+		}
 		return;
 	}
 
@@ -451,6 +459,8 @@ static int movit_render( EffectChain *chain, mlt_frame frame, mlt_image_format *
 		mlt_log_error( NULL, "Invalid frame size for movit_render: %dx%d.\n", width, height );
 		return 1;
 	}
+	if ( mlt_frame_is_cancelled( frame ) )
+		return 1;
 
 	GlslManager* glsl = GlslManager::get_instance();
 	int error;
@@ -505,7 +515,9 @@ static MltInput* create_input( mlt_properties properties, mlt_image_format forma
 // Make a copy of the given image (allocated using mlt_pool_alloc) suitable
 // to pass as pixel pointer to an MltInput (created using create_input
 // with the same parameters), and return that pointer.
-static uint8_t* make_input_copy( mlt_image_format format, uint8_t *image, int width, int height )
+// When possible, the copy is written straight into a mapped PBO instead,
+// which is returned in upload, so the GPU can fetch it on its own.
+static uint8_t* make_input_copy( mlt_image_format format, uint8_t *image, int width, int height, glsl_upload *upload )
 {
 	if (width < 1 || height < 1) {
 		mlt_log_error( NULL, "Invalid frame size for make_input_copy: %dx%d.\n", width, height );
@@ -513,7 +525,8 @@ static uint8_t* make_input_copy( mlt_image_format format, uint8_t *image, int wi
 	}
 
 	int img_size = mlt_image_format_size( format, width, height, NULL );
-	uint8_t* img_copy = (uint8_t*) mlt_pool_alloc( img_size );
+	*upload = GlslManager::get_instance()->get_upload( img_size );
+	uint8_t* img_copy = *upload ? (*upload)->data : (uint8_t*) mlt_pool_alloc( img_size );
 	if ( format == mlt_image_yuv422 ) {
 		yuv422_to_yuv422p( image, img_copy, width, height );
 	} else {
@@ -566,7 +579,8 @@ static int convert_image( mlt_frame frame, uint8_t **image, mlt_image_format *fo
 		}
 
 		GlslManager::set_input( producer, frame, input );
-		uint8_t *img_copy = make_input_copy( *format, *image, width, height );
+		glsl_upload upload = NULL;
+		uint8_t *img_copy = make_input_copy( *format, *image, width, height, &upload );
 
 		if (!img_copy) {
 			delete input;
@@ -574,6 +588,7 @@ static int convert_image( mlt_frame frame, uint8_t **image, mlt_image_format *fo
 		}
 
 		GlslManager::set_input_pixel_pointer( producer, frame, img_copy );
+		GlslManager::set_input_upload( producer, frame, upload );
 
 		*image = (uint8_t *) -1;
 		mlt_frame_set_image( frame, *image, 0, NULL );
@@ -591,6 +606,15 @@ static int convert_image( mlt_frame frame, uint8_t **image, mlt_image_format *fo
 			MltInput *input = GlslManager::get_input( producer, frame );
 			*image = GlslManager::get_input_pixel_pointer( producer, frame );
 			*format = input->get_format();
+			glsl_upload upload = GlslManager::get_input_upload( producer, frame );
+			if ( upload ) {
+				// Move it out of the PBO into memory that can be freed with the frame
+				uint8_t *copy = (uint8_t*) mlt_pool_alloc( upload->size );
+				memcpy( copy, *image, upload->size );
+				*image = copy;
+				GlslManager::release_upload( upload );
+				GlslManager::set_input_upload( producer, frame, NULL );
+			}
 			delete input;
 			GlslManager::get_instance()->unlock_service( frame );
 			return convert_on_cpu( frame, image, format, output_format );
@@ -655,15 +679,22 @@ static int convert_image( mlt_frame frame, uint8_t **image, mlt_image_format *fo
 
 			if ( *format == mlt_image_yuv422 ) {
 				// We need to convert to planar, which make_input_copy() will do for us.
-				uint8_t *planar = make_input_copy( *format, *image, width, height );
+				glsl_upload upload = NULL;
+				uint8_t *planar = make_input_copy( *format, *image, width, height, &upload );
 
 				if (!planar) {
 					return 1;
 				}
 
-				input->set_pixel_data( planar );
+				if ( upload )
+					input->set_pixel_data( NULL, upload->pbo );
+				else
+					input->set_pixel_data( planar );
 				error = movit_render( chain, frame, format, output_format, width, height, image );
-				mlt_pool_release( planar );
+				if ( upload )
+					GlslManager::release_upload( upload );
+				else
+					mlt_pool_release( planar );
 			} else {
 				input->set_pixel_data( *image );
 				error = movit_render( chain, frame, format, output_format, width, height, image );
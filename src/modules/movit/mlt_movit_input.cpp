@@ -73,7 +73,7 @@ void MltInput::useYCbCrInput(const ImageFormat& image_format, const YCbCrFormat&
 	}
 }
 
-void MltInput::set_pixel_data(const unsigned char* data)
+void MltInput::set_pixel_data(const unsigned char* data, GLuint pbo)
 {
 	if (!input) {
 		mlt_log_error( NULL, "No input for set_pixel_data");
@@ -88,12 +88,12 @@ void MltInput::set_pixel_data(const unsigned char* data)
 
 	if (isRGB) {
 		FlatInput* flat = (FlatInput*) input;
-		flat->set_pixel_data(data);
+		flat->set_pixel_data(data, pbo);
 	} else {
 		YCbCrInput* ycbcr = (YCbCrInput*) input;
-		ycbcr->set_pixel_data(0, data);
-		ycbcr->set_pixel_data(1, &data[m_width * m_height]);
-		ycbcr->set_pixel_data(2, &data[m_width * m_height + (m_width / m_ycbcr_format.chroma_subsampling_x * m_height / m_ycbcr_format.chroma_subsampling_y)]);
+		ycbcr->set_pixel_data(0, data, pbo);
+		ycbcr->set_pixel_data(1, &data[m_width * m_height], pbo);
+		ycbcr->set_pixel_data(2, &data[m_width * m_height + (m_width / m_ycbcr_format.chroma_subsampling_x * m_height / m_ycbcr_format.chroma_subsampling_y)], pbo);
 	}
 }
 
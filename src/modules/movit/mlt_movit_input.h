@@ -34,7 +34,8 @@ public:
 
 	void useFlatInput(movit::MovitPixelFormat pix_fmt, unsigned width, unsigned height);
 	void useYCbCrInput(const movit::ImageFormat& image_format, const movit::YCbCrFormat& ycbcr_format, unsigned width, unsigned height);
-	void set_pixel_data(const unsigned char* data);
+	// With a pbo, data is the offset of the image in it.
+	void set_pixel_data(const unsigned char* data, GLuint pbo = 0);
 	void invalidate_pixel_data();
 	movit::Input *get_input() { return input; }
 
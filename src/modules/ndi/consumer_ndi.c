@@ -43,8 +43,40 @@ typedef struct
 	pthread_t th;
 	int count;
 	int sliced_swab;
+	int async;
+	uint8_t* buffers[2];
+	int buffer_size, buffer_index;
 } consumer_ndi_t;
 
+/** Get a buffer for the next video frame.
+ *
+ * The buffers are kept between frames. An asynchronous send uses the buffer
+ * until the next send, so then there are two and they alternate.
+ */
+
+static uint8_t* video_buffer( consumer_ndi_t* self, NDIlib_send_instance_t ndi_send, int size )
+{
+	uint8_t* buffer;
+
+	if ( size > self->buffer_size )
+	{
+		// Make the sender finish with the buffers before releasing them
+		if ( self->async )
+			NDIlib_send_send_video_async( ndi_send, NULL );
+		mlt_pool_release( self->buffers[0] );
+		mlt_pool_release( self->buffers[1] );
+		self->buffers[0] = mlt_pool_alloc( size );
+		self->buffers[1] = self->async ? mlt_pool_alloc( size ) : NULL;
+		self->buffer_size = size;
+		self->buffer_index = 0;
+	}
+	buffer = self->buffers[ self->buffer_index ];
+	if ( self->async )
+		self->buffer_index ^= 1;
+
+	return buffer;
+}
+
 static void* consumer_ndi_feeder( void* p )
 {
 	int i;
@@ -143,7 +175,7 @@ static void* consumer_ndi_feeder( void* p )
 					timecode,
 
 					// The video memory used for this frame
-					buffer = (uint8_t*)malloc( height * stride ),
+					buffer = video_buffer( self, ndi_send, height * stride ),
 
 					// The line to line stride of this image
 					stride
@@ -187,16 +219,16 @@ static void* consumer_ndi_feeder( void* p )
 					memset( buffer, 0, stride * height );
 				}
 
-				mlt_audio_format aformat = mlt_audio_s16;
+				mlt_audio_format aformat = mlt_audio_float;
 				int frequency = 48000;
 				int m_channels = 2;
 				int samples = mlt_audio_calculate_frame_samples( mlt_profile_fps( profile ), frequency, self->count );
-				int16_t *pcm = 0;
+				float *pcm = 0;
 
 				if ( !mlt_frame_get_audio( frm, (void**) &pcm, &aformat, &frequency, &m_channels, &samples ) )
 				{
 					// Create an audio buffer
-					const NDIlib_audio_frame_interleaved_16s_t audio_data =
+					const NDIlib_audio_frame_t audio_data =
 					{
 						// 48kHz
 						frequency,
@@ -210,21 +242,21 @@ static void* consumer_ndi_feeder( void* p )
 						// Timecode
 						timecode,
 
-						// reference_level
-						0,
+						// The audio data, planar float like NDI uses
+						pcm,
 
-						// The audio data, interleaved 16bpp
-						pcm
+						// The channel to channel stride
+						samples * sizeof( float )
 					};
 
-					NDIlib_util_send_send_audio_interleaved_16s(ndi_send, &audio_data);
+					NDIlib_send_send_audio( ndi_send, &audio_data );
 				}
 
 				// We now submit the frame.
-				NDIlib_send_send_video(ndi_send, &ndi_video_frame);
-
-				// free buf
-				free( ndi_video_frame.p_data );
+				if ( self->async )
+					NDIlib_send_send_video_async( ndi_send, &ndi_video_frame );
+				else
+					NDIlib_send_send_video( ndi_send, &ndi_video_frame );
 
 				self->count++;
 			}
@@ -241,7 +273,14 @@ static void* consumer_ndi_feeder( void* p )
 		mlt_events_fire( properties, "consumer-frame-show", mlt_event_data_from_frame(frame) );
 	}
 
+	// Release the last buffer given to the sender
+	if ( self->async )
+		NDIlib_send_send_video_async( ndi_send, NULL );
 	NDIlib_send_destroy( ndi_send );
+	mlt_pool_release( self->buffers[0] );
+	mlt_pool_release( self->buffers[1] );
+	self->buffers[0] = self->buffers[1] = NULL;
+	self->buffer_size = 0;
 
 	mlt_log_debug( MLT_CONSUMER_SERVICE(consumer), "%s: exiting\n", __FUNCTION__ );
 
@@ -268,6 +307,7 @@ static int consumer_ndi_start( mlt_consumer consumer )
 	if ( !self->f_running )
 	{
 		self->sliced_swab = mlt_properties_get_int( properties, "sliced_swab" );
+		self->async = mlt_properties_get_int( properties, "async" );
 
 		// set flags
 		self->f_exit = 0;
@@ -46,11 +46,12 @@ typedef struct
 	char* arg;
 	pthread_t th;
 	int count;
-	mlt_deque a_queue, v_queue;
+	mlt_deque a_queue;
+	mlt_ring v_queue;
 	pthread_mutex_t lock;
-	pthread_cond_t cond;
 	NDIlib_recv_instance_t recv;
 	int v_queue_limit, a_queue_limit, v_prefill;
+	int dropped, late;
 } producer_ndi_t;
 
 static void* producer_ndi_feeder( void* p )
@@ -155,17 +156,18 @@ static void* producer_ndi_feeder( void* p )
 				break;
 
 			case NDIlib_frame_type_video:
-				pthread_mutex_lock( &self->lock );
-				mlt_deque_push_back( self->v_queue, video );
-				if ( mlt_deque_count( self->v_queue ) >= self->v_queue_limit )
+				// The video queue needs no lock, so get_frame never holds up the capture
+				if ( !mlt_ring_push( self->v_queue, video ) )
+					video = NULL;
+				if ( !video && mlt_ring_count( self->v_queue ) >= self->v_queue_limit )
+					video = mlt_ring_pop( self->v_queue );
+
+				// Drop the oldest frame and reuse its description for the next one
+				if ( video )
 				{
-					video = mlt_deque_pop_front( self->v_queue );
 					NDIlib_recv_free_video( self->recv, video );
+					mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( producer ), "dropped", ++self->dropped );
 				}
-				else
-					video = NULL;
-				pthread_cond_broadcast( &self->cond );
-				pthread_mutex_unlock( &self->lock );
 				break;
 
 			case NDIlib_frame_type_audio:
@@ -224,7 +226,6 @@ static void* producer_ndi_feeder( void* p )
 					mlt_pool_release( audio_packet->p_data );
 					mlt_pool_release( audio_packet );
 				}
-				pthread_cond_broadcast( &self->cond );
 				pthread_mutex_unlock( &self->lock );
 				break;
 
@@ -371,25 +372,21 @@ static int get_frame( mlt_producer producer, mlt_frame_ptr pframe, int index )
 		self->f_running = 1;
 	}
 
-	mlt_log_debug( NULL, "%s:%d: audio_cnt=%d, video_cnt=%d\n", __FILE__, __LINE__,
-		mlt_deque_count( self->a_queue ), mlt_deque_count( self->v_queue ));
+	pthread_mutex_unlock( &self->lock );
+
+	mlt_log_debug( NULL, "%s:%d: video_cnt=%d\n", __FILE__, __LINE__, mlt_ring_count( self->v_queue ) );
 
 	// wait for prefill
-	if ( mlt_deque_count( self->v_queue ) < self->v_prefill )
-	{
-		struct timespec tm;
-
-		// Wait
-		clock_gettime(CLOCK_REALTIME, &tm);
-		tm.tv_nsec += self->v_prefill * 1000000000LL / fps;
-		tm.tv_sec += tm.tv_nsec / 1000000000LL;
-		tm.tv_nsec %= 1000000000LL;
-		pthread_cond_timedwait( &self->cond, &self->lock, &tm );
-	}
+	if ( mlt_ring_count( self->v_queue ) < self->v_prefill )
+		mlt_ring_wait_for_items_timeout( self->v_queue, self->v_prefill, self->v_prefill * 1000000LL / fps );
 
 	// pop frame to use
-	if ( mlt_deque_count( self->v_queue ) >= self->v_prefill )
-		video = (NDIlib_video_frame_t*)mlt_deque_pop_front( self->v_queue );
+	if ( mlt_ring_count( self->v_queue ) >= self->v_prefill )
+		video = (NDIlib_video_frame_t*)mlt_ring_pop( self->v_queue );
+	else
+		mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( producer ), "late", ++self->late );
+
+	pthread_mutex_lock( &self->lock );
 
 	if ( video )
 	{
@@ -521,7 +518,7 @@ static void producer_ndi_close( mlt_producer producer )
 		self->f_exit = 1;
 
 		// signal threads
-		pthread_cond_broadcast( &self->cond );
+		mlt_ring_interrupt( self->v_queue, 1 );
 
 		// wait for thread
 		pthread_join( self->th, NULL );
@@ -538,9 +535,9 @@ static void producer_ndi_close( mlt_producer producer )
 		}
 
 		// dequeue video frames
-		while( mlt_deque_count( self->v_queue ) )
+		while( mlt_ring_count( self->v_queue ) )
 		{
-			NDIlib_video_frame_t* video = (NDIlib_video_frame_t*)mlt_deque_pop_front( self->v_queue );
+			NDIlib_video_frame_t* video = (NDIlib_video_frame_t*)mlt_ring_pop( self->v_queue );
 			NDIlib_recv_free_video( self->recv, video );
 			mlt_pool_release( video );
 		}
@@ -550,9 +547,8 @@ static void producer_ndi_close( mlt_producer producer )
 	}
 
 	mlt_deque_close( self->a_queue );
-	mlt_deque_close( self->v_queue );
+	mlt_ring_close( self->v_queue );
 	pthread_mutex_destroy( &self->lock );
-	pthread_cond_destroy( &self->cond );
 
 	free( producer->child );
 	producer->close = NULL;
@@ -580,10 +576,9 @@ mlt_producer producer_ndi_init( mlt_profile profile, mlt_service_type type, cons
 		// Setup context
 		self->arg = strdup( arg );
 		pthread_mutex_init( &self->lock, NULL );
-		pthread_cond_init( &self->cond, NULL );
-		self->v_queue = mlt_deque_init();
-		self->a_queue = mlt_deque_init();
 		self->v_queue_limit = 6;
+		self->v_queue = mlt_ring_init( self->v_queue_limit );
+		self->a_queue = mlt_deque_init();
 		self->a_queue_limit = 6;
 		self->v_prefill = 2;
 
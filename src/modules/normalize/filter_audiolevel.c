@@ -19,6 +19,8 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include "volume_simd.h"
+
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_log.h>
@@ -71,13 +73,29 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 	int c, s;
 	char key[ 50 ];
 	int16_t *pcm = (int16_t*) *buffer;
+	const volume_simd *simd = volume_simd_get();
+	int64_t sums[ VOLUME_SIMD_CHANNELS ];
+	int marks[ VOLUME_SIMD_CHANNELS ];
+	int vector_samples = 0;
+
+	if ( simd->level_s16 )
+		vector_samples = simd->level_s16( pcm, num_channels, num_samples, sums, marks );
 
 	for ( c = 0; c < *channels; c++ )
 	{
 		double val = 0;
 		double level = 0.0;
 
-		for ( s = 0; s < num_samples; s++ )
+		s = 0;
+		// Take the sum of the start of the channel from the vector code
+		// unless it needs checking for overloaded samples.
+		if ( vector_samples > 0 && !marks[c] )
+		{
+			val = sums[c] / 128.0;
+			num_oversample = 0;
+			s = vector_samples;
+		}
+		for ( ; s < num_samples; s++ )
 		{
 			double sample = fabs( pcm[c + s * num_channels] / 128.0 );
 			val += sample;
@@ -17,6 +17,8 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include "volume_simd.h"
+
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 
@@ -33,10 +35,6 @@
 
 #define samp_width 16
 
-#ifndef ROUND
-# define ROUND(x) floor((x) + 0.5)
-#endif
-
 #define DBFSTOAMP(x) pow(10,(x)/20.0)
 
 /** Return nonzero if the two strings are equal, ignoring case, up to
@@ -52,52 +50,28 @@ int strncaseeq(const char *s1, const char *s2, size_t n)
 	return 1;
 }
 
-/** Limiter function.
- 
-         / tanh((x + lev) / (1-lev)) * (1-lev) - lev        (for x < -lev)
-         |
-    x' = | x                                                (for |x| <= lev)
-         |
-         \ tanh((x - lev) / (1-lev)) * (1-lev) + lev        (for x > lev)
- 
-  With limiter level = 0, this is equivalent to a tanh() function;
-  with limiter level = 1, this is equivalent to clipping.
-*/
-static inline double limiter( double x, double lmtr_lvl )
-{
-	double xp = x;
-
-	if (x < -lmtr_lvl)
-		xp = tanh((x + lmtr_lvl) / (1-lmtr_lvl)) * (1-lmtr_lvl) - lmtr_lvl;
-	else if (x > lmtr_lvl)
-		xp = tanh((x - lmtr_lvl) / (1-lmtr_lvl)) * (1-lmtr_lvl) + lmtr_lvl;
-
-	return xp;
-}
-
-
-/** Takes a full smoothing window, and returns the value of the center
-    element, smoothed.
+/** Takes a full smoothing window, and returns the sum of the set elements
+    and their number in n.
 
-    Currently, just does a mean filter, but we could do a median or
-    gaussian filter here instead.
+    The mean of these is the smoothed value. Currently, just does a mean
+    filter, but we could do a median or gaussian filter here instead.
 */
-static inline double get_smoothed_data( double *buf, int count )
+static inline double get_smoothed_sum( double *buf, int count, int *n )
 {
 	int i, j;
-	double smoothed = 0;
+	double sum = 0;
 
 	for ( i = 0, j = 0; i < count; i++ )
 	{
 		if ( buf[ i ] != -1.0 )
 		{
-			smoothed += buf[ i ];
+			sum += buf[ i ];
 			j++;
 		}
 	}
-	if (j) smoothed /= j;
+	*n = j;
 
-	return smoothed;
+	return sum;
 }
 
 /** Get the max power level (using RMS) and peak level of the audio segment.
@@ -175,7 +149,6 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 	int normalise =  mlt_properties_get_int( instance_props, "normalise" );
 	double amplitude =  mlt_properties_get_double( instance_props, "amplitude" );
 	int i, j;
-	double sample;
 	int16_t peak;
 
 	// Use animated value for gain if "level" property is set 
@@ -205,17 +178,37 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 		if ( window > 0 && smooth_buffer != NULL )
 		{
 			int smooth_index = mlt_properties_get_int( filter_props, "_smooth_index" );
-			
+			double smooth_sum = mlt_properties_get_double( filter_props, "_smooth_sum" );
+			int smooth_count = mlt_properties_get_int( filter_props, "_smooth_count" );
+
+			// Keep a running sum of the smoothing buffer instead of adding it
+			// up again every frame
+			if ( smooth_buffer[ smooth_index ] != -1.0 )
+			{
+				smooth_sum -= smooth_buffer[ smooth_index ];
+				smooth_count--;
+			}
+
 			// Compute the signal power and put into smoothing buffer
 			smooth_buffer[ smooth_index ] = signal_max_power( *buffer, *channels, *samples, &peak );
+			smooth_sum += smooth_buffer[ smooth_index ];
+			smooth_count++;
 
 			if ( smooth_buffer[ smooth_index ] > EPSILON )
 			{
-				mlt_properties_set_int( filter_props, "_smooth_index", ( smooth_index + 1 ) % window );
+				smooth_index = ( smooth_index + 1 ) % window;
+				mlt_properties_set_int( filter_props, "_smooth_index", smooth_index );
+
+				// Add up the whole buffer once per pass to stop rounding
+				// errors accumulating in the running sum
+				if ( smooth_index == 0 )
+					smooth_sum = get_smoothed_sum( smooth_buffer, window, &smooth_count );
 
 				// Smooth the data and compute the gain
-				gain *= amplitude / get_smoothed_data( smooth_buffer, window );
+				gain *= amplitude / ( smooth_sum / smooth_count );
 			}
+			mlt_properties_set_double( filter_props, "_smooth_sum", smooth_sum );
+			mlt_properties_set_int( filter_props, "_smooth_count", smooth_count );
 		}
 		else
 		{
@@ -246,24 +239,40 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
 
 	// Ramp from the previous gain to the current
-	gain = previous_gain;
+	float start = previous_gain;
+	float step = gain_step;
+	const volume_simd *simd = volume_simd_get();
+
+	// Nothing to do at unity gain
+	if ( start == 1.0f && step == 0.0f )
+		return 0;
 
 	// Apply the gain
+	i = 0;
 	if ( normalise )
 	{
 		int16_t *p = *buffer;
 		// Determine numeric limits
 		int bytes_per_samp = (samp_width - 1) / 8 + 1;
-		int samplemax = (1 << (bytes_per_samp * 8 - 1)) - 1;
-
-		for ( i = 0; i < *samples; i++, gain += gain_step ) {
+		float samplemax = (1 << (bytes_per_samp * 8 - 1)) - 1;
+		float limit = limiter_level * samplemax;
+		float end = start + (float) ( *samples - 1 ) * step;
+
+		// The limiter is used instead of clipping where the gain is above
+		// 1.0, and the vector code applies it to all of the samples or none.
+		if ( simd->gain_s16 && start <= 1.0f && end <= 1.0f )
+			i = simd->gain_s16( p, *channels, *samples, start, step, -1.0f );
+		else if ( simd->gain_s16 && start > 1.0f && end > 1.0f )
+			i = simd->gain_s16( p, *channels, *samples, start, step, limit );
+		p += i * *channels;
+
+		for ( ; i < *samples; i++ ) {
+			float sample_gain = start + (float) i * step;
 			for ( j = 0; j < *channels; j++ ) {
-				sample = *p * gain;
-				*p = ROUND( sample );
-				if ( gain > 1.0 && normalise ) {
-					/* use limiter function instead of clipping */
-					*p = ROUND( samplemax * limiter( sample / (double) samplemax, limiter_level ) );
-				}
+				float sample = *p * sample_gain;
+				if ( sample_gain > 1.0f )
+					sample = volume_limiter( sample, limit, samplemax );
+				*p = CLAMP( lrintf( sample ), -32768, 32767 );
 				p++;
 			}
 		}
@@ -271,9 +280,14 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 	else
 	{
 		float *p = *buffer;
-		for ( i = 0; i < *samples; i++, gain += gain_step ) {
+		if ( simd->gain_f32 )
+			i = simd->gain_f32( p, *channels, *samples, start, step );
+		p += i * *channels;
+
+		for ( ; i < *samples; i++ ) {
+			float sample_gain = start + (float) i * step;
 			for ( j = 0; j < *channels; j++, p++ ) {
-				p[0] *= gain;
+				p[0] *= sample_gain;
 			}
 		}
 	}
@@ -0,0 +1,235 @@
+/*
+ * volume_simd.c -- vectorised gain and level for the normalize filters
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "volume_simd.h"
+
+#include <framework/mlt_cpu.h>
+
+#include <pthread.h>
+#include <stddef.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) ) && defined(__SSE2__)
+#define USE_X86_SIMD 1
+#include <immintrin.h>
+
+// The buffers are processed in blocks of a whole number of samples that is
+// also a whole number of vectors for any channel count. offsets[e] is the
+// sample of element e in a block, so the gain of a lane is
+// start + ( i + offsets[e] ) * step, where the sum is an exact integer,
+// giving the same gain as the scalar ramp.
+
+static void block_offsets( float *offsets, int channels, int block )
+{
+	int e;
+	for ( e = 0; e < block * channels; e++ )
+		offsets[e] = e / channels;
+}
+
+// No FMA, so every product is rounded like in the scalar code
+__attribute__((target("avx")))
+static int gain_f32_avx( float *buffer, int channels, int samples, float start, float step )
+{
+	float offsets[ 8 * VOLUME_SIMD_CHANNELS ];
+	const __m256 start_v = _mm256_set1_ps( start );
+	const __m256 step_v = _mm256_set1_ps( step );
+	int i, g;
+
+	if ( channels < 1 || channels > VOLUME_SIMD_CHANNELS )
+		return 0;
+	block_offsets( offsets, channels, 8 );
+	for ( i = 0; i + 8 <= samples; i += 8 )
+	{
+		const __m256 base = _mm256_set1_ps( i );
+		for ( g = 0; g < channels; g++ )
+		{
+			float *p = buffer + i * channels + g * 8;
+			__m256 gain = _mm256_add_ps( start_v, _mm256_mul_ps( _mm256_add_ps( base, _mm256_loadu_ps( offsets + g * 8 ) ), step_v ) );
+			_mm256_storeu_ps( p, _mm256_mul_ps( _mm256_loadu_ps( p ), gain ) );
+		}
+	}
+	return i;
+}
+
+static int gain_f32_sse2( float *buffer, int channels, int samples, float start, float step )
+{
+	float offsets[ 4 * VOLUME_SIMD_CHANNELS ];
+	const __m128 start_v = _mm_set1_ps( start );
+	const __m128 step_v = _mm_set1_ps( step );
+	int i, g;
+
+	if ( channels < 1 || channels > VOLUME_SIMD_CHANNELS )
+		return 0;
+	block_offsets( offsets, channels, 4 );
+	for ( i = 0; i + 4 <= samples; i += 4 )
+	{
+		const __m128 base = _mm_set1_ps( i );
+		for ( g = 0; g < channels; g++ )
+		{
+			float *p = buffer + i * channels + g * 4;
+			__m128 gain = _mm_add_ps( start_v, _mm_mul_ps( _mm_add_ps( base, _mm_loadu_ps( offsets + g * 4 ) ), step_v ) );
+			_mm_storeu_ps( p, _mm_mul_ps( _mm_loadu_ps( p ), gain ) );
+		}
+	}
+	return i;
+}
+
+// Apply the limiter to the lanes that exceed it. This is rare, so the lanes
+// go through the scalar function.
+static inline __m128 limit_sse2( __m128 x, float limit )
+{
+	const __m128 abs_mask = _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+	if ( _mm_movemask_ps( _mm_cmpgt_ps( _mm_and_ps( x, abs_mask ), _mm_set1_ps( limit ) ) ) )
+	{
+		float lanes[4];
+		int e;
+		_mm_storeu_ps( lanes, x );
+		for ( e = 0; e < 4; e++ )
+			lanes[e] = volume_limiter( lanes[e], limit, 32767.0f );
+		x = _mm_loadu_ps( lanes );
+	}
+	return x;
+}
+
+static int gain_s16_sse2( int16_t *buffer, int channels, int samples, float start, float step, float limit )
+{
+	float offsets[ 8 * VOLUME_SIMD_CHANNELS ];
+	const __m128 start_v = _mm_set1_ps( start );
+	const __m128 step_v = _mm_set1_ps( step );
+	int i, g;
+
+	if ( channels < 1 || channels > VOLUME_SIMD_CHANNELS )
+		return 0;
+	block_offsets( offsets, channels, 8 );
+	for ( i = 0; i + 8 <= samples; i += 8 )
+	{
+		const __m128 base = _mm_set1_ps( i );
+		for ( g = 0; g < channels; g++ )
+		{
+			__m128i *p = (__m128i*) ( buffer + i * channels + g * 8 );
+			__m128i v = _mm_loadu_si128( p );
+			__m128 lo = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 ) );
+			__m128 hi = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( v, v ), 16 ) );
+			__m128 gain_lo = _mm_add_ps( start_v, _mm_mul_ps( _mm_add_ps( base, _mm_loadu_ps( offsets + g * 8 ) ), step_v ) );
+			__m128 gain_hi = _mm_add_ps( start_v, _mm_mul_ps( _mm_add_ps( base, _mm_loadu_ps( offsets + g * 8 + 4 ) ), step_v ) );
+			lo = _mm_mul_ps( lo, gain_lo );
+			hi = _mm_mul_ps( hi, gain_hi );
+			if ( limit >= 0.0f )
+			{
+				lo = limit_sse2( lo, limit );
+				hi = limit_sse2( hi, limit );
+			}
+			_mm_storeu_si128( p, _mm_packs_epi32( _mm_cvtps_epi32( lo ), _mm_cvtps_epi32( hi ) ) );
+		}
+	}
+	return i;
+}
+
+static inline __m128i abs_epi32_sse2( __m128i x )
+{
+	__m128i sign = _mm_srai_epi32( x, 31 );
+	return _mm_sub_epi32( _mm_xor_si128( x, sign ), sign );
+}
+
+static int level_s16_sse2( const int16_t *buffer, int channels, int samples, int64_t *sums, int *marks )
+{
+	__m128i acc[ 2 * VOLUME_SIMD_CHANNELS ];
+	__m128i mark[ VOLUME_SIMD_CHANNELS ];
+	const __m128i over_pos = _mm_set1_epi16( 16384 );
+	const __m128i over_neg = _mm_set1_epi16( -16384 );
+	int32_t lanes[8];
+	int16_t mark_lanes[8];
+	int i, g, e;
+
+	if ( channels < 1 || channels > VOLUME_SIMD_CHANNELS )
+		return 0;
+	// Each lane adds one sample per block, so keep the lanes from overflowing.
+	if ( samples > 8 * 65535 )
+		samples = 8 * 65535;
+	for ( g = 0; g < channels; g++ )
+	{
+		acc[2 * g] = acc[2 * g + 1] = _mm_setzero_si128();
+		mark[g] = _mm_setzero_si128();
+	}
+	for ( i = 0; i + 8 <= samples; i += 8 )
+	{
+		for ( g = 0; g < channels; g++ )
+		{
+			__m128i v = _mm_loadu_si128( (const __m128i*) ( buffer + i * channels + g * 8 ) );
+			__m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 );
+			__m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( v, v ), 16 );
+			acc[2 * g] = _mm_add_epi32( acc[2 * g], abs_epi32_sse2( lo ) );
+			acc[2 * g + 1] = _mm_add_epi32( acc[2 * g + 1], abs_epi32_sse2( hi ) );
+			mark[g] = _mm_or_si128( mark[g], _mm_or_si128( _mm_cmpeq_epi16( v, over_pos ), _mm_cmpeq_epi16( v, over_neg ) ) );
+		}
+	}
+	for ( g = 0; g < channels; g++ )
+	{
+		sums[g] = 0;
+		marks[g] = 0;
+	}
+	for ( g = 0; g < channels; g++ )
+	{
+		_mm_storeu_si128( (__m128i*) lanes, acc[2 * g] );
+		_mm_storeu_si128( (__m128i*) ( lanes + 4 ), acc[2 * g + 1] );
+		_mm_storeu_si128( (__m128i*) mark_lanes, mark[g] );
+		for ( e = 0; e < 8; e++ )
+		{
+			sums[ ( g * 8 + e ) % channels ] += lanes[e];
+			marks[ ( g * 8 + e ) % channels ] |= mark_lanes[e];
+		}
+	}
+	return i;
+}
+
+#endif
+
+static volume_simd g_simd;
+static pthread_once_t g_simd_once = PTHREAD_ONCE_INIT;
+
+static void simd_init( void )
+{
+#if USE_X86_SIMD
+	static const mlt_cpu_dispatch gain_f32[] = {
+		{ mlt_cpu_avx, gain_f32_avx },
+		{ mlt_cpu_sse2, gain_f32_sse2 },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch gain_s16[] = {
+		{ mlt_cpu_sse2, gain_s16_sse2 },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch level_s16[] = {
+		{ mlt_cpu_sse2, level_s16_sse2 },
+		{ 0, NULL }
+	};
+#else
+	static const mlt_cpu_dispatch gain_f32[] = { { 0, NULL } };
+	static const mlt_cpu_dispatch gain_s16[] = { { 0, NULL } };
+	static const mlt_cpu_dispatch level_s16[] = { { 0, NULL } };
+#endif
+	g_simd.gain_f32 = mlt_cpu_select( gain_f32 );
+	g_simd.gain_s16 = mlt_cpu_select( gain_s16 );
+	g_simd.level_s16 = mlt_cpu_select( level_s16 );
+}
+
+const volume_simd *volume_simd_get( void )
+{
+	pthread_once( &g_simd_once, simd_init );
+	return &g_simd;
+}
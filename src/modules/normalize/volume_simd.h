@@ -0,0 +1,76 @@
+/*
+ * volume_simd.h -- vectorised gain and level for the normalize filters
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef VOLUME_SIMD_H
+#define VOLUME_SIMD_H
+
+#include <math.h>
+#include <stdint.h>
+
+/** Limiter function in sample units.
+
+         / tanh((x + lev) / (max-lev)) * (max-lev) - lev    (for x < -lev)
+         |
+    x' = | x                                                (for |x| <= lev)
+         |
+         \ tanh((x - lev) / (max-lev)) * (max-lev) + lev    (for x > lev)
+
+  With limiter level = 0, this is equivalent to a tanh() function;
+  with limiter level = max, this is equivalent to clipping.
+*/
+static inline float volume_limiter( float x, float lev, float max )
+{
+	if ( x < -lev )
+		return tanhf( ( x + lev ) / ( max - lev ) ) * ( max - lev ) - lev;
+	else if ( x > lev )
+		return tanhf( ( x - lev ) / ( max - lev ) ) * ( max - lev ) + lev;
+	return x;
+}
+
+/** Gain and level functions for interleaved audio.
+ *
+ * The gain of sample i is start + i * step, computed in float in the same
+ * way as the scalar code in filter_volume, so the results are the same.
+ * gain_s16 rounds to the nearest integer and, when limit is at least 0,
+ * passes every sample through volume_limiter( x, limit, 32767 ).
+ * level_s16 adds up the absolute values of each channel into sums and sets
+ * marks for a channel that has a sample of +/-16384, which filter_audiolevel
+ * treats as overloaded. Each one handles the largest number of samples it
+ * can from the start of the buffer and returns it, leaving the rest to the
+ * caller.
+ */
+
+typedef struct
+{
+	int ( *gain_f32 )( float *buffer, int channels, int samples, float start, float step );
+	int ( *gain_s16 )( int16_t *buffer, int channels, int samples, float start, float step, float limit );
+	int ( *level_s16 )( const int16_t *buffer, int channels, int samples, int64_t *sums, int *marks );
+} volume_simd;
+
+/** The highest channel count the functions handle */
+
+#define VOLUME_SIMD_CHANNELS (8)
+
+/** Get the best functions for the running CPU, or NULL ones if none apply.
+ * They are chosen with mlt_cpu_select(), so MLT_CPU_FLAGS can restrict them.
+ */
+
+extern const volume_simd *volume_simd_get( void );
+
+#endif
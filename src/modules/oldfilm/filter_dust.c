@@ -25,11 +25,36 @@
 #include <string.h>
 #include <time.h>
 
-static void overlay_image(uint8_t *src, int src_width, int src_height , uint8_t *overlay, int overlay_width, int overlay_height, uint8_t * alpha , int xpos, int ypos, int upsidedown , int mirror )
+#include "rng.h"
+
+#define MIN_SLICE_HEIGHT (16)
+
+/** A speck of dust, either an overlay picture or drawn */
+
+typedef struct
+{
+	uint8_t *overlay;   /**< the picture, or NULL to draw a speck */
+	uint8_t *alpha;
+	int overlay_width, overlay_height;
+	int x1, y1;
+	int upsidedown, mirror;
+	int type, dx, dy;   /**< of a drawn speck */
+} dust_desc;
+
+struct sliced_desc
+{
+	uint8_t *image;
+	int width;
+	int height;
+	int count;
+	dust_desc *dust;
+};
+
+static void overlay_image(uint8_t *src, int src_width, int src_height , uint8_t *overlay, int overlay_width, int overlay_height, uint8_t * alpha , int xpos, int ypos, int upsidedown , int mirror, int ystart, int yend )
 {
 	int x,y;
 
-	for ( y = ypos; y < src_height; y++)
+	for ( y = MAX( ypos, ystart ); y < yend; y++)
 	{
 		if ( y >= 0 && (y - ypos) < overlay_height )
 		{
@@ -62,6 +87,58 @@ static void overlay_image(uint8_t *src, int src_width, int src_height , uint8_t
 	}
 }
 
+static void draw_speck( uint8_t *image, int w, int h, dust_desc *dust, int ystart, int yend )
+{
+	int x1 = dust->x1, y1 = dust->y1, dx = dust->dx, dy = dust->dy;
+	int x=0, y=0;
+	double v = 0.0;
+	for ( x = -dx ; x < dx ; x++ )
+	{
+		for ( y = MAX( -dy, ystart - y1 ) ; y < dy && y1 + y < yend ; y++ )
+		{
+			if ( x1 + x < w && x1 + x > 0 && y1 + y < h && y1 + y > 0 ){
+				uint8_t *pix = image + (y+y1) * w * 2 + (x + x1) * 2;
+
+				v=pow((double) x /(double)dx * 5.0, 2.0) + pow((double)y / (double)dy * 5.0, 2.0);
+				if (v>10)
+					v=10;
+				v = 1.0 - ( v / 10.0 );
+
+				switch(dust->type)
+				{
+					case 0:
+						*pix -= (*pix) * v;
+						break;
+					case 1:
+						*pix += ( 255-*pix ) * v;
+						break;
+				}
+			}
+		}
+	}
+}
+
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* desc = (struct sliced_desc*) cookie;
+	int start = desc->height * index / jobs;
+	int end = desc->height * ( index + 1 ) / jobs;
+	int i;
+
+	// Apply the dust in the same order as a single pass, clipped to the slice
+	for ( i = 0; i < desc->count; i++ )
+	{
+		dust_desc *dust = &desc->dust[i];
+		if ( dust->overlay )
+			overlay_image( desc->image, desc->width, desc->height, dust->overlay, dust->overlay_width, dust->overlay_height,
+				dust->alpha, dust->x1, dust->y1, dust->upsidedown, dust->mirror, start, end );
+		else
+			draw_speck( desc->image, desc->width, desc->height, dust, start, end );
+	}
+	return 0;
+}
+
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
 	mlt_filter filter = (mlt_filter) mlt_frame_pop_service( frame );
@@ -75,6 +152,9 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	*format = mlt_image_yuv422;
 	int error = mlt_frame_get_image( frame, image, format, width, height, 1 );
 
+	if (!maxcount)
+		return 0;
+
 	// Load svg
 	char *factory = mlt_properties_get( properties, "factory" );
 	char temp[1204] = "";
@@ -82,31 +162,36 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	
 	mlt_properties direntries = mlt_properties_new();
 	mlt_properties_dir_list( direntries, temp,"dust*.svg",1 );
-	
-	if (!maxcount)
-		return 0;
 
 	double position = mlt_filter_get_progress( filter, frame );
-	srand( position * 10000 );
+	rng_state rng;
+	rng_init( &rng, position * 10000 );
+
+	struct sliced_desc desc;
+	desc.image = *image;
+	desc.width = *width;
+	desc.height = *height;
+	desc.count = 0;
+	desc.dust = calloc( abs( maxcount ), sizeof( dust_desc ) );
 
 	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
 
-	int im = rand() % maxcount;
+	int im = rng_range( &rng, maxcount );
 	int piccount = mlt_properties_count( direntries );
-	while ( im-- && piccount )
+	while ( im-- && piccount && desc.dust )
 	{
-		int picnum = rand() % piccount;
+		int picnum = rng_range( &rng, piccount );
 		
-		int y1 = rand() % *height;
-		int x1 = rand() % *width;
+		int y1 = rng_range( &rng, *height );
+		int x1 = rng_range( &rng, *width );
 		char resource[1024] = "";
 		char savename[1024] = "", savename1[1024] = "", cachedy[100];
 		int dx = ( *width * maxdia / 100);
 		int luma_width, luma_height;
 		uint8_t *luma_image = NULL;
 		uint8_t *alpha = NULL;
-		int updown = rand() % 2;
-		int mirror = rand() % 2;
+		int updown = rng_range( &rng, 2 );
+		int mirror = rng_range( &rng, 2 );
 		
 		sprintf( resource, "%s", mlt_properties_get_value(direntries,picnum) );
 		sprintf( savename, "cache-%d-%d", picnum,dx );
@@ -115,9 +200,12 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		
 		luma_image = mlt_properties_get_data( properties , savename , NULL );
 		alpha = mlt_properties_get_data( properties , savename1 , NULL );
+		luma_width = dx;
+		luma_height = mlt_properties_get_int ( properties, cachedy );
 		
 		if ( luma_image == NULL || alpha == NULL )
 		{
+			luma_image = NULL;
 			mlt_profile profile = mlt_service_profile( MLT_FILTER_SERVICE( filter ) );
 			mlt_producer producer = mlt_factory_producer( profile, factory, resource );
 		
@@ -131,12 +219,13 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 				if ( mlt_service_get_frame( MLT_PRODUCER_SERVICE( producer ), &luma_frame, 0 ) == 0 )
 				{
 					mlt_image_format luma_format = mlt_image_yuv422;
+					uint8_t *frame_image = NULL;
 					luma_width = dx;
 					luma_height = luma_width * mlt_properties_get_int( MLT_FRAME_PROPERTIES ( luma_frame ) , "height" ) / mlt_properties_get_int( MLT_FRAME_PROPERTIES ( luma_frame ) , "width" );
 
 					mlt_properties_set( MLT_FRAME_PROPERTIES( luma_frame ), "rescale.interp", "best" );// none/nearest/tiles/hyper
 					
-					mlt_frame_get_image( luma_frame, &luma_image, &luma_format, &luma_width, &luma_height, 0 );
+					mlt_frame_get_image( luma_frame, &frame_image, &luma_format, &luma_width, &luma_height, 0 );
 					alpha = mlt_frame_get_alpha( luma_frame );
 					if ( !alpha )
 					{
@@ -152,13 +241,14 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 					if ( savealpha && savepic )
 					{
 						memcpy( savealpha, alpha , luma_width * luma_height );
-						memcpy( savepic, luma_image , luma_width * luma_height * 2 );
+						memcpy( savepic, frame_image , luma_width * luma_height * 2 );
 						
 						mlt_properties_set_data( properties, savename, savepic, luma_width * luma_height * 2, mlt_pool_release, NULL );
 						mlt_properties_set_data( properties, savename1, savealpha, luma_width * luma_height,  mlt_pool_release, NULL );
 						mlt_properties_set_int( properties, cachedy, luma_height );
 						
-						overlay_image( *image, *width, *height, luma_image, luma_width, luma_height, alpha, x1, y1, updown, mirror );
+						luma_image = savepic;
+						alpha = savealpha;
 					}
 					else
 					{
@@ -172,59 +262,56 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 				mlt_producer_close( producer );	
 			}
 		}
-		else 
+
+		if ( luma_image )
 		{
-			overlay_image ( *image, *width, *height, luma_image, dx, mlt_properties_get_int ( properties, cachedy ), alpha, x1, y1, updown, mirror );
+			dust_desc *dust = &desc.dust[desc.count++];
+			dust->overlay = luma_image;
+			dust->alpha = alpha;
+			dust->overlay_width = luma_width;
+			dust->overlay_height = luma_height;
+			dust->x1 = x1;
+			dust->y1 = y1;
+			dust->upsidedown = updown;
+			dust->mirror = mirror;
 		}
 	}
 
-	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+	mlt_properties_close( direntries );
 
-	if (piccount>0 )
-		return 0;
-	if ( error == 0 && *image )
+	if ( piccount == 0 && error == 0 && *image && desc.dust )
 	{
 
 		int h = *height;
 		int w = *width;
-		int im = rand() % maxcount;
+		int im = rng_range( &rng, maxcount );
 		
 		while ( im-- )
 		{
-			int type = im % 2;
-			int y1 = rand() % h;
-			int x1 = rand() % w;
-			int dx = rand() % maxdia;
-			int dy = rand() % maxdia;
-			int x=0, y=0;
-			double v = 0.0;
-			for ( x = -dx ; x < dx ; x++ )
-			{
-				for ( y = -dy ; y < dy ; y++ ) 
-				{
-					if ( x1 + x < w && x1 + x > 0 && y1 + y < h && y1 + y > 0 ){
-						uint8_t *pix = *image + (y+y1) * w * 2 + (x + x1) * 2;
-
-						v=pow((double) x /(double)dx * 5.0, 2.0) + pow((double)y / (double)dy * 5.0, 2.0);
-						if (v>10)
-							v=10;
-						v = 1.0 - ( v / 10.0 );
-
-						switch(type)
-						{
-							case 0:
-								*pix -= (*pix) * v;
-								break;
-							case 1:
-								*pix += ( 255-*pix ) * v;
-								break;
-						}
-					}
-				}
-			}
+			dust_desc *dust = &desc.dust[desc.count++];
+			dust->type = im % 2;
+			dust->y1 = rng_range( &rng, h );
+			dust->x1 = rng_range( &rng, w );
+			dust->dx = rng_range( &rng, maxdia );
+			dust->dy = rng_range( &rng, maxdia );
 		}
 	}
 
+	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+
+	// The cached overlays are never replaced, so they can be used without the lock
+	if ( error == 0 && *image && desc.count )
+	{
+		int threads = CLAMP( mlt_slices_count_normal(), 1, MAX( *height / MIN_SLICE_HEIGHT, 1 ) );
+		if ( threads == 1 )
+			sliced_proc( 0, 0, 1, &desc );
+		else
+			mlt_slices_run_normal( threads, sliced_proc, &desc );
+	}
+	free( desc.dust );
+
+	if ( piccount > 0 )
+		return 0;
 	return error;
 }
 
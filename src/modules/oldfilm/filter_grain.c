@@ -19,10 +19,103 @@
 
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
+#include <framework/mlt_slices.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 
+#include "rng.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2 1
+#endif
+
+#define MIN_SLICE_HEIGHT (16)
+
+struct sliced_desc
+{
+	uint8_t *image;
+	int width;
+	int height;
+	int noise;
+	uint32_t key;
+	int lut[256];   /**< the luma after contrast and brightness */
+};
+
+#if defined(USE_SSE2)
+static inline __m128i mullo_epi32( __m128i a, __m128i b )
+{
+	__m128i even = _mm_mul_epu32( a, b );
+	__m128i odd = _mm_mul_epu32( _mm_srli_epi64( a, 32 ), _mm_srli_epi64( b, 32 ) );
+	return _mm_unpacklo_epi32( _mm_shuffle_epi32( even, _MM_SHUFFLE( 0, 0, 2, 0 ) ),
+	                           _mm_shuffle_epi32( odd, _MM_SHUFFLE( 0, 0, 2, 0 ) ) );
+}
+
+/** Fill \param out with rng_at( key, counter + i ) and return the number of values done. */
+static int rng_fill_sse2( uint32_t *out, uint32_t key, uint32_t counter, int count )
+{
+	const uint32_t golden = 0x9e3779b9U;
+	__m128i x = _mm_setr_epi32( key + counter * golden, key + ( counter + 1 ) * golden,
+	                            key + ( counter + 2 ) * golden, key + ( counter + 3 ) * golden );
+	const __m128i step = _mm_set1_epi32( 4 * golden );
+	const __m128i m1 = _mm_set1_epi32( 0x7feb352d );
+	const __m128i m2 = _mm_set1_epi32( 0x846ca68b );
+	int i;
+	for ( i = 0; i + 4 <= count; i += 4 )
+	{
+		__m128i h = x;
+		h = _mm_xor_si128( h, _mm_srli_epi32( h, 16 ) );
+		h = mullo_epi32( h, m1 );
+		h = _mm_xor_si128( h, _mm_srli_epi32( h, 15 ) );
+		h = mullo_epi32( h, m2 );
+		h = _mm_xor_si128( h, _mm_srli_epi32( h, 16 ) );
+		_mm_storeu_si128( (__m128i*) ( out + i ), h );
+		x = _mm_add_epi32( x, step );
+	}
+	return i;
+}
+#endif
+
+static void rng_fill( uint32_t *out, uint32_t key, uint32_t counter, int count )
+{
+	int i = 0;
+#if defined(USE_SSE2)
+	i = rng_fill_sse2( out, key, counter, count );
+#endif
+	for ( ; i < count; i++ )
+		out[i] = rng_at( key, counter + i );
+}
+
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* desc = (struct sliced_desc*) cookie;
+	int w = desc->width;
+	int start = desc->height * index / jobs;
+	int end = desc->height * ( index + 1 ) / jobs;
+	uint32_t *random = desc->noise > 0 ? malloc( w * sizeof( uint32_t ) ) : NULL;
+	int x, y;
+
+	for ( y = start; y < end; y++ )
+	{
+		uint8_t* pixel = desc->image + y * w * 2;
+		if ( random )
+			rng_fill( random, desc->key, y * w, w );
+		for ( x = 0; x < w; x++, pixel += 2 )
+		{
+			if ( *pixel > 20 )
+			{
+				int pix = desc->lut[*pixel];
+				if ( random )
+					pix += desc->noise - (int) ( ( (uint64_t) random[x] * desc->noise ) >> 32 );
+				*pixel = MIN( pix, 255 );
+			}
+		}
+	}
+	free( random );
+	return 0;
+}
 
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
@@ -36,31 +129,29 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 
 	if ( error == 0 && *image )
 	{
-		int h = *height;
-		int w = *width;
+		struct sliced_desc desc;
+		int i;
 
 		double position = mlt_filter_get_progress( filter, frame );
-		srand(position*10000);
+		rng_state rng;
+		rng_init( &rng, position * 10000 );
 
-		int noise = mlt_properties_anim_get_int( properties, "noise", pos, len );
 		double contrast = mlt_properties_anim_get_double( properties, "contrast", pos, len ) / 100.0;
 		double brightness = 127.0 * (mlt_properties_anim_get_double( properties, "brightness", pos, len ) -100.0 ) / 100.0;
-		
-		int x = 0,y = 0,pix = 0;
-		for ( x = 0; x < w; x++ )
-		{
-			for( y = 0; y < h; y++ )
-			{
-				uint8_t* pixel = (*image + (y) * w * 2 + (x) * 2 );
-				if (*pixel > 20)
-				{
-					pix = MIN ( MAX ( ( (double)*pixel -127.0  ) * contrast + 127.0 + brightness , 0 ) , 255 ) ;
-					if ( noise > 0 ) pix -= ( rand() % noise - noise );
-
-					*pixel = MIN ( MAX ( pix , 0 ) , 255 );
-				}
-			}
-		}
+
+		desc.image = *image;
+		desc.width = *width;
+		desc.height = *height;
+		desc.noise = mlt_properties_anim_get_int( properties, "noise", pos, len );
+		desc.key = rng.key;
+		for ( i = 0; i < 256; i++ )
+			desc.lut[i] = MIN ( MAX ( ( (double)i -127.0  ) * contrast + 127.0 + brightness , 0 ) , 255 ) ;
+
+		int threads = CLAMP( mlt_slices_count_normal(), 1, MAX( *height / MIN_SLICE_HEIGHT, 1 ) );
+		if ( threads == 1 )
+			sliced_proc( 0, 0, 1, &desc );
+		else
+			mlt_slices_run_normal( threads, sliced_proc, &desc );
 	}
 
 	return error;
@@ -20,11 +20,80 @@
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_profile.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 
+#include "rng.h"
+
+#define MIN_SLICE_HEIGHT (16)
+
+typedef struct
+{
+	int type;
+	int x1, dx;
+	int ystart, yend;
+	double maxdarker, maxlighter;
+} line_desc;
+
+struct sliced_desc
+{
+	uint8_t *image;
+	int width;
+	int height;
+	int count;
+	line_desc *lines;
+};
+
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* desc = (struct sliced_desc*) cookie;
+	int w = desc->width;
+	int start = desc->height * index / jobs;
+	int end = desc->height * ( index + 1 ) / jobs;
+	int i;
+
+	// Draw the lines in the same order as a single pass, clipped to the slice
+	for ( i = 0; i < desc->count; i++ )
+	{
+		line_desc *line = &desc->lines[i];
+		int dx = line->dx;
+		int x1 = line->x1;
+		int ystart = MAX( line->ystart, start );
+		int yend = MIN( line->yend, end );
+		int x = 0, y = 0;
+
+		for ( x = -dx ; x < dx && dx != 0 ; x++ )
+		{
+			for( y = ystart; y < yend; y++ )
+			{
+				if ( x + x1 < w && x + x1 > 0)
+				{
+					uint8_t* pixel = (desc->image + (y) * w * 2 + ( x + x1) * 2);
+					double diff = 1.0 - (double) abs(x) / dx;
+					switch( line->type )
+					{
+						case 1: //blackline
+							*pixel -= ((double) * pixel * diff * line->maxdarker / 100.0);
+							break;
+						case 2: //whiteline
+							*pixel += ((255.0-(double)*pixel) * diff * line->maxlighter /100.0);
+							break;
+						case 3: //greenline
+							*(pixel+1) -= ((*(pixel+1)) * diff * line->maxlighter / 100.0);
+						break;
+					}
+						
+				}
+			}
+		}
+	}
+	return 0;
+}
+
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
 	mlt_filter filter = (mlt_filter) mlt_frame_pop_service( frame );
@@ -55,25 +124,36 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		
 		if ( line_width < 1 )
 			return 0;
+		num = MAX( num, 0 );
 
 		double position = mlt_filter_get_progress( filter, frame );
-		srand(position*10000);
+		rng_state rng;
+		rng_init( &rng, position * 10000 );
+
+		struct sliced_desc desc;
+		desc.image = *image;
+		desc.width = w;
+		desc.height = h;
+		desc.count = 0;
+		desc.lines = malloc( ( num + 1 ) * sizeof( line_desc ) );
+		if ( !desc.lines )
+			return 0;
 		
 		mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
 
 		while ( num-- )
 		{
-			int type = (rand() % 3 ) + 1;
-			int x1 = (double)w * rand() / RAND_MAX;
-			int dx = rand() % line_width;
-			int x = 0, y = 0;
-			int ystart = rand() % h;
-			int yend = rand() % h;
+			line_desc *line = &desc.lines[desc.count++];
+			int type = rng_range( &rng, 3 ) + 1;
+			int x1 = (double)w * rng_unit( &rng );
+			int dx = rng_range( &rng, line_width );
+			int ystart = rng_range( &rng, h );
+			int yend = rng_range( &rng, h );
 
 			sprintf( buf, "line%d", num);
 			sprintf( typebuf, "typeline%d", num);
-			maxlighter += rand() % 30 -15;
-			maxdarker += rand() % 30 -15;
+			maxlighter += rng_range( &rng, 30 ) -15;
+			maxdarker += rng_range( &rng, 30 ) -15;
 
 			if ( mlt_properties_get_int(MLT_FILTER_PROPERTIES( filter ),buf ) ==0 )
 			{
@@ -90,7 +170,7 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 			type = mlt_properties_get_int(MLT_FILTER_PROPERTIES( filter ), typebuf );
 			if ( position != mlt_properties_get_double(MLT_FILTER_PROPERTIES( filter ), "last_oldfilm_line_pos"))
 			{
-				x1 += (rand() % 11 - 5);
+				x1 += rng_range( &rng, 11 ) - 5;
 			}
 
 			if ( yend < ystart)
@@ -98,34 +178,24 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 				yend=h;
 			}
 
-			for ( x = -dx ; x < dx && dx != 0 ; x++ )
-			{
-				for( y = ystart; y < yend; y++ )
-				{
-					if ( x + x1 < w && x + x1 > 0)
-					{
-						uint8_t* pixel = (*image + (y) * w * 2 + ( x + x1) * 2);
-						double diff = 1.0 - (double) abs(x) / dx;
-						switch( type )
-						{
-							case 1: //blackline
-								*pixel -= ((double) * pixel * diff * maxdarker / 100.0);
-								break;
-							case 2: //whiteline
-								*pixel += ((255.0-(double)*pixel) * diff * maxlighter /100.0);
-								break;
-							case 3: //greenline
-								*(pixel+1) -= ((*(pixel+1)) * diff * maxlighter / 100.0);
-							break;
-						}
-							
-					}
-				}
-			}
+			line->type = type;
+			line->x1 = x1;
+			line->dx = dx;
+			line->ystart = ystart;
+			line->yend = yend;
+			line->maxdarker = maxdarker;
+			line->maxlighter = maxlighter;
 			mlt_properties_set_int(MLT_FILTER_PROPERTIES( filter ),buf , x1);
 		}
 		mlt_properties_set_double(MLT_FILTER_PROPERTIES( filter ),"last_oldfilm_line_pos", position);
 		mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+
+		int threads = CLAMP( mlt_slices_count_normal(), 1, MAX( h / MIN_SLICE_HEIGHT, 1 ) );
+		if ( threads == 1 )
+			sliced_proc( 0, 0, 1, &desc );
+		else
+			mlt_slices_run_normal( threads, sliced_proc, &desc );
+		free( desc.lines );
 	}
 
 	return error;
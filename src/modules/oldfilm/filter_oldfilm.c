@@ -20,10 +20,16 @@
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_profile.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+
+#include "rng.h"
+
+#define MIN_SLICE_HEIGHT (16)
 
 static double sinarr[] = {
 0.0,0.0627587292804297,0.125270029508395,0.18728744713136,0.2485664757507,0.308865520098932,
@@ -45,6 +51,51 @@ static double sinarr[] = {
 -0.251650545336281,-0.190415435368805,-0.128429604166398,-0.0659374335968388,0.0,
 };
 
+struct sliced_desc
+{
+	uint8_t *image;
+	const uint8_t *source;  /**< an unchanged copy to read shifted rows from */
+	int width;
+	int height;
+	int first;              /**< the first row to process */
+	int diffpic;
+	int delta;              /**< the change of brightness */
+};
+
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* desc = (struct sliced_desc*) cookie;
+	int w = desc->width;
+	int h = desc->height;
+	int rows = h - desc->first;
+	int start = desc->first + rows * index / jobs;
+	int end = desc->first + rows * ( index + 1 ) / jobs;
+	int x, y;
+
+	for ( y = start; y < end; y++ )
+	{
+		uint8_t* pic = desc->image + y * w * 2;
+		int newy = y + desc->diffpic;
+		if ( newy > 0 && newy < h )
+		{
+			const uint8_t* src = desc->source + newy * w * 2;
+			for ( x = 0; x < w; x++, pic += 2, src += 2 )
+			{
+				int val = (int) src[0] + desc->delta;
+				pic[0] = CLAMP( val, 0, 255 );
+				pic[1] = src[1];
+			}
+		}
+		else
+		{
+			for ( x = 0; x < w; x++, pic += 2 )
+				*pic = 0;
+		}
+	}
+	return 0;
+}
+
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
 	mlt_filter filter = (mlt_filter) mlt_frame_pop_service( frame );
@@ -60,11 +111,9 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		int h = *height;
 		int w = *width;
 
-		int x = 0;
-		int y = 0;
-
 		double position = mlt_filter_get_progress( filter, frame );
-		srand( position * 10000);
+		rng_state rng;
+		rng_init( &rng, position * 10000 );
 
 		int delta = mlt_properties_anim_get_int( properties, "delta", pos, len );
 		int every = mlt_properties_anim_get_int( properties, "every", pos, len );
@@ -81,66 +130,47 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		if ( delta ) {
 			mlt_profile profile = mlt_service_profile(MLT_FILTER_SERVICE(filter));
 			delta *= mlt_profile_scale_width(profile, *width);
-			diffpic = rand() % delta * 2 - delta;
+			diffpic = rng_range( &rng, delta ) * 2 - delta;
 		}
 		int brightdelta = 0;
 		if (( bdu + bdd ) != 0 )
-			brightdelta = rand() % (bdu + bdd) - bdd;
-		if ( rand() % 100 > every )
+			brightdelta = rng_range( &rng, bdu + bdd ) - bdd;
+		if ( rng_range( &rng, 100 ) > every )
 			diffpic = 0;
-		if ( rand() % 100 > bevery)
+		if ( rng_range( &rng, 100 ) > bevery)
 			brightdelta = 0;
-		int yend, ydiff;
 		int unevendevelop_delta = 0;
 		if ( uduration > 0 )
 		{
 			float uval = sinarr[ ( ((int)position) % uduration) * 100 / uduration ];
 			unevendevelop_delta = uval * ( uval > 0 ? udu : udd );
 		}
-		if ( diffpic <= 0 )
-		{
-			y = h;
-			yend = 0;
-			ydiff = -1;
-		}
-		else
-		{
-			y = 0;
-			yend = h;
-			ydiff = 1;
-		}
 
-		while( y != yend )
+		struct sliced_desc desc;
+		desc.image = *image;
+		desc.source = *image;
+		desc.width = w;
+		desc.height = h;
+		// Shifting up leaves the top row as it is
+		desc.first = diffpic <= 0 ? 1 : 0;
+		desc.diffpic = diffpic;
+		desc.delta = brightdelta + unevendevelop_delta;
+
+		uint8_t *copy = NULL;
+		if ( diffpic != 0 )
 		{
-			for ( x = 0; x < w; x++ )
-			{
-				uint8_t* pic = ( *image + y * w * 2 + x * 2 );
-				int newy = y + diffpic;
-				if ( newy > 0 && newy < h )
-				{
-					uint8_t oldval= *( pic + diffpic * w * 2 );
-					if ( ((int) oldval + brightdelta + unevendevelop_delta ) > 255 )
-					{
-						*pic=255;
-					}
-					else if ( ( (int) oldval + brightdelta + unevendevelop_delta )	<0 )
-					{
-						*pic=0;
-					}
-					else
-					{
-						*pic = oldval + brightdelta + unevendevelop_delta;
-					}
-					*( pic + 1 ) =* ( pic + diffpic * w * 2 + 1 );
-
-				}
-				else
-				{
-					*pic = 0;
-				}
-		}
-			y += ydiff;
+			int size = w * h * 2;
+			copy = mlt_pool_alloc( size );
+			memcpy( copy, *image, size );
+			desc.source = copy;
 		}
+
+		int threads = CLAMP( mlt_slices_count_normal(), 1, MAX( h / MIN_SLICE_HEIGHT, 1 ) );
+		if ( threads == 1 )
+			sliced_proc( 0, 0, 1, &desc );
+		else
+			mlt_slices_run_normal( threads, sliced_proc, &desc );
+		mlt_pool_release( copy );
 	}
 
 	return error;
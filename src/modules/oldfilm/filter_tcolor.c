@@ -32,32 +32,21 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	mlt_position pos = mlt_filter_get_position( filter, frame );
 	mlt_position len = mlt_filter_get_length2( filter, frame );
 
-	*format = mlt_image_yuv422;
-	int error = mlt_frame_get_image( frame, image, format, width, height, 1 );
-
-	if ( error == 0 && *image )
-	{
-		double over_cr = mlt_properties_anim_get_double( properties, "oversaturate_cr", pos, len )/100.0;
-		double over_cb = mlt_properties_anim_get_double( properties, "oversaturate_cb", pos, len )/100.0;
+	double over_cr = mlt_properties_anim_get_double( properties, "oversaturate_cr", pos, len )/100.0;
+	double over_cb = mlt_properties_anim_get_double( properties, "oversaturate_cb", pos, len )/100.0;
 
-		int video_width = *width;
-		int video_height = *height;
+	uint8_t cb[256], cr[256];
+	const uint8_t *luts[MLT_IMAGE_MAX_PLANES] = { NULL, cb, cr, NULL };
+	int i;
 
-		int x,y;
-		
-		for ( y = 0; y < video_height; y++)
-		{
-			for ( x = 0; x < video_width; x += 2)
-			{
-				uint8_t *pix = (*image + y * video_width * 2 + x * 2 + 1);
-				uint8_t *pix1 = (*image + y * video_width * 2 + x * 2 + 3);
-				*pix = MIN(MAX( ((double) * pix - 127.0) * over_cb + 127.0,0), 255);
-				*pix1 = MIN(MAX( ((double) * pix1 - 127.0) * over_cr + 127.0,0), 255);
-			}
-		}
+	for ( i = 0; i < 256; i++ )
+	{
+		cb[i] = MIN(MAX( ((double) i - 127.0) * over_cb + 127.0,0), 255);
+		cr[i] = MIN(MAX( ((double) i - 127.0) * over_cr + 127.0,0), 255);
 	}
 
-	return error;
+	*format = mlt_image_yuv422;
+	return mlt_frame_get_image_lut( frame, image, format, width, height, luts );
 }
 
 static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
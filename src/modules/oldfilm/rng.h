@@ -0,0 +1,86 @@
+/*
+ * rng.h -- counter-based random numbers for the oldfilm filters
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef OLDFILM_RNG_H
+#define OLDFILM_RNG_H
+
+#include <stdint.h>
+
+/** A stream of random numbers.
+ *
+ * Number n of the stream with a key is a hash of both, so any part of the
+ * stream can be generated on its own, in any order and on any thread, and a
+ * frame gets the same numbers however it is processed. Unlike rand(), there
+ * is no state shared between filters or threads.
+ */
+
+typedef struct
+{
+	uint32_t key;
+	uint32_t counter;
+} rng_state;
+
+/** Mix the bits of \p x (the "lowbias32" integer hash). */
+
+static inline uint32_t rng_hash( uint32_t x )
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+/** Get number \p counter of the stream with \p key. */
+
+static inline uint32_t rng_at( uint32_t key, uint32_t counter )
+{
+	return rng_hash( key + counter * 0x9e3779b9U );
+}
+
+static inline void rng_init( rng_state *self, uint32_t seed )
+{
+	self->key = rng_hash( seed ^ 0x6d2b79f5U );
+	self->counter = 0;
+}
+
+/** Get the next number of the stream, from 0 to UINT32_MAX. */
+
+static inline uint32_t rng_next( rng_state *self )
+{
+	return rng_at( self->key, self->counter++ );
+}
+
+/** Get the next number of the stream scaled to 0 to \p n - 1, or 0 if \p n is not positive. */
+
+static inline int rng_range( rng_state *self, int n )
+{
+	uint32_t r = rng_next( self );
+	return n > 0 ? (int) ( ( (uint64_t) r * (uint32_t) n ) >> 32 ) : 0;
+}
+
+/** Get the next number of the stream scaled to 0.0 to 1.0. */
+
+static inline double rng_unit( rng_state *self )
+{
+	return rng_next( self ) / 4294967295.0;
+}
+
+#endif
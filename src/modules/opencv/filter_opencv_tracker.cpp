@@ -19,17 +19,37 @@
 
 #include <framework/mlt.h>
 #include <opencv2/tracking.hpp>
+#include <opencv2/imgproc.hpp>
 #include <opencv2/core/version.hpp>
+#include <pthread.h>
 
 #define CV_VERSION_INT (CV_VERSION_MAJOR << 16 | CV_VERSION_MINOR << 8 | CV_VERSION_REVISION)
 
+// The most frames that wait for the background tracking
+#define MAX_QUEUED_FRAMES 25
+
+/** A frame waiting for the background tracking.
+*/
+
+typedef struct
+{
+	cv::Mat image;
+	double scale;
+	int width;
+	int height;
+	int position;
+	int length;
+} tracker_job;
+
 typedef struct
 {
 	cv::Ptr<cv::Tracker> tracker;
 #if CV_VERSION_INT < 0x040500
 	cv::Rect2d boundingBox;
+	cv::Rect2d trackingBox;
 #else
 	cv::Rect boundingBox;
+	cv::Rect trackingBox;
 #endif
 	char * algo;
 	mlt_rect startRect;
@@ -41,6 +61,13 @@ typedef struct
 	int analyse_height;
 	mlt_position producer_in;
 	mlt_position producer_length;
+	// Background tracking
+	mlt_deque jobs;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool thread_running;
+	bool stop;
 } private_data;
 
 
@@ -118,7 +145,12 @@ static void apply( mlt_filter filter, private_data* data, int width, int height,
 }
 
 
-static void analyze( mlt_filter filter, cv::Mat cvFrame, private_data* data, int width, int height, int position, int length )
+/** Track the object in a frame and store the results.
+ *
+ * \param cvFrame the frame, scaled by \p scale from \p width and \p height
+ */
+
+static void analyze( mlt_filter filter, cv::Mat cvFrame, double scale, private_data* data, int width, int height, int position, int length )
 {
 	mlt_properties filter_properties = MLT_FILTER_PROPERTIES( filter );
 
@@ -233,11 +265,15 @@ static void analyze( mlt_filter filter, cv::Mat cvFrame, private_data* data, int
 			if ( data->boundingBox.height <1 ) {
 				data->boundingBox.height = 50;
 			}
+			data->trackingBox.x = data->boundingBox.x * scale;
+			data->trackingBox.y = data->boundingBox.y * scale;
+			data->trackingBox.width = MAX( data->boundingBox.width * scale, 1 );
+			data->trackingBox.height = MAX( data->boundingBox.height * scale, 1 );
 #if CV_VERSION_INT >= 0x030402 && CV_VERSION_INT < 0x040500
-			if ( data->tracker->init( cvFrame, data->boundingBox ) ) {
+			if ( data->tracker->init( cvFrame, data->trackingBox ) ) {
 #else
 			{
-				data->tracker->init( cvFrame, data->boundingBox );
+				data->tracker->init( cvFrame, data->trackingBox );
 #endif
 				data->initialized = true;
 				data->analyze = true;
@@ -253,7 +289,13 @@ static void analyze( mlt_filter filter, cv::Mat cvFrame, private_data* data, int
 	}
 	else
 	{
-		data->tracker->update( cvFrame, data->boundingBox );
+		data->tracker->update( cvFrame, data->trackingBox );
+
+		// Map the rect back to the frame
+		data->boundingBox.x = data->trackingBox.x / scale;
+		data->boundingBox.y = data->trackingBox.y / scale;
+		data->boundingBox.width = data->trackingBox.width / scale;
+		data->boundingBox.height = data->trackingBox.height / scale;
 	}
 	if( data->analyze && position != data->last_position + 1 )
 	{
@@ -296,6 +338,88 @@ static void analyze( mlt_filter filter, cv::Mat cvFrame, private_data* data, int
 }
 
 
+/** Get the image to track in, downscaled to tracking_width and grey when it is set.
+*/
+
+static cv::Mat tracking_image( mlt_filter filter, cv::Mat cvFrame, double* scale )
+{
+	int tracking_width = mlt_properties_get_int( MLT_FILTER_PROPERTIES( filter ), "tracking_width" );
+
+	*scale = 1.0;
+	if ( tracking_width <= 0 || cvFrame.empty() )
+		return cvFrame;
+
+	cv::Mat scaled, grey;
+	if ( tracking_width < cvFrame.cols )
+	{
+		*scale = (double) tracking_width / cvFrame.cols;
+		cv::resize( cvFrame, scaled, cv::Size( tracking_width, MAX( 1, cvRound( cvFrame.rows * *scale ) ) ), 0, 0, cv::INTER_AREA );
+	}
+	else
+	{
+		scaled = cvFrame;
+	}
+	cv::cvtColor( scaled, grey, cv::COLOR_RGB2GRAY );
+	return grey;
+}
+
+static void* tracker_thread( void* arg )
+{
+	mlt_filter filter = (mlt_filter) arg;
+	private_data* data = (private_data*) filter->child;
+
+	pthread_mutex_lock( &data->mutex );
+	while ( !data->stop )
+	{
+		tracker_job* job = (tracker_job*) mlt_deque_pop_front( data->jobs );
+		if ( !job )
+		{
+			pthread_cond_wait( &data->cond, &data->mutex );
+			continue;
+		}
+		pthread_cond_broadcast( &data->cond );
+		pthread_mutex_unlock( &data->mutex );
+
+		mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
+		if ( !data->playback )
+			analyze( filter, job->image, job->scale, data, job->width, job->height, job->position, job->length );
+		mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+		delete job;
+
+		pthread_mutex_lock( &data->mutex );
+	}
+	pthread_mutex_unlock( &data->mutex );
+	return NULL;
+}
+
+/** Hand a frame to the background tracking, waiting while too many frames are queued.
+ *
+ * This must be called without the service lock because the tracking takes it.
+ */
+
+static void queue_job( mlt_filter filter, tracker_job* job )
+{
+	private_data* data = (private_data*) filter->child;
+
+	pthread_mutex_lock( &data->mutex );
+	if ( !data->thread_running )
+	{
+		data->stop = false;
+		data->thread_running = pthread_create( &data->thread, NULL, tracker_thread, filter ) == 0;
+	}
+	while ( data->thread_running && mlt_deque_count( data->jobs ) >= MAX_QUEUED_FRAMES )
+		pthread_cond_wait( &data->cond, &data->mutex );
+	if ( data->thread_running )
+	{
+		mlt_deque_push_back( data->jobs, job );
+		job = NULL;
+		pthread_cond_broadcast( &data->cond );
+	}
+	pthread_mutex_unlock( &data->mutex );
+	delete job;
+}
+
+
 /** Get the image.
 */
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
@@ -304,13 +428,14 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	mlt_filter filter = (mlt_filter) mlt_frame_pop_service( frame );
 	mlt_properties filter_properties = MLT_FILTER_PROPERTIES( filter );
 	mlt_position position = mlt_filter_get_position( filter, frame );
-	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
 	int shape_width = mlt_properties_get_int( filter_properties, "shape_width" );
 	int blur = mlt_properties_get_int( filter_properties, "blur" );
 	cv::Mat cvFrame;
+	tracker_job* job = NULL;
 
+	// Get the image without the lock so that it can overlap the background tracking
 	private_data* data = (private_data*) filter->child;
-	if ( shape_width == 0 && blur == 0 && !data->playback ) {
+	if ( shape_width == 0 && blur == 0 && data->playback ) {
 		error = mlt_frame_get_image( frame, image, format, width, height, 1 );
 	}
 	else
@@ -319,6 +444,7 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		error = mlt_frame_get_image( frame, image, format, width, height, 1 );
 		cvFrame = cv::Mat( *height, *width, CV_8UC3, *image );
 	}
+	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
 	if ( data->producer_length == 0 )
 	{
 		mlt_producer producer = mlt_frame_get_original_producer( frame );
@@ -343,9 +469,25 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		// Clip already analysed, don't re-process
 		apply( filter, data, *width, *height, position, data->producer_in + data->producer_length );
 	}
-	else
+	else if ( !cvFrame.empty() )
 	{
-		analyze( filter, cvFrame, data, *width, *height, position, data->producer_in + data->producer_length );
+		double scale;
+		cv::Mat trackingFrame = tracking_image( filter, cvFrame, &scale );
+		if ( mlt_properties_get_int( filter_properties, "background" ) )
+		{
+			// The shape shows the last tracked rect while the tracking catches up
+			job = new tracker_job;
+			job->image = trackingFrame.data == cvFrame.data ? trackingFrame.clone() : trackingFrame;
+			job->scale = scale;
+			job->width = *width;
+			job->height = *height;
+			job->position = position;
+			job->length = data->producer_in + data->producer_length;
+		}
+		else
+		{
+			analyze( filter, trackingFrame, scale, data, *width, *height, position, data->producer_in + data->producer_length );
+		}
 	}
 	// ensure bounding box is within the frame boundaries or OpenCV will crash
 	if ( data->boundingBox.x > *width )
@@ -422,6 +564,8 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	}
 
 	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+	if ( job )
+		queue_job( filter, job );
 	return error;
 }
 
@@ -438,6 +582,19 @@ static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
 static void filter_close( mlt_filter filter )
 {
 	private_data* data = (private_data*) filter->child;
+	if ( data->thread_running )
+	{
+		pthread_mutex_lock( &data->mutex );
+		data->stop = true;
+		pthread_cond_broadcast( &data->cond );
+		pthread_mutex_unlock( &data->mutex );
+		pthread_join( data->thread, NULL );
+	}
+	while ( mlt_deque_count( data->jobs ) )
+		delete (tracker_job*) mlt_deque_pop_front( data->jobs );
+	mlt_deque_close( data->jobs );
+	pthread_mutex_destroy( &data->mutex );
+	pthread_cond_destroy( &data->cond );
 	free ( data );
 	filter->child = NULL;
 	filter->close = NULL;
@@ -473,6 +630,11 @@ mlt_filter filter_tracker_init( mlt_profile profile, mlt_service_type type, cons
 		data->analyse_height = -1;
 		data->producer_in = 0;
 		data->producer_length = 0;
+		data->jobs = mlt_deque_init();
+		pthread_mutex_init( &data->mutex, NULL );
+		pthread_cond_init( &data->cond, NULL );
+		data->thread_running = false;
+		data->stop = false;
 		filter->child = data;
 
 		// Create a unique ID for storing data on the frame
@@ -0,0 +1,419 @@
+/*
+ * affine_gl.c -- OpenGL ES compositing for transition_affine
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "affine_gl.h"
+
+#include <framework/mlt_log.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** The offscreen context of a thread and what it keeps between frames */
+
+typedef struct
+{
+	EGLContext context;
+	EGLSurface surface;        // a 1x1 pbuffer unless surfaceless contexts are supported
+	GLuint program;
+	GLuint textures[3];        // the a image, the b image and the result
+	GLuint framebuffer;
+	int sizes[3][2];           // the sizes the textures are allocated at
+	GLint uniforms[8];
+	int failed;                // do not try again on this thread
+} gl_thread;
+
+enum
+{
+	u_origin,
+	u_step_x,
+	u_step_y,
+	u_limits,
+	u_mix,
+	u_b_alpha,
+	u_interp,
+	u_b_size
+};
+
+static const char *uniform_names[] = { "origin", "step_x", "step_y", "limits", "mix_level", "b_alpha", "interp", "b_size" };
+
+static pthread_once_t display_once = PTHREAD_ONCE_INIT;
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLConfig display_config = NULL;
+static int display_surfaceless = 0;
+static pthread_key_t thread_key;
+
+static const char *vertex_source =
+	"#version 300 es\n"
+	"void main()\n"
+	"{\n"
+	"	// One triangle that covers the viewport\n"
+	"	vec2 p = vec2( float( ( gl_VertexID & 1 ) << 2 ), float( ( gl_VertexID & 2 ) << 1 ) ) - 1.0;\n"
+	"	gl_Position = vec4( p, 0.0, 1.0 );\n"
+	"}\n";
+
+// The samplers and the mix follow interpNN_b32, interpBL_b32 and interpBC_b32
+// in interp.h, down to the truncation of the results to bytes.
+static const char *fragment_source =
+	"#version 300 es\n"
+	"precision highp float;\n"
+	"precision highp int;\n"
+	"uniform highp sampler2D a_image;\n"
+	"uniform highp sampler2D b_image;\n"
+	"uniform vec2 origin;\n"
+	"uniform vec2 step_x;\n"
+	"uniform vec2 step_y;\n"
+	"uniform vec4 limits;\n"
+	"uniform float mix_level;\n"
+	"uniform int b_alpha;\n"
+	"uniform int interp;\n"
+	"uniform ivec2 b_size;\n"
+	"out vec4 color;\n"
+	"\n"
+	"vec4 pixel( int x, int y )\n"
+	"{\n"
+	"	return floor( texelFetch( b_image, ivec2( x, y ), 0 ) * 255.0 + 0.5 );\n"
+	"}\n"
+	"\n"
+	"vec4 neville( vec4 p0, vec4 p1, vec4 p2, vec4 p3, float t, float n )\n"
+	"{\n"
+	"	p3 = p3 + ( t - 3.0 - n ) * ( p3 - p2 );\n"
+	"	p2 = p2 + ( t - 2.0 - n ) * ( p2 - p1 );\n"
+	"	p1 = p1 + ( t - 1.0 - n ) * ( p1 - p0 );\n"
+	"	p3 = p3 + ( t - 3.0 - n ) / 2.0 * ( p3 - p2 );\n"
+	"	p2 = p2 + ( t - 2.0 - n ) / 2.0 * ( p2 - p1 );\n"
+	"	return p3 + ( t - 3.0 - n ) / 3.0 * ( p3 - p2 );\n"
+	"}\n"
+	"\n"
+	"vec4 sample_b( float x, float y )\n"
+	"{\n"
+	"	if ( interp == 0 )\n"
+	"		return pixel( int( roundEven( x ) ), int( roundEven( y ) ) );\n"
+	"	if ( interp == 1 )\n"
+	"	{\n"
+	"		int m = min( int( floor( x ) ), b_size.x - 2 );\n"
+	"		int n = min( int( floor( y ) ), b_size.y - 2 );\n"
+	"		float fx = x - float( m );\n"
+	"		float fy = y - float( n );\n"
+	"		vec4 s00 = pixel( m, n ), s10 = pixel( m, n + 1 );\n"
+	"		vec4 a = s00 + ( pixel( m + 1, n ) - s00 ) * fx;\n"
+	"		vec4 b = s10 + ( pixel( m + 1, n + 1 ) - s10 ) * fx;\n"
+	"		return a + ( b - a ) * fy;\n"
+	"	}\n"
+	"	int m = int( ceil( x ) ) - 2;\n"
+	"	int n = int( ceil( y ) ) - 2;\n"
+	"	m = m < 0 ? 0 : m + 5 > b_size.x ? b_size.x - 4 : m;\n"
+	"	n = n < 0 ? 0 : n + 5 > b_size.y ? b_size.y - 4 : n;\n"
+	"	vec4 p[4];\n"
+	"	for ( int i = 0; i < 4; i++ )\n"
+	"		p[i] = neville( pixel( m + i, n ), pixel( m + i, n + 1 ), pixel( m + i, n + 2 ), pixel( m + i, n + 3 ), y, float( n ) );\n"
+	"	return clamp( neville( p[0], p[1], p[2], p[3], x, float( m ) ), 0.0, 255.0 );\n"
+	"}\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"	ivec2 ij = ivec2( gl_FragCoord.xy );\n"
+	"	vec4 v = floor( texelFetch( a_image, ij, 0 ) * 255.0 + 0.5 );\n"
+	"	vec2 d = origin + step_x * float( ij.x ) + step_y * float( ij.y );\n"
+	"	color = v / 255.0;\n"
+	"	if ( d.x < limits.x || d.x > limits.z || d.y < limits.y || d.y > limits.w )\n"
+	"		return;\n"
+	"	vec4 s = sample_b( d.x, d.y );\n"
+	"	float alpha_sl = s.a / 255.0 * mix_level;\n"
+	"	float alpha_v = v.a / 255.0;\n"
+	"	if ( b_alpha == 0 && alpha_sl == 0.0 && alpha_v != 0.0 )\n"
+	"		return;\n"
+	"	float alpha = alpha_sl + alpha_v - alpha_sl * alpha_v;\n"
+	"	float a = b_alpha != 0 ? s.a : 255.0 * alpha;\n"
+	"	vec3 rgb = vec3( 0.0 );\n"
+	"	if ( alpha > 0.0 )\n"
+	"	{\n"
+	"		alpha = alpha_sl / alpha;\n"
+	"		rgb = v.rgb * ( 1.0 - alpha ) + s.rgb * alpha;\n"
+	"	}\n"
+	"	color = clamp( floor( vec4( rgb, a ) ), 0.0, 255.0 ) / 255.0;\n"
+	"}\n";
+
+static void thread_close( gl_thread *self );
+
+/** Get the display, preferring those that need no window system. */
+
+static void display_init( void )
+{
+	const char *extensions = eglQueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS );
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = NULL;
+	EGLint major, minor;
+
+	if ( extensions && strstr( extensions, "EGL_EXT_platform_base" ) )
+		get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+	if ( get_platform_display && strstr( extensions, "EGL_MESA_platform_surfaceless" ) )
+		display = get_platform_display( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+	if ( display != EGL_NO_DISPLAY && !eglInitialize( display, &major, &minor ) )
+		display = EGL_NO_DISPLAY;
+	if ( display == EGL_NO_DISPLAY && get_platform_display && strstr( extensions, "EGL_EXT_platform_device" ) )
+	{
+		PFNEGLQUERYDEVICESEXTPROC query_devices = (PFNEGLQUERYDEVICESEXTPROC) eglGetProcAddress( "eglQueryDevicesEXT" );
+		EGLDeviceEXT device;
+		EGLint count = 0;
+		if ( query_devices && query_devices( 1, &device, &count ) && count > 0 )
+			display = get_platform_display( EGL_PLATFORM_DEVICE_EXT, device, NULL );
+		if ( display != EGL_NO_DISPLAY && !eglInitialize( display, &major, &minor ) )
+			display = EGL_NO_DISPLAY;
+	}
+	if ( display == EGL_NO_DISPLAY )
+	{
+		display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+		if ( display != EGL_NO_DISPLAY && !eglInitialize( display, &major, &minor ) )
+			display = EGL_NO_DISPLAY;
+	}
+	if ( display == EGL_NO_DISPLAY || !eglBindAPI( EGL_OPENGL_ES_API ) )
+	{
+		mlt_log_verbose( NULL, "[affine] no EGL display for GPU compositing\n" );
+		display = EGL_NO_DISPLAY;
+		return;
+	}
+
+	const EGLint attributes[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_NONE
+	};
+	EGLint count = 0;
+	extensions = eglQueryString( display, EGL_EXTENSIONS );
+	display_surfaceless = extensions && strstr( extensions, "EGL_KHR_surfaceless_context" );
+	if ( !eglChooseConfig( display, attributes, &display_config, 1, &count ) )
+		count = 0;
+
+	// A display without surfaces may still make contexts without a configuration
+	if ( count < 1 && display_surfaceless && strstr( extensions, "EGL_KHR_no_config_context" ) )
+	{
+		display_config = EGL_NO_CONFIG_KHR;
+		count = 1;
+	}
+	if ( count < 1 )
+	{
+		mlt_log_verbose( NULL, "[affine] no OpenGL ES 3 configuration for GPU compositing\n" );
+		eglTerminate( display );
+		display = EGL_NO_DISPLAY;
+		return;
+	}
+	pthread_key_create( &thread_key, (void (*)( void* )) thread_close );
+	mlt_log_verbose( NULL, "[affine] GPU compositing with EGL %d.%d %s\n", major, minor, eglQueryString( display, EGL_VENDOR ) );
+}
+
+static void thread_close( gl_thread *self )
+{
+	if ( self->context != EGL_NO_CONTEXT &&
+		 eglMakeCurrent( display, self->surface, self->surface, self->context ) )
+	{
+		glDeleteFramebuffers( 1, &self->framebuffer );
+		glDeleteTextures( 3, self->textures );
+		glDeleteProgram( self->program );
+		eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+	}
+	if ( self->context != EGL_NO_CONTEXT )
+		eglDestroyContext( display, self->context );
+	if ( self->surface != EGL_NO_SURFACE )
+		eglDestroySurface( display, self->surface );
+	eglReleaseThread();
+	free( self );
+}
+
+static GLuint shader_compile( GLenum type, const char *source )
+{
+	GLuint shader = glCreateShader( type );
+	GLint status = 0;
+
+	glShaderSource( shader, 1, &source, NULL );
+	glCompileShader( shader );
+	glGetShaderiv( shader, GL_COMPILE_STATUS, &status );
+	if ( !status )
+	{
+		char log[1024] = "";
+		glGetShaderInfoLog( shader, sizeof( log ), NULL, log );
+		mlt_log_warning( NULL, "[affine] GPU shader failed to compile: %s\n", log );
+		glDeleteShader( shader );
+		shader = 0;
+	}
+	return shader;
+}
+
+/** Make the context of the thread with the program and the objects it uses. */
+
+static int thread_init( gl_thread *self )
+{
+	const EGLint context_attributes[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+	const EGLint surface_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+	int i;
+
+	self->context = eglCreateContext( display, display_config, EGL_NO_CONTEXT, context_attributes );
+	if ( self->context == EGL_NO_CONTEXT )
+		return 1;
+	if ( !display_surfaceless )
+	{
+		self->surface = eglCreatePbufferSurface( display, display_config, surface_attributes );
+		if ( self->surface == EGL_NO_SURFACE )
+			return 1;
+	}
+	if ( !eglMakeCurrent( display, self->surface, self->surface, self->context ) )
+		return 1;
+
+	GLuint vertex = shader_compile( GL_VERTEX_SHADER, vertex_source );
+	GLuint fragment = shader_compile( GL_FRAGMENT_SHADER, fragment_source );
+	GLint status = 0;
+	if ( !vertex || !fragment )
+	{
+		glDeleteShader( vertex );
+		glDeleteShader( fragment );
+		return 1;
+	}
+	self->program = glCreateProgram();
+	glAttachShader( self->program, vertex );
+	glAttachShader( self->program, fragment );
+	glLinkProgram( self->program );
+	glDeleteShader( vertex );
+	glDeleteShader( fragment );
+	glGetProgramiv( self->program, GL_LINK_STATUS, &status );
+	if ( !status )
+		return 1;
+
+	glUseProgram( self->program );
+	glUniform1i( glGetUniformLocation( self->program, "a_image" ), 0 );
+	glUniform1i( glGetUniformLocation( self->program, "b_image" ), 1 );
+	for ( i = 0; i < (int) ( sizeof( uniform_names ) / sizeof( uniform_names[0] ) ); i++ )
+		self->uniforms[i] = glGetUniformLocation( self->program, uniform_names[i] );
+
+	glGenTextures( 3, self->textures );
+	for ( i = 0; i < 3; i++ )
+	{
+		glBindTexture( GL_TEXTURE_2D, self->textures[i] );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	}
+	glGenFramebuffers( 1, &self->framebuffer );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	glPixelStorei( GL_PACK_ALIGNMENT, 4 );
+	glDisable( GL_BLEND );
+	glDisable( GL_DITHER );
+	return glGetError() != GL_NO_ERROR;
+}
+
+/** Get the context of the calling thread, made current, or NULL if there is none. */
+
+static gl_thread *thread_get( void )
+{
+	pthread_once( &display_once, display_init );
+	if ( display == EGL_NO_DISPLAY )
+		return NULL;
+
+	gl_thread *self = pthread_getspecific( thread_key );
+	if ( !self )
+	{
+		self = calloc( 1, sizeof( *self ) );
+		if ( !self )
+			return NULL;
+		self->context = EGL_NO_CONTEXT;
+		self->surface = EGL_NO_SURFACE;
+		if ( thread_init( self ) )
+		{
+			mlt_log_warning( NULL, "[affine] GPU compositing is not available on this thread, using the CPU\n" );
+			thread_close( self );
+			self = calloc( 1, sizeof( *self ) );
+			if ( !self )
+				return NULL;
+			self->failed = 1;
+		}
+		pthread_setspecific( thread_key, self );
+	}
+	else if ( !self->failed && !eglMakeCurrent( display, self->surface, self->surface, self->context ) )
+	{
+		return NULL;
+	}
+	return self->failed ? NULL : self;
+}
+
+/** Upload an image to a texture, allocating it only when its size changes. */
+
+static void texture_upload( gl_thread *self, int index, int width, int height, const void *image )
+{
+	glBindTexture( GL_TEXTURE_2D, self->textures[index] );
+	if ( self->sizes[index][0] != width || self->sizes[index][1] != height )
+	{
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image );
+		self->sizes[index][0] = width;
+		self->sizes[index][1] = height;
+	}
+	else if ( image )
+	{
+		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image );
+	}
+}
+
+int affine_gl_composite( const affine_gl_job *job )
+{
+	// The samplers need this many pixels around the one they are at
+	int reach = job->interp == affine_gl_bicubic ? 4 : job->interp == affine_gl_bilinear ? 2 : 1;
+	if ( job->a_width < 1 || job->a_height < 1 || job->b_width < reach || job->b_height < reach || job->dz == 0.0 )
+		return 1;
+
+	gl_thread *self = thread_get();
+	if ( !self )
+		return 1;
+
+	GLint max_size = 0;
+	glGetIntegerv( GL_MAX_TEXTURE_SIZE, &max_size );
+	if ( job->a_width > max_size || job->a_height > max_size || job->b_width > max_size || job->b_height > max_size )
+		return 1;
+
+	// The coordinates in b of the first pixel of a and the steps along a row and a column
+	const double ( *m )[3] = job->matrix;
+	double x = job->lower_x, y = job->lower_y;
+	glUniform2f( self->uniforms[u_origin], ( m[0][0] * x + m[0][1] * y + m[0][2] ) / job->dz + job->x_offset,
+		( m[1][0] * x + m[1][1] * y + m[1][2] ) / job->dz + job->y_offset );
+	glUniform2f( self->uniforms[u_step_x], m[0][0] / job->dz, m[1][0] / job->dz );
+	glUniform2f( self->uniforms[u_step_y], m[0][1] / job->dz, m[1][1] / job->dz );
+	glUniform4f( self->uniforms[u_limits], job->xmin, job->ymin, job->xmax, job->ymax );
+	glUniform1f( self->uniforms[u_mix], job->mix );
+	glUniform1i( self->uniforms[u_b_alpha], job->b_alpha );
+	glUniform1i( self->uniforms[u_interp], job->interp );
+	glUniform2i( self->uniforms[u_b_size], job->b_width, job->b_height );
+
+	glActiveTexture( GL_TEXTURE1 );
+	texture_upload( self, 1, job->b_width, job->b_height, job->b_image );
+	glActiveTexture( GL_TEXTURE0 );
+	texture_upload( self, 2, job->a_width, job->a_height, NULL );
+	texture_upload( self, 0, job->a_width, job->a_height, job->a_image );
+
+	glBindFramebuffer( GL_FRAMEBUFFER, self->framebuffer );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, self->textures[2], 0 );
+	if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+		return 1;
+	glViewport( 0, 0, job->a_width, job->a_height );
+	glDrawArrays( GL_TRIANGLES, 0, 3 );
+	glReadPixels( 0, 0, job->a_width, job->a_height, GL_RGBA, GL_UNSIGNED_BYTE, job->a_image );
+	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+	return glGetError() != GL_NO_ERROR;
+}
@@ -0,0 +1,66 @@
+/*
+ * affine_gl.h -- OpenGL ES compositing for transition_affine
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef AFFINE_GL_H
+#define AFFINE_GL_H
+
+#include <stdint.h>
+
+/** The sampling of the b image, matching interpNN_b32, interpBL_b32 or interpBC_b32 */
+
+typedef enum
+{
+	affine_gl_nearest,
+	affine_gl_bilinear,
+	affine_gl_bicubic
+} affine_gl_interp;
+
+/** A transform of the b image mixed into the a image, as transition_affine does it on the CPU.
+ *
+ * Pixel (j, i) of a is at x = lower_x + j, y = lower_y + i. It is mixed with
+ * the b image at matrix * (x, y, 1) / dz + (x_offset, y_offset) when that is
+ * within [xmin, xmax] x [ymin, ymax].
+ */
+
+typedef struct
+{
+	uint8_t *a_image;          /**< the rgba image to mix into, which is replaced by the result */
+	const uint8_t *b_image;    /**< the rgba image to transform */
+	int a_width, a_height;
+	int b_width, b_height;
+	double matrix[3][3];
+	double dz;
+	double lower_x, lower_y;
+	double x_offset, y_offset;
+	double xmin, ymin, xmax, ymax;
+	double mix;                /**< the opacity of the b image */
+	int b_alpha;               /**< whether the alpha of b replaces that of a */
+	affine_gl_interp interp;
+} affine_gl_job;
+
+/** Do a transform on the GPU with an offscreen context of the calling thread.
+ *
+ * The context is made on first use and released when the thread exits.
+ * \return 0 when done, or non-zero if there is no usable GPU and the caller
+ * must do the transform itself
+ */
+
+extern int affine_gl_composite( const affine_gl_job *job );
+
+#endif
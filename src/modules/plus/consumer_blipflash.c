@@ -25,10 +25,12 @@
 
 // System header files
 #include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
 
 // Private constants
 #define SAMPLE_FREQ 48000
@@ -36,6 +38,15 @@
 #define BLIP_THRESHOLD 0.5
 
 // Private types
+typedef struct
+{
+	int count;
+	double sum;
+	double sum2;
+	double min;
+	double max;
+} series_stats;
+
 typedef struct
 {
 	int64_t flash_history[2];
@@ -49,6 +60,20 @@ typedef struct
 	int sample_offset;
 	FILE* out_file;
 	int report_frames;
+	// Wall clock measurements in microseconds
+	int64_t now;
+	int flash_in_progress;
+	int64_t last_flash_time;
+	int64_t reference_flash_time;
+	int64_t reference_blip_time;
+	double video_latency;
+	double audio_latency;
+	pthread_mutex_t reference_mutex;
+	mlt_consumer reference;
+	series_stats offset_stats;
+	series_stats video_stats;
+	series_stats audio_stats;
+	series_stats interval_stats;
 } avsync_stats;
 
 // Forward references.
@@ -57,6 +82,7 @@ static int consumer_stop( mlt_consumer consumer );
 static int consumer_is_stopped( mlt_consumer consumer );
 static void *consumer_thread( void *arg );
 static void consumer_close( mlt_consumer consumer );
+static void on_reference_show( mlt_properties owner, avsync_stats* stats, mlt_event_data event_data );
 
 /** Initialize the consumer.
 */
@@ -78,15 +104,12 @@ mlt_consumer consumer_blipflash_init( mlt_profile profile, mlt_service_type type
 		consumer->is_stopped = consumer_is_stopped;
 
 		stats = mlt_pool_alloc( sizeof( avsync_stats ) );
-		stats->flash_history_count = 0;
-		stats->blip_history_count = 0;
-		stats->blip_in_progress = 0;
-		stats->samples_since_blip = 0;
-		stats->blip = 0;
-		stats->flash = 0;
+		memset( stats, 0, sizeof( avsync_stats ) );
 		stats->sample_offset = INT_MAX;
-		stats->report_frames = 0;
+		stats->video_latency = NAN;
+		stats->audio_latency = NAN;
 		stats->out_file = stdout;
+		pthread_mutex_init( &stats->reference_mutex, NULL );
 		if ( arg != NULL )
 		{
 			FILE* out_file = mlt_fopen( arg, "w" );
@@ -96,6 +119,7 @@ mlt_consumer consumer_blipflash_init( mlt_profile profile, mlt_service_type type
 		mlt_properties_set_data( consumer_properties, "_stats", stats, 0, NULL, NULL );
 
 		mlt_properties_set( consumer_properties, "report", "blip" );
+		mlt_properties_set_int( consumer_properties, "summary", 0 );
 	}
 
 	// Return this
@@ -113,6 +137,17 @@ static int consumer_start( mlt_consumer consumer )
 	// Check that we're not already running
 	if ( !mlt_properties_get_int( properties, "_running" ) )
 	{
+		avsync_stats* stats = mlt_properties_get_data( properties, "_stats", NULL );
+		mlt_consumer reference = mlt_properties_get_data( properties, "reference", NULL );
+
+		// Time the flashes and blips as the reference consumer shows them
+		if ( reference && !stats->reference )
+		{
+			stats->reference = reference;
+			mlt_properties_inc_ref( MLT_CONSUMER_PROPERTIES( reference ) );
+			mlt_events_listen( MLT_CONSUMER_PROPERTIES( reference ), stats, "consumer-frame-show", ( mlt_listener ) on_reference_show );
+		}
+
 		// Allocate a thread
 		pthread_t *thread = calloc( 1, sizeof( pthread_t ) );
 
@@ -150,6 +185,15 @@ static int consumer_stop( mlt_consumer consumer )
 			pthread_join( *thread, NULL );
 	}
 
+	// Stop listening to the reference consumer
+	avsync_stats* stats = mlt_properties_get_data( properties, "_stats", NULL );
+	if ( stats->reference )
+	{
+		mlt_events_disconnect( MLT_CONSUMER_PROPERTIES( stats->reference ), stats );
+		mlt_consumer_close( stats->reference );
+		stats->reference = NULL;
+	}
+
 	return 0;
 }
 
@@ -163,6 +207,67 @@ static int consumer_is_stopped( mlt_consumer consumer )
 	return !mlt_properties_get_int( properties, "_running" );
 }
 
+/** Get the monotonic time in microseconds.
+*/
+
+static int64_t wall_clock( void )
+{
+	struct timespec now;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void add_sample( series_stats* series, double value )
+{
+	if( series->count == 0 || value < series->min )
+		series->min = value;
+	if( series->count == 0 || value > series->max )
+		series->max = value;
+	series->count++;
+	series->sum += value;
+	series->sum2 += value * value;
+}
+
+static void report_series( FILE* out_file, const char* name, series_stats* series )
+{
+	if( series->count > 0 )
+	{
+		double mean = series->sum / series->count;
+		double variance = series->sum2 / series->count - mean * mean;
+		fprintf( out_file, "# %s\tcount %d\tmean %02.02f\tmin %02.02f\tmax %02.02f\tstddev %02.02f\n",
+			name, series->count, mean, series->min, series->max, sqrt( variance > 0.0 ? variance : 0.0 ) );
+	}
+	else
+	{
+		fprintf( out_file, "# %s\tcount 0\n", name );
+	}
+}
+
+/** Record when the reference consumer shows a flash or a blip.
+*/
+
+static void on_reference_show( mlt_properties owner, avsync_stats* stats, mlt_event_data event_data )
+{
+	mlt_frame frame = mlt_event_data_to_frame( event_data );
+	if ( frame )
+	{
+		mlt_properties frame_properties = MLT_FRAME_PROPERTIES( frame );
+		int flash = mlt_properties_get_int( frame_properties, "blipflash.flash" );
+		int blip = mlt_properties_get_int( frame_properties, "blipflash.blip" );
+		if ( flash || blip )
+		{
+			int64_t now = wall_clock();
+			pthread_mutex_lock( &stats->reference_mutex );
+			if ( flash )
+				stats->reference_flash_time = now;
+			if ( blip )
+				stats->reference_blip_time = now;
+			pthread_mutex_unlock( &stats->reference_mutex );
+		}
+	}
+}
+
 static void detect_flash( mlt_frame frame, mlt_position pos, double fps, avsync_stats* stats )
 {
 	int width = 0;
@@ -184,7 +289,7 @@ static void detect_flash( mlt_frame frame, mlt_position pos, double fps, avsync_
 			for( j = 1; j < 3; j++ )
 			{
 				int y = ( height / 3 ) * j;
-				y_accumulator += image[ y * height * 2 + x * 2 ];
+				y_accumulator += image[ y * width * 2 + x * 2 ];
 			}
 		}
 		// If the average luma value is > 150, assume it is a flash.
@@ -199,7 +304,25 @@ static void detect_flash( mlt_frame frame, mlt_position pos, double fps, avsync_
 		{
 			stats->flash_history_count++;
 		}
+
+		// Only the first frame of a flash counts for the timing
+		if( !stats->flash_in_progress )
+		{
+			if( stats->last_flash_time )
+				add_sample( &stats->interval_stats, ( stats->now - stats->last_flash_time ) / 1000.0 );
+			stats->last_flash_time = stats->now;
+
+			pthread_mutex_lock( &stats->reference_mutex );
+			if( stats->reference_flash_time && stats->reference_flash_time <= stats->now )
+			{
+				stats->video_latency = ( stats->now - stats->reference_flash_time ) / 1000.0;
+				add_sample( &stats->video_stats, stats->video_latency );
+				stats->reference_flash_time = 0;
+			}
+			pthread_mutex_unlock( &stats->reference_mutex );
+		}
 	}
+	stats->flash_in_progress = stats->flash;
 }
 
 static void detect_blip( mlt_frame frame, mlt_position pos, double fps, avsync_stats* stats )
@@ -233,6 +356,17 @@ static void detect_blip( mlt_frame frame, mlt_position pos, double fps, avsync_s
 						stats->blip_history_count++;
 					}
 					stats->blip = 1;
+
+					// The frame is received after its last sample
+					int64_t blip_time = stats->now - (int64_t) ( samples - i ) * 1000000 / frequency;
+					pthread_mutex_lock( &stats->reference_mutex );
+					if( stats->reference_blip_time && stats->reference_blip_time <= blip_time )
+					{
+						stats->audio_latency = ( blip_time - stats->reference_blip_time ) / 1000.0;
+						add_sample( &stats->audio_stats, stats->audio_latency );
+						stats->reference_blip_time = 0;
+					}
+					pthread_mutex_unlock( &stats->reference_mutex );
 				}
 			}
 			else
@@ -317,20 +451,39 @@ static void calculate_sync( avsync_stats* stats )
 	}
 }
 
+static void report_latency( FILE* out_file, double latency )
+{
+	if( isnan( latency ) )
+		fprintf( out_file, "\t??" );
+	else
+		fprintf( out_file, "\t%02.02f", latency );
+}
+
 static void report_results( avsync_stats* stats, mlt_position pos )
 {
+	if( stats->blip && stats->sample_offset != INT_MAX )
+	{
+		add_sample( &stats->offset_stats, (double)stats->sample_offset * 1000.0 / (double)SAMPLE_FREQ );
+	}
 	if( stats->report_frames || stats->blip )
 	{
 		if( stats->sample_offset == INT_MAX )
 		{
-			fprintf( stats->out_file, MLT_POSITION_FMT "\t??\n", pos );
+			fprintf( stats->out_file, MLT_POSITION_FMT "\t??", pos );
 		}
 		else
 		{
 			// Convert to milliseconds.
 			double ms_offset = (double)stats->sample_offset * 1000.0 / (double)SAMPLE_FREQ;
-			fprintf( stats->out_file, MLT_POSITION_FMT "\t%02.02f\n", pos, ms_offset );
+			fprintf( stats->out_file, MLT_POSITION_FMT "\t%02.02f", pos, ms_offset );
+		}
+		// The latencies are only known when timed against a reference consumer
+		if( stats->reference )
+		{
+			report_latency( stats->out_file, stats->video_latency );
+			report_latency( stats->out_file, stats->audio_latency );
 		}
+		fprintf( stats->out_file, "\n" );
 	}
 	stats->blip = 0;
 	stats->flash = 0;
@@ -371,6 +524,8 @@ static void *consumer_thread( void *arg )
 			double fps = mlt_properties_get_double( properties, "fps" );
 			mlt_position pos = mlt_frame_get_position( frame );
 
+			stats->now = wall_clock();
+
 			 if( !strcmp( mlt_properties_get( properties, "report" ), "frame" ) )
 			 {
 				 stats->report_frames = 1;
@@ -409,6 +564,17 @@ static void consumer_close( mlt_consumer consumer )
 	// Stop the consumer
 	mlt_consumer_stop( consumer );
 
+	if( mlt_properties_get_int( consumer_properties, "summary" ) )
+	{
+		report_series( stats->out_file, "av_offset_ms", &stats->offset_stats );
+		report_series( stats->out_file, "flash_interval_ms", &stats->interval_stats );
+		if( mlt_properties_get_data( consumer_properties, "reference", NULL ) )
+		{
+			report_series( stats->out_file, "video_latency_ms", &stats->video_stats );
+			report_series( stats->out_file, "audio_latency_ms", &stats->audio_stats );
+		}
+	}
+
 	// Close the file
 	if( stats->out_file != stdout )
 	{
@@ -416,6 +582,7 @@ static void consumer_close( mlt_consumer consumer )
 	}
 
 	// Clean up memory
+	pthread_mutex_destroy( &stats->reference_mutex );
 	mlt_pool_release( stats );
 
 	// Close the parent
@@ -514,12 +514,72 @@ static void ebur128_check_true_peak(ebur128_state* st, size_t frames) {
 }
 
 #ifdef __SSE2_MATH__
-#include <xmmintrin.h>
+#include <emmintrin.h>
 #define TURN_ON_FTZ \
         unsigned int mxcsr = _mm_getcsr(); \
         _mm_setcsr(mxcsr | _MM_FLUSH_ZERO_ON);
 #define TURN_OFF_FTZ _mm_setcsr(mxcsr);
 #define FLUSH_MANUALLY
+
+/* Filters two channels with their own filter states ci and cj at once, one per
+ * SSE2 lane. Each lane does the same operations in the same order as the
+ * scalar loop in ebur128_filter_*, so the output is identical. */
+#define EBUR128_FILTER_PAIR(type)                                              \
+static void ebur128_filter_pair_##type(ebur128_state* st, const type* src,     \
+                                       size_t frames, double scaling_factor,   \
+                                       double* audio_data, size_t c,           \
+                                       int ci, int cj) {                       \
+  const size_t channels = st->channels;                                        \
+  const __m128d a1 = _mm_set1_pd(st->d->a[1]), a2 = _mm_set1_pd(st->d->a[2]);  \
+  const __m128d a3 = _mm_set1_pd(st->d->a[3]), a4 = _mm_set1_pd(st->d->a[4]);  \
+  const __m128d b0 = _mm_set1_pd(st->d->b[0]), b1 = _mm_set1_pd(st->d->b[1]);  \
+  const __m128d b2 = _mm_set1_pd(st->d->b[2]), b3 = _mm_set1_pd(st->d->b[3]);  \
+  const __m128d b4 = _mm_set1_pd(st->d->b[4]);                                 \
+  __m128d v0 = _mm_set_pd(st->d->v[cj][0], st->d->v[ci][0]);                  \
+  __m128d v1 = _mm_set_pd(st->d->v[cj][1], st->d->v[ci][1]);                  \
+  __m128d v2 = _mm_set_pd(st->d->v[cj][2], st->d->v[ci][2]);                  \
+  __m128d v3 = _mm_set_pd(st->d->v[cj][3], st->d->v[ci][3]);                  \
+  __m128d v4 = _mm_set_pd(st->d->v[cj][4], st->d->v[ci][4]);                  \
+  double lanes[2];                                                             \
+  size_t i;                                                                    \
+  for (i = 0; i < frames; ++i) {                                               \
+    __m128d x = _mm_set_pd((double) (src[i * channels + c + 1] / scaling_factor),\
+                           (double) (src[i * channels + c] / scaling_factor)); \
+    v0 = _mm_sub_pd(_mm_sub_pd(_mm_sub_pd(_mm_sub_pd(x,                        \
+                    _mm_mul_pd(a1, v1)), _mm_mul_pd(a2, v2)),                  \
+                    _mm_mul_pd(a3, v3)), _mm_mul_pd(a4, v4));                  \
+    _mm_storeu_pd(audio_data + i * channels + c,                               \
+                  _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_add_pd(                 \
+                  _mm_mul_pd(b0, v0), _mm_mul_pd(b1, v1)), _mm_mul_pd(b2, v2)),\
+                  _mm_mul_pd(b3, v3)), _mm_mul_pd(b4, v4)));                   \
+    v4 = v3;                                                                   \
+    v3 = v2;                                                                   \
+    v2 = v1;                                                                   \
+    v1 = v0;                                                                   \
+  }                                                                            \
+  _mm_storeu_pd(lanes, v0);                                                    \
+  st->d->v[ci][0] = lanes[0]; st->d->v[cj][0] = lanes[1];                      \
+  _mm_storeu_pd(lanes, v1);                                                    \
+  st->d->v[ci][1] = lanes[0]; st->d->v[cj][1] = lanes[1];                      \
+  _mm_storeu_pd(lanes, v2);                                                    \
+  st->d->v[ci][2] = lanes[0]; st->d->v[cj][2] = lanes[1];                      \
+  _mm_storeu_pd(lanes, v3);                                                    \
+  st->d->v[ci][3] = lanes[0]; st->d->v[cj][3] = lanes[1];                      \
+  _mm_storeu_pd(lanes, v4);                                                    \
+  st->d->v[ci][4] = lanes[0]; st->d->v[cj][4] = lanes[1];                      \
+}
+/* Takes channels c and c + 1 together when they have separate filter states. */
+#define FILTER_PAIR(type)                                                      \
+    if (c + 1 < st->channels) {                                                \
+      int cj = st->d->channel_map[c + 1] - 1;                                  \
+      if (cj == EBUR128_DUAL_MONO - 1) cj = 0;                                 \
+      if (cj >= 0 && cj != ci) {                                               \
+        ebur128_filter_pair_##type(st, src, frames, scaling_factor,            \
+                                   audio_data, c, ci, cj);                     \
+        ++c;                                                                   \
+        continue;                                                              \
+      }                                                                        \
+    }
 #else
 #warning "manual FTZ is being used, please enable SSE2 (-msse2 -mfpmath=sse)"
 #define TURN_ON_FTZ
@@ -529,6 +589,8 @@ static void ebur128_check_true_peak(ebur128_state* st, size_t frames) {
     st->d->v[ci][3] = fabs(st->d->v[ci][3]) < DBL_MIN ? 0.0 : st->d->v[ci][3]; \
     st->d->v[ci][2] = fabs(st->d->v[ci][2]) < DBL_MIN ? 0.0 : st->d->v[ci][2]; \
     st->d->v[ci][1] = fabs(st->d->v[ci][1]) < DBL_MIN ? 0.0 : st->d->v[ci][1];
+#define EBUR128_FILTER_PAIR(type)
+#define FILTER_PAIR(type)
 #endif
 
 #define EBUR128_FILTER(type, min_scale, max_scale)                             \
@@ -569,6 +631,7 @@ static void ebur128_filter_##type(ebur128_state* st, const type* src,          \
     int ci = st->d->channel_map[c] - 1;                                        \
     if (ci < 0) continue;                                                      \
     else if (ci == EBUR128_DUAL_MONO - 1) ci = 0; /*dual mono */               \
+    FILTER_PAIR(type)                                                          \
     for (i = 0; i < frames; ++i) {                                             \
       st->d->v[ci][0] = (double) (src[i * st->channels + c] / scaling_factor)  \
                    - st->d->a[1] * st->d->v[ci][1]                             \
@@ -590,6 +653,10 @@ static void ebur128_filter_##type(ebur128_state* st, const type* src,          \
   }                                                                            \
   TURN_OFF_FTZ                                                                 \
 }
+EBUR128_FILTER_PAIR(short)
+EBUR128_FILTER_PAIR(int)
+EBUR128_FILTER_PAIR(float)
+EBUR128_FILTER_PAIR(double)
 EBUR128_FILTER(short, SHRT_MIN, SHRT_MAX)
 EBUR128_FILTER(int, INT_MIN, INT_MAX)
 EBUR128_FILTER(float, -1.0f, 1.0f)
@@ -23,21 +23,125 @@
 #include <framework/mlt_factory.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_producer.h>
+#include <framework/mlt_slices.h>
 
 #include <stdlib.h>
 #include <string.h>
 
-static inline int in_range( uint8_t v, uint8_t c, int var )
+#define MIN_SLICE_HEIGHT (16)
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2 1
+#endif
+
+struct sliced_desc
+{
+	uint8_t *image;
+	uint8_t *alpha;
+	int pairs;          /**< the number of pixel pairs in the image */
+	int u, v;
+	int variance;
+	int hard;           /**< no soft edge and no spill suppression */
+	int spill;          /**< the spill suppression in 1/256 */
+	int keep[256];      /**< how much alpha to keep for a chroma distance, in 1/256 */
+	uint8_t *next;      /**< the original chroma of the pair after each slice */
+};
+
+/** Get the pixel pairs [start, end) of a slice. */
+
+static void slice_pairs( int pairs, int index, int jobs, int *start, int *end )
 {
-	return ( ( int )v >= c - var ) && ( ( int )v <= c + var );
+	*start = (int) ( (int64_t) pairs * index / jobs );
+	*end = (int) ( (int64_t) pairs * ( index + 1 ) / jobs );
 }
 
-static inline uint8_t alpha_value( uint8_t a, uint8_t *p, uint8_t u, uint8_t v, int var, int odd )
+static inline int distance( int u, int v, int key_u, int key_v )
+{
+	int du = abs( u - key_u );
+	int dv = abs( v - key_v );
+	return MIN( du > dv ? du : dv, 255 );
+}
+
+/** Key the pairs [start, end) one at a time.
+ *
+ * The second pixel of a pair is keyed on the average of its chroma and that of
+ * the next pair, whose original values are in next.
+ */
+
+static void key_pairs( struct sliced_desc *ctx, int start, int end, const uint8_t *next )
 {
-	if ( odd == 0 )
-		return ( in_range( *( p + 1 ), u, var ) && in_range( *( p + 3 ), v, var ) ) ? 0 : a;
-	else
-		return ( in_range( ( *( p + 1 ) + *( p + 5 ) ) / 2, u, var ) && in_range( ( *( p + 3 ) + *( p + 7 ) ) / 2, v, var ) ) ? 0 : a;
+	uint8_t *p = ctx->image + 4 * start;
+	uint8_t *alpha = ctx->alpha + 2 * start;
+	int k;
+
+	for ( k = start; k < end; k++, p += 4, alpha += 2 )
+	{
+		int u = p[1], v = p[3];
+		int next_u = k + 1 < end ? p[5] : next[0];
+		int next_v = k + 1 < end ? p[7] : next[1];
+		int even = distance( u, v, ctx->u, ctx->v );
+		int odd = distance( ( u + next_u ) / 2, ( v + next_v ) / 2, ctx->u, ctx->v );
+
+		alpha[0] = ( alpha[0] * ctx->keep[even] ) >> 8;
+		alpha[1] = ( alpha[1] * ctx->keep[odd] ) >> 8;
+		if ( ctx->spill && ctx->keep[even] < 256 && ctx->keep[even] > 0 )
+		{
+			// Pull the chroma of a partly keyed pixel towards grey
+			int scale = 256 - ( ( 256 - ctx->keep[even] ) * ctx->spill >> 8 );
+			p[1] = 128 + ( ( u - 128 ) * scale >> 8 );
+			p[3] = 128 + ( ( v - 128 ) * scale >> 8 );
+		}
+	}
+}
+
+#if defined(USE_SSE2)
+/** Key groups of 4 pairs with a hard edge, returning the first pair not done.
+ * The pair after the last one done must lie inside [start, end).
+ */
+
+static int key_pairs_sse2( struct sliced_desc *ctx, int start, int end )
+{
+	const __m128i byte = _mm_set1_epi32( 255 );
+	const __m128i u_low = _mm_set1_epi32( ctx->u - ctx->variance - 1 );
+	const __m128i u_high = _mm_set1_epi32( ctx->u + ctx->variance + 1 );
+	const __m128i v_low = _mm_set1_epi32( ctx->v - ctx->variance - 1 );
+	const __m128i v_high = _mm_set1_epi32( ctx->v + ctx->variance + 1 );
+	int k;
+
+	for ( k = start; k + 4 < end; k += 4 )
+	{
+		__m128i pairs = _mm_loadu_si128( (const __m128i*) ( ctx->image + 4 * k ) );
+		__m128i next = _mm_loadu_si128( (const __m128i*) ( ctx->image + 4 * k + 4 ) );
+		__m128i u = _mm_and_si128( _mm_srli_epi32( pairs, 8 ), byte );
+		__m128i v = _mm_srli_epi32( pairs, 24 );
+		__m128i u2 = _mm_srli_epi32( _mm_add_epi32( u, _mm_and_si128( _mm_srli_epi32( next, 8 ), byte ) ), 1 );
+		__m128i v2 = _mm_srli_epi32( _mm_add_epi32( v, _mm_srli_epi32( next, 24 ) ), 1 );
+		__m128i even = _mm_and_si128( _mm_and_si128( _mm_cmpgt_epi32( u, u_low ), _mm_cmplt_epi32( u, u_high ) ),
+			_mm_and_si128( _mm_cmpgt_epi32( v, v_low ), _mm_cmplt_epi32( v, v_high ) ) );
+		__m128i odd = _mm_and_si128( _mm_and_si128( _mm_cmpgt_epi32( u2, u_low ), _mm_cmplt_epi32( u2, u_high ) ),
+			_mm_and_si128( _mm_cmpgt_epi32( v2, v_low ), _mm_cmplt_epi32( v2, v_high ) ) );
+		__m128i keyed = _mm_packs_epi16( _mm_unpacklo_epi16( _mm_packs_epi32( even, even ), _mm_packs_epi32( odd, odd ) ), _mm_setzero_si128() );
+		__m128i alpha = _mm_loadl_epi64( (const __m128i*) ( ctx->alpha + 2 * k ) );
+		_mm_storel_epi64( (__m128i*) ( ctx->alpha + 2 * k ), _mm_andnot_si128( keyed, alpha ) );
+	}
+	return k;
+}
+#endif
+
+static int sliced_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	int start, end;
+
+	slice_pairs( ctx->pairs, index, jobs, &start, &end );
+#if defined(USE_SSE2)
+	if ( ctx->hard )
+		start = key_pairs_sse2( ctx, start, end );
+#endif
+	key_pairs( ctx, start, end, ctx->next + 2 * index );
+	return 0;
 }
 
 /** Get the images and map the chroma to the alpha of the frame.
@@ -46,17 +150,22 @@ static inline uint8_t alpha_value( uint8_t a, uint8_t *p, uint8_t u, uint8_t v,
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
 	mlt_filter this = mlt_frame_pop_service( frame );
-	int variance = 200 * mlt_properties_get_double( MLT_FILTER_PROPERTIES( this ), "variance" );
-	int32_t key_val = mlt_properties_get_int( MLT_FILTER_PROPERTIES( this ), "key" );
+	mlt_properties properties = MLT_FILTER_PROPERTIES( this );
+	int variance = 200 * mlt_properties_get_double( properties, "variance" );
+	int softness = 200 * mlt_properties_get_double( properties, "softness" );
+	int spill = 256 * mlt_properties_get_double( properties, "spill" );
+	int32_t key_val = mlt_properties_get_int( properties, "key" );
 	uint8_t r = ( key_val >> 24 ) & 0xff;
 	uint8_t g = ( key_val >> 16 ) & 0xff;
 	uint8_t b = ( key_val >>  8 ) & 0xff;
 	uint8_t u, v;
 
 	RGB2UV_601_SCALED( r, g, b, u, v );
+	softness = CLAMP( softness, 0, 255 );
+	spill = softness > 0 ? CLAMP( spill, 0, 256 ) : 0;
 
 	*format = mlt_image_yuv422;
-	if ( mlt_frame_get_image( frame, image, format, width, height, writable ) == 0 )
+	if ( mlt_frame_get_image( frame, image, format, width, height, writable || spill ) == 0 )
 	{
 		uint8_t *alpha = mlt_frame_get_alpha( frame );
 		if ( !alpha )
@@ -66,15 +175,51 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 			memset( alpha, 255, alphasize );
 			mlt_frame_set_alpha( frame, alpha, alphasize, mlt_pool_release );
 		}
-		uint8_t *p = *image;
-		int size = *width * *height / 2;
-		while ( size -- )
+
+		struct sliced_desc desc;
+		int threads = CLAMP( mlt_properties_get_int( properties, "threads" ), 0, mlt_slices_count_normal() );
+		int d, i;
+
+		desc.image = *image;
+		desc.alpha = alpha;
+		desc.pairs = *width * *height / 2;
+		desc.u = u;
+		desc.v = v;
+		desc.variance = variance;
+		desc.hard = softness == 0;
+		desc.spill = spill;
+		for ( d = 0; d < 256; d++ )
+		{
+			if ( d <= variance )
+				desc.keep[d] = 0;
+			else if ( d < variance + softness )
+				desc.keep[d] = ( d - variance ) * 256 / softness;
+			else
+				desc.keep[d] = 256;
+		}
+		if ( threads == 0 )
+			threads = mlt_slices_count_normal();
+		threads = CLAMP( threads, 1, MAX( *height / MIN_SLICE_HEIGHT, 1 ) );
+
+		// Save the chroma that follows each slice before another slice changes it.
+		// The last pair of the image is averaged with itself.
+		desc.next = desc.pairs > 0 ? malloc( 2 * threads ) : NULL;
+		if ( desc.next )
 		{
-			*alpha = alpha_value( *alpha, p, u, v, variance, 0 );
-			alpha ++;
-			*alpha = alpha_value( *alpha, p, u, v, variance, 1 );
-			alpha ++;
-			p += 4;
+			for ( i = 0; i < threads; i++ )
+			{
+				int start, end;
+				slice_pairs( desc.pairs, i, threads, &start, &end );
+				if ( end == desc.pairs )
+					end = desc.pairs - 1;
+				desc.next[2 * i] = desc.image[4 * end + 1];
+				desc.next[2 * i + 1] = desc.image[4 * end + 3];
+			}
+			if ( threads == 1 )
+				sliced_proc( 0, 0, 1, &desc );
+			else
+				mlt_slices_run_normal( threads, sliced_proc, &desc );
+			free( desc.next );
 		}
 	}
 
@@ -101,6 +246,8 @@ mlt_filter filter_chroma_init( mlt_profile profile, mlt_service_type type, const
 	{
 		mlt_properties_set( MLT_FILTER_PROPERTIES( this ), "key", arg == NULL ? "0x0000ff00" : arg );
 		mlt_properties_set_double( MLT_FILTER_PROPERTIES( this ), "variance", 0.15 );
+		mlt_properties_set_double( MLT_FILTER_PROPERTIES( this ), "softness", 0 );
+		mlt_properties_set_double( MLT_FILTER_PROPERTIES( this ), "spill", 0 );
 		this->process = filter_process;
 	}
 	return this;
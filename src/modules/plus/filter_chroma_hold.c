@@ -23,18 +23,110 @@
 #include <framework/mlt_factory.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_producer.h>
+#include <framework/mlt_slices.h>
 
-static inline int in_range( uint8_t v, uint8_t c, int var )
+#define MIN_SLICE_HEIGHT (16)
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2 1
+#endif
+
+struct sliced_desc
+{
+	uint8_t *image;
+	int pairs;          /**< the number of pixel pairs in the image */
+	int u, v;
+	int variance;
+	uint8_t *next;      /**< the original chroma of the pair after each slice */
+};
+
+/** Get the pixel pairs [start, end) of a slice. */
+
+static void slice_pairs( int pairs, int index, int jobs, int *start, int *end )
 {
-	return ( ( int )v >= c - var ) && ( ( int )v <= c + var );
+	*start = (int) ( (int64_t) pairs * index / jobs );
+	*end = (int) ( (int64_t) pairs * ( index + 1 ) / jobs );
 }
 
-static inline uint8_t alpha_value( uint8_t a, uint8_t *p, uint8_t u, uint8_t v, int var, int odd )
+static inline int in_range( int v, int c, int var )
 {
-	if ( odd == 0 )
-		return ( in_range( *( p + 1 ), u, var ) && in_range( *( p + 3 ), v, var ) ) ? 0 : a;
-	else
-		return ( in_range( ( *( p + 1 ) + *( p + 5 ) ) / 2, u, var ) && in_range( ( *( p + 3 ) + *( p + 7 ) ) / 2, v, var ) ) ? 0 : a;
+	return ( v >= c - var ) && ( v <= c + var );
+}
+
+/** Remove the chroma outside of the key from the pairs [start, end).
+ *
+ * The first pixel of a pair gives its U and the second pixel, keyed on the
+ * average with the next pair, gives its V. The average uses the U that the
+ * first pixel left and the original chroma of the next pair, which is in next
+ * for the last pair.
+ */
+
+static void hold_pairs( struct sliced_desc *ctx, int start, int end, const uint8_t *next )
+{
+	uint8_t *p = ctx->image + 4 * start;
+	int k;
+
+	for ( k = start; k < end; k++, p += 4 )
+	{
+		int next_u = k + 1 < end ? p[5] : next[0];
+		int next_v = k + 1 < end ? p[7] : next[1];
+		if ( !( in_range( p[1], ctx->u, ctx->variance ) && in_range( p[3], ctx->v, ctx->variance ) ) )
+			p[1] = 128;
+		if ( !( in_range( ( p[1] + next_u ) / 2, ctx->u, ctx->variance ) && in_range( ( p[3] + next_v ) / 2, ctx->v, ctx->variance ) ) )
+			p[3] = 128;
+	}
+}
+
+#if defined(USE_SSE2)
+/** Process groups of 4 pairs, returning the first pair not done.
+ * The pair after the last one done must lie inside [start, end).
+ */
+
+static int hold_pairs_sse2( struct sliced_desc *ctx, int start, int end )
+{
+	const __m128i byte = _mm_set1_epi32( 255 );
+	const __m128i grey = _mm_set1_epi32( 128 );
+	const __m128i luma = _mm_set1_epi32( 0x00ff00ff );
+	const __m128i u_low = _mm_set1_epi32( ctx->u - ctx->variance - 1 );
+	const __m128i u_high = _mm_set1_epi32( ctx->u + ctx->variance + 1 );
+	const __m128i v_low = _mm_set1_epi32( ctx->v - ctx->variance - 1 );
+	const __m128i v_high = _mm_set1_epi32( ctx->v + ctx->variance + 1 );
+	int k;
+
+	for ( k = start; k + 4 < end; k += 4 )
+	{
+		__m128i pairs = _mm_loadu_si128( (const __m128i*) ( ctx->image + 4 * k ) );
+		__m128i next = _mm_loadu_si128( (const __m128i*) ( ctx->image + 4 * k + 4 ) );
+		__m128i u = _mm_and_si128( _mm_srli_epi32( pairs, 8 ), byte );
+		__m128i v = _mm_srli_epi32( pairs, 24 );
+		__m128i even = _mm_and_si128( _mm_and_si128( _mm_cmpgt_epi32( u, u_low ), _mm_cmplt_epi32( u, u_high ) ),
+			_mm_and_si128( _mm_cmpgt_epi32( v, v_low ), _mm_cmplt_epi32( v, v_high ) ) );
+		u = _mm_or_si128( _mm_and_si128( even, u ), _mm_andnot_si128( even, grey ) );
+		__m128i u2 = _mm_srli_epi32( _mm_add_epi32( u, _mm_and_si128( _mm_srli_epi32( next, 8 ), byte ) ), 1 );
+		__m128i v2 = _mm_srli_epi32( _mm_add_epi32( v, _mm_srli_epi32( next, 24 ) ), 1 );
+		__m128i odd = _mm_and_si128( _mm_and_si128( _mm_cmpgt_epi32( u2, u_low ), _mm_cmplt_epi32( u2, u_high ) ),
+			_mm_and_si128( _mm_cmpgt_epi32( v2, v_low ), _mm_cmplt_epi32( v2, v_high ) ) );
+		v = _mm_or_si128( _mm_and_si128( odd, v ), _mm_andnot_si128( odd, grey ) );
+		pairs = _mm_or_si128( _mm_and_si128( pairs, luma ), _mm_or_si128( _mm_slli_epi32( u, 8 ), _mm_slli_epi32( v, 24 ) ) );
+		_mm_storeu_si128( (__m128i*) ( ctx->image + 4 * k ), pairs );
+	}
+	return k;
+}
+#endif
+
+static int sliced_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	int start, end;
+
+	slice_pairs( ctx->pairs, index, jobs, &start, &end );
+#if defined(USE_SSE2)
+	start = hold_pairs_sse2( ctx, start, end );
+#endif
+	hold_pairs( ctx, start, end, ctx->next + 2 * index );
+	return 0;
 }
 
 /** Get the images and map the chroma to the alpha of the frame.
@@ -43,8 +135,9 @@ static inline uint8_t alpha_value( uint8_t a, uint8_t *p, uint8_t u, uint8_t v,
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
 	mlt_filter this = mlt_frame_pop_service( frame );
-	int variance = 200 * mlt_properties_get_double( MLT_FILTER_PROPERTIES( this ), "variance" );
-	int32_t key_val = mlt_properties_get_int( MLT_FILTER_PROPERTIES( this ), "key" );
+	mlt_properties properties = MLT_FILTER_PROPERTIES( this );
+	int variance = 200 * mlt_properties_get_double( properties, "variance" );
+	int32_t key_val = mlt_properties_get_int( properties, "key" );
 	uint8_t r = ( key_val >> 24 ) & 0xff;
 	uint8_t g = ( key_val >> 16 ) & 0xff;
 	uint8_t b = ( key_val >>  8 ) & 0xff;
@@ -55,18 +148,38 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	*format = mlt_image_yuv422;
 	if ( mlt_frame_get_image( frame, image, format, width, height, writable ) == 0 )
 	{
-		uint8_t alpha = 0;
-		uint8_t *p = *image;
-		int size = *width * *height / 2;
-		while ( size -- )
+		struct sliced_desc desc;
+		int threads = CLAMP( mlt_properties_get_int( properties, "threads" ), 0, mlt_slices_count_normal() );
+		int i;
+
+		desc.image = *image;
+		desc.pairs = *width * *height / 2;
+		desc.u = u;
+		desc.v = v;
+		desc.variance = variance;
+		if ( threads == 0 )
+			threads = mlt_slices_count_normal();
+		threads = CLAMP( threads, 1, MAX( *height / MIN_SLICE_HEIGHT, 1 ) );
+
+		// Save the chroma that follows each slice before another slice changes it.
+		// The last pair of the image is averaged with itself.
+		desc.next = desc.pairs > 0 ? malloc( 2 * threads ) : NULL;
+		if ( desc.next )
 		{
-			alpha = alpha_value( 255, p, u, v, variance, 0 );
-			if ( alpha ) 
-				*( p + 1 )= 128;
-			alpha = alpha_value( 255, p, u, v, variance, 1 );
-			if ( alpha ) 
-				*( p + 3 ) = 128;
-			p += 4;
+			for ( i = 0; i < threads; i++ )
+			{
+				int start, end;
+				slice_pairs( desc.pairs, i, threads, &start, &end );
+				if ( end == desc.pairs )
+					end = desc.pairs - 1;
+				desc.next[2 * i] = desc.image[4 * end + 1];
+				desc.next[2 * i + 1] = desc.image[4 * end + 3];
+			}
+			if ( threads == 1 )
+				sliced_proc( 0, 0, 1, &desc );
+			else
+				mlt_slices_run_normal( threads, sliced_proc, &desc );
+			free( desc.next );
 		}
 	}
 
@@ -28,6 +28,40 @@
 
 #define MAX_TEXT_LEN 512
 
+/** The kinds of token in a template. */
+
+typedef enum
+{
+	token_text,           /**< literal text */
+	token_smpte_df,       /**< #timecode# or #smpte_df# */
+	token_smpte_ndf,      /**< #smpte_ndf# */
+	token_frame,          /**< #frame# */
+	token_filedate,       /**< #filedate[ format]# */
+	token_localfiledate,  /**< #localfiledate[ format]# */
+	token_localtime,      /**< #localtime[ format]# */
+	token_resource,       /**< #resource# */
+	token_createdate,     /**< #createdate[ format]# */
+	token_property        /**< any other keyword names a frame property */
+} token_type;
+
+typedef struct
+{
+	token_type type;
+	char* text;           /**< the literal text or the whole keyword */
+} template_token;
+
+/** \brief a template split into tokens
+ *
+ * The argument is only tokenized again when it changes.
+ */
+
+typedef struct
+{
+	char* source;         /**< the argument that the tokens came from */
+	template_token* tokens;
+	int count;
+} compiled_template;
+
 /** Get the next token and indicate whether it is enclosed in "# #".
 */
 static int get_next_token(char* str, int* pos, char* token, int* is_keyword)
@@ -82,6 +116,69 @@ static int get_next_token(char* str, int* pos, char* token, int* is_keyword)
 	return 1;
 }
 
+static token_type get_token_type( const char* keyword )
+{
+	if ( !strcmp( keyword, "timecode" ) || !strcmp( keyword, "smpte_df" ) )
+		return token_smpte_df;
+	else if ( !strcmp( keyword, "smpte_ndf" ) )
+		return token_smpte_ndf;
+	else if ( !strcmp( keyword, "frame" ) )
+		return token_frame;
+	else if ( !strncmp( keyword, "filedate", 8 ) )
+		return token_filedate;
+	else if ( !strncmp( keyword, "localfiledate", 13 ) )
+		return token_localfiledate;
+	else if ( !strncmp( keyword, "localtime", 9 ) )
+		return token_localtime;
+	else if ( !strcmp( keyword, "resource" ) )
+		return token_resource;
+	else if ( !strncmp( keyword, "createdate", 10 ) )
+		return token_createdate;
+	return token_property;
+}
+
+static void clear_template( compiled_template* compiled )
+{
+	int i;
+	for ( i = 0; i < compiled->count; i++ )
+		free( compiled->tokens[i].text );
+	free( compiled->tokens );
+	free( compiled->source );
+	compiled->tokens = NULL;
+	compiled->source = NULL;
+	compiled->count = 0;
+}
+
+/** Tokenize the template unless it is the one that was tokenized last.
+*/
+static void compile_template( compiled_template* compiled, char* value )
+{
+	char keyword[MAX_TEXT_LEN] = "";
+	int pos = 0;
+	int is_keyword = 0;
+	int size = 0;
+
+	if ( compiled->source && !strcmp( compiled->source, value ) )
+		return;
+
+	clear_template( compiled );
+	compiled->source = strdup( value );
+	while ( get_next_token( value, &pos, keyword, &is_keyword ) )
+	{
+		if ( compiled->count == size )
+		{
+			template_token* tokens = realloc( compiled->tokens, ( size * 2 + 4 ) * sizeof( template_token ) );
+			if ( !tokens )
+				break;
+			compiled->tokens = tokens;
+			size = size * 2 + 4;
+		}
+		compiled->tokens[compiled->count].type = is_keyword ? get_token_type( keyword ) : token_text;
+		compiled->tokens[compiled->count].text = strdup( keyword );
+		compiled->count++;
+	}
+}
+
 static void get_timecode_str( mlt_filter filter, mlt_frame frame, char* text, mlt_time_format time_format )
 {
 	mlt_position frames = mlt_frame_get_position( frame );
@@ -177,51 +274,44 @@ static void get_createdate_str( const char* keyword, mlt_filter filter, mlt_fram
 
 /** Perform substitution for keywords that are enclosed in "# #".
 */
-static void substitute_keywords(mlt_filter filter, char* result, char* value, mlt_frame frame)
+static void substitute_keywords(mlt_filter filter, char* result, compiled_template* compiled, mlt_frame frame)
 {
-	char keyword[MAX_TEXT_LEN] = "";
-	int pos = 0;
-	int is_keyword = 0;
+	int i;
 
-	while ( get_next_token(value, &pos, keyword, &is_keyword) )
+	for ( i = 0; i < compiled->count; i++ )
 	{
-		if(!is_keyword)
+		char* keyword = compiled->tokens[i].text;
+
+		switch ( compiled->tokens[i].type )
 		{
+		case token_text:
 			strncat( result, keyword, MAX_TEXT_LEN - strlen( result ) - 1 );
-		}
-		else if ( !strcmp( keyword, "timecode" ) || !strcmp( keyword, "smpte_df" ) )
-		{
+			break;
+		case token_smpte_df:
 			get_timecode_str( filter, frame, result, mlt_time_smpte_df );
-		}
-		else if ( !strcmp( keyword, "smpte_ndf" ) )
-		{
+			break;
+		case token_smpte_ndf:
 			get_timecode_str( filter, frame, result, mlt_time_smpte_ndf );
-		}
-		else if ( !strcmp( keyword, "frame" ) )
-		{
+			break;
+		case token_frame:
 			get_frame_str( filter, frame, result );
-		}
-		else if ( !strncmp( keyword, "filedate", 8 ) )
-		{
+			break;
+		case token_filedate:
 			get_filedate_str( keyword, filter, frame, result );
-		}
-		else if ( !strncmp( keyword, "localfiledate", 13 ) )
-		{
+			break;
+		case token_localfiledate:
 			get_localfiledate_str( keyword, filter, frame, result );
-		}
-		else if ( !strncmp( keyword, "localtime", 9 ) )
-		{
+			break;
+		case token_localtime:
 			get_localtime_str( keyword, result );
-		}
-		else if ( !strcmp( keyword, "resource" ) )
-		{
+			break;
+		case token_resource:
 			get_resource_str( filter, frame, result );
-		}
-		else if ( !strncmp( keyword, "createdate", 10 ) )
-		{
+			break;
+		case token_createdate:
 			get_createdate_str( keyword, filter, frame, result );
-		}
-		else
+			break;
+		case token_property:
 		{
 			// replace keyword with property value from this frame
 			mlt_properties frame_properties = MLT_FRAME_PROPERTIES( frame );
@@ -230,6 +320,8 @@ static void substitute_keywords(mlt_filter filter, char* result, char* value, ml
 			{
 				strncat( result, frame_value, MAX_TEXT_LEN - strlen(result) - 1 );
 			}
+			break;
+		}
 		}
 	}
 }
@@ -248,7 +340,10 @@ static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
 
 	// Apply keyword substitution before passing the text to the filter.
 	char* result = calloc( 1, MAX_TEXT_LEN );
-	substitute_keywords( filter, result, dynamic_text, frame );
+	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
+	compile_template( filter->child, dynamic_text );
+	substitute_keywords( filter, result, filter->child, frame );
+	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
 	mlt_properties_set_string( text_filter_properties, "argument", result );
 	free( result );
 	mlt_properties_pass_list( text_filter_properties, properties,
@@ -257,12 +352,30 @@ static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
 	return mlt_filter_process( text_filter, frame );
 }
 
+/** Destructor for the filter.
+*/
+static void filter_close( mlt_filter filter )
+{
+	compiled_template* compiled = filter->child;
+
+	if ( compiled )
+	{
+		clear_template( compiled );
+		free( compiled );
+	}
+	filter->child = NULL;
+	filter->close = NULL;
+	filter->parent.close = NULL;
+	mlt_service_close( &filter->parent );
+}
+
 /** Constructor for the filter.
 */
 mlt_filter filter_dynamictext_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg )
 {
 	mlt_filter filter = mlt_filter_new();
 	mlt_filter text_filter = mlt_factory_filter( profile, "qtext", NULL );
+	compiled_template* compiled = calloc( 1, sizeof( compiled_template ) );
 
 	if( !text_filter )
 		text_filter = mlt_factory_filter( profile, "text", NULL );
@@ -270,7 +383,7 @@ mlt_filter filter_dynamictext_init( mlt_profile profile, mlt_service_type type,
 	if( !text_filter )
 		mlt_log_warning( MLT_FILTER_SERVICE(filter), "Unable to create text filter.\n" );
 
-	if ( filter && text_filter )
+	if ( filter && text_filter && compiled )
 	{
 		mlt_properties my_properties = MLT_FILTER_PROPERTIES( filter );
 
@@ -293,6 +406,8 @@ mlt_filter filter_dynamictext_init( mlt_profile profile, mlt_service_type type,
 		mlt_properties_set_string( my_properties, "outline", "0" );
 		mlt_properties_set_int( my_properties, "_filter_private", 1 );
 
+		filter->child = compiled;
+		filter->close = filter_close;
 		filter->process = filter_process;
 	}
 	else
@@ -307,6 +422,8 @@ mlt_filter filter_dynamictext_init( mlt_profile profile, mlt_service_type type,
 			mlt_filter_close( text_filter );
 		}
 
+		free( compiled );
+
 		filter = NULL;
 	}
 	return filter;
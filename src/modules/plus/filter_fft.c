@@ -21,6 +21,7 @@
 #include <stdlib.h> // calloc(), free()
 #include <string.h> // memset(), memmove()
 #include <math.h>   // sqrt()
+#include <pthread.h>
 #include <fftw3.h>
 
 // Private Constants
@@ -29,21 +30,131 @@ static const int MIN_WINDOW_SIZE = 500;
 static const double PI = 3.14159265358979323846;
 
 // Private Types
+
+// A plan and window function shared by every filter with the same window size
+typedef struct shared_plan_s
+{
+	unsigned int window_size;
+	int refs;
+	fftw_plan plan;
+	float* hann;
+	struct shared_plan_s* next;
+} shared_plan;
+
 typedef struct
 {
 	int initialized;
 	unsigned int window_size;
 	double* fft_in;
 	fftw_complex* fft_out;
-	fftw_plan fft_plan;
+	shared_plan* fft_plan;
 	int bin_count;
 	int sample_buff_count;
+	int sample_buff_pos;
 	float* sample_buff;
-	float* hann;
 	float* out_bins;
 	mlt_position expected_pos;
 } private_data;
 
+// The fftw planner is not thread safe, so the plans are made and destroyed
+// under this lock. Executing a plan on new arrays is thread safe.
+static pthread_mutex_t g_plans_lock = PTHREAD_MUTEX_INITIALIZER;
+static shared_plan* g_plans = NULL;
+static int g_wisdom_loaded = 0;
+
+/** Get the shared plan for a window size, making it if needed.
+ *
+ * When MLT_FFTW_WISDOM names a file, the plans are measured instead of
+ * estimated, and the wisdom is read from and saved to that file so that
+ * measuring only happens once per window size.
+ */
+
+static shared_plan* acquire_plan( unsigned int window_size )
+{
+	const char* wisdom = getenv( "MLT_FFTW_WISDOM" );
+	shared_plan* plan = NULL;
+
+	pthread_mutex_lock( &g_plans_lock );
+	for ( plan = g_plans; plan; plan = plan->next )
+	{
+		if ( plan->window_size == window_size )
+		{
+			plan->refs++;
+			break;
+		}
+	}
+	if ( !plan )
+	{
+		plan = calloc( 1, sizeof(*plan) );
+		if ( plan )
+		{
+			// The arrays are only needed to make the plan, which is executed
+			// on the arrays of each filter. They are allocated the same way so
+			// that they have the same alignment.
+			double* in = fftw_alloc_real( window_size );
+			fftw_complex* out = fftw_alloc_complex( window_size / 2 + 1 );
+			if ( wisdom && !g_wisdom_loaded )
+			{
+				fftw_import_wisdom_from_filename( wisdom );
+				g_wisdom_loaded = 1;
+			}
+			if ( in && out )
+			{
+				plan->plan = fftw_plan_dft_r2c_1d( window_size, in, out, wisdom ? FFTW_MEASURE : FFTW_ESTIMATE );
+			}
+			fftw_free( in );
+			fftw_free( out );
+			if ( plan->plan && wisdom )
+			{
+				fftw_export_wisdom_to_filename( wisdom );
+			}
+
+			// Initialize the hanning window function
+			plan->hann = mlt_pool_alloc( window_size * sizeof(*plan->hann) );
+			if ( plan->plan && plan->hann )
+			{
+				int i = 0;
+				for ( i = 0; i < window_size; i++ )
+				{
+					plan->hann[i] = 0.5 * (1 - cos( 2 * PI * i / window_size ) );
+				}
+				plan->window_size = window_size;
+				plan->refs = 1;
+				plan->next = g_plans;
+				g_plans = plan;
+			}
+			else
+			{
+				if ( plan->plan )
+					fftw_destroy_plan( plan->plan );
+				mlt_pool_release( plan->hann );
+				free( plan );
+				plan = NULL;
+			}
+		}
+	}
+	pthread_mutex_unlock( &g_plans_lock );
+	return plan;
+}
+
+static void release_plan( shared_plan* plan )
+{
+	if ( !plan )
+		return;
+	pthread_mutex_lock( &g_plans_lock );
+	if ( --plan->refs == 0 )
+	{
+		shared_plan** p = &g_plans;
+		while ( *p != plan )
+			p = &(*p)->next;
+		*p = plan->next;
+		fftw_destroy_plan( plan->plan );
+		mlt_pool_release( plan->hann );
+		free( plan );
+	}
+	pthread_mutex_unlock( &g_plans_lock );
+}
+
 static int initFft( mlt_filter filter )
 {
 	int error = 0;
@@ -57,6 +168,7 @@ static int initFft( mlt_filter filter )
 			private->initialized = 1;
 			private->bin_count = private->window_size / 2 + 1;
 			private->sample_buff_count = 0;
+			private->sample_buff_pos = 0;
 			private->out_bins = mlt_pool_alloc( private->bin_count * sizeof(*private->out_bins));
 
 			// Initialize sample buffer
@@ -66,15 +178,7 @@ static int initFft( mlt_filter filter )
 			// Initialize fftw variables
 			private->fft_in = fftw_alloc_real( private->window_size );
 			private->fft_out = fftw_alloc_complex( private->bin_count );
-			private->fft_plan = fftw_plan_dft_r2c_1d( private->window_size, private->fft_in, private->fft_out, FFTW_ESTIMATE );
-
-			// Initialize the hanning window function
-			private->hann = mlt_pool_alloc( private->window_size * sizeof(*private->hann));
-			int i = 0;
-			for ( i = 0; i < private->window_size; i++ )
-			{
-				private->hann[i] = 0.5 * (1 - cos( 2 * PI * i / private->window_size ) );
-			}
+			private->fft_plan = acquire_plan( private->window_size );
 
 			mlt_properties_set_int( filter_properties, "bin_count", private->bin_count );
 			mlt_properties_set_data( filter_properties, "bins", private->out_bins, 0, 0, 0 );
@@ -114,37 +218,46 @@ static int filter_get_audio( mlt_frame frame, void** buffer, mlt_audio_format* f
 		private->expected_pos = mlt_frame_get_position( frame );
 	}
 
-	if( !initFft( filter ) )
+	int error = initFft( filter );
+	if( !error && private->expected_pos == mlt_frame_get_position( frame ) + 1 && private->sample_buff_count > 0 )
+	{
+		// The same frame again, such as when a paused consumer refreshes it.
+		// Keep the bins instead of adding its samples to the window again.
+	}
+	else if( !error )
 	{
 		if( private->expected_pos != mlt_frame_get_position( frame ) )
 		{
 			// Reset the sample buffer when seeking occurs.
 			memset( private->sample_buff, 0, sizeof(*private->sample_buff) * private->window_size );
 			private->sample_buff_count = 0;
+			private->sample_buff_pos = 0;
 			mlt_log_info( MLT_FILTER_SERVICE(filter), "Buffer Reset %d:%d\n",
 							private->expected_pos,
 							mlt_frame_get_position( frame ) );
 			private->expected_pos = mlt_frame_get_position( frame );
 		}
 
-		int new_samples = 0;
-		int old_samples = 0;
-		if( *samples >= private->window_size )
+		// The sample buffer is a ring that holds the last window_size samples
+		// with the oldest at sample_buff_pos, so the samples that overlap the
+		// previous window stay in place.
+		int new_samples = *samples;
+		if( new_samples > private->window_size )
 		{
 			// Ignore samples that don't fit in the window
 			new_samples = private->window_size;
-			old_samples = 0;
-		}
-		else
-		{
-			new_samples = *samples;
-			// Shift the previous samples (discarding oldest samples)
-			old_samples = private->window_size - new_samples;
-			memmove( private->sample_buff, private->sample_buff + new_samples, sizeof(*private->sample_buff) * old_samples);
 		}
+		int start = private->sample_buff_pos;
+		int first = MIN( new_samples, private->window_size - start );
+		float* part[2] = { private->sample_buff + start, private->sample_buff };
+		int part_count[2] = { first, new_samples - first };
+		int i = 0;
 
 		// Zero out the space for the new samples
-		memset( private->sample_buff + old_samples, 0, sizeof(*private->sample_buff) * new_samples );
+		for( i = 0; i < 2; i++ )
+		{
+			memset( part[i], 0, sizeof(*private->sample_buff) * part_count[i] );
+		}
 
 		// Copy the new samples into the sample buffer
 		if( *format == mlt_audio_s16 )
@@ -159,7 +272,10 @@ static int filter_get_audio( mlt_frame frame, void** buffer, mlt_audio_format* f
 					// Scale to +/-1
 					sample /= MAX_S16_AMPLITUDE;
 					sample /= (double)*channels;
-					private->sample_buff[old_samples + s] += sample;
+					if ( s < first )
+						part[0][s] += sample;
+					else
+						part[1][s - first] += sample;
 				}
 			}
 		}
@@ -173,7 +289,10 @@ static int filter_get_audio( mlt_frame frame, void** buffer, mlt_audio_format* f
 				{
 					double sample = aud[c * *samples + s];
 					sample /= (double)*channels;
-					private->sample_buff[old_samples + s] += sample;
+					if ( s < first )
+						part[0][s] += sample;
+					else
+						part[1][s - first] += sample;
 				}
 			}
 		}
@@ -181,20 +300,29 @@ static int filter_get_audio( mlt_frame frame, void** buffer, mlt_audio_format* f
 		{
 			mlt_log_error( MLT_FILTER_SERVICE(filter), "Unsupported format %d\n", *format );
 		}
+		private->sample_buff_pos = ( start + new_samples ) % private->window_size;
 		private->sample_buff_count += *samples;
 		if( private->sample_buff_count > private->window_size )
 		{
 			private->sample_buff_count = private->window_size;
 		}
 
-		// Copy samples to fft input while applying window function
-		for (s = 0; s < private->window_size; s++)
+		// Copy samples to fft input from oldest to newest while applying
+		// window function
+		float* hann = private->fft_plan->hann;
+		int oldest = private->sample_buff_pos;
+		int tail = private->window_size - oldest;
+		for (s = 0; s < tail; s++)
+		{
+			private->fft_in[s] = private->sample_buff[oldest + s] * hann[s];
+		}
+		for (s = tail; s < private->window_size; s++)
 		{
-			private->fft_in[s] = private->sample_buff[s] * private->hann[s];
+			private->fft_in[s] = private->sample_buff[s - tail] * hann[s];
 		}
 
 		// Perform the FFT
-		fftw_execute( private->fft_plan );
+		fftw_execute_dft_r2c( private->fft_plan->plan, private->fft_in, private->fft_out );
 
 		// Convert to magnitudes
 		int bin = 0;
@@ -236,9 +364,8 @@ static void filter_close( mlt_filter filter )
 	{
 		fftw_free( private->fft_in );
 		fftw_free( private->fft_out );
-		fftw_destroy_plan( private->fft_plan );
+		release_plan( private->fft_plan );
 		mlt_pool_release( private->sample_buff );
-		mlt_pool_release( private->hann );
 		mlt_pool_release( private->out_bins );
 		free( private );
 	}
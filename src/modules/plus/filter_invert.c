@@ -25,11 +25,6 @@
 #include <math.h>
 #include <string.h>
 
-static inline int clamp( int v, int l, int u )
-{
-	return v < l ? l : ( v > u ? u : v );
-}
-
 /** Do it :-).
 */
 
@@ -39,22 +34,19 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	mlt_filter filter = mlt_frame_pop_service( frame );
 
 	int mask = mlt_properties_get_int( MLT_FILTER_PROPERTIES( filter ), "alpha" );
+
+	// Invert the luma and the chroma within their ranges
+	uint8_t luma[ 256 ], chroma[ 256 ];
+	const uint8_t *luts[ MLT_IMAGE_MAX_PLANES ] = { luma, chroma, chroma, NULL };
+	mlt_image_lut_affine( luma, -1, 251, 16, 235 );
+	mlt_image_lut_affine( chroma, -1, 256, 16, 240 );
+
 	*format = mlt_image_yuv422;
-	int error = mlt_frame_get_image( frame, image, format, width, height, 1 );
+	int error = mlt_frame_get_image_lut( frame, image, format, width, height, luts );
 
 	// Only process if we have no error and a valid colour space
 	if ( error == 0 )
 	{
-		uint8_t *p = *image;
-		uint8_t *q = *image + *width * *height * 2;
-		uint8_t *r = *image;
-
-		while ( p != q )
-		{
-			*p ++ = clamp( 251 - *r ++, 16, 235 );
-			*p ++ = clamp( 256 - *r ++, 16, 240 );
-		}
-
 		if ( mask )
 		{
 			int size = *width * *height;
@@ -30,6 +30,9 @@ typedef struct
 	double rlift, glift, blift;
 	double rgamma, ggamma, bgamma;
 	double rgain, ggain, bgain;
+	mlt_property lift_r, lift_g, lift_b;
+	mlt_property gamma_r, gamma_g, gamma_b;
+	mlt_property gain_r, gain_g, gain_b;
 } private_data;
 
 static void refresh_lut( mlt_filter filter, mlt_frame frame )
@@ -38,15 +41,15 @@ static void refresh_lut( mlt_filter filter, mlt_frame frame )
 	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
 	mlt_position position = mlt_filter_get_position( filter, frame );
 	mlt_position length = mlt_filter_get_length2( filter, frame );
-	double rlift = mlt_properties_anim_get_double( properties, "lift_r", position, length );
-	double glift = mlt_properties_anim_get_double( properties, "lift_g", position, length );
-	double blift = mlt_properties_anim_get_double( properties, "lift_b", position, length );
-	double rgamma = mlt_properties_anim_get_double( properties, "gamma_r", position, length );
-	double ggamma = mlt_properties_anim_get_double( properties, "gamma_g", position, length );
-	double bgamma = mlt_properties_anim_get_double( properties, "gamma_b", position, length );
-	double rgain = mlt_properties_anim_get_double( properties, "gain_r", position, length );
-	double ggain = mlt_properties_anim_get_double( properties, "gain_g", position, length );
-	double bgain = mlt_properties_anim_get_double( properties, "gain_b", position, length );
+	double rlift = mlt_properties_anim_get_double_property( properties, self->lift_r, position, length );
+	double glift = mlt_properties_anim_get_double_property( properties, self->lift_g, position, length );
+	double blift = mlt_properties_anim_get_double_property( properties, self->lift_b, position, length );
+	double rgamma = mlt_properties_anim_get_double_property( properties, self->gamma_r, position, length );
+	double ggamma = mlt_properties_anim_get_double_property( properties, self->gamma_g, position, length );
+	double bgamma = mlt_properties_anim_get_double_property( properties, self->gamma_b, position, length );
+	double rgain = mlt_properties_anim_get_double_property( properties, self->gain_r, position, length );
+	double ggain = mlt_properties_anim_get_double_property( properties, self->gain_g, position, length );
+	double bgain = mlt_properties_anim_get_double_property( properties, self->gain_b, position, length );
 
 	// Only regenerate the LUT if something changed.
 	if( self->rlift != rlift || self->glift != glift || self->blift != blift ||
@@ -107,65 +110,21 @@ static void refresh_lut( mlt_filter filter, mlt_frame frame )
 	}
 }
 
-static void apply_lut( mlt_filter filter, uint8_t* image, mlt_image_format format, int width, int height )
-{
-	private_data* self = (private_data*)filter->child;
-	uint8_t* rlut = malloc( sizeof(self->rlut) );
-	uint8_t* glut = malloc( sizeof(self->glut) );
-	uint8_t* blut = malloc( sizeof(self->blut) );
-	int total = width * height + 1;
-	uint8_t* sample = image;
-
-	// Copy the LUT so that we can be frame-thread safe.
-	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
-	memcpy( rlut, self->rlut, sizeof(self->rlut) );
-	memcpy( glut, self->glut, sizeof(self->glut) );
-	memcpy( blut, self->blut, sizeof(self->blut) );
-	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
-
-	switch( format )
-	{
-	case mlt_image_rgb:
-		while( --total )
-		{
-			*sample = rlut[ *sample ];
-			sample++;
-			*sample = glut[ *sample ];
-			sample++;
-			*sample = blut[ *sample ];
-			sample++;
-		}
-		break;
-	case mlt_image_rgba:
-		while( --total )
-		{
-			*sample = rlut[ *sample ];
-			sample++;
-			*sample = glut[ *sample ];
-			sample++;
-			*sample = blut[ *sample ];
-			sample++;
-			sample++; // Skip alpha
-		}
-		break;
-	default:
-		mlt_log_error( MLT_FILTER_SERVICE( filter ), "Invalid image format: %s\n", mlt_image_format_name( format ) );
-		break;
-	}
-	free( rlut );
-	free( glut );
-	free( blut );
-}
-
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
 	mlt_filter filter = (mlt_filter) mlt_frame_pop_service( frame );
+	private_data* self = (private_data*)filter->child;
+	uint8_t rlut[256], glut[256], blut[256];
+	const uint8_t *luts[MLT_IMAGE_MAX_PLANES] = { rlut, glut, blut, NULL };
+	mlt_image_format requested_format;
 	int error = 0;
 
-
-	// Regenerate the LUT if necessary
+	// Regenerate the LUT if necessary and copy it so that we can be frame-thread safe.
 	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
 	refresh_lut( filter, frame );
+	memcpy( rlut, self->rlut, sizeof(self->rlut) );
+	memcpy( glut, self->glut, sizeof(self->glut) );
+	memcpy( blut, self->blut, sizeof(self->blut) );
 	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
 
 	// Make sure the format is acceptable
@@ -173,15 +132,13 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	{
 		*format = mlt_image_rgb;
 	}
+	requested_format = *format;
 
-	// Get the image
-	writable = 1;
-	error = mlt_frame_get_image( frame, image, format, width, height, writable );
-
-	// Apply the LUT
-	if( !error )
+	// Get the image and apply the LUT, which leaves the alpha alone
+	error = mlt_frame_get_image_lut( frame, image, format, width, height, luts );
+	if( !error && *format != requested_format )
 	{
-		apply_lut( filter, *image, *format, *width, *height );
+		mlt_log_error( MLT_FILTER_SERVICE( filter ), "Invalid image format: %s\n", mlt_image_format_name( *format ) );
 	}
 
 	return error;
@@ -237,6 +194,17 @@ mlt_filter filter_lift_gamma_gain_init( mlt_profile profile, mlt_service_type ty
 		mlt_properties_set_double( properties, "gain_g", self->ggain );
 		mlt_properties_set_double( properties, "gain_b", self->bgain );
 
+		// Look up the parameters once instead of on every frame
+		self->lift_r = mlt_properties_get_property( properties, "lift_r" );
+		self->lift_g = mlt_properties_get_property( properties, "lift_g" );
+		self->lift_b = mlt_properties_get_property( properties, "lift_b" );
+		self->gamma_r = mlt_properties_get_property( properties, "gamma_r" );
+		self->gamma_g = mlt_properties_get_property( properties, "gamma_g" );
+		self->gamma_b = mlt_properties_get_property( properties, "gamma_b" );
+		self->gain_r = mlt_properties_get_property( properties, "gain_r" );
+		self->gain_g = mlt_properties_get_property( properties, "gain_g" );
+		self->gain_b = mlt_properties_get_property( properties, "gain_b" );
+
 		filter->close = filter_close;
 		filter->process = filter_process;
 		filter->child = self;
@@ -21,15 +21,37 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 #include <ebur128.h>
 
 #define MAX_RESULT_SIZE 512
+#define MAX_QUEUED_BUFFERS 64
+
+/** \brief the analysis state of the first pass
+ *
+ * The audio of each frame is copied onto a queue and measured by a thread
+ * of its own, so the consumer does not wait for the analysis while it is
+ * decoding the next frames.
+ */
 
 typedef struct
 {
 	ebur128_state* state;
+	char* cache_key;        /**< the key of the results in results_cache, or NULL */
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	mlt_deque queue;        /**< audio buffers waiting to be measured */
+	int running;
+	int thread_started;
 } analyze_data;
 
+typedef struct
+{
+	float* samples;
+	int frames;
+} queued_audio;
+
 typedef struct
 {
 	double in_loudness;
@@ -44,19 +66,188 @@ typedef struct
 	mlt_position last_position;
 } private_data;
 
+/** The results of completed analyses for this process, keyed by what was analyzed.
+ *
+ * This lets another loudness filter over the same audio skip the first pass.
+ */
+
+static pthread_mutex_t results_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static mlt_properties results_cache = NULL;
+
+static void results_cache_close( void *unused )
+{
+	pthread_mutex_lock( &results_cache_mutex );
+	mlt_properties_close( results_cache );
+	results_cache = NULL;
+	pthread_mutex_unlock( &results_cache_mutex );
+}
+
+static char* results_cache_get( const char* key )
+{
+	char* result = NULL;
+	pthread_mutex_lock( &results_cache_mutex );
+	if ( results_cache && mlt_properties_get( results_cache, key ) )
+		result = strdup( mlt_properties_get( results_cache, key ) );
+	pthread_mutex_unlock( &results_cache_mutex );
+	return result;
+}
+
+static void results_cache_put( const char* key, const char* result )
+{
+	pthread_mutex_lock( &results_cache_mutex );
+	if ( !results_cache )
+	{
+		results_cache = mlt_properties_new( );
+		mlt_factory_register_for_clean_up( results_cache, results_cache_close );
+	}
+	mlt_properties_set( results_cache, key, result );
+	pthread_mutex_unlock( &results_cache_mutex );
+}
+
+/** Build the cache key for the analysis that starts with this frame.
+ *
+ * The audio is identified by the resource of the producer, where the filter
+ * starts in it and how long it is. Producers without a resource can not be
+ * told apart, so their results are not cached.
+ */
+
+static char* make_cache_key( mlt_filter filter, mlt_frame frame, int channels, int samplerate )
+{
+	mlt_producer producer = mlt_frame_get_original_producer( frame );
+	const char* service = NULL;
+	const char* resource = NULL;
+	char* key = NULL;
+
+	if ( producer )
+	{
+		service = mlt_properties_get( MLT_PRODUCER_PROPERTIES( producer ), "mlt_service" );
+		resource = mlt_properties_get( MLT_PRODUCER_PROPERTIES( producer ), "resource" );
+	}
+	if ( resource && strcmp( resource, "" ) )
+	{
+		size_t size = strlen( resource ) + ( service ? strlen( service ) : 0 ) + 100;
+		key = malloc( size );
+		if ( key )
+			snprintf( key, size, "%s:%s:%d:%d:%d:%d", service ? service : "", resource,
+				(int) mlt_frame_original_position( frame ), (int) mlt_filter_get_length2( filter, frame ),
+				channels, samplerate );
+	}
+	return key;
+}
+
+static void* analyze_thread( void* arg )
+{
+	analyze_data* analyze = (analyze_data*)arg;
+
+	pthread_mutex_lock( &analyze->mutex );
+	while ( 1 )
+	{
+		queued_audio* audio = mlt_deque_pop_front( analyze->queue );
+		if ( audio )
+		{
+			pthread_cond_broadcast( &analyze->cond );
+			pthread_mutex_unlock( &analyze->mutex );
+			ebur128_add_frames_float( analyze->state, audio->samples, audio->frames );
+			free( audio->samples );
+			free( audio );
+			pthread_mutex_lock( &analyze->mutex );
+		}
+		else if ( analyze->running )
+		{
+			pthread_cond_wait( &analyze->cond, &analyze->mutex );
+		}
+		else
+		{
+			break;
+		}
+	}
+	pthread_mutex_unlock( &analyze->mutex );
+	return NULL;
+}
+
+/** Wait for the analysis thread to measure everything on the queue and finish. */
+
+static void finish_analyze_thread( analyze_data* analyze )
+{
+	if ( analyze->thread_started )
+	{
+		pthread_mutex_lock( &analyze->mutex );
+		analyze->running = 0;
+		pthread_cond_broadcast( &analyze->cond );
+		pthread_mutex_unlock( &analyze->mutex );
+		pthread_join( analyze->thread, NULL );
+		analyze->thread_started = 0;
+	}
+}
+
+/** Measure the audio of a frame, on the analysis thread if there is one. */
+
+static void add_analyze_audio( analyze_data* analyze, float* buffer, int frames, int channels )
+{
+	queued_audio* audio = NULL;
+
+	if ( analyze->thread_started )
+	{
+		audio = malloc( sizeof( queued_audio ) );
+		if ( audio )
+			audio->samples = malloc( frames * channels * sizeof( float ) );
+		if ( audio && !audio->samples )
+		{
+			free( audio );
+			audio = NULL;
+		}
+	}
+	if ( audio )
+	{
+		memcpy( audio->samples, buffer, frames * channels * sizeof( float ) );
+		audio->frames = frames;
+		pthread_mutex_lock( &analyze->mutex );
+		while ( mlt_deque_count( analyze->queue ) >= MAX_QUEUED_BUFFERS )
+			pthread_cond_wait( &analyze->cond, &analyze->mutex );
+		mlt_deque_push_back( analyze->queue, audio );
+		pthread_cond_broadcast( &analyze->cond );
+		pthread_mutex_unlock( &analyze->mutex );
+	}
+	else
+	{
+		// Keep the order of the audio by letting the thread catch up first.
+		finish_analyze_thread( analyze );
+		ebur128_add_frames_float( analyze->state, buffer, frames );
+	}
+}
+
 static void destroy_analyze_data( mlt_filter filter )
 {
 	private_data* private = (private_data*)filter->child;
-	ebur128_destroy( &private->analyze->state );
-	free( private->analyze );
+	analyze_data* analyze = private->analyze;
+	queued_audio* audio;
+
+	finish_analyze_thread( analyze );
+	while ( ( audio = mlt_deque_pop_front( analyze->queue ) ) )
+	{
+		free( audio->samples );
+		free( audio );
+	}
+	mlt_deque_close( analyze->queue );
+	pthread_cond_destroy( &analyze->cond );
+	pthread_mutex_destroy( &analyze->mutex );
+	ebur128_destroy( &analyze->state );
+	free( analyze->cache_key );
+	free( analyze );
 	private->analyze = NULL;
 }
 
 static void init_analyze_data( mlt_filter filter, int channels, int samplerate )
 {
 	private_data* private = (private_data*)filter->child;
-	private->analyze = (analyze_data*)calloc( 1, sizeof(analyze_data) );
-	private->analyze->state = ebur128_init( (unsigned int)channels, (unsigned long)samplerate, EBUR128_MODE_I | EBUR128_MODE_LRA | EBUR128_MODE_SAMPLE_PEAK );
+	analyze_data* analyze = (analyze_data*)calloc( 1, sizeof(analyze_data) );
+	private->analyze = analyze;
+	analyze->state = ebur128_init( (unsigned int)channels, (unsigned long)samplerate, EBUR128_MODE_I | EBUR128_MODE_LRA | EBUR128_MODE_SAMPLE_PEAK );
+	analyze->queue = mlt_deque_init( );
+	pthread_mutex_init( &analyze->mutex, NULL );
+	pthread_cond_init( &analyze->cond, NULL );
+	analyze->running = 1;
+	analyze->thread_started = pthread_create( &analyze->thread, NULL, analyze_thread, analyze ) == 0;
 	private->last_position = 0;
 }
 
@@ -105,11 +296,12 @@ static void analyze( mlt_filter filter, mlt_frame frame, void **buffer, mlt_audi
 	if( !private->analyze && pos == 0 )
 	{
 		init_analyze_data( filter, *channels, *frequency );
+		private->analyze->cache_key = make_cache_key( filter, frame, *channels, *frequency );
 	}
 
 	if( private->analyze )
 	{
-		ebur128_add_frames_float( private->analyze->state, *buffer, *samples );
+		add_analyze_audio( private->analyze, *buffer, *samples, *channels );
 
 		if ( pos + 1 == mlt_filter_get_length2( filter, frame ) )
 		{
@@ -120,6 +312,7 @@ static void analyze( mlt_filter filter, mlt_frame frame, void **buffer, mlt_audi
 			double peak = 0.0;
 			int i = 0;
 			char result[MAX_RESULT_SIZE];
+			finish_analyze_thread( private->analyze );
 			ebur128_loudness_global( private->analyze->state, &loudness );
 			ebur128_loudness_range( private->analyze->state, &range );
 
@@ -136,6 +329,8 @@ static void analyze( mlt_filter filter, mlt_frame frame, void **buffer, mlt_audi
 			result[ MAX_RESULT_SIZE - 1 ] = '\0';
 			mlt_log_info( MLT_FILTER_SERVICE( filter ), "Stored results: %s\n", result );
 			mlt_properties_set( properties, "results", result );
+			if ( private->analyze->cache_key )
+				results_cache_put( private->analyze->cache_key, result );
 			destroy_analyze_data( filter );
 		}
 
@@ -176,6 +371,7 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 {
 	mlt_filter filter = mlt_frame_pop_audio( frame );
 	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	private_data* private = (private_data*)filter->child;
 
 	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
 
@@ -184,6 +380,22 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 	mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
 
 	char* results = mlt_properties_get( properties, "results" );
+	if( !( results && strcmp( results, "" ) ) && mlt_filter_get_position( filter, frame ) == 0 )
+	{
+		// Reuse the results of an earlier analysis of the same audio.
+		char* key = make_cache_key( filter, frame, *channels, *frequency );
+		char* cached = key ? results_cache_get( key ) : NULL;
+		if ( cached )
+		{
+			mlt_log_info( MLT_FILTER_SERVICE( filter ), "Reusing results: %s\n", cached );
+			if ( private->analyze )
+				destroy_analyze_data( filter );
+			mlt_properties_set( properties, "results", cached );
+			results = mlt_properties_get( properties, "results" );
+		}
+		free( cached );
+		free( key );
+	}
 	if( results && strcmp( results, "" ) )
 	{
 		apply( filter, frame, buffer, format, frequency, channels, samples );
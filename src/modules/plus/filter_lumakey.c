@@ -20,6 +20,7 @@
 
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -59,6 +60,31 @@ static void fill_opa_lut(int lgg_lut[], int prelevel, int postlevel, int slope_s
 		lgg_lut[ i ] = postlevel;
 }
 
+#define MIN_SLICE_HEIGHT (16)
+
+struct sliced_desc
+{
+	uint8_t *image;
+	int width, height;
+	int opa_lut[256];
+	// The products of each component with its weight for the visual luma
+	double r_lut[256], g_lut[256], b_lut[256];
+};
+
+static int sliced_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	int start = ctx->height * index / jobs;
+	int end = ctx->height * ( index + 1 ) / jobs;
+	int i = ( end - start ) * ctx->width;
+	uint8_t *sample = ctx->image + start * ctx->width * 4;
+
+	for ( ; i > 0; i--, sample += 4 )
+		sample[3] = ctx->opa_lut[(int) ( ctx->r_lut[sample[0]] + ctx->g_lut[sample[1]] + ctx->b_lut[sample[2]] )];
+	return 0;
+}
+
 /** Do image filtering.
 */
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
@@ -90,25 +116,34 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		int slope_end = clamp( threshold + slope, 0, 255 );
 
 		// Build lut
-		int opa_lut[256];
-		fill_opa_lut( opa_lut, prelevel, postlevel, slope_start, slope_end );
+		struct sliced_desc desc;
+		fill_opa_lut( desc.opa_lut, prelevel, postlevel, slope_start, slope_end );
 
 		// Values for calculating visual luma from RGB
 		double R = 0.3;
 		double G = 0.59;
 		double B = 0.11;
+		int i;
 
-		// Filter
-		int i = *width * *height + 1;
-		uint8_t *sample = *image;
-		uint8_t r, g, b;
-		while ( --i )
+		for ( i = 0; i < 256; i++ )
 		{
-			r = *sample ++;
-			g = *sample ++;
-			b = *sample ++;
-			*sample ++ = opa_lut[(int) (R * r + g * G + b * B) ];
+			desc.r_lut[i] = R * i;
+			desc.g_lut[i] = i * G;
+			desc.b_lut[i] = i * B;
 		}
+
+		// Filter
+		int threads = CLAMP( mlt_properties_get_int( properties, "threads" ), 0, mlt_slices_count_normal() );
+		if ( threads == 0 )
+			threads = mlt_slices_count_normal();
+		threads = CLAMP( threads, 1, MAX( *height / MIN_SLICE_HEIGHT, 1 ) );
+		desc.image = *image;
+		desc.width = *width;
+		desc.height = *height;
+		if ( threads == 1 )
+			sliced_proc( 0, 0, 1, &desc );
+		else
+			mlt_slices_run_normal( threads, sliced_proc, &desc );
 	}
 
 	return error;
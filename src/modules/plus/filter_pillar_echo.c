@@ -63,9 +63,11 @@ static mlt_rect constrain_rect( mlt_rect rect, int max_x, int max_y )
   * \param width the number of values in each row
   * \param height the number of values in each column
   * \param rect the area of interest in the src to be scaled to fit the dst
+  * \param start the first row of the dst to fill
+  * \param end the row after the last row of the dst to fill
   */
 
-static void bilinear_scale_rgba( uint8_t* src, uint8_t* dst, int width, int height, mlt_rect rect )
+static void bilinear_scale_rgba( uint8_t* src, uint8_t* dst, int width, int height, mlt_rect rect, int start, int end )
 {
 	mlt_rect srcRect = rect;
 
@@ -88,7 +90,8 @@ static void bilinear_scale_rgba( uint8_t* src, uint8_t* dst, int width, int heig
 	int linesize = width * 4;
 
 	int y = 0;
-	for ( y = 0; y < height; y++ )
+	dst += start * linesize;
+	for ( y = start; y < end; y++ )
 	{
 		double srcY = srcRect.y + (double)y * srcScale;
 		int srcYindex = floor(srcY);
@@ -172,46 +175,31 @@ static void bilinear_scale_rgba( uint8_t* src, uint8_t* dst, int width, int heig
 	}
 }
 
-/** Perform a box blur from the source to the destination
-  *
-  * src and dst can be the same location
+/** Blur the rows [start, end) of the source horizontally into the destination
   *
-  * This function uses a sliding window accumulator method - applied
-  * horizontally first and then vertically.
+  * This function uses a sliding window accumulator method.
   *
   * \param src a pointer to the source image
   * \param dst a pointer to the destination image
   * \param width the number of values in each row
-  * \param height the number of values in each column
   * \param radius the radius of the box blur operation
+  * \param start the first row to blur
+  * \param end the row after the last row to blur
   */
 
-static void box_blur( uint8_t* src, uint8_t* dst, int width, int height, int radius )
+static void box_blur_rows( uint8_t* src, uint8_t* dst, int width, int radius, int start, int end )
 {
 	int accumulator[] = {0, 0, 0, 0};
 	int x = 0;
 	int y = 0;
 	int step = 4;
 	int linesize = step * width;
-	uint8_t* d = NULL;
-	uint8_t* tmpbuff = mlt_pool_alloc( width * height * step );
-
-	if ( radius > (width / 2) )
-	{
-		radius = width / 2;
-	}
-	if ( radius > (height / 2) )
-	{
-		radius = height / 2;
-	}
-
 	double diameter = (radius * 2) + 1;
 
-	// Horizontal Blur
-	d = tmpbuff;
-	for ( y = 0; y < height; y++ )
+	for ( y = start; y < end; y++ )
 	{
 		uint8_t* first = src + (y * linesize);
+		uint8_t* d = dst + (y * linesize);
 		uint8_t* last = first + linesize - step;
 		uint8_t* s1 = first;
 		uint8_t* s2 = first;
@@ -269,15 +257,35 @@ static void box_blur( uint8_t* src, uint8_t* dst, int width, int height, int rad
 			d += step;
 		}
 	}
+}
 
-	// Vertical Blur
-	for ( x = 0; x < width; x++ )
+/** Blur the columns [start, end) of the source vertically into the destination
+  *
+  * \param src a pointer to the source image
+  * \param dst a pointer to the destination image
+  * \param width the number of values in each row
+  * \param height the number of values in each column
+  * \param radius the radius of the box blur operation
+  * \param start the first column to blur
+  * \param end the column after the last column to blur
+  */
+
+static void box_blur_columns( uint8_t* src, uint8_t* dst, int width, int height, int radius, int start, int end )
+{
+	int accumulator[] = {0, 0, 0, 0};
+	int x = 0;
+	int y = 0;
+	int step = 4;
+	int linesize = step * width;
+	double diameter = (radius * 2) + 1;
+
+	for ( x = start; x < end; x++ )
 	{
-		uint8_t* first = tmpbuff + (x * step);
+		uint8_t* first = src + (x * step);
 		uint8_t* last = first + (linesize * (height - 1));
 		uint8_t* s1 = first;
 		uint8_t* s2 = first;
-		d = dst + (x * step);
+		uint8_t* d = dst + (x * step);
 		accumulator[0] = first[0] * (radius + 1);
 		accumulator[1] = first[1] * (radius + 1);
 		accumulator[2] = first[2] * (radius + 1);
@@ -332,6 +340,85 @@ static void box_blur( uint8_t* src, uint8_t* dst, int width, int height, int rad
 			d += linesize;
 		}
 	}
+}
+
+struct sliced_desc
+{
+	uint8_t *src;
+	uint8_t *dst;
+	int width;
+	int height;
+	mlt_rect rect;
+	int radius;
+};
+
+static int scale_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	bilinear_scale_rgba( ctx->src, ctx->dst, ctx->width, ctx->height, ctx->rect,
+		ctx->height * index / jobs, ctx->height * ( index + 1 ) / jobs );
+	return 0;
+}
+
+static int blur_rows_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	box_blur_rows( ctx->src, ctx->dst, ctx->width, ctx->radius,
+		ctx->height * index / jobs, ctx->height * ( index + 1 ) / jobs );
+	return 0;
+}
+
+static int blur_columns_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	box_blur_columns( ctx->src, ctx->dst, ctx->width, ctx->height, ctx->radius,
+		ctx->width * index / jobs, ctx->width * ( index + 1 ) / jobs );
+	return 0;
+}
+
+static void run_slices( int threads, mlt_slices_proc proc, struct sliced_desc *desc )
+{
+	if ( threads == 1 )
+		proc( 0, 0, 1, desc );
+	else
+		mlt_slices_run_normal( threads, proc, desc );
+}
+
+/** Perform a box blur from the source to the destination
+  *
+  * src and dst can be the same location
+  *
+  * The rows are blurred horizontally first and then the columns vertically.
+  *
+  * \param src a pointer to the source image
+  * \param dst a pointer to the destination image
+  * \param width the number of values in each row
+  * \param height the number of values in each column
+  * \param radius the radius of the box blur operation
+  * \param threads the number of slices to use, 0 for all
+  */
+
+static void box_blur( uint8_t* src, uint8_t* dst, int width, int height, int radius, int threads )
+{
+	uint8_t* tmpbuff = mlt_pool_alloc( width * height * 4 );
+
+	if ( radius > (width / 2) )
+	{
+		radius = width / 2;
+	}
+	if ( radius > (height / 2) )
+	{
+		radius = height / 2;
+	}
+
+	struct sliced_desc desc = { src, tmpbuff, width, height, { 0 }, radius };
+	run_slices( threads, blur_rows_proc, &desc );
+	desc.src = tmpbuff;
+	desc.dst = dst;
+	run_slices( threads, blur_columns_proc, &desc );
 
 	mlt_pool_release( tmpbuff );
 }
@@ -413,8 +500,10 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	int size = mlt_image_format_size( *format, *width, *height, NULL );
 	uint8_t* dst = mlt_pool_alloc( size );
 
-	bilinear_scale_rgba( *image, dst, *width, *height, rect );
-	box_blur( dst, dst, *width, *height, blur );
+	int threads = CLAMP( mlt_properties_get_int( filter_properties, "threads" ), 0, mlt_slices_count_normal() );
+	struct sliced_desc desc = { *image, dst, *width, *height, rect, 0 };
+	run_slices( threads, scale_proc, &desc );
+	box_blur( dst, dst, *width, *height, blur, threads );
 	blit_rect( *image, dst, *width, rect );
 
 	*image = dst;
@@ -29,7 +29,7 @@
 
 /** Fill channel lut with integers parsed from property string.
 */
-static void fill_channel_lut(int lut[], char* channel_table_str)
+static void fill_channel_lut(uint8_t lut[], char* channel_table_str)
 {
 	mlt_tokeniser tokeniser = mlt_tokeniser_init();
 	mlt_tokeniser_parse_new( tokeniser, channel_table_str, ";" );
@@ -65,39 +65,23 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	// Get the image
 	mlt_filter filter = mlt_frame_pop_service( frame );
 
-	*format = mlt_image_rgb;
-	int error = mlt_frame_get_image( frame, image, format, width, height, 0 );
-
-	// Only process if we have no error and a valid colour space
-	if ( error == 0 )
-	{
+	// Create lut tables from properties for each RGB channel
+	char* r_str = mlt_properties_get( MLT_FILTER_PROPERTIES( filter ), "R_table" );
+	uint8_t r_lut[256];
+	fill_channel_lut( r_lut, r_str );
 
-		// Create lut tables from properties for each RGB channel
-		char* r_str = mlt_properties_get( MLT_FILTER_PROPERTIES( filter ), "R_table" );
-		int r_lut[256];
-		fill_channel_lut( r_lut, r_str );
+	char* g_str = mlt_properties_get( MLT_FILTER_PROPERTIES( filter ), "G_table" );
+	uint8_t g_lut[256];
+	fill_channel_lut( g_lut, g_str );
 
-		char* g_str = mlt_properties_get( MLT_FILTER_PROPERTIES( filter ), "G_table" );
-		int g_lut[256];
-		fill_channel_lut( g_lut, g_str );
+	char* b_str = mlt_properties_get( MLT_FILTER_PROPERTIES( filter ), "B_table" );
+	uint8_t b_lut[256];
+	fill_channel_lut( b_lut, b_str );
 
-		char* b_str = mlt_properties_get( MLT_FILTER_PROPERTIES( filter ), "B_table" );
-		int b_lut[256];
-		fill_channel_lut( b_lut, b_str );
-
-		// Apply look-up tables into image
-		int i = *width * *height + 1;
-		uint8_t *p = *image;
-		uint8_t *r = *image;
-		while ( --i )
-		{
-			*p ++ = r_lut[ *r ++ ];
-			*p ++ = g_lut[ *r ++ ];
-			*p ++ = b_lut[ *r ++ ];
-		}
-	}
-
-	return error;
+	// Apply look-up tables into image
+	const uint8_t *luts[MLT_IMAGE_MAX_PLANES] = { r_lut, g_lut, b_lut, NULL };
+	*format = mlt_image_rgb;
+	return mlt_frame_get_image_lut( frame, image, format, width, height, luts );
 }
 
 /** Filter processing.
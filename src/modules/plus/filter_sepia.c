@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 /** Do it :-).
 */
@@ -35,44 +36,19 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	mlt_position position = mlt_filter_get_position( filter, frame );
 	mlt_position length = mlt_filter_get_length2( filter, frame );
 
-	// Get the image
-	*format = mlt_image_yuv422;
-	int error = mlt_frame_get_image( frame, image, format, width, height, 1 );
-
-	// Only process if we have no error and a valid colour space
-	if ( error == 0 && *image )
-	{
-		// We modify the whole image
-		uint8_t *p = *image;
-		int h = *height;
-		int uneven = *width % 2;
-		int w = ( *width - uneven ) / 2;
-		int t;
+	// Get u and v values
+	int u = mlt_properties_anim_get_int( properties, "u", position, length );
+	int v = mlt_properties_anim_get_int( properties, "v", position, length );
 
-		// Get u and v values
-		int u = mlt_properties_anim_get_int( properties, "u", position, length );
-		int v = mlt_properties_anim_get_int( properties, "v", position, length );
+	// Replace the chroma of the whole image
+	uint8_t u_lut[ 256 ], v_lut[ 256 ];
+	const uint8_t *luts[ MLT_IMAGE_MAX_PLANES ] = { NULL, u_lut, v_lut, NULL };
+	memset( u_lut, ( uint8_t )u, sizeof( u_lut ) );
+	memset( v_lut, ( uint8_t )v, sizeof( v_lut ) );
 
-		// Loop through image
-		while( h -- )
-		{
-			t = w;
-			while( t -- )
-			{
-				p ++;
-				*p ++ = u;
-				p ++;
-				*p ++ = v;
-			}
-			if ( uneven )
-			{
-				p ++;
-				*p ++ = u;
-			}
-		}
-	}
-
-	return error;
+	// Get the image
+	*format = mlt_image_yuv422;
+	return mlt_frame_get_image_lut( frame, image, format, width, height, luts );
 }
 
 /** Filter processing.
@@ -20,9 +20,12 @@
  */
 
 #include <framework/mlt.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <framework/mlt_factory.h>
 #include <framework/mlt_frame.h>
+#include <framework/mlt_luma_map.h>
 #include <framework/mlt_producer.h>
 
 static inline double smoothstep( const double e1, const double e2, const double a )
@@ -33,6 +36,179 @@ static inline double smoothstep( const double e1, const double e2, const double
     return ( v * v * ( 3 - 2 * v ) );
 }
 
+enum shape_mode
+{
+	shape_alpha_mix,      // mix with the alpha of the mask
+	shape_alpha_copy,     // copy the alpha of the mask
+	shape_luma_copy,      // copy the luma of the mask
+	shape_luma_mix        // mix with the luma of the mask
+};
+
+struct sliced_desc
+{
+	uint8_t *alpha;
+	uint8_t *mask;        // the alpha or the yuv422 image of the mask
+	uint16_t *map;        // or the alpha or luma of the mask from the cache
+	int size;
+	enum shape_mode mode;
+	double softness;
+	double mix;
+	int invert;
+	double offset;
+	double divisor;
+};
+
+static int sliced_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	int start = (int) ( (int64_t) ctx->size * index / jobs );
+	int size = (int) ( (int64_t) ctx->size * ( index + 1 ) / jobs ) - start;
+	uint8_t *p = ctx->alpha + start;
+	const uint16_t *m = ctx->map ? ctx->map + start : NULL;
+	double softness = ctx->softness;
+	double mix = ctx->mix;
+	int invert = ctx->invert;
+	double a = 0;
+	double b = 0;
+
+	if ( ctx->mode == shape_alpha_mix )
+	{
+		uint8_t *q = ctx->mask + start;
+		while( size -- )
+		{
+			a = ( double )( m ? *m ++ >> 8 : *q ++ ) / 255.0;
+			b = 1.0 - smoothstep( a, a + softness, mix );
+			*p = ( uint8_t )( *p * b ) ^ invert;
+			p ++;
+		}
+	}
+	else if ( ctx->mode == shape_alpha_copy )
+	{
+		if ( m )
+			while( size -- )
+				*p ++ = *m ++ >> 8;
+		else
+			memcpy( p, ctx->mask + start, size );
+	}
+	else if ( ctx->mode == shape_luma_copy )
+	{
+		// Do not apply threshold filter.
+		uint8_t *q = ctx->mask + start * 2;
+		while( size -- )
+		{
+			*p = m ? *m ++ >> 8 : *q;
+			p++;
+			q += 2;
+		}
+	}
+	else
+	{
+		uint8_t *q = ctx->mask + start * 2;
+		while( size -- )
+		{
+			a = ( ( double )( m ? *m ++ >> 8 : *q ) - ctx->offset ) / ctx->divisor;
+			b = smoothstep( a, a + softness, mix );
+			*p = ( uint8_t )( *p * b ) ^ invert;
+			p ++;
+			q += 2;
+		}
+	}
+	return 0;
+}
+
+/** Get the name of the scaled mask in the cache of luma maps.
+ *
+ * The name holds everything the scaled mask depends upon, so that it is shared
+ * by the filters that use the same file at the same size.
+ * \return the name to free() or NULL if the mask may change between frames
+ */
+
+static char *mask_cache_key( mlt_filter filter, mlt_frame frame, int width, int height, int use_luminance )
+{
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	const char *resource = mlt_properties_get( properties, "_mask_resource" );
+	const char *interp = mlt_properties_get( MLT_FRAME_PROPERTIES( frame ), "rescale.interp" );
+	const char *trc = mlt_properties_get( MLT_FRAME_PROPERTIES( frame ), "consumer_color_trc" );
+	int count = mlt_properties_count( properties );
+	size_t size;
+	int i;
+
+	if ( !resource || !mlt_properties_get_int( properties, "_mask_static" ) )
+		return NULL;
+
+	// The producer.* properties can change the image of the mask
+	size = strlen( resource ) + 128 + ( interp ? strlen( interp ) : 0 ) + ( trc ? strlen( trc ) : 0 );
+	for ( i = 0; i < count; i++ )
+	{
+		const char *name = mlt_properties_get_name( properties, i );
+		const char *value = mlt_properties_get_value( properties, i );
+		if ( name && value && !strncmp( name, "producer.", 9 ) )
+			size += strlen( name ) + strlen( value ) + 2;
+	}
+	char *key = malloc( size );
+	if ( !key )
+		return NULL;
+	int n = snprintf( key, size, "shape %s %dx%d %s %s %s", resource, width, height,
+		use_luminance ? "luma" : "alpha", interp ? interp : "", trc ? trc : "" );
+	for ( i = 0; i < count; i++ )
+	{
+		const char *name = mlt_properties_get_name( properties, i );
+		const char *value = mlt_properties_get_value( properties, i );
+		if ( name && value && !strncmp( name, "producer.", 9 ) )
+			n += snprintf( key + n, size - n, " %s=%s", name, value );
+	}
+	return key;
+}
+
+/** Get the alpha or the luma of the mask, scaled to the frame, from the cache of luma maps.
+ *
+ * The 8-bit values are kept at full 16-bit range, as in the other luma maps.
+ * \return a cache item to close with mlt_cache_item_close() or NULL if the mask is not cached
+ */
+
+static mlt_cache_item mask_cache_get( const char *key, mlt_frame mask, int width, int height, int use_luminance, uint16_t **map )
+{
+	int map_width = 0, map_height = 0;
+	mlt_cache_item item = mlt_luma_map_cache_get( key, map, &map_width, &map_height );
+
+	if ( item && ( map_width != width || map_height != height ) )
+	{
+		mlt_cache_item_close( item );
+		item = NULL;
+	}
+	if ( !item )
+	{
+		uint8_t *image = NULL;
+		mlt_image_format format = mlt_image_yuv422;
+		int size = width * height;
+
+		if ( mlt_frame_get_image( mask, &image, &format, &width, &height, 0 ) != 0 || width * height != size )
+			return NULL;
+		uint8_t *alpha = use_luminance ? NULL : mlt_frame_get_alpha( mask );
+		uint16_t *p = mlt_pool_alloc( size * sizeof( *p ) );
+		if ( !p )
+			return NULL;
+		*map = p;
+		if ( use_luminance )
+			while ( size -- )
+			{
+				*p ++ = *image * 257;
+				image += 2;
+			}
+		else if ( alpha )
+			while ( size -- )
+				*p ++ = *alpha ++ * 257;
+		else
+			while ( size -- )
+				*p ++ = 0xffff;
+		map_width = width;
+		map_height = height;
+		item = mlt_luma_map_cache_put( key, map, &map_width, &map_height );
+	}
+	return item;
+}
+
 /** Get the images and apply the luminance of the mask to the alpha of the frame.
 */
 
@@ -66,11 +242,15 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		mlt_properties_set_int( MLT_FRAME_PROPERTIES( mask ), "distort", 1 );
 		mlt_properties_pass_list( MLT_FRAME_PROPERTIES( mask ), MLT_FRAME_PROPERTIES( frame ), "consumer_deinterlace, deinterlace_method, rescale.interp, consumer_tff, consumer_color_trc" );
 
-		if ( mlt_frame_get_image( mask, &mask_img, &mask_fmt, width, height, 0 ) == 0 )
+		// A still mask is only scaled and converted once for all frames
+		char *key = mask_cache_key( filter, frame, *width, *height, use_luminance );
+		uint16_t *map = NULL;
+		mlt_cache_item item = key ? mask_cache_get( key, mask, *width, *height, use_luminance, &map ) : NULL;
+		free( key );
+
+		if ( item || mlt_frame_get_image( mask, &mask_img, &mask_fmt, width, height, 0 ) == 0 )
 		{
-			int size = *width * *height;
-			double a = 0;
-			double b = 0;
+			struct sliced_desc desc = { NULL, mask_img, item ? map : NULL, *width * *height, shape_luma_mix, softness, mix, invert, 0.0, 1.0 };
 			uint8_t* p = mlt_frame_get_alpha( frame );
 			if ( !p )
 			{
@@ -79,8 +259,13 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 				memset( p, 255, alphasize );
 				mlt_frame_set_alpha( frame, p, alphasize, mlt_pool_release );
 			}
+			desc.alpha = p;
 
-			if ( !use_luminance )
+			if ( !use_luminance && item )
+			{
+				desc.mode = use_mix ? shape_alpha_mix : shape_alpha_copy;
+			}
+			else if ( !use_luminance )
 			{
 				uint8_t* q = mlt_frame_get_alpha( mask );
 				if ( !q )
@@ -90,56 +275,59 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 					memset( q, 255, alphasize );
 					mlt_frame_set_alpha( mask, q, alphasize, mlt_pool_release );
 				}
-				if ( use_mix )
-				{
-					while( size -- )
-					{
-						a = ( double )*q ++ / 255.0;
-						b = 1.0 - smoothstep( a, a + softness, mix );
-						*p = ( uint8_t )( *p * b ) ^ invert;
-						p ++;
-					}
-				}
-				else
-				{
-					while( size -- )
-						*p++ = *q++;
-				}
+				desc.mask = q;
+				desc.mode = use_mix ? shape_alpha_mix : shape_alpha_copy;
 			}
 			else if ( !use_mix )
 			{
-				// Do not apply threshold filter.
-				uint8_t *q = mask_img;
-				while( size -- )
-				{
-					*p = *q;
-					p++;
-					q += 2;
-				}
+				desc.mode = shape_luma_copy;
 			}
-			else if ( (int) mix != 1 || invert == 255 )
+			else
 			{
 				int full_range = mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "full_luma" );
-				double offset = full_range ? 0.0 : 16.0;
-				double divisor = full_range ? 255.0 : 235.0;
-				uint8_t *q = mask_img;
+				desc.offset = full_range ? 0.0 : 16.0;
+				desc.divisor = full_range ? 255.0 : 235.0;
 				// Ensure softness tends to zero as mix tends to 1
-				softness *= ( 1.0 - mix );
-				while( size -- )
-				{
-					a = ( ( double ) *q - offset ) / divisor;
-					b = smoothstep( a, a + softness, mix );
-					*p = ( uint8_t )( *p * b ) ^ invert;
-					p ++;
-					q += 2;
-				}
+				desc.softness *= ( 1.0 - mix );
 			}
+
+			int threads = CLAMP( mlt_properties_get_int( MLT_FILTER_PROPERTIES( filter ), "threads" ), 0, mlt_slices_count_normal() );
+			if ( threads == 1 )
+				sliced_proc( 0, 0, 1, &desc );
+			else
+				mlt_slices_run_normal( threads, sliced_proc, &desc );
 		}
+		mlt_cache_item_close( item );
 	}
 
 	return 0;
 }
 
+/** Determine whether a resource is an image file that is the same for every frame.
+ *
+ * Image sequences and producer URLs do not name a file and are not still images.
+ */
+
+static int is_still_image( const char *resource )
+{
+	static const char *extensions[] = { ".pgm", ".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".webp", NULL };
+	const char *extension = strrchr( resource, '.' );
+	int i;
+
+	if ( !extension || strchr( extension, '/' ) )
+		return 0;
+	for ( i = 0; extensions[i]; i++ )
+		if ( !strcasecmp( extension, extensions[i] ) )
+			break;
+	if ( !extensions[i] )
+		return 0;
+
+	FILE *test = mlt_fopen( resource, "r" );
+	if ( test )
+		fclose( test );
+	return test != NULL;
+}
+
 /** Filter processing.
 */
 
@@ -189,6 +377,10 @@ static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
 		producer = mlt_factory_producer( profile, NULL, resource );
 		if ( producer != NULL )
 			mlt_properties_set( MLT_PRODUCER_PROPERTIES( producer ), "eof", "loop" );
+		mlt_properties_set( MLT_FILTER_PROPERTIES( filter ), "_mask_resource", resource );
+		mlt_properties_set_int( MLT_FILTER_PROPERTIES( filter ), "_mask_static",
+			mlt_properties_get( MLT_FILTER_PROPERTIES( filter ), "cache" ) ?
+			mlt_properties_get_int( MLT_FILTER_PROPERTIES( filter ), "cache" ) : is_still_image( resource ) );
 		mlt_properties_set_data( MLT_FILTER_PROPERTIES( filter ), "instance", producer, 0, ( mlt_destructor )mlt_producer_close, NULL );
 	}
 
@@ -89,14 +89,17 @@ static mlt_rect constrain_rect( mlt_rect rect, int max_x, int max_y )
   * \param rowCount the number of values in each line (row)
   * \param step the space between values in each line
   * \param rect the area to be removed
+  * \param index the slice of the rows of the rect to remove
+  * \param jobs the number of slices
   */
-static void remove_spot_channel( uint8_t *chan, int rowCount, int step, mlt_rect rect )
+static void remove_spot_channel( uint8_t *chan, int rowCount, int step, mlt_rect rect, int index, int jobs )
 {
-	int yStop = rect.y + rect.h;
+	int yStart = rect.y + (int) rect.h * index / jobs;
+	int yStop = rect.y + (int) rect.h * ( index + 1 ) / jobs;
 	int xStop = rect.x + rect.w;
 	int rowSize = rowCount * step;
 	int y;
-	for ( y = rect.y; y < yStop; y++ )
+	for ( y = yStart; y < yStop; y++ )
 	{
 		uint8_t* xValueL = chan + ( y * rowSize ) + ( ( (int)rect.x - 1 ) * step );
 		uint8_t* xValueR = xValueL + ( (int)rect.w * step );
@@ -118,6 +121,45 @@ static void remove_spot_channel( uint8_t *chan, int rowCount, int step, mlt_rect
 	}
 }
 
+/** The channels to remove the spot from. */
+
+struct sliced_desc
+{
+	int count;
+	struct
+	{
+		uint8_t *chan;
+		int rowCount;
+		int step;
+		mlt_rect rect;
+	} channels[5];
+};
+
+static void add_channel( struct sliced_desc *desc, uint8_t *chan, int rowCount, int step, mlt_rect rect )
+{
+	desc->channels[ desc->count ].chan = chan;
+	desc->channels[ desc->count ].rowCount = rowCount;
+	desc->channels[ desc->count ].step = step;
+	desc->channels[ desc->count ].rect = rect;
+	desc->count++;
+}
+
+/** Remove the spot from a slice of the rows of each channel.
+  *
+  * A value is only interpolated from values outside of the rect, which are
+  * never changed, so the rows do not depend on each other.
+  */
+static int sliced_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	int i;
+	for ( i = 0; i < ctx->count; i++ )
+		remove_spot_channel( ctx->channels[i].chan, ctx->channels[i].rowCount, ctx->channels[i].step,
+							 ctx->channels[i].rect, index, jobs );
+	return 0;
+}
+
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
 	int error = 0;
@@ -171,40 +213,42 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	struct mlt_image_s img;
 	mlt_image_set_values( &img, *image, *format, *width, *height );
 
+	struct sliced_desc desc;
+	desc.count = 0;
 	int i;
 	switch( *format )
 	{
 		case mlt_image_rgba:
 			for ( i = 0; i < 4; i++ )
 			{
-				remove_spot_channel( img.planes[0] + i, img.width, 4, rect );
+				add_channel( &desc, img.planes[0] + i, img.width, 4, rect );
 			}
 			break;
 		case mlt_image_rgb:
 			for ( i = 0; i < 3; i++ )
 			{
-				remove_spot_channel( img.planes[0] + i, img.width, 3, rect );
+				add_channel( &desc, img.planes[0] + i, img.width, 3, rect );
 			}
 			break;
 		case mlt_image_yuv422:
 			// Y
-			remove_spot_channel( img.planes[0], img.width, 2, rect );
+			add_channel( &desc, img.planes[0], img.width, 2, rect );
 			// U
-			remove_spot_channel( img.planes[0] + 1, img.width / 2, 4,
-								 constrain_rect( scale_rect( rect, 2, 1 ), img.width / 2, img.height ) );
+			add_channel( &desc, img.planes[0] + 1, img.width / 2, 4,
+						 constrain_rect( scale_rect( rect, 2, 1 ), img.width / 2, img.height ) );
 			// V
-			remove_spot_channel( img.planes[0] + 3, img.width / 2, 4,
-								 constrain_rect( scale_rect( rect, 2, 1 ), img.width / 2, img.height ) );
+			add_channel( &desc, img.planes[0] + 3, img.width / 2, 4,
+						 constrain_rect( scale_rect( rect, 2, 1 ), img.width / 2, img.height ) );
 			break;
 		case mlt_image_yuv420p:
 			// Y
-			remove_spot_channel( img.planes[0], img.width, 1, rect );
+			add_channel( &desc, img.planes[0], img.width, 1, rect );
 			// U
-			remove_spot_channel( img.planes[1], img.width / 2, 1,
-								 constrain_rect( scale_rect( rect, 2, 2 ), img.width / 2, img.height / 2 ) );
+			add_channel( &desc, img.planes[1], img.width / 2, 1,
+						 constrain_rect( scale_rect( rect, 2, 2 ), img.width / 2, img.height / 2 ) );
 			// V
-			remove_spot_channel( img.planes[2], img.width / 2, 1,
-								 constrain_rect( scale_rect( rect, 2, 2 ), img.width / 2, img.height / 2 ) );
+			add_channel( &desc, img.planes[2], img.width / 2, 1,
+						 constrain_rect( scale_rect( rect, 2, 2 ), img.width / 2, img.height / 2 ) );
 			break;
 		default:
 			return 1;
@@ -213,9 +257,15 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	uint8_t *alpha = mlt_frame_get_alpha( frame );
 	if ( alpha && *format != mlt_image_rgba )
 	{
-		remove_spot_channel( alpha, *width, 1, rect );
+		add_channel( &desc, alpha, *width, 1, rect );
 	}
 
+	int threads = CLAMP( mlt_properties_get_int( filter_properties, "threads" ), 0, mlt_slices_count_normal() );
+	if ( threads == 1 )
+		sliced_proc( 0, 0, 1, &desc );
+	else
+		mlt_slices_run_normal( threads, sliced_proc, &desc );
+
 	return error;
 }
 
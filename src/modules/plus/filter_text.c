@@ -109,7 +109,10 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		setup_producer( producer, properties );
 		setup_transition( filter, transition, frame, properties );
 	}
-	mlt_properties_set_string( MLT_PRODUCER_PROPERTIES( producer ), "text", argument );
+	// Only change the text when it differs so that the producer can keep its rendering.
+	char* text = mlt_properties_get( MLT_PRODUCER_PROPERTIES( producer ), "text" );
+	if ( !text || strcmp( text, argument ) )
+		mlt_properties_set_string( MLT_PRODUCER_PROPERTIES( producer ), "text", argument );
 
 	// Make sure the producer is in the correct position
 	position = mlt_filter_get_position( filter, frame );
@@ -32,29 +32,41 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 {
 	mlt_filter filter = mlt_frame_pop_service(frame);
 
+	mlt_properties properties = mlt_filter_properties(filter);
+	mlt_position position = mlt_filter_get_position(filter, frame);
+	mlt_position length = mlt_filter_get_length2(filter, frame);
+	int midpoint = mlt_properties_anim_get_int(properties, "midpoint", position, length);
+	int use_alpha = mlt_properties_get_int(properties, "use_alpha");
+	int invert = mlt_properties_get_int(properties, "invert");
+	int full_luma = mlt_properties_get_int(MLT_FRAME_PROPERTIES(frame), "full_luma");
+	uint8_t white = full_luma? 255 : 235;
+	uint8_t black = full_luma? 0 : 16;
+	uint8_t A = invert? white : black;
+	uint8_t B = invert? black : white;
+
 	// Render the frame
 	*format = mlt_image_yuv422;
-	if ( mlt_frame_get_image( frame, image, format, width, height, writable ) == 0 )
+	if ( !use_alpha )
+	{
+		// The luma alone decides, so it is a lookup table
+		uint8_t luma[256], chroma[256];
+		const uint8_t *luts[MLT_IMAGE_MAX_PLANES] = { luma, chroma, chroma, NULL };
+		for ( int i = 0; i < 256; i++ )
+			luma[i] = i < midpoint? A : B;
+		memset( chroma, 128, sizeof(chroma) );
+		mlt_frame_get_image_lut( frame, image, format, width, height, luts );
+	}
+	else if ( mlt_frame_get_image( frame, image, format, width, height, 1 ) == 0 )
 	{
-		mlt_properties properties = mlt_filter_properties(filter);
-		mlt_position position = mlt_filter_get_position(filter, frame);
-		mlt_position length = mlt_filter_get_length2(filter, frame);
-		int midpoint = mlt_properties_anim_get_int(properties, "midpoint", position, length);
-		int use_alpha = mlt_properties_get_int(properties, "use_alpha");
-		int invert = mlt_properties_get_int(properties, "invert");
-		int full_luma = mlt_properties_get_int(MLT_FRAME_PROPERTIES(frame), "full_luma");
-		uint8_t white = full_luma? 255 : 235;
-		uint8_t black = full_luma? 0 : 16;
 		uint8_t *p = *image;
-		uint8_t A = invert? white : black;
-		uint8_t B = invert? black : white;
 		int size = *width * *height + 1;
+		uint8_t *alpha = mlt_frame_get_alpha( frame );
 
-		if ( !use_alpha )
+		if ( alpha )
 		{
 			while (--size)
 			{
-				if ( *p < midpoint )
+				if ( *alpha ++ < midpoint )
 					*p ++ = A;
 				else
 					*p ++ = B;
@@ -63,25 +75,10 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		}
 		else
 		{
-			uint8_t *alpha = mlt_frame_get_alpha( frame );
-			if ( alpha )
-			{
-				while (--size)
-				{
-					if ( *alpha ++ < midpoint )
-						*p ++ = A;
-					else
-						*p ++ = B;
-					*p ++ = 128;
-				}
-			}
-			else
+			while (--size)
 			{
-				while (--size)
-				{
-					*p ++ = B;
-					*p ++ = 128;
-				}
+				*p ++ = B;
+				*p ++ = 128;
 			}
 		}
 	}
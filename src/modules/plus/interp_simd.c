@@ -0,0 +1,385 @@
+/*
+ * interp_simd.c -- vectorised samplers for transition_affine
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "interp_simd.h"
+
+#include <framework/mlt_cpu.h>
+
+#include <pthread.h>
+#include <string.h>
+
+// The kernels do the float operations of interpBL_b32 and interpBC_b32 in the same
+// order, so they give the same results. Stores to a byte take the low 8 bits of the
+// truncated 32-bit integer like the scalar conversions do. Groups of pixels that would
+// leave the destination unchanged because the source is fully transparent there are
+// skipped once their alpha is known.
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) ) && defined(__SSE2__)
+#define USE_X86_SIMD 1
+#include <immintrin.h>
+
+// Bicubic interpolation weights in the order they are used by neville4
+#define BICUBIC_WEIGHTS 6
+static const int bicubic_i[ BICUBIC_WEIGHTS ] = { 3, 2, 1, 3, 2, 3 };
+static const int bicubic_j[ BICUBIC_WEIGHTS ] = { 1, 1, 1, 2, 2, 3 };
+
+__attribute__((target("sse4.1")))
+static inline __m128i gather_sse41( const uint8_t *src, __m128i index )
+{
+	int32_t i[4];
+	uint32_t t[4];
+	_mm_storeu_si128( (__m128i*) i, index );
+	memcpy( &t[0], src + 4 * (size_t) i[0], 4 );
+	memcpy( &t[1], src + 4 * (size_t) i[1], 4 );
+	memcpy( &t[2], src + 4 * (size_t) i[2], 4 );
+	memcpy( &t[3], src + 4 * (size_t) i[3], 4 );
+	return _mm_loadu_si128( (const __m128i*) t );
+}
+
+#define CHANNEL_SSE41( t, c ) _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( t, 8 * ( c ) ), _mm_set1_epi32( 255 ) ) )
+
+__attribute__((target("sse4.1")))
+static inline __m128i to_byte_sse41( __m128 v )
+{
+	return _mm_and_si128( _mm_cvttps_epi32( v ), _mm_set1_epi32( 255 ) );
+}
+
+/** Mix the interpolated channels into 4 destination pixels, returning them. */
+
+__attribute__((target("sse4.1")))
+static inline __m128i mix_sse41( __m128i d, const __m128 *value, __m128 alpha_sl, __m128 alpha_v, int is_atop )
+{
+	const __m128 one = _mm_set1_ps( 1.0f );
+	__m128 alpha = _mm_sub_ps( _mm_add_ps( alpha_sl, alpha_v ), _mm_mul_ps( alpha_sl, alpha_v ) );
+	__m128i out = _mm_slli_epi32( is_atop ? to_byte_sse41( value[3] ) : to_byte_sse41( _mm_mul_ps( _mm_set1_ps( 255.0f ), alpha ) ), 24 );
+	alpha = _mm_div_ps( alpha_sl, alpha );
+	__m128 inverse = _mm_sub_ps( one, alpha );
+	out = _mm_or_si128( out, to_byte_sse41( _mm_add_ps( _mm_mul_ps( CHANNEL_SSE41( d, 0 ), inverse ), _mm_mul_ps( value[0], alpha ) ) ) );
+	out = _mm_or_si128( out, _mm_slli_epi32( to_byte_sse41( _mm_add_ps( _mm_mul_ps( CHANNEL_SSE41( d, 1 ), inverse ), _mm_mul_ps( value[1], alpha ) ) ), 8 ) );
+	out = _mm_or_si128( out, _mm_slli_epi32( to_byte_sse41( _mm_add_ps( _mm_mul_ps( CHANNEL_SSE41( d, 2 ), inverse ), _mm_mul_ps( value[2], alpha ) ) ), 16 ) );
+	return out;
+}
+
+/** Whether mixing with alpha_sl would leave all of the pixels as they are. */
+
+__attribute__((target("sse4.1")))
+static inline int unchanged_sse41( __m128 alpha_sl, __m128 alpha_v, int is_atop )
+{
+	__m128 zero = _mm_setzero_ps();
+	return !is_atop && _mm_movemask_ps( _mm_cmpneq_ps( alpha_sl, zero ) ) == 0
+		&& _mm_movemask_ps( _mm_cmpeq_ps( alpha_v, zero ) ) == 0;
+}
+
+__attribute__((target("sse4.1")))
+static int bilinear_sse41( const uint8_t *src, int w, int h, const float *x, const float *y,
+	int count, float o, uint8_t *dest, int is_atop )
+{
+	const __m128 scale = _mm_set1_ps( 255.0f );
+	const __m128 opacity = _mm_set1_ps( o );
+	int i;
+
+	for ( i = 0; i + 4 <= count; i += 4, dest += 16 )
+	{
+		__m128 xv = _mm_loadu_ps( x + i );
+		__m128 yv = _mm_loadu_ps( y + i );
+		__m128i m = _mm_min_epi32( _mm_cvttps_epi32( _mm_floor_ps( xv ) ), _mm_set1_epi32( w - 2 ) );
+		__m128i n = _mm_min_epi32( _mm_cvttps_epi32( _mm_floor_ps( yv ) ), _mm_set1_epi32( h - 2 ) );
+		__m128 fx = _mm_sub_ps( xv, _mm_cvtepi32_ps( m ) );
+		__m128 fy = _mm_sub_ps( yv, _mm_cvtepi32_ps( n ) );
+		__m128i k = _mm_add_epi32( _mm_mullo_epi32( n, _mm_set1_epi32( w ) ), m );
+		__m128i l = _mm_add_epi32( k, _mm_set1_epi32( w ) );
+		__m128i t00 = gather_sse41( src, k );
+		__m128i t01 = gather_sse41( src, _mm_add_epi32( k, _mm_set1_epi32( 1 ) ) );
+		__m128i t10 = gather_sse41( src, l );
+		__m128i t11 = gather_sse41( src, _mm_add_epi32( l, _mm_set1_epi32( 1 ) ) );
+		__m128i d = _mm_loadu_si128( (const __m128i*) dest );
+		__m128 value[4];
+
+#define BILINEAR_SSE41( c ) \
+		{ \
+			__m128 s00 = CHANNEL_SSE41( t00, c ), s10 = CHANNEL_SSE41( t10, c ); \
+			__m128 a = _mm_add_ps( s00, _mm_mul_ps( _mm_sub_ps( CHANNEL_SSE41( t01, c ), s00 ), fx ) ); \
+			__m128 b = _mm_add_ps( s10, _mm_mul_ps( _mm_sub_ps( CHANNEL_SSE41( t11, c ), s10 ), fx ) ); \
+			value[c] = _mm_add_ps( a, _mm_mul_ps( _mm_sub_ps( b, a ), fy ) ); \
+		}
+
+		BILINEAR_SSE41( 3 )
+		__m128 alpha_v = _mm_div_ps( CHANNEL_SSE41( d, 3 ), scale );
+		__m128 alpha_sl = _mm_mul_ps( _mm_div_ps( value[3], scale ), opacity );
+		if ( unchanged_sse41( alpha_sl, alpha_v, is_atop ) )
+			continue;
+		BILINEAR_SSE41( 0 )
+		BILINEAR_SSE41( 1 )
+		BILINEAR_SSE41( 2 )
+#undef BILINEAR_SSE41
+		_mm_storeu_si128( (__m128i*) dest, mix_sse41( d, value, alpha_sl, alpha_v, is_atop ) );
+	}
+	return i;
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 neville4_sse41( __m128 p0, __m128 p1, __m128 p2, __m128 p3, const __m128 *k )
+{
+	p3 = _mm_add_ps( p3, _mm_mul_ps( k[0], _mm_sub_ps( p3, p2 ) ) );
+	p2 = _mm_add_ps( p2, _mm_mul_ps( k[1], _mm_sub_ps( p2, p1 ) ) );
+	p1 = _mm_add_ps( p1, _mm_mul_ps( k[2], _mm_sub_ps( p1, p0 ) ) );
+	p3 = _mm_add_ps( p3, _mm_mul_ps( k[3], _mm_sub_ps( p3, p2 ) ) );
+	p2 = _mm_add_ps( p2, _mm_mul_ps( k[4], _mm_sub_ps( p2, p1 ) ) );
+	return _mm_add_ps( p3, _mm_mul_ps( k[5], _mm_sub_ps( p3, p2 ) ) );
+}
+
+__attribute__((target("sse4.1")))
+static int bicubic_sse41( const uint8_t *src, int w, int h, const float *x, const float *y,
+	int count, float o, uint8_t *dest, int is_atop )
+{
+	const __m128 scale = _mm_set1_ps( 255.0f );
+	const __m128 opacity = _mm_set1_ps( o );
+	int i;
+
+	for ( i = 0; i + 4 <= count; i += 4, dest += 16 )
+	{
+		__m128 xv = _mm_loadu_ps( x + i );
+		__m128 yv = _mm_loadu_ps( y + i );
+		__m128i m = _mm_sub_epi32( _mm_cvttps_epi32( _mm_ceil_ps( xv ) ), _mm_set1_epi32( 2 ) );
+		__m128i n = _mm_sub_epi32( _mm_cvttps_epi32( _mm_ceil_ps( yv ) ), _mm_set1_epi32( 2 ) );
+		m = _mm_min_epi32( _mm_max_epi32( m, _mm_setzero_si128() ), _mm_set1_epi32( w - 4 ) );
+		n = _mm_min_epi32( _mm_max_epi32( n, _mm_setzero_si128() ), _mm_set1_epi32( h - 4 ) );
+		__m128 mf = _mm_cvtepi32_ps( m ), nf = _mm_cvtepi32_ps( n );
+		__m128i base = _mm_add_epi32( _mm_mullo_epi32( n, _mm_set1_epi32( w ) ), m );
+		__m128i t[4][4];
+		__m128 kx[ BICUBIC_WEIGHTS ], ky[ BICUBIC_WEIGHTS ];
+		__m128 value[4];
+		__m128i d = _mm_loadu_si128( (const __m128i*) dest );
+		int r, c;
+
+		for ( r = 0; r < 4; r++ )
+			for ( c = 0; c < 4; c++ )
+				t[r][c] = gather_sse41( src, _mm_add_epi32( base, _mm_set1_epi32( r * w + c ) ) );
+		for ( r = 0; r < BICUBIC_WEIGHTS; r++ )
+		{
+			__m128 fi = _mm_set1_ps( bicubic_i[r] ), fj = _mm_set1_ps( bicubic_j[r] );
+			ky[r] = _mm_div_ps( _mm_sub_ps( _mm_sub_ps( yv, fi ), nf ), fj );
+			kx[r] = _mm_div_ps( _mm_sub_ps( _mm_sub_ps( xv, fi ), mf ), fj );
+		}
+
+#define BICUBIC_SSE41( ch ) \
+		{ \
+			__m128 p[4]; \
+			for ( c = 0; c < 4; c++ ) \
+				p[c] = neville4_sse41( CHANNEL_SSE41( t[0][c], ch ), CHANNEL_SSE41( t[1][c], ch ), \
+					CHANNEL_SSE41( t[2][c], ch ), CHANNEL_SSE41( t[3][c], ch ), ky ); \
+			value[ch] = _mm_min_ps( _mm_max_ps( neville4_sse41( p[0], p[1], p[2], p[3], kx ), _mm_setzero_ps() ), scale ); \
+		}
+
+		BICUBIC_SSE41( 3 )
+		__m128 alpha_sl = _mm_mul_ps( _mm_div_ps( value[3], scale ), opacity );
+		__m128 alpha_v = _mm_div_ps( CHANNEL_SSE41( d, 3 ), scale );
+		if ( unchanged_sse41( alpha_sl, alpha_v, is_atop ) )
+			continue;
+		BICUBIC_SSE41( 2 )
+		BICUBIC_SSE41( 1 )
+		BICUBIC_SSE41( 0 )
+#undef BICUBIC_SSE41
+		_mm_storeu_si128( (__m128i*) dest, mix_sse41( d, value, alpha_sl, alpha_v, is_atop ) );
+	}
+	return i;
+}
+
+#define CHANNEL_AVX2( t, c ) _mm256_cvtepi32_ps( _mm256_and_si256( _mm256_srli_epi32( t, 8 * ( c ) ), _mm256_set1_epi32( 255 ) ) )
+
+__attribute__((target("avx2")))
+static inline __m256i gather_avx2( const uint8_t *src, __m256i index )
+{
+	return _mm256_i32gather_epi32( (const int*) src, index, 4 );
+}
+
+__attribute__((target("avx2")))
+static inline __m256i to_byte_avx2( __m256 v )
+{
+	return _mm256_and_si256( _mm256_cvttps_epi32( v ), _mm256_set1_epi32( 255 ) );
+}
+
+__attribute__((target("avx2")))
+static inline __m256i mix_avx2( __m256i d, const __m256 *value, __m256 alpha_sl, __m256 alpha_v, int is_atop )
+{
+	const __m256 one = _mm256_set1_ps( 1.0f );
+	__m256 alpha = _mm256_sub_ps( _mm256_add_ps( alpha_sl, alpha_v ), _mm256_mul_ps( alpha_sl, alpha_v ) );
+	__m256i out = _mm256_slli_epi32( is_atop ? to_byte_avx2( value[3] ) : to_byte_avx2( _mm256_mul_ps( _mm256_set1_ps( 255.0f ), alpha ) ), 24 );
+	alpha = _mm256_div_ps( alpha_sl, alpha );
+	__m256 inverse = _mm256_sub_ps( one, alpha );
+	out = _mm256_or_si256( out, to_byte_avx2( _mm256_add_ps( _mm256_mul_ps( CHANNEL_AVX2( d, 0 ), inverse ), _mm256_mul_ps( value[0], alpha ) ) ) );
+	out = _mm256_or_si256( out, _mm256_slli_epi32( to_byte_avx2( _mm256_add_ps( _mm256_mul_ps( CHANNEL_AVX2( d, 1 ), inverse ), _mm256_mul_ps( value[1], alpha ) ) ), 8 ) );
+	out = _mm256_or_si256( out, _mm256_slli_epi32( to_byte_avx2( _mm256_add_ps( _mm256_mul_ps( CHANNEL_AVX2( d, 2 ), inverse ), _mm256_mul_ps( value[2], alpha ) ) ), 16 ) );
+	return out;
+}
+
+__attribute__((target("avx2")))
+static inline int unchanged_avx2( __m256 alpha_sl, __m256 alpha_v, int is_atop )
+{
+	__m256 zero = _mm256_setzero_ps();
+	return !is_atop && _mm256_movemask_ps( _mm256_cmp_ps( alpha_sl, zero, _CMP_NEQ_UQ ) ) == 0
+		&& _mm256_movemask_ps( _mm256_cmp_ps( alpha_v, zero, _CMP_EQ_OQ ) ) == 0;
+}
+
+__attribute__((target("avx2")))
+static int bilinear_avx2( const uint8_t *src, int w, int h, const float *x, const float *y,
+	int count, float o, uint8_t *dest, int is_atop )
+{
+	const __m256 scale = _mm256_set1_ps( 255.0f );
+	const __m256 opacity = _mm256_set1_ps( o );
+	int i;
+
+	for ( i = 0; i + 8 <= count; i += 8, dest += 32 )
+	{
+		__m256 xv = _mm256_loadu_ps( x + i );
+		__m256 yv = _mm256_loadu_ps( y + i );
+		__m256i m = _mm256_min_epi32( _mm256_cvttps_epi32( _mm256_floor_ps( xv ) ), _mm256_set1_epi32( w - 2 ) );
+		__m256i n = _mm256_min_epi32( _mm256_cvttps_epi32( _mm256_floor_ps( yv ) ), _mm256_set1_epi32( h - 2 ) );
+		__m256 fx = _mm256_sub_ps( xv, _mm256_cvtepi32_ps( m ) );
+		__m256 fy = _mm256_sub_ps( yv, _mm256_cvtepi32_ps( n ) );
+		__m256i k = _mm256_add_epi32( _mm256_mullo_epi32( n, _mm256_set1_epi32( w ) ), m );
+		__m256i l = _mm256_add_epi32( k, _mm256_set1_epi32( w ) );
+		__m256i t00 = gather_avx2( src, k );
+		__m256i t01 = gather_avx2( src, _mm256_add_epi32( k, _mm256_set1_epi32( 1 ) ) );
+		__m256i t10 = gather_avx2( src, l );
+		__m256i t11 = gather_avx2( src, _mm256_add_epi32( l, _mm256_set1_epi32( 1 ) ) );
+		__m256i d = _mm256_loadu_si256( (const __m256i*) dest );
+		__m256 value[4];
+
+#define BILINEAR_AVX2( c ) \
+		{ \
+			__m256 s00 = CHANNEL_AVX2( t00, c ), s10 = CHANNEL_AVX2( t10, c ); \
+			__m256 a = _mm256_add_ps( s00, _mm256_mul_ps( _mm256_sub_ps( CHANNEL_AVX2( t01, c ), s00 ), fx ) ); \
+			__m256 b = _mm256_add_ps( s10, _mm256_mul_ps( _mm256_sub_ps( CHANNEL_AVX2( t11, c ), s10 ), fx ) ); \
+			value[c] = _mm256_add_ps( a, _mm256_mul_ps( _mm256_sub_ps( b, a ), fy ) ); \
+		}
+
+		BILINEAR_AVX2( 3 )
+		__m256 alpha_v = _mm256_div_ps( CHANNEL_AVX2( d, 3 ), scale );
+		__m256 alpha_sl = _mm256_mul_ps( _mm256_div_ps( value[3], scale ), opacity );
+		if ( unchanged_avx2( alpha_sl, alpha_v, is_atop ) )
+			continue;
+		BILINEAR_AVX2( 0 )
+		BILINEAR_AVX2( 1 )
+		BILINEAR_AVX2( 2 )
+#undef BILINEAR_AVX2
+		_mm256_storeu_si256( (__m256i*) dest, mix_avx2( d, value, alpha_sl, alpha_v, is_atop ) );
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256 neville4_avx2( __m256 p0, __m256 p1, __m256 p2, __m256 p3, const __m256 *k )
+{
+	p3 = _mm256_add_ps( p3, _mm256_mul_ps( k[0], _mm256_sub_ps( p3, p2 ) ) );
+	p2 = _mm256_add_ps( p2, _mm256_mul_ps( k[1], _mm256_sub_ps( p2, p1 ) ) );
+	p1 = _mm256_add_ps( p1, _mm256_mul_ps( k[2], _mm256_sub_ps( p1, p0 ) ) );
+	p3 = _mm256_add_ps( p3, _mm256_mul_ps( k[3], _mm256_sub_ps( p3, p2 ) ) );
+	p2 = _mm256_add_ps( p2, _mm256_mul_ps( k[4], _mm256_sub_ps( p2, p1 ) ) );
+	return _mm256_add_ps( p3, _mm256_mul_ps( k[5], _mm256_sub_ps( p3, p2 ) ) );
+}
+
+__attribute__((target("avx2")))
+static int bicubic_avx2( const uint8_t *src, int w, int h, const float *x, const float *y,
+	int count, float o, uint8_t *dest, int is_atop )
+{
+	const __m256 scale = _mm256_set1_ps( 255.0f );
+	const __m256 opacity = _mm256_set1_ps( o );
+	int i;
+
+	for ( i = 0; i + 8 <= count; i += 8, dest += 32 )
+	{
+		__m256 xv = _mm256_loadu_ps( x + i );
+		__m256 yv = _mm256_loadu_ps( y + i );
+		__m256i m = _mm256_sub_epi32( _mm256_cvttps_epi32( _mm256_ceil_ps( xv ) ), _mm256_set1_epi32( 2 ) );
+		__m256i n = _mm256_sub_epi32( _mm256_cvttps_epi32( _mm256_ceil_ps( yv ) ), _mm256_set1_epi32( 2 ) );
+		m = _mm256_min_epi32( _mm256_max_epi32( m, _mm256_setzero_si256() ), _mm256_set1_epi32( w - 4 ) );
+		n = _mm256_min_epi32( _mm256_max_epi32( n, _mm256_setzero_si256() ), _mm256_set1_epi32( h - 4 ) );
+		__m256 mf = _mm256_cvtepi32_ps( m ), nf = _mm256_cvtepi32_ps( n );
+		__m256i base = _mm256_add_epi32( _mm256_mullo_epi32( n, _mm256_set1_epi32( w ) ), m );
+		__m256i t[4][4];
+		__m256 kx[ BICUBIC_WEIGHTS ], ky[ BICUBIC_WEIGHTS ];
+		__m256 value[4];
+		__m256i d = _mm256_loadu_si256( (const __m256i*) dest );
+		int r, c;
+
+		for ( r = 0; r < 4; r++ )
+			for ( c = 0; c < 4; c++ )
+				t[r][c] = gather_avx2( src, _mm256_add_epi32( base, _mm256_set1_epi32( r * w + c ) ) );
+		for ( r = 0; r < BICUBIC_WEIGHTS; r++ )
+		{
+			__m256 fi = _mm256_set1_ps( bicubic_i[r] ), fj = _mm256_set1_ps( bicubic_j[r] );
+			ky[r] = _mm256_div_ps( _mm256_sub_ps( _mm256_sub_ps( yv, fi ), nf ), fj );
+			kx[r] = _mm256_div_ps( _mm256_sub_ps( _mm256_sub_ps( xv, fi ), mf ), fj );
+		}
+
+#define BICUBIC_AVX2( ch ) \
+		{ \
+			__m256 p[4]; \
+			for ( c = 0; c < 4; c++ ) \
+				p[c] = neville4_avx2( CHANNEL_AVX2( t[0][c], ch ), CHANNEL_AVX2( t[1][c], ch ), \
+					CHANNEL_AVX2( t[2][c], ch ), CHANNEL_AVX2( t[3][c], ch ), ky ); \
+			value[ch] = _mm256_min_ps( _mm256_max_ps( neville4_avx2( p[0], p[1], p[2], p[3], kx ), _mm256_setzero_ps() ), scale ); \
+		}
+
+		BICUBIC_AVX2( 3 )
+		__m256 alpha_sl = _mm256_mul_ps( _mm256_div_ps( value[3], scale ), opacity );
+		__m256 alpha_v = _mm256_div_ps( CHANNEL_AVX2( d, 3 ), scale );
+		if ( unchanged_avx2( alpha_sl, alpha_v, is_atop ) )
+			continue;
+		BICUBIC_AVX2( 2 )
+		BICUBIC_AVX2( 1 )
+		BICUBIC_AVX2( 0 )
+#undef BICUBIC_AVX2
+		_mm256_storeu_si256( (__m256i*) dest, mix_avx2( d, value, alpha_sl, alpha_v, is_atop ) );
+	}
+	return i;
+}
+
+#endif
+
+static interp_simd g_simd;
+static pthread_once_t g_simd_once = PTHREAD_ONCE_INIT;
+
+static void simd_init( void )
+{
+#if USE_X86_SIMD
+	static const mlt_cpu_dispatch bilinear[] = {
+		{ mlt_cpu_avx2 | mlt_cpu_sse41, bilinear_avx2 },
+		{ mlt_cpu_sse41, bilinear_sse41 },
+		{ 0, NULL }
+	};
+	static const mlt_cpu_dispatch bicubic[] = {
+		{ mlt_cpu_avx2 | mlt_cpu_sse41, bicubic_avx2 },
+		{ mlt_cpu_sse41, bicubic_sse41 },
+		{ 0, NULL }
+	};
+#else
+	static const mlt_cpu_dispatch bilinear[] = { { 0, NULL } };
+	static const mlt_cpu_dispatch bicubic[] = { { 0, NULL } };
+#endif
+	g_simd.bilinear = mlt_cpu_select( bilinear );
+	g_simd.bicubic = mlt_cpu_select( bicubic );
+}
+
+const interp_simd *interp_simd_get( void )
+{
+	pthread_once( &g_simd_once, simd_init );
+	return &g_simd;
+}
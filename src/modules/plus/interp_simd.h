@@ -0,0 +1,49 @@
+/*
+ * interp_simd.h -- vectorised samplers for transition_affine
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef INTERP_SIMD_H
+#define INTERP_SIMD_H
+
+#include <stdint.h>
+
+/** A sampler for a run of consecutive rgba destination pixels.
+ *
+ * Pixel i of the run is interpolated at x[i], y[i] of the w x h source image and
+ * mixed into dest + 4 * i like interpBL_b32 or interpBC_b32 would. The coordinates
+ * must be within the limits that transition_affine checks for those functions.
+ * It handles the largest number of pixels it can from the start of the run and
+ * returns it, leaving the rest of the run to the caller.
+ */
+
+typedef int ( *interp_simd_run )( const uint8_t *src, int w, int h, const float *x, const float *y,
+	int count, float o, uint8_t *dest, int is_atop );
+
+typedef struct
+{
+	interp_simd_run bilinear; /**< gives the results of interpBL_b32 */
+	interp_simd_run bicubic;  /**< gives the results of interpBC_b32 */
+} interp_simd;
+
+/** Get the best samplers for the running CPU, or NULL ones if none apply.
+ * They are chosen with mlt_cpu_select(), so MLT_CPU_FLAGS can restrict them.
+ */
+
+extern const interp_simd *interp_simd_get( void );
+
+#endif
@@ -23,6 +23,19 @@
 #include <stdlib.h>
 #include <string.h>
 
+/** Determine if a frame of the producer flashes and blips.
+*/
+
+static int is_blip_frame( mlt_producer producer, int frames )
+{
+	double fps = mlt_producer_get_fps( producer );
+	int seconds = frames / fps;
+
+	frames = frames % lrint( fps );
+	seconds = seconds % mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( producer ), "period" );
+	return seconds == 0 && frames == 0;
+}
+
 /** Fill an audio buffer with 1kHz "blip" samples.
 */
 
@@ -71,7 +84,6 @@ static int producer_get_audio( mlt_frame frame, int16_t** buffer, mlt_audio_form
 	int size = *samples * *channels * sizeof( float );
 	double fps = mlt_producer_get_fps( producer );
 	int frames = mlt_frame_get_position( frame )  + mlt_properties_get_int( producer_properties, "offset" );
-	int seconds = frames / fps;
 
 	// Correct the returns if necessary
 	*format = mlt_audio_float;
@@ -83,9 +95,7 @@ static int producer_get_audio( mlt_frame frame, int16_t** buffer, mlt_audio_form
 	*buffer = mlt_pool_alloc( size );
 
 	// Determine if this should be a blip or silence.
-	frames = frames % lrint( fps );
-	seconds = seconds % mlt_properties_get_int( producer_properties, "period" );
-	if( seconds == 0 && frames == 0 )
+	if( is_blip_frame( producer, frames ) )
 	{
 		fill_blip( producer_properties, (float*)*buffer, *frequency, *channels, *samples );
 	}
@@ -197,9 +207,6 @@ static int producer_get_image( mlt_frame frame, uint8_t** buffer, mlt_image_form
 	mlt_producer producer = mlt_properties_get_data( MLT_FRAME_PROPERTIES( frame ), "_producer_blipflash", NULL );
 	mlt_properties producer_properties = MLT_PRODUCER_PROPERTIES( producer );
 	int size = 0;
-	double fps = mlt_producer_get_fps( producer );
-	int frames = mlt_frame_get_position( frame );
-	int seconds = frames / fps;
 
 	mlt_service_lock( MLT_PRODUCER_SERVICE( producer ) );
 
@@ -216,9 +223,7 @@ static int producer_get_image( mlt_frame frame, uint8_t** buffer, mlt_image_form
 	*buffer = mlt_pool_alloc( size );
 
 	// Determine if this should be a flash or black.
-	frames = frames % lrint( fps );
-	seconds = seconds % mlt_properties_get_int( producer_properties, "period" );
-	if( seconds == 0 && frames == 0 )
+	if( mlt_properties_get_int( properties, "blipflash.flash" ) )
 	{
 		fill_image( producer_properties, "_flash", *buffer, *format, *width, *height );
 	}
@@ -262,6 +267,13 @@ static int producer_get_frame( mlt_producer producer, mlt_frame_ptr frame, int i
 		// Update time code on the frame
 		mlt_frame_set_position( *frame, mlt_producer_position( producer ) );
 
+		// Mark the flash and the blip so that consumers can time when they are shown
+		mlt_properties producer_properties = MLT_PRODUCER_PROPERTIES( producer );
+		int position = mlt_producer_position( producer );
+		mlt_properties_set_int( frame_properties, "blipflash.flash", is_blip_frame( producer, position ) );
+		mlt_properties_set_int( frame_properties, "blipflash.blip",
+			is_blip_frame( producer, position + mlt_properties_get_int( producer_properties, "offset" ) ) );
+
 		// Configure callbacks
 		mlt_frame_push_get_image( *frame, producer_get_image );
 		mlt_frame_push_audio( *frame, producer_get_audio );
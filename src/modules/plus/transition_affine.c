@@ -28,9 +28,16 @@
 #include <float.h>
 
 #include "interp.h"
+#include "interp_simd.h"
+#ifdef USE_GLES
+#include "affine_gl.h"
+#endif
 
 #define MLT_AFFINE_MAX_DIMENSION (16000)
 
+/** The number of pixels that are given to a sampler at a time */
+#define SAMPLE_RUN (64)
+
 static double alignment_parse( char* align )
 {
 	int ret = 0.0;
@@ -310,44 +317,184 @@ static inline void get_affine( affine_t *affine, mlt_transition transition,
 	}
 }
 
+/** Tell whether the transform only places the b image in the rect.
+ *
+ * Then the b image covers the rect exactly, so the part of it that shows is known
+ * before it is fetched.
+ */
+
+static int is_placement( mlt_transition transition, double position, int length, double scale_width, double scale_height )
+{
+	mlt_properties properties = MLT_TRANSITION_PROPERTIES( transition );
+	double scale_x = mlt_properties_anim_get_double( properties, "scale_x", position, length );
+	double scale_y = mlt_properties_anim_get_double( properties, "scale_y", position, length );
+	affine_t affine;
+	int i, j;
+
+	if ( mlt_properties_get_int( properties, "scale" ) || mlt_properties_get( properties, "halign" ) || mlt_properties_get( properties, "valign" ) )
+		return 0;
+	if ( ( scale_x != 0 && scale_x != 1 ) || ( scale_y != 0 && scale_y != 1 ) )
+		return 0;
+	if ( mlt_properties_get_int( properties, "invert_scale" ) && ( scale_x == 0 || scale_y == 0 ) )
+		return 0;
+	affine_init( affine.matrix );
+	get_affine( &affine, transition, position, length, scale_width, scale_height );
+	for ( i = 0; i < 3; i++ )
+		for ( j = 0; j < 3; j++ )
+			if ( fabs( affine.matrix[i][j] - ( i == j ) ) > 1e-9 )
+				return 0;
+	return 1;
+}
+
 struct sliced_desc
 {
 	uint8_t *a_image, *b_image;
 	interpp interp;
+	interp_simd_run interp_run;
 	affine_t affine;
 	int a_width, a_height, b_width, b_height;
 	double lower_x, lower_y;
 	double dz, mix;
 	double x_offset, y_offset;
 	int b_alpha;
-	double minima, xmax, ymax;
+	double xmin, ymin, xmax, ymax;
 };
 
+/** Get the columns [first, last] of the row at y that can map inside the b image.
+ *
+ * The mapped coordinates are linear along a row, so this solves for the limits and
+ * adds a pixel on each side to allow for rounding. The pixels of the span still need
+ * to be checked, but those outside of it can be skipped.
+ */
+
+static void row_span( struct sliced_desc *ctx, double y, int *first, int *last )
+{
+	double lo = ctx->lower_x;
+	double hi = ctx->lower_x + ctx->a_width - 1;
+	int r;
+
+	for ( r = 0; r < 2 && lo <= hi; r++ )
+	{
+		double a = ctx->affine.matrix[r][0] / ctx->dz;
+		double b = ( ctx->affine.matrix[r][1] * y + ctx->affine.matrix[r][2] ) / ctx->dz + ( r ? ctx->y_offset : ctx->x_offset );
+		double min = r ? ctx->ymin : ctx->xmin;
+		double max = r ? ctx->ymax : ctx->xmax;
+
+		if ( a == 0 )
+		{
+			if ( b < min - 1 || b > max + 1 )
+				hi = lo - 1;
+		}
+		else
+		{
+			double x1 = ( min - b ) / a;
+			double x2 = ( max - b ) / a;
+			lo = MAX( lo, MIN( x1, x2 ) );
+			hi = MIN( hi, MAX( x1, x2 ) );
+		}
+	}
+	if ( lo <= hi )
+	{
+		lo = floor( lo - ctx->lower_x ) - 1;
+		hi = ceil( hi - ctx->lower_x ) + 1;
+		*first = lo < 0 ? 0 : (int) lo;
+		*last = hi > ctx->a_width - 1 ? ctx->a_width - 1 : (int) hi;
+	}
+	else
+	{
+		*first = 0;
+		*last = -1;
+	}
+}
+
+/** Sample a run of consecutive pixels, vectorised where possible. */
+
+static void sample_run( struct sliced_desc *ctx, const float *xs, const float *ys, int count, uint8_t *dest )
+{
+	int i = ctx->interp_run ? ctx->interp_run( ctx->b_image, ctx->b_width, ctx->b_height, xs, ys, count, ctx->mix, dest, ctx->b_alpha ) : 0;
+	for ( ; i < count; i++ )
+		ctx->interp( ctx->b_image, ctx->b_width, ctx->b_height, xs[i], ys[i], ctx->mix, dest + 4 * i, ctx->b_alpha );
+}
+
 static int sliced_proc( int id, int index, int jobs, void* cookie )
 {
 	(void) id; // unused
 	struct sliced_desc ctx = *((struct sliced_desc*) cookie);
-	int height_slice = (ctx.a_height + jobs / 2) / jobs;
-	int starty = height_slice * index;
+	int starty = ctx.a_height * index / jobs;
+	int endy = ctx.a_height * ( index + 1 ) / jobs;
+	float xs[ SAMPLE_RUN ], ys[ SAMPLE_RUN ];
 	double x, y;
 	double dx, dy;
-	int i, j;
-
-	ctx.a_image += (index * height_slice) * (ctx.a_width * 4);
-	for (i = 0, y = ctx.lower_y; i < ctx.a_height; i++, y++) {
-		if (i >= starty && i < (starty + height_slice)) {
-			for (j = 0, x = ctx.lower_x; j < ctx.a_width; j++, x++) {
-				dx = MapX( ctx.affine.matrix, x, y ) / ctx.dz + ctx.x_offset;
-				dy = MapY( ctx.affine.matrix, x, y ) / ctx.dz + ctx.y_offset;
-				if (dx >= ctx.minima && dx <= ctx.xmax && dy >= ctx.minima && dy <= ctx.ymax)
-					ctx.interp(ctx.b_image, ctx.b_width, ctx.b_height, dx, dy, ctx.mix, ctx.a_image, ctx.b_alpha);
-				ctx.a_image += 4;
+	int i, j, first, last, count, start;
+
+	// Step the coordinates from the same origin for every slice
+	for ( i = 0, y = ctx.lower_y; i < starty; i++, y++ );
+	for ( ; i < endy; i++, y++ ) {
+		uint8_t *row = ctx.a_image + i * ctx.a_width * 4;
+
+		row_span( &ctx, y, &first, &last );
+		for ( j = 0, x = ctx.lower_x; j < first; j++, x++ );
+		for ( count = 0, start = j; j <= last; j++, x++ ) {
+			dx = MapX( ctx.affine.matrix, x, y ) / ctx.dz + ctx.x_offset;
+			dy = MapY( ctx.affine.matrix, x, y ) / ctx.dz + ctx.y_offset;
+			if (dx >= ctx.xmin && dx <= ctx.xmax && dy >= ctx.ymin && dy <= ctx.ymax) {
+				if ( count == 0 )
+					start = j;
+				xs[ count ] = dx;
+				ys[ count ] = dy;
+				if ( ++count < SAMPLE_RUN )
+					continue;
 			}
+			if ( count > 0 )
+				sample_run( &ctx, xs, ys, count, row + 4 * start );
+			count = 0;
 		}
+		if ( count > 0 )
+			sample_run( &ctx, xs, ys, count, row + 4 * start );
 	}
 	return 0;
 }
 
+#ifdef USE_GLES
+
+/** Do the transform of sliced_proc() on the GPU.
+ *
+ * \return true if it is done, false if it must be done on the CPU
+ */
+
+static int gpu_proc( struct sliced_desc *desc )
+{
+	affine_gl_job job = {
+		.a_image = desc->a_image,
+		.b_image = desc->b_image,
+		.a_width = desc->a_width,
+		.a_height = desc->a_height,
+		.b_width = desc->b_width,
+		.b_height = desc->b_height,
+		.dz = desc->dz,
+		.lower_x = desc->lower_x,
+		.lower_y = desc->lower_y,
+		.x_offset = desc->x_offset,
+		.y_offset = desc->y_offset,
+		.xmin = desc->xmin,
+		.ymin = desc->ymin,
+		.xmax = desc->xmax,
+		.ymax = desc->ymax,
+		.mix = desc->mix,
+		.b_alpha = desc->b_alpha,
+		.interp = desc->interp == interpNN_b32 ? affine_gl_nearest :
+			desc->interp == interpBC_b32 ? affine_gl_bicubic : affine_gl_bilinear
+	};
+	memcpy( job.matrix, desc->affine.matrix, sizeof( job.matrix ) );
+
+	// Nothing is sampled when the limits are empty
+	if ( desc->xmax < desc->xmin || desc->ymax < desc->ymin )
+		return 1;
+	return affine_gl_composite( &job ) == 0;
+}
+
+#endif
+
 /** Get the image.
 */
 
@@ -407,6 +554,10 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		*height = normalised_height;
 	}
 	
+	// The region of the a image that is needed
+	mlt_rect roi;
+	mlt_frame_get_roi( a_frame, &roi );
+
 	// Fetch the a frame image
 	*format = mlt_image_rgba;
 	int error = mlt_frame_get_image( a_frame, image, format, width, height, 1 );
@@ -519,10 +670,28 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 	}
 	mlt_log_debug(MLT_TRANSITION_SERVICE(transition), "requesting image B at resolution %dx%d\n", b_width, b_height);
 
+	// Only the part of a placed b image inside the region of interest is needed
+	if ( result.w > 0 && result.h > 0 && b_width > 0 && b_height > 0 &&
+		 is_placement( transition, position, length, scale_width, scale_height ) )
+	{
+		double x0 = MAX( result.x, roi.x * *width );
+		double y0 = MAX( result.y, roi.y * *height );
+		double x1 = MIN( result.x + result.w, ( roi.x + roi.w ) * *width );
+		double y1 = MIN( result.y + result.h, ( roi.y + roi.h ) * *height );
+
+		// Allow for the reach of the interpolation
+		mlt_rect b_roi = { ( x0 - result.x ) / result.w - 2.0 / b_width, ( y0 - result.y ) / result.h - 2.0 / b_height,
+			( x1 - x0 ) / result.w + 4.0 / b_width, ( y1 - y0 ) / result.h + 4.0 / b_height, 1.0 };
+		mlt_frame_set_roi( b_frame, b_roi );
+	}
+
 	// This is not a field-aware transform.
 	mlt_properties_set_int( b_props, "consumer_deinterlace", 1 );
 
 	error = mlt_frame_get_image( b_frame, &b_image, &b_format, &b_width, &b_height, 0 );
+	mlt_rect bounds;
+	int opaque;
+	int has_bounds = mlt_frame_get_alpha_bounds( b_frame, &bounds, &opaque );
 	if (error || !b_image) {
 		// Remove potentially large image on the B frame. 
 		mlt_frame_set_image( b_frame, NULL, 0, NULL );
@@ -545,6 +714,7 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 			.a_image = *image,
 			.b_image = b_image,
 			.interp = interpBL_b32,
+			.interp_run = interp_simd_get()->bilinear,
 			.a_width = *width,
 			.a_height = *height,
 			.b_width = b_width,
@@ -556,7 +726,8 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 			.y_offset = (double) b_height / 2.0,
 			.b_alpha = mlt_properties_get_int( properties, "b_alpha" ),
 			// Affine boundaries
-			.minima = 0,
+			.xmin = 0,
+			.ymin = 0,
 			.xmax = b_width - 1,
 			.ymax = b_height - 1
 		};
@@ -632,14 +803,17 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		if ( interps == NULL || strcmp( interps, "nearest" ) == 0 || strcmp( interps, "neighbor" ) == 0 || strcmp( interps, "tiles" ) == 0 || strcmp( interps, "fast_bilinear" ) == 0 )
 		{
 			desc.interp = interpNN_b32;
+			desc.interp_run = NULL;
 			// uses lrintf. Values should be >= -0.5 and < max + 0.5
-			desc.minima -= 0.5;
+			desc.xmin -= 0.5;
+			desc.ymin -= 0.5;
 			desc.xmax += 0.49;
 			desc.ymax += 0.49;
 		}
 		else if ( strcmp( interps, "bilinear" ) == 0 )
 		{
 			desc.interp = interpBL_b32;
+			desc.interp_run = interp_simd_get()->bilinear;
 			// uses floorf.
 		}
 		else if ( strcmp( interps, "bicubic" ) == 0 ||  strcmp( interps, "hyper" ) == 0 || strcmp( interps, "sinc" ) == 0 || strcmp( interps, "lanczos" ) == 0 || strcmp( interps, "spline" ) == 0 )
@@ -647,13 +821,37 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 			// TODO: lanczos 8x8
 			// TODO: spline 4x4 or 6x6
 			desc.interp = interpBC_b32;
+			desc.interp_run = interp_simd_get()->bicubic;
 			// uses ceilf. Values should be > -1 and <= max.
-			desc.minima -= 1;
+			desc.xmin -= 1;
+			desc.ymin -= 1;
 		}
 		free( interps );
 
-		// Do the transform with interpolation
-		if (threads == 1)
+		// Sample only near where the b image is not transparent, unless its alpha replaces that of a
+		if ( has_bounds && !desc.b_alpha )
+		{
+			if ( bounds.w > 0 && bounds.h > 0 )
+			{
+				desc.xmin = MAX( desc.xmin, bounds.x - 3 );
+				desc.ymin = MAX( desc.ymin, bounds.y - 3 );
+				desc.xmax = MIN( desc.xmax, bounds.x + bounds.w + 2 );
+				desc.ymax = MIN( desc.ymax, bounds.y + bounds.h + 2 );
+			}
+			else
+			{
+				desc.xmax = desc.xmin - 1;
+			}
+		}
+
+		// Do the transform with interpolation, on the GPU if asked for and there is one
+		int on_gpu = 0;
+#ifdef USE_GLES
+		on_gpu = mlt_properties_get_int( properties, "gpu" ) && gpu_proc( &desc );
+#endif
+		if (on_gpu)
+			mlt_log_debug( MLT_TRANSITION_SERVICE(transition), "composited on the GPU\n" );
+		else if (threads == 1)
 			sliced_proc(0, 0, 1, &desc);
 		else
 			mlt_slices_run_normal(threads, sliced_proc, &desc);
@@ -20,6 +20,12 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
+
+// For sendmmsg
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #ifdef _WIN32
 #include <winsock2.h>
 #else
@@ -68,6 +74,10 @@
 #define RTP_VERSION   (2)
 #define RTP_PAYLOAD   (33)
 #define RTP_HZ        (90000)
+#define TSP_RING_MINIMUM (8192)
+#define UDP_BATCH_MAX (32)
+#define UDP_BATCH_NSEC (1000000)
+#define WRITE_BUFFER_PACKETS (348)
 
 #define PIDOF( packet )  ( ntohs( *( ( uint16_t* )( packet + 1 ) ) ) & 0x1fff )
 #define HASPCR( packet ) ( (packet[3] & 0x20) && (packet[4] != 0) && (packet[5] & 0x10) )
@@ -86,9 +96,14 @@ struct consumer_cbrts_s
 	mlt_position last_position;
 	mlt_event event_registered;
 	int fd;
-	uint8_t *leftover_data[TSP_BYTES];
+	uint8_t leftover_data[TSP_BYTES];
 	int leftover_size;
-	mlt_deque tsp_packets;
+	uint8_t *tsp_ring;
+	int tsp_ring_size;
+	int tsp_ring_head;
+	int tsp_ring_count;
+	uint8_t *write_buffer;
+	size_t write_bytes;
 	uint64_t previous_pcr;
 	uint64_t previous_packet_count;
 	uint64_t packet_count;
@@ -110,13 +125,16 @@ struct consumer_cbrts_s
 	uint64_t femto_counter;
 #endif
 	int ( *write_tsp )( consumer_cbrts, const void *buf, size_t count );
-	uint8_t udp_packet[UDP_MTU];
+	uint8_t *udp_ring;
+	uint8_t *udp_fill;
 	size_t udp_bytes;
 	size_t udp_packet_size;
-	mlt_deque udp_packets;
+	int udp_ring_head;
+	int udp_ring_count;
+	int udp_batch;
 	pthread_t output_thread;
-	pthread_mutex_t udp_deque_mutex;
-	pthread_cond_t udp_deque_cond;
+	pthread_mutex_t udp_ring_mutex;
+	pthread_cond_t udp_ring_cond;
 	uint64_t muxrate;
 	int udp_buffer_max;
 	uint16_t rtp_sequence;
@@ -168,8 +186,6 @@ mlt_consumer consumer_cbrts_init( mlt_profile profile, mlt_service_type type, co
 		parent->stop = consumer_stop;
 		parent->is_stopped = consumer_is_stopped;
 		self->joined = 1;
-		self->tsp_packets = mlt_deque_init();
-		self->udp_packets = mlt_deque_init();
 
 		// Create the null packet
 		memset( null_packet, 0xFF, TSP_BYTES );
@@ -178,9 +194,9 @@ mlt_consumer consumer_cbrts_init( mlt_profile profile, mlt_service_type type, co
 		null_packet[2] = 0xff;
 		null_packet[3] = 0x10;
 
-		// Create the deque mutex and condition
-		pthread_mutex_init( &self->udp_deque_mutex, NULL );
-		pthread_cond_init( &self->udp_deque_cond, NULL );
+		// Create the ring mutex and condition
+		pthread_mutex_init( &self->udp_ring_mutex, NULL );
+		pthread_cond_init( &self->udp_ring_cond, NULL );
 
 		// Set consumer property defaults
 		mlt_properties_set_int( properties, "real_time", -1 );
@@ -314,6 +330,38 @@ static void load_sections( consumer_cbrts self, mlt_properties properties )
 	}
 }
 
+// Get the next free packet at the end of the TS ring, growing it if full.
+static uint8_t *tsp_ring_push( consumer_cbrts self )
+{
+	if ( self->tsp_ring_count == self->tsp_ring_size )
+	{
+		int size = MAX( 2 * self->tsp_ring_size, TSP_RING_MINIMUM );
+		uint8_t *ring = malloc( size * TSP_BYTES );
+		int first = MIN( self->tsp_ring_count, self->tsp_ring_size - self->tsp_ring_head );
+
+		// Unwrap the packets into the new ring
+		if ( self->tsp_ring_count )
+		{
+			memcpy( ring, self->tsp_ring + self->tsp_ring_head * TSP_BYTES, first * TSP_BYTES );
+			memcpy( ring + first * TSP_BYTES, self->tsp_ring, ( self->tsp_ring_count - first ) * TSP_BYTES );
+		}
+		free( self->tsp_ring );
+		self->tsp_ring = ring;
+		self->tsp_ring_size = size;
+		self->tsp_ring_head = 0;
+	}
+	return self->tsp_ring + ( ( self->tsp_ring_head + self->tsp_ring_count++ ) % self->tsp_ring_size ) * TSP_BYTES;
+}
+
+// Take the first packet of the TS ring, valid until the next push.
+static uint8_t *tsp_ring_pop( consumer_cbrts self )
+{
+	uint8_t *packet = self->tsp_ring + self->tsp_ring_head * TSP_BYTES;
+	self->tsp_ring_head = ( self->tsp_ring_head + 1 ) % self->tsp_ring_size;
+	self->tsp_ring_count--;
+	return packet;
+}
+
 static void write_section( consumer_cbrts self, ts_section *section )
 {
 	uint8_t *packet;
@@ -325,7 +373,7 @@ static void write_section( consumer_cbrts self, ts_section *section )
 	while ( size > 0 )
 	{
 		first = ( section->data == data_ptr );
-		p = packet = malloc( TSP_BYTES );
+		p = packet = tsp_ring_push( self );
 		*p++ = 0x47;
 		*p = ( section->pid >> 8 );
 		if ( first )
@@ -345,7 +393,6 @@ static void write_section( consumer_cbrts self, ts_section *section )
 		if ( len > 0 )
 			memset( p, 0xff, len );
 
-		mlt_deque_push_back( self->tsp_packets, packet );
 		self->packet_count++;
 
 		data_ptr += len;
@@ -372,7 +419,7 @@ static void write_sections( consumer_cbrts self )
 	}
 }
 
-static uint64_t get_pcr( uint8_t *packet )
+static uint64_t get_pcr( const uint8_t *packet )
 {
 	uint64_t pcr = 0;
 	pcr += (uint64_t) packet[6] << 25;
@@ -441,11 +488,34 @@ static int writen( consumer_cbrts self, const void *buf, size_t count )
 	return result;
 }
 
-static int sendn( consumer_cbrts self, const void *buf, size_t count )
+// Write the buffered packets to the file.
+static int flush_tsp( consumer_cbrts self )
 {
 	int result = 0;
+	if ( self->write_bytes )
+		result = writen( self, self->write_buffer, self->write_bytes );
+	self->write_bytes = 0;
+	return result;
+}
 
-#ifdef CBRTS_BSD_SOCKETS
+// Buffer packets for the file to write many of them at once.
+static int buffer_tsp( consumer_cbrts self, const void *buf, size_t count )
+{
+	int result = 0;
+	if ( !self->write_buffer )
+		self->write_buffer = malloc( WRITE_BUFFER_PACKETS * TSP_BYTES );
+	if ( self->write_bytes + count > WRITE_BUFFER_PACKETS * TSP_BYTES )
+		result = flush_tsp( self );
+	memcpy( self->write_buffer + self->write_bytes, buf, count );
+	self->write_bytes += count;
+	return result;
+}
+
+#if defined( CBRTS_BSD_SOCKETS ) && !defined( __linux__ )
+// Linux sends the batches with sendmmsg instead.
+static int sendn( consumer_cbrts self, const void *buf, size_t count )
+{
+	int result = 0;
 	int written = 0;
 	while ( written < count )
 	{
@@ -459,26 +529,68 @@ static int sendn( consumer_cbrts self, const void *buf, size_t count )
 		}
 		written += result;
 	}
-#endif
-
 	return result;
 }
-
-static int write_udp( consumer_cbrts self, const void *buf, size_t count )
-{
-	int result = 0;
+#endif
 
 #ifdef CBRTS_BSD_SOCKETS
-	if ( !self->timer.tv_sec )
-		clock_gettime( CLOCK_MONOTONIC, &self->timer );
+static void advance_timer( consumer_cbrts self )
+{
 	self->femto_counter += self->femto_per_packet;
 	self->timer.tv_nsec += self->femto_counter / 1000000;
 	self->femto_counter  = self->femto_counter % 1000000;
 	self->timer.tv_nsec += self->nsec_per_packet;
 	self->timer.tv_sec  += self->timer.tv_nsec / 1000000000;
 	self->timer.tv_nsec  = self->timer.tv_nsec % 1000000000;
+}
+#endif
+
+// Send count UDP packets of the ring starting at index, paced to the muxrate.
+// The packets of a batch leave together at the time of the first one.
+static int write_udp( consumer_cbrts self, int index, int count )
+{
+	int result = 0;
+
+#ifdef CBRTS_BSD_SOCKETS
+	size_t size = self->rtp_ssrc ? RTP_BYTES + self->udp_packet_size : self->udp_packet_size;
+	int i;
+
+	if ( !self->timer.tv_sec )
+		clock_gettime( CLOCK_MONOTONIC, &self->timer );
+	advance_timer( self );
 	clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &self->timer, NULL );
-	result = sendn( self, buf, count );
+	for ( i = 1; i < count; i++ )
+		advance_timer( self );
+
+#ifdef __linux__
+	struct mmsghdr messages[ UDP_BATCH_MAX ];
+	struct iovec vectors[ UDP_BATCH_MAX ];
+	int sent = 0;
+
+	memset( messages, 0, count * sizeof( *messages ) );
+	for ( i = 0; i < count; i++ )
+	{
+		vectors[i].iov_base = self->udp_ring + ( ( index + i ) % self->udp_buffer_max ) * UDP_MTU;
+		vectors[i].iov_len = size;
+		messages[i].msg_hdr.msg_name = self->addr->ai_addr;
+		messages[i].msg_hdr.msg_namelen = self->addr->ai_addrlen;
+		messages[i].msg_hdr.msg_iov = &vectors[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+	}
+	while ( sent < count )
+	{
+		result = sendmmsg( self->fd, messages + sent, count - sent, 0 );
+		if ( result < 0 )
+		{
+			mlt_log_error( MLT_CONSUMER_SERVICE(&self->parent), "Failed to send: %s\n", strerror( errno ) );
+			exit( EXIT_FAILURE );
+		}
+		sent += result;
+	}
+#else
+	for ( i = 0; i < count && result >= 0; i++ )
+		result = sendn( self, self->udp_ring + ( ( index + i ) % self->udp_buffer_max ) * UDP_MTU, size );
+#endif
 #endif
 
 	return result;
@@ -625,45 +737,56 @@ static void *output_thread( void *arg )
 	consumer_cbrts self = arg;
 	int result = 0;
 
-	while ( self->thread_running )
+	while ( self->thread_running && result >= 0 )
 	{
-		pthread_mutex_lock( &self->udp_deque_mutex );
-		while ( self->thread_running && mlt_deque_count( self->udp_packets ) < 1 )
-			pthread_cond_wait( &self->udp_deque_cond, &self->udp_deque_mutex );
-		pthread_mutex_unlock( &self->udp_deque_mutex );
-
-		// Dequeue the UDP packets and write them.
-		int i = mlt_deque_count( self->udp_packets );
-		mlt_log_debug( MLT_CONSUMER_SERVICE(&self->parent), "%s: count %d\n", __FUNCTION__, i );
-		while ( self->thread_running && i-- && result >= 0 )
-		{
-			pthread_mutex_lock( &self->udp_deque_mutex );
-			uint8_t *packet = mlt_deque_pop_front( self->udp_packets );
-			pthread_cond_broadcast( &self->udp_deque_cond );
-			pthread_mutex_unlock( &self->udp_deque_mutex );
-
-			size_t size = self->rtp_ssrc ? RTP_BYTES + self->udp_packet_size : self->udp_packet_size;
-			result = write_udp( self, packet, size );
-			free( packet );
-		}
+		pthread_mutex_lock( &self->udp_ring_mutex );
+		while ( self->thread_running && self->udp_ring_count < 1 )
+			pthread_cond_wait( &self->udp_ring_cond, &self->udp_ring_mutex );
+		int index = self->udp_ring_head;
+		int count = MIN( self->udp_ring_count, self->udp_batch );
+		pthread_mutex_unlock( &self->udp_ring_mutex );
+
+		if ( !self->thread_running )
+			break;
+
+		// Write the UDP packets in place and release them.
+		mlt_log_debug( MLT_CONSUMER_SERVICE(&self->parent), "%s: count %d\n", __FUNCTION__, count );
+		result = write_udp( self, index, count );
+
+		pthread_mutex_lock( &self->udp_ring_mutex );
+		self->udp_ring_head = ( self->udp_ring_head + count ) % self->udp_buffer_max;
+		self->udp_ring_count -= count;
+		pthread_cond_broadcast( &self->udp_ring_cond );
+		pthread_mutex_unlock( &self->udp_ring_mutex );
 	}
 	return NULL;
 }
 
 static int enqueue_udp( consumer_cbrts self, const void *buf, size_t count )
 {
-	// Append TSP to the UDP packet.
-	memcpy( &self->udp_packet[self->udp_bytes], buf, count );
+	size_t offset = self->rtp_ssrc ? RTP_BYTES : 0;
+
+	// Wait for room in the ring to start a UDP packet.
+	if ( !self->udp_bytes )
+	{
+		pthread_mutex_lock( &self->udp_ring_mutex );
+		while ( self->thread_running && self->udp_ring_count >= self->udp_buffer_max )
+			pthread_cond_wait( &self->udp_ring_cond, &self->udp_ring_mutex );
+		int full = self->udp_ring_count >= self->udp_buffer_max;
+		self->udp_fill = self->udp_ring + ( ( self->udp_ring_head + self->udp_ring_count ) % self->udp_buffer_max ) * UDP_MTU;
+		pthread_mutex_unlock( &self->udp_ring_mutex );
+		if ( full )
+			return 0;
+	}
+
+	// Append TSP to the UDP packet in the ring.
+	memcpy( self->udp_fill + offset + self->udp_bytes, buf, count );
 	self->udp_bytes = ( self->udp_bytes + count ) % self->udp_packet_size;
 
 	// Send the UDP packet.
 	if ( !self->udp_bytes )
 	{
-		size_t offset = self->rtp_ssrc ? RTP_BYTES : 0;
-
-		// Duplicate the packet.
-		uint8_t *packet = malloc( self->udp_packet_size + offset );
-		memcpy( packet + offset, self->udp_packet, self->udp_packet_size );
+		uint8_t *packet = self->udp_fill;
 
 		// Add the RTP header.
 		if ( self->rtp_ssrc ) {
@@ -687,15 +810,11 @@ static int enqueue_udp( consumer_cbrts self, const void *buf, size_t count )
 			self->rtp_sequence++;
 		}
 
-		// Wait for room in the fifo.
-		pthread_mutex_lock( &self->udp_deque_mutex );
-		while ( self->thread_running && mlt_deque_count( self->udp_packets ) >= self->udp_buffer_max )
-			pthread_cond_wait( &self->udp_deque_cond, &self->udp_deque_mutex );
-
-		// Add the packet to the fifo.
-		mlt_deque_push_back( self->udp_packets, packet );
-		pthread_cond_broadcast( &self->udp_deque_cond );
-		pthread_mutex_unlock( &self->udp_deque_mutex );
+		// Add the packet to the ring.
+		pthread_mutex_lock( &self->udp_ring_mutex );
+		self->udp_ring_count++;
+		pthread_cond_broadcast( &self->udp_ring_cond );
+		pthread_mutex_unlock( &self->udp_ring_mutex );
 	}
 
 	return 0;
@@ -722,7 +841,7 @@ static int insert_pcr( consumer_cbrts self, uint16_t pid, uint8_t cc, uint64_t p
 
 static int output_cbr( consumer_cbrts self, uint64_t input_rate, uint64_t output_rate, uint64_t *pcr )
 {
-	int n = mlt_deque_count( self->tsp_packets );
+	int n = self->tsp_ring_count;
 	unsigned output_packets = 0;
 	unsigned packets_since_pcr = 0;
 	int result = 0;
@@ -738,7 +857,7 @@ static int output_cbr( consumer_cbrts self, uint64_t input_rate, uint64_t output
 	mlt_log_debug( NULL, "%s: n %i output_counter %"PRIu64" input_rate %"PRIu64"\n", __FUNCTION__, n, self->output_counter, input_rate );
 	while ( self->thread_running && n-- && result >= 0 )
 	{
-		uint8_t *packet = mlt_deque_pop_front( self->tsp_packets );
+		uint8_t *packet = tsp_ring_pop( self );
 		uint16_t pid = PIDOF( packet );
 
 		// Check for overflow
@@ -752,8 +871,6 @@ static int output_cbr( consumer_cbrts self, uint64_t input_rate, uint64_t output
 			}
 
 			// Skip this packet
-			free( packet );
-
 			// Compute new input_rate based on dropped count
 			input_rate = measure_bitrate( self, *pcr, ++dropped );
 
@@ -777,7 +894,6 @@ static int output_cbr( consumer_cbrts self, uint64_t input_rate, uint64_t output
 			cc = CCOF( packet );
 
 		result = self->write_tsp( self, packet, TSP_BYTES );
-		free( packet );
 		if ( result < 0 )
 			break;
 		output_packets++;
@@ -858,19 +974,21 @@ static int output_cbr( consumer_cbrts self, uint64_t input_rate, uint64_t output
 	return result;
 }
 
-static void get_pmt_pid( consumer_cbrts self, uint8_t *packet )
+static void get_pmt_pid( consumer_cbrts self, const uint8_t *packet )
 {
 	// Skip 5 bytes of TSP header + 8 bytes of section header + 2 bytes of service ID
-	uint16_t *p = ( uint16_t* )( packet + 5 + 8 + 2 );
+	const uint16_t *p = ( const uint16_t* )( packet + 5 + 8 + 2 );
 	self->pmt_pid = ntohs( p[0] ) & 0x1fff;
 	mlt_log_debug(NULL, "PMT PID 0x%04x\n", self->pmt_pid );
 	return;
 }
 
-static int remux_packet( consumer_cbrts self, uint8_t *packet )
+static int remux_packet( consumer_cbrts self, const uint8_t *packet )
 {
 	mlt_service service = MLT_CONSUMER_SERVICE( &self->parent );
 	uint16_t pid = PIDOF( packet );
+	uint64_t pcr = 0;
+	int is_pcr_set = 0;
 	int result = 0;
 
 	write_sections( self );
@@ -892,7 +1010,7 @@ static int remux_packet( consumer_cbrts self, uint8_t *packet )
 	{
 		if ( self->pcr_count++ % PCR_SMOOTHING == 0 )
 		{
-			uint64_t pcr = get_pcr( packet );
+			pcr = get_pcr( packet );
 			double input_rate = measure_bitrate( self, pcr, 0 );
 			if ( input_rate > 0 )
 			{
@@ -900,14 +1018,19 @@ static int remux_packet( consumer_cbrts self, uint8_t *packet )
 				if ( input_rate > 1.0 )
 				{
 					result = output_cbr( self, input_rate, self->muxrate, &pcr );
-					set_pcr( packet, pcr );
+					is_pcr_set = 1;
 				}
 			}
 			self->previous_pcr = pcr;
 			self->previous_packet_count = self->packet_count;
 		}
 	}
-	mlt_deque_push_back( self->tsp_packets, packet );
+
+	// Copy the packet into the ring, where it stays until output.
+	uint8_t *slot = tsp_ring_push( self );
+	memcpy( slot, packet, TSP_BYTES );
+	if ( is_pcr_set )
+		set_pcr( slot, pcr );
 	self->packet_count++;
 	return result;
 }
@@ -944,25 +1067,30 @@ static void start_output_thread( consumer_cbrts self )
 
 static void stop_output_thread( consumer_cbrts self )
 {
-	self->thread_running = 0;
+	if ( self->thread_running )
+	{
+		self->thread_running = 0;
 
-	// Broadcast to the condition in case it's waiting.
-	pthread_mutex_lock( &self->udp_deque_mutex );
-	pthread_cond_broadcast( &self->udp_deque_cond );
-	pthread_mutex_unlock( &self->udp_deque_mutex );
+		// Broadcast to the condition in case it's waiting.
+		pthread_mutex_lock( &self->udp_ring_mutex );
+		pthread_cond_broadcast( &self->udp_ring_cond );
+		pthread_mutex_unlock( &self->udp_ring_mutex );
 
-	// Join the thread.
-	pthread_join( self->output_thread, NULL );
+		// Join the thread.
+		pthread_join( self->output_thread, NULL );
+	}
 
 	// Release the buffered packets.
-	pthread_mutex_lock( &self->udp_deque_mutex );
-	int n = mlt_deque_count( self->udp_packets );
-	while ( n-- )
-		free( mlt_deque_pop_back( self->udp_packets ) );
-	pthread_mutex_unlock( &self->udp_deque_mutex );
+	pthread_mutex_lock( &self->udp_ring_mutex );
+	self->udp_ring_head = 0;
+	self->udp_ring_count = 0;
+	self->udp_bytes = 0;
+	pthread_mutex_unlock( &self->udp_ring_mutex );
+	self->tsp_ring_head = 0;
+	self->tsp_ring_count = 0;
 }
 
-static inline int filter_packet( consumer_cbrts self, uint8_t *packet )
+static inline int filter_packet( consumer_cbrts self, const uint8_t *packet )
 {
 	uint16_t pid = PIDOF( packet );
 
@@ -983,19 +1111,14 @@ static inline int filter_packet( consumer_cbrts self, uint8_t *packet )
 	return result;
 }
 
-static void filter_remux_or_write_packet( consumer_cbrts self, uint8_t *packet )
+static void filter_remux_or_write_packet( consumer_cbrts self, const uint8_t *packet, int remux )
 {
-	int remux = !mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( &self->parent ), "noremux" );
-
 	// Filter out packets
 	if ( remux ) {
 		if ( !filter_packet( self, packet ) )
 			remux_packet( self, packet );
-		else
-			free( packet );
 	} else {
 		self->write_tsp( self, packet, TSP_BYTES );
-		free( packet );
 	}
 }
 
@@ -1021,33 +1144,32 @@ static void on_data_received( mlt_properties properties, mlt_consumer consumer,
 				exit(1);
 		}
 
-		// Enqueue the packets
+		// Process the packets from the buffer
+		int remux = !mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( consumer ), "noremux" );
 		int num_packets = ( self->leftover_size + size ) / TSP_BYTES;
 		int remaining = ( self->leftover_size + size ) % TSP_BYTES;
-		uint8_t *packet = NULL;
 		int i;
 
 //			mlt_log_verbose( MLT_CONSUMER_SERVICE(consumer), "%s: packets %d remaining %i\n", __FUNCTION__, num_packets, self->leftover_size );
 
-		if ( self->leftover_size )
+		if ( self->leftover_size && num_packets )
 		{
-			packet = malloc( TSP_BYTES );
+			uint8_t packet[ TSP_BYTES ];
 			memcpy( packet, self->leftover_data, self->leftover_size );
 			memcpy( packet + self->leftover_size, buf, TSP_BYTES - self->leftover_size );
 			buf += TSP_BYTES - self->leftover_size;
+			self->leftover_size = 0;
 			--num_packets;
-			filter_remux_or_write_packet( self, packet );
+			filter_remux_or_write_packet( self, packet, remux );
 		}
 		for ( i = 0; i < num_packets; i++, buf += TSP_BYTES )
-		{
-			packet = malloc( TSP_BYTES );
-			memcpy( packet, buf, TSP_BYTES );
-			filter_remux_or_write_packet( self, packet );
-		}
+			filter_remux_or_write_packet( self, buf, remux );
 
+		memcpy( self->leftover_data + self->leftover_size, buf, remaining - self->leftover_size );
 		self->leftover_size = remaining;
-		memcpy( self->leftover_data, buf, self->leftover_size );
 
+		if ( self->write_tsp == buffer_tsp )
+			flush_tsp( self );
 		if ( !self->thread_running )
 			start_output_thread( self );
 		mlt_log_debug( MLT_CONSUMER_SERVICE(consumer), "%s: %p 0x%x (%d)\n", __FUNCTION__, buf, *buf, size % TSP_BYTES );
@@ -1082,7 +1204,7 @@ static int consumer_start( mlt_consumer parent )
 		mlt_properties_set( avformat, "f", "mpegts" );
 		self->dropped = 0;
 		self->fd = STDOUT_FILENO;
-		self->write_tsp = writen;
+		self->write_tsp = buffer_tsp;
 		self->muxrate = mlt_properties_get_int64( MLT_CONSUMER_PROPERTIES(&self->parent), "muxrate" );
 
 		if ( mlt_properties_get( properties, "udp.address" ) )
@@ -1109,6 +1231,16 @@ static int consumer_start( mlt_consumer parent )
 				self->udp_buffer_max = mlt_properties_get_int( properties, "udp.buffer" );
 				if ( self->udp_buffer_max < UDP_BUFFER_MINIMUM )
 					self->udp_buffer_max = UDP_BUFFER_DEFAULT;
+				free( self->udp_ring );
+				self->udp_ring = malloc( self->udp_buffer_max * UDP_MTU );
+
+				// Send the packets due within a millisecond together by default
+				self->udp_batch = mlt_properties_get_int( properties, "udp.batch" );
+#ifdef CBRTS_BSD_SOCKETS
+				if ( self->udp_batch <= 0 )
+					self->udp_batch = UDP_BATCH_NSEC / MAX( self->nsec_per_packet, 1 );
+#endif
+				self->udp_batch = CLAMP( self->udp_batch, 1, UDP_BATCH_MAX );
 
 				self->write_tsp = enqueue_udp;
 			}
@@ -1243,8 +1375,11 @@ static void consumer_close( mlt_consumer parent )
 	mlt_consumer_close( self->avformat );
 
 	// Now clean up the rest
-	mlt_deque_close( self->tsp_packets );
-	mlt_deque_close( self->udp_packets );
+	free( self->tsp_ring );
+	free( self->udp_ring );
+	free( self->write_buffer );
+	pthread_mutex_destroy( &self->udp_ring_mutex );
+	pthread_cond_destroy( &self->udp_ring_cond );
 	mlt_consumer_close( parent );
 
 	// Finally clean up this
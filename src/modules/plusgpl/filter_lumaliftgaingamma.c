@@ -88,7 +88,7 @@ static double lut_value( double value, double lift, double gain, double gamma )
 	return value;
 }
 
-static void fill_lgg_lut(int lgg_lut[], double lift, double gain, double gamma)
+static void fill_lgg_lut(uint8_t lgg_lut[], double lift, double gain, double gamma)
 {
 	int i;
 	double val;
@@ -109,37 +109,22 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	mlt_position position = mlt_filter_get_position( filter, frame );
 	mlt_position length = mlt_filter_get_length2( filter, frame );
 
-	*format = mlt_image_rgb;
-	int error = mlt_frame_get_image( frame, image, format, width, height, 0 );
+	// Get values and force accepted ranges
+	double lift = mlt_properties_anim_get_double( properties, "lift", position, length );
+	double gain = mlt_properties_anim_get_double( properties, "gain", position, length );
+	double gamma = mlt_properties_anim_get_double( properties, "gamma", position, length );
+	lift = clamp( lift, -0.5, 0.5 );
+	gain = clamp( gain, -0.5, 0.5 );
+	gamma = clamp( gamma, -1.0, 1.0 );
 
-	// Only process if we have no error and a valid colour space
-	if ( error == 0 )
-	{
-		// Get values and force accepted ranges
-		double lift = mlt_properties_anim_get_double( properties, "lift", position, length );
-		double gain = mlt_properties_anim_get_double( properties, "gain", position, length );
-		double gamma = mlt_properties_anim_get_double( properties, "gamma", position, length );
-		lift = clamp( lift, -0.5, 0.5 );
-		gain = clamp( gain, -0.5, 0.5 );
-		gamma = clamp( gamma, -1.0, 1.0 );
-
-		// Build lut
-		int lgg_lut[256];
-		fill_lgg_lut( lgg_lut, lift, gain, gamma);
-
-		// Filter
-		int i = *width * *height + 1;
-		uint8_t *p = *image;
-		uint8_t *r = *image;
-		while ( --i )
-		{
-			*p ++ = lgg_lut[ *r ++ ];
-			*p ++ = lgg_lut[ *r ++ ];
-			*p ++ = lgg_lut[ *r ++ ];
-		}
-	}
+	// Build lut
+	uint8_t lgg_lut[256];
+	const uint8_t *luts[MLT_IMAGE_MAX_PLANES] = { lgg_lut, lgg_lut, lgg_lut, NULL };
+	fill_lgg_lut( lgg_lut, lift, gain, gamma);
 
-	return error;
+	// Filter
+	*format = mlt_image_rgb;
+	return mlt_frame_get_image_lut( frame, image, format, width, height, luts );
 }
 
 /** Filter processing.
@@ -21,6 +21,7 @@
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_profile.h>
+#include <framework/mlt_slices.h>
 
 #include "cJSON.h"
 
@@ -28,8 +29,10 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <pthread.h>
 
 #define SQR( x ) ( x ) * ( x )
+#define MIN_SLICE_HEIGHT (16)
 
 /** x, y tuple with double precision */
 typedef struct PointF
@@ -51,6 +54,27 @@ const char *MODESTR[3] = { "rgb", "alpha", "luma" };
 enum ALPHAOPERATIONS { ALPHA_CLEAR, ALPHA_MAX, ALPHA_MIN, ALPHA_ADD, ALPHA_SUB };
 const char *ALPHAOPERATIONSTR[5] = { "clear", "max", "min", "add", "sub" };
 
+/** \brief a rasterized mask and the shape and settings it was made from
+ *
+ * Between keyframes, or without them, the shape does not move and the filter
+ * reuses the last mask instead of rendering it again.
+ */
+typedef struct mask_s
+{
+    BPointF *points;    /**< the shape in coordinates relative to the image size */
+    int count;
+    int width, height, invert, feather, passes;
+    uint8_t *map;       /**< width * height values */
+    int top, bottom;    /**< the rows outside [top, bottom) hold only the background */
+    int refs;
+} mask_s, *mask_t;
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    mask_t mask;        /**< the last rendered mask */
+} private_data;
+
 
 /** Returns the index of \param string in \param stringList.
  * Useful for assigning string parameters to enums. */
@@ -135,14 +159,14 @@ static int json2BCurves( cJSON *array, BPointF **points )
 }
 
 /** Blurs \param src horizontally. \See function blur. */
-static void blurHorizontal( uint8_t *src, uint8_t *dst, int width, int height, int radius)
+static void blurHorizontal( uint8_t *src, uint8_t *dst, int width, int height, int stride, int radius)
 {
     int x, y, kx, yOff, total, amount, amountInit;
     amountInit = radius * 2 + 1;
     for (y = 0; y < height; ++y)
     {
         total = 0;
-        yOff = y * width;
+        yOff = y * stride;
         // Process entire window for first pixel
         int size = MIN(radius + 1, width);
         for ( kx = 0; kx < size; ++kx )
@@ -168,7 +192,7 @@ static void blurHorizontal( uint8_t *src, uint8_t *dst, int width, int height, i
 }
 
 /** Blurs \param src vertically. \See function blur. */
-static void blurVertical( uint8_t *src, uint8_t *dst, int width, int height, int radius)
+static void blurVertical( uint8_t *src, uint8_t *dst, int width, int height, int stride, int radius)
 {
     int x, y, ky, total, amount, amountInit;
     amountInit = radius * 2 + 1;
@@ -177,43 +201,95 @@ static void blurVertical( uint8_t *src, uint8_t *dst, int width, int height, int
         total = 0;
         int size = MIN(radius + 1, height);
         for ( ky = 0; ky < size; ++ky )
-            total += src[x + ky * width];
+            total += src[x + ky * stride];
         dst[x] = total / ( radius + 1 );
         for ( y = 1; y < height; ++y )
         {
             amount = amountInit;
             if ( y - radius - 1 >= 0 )
-                total -= src[( y - radius - 1 ) * width + x];
+                total -= src[( y - radius - 1 ) * stride + x];
             else
                 amount -= radius - y;
             if ( y + radius < height )
-                total += src[( y + radius ) * width + x];
+                total += src[( y + radius ) * stride + x];
             else
                 amount -= radius - height + y;
-            dst[y * width + x] = total / amount;
+            dst[y * stride + x] = total / amount;
         }
     }
 }
 
+struct blur_desc
+{
+    uint8_t *src, *dst;
+    int width, height, stride, radius;
+};
+
+static int blur_horizontal_proc( int id, int index, int jobs, void *cookie )
+{
+    (void) id; // unused
+    struct blur_desc *ctx = (struct blur_desc*) cookie;
+    int start = ctx->height * index / jobs;
+    int end = ctx->height * ( index + 1 ) / jobs;
+    blurHorizontal( ctx->src + start * ctx->stride, ctx->dst + start * ctx->stride, ctx->width, end - start, ctx->stride, ctx->radius );
+    return 0;
+}
+
+static int blur_vertical_proc( int id, int index, int jobs, void *cookie )
+{
+    (void) id; // unused
+    struct blur_desc *ctx = (struct blur_desc*) cookie;
+    int start = ctx->width * index / jobs;
+    int end = ctx->width * ( index + 1 ) / jobs;
+    blurVertical( ctx->src + start, ctx->dst + start, end - start, ctx->height, ctx->stride, ctx->radius );
+    return 0;
+}
+
+/** Get the number of slices for processing \param size rows or columns.
+ * \param threads the requested number of slices, 0 for the default
+ */
+static int slice_count( int threads, int size )
+{
+    if ( threads == 0 )
+        threads = mlt_slices_count_normal();
+    return CLAMP( threads, 1, MAX( size / MIN_SLICE_HEIGHT, 1 ) );
+}
+
+static void run_slices( int jobs, mlt_slices_proc proc, void *cookie )
+{
+    if ( jobs > 1 )
+        mlt_slices_run_normal( jobs, proc, cookie );
+    else
+        proc( 0, 0, 1, cookie );
+}
+
 /**
  * Blurs the \param map using a simple "average" blur.
  * \param map Will be blurred; 1bpp
  * \param width x dimension of channel stored in \param map
  * \param height y dimension of channel stored in \param map
+ * \param stride distance between the rows of \param map
  * \param radius blur radius
  * \param passes blur passes
+ * \param threads the number of slices to request, 0 for the default
  */
-static void blur( uint8_t *map, int width, int height, int radius, int passes )
+static void blur( uint8_t *map, int width, int height, int stride, int radius, int passes, int threads )
 {
-    uint8_t *src = mlt_pool_alloc( width * height );
-    uint8_t *tmp = mlt_pool_alloc( width * height );
+    uint8_t *src = mlt_pool_alloc( stride * height );
+    uint8_t *tmp = mlt_pool_alloc( stride * height );
+    struct blur_desc desc = { src, tmp, width, height, stride, radius };
 
     int i;
     for ( i = 0; i < passes; ++i )
     {
-        memcpy( src, map, width * height );
-        blurHorizontal( src, tmp, width, height, radius );
-        blurVertical( tmp, map, width, height, radius );
+        for ( int y = 0; y < height; y++ )
+            memcpy( src + y * stride, map + y * stride, width );
+        desc.src = src;
+        desc.dst = tmp;
+        run_slices( slice_count( threads, height ), blur_horizontal_proc, &desc );
+        desc.src = tmp;
+        desc.dst = map;
+        run_slices( slice_count( threads, width ), blur_vertical_proc, &desc );
     }
 
     mlt_pool_release(src);
@@ -230,15 +306,14 @@ static void blur( uint8_t *map, int width, int height, int radius, int passes )
  * \param map array of integers of the dimension width * height.
  *            The map entries belonging to the points in the polygon will be set to \param set * 255 the others to !set * 255.
  */
-static void fillMap( PointF *vertices, int count, int width, int height, int invert, uint8_t *map )
+static void fillMap( PointF *vertices, int count, int width, int top, int bottom, int invert, uint8_t *map )
 {
     int nodes, nodeX[1024], pixelY, i, j, value;
 
     value = !invert * 255;
-    memset( map, invert * 255, width * height );
 
-    // Loop through the rows of the image
-    for ( pixelY = 0; pixelY < height; pixelY++ )
+    // Loop through the rows [top, bottom) of the image, which the polygon spans
+    for ( pixelY = top; pixelY < bottom; pixelY++ )
     {
         /*
          * Build a list of nodes.
@@ -246,7 +321,7 @@ static void fillMap( PointF *vertices, int count, int width, int height, int inv
          * and therefore indicate a move from in to out or vice versa
          */
         nodes = 0;
-        for ( i = 0, j = count - 1; i < count; j = i++ )
+        for ( i = 0, j = count - 1; i < count && nodes < 1024; j = i++ )
             if ( (vertices[i].y > (double)pixelY) != (vertices[j].y > (double)pixelY) )
                 nodeX[nodes++] = (int)(vertices[i].x + (pixelY - vertices[i].y) / (vertices[j].y - vertices[i].y) * (vertices[j].x - vertices[i].x) );
 
@@ -318,11 +393,298 @@ static void curvePoints( BPointF p1, BPointF p2, PointF **points, int *count, in
     (*points)[*(count)++] = p2.p;
 }
 
+struct fill_desc
+{
+    PointF *vertices;
+    int count, width, top, bottom, invert;
+    uint8_t *map;
+};
+
+static int fill_proc( int id, int index, int jobs, void *cookie )
+{
+    (void) id; // unused
+    struct fill_desc *ctx = (struct fill_desc*) cookie;
+    int rows = ctx->bottom - ctx->top;
+    int start = ctx->top + rows * index / jobs;
+    int end = ctx->top + rows * ( index + 1 ) / jobs;
+    fillMap( ctx->vertices, ctx->count, ctx->width, start, end, ctx->invert, ctx->map );
+    return 0;
+}
+
+static void mask_release( mask_t mask )
+{
+    if ( mask && --mask->refs == 0 )
+    {
+        mlt_pool_release( mask->points );
+        mlt_pool_release( mask->map );
+        free( mask );
+    }
+}
+
+static int mask_matches( mask_t mask, BPointF *points, int count, int width, int height, int invert, int feather, int passes )
+{
+    return mask && mask->count == count && mask->width == width && mask->height == height
+        && mask->invert == invert && mask->feather == feather && mask->passes == passes
+        && !memcmp( mask->points, points, count * sizeof( BPointF ) );
+}
+
+/** Rasterize the shape \param rpoints, given relative to the image size, into a new mask.
+ * \return NULL if the shape has no outline
+ */
+static mask_t mask_render( BPointF *rpoints, int bcount, int width, int height, int invert, int feather, int passes, int threads )
+{
+    BPointF *bpoints = mlt_pool_alloc( bcount * sizeof( BPointF ) + 1 );
+    struct PointF *points;
+    int count, size, i, j;
+    mask_t mask = NULL;
+
+    for ( i = 0; i < bcount; i++ )
+    {
+        // map to image dimensions
+        bpoints[i] = rpoints[i];
+        bpoints[i].h1.x *= width;
+        bpoints[i].p.x  *= width;
+        bpoints[i].h2.x *= width;
+        bpoints[i].h1.y *= height;
+        bpoints[i].p.y  *= height;
+        bpoints[i].h2.y *= height;
+    }
+
+    count = 0;
+    size = 1;
+    points = mlt_pool_alloc( size * sizeof( struct PointF ) );
+    for ( i = 0; i < bcount; i++ )
+    {
+        j = (i + 1) % bcount;
+        curvePoints( bpoints[i], bpoints[j], &points, &count, &size );
+    }
+
+    if ( count )
+    {
+        mask = calloc( 1, sizeof( *mask ) );
+        mask->points = mlt_pool_alloc( bcount * sizeof( BPointF ) + 1 );
+        memcpy( mask->points, rpoints, bcount * sizeof( BPointF ) );
+        mask->count = bcount;
+        mask->width = width;
+        mask->height = height;
+        mask->invert = invert;
+        mask->feather = feather;
+        mask->passes = passes;
+        mask->map = mlt_pool_alloc( width * height );
+        mask->refs = 1;
+        memset( mask->map, invert * 255, width * height );
+
+        // Only the bounding box of the polygon can differ from the background
+        double minX = points[0].x, maxX = points[0].x;
+        double minY = points[0].y, maxY = points[0].y;
+        for ( i = 1; i < count; i++ )
+        {
+            minX = MIN( minX, points[i].x );
+            maxX = MAX( maxX, points[i].x );
+            minY = MIN( minY, points[i].y );
+            maxY = MAX( maxY, points[i].y );
+        }
+        int left = CLAMP( floor( minX ), 0, width );
+        int right = CLAMP( ceil( maxX ) + 1, 0, width );
+        mask->top = CLAMP( floor( minY ), 0, height );
+        mask->bottom = CLAMP( floor( maxY ) + 1, 0, height );
+
+        struct fill_desc desc = { points, count, width, mask->top, mask->bottom, invert, mask->map };
+        run_slices( slice_count( threads, mask->bottom - mask->top ), fill_proc, &desc );
+
+        if ( feather && left < right && mask->top < mask->bottom )
+        {
+            // Blurring the background gives the background, so only the box around
+            // the polygon that the blur can spread into needs it.
+            int margin = ( passes + 1 ) * feather + 1;
+            left = MAX( left - margin, 0 );
+            right = MIN( right + margin, width );
+            mask->top = MAX( mask->top - margin, 0 );
+            mask->bottom = MIN( mask->bottom + margin, height );
+            if ( invert )
+            {
+                // The blur does not keep a non-zero background along the right
+                // and bottom edges of the image, so it needs all of it.
+                left = 0;
+                right = width;
+                mask->top = 0;
+                mask->bottom = height;
+            }
+            blur( mask->map + mask->top * width + left, right - left, mask->bottom - mask->top, width, feather, passes, threads );
+        }
+    }
+
+    mlt_pool_release( points );
+    mlt_pool_release( bpoints );
+
+    return mask;
+}
+
+/** Get the mask for the shape from the cache or render it.
+ * \return a reference to release with mask_release, or NULL if the shape has no outline
+ */
+static mask_t mask_get( mlt_filter filter, BPointF *points, int count, int width, int height, int invert, int feather, int passes, int threads )
+{
+    private_data *pdata = (private_data*) filter->child;
+    mask_t mask;
+
+    pthread_mutex_lock( &pdata->mutex );
+    mask = pdata->mask;
+    if ( mask_matches( mask, points, count, width, height, invert, feather, passes ) )
+        mask->refs++;
+    else
+        mask = NULL;
+    pthread_mutex_unlock( &pdata->mutex );
+
+    if ( !mask )
+    {
+        mask = mask_render( points, count, width, height, invert, feather, passes, threads );
+        if ( mask )
+        {
+            pthread_mutex_lock( &pdata->mutex );
+            mask_release( pdata->mask );
+            pdata->mask = mask;
+            mask->refs++;
+            pthread_mutex_unlock( &pdata->mutex );
+        }
+    }
+    return mask;
+}
+
+struct apply_desc
+{
+    uint8_t *image, *alpha;
+    mlt_image_format format;
+    int mode, operation, bpp, width, top, bottom;
+    mask_t mask;
+};
+
+static int apply_proc( int id, int index, int jobs, void *cookie )
+{
+    (void) id; // unused
+    struct apply_desc *ctx = (struct apply_desc*) cookie;
+    int rows = ctx->bottom - ctx->top;
+    int i = ( ctx->top + rows * index / jobs ) * ctx->width;
+    int length = ( ctx->top + rows * ( index + 1 ) / jobs ) * ctx->width;
+    uint8_t *map = ctx->mask->map;
+    uint8_t *p = ctx->image + i * ctx->bpp;
+    uint8_t *alpha = ctx->alpha ? ctx->alpha + i : NULL;
+
+    switch ( ctx->mode )
+    {
+    case MODE_RGB:
+        // *format == mlt_image_rgb
+        for ( ; i < length; i++, p += 3 )
+        {
+            if ( !map[i] )
+                p[0] = p[1] = p[2] = 0;
+        }
+        break;
+    case MODE_LUMA:
+        switch ( ctx->format )
+        {
+            case mlt_image_rgb:
+            case mlt_image_rgba:
+                for ( ; i < length; i++, p += ctx->bpp )
+                    p[0] = p[1] = p[2] = map[i];
+                break;
+            case mlt_image_yuv422:
+                for ( ; i < length; i++, p += 2 )
+                {
+                    p[0] = map[i];
+                    p[1] = 128;
+                }
+                break;
+            default:
+                break;
+        }
+        break;
+    case MODE_ALPHA:
+        switch ( ctx->format )
+        {
+        case mlt_image_rgba:
+            switch ( ctx->operation )
+            {
+            case ALPHA_CLEAR:
+                for ( ; i < length; i++, p += 4 )
+                    p[3] = map[i];
+                break;
+            case ALPHA_MAX:
+                for ( ; i < length; i++, p += 4 )
+                    p[3] = MAX( p[3], map[i] );
+                break;
+            case ALPHA_MIN:
+                for ( ; i < length; i++, p += 4 )
+                    p[3] = MIN( p[3], map[i] );
+                break;
+            case ALPHA_ADD:
+                for ( ; i < length; i++, p += 4 )
+                    p[3] = MIN( p[3] + map[i], 255 );
+                break;
+            case ALPHA_SUB:
+                for ( ; i < length; i++, p += 4 )
+                    p[3] = MAX( p[3] - map[i], 0 );
+                break;
+            }
+            break;
+        default:
+            switch ( ctx->operation )
+            {
+            case ALPHA_CLEAR:
+                memcpy( alpha, map + i, length - i );
+                break;
+            case ALPHA_MAX:
+                for ( ; i < length; i++, alpha++ )
+                    *alpha = MAX( map[i], *alpha );
+                break;
+            case ALPHA_MIN:
+                for ( ; i < length; i++, alpha++ )
+                    *alpha = MIN( map[i], *alpha );
+                break;
+            case ALPHA_ADD:
+                for ( ; i < length; i++, alpha++ )
+                    *alpha = MIN( *alpha + map[i], 255 );
+                break;
+            case ALPHA_SUB:
+                for ( ; i < length; i++, alpha++ )
+                    *alpha = MAX( *alpha - map[i], 0 );
+                break;
+            }
+            break;
+        }
+        break;
+    }
+    return 0;
+}
+
+/** Check whether applying the background value of the mask leaves the image unchanged. */
+static int background_is_identity( struct apply_desc *desc )
+{
+    switch ( desc->mode )
+    {
+    case MODE_RGB:
+        return desc->mask->invert;
+    case MODE_ALPHA:
+        switch ( desc->operation )
+        {
+        case ALPHA_MAX:
+        case ALPHA_ADD:
+        case ALPHA_SUB:
+            return !desc->mask->invert;
+        case ALPHA_MIN:
+            return desc->mask->invert;
+        }
+        break;
+    }
+    return 0;
+}
+
 /** Do it :-).
 */
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
     mlt_properties unique = mlt_frame_pop_service( frame );
+    mlt_filter filter = mlt_properties_get_data( unique, "_filter", NULL );
 
     int mode = mlt_properties_get_int( unique, "mode" );
 
@@ -335,185 +697,96 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
     if ( !error )
     {
         BPointF *bpoints;
-        struct PointF *points;
-        int bcount, length, count, size, i, j;
+        int length, bcount;
         bpoints = mlt_properties_get_data( unique, "points", &length );
         bcount = length / sizeof( BPointF );
 
-        for ( i = 0; i < bcount; i++ )
+        int invert = mlt_properties_get_int( unique, "invert" );
+        int feather = mlt_properties_get_int( unique, "feather" );
+        int passes = 0;
+        int threads = CLAMP( mlt_properties_get_int( unique, "threads" ), 0, mlt_slices_count_normal() );
+        if ( feather && mode != MODE_RGB )
         {
-            // map to image dimensions
-            bpoints[i].h1.x *= *width;
-            bpoints[i].p.x  *= *width;
-            bpoints[i].h2.x *= *width;
-            bpoints[i].h1.y *= *height;
-            bpoints[i].p.y  *= *height;
-            bpoints[i].h2.y *= *height;
+            // Adapt feathering to consumer scaling
+            mlt_profile profile = mlt_service_profile( MLT_FILTER_SERVICE( (mlt_filter) unique ) );
+            double scale_width = mlt_profile_scale_width( profile, *width );
+            feather = MAX( 1, (int) ( feather * scale_width ) );
+            passes = mlt_properties_get_int( unique, "feather_passes" );
         }
-
-        count = 0;
-        size = 1;
-        points = mlt_pool_alloc( size * sizeof( struct PointF ) );
-        for ( i = 0; i < bcount; i++ )
+        else
         {
-            j = (i + 1) % bcount;
-            curvePoints( bpoints[i], bpoints[j], &points, &count, &size );
+            feather = 0;
         }
 
-        if ( count )
+        mask_t mask = mask_get( filter, bpoints, bcount, *width, *height, invert, feather, passes, threads );
+        if ( mask )
         {
             length = *width * *height;
-            uint8_t *map = mlt_pool_alloc( length );
-            int invert = mlt_properties_get_int( unique, "invert" );
-            fillMap( points, count, *width, *height, invert, map );
-
-            int feather = mlt_properties_get_int( unique, "feather" );
-            if ( feather && mode != MODE_RGB )
+            struct apply_desc desc = {
+                .image = *image,
+                .format = *format,
+                .mode = mode,
+                .operation = mlt_properties_get_int( unique, "alpha_operation" ),
+                .width = *width,
+                .top = 0,
+                .bottom = *height,
+                .mask = mask
+            };
+            mlt_image_format_size( *format, *width, *height, &desc.bpp );
+
+            if ( mode == MODE_ALPHA && *format != mlt_image_rgba )
             {
-                // Adapt feathering to consumer scaling
-                mlt_profile profile = mlt_service_profile( MLT_FILTER_SERVICE( (mlt_filter) unique ) );
-                double scale_width = mlt_profile_scale_width( profile, *width );
-                feather = MAX( 1, (int) ( feather * scale_width ) );
-                blur( map, *width, *height, feather, mlt_properties_get_int( unique, "feather_passes" ) );
+                desc.alpha = mlt_frame_get_alpha( frame );
+                if ( !desc.alpha )
+                {
+                    desc.alpha = mlt_pool_alloc( length );
+                    memset( desc.alpha, 255, length );
+                    mlt_frame_set_alpha( frame, desc.alpha, length, mlt_pool_release );
+                }
             }
 
-            int bpp;
-            size = mlt_image_format_size( *format, *width, *height, &bpp );
-            uint8_t *p = *image;
-            uint8_t *q = *image + size;
-
-            i = 0;
-            uint8_t *alpha;
+            if ( background_is_identity( &desc ) )
+            {
+                // Outside of the rows of the shape the mask only holds the background
+                desc.top = mask->top;
+                desc.bottom = mask->bottom;
+            }
 
-            switch ( mode )
+            if ( mode == MODE_LUMA && *format == mlt_image_yuv420p )
             {
-            case MODE_RGB:
-                // *format == mlt_image_rgb
-                while ( p != q )
-                {
-                    if ( !map[i++] )
-                        p[0] = p[1] = p[2] = 0;
-                    p += 3;
-                }
-                break;
-            case MODE_LUMA:
-                switch ( *format )
-                {
-                    case mlt_image_rgb:
-                    case mlt_image_rgba:
-                        while ( p != q )
-                        {
-                            p[0] = p[1] = p[2] = map[i++];
-                            p += bpp;
-                        }
-                        break;
-                    case mlt_image_yuv422:
-                        while ( p != q )
-                        {
-                            p[0] = map[i++];
-                            p[1] = 128;
-                            p += 2;
-                        }
-                        break;
-                    case mlt_image_yuv420p:
-                        memcpy( p, map, length );
-                        memset( p + length, 128, length / 2 );
-                        break;
-                    default:
-                        break;
-                }
-                break;
-            case MODE_ALPHA:
-                switch ( *format )
-                {
-                case mlt_image_rgba:
-                    switch ( mlt_properties_get_int( unique, "alpha_operation" ) )
-                    {
-                    case ALPHA_CLEAR:
-                        while ( p != q )
-                        {
-                            p[3] = map[i++];
-                            p += 4;
-                        }
-                        break;
-                    case ALPHA_MAX:
-                        while ( p != q )
-                        {
-                            p[3] = MAX( p[3], map[i] );
-                            p += 4;
-                            i++;
-                        }
-                        break;
-                    case ALPHA_MIN:
-                        while ( p != q )
-                        {
-                            p[3] = MIN( p[3], map[i] );
-                            p += 4;
-                            i++;
-                        }
-                        break;
-                    case ALPHA_ADD:
-                        while ( p != q )
-                        {
-                            p[3] = MIN( p[3] + map[i], 255 );
-                            p += 4;
-                            i++;
-                        }
-                        break;
-                    case ALPHA_SUB:
-                        while ( p != q )
-                        {
-                            p[3] = MAX( p[3] - map[i], 0 );
-                            p += 4;
-                            i++;
-                        }
-                        break;
-                    }
-                    break;
-                default:
-                    alpha = mlt_frame_get_alpha( frame );
-                    if ( !alpha )
-                    {
-                        alpha = mlt_pool_alloc( length );
-                        memset( alpha, 255, length );
-                        mlt_frame_set_alpha( frame, alpha, length, mlt_pool_release );
-                    }
-                    switch ( mlt_properties_get_int( unique, "alpha_operation" ) )
-                    {
-                    case ALPHA_CLEAR:
-                        memcpy( alpha, map, length );
-                        break;
-                    case ALPHA_MAX:
-                        for ( ; i < length; i++, alpha++ )
-                            *alpha = MAX( map[i], *alpha );
-                        break;
-                    case ALPHA_MIN:
-                        for ( ; i < length; i++, alpha++ )
-                            *alpha = MIN( map[i], *alpha );
-                        break;
-                    case ALPHA_ADD:
-                        for ( ; i < length; i++, alpha++ )
-                            *alpha = MIN( *alpha + map[i], 255 );
-                        break;
-                    case ALPHA_SUB:
-                        for ( ; i < length; i++, alpha++ )
-                            *alpha = MAX( *alpha - map[i], 0 );
-                        break;
-                    }
-                    break;
-                }
-                break;
+                memcpy( *image, mask->map, length );
+                memset( *image + length, 128, length / 2 );
+            }
+            else if ( desc.top < desc.bottom )
+            {
+                run_slices( slice_count( threads, desc.bottom - desc.top ), apply_proc, &desc );
             }
 
-            mlt_pool_release( map );
+            mask_release( mask );
         }
-
-        mlt_pool_release( points );
     }
 
     return error;
 }
 
+/** Release the cached mask.
+*/
+static void filter_close( mlt_filter filter )
+{
+    private_data *pdata = (private_data*) filter->child;
+
+    if ( pdata )
+    {
+        mask_release( pdata->mask );
+        pthread_mutex_destroy( &pdata->mutex );
+        free( pdata );
+    }
+    filter->child = NULL;
+    filter->close = NULL;
+    filter->parent.close = NULL;
+    mlt_service_close( &filter->parent );
+}
+
 /** Filter processing.
 */
 static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
@@ -612,6 +885,8 @@ static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
     mlt_properties_set_int( unique, "invert", mlt_properties_get_int( properties, "invert" ) );
     mlt_properties_set_int( unique, "feather", mlt_properties_get_int( properties, "feather" ) );
     mlt_properties_set_int( unique, "feather_passes", mlt_properties_get_int( properties, "feather_passes" ) );
+    mlt_properties_set_int( unique, "threads", mlt_properties_get_int( properties, "threads" ) );
+    mlt_properties_set_data( unique, "_filter", filter, 0, NULL, NULL );
     mlt_frame_push_service( frame, unique );
     mlt_frame_push_get_image( frame, filter_get_image );
 
@@ -623,8 +898,12 @@ static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
 mlt_filter filter_rotoscoping_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg )
 {
         mlt_filter filter = mlt_filter_new( );
-        if ( filter )
+        private_data *pdata = (private_data*) calloc( 1, sizeof( private_data ) );
+        if ( filter && pdata )
         {
+                pthread_mutex_init( &pdata->mutex, NULL );
+                filter->child = pdata;
+                filter->close = filter_close;
                 filter->process = filter_process;
                 mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
                 mlt_properties_set( properties, "mode", "alpha" );
@@ -637,5 +916,12 @@ mlt_filter filter_rotoscoping_init( mlt_profile profile, mlt_service_type type,
 
                 mlt_events_listen( properties, filter, "property-changed", (mlt_listener)rotoPropertyChanged );
         }
+        else
+        {
+                if ( filter )
+                    mlt_filter_close( filter );
+                free( pdata );
+                filter = NULL;
+        }
         return filter;
 }
@@ -20,6 +20,10 @@
 #include <QApplication>
 #include <QLocale>
 #include <QImage>
+#include <QPainter>
+#include <QTransform>
+
+#define MIN_BAND_HEIGHT (64)
 
 #if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
 #include <X11/Xlib.h>
@@ -126,3 +130,116 @@ int create_image( mlt_frame frame, uint8_t **image, mlt_image_format *image_form
 
 	return error;
 }
+
+struct paint_tiled_desc
+{
+	QImage *image;
+	uchar *bits;
+	const std::function<void ( QPainter &painter )> *paint;
+};
+
+static int paint_tiled_slice( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	paint_tiled_desc *desc = static_cast<paint_tiled_desc*>( cookie );
+	int width = desc->image->width();
+	int height = desc->image->height();
+	int top = height * index / jobs;
+	int bottom = height * ( index + 1 ) / jobs;
+
+	// Each thread needs its own QImage on the shared pixels to have its own painter.
+	QImage band( desc->bits, width, height, desc->image->bytesPerLine(), desc->image->format() );
+	QPainter painter( &band );
+	painter.setClipRect( 0, top, width, bottom - top );
+	( *desc->paint )( painter );
+	painter.end();
+	return 0;
+}
+
+/** Paint on an image with a painter per band of rows on the slice threads.
+ *
+ * \p paint is called once for each band with a painter that is clipped to it
+ * and must draw the entire picture the same way each time; pixels are only
+ * written within the band, so the result is the same as painting it once. It
+ * must only read shared data, so anything that is computed for the picture
+ * has to be prepared before painting.
+ */
+
+void paint_tiled( QImage *image, const std::function<void ( QPainter &painter )> &paint )
+{
+	int threads = qBound( 1, mlt_slices_count_normal(), qMax( image->height() / MIN_BAND_HEIGHT, 1 ) );
+	if ( threads == 1 )
+	{
+		QPainter painter( image );
+		paint( painter );
+		painter.end();
+	}
+	else
+	{
+		paint_tiled_desc desc;
+		desc.image = image;
+		desc.bits = image->bits();
+		desc.paint = &paint;
+		mlt_slices_run_normal( threads, paint_tiled_slice, &desc );
+	}
+}
+
+/** Composite an rgba image over another without QPainter if that is simple.
+ *
+ * This only handles a transform that moves the source by whole pixels with the
+ * source-over composition mode, so the source pixels map one to one onto the
+ * destination; anything else returns false for the caller to paint it with Qt.
+ * Both images are straight (not premultiplied) alpha, as MLT uses. A source
+ * rectangle limits the blending to the part of the source that is not transparent.
+ */
+
+bool blend_rgba_translated( const QTransform &transform, int compositing, double opacity,
+	const uint8_t *src, int src_width, int src_height, uint8_t *dest, int width, int height,
+	const QRect *src_rect )
+{
+	if ( compositing != QPainter::CompositionMode_SourceOver || transform.type() > QTransform::TxTranslate )
+		return false;
+	int dx = qRound( transform.dx() );
+	int dy = qRound( transform.dy() );
+	if ( qAbs( transform.dx() - dx ) > 1e-6 || qAbs( transform.dy() - dy ) > 1e-6 )
+		return false;
+
+	// Only the part of the source in src_rect, if given, is blended
+	QRect rect( 0, 0, src_width, src_height );
+	if ( src_rect )
+		rect &= *src_rect;
+	int x0 = qMax( dx + rect.x(), 0 );
+	int y0 = qMax( dy + rect.y(), 0 );
+	int x1 = qMin( dx + rect.x() + rect.width(), width );
+	int y1 = qMin( dy + rect.y() + rect.height(), height );
+	int weight = qBound( 0, qRound( opacity * 256 ), 256 );
+	if ( x0 >= x1 || y0 >= y1 || weight == 0 )
+		return true;
+
+	for ( int y = y0; y < y1; y++ )
+	{
+		const uint8_t *s = src + ( ( y - dy ) * src_width + x0 - dx ) * 4;
+		uint8_t *d = dest + ( y * width + x0 ) * 4;
+		for ( int x = x0; x < x1; x++, s += 4, d += 4 )
+		{
+			int sa = ( s[3] * weight ) >> 8;
+			if ( sa == 255 )
+			{
+				d[0] = s[0];
+				d[1] = s[1];
+				d[2] = s[2];
+				d[3] = 255;
+			}
+			else if ( sa > 0 )
+			{
+				int da = d[3] * ( 255 - sa ) / 255;
+				int oa = sa + da;
+				d[0] = ( s[0] * sa + d[0] * da + oa / 2 ) / oa;
+				d[1] = ( s[1] * sa + d[1] * da + oa / 2 ) / oa;
+				d[2] = ( s[2] * sa + d[2] * da + oa / 2 ) / oa;
+				d[3] = oa;
+			}
+		}
+	}
+	return true;
+}
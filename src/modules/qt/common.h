@@ -20,12 +20,20 @@
 #define COMMON_H
 
 #include <framework/mlt.h>
+#include <functional>
 
 class QImage;
+class QPainter;
+class QRect;
+class QTransform;
 
 bool createQApplicationIfNeeded(mlt_service service);
 void convert_qimage_to_mlt_rgba( QImage* qImg, uint8_t* mImg, int width, int height );
 void convert_mlt_to_qimage_rgba( uint8_t* mImg, QImage* qImg, int width, int height );
+bool blend_rgba_translated( const QTransform &transform, int compositing, double opacity,
+	const uint8_t *src, int src_width, int src_height, uint8_t *dest, int width, int height,
+	const QRect *src_rect = nullptr );
+void paint_tiled( QImage *image, const std::function<void ( QPainter &painter )> &paint );
 int create_image( mlt_frame frame, uint8_t **image, mlt_image_format *image_format, int *width, int *height, int writable );
 
 #endif // COMMON_H
@@ -201,16 +201,12 @@ static void draw_spectrum( mlt_filter filter, mlt_frame frame, QImage* qimg, int
 	double tension = mlt_properties_get_double( filter_properties, "tension" );
 
 	QRectF r( rect.x, rect.y, rect.w, rect.h );
-	QPainter p( qimg );
 
 	if( mirror ) {
 		// Draw two half rectangle instead of one full rectangle.
 		r.setHeight( r.height() / 2.0 );
 	}
 
-	setup_graph_painter( p, r, filter_properties );
-	setup_graph_pen( p, r, filter_properties, scale );
-
 	int bands = mlt_properties_get_int( filter_properties, "bands" );
 	if ( bands == 0 ) {
 		// "0" means match rectangle width
@@ -220,27 +216,30 @@ static void draw_spectrum( mlt_filter filter, mlt_frame frame, QImage* qimg, int
 
 	convert_fft_to_spectrum( filter, frame, bands, spectrum );
 
-	if( graph_type && graph_type[0] == 'b' ) {
-		paint_bar_graph( p, r, bands, spectrum );
-	} else {
-		paint_line_graph( p, r, bands, spectrum, tension, fill );
-	}
-
-	if( mirror ) {
-		// Second rectangle is mirrored.
-		p.translate( 0, r.y() * 2 + r.height() * 2 );
-		p.scale( 1, -1 );
+	paint_tiled( qimg, [&]( QPainter &p ) {
+		setup_graph_painter( p, r, filter_properties );
+		setup_graph_pen( p, r, filter_properties, scale );
 
 		if( graph_type && graph_type[0] == 'b' ) {
 			paint_bar_graph( p, r, bands, spectrum );
 		} else {
 			paint_line_graph( p, r, bands, spectrum, tension, fill );
 		}
-	}
 
-	mlt_pool_release( spectrum );
+		if( mirror ) {
+			// Second rectangle is mirrored.
+			p.translate( 0, r.y() * 2 + r.height() * 2 );
+			p.scale( 1, -1 );
 
-	p.end();
+			if( graph_type && graph_type[0] == 'b' ) {
+				paint_bar_graph( p, r, bands, spectrum );
+			} else {
+				paint_line_graph( p, r, bands, spectrum, tension, fill );
+			}
+		}
+	});
+
+	mlt_pool_release( spectrum );
 }
 /** Get the image.
 */
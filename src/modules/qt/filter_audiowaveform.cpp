@@ -281,10 +281,6 @@ static void draw_waveforms( mlt_filter filter, mlt_frame frame, QImage* qimg,
 
 	QRectF r( rect.x, rect.y, rect.w, rect.h );
 
-	QPainter p( qimg );
-
-	setup_graph_painter( p, r, filter_properties );
-
 	if ( show_channel == -1 ) // Combine all channels
 	{
 		if( channels > 1 )
@@ -304,29 +300,31 @@ static void draw_waveforms( mlt_filter filter, mlt_frame frame, QImage* qimg,
 		}
 		show_channel = 1;
 	}
+	if ( show_channel > channels ) {
+		// Sanity
+		show_channel = 1;
+	}
 
-	if ( show_channel == 0 ) // Show all channels
-	{
-		QRectF c_rect = r;
-		qreal c_height = r.height() / channels;
-		for ( int c = 0; c < channels; c++ )
+	paint_tiled( qimg, [&]( QPainter &p ) {
+		setup_graph_painter( p, r, filter_properties );
+
+		if ( show_channel == 0 ) // Show all channels
 		{
-			// Divide the rectangle into smaller rectangles for each channel.
-			c_rect.setY( r.y() + c_height * c );
-			c_rect.setHeight( c_height );
-			setup_graph_pen( p, c_rect, filter_properties, scale );
-			paint_waveform( p, c_rect, audio + c, samples, channels, fill );
-		}
-	} else if ( show_channel > 0 ) { // Show one specific channel
-		if ( show_channel > channels ) {
-			// Sanity
-			show_channel = 1;
+			QRectF c_rect = r;
+			qreal c_height = r.height() / channels;
+			for ( int c = 0; c < channels; c++ )
+			{
+				// Divide the rectangle into smaller rectangles for each channel.
+				c_rect.setY( r.y() + c_height * c );
+				c_rect.setHeight( c_height );
+				setup_graph_pen( p, c_rect, filter_properties, scale );
+				paint_waveform( p, c_rect, audio + c, samples, channels, fill );
+			}
+		} else if ( show_channel > 0 ) { // Show one specific channel
+			setup_graph_pen( p, r, filter_properties, scale );
+			paint_waveform( p, r, audio + show_channel - 1, samples, channels, fill );
 		}
-		setup_graph_pen( p, r, filter_properties, scale );
-		paint_waveform( p, r, audio + show_channel - 1, samples, channels, fill );
-	}
-
-	p.end();
+	});
 }
 
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *image_format, int *width, int *height, int writable )
@@ -149,6 +149,8 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	}
 
 	error = mlt_frame_get_image( frame, &src_image, format, &b_width, &b_height, 0 );
+	if ( mlt_frame_is_cancelled( frame ) )
+		return 1;
 
 	// Put source buffer into QImage
 	QImage sourceImage;
@@ -186,16 +188,19 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	convert_mlt_to_qimage_rgba( dest_image, &destImage, *width, *height );
 	destImage.fill( mlt_properties_get_int( properties, "background_color" ) );
 
-	QPainter painter( &destImage );
-	painter.setCompositionMode( ( QPainter::CompositionMode ) mlt_properties_get_int( properties, "compositing" ) );
-	painter.setRenderHints( QPainter::Antialiasing | QPainter::SmoothPixmapTransform );
-	painter.setTransform(transform);
-	painter.setOpacity(opacity);
-	// Composite top frame
-	painter.drawImage(0, 0, sourceImage);
-	// finish Qt drawing
-	painter.end();
-	convert_qimage_to_mlt_rgba( &destImage, dest_image, *width, *height );
+	int compositing = mlt_properties_get_int( properties, "compositing" );
+	if ( !blend_rgba_translated( transform, compositing, opacity, src_image, b_width, b_height, dest_image, *width, *height ) )
+	{
+		paint_tiled( &destImage, [&]( QPainter &painter ) {
+			painter.setCompositionMode( ( QPainter::CompositionMode ) compositing );
+			painter.setRenderHints( QPainter::Antialiasing | QPainter::SmoothPixmapTransform );
+			painter.setTransform(transform);
+			painter.setOpacity(opacity);
+			// Composite top frame
+			painter.drawImage(0, 0, sourceImage);
+		});
+		convert_qimage_to_mlt_rgba( &destImage, dest_image, *width, *height );
+	}
 	*image = dest_image;
 	mlt_frame_set_image( frame, *image, *width * *height * 4, mlt_pool_release );
 	return error;
@@ -36,6 +36,27 @@ static int get_image(mlt_frame frame, uint8_t **image, mlt_image_format *format,
 	mlt_position length = mlt_filter_get_length2(filter, frame);
 	mlt_rect rect = mlt_properties_anim_get_rect(properties, "rect", position, length);
 
+	// Nothing outside of the crop rect is needed, apart from its color
+	mlt_rect roi;
+	mlt_frame_get_roi(frame, &roi);
+	if (!mlt_properties_get_int(properties, "circle")) {
+		const char* s = mlt_properties_get(properties, "rect");
+		bool percent = qstrlen(s) > 0 && strchr(s, '%');
+		double x0 = percent ? rect.x : rect.x / profile->width;
+		double y0 = percent ? rect.y : rect.y / profile->height;
+		double x1 = x0 + (percent ? rect.w : rect.w / profile->width);
+		double y1 = y0 + (percent ? rect.h : rect.h / profile->height);
+		x0 = MAX(x0, roi.x);
+		y0 = MAX(y0, roi.y);
+		x1 = MIN(x1, roi.x + roi.w);
+		y1 = MIN(y1, roi.y + roi.h);
+		roi.x = x0;
+		roi.y = y0;
+		roi.w = x1 - x0;
+		roi.h = y1 - y0;
+		mlt_frame_set_roi(frame, roi);
+	}
+
 	// Get the current image
 	*format = mlt_image_rgba;
 	mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "resize_alpha", 255);
@@ -123,6 +123,47 @@ static QRectF get_text_path( QPainterPath* qpath, mlt_properties filter_properti
 	return QRectF( 0, 0, width, height );
 }
 
+struct text_path_cache
+{
+	QByteArray signature;
+	QPainterPath path;
+	QRectF rect;
+};
+
+static void close_text_path_cache( void* p )
+{
+	delete static_cast<text_path_cache*>( p );
+}
+
+/** Get the text path, laying out the text again only if it or its font changed.
+ */
+static QRectF get_cached_text_path( QPainterPath* qpath, mlt_properties filter_properties, const char* text, double scale )
+{
+	QByteArray signature = QByteArray( text ) + '\0'
+		+ QByteArray::number( scale ) + ' '
+		+ mlt_properties_get( filter_properties, "family" ) + ' '
+		+ mlt_properties_get( filter_properties, "size" ) + ' '
+		+ mlt_properties_get( filter_properties, "weight" ) + ' '
+		+ mlt_properties_get( filter_properties, "style" ) + ' '
+		+ mlt_properties_get( filter_properties, "halign" ) + ' '
+		+ mlt_properties_get( filter_properties, "outline" ) + ' '
+		+ mlt_properties_get( filter_properties, "pad" );
+	text_path_cache* cache = static_cast<text_path_cache*>( mlt_properties_get_data( filter_properties, "_text_path_cache", NULL ) );
+	if ( !cache )
+	{
+		cache = new text_path_cache;
+		mlt_properties_set_data( filter_properties, "_text_path_cache", cache, 0, close_text_path_cache, NULL );
+	}
+	if ( cache->signature != signature || cache->path.isEmpty() )
+	{
+		cache->path = QPainterPath();
+		cache->rect = get_text_path( &cache->path, filter_properties, text, scale );
+		cache->signature = signature;
+	}
+	*qpath = cache->path;
+	return cache->rect;
+}
+
 static QColor get_qcolor( mlt_properties filter_properties, const char* name )
 {
 	mlt_color color = mlt_properties_get_color( filter_properties, name );
@@ -334,9 +375,10 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		auto pixel_ratio = 1.0;
 #endif
 		QRectF path_rect(0, 0, rect.w / scale * pixel_ratio, rect.h / scale_height * pixel_ratio);
-		QPainter painter( &qimg );
-		painter.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::HighQualityAntialiasing );
 		if (isRichText) {
+			// A QTextDocument can not be drawn from several threads at once.
+			QPainter painter( &qimg );
+			painter.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::HighQualityAntialiasing );
 			auto overflowY = mlt_properties_exists(filter_properties, "overflow-y")?
 				!!mlt_properties_get_int(filter_properties, "overflow-y") :
 				(path_rect.height() >= profile->height * pixel_ratio);
@@ -351,13 +393,20 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 				paint_background(&painter, path_rect, filter_properties);
 				doc->drawContents(&painter, drawRect);
 			}
+			painter.end();
 		} else {
-			path_rect = get_text_path(&text_path, filter_properties, argument, scale);
-			transform_painter(&painter, rect, path_rect, filter_properties, profile);
-			paint_background(&painter, path_rect, filter_properties);
-			paint_text(&painter, &text_path, filter_properties);
+			path_rect = get_cached_text_path(&text_path, filter_properties, argument, scale);
+			paint_tiled( &qimg, [&]( QPainter &painter ) {
+				// Paint a copy of the path as painting caches data in it.
+				QPainterPath path;
+				path.addPath( text_path );
+				path.setFillRule( text_path.fillRule() );
+				painter.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::HighQualityAntialiasing );
+				transform_painter(&painter, rect, path_rect, filter_properties, profile);
+				paint_background(&painter, path_rect, filter_properties);
+				paint_text(&painter, &path, filter_properties);
+			});
 		}
-		painter.end();
 
 		convert_qimage_to_mlt_rgba( &qimg, *image, *width, *height );
 	}
@@ -48,6 +48,9 @@ struct FilterContainer {
     int producer_type;      // 1 - kdenlivetitle
     mlt_producer producer;  // hold producer pointer
 
+    std::string rendered_xml;   // the data last rendered by the producer
+    void * rendered_image;      // the image the producer cached for it
+
     FilterContainer() {
         clean();
     }
@@ -65,6 +68,8 @@ struct FilterContainer {
         macro = 0;
         producer_type = 0;
         producer = nullptr;
+        rendered_xml.clear();
+        rendered_image = nullptr;
     }
 };
 
@@ -239,6 +244,22 @@ static int update_producer(mlt_frame frame, mlt_properties /*frame_p*/, FilterCo
     return 1;
 }
 
+/*
+ * Check if the producer still holds the image of the text of this frame,
+ * so it does not need to reload the title.
+ */
+static bool is_rendered(FilterContainer * cont, mlt_position pos)
+{
+    if (cont->producer_type != 1 || cont->rendered_image == nullptr)
+        return false;
+    unsigned int n = cont->xp.getContentNodesNumber();
+    for (uint i = 0; i < n; ++i)
+        cont->xp.setNodeContent(i, cont->renders[i].render(pos).c_str());
+    mlt_properties producer_properties = MLT_PRODUCER_PROPERTIES( cont->producer );
+    return cont->xp.getDocument().toStdString() == cont->rendered_xml
+        && mlt_properties_get_data( producer_properties, "_cached_image", NULL ) == cont->rendered_image;
+}
+
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int /*writable*/ )
 {
     int error = 0;
@@ -253,12 +274,30 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 
     int res = get_producer_data(properties, frame_properties, cont);
     if (res == 0)
+    {
+        mlt_service_unlock(MLT_FILTER_SERVICE(filter));
         return mlt_frame_get_image( frame, image, format, width, height, 1 );
+    }
+
+    // The typewriter text usually changes only every few frames.
+    if (cont->init && is_rendered(cont, mlt_frame_original_position( frame )))
+    {
+        error = mlt_frame_get_image( frame, image, format, width, height, 1 );
+        mlt_service_unlock(MLT_FILTER_SERVICE(filter));
+        return error;
+    }
 
     update_producer(frame, frame_properties, cont, false);
 
     error = mlt_frame_get_image( frame, image, format, width, height, 1 );
 
+    if (cont->producer_type == 1)
+    {
+        mlt_properties producer_properties = MLT_PRODUCER_PROPERTIES( cont->producer );
+        const char * xml = mlt_properties_get( producer_properties, cont->is_template ? "_xmldata" : "xmldata" );
+        cont->rendered_xml = xml ? xml : "";
+        cont->rendered_image = mlt_properties_get_data( producer_properties, "_cached_image", NULL );
+    }
     update_producer(frame, frame_properties, cont, true);
 
     mlt_service_unlock(MLT_FILTER_SERVICE(filter));
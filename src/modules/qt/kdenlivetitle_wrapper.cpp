@@ -50,6 +50,7 @@
 #endif
 
 #include <memory>
+#include <limits>
 
 Q_DECLARE_METATYPE(QTextCursor);
 Q_DECLARE_METATYPE(std::shared_ptr<TypeWriter>);
@@ -165,7 +166,10 @@ public:
 		updateText(text);
 	}
 
-	void updateText(QString text) {
+	// Returns false if the text is unchanged.
+	bool updateText(QString text) {
+		if ( text == m_text && !m_lines.isEmpty() )
+			return false;
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 13, 0))
 		m_path.clear();
 #else
@@ -173,22 +177,38 @@ public:
 #endif
 		// Calculate line width
 		QStringList lines = text.split('\n');
+		QVector<QPainterPath> linePaths;
+		linePaths.reserve(lines.count());
 		double linePos = m_metrics.ascent();
-		foreach(const QString &line, lines)
+		for (int i = 0; i < lines.count(); i++)
 		{
+			const QString &line = lines.at(i);
 			QPainterPath linePath;
-			linePath.addText(0, linePos, m_font, line);
-			linePos += m_lineSpacing;
-			if ( m_align == Qt::AlignHCenter )
+			if ( i < m_lines.count() && m_lines.at(i) == line )
+			{
+				// Lines are laid out only when they change, as typewriter text grows at the end.
+				linePath = m_linePaths.at(i);
+			}
+			else
 			{
-				double offset = (m_width - m_metrics.width(line)) / 2;
-				linePath.translate(offset, 0);
-			} else if ( m_align == Qt::AlignRight ) {
-				double offset = (m_width - m_metrics.width(line));
-				linePath.translate(offset, 0);
+				linePath.addText(0, linePos, m_font, line);
+				if ( m_align == Qt::AlignHCenter )
+				{
+					double offset = (m_width - m_metrics.width(line)) / 2;
+					linePath.translate(offset, 0);
+				} else if ( m_align == Qt::AlignRight ) {
+					double offset = (m_width - m_metrics.width(line));
+					linePath.translate(offset, 0);
+				}
 			}
+			linePos += m_lineSpacing;
 			m_path.addPath(linePath);
+			linePaths << linePath;
 		}
+		m_text = text;
+		m_lines = lines;
+		m_linePaths = linePaths;
+		return true;
 	}
 
 	virtual QRectF boundingRect() const
@@ -246,6 +266,9 @@ private:
 	QImage m_shadow;
 	QPoint m_shadowOffset;
 	QPainterPath m_path;
+	QString m_text;
+	QStringList m_lines;
+	QVector<QPainterPath> m_linePaths;
 	QBrush m_brush;
 	QPen m_pen;
 	QFont m_font;
@@ -687,6 +710,36 @@ void loadFromXml( producer_ktitle self, QGraphicsScene *scene, const char *templ
 }
 
 
+/** Get the visible top level items below the lowest animated one.
+ *
+ * These are painted the same on every frame of a title, so they can be
+ * rendered once into a layer that the rest of the scene is painted over.
+ */
+
+static QList<QGraphicsItem *> static_items( QGraphicsScene *scene )
+{
+	QList <QGraphicsItem *> items = scene->items();
+	qreal lowest = std::numeric_limits<qreal>::max();
+	for (int i = 0; i < items.count(); i++) {
+		PlainTextItem *titem = dynamic_cast <PlainTextItem*> ( items.at( i ) );
+		if (titem && !titem->data( 0 ).isNull())
+			lowest = qMin( lowest, titem->topLevelItem()->zValue() );
+	}
+	QList <QGraphicsItem *> result;
+	for (int i = 0; i < items.count(); i++) {
+		QGraphicsItem *item = items.at( i );
+		if (!item->parentItem() && item->isVisible() && item->zValue() < lowest)
+			result << item;
+	}
+	return result;
+}
+
+static void set_items_visible( const QList<QGraphicsItem *> &items, bool visible )
+{
+	for (int i = 0; i < items.count(); i++)
+		items.at( i )->setVisible( visible );
+}
+
 void drawKdenliveTitle( producer_ktitle self, mlt_frame frame, mlt_image_format format, int width, int height, double position, int force_refresh )
 {
 	// Obtain the producer
@@ -701,8 +754,10 @@ void drawKdenliveTitle( producer_ktitle self, mlt_frame frame, mlt_image_format
 
 	// Check if user wants us to reload the image or if we need animation
 	bool animated = mlt_properties_get( producer_props, "_endrect" ) != NULL;
+	// Typewriter text changes the content, but the scene stays in place.
+	bool typewriter = mlt_properties_get( producer_props, "_animated" ) != NULL;
 
-	if ( mlt_properties_get( producer_props, "_animated" ) != NULL || force_refresh == 1 || width != self->current_width || height != self->current_height || animated )
+	if ( force_refresh == 1 || width != self->current_width || height != self->current_height || animated )
 	{
 		if ( !animated )
 		{
@@ -710,13 +765,14 @@ void drawKdenliveTitle( producer_ktitle self, mlt_frame frame, mlt_image_format
 			self->current_image = NULL;
 			mlt_properties_set_data( producer_props, "_cached_image", NULL, 0, NULL, NULL );
 		}
+		mlt_properties_set_data( producer_props, "_static_layer", NULL, 0, NULL, NULL );
+		mlt_properties_set( producer_props, "_rendered_text", NULL );
 		mlt_properties_set_int( producer_props, "force_reload", 0 );
 	}
 	int image_size = width * height * 4;
-	if ( self->current_image == NULL || animated ) {
+	if ( self->current_image == NULL || animated || typewriter ) {
 		// restore QGraphicsScene
 		QGraphicsScene *scene = static_cast<QGraphicsScene *> (mlt_properties_get_data( producer_props, "qscene", NULL ));
-		self->current_alpha = NULL;
 
 		if ( force_refresh == 1 && scene )
 		{
@@ -726,6 +782,8 @@ void drawKdenliveTitle( producer_ktitle self, mlt_frame frame, mlt_image_format
 
 		if ( scene == NULL )
 		{
+			mlt_properties_set_data( producer_props, "_static_layer", NULL, 0, NULL, NULL );
+			mlt_properties_set( producer_props, "_rendered_text", NULL );
 			if ( !createQApplicationIfNeeded( MLT_PRODUCER_SERVICE(producer) ) ) {
 				pthread_mutex_unlock( &self->mutex );
 				return;
@@ -761,82 +819,129 @@ void drawKdenliveTitle( producer_ktitle self, mlt_frame frame, mlt_image_format
 		// Effects
 		QList <QGraphicsItem *> items = scene->items();
 		PlainTextItem *titem = NULL;
+		QByteArray rendered_text;
 		for (int i = 0; i < items.count(); i++) {
 			titem = dynamic_cast <PlainTextItem*> ( items.at( i ) );
 			if (titem && !titem->data( 0 ).isNull()) {
 				std::shared_ptr<TypeWriter> ptr = titem->data( 0 ).value<std::shared_ptr<TypeWriter>>();
-				titem->updateText(ptr->render(position).c_str());
-				titem->updateShadows();
+				std::string text = ptr->render(position);
+				if (titem->updateText(text.c_str()))
+					titem->updateShadows();
+				rendered_text.append( text.c_str() ).append( '\x1f' );
 			}
 		}
-
-		//must be extracted from kdenlive title
-		self->rgba_image = (uint8_t *) mlt_pool_alloc( image_size );
+		// The whole title is unchanged if the text of the typewriter items is.
+		const char *last_text = mlt_properties_get( producer_props, "_rendered_text" );
+		bool unchanged = !animated && self->current_image && last_text && rendered_text == last_text;
+		mlt_properties_set( producer_props, "_rendered_text", rendered_text.constData() );
+		if ( !unchanged ) {
+			self->current_alpha = NULL;
+
+			//must be extracted from kdenlive title
+			self->rgba_image = (uint8_t *) mlt_pool_alloc( image_size );
 #if QT_VERSION >= 0x050200
-		// QImage::Format_RGBA8888 was added in Qt5.2
-		// Initialize the QImage with the MLT image because the data formats match.
-		QImage img( self->rgba_image, width, height, QImage::Format_RGBA8888 );
+			// QImage::Format_RGBA8888 was added in Qt5.2
+			// Initialize the QImage with the MLT image because the data formats match.
+			QImage img( self->rgba_image, width, height, QImage::Format_RGBA8888 );
 #else
-		QImage img( width, height, QImage::Format_ARGB32 );
+			QImage img( width, height, QImage::Format_ARGB32 );
 #endif
-		img.fill( 0 );
-		QPainter p1;
-		p1.begin( &img );
-		p1.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::HighQualityAntialiasing );
-		//| QPainter::SmoothPixmapTransform );
-		mlt_position anim_out = mlt_properties_get_position( producer_props, "_animation_out" );
-
-		if (end.isNull())
-		{
-			scene->render( &p1, source, start, Qt::IgnoreAspectRatio );
-		}
-		else if ( position > anim_out ) {
-			scene->render( &p1, source, end, Qt::IgnoreAspectRatio );
-		}
-		else {
-			double percentage = 0;
-			if ( position && anim_out )
-				percentage = position / anim_out;
-			QPointF topleft = start.topLeft() + ( end.topLeft() - start.topLeft() ) * percentage;
-			QPointF bottomRight = start.bottomRight() + ( end.bottomRight() - start.bottomRight() ) * percentage;
-			const QRectF r1( topleft, bottomRight );
-			scene->render( &p1, source, r1, Qt::IgnoreAspectRatio );
-			if ( profile && !profile->progressive ){
-				int line=0;
-				double percentage_next_filed	= ( position + 0.5 ) / anim_out;
-				QPointF topleft_next_field = start.topLeft() + ( end.topLeft() - start.topLeft() ) * percentage_next_filed;
-				QPointF bottomRight_next_field = start.bottomRight() + ( end.bottomRight() - start.bottomRight() ) * percentage_next_filed;
-				const QRectF r2( topleft_next_field, bottomRight_next_field );
-				QImage img1( width, height, QImage::Format_ARGB32 );
-				img1.fill( 0 );
-				QPainter p2;
-				p2.begin(&img1);
-				p2.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::HighQualityAntialiasing );
-				scene->render(&p2,source,r2,  Qt::IgnoreAspectRatio );
-				p2.end();
-				int next_field_line = (  mlt_properties_get_int( producer_props, "top_field_first" ) ? 1 : 0 );
-				for (line = next_field_line ;line<height;line+=2){
-					memcpy(img.scanLine(line),img1.scanLine(line),img.bytesPerLine());
+			QList <QGraphicsItem *> layer_items;
+#if QT_VERSION >= 0x050200
+			if ( typewriter && !animated )
+			{
+				// Render the items under the typewriter text once and paint the rest over them.
+				layer_items = static_items( scene );
+				uint8_t *layer = (uint8_t *) mlt_properties_get_data( producer_props, "_static_layer", NULL );
+				if ( !layer )
+				{
+					layer = (uint8_t *) mlt_pool_alloc( image_size );
+					QImage layer_img( layer, width, height, QImage::Format_RGBA8888 );
+					layer_img.fill( 0 );
+					QList <QGraphicsItem *> others = scene->items();
+					for (int i = others.count() - 1; i >= 0; i--) {
+						if ( others.at( i )->parentItem() || !others.at( i )->isVisible() || layer_items.contains( others.at( i ) ) )
+							others.removeAt( i );
+					}
+					set_items_visible( others, false );
+					QPainter p;
+					p.begin( &layer_img );
+					p.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::HighQualityAntialiasing );
+					scene->render( &p, source, start, Qt::IgnoreAspectRatio );
+					p.end();
+					set_items_visible( others, true );
+					mlt_properties_set_data( producer_props, "_static_layer", layer, image_size, mlt_pool_release, NULL );
 				}
+				memcpy( self->rgba_image, layer, image_size );
+				set_items_visible( layer_items, false );
+			}
+#endif
+			if ( layer_items.isEmpty() )
+				img.fill( 0 );
+			QPainter p1;
+			p1.begin( &img );
+			p1.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::HighQualityAntialiasing );
+			//| QPainter::SmoothPixmapTransform );
+			mlt_position anim_out = mlt_properties_get_position( producer_props, "_animation_out" );
+
+			if (end.isNull())
+			{
+				scene->render( &p1, source, start, Qt::IgnoreAspectRatio );
+			}
+			else if ( position > anim_out ) {
+				scene->render( &p1, source, end, Qt::IgnoreAspectRatio );
+			}
+			else {
+				double percentage = 0;
+				if ( position && anim_out )
+					percentage = position / anim_out;
+				QPointF topleft = start.topLeft() + ( end.topLeft() - start.topLeft() ) * percentage;
+				QPointF bottomRight = start.bottomRight() + ( end.bottomRight() - start.bottomRight() ) * percentage;
+				const QRectF r1( topleft, bottomRight );
+				scene->render( &p1, source, r1, Qt::IgnoreAspectRatio );
+				if ( profile && !profile->progressive ){
+					int line=0;
+					double percentage_next_filed	= ( position + 0.5 ) / anim_out;
+					QPointF topleft_next_field = start.topLeft() + ( end.topLeft() - start.topLeft() ) * percentage_next_filed;
+					QPointF bottomRight_next_field = start.bottomRight() + ( end.bottomRight() - start.bottomRight() ) * percentage_next_filed;
+					const QRectF r2( topleft_next_field, bottomRight_next_field );
+					QImage img1( width, height, QImage::Format_ARGB32 );
+					img1.fill( 0 );
+					QPainter p2;
+					p2.begin(&img1);
+					p2.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::HighQualityAntialiasing );
+					scene->render(&p2,source,r2,  Qt::IgnoreAspectRatio );
+					p2.end();
+					int next_field_line = (  mlt_properties_get_int( producer_props, "top_field_first" ) ? 1 : 0 );
+					for (line = next_field_line ;line<height;line+=2){
+						memcpy(img.scanLine(line),img1.scanLine(line),img.bytesPerLine());
+					}
+				}
+			}
+			p1.end();
+			set_items_visible( layer_items, true );
+			self->format = mlt_image_rgba;
+
+			convert_qimage_to_mlt_rgba(&img, self->rgba_image, width, height);
+
+			// Find the items once for compositors to skip the transparent rest
+			struct mlt_image_s rendered;
+			mlt_image_set_values( &rendered, self->rgba_image, mlt_image_rgba, width, height );
+			self->alpha_opaque = mlt_image_alpha_bounds( &rendered, &self->alpha_bounds );
+			self->current_image = (uint8_t *) mlt_pool_alloc( image_size );
+			memcpy( self->current_image, self->rgba_image, image_size );
+			mlt_properties_set_data( producer_props, "_cached_buffer", self->rgba_image, image_size, mlt_pool_release, NULL );
+			mlt_properties_set_data( producer_props, "_cached_image", self->current_image, image_size, mlt_pool_release, NULL );
+			self->current_width = width;
+			self->current_height = height;
+
+			uint8_t *alpha = NULL;
+			if ( ( alpha = mlt_frame_get_alpha( frame ) ) )
+			{
+				self->current_alpha = (uint8_t*) mlt_pool_alloc( width * height );
+				memcpy( self->current_alpha, alpha, width * height );
+				mlt_properties_set_data( producer_props, "_cached_alpha", self->current_alpha, width * height, mlt_pool_release, NULL );
 			}
-		}
-		p1.end();
-		self->format = mlt_image_rgba;
-
-		convert_qimage_to_mlt_rgba(&img, self->rgba_image, width, height);
-		self->current_image = (uint8_t *) mlt_pool_alloc( image_size );
-		memcpy( self->current_image, self->rgba_image, image_size );
-		mlt_properties_set_data( producer_props, "_cached_buffer", self->rgba_image, image_size, mlt_pool_release, NULL );
-		mlt_properties_set_data( producer_props, "_cached_image", self->current_image, image_size, mlt_pool_release, NULL );
-		self->current_width = width;
-		self->current_height = height;
-
-		uint8_t *alpha = NULL;
-		if ( ( alpha = mlt_frame_get_alpha( frame ) ) )
-		{
-			self->current_alpha = (uint8_t*) mlt_pool_alloc( width * height );
-			memcpy( self->current_alpha, alpha, width * height );
-			mlt_properties_set_data( producer_props, "_cached_alpha", self->current_alpha, width * height, mlt_pool_release, NULL );
 		}
 	}
 
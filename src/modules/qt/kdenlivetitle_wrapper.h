@@ -39,6 +39,8 @@ struct producer_ktitle_s
 	int current_width;
 	int current_height;
 	int has_alpha;
+	mlt_rect alpha_bounds;
+	int alpha_opaque;
 	pthread_mutex_t mutex;
 };
 
@@ -112,6 +112,7 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 			memcpy( image_copy, self->current_alpha, self->current_width * self->current_height );
 			mlt_frame_set_alpha( frame, image_copy, self->current_width * self->current_height, mlt_pool_release );
 		}
+		mlt_frame_set_alpha_bounds( frame, self->alpha_bounds, self->alpha_opaque );
 	}
 	else
 	{
@@ -82,6 +82,7 @@ mlt_producer producer_qimage_init( mlt_profile profile, mlt_service_type type, c
 		mlt_properties_set_int( properties, "aspect_ratio", 1 );
 		mlt_properties_set_int( properties, "progressive", 1 );
 		mlt_properties_set_int( properties, "seekable", 1 );
+		mlt_properties_set_int( properties, "prefetch_memory", 512 );
 
 		// Validate the resource
 		if ( filename )
@@ -368,6 +369,7 @@ static void producer_close( mlt_producer parent )
 	parent->close = NULL;
 	mlt_service_cache_purge( MLT_PRODUCER_SERVICE(parent) );
 	mlt_producer_close( parent );
+	close_prefetch( self );
 	mlt_properties_close( self->filenames );
 	free( self );
 }
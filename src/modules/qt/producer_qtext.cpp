@@ -292,11 +292,6 @@ static void generate_qimage( mlt_properties frame_properties )
 	qImg->fill( QColor( bg_color.r, bg_color.g, bg_color.b, bg_color.a ).rgba() );
 
 	// Draw the text
-	QPainter painter( qImg );
-	// Scale the painter rather than the image for better looking results.
-	painter.scale( sx, sy );
-	painter.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::HighQualityAntialiasing );
-
 	QPen pen;
 	pen.setWidth( outline );
 	if( outline )
@@ -307,10 +302,27 @@ static void generate_qimage( mlt_properties frame_properties )
 	{
 		pen.setColor( QColor( bg_color.r, bg_color.g, bg_color.b, bg_color.a ) );
 	}
-	painter.setPen( pen );
 	QBrush brush( QColor( fg_color.r, fg_color.g, fg_color.b, fg_color.a ) );
-	painter.setBrush( brush );
-	painter.drawPath( *qPath );
+	paint_tiled( qImg, [&]( QPainter &painter ) {
+		// Scale the painter rather than the image for better looking results.
+		painter.scale( sx, sy );
+		painter.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::HighQualityAntialiasing );
+		painter.setPen( pen );
+		painter.setBrush( brush );
+		// Paint a copy of the path as painting caches data in it.
+		QPainterPath path;
+		path.addPath( *qPath );
+		path.setFillRule( qPath->fillRule() );
+		painter.drawPath( path );
+	});
+
+	// Find the text once for compositors to skip the transparent background
+	struct mlt_image_s image;
+	mlt_rect bounds;
+	mlt_image_set_values( &image, qImg->bits(), mlt_image_rgba, qImg->width(), qImg->height() );
+	int opaque = mlt_image_alpha_bounds( &image, &bounds );
+	mlt_properties_set_rect( producer_properties, "_alpha_bounds", bounds );
+	mlt_properties_set_int( producer_properties, "_alpha_opaque", opaque );
 }
 
 static int producer_get_image( mlt_frame frame, uint8_t** buffer, mlt_image_format* format, int* width, int* height, int writable )
@@ -339,6 +351,8 @@ static int producer_get_image( mlt_frame frame, uint8_t** buffer, mlt_image_form
 	img_size = mlt_image_format_size( *format, *width, *height, NULL );
 	*buffer = static_cast<uint8_t*>( mlt_pool_alloc( img_size ) );
 	copy_qimage_to_mlt_image( qImg, *buffer );
+	mlt_rect bounds = mlt_properties_get_rect( producer_properties, "_alpha_bounds" );
+	int opaque = mlt_properties_get_int( producer_properties, "_alpha_opaque" );
 
 	mlt_service_unlock( MLT_PRODUCER_SERVICE( producer ) );
 
@@ -350,6 +364,7 @@ static int producer_get_image( mlt_frame frame, uint8_t** buffer, mlt_image_form
 	// Update the frame
 	mlt_frame_set_image( frame, *buffer, img_size, mlt_pool_release );
 	mlt_frame_set_alpha( frame, alpha, alpha_size, mlt_pool_release );
+	mlt_frame_set_alpha_bounds( frame, bounds, opaque );
 	mlt_properties_set_int( frame_properties, "width", *width );
 	mlt_properties_set_int( frame_properties, "height", *height );
 
@@ -27,6 +27,11 @@
 #include <QImage>
 #include <QSysInfo>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QMap>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
 #include <QtEndian>
 #include <QTemporaryFile>
 #include <QImageReader>
@@ -40,6 +45,151 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+static QImage read_qimage( const QString &filename, bool auto_transform )
+{
+	QImageReader reader;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+	// Use Qt's orientation detection
+	reader.setAutoTransform( auto_transform );
+#else
+	Q_UNUSED( auto_transform );
+#endif
+	reader.setDecideFormatFromContent( true );
+	reader.setFileName( filename );
+	return reader.read();
+}
+
+/** Decodes the next images of a sequence on a thread pool ahead of the playhead.
+ *
+ * The images are looked ahead in the direction the sequence is played in and
+ * decoded nearest first, within a memory budget. Images that are no longer
+ * ahead of the playhead are dropped.
+ */
+
+class ImagePrefetch
+{
+public:
+	ImagePrefetch() : m_serial( 0 ), m_last( -1 ), m_direction( 1 )
+	{
+		m_pool.setMaxThreadCount( qMax( 1, QThread::idealThreadCount() / 2 ) );
+	}
+	~ImagePrefetch()
+	{
+		m_mutex.lock();
+		m_entries.clear();
+		m_mutex.unlock();
+		m_pool.clear();
+		m_pool.waitForDone();
+	}
+
+	/** Get an image, waiting for it if it is being decoded, or else decoding it. */
+	QImage take( int index, const QString &filename, bool auto_transform )
+	{
+		QMutexLocker locker( &m_mutex );
+		QMap<int, Entry>::iterator it = m_entries.find( index );
+		while ( it != m_entries.end() && it->state == Entry::Decoding && it->auto_transform == auto_transform )
+		{
+			m_done.wait( &m_mutex );
+			it = m_entries.find( index );
+		}
+		if ( it != m_entries.end() )
+		{
+			QImage image = it->image;
+			bool ready = it->state == Entry::Done && it->auto_transform == auto_transform;
+			// A queued image is decoded here rather than waited for.
+			m_entries.erase( it );
+			if ( ready )
+				return image;
+		}
+		locker.unlock();
+		return read_qimage( filename, auto_transform );
+	}
+
+	/** Look ahead of the image at \p index, playing \p ahead images and up to \p budget bytes. */
+	void schedule( producer_qimage self, int index, int ahead, qint64 budget, qint64 image_size, bool auto_transform )
+	{
+		QMutexLocker locker( &m_mutex );
+		int step = index - m_last;
+		if ( m_last >= 0 && step != 0 && qAbs( step ) <= ahead + 1 )
+			m_direction = step > 0 ? 1 : -1;
+		m_last = index;
+
+		int n = qMin( qMin( ahead, self->count - 1 ), int( budget / qMax( image_size, qint64( 1 ) ) ) );
+		QMap<int, Entry> wanted;
+		for ( int i = 1; i <= n; i++ )
+		{
+			int next = ( ( index + i * m_direction ) % self->count + self->count ) % self->count;
+			QMap<int, Entry>::iterator it = m_entries.find( next );
+			if ( it != m_entries.end() && it->auto_transform == auto_transform )
+			{
+				wanted.insert( next, *it );
+				continue;
+			}
+			Entry entry;
+			entry.state = Entry::Queued;
+			entry.serial = ++m_serial;
+			entry.auto_transform = auto_transform;
+			wanted.insert( next, entry );
+			QString filename = QString::fromUtf8( mlt_properties_get_value( self->filenames, next ) );
+			// Nearest first
+			m_pool.start( new Task( this, next, entry.serial, filename, auto_transform ), n - i );
+		}
+		m_entries.swap( wanted );
+		// Wake anyone waiting for an image that was dropped.
+		m_done.wakeAll();
+	}
+
+private:
+	struct Entry
+	{
+		enum State { Queued, Decoding, Done } state;
+		int serial;
+		bool auto_transform;
+		QImage image;
+	};
+
+	class Task : public QRunnable
+	{
+	public:
+		Task( ImagePrefetch *prefetch, int index, int serial, const QString &filename, bool auto_transform )
+			: m_prefetch( prefetch ), m_index( index ), m_serial( serial ), m_filename( filename ), m_auto_transform( auto_transform ) {}
+		void run() override { m_prefetch->decode( m_index, m_serial, m_filename, m_auto_transform ); }
+	private:
+		ImagePrefetch *m_prefetch;
+		int m_index;
+		int m_serial;
+		QString m_filename;
+		bool m_auto_transform;
+	};
+
+	void decode( int index, int serial, const QString &filename, bool auto_transform )
+	{
+		QMutexLocker locker( &m_mutex );
+		QMap<int, Entry>::iterator it = m_entries.find( index );
+		if ( it == m_entries.end() || it->serial != serial || it->state != Entry::Queued )
+			return;
+		it->state = Entry::Decoding;
+		locker.unlock();
+		QImage image = read_qimage( filename, auto_transform );
+		locker.relock();
+		it = m_entries.find( index );
+		if ( it != m_entries.end() && it->serial == serial )
+		{
+			it->image = image;
+			it->state = Entry::Done;
+		}
+		m_done.wakeAll();
+	}
+
+	QMutex m_mutex;
+	QWaitCondition m_done;
+	QMap<int, Entry> m_entries;
+	QThreadPool m_pool;
+	int m_serial;
+	int m_last;
+	int m_direction;
+};
+
 extern "C" {
 
 #include <framework/mlt_pool.h>
@@ -171,14 +321,23 @@ int refresh_qimage( producer_qimage self, mlt_frame frame, int enable_caching )
 	if ( !self->qimage || mlt_properties_get_int( producer_props, "_disable_exif" ) != disable_exif )
 	{
 		self->current_image = NULL;
-		QImageReader reader;
-#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
-		// Use Qt's orientation detection
-		reader.setAutoTransform(!disable_exif);
-#endif
-		reader.setDecideFormatFromContent( true );
-		reader.setFileName( QString::fromUtf8( mlt_properties_get_value( self->filenames, image_idx ) ) );
-		QImage *qimage = new  QImage( reader.read() );
+		QString filename = QString::fromUtf8( mlt_properties_get_value( self->filenames, image_idx ) );
+		int prefetch = mlt_properties_get_int( producer_props, "prefetch" );
+		QImage *qimage;
+		if ( prefetch > 0 && self->count > 1 )
+		{
+			if ( !self->prefetch )
+				self->prefetch = new ImagePrefetch;
+			ImagePrefetch *prefetcher = static_cast<ImagePrefetch*>( self->prefetch );
+			qimage = new QImage( prefetcher->take( image_idx, filename, !disable_exif ) );
+			qint64 budget = qint64( mlt_properties_get_int( producer_props, "prefetch_memory" ) ) << 20;
+			prefetcher->schedule( self, image_idx, prefetch, budget, qimage->sizeInBytes(), !disable_exif );
+		}
+		else
+		{
+			close_prefetch( self );
+			qimage = new QImage( read_qimage( filename, !disable_exif ) );
+		}
 		self->qimage = qimage;
 
 		if ( !qimage->isNull( ) )
@@ -458,4 +617,10 @@ int load_sequence_sprintf(producer_qimage self, mlt_properties properties, const
 	return result;
 }
 
+void close_prefetch( producer_qimage self )
+{
+	delete static_cast<ImagePrefetch*>( self->prefetch );
+	self->prefetch = NULL;
+}
+
 } // extern "C"
@@ -45,6 +45,7 @@ struct producer_qimage_s
 	mlt_cache_item qimage_cache;
 	void *qimage;
 	mlt_image_format format;
+	void *prefetch;
 };
 
 typedef struct producer_qimage_s *producer_qimage;
@@ -54,6 +55,7 @@ extern void refresh_image( producer_qimage, mlt_frame, mlt_image_format, int wid
 extern void make_tempfile( producer_qimage, const char *xml );
 extern int init_qimage(mlt_producer producer, const char *filename);
 extern int load_sequence_sprintf( producer_qimage self, mlt_properties properties, const char *filename );
+extern void close_prefetch( producer_qimage self );
 
 
 #ifdef __cplusplus
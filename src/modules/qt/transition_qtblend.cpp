@@ -46,6 +46,10 @@ static int get_image( mlt_frame a_frame, uint8_t **image, mlt_image_format *form
 	// Get current position
 	mlt_position position =  mlt_transition_get_position( transition, a_frame );
 
+	// The region of the a image that is needed
+	mlt_rect roi;
+	mlt_frame_get_roi( a_frame, &roi );
+
 	// Obtain the normalised width and height from the a_frame
 	mlt_profile profile = mlt_service_profile( MLT_TRANSITION_SERVICE( transition ) );
 	int normalised_width = profile->width;
@@ -185,9 +189,13 @@ static int get_image( mlt_frame a_frame, uint8_t **image, mlt_image_format *form
 	// Check if we have transparency
 	if ( !hasAlpha )
 	{
-		// fetch image
+		// fetch image, which replaces the a image
+		mlt_frame_set_roi( b_frame, roi );
 		error = mlt_frame_get_image( b_frame, &b_image, format, width, height, 1 );
-		if ( *format == mlt_image_rgba || mlt_frame_get_alpha( b_frame ) )
+		mlt_rect bounds;
+		int opaque = 0;
+		mlt_frame_get_alpha_bounds( b_frame, &bounds, &opaque );
+		if ( !opaque && ( *format == mlt_image_rgba || mlt_frame_get_alpha( b_frame ) ) )
 		{
 			hasAlpha = true;
 		}
@@ -200,24 +208,55 @@ static int get_image( mlt_frame a_frame, uint8_t **image, mlt_image_format *form
 		free( interps );
 		return 0;
 	}
+	// Only the part of the b image that the transform puts inside the region of interest is needed
+	bool invertible = false;
+	QTransform inverse = transform.inverted( &invertible );
+	if ( invertible && b_width > 0 && b_height > 0 )
+	{
+		QRectF region = inverse.mapRect( QRectF( roi.x * *width, roi.y * *height, roi.w * *width, roi.h * *height ) );
+		// Allow for the reach of smooth painting
+		region.adjust( -2, -2, 2, 2 );
+		mlt_rect b_roi = { region.x() / b_width, region.y() / b_height, region.width() / b_width, region.height() / b_height, 1.0 };
+		mlt_frame_set_roi( b_frame, b_roi );
+	}
+
 	// Get RGBA image to process
 	*format = mlt_image_rgba;
 	error = mlt_frame_get_image( b_frame, &b_image, format, &b_width, &b_height, writable );
 
+	// Blending over leaves the bottom image alone where the top one is transparent
+	int compositing = mlt_properties_get_int( transition_properties, "compositing" );
+	QRect boundsRect( 0, 0, b_width, b_height );
+	mlt_rect bounds;
+	int opaque;
+	if ( !error && mlt_frame_get_alpha_bounds( b_frame, &bounds, &opaque ) && compositing == QPainter::CompositionMode_SourceOver )
+	{
+		// Allow for the reach of smooth painting
+		boundsRect &= QRect( bounds.x - 2, bounds.y - 2, bounds.w + 4, bounds.h + 4 );
+		if ( bounds.w <= 0 || bounds.h <= 0 || boundsRect.isEmpty() )
+		{
+			free( interps );
+			return mlt_frame_get_image( a_frame, image, format, width, height, 1 );
+		}
+	}
+
 	// Get bottom frame
 	uint8_t *a_image = NULL;
 	error = mlt_frame_get_image( a_frame, &a_image, format, width, height, 1 );
+	if ( !error && mlt_frame_is_cancelled( a_frame ) )
+		error = 1;
 	if (error)
 	{
 		free( interps );
 		return error;
 	}
-	// Prepare output image
-	int image_size = mlt_image_format_size( *format, *width, *height, NULL );
-	*image = (uint8_t *) mlt_pool_alloc( image_size );
-
-	// Copy bottom frame in output
-	memcpy( *image, a_image, image_size );
+	// Composite in place on the bottom frame
+	*image = a_image;
+	if ( blend_rgba_translated( transform, compositing, opacity, b_image, b_width, b_height, *image, *width, *height, &boundsRect ) )
+	{
+		free( interps );
+		return error;
+	}
 
 	bool hqPainting = false;
 	if ( interps )
@@ -237,20 +276,15 @@ static int get_image( mlt_frame a_frame, uint8_t **image, mlt_image_format *form
 	convert_mlt_to_qimage_rgba( b_image, &topImg, b_width, b_height );
 
 
-	// setup Qt drawing
-	QPainter painter( &bottomImg );
-	painter.setCompositionMode( ( QPainter::CompositionMode ) mlt_properties_get_int( transition_properties, "compositing" ) );
-	painter.setRenderHints( QPainter::Antialiasing | QPainter::SmoothPixmapTransform, hqPainting );
-	painter.setTransform(transform);
-	painter.setOpacity(opacity);
-
 	// Composite top frame
-	painter.drawImage(0, 0, topImg);
-
-	// finish Qt drawing
-	painter.end();
+	paint_tiled( &bottomImg, [&]( QPainter &painter ) {
+		painter.setCompositionMode( ( QPainter::CompositionMode ) compositing );
+		painter.setRenderHints( QPainter::Antialiasing | QPainter::SmoothPixmapTransform, hqPainting );
+		painter.setTransform(transform);
+		painter.setOpacity(opacity);
+		painter.drawImage(QPointF(boundsRect.topLeft()), topImg, QRectF(boundsRect));
+	});
 	convert_qimage_to_mlt_rgba( &bottomImg, *image, *width, *height );
-	mlt_frame_set_image( a_frame, *image, image_size, mlt_pool_release);
 	free( interps );
 	return error;
 }
@@ -19,7 +19,9 @@
  */
 
 #include "common.h"
+#include "vqm_simd.h"
 #include <framework/mlt.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <stdio.h>
@@ -30,76 +32,176 @@
 #include <QFont>
 #include <QString>
 
-static double calc_psnr( const uint8_t *a, const uint8_t *b, int size, int bpp )
+// The bytes of each plane in a row of packed yuv422: sample i is at offset + step * i
+static const int plane_offset[3] = { 0, 1, 3 };
+static const int plane_step[3] = { 2, 4, 4 };
+
+/** The work shared by the slices, which each take a run of bands of lines.
+ * A band is as high as a window, so the ssim of a window comes from one band.
+ */
+
+struct vqm_desc
+{
+	const uint8_t *a, *b;
+	int width, height;
+	int window_size;
+	int band;               // the lines in a band
+	int bands;
+	int windows_x[3], windows_y;
+	vqm_simd_columns simd;
+	uint32_t *columns;      // the sums of each byte of a row for each slice
+	uint64_t *sse;          // the sum of squared differences of each plane for each slice
+	double *ssim[3];        // the ssim of each window of each plane
+};
+
+static double calc_ssim( const uint32_t *sums, int stride, int offset, int step, int window_size )
 {
-	double mse = 0.0;
-	int n = size + 1;
+	double	ref_acc = 0.0,
+			ref_acc_2 = 0.0,
+			cmp_acc = 0.0,
+			cmp_acc_2 = 0.0,
+			ref_cmp_acc = 0.0;
 
-	while ( --n )
+	// accumulate the pixel values for this window from the sums of its columns
+	for ( int i = 0; i < window_size; ++i )
 	{
-		int diff = *a - *b;
-		mse += diff * diff;
-		a += bpp;
-		b += bpp;
+		int c = offset + step * i;
+		ref_acc += sums[vqm_sum_a * stride + c];
+		ref_acc_2 += sums[vqm_sum_a2 * stride + c];
+		cmp_acc += sums[vqm_sum_b * stride + c];
+		cmp_acc_2 += sums[vqm_sum_b2 * stride + c];
+		ref_cmp_acc += sums[vqm_sum_ab * stride + c];
 	}
 
-	return 10.0 * log10( 255.0 * 255.0 / ( mse == 0 ? 1e-10 : mse/size ) );
+	// compute the SSIM for this window
+	// http://en.wikipedia.org/wiki/SSIM
+	// http://en.wikipedia.org/wiki/Variance
+	// http://en.wikipedia.org/wiki/Covariance
+	double n_samples = window_size * window_size,
+			ref_avg = ref_acc / n_samples,
+			ref_var = ref_acc_2 / n_samples - ref_avg * ref_avg,
+			cmp_avg = cmp_acc / n_samples,
+			cmp_var = cmp_acc_2 / n_samples - cmp_avg * cmp_avg,
+			ref_cmp_cov = ref_cmp_acc / n_samples - ref_avg * cmp_avg,
+			c1 = 6.5025, // (0.01*255.0)^2
+			c2 = 58.5225, // (0.03*255)^2
+			ssim_num = (2.0 * ref_avg * cmp_avg + c1) * (2.0 * ref_cmp_cov + c2),
+			ssim_den = (ref_avg * ref_avg + cmp_avg * cmp_avg + c1) * (ref_var + cmp_var + c2);
+
+	return ssim_num / ssim_den;
 }
 
-static double calc_ssim( const uint8_t *a, const uint8_t *b, int width, int height, int window_size, int bpp )
+static int calc_slice( int id, int index, int jobs, void *cookie )
 {
-	int	windows_x = width / window_size;
-	int windows_y = height / window_size;
-	double	avg = 0.0;
+	vqm_desc *desc = (vqm_desc*) cookie;
+	int stride = 2 * desc->width;
+	uint32_t *sums = desc->columns + (size_t) index * vqm_sums * stride;
+	uint64_t *sse = desc->sse + 3 * index;
+	int per_slice = ( desc->bands + jobs - 1 ) / jobs;
+	int last = MIN( ( index + 1 ) * per_slice, desc->bands );
+
+	for ( int band = index * per_slice; band < last; band++ )
+	{
+		int top = band * desc->band;
+		int lines = MIN( desc->band, desc->height - top );
 
-	if ( !windows_x || !windows_y )
-		return 0.0;
+		// add up each column of the band
+		memset( sums, 0, vqm_sums * stride * sizeof( uint32_t ) );
+		for ( int line = top; line < top + lines; line++ )
+		{
+			const uint8_t *a = desc->a + (size_t) line * stride;
+			const uint8_t *b = desc->b + (size_t) line * stride;
+			int i = desc->simd ? desc->simd( a, b, stride, sums, stride ) : 0;
+			for ( ; i < stride; i++ )
+			{
+				sums[vqm_sum_a * stride + i] += a[i];
+				sums[vqm_sum_a2 * stride + i] += a[i] * a[i];
+				sums[vqm_sum_b * stride + i] += b[i];
+				sums[vqm_sum_b2 * stride + i] += b[i] * b[i];
+				sums[vqm_sum_ab * stride + i] += a[i] * b[i];
+			}
+		}
 
-	// for each window
-	for ( int y = 0; y < windows_y; ++y )
-		for ( int x = 0; x < windows_x; ++x )
+		// the squared differences are a^2 + b^2 - 2ab
+		for ( int i = 0; i < stride; i++ )
 		{
-			int	base_offset = x * window_size + y * window_size * width;
-			double	ref_acc = 0.0,
-					ref_acc_2 = 0.0,
-					cmp_acc = 0.0,
-					cmp_acc_2 = 0.0,
-					ref_cmp_acc = 0.0;
-
-			// accumulate the pixel values for this window
-			for ( int j = 0; j < window_size; ++j )
-				for ( int i = 0; i < window_size; ++i )
-				{
-					uint8_t c_a = a[bpp * (base_offset + j * width + i)];
-					uint8_t c_b = b[bpp * (base_offset + j * width + i)];
-					ref_acc += c_a;
-					ref_acc_2 += c_a * c_a;
-					cmp_acc += c_b;
-					cmp_acc_2 += c_b * c_b;
-					ref_cmp_acc += c_a * c_b;
-				}
-
-			// compute the SSIM for this window
-			// http://en.wikipedia.org/wiki/SSIM
-			// http://en.wikipedia.org/wiki/Variance
-			// http://en.wikipedia.org/wiki/Covariance
-			double n_samples = window_size * window_size,
-					ref_avg = ref_acc / n_samples,
-					ref_var = ref_acc_2 / n_samples - ref_avg * ref_avg,
-					cmp_avg = cmp_acc / n_samples,
-					cmp_var = cmp_acc_2 / n_samples - cmp_avg * cmp_avg,
-					ref_cmp_cov = ref_cmp_acc / n_samples - ref_avg * cmp_avg,
-					c1 = 6.5025, // (0.01*255.0)^2
-					c2 = 58.5225, // (0.03*255)^2
-					ssim_num = (2.0 * ref_avg * cmp_avg + c1) * (2.0 * ref_cmp_cov + c2),
-					ssim_den = (ref_avg * ref_avg + cmp_avg * cmp_avg + c1) * (ref_var + cmp_var + c2);
-
-			// accumulate the SSIM
-			avg += ssim_num / ssim_den;
+			int plane = i & 1 ? 1 + ( ( i >> 1 ) & 1 ) : 0;
+			sse[plane] += (int64_t) sums[vqm_sum_a2 * stride + i] + sums[vqm_sum_b2 * stride + i]
+				- 2 * (int64_t) sums[vqm_sum_ab * stride + i];
 		}
 
-	// return the average SSIM
-	return avg / windows_x / windows_y;
+		if ( band < desc->windows_y )
+			for ( int plane = 0; plane < 3; plane++ )
+				for ( int x = 0; x < desc->windows_x[plane]; x++ )
+					desc->ssim[plane][band * desc->windows_x[plane] + x] = calc_ssim( sums, stride,
+						plane_offset[plane] + plane_step[plane] * x * desc->window_size, plane_step[plane], desc->window_size );
+	}
+	return 0;
+}
+
+/** Measure the psnr and ssim of each plane of a yuv422 image against another.
+ *
+ * The sums are exact integers and the ssim of the windows are added in order,
+ * so slicing does not change the results.
+ */
+
+static void calc_metrics( const uint8_t *a, const uint8_t *b, int width, int height, int window_size, double psnr[3], double ssim[3] )
+{
+	vqm_desc desc;
+	int stride = 2 * width;
+	int windows = 0;
+
+	desc.a = a;
+	desc.b = b;
+	desc.width = width;
+	desc.height = height;
+	desc.window_size = window_size;
+	desc.band = window_size > 0 ? window_size : 1;
+	desc.bands = ( height + desc.band - 1 ) / desc.band;
+	desc.windows_y = window_size > 0 ? height / window_size : 0;
+	desc.windows_x[0] = window_size > 0 ? width / window_size : 0;
+	desc.windows_x[1] = desc.windows_x[2] = window_size > 0 ? width / 2 / window_size : 0;
+	desc.simd = vqm_simd_get();
+	for ( int plane = 0; plane < 3; plane++ )
+		windows += desc.windows_x[plane] * desc.windows_y;
+
+	int jobs = CLAMP( mlt_slices_count_normal(), 1, MAX( desc.bands, 1 ) );
+	desc.columns = (uint32_t*) malloc( (size_t) jobs * vqm_sums * stride * sizeof( uint32_t ) );
+	desc.sse = (uint64_t*) calloc( 3 * jobs, sizeof( uint64_t ) );
+	desc.ssim[0] = (double*) malloc( MAX( windows, 1 ) * sizeof( double ) );
+	desc.ssim[1] = desc.ssim[0] + desc.windows_x[0] * desc.windows_y;
+	desc.ssim[2] = desc.ssim[1] + desc.windows_x[1] * desc.windows_y;
+
+	for ( int plane = 0; plane < 3; plane++ )
+		psnr[plane] = ssim[plane] = 0.0;
+	if ( desc.columns && desc.sse && desc.ssim[0] && stride > 0 )
+	{
+		if ( jobs == 1 )
+			calc_slice( 0, 0, 1, &desc );
+		else
+			mlt_slices_run_normal( jobs, calc_slice, &desc );
+
+		for ( int plane = 0; plane < 3; plane++ )
+		{
+			int size = plane ? width * height / 2 : width * height;
+			uint64_t sum = 0;
+			for ( int i = 0; i < jobs; i++ )
+				sum += desc.sse[3 * i + plane];
+			double mse = sum;
+			psnr[plane] = 10.0 * log10( 255.0 * 255.0 / ( mse == 0 ? 1e-10 : mse/size ) );
+
+			if ( desc.windows_x[plane] && desc.windows_y )
+			{
+				double avg = 0.0;
+				for ( int i = 0; i < desc.windows_x[plane] * desc.windows_y; i++ )
+					avg += desc.ssim[plane][i];
+				ssim[plane] = avg / desc.windows_x[plane] / desc.windows_y;
+			}
+		}
+	}
+	free( desc.columns );
+	free( desc.sse );
+	free( desc.ssim[0] );
 }
 
 static int get_image( mlt_frame a_frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
@@ -107,35 +209,48 @@ static int get_image( mlt_frame a_frame, uint8_t **image, mlt_image_format *form
 	mlt_frame b_frame = mlt_frame_pop_frame( a_frame );
 	mlt_properties properties = MLT_FRAME_PROPERTIES( a_frame );
 	mlt_transition transition = MLT_TRANSITION( mlt_frame_pop_service( a_frame ) );
+	mlt_properties transition_properties = MLT_TRANSITION_PROPERTIES( transition );
 	uint8_t *b_image;
-	int window_size = mlt_properties_get_int( MLT_TRANSITION_PROPERTIES( transition ), "window_size" );
+	int window_size = mlt_properties_get_int( transition_properties, "window_size" );
+	int headless = mlt_properties_get_int( transition_properties, "headless" );
 	double psnr[3], ssim[3];
 
+	// headless leaves the A frame as it is
+	if ( headless )
+		writable = 0;
 	*format = mlt_image_yuv422;
 	mlt_frame_get_image( b_frame, &b_image, format, width, height, writable );
 	mlt_frame_get_image( a_frame, image, format, width, height, writable );
 
-	psnr[0] = calc_psnr( *image, b_image, *width * *height, 2 );
-	psnr[1] = calc_psnr( *image + 1, b_image + 1, *width * *height / 2, 4 );
-	psnr[2] = calc_psnr( *image + 3, b_image + 3, *width * *height / 2, 4 );
-	ssim[0] = calc_ssim( *image, b_image, *width, *height, window_size, 2 );
-	ssim[1] = calc_ssim( *image + 1, b_image + 1, *width / 2, *height, window_size, 4 );
-	ssim[2] = calc_ssim( *image + 3, b_image + 3, *width / 2, *height, window_size, 4 );
+	calc_metrics( *image, b_image, *width, *height, window_size, psnr, ssim );
 	mlt_properties_set_double( properties, "meta.vqm.psnr.y", psnr[0] );
 	mlt_properties_set_double( properties, "meta.vqm.psnr.cb", psnr[1] );
 	mlt_properties_set_double( properties, "meta.vqm.psnr.cr", psnr[2] );
 	mlt_properties_set_double( properties, "meta.vqm.ssim.y", ssim[0] );
 	mlt_properties_set_double( properties, "meta.vqm.ssim.cb", ssim[1] );
 	mlt_properties_set_double( properties, "meta.vqm.ssim.cr", ssim[2] );
+
+	if ( headless )
+		return 0;
+
+	mlt_service_lock( MLT_TRANSITION_SERVICE( transition ) );
+	if ( !mlt_properties_get_int( transition_properties, "_header" ) )
+	{
+		mlt_properties_set_int( transition_properties, "_header", 1 );
+		printf( "frame psnr[Y] psnr[Cb] psnr[Cr] ssim[Y] ssim[Cb] ssim[Cr]\n" );
+	}
 	printf( "%05d %05.2f %05.2f %05.2f %5.3f %5.3f %5.3f\n",
 			mlt_frame_get_position( a_frame ), psnr[0], psnr[1], psnr[2],
 			ssim[0], ssim[1], ssim[2] );
+	mlt_service_unlock( MLT_TRANSITION_SERVICE( transition ) );
 
 	// copy the B frame to the bottom of the A frame for comparison
 	window_size = mlt_image_format_size( *format, *width, *height, NULL ) / 2;
 	memcpy( *image + window_size, b_image + window_size, window_size );
 
-	if ( !mlt_properties_get_int( MLT_TRANSITION_PROPERTIES( transition ), "render" ) )
+	// only the overlay needs Qt
+	if ( !mlt_properties_get_int( transition_properties, "render" )
+		|| !createQApplicationIfNeeded( MLT_TRANSITION_SERVICE( transition ) ) )
 		return 0;
 
 	// get RGBA image for Qt drawing
@@ -226,15 +341,9 @@ mlt_transition transition_vqm_init( mlt_profile profile, mlt_service_type type,
 	{
 		mlt_properties properties = MLT_TRANSITION_PROPERTIES( transition );
 
-		if ( !createQApplicationIfNeeded( MLT_TRANSITION_SERVICE(transition) ) )
-		{
-			mlt_transition_close( transition );
-			return NULL;
-		}
 		transition->process = process;
 		mlt_properties_set_int( properties, "_transition_type", 1 ); // video only
 		mlt_properties_set_int( properties, "window_size", 8 );
-		printf( "frame psnr[Y] psnr[Cb] psnr[Cr] ssim[Y] ssim[Cb] ssim[Cr]\n" );
 	}
 
 	return transition;
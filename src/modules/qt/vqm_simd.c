@@ -0,0 +1,123 @@
+/*
+ * vqm_simd.c -- vectorised sums for transition_vqm
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "vqm_simd.h"
+
+#include <framework/mlt_cpu.h>
+
+#include <pthread.h>
+#include <stddef.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) ) && defined(__SSE2__)
+#define USE_X86_SIMD 1
+#include <emmintrin.h>
+
+static inline void add_u16_sse2( uint32_t *sums, __m128i lo, __m128i hi )
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i *p = (__m128i*) sums;
+	_mm_storeu_si128( p, _mm_add_epi32( _mm_loadu_si128( p ), _mm_unpacklo_epi16( lo, zero ) ) );
+	_mm_storeu_si128( p + 1, _mm_add_epi32( _mm_loadu_si128( p + 1 ), _mm_unpackhi_epi16( lo, zero ) ) );
+	_mm_storeu_si128( p + 2, _mm_add_epi32( _mm_loadu_si128( p + 2 ), _mm_unpacklo_epi16( hi, zero ) ) );
+	_mm_storeu_si128( p + 3, _mm_add_epi32( _mm_loadu_si128( p + 3 ), _mm_unpackhi_epi16( hi, zero ) ) );
+}
+
+// A product of two bytes fits in 16 bits unsigned, so mullo is exact
+static int columns_sse2( const uint8_t *a, const uint8_t *b, int bytes, uint32_t *sums, int stride )
+{
+	const __m128i zero = _mm_setzero_si128();
+	int i;
+
+	for ( i = 0; i + 16 <= bytes; i += 16 )
+	{
+		__m128i va = _mm_loadu_si128( (const __m128i*) ( a + i ) );
+		__m128i vb = _mm_loadu_si128( (const __m128i*) ( b + i ) );
+		__m128i a_lo = _mm_unpacklo_epi8( va, zero );
+		__m128i a_hi = _mm_unpackhi_epi8( va, zero );
+		__m128i b_lo = _mm_unpacklo_epi8( vb, zero );
+		__m128i b_hi = _mm_unpackhi_epi8( vb, zero );
+
+		add_u16_sse2( sums + vqm_sum_a * stride + i, a_lo, a_hi );
+		add_u16_sse2( sums + vqm_sum_a2 * stride + i, _mm_mullo_epi16( a_lo, a_lo ), _mm_mullo_epi16( a_hi, a_hi ) );
+		add_u16_sse2( sums + vqm_sum_b * stride + i, b_lo, b_hi );
+		add_u16_sse2( sums + vqm_sum_b2 * stride + i, _mm_mullo_epi16( b_lo, b_lo ), _mm_mullo_epi16( b_hi, b_hi ) );
+		add_u16_sse2( sums + vqm_sum_ab * stride + i, _mm_mullo_epi16( a_lo, b_lo ), _mm_mullo_epi16( a_hi, b_hi ) );
+	}
+	return i;
+}
+
+#elif defined(__aarch64__)
+#define USE_NEON 1
+#include <arm_neon.h>
+
+static inline void add_u16_neon( uint32_t *sums, uint16x8_t lo, uint16x8_t hi )
+{
+	vst1q_u32( sums, vaddw_u16( vld1q_u32( sums ), vget_low_u16( lo ) ) );
+	vst1q_u32( sums + 4, vaddw_u16( vld1q_u32( sums + 4 ), vget_high_u16( lo ) ) );
+	vst1q_u32( sums + 8, vaddw_u16( vld1q_u32( sums + 8 ), vget_low_u16( hi ) ) );
+	vst1q_u32( sums + 12, vaddw_u16( vld1q_u32( sums + 12 ), vget_high_u16( hi ) ) );
+}
+
+static int columns_neon( const uint8_t *a, const uint8_t *b, int bytes, uint32_t *sums, int stride )
+{
+	int i;
+
+	for ( i = 0; i + 16 <= bytes; i += 16 )
+	{
+		uint8x16_t va = vld1q_u8( a + i );
+		uint8x16_t vb = vld1q_u8( b + i );
+		uint8x8_t a_lo = vget_low_u8( va ), a_hi = vget_high_u8( va );
+		uint8x8_t b_lo = vget_low_u8( vb ), b_hi = vget_high_u8( vb );
+
+		add_u16_neon( sums + vqm_sum_a * stride + i, vmovl_u8( a_lo ), vmovl_u8( a_hi ) );
+		add_u16_neon( sums + vqm_sum_a2 * stride + i, vmull_u8( a_lo, a_lo ), vmull_u8( a_hi, a_hi ) );
+		add_u16_neon( sums + vqm_sum_b * stride + i, vmovl_u8( b_lo ), vmovl_u8( b_hi ) );
+		add_u16_neon( sums + vqm_sum_b2 * stride + i, vmull_u8( b_lo, b_lo ), vmull_u8( b_hi, b_hi ) );
+		add_u16_neon( sums + vqm_sum_ab * stride + i, vmull_u8( a_lo, b_lo ), vmull_u8( a_hi, b_hi ) );
+	}
+	return i;
+}
+
+#endif
+
+static vqm_simd_columns g_columns;
+static pthread_once_t g_simd_once = PTHREAD_ONCE_INIT;
+
+static void simd_init( void )
+{
+#if USE_X86_SIMD
+	static const mlt_cpu_dispatch columns[] = {
+		{ mlt_cpu_sse2, columns_sse2 },
+		{ 0, NULL }
+	};
+#elif USE_NEON
+	static const mlt_cpu_dispatch columns[] = {
+		{ mlt_cpu_neon, columns_neon },
+		{ 0, NULL }
+	};
+#else
+	static const mlt_cpu_dispatch columns[] = { { 0, NULL } };
+#endif
+	g_columns = mlt_cpu_select( columns );
+}
+
+vqm_simd_columns vqm_simd_get( void )
+{
+	pthread_once( &g_simd_once, simd_init );
+	return g_columns;
+}
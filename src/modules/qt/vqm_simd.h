@@ -0,0 +1,60 @@
+/*
+ * vqm_simd.h -- vectorised sums for transition_vqm
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef VQM_SIMD_H
+#define VQM_SIMD_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** The sums that vqm_simd_columns adds to, each an array of one per byte of a row */
+
+enum
+{
+	vqm_sum_a,
+	vqm_sum_a2,
+	vqm_sum_b,
+	vqm_sum_b2,
+	vqm_sum_ab,
+	vqm_sums
+};
+
+/** Add a row of the images a and b into sums for each byte of the row.
+ *
+ * For byte i, it adds a[i], a[i]^2, b[i], b[i]^2 and a[i]*b[i] to
+ * sums[k * stride + i], where k is the vqm_sum_ value. It handles the largest
+ * number of bytes it can from the start of the row and returns it, leaving the
+ * rest of the row to the caller.
+ */
+
+typedef int ( *vqm_simd_columns )( const uint8_t *a, const uint8_t *b, int bytes, uint32_t *sums, int stride );
+
+/** Get the best function for the running CPU, or NULL if none applies.
+ * It is chosen with mlt_cpu_select(), so MLT_CPU_FLAGS can restrict it.
+ */
+
+extern vqm_simd_columns vqm_simd_get( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
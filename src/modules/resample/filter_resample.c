@@ -35,10 +35,24 @@ typedef struct
 	SRC_STATE* s;
 	int error;
 	int channels;
+	int converter;
+	int bypassed;
 	float buff[PROCESS_BUFF_SIZE];
 	int leftover_samples;
 } private_data;
 
+/** Get the libsamplerate converter for a quality name.
+*/
+
+static int get_converter( const char* quality )
+{
+	if ( quality && !strcmp( quality, "fast" ) )
+		return SRC_SINC_FASTEST;
+	else if ( quality && !strcmp( quality, "medium" ) )
+		return SRC_SINC_MEDIUM_QUALITY;
+	return SRC_SINC_BEST_QUALITY;
+}
+
 /** Get the audio.
 */
 
@@ -71,10 +85,19 @@ static int resample_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 		return error;
 	}
 
-	if( *frequency == out.frequency && !pdata )
+	if( *frequency == out.frequency )
 	{
-		// No frequency change, and there is no stored state.
-		return error;
+		// No frequency change. Pass the audio through once no resampled samples are left over.
+		int bypass = 1;
+		mlt_service_lock( MLT_FILTER_SERVICE(filter) );
+		if ( pdata )
+		{
+			bypass = !pdata->leftover_samples;
+			pdata->bypassed |= bypass;
+		}
+		mlt_service_unlock( MLT_FILTER_SERVICE(filter) );
+		if ( bypass )
+			return error;
 	}
 
 	// *Proceed to convert the sampling frequency*
@@ -105,13 +128,27 @@ static int resample_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 		filter->child = pdata;
 	}
 
+	// The filter quality overrides the one the consumer asks for
+	const char* quality = mlt_properties_get( MLT_FILTER_PROPERTIES( filter ), "quality" );
+	if ( !quality )
+		quality = mlt_properties_get( MLT_FRAME_PROPERTIES( frame ), "consumer_resample_quality" );
+	int converter = get_converter( quality );
+
 	// Recreate the resampler if necessary
-	if ( !pdata->s || pdata->channels != in.channels )
+	if ( !pdata->s || pdata->channels != in.channels || pdata->converter != converter )
 	{
-		mlt_log_debug( MLT_FILTER_SERVICE(filter), "Create resample state %d channels\n", in.channels );
+		mlt_log_debug( MLT_FILTER_SERVICE(filter), "Create resample state %d channels %s\n", in.channels, src_get_name( converter ) );
 		pdata->s = src_delete( pdata->s );
-		pdata->s = src_new( SRC_SINC_BEST_QUALITY, in.channels, &pdata->error );
+		pdata->s = src_new( converter, in.channels, &pdata->error );
 		pdata->channels = in.channels;
+		pdata->converter = converter;
+		pdata->bypassed = 0;
+	}
+	else if ( pdata->bypassed )
+	{
+		// Do not resample the history from before the audio was passed through
+		src_reset( pdata->s );
+		pdata->bypassed = 0;
 	}
 
 	int total_consumed_samples = 0;
@@ -22,12 +22,16 @@
 #include <string.h>
 #include <pthread.h>
 #include <sys/time.h>
+#include <atomic>
 #ifdef USE_INTERNAL_RTAUDIO
 #include "RtAudio.h"
 #else
 #include <RtAudio.h>
 #endif
 
+/** the amount of audio buffered ahead of the device in bytes */
+#define AUDIO_RING_BYTES ( 4096 * 10 )
+
 static void consumer_refresh_cb(mlt_consumer sdl, mlt_consumer consumer, mlt_event_data );
 static int  rtaudio_callback( void *outputBuffer, void *inputBuffer,
 	unsigned int nFrames, double streamTime, RtAudioStreamStatus status, void *userData );
@@ -63,10 +67,8 @@ public:
 	int                   joined;
 	int                   running;
 	int                   out_channels;
-	uint8_t               audio_buffer[4096 * 10];
-	int                   audio_avail;
-	pthread_mutex_t       audio_mutex;
-	pthread_cond_t        audio_cond;
+	mlt_audio_ring        audio_ring;
+	std::atomic<float>    volume;
 	pthread_mutex_t       video_mutex;
 	pthread_cond_t        video_cond;
 	int                   playing;
@@ -84,7 +86,8 @@ public:
 		, queue(NULL)
 		, joined(0)
 		, running(0)
-		, audio_avail(0)
+		, audio_ring(NULL)
+		, volume(1.0f)
 		, playing(0)
 		, refresh_count(0)
 		, is_purge(false)
@@ -98,8 +101,6 @@ public:
 		mlt_deque_close( queue );
 
 		// Destroy mutexes
-		pthread_mutex_destroy( &audio_mutex );
-		pthread_cond_destroy( &audio_cond );
 		pthread_mutex_destroy( &video_mutex );
 		pthread_cond_destroy( &video_cond );
 		pthread_mutex_destroy( &refresh_mutex );
@@ -109,6 +110,7 @@ public:
 			rt->closeStream();
 		delete rt;
 		rt = NULL;
+		mlt_audio_ring_close( audio_ring );
 	}
 
 	bool create_rtaudio( RtAudio::Api api, int channels, int frequency )
@@ -181,6 +183,11 @@ public:
 			}
 		}
 
+		// The callback starts with the stream, so make the ring for this number of channels first
+		mlt_audio_ring_close( audio_ring );
+		audio_ring = mlt_audio_ring_init( AUDIO_RING_BYTES / ( channels * sizeof( int16_t ) ),
+			channels * sizeof( int16_t ) );
+
 		try {
 			if ( rt->isStreamOpen() ) {
 				 rt->closeStream();
@@ -272,14 +279,13 @@ public:
 		mlt_properties_set_double( properties, "volume", 1.0 );
 
 		// This is the initialisation of the consumer
-		pthread_mutex_init( &audio_mutex, NULL );
-		pthread_cond_init( &audio_cond, NULL);
 		pthread_mutex_init( &video_mutex, NULL );
 		pthread_cond_init( &video_cond, NULL);
 
 		// Default scaler (for now we'll use nearest)
 		mlt_properties_set( properties, "rescale", "nearest" );
 		mlt_properties_set( properties, "deinterlace_method", "onefield" );
+		mlt_properties_set( properties, "resample_quality", "fast" );
 
 		// Default buffer for low latency
 		mlt_properties_set_int( properties, "buffer", 1 );
@@ -322,6 +328,10 @@ public:
 			joined = 1;
 			running = 0;
 
+			// Unlatch the audio writer
+			if ( audio_ring )
+				mlt_audio_ring_interrupt( audio_ring, 1 );
+
 			// Unlatch the consumer thread
 			pthread_mutex_lock( &refresh_mutex );
 			pthread_cond_broadcast( &refresh_cond );
@@ -335,11 +345,6 @@ public:
 			pthread_cond_broadcast( &video_cond );
 			pthread_mutex_unlock( &video_mutex );
 
-			// Unlatch the audio callback
-			pthread_mutex_lock( &audio_mutex );
-			pthread_cond_broadcast( &audio_cond );
-			pthread_mutex_unlock( &audio_mutex );
-
 			if ( rt && rt->isStreamOpen() )
 			try {
 				// Stop the stream
@@ -354,6 +359,10 @@ public:
 			}
 			delete rt;
 			rt = NULL;
+
+			// The audio callback has stopped
+			mlt_audio_ring_close( audio_ring );
+			audio_ring = NULL;
 		}
 
 		return 0;
@@ -506,46 +515,19 @@ public:
 		while( mlt_deque_count( queue ) )
 			mlt_frame_close( (mlt_frame) mlt_deque_pop_back( queue ) );
 
-		audio_avail = 0;
+		mlt_audio_ring_clear( audio_ring );
 	}
 
 	int callback( int16_t *outbuf, int16_t *inbuf,
 		unsigned int samples, double streamTime, RtAudioStreamStatus status )
 	{
-		mlt_properties properties = MLT_CONSUMER_PROPERTIES( getConsumer() );
-		double volume = mlt_properties_get_double( properties, "volume" );
-		int len = mlt_audio_format_size( mlt_audio_s16, samples, out_channels );
-
-		pthread_mutex_lock( &audio_mutex );
-
-		// Block until audio received
-		while ( running && len > audio_avail )
-			pthread_cond_wait( &audio_cond, &audio_mutex );
-
-		if ( audio_avail >= len )
-		{
-			// Place in the audio buffer
-			memcpy( outbuf, audio_buffer, len );
+		// This runs on the device thread, so take no locks and read no properties
+		float volume = this->volume;
 
-			// Remove len from the audio available
-			audio_avail -= len;
+		// Place in the audio buffer, the ring pads it with silence when it runs short
+		mlt_audio_ring_read( audio_ring, outbuf, samples );
 
-			// Remove the samples
-			memmove( audio_buffer, audio_buffer + len, audio_avail );
-		}
-		else
-		{
-			// Just to be safe, wipe the stream first
-			memset( outbuf, 0, len );
-
-			// Copy what we have
-			memcpy( outbuf, audio_buffer, audio_avail );
-
-			// No audio left
-			audio_avail = 0;
-		}
-
-		if ( volume != 1.0 )
+		if ( volume != 1.0f )
 		{
 			int16_t *p = outbuf;
 			int i = samples * out_channels + 1;
@@ -556,9 +538,6 @@ public:
 		// We're definitely playing now
 		playing = 1;
 
-		pthread_cond_broadcast( &audio_cond );
-		pthread_mutex_unlock( &audio_mutex );
-
 		return 0;
 	}
 
@@ -604,58 +583,40 @@ public:
 		{
 			mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
 			int samples_copied = 0;
-			int dst_stride = out_channels * sizeof( *pcm );
+			int16_t *buffer = NULL;
+			int16_t *src = pcm;
 
-			pthread_mutex_lock( &audio_mutex );
+			// Hand the volume to the audio callback
+			volume = mlt_properties_get_double( MLT_CONSUMER_PROPERTIES( getConsumer() ), "volume" );
 
-			while ( running && samples_copied < samples )
+			if ( !scrub && mlt_properties_get_double( properties, "_speed" ) != 1 )
 			{
-				int sample_space = ( sizeof( audio_buffer ) - audio_avail ) / dst_stride;
-
-				while ( running && sample_space == 0 )
+				src = NULL;
+			}
+			else if ( channels != out_channels )
+			{
+				// Pack the channels that the device outputs
+				int n = MIN( channels, out_channels );
+				int16_t *dest = buffer = (int16_t*) mlt_pool_alloc( samples * out_channels * sizeof( *pcm ) );
+				int i = samples + 1;
+				memset( buffer, 0, samples * out_channels * sizeof( *pcm ) );
+				while ( --i )
 				{
-					pthread_cond_wait( &audio_cond, &audio_mutex );
-					sample_space = ( sizeof( audio_buffer ) - audio_avail ) / dst_stride;
+					memcpy( dest, pcm, n * sizeof( *pcm ) );
+					pcm += channels;
+					dest += out_channels;
 				}
-				if ( running )
-				{
-					int samples_to_copy = samples - samples_copied;
-					if ( samples_to_copy > sample_space )
-					{
-						samples_to_copy = sample_space;
-					}
-					int dst_bytes = samples_to_copy * dst_stride;
+				src = buffer;
+			}
 
-					if ( scrub || mlt_properties_get_double( properties, "_speed" ) == 1 )
-					{
-						if ( channels == out_channels )
-						{
-							memcpy( &audio_buffer[ audio_avail ], pcm, dst_bytes );
-							pcm += samples_to_copy * channels;
-						}
-						else
-						{
-							int16_t *dest = (int16_t*) &audio_buffer[ audio_avail ];
-							int i = samples_to_copy + 1;
-							while ( --i )
-							{
-								memcpy( dest, pcm, dst_stride );
-								pcm += channels;
-								dest += out_channels;
-							}
-						}
-					}
-					else
-					{
-						memset( &audio_buffer[ audio_avail ], 0, dst_bytes );
-						pcm += samples_to_copy * channels;
-					}
-					audio_avail += dst_bytes;
-					samples_copied += samples_to_copy;
-				}
-				pthread_cond_broadcast( &audio_cond );
+			while ( running && samples_copied < samples )
+			{
+				if ( mlt_audio_ring_wait_for_space( audio_ring, 1, -1 ) )
+					break;
+				samples_copied += mlt_audio_ring_write( audio_ring,
+					src ? src + samples_copied * out_channels : NULL, samples - samples_copied );
 			}
-			pthread_mutex_unlock( &audio_mutex );
+			mlt_pool_release( buffer );
 		}
 
 		return init_audio;
@@ -33,6 +33,10 @@ typedef struct
 {
 	RubberBandStretcher* s;
 	int rubberband_frequency;
+	int realtime;
+	int preroll;
+	float* silence;
+	int silence_samples;
 	uint64_t in_samples;
 	uint64_t out_samples;
 } private_data;
@@ -89,26 +93,51 @@ static int rbpitch_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *
 		timeratio = (double)requested_samples / (double)*samples;
 	}
 	rubberband_frequency = CLAMP( rubberband_frequency, 10000, 300000 );
+	int realtime = mlt_properties_get_int( filter_properties, "realtime" );
 
 	// Protect the RubberBandStretcher instance.
 	mlt_service_lock( MLT_FILTER_SERVICE(filter) );
 
+	if ( pitchscale == 1.0 && timeratio == 1.0 && ( !stretch || requested_frequency == *frequency ) )
+	{
+		// Nothing to do. Drop the stretcher so that it starts clean with a
+		// new pre-roll if the pitch changes again.
+		delete pdata->s;
+		pdata->s = NULL;
+		mlt_properties_set_double( filter_properties, "latency", 0.0 );
+		mlt_service_unlock( MLT_FILTER_SERVICE(filter) );
+		return error;
+	}
+
 	// Configure the stretcher.
 	RubberBandStretcher* s = pdata->s;
-	if ( !s || s->available() == -1 || (int)s->getChannelCount() != *channels || pdata->rubberband_frequency != rubberband_frequency )
+	if ( !s || s->available() == -1 || (int)s->getChannelCount() != *channels || pdata->rubberband_frequency != rubberband_frequency || pdata->realtime != realtime )
 	{
 		mlt_log_debug( MLT_FILTER_SERVICE(filter), "Create a new stretcher\t%d\t%d\t%f\n", *channels, rubberband_frequency, pitchscale );
 		delete s;
 		// Create a rubberband instance
 		RubberBandStretcher::Options options = RubberBandStretcher::OptionProcessRealTime;
+		if ( realtime )
+		{
+			// Trade some quality for speed: short windows, no worker threads
+			// and a cheaper pitch shifter.
+			options |= RubberBandStretcher::OptionThreadingNever | RubberBandStretcher::OptionWindowShort;
+		}
 		s = new RubberBandStretcher(rubberband_frequency, *channels, options, 1.0, pitchscale);
 		pdata->s = s;
 		pdata->rubberband_frequency = rubberband_frequency;
+		pdata->realtime = realtime;
+		pdata->preroll = 1;
 		pdata->in_samples = 0;
 		pdata->out_samples = 0;
 	}
 	s->setPitchScale(pitchscale);
-	if( pitchscale >= 0.5 && pitchscale <= 2.0 )
+	if ( realtime )
+	{
+		s->setPitchOption(RubberBandStretcher::OptionPitchHighSpeed);
+		s->setTransientsOption(RubberBandStretcher::OptionTransientsMixed);
+	}
+	else if( pitchscale >= 0.5 && pitchscale <= 2.0 )
 	{
 		// Pitch adjustment < 200%
 		s->setPitchOption(RubberBandStretcher::OptionPitchHighQuality);
@@ -124,6 +153,30 @@ static int rbpitch_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *
 	}
 	s->setTimeRatio( timeratio );
 
+	// Prime a new stretcher with silence to cover its latency so that output
+	// is available right away instead of repeating the first input samples.
+	if ( pdata->preroll )
+	{
+		int preroll_samples = (int)s->getLatency();
+		if ( preroll_samples > pdata->silence_samples )
+		{
+			free( pdata->silence );
+			pdata->silence = (float*)calloc( preroll_samples, sizeof(float) );
+			pdata->silence_samples = pdata->silence ? preroll_samples : 0;
+		}
+		if ( preroll_samples > 0 && pdata->silence )
+		{
+			const float* silence_planes[MAX_CHANNELS];
+			for ( int i = 0; i < *channels; i++ )
+			{
+				silence_planes[i] = pdata->silence;
+			}
+			s->process( silence_planes, preroll_samples, false );
+			pdata->in_samples += preroll_samples;
+		}
+		pdata->preroll = 0;
+	}
+
 	// Configure input and output buffers and counters.
 	int consumed_samples = 0;
 	int total_consumed_samples = 0;
@@ -251,6 +304,7 @@ static void close_filter( mlt_filter filter )
 		{
 			delete s;
 		}
+		free( pdata->silence );
 		free( pdata );
 		filter->child = NULL;
 	}
@@ -267,6 +321,10 @@ mlt_filter filter_rbpitch_init( mlt_profile profile, mlt_service_type type, cons
 	{
 		pdata->s = NULL;
 		pdata->rubberband_frequency = 0;
+		pdata->realtime = 0;
+		pdata->preroll = 0;
+		pdata->silence = NULL;
+		pdata->silence_samples = 0;
 		pdata->in_samples = 0;
 		pdata->out_samples = 0;
 
@@ -92,6 +92,7 @@ mlt_consumer consumer_sdl_preview_init( mlt_profile profile, mlt_service_type ty
 		self->still = mlt_factory_consumer( profile, "sdl_still", arg );
 		mlt_properties_set( properties, "rescale", "nearest" );
 		mlt_properties_set( properties, "deinterlace_method", "onefield" );
+		mlt_properties_set( properties, "resample_quality", "fast" );
 		mlt_properties_set_int( properties, "prefill", 1 );
 		mlt_properties_set_int( properties, "top_field_first", -1 );
 
@@ -68,6 +68,9 @@ struct consumer_sdl_s
 	SDL_Renderer *sdl_renderer;
 	SDL_Texture *sdl_texture;
 	SDL_Rect sdl_rect;
+	mlt_image_format image_format;
+	int vsync;
+	int refresh;
 	uint8_t *buffer;
 	int is_purge;
 #ifdef _WIN32
@@ -123,6 +126,7 @@ mlt_consumer consumer_sdl2_init( mlt_profile profile, mlt_service_type type, con
 		// Default scaler (for now we'll use nearest)
 		mlt_properties_set( self->properties, "rescale", "nearest" );
 		mlt_properties_set( self->properties, "deinterlace_method", "onefield" );
+		mlt_properties_set( self->properties, "resample_quality", "fast" );
 		mlt_properties_set_int( self->properties, "top_field_first", -1 );
 
 		// Default buffer for low latency
@@ -490,10 +494,32 @@ static int consumer_play_audio( consumer_sdl self, mlt_frame frame, int init_aud
 	return init_audio;
 }
 
+/** Get the image format to display, which the texture is created for.
+ */
+
+static mlt_image_format get_image_format( consumer_sdl self )
+{
+	const char *name = mlt_properties_get( self->properties, "mlt_image_format" );
+	mlt_image_format format = name ? mlt_image_format_id( name ) : mlt_image_yuv422;
+
+	switch ( format )
+	{
+	case mlt_image_rgb:
+	case mlt_image_rgba:
+	case mlt_image_yuv420p:
+	case mlt_image_yuv422:
+		return format;
+	default:
+		mlt_log_warning( MLT_CONSUMER_SERVICE(&self->parent), "Unsupported image format %s, using yuv422\n", name );
+		return mlt_image_yuv422;
+	}
+}
+
 static int setup_sdl_video( consumer_sdl self )
 {
 	int error = 0;
 	int sdl_flags = SDL_WINDOW_RESIZABLE;
+	int renderer_flags = SDL_RENDERER_ACCELERATED;
 	int texture_format = SDL_PIXELFORMAT_YUY2;
 
 	// Skip this if video is disabled.
@@ -514,10 +540,9 @@ static int setup_sdl_video( consumer_sdl self )
 		}
 	}
 
-#ifdef MLT_IMAGE_FORMAT
-	int image_format = mlt_properties_get_int( self->properties, "mlt_image_format" );
-
-	if ( image_format ) switch ( image_format ) {
+	// Stream the frames into a texture of the same layout, so SDL only copies them
+	self->image_format = get_image_format( self );
+	switch ( self->image_format ) {
 	case mlt_image_rgb:
 		texture_format = SDL_PIXELFORMAT_RGB24;
 		break;
@@ -527,15 +552,15 @@ static int setup_sdl_video( consumer_sdl self )
 	case mlt_image_yuv420p:
 		texture_format = SDL_PIXELFORMAT_IYUV;
 		break;
-	case mlt_image_yuv422:
+	default:
 		texture_format = SDL_PIXELFORMAT_YUY2;
 		break;
-	default:
-		mlt_log_error( MLT_CONSUMER_SERVICE(&self->parent), "Invalid image format %s\n",
-			mlt_image_format_name( image_format ) );
-		return -1;
 	}
-#endif
+
+	// Present on the vertical blank
+	self->vsync = mlt_properties_get_int( self->properties, "vsync" );
+	if ( self->vsync )
+		renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
 
 	if ( mlt_properties_get_int( self->properties, "fullscreen" ) )
 	{
@@ -548,9 +573,17 @@ static int setup_sdl_video( consumer_sdl self )
 	pthread_mutex_lock( &mlt_sdl_mutex );
 	self->sdl_window = SDL_CreateWindow("MLT", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
 		self->window_width, self->window_height, sdl_flags);
-	self->sdl_renderer = SDL_CreateRenderer(self->sdl_window, -1, SDL_RENDERER_ACCELERATED);
+	self->sdl_renderer = SDL_CreateRenderer(self->sdl_window, -1, renderer_flags);
 	if ( self->sdl_renderer )
 	{
+		SDL_DisplayMode mode;
+
+		// The time between refreshes in microseconds, 0 if unknown
+		self->refresh = 0;
+		if ( self->vsync && !SDL_GetCurrentDisplayMode( SDL_GetWindowDisplayIndex( self->sdl_window ), &mode )
+			&& mode.refresh_rate > 0 )
+			self->refresh = 1000000 / mode.refresh_rate;
+
 		// Get texture width and height from the profile.
 		int width = mlt_properties_get_int( self->properties, "width" );
 		int height = mlt_properties_get_int( self->properties, "height" );
@@ -576,11 +609,7 @@ static int consumer_play_video( consumer_sdl self, mlt_frame frame )
 	// Get the properties of this consumer
 	mlt_properties properties = self->properties;
 
-#ifdef MLT_IMAGE_FORMAT
-	mlt_image_format vfmt = mlt_properties_get_int( properties, "mlt_image_format" );
-#else
-	mlt_image_format vfmt = mlt_image_yuv422;
-#endif
+	mlt_image_format vfmt = self->image_format;
 	int width = self->width, height = self->height;
 	uint8_t *image;
 
@@ -656,7 +685,7 @@ static int consumer_play_video( consumer_sdl self, mlt_frame frame )
 			mlt_properties_set_int( self->properties, "rect_h", self->sdl_rect.h );
 		}
 
-		if ( self->running && image )
+		if ( self->running && image && vfmt == self->image_format )
 		{
 			unsigned char* planes[4];
 			int strides[4];
@@ -707,6 +736,11 @@ static void *video_thread( void *arg )
 	// Get real time flag
 	int real_time = mlt_properties_get_int( self->properties, "real_time" );
 
+	// Presenting waits for the next refresh, so wake up that much earlier,
+	// and a frame is only too old when it misses more than a refresh
+	int64_t refresh = self->vsync ? self->refresh : 0;
+	int64_t too_old = MAX( refresh, 10000 );
+
 	// Determine start time
 	gettimeofday( &now, NULL );
 	start = ( int64_t )now.tv_sec * 1000000 + now.tv_usec;
@@ -747,15 +781,15 @@ static void *video_thread( void *arg )
 			int64_t difference = scheduled - elapsed;
 
 			// Smooth playback a bit
-			if ( real_time && ( difference > 20000 && speed == 1.0 ) )
+			if ( real_time && ( difference - refresh > 20000 && speed == 1.0 ) )
 			{
-				tm.tv_sec = difference / 1000000;
-				tm.tv_nsec = ( difference % 1000000 ) * 500;
+				tm.tv_sec = ( difference - refresh ) / 1000000;
+				tm.tv_nsec = ( ( difference - refresh ) % 1000000 ) * 500;
 				nanosleep( &tm, NULL );
 			}
 
 			// Show current frame if not too old
-			if ( !real_time || ( difference > -10000 || speed != 1.0 || mlt_deque_count( self->queue ) < 2 ) )
+			if ( !real_time || ( difference > -too_old || speed != 1.0 || mlt_deque_count( self->queue ) < 2 ) )
 				consumer_play_video( self, next );
 
 			// If the queue is empty, recalculate start to allow build up again
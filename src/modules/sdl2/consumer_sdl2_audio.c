@@ -25,6 +25,8 @@
 #include <framework/mlt_factory.h>
 #include <framework/mlt_filter.h>
 #include <framework/mlt_log.h>
+#include <framework/mlt_pool.h>
+#include <framework/mlt_audio_ring.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,6 +37,9 @@
 
 extern pthread_mutex_t mlt_sdl_mutex;
 
+/** the amount of audio buffered ahead of the device in bytes */
+#define AUDIO_RING_BYTES ( 4096 * 10 )
+
 /** This classes definition.
 */
 
@@ -48,10 +53,8 @@ struct consumer_sdl_s
 	pthread_t thread;
 	int joined;
 	atomic_int running;
-	uint8_t audio_buffer[ 4096 * 10 ];
-	int audio_avail;
-	pthread_mutex_t audio_mutex;
-	pthread_cond_t audio_cond;
+	mlt_audio_ring audio_ring;
+	_Atomic float volume;
 	pthread_mutex_t video_mutex;
 	pthread_cond_t video_cond;
 	int out_channels;
@@ -105,15 +108,17 @@ mlt_consumer consumer_sdl2_audio_init( mlt_profile profile, mlt_service_type typ
 		// Set the default volume
 		mlt_properties_set_double( self->properties, "volume", 1.0 );
 
+		// The audio callback reads the volume from here
+		atomic_init( &self->volume, 1.0f );
+
 		// This is the initialisation of the consumer
-		pthread_mutex_init( &self->audio_mutex, NULL );
-		pthread_cond_init( &self->audio_cond, NULL);
 		pthread_mutex_init( &self->video_mutex, NULL );
 		pthread_cond_init( &self->video_cond, NULL);
 
 		// Default scaler (for now we'll use nearest)
 		mlt_properties_set( self->properties, "rescale", "nearest" );
 		mlt_properties_set( self->properties, "deinterlace_method", "onefield" );
+		mlt_properties_set( self->properties, "resample_quality", "fast" );
 		mlt_properties_set_int( self->properties, "top_field_first", -1 );
 
 		// Default buffer for low latency
@@ -206,6 +211,10 @@ int consumer_stop( mlt_consumer parent )
 		self->joined = 1;
 		self->running = 0;
 
+		// Unlatch the audio writer
+		if ( self->audio_ring )
+			mlt_audio_ring_interrupt( self->audio_ring, 1 );
+
 		// Unlatch the consumer thread
 		pthread_mutex_lock( &self->refresh_mutex );
 		pthread_cond_broadcast( &self->refresh_cond );
@@ -222,14 +231,16 @@ int consumer_stop( mlt_consumer parent )
 		pthread_cond_broadcast( &self->video_cond );
 		pthread_mutex_unlock( &self->video_mutex );
 
-		// Unlatch the audio callback
-		pthread_mutex_lock( &self->audio_mutex );
-		pthread_cond_broadcast( &self->audio_cond );
-		pthread_mutex_unlock( &self->audio_mutex );
 #ifdef _WIN32
 		if ( !self->no_quit_subsystem )
 #endif
-		SDL_QuitSubSystem( SDL_INIT_AUDIO );
+		{
+			SDL_QuitSubSystem( SDL_INIT_AUDIO );
+
+			// The audio callback has stopped
+			mlt_audio_ring_close( self->audio_ring );
+			self->audio_ring = NULL;
+		}
 	}
 
 	return 0;
@@ -264,40 +275,28 @@ static void sdl_fill_audio( void *udata, uint8_t *stream, int len )
 {
 	consumer_sdl self = udata;
 
-	// Get the volume
-	double volume = mlt_properties_get_double( self->properties, "volume" );
+	// This runs on the device thread, so take no locks and read no properties
+	float volume = atomic_load( &self->volume );
+	int samples = len / ( self->out_channels * sizeof( int16_t ) );
 
 	// Wipe the stream first
 	memset( stream, 0, len );
 
-	pthread_mutex_lock( &self->audio_mutex );
-	int bytes = MIN(len, self->audio_avail);
+	// Place in the audio buffer, the ring pads it with silence when it runs short
+	int bytes = mlt_audio_ring_read( self->audio_ring, stream, samples ) * self->out_channels * sizeof( int16_t );
 
-	// Place in the audio buffer
-	if ( volume != 1.0 ) {
-		// Adjust the volume while copying.
-		int16_t *src = (int16_t*) self->audio_buffer;
+	if ( volume != 1.0f ) {
+		// Adjust the volume in place.
 		int16_t *dst = (int16_t*) stream;
 		int i = bytes / sizeof(*dst) + 1;
 		while (--i) {
-			*dst++ = CLAMP(volume * src[0], -32768, 32767);
-			src++;
+			*dst = CLAMP(volume * dst[0], -32768, 32767);
+			dst++;
 		}
-	} else {
-		memcpy( stream, self->audio_buffer, bytes );
 	}
 
-	// Remove len from the audio available
-	self->audio_avail -= bytes;
-
-	// Remove the samples
-	memmove( self->audio_buffer, self->audio_buffer + bytes, self->audio_avail );
-
 	// We're definitely playing now
 	self->playing = 1;
-
-	pthread_cond_broadcast( &self->audio_cond );
-	pthread_mutex_unlock( &self->audio_mutex );
 }
 
 static int consumer_play_audio( consumer_sdl self, mlt_frame frame, int init_audio, int64_t *duration )
@@ -355,9 +354,13 @@ static int consumer_play_audio( consumer_sdl self, mlt_frame frame, int init_aud
 				mlt_log_info( MLT_CONSUMER_SERVICE( self ), "Unable to output %d channels. Change to %d\n", request.channels, got.channels );
 			}
 				mlt_log_info( MLT_CONSUMER_SERVICE( self ), "Audio Opened: driver=%s channels=%d frequency=%d\n", SDL_GetCurrentAudioDriver(), got.channels, got.freq );
+			self->out_channels = got.channels;
+
+			// Never close a ring here, a device that could not be closed may still be reading it
+			self->audio_ring = mlt_audio_ring_init( AUDIO_RING_BYTES / ( got.channels * sizeof( int16_t ) ),
+				got.channels * sizeof( int16_t ) );
 			SDL_PauseAudioDevice( dev, 0 );
 			init_audio = 0;
-			self->out_channels = got.channels;
 		}
 	}
 
@@ -365,73 +368,51 @@ static int consumer_play_audio( consumer_sdl self, mlt_frame frame, int init_aud
 	{
 		mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
 		int samples_copied = 0;
-		int dst_stride = self->out_channels * sizeof( *pcm );
+		int16_t *buffer = NULL;
+		int16_t *src = pcm;
 
-		pthread_mutex_lock( &self->audio_mutex );
+		// Hand the volume to the audio callback
+		atomic_store( &self->volume, mlt_properties_get_double( self->properties, "volume" ) );
 
-		while ( self->running && samples_copied < samples )
+		if ( !scrub && mlt_properties_get_double( properties, "_speed" ) != 1 )
+		{
+			src = NULL;
+		}
+		else if ( channels != self->out_channels )
 		{
-			int sample_space = ( sizeof( self->audio_buffer ) - self->audio_avail ) / dst_stride;
-			while ( self->running && sample_space == 0 )
+			// Pack the channels that the device outputs
+			int n = MIN( channels, self->out_channels );
+			int16_t *dest = buffer = mlt_pool_alloc( samples * self->out_channels * sizeof( *pcm ) );
+			int i = samples + 1;
+			memset( buffer, 0, samples * self->out_channels * sizeof( *pcm ) );
+			while ( --i )
 			{
-				struct timeval now;
-				struct timespec tm;
-
-				gettimeofday( &now, NULL );
-				tm.tv_sec = now.tv_sec + 1;
-				tm.tv_nsec = now.tv_usec * 1000;
-				pthread_cond_timedwait( &self->audio_cond, &self->audio_mutex, &tm );
-				sample_space = ( sizeof( self->audio_buffer ) - self->audio_avail ) / dst_stride;
+				memcpy( dest, pcm, n * sizeof( *pcm ) );
+				pcm += channels;
+				dest += self->out_channels;
+			}
+			src = buffer;
+		}
 
-				if ( sample_space == 0 )
+		while ( self->running && samples_copied < samples )
+		{
+			if ( mlt_audio_ring_wait_for_space( self->audio_ring, 1, 1000000 ) )
+			{
+				if ( self->running )
 				{
 					mlt_log_warning( MLT_CONSUMER_SERVICE(&self->parent), "audio timed out\n" );
-					pthread_mutex_unlock( &self->audio_mutex );
+					mlt_pool_release( buffer );
 #ifdef _WIN32
 					self->no_quit_subsystem = 1;
 #endif
 					return 1;
 				}
+				break;
 			}
-			if ( self->running )
-			{
-				int samples_to_copy = samples - samples_copied;
-				if ( samples_to_copy > sample_space )
-				{
-					samples_to_copy = sample_space;
-				}
-				int dst_bytes = samples_to_copy * dst_stride;
-
-				if ( scrub || mlt_properties_get_double( properties, "_speed" ) == 1 )
-				{
-					if ( channels == self->out_channels )
-					{
-						memcpy( &self->audio_buffer[ self->audio_avail ], pcm, dst_bytes );
-						pcm += samples_to_copy * channels;
-					}
-					else
-					{
-						int16_t *dest = (int16_t*) &self->audio_buffer[ self->audio_avail ];
-						int i = samples_to_copy + 1;
-						while ( --i )
-						{
-							memcpy( dest, pcm, dst_stride );
-							pcm += channels;
-							dest += self->out_channels;
-						}
-					}
-				}
-				else
-				{
-					memset( &self->audio_buffer[ self->audio_avail ], 0, dst_bytes );
-					pcm += samples_to_copy * channels;
-				}
-				self->audio_avail += dst_bytes;
-				samples_copied += samples_to_copy;
-			}
-			pthread_cond_broadcast( &self->audio_cond );
+			samples_copied += mlt_audio_ring_write( self->audio_ring,
+				src ? src + samples_copied * self->out_channels : NULL, samples - samples_copied );
 		}
-		pthread_mutex_unlock( &self->audio_mutex );
+		mlt_pool_release( buffer );
 	}
 	else
 	{
@@ -691,9 +672,7 @@ static void *consumer_thread( void *arg )
 		frame = NULL;
 	}
 
-	pthread_mutex_lock( &self->audio_mutex );
-	self->audio_avail = 0;
-	pthread_mutex_unlock( &self->audio_mutex );
+	mlt_audio_ring_clear( self->audio_ring );
 
 	return NULL;
 }
@@ -716,8 +695,6 @@ static void consumer_close( mlt_consumer parent )
 	mlt_deque_close( self->queue );
 
 	// Destroy mutexes
-	pthread_mutex_destroy( &self->audio_mutex );
-	pthread_cond_destroy( &self->audio_cond );
 	pthread_mutex_destroy( &self->video_mutex );
 	pthread_cond_destroy( &self->video_cond );
 	pthread_mutex_destroy( &self->refresh_mutex );
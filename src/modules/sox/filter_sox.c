@@ -184,6 +184,33 @@ static int create_effect( mlt_filter this, char *value, int count, int channel,
 	return error;
 }
 
+/** Join the specifications of all the effects to detect changes.
+*/
+
+static char *get_effect_spec( mlt_properties properties )
+{
+	size_t size = 1;
+	int i;
+
+	for ( i = 0; i < mlt_properties_count( properties ); i++ )
+	{
+		char *value = mlt_properties_get_value( properties, i );
+		if ( !strncmp( mlt_properties_get_name( properties, i ), "effect", 6 ) && value )
+			size += strlen( value ) + 1;
+	}
+	char *spec = calloc( 1, size );
+	for ( i = 0; i < mlt_properties_count( properties ); i++ )
+	{
+		char *value = mlt_properties_get_value( properties, i );
+		if ( !strncmp( mlt_properties_get_name( properties, i ), "effect", 6 ) && value )
+		{
+			strcat( spec, value );
+			strcat( spec, "\n" );
+		}
+	}
+	return spec;
+}
+
 /** Get the audio.
 */
 
@@ -212,55 +239,77 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 	mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
 
 	// Even though some effects are multi-channel aware, it is not reliable
-	// We must maintain a separate effect state for each channel
-	for ( i = 0; i < *channels; i++ )
+	// We must maintain a separate effect state for each channel.
+	// The states are kept across frames and only rebuilt when the effect
+	// specification or the signal changes.
+	char *spec = get_effect_spec( filter_properties );
+	char *saved_spec = mlt_properties_get( filter_properties, "_effect_spec" );
+	if ( !saved_spec || strcmp( saved_spec, spec ) ||
+		 mlt_properties_get_int( filter_properties, "_effect_frequency" ) != *frequency ||
+		 mlt_properties_get_int( filter_properties, "_effect_channels" ) != *channels )
 	{
-		char id[ 256 ];
-		sprintf( id, "_effect_0_%d", i );
-		
-		// Get an existing effect state
-		eff_t e = mlt_properties_get_data( filter_properties, id, NULL );
-		
-		// Validate the existing effect state
-#if (ST_LIB_VERSION_CODE >= ST_LIB_VERSION(14,1,0))
-		if ( e != NULL && ( e->in_signal.rate != *frequency || 
-							e->out_signal.rate != *frequency ) )
-#else
-		if ( e != NULL && ( e->ininfo.rate != *frequency || 
-							e->outinfo.rate != *frequency ) )
-#endif
-			e = NULL;
-		
-		// (Re)Create the effect state
-		if ( e == NULL )
+		int old_channels = mlt_properties_get_int( filter_properties, "_effect_channels" );
+		int j;
+
+		// Release the old effect states
+		for ( i = 0; i < old_channels; i++ )
+		{
+			for ( j = 0; j < count; j++ )
+			{
+				char id[ 256 ];
+				sprintf( id, "_effect_%d_%d", j, i );
+				mlt_properties_clear( filter_properties, id );
+			}
+		}
+
+		// Create the new effect states for every channel
+		for ( i = 0; i < *channels; i++ )
 		{
-			int j = 0;
-			
 			// Reset the count
 			count = 0;
-	
+
 			// Loop over all properties
 			for ( j = 0; j < mlt_properties_count( filter_properties ); j ++ )
 			{
 				// Get the name of this property
 				char *name = mlt_properties_get_name( filter_properties, j );
-	
+
 				// If the name does not contain a . and matches effect
 				if ( !strncmp( name, "effect", 6 ) )
 				{
 					// Get the effect specification
 					char *value = mlt_properties_get_value( filter_properties, j );
-	
+
 					// Create an instance
 					if ( create_effect( filter, value, count, i, *frequency ) == 0 )
 						count ++;
 				}
 			}
-			
-			// Save the number of filters
-			mlt_properties_set_int( filter_properties, "_effect_count", count );
-			
 		}
+
+		// Save the number of filters and what they were made for
+		mlt_properties_set_int( filter_properties, "_effect_count", count );
+		mlt_properties_set_int( filter_properties, "_effect_frequency", *frequency );
+		mlt_properties_set_int( filter_properties, "_effect_channels", *channels );
+		mlt_properties_set( filter_properties, "_effect_spec", spec );
+	}
+	free( spec );
+
+	// Make sure the output buffer can hold a whole channel of this frame
+	int output_size = 0;
+	output_buffer = mlt_properties_get_data( filter_properties, "output_buffer", &output_size );
+	if ( *samples * (int) sizeof( st_sample_t ) > output_size )
+	{
+		output_size = *samples * sizeof( st_sample_t );
+		output_buffer = mlt_pool_alloc( output_size );
+		mlt_properties_set_data( filter_properties, "output_buffer", output_buffer, output_size, mlt_pool_release, NULL );
+	}
+
+	for ( i = 0; i < *channels; i++ )
+	{
+		char id[ 256 ];
+		eff_t e = NULL;
+
 		if ( *samples > 0 && ( count > 0 || analysis ) )
 		{
 			input_buffer = (st_sample_t*) *buffer + i * *samples;
@@ -407,15 +456,35 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 						*f = saved_gain * normalised_gain;
 					}
 					
-					// Apply the effect
+					// Apply the effect to the whole channel, which may take
+					// more than one call when the buffer holds several frames.
+					st_size_t in_done = 0;
+					st_size_t out_done = 0;
+					while ( in_done < *samples && out_done < *samples )
+					{
+						isamp = *samples - in_done;
+						osamp = *samples - out_done;
 #ifdef SOX14
-					if ( ( * e->handler.flow )( e, input_buffer, output_buffer, &isamp, &osamp ) != ST_SUCCESS )
+						if ( ( * e->handler.flow )( e, input_buffer + in_done, output_buffer + out_done, &isamp, &osamp ) != ST_SUCCESS )
 #else
-					if ( ( * e->h->flow )( e, input_buffer, output_buffer, &isamp, &osamp ) != ST_SUCCESS )
+						if ( ( * e->h->flow )( e, input_buffer + in_done, output_buffer + out_done, &isamp, &osamp ) != ST_SUCCESS )
 #endif
-					{
-						mlt_log_warning( MLT_FILTER_SERVICE(filter), "effect processing failed\n" );
+						{
+							mlt_log_warning( MLT_FILTER_SERVICE(filter), "effect processing failed\n" );
+							break;
+						}
+						in_done += isamp;
+						out_done += osamp;
+						if ( isamp == 0 && osamp == 0 )
+							break;
 					}
+
+					// An effect with latency may not fill the first output.
+					if ( out_done < *samples )
+						memset( output_buffer + out_done, 0, ( *samples - out_done ) * sizeof(st_sample_t) );
+
+					// Feed the result to the next effect
+					memcpy( input_buffer, output_buffer, *samples * sizeof(st_sample_t) );
 					
 					// XXX: hack to restore the original vol gain to prevent accumulation
 #ifdef SOX14
@@ -429,9 +498,6 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 					}
 				}
 			}
-
-			// Write back
-			memcpy( input_buffer, output_buffer, *samples * sizeof(st_sample_t) );
 		}
 	}
 
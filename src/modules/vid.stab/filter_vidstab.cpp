@@ -30,6 +30,12 @@ extern "C"
 #include <sstream>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+// How long the analysis of a frame waits for the frame before it
+#define PARALLEL_WAIT_SECONDS 10
 
 typedef struct
 {
@@ -38,6 +44,38 @@ typedef struct
 	mlt_position last_position;
 } vs_analyze;
 
+/** A motion detector of the parallel analysis.
+ *
+ * The detection of a frame only depends on the frame before it, so any idle
+ * detector can analyze any frame once it is given the frame before.
+ */
+
+typedef struct
+{
+	VSMotionDetect md;
+	mlt_position last_position; // the last frame that md saw
+	int busy;
+} vs_detector;
+
+typedef struct
+{
+	VSMotionDetectConfig conf;
+	VSFrameInfo fi;
+	FILE* results;
+	int image_size;
+	mlt_position length;
+	mlt_position next_position; // the next frame to write to results
+	uint8_t** images;           // copies of the frames until the next frame is analyzed
+	LocalMotions* motions;      // motions waiting for the frames before to be written
+	char* status;               // 0 = not seen, 1 = started, 2 = detected
+	vs_detector** detectors;
+	int detector_count;
+	int users;                  // threads using this, protected by the service lock
+	int error;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} vs_parallel_analyze;
+
 typedef struct
 {
 	VSTransformData td;
@@ -48,6 +86,7 @@ typedef struct
 typedef struct
 {
 	vs_analyze* analyze_data;
+	vs_parallel_analyze* parallel_data;
 	vs_apply* apply_data;
 } vs_data;
 
@@ -196,6 +235,20 @@ void destroy_analyze_data( vs_analyze* analyze_data )
 	}
 }
 
+static void get_motion_config( VSMotionDetectConfig* conf, mlt_filter filter )
+{
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	const char* filterName = mlt_properties_get( properties, "mlt_service" );
+
+	*conf = vsMotionDetectGetDefaultConfig( filterName );
+	conf->shakiness = mlt_properties_get_int( properties, "shakiness" );
+	conf->accuracy = mlt_properties_get_int( properties, "accuracy" );
+	conf->stepSize = mlt_properties_get_int( properties, "stepsize" );
+	conf->contrastThreshold = mlt_properties_get_double( properties, "mincontrast" );
+	conf->show = mlt_properties_get_int( properties, "show" );
+	conf->virtualTripod = mlt_properties_get_int( properties, "tripod" );
+}
+
 static void init_analyze_data( mlt_filter filter, mlt_frame frame, VSPixelFormat vs_format, int width, int height )
 {
 	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
@@ -204,14 +257,8 @@ static void init_analyze_data( mlt_filter filter, mlt_frame frame, VSPixelFormat
 	memset( analyze_data, 0, sizeof(vs_analyze) );
 
 	// Initialize a VSMotionDetectConfig
-	const char* filterName = mlt_properties_get( properties, "mlt_service" );
-	VSMotionDetectConfig conf = vsMotionDetectGetDefaultConfig( filterName );
-	conf.shakiness = mlt_properties_get_int( properties, "shakiness" );
-	conf.accuracy = mlt_properties_get_int( properties, "accuracy" );
-	conf.stepSize = mlt_properties_get_int( properties, "stepsize" );
-	conf.contrastThreshold = mlt_properties_get_double( properties, "mincontrast" );
-	conf.show = mlt_properties_get_int( properties, "show" );
-	conf.virtualTripod = mlt_properties_get_int( properties, "tripod" );
+	VSMotionDetectConfig conf;
+	get_motion_config( &conf, filter );
 
 	// Initialize a VSFrameInfo
 	VSFrameInfo fi;
@@ -332,6 +379,215 @@ static void analyze_image( mlt_filter filter, mlt_frame frame, uint8_t* vs_image
 	}
 }
 
+static void destroy_parallel_data( vs_parallel_analyze* parallel_data )
+{
+	if ( parallel_data )
+	{
+		int i;
+		for ( i = 0; i < parallel_data->detector_count; i++ )
+		{
+			vsMotionDetectionCleanup( &parallel_data->detectors[i]->md );
+			free( parallel_data->detectors[i] );
+		}
+		free( parallel_data->detectors );
+		for ( i = 0; i < parallel_data->length; i++ )
+		{
+			mlt_pool_release( parallel_data->images[i] );
+			if ( parallel_data->status[i] == 2 )
+				vs_vector_del( &parallel_data->motions[i] );
+		}
+		free( parallel_data->images );
+		free( parallel_data->motions );
+		free( parallel_data->status );
+		if( parallel_data->results )
+			fclose( parallel_data->results );
+		pthread_mutex_destroy( &parallel_data->mutex );
+		pthread_cond_destroy( &parallel_data->cond );
+		free( parallel_data );
+	}
+}
+
+static vs_detector* new_detector( vs_parallel_analyze* parallel_data )
+{
+	vs_detector* detector = (vs_detector*)calloc( 1, sizeof(vs_detector) );
+	vsMotionDetectInit( &detector->md, &parallel_data->conf, &parallel_data->fi );
+#ifdef ASCII_SERIALIZATION_MODE
+	detector->md.serializationMode = ASCII_SERIALIZATION_MODE;
+#endif
+	detector->last_position = -2;
+	parallel_data->detectors = (vs_detector**)realloc( parallel_data->detectors,
+		( parallel_data->detector_count + 1 ) * sizeof(vs_detector*) );
+	parallel_data->detectors[ parallel_data->detector_count++ ] = detector;
+	return detector;
+}
+
+static void init_parallel_data( mlt_filter filter, mlt_frame frame, VSPixelFormat vs_format, int width, int height )
+{
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	vs_data* data = (vs_data*)filter->child;
+	vs_parallel_analyze* parallel_data = (vs_parallel_analyze*)calloc( 1, sizeof(vs_parallel_analyze) );
+
+	get_motion_config( &parallel_data->conf, filter );
+	vsFrameInfoInit( &parallel_data->fi, width, height, vs_format );
+	parallel_data->image_size = vs_format == PF_YUV420P ?
+		mlt_image_format_size( mlt_image_yuv420p, width, height, NULL ) : width * height * 3;
+	parallel_data->length = mlt_filter_get_length2( filter, frame );
+	parallel_data->images = (uint8_t**)calloc( parallel_data->length, sizeof(uint8_t*) );
+	parallel_data->motions = (LocalMotions*)calloc( parallel_data->length, sizeof(LocalMotions) );
+	parallel_data->status = (char*)calloc( parallel_data->length, 1 );
+	pthread_mutex_init( &parallel_data->mutex, NULL );
+	pthread_cond_init( &parallel_data->cond, NULL );
+
+	// Initialize the file to save results to
+	char* filename = mlt_properties_get( properties, "filename" );
+	vs_detector* detector = new_detector( parallel_data );
+	parallel_data->results = mlt_fopen( filename, "w" );
+	if ( vsPrepareFile( &detector->md, parallel_data->results ) != VS_OK )
+	{
+		mlt_log_error( MLT_FILTER_SERVICE(filter), "Can not write to results file: %s\n", filename );
+		destroy_parallel_data( parallel_data );
+		data->parallel_data = NULL;
+	}
+	else
+	{
+		data->parallel_data = parallel_data;
+	}
+}
+
+/** Analyze a frame on the calling thread while other threads analyze other frames.
+ *
+ * A detector that did not see the frame before is first given a copy of it,
+ * and the motions are written to the results in order as they complete.
+ * This is called without the service lock.
+ */
+
+static void analyze_image_parallel( mlt_filter filter, mlt_frame frame, vs_parallel_analyze* parallel_data, uint8_t* vs_image )
+{
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	mlt_position pos = mlt_filter_get_position( filter, frame );
+	vs_detector* detector = NULL;
+	uint8_t* previous = NULL;
+	LocalMotions localmotions;
+	VSFrame vsFrame;
+	int i, error = 0;
+
+	pthread_mutex_lock( &parallel_data->mutex );
+
+	if ( parallel_data->error || pos < 0 || pos >= parallel_data->length || parallel_data->status[pos] )
+	{
+		// Failed, or a frame that is already analyzed or being analyzed
+		pthread_mutex_unlock( &parallel_data->mutex );
+		return;
+	}
+	parallel_data->status[pos] = 1;
+
+	// Keep a copy of this frame for the detector of the next one
+	if ( pos + 1 < parallel_data->length )
+	{
+		parallel_data->images[pos] = (uint8_t*)mlt_pool_alloc( parallel_data->image_size );
+		memcpy( parallel_data->images[pos], vs_image, parallel_data->image_size );
+		pthread_cond_broadcast( &parallel_data->cond );
+	}
+
+	// Prefer the detector that saw the frame before
+	for ( i = 0; i < parallel_data->detector_count; i++ )
+	{
+		vs_detector* d = parallel_data->detectors[i];
+		if ( !d->busy && ( !detector || d->last_position == pos - 1 ) )
+			detector = d;
+	}
+	if ( !detector )
+		detector = new_detector( parallel_data );
+	detector->busy = 1;
+
+	if ( pos > 0 && detector->last_position != pos - 1 )
+	{
+		// Wait for the frame before
+		struct timeval now;
+		struct timespec timeout;
+		gettimeofday( &now, NULL );
+		timeout.tv_sec = now.tv_sec + PARALLEL_WAIT_SECONDS;
+		timeout.tv_nsec = now.tv_usec * 1000;
+		while ( !parallel_data->error && !parallel_data->images[pos - 1] && !error )
+			error = pthread_cond_timedwait( &parallel_data->cond, &parallel_data->mutex, &timeout ) == ETIMEDOUT;
+		previous = parallel_data->images[pos - 1];
+		parallel_data->images[pos - 1] = NULL;
+		if ( error )
+			mlt_log_error( MLT_FILTER_SERVICE(filter), "Bad frame sequence pos %d\n", pos );
+	}
+	else if ( pos > 0 )
+	{
+		mlt_pool_release( parallel_data->images[pos - 1] );
+		parallel_data->images[pos - 1] = NULL;
+	}
+	error = error || parallel_data->error;
+	pthread_mutex_unlock( &parallel_data->mutex );
+
+	if ( !error && detector->last_position != pos - 1 )
+	{
+		// Start over from the frame before
+		vsMotionDetectionCleanup( &detector->md );
+		vsMotionDetectInit( &detector->md, &parallel_data->conf, &parallel_data->fi );
+#ifdef ASCII_SERIALIZATION_MODE
+		detector->md.serializationMode = ASCII_SERIALIZATION_MODE;
+#endif
+		if ( previous )
+		{
+			vsFrameFillFromBuffer( &vsFrame, previous, &parallel_data->fi );
+			if ( vsMotionDetection( &detector->md, &localmotions, &vsFrame ) == VS_OK )
+				vs_vector_del( &localmotions );
+			else
+				error = 1;
+		}
+	}
+	mlt_pool_release( previous );
+
+	// Detect the motions
+	if ( !error )
+	{
+		vsFrameFillFromBuffer( &vsFrame, vs_image, &parallel_data->fi );
+		error = vsMotionDetection( &detector->md, &localmotions, &vsFrame ) != VS_OK;
+		if ( error )
+			mlt_log_error( MLT_FILTER_SERVICE(filter), "Motion detection failed\n" );
+	}
+
+	pthread_mutex_lock( &parallel_data->mutex );
+	detector->busy = 0;
+	detector->last_position = error ? -2 : pos;
+	if ( error )
+	{
+		parallel_data->error = 1;
+		pthread_cond_broadcast( &parallel_data->cond );
+	}
+	else
+	{
+		parallel_data->motions[pos] = localmotions;
+		parallel_data->status[pos] = 2;
+
+		// Write the motions that are complete in order
+		while ( parallel_data->next_position < parallel_data->length
+			&& parallel_data->status[ parallel_data->next_position ] == 2 )
+		{
+			mlt_position next = parallel_data->next_position++;
+			detector->md.frameNum = next + 1;
+			vsWriteToFile( &detector->md, parallel_data->results, &parallel_data->motions[next] );
+			vs_vector_del( &parallel_data->motions[next] );
+			parallel_data->status[next] = 1;
+		}
+		detector->md.frameNum = pos + 1;
+
+		// Publish the motions if this is the last frame.
+		if ( parallel_data->next_position == parallel_data->length )
+		{
+			mlt_log_info( MLT_FILTER_SERVICE(filter), "Analysis complete\n" );
+			fclose( parallel_data->results );
+			parallel_data->results = NULL;
+			mlt_properties_set( properties, "results", mlt_properties_get( properties, "filename" ) );
+		}
+	}
+	pthread_mutex_unlock( &parallel_data->mutex );
+}
+
 static int get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
 	mlt_filter filter = (mlt_filter)mlt_frame_pop_service( frame );
@@ -372,7 +628,34 @@ static int get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format
 		else if (!mlt_properties_get(properties, "analyze") ||
 		         mlt_properties_get_int(properties, "analyze"))
 		{
-			analyze_image( filter, frame, vs_image, vs_format, *width, *height );
+			// The virtual tripod needs every frame to be compared with the same reference frame
+			if ( mlt_properties_get_int( properties, "parallel" ) && !mlt_properties_get_int( properties, "tripod" ) )
+			{
+				vs_data* data = (vs_data*)filter->child;
+				vs_parallel_analyze* parallel_data = data->parallel_data;
+
+				// Start over when the analysis restarts at the first frame
+				if ( parallel_data && !parallel_data->users && mlt_filter_get_position( filter, frame ) == 0 )
+				{
+					destroy_parallel_data( parallel_data );
+					data->parallel_data = NULL;
+				}
+				if ( !data->parallel_data )
+					init_parallel_data( filter, frame, vs_format, *width, *height );
+				parallel_data = data->parallel_data;
+				if ( parallel_data )
+				{
+					parallel_data->users++;
+					mlt_service_unlock( MLT_FILTER_SERVICE(filter) );
+					analyze_image_parallel( filter, frame, parallel_data, vs_image );
+					mlt_service_lock( MLT_FILTER_SERVICE(filter) );
+					parallel_data->users--;
+				}
+			}
+			else
+			{
+				analyze_image( filter, frame, vs_image, vs_format, *width, *height );
+			}
 			if( mlt_properties_get_int( properties, "show" ) == 1 )
 			{
 				vsimage_to_mltimage( vs_image, *image, *format, *width, *height );
@@ -400,6 +683,7 @@ static void filter_close( mlt_filter filter )
 	if ( data )
 	{
 		if ( data->analyze_data ) destroy_analyze_data( data->analyze_data );
+		if ( data->parallel_data ) destroy_parallel_data( data->parallel_data );
 		if ( data->apply_data ) destory_apply_data( data->apply_data );
 		free( data );
 	}
@@ -420,6 +704,7 @@ mlt_filter filter_vidstab_init( mlt_profile profile, mlt_service_type type, cons
 	if ( filter && data )
 	{
 		data->analyze_data = NULL;
+		data->parallel_data = NULL;
 		data->apply_data = NULL;
 
 		filter->close = filter_close;
@@ -437,6 +722,7 @@ mlt_filter filter_vidstab_init( mlt_profile profile, mlt_service_type type, cons
 		mlt_properties_set_double( properties, "mincontrast", 0.3 );
 		mlt_properties_set( properties, "show", "0" );
 		mlt_properties_set( properties, "tripod", "0" );
+		mlt_properties_set( properties, "parallel", "0" );
 
 		// properties for apply
 		mlt_properties_set( properties, "smoothing", "15" );
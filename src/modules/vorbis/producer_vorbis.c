@@ -30,6 +30,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+// How far the reader decodes ahead of playback and how much it holds
+#define AHEAD_SECONDS (2)
+#define BUFFER_SECONDS (4)
+
+// A forward jump up to this is decoded rather than seeked
+#define SKIP_SECONDS (1)
+
+// The samples a seek starts decoding before its target, more than a vorbis block
+#define SEEK_MARGIN (8192)
+
+// The largest read from libvorbisfile
+#define READ_BYTES (4096)
 
 // Forward references.
 static int producer_open( mlt_producer this, mlt_profile profile, char *file );
@@ -102,18 +119,342 @@ mlt_producer producer_vorbis_init( mlt_profile profile, mlt_service_type type, c
 	return this;
 }
 
-/** Destuctor for ogg files.
+/** A page of the index of an ogg file.
 */
 
-static void producer_file_close( void *file )
+typedef struct
 {
-	if ( file != NULL )
+	int64_t offset;      // the position of the page in the file
+	int64_t pcm;         // decoding from the page gives no samples before this one
+} page_entry;
+
+/** The decoder of a file, which decodes ahead of playback on its own thread.
+ *
+ * Only the thread uses the OggVorbis_File once it is started. The decoded
+ * samples from the sample position start are in buffer from head on, and the
+ * thread keeps decoding until it is AHEAD_SECONDS beyond the last request.
+ * A request before the buffer, or too far after it, makes the thread seek.
+ */
+
+typedef struct vorbis_reader_s
+{
+	OggVorbis_File ov;
+	char *file;
+	int channels;
+	int rate;
+	long serial;                 // the serial number of the only logical stream, or -1
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t thread;
+	pthread_t index_thread;
+	int thread_started;
+	int index_started;
+	int running;
+	atomic_int cancel;
+	int16_t *buffer;
+	int capacity;                // the size of buffer in samples per channel
+	int head;                    // where the sample at start is in buffer
+	int count;                   // the number of samples from head on
+	int64_t start;
+	int64_t wanted;              // the sample after the last request
+	int64_t seek;                // a position the thread must seek to, or -1
+	int generation;              // changes with each seek to drop what was decoded before it
+	int eof;
+	page_entry *index;           // set once it is complete
+	int index_count;
+} *vorbis_reader;
+
+/** Build an index of the pages of the file by reading only their headers.
+*/
+
+static void *reader_index_thread( void *arg )
+{
+	vorbis_reader self = arg;
+	FILE *input = mlt_fopen( self->file, "rb" );
+	page_entry *index = NULL;
+	int count = 0, allocated = 0, error = input == NULL;
+	unsigned char header[ 27 + 255 ];
+	int64_t offset = 0;
+
+	while ( !error && !atomic_load( &self->cancel ) && fread( header, 1, 27, input ) == 27 )
 	{
-		// Close the ogg vorbis structure
-		ov_clear( file );
+		int segments = header[26], body = 0, i;
+		uint64_t granule = 0;
+		uint32_t serial = header[14] | header[15] << 8 | header[16] << 16 | (uint32_t) header[17] << 24;
 
-		// Free the memory
-		free( file );
+		if ( memcmp( header, "OggS", 4 ) || fread( header + 27, 1, segments, input ) != (size_t) segments )
+		{
+			error = 1;
+			break;
+		}
+		for ( i = 0; i < segments; i++ )
+			body += header[ 27 + i ];
+		for ( i = 7; i >= 0; i-- )
+			granule = ( granule << 8 ) | header[ 6 + i ];
+		offset += 27 + segments + body;
+
+		// A page without a granule position has no packet which ends on it
+		if ( serial == (uint32_t) self->serial && granule != UINT64_MAX )
+		{
+			if ( count == allocated )
+			{
+				page_entry *entries = realloc( index, ( allocated = allocated ? allocated * 2 : 1024 ) * sizeof( page_entry ) );
+				if ( !entries )
+				{
+					error = 1;
+					break;
+				}
+				index = entries;
+			}
+			// The samples of the next page begin at the end of this one
+			index[ count ].offset = offset;
+			index[ count ].pcm = (int64_t) granule;
+			count++;
+		}
+		error = fseeko( input, (off_t) offset, SEEK_SET ) != 0;
+	}
+	if ( input )
+		fclose( input );
+
+	pthread_mutex_lock( &self->mutex );
+	if ( !error && !atomic_load( &self->cancel ) && count > 0 )
+	{
+		self->index = index;
+		self->index_count = count;
+		index = NULL;
+	}
+	pthread_mutex_unlock( &self->mutex );
+	free( index );
+
+	return NULL;
+}
+
+/** Seek the decoder, using the index when it is ready.
+ *
+ * \return the number of decoded samples to drop to reach the position, or -1
+ * if the position is not in the file
+ */
+
+static int64_t reader_seek( vorbis_reader self, int64_t position )
+{
+	page_entry *index;
+	int count;
+
+	pthread_mutex_lock( &self->mutex );
+	index = self->index;
+	count = self->index_count;
+	pthread_mutex_unlock( &self->mutex );
+
+	if ( index )
+	{
+		// Find the last page which begins well before the position
+		int low = 0, high = count - 1, found = -1;
+		while ( low <= high )
+		{
+			int middle = ( low + high ) / 2;
+			if ( index[ middle ].pcm <= position - SEEK_MARGIN )
+			{
+				found = middle;
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle - 1;
+			}
+		}
+		if ( found >= 0 && ov_raw_seek( &self->ov, index[ found ].offset ) == 0 )
+		{
+			// The decoder knows the exact position after a raw seek
+			ogg_int64_t tell = ov_pcm_tell( &self->ov );
+			if ( tell >= 0 && tell <= position && position - tell <= self->rate )
+				return position - tell;
+		}
+		else if ( found < 0 && ov_raw_seek( &self->ov, 0 ) == 0 && ov_pcm_tell( &self->ov ) == 0 )
+		{
+			return position;
+		}
+	}
+	return ov_pcm_seek( &self->ov, position ) == 0 ? 0 : -1;
+}
+
+/** The thread which decodes ahead.
+*/
+
+static void *reader_thread( void *arg )
+{
+	vorbis_reader self = arg;
+	char *data = malloc( READ_BYTES );
+	int chunk = READ_BYTES / ( sizeof( int16_t ) * self->channels );
+	int64_t skip = 0;
+
+	pthread_mutex_lock( &self->mutex );
+	while ( self->running )
+	{
+		if ( self->seek >= 0 )
+		{
+			int64_t position = self->seek;
+			int generation = self->generation;
+
+			self->seek = -1;
+			pthread_mutex_unlock( &self->mutex );
+			skip = reader_seek( self, position );
+			pthread_mutex_lock( &self->mutex );
+			if ( generation != self->generation )
+			{
+				skip = 0;
+			}
+			else if ( skip < 0 )
+			{
+				skip = 0;
+				self->eof = 1;
+				pthread_cond_broadcast( &self->cond );
+			}
+			continue;
+		}
+
+		// Make room at the end of the buffer
+		if ( self->head + self->count + chunk > self->capacity && self->head > 0 )
+		{
+			memmove( self->buffer, &self->buffer[ self->head * self->channels ], self->count * self->channels * sizeof( int16_t ) );
+			self->head = 0;
+		}
+
+		if ( data && !self->eof && self->head + self->count + chunk <= self->capacity
+			&& self->start + self->count < self->wanted + (int64_t) self->rate * AHEAD_SECONDS )
+		{
+			int generation = self->generation;
+			int section = 0;
+			long bytes;
+
+			pthread_mutex_unlock( &self->mutex );
+			bytes = ov_read( &self->ov, data, READ_BYTES, 0, 2, 1, &section );
+			pthread_mutex_lock( &self->mutex );
+
+			// Drop what was decoded for a position which is no longer wanted
+			if ( generation != self->generation )
+				continue;
+			if ( bytes == OV_HOLE )
+				continue;
+			if ( bytes <= 0 )
+			{
+				self->eof = 1;
+			}
+			else
+			{
+				int samples = bytes / ( sizeof( int16_t ) * self->channels );
+				int16_t *pcm = (int16_t*) data;
+
+				if ( skip > 0 )
+				{
+					int dropped = skip < samples ? skip : samples;
+					skip -= dropped;
+					samples -= dropped;
+					pcm += dropped * self->channels;
+				}
+				memcpy( &self->buffer[ ( self->head + self->count ) * self->channels ], pcm, samples * self->channels * sizeof( int16_t ) );
+				self->count += samples;
+			}
+			pthread_cond_broadcast( &self->cond );
+		}
+		else
+		{
+			pthread_cond_wait( &self->cond, &self->mutex );
+		}
+	}
+	pthread_mutex_unlock( &self->mutex );
+	free( data );
+
+	return NULL;
+}
+
+/** Get the samples from a position, waiting for the thread to decode them.
+ *
+ * \return the number of samples, which is less than asked for at the end of the file
+ */
+
+static int reader_read( vorbis_reader self, int64_t position, int16_t *out, int samples )
+{
+	int available = 0;
+
+	pthread_mutex_lock( &self->mutex );
+
+	if ( !self->thread_started && self->buffer )
+	{
+		self->thread_started = !pthread_create( &self->thread, NULL, reader_thread, self );
+		if ( self->serial >= 0 )
+			self->index_started = !pthread_create( &self->index_thread, NULL, reader_index_thread, self );
+	}
+
+	// Seek when going back or jumping far ahead
+	if ( position < self->start || position > self->start + self->count + (int64_t) self->rate * SKIP_SECONDS )
+	{
+		self->generation++;
+		self->seek = position;
+		self->start = position;
+		self->head = 0;
+		self->count = 0;
+		self->eof = 0;
+	}
+	self->wanted = position + samples;
+	pthread_cond_broadcast( &self->cond );
+
+	while ( self->thread_started )
+	{
+		// Drop the samples before the position
+		int64_t drop = position - self->start;
+		if ( drop > self->count )
+			drop = self->count;
+		if ( drop > 0 )
+		{
+			self->head += drop;
+			self->count -= drop;
+			self->start += drop;
+			pthread_cond_broadcast( &self->cond );
+		}
+		if ( self->eof || ( self->start == position && self->count >= samples ) )
+			break;
+		pthread_cond_wait( &self->cond, &self->mutex );
+	}
+
+	if ( self->start == position )
+	{
+		available = self->count < samples ? self->count : samples;
+		memcpy( out, &self->buffer[ self->head * self->channels ], available * self->channels * sizeof( int16_t ) );
+	}
+
+	pthread_mutex_unlock( &self->mutex );
+
+	return available;
+}
+
+/** Destructor for the reader, which also closes the file.
+*/
+
+static void reader_close( void *arg )
+{
+	vorbis_reader self = arg;
+
+	if ( self != NULL )
+	{
+		pthread_mutex_lock( &self->mutex );
+		self->running = 0;
+		atomic_store( &self->cancel, 1 );
+		pthread_cond_broadcast( &self->cond );
+		pthread_mutex_unlock( &self->mutex );
+		if ( self->thread_started )
+			pthread_join( self->thread, NULL );
+		if ( self->index_started )
+			pthread_join( self->index_thread, NULL );
+
+		// Close the ogg vorbis structure
+		ov_clear( &self->ov );
+
+		pthread_mutex_destroy( &self->mutex );
+		pthread_cond_destroy( &self->cond );
+		free( self->buffer );
+		free( self->index );
+		free( self->file );
+		free( self );
 	}
 }
 
@@ -131,20 +472,36 @@ static int producer_open( mlt_producer this, mlt_profile profile, char *file )
 	// Continue if file is open
 	if ( error == 0 )
 	{
-		// OggVorbis file structure
-		OggVorbis_File *ov = calloc( 1, sizeof( OggVorbis_File ) );
+		// The reader holds the OggVorbis file structure
+		vorbis_reader reader = calloc( 1, sizeof( struct vorbis_reader_s ) );
 
 		// Attempt to open the stream
-		error = ov == NULL || ov_open( input, ov, NULL, 0 ) != 0;
+		error = reader == NULL || ov_open( input, &reader->ov, NULL, 0 ) != 0;
 
 		// Assign to producer properties if successful
 		if ( error == 0 )
 		{
 			// Get the properties
 			mlt_properties properties = MLT_PRODUCER_PROPERTIES( this );
-
-			// Assign the ov structure
-			mlt_properties_set_data( properties, "ogg_vorbis_file", ov, 0, producer_file_close, NULL );
+			OggVorbis_File *ov = &reader->ov;
+
+			// Get the vorbis info
+			vorbis_info *vi = ov_info( ov, -1 );
+
+			// Set up the decoding ahead
+			reader->file = strdup( file );
+			reader->channels = vi->channels;
+			reader->rate = vi->rate;
+			reader->serial = ov_seekable( ov ) && ov_streams( ov ) == 1 ? ov_serialnumber( ov, 0 ) : -1;
+			reader->capacity = vi->rate * BUFFER_SECONDS;
+			reader->buffer = malloc( reader->capacity * vi->channels * sizeof( int16_t ) );
+			reader->running = 1;
+			reader->seek = -1;
+			pthread_mutex_init( &reader->mutex, NULL );
+			pthread_cond_init( &reader->cond, NULL );
+
+			// Assign the reader
+			mlt_properties_set_data( properties, "vorbis_reader", reader, 0, reader_close, NULL );
 
 			// Read metadata
 			sw_metadata * metadata = NULL;
@@ -172,8 +529,7 @@ static int producer_open( mlt_producer this, mlt_profile profile, char *file )
 				mlt_properties_set_position( properties, "out", ( length * fps ) - 1 );
 				mlt_properties_set_position( properties, "length", ( length * fps ) );
 
-				// Get the vorbis info
-				vorbis_info *vi = ov_info( ov, -1 );
+				// Set the audio info
 				mlt_properties_set_int( properties, "audio_frequency", (int) vi->rate );
 				mlt_properties_set_int( properties, "audio_channels", vi->channels );
 
@@ -188,7 +544,7 @@ static int producer_open( mlt_producer this, mlt_profile profile, char *file )
 		else
 		{
 			// Clean up
-			free( ov );
+			free( reader );
 
 			// Must close input file when open fails
 			fclose( input );
@@ -198,14 +554,6 @@ static int producer_open( mlt_producer this, mlt_profile profile, char *file )
 	return error;
 }
 
-/** Convert a frame position to a time code.
-*/
-
-static double producer_time_of_frame( mlt_producer this, mlt_position position )
-{
-	return ( double )position / mlt_producer_get_fps( this );
-}
-
 /** Get the audio from a frame.
 */
 
@@ -222,8 +570,8 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 
 	mlt_service_lock( MLT_PRODUCER_SERVICE( this ) );
 
-	// Get the ogg vorbis file
-	OggVorbis_File *ov = mlt_properties_get_data( properties, "ogg_vorbis_file", NULL );
+	// Get the reader of the ogg vorbis file
+	vorbis_reader reader = mlt_properties_get_data( properties, "vorbis_reader", NULL );
 
 	// Obtain the expected frame number
 	mlt_position expected = mlt_properties_get_position( properties, "audio_expected" );
@@ -231,113 +579,38 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 	// Get the fps for this producer
 	double fps = mlt_producer_get_fps( this );
 
-	// Get the vorbis info
-	vorbis_info *vi = ov_info( ov, -1 );
-
-	// Obtain the audio buffer
-	int16_t *audio_buffer = mlt_properties_get_data( properties, "audio_buffer", NULL );
-
-	// Get amount of audio used
-	int audio_used =  mlt_properties_get_int( properties, "audio_used" );
-
-	// Number of frames to ignore (for ffwd)
-	int ignore = 0;
-
-	// Flag for paused (silence) 
-	int paused = 0;
-
-	// Check for audio buffer and create if necessary
-	if ( audio_buffer == NULL )
-	{
-		// Allocate the audio buffer
-		audio_buffer = mlt_pool_alloc( 131072 * sizeof( int16_t ) );
-
-		// And store it on properties for reuse
-		mlt_properties_set_data( properties, "audio_buffer", audio_buffer, 0, mlt_pool_release, NULL );
-	}
-
-	// Seek if necessary
-	if ( position != expected )
-	{
-		if ( position + 1 == expected )
-		{
-			// We're paused - silence required
-			paused = 1;
-		}
-		else if ( position > expected && ( position - expected ) < 250 )
-		{
-			// Fast forward - seeking is inefficient for small distances - just ignore following frames
-			ignore = position - expected;
-		}
-		else
-		{
-			// Seek to the required position
-			ov_time_seek( ov, producer_time_of_frame( this, position ) );
-			expected = position;
-			audio_used = 0;
-		}
-	}
-
 	// Return info in frame
-	*frequency = vi->rate;
-	*channels = vi->channels;
-
-	// Get the audio if required
-	if ( !paused )
-	{
-		// Bitstream section
-		int current_section;
-
-		// Get the number of samples for the current frame
-		*samples = mlt_audio_calculate_frame_samples( fps, *frequency, expected ++ );
+	*frequency = reader->rate;
+	*channels = reader->channels;
 
-		while( *samples > audio_used  )
-		{
-			// Read the samples
-			int bytes = ov_read( ov, ( char * )( &audio_buffer[ audio_used * 2 ] ), 4096, 0, 2, 1, &current_section );
-
-			// Break if error or eof
-			if ( bytes <= 0 )
-				break;
+	// Get the number of samples for the current frame
+	*samples = mlt_audio_calculate_frame_samples( fps, *frequency, position );
 
-			// Increment number of samples used
-			audio_used += bytes / ( sizeof( int16_t ) * *channels );
-
-			// Handle ignore
-			while ( ignore && audio_used >= *samples )
-			{
-				ignore --;
-				audio_used -= *samples;
-				memmove( audio_buffer, &audio_buffer[ *samples * *channels ], audio_used * sizeof( int16_t ) * *channels );
-				*samples = mlt_audio_calculate_frame_samples( fps, *frequency, expected ++ );
-			}
-		}
+	// Get the audio unless we're paused, which needs silence
+	if ( position + 1 != expected )
+	{
+		int size = *samples * *channels * sizeof( int16_t );
+		int16_t *audio = mlt_pool_alloc( size );
+		int64_t sample = mlt_audio_calculate_samples_to_position( fps, *frequency, position );
+		int available = reader_read( reader, sample, audio, *samples );
 
-		// Now handle the audio if we have enough
-		if ( audio_used >= *samples )
+		if ( available > 0 )
 		{
-			int size = *samples * *channels * sizeof( int16_t );
-
+			// Pad the end of the file with silence
+			memset( &audio[ available * *channels ], 0, ( *samples - available ) * *channels * sizeof( int16_t ) );
 			*format = mlt_audio_s16;
-			*buffer = mlt_pool_alloc( size );
-			memcpy( *buffer, audio_buffer, size );
-			audio_used -= *samples;
-			memmove( audio_buffer, &audio_buffer[ *samples * *channels ], audio_used * *channels * sizeof( int16_t ) );
+			*buffer = audio;
 			mlt_frame_set_audio( frame, *buffer, *format, size, mlt_pool_release );
 		}
 		else
 		{
+			mlt_pool_release( audio );
 			mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
-			audio_used = 0;
 		}
-		
-		// Store the number of audio samples still available
-		mlt_properties_set_int( properties, "audio_used", audio_used );
 	}
 	else
 	{
-		// Get silence and don't touch the context
-		*samples = mlt_audio_calculate_frame_samples( fps, *frequency, position );
+		// Get silence and don't touch the decoder
 		mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
 	}
 
@@ -38,6 +38,18 @@
 #define xine_fast_memcpy memcpy
 #define xine_fast_memmove memmove
 
+/* Get the range [start, end) of the n iterations of a loop that slice index
+   out of jobs handles. The first and the last slice also handle the lines
+   before and after the loop, so every line is written by one slice only.
+*/
+static void slice_lines( int n, int index, int jobs, int *start, int *end )
+{
+  if (n < 0)
+    n = 0;
+  *start = n * index / jobs;
+  *end = n * (index + 1) / jobs;
+}
+
 /*
    DeinterlaceFieldBob algorithm
    Based on Virtual Dub plugin by Gunnar Thalin
@@ -45,7 +57,7 @@
    Linux version for Xine player by Miguel Freitas
 */
 static void deinterlace_bob_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
-    int width, int height )
+    int width, int height, int index, int jobs )
 {
 #ifdef USE_MMX
   int Line;
@@ -61,7 +73,7 @@ static void deinterlace_bob_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
   long EdgeDetect = 625;
   long JaggieThreshold = 73;
 
-  int n;
+  int n, start, end;
 
   uint64_t qwEdgeDetect;
   uint64_t qwThreshold;
@@ -77,12 +89,15 @@ static void deinterlace_bob_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
 
   // copy first even line no matter what, and the first odd line if we're
   // processing an odd field.
-  xine_fast_memcpy(pdst, pEvenLines, LineLength);
-  if (IsOdd)
-    xine_fast_memcpy(pdst + LineLength, pOddLines, LineLength);
+  if (index == 0) {
+    xine_fast_memcpy(pdst, pEvenLines, LineLength);
+    if (IsOdd)
+      xine_fast_memcpy(pdst + LineLength, pOddLines, LineLength);
+  }
 
   height = height / 2;
-  for (Line = 0; Line < height - 1; ++Line)
+  slice_lines(height - 1, index, jobs, &start, &end);
+  for (Line = start; Line < end; ++Line)
   {
     if (IsOdd)
     {
@@ -170,7 +185,7 @@ static void deinterlace_bob_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
   }
 
   // Copy last odd line if we're processing an even field.
-  if (! IsOdd)
+  if (! IsOdd && index == jobs - 1)
   {
     xine_fast_memcpy(pdst + (height * 2 - 1) * LineLength,
                       pOddLines + (height - 1) * SourcePitch,
@@ -189,7 +204,7 @@ static void deinterlace_bob_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
    is normal or if the code is broken.
 */
 static int deinterlace_weave_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
-    int width, int height )
+    int width, int height, int index, int jobs )
 {
 #ifdef USE_MMX
 
@@ -211,7 +226,7 @@ static int deinterlace_weave_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
   long SpatialTolerance = 600;
   long SimilarityThreshold = 25;
 
-  int n;
+  int n, start, end;
 
   uint64_t qwSpatialTolerance;
   uint64_t qwTemporalTolerance;
@@ -241,12 +256,15 @@ static int deinterlace_weave_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
 
   // copy first even line no matter what, and the first odd line if we're
   // processing an even field.
-  xine_fast_memcpy(pdst, pEvenLines, LineLength);
-  if (!IsOdd)
-    xine_fast_memcpy(pdst + LineLength, pOddLines, LineLength);
+  if (index == 0) {
+    xine_fast_memcpy(pdst, pEvenLines, LineLength);
+    if (!IsOdd)
+      xine_fast_memcpy(pdst + LineLength, pOddLines, LineLength);
+  }
 
   height = height / 2;
-  for (Line = 0; Line < height - 1; ++Line)
+  slice_lines(height - 1, index, jobs, &start, &end);
+  for (Line = start; Line < end; ++Line)
   {
     if (IsOdd)
     {
@@ -359,7 +377,7 @@ static int deinterlace_weave_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
   }
 
   // Copy last odd line if we're processing an odd field.
-  if (IsOdd)
+  if (IsOdd && index == jobs - 1)
   {
     xine_fast_memcpy(pdst + (height * 2 - 1) * LineLength,
                       pOddLines + (height - 1) * SourcePitch,
@@ -388,7 +406,7 @@ static int deinterlace_weave_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
 // I'd intended this to be part of a larger more elaborate method added to
 // Blended Clip but this give too good results for the CPU to ignore here.
 static int deinterlace_greedy_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
-    int width, int height )
+    int width, int height, int index, int jobs )
 {
 #ifdef USE_MMX
   int Line;
@@ -408,8 +426,8 @@ static int deinterlace_greedy_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
   int SourcePitch = width * 2;
   int IsOdd = 1;
   long GreedyMaxComb = 15;
-  static mmx_t MaxComb;
-  int i;
+  mmx_t MaxComb;
+  int i, start, end;
 
   if ( psrc[0] == NULL || psrc[1] == NULL )
     return 0;
@@ -426,12 +444,15 @@ static int deinterlace_greedy_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
 
   // copy first even line no matter what, and the first odd line if we're
   // processing an EVEN field. (note diff from other deint rtns.)
-  xine_fast_memcpy(pdst, pEvenLines, LineLength); //DL0
-  if (!IsOdd)
-    xine_fast_memcpy(pdst + LineLength, pOddLines, LineLength); //DL1
+  if (index == 0) {
+    xine_fast_memcpy(pdst, pEvenLines, LineLength); //DL0
+    if (!IsOdd)
+      xine_fast_memcpy(pdst + LineLength, pOddLines, LineLength); //DL1
+  }
 
   height = height / 2;
-  for (Line = 0; Line < height - 1; ++Line)
+  slice_lines(height - 1, index, jobs, &start, &end);
+  for (Line = start; Line < end; ++Line)
   {
     LoopCtr = LineLength / 8;				// there are LineLength / 8 qwords per line
 
@@ -531,7 +552,7 @@ static int deinterlace_greedy_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
   }
 
   /* Copy last odd line if we're processing an Odd field. */
-  if (IsOdd)
+  if (IsOdd && index == jobs - 1)
   {
     xine_fast_memcpy(pdst + (height * 2 - 1) * LineLength,
                       pOddLines + (height - 1) * SourcePitch,
@@ -551,7 +572,7 @@ static int deinterlace_greedy_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
    (good for fast moving scenes) also know as "linear interpolation"
 */
 static void deinterlace_onefield_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
-    int width, int height )
+    int width, int height, int index, int jobs )
 {
 #ifdef USE_MMX
   int Line;
@@ -564,7 +585,7 @@ static void deinterlace_onefield_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
   int SourcePitch = width * 2;
   int IsOdd = 1;
 
-  int n;
+  int n, start, end;
 
   static mmx_t Mask = {.ub={0xfe,0xfe,0xfe,0xfe,0xfe,0xfe,0xfe,0xfe}};
 
@@ -573,12 +594,15 @@ static void deinterlace_onefield_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
    * processing an odd field.
    */
 
-  xine_fast_memcpy(pdst, pEvenLines, LineLength);
-  if (IsOdd)
-    xine_fast_memcpy(pdst + LineLength, pOddLines, LineLength);
+  if (index == 0) {
+    xine_fast_memcpy(pdst, pEvenLines, LineLength);
+    if (IsOdd)
+      xine_fast_memcpy(pdst + LineLength, pOddLines, LineLength);
+  }
 
   height = height / 2;
-  for (Line = 0; Line < height - 1; ++Line)
+  slice_lines(height - 1, index, jobs, &start, &end);
+  for (Line = start; Line < end; ++Line)
   {
     if (IsOdd)
     {
@@ -614,7 +638,7 @@ static void deinterlace_onefield_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
   }
 
   /* Copy last odd line if we're processing an even field. */
-  if (! IsOdd)
+  if (! IsOdd && index == jobs - 1)
   {
     xine_fast_memcpy(pdst + (height * 2 - 1) * LineLength,
                       pOddLines + (height - 1) * SourcePitch,
@@ -632,7 +656,7 @@ static void deinterlace_onefield_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
    (idea borrowed from mplayer's sources)
 */
 static void deinterlace_linearblend_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
-    int width, int height )
+    int width, int height, int index, int jobs )
 {
 #ifdef USE_MMX
   int Line;
@@ -642,12 +666,14 @@ static void deinterlace_linearblend_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
   uint64_t *Dest;
   int LineLength = width;
 
-  int n;
+  int n, start, end;
 
   /* Copy first line */
-  xine_fast_memmove(pdst, psrc[0], LineLength);
+  if (index == 0)
+    xine_fast_memmove(pdst, psrc[0], LineLength);
 
-  for (Line = 1; Line < height - 1; ++Line)
+  slice_lines(height - 2, index, jobs, &start, &end);
+  for (Line = start + 1; Line < end + 1; ++Line)
   {
     YVal1 = (uint64_t *)(psrc[0] + (Line - 1) * LineLength);
     YVal2 = (uint64_t *)(psrc[0] + (Line) * LineLength);
@@ -662,7 +688,12 @@ static void deinterlace_linearblend_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
       movq_m2r (*YVal2++, mm1);
       movq_m2r (*YVal3++, mm2);
 
-      /* expand bytes to words */
+      /* expand bytes to words, clearing the registers that get the low
+         bytes of the high half first so that they don't leak into the
+         result from whatever ran before on this thread */
+      pxor_r2r (mm3, mm3);
+      pxor_r2r (mm4, mm4);
+      pxor_r2r (mm5, mm5);
       punpckhbw_r2r (mm0, mm3);
       punpckhbw_r2r (mm1, mm4);
       punpckhbw_r2r (mm2, mm5);
@@ -695,8 +726,9 @@ static void deinterlace_linearblend_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
   }
 
   /* Copy last line */
-  xine_fast_memmove(pdst + Line * LineLength,
-                   psrc[0] + Line * LineLength, LineLength);
+  if (index == jobs - 1)
+    xine_fast_memmove(pdst + (height - 1) * LineLength,
+                     psrc[0] + (height - 1) * LineLength, LineLength);
 
   /* clear out the MMX registers ready for doing floating point
    * again
@@ -722,21 +754,23 @@ static void deinterlace_linearblend_yuv_mmx( uint8_t *pdst, uint8_t *psrc[],
 
 */
 static void deinterlace_linearblend_yuv( uint8_t *pdst, uint8_t *psrc[],
-                                         int width, int height )
+                                         int width, int height, int index, int jobs )
 {
   register int x, y;
   register uint8_t *l0, *l1, *l2, *l3;
+  int start, end;
 
-  l0 = pdst;		/* target line */
-  l1 = psrc[0];		/* 1st source line */
+  /* Copy the first line */
+  if (index == 0)
+    xine_fast_memcpy(pdst, psrc[0], width);
+
+  slice_lines(height - 2, index, jobs, &start, &end);
+  l0 = pdst + (start + 1) * width;	/* target line */
+  l1 = psrc[0] + start * width;		/* 1st source line */
   l2 = l1 + width;	/* 2nd source line = line that follows l1 */
   l3 = l2 + width;	/* 3rd source line = line that follows l2 */
 
-  /* Copy the first line */
-  xine_fast_memcpy(l0, l1, width);
-  l0 += width;
-
-  for (y = 1; y < height-1; ++y) {
+  for (y = start + 1; y < end + 1; ++y) {
     /* computes avg of: l1 + 2*l2 + l3 */
 
     for (x = 0; x < width; ++x) {
@@ -748,8 +782,9 @@ static void deinterlace_linearblend_yuv( uint8_t *pdst, uint8_t *psrc[],
     l0 += width;
   }
 
-  /* Copy the last line */
-  xine_fast_memcpy(l0, l1, width);
+  /* Copy the last line (the loop has left l1 on the line above it) */
+  if (index == jobs - 1 && height > 1)
+    xine_fast_memcpy(pdst + (height - 1) * width, psrc[0] + (height - 2) * width, width);
 }
 
 static int check_for_mmx(void)
@@ -767,6 +802,16 @@ static int config_flags = -1;
 #endif
 }
 
+/* copy the lines of a slice when a method has nothing to do */
+static void copy_yuv( uint8_t *pdst, uint8_t *psrc[],
+    int width, int height, int index, int jobs )
+{
+  int start, end;
+
+  slice_lines(height, index, jobs, &start, &end);
+  xine_fast_memcpy(pdst + start * width, psrc[0] + start * width, (end - start) * width);
+}
+
 /* generic YUV deinterlacer
    pdst -> pointer to destination bitmap
    psrc -> array of pointers to source bitmaps ([0] = most recent)
@@ -776,49 +821,60 @@ static int config_flags = -1;
 
 void deinterlace_yuv( uint8_t *pdst, uint8_t *psrc[],
     int width, int height, int method )
+{
+  deinterlace_yuv_slice(pdst, psrc, width, height, method, 0, 1);
+}
+
+/* deinterlace slice index out of jobs, using the same arguments as
+   deinterlace_yuv. The slices can run in parallel and together write
+   every line of pdst.
+*/
+
+void deinterlace_yuv_slice( uint8_t *pdst, uint8_t *psrc[],
+    int width, int height, int method, int index, int jobs )
 {
   switch( method ) {
     case DEINTERLACE_NONE:
-      xine_fast_memcpy(pdst,psrc[0],width*height);
+      copy_yuv(pdst,psrc,width,height,index,jobs);
       break;
     case DEINTERLACE_BOB:
       if( check_for_mmx() )
-        deinterlace_bob_yuv_mmx(pdst,psrc,width,height);
+        deinterlace_bob_yuv_mmx(pdst,psrc,width,height,index,jobs);
       else /* FIXME: provide an alternative? */
-        deinterlace_linearblend_yuv(pdst,psrc,width,height);
+        deinterlace_linearblend_yuv(pdst,psrc,width,height,index,jobs);
       break;
     case DEINTERLACE_WEAVE:
       if( check_for_mmx() )
       {
-        if( !deinterlace_weave_yuv_mmx(pdst,psrc,width,height) )
-          xine_fast_memcpy(pdst,psrc[0],width*height);
+        if( !deinterlace_weave_yuv_mmx(pdst,psrc,width,height,index,jobs) )
+          copy_yuv(pdst,psrc,width,height,index,jobs);
       }
       else /* FIXME: provide an alternative? */
-        deinterlace_linearblend_yuv(pdst,psrc,width,height);
+        deinterlace_linearblend_yuv(pdst,psrc,width,height,index,jobs);
       break;
     case DEINTERLACE_GREEDY:
       if( check_for_mmx() )
       {
-        if( !deinterlace_greedy_yuv_mmx(pdst,psrc,width,height) )
-          xine_fast_memcpy(pdst,psrc[0],width*height);
+        if( !deinterlace_greedy_yuv_mmx(pdst,psrc,width,height,index,jobs) )
+          copy_yuv(pdst,psrc,width,height,index,jobs);
       }
       else /* FIXME: provide an alternative? */
-        deinterlace_linearblend_yuv(pdst,psrc,width,height);
+        deinterlace_linearblend_yuv(pdst,psrc,width,height,index,jobs);
       break;
     case DEINTERLACE_ONEFIELD:
       if( check_for_mmx() )
-        deinterlace_onefield_yuv_mmx(pdst,psrc,width,height);
+        deinterlace_onefield_yuv_mmx(pdst,psrc,width,height,index,jobs);
       else /* FIXME: provide an alternative? */
-        deinterlace_linearblend_yuv(pdst,psrc,width,height);
+        deinterlace_linearblend_yuv(pdst,psrc,width,height,index,jobs);
       break;
     case DEINTERLACE_ONEFIELDXV:
       lprintf("ONEFIELDXV must be handled by the video driver.\n");
       break;
     case DEINTERLACE_LINEARBLEND:
       if( check_for_mmx() )
-        deinterlace_linearblend_yuv_mmx(pdst,psrc,width,height);
+        deinterlace_linearblend_yuv_mmx(pdst,psrc,width,height,index,jobs);
       else
-        deinterlace_linearblend_yuv(pdst,psrc,width,height);
+        deinterlace_linearblend_yuv(pdst,psrc,width,height,index,jobs);
       break;
     default:
       lprintf("unknown method %d.\n",method);
@@ -33,6 +33,8 @@
 int deinterlace_yuv_supported ( int method );
 void deinterlace_yuv( uint8_t *pdst, uint8_t *psrc[],
     int width, int height, int method );
+void deinterlace_yuv_slice( uint8_t *pdst, uint8_t *psrc[],
+    int width, int height, int method, int index, int jobs );
 
 #define DEINTERLACE_NONE        0
 #define DEINTERLACE_BOB         1
@@ -21,6 +21,8 @@
 #include <framework/mlt_log.h>
 #include <framework/mlt_producer.h>
 #include <framework/mlt_events.h>
+#include <framework/mlt_cpu.h>
+#include <framework/mlt_slices.h>
 #include "deinterlace.h"
 #include "yadif.h"
 
@@ -32,17 +34,38 @@
 #define YADIF_MODE_TEMPORAL_SPATIAL (0)
 #define YADIF_MODE_TEMPORAL (2)
 
+/** Images shorter than twice this many lines are deinterlaced on the calling thread. */
+#define MIN_SLICE_HEIGHT (64)
+
+/** Get the number of slices to deinterlace an image of the given height with. */
+
+static int slice_count( int height )
+{
+	int jobs = mlt_slices_count_normal();
+	if ( jobs > height / MIN_SLICE_HEIGHT )
+		jobs = height / MIN_SLICE_HEIGHT;
+	return jobs > 1 ? jobs : 1;
+}
+
 static yadif_filter *init_yadif( int width, int height )
 {
 	yadif_filter *yadif = mlt_pool_alloc( sizeof( *yadif ) );
 
 	yadif->cpu = 0; // Pure C
 #ifdef USE_SSE
-	yadif->cpu |= AVS_CPU_INTEGER_SSE;
+	if ( mlt_cpu_has( mlt_cpu_sse ) )
+		yadif->cpu |= AVS_CPU_INTEGER_SSE;
 #endif
 #ifdef USE_SSE2
-	yadif->cpu |= AVS_CPU_SSE2;
+	if ( mlt_cpu_has( mlt_cpu_sse2 ) )
+		yadif->cpu |= AVS_CPU_SSE2;
+#endif
+#ifdef USE_SSE3
+	if ( mlt_cpu_has( mlt_cpu_ssse3 ) )
+		yadif->cpu |= AVS_CPU_SSSE3;
 #endif
+	if ( mlt_cpu_has( mlt_cpu_avx2 ) )
+		yadif->cpu |= AVS_CPU_AVX2;
 	// Create intermediate planar planes
 	yadif->yheight = height;
 	yadif->ywidth  = width;
@@ -98,6 +121,81 @@ static void close_yadif(yadif_filter *yadif)
 #endif
 }
 
+struct yadif_desc
+{
+	yadif_filter *yadif;
+	uint8_t *image;
+	uint8_t *previous;
+	uint8_t *next;
+	int mode;
+	int order;
+};
+
+static void slice_lines( int height, int index, int jobs, int *start, int *end )
+{
+	*start = height * index / jobs;
+	*end = height * ( index + 1 ) / jobs;
+}
+
+/** Convert a slice of the three packed images to planar. */
+
+static int yadif_planes_proc( int id, int index, int jobs, void *cookie )
+{
+	struct yadif_desc *desc = cookie;
+	yadif_filter *yadif = desc->yadif;
+	const int pitch = yadif->ywidth << 1;
+	int start, end;
+
+	slice_lines( yadif->yheight, index, jobs, &start, &end );
+	if ( end > start )
+	{
+		int y = start * yadif->ypitch;
+		int uv = start * yadif->uvpitch;
+		int lines = end - start;
+
+		YUY2ToPlanes( desc->image + start * pitch, pitch, yadif->ywidth, lines, yadif->ysrc + y,
+			yadif->ypitch, yadif->usrc + uv, yadif->vsrc + uv, yadif->uvpitch, yadif->cpu );
+		YUY2ToPlanes( desc->previous + start * pitch, pitch, yadif->ywidth, lines, yadif->yprev + y,
+			yadif->ypitch, yadif->uprev + uv, yadif->vprev + uv, yadif->uvpitch, yadif->cpu );
+		YUY2ToPlanes( desc->next + start * pitch, pitch, yadif->ywidth, lines, yadif->ynext + y,
+			yadif->ypitch, yadif->unext + uv, yadif->vnext + uv, yadif->uvpitch, yadif->cpu );
+	}
+	return 0;
+}
+
+/** Deinterlace a slice of each plane and pack it back into the current image.
+ *
+ * The lines of a slice depend on the neighbouring lines of the sources, so this
+ * can only start once yadif_planes_proc() has finished for every slice.
+ */
+
+static int yadif_filter_proc( int id, int index, int jobs, void *cookie )
+{
+	struct yadif_desc *desc = cookie;
+	yadif_filter *yadif = desc->yadif;
+	const int pitch = yadif->ywidth << 1;
+	const int parity = 0;
+	int start, end;
+
+	slice_lines( yadif->yheight, index, jobs, &start, &end );
+	if ( end > start )
+	{
+		int y = start * yadif->ypitch;
+		int uv = start * yadif->uvpitch;
+
+		filter_plane_lines( desc->mode, yadif->ydest, yadif->ypitch, yadif->yprev, yadif->ysrc,
+			yadif->ynext, yadif->ypitch, yadif->ywidth, yadif->yheight, parity, desc->order, yadif->cpu, start, end );
+		filter_plane_lines( desc->mode, yadif->udest, yadif->uvpitch, yadif->uprev, yadif->usrc,
+			yadif->unext, yadif->uvpitch, yadif->uvwidth, yadif->yheight, parity, desc->order, yadif->cpu, start, end );
+		filter_plane_lines( desc->mode, yadif->vdest, yadif->uvpitch, yadif->vprev, yadif->vsrc,
+			yadif->vnext, yadif->uvpitch, yadif->uvwidth, yadif->yheight, parity, desc->order, yadif->cpu, start, end );
+
+		YUY2FromPlanes( desc->image + start * pitch, pitch, yadif->ywidth, end - start, yadif->ydest + y,
+			yadif->ypitch, yadif->udest + uv, yadif->vdest + uv, yadif->uvpitch, yadif->cpu );
+	}
+	return 0;
+}
+
 static int deinterlace_yadif( mlt_frame frame, mlt_filter filter, uint8_t **image, mlt_image_format *format, int *width, int *height, int mode )
 {
 	mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
@@ -146,29 +244,27 @@ static int deinterlace_yadif( mlt_frame frame, mlt_filter filter, uint8_t **imag
 				yadif_filter *yadif = init_yadif( *width, *height );
 				if ( yadif )
 				{
-					const int order = mlt_properties_get_int( properties, "top_field_first" );
-					const int pitch = *width << 1;
-					const int parity = 0;
-
-					// Convert packed to planar
-					YUY2ToPlanes( *image, pitch, *width, *height, yadif->ysrc,
-						yadif->ypitch, yadif->usrc, yadif->vsrc, yadif->uvpitch, yadif->cpu );
-					YUY2ToPlanes( previous_image, pitch, *width, *height, yadif->yprev,
-						yadif->ypitch, yadif->uprev, yadif->vprev, yadif->uvpitch, yadif->cpu );
-					YUY2ToPlanes( next_image, pitch, *width, *height, yadif->ynext,
-						yadif->ypitch, yadif->unext, yadif->vnext, yadif->uvpitch, yadif->cpu );
-
-					// Deinterlace each plane
-					filter_plane( mode, yadif->ydest, yadif->ypitch, yadif->yprev, yadif->ysrc,
-						yadif->ynext, yadif->ypitch, *width, *height, parity, order, yadif->cpu);
-					filter_plane( mode, yadif->udest, yadif->uvpitch,yadif->uprev, yadif->usrc,
-						yadif->unext, yadif->uvpitch, *width >> 1, *height, parity, order, yadif->cpu);
-					filter_plane( mode, yadif->vdest, yadif->uvpitch, yadif->vprev, yadif->vsrc,
-						yadif->vnext, yadif->uvpitch, *width >> 1, *height, parity, order, yadif->cpu);
-
-					// Convert planar to packed
-					YUY2FromPlanes( *image, pitch, *width, *height, yadif->ydest,
-						yadif->ypitch, yadif->udest, yadif->vdest, yadif->uvpitch, yadif->cpu);
+					struct yadif_desc desc = {
+						.yadif = yadif,
+						.image = *image,
+						.previous = previous_image,
+						.next = next_image,
+						.mode = mode,
+						.order = mlt_properties_get_int( properties, "top_field_first" ),
+					};
+					int jobs = slice_count( *height );
+
+					// Convert packed to planar, then deinterlace each plane and convert it back
+					if ( jobs > 1 )
+					{
+						mlt_slices_run_normal( jobs, yadif_planes_proc, &desc );
+						mlt_slices_run_normal( jobs, yadif_filter_proc, &desc );
+					}
+					else
+					{
+						yadif_planes_proc( 0, 0, 1, &desc );
+						yadif_filter_proc( 0, 0, 1, &desc );
+					}
 
 					close_yadif( yadif );
 				}
@@ -185,6 +281,22 @@ static int deinterlace_yadif( mlt_frame frame, mlt_filter filter, uint8_t **imag
 	return error;
 }
 
+struct xine_desc
+{
+	uint8_t *dst;
+	uint8_t **src;
+	int width;
+	int height;
+	int method;
+};
+
+static int xine_proc( int id, int index, int jobs, void *cookie )
+{
+	struct xine_desc *desc = cookie;
+	deinterlace_yuv_slice( desc->dst, desc->src, desc->width, desc->height, desc->method, index, jobs );
+	return 0;
+}
+
 /** Do it :-).
 */
 
@@ -278,7 +390,13 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 					int image_size = mlt_image_format_size( *format, *width, *height, NULL );
 					uint8_t *new_image = mlt_pool_alloc( image_size );
 
-					deinterlace_yuv( new_image, image, *width * 2, *height, method );
+					struct xine_desc desc = { new_image, image, *width * 2, *height, method };
+					int jobs = slice_count( *height );
+
+					if ( jobs > 1 )
+						mlt_slices_run_normal( jobs, xine_proc, &desc );
+					else
+						deinterlace_yuv( new_image, image, *width * 2, *height, method );
 					mlt_frame_set_image( frame, new_image, image_size, mlt_pool_release );
 					*image = new_image;
 				}
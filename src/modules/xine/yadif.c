@@ -33,7 +33,7 @@
 #define MIN3(a,b,c) MIN(MIN(a,b),c)
 #define MAX3(a,b,c) MAX(MAX(a,b),c)
 
-static void (*filter_line)(int mode, uint8_t *dst, const uint8_t *prev, const uint8_t *cur, const uint8_t *next, int w, int refs, int parity);
+typedef void (*filter_line_func)(int mode, uint8_t *dst, const uint8_t *prev, const uint8_t *cur, const uint8_t *next, int w, int refs, int parity);
 
 #if defined(__GNUC__) && defined(USE_SSE)
 
@@ -355,63 +355,153 @@ static void interpolate(uint8_t *dst, const uint8_t *cur0,  const uint8_t *cur2,
     }
 }
 
-void filter_plane(int mode, uint8_t *dst, int dst_stride, const uint8_t *prev0, const uint8_t *cur0, const uint8_t *next0, int refs, int w, int h, int parity, int tff, int cpu){
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_AVX2 1
+#include <immintrin.h>
 
-	int y;
-	filter_line = filter_line_c;
+__attribute__((target("avx2")))
+static inline __m256i load16_avx2(const uint8_t *p)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) p));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avg_avx2(__m256i a, __m256i b)
+{
+    return _mm256_srli_epi16(_mm256_add_epi16(a, b), 1);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i score_avx2(const uint8_t *cur, int refs, int j)
+{
+    __m256i s0 = _mm256_abs_epi16(_mm256_sub_epi16(load16_avx2(cur - refs - 1 + j), load16_avx2(cur + refs - 1 - j)));
+    __m256i s1 = _mm256_abs_epi16(_mm256_sub_epi16(load16_avx2(cur - refs     + j), load16_avx2(cur + refs     - j)));
+    __m256i s2 = _mm256_abs_epi16(_mm256_sub_epi16(load16_avx2(cur - refs + 1 + j), load16_avx2(cur + refs + 1 - j)));
+    return _mm256_add_epi16(_mm256_add_epi16(s0, s1), s2);
+}
+
+// 16 pixels per iteration in 16-bit lanes, giving the results of filter_line_c
+__attribute__((target("avx2")))
+static void filter_line_avx2(int mode, uint8_t *dst, const uint8_t *prev, const uint8_t *cur, const uint8_t *next, int w, int refs, int parity){
+    const uint8_t *prev2= parity ? prev : cur ;
+    const uint8_t *next2= parity ? cur  : next;
+    int x;
+    for(x=0; x+16<=w; x+=16){
+        __m256i c= load16_avx2(cur - refs);
+        __m256i e= load16_avx2(cur + refs);
+        __m256i p2= load16_avx2(prev2);
+        __m256i n2= load16_avx2(next2);
+        __m256i d= avg_avx2(p2, n2);
+        __m256i temporal_diff0= _mm256_abs_epi16(_mm256_sub_epi16(p2, n2));
+        __m256i temporal_diff1= _mm256_srli_epi16(_mm256_add_epi16(
+            _mm256_abs_epi16(_mm256_sub_epi16(load16_avx2(prev - refs), c)),
+            _mm256_abs_epi16(_mm256_sub_epi16(load16_avx2(prev + refs), e))), 1);
+        __m256i temporal_diff2= _mm256_srli_epi16(_mm256_add_epi16(
+            _mm256_abs_epi16(_mm256_sub_epi16(load16_avx2(next - refs), c)),
+            _mm256_abs_epi16(_mm256_sub_epi16(load16_avx2(next + refs), e))), 1);
+        __m256i diff= _mm256_max_epi16(_mm256_max_epi16(_mm256_srli_epi16(temporal_diff0, 1), temporal_diff1), temporal_diff2);
+        __m256i spatial_pred= avg_avx2(c, e);
+        __m256i spatial_score= _mm256_sub_epi16(score_avx2(cur, refs, 0), _mm256_set1_epi16(1));
+        __m256i score, better, more;
+
+        // Like CHECK, the second offset on each side is only tried if the first one won
+        score= score_avx2(cur, refs, -1);
+        better= _mm256_cmpgt_epi16(spatial_score, score);
+        spatial_score= _mm256_blendv_epi8(spatial_score, score, better);
+        spatial_pred= _mm256_blendv_epi8(spatial_pred, avg_avx2(load16_avx2(cur - refs - 1), load16_avx2(cur + refs + 1)), better);
+        score= score_avx2(cur, refs, -2);
+        more= _mm256_and_si256(better, _mm256_cmpgt_epi16(spatial_score, score));
+        spatial_score= _mm256_blendv_epi8(spatial_score, score, more);
+        spatial_pred= _mm256_blendv_epi8(spatial_pred, avg_avx2(load16_avx2(cur - refs - 2), load16_avx2(cur + refs + 2)), more);
+
+        score= score_avx2(cur, refs, 1);
+        better= _mm256_cmpgt_epi16(spatial_score, score);
+        spatial_score= _mm256_blendv_epi8(spatial_score, score, better);
+        spatial_pred= _mm256_blendv_epi8(spatial_pred, avg_avx2(load16_avx2(cur - refs + 1), load16_avx2(cur + refs - 1)), better);
+        score= score_avx2(cur, refs, 2);
+        more= _mm256_and_si256(better, _mm256_cmpgt_epi16(spatial_score, score));
+        spatial_pred= _mm256_blendv_epi8(spatial_pred, avg_avx2(load16_avx2(cur - refs + 2), load16_avx2(cur + refs - 2)), more);
+
+        if(mode<2){
+            __m256i b= avg_avx2(load16_avx2(prev2 - 2*refs), load16_avx2(next2 - 2*refs));
+            __m256i f= avg_avx2(load16_avx2(prev2 + 2*refs), load16_avx2(next2 + 2*refs));
+            __m256i de= _mm256_sub_epi16(d, e);
+            __m256i dc= _mm256_sub_epi16(d, c);
+            __m256i bc= _mm256_sub_epi16(b, c);
+            __m256i fe= _mm256_sub_epi16(f, e);
+            __m256i max= _mm256_max_epi16(_mm256_max_epi16(de, dc), _mm256_min_epi16(bc, fe));
+            __m256i min= _mm256_min_epi16(_mm256_min_epi16(de, dc), _mm256_max_epi16(bc, fe));
+            diff= _mm256_max_epi16(_mm256_max_epi16(diff, min), _mm256_sub_epi16(_mm256_setzero_si256(), max));
+        }
+
+        // diff is never negative, so the two bounds are ordered
+        spatial_pred= _mm256_min_epi16(_mm256_max_epi16(spatial_pred, _mm256_sub_epi16(d, diff)), _mm256_add_epi16(d, diff));
+        spatial_pred= _mm256_permute4x64_epi64(_mm256_packus_epi16(spatial_pred, spatial_pred), 0xd8);
+        _mm_storeu_si128((__m128i*) dst, _mm256_castsi256_si128(spatial_pred));
+
+        dst += 16;
+        cur += 16;
+        prev += 16;
+        next += 16;
+        prev2 += 16;
+        next2 += 16;
+    }
+    if (x < w)
+        filter_line_c(mode, dst, prev, cur, next, w - x, refs, parity);
+}
+#endif
+
+static filter_line_func select_filter_line(int cpu)
+{
+#ifdef USE_AVX2
+	if (cpu & AVS_CPU_AVX2)
+		return filter_line_avx2;
+#endif
 #ifdef __GNUC__
 #if (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__>1)
 #ifdef USE_SSE3
 	if (cpu & AVS_CPU_SSSE3)
-		filter_line = filter_line_ssse3;
-	else
+		return filter_line_ssse3;
 #endif
 #if defined(USE_SSE2) && defined(ARCH_X86_64)
 	if (cpu & AVS_CPU_SSE2)
-		filter_line = filter_line_sse2;
-	else
+		return filter_line_sse2;
 #endif
 #endif // GCC 4.2+
 #ifdef USE_SSE
 	if (cpu & AVS_CPU_INTEGER_SSE)
-		filter_line = filter_line_mmx2;
+		return filter_line_mmx2;
 #endif
 #endif // GNUC
-        y=0;
-        if(((y ^ parity) & 1)){
-            memcpy(dst, cur0 + refs, w);// duplicate 1
-        }else{
-            memcpy(dst, cur0, w);
-        }
-        y=1;
-        if(((y ^ parity) & 1)){
-            interpolate(dst + dst_stride, cur0, cur0 + refs*2, w);   // interpolate 0 and 2
-        }else{
-            memcpy(dst + dst_stride, cur0 + refs, w); // copy original
-        }
-        for(y=2; y<h-2; y++){
-            if(((y ^ parity) & 1)){
-                const uint8_t *prev= prev0 + y*refs;
-                const uint8_t *cur = cur0 + y*refs;
-                const uint8_t *next= next0 + y*refs;
-                uint8_t *dst2= dst + y*dst_stride;
-                filter_line(mode, dst2, prev, cur, next, w, refs, (parity ^ tff));
-            }else{
-                memcpy(dst + y*dst_stride, cur0 + y*refs, w); // copy original
-            }
-        }
-       y=h-2;
-        if(((y ^ parity) & 1)){
-            interpolate(dst + (h-2)*dst_stride, cur0 + (h-3)*refs, cur0 + (h-1)*refs, w);   // interpolate h-3 and h-1
-        }else{
-            memcpy(dst + (h-2)*dst_stride, cur0 + (h-2)*refs, w); // copy original
-        }
-        y=h-1;
-        if(((y ^ parity) & 1)){
-            memcpy(dst + (h-1)*dst_stride, cur0 + (h-2)*refs, w); // duplicate h-2
+	return filter_line_c;
+}
+
+void filter_plane_lines(int mode, uint8_t *dst, int dst_stride, const uint8_t *prev0, const uint8_t *cur0, const uint8_t *next0, int refs, int w, int h, int parity, int tff, int cpu, int start, int end){
+
+	int y;
+	filter_line_func filter_line = select_filter_line(cpu);
+
+	// A line only depends on the sources, so each one is handled on its own. When the image
+	// is very short the last rules apply first, as when the lines were done in order.
+	for(y=start; y<end; y++){
+        uint8_t *dst2= dst + y*dst_stride;
+        if(!((y ^ parity) & 1)){
+            memcpy(dst2, cur0 + y*refs, w); // copy original
+        }else if(y == h-1){
+            memcpy(dst2, cur0 + (h-2)*refs, w); // duplicate h-2
+        }else if(y == h-2){
+            interpolate(dst2, cur0 + (h-3)*refs, cur0 + (h-1)*refs, w);   // interpolate h-3 and h-1
+        }else if(y == 1){
+            interpolate(dst2, cur0, cur0 + refs*2, w);   // interpolate 0 and 2
+        }else if(y == 0){
+            memcpy(dst2, cur0 + refs, w);// duplicate 1
         }else{
-            memcpy(dst + (h-1)*dst_stride, cur0 + (h-1)*refs, w); // copy original
+            const uint8_t *prev= prev0 + y*refs;
+            const uint8_t *cur = cur0 + y*refs;
+            const uint8_t *next= next0 + y*refs;
+            filter_line(mode, dst2, prev, cur, next, w, refs, (parity ^ tff));
         }
+	}
 
 #if defined(__GNUC__) && defined(USE_SSE)
 	if (cpu >= AVS_CPU_INTEGER_SSE)
@@ -419,6 +509,10 @@ void filter_plane(int mode, uint8_t *dst, int dst_stride, const uint8_t *prev0,
 #endif
 }
 
+void filter_plane(int mode, uint8_t *dst, int dst_stride, const uint8_t *prev0, const uint8_t *cur0, const uint8_t *next0, int refs, int w, int h, int parity, int tff, int cpu){
+	filter_plane_lines(mode, dst, dst_stride, prev0, cur0, next0, refs, w, h, parity, tff, cpu, 0, h);
+}
+
 #if defined(__GNUC__) && defined(USE_SSE) && !defined(PIC)
 static attribute_align_arg void  YUY2ToPlanes_mmx(const unsigned char *srcYUY2, int pitch_yuy2, int width, int height,
                     unsigned char *py, int pitch_y,
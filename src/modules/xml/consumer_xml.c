@@ -34,6 +34,32 @@
 #define _x (const xmlChar*)
 #define _s (const char*)
 
+/** A growing buffer of text.
+*/
+
+typedef struct
+{
+	char *data;
+	size_t length;
+	size_t size;
+} xml_buffer;
+
+static void buffer_append( xml_buffer *buffer, const char *text, int length )
+{
+	size_t n = length < 0 ? strlen( text ) : length;
+	if ( buffer->length + n + 1 > buffer->size )
+	{
+		size_t size = MAX( buffer->size * 2, buffer->length + n + 1 );
+		size = MAX( size, 4096 );
+		buffer->data = realloc( buffer->data, size );
+		buffer->size = size;
+	}
+	memcpy( buffer->data + buffer->length, text, n );
+	buffer->length += n;
+	buffer->data[ buffer->length ] = '\0';
+}
+
+
 // This maintains counters for adding ids to elements
 struct serialise_context_s
 {
@@ -53,8 +79,240 @@ struct serialise_context_s
 	int no_meta;
 	mlt_profile profile;
 	mlt_time_format time_format;
+	int format;
+	int ascii;
+	xml_buffer text;
 };
 typedef struct serialise_context_s* serialise_context;
+typedef struct xml_element_s *xml_element;
+
+/** An element of the document.
+ *
+ * The serialiser either adds the elements to a libxml2 tree or writes them
+ * straight out as text. Text is written as the services are visited, except
+ * that the root and tractor elements may get attributes after their first
+ * child, so their content is held until they end.
+ */
+
+struct xml_element_s
+{
+	struct xml_element_s *parent;
+	const char *name;
+	xmlNodePtr node;    // NULL when writing text
+	int depth;
+	int held;           // the content is held in body until the end
+	int started;        // the start tag is written
+	int empty;          // nothing is in the element yet
+	xml_buffer attributes;
+	xml_buffer body;
+};
+
+/** Append text with the characters that XML reserves escaped as libxml2 does.
+*/
+
+static void buffer_escape( serialise_context context, xml_buffer *buffer, const char *text, int attribute )
+{
+	const unsigned char *s = (const unsigned char*) text;
+	const unsigned char *run = s;
+	char ref[ 16 ];
+
+	for ( ; *s; s++ )
+	{
+		const char *entity = NULL;
+		int c = *s;
+		int n = 1;
+
+		if ( c == '<' )
+			entity = "&lt;";
+		else if ( c == '>' )
+			entity = "&gt;";
+		else if ( c == '&' )
+			entity = "&amp;";
+		else if ( c == '"' && attribute )
+			entity = "&quot;";
+		else if ( c == '\r' || ( attribute && ( c == '\n' || c == '\t' ) ) )
+			entity = ref;
+		else if ( c >= 0x80 && context->ascii )
+		{
+			// Decode the UTF-8 sequence to reference the character
+			n = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+			c &= 0x3f >> ( n - 1 );
+			for ( int i = 1; i < n; i++ )
+			{
+				if ( ( s[i] & 0xc0 ) != 0x80 )
+				{
+					n = i;
+					break;
+				}
+				c = ( c << 6 ) | ( s[i] & 0x3f );
+			}
+			entity = ref;
+		}
+		if ( entity )
+		{
+			if ( entity == ref )
+				snprintf( ref, sizeof( ref ), context->ascii ? "&#x%X;" : "&#%d;", c );
+			buffer_append( buffer, (const char*) run, s - run );
+			buffer_append( buffer, entity, -1 );
+			s += n - 1;
+			run = s + 1;
+		}
+	}
+	buffer_append( buffer, (const char*) run, s - run );
+}
+
+static void buffer_indent( serialise_context context, xml_buffer *buffer, int depth )
+{
+	static const char spaces[] = "                                ";
+	depth *= 2;
+	while ( context->format && depth > 0 )
+	{
+		int n = MIN( depth, (int) sizeof( spaces ) - 1 );
+		buffer_append( buffer, spaces, n );
+		depth -= n;
+	}
+}
+
+static void buffer_newline( serialise_context context, xml_buffer *buffer )
+{
+	if ( context->format )
+		buffer_append( buffer, "\n", 1 );
+}
+
+// Get the buffer to which the content of an element is written
+static xml_buffer *element_content( serialise_context context, xml_element element )
+{
+	while ( element && !element->held )
+		element = element->parent;
+	return element ? &element->body : &context->text;
+}
+
+static void element_write_start( serialise_context context, xml_element element, xml_buffer *buffer, int close )
+{
+	buffer_indent( context, buffer, element->depth );
+	buffer_append( buffer, "<", 1 );
+	buffer_append( buffer, element->name, -1 );
+	if ( element->attributes.data )
+		buffer_append( buffer, element->attributes.data, element->attributes.length );
+	buffer_append( buffer, close ? "/>" : ">", -1 );
+	buffer_newline( context, buffer );
+}
+
+// Write the start tag of an element that gets content, unless it is held
+static void element_open( serialise_context context, xml_element element )
+{
+	if ( element->node == NULL && !element->held && !element->started )
+		element_write_start( context, element, element_content( context, element->parent ), 0 );
+	element->started = 1;
+	element->empty = 0;
+}
+
+static xml_element element_init( xml_element parent, const char *name, xmlNodePtr node )
+{
+	xml_element element = calloc( 1, sizeof( struct xml_element_s ) );
+	element->parent = parent;
+	element->name = name;
+	element->node = node;
+	element->depth = parent ? parent->depth + 1 : 0;
+	element->held = !parent || !strcmp( name, "tractor" );
+	element->empty = 1;
+	return element;
+}
+
+/** Create the root element, in a tree if \p node is not NULL.
+*/
+
+static xml_element element_root( serialise_context context, xmlNodePtr node )
+{
+	return element_init( NULL, "mlt", node );
+}
+
+static xml_element element_new( serialise_context context, xml_element parent, const char *name )
+{
+	if ( parent->node )
+		return element_init( parent, name, xmlNewChild( parent->node, NULL, _x(name), NULL ) );
+	element_open( context, parent );
+	return element_init( parent, name, NULL );
+}
+
+static void element_attribute( serialise_context context, xml_element element, const char *name, const char *value )
+{
+	if ( element->node )
+	{
+		xmlNewProp( element->node, _x(name), _x(value) );
+	}
+	else if ( element->started && !element->held )
+	{
+		mlt_log_warning( NULL, "[consumer_xml] attribute %s is too late for element %s\n", name, element->name );
+	}
+	else
+	{
+		buffer_append( &element->attributes, " ", 1 );
+		buffer_append( &element->attributes, name, -1 );
+		buffer_append( &element->attributes, "=\"", 2 );
+		buffer_escape( context, &element->attributes, value, 1 );
+		buffer_append( &element->attributes, "\"", 1 );
+	}
+}
+
+/** Add a property element with text to an element.
+*/
+
+static void element_property( serialise_context context, xml_element element, const char *name, const char *value )
+{
+	if ( element->node )
+	{
+		xmlNodePtr p = xmlNewTextChild( element->node, NULL, _x("property"), _x(value) );
+		xmlNewProp( p, _x("name"), _x(name) );
+	}
+	else
+	{
+		xml_buffer *buffer;
+
+		element_open( context, element );
+		buffer = element_content( context, element );
+		buffer_indent( context, buffer, element->depth + 1 );
+		buffer_append( buffer, "<property name=\"", -1 );
+		buffer_escape( context, buffer, name, 1 );
+		buffer_append( buffer, "\">", 2 );
+		buffer_escape( context, buffer, value, 0 );
+		buffer_append( buffer, "</property>", -1 );
+		buffer_newline( context, buffer );
+	}
+}
+
+/** Finish an element once all of its content is added.
+*/
+
+static void element_end( serialise_context context, xml_element element )
+{
+	if ( !element->node )
+	{
+		xml_buffer *buffer = element_content( context, element->parent );
+
+		if ( element->held )
+		{
+			element_write_start( context, element, buffer, element->empty );
+			if ( element->body.data )
+				buffer_append( buffer, element->body.data, element->body.length );
+		}
+		else if ( !element->started )
+		{
+			element_write_start( context, element, buffer, 1 );
+		}
+		if ( !element->empty )
+		{
+			buffer_indent( context, buffer, element->depth );
+			buffer_append( buffer, "</", 2 );
+			buffer_append( buffer, element->name, -1 );
+			buffer_append( buffer, ">", 1 );
+			buffer_newline( context, buffer );
+		}
+	}
+	free( element->attributes.data );
+	free( element->body.data );
+	free( element );
+}
 
 /** Forward references to static functions.
 */
@@ -64,7 +322,8 @@ static int consumer_stop( mlt_consumer parent );
 static int consumer_is_stopped( mlt_consumer consumer );
 static void consumer_close( mlt_consumer parent );
 static void *consumer_thread( void *arg );
-static void serialise_service( serialise_context context, mlt_service service, xmlNode *node );
+static void *writer_thread( void *arg );
+static void serialise_service( serialise_context context, mlt_service service, xml_element node );
 
 typedef enum
 {
@@ -196,10 +455,9 @@ mlt_consumer consumer_xml_init( mlt_profile profile, mlt_service_type type, cons
 	return NULL;
 }
 
-static void serialise_properties( serialise_context context, mlt_properties properties, xmlNode *node )
+static void serialise_properties( serialise_context context, mlt_properties properties, xml_element node )
 {
 	int i;
-	xmlNode *p;
 
 	// Enumerate the properties
 	for ( i = 0; i < mlt_properties_count( properties ); i++ )
@@ -243,24 +501,22 @@ static void serialise_properties( serialise_context context, mlt_properties prop
 						char *s = calloc( 1, strlen( value_orig ) - rootlen + 1 );
 						strncat( s, value_orig, prefix_size );
 						strcat( s, value + rootlen + 1 );
-						p = xmlNewTextChild( node, NULL, _x("property"), _x(s) );
+						element_property( context, node, name, s );
 						free( s );
 					} else {
-						p = xmlNewTextChild( node, NULL, _x("property"), _x(value_orig + rootlen + 1) );
+						element_property( context, node, name, value_orig + rootlen + 1 );
 					}
 				}
 				else
-					p = xmlNewTextChild( node, NULL, _x("property"), _x(value_orig) );
-				xmlNewProp( p, _x("name"), _x(name) );
+					element_property( context, node, name, value_orig );
 			}
 		}
 	}
 }
 
-static void serialise_store_properties( serialise_context context, mlt_properties properties, xmlNode *node, const char *store )
+static void serialise_store_properties( serialise_context context, mlt_properties properties, xml_element node, const char *store )
 {
 	int i;
-	xmlNode *p;
 
 	// Enumerate the properties
 	for ( i = 0; store != NULL && i < mlt_properties_count( properties ); i++ )
@@ -274,19 +530,18 @@ static void serialise_store_properties( serialise_context context, mlt_propertie
 				int rootlen = strlen( context->root );
 				// convert absolute path to relative
 				if ( rootlen && !strncmp( value, context->root, rootlen ) && value[ rootlen ] == '/' )
-					p = xmlNewTextChild( node, NULL, _x("property"), _x(value + rootlen + 1) );
+					element_property( context, node, name, value + rootlen + 1 );
 				else
-					p = xmlNewTextChild( node, NULL, _x("property"), _x(value) );
-				xmlNewProp( p, _x("name"), _x(name) );
+					element_property( context, node, name, value );
 			}
 		}
 	}
 }
 
-static inline void serialise_service_filters( serialise_context context, mlt_service service, xmlNode *node )
+static inline void serialise_service_filters( serialise_context context, mlt_service service, xml_element node )
 {
 	int i;
-	xmlNode *p;
+	xml_element p;
 	mlt_filter filter = NULL;
 
 	// Enumerate the filters
@@ -299,24 +554,25 @@ static inline void serialise_service_filters( serialise_context context, mlt_ser
 			char *id = xml_get_id( context, MLT_FILTER_SERVICE( filter ), xml_filter );
 			if ( id != NULL )
 			{
-				p = xmlNewChild( node, NULL, _x("filter"), NULL );
-				xmlNewProp( p, _x("id"), _x(id) );
+				p = element_new( context, node, "filter" );
+				element_attribute( context, p, "id", id );
 				if ( mlt_properties_get( properties, "title" ) )
-					xmlNewProp( p, _x("title"), _x(mlt_properties_get( properties, "title" )) );
+					element_attribute( context, p, "title", mlt_properties_get( properties, "title" ) );
 				if ( mlt_properties_get_position( properties, "in" ) )
-					xmlNewProp( p, _x("in"), _x( mlt_properties_get_time( properties, "in", context->time_format ) ) );
+					element_attribute( context, p, "in", mlt_properties_get_time( properties, "in", context->time_format ) );
 				if ( mlt_properties_get_position( properties, "out" ) )
-					xmlNewProp( p, _x("out"), _x( mlt_properties_get_time( properties, "out", context->time_format ) ) );
+					element_attribute( context, p, "out", mlt_properties_get_time( properties, "out", context->time_format ) );
 				serialise_properties( context, properties, p );
 				serialise_service_filters( context, MLT_FILTER_SERVICE( filter ), p );
+				element_end( context, p );
 			}
 		}
 	}
 }
 
-static void serialise_producer( serialise_context context, mlt_service service, xmlNode *node )
+static void serialise_producer( serialise_context context, mlt_service service, xml_element node )
 {
-	xmlNode *child = node;
+	xml_element child = node;
 	mlt_service parent = MLT_SERVICE( mlt_producer_cut_parent( MLT_PRODUCER( service ) ) );
 
 	if ( context->pass == 0 )
@@ -327,14 +583,14 @@ static void serialise_producer( serialise_context context, mlt_service service,
 		if ( id == NULL )
 			return;
 
-		child = xmlNewChild( node, NULL, _x("producer"), NULL );
+		child = element_new( context, node, "producer" );
 
 		// Set the id
-		xmlNewProp( child, _x("id"), _x(id) );
+		element_attribute( context, child, "id", id );
 		if ( mlt_properties_get( properties, "title" ) )
-			xmlNewProp( child, _x("title"), _x(mlt_properties_get( properties, "title" )) );
-		xmlNewProp( child, _x("in"), _x(mlt_properties_get_time( properties, "in", context->time_format )) );
-		xmlNewProp( child, _x("out"), _x(mlt_properties_get_time( properties, "out", context->time_format )) );
+			element_attribute( context, child, "title", mlt_properties_get( properties, "title" ) );
+		element_attribute( context, child, "in", mlt_properties_get_time( properties, "in", context->time_format ) );
+		element_attribute( context, child, "out", mlt_properties_get_time( properties, "out", context->time_format ) );
 
 		// If the xml producer fails to load a producer, it creates a text producer that says INVALID
 		// and sets the xml_mlt_service property to the original service.
@@ -346,6 +602,7 @@ static void serialise_producer( serialise_context context, mlt_service service,
 
 		serialise_properties( context, properties, child );
 		serialise_service_filters( context, service, child );
+		element_end( context, child );
 
 		// Add producer to the map
 		mlt_properties_set_int( context->hide_map, id, mlt_properties_get_int( properties, "hide" ) );
@@ -354,15 +611,15 @@ static void serialise_producer( serialise_context context, mlt_service service,
 	{
 		char *id = xml_get_id( context, parent, xml_existing );
 		mlt_properties properties = MLT_SERVICE_PROPERTIES( service );
-		xmlNewProp( node, _x("parent"), _x(id) );
-		xmlNewProp( node, _x("in"), _x(mlt_properties_get_time( properties, "in", context->time_format )) );
-		xmlNewProp( node, _x("out"), _x(mlt_properties_get_time( properties, "out", context->time_format )) );
+		element_attribute( context, node, "parent", id );
+		element_attribute( context, node, "in", mlt_properties_get_time( properties, "in", context->time_format ) );
+		element_attribute( context, node, "out", mlt_properties_get_time( properties, "out", context->time_format ) );
 	}
 }
 
-static void serialise_tractor( serialise_context context, mlt_service service, xmlNode *node );
+static void serialise_tractor( serialise_context context, mlt_service service, xml_element node );
 
-static void serialise_multitrack( serialise_context context, mlt_service service, xmlNode *node )
+static void serialise_multitrack( serialise_context context, mlt_service service, xml_element node )
 {
 	int i;
 
@@ -385,7 +642,7 @@ static void serialise_multitrack( serialise_context context, mlt_service service
 		// Serialise the tracks
 		for ( i = 0; i < mlt_multitrack_count( MLT_MULTITRACK( service ) ); i++ )
 		{
-			xmlNode *track = xmlNewChild( node, NULL, _x("track"), NULL );
+			xml_element track = element_new( context, node, "track" );
 			int hide = 0;
 			mlt_producer producer = mlt_multitrack_track( MLT_MULTITRACK( service ), i );
 			mlt_properties properties = MLT_PRODUCER_PROPERTIES( producer );
@@ -393,11 +650,11 @@ static void serialise_multitrack( serialise_context context, mlt_service service
 			mlt_service parent = MLT_SERVICE( mlt_producer_cut_parent( producer ) );
 
 			char *id = xml_get_id( context, MLT_SERVICE( parent ), xml_existing );
-			xmlNewProp( track, _x("producer"), _x(id) );
+			element_attribute( context, track, "producer", id );
 			if ( mlt_producer_is_cut( producer ) )
 			{
-				xmlNewProp( track, _x("in"), _x( mlt_properties_get_time( properties, "in", context->time_format ) ) );
-				xmlNewProp( track, _x("out"), _x( mlt_properties_get_time( properties, "out", context->time_format ) ) );
+				element_attribute( context, track, "in", mlt_properties_get_time( properties, "in", context->time_format ) );
+				element_attribute( context, track, "out", mlt_properties_get_time( properties, "out", context->time_format ) );
 				serialise_store_properties( context, MLT_PRODUCER_PROPERTIES( producer ), track, context->store );
 				serialise_store_properties( context, MLT_PRODUCER_PROPERTIES( producer ), track, "xml_" );
 				if ( !context->no_meta )
@@ -407,16 +664,17 @@ static void serialise_multitrack( serialise_context context, mlt_service service
 
 			hide = mlt_properties_get_int( context->hide_map, id );
 			if ( hide )
-				xmlNewProp( track, _x("hide"), _x( hide == 1 ? "video" : ( hide == 2 ? "audio" : "both" ) ) );
+				element_attribute( context, track, "hide", hide == 1 ? "video" : ( hide == 2 ? "audio" : "both" ) );
+			element_end( context, track );
 		}
 		serialise_service_filters( context, service, node );
 	}
 }
 
-static void serialise_playlist( serialise_context context, mlt_service service, xmlNode *node )
+static void serialise_playlist( serialise_context context, mlt_service service, xml_element node )
 {
 	int i;
-	xmlNode *child = node;
+	xml_element child = node;
 	mlt_playlist_clip_info info;
 	mlt_properties properties = MLT_SERVICE_PROPERTIES( service );
 
@@ -445,12 +703,12 @@ static void serialise_playlist( serialise_context context, mlt_service service,
 			}
 		}
 
-		child = xmlNewChild( node, NULL, _x("playlist"), NULL );
+		child = element_new( context, node, "playlist" );
 
 		// Set the id
-		xmlNewProp( child, _x("id"), _x(id) );
+		element_attribute( context, child, "id", id );
 		if ( mlt_properties_get( properties, "title" ) )
-			xmlNewProp( child, _x("title"), _x(mlt_properties_get( properties, "title" )) );
+			element_attribute( context, child, "title", mlt_properties_get( properties, "title" ) );
 
 		// Store application specific properties
 		serialise_store_properties( context, properties, child, context->store );
@@ -471,25 +729,26 @@ static void serialise_playlist( serialise_context context, mlt_service service,
 				char *service_s = mlt_properties_get( producer_props, "mlt_service" );
 				if ( service_s != NULL && strcmp( service_s, "blank" ) == 0 )
 				{
-					xmlNode *entry = xmlNewChild( child, NULL, _x("blank"), NULL );
+					xml_element entry = element_new( context, child, "blank" );
 					mlt_properties_set_data( producer_props, "_profile", context->profile, 0, NULL, NULL );
 					mlt_properties_set_position( producer_props, TIME_PROPERTY, info.frame_count );
-					xmlNewProp( entry, _x("length"), _x( mlt_properties_get_time( producer_props, TIME_PROPERTY, context->time_format ) ) );
+					element_attribute( context, entry, "length", mlt_properties_get_time( producer_props, TIME_PROPERTY, context->time_format ) );
+					element_end( context, entry );
 				}
 				else
 				{
 					char temp[ 20 ];
-					xmlNode *entry = xmlNewChild( child, NULL, _x("entry"), NULL );
+					xml_element entry = element_new( context, child, "entry" );
 					id = xml_get_id( context, MLT_SERVICE( producer ), xml_existing );
-					xmlNewProp( entry, _x("producer"), _x(id) );
+					element_attribute( context, entry, "producer", id );
 					mlt_properties_set_position( producer_props, TIME_PROPERTY, info.frame_in );
-					xmlNewProp( entry, _x("in"), _x( mlt_properties_get_time( producer_props, TIME_PROPERTY, context->time_format ) ) );
+					element_attribute( context, entry, "in", mlt_properties_get_time( producer_props, TIME_PROPERTY, context->time_format ) );
 					mlt_properties_set_position( producer_props, TIME_PROPERTY, info.frame_out );
-					xmlNewProp( entry, _x("out"), _x( mlt_properties_get_time( producer_props, TIME_PROPERTY, context->time_format ) ) );
+					element_attribute( context, entry, "out", mlt_properties_get_time( producer_props, TIME_PROPERTY, context->time_format ) );
 					if ( info.repeat > 1 )
 					{
 						sprintf( temp, "%d", info.repeat );
-						xmlNewProp( entry, _x("repeat"), _x(temp) );
+						element_attribute( context, entry, "repeat", temp );
 					}
 					if ( mlt_producer_is_cut( info.cut ) )
 					{
@@ -499,22 +758,24 @@ static void serialise_playlist( serialise_context context, mlt_service service,
 							serialise_store_properties( context, MLT_PRODUCER_PROPERTIES( info.cut ), entry, "meta." );
 						serialise_service_filters( context, MLT_PRODUCER_SERVICE( info.cut ), entry );
 					}
+					element_end( context, entry );
 				}
 			}
 		}
 
 		serialise_service_filters( context, service, child );
+		element_end( context, child );
 	}
-	else if ( xmlStrcmp( node->name, _x("tractor") ) != 0 )
+	else if ( strcmp( node->name, "tractor" ) != 0 )
 	{
 		char *id = xml_get_id( context, service, xml_existing );
-		xmlNewProp( node, _x("producer"), _x(id) );
+		element_attribute( context, node, "producer", id );
 	}
 }
 
-static void serialise_tractor( serialise_context context, mlt_service service, xmlNode *node )
+static void serialise_tractor( serialise_context context, mlt_service service, xml_element node )
 {
-	xmlNode *child = node;
+	xml_element child = node;
 	mlt_properties properties = MLT_SERVICE_PROPERTIES( service );
 
 	if ( context->pass == 0 )
@@ -529,16 +790,16 @@ static void serialise_tractor( serialise_context context, mlt_service service, x
 		if ( id == NULL )
 			return;
 
-		child = xmlNewChild( node, NULL, _x("tractor"), NULL );
+		child = element_new( context, node, "tractor" );
 
 		// Set the id
-		xmlNewProp( child, _x("id"), _x(id) );
+		element_attribute( context, child, "id", id );
 		if ( mlt_properties_get( properties, "title" ) )
-			xmlNewProp( child, _x("title"), _x(mlt_properties_get( properties, "title" )) );
+			element_attribute( context, child, "title", mlt_properties_get( properties, "title" ) );
 		if ( mlt_properties_get_position( properties, "in" ) >= 0 )
-			xmlNewProp( child, _x("in"), _x(mlt_properties_get_time( properties, "in", context->time_format )) );
+			element_attribute( context, child, "in", mlt_properties_get_time( properties, "in", context->time_format ) );
 		if ( mlt_properties_get_position( properties, "out" ) >= 0 )
-			xmlNewProp( child, _x("out"), _x(mlt_properties_get_time( properties, "out", context->time_format )) );
+			element_attribute( context, child, "out", mlt_properties_get_time( properties, "out", context->time_format ) );
 
 		// Store application specific properties
 		serialise_store_properties( context, MLT_SERVICE_PROPERTIES( service ), child, context->store );
@@ -549,12 +810,13 @@ static void serialise_tractor( serialise_context context, mlt_service service, x
 		// Recurse on connected producer
 		serialise_service( context, mlt_service_producer( service ), child );
 		serialise_service_filters( context, service, child );
+		element_end( context, child );
 	}
 }
 
-static void serialise_filter( serialise_context context, mlt_service service, xmlNode *node )
+static void serialise_filter( serialise_context context, mlt_service service, xml_element node )
 {
-	xmlNode *child = node;
+	xml_element child = node;
 	mlt_properties properties = MLT_SERVICE_PROPERTIES( service );
 
 	// Recurse on connected producer
@@ -567,25 +829,26 @@ static void serialise_filter( serialise_context context, mlt_service service, xm
 		if ( id == NULL )
 			return;
 
-		child = xmlNewChild( node, NULL, _x("filter"), NULL );
+		child = element_new( context, node, "filter" );
 
 		// Set the id
-		xmlNewProp( child, _x("id"), _x(id) );
+		element_attribute( context, child, "id", id );
 		if ( mlt_properties_get( properties, "title" ) )
-			xmlNewProp( child, _x("title"), _x(mlt_properties_get( properties, "title" )) );
+			element_attribute( context, child, "title", mlt_properties_get( properties, "title" ) );
 		if ( mlt_properties_get_position( properties, "in" ) )
-			xmlNewProp( child, _x("in"), _x( mlt_properties_get_time( properties, "in", context->time_format ) ) );
+			element_attribute( context, child, "in", mlt_properties_get_time( properties, "in", context->time_format ) );
 		if ( mlt_properties_get_position( properties, "out" ) )
-			xmlNewProp( child, _x("out"), _x( mlt_properties_get_time( properties, "out", context->time_format ) ) );
+			element_attribute( context, child, "out", mlt_properties_get_time( properties, "out", context->time_format ) );
 
 		serialise_properties( context, properties, child );
 		serialise_service_filters( context, service, child );
+		element_end( context, child );
 	}
 }
 
-static void serialise_transition( serialise_context context, mlt_service service, xmlNode *node )
+static void serialise_transition( serialise_context context, mlt_service service, xml_element node )
 {
-	xmlNode *child = node;
+	xml_element child = node;
 	mlt_properties properties = MLT_SERVICE_PROPERTIES( service );
 
 	// Recurse on connected producer
@@ -598,25 +861,26 @@ static void serialise_transition( serialise_context context, mlt_service service
 		if ( id == NULL )
 			return;
 
-		child = xmlNewChild( node, NULL, _x("transition"), NULL );
+		child = element_new( context, node, "transition" );
 
 		// Set the id
-		xmlNewProp( child, _x("id"), _x(id) );
+		element_attribute( context, child, "id", id );
 		if ( mlt_properties_get( properties, "title" ) )
-			xmlNewProp( child, _x("title"), _x(mlt_properties_get( properties, "title" )) );
+			element_attribute( context, child, "title", mlt_properties_get( properties, "title" ) );
 		if ( mlt_properties_get_position( properties, "in" ) )
-			xmlNewProp( child, _x("in"), _x( mlt_properties_get_time( properties, "in", context->time_format ) ) );
+			element_attribute( context, child, "in", mlt_properties_get_time( properties, "in", context->time_format ) );
 		if ( mlt_properties_get_position( properties, "out" ) )
-			xmlNewProp( child, _x("out"), _x( mlt_properties_get_time( properties, "out", context->time_format ) ) );
+			element_attribute( context, child, "out", mlt_properties_get_time( properties, "out", context->time_format ) );
 
 		serialise_properties( context, properties, child );
 		serialise_service_filters( context, service, child );
+		element_end( context, child );
 	}
 }
 
-static void serialise_link( serialise_context context, mlt_service service, xmlNode *node )
+static void serialise_link( serialise_context context, mlt_service service, xml_element node )
 {
-	xmlNode *child = node;
+	xml_element child = node;
 	mlt_properties properties = MLT_SERVICE_PROPERTIES( service );
 
 	if ( context->pass == 0 )
@@ -626,26 +890,27 @@ static void serialise_link( serialise_context context, mlt_service service, xmlN
 		if ( id == NULL )
 			return;
 
-		child = xmlNewChild( node, NULL, _x("link"), NULL );
+		child = element_new( context, node, "link" );
 
 		// Set the id
-		xmlNewProp( child, _x("id"), _x(id) );
+		element_attribute( context, child, "id", id );
 		if ( mlt_properties_get( properties, "title" ) )
-			xmlNewProp( child, _x("title"), _x(mlt_properties_get( properties, "title" )) );
+			element_attribute( context, child, "title", mlt_properties_get( properties, "title" ) );
 		if ( mlt_properties_get_position( properties, "in" ) )
-			xmlNewProp( child, _x("in"), _x( mlt_properties_get_time( properties, "in", context->time_format ) ) );
+			element_attribute( context, child, "in", mlt_properties_get_time( properties, "in", context->time_format ) );
 		if ( mlt_properties_get_position( properties, "out" ) )
-			xmlNewProp( child, _x("out"), _x( mlt_properties_get_time( properties, "out", context->time_format ) ) );
+			element_attribute( context, child, "out", mlt_properties_get_time( properties, "out", context->time_format ) );
 
 		serialise_properties( context, properties, child );
 		serialise_service_filters( context, service, child );
+		element_end( context, child );
 	}
 }
 
-static void serialise_chain( serialise_context context, mlt_service service, xmlNode *node )
+static void serialise_chain( serialise_context context, mlt_service service, xml_element node )
 {
 	int i = 0;
-	xmlNode *child = node;
+	xml_element child = node;
 	mlt_properties properties = MLT_SERVICE_PROPERTIES( service );
 
 	if ( context->pass == 0 )
@@ -655,16 +920,16 @@ static void serialise_chain( serialise_context context, mlt_service service, xml
 		if ( id == NULL )
 			return;
 
-		child = xmlNewChild( node, NULL, _x("chain"), NULL );
+		child = element_new( context, node, "chain" );
 
 		// Set the id
-		xmlNewProp( child, _x("id"), _x(id) );
+		element_attribute( context, child, "id", id );
 		if ( mlt_properties_get( properties, "title" ) )
-			xmlNewProp( child, _x("title"), _x(mlt_properties_get( properties, "title" )) );
+			element_attribute( context, child, "title", mlt_properties_get( properties, "title" ) );
 		if ( mlt_properties_get_position( properties, "in" ) )
-			xmlNewProp( child, _x("in"), _x( mlt_properties_get_time( properties, "in", context->time_format ) ) );
+			element_attribute( context, child, "in", mlt_properties_get_time( properties, "in", context->time_format ) );
 		if ( mlt_properties_get_position( properties, "out" ) )
-			xmlNewProp( child, _x("out"), _x( mlt_properties_get_time( properties, "out", context->time_format ) ) );
+			element_attribute( context, child, "out", mlt_properties_get_time( properties, "out", context->time_format ) );
 
 		serialise_properties( context, properties, child );
 
@@ -679,10 +944,11 @@ static void serialise_chain( serialise_context context, mlt_service service, xml
 		}
 
 		serialise_service_filters( context, service, child );
+		element_end( context, child );
 	}
 }
 
-static void serialise_service( serialise_context context, mlt_service service, xmlNode *node )
+static void serialise_service( serialise_context context, mlt_service service, xml_element node )
 {
 	// Iterate over consumer/producer connections
 	while ( service != NULL )
@@ -784,7 +1050,7 @@ static void serialise_service( serialise_context context, mlt_service service, x
 	}
 }
 
-static void serialise_other( mlt_properties properties, struct serialise_context_s *context, xmlNodePtr root )
+static void serialise_other( mlt_properties properties, struct serialise_context_s *context, xml_element root )
 {
 	int i;
 	for ( i = 0; i < mlt_properties_count( properties ); i++ )
@@ -802,20 +1068,15 @@ static void serialise_other( mlt_properties properties, struct serialise_context
 	}
 }
 
-xmlDocPtr xml_make_doc( mlt_consumer consumer, mlt_service service )
+static void serialise_document( serialise_context context, mlt_consumer consumer, mlt_service service, xml_element root )
 {
 	mlt_properties properties = MLT_SERVICE_PROPERTIES( service );
-	xmlDocPtr doc = xmlNewDoc( _x("1.0") );
-	xmlNodePtr root = xmlNewNode( NULL, _x("mlt") );
-	struct serialise_context_s *context = calloc( 1, sizeof( struct serialise_context_s ) );
 	mlt_profile profile = mlt_service_profile( MLT_CONSUMER_SERVICE( consumer ) );
 	char tmpstr[ 32 ];
 
-	xmlDocSetRootElement( doc, root );
-
 	// Indicate the numeric locale
 	if ( mlt_properties_get_lcnumeric( properties ) )
-		xmlNewProp( root, _x("LC_NUMERIC"), _x( mlt_properties_get_lcnumeric( properties ) ) );
+		element_attribute( context, root, "LC_NUMERIC", mlt_properties_get_lcnumeric( properties ) );
 	else
 #ifdef _WIN32
 	{
@@ -824,20 +1085,20 @@ xmlDocPtr xml_make_doc( mlt_consumer consumer, mlt_service service )
 		free( lcnumeric );
 		mlt_properties_to_utf8( properties, "_xml_lcnumeric_in", "_xml_lcnumeric_out" );
 		lcnumeric = mlt_properties_get( properties, "_xml_lcnumeric_out" );
-		xmlNewProp( root, _x("LC_NUMERIC"), _x( lcnumeric ) );
+		element_attribute( context, root, "LC_NUMERIC", lcnumeric );
 	}
 #else
-		xmlNewProp( root, _x("LC_NUMERIC"), _x( setlocale( LC_NUMERIC, NULL ) ) );
+		element_attribute( context, root, "LC_NUMERIC", setlocale( LC_NUMERIC, NULL ) );
 #endif
 
 	// Indicate the version
-	xmlNewProp( root, _x("version"), _x( mlt_version_get_string() ) );
+	element_attribute( context, root, "version", mlt_version_get_string() );
 
 	// If we have root, then deal with it now
 	if ( mlt_properties_get( properties, "root" ) != NULL )
 	{
 		if ( !mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( consumer ), "no_root" ) )
-			xmlNewProp( root, _x("root"), _x(mlt_properties_get( properties, "root" )) );
+			element_attribute( context, root, "root", mlt_properties_get( properties, "root" ) );
 		context->root = strdup( mlt_properties_get( properties, "root" ) );
 	}
 	else
@@ -859,36 +1120,37 @@ xmlDocPtr xml_make_doc( mlt_consumer consumer, mlt_service service )
 
 	// Assign a title property
 	if ( mlt_properties_get( properties, "title" ) != NULL )
-		xmlNewProp( root, _x("title"), _x(mlt_properties_get( properties, "title" )) );
+		element_attribute( context, root, "title", mlt_properties_get( properties, "title" ) );
 
 	// Add a profile child element
 	if ( profile )
 	{
 		if ( !mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( consumer ), "no_profile" ) )
 		{
-			xmlNodePtr profile_node = xmlNewChild( root, NULL, _x("profile"), NULL );
+			xml_element profile_node = element_new( context, root, "profile" );
 			if ( profile->description )
-				xmlNewProp( profile_node, _x("description"), _x(profile->description) );
+				element_attribute( context, profile_node, "description", profile->description );
 			sprintf( tmpstr, "%d", profile->width );
-			xmlNewProp( profile_node, _x("width"), _x(tmpstr) );
+			element_attribute( context, profile_node, "width", tmpstr );
 			sprintf( tmpstr, "%d", profile->height );
-			xmlNewProp( profile_node, _x("height"), _x(tmpstr) );
+			element_attribute( context, profile_node, "height", tmpstr );
 			sprintf( tmpstr, "%d", profile->progressive );
-			xmlNewProp( profile_node, _x("progressive"), _x(tmpstr) );
+			element_attribute( context, profile_node, "progressive", tmpstr );
 			sprintf( tmpstr, "%d", profile->sample_aspect_num );
-			xmlNewProp( profile_node, _x("sample_aspect_num"), _x(tmpstr) );
+			element_attribute( context, profile_node, "sample_aspect_num", tmpstr );
 			sprintf( tmpstr, "%d", profile->sample_aspect_den );
-			xmlNewProp( profile_node, _x("sample_aspect_den"), _x(tmpstr) );
+			element_attribute( context, profile_node, "sample_aspect_den", tmpstr );
 			sprintf( tmpstr, "%d", profile->display_aspect_num );
-			xmlNewProp( profile_node, _x("display_aspect_num"), _x(tmpstr) );
+			element_attribute( context, profile_node, "display_aspect_num", tmpstr );
 			sprintf( tmpstr, "%d", profile->display_aspect_den );
-			xmlNewProp( profile_node, _x("display_aspect_den"), _x(tmpstr) );
+			element_attribute( context, profile_node, "display_aspect_den", tmpstr );
 			sprintf( tmpstr, "%d", profile->frame_rate_num );
-			xmlNewProp( profile_node, _x("frame_rate_num"), _x(tmpstr) );
+			element_attribute( context, profile_node, "frame_rate_num", tmpstr );
 			sprintf( tmpstr, "%d", profile->frame_rate_den );
-			xmlNewProp( profile_node, _x("frame_rate_den"), _x(tmpstr) );
+			element_attribute( context, profile_node, "frame_rate_den", tmpstr );
 			sprintf( tmpstr, "%d", profile->colorspace );
-			xmlNewProp( profile_node, _x("colorspace"), _x(tmpstr) );
+			element_attribute( context, profile_node, "colorspace", tmpstr );
+			element_end( context, profile_node );
 		}
 		context->profile = profile;
 	}
@@ -911,26 +1173,87 @@ xmlDocPtr xml_make_doc( mlt_consumer consumer, mlt_service service )
 	context->pass++;
 	serialise_other( MLT_SERVICE_PROPERTIES( service ), context, root );
 	serialise_service( context, service, root );
+	element_end( context, root );
 
 	// Cleanup resource
 	mlt_properties_close( context->id_map );
 	mlt_properties_close( context->hide_map );
 	free( context->root );
+}
+
+xmlDocPtr xml_make_doc( mlt_consumer consumer, mlt_service service )
+{
+	xmlDocPtr doc = xmlNewDoc( _x("1.0") );
+	struct serialise_context_s *context = calloc( 1, sizeof( struct serialise_context_s ) );
+	xml_element root = element_root( context, xmlNewNode( NULL, _x("mlt") ) );
+
+	xmlDocSetRootElement( doc, root->node );
+	serialise_document( context, consumer, service, root );
 	free( context );
 
 	return doc;
 }
 
+/** Serialise the service network straight to text, without building a tree.
+ *
+ * \param format true to put every element on a line of its own with indentation
+ * \param ascii true to write characters outside of ASCII as character references
+ * \return the text, which the caller must free
+ */
+
+static char *xml_make_text( mlt_consumer consumer, mlt_service service, int format, int ascii )
+{
+	struct serialise_context_s *context = calloc( 1, sizeof( struct serialise_context_s ) );
+	xml_element root;
+
+	context->format = format;
+	context->ascii = ascii;
+	buffer_append( &context->text, ascii ? "<?xml version=\"1.0\"?>\n" : "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n", -1 );
+	root = element_root( context, NULL );
+	serialise_document( context, consumer, service, root );
+	if ( !format )
+		buffer_append( &context->text, "\n", 1 );
+
+	char *text = context->text.data;
+	free( context );
+	return text;
+}
+
+/** Write the text of a document to a file.
+ */
+
+static int write_text( const char *filename, const char *text )
+{
+	FILE *file = mlt_fopen( filename, "wb" );
+	int error = file == NULL;
+
+	if ( file )
+	{
+		size_t length = strlen( text );
+		error = fwrite( text, 1, length, file ) != length;
+		error = fclose( file ) || error;
+	}
+	if ( error )
+		mlt_log_error( NULL, "[consumer_xml] failed to write %s\n", filename );
+	return error;
+}
+
+
+/** Serialise the connected service network to the resource.
+ *
+ * \param background true to leave writing a file to the caller
+ * \return the text to write to the file when \p background is true, otherwise NULL
+ */
 
-static void output_xml( mlt_consumer consumer )
+static char *output_xml( mlt_consumer consumer, int background )
 {
 	// Get the producer service
 	mlt_service service = mlt_service_producer( MLT_CONSUMER_SERVICE( consumer ) );
 	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
 	char *resource =  mlt_properties_get( properties, "resource" );
-	xmlDocPtr doc = NULL;
+	char *text = NULL;
 
-	if ( !service ) return;
+	if ( !service ) return NULL;
 
 	// Set the title if provided
 	if ( mlt_properties_get( properties, "title" ) )
@@ -949,34 +1272,28 @@ static void output_xml( mlt_consumer consumer )
 		free( cwd );
 	}
 
-	// Make the document
-	doc = xml_make_doc( consumer, service );
-
 	// Handle the output
 	if ( resource == NULL || !strcmp( resource, "" ) )
 	{
-		xmlDocFormatDump( stdout, doc, 1 );
+		text = xml_make_text( consumer, service, 1, 1 );
+		fputs( text, stdout );
 	}
 	else if ( strchr( resource, '.' ) == NULL )
 	{
-		xmlChar *buffer = NULL;
-		int length = 0;
-		xmlDocDumpMemoryEnc( doc, &buffer, &length, "utf-8" );
-		mlt_properties_set( properties, resource, _s(buffer) );
-#ifdef _WIN32
-		xmlFreeFunc xmlFree = NULL;
-		xmlMemGet( &xmlFree, NULL, NULL, NULL);
-#endif
-		xmlFree( buffer );
+		text = xml_make_text( consumer, service, 0, 0 );
+		mlt_properties_set( properties, resource, text );
 	}
 	else
 	{
-		xmlSaveFormatFileEnc( resource, doc, "utf-8", 1 );
+		text = xml_make_text( consumer, service, 1, 0 );
+		if ( background )
+			return text;
+		write_text( resource, text );
 	}
-
-	// Close the document
-	xmlFreeDoc( doc );
+	free( text );
+	return NULL;
 }
+
 static int consumer_start( mlt_consumer consumer )
 {
 	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
@@ -1002,9 +1319,32 @@ static int consumer_start( mlt_consumer consumer )
 	}
 	else
 	{
-		output_xml( consumer );
-		mlt_consumer_stop( consumer );
-		mlt_consumer_stopped( consumer );
+		char *text = NULL;
+
+		// The text is a snapshot of the service network, so only writing it is left for later
+		if ( mlt_properties_get_int( properties, "background" ) )
+		{
+			consumer_stop( consumer );
+			text = output_xml( consumer, 1 );
+		}
+		else
+		{
+			output_xml( consumer, 0 );
+		}
+		if ( text )
+		{
+			pthread_t *thread = calloc( 1, sizeof( pthread_t ) );
+			mlt_properties_set_data( properties, "thread", thread, sizeof( pthread_t ), free, NULL );
+			mlt_properties_set_data( properties, "_xml_text", text, 0, free, NULL );
+			mlt_properties_set_int( properties, "running", 1 );
+			mlt_properties_set_int( properties, "joined", 0 );
+			pthread_create( thread, NULL, writer_thread, consumer );
+		}
+		else
+		{
+			mlt_consumer_stop( consumer );
+			mlt_consumer_stopped( consumer );
+		}
 	}
 	return 0;
 }
@@ -1088,7 +1428,22 @@ static void *consumer_thread( void *arg )
 			mlt_frame_close( frame );
 		}
 	}
-	output_xml( consumer );
+	output_xml( consumer, 0 );
+
+	// Indicate that the consumer is stopped
+	mlt_properties_set_int( properties, "running", 0 );
+	mlt_consumer_stopped( consumer );
+
+	return NULL;
+}
+
+static void *writer_thread( void *arg )
+{
+	mlt_consumer consumer = arg;
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+
+	write_text( mlt_properties_get( properties, "resource" ), mlt_properties_get_data( properties, "_xml_text", NULL ) );
+	mlt_properties_set_data( properties, "_xml_text", NULL, 0, NULL, NULL );
 
 	// Indicate that the consumer is stopped
 	mlt_properties_set_int( properties, "running", 0 );
@@ -494,8 +494,10 @@ static void process_filter_properties(mlt_filter filter, mlt_frame frame)
 
 /** Processes data and tries to replace the GPS keywords with actual values.
  *  Puts "--" in place of keywords with no valid return.
+ *  The gps point of the frame is looked up once and kept in i_gps and video_time_synced
+ *  for the other keywords of the same frame (i_gps is -2 until then).
 */
-static void get_gps_str(char* keyword, mlt_filter filter, mlt_frame frame, char* text )
+static void get_gps_str(char* keyword, mlt_filter filter, mlt_frame frame, char* text, int* i_gps, int64_t* video_time_synced )
 {
 	private_data* pdata = (private_data*)filter->child;
 	char gps_text[256];
@@ -507,22 +509,21 @@ static void get_gps_str(char* keyword, mlt_filter filter, mlt_frame frame, char*
 		return;
 	}
 
-	//process filter properties: read, apply changes where needed, write to properties
-	process_filter_properties(filter, frame);
+	if (*i_gps == -2) {
+		//process filter properties: read, apply changes where needed, write to properties
+		process_filter_properties(filter, frame);
 
-	//add offset to video time:
-	int64_t video_time_synced = get_current_frame_time_ms(filter, frame) + pdata->gps_offset;
-	//printf("frame_time=%I64d, gps_offset=%I64d, vid sync= %I64d\n", get_current_frame_time_ms(filter, frame), pdata->gps_offset, video_time_synced);
+		//add offset to video time:
+		*video_time_synced = get_current_frame_time_ms(filter, frame) + pdata->gps_offset;
 
-	//find gps entry closest to our time
-	int i_gps = -1;
-	if ((i_gps = binary_search_gps(filter_to_gps_data(filter), video_time_synced, 0)) == -1) {
-		//mlt_log_info(NULL, "get_gps_str, vid_time: %d s, i_gps=%d\n", video_time_synced/1000, i_gps);
+		//find gps entry closest to our time
+		*i_gps = binary_search_gps(filter_to_gps_data(filter), *video_time_synced, 0);
+	}
+	if (*i_gps == -1) {
 		strncat( text, gps_text, MAX_TEXT_LEN - strlen( text ) - 1);
 		return;
 	}
-//	mlt_log_info(NULL, "get_gps_str, vid_time: %d s, i_gps=%d, time[i]=%d s\n", video_time_synced/1000, i_gps, pdata->gps_points_r[i_gps].time/1000);
-	gps_point_to_output(filter, i_gps, video_time_synced, keyword, gps_text);
+	gps_point_to_output(filter, *i_gps, *video_time_synced, keyword, gps_text);
 	strncat( text, gps_text, MAX_TEXT_LEN - strlen( text ) - 1);
 }
 
@@ -566,6 +567,8 @@ static void substitute_keywords(mlt_filter filter, char* result, char* value, ml
 		char keyword[MAX_TEXT_LEN] = "";
 		int pos = 0;
 		int is_keyword = 0;
+		int i_gps = -2;
+		int64_t video_time_synced = 0;
 
 		while ( get_next_token(value, &pos, keyword, &is_keyword) )
 		{
@@ -575,59 +578,59 @@ static void substitute_keywords(mlt_filter filter, char* result, char* value, ml
 			}
 			else if ( !strncmp( keyword, "gps_lat", strlen("gps_lat") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_lon", strlen("gps_lon") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_elev", strlen("gps_elev") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_vdist_up", strlen("gps_vdist_up") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_vdist_down", strlen("gps_vdist_down") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_dist_uphill", strlen("gps_dist_uphill") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_dist_downhill", strlen("gps_dist_downhill") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_dist_flat", strlen("gps_dist_flat") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_speed", strlen("gps_speed") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_dist", strlen("gps_dist") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_hr", strlen("gps_hr") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_bearing", strlen("gps_bearing") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_compass", strlen("gps_compass") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "gps_datetime_now", strlen("gps_datetime_now") ) )
 			{
-				get_gps_str( keyword, filter, frame, result );
+				get_gps_str( keyword, filter, frame, result, &i_gps, &video_time_synced );
 			}
 			else if ( !strncmp( keyword, "file_datetime_now", strlen("file_datetime_now") ) )
 			{
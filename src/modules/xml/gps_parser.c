@@ -176,7 +176,7 @@ void get_last_gps_time(gps_private_data gdata)
 
 //checks if time value val is between gps_points[i] and gps_points[i+1] with size checks
 static int time_val_between_indices(int64_t val, gps_point_raw* gp, int i, int size, char force_result) {
-	if (i<0 || i>size)
+	if (i<0 || i>=size)
 		return 0;
 	else if (val == gp[i].time)
 		return 1;
@@ -192,7 +192,7 @@ static int time_val_between_indices(int64_t val, gps_point_raw* gp, int i, int s
 
 /** Returns the [index of] nearest gps point in time, but not farther than MAX_GPS_DIFF (10 seconds)
  * or -1 if search fails
- * Seaches in raw values directly
+ * Seaches in raw values directly, which are sorted by time when the file is parsed
  * If force_result is nonzero, it will ignore MAX_GPS_DIFF restriction
 */
 int binary_search_gps(gps_private_data gdata, int64_t video_time, char force_result)
@@ -202,22 +202,20 @@ int binary_search_gps(gps_private_data gdata, int64_t video_time, char force_res
 	int last_index = *gdata.last_searched_index;
 
 	int il = 0;
-	int ir = gps_points_size-1;
-	int mid = 0;
+	int ir = gps_points_size;
+	int i = 0;
 
 	if (!gps_points || gps_points_size==0)
 		return -1;
 
 	//optimize repeated calls (exact match or in between points)
 	if (time_val_between_indices(video_time, gps_points, last_index, gps_points_size, force_result)) {
-//		printf("_binary_search_gps, last_index(%d) v1 video_time: %I64d match: %I64d\n", last_index, video_time, gps_points[last_index].time);
 		return last_index;
 	}
 
 	//optimize consecutive playback calls
 	last_index++;
 	if (time_val_between_indices(video_time, gps_points, last_index, gps_points_size, force_result)) {
-//		printf("_binary_search_gps, last_index(%d) v2 video_time: %I64d match: %I64d\n", last_index, video_time, gps_points[last_index].time);
 		*gdata.last_searched_index = last_index;
 		return last_index;
 	}
@@ -226,26 +224,32 @@ int binary_search_gps(gps_private_data gdata, int64_t video_time, char force_res
 	if (video_time < *gdata.first_gps_time - MAX_GPS_DIFF_MS || video_time > *gdata.last_gps_time + MAX_GPS_DIFF_MS)
 		return -1;
 
-	//binary search
+	//binary search for the first point after video_time
 	while (il < ir)
 	{
-		mid = (ir+il)/2;
-		//mlt_log_info(gdata.filter, "binary_search_gps: mid=%d, l=%d, r=%d, mid-time=%d (s)", mid, il, ir, gps_points[mid].time/1000);
-		if (time_val_between_indices(video_time, gps_points, mid, gps_points_size, force_result)) {
-			*gdata.last_searched_index = mid;
-			break;
-		}
-		else if (gps_points[mid].time > video_time)
-			ir = mid-1;
-		else //if (gps_points[mid].time < video_time)
+		int mid = il + (ir-il)/2;
+		if (gps_points[mid].time > video_time)
+			ir = mid;
+		else
 			il = mid+1;
 	}
 
+	//the point at or before video_time, or the first point if there is none
+	i = MAX(il-1, 0);
+	if (time_val_between_indices(video_time, gps_points, i, gps_points_size, force_result)) {
+		*gdata.last_searched_index = i;
+		return i;
+	}
+
+	//otherwise take the closer of the 2 neighbours
+	if (i+1 < gps_points_size && llabs(gps_points[i+1].time - video_time) < llabs(video_time - gps_points[i].time))
+		i++;
+
 	//don't return the closest gps point if time difference is too large (unless force_result is 1)
-	if (llabs(video_time - gps_points[mid].time) > MAX_GPS_DIFF_MS)
-		return (force_result ? mid : -1);
-	else 
-		return mid;
+	if (llabs(video_time - gps_points[i].time) > MAX_GPS_DIFF_MS && !force_result)
+		return -1;
+	*gdata.last_searched_index = i;
+	return i;
 }
 
 /* Converts the bearing angle (0-360) to a cardinal direction
@@ -90,6 +90,7 @@ struct deserialise_context_s
 	int consumer_count;
 	int seekable;
 	mlt_consumer qglsl;
+	int lazy;
 };
 typedef struct deserialise_context_s *deserialise_context;
 
@@ -765,6 +766,197 @@ static void on_end_link( deserialise_context context, const xmlChar *name )
 	}
 }
 
+/** Open a producer as the XML describes it.
+ *
+ * When the service is missing or fails to open the resource, this tries the
+ * resource on its own and then stands in an INVALID text or a red colour, so
+ * the document still loads and saves without losing the clip.
+ */
+
+static mlt_producer open_producer( mlt_profile profile, mlt_properties properties, const char *service_name, const char *resource )
+{
+	mlt_producer producer = NULL;
+
+	if ( service_name )
+	{
+		if ( resource )
+		{
+			// If a document was saved as +INVALID.txt (see below), then ignore the mlt_service and
+			// try to load it just from the resource. This is an attempt to recover the failed
+			// producer in case, for example, a file returns.
+			if (!strcmp("qtext", service_name)) {
+				const char *text = mlt_properties_get( properties, "text" );
+				if (text && !strcmp("INVALID", text)) {
+					service_name = NULL;
+				}
+			} else if (!strcmp("pango", service_name)) {
+				const char *markup = mlt_properties_get( properties, "markup" );
+				if (markup && !strcmp("INVALID", markup)) {
+					service_name = NULL;
+				}
+			}
+			if (service_name) {
+				char *temp = calloc( 1, strlen( service_name ) + strlen( resource ) + 2 );
+				strcat( temp, service_name );
+				strcat( temp, ":" );
+				strcat( temp, resource );
+				producer = mlt_factory_producer( profile, NULL, temp );
+				free( temp );
+			}
+		}
+		else
+		{
+			producer = mlt_factory_producer( profile, NULL, service_name );
+		}
+	}
+
+	// Just in case the plugin requested doesn't exist...
+	if ( !producer && resource )
+		producer = mlt_factory_producer( profile, NULL, resource );
+	if ( !producer ) {
+		mlt_log_error( NULL, "[producer_xml] failed to load producer \"%s\"\n", resource );
+		producer = mlt_factory_producer( profile, NULL, "+INVALID.txt" );
+		if (producer) {
+			// Save the original mlt_service for the consumer to serialize it as original.
+			mlt_properties_set_string( MLT_PRODUCER_PROPERTIES( producer ), "_xml_mlt_service",
+				mlt_properties_get( properties, "mlt_service" ) );
+		}
+	}
+	if ( !producer )
+		producer = mlt_factory_producer( profile, NULL, "colour:red" );
+	return producer;
+}
+
+/** A stand-in for a producer of the XML that opens it when it is first used.
+ *
+ * In lazy mode, a producer whose length is in the XML is loaded as one of
+ * these with the properties of the XML, including its mlt_service, so that
+ * a project can be loaded, edited and saved again without opening its media.
+ * The real producer gets the properties that the XML gave it. With preload,
+ * every producer is also opened in the background on the normal thread pool
+ * while the document is still being read.
+ */
+
+typedef struct
+{
+	struct mlt_producer_s parent;
+	mlt_producer producer;      // the real producer, once it is open
+	mlt_properties xml;         // the properties to open it with
+	char *service_name;
+	mlt_slices_task task;       // the background open, or NULL
+	int opened;
+} *lazy_producer;
+
+static int lazy_open( void *cookie )
+{
+	lazy_producer self = cookie;
+
+	if ( !self->opened )
+	{
+		mlt_properties xml = self->xml;
+		const char *resource = mlt_properties_get( xml, "resource" );
+
+		if ( !resource )
+			resource = mlt_properties_get( xml, "src" );
+		self->producer = open_producer( mlt_service_profile( MLT_PRODUCER_SERVICE( &self->parent ) ),
+			xml, self->service_name, resource );
+		if ( self->producer )
+		{
+			mlt_properties_set_lcnumeric( MLT_PRODUCER_PROPERTIES( self->producer ), mlt_properties_get_lcnumeric( xml ) );
+			mlt_properties_inherit( MLT_PRODUCER_PROPERTIES( self->producer ), xml );
+		}
+		self->opened = 1;
+	}
+	return self->producer == NULL;
+}
+
+static void lazy_wait( lazy_producer self )
+{
+	if ( self->task )
+	{
+		mlt_slices_task_wait( self->task );
+		mlt_slices_task_close( self->task );
+		self->task = NULL;
+	}
+}
+
+static int lazy_get_frame( mlt_producer parent, mlt_frame_ptr frame, int index )
+{
+	lazy_producer self = parent->child;
+	int error = 0;
+
+	// mlt_service_get_frame() holds the service lock here
+	lazy_wait( self );
+	lazy_open( self );
+	if ( self->producer )
+	{
+		mlt_producer_seek( self->producer, mlt_producer_frame( parent ) );
+		mlt_producer_set_speed( self->producer, mlt_producer_get_speed( parent ) );
+		error = mlt_service_get_frame( MLT_PRODUCER_SERVICE( self->producer ), frame, index );
+	}
+	else
+	{
+		*frame = mlt_frame_init( MLT_PRODUCER_SERVICE( parent ) );
+	}
+	if ( *frame )
+		mlt_frame_set_position( *frame, mlt_producer_position( parent ) );
+	mlt_producer_prepare_next( parent );
+	return error;
+}
+
+static void lazy_close( mlt_producer parent )
+{
+	lazy_producer self = parent->child;
+
+	lazy_wait( self );
+	mlt_producer_close( self->producer );
+	mlt_properties_close( self->xml );
+	free( self->service_name );
+	parent->close = NULL;
+	mlt_producer_close( parent );
+	free( self );
+}
+
+static mlt_producer lazy_init( mlt_profile profile )
+{
+	lazy_producer self = calloc( 1, sizeof( *self ) );
+
+	if ( self && !mlt_producer_init( &self->parent, self ) )
+	{
+		mlt_producer parent = &self->parent;
+		mlt_properties properties = MLT_PRODUCER_PROPERTIES( parent );
+
+		mlt_properties_set_data( properties, "_profile", profile, 0, NULL, NULL );
+		mlt_properties_set_double( properties, "aspect_ratio", mlt_profile_sar( profile ) );
+		parent->get_frame = lazy_get_frame;
+		parent->close = ( mlt_destructor )lazy_close;
+		return parent;
+	}
+	free( self );
+	return NULL;
+}
+
+/** Finish a stand-in once it has the properties of the XML.
+ */
+
+static void lazy_prepare( mlt_producer parent, mlt_properties properties, const char *service_name, int preload )
+{
+	lazy_producer self = parent->child;
+	mlt_properties parent_properties = MLT_PRODUCER_PROPERTIES( parent );
+
+	self->xml = mlt_properties_new();
+	mlt_properties_set_lcnumeric( self->xml, mlt_properties_get_lcnumeric( parent_properties ) );
+	mlt_properties_inherit( self->xml, properties );
+	self->service_name = strdup( service_name );
+
+	// Clone and serialise as the producer it stands in for
+	mlt_properties_set_string( parent_properties, "mlt_service", service_name );
+	mlt_properties_set_position( parent_properties, "out", mlt_producer_get_length( parent ) - 1 );
+
+	if ( preload )
+		self->task = mlt_slices_task_submit( lazy_open, self );
+}
+
 static void on_start_producer( deserialise_context context, const xmlChar *name, const xmlChar **atts)
 {
 	// use a dummy service to hold properties to allow arbitrary nesting
@@ -788,6 +980,8 @@ static void on_end_producer( deserialise_context context, const xmlChar *name )
 	if ( service != NULL && type == mlt_dummy_producer_type )
 	{
 		mlt_service producer = NULL;
+		char *service_name = NULL;
+		int lazy = 0;
 
 		qualify_property( context, properties, "resource" );
 		char *resource = mlt_properties_get( properties, "resource" );
@@ -799,57 +993,17 @@ static void on_end_producer( deserialise_context context, const xmlChar *name )
 			resource = mlt_properties_get( properties, "src" );
 		}
 
-		// Instantiate the producer
+		// Instantiate the producer, or a placeholder for it
 		if ( mlt_properties_get( properties, "mlt_service" ) != NULL )
-		{
-			char *service_name = trim( mlt_properties_get( properties, "mlt_service" ) );
-			if ( resource )
-			{
-				// If a document was saved as +INVALID.txt (see below), then ignore the mlt_service and
-				// try to load it just from the resource. This is an attempt to recover the failed
-				// producer in case, for example, a file returns.
-				if (!strcmp("qtext", service_name)) {
-					const char *text = mlt_properties_get( properties, "text" );
-					if (text && !strcmp("INVALID", text)) {
-						service_name = NULL;
-					}
-				} else if (!strcmp("pango", service_name)) {
-					const char *markup = mlt_properties_get( properties, "markup" );
-					if (markup && !strcmp("INVALID", markup)) {
-						service_name = NULL;
-					}
-				}
-				if (service_name) {
-					char *temp = calloc( 1, strlen( service_name ) + strlen( resource ) + 2 );
-					strcat( temp, service_name );
-					strcat( temp, ":" );
-					strcat( temp, resource );
-					producer = MLT_SERVICE( mlt_factory_producer( context->profile, NULL, temp ) );
-					free( temp );
-				}
-			}
-			else
-			{
-				producer = MLT_SERVICE( mlt_factory_producer( context->profile, NULL, service_name ) );
-			}
-		}
-
-		// Just in case the plugin requested doesn't exist...
-		if ( !producer && resource )
-			producer = MLT_SERVICE( mlt_factory_producer( context->profile, NULL, resource ) );
-		if ( !producer ) {
-			mlt_log_error( NULL, "[producer_xml] failed to load producer \"%s\"\n", resource );
-			producer = MLT_SERVICE( mlt_factory_producer( context->profile, NULL, "+INVALID.txt" ) );
-			if (producer) {
-				// Save the original mlt_service for the consumer to serialize it as original.
-				mlt_properties_set_string( MLT_SERVICE_PROPERTIES(producer), "_xml_mlt_service",
-					mlt_properties_get( properties, "mlt_service" ) );
-			}
-		}
-		if ( !producer )
-			producer = MLT_SERVICE( mlt_factory_producer( context->profile, NULL, "colour:red" ) );
+			service_name = strdup( trim( mlt_properties_get( properties, "mlt_service" ) ) );
+		lazy = context->lazy && service_name && mlt_properties_get( properties, "length" );
+		if ( lazy )
+			producer = MLT_PRODUCER_SERVICE( lazy_init( context->profile ) );
+		else
+			producer = MLT_SERVICE( open_producer( context->profile, properties, service_name, resource ) );
 		if ( !producer )
 		{
+			free( service_name );
 			mlt_service_close( service );
 			free( service );
 			return;
@@ -895,6 +1049,9 @@ static void on_end_producer( deserialise_context context, const xmlChar *name )
 
 		// Inherit the properties
 		mlt_properties_inherit( MLT_SERVICE_PROPERTIES( producer ), properties );
+		if ( lazy )
+			lazy_prepare( MLT_PRODUCER( producer ), properties, service_name, context->lazy > 1 );
+		free( service_name );
 
 		// Attach all filters from service onto producer
 		attach_filters( producer, service );
@@ -2045,6 +2202,13 @@ mlt_producer producer_xml_init( mlt_profile profile, mlt_service_type servtype,
 		}
 	}
 
+	// Defer opening the producers with lazy=1, and open them in the background with lazy=preload
+	const char *lazy = mlt_properties_get( context->params, "lazy" );
+	if ( !lazy )
+		lazy = getenv( "MLT_XML_LAZY" );
+	if ( lazy )
+		context->lazy = !strcmp( lazy, "preload" ) ? 2 : atoi( lazy ) != 0;
+
 	// We need to track the number of registered filters
 	mlt_properties_set_int( context->destructors, "registered", 0 );
 
@@ -74,6 +74,31 @@ namespace Mlt {
 %feature("shadow") Frame::get_image(mlt_image_format&, int&, int&) %{
     def get_image(*args): return _mlt.frame_get_image(*args)
 %}
+%extend Frame {
+%pythoncode %{
+    def get_image_buffer(self, *args):
+        """Get the image as a memoryview that refers to the frame without a copy.
+
+        Packed formats are shaped (height, width, components). Planar formats
+        are one row of bytes; use get_image_planes() for their planes.
+        """
+        return _mlt.frame_get_image_buffer(self, *args)
+
+    def get_image_planes(self, *args):
+        """Get a tuple of memoryviews shaped (height, width[, components]),
+        one for each plane of the image, that refer to the frame without a copy.
+        """
+        return _mlt.frame_get_image_planes(self, *args)
+
+    def get_audio_buffer(self, *args):
+        """Get the audio as a memoryview that refers to the frame without a copy.
+
+        Interleaved formats are shaped (samples, channels) and planar
+        formats (channels, samples).
+        """
+        return _mlt.frame_get_audio_buffer(self, *args)
+%}
+}
 #endif
 
 }
@@ -87,6 +112,7 @@ namespace Mlt {
 int mlt_log_get_level( void );
 void mlt_log_set_level( int );
 %include <MltFactory.h>
+%include <MltPool.h>
 %include <MltRepository.h>
 %include <MltEvent.h>
 %include <MltProperties.h>
@@ -254,4 +280,241 @@ binary_data frame_get_image( Mlt::Frame &frame, mlt_image_format format, int w,
 binary_data frame_get_waveform(Mlt::Frame&, int, int);
 binary_data frame_get_image(Mlt::Frame&, mlt_image_format, int, int);
 
+%{
+/** A Python buffer over an image plane or the audio of a frame.
+ *
+ * It holds a reference to the frame so the memory stays valid while a
+ * memoryview or NumPy array made from it exists, without a copy.
+ */
+
+typedef struct {
+	PyObject_HEAD
+	mlt_frame frame;
+	void *data;
+	int readonly;
+	int ndim;
+	Py_ssize_t shape[3];
+	Py_ssize_t strides[3];
+	Py_ssize_t itemsize;
+	char format[2];
+} frame_buffer;
+
+static void frame_buffer_dealloc( PyObject *self )
+{
+	mlt_frame_close( ( (frame_buffer*) self )->frame );
+	Py_TYPE( self )->tp_free( self );
+}
+
+static int frame_buffer_get( PyObject *self, Py_buffer *view, int flags )
+{
+	frame_buffer *buffer = (frame_buffer*) self;
+	Py_ssize_t len = buffer->itemsize;
+	int i;
+
+	if ( ( flags & PyBUF_WRITABLE ) && buffer->readonly )
+	{
+		PyErr_SetString( PyExc_BufferError, "the frame buffer is read-only" );
+		return -1;
+	}
+	for ( i = 0; i < buffer->ndim; i++ )
+		len *= buffer->shape[i];
+	view->obj = self;
+	view->buf = buffer->data;
+	view->len = len;
+	view->readonly = buffer->readonly;
+	view->itemsize = buffer->itemsize;
+	view->format = ( flags & PyBUF_FORMAT ) ? buffer->format : NULL;
+	view->ndim = buffer->ndim;
+	view->shape = ( flags & PyBUF_ND ) == PyBUF_ND ? buffer->shape : NULL;
+	view->strides = ( flags & PyBUF_STRIDES ) == PyBUF_STRIDES ? buffer->strides : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	Py_INCREF( self );
+	return 0;
+}
+
+static PyBufferProcs frame_buffer_procs = { frame_buffer_get, NULL };
+
+static PyTypeObject frame_buffer_type = {
+	PyVarObject_HEAD_INIT( NULL, 0 )
+	"mlt.FrameBuffer",
+};
+
+static int frame_buffer_type_ready( void )
+{
+	if ( !frame_buffer_type.tp_flags )
+	{
+		frame_buffer_type.tp_basicsize = sizeof( frame_buffer );
+		frame_buffer_type.tp_dealloc = frame_buffer_dealloc;
+		frame_buffer_type.tp_as_buffer = &frame_buffer_procs;
+		frame_buffer_type.tp_flags = Py_TPFLAGS_DEFAULT;
+		frame_buffer_type.tp_doc = "A reference to memory owned by an MLT frame";
+		if ( PyType_Ready( &frame_buffer_type ) < 0 )
+			return -1;
+	}
+	return 0;
+}
+
+/** Make a C-contiguous memoryview of rows x columns x components items,
+ * each rows apart by stride bytes. A dimension of 1 component is dropped.
+ */
+
+static PyObject *frame_buffer_new( mlt_frame frame, void *data, int readonly, const char *format,
+	Py_ssize_t itemsize, Py_ssize_t rows, Py_ssize_t columns, Py_ssize_t components, Py_ssize_t stride )
+{
+	frame_buffer *buffer;
+	PyObject *result;
+
+	if ( frame_buffer_type_ready() < 0 )
+		return NULL;
+	buffer = PyObject_New( frame_buffer, &frame_buffer_type );
+	if ( !buffer )
+		return NULL;
+	mlt_properties_inc_ref( MLT_FRAME_PROPERTIES( frame ) );
+	buffer->frame = frame;
+	buffer->data = data;
+	buffer->readonly = readonly;
+	buffer->itemsize = itemsize;
+	buffer->format[0] = format[0];
+	buffer->format[1] = 0;
+	buffer->ndim = components > 1 ? 3 : 2;
+	buffer->shape[0] = rows;
+	buffer->shape[1] = columns;
+	buffer->shape[2] = components;
+	buffer->strides[0] = stride;
+	buffer->strides[1] = itemsize * components;
+	buffer->strides[2] = itemsize;
+	result = PyMemoryView_FromObject( (PyObject*) buffer );
+	Py_DECREF( buffer );
+	return result;
+}
+
+/** The layout of a plane of an image format */
+
+typedef struct {
+	const char *format;  /**< the struct module format of an item */
+	int itemsize;        /**< the size of an item in bytes */
+	int components;      /**< the items per pixel */
+	int shift_x;         /**< the log2 subsampling of the columns */
+	int shift_y;         /**< the log2 subsampling of the rows */
+} plane_layout;
+
+static int image_layout( mlt_image_format format, plane_layout layout[3] )
+{
+	static const plane_layout rgb[] = { { "B", 1, 3, 0, 0 } };
+	static const plane_layout rgba[] = { { "B", 1, 4, 0, 0 } };
+	static const plane_layout rgba64[] = { { "H", 2, 4, 0, 0 } };
+	static const plane_layout yuv422[] = { { "B", 1, 2, 0, 0 } };
+	static const plane_layout yuv420p[] = { { "B", 1, 1, 0, 0 }, { "B", 1, 1, 1, 1 }, { "B", 1, 1, 1, 1 } };
+	static const plane_layout yuv422p16[] = { { "H", 2, 1, 0, 0 }, { "H", 2, 1, 1, 0 }, { "H", 2, 1, 1, 0 } };
+	static const plane_layout yuv420p10[] = { { "H", 2, 1, 0, 0 }, { "H", 2, 1, 1, 1 }, { "H", 2, 1, 1, 1 } };
+	static const plane_layout nv12[] = { { "B", 1, 1, 0, 0 }, { "B", 1, 2, 1, 1 } };
+	static const plane_layout p010[] = { { "H", 2, 1, 0, 0 }, { "H", 2, 2, 1, 1 } };
+	const plane_layout *planes = NULL;
+	int count = 0, i;
+
+	switch ( format )
+	{
+	case mlt_image_rgb: planes = rgb; count = 1; break;
+	case mlt_image_rgba: planes = rgba; count = 1; break;
+	case mlt_image_rgba64: planes = rgba64; count = 1; break;
+	case mlt_image_yuv422: planes = yuv422; count = 1; break;
+	case mlt_image_yuv420p: planes = yuv420p; count = 3; break;
+	case mlt_image_yuv422p16: planes = yuv422p16; count = 3; break;
+	case mlt_image_yuv420p10: planes = yuv420p10; count = 3; break;
+	case mlt_image_nv12: planes = nv12; count = 2; break;
+	case mlt_image_p010: planes = p010; count = 2; break;
+	default: break;
+	}
+	for ( i = 0; i < count; i++ )
+		layout[i] = planes[i];
+	return count;
+}
+
+PyObject *frame_get_image_planes( Mlt::Frame &frame, mlt_image_format format, int w, int h, int writable )
+{
+	Mlt::ImageView view = frame.get_image_view( format, w, h, writable );
+	plane_layout layout[3];
+	int count = image_layout( view.format(), layout );
+	PyObject *result;
+	int i;
+
+	if ( !view.is_valid() || count == 0 )
+	{
+		PyErr_Format( PyExc_ValueError, "no image in a format with a buffer layout (got %s)",
+			mlt_image_format_name( view.format() ) );
+		return NULL;
+	}
+	result = PyTuple_New( count );
+	for ( i = 0; result && i < count; i++ )
+	{
+		PyObject *plane = frame_buffer_new( frame.get_frame(), view.plane( i ), !writable,
+			layout[i].format, layout[i].itemsize,
+			view.height() >> layout[i].shift_y, view.width() >> layout[i].shift_x,
+			layout[i].components, view.stride( i ) );
+		if ( !plane )
+		{
+			Py_CLEAR( result );
+			break;
+		}
+		PyTuple_SET_ITEM( result, i, plane );
+	}
+	return result;
+}
+
+PyObject *frame_get_image_buffer( Mlt::Frame &frame, mlt_image_format format, int w, int h, int writable )
+{
+	Mlt::ImageView view = frame.get_image_view( format, w, h, writable );
+	plane_layout layout[3];
+	int count = image_layout( view.format(), layout );
+
+	if ( !view.is_valid() || count == 0 )
+	{
+		PyErr_Format( PyExc_ValueError, "no image in a format with a buffer layout (got %s)",
+			mlt_image_format_name( view.format() ) );
+		return NULL;
+	}
+	if ( count == 1 )
+		return frame_buffer_new( frame.get_frame(), view.data(), !writable, layout[0].format, layout[0].itemsize,
+			view.height(), view.width(), layout[0].components, view.stride( 0 ) );
+	// The planes of a planar format are contiguous, so give them as one row of bytes.
+	Py_ssize_t size = mlt_image_format_size( view.format(), view.width(), view.height(), NULL );
+	return frame_buffer_new( frame.get_frame(), view.data(), !writable, "B", 1, 1, size, 1, size );
+}
+
+PyObject *frame_get_audio_buffer( Mlt::Frame &frame, mlt_audio_format format, int frequency, int channels, int samples )
+{
+	Mlt::AudioView view = frame.get_audio_view( format, frequency, channels, samples );
+	const char *type = NULL;
+	int itemsize = 0;
+
+	switch ( view.format() )
+	{
+	case mlt_audio_s16: type = "h"; itemsize = 2; break;
+	case mlt_audio_s32:
+	case mlt_audio_s32le: type = "i"; itemsize = 4; break;
+	case mlt_audio_float:
+	case mlt_audio_f32le: type = "f"; itemsize = 4; break;
+	case mlt_audio_u8: type = "B"; itemsize = 1; break;
+	default: break;
+	}
+	if ( !view.is_valid() || !type || view.channels() < 1 )
+	{
+		PyErr_SetString( PyExc_ValueError, "no audio" );
+		return NULL;
+	}
+	// Planar audio is channels x samples and interleaved audio is samples x channels.
+	if ( view.plane( 0 ) && view.channels() > 1 )
+		return frame_buffer_new( frame.get_frame(), view.data(), 0, type, itemsize,
+			view.channels(), view.samples(), 1, (Py_ssize_t) view.samples() * itemsize );
+	return frame_buffer_new( frame.get_frame(), view.data(), 0, type, itemsize,
+		view.samples(), view.channels(), 1, (Py_ssize_t) view.channels() * itemsize );
+}
+
+%}
+
+PyObject *frame_get_image_planes(Mlt::Frame&, mlt_image_format, int, int, int writable = 0);
+PyObject *frame_get_image_buffer(Mlt::Frame&, mlt_image_format, int, int, int writable = 0);
+PyObject *frame_get_audio_buffer(Mlt::Frame&, mlt_audio_format, int, int, int);
+
 #endif
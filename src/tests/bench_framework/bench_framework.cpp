@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2023 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with consumer library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Benchmarks of the framework hot paths. These are not run by ctest; run
+// bench_framework with QtTest's output options to record the results, for
+// example "bench_framework -o results.xml,xml", or build the benchmark
+// target, which writes benchmark.xml in the build directory.
+
+#include <QtTest>
+
+#include <mlt++/Mlt.h>
+using namespace Mlt;
+
+extern "C" {
+#include <framework/mlt_cache.h>
+#include <framework/mlt_slices.h>
+}
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class BenchFramework : public QObject
+{
+    Q_OBJECT
+    Profile profile;
+
+public:
+    BenchFramework()
+        : profile("atsc_1080p_25")
+    {
+        Factory::init();
+    }
+
+private:
+    static int slice_proc(int /*id*/, int idx, int /*jobs*/, void *cookie)
+    {
+        static_cast<std::atomic<int> *>(cookie)->fetch_add(idx);
+        return 0;
+    }
+
+    static void make_names(std::vector<QByteArray> &names, int count)
+    {
+        names.clear();
+        for (int i = 0; i < count; i++)
+            names.push_back(QByteArray("meta.media.") + QByteArray::number(i) + ".key");
+    }
+
+private Q_SLOTS:
+    void PropertiesSet_data()
+    {
+        QTest::addColumn<int>("count");
+        QTest::newRow("10") << 10;
+        QTest::newRow("100") << 100;
+        QTest::newRow("1000") << 1000;
+    }
+
+    void PropertiesSet()
+    {
+        QFETCH(int, count);
+        std::vector<QByteArray> names;
+        make_names(names, count);
+        Properties p;
+        QBENCHMARK {
+            for (int i = 0; i < count; i++)
+                p.set(names[i].constData(), i);
+        }
+        QCOMPARE(p.count(), count);
+    }
+
+    void PropertiesGet_data()
+    {
+        PropertiesSet_data();
+    }
+
+    void PropertiesGet()
+    {
+        QFETCH(int, count);
+        std::vector<QByteArray> names;
+        make_names(names, count);
+        Properties p;
+        for (int i = 0; i < count; i++)
+            p.set(names[i].constData(), i);
+        qint64 sum = 0;
+        QBENCHMARK {
+            for (int i = 0; i < count; i++)
+                sum += p.get_int(names[i].constData());
+        }
+        QVERIFY(sum >= 0);
+    }
+
+    void PoolAllocRelease_data()
+    {
+        QTest::addColumn<int>("threads");
+        QTest::newRow("1") << 1;
+        QTest::newRow("4") << 4;
+        QTest::newRow("16") << 16;
+    }
+
+    void PoolAllocRelease()
+    {
+        QFETCH(int, threads);
+        const int iterations = 10000;
+        QBENCHMARK {
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([t, iterations]() {
+                    for (int i = 0; i < iterations; i++) {
+                        // Sizes spread over a few of the pool's power of two stacks
+                        void *p = mlt_pool_alloc(64 << ((i + t) % 8));
+                        mlt_pool_release(p);
+                    }
+                });
+            }
+            for (auto &worker : workers)
+                worker.join();
+        }
+    }
+
+    void CacheHit()
+    {
+        mlt_cache cache = mlt_cache_init();
+        int keys[4];
+        mlt_cache_set_size(cache, 4);
+        for (int i = 0; i < 4; i++)
+            mlt_cache_put(cache, &keys[i], mlt_pool_alloc(1024), 1024, mlt_pool_release);
+        int hits = 0;
+        QBENCHMARK {
+            for (int i = 0; i < 4; i++) {
+                mlt_cache_item item = mlt_cache_get(cache, &keys[i]);
+                hits += item != NULL;
+                mlt_cache_item_close(item);
+            }
+        }
+        QVERIFY(hits > 0);
+        mlt_cache_close(cache);
+    }
+
+    void CacheMiss()
+    {
+        mlt_cache cache = mlt_cache_init();
+        int keys[8];
+        mlt_cache_set_size(cache, 4);
+        // Putting more keys than fit evicts the least recently used each time.
+        QBENCHMARK {
+            for (int i = 0; i < 8; i++) {
+                mlt_cache_item item = mlt_cache_get(cache, &keys[i]);
+                if (!item)
+                    mlt_cache_put(cache, &keys[i], mlt_pool_alloc(1024), 1024, mlt_pool_release);
+                mlt_cache_item_close(item);
+            }
+        }
+        mlt_cache_close(cache);
+    }
+
+    void AnimationEvaluate_data()
+    {
+        QTest::addColumn<int>("keys");
+        QTest::newRow("10") << 10;
+        QTest::newRow("100") << 100;
+        QTest::newRow("1000") << 1000;
+    }
+
+    void AnimationEvaluate()
+    {
+        QFETCH(int, keys);
+        QByteArray value;
+        for (int i = 0; i < keys; i++)
+            value += QByteArray::number(i * 10) + (i % 2 ? "~=" : "=") + QByteArray::number(i % 7) + ";";
+        Properties p;
+        p.set("key", value.constData());
+        const int length = keys * 10;
+        // Parse before measuring
+        p.anim_get_double("key", 0, length);
+        double sum = 0.0;
+        QBENCHMARK {
+            for (int position = 0; position < length; position += 7)
+                sum += p.anim_get_double("key", position, length);
+        }
+        QVERIFY(sum >= 0.0);
+    }
+
+    void SlicesDispatch_data()
+    {
+        QTest::addColumn<int>("jobs");
+        QTest::newRow("1") << 1;
+        QTest::newRow("cores") << 0;
+        QTest::newRow("64") << 64;
+    }
+
+    void SlicesDispatch()
+    {
+        QFETCH(int, jobs);
+        std::atomic<int> sum(0);
+        // A job count of 0 uses one job per slice thread
+        QBENCHMARK {
+            mlt_slices_run_normal(jobs, slice_proc, &sum);
+        }
+        QVERIFY(sum >= 0);
+    }
+
+    void PlaylistLocate_data()
+    {
+        QTest::addColumn<int>("clips");
+        QTest::newRow("100") << 100;
+        QTest::newRow("1000") << 1000;
+        QTest::newRow("10000") << 10000;
+    }
+
+    void PlaylistLocate()
+    {
+        QFETCH(int, clips);
+        Playlist playlist(profile);
+        Producer producer(profile, "color:red");
+        QVERIFY(producer.is_valid());
+        for (int i = 0; i < clips; i++)
+            playlist.append(producer, 0, 24);
+        const int length = playlist.get_length();
+        int sum = 0;
+        QBENCHMARK {
+            // Step by a prime so the positions spread over the whole playlist
+            for (int position = 0; position < length; position += 997)
+                sum += playlist.get_clip_index_at(position);
+        }
+        QVERIFY(sum >= 0);
+    }
+
+    void ImageConvert_data()
+    {
+        QTest::addColumn<int>("from");
+        QTest::addColumn<int>("to");
+        QTest::newRow("yuv422 to rgba") << int(mlt_image_yuv422) << int(mlt_image_rgba);
+        QTest::newRow("rgba to yuv422") << int(mlt_image_rgba) << int(mlt_image_yuv422);
+        QTest::newRow("yuv420p to yuv422") << int(mlt_image_yuv420p) << int(mlt_image_yuv422);
+    }
+
+    void ImageConvert()
+    {
+        QFETCH(int, from);
+        QFETCH(int, to);
+        Producer producer(profile, "color:red");
+        QVERIFY(producer.is_valid());
+        int width = profile.width();
+        int height = profile.height();
+        QBENCHMARK {
+            // The colour producer makes its image in the format asked for, so
+            // get it in one format and then convert it on the same frame.
+            Frame *frame = producer.get_frame();
+            mlt_image_format format = mlt_image_format(from);
+            frame->get_image(format, width, height);
+            format = mlt_image_format(to);
+            frame->get_image(format, width, height);
+            delete frame;
+        }
+    }
+
+    void Composite()
+    {
+        Tractor tractor(profile);
+        Producer top(profile, "color:0x80ff0000");
+        Producer bottom(profile, "color:blue");
+        QVERIFY(top.is_valid() && bottom.is_valid());
+        tractor.set_track(bottom, 0);
+        tractor.set_track(top, 1);
+        Transition composite(profile, "composite");
+        QVERIFY(composite.is_valid());
+        composite.set("geometry", "10%/10%:80%x80%:100");
+        composite.set("always_active", 1);
+        tractor.plant_transition(composite, 0, 1);
+        int width = profile.width();
+        int height = profile.height();
+        QBENCHMARK {
+            Frame *frame = tractor.get_frame();
+            mlt_image_format format = mlt_image_yuv422;
+            frame->get_image(format, width, height);
+            delete frame;
+        }
+    }
+};
+
+QTEST_APPLESS_MAIN(BenchFramework)
+
+#include "bench_framework.moc"
@@ -0,0 +1,4 @@
+include (../common.pri)
+CONFIG  -= testcase
+TARGET   = bench_framework
+SOURCES  = bench_framework.cpp
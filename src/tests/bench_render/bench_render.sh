@@ -0,0 +1,99 @@
+#!/bin/sh
+#
+# bench_render.sh -- render the benchmark projects and report throughput
+# Copyright (C) 2023 Meltytech, LLC
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published
+# by the Free Software Foundation; either version 2.1 of the License, or
+# (at your option) any later version.
+#
+# Renders every project in this directory with the null consumer at
+# real_time -1, -2, -4 ... up to the number of cores and writes one CSV line
+# per run to stdout:
+#
+#   project,threads,seconds,fps,speedup,efficiency
+#
+# speedup is relative to the single thread run and efficiency is the speedup
+# divided by the number of threads. Projects that fail to load, for example
+# frei0r_stack.mlt without frei0r, are reported on stderr and skipped.
+#
+# Environment:
+#   MELT     the melt to run, defaults to melt
+#   THREADS  the thread counts to run, defaults to powers of two up to nproc
+#   REPEAT   the number of runs of each, of which the fastest counts, defaults to 1
+#
+# Set MLT_REPOSITORY and MLT_DATA as usual to run an uninstalled build, or
+# source src/tests/setenv from the top of the source tree.
+
+MELT=${MELT:-melt}
+REPEAT=${REPEAT:-1}
+# Every project is this many frames long
+FRAMES=250
+DIR=$(cd "$(dirname "$0")" && pwd)
+
+if [ -z "$THREADS" ]; then
+	cores=$(nproc 2>/dev/null || getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)
+	THREADS=1
+	n=2
+	while [ $n -le "$cores" ]; do
+		THREADS="$THREADS $n"
+		n=$((n * 2))
+	done
+	[ "${THREADS##* }" -ne "$cores" ] && THREADS="$THREADS $cores"
+fi
+
+now()
+{
+	date +%s.%N
+}
+
+# Print the seconds to render a project with a number of threads or nothing on error
+render()
+{
+	best=
+	i=0
+	while [ $i -lt "$REPEAT" ]; do
+		start=$(now)
+		"$MELT" -silent "$1" -consumer null real_time=-"$2" terminate_on_pause=1 \
+			mlt_image_format=yuv420p 2>/dev/null || return 1
+		end=$(now)
+		best=$(echo "$start $end $best" | awk '{ t = $2 - $1; if ($3 == "" || t < $3) print t; else print $3 }')
+		i=$((i + 1))
+	done
+	echo "$best"
+}
+
+# The names of all of the services melt can load, one per line
+SERVICES=$(for type in producers filters transitions; do
+	"$MELT" -query "$type" 2>/dev/null | sed -n 's/^  - \(.*\)$/\1/p'
+done)
+if [ -z "$SERVICES" ]; then
+	echo "Failed to run $MELT" >&2
+	exit 1
+fi
+
+echo "project,threads,seconds,fps,speedup,efficiency"
+for project in "$DIR"/*.mlt; do
+	name=$(basename "$project" .mlt)
+	# A service that is not available would just be left out, so skip the
+	# project. melt does not list links, so those are not checked.
+	for service in $(awk '/<link>/ { link = 1 } /<\/link>/ { link = 0 }
+			!link && /name="mlt_service"/ { sub(/.*">/, ""); sub(/<.*/, ""); print }' "$project" | sort -u); do
+		if ! echo "$SERVICES" | grep -qx "$service"; then
+			echo "$name: skipped, $service is not available" >&2
+			continue 2
+		fi
+	done
+	base=
+	for threads in $THREADS; do
+		seconds=$(render "$project" "$threads")
+		if [ -z "$seconds" ]; then
+			echo "$name: failed to render with $threads threads" >&2
+			continue 2
+		fi
+		[ -z "$base" ] && base=$seconds
+		echo "$name $threads $seconds $base" | awk -v frames=$FRAMES \
+			'{ s = $4 / $3; printf "%s,%d,%.3f,%.2f,%.2f,%.2f\n", $1, $2, $3, frames / $3, s, s / $2 }'
+	done
+done
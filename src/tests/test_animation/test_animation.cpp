@@ -383,6 +383,75 @@ private Q_SLOTS:
 		QCOMPARE(a.key_get_frame(2), 40);
 		QCOMPARE(a.key_get_frame(3), -1);
 	}
+
+	void ManyKeyframesInAnyOrder()
+	{
+		// Key k is at frame 10 * k with the value k * k
+		char s[2000];
+		int n = 0;
+		for (int k = 0; k < 100; k++)
+			n += snprintf(s + n, sizeof(s) - n, "%d=%d;", 10 * k, k * k);
+		Properties p;
+		p.set("foo", s);
+		p.anim_get_int("foo", 0);
+		Animation a = p.get_animation("foo");
+		QCOMPARE(a.key_count(), 100);
+		QCOMPARE(a.key_get_frame(57), 570);
+		QCOMPARE(a.next_key(571), 580);
+		QCOMPARE(a.previous_key(579), 570);
+		QCOMPARE(a.previous_key(580), 580);
+		QVERIFY(a.is_key(990));
+		QVERIFY(!a.is_key(995));
+
+		// Forward, backward and jumping around
+		for (int i = 0; i < 990; i++)
+			QCOMPARE(p.anim_get_int("foo", i), i / 10 * (i / 10) + (2 * (i / 10) + 1) * (i % 10) / 10);
+		for (int i = 990; i >= 0; i -= 3)
+			QCOMPARE(p.anim_get_int("foo", i), i / 10 * (i / 10) + (2 * (i / 10) + 1) * (i % 10) / 10);
+		for (int i = 0; i < 1000; i++) {
+			int position = (i * 7919) % 990;
+			QCOMPARE(p.anim_get_int("foo", position),
+				position / 10 * (position / 10) + (2 * (position / 10) + 1) * (position % 10) / 10);
+		}
+		QCOMPARE(p.anim_get_int("foo", 2000), 99 * 99);
+	}
+
+	void KeyframeEditsAfterLookups()
+	{
+		Properties p;
+		p.set("foo", "0=0;10=100;20=200;30=300;40=400");
+		QCOMPARE(p.anim_get_int("foo", 25), 250);
+		Animation a = p.get_animation("foo");
+
+		// Add a key inside the segment looked up last
+		p.anim_set("foo", 0, 25);
+		QCOMPARE(a.key_count(), 6);
+		QCOMPARE(p.anim_get_int("foo", 25), 0);
+		QCOMPARE(p.anim_get_int("foo", 22), 120);
+		QCOMPARE(a.next_key(21), 25);
+
+		// Remove it again
+		QCOMPARE(a.remove(25), 0);
+		QCOMPARE(a.key_count(), 5);
+		QCOMPARE(p.anim_get_int("foo", 25), 250);
+		QCOMPARE(a.next_key(21), 30);
+
+		// Move a key within its segment
+		QCOMPARE(p.anim_get_int("foo", 15), 150);
+		QCOMPARE(a.key_set_frame(1, 15), 0);
+		Properties q;
+		q.set("foo", "0=0;15=100;20=200;30=300;40=400");
+		for (int i = 0; i <= 40; i++)
+			QCOMPARE(p.anim_get_int("foo", i), q.anim_get_int("foo", i));
+
+		// Move it past its neighbour and back
+		QCOMPARE(a.key_set_frame(1, 35), 0);
+		p.anim_get_int("foo", 36);
+		QCOMPARE(a.key_set_frame(1, 15), 0);
+		for (int i = 40; i >= 0; i--)
+			QCOMPARE(p.anim_get_int("foo", i), q.anim_get_int("foo", i));
+		QCOMPARE(a.next_key(16), 20);
+	}
 };
 
 QTEST_APPLESS_MAIN(TestAnimation)
@@ -22,6 +22,9 @@
 #include <mlt++/Mlt.h>
 using namespace Mlt;
 
+#include <cstdint>
+#include <limits>
+
 class TestAudio : public QObject
 {
 	Q_OBJECT
@@ -51,6 +54,30 @@ private Q_SLOTS:
 		free(data);
 		a.set_data(nullptr);
 	}
+
+	void FloatConversionClipsAndZeroesNaN()
+	{
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		const float inf = std::numeric_limits<float>::infinity();
+		const float in[] = { 0.5f, -0.5f, 2.0f, -2.0f, nan, -nan, inf, -inf, 1.0f, -1.0f, 0.0f };
+		const int16_t s16[] = { 16383, -16383, 32767, -32767, 0, 0, 32767, -32767, 32767, -32767, 0 };
+		const int32_t s32[] = { 1073741824, -1073741824, INT32_MAX, INT32_MIN, 0, 0, INT32_MAX, INT32_MIN, INT32_MAX, INT32_MIN, 0 };
+		const int n = sizeof(in) / sizeof(in[0]);
+		// Rotate the samples so that each one goes through the vector and the scalar code
+		for (int offset = 0; offset < n; offset++) {
+			float src[2 * n];
+			int16_t dst16[2 * n];
+			int32_t dst32[2 * n];
+			for (int i = 0; i < 2 * n; i++)
+				src[i] = in[(i + offset) % n];
+			mlt_audio_f32_to_s16(dst16, src, 2 * n);
+			mlt_audio_f32_to_s32(dst32, src, 2 * n);
+			for (int i = 0; i < 2 * n; i++) {
+				QCOMPARE(dst16[i], s16[(i + offset) % n]);
+				QCOMPARE(dst32[i], s32[(i + offset) % n]);
+			}
+		}
+	}
 };
 
 QTEST_APPLESS_MAIN(TestAudio)
@@ -22,6 +22,9 @@
 #include <mlt++/Mlt.h>
 using namespace Mlt;
 
+#include <string>
+#include <thread>
+
 class TestEvents : public QObject
 {
     Q_OBJECT
@@ -51,6 +54,11 @@ private:
         self->checkOwner(owner);
     }
 
+    static void onPropertyCounted(mlt_properties owner, std::string* names, mlt_event_data data)
+    {
+        names->append(Mlt::EventData(data).to_string()).append(" ");
+    }
+
 private Q_SLOTS:
     
     void ListenToPropertyChanged()
@@ -93,7 +101,46 @@ private Q_SLOTS:
         producer.set("foo", 1);
         delete event;
     }
-  
+
+    void NestedUpdateFiresOnce()
+    {
+        Profile profile;
+        Producer producer(profile, "noise");
+        std::string names;
+        Event* event = producer.listen("property-changed", &names, (mlt_listener) onPropertyCounted);
+        QVERIFY(event != nullptr);
+        mlt_properties_begin_update(producer.get_properties());
+        producer.set("foo", 1);
+        mlt_properties_begin_update(producer.get_properties());
+        producer.set("bar", 1);
+        producer.set("foo", 2);
+        mlt_properties_end_update(producer.get_properties());
+        QCOMPARE(names.c_str(), "");
+        mlt_properties_end_update(producer.get_properties());
+        QCOMPARE(names.c_str(), "foo bar ");
+        names.clear();
+        producer.set("foo", 3);
+        QCOMPARE(names.c_str(), "foo ");
+        delete event;
+    }
+
+    void UpdateHoldsOnlyItsThread()
+    {
+        Profile profile;
+        Producer producer(profile, "noise");
+        std::string names;
+        Event* event = producer.listen("property-changed", &names, (mlt_listener) onPropertyCounted);
+        QVERIFY(event != nullptr);
+        mlt_properties_begin_update(producer.get_properties());
+        std::thread other([&producer] { producer.set("bar", 1); });
+        other.join();
+        QCOMPARE(names.c_str(), "bar ");
+        producer.set("foo", 1);
+        QCOMPARE(names.c_str(), "bar ");
+        mlt_properties_end_update(producer.get_properties());
+        QCOMPARE(names.c_str(), "bar foo ");
+        delete event;
+    }
 };
 
 QTEST_APPLESS_MAIN(TestEvents)
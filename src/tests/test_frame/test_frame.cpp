@@ -93,6 +93,134 @@ private Q_SLOTS:
         QCOMPARE(f1.ref_count(), 2);
         mlt_frame_close(frame);
     }
+
+    static int CountingGetImage(mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int)
+    {
+        int *calls = (int*) mlt_frame_pop_service(frame);
+        ++*calls;
+        return mlt_frame_get_image(frame, image, format, width, height, 0);
+    }
+
+    void CancelledFrameSkipsGetImage()
+    {
+        Factory::init();
+        mlt_frame frame = mlt_frame_init(NULL);
+        int calls = 0;
+        QVERIFY(!mlt_frame_is_cancelled(frame));
+        mlt_frame_push_service(frame, &calls);
+        mlt_frame_push_get_image(frame, CountingGetImage);
+        mlt_frame_cancel(frame);
+        QVERIFY(mlt_frame_is_cancelled(frame));
+        uint8_t *image = NULL;
+        mlt_image_format format = mlt_image_yuv422;
+        int width = 0, height = 0;
+        mlt_frame_get_image(frame, &image, &format, &width, &height, 0);
+        QCOMPARE(calls, 0);
+        mlt_frame_close(frame);
+    }
+
+    void WritableImageCopiesOnlyWhenShared()
+    {
+        Factory::init();
+        mlt_frame frame = mlt_frame_init(NULL);
+        uint8_t *shared = (uint8_t*) mlt_image_buffer_alloc(16);
+        shared[0] = 1;
+        mlt_frame_set_image(frame, shared, 16, mlt_image_buffer_release);
+        mlt_frame clone = mlt_frame_clone(frame, 1);
+        uint8_t *image = NULL;
+        mlt_image_format format = mlt_image_rgba;
+        int width = 2, height = 2;
+        mlt_frame_get_image(clone, &image, &format, &width, &height, 0);
+        QCOMPARE(image, shared);
+        mlt_frame_get_image(clone, &image, &format, &width, &height, 1);
+        QVERIFY(image != shared);
+        QCOMPARE(image[0], (uint8_t) 1);
+        image[0] = 2;
+        QCOMPARE(shared[0], (uint8_t) 1);
+        mlt_frame_close(frame);
+        uint8_t *writable = NULL;
+        mlt_frame_get_image(clone, &writable, &format, &width, &height, 1);
+        QCOMPARE(writable, image);
+        mlt_frame_close(clone);
+    }
+
+    void ShallowCloneCopiesBorrowedImageBeforeWrite()
+    {
+        Factory::init();
+        mlt_frame frame = mlt_frame_init(NULL);
+        uint8_t *owned = (uint8_t*) mlt_pool_alloc(16);
+        owned[0] = 1;
+        mlt_frame_set_image(frame, owned, 16, mlt_pool_release);
+        mlt_frame clone = mlt_frame_clone(frame, 0);
+        uint8_t *image = NULL;
+        mlt_image_format format = mlt_image_rgba;
+        int width = 2, height = 2;
+        mlt_frame_get_image(clone, &image, &format, &width, &height, 0);
+        QCOMPARE(image, owned);
+        mlt_frame_get_image(clone, &image, &format, &width, &height, 1);
+        QVERIFY(image != owned);
+        QCOMPARE(image[0], (uint8_t) 1);
+        image[0] = 2;
+        QCOMPARE(owned[0], (uint8_t) 1);
+        mlt_frame_close(clone);
+        mlt_frame_close(frame);
+    }
+
+    void StackDequeWrapsAround()
+    {
+        // Frame stacks are deques, which keep a few entries inline
+        mlt_deque deque = mlt_deque_init();
+        int next = 0, first = 0;
+        for (int i = 0; i < 6; i++)
+            mlt_deque_push_back_int(deque, next++);
+        // Move the window around the inline ring several times
+        for (int i = 0; i < 50; i++) {
+            QCOMPARE(mlt_deque_pop_front_int(deque), first++);
+            mlt_deque_push_back_int(deque, next++);
+            QCOMPARE(mlt_deque_count(deque), 6);
+            QCOMPARE(mlt_deque_peek_front_int(deque), first);
+            QCOMPARE(mlt_deque_peek_back_int(deque), next - 1);
+        }
+        // And the other way, from the front
+        for (int i = 0; i < 50; i++) {
+            mlt_deque_push_front_int(deque, --first);
+            QCOMPARE(mlt_deque_pop_back_int(deque), --next);
+        }
+        for (int i = 0; i < 6; i++)
+            QCOMPARE(mlt_deque_pop_front_int(deque), first + i);
+        QCOMPARE(mlt_deque_count(deque), 0);
+        QCOMPARE(mlt_deque_pop_front(deque), (void*) 0);
+        QCOMPARE(mlt_deque_pop_back(deque), (void*) 0);
+        mlt_deque_close(deque);
+    }
+
+    void StackDequeGrowsWhileWrapped()
+    {
+        mlt_deque deque = mlt_deque_init();
+        int values[100];
+        for (int i = 0; i < 100; i++)
+            values[i] = i;
+        // Wrap the head before the deque outgrows its inline entries
+        for (int i = 0; i < 5; i++)
+            mlt_deque_push_back(deque, &values[50 + i]);
+        for (int i = 0; i < 50; i++) {
+            mlt_deque_push_front(deque, &values[49 - i]);
+            mlt_deque_push_back(deque, &values[55 + i % 45]);
+            mlt_deque_pop_back(deque);
+        }
+        for (int i = 55; i < 100; i++)
+            mlt_deque_push_back(deque, &values[i]);
+        QCOMPARE(mlt_deque_count(deque), 100);
+        for (int i = 0; i < 100; i++)
+            QCOMPARE(mlt_deque_peek(deque, i), (void*) &values[i]);
+        QCOMPARE(mlt_deque_peek(deque, 100), (void*) 0);
+        QCOMPARE(mlt_deque_peek_front(deque), (void*) &values[0]);
+        QCOMPARE(mlt_deque_peek_back(deque), (void*) &values[99]);
+        for (int i = 99; i >= 0; i--)
+            QCOMPARE(mlt_deque_pop_back(deque), (void*) &values[i]);
+        QCOMPARE(mlt_deque_count(deque), 0);
+        mlt_deque_close(deque);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestFrame)
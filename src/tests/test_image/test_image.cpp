@@ -119,6 +119,34 @@ private Q_SLOTS:
 		QCOMPARE(i.stride(3), 0);
 	}
 
+	void PlaneAndStrideP010()
+	{
+		Image i(1920, 1080, mlt_image_p010 );
+		QVERIFY(i.plane(0) != nullptr);
+		QCOMPARE(i.stride(0), 1920 * 2);
+		QVERIFY(i.plane(1) != nullptr);
+		QCOMPARE(i.stride(1), 1920 * 2);
+		QVERIFY(i.plane(2) == nullptr);
+		QCOMPARE(i.stride(2), 0);
+		QCOMPARE(mlt_image_format_id("p010"), mlt_image_p010);
+	}
+
+	void AllocAlignsAndPadsPlanes()
+	{
+		Image i(100, 10, mlt_image_yuv420p );
+		QCOMPARE(i.stride(0), 128);
+		QCOMPARE(i.stride(1), 64);
+		QCOMPARE(i.stride(2), 64);
+		for (int p = 0; p < 3; p++)
+			QCOMPARE((quintptr) i.plane(p) % MLT_IMAGE_ALIGNMENT, (quintptr) 0);
+	}
+
+	void HwframeIsOpaque()
+	{
+		QCOMPARE(mlt_image_format_id("hwframe"), mlt_image_hwframe);
+		QCOMPARE(mlt_image_format_size(mlt_image_hwframe, 1920, 1080, NULL), 0);
+	}
+
 	void GetSetColorspace()
 	{
 		Image i(1920, 1080, mlt_image_rgb );
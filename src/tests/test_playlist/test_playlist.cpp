@@ -263,6 +263,53 @@ private Q_SLOTS:
         delete pp2;
         delete pp3;
     }
+
+    void ClipAtEveryPosition()
+    {
+        Playlist pl(profile);
+        Producer p(profile, "noise");
+        for (int i = 0; i < 40; i++) {
+            if (i % 5 == 4)
+                pl.blank(i % 3);
+            else
+                pl.append(p, 0, i % 7 + 1);
+        }
+        // Compare with the clip found by adding up the lengths
+        auto check = [&pl]() {
+            int length = 0;
+            for (int i = 0; i < pl.count(); i++) {
+                QCOMPARE(pl.clip_start(i), length);
+                length += pl.clip_length(i);
+            }
+            QCOMPARE(pl.get_playtime(), length);
+            for (int position = 0; position <= length; position++) {
+                int index = 0, end = pl.clip_length(0);
+                while (index < pl.count() && position >= end)
+                    end += pl.clip_length(++index);
+                QCOMPARE(pl.get_clip_index_at(position), index);
+                QCOMPARE(pl.clip(mlt_whence_relative_start, index), pl.clip_start(index));
+            }
+            for (int position = length - 1; position >= 0; position -= 3) {
+                pl.seek(position);
+                QCOMPARE(pl.current_clip(), pl.get_clip_index_at(position));
+            }
+        };
+        check();
+
+        // Every edit drops the index until the next refresh
+        pl.insert(p, 3, 0, 9);
+        check();
+        pl.remove(10);
+        check();
+        pl.move(0, 20);
+        check();
+        pl.split(5, 1);
+        check();
+        pl.resize_clip(7, 0, 20);
+        check();
+        pl.clear();
+        QCOMPARE(pl.get_clip_index_at(0), 0);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestPlaylist)
@@ -845,6 +845,56 @@ private Q_SLOTS:
         QCOMPARE(p.get_double("foo"), 456.0);
     }
 
+    void DecimalFromString()
+    {
+        Properties p;
+        p.set_lcnumeric("POSIX");
+        p.set("key", "1.5");
+        QCOMPARE(p.get_double("key"), 1.5);
+        p.set("key", "-0.25");
+        QCOMPARE(p.get_double("key"), -0.25);
+        p.set("key", "1e3");
+        QCOMPARE(p.get_double("key"), 1000.0);
+        p.set("key", "1.5e-1");
+        QCOMPARE(p.get_double("key"), 0.15);
+        p.set("key", "2.5px");
+        QCOMPARE(p.get_double("key"), 2.5);
+    }
+
+    void TimeClockWithFraction()
+    {
+        Profile profile;
+        profile.set_frame_rate(30, 1);
+        Properties p;
+        p.set("_profile", profile.get_profile(), 0);
+        p.set_lcnumeric("POSIX");
+        p.set("key", "00:00:01.500");
+        QCOMPARE(p.get_int("key"), 45);
+        QCOMPARE(p.get_double("key"), 45.0);
+        p.set("key", "1:02.5");
+        QCOMPARE(p.get_int("key"), 1875);
+    }
+
+    void DecimalFromStringWithCommaLocale()
+    {
+#if !defined(_WIN32)
+        Profile profile;
+        profile.set_frame_rate(30, 1);
+        Properties p;
+        p.set("_profile", profile.get_profile(), 0);
+        p.set_lcnumeric("de_DE.UTF-8");
+        p.set("key", "1,5");
+        QCOMPARE(p.get_double("key"), 1.5);
+        p.set("key", "-0,25");
+        QCOMPARE(p.get_double("key"), -0.25);
+        // A point is not the decimal point of the locale
+        p.set("key", "1.5");
+        QCOMPARE(p.get_double("key"), 1.0);
+        p.set("key", "00:00:01,500");
+        QCOMPARE(p.get_int("key"), 45);
+#endif
+    }
+
     void PropertiesAnimInt()
     {
         Properties p;
@@ -1115,6 +1165,48 @@ private Q_SLOTS:
         QCOMPARE(p.anim_get_rect("key", 25).y, 1.0);
     }
 
+    void DoubleRangeMatchesSingleFrames()
+    {
+        Properties p;
+        p.set_lcnumeric("POSIX");
+        const char *values[] = {
+            "10=100;20~=200;35|=50;40=-10;-5=30",
+            "0=1.5",
+            "0.25",
+            nullptr
+        };
+        double range[80];
+        for (int v = 0; values[v]; v++) {
+            p.set("foo", values[v]);
+            QCOMPARE(p.anim_get_double_range("foo", range, -5, 80, 60), 0);
+            for (int i = 0; i < 80; i++)
+                QCOMPARE(range[i], p.anim_get_double("foo", i - 5, 60));
+        }
+        QCOMPARE(p.anim_get_double_range("missing", range, 0, 4), 0);
+        QCOMPARE(range[3], 0.0);
+    }
+
+    void RectRangeMatchesSingleFrames()
+    {
+        Properties p;
+        p.set_lcnumeric("POSIX");
+        p.set("key", "0~=0/0:200x200:0;20=100/100:400x400:1;30|=10 20 30 40 0.5;45=50% 50% 10% 10%");
+        mlt_rect range[60];
+        QCOMPARE(p.anim_get_rect_range("key", range, 0, 60), 0);
+        for (int i = 0; i < 60; i++) {
+            mlt_rect r = p.anim_get_rect("key", i);
+            QCOMPARE(range[i].x, r.x);
+            QCOMPARE(range[i].y, r.y);
+            QCOMPARE(range[i].w, r.w);
+            QCOMPARE(range[i].h, r.h);
+            QCOMPARE(range[i].o, r.o);
+        }
+        // A range starting in a later segment
+        QCOMPARE(p.anim_get_rect_range("key", range, 25, 10), 0);
+        QCOMPARE(range[0].x, p.anim_get_rect("key", 25).x);
+        QCOMPARE(range[9].w, p.anim_get_rect("key", 34).w);
+    }
+
     void ColorFromInt()
     {
         Properties p;
@@ -1229,6 +1321,216 @@ private Q_SLOTS:
         QCOMPARE(p.get_int("foo"), 123);
         QCOMPARE(p.get_double("foo"), 123.4);
     }
+
+    void ManyPropertiesLookup()
+    {
+        Properties p;
+        char name[32];
+        for (int i = 0; i < 1000; i++) {
+            snprintf(name, sizeof(name), "key.%d", i);
+            p.set(name, i);
+        }
+        QCOMPARE(p.count(), 1000);
+        for (int i = 0; i < 1000; i++) {
+            snprintf(name, sizeof(name), "key.%d", i);
+            QCOMPARE(p.get_int(name), i);
+        }
+        QCOMPARE(p.get("key.1000"), (void*) 0);
+        QCOMPARE(p.rename("key.500", "renamed"), 0);
+        QCOMPARE(p.get("key.500"), (void*) 0);
+        QCOMPARE(p.get_int("renamed"), 500);
+        QCOMPARE(p.get_int("key.999"), 999);
+    }
+
+    void AtomsAreInterned()
+    {
+        mlt_property_atom a = mlt_atom("atom.key");
+        QCOMPARE(mlt_atom("atom.key"), a);
+        QVERIFY(mlt_atom("atom.other") != a);
+        QCOMPARE(mlt_atom_name(a), "atom.key");
+    }
+
+    void SetAndGetByAtom()
+    {
+        Properties p;
+        mlt_properties props = p.get_properties();
+        mlt_property_atom key = mlt_atom("key");
+        p.set("key", 123);
+        QCOMPARE(mlt_properties_get_int_atom(props, key), 123);
+        mlt_properties_set_double_atom(props, key, 1.5);
+        QCOMPARE(p.get_double("key"), 1.5);
+        mlt_properties_set_int_atom(props, mlt_atom("other"), 7);
+        QCOMPARE(p.get_int("other"), 7);
+        QCOMPARE(p.count(), 2);
+        QCOMPARE(mlt_properties_get_atom(props, mlt_atom("missing")), (char*) 0);
+    }
+
+    void ArenaProperties()
+    {
+        mlt_properties props = mlt_properties_new();
+        QCOMPARE(mlt_properties_use_arena(props), 0);
+        char name[32];
+        for (int i = 0; i < 500; i++) {
+            snprintf(name, sizeof(name), "key.%d", i);
+            mlt_properties_set_int(props, name, i);
+        }
+        QCOMPARE(mlt_properties_rename(props, "key.1", "renamed"), 0);
+        QCOMPARE(mlt_properties_get_int(props, "renamed"), 1);
+        QCOMPARE(mlt_properties_get_int(props, "key.499"), 499);
+        QCOMPARE(mlt_properties_use_arena(props), 0);
+        mlt_properties_close(props);
+
+        // Cannot switch to an arena after properties are set
+        props = mlt_properties_new();
+        mlt_properties_set_int(props, "key", 1);
+        QVERIFY(mlt_properties_use_arena(props) != 0);
+        mlt_properties_close(props);
+    }
+
+    void ParentLookup()
+    {
+        Properties parent;
+        parent.set("meta.a", "1");
+        parent.set("meta.b", 2);
+        Properties p;
+        mlt_properties_set_parent(p.get_properties(), parent.get_properties());
+        QCOMPARE(mlt_properties_get_parent(p.get_properties()), parent.get_properties());
+        QCOMPARE(p.get("meta.a"), "1");
+        QCOMPARE(p.get_int("meta.b"), 2);
+        QCOMPARE(mlt_properties_get_int_atom(p.get_properties(), mlt_atom("meta.b")), 2);
+        QCOMPARE(p.get("meta.c"), (void*) 0);
+        mlt_properties_set_parent(p.get_properties(), nullptr);
+        QCOMPARE(p.get("meta.a"), (void*) 0);
+        QCOMPARE(p.count(), 0);
+    }
+
+    void ParentShadowing()
+    {
+        Properties parent;
+        parent.set("meta.a", "1");
+        parent.set("meta.b", "2");
+        Properties p;
+        p.set("meta.a", "local");
+        mlt_properties_set_parent(p.get_properties(), parent.get_properties());
+        QCOMPARE(p.get("meta.a"), "local");
+        p.set("meta.b", "3");
+        QCOMPARE(p.get("meta.b"), "3");
+        QCOMPARE(parent.get("meta.b"), "2");
+        QCOMPARE(p.count(), 2);
+        QCOMPARE(p.rename("meta.a", "other"), 0);
+        QCOMPARE(p.get("meta.a"), "1");
+        QCOMPARE(p.count(), 3);
+    }
+
+    void ParentEnumeration()
+    {
+        Properties parent;
+        parent.set("meta.a", "1");
+        parent.set("meta.b", "2");
+        parent.set("meta.c", "3");
+        Properties p;
+        p.set("width", 720);
+        mlt_properties_set_parent(p.get_properties(), parent.get_properties());
+        p.set("meta.b", "local");
+        QCOMPARE(p.count(), 4);
+        QCOMPARE(p.get_name(0), "width");
+        QCOMPARE(p.get_name(1), "meta.b");
+        QCOMPARE(p.get(1), "local");
+        QCOMPARE(p.get_name(2), "meta.a");
+        QCOMPARE(p.get(2), "1");
+        QCOMPARE(p.get_name(3), "meta.c");
+        QCOMPARE(p.get(3), "3");
+        QCOMPARE(p.get_name(4), (void*) 0);
+
+        Properties copy;
+        copy.pass_values(p, "meta.");
+        QCOMPARE(copy.count(), 3);
+        QCOMPARE(copy.get("b"), "local");
+        QCOMPARE(copy.get("c"), "3");
+    }
+
+    void ParsedNumberFollowsSet()
+    {
+        Properties p;
+        p.set_lcnumeric("POSIX");
+        p.set("foo", "10");
+        QCOMPARE(p.get_int("foo"), 10);
+        QCOMPARE(p.get_double("foo"), 10.0);
+        p.set("foo", "20.5");
+        QCOMPARE(p.get_int("foo"), 20);
+        QCOMPARE(p.get_double("foo"), 20.5);
+        p.set("foo", 7);
+        QCOMPARE(p.get_double("foo"), 7.0);
+        p.set("foo", 2.5);
+        QCOMPARE(p.get_int("foo"), 2);
+        p.set_string("foo", "-3");
+        QCOMPARE(p.get_int("foo"), -3);
+        QCOMPARE(p.get_double("foo"), -3.0);
+        QCOMPARE(p.get("foo"), "-3");
+    }
+
+    void ParsedTimeFollowsFps()
+    {
+        Properties p;
+        Profile pal("dv_pal");
+        Profile p50("atsc_720p_50");
+        p.set("_profile", pal.get_profile(), 0);
+        p.set("foo", "00:00:02.000");
+        QCOMPARE(p.get_int("foo"), 50);
+        p.set("_profile", p50.get_profile(), 0);
+        QCOMPARE(p.get_int("foo"), 100);
+        p.set("_profile", pal.get_profile(), 0);
+        QCOMPARE(p.get_int("foo"), 50);
+    }
+
+    void PropertyObjectGetters()
+    {
+        Properties p;
+        mlt_properties props = p.get_properties();
+        p.set_lcnumeric("POSIX");
+        mlt_property foo = mlt_properties_get_property(props, "foo");
+        QVERIFY(foo != nullptr);
+        QCOMPARE(mlt_properties_get_property(props, "foo"), foo);
+        QCOMPARE(mlt_properties_get_string_property(props, foo), (char*) 0);
+        QCOMPARE(mlt_properties_get_int_property(props, foo), 0);
+
+        p.set("foo", "42");
+        QCOMPARE(mlt_properties_get_int_property(props, foo), 42);
+        QCOMPARE(mlt_properties_get_string_property(props, foo), "42");
+        p.set("foo", 2.5);
+        QCOMPARE(mlt_properties_get_double_property(props, foo), 2.5);
+        QCOMPARE(mlt_properties_get_int_property(props, foo), 2);
+
+        // The object follows its name
+        QCOMPARE(p.rename("foo", "bar"), 0);
+        p.set("bar", "7");
+        QCOMPARE(mlt_properties_get_int_property(props, foo), 7);
+
+        p.set("bar", "0=0;10=100");
+        QCOMPARE(mlt_properties_anim_get_double_property(props, foo, 5, 0), 50.0);
+        QCOMPARE(mlt_properties_anim_get_int_property(props, foo, 10, 0), 100);
+        p.anim_set("bar", 200.0, 10);
+        QCOMPARE(mlt_properties_anim_get_double_property(props, foo, 5, 0), 100.0);
+        p.set("bar", "0=10;10=20");
+        QCOMPARE(mlt_properties_anim_get_double_property(props, foo, 5, 0), 15.0);
+    }
+
+    void BenchmarkManyPropertiesLookup()
+    {
+        Properties p;
+        char name[32];
+        for (int i = 0; i < 200; i++) {
+            snprintf(name, sizeof(name), "meta.media.%d.key", i);
+            p.set(name, i);
+        }
+        int sum = 0;
+        QBENCHMARK {
+            sum += p.get_int("meta.media.0.key");
+            sum += p.get_int("meta.media.199.key");
+            sum += p.get_int("width");
+        }
+        QVERIFY(sum >= 0);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestProperties)
@@ -49,6 +49,57 @@ private Q_SLOTS:
             QVERIFY(consumers->count() > 0);
         delete consumers;
     }
+
+    static void onMemoryPressure(mlt_properties, int* count, mlt_event_data)
+    {
+        ++*count;
+    }
+
+    void MemoryPressureChangesWithReadings()
+    {
+        Factory::init();
+        int count = 0;
+        mlt_factory_set_memory_pressure(mlt_memory_pressure_none);
+        mlt_events_listen(mlt_factory_event_object(), &count, "memory-pressure",
+                          (mlt_listener) onMemoryPressure);
+        QCOMPARE(mlt_factory_update_memory_pressure(50, 100), mlt_memory_pressure_none);
+        QCOMPARE(count, 0);
+        QCOMPARE(mlt_factory_update_memory_pressure(80, 100), mlt_memory_pressure_moderate);
+        QCOMPARE(count, 1);
+        // The same level again does not fire or purge again
+        QCOMPARE(mlt_factory_update_memory_pressure(80, 100), mlt_memory_pressure_moderate);
+        QCOMPARE(count, 1);
+        QCOMPARE(mlt_factory_update_memory_pressure(70, 100), mlt_memory_pressure_moderate);
+        QCOMPARE(count, 1);
+        QCOMPARE(mlt_factory_update_memory_pressure(95, 100), mlt_memory_pressure_critical);
+        QCOMPARE(count, 2);
+        QCOMPARE(mlt_factory_update_memory_pressure(80, 100), mlt_memory_pressure_critical);
+        QCOMPARE(count, 2);
+        QCOMPARE(mlt_factory_update_memory_pressure(70, 100), mlt_memory_pressure_moderate);
+        QCOMPARE(count, 3);
+        QCOMPARE(mlt_factory_update_memory_pressure(60, 100), mlt_memory_pressure_none);
+        QCOMPARE(count, 4);
+        QCOMPARE(mlt_factory_get_memory_pressure(), mlt_memory_pressure_none);
+        mlt_events_disconnect(mlt_factory_event_object(), &count);
+    }
+
+    void SetMemoryPressure()
+    {
+        Factory::init();
+        int count = 0;
+        mlt_factory_set_memory_pressure(mlt_memory_pressure_none);
+        mlt_events_listen(mlt_factory_event_object(), &count, "memory-pressure",
+                          (mlt_listener) onMemoryPressure);
+        mlt_factory_set_memory_pressure(mlt_memory_pressure_critical);
+        QCOMPARE(mlt_factory_get_memory_pressure(), mlt_memory_pressure_critical);
+        QCOMPARE(count, 1);
+        mlt_factory_set_memory_pressure(mlt_memory_pressure_critical);
+        QCOMPARE(count, 1);
+        mlt_factory_set_memory_pressure(mlt_memory_pressure_none);
+        QCOMPARE(mlt_factory_get_memory_pressure(), mlt_memory_pressure_none);
+        QCOMPARE(count, 2);
+        mlt_events_disconnect(mlt_factory_event_object(), &count);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestRepository)
@@ -69,6 +69,28 @@ private Q_SLOTS:
         QCOMPARE(mlt_service_identify(MLT_CONSUMER_SERVICE(consumer)), mlt_service_consumer_type);
     }
 
+    void PerfStatsCountGetFrameAndGetImage()
+    {
+        Profile profile;
+        Producer producer(profile, "color");
+        mlt_trace_set_counters(1);
+        for (int i = 0; i < 3; i++) {
+            Frame *frame = producer.get_frame();
+            mlt_image_format format = mlt_image_rgba;
+            int width = 0;
+            int height = 0;
+            frame->get_image(format, width, height);
+            delete frame;
+        }
+        mlt_trace_set_counters(0);
+        Properties *stats = producer.perf_stats();
+        QCOMPARE(stats->get_int("get_frame_count"), 3);
+        QCOMPARE(stats->get_int("get_image_count"), 3);
+        QVERIFY(stats->get_int64("get_image_p99") > 0);
+        QVERIFY(stats->get_int64("bytes_allocated") > 0);
+        delete stats;
+    }
+
 private:
     Repository* repo;
 };
@@ -22,6 +22,9 @@
 #include <mlt++/Mlt.h>
 using namespace Mlt;
 
+#include <cstring>
+#include <vector>
+
 class TestTractor : public QObject
 {
     Q_OBJECT
@@ -34,6 +37,61 @@ public:
         Factory::init();
     }
 
+    // A yuv422 image that is transparent but for a box in its middle
+    static int getTestImage(mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int)
+    {
+        mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+        int size = mlt_image_format_size(mlt_image_yuv422, *width, *height, NULL);
+        uint8_t *data = (uint8_t*) mlt_pool_alloc(size);
+        for (int i = 0; i < size; i++)
+            data[i] = (i * 7 + mlt_properties_get_int(properties, "test.seed")) & 0xff;
+        mlt_frame_set_image(frame, data, size, mlt_pool_release);
+        if (mlt_properties_get_int(properties, "test.alpha")) {
+            mlt_rect box = { double(*width * 2 / 5), double(*height * 2 / 5), double(*width / 5), double(*height / 5), 1.0 };
+            uint8_t *alpha = (uint8_t*) mlt_pool_alloc(*width * *height);
+            memset(alpha, 0, *width * *height);
+            for (int y = box.y; y < box.y + box.h; y++)
+                memset(alpha + y * *width + int(box.x), 200, box.w);
+            mlt_frame_set_alpha(frame, alpha, *width * *height, mlt_pool_release);
+            if (mlt_properties_get_int(properties, "test.bounds"))
+                mlt_frame_set_alpha_bounds(frame, box, 0);
+        }
+        *format = mlt_image_yuv422;
+        *image = data;
+        return 0;
+    }
+
+    static void onChanged(mlt_properties, int *count, mlt_event_data)
+    {
+        ++*count;
+    }
+
+    static std::vector<uint8_t> compositeTestImages(Profile &profile, bool bounds)
+    {
+        Transition transition(profile, "composite");
+        transition.set("distort", 1);
+        mlt_frame a = mlt_frame_init(transition.get_service());
+        mlt_frame b = mlt_frame_init(transition.get_service());
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(a), "test.seed", 1);
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(a), "progressive", profile.progressive());
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(b), "test.seed", 100);
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(b), "test.alpha", 1);
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(b), "test.bounds", bounds);
+        mlt_frame_push_get_image(a, getTestImage);
+        mlt_frame_push_get_image(b, getTestImage);
+        mlt_transition_process(transition.get_transition(), a, b);
+
+        mlt_image_format format = mlt_image_yuv422;
+        int width = profile.width();
+        int height = profile.height();
+        uint8_t *image = NULL;
+        mlt_frame_get_image(a, &image, &format, &width, &height, 0);
+        std::vector<uint8_t> result(image, image + mlt_image_format_size(format, width, height, NULL));
+        mlt_frame_close(a);
+        mlt_frame_close(b);
+        return result;
+    }
+
 private Q_SLOTS:
 
     void CreateSingleTrack()
@@ -402,6 +460,99 @@ private Q_SLOTS:
         QCOMPARE(t.count(), 1);
         QCOMPARE(filter.get_track(), 0);
     }
+
+    void CompositeAlphaBoundsMatchFullBlend()
+    {
+        // Widths with and without a remainder of pixels for the scalar blend
+        for (int width : { 100, 96 }) {
+            for (int progressive : { 0, 1 }) {
+                Profile p;
+                p.set_width(width);
+                p.set_height(50);
+                p.set_sample_aspect(1, 1);
+                p.set_display_aspect(width, 50);
+                p.set_frame_rate(25, 1);
+                p.set_progressive(progressive);
+                std::vector<uint8_t> full = compositeTestImages(p, false);
+                std::vector<uint8_t> bounded = compositeTestImages(p, true);
+                QCOMPARE(bounded.size(), full.size());
+                QVERIFY(bounded == full);
+            }
+        }
+    }
+
+    void TwoTracksRenderTopTrackImage()
+    {
+        // Without a transition the tractor gives the image of the top track
+        for (mlt_image_format format : { mlt_image_yuv422, mlt_image_rgba }) {
+            Tractor t(profile);
+            Producer bottom(profile, "colour:red");
+            Producer top(profile, "colour:0x2060a0c0");
+            t.set_track(bottom, 0);
+            t.set_track(top, 1);
+            std::vector<uint8_t> images[2];
+            Producer *producers[2] = { &t, &top };
+            for (int i = 0; i < 2; i++) {
+                Frame *frame = producers[i]->get_frame();
+                mlt_image_format f = format;
+                int width = profile.width();
+                int height = profile.height();
+                uint8_t *image = frame->get_image(f, width, height);
+                QVERIFY(image);
+                QCOMPARE(f, format);
+                images[i].assign(image, image + mlt_image_format_size(f, width, height, NULL));
+                delete frame;
+            }
+            QCOMPARE(images[0].size(), images[1].size());
+            QVERIFY(images[0] == images[1]);
+        }
+    }
+
+    void BatchedTrackChangesRefreshOnce()
+    {
+        Tractor t(profile);
+        Playlist a(profile), b(profile);
+        Producer p(profile, "noise");
+        t.set_track(a, 0);
+        t.set_track(b, 1);
+        mlt_tractor tractor = t.get_tractor();
+        Multitrack *multitrack = t.multitrack();
+        int changes = 0;
+        Event *event = multitrack->listen("producer-changed", &changes, (mlt_listener) onChanged);
+
+        mlt_tractor_begin_update(tractor);
+        a.append(p, 0, 9);
+        a.append(p, 0, 19);
+        mlt_tractor_begin_update(tractor);
+        a.append(p, 0, 29);
+        b.append(p, 0, 14);
+        mlt_tractor_end_update(tractor);
+        b.append(p, 0, 14);
+        QCOMPARE(changes, 0);
+        QCOMPARE(t.get_playtime(), 0);
+        mlt_tractor_end_update(tractor);
+        QCOMPARE(changes, 1);
+        QCOMPARE(t.get_playtime(), 60);
+        QCOMPARE(multitrack->get_playtime(), 60);
+
+        // Every change refreshes outside a batch
+        b.append(p, 0, 39);
+        QCOMPARE(changes, 2);
+        QCOMPARE(t.get_playtime(), 70);
+        QCOMPARE(b.get("eof"), "continue");
+
+        // The clip boundaries of all the tracks in order
+        const int starts[] = { 0, 10, 15, 30, 60, 70 };
+        for (int i = 0; i < 6; i++)
+            QCOMPARE(multitrack->clip(mlt_whence_relative_start, i), starts[i]);
+
+        // Nothing changed, so nothing is refreshed
+        mlt_tractor_begin_update(tractor);
+        mlt_tractor_end_update(tractor);
+        QCOMPARE(changes, 2);
+        delete event;
+        delete multitrack;
+    }
 };
 
 QTEST_APPLESS_MAIN(TestTractor)
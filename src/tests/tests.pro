@@ -1,5 +1,6 @@
 TEMPLATE = subdirs
-SUBDIRS = test_audio \
+SUBDIRS = bench_framework \
+    test_audio \
     test_filter \
     test_events \
     test_frame \